@@ -121,6 +121,25 @@ if (STATIC_BUILD OR NOT USE_SYSTEM_LUA)
 
   source_group(ThirdParty\\Lua REGULAR_EXPRESSION ${LUA_SOURCES_DIR}/.*)
 
+elseif (USE_LUAJIT)
+  # New in Orthanc 1.12.12. LuaJIT implements the API of Lua 5.1.
+  find_path(LUAJIT_INCLUDE_DIR
+    NAMES luajit.h
+    PATH_SUFFIXES luajit-2.1 luajit-2.0 luajit
+    )
+
+  find_library(LUAJIT_LIBRARY
+    NAMES luajit-5.1 luajit
+    )
+
+  if (NOT LUAJIT_INCLUDE_DIR OR NOT LUAJIT_LIBRARY)
+    message(FATAL_ERROR "Please install the libluajit-5.1-dev package")
+  endif()
+
+  message("LuaJIT include dir: ${LUAJIT_INCLUDE_DIR}")
+  include_directories(${LUAJIT_INCLUDE_DIR})
+  link_libraries(${LUAJIT_LIBRARY})
+
 elseif ((CMAKE_CROSSCOMPILING AND
       "${CMAKE_SYSTEM_VERSION}" STREQUAL "CrossToolNg") OR
     NOT "${ORTHANC_LUA_VERSION}" STREQUAL "")
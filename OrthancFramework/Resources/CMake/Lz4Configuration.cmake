@@ -0,0 +1,38 @@
+# Orthanc - A Lightweight, RESTful DICOM Store
+# Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+# Department, University Hospital of Liege, Belgium
+# Copyright (C) 2017-2023 Osimis S.A., Belgium
+# Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+# Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+#
+# This program is free software: you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public License
+# as published by the Free Software Foundation, either version 3 of
+# the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this program. If not, see
+# <http://www.gnu.org/licenses/>.
+
+
+
+if (STATIC_BUILD OR NOT USE_SYSTEM_LZ4)
+  message(FATAL_ERROR "Static linking against LZ4 is not supported, set USE_SYSTEM_LZ4 to ON or ENABLE_LZ4 to OFF")
+else()
+  CHECK_INCLUDE_FILE(lz4.h HAVE_LZ4_H)
+  if (NOT HAVE_LZ4_H)
+    message(FATAL_ERROR "Please install the liblz4-dev package")
+  endif()
+
+  find_library(LZ4_LIBRARY NAMES lz4)
+  if (NOT LZ4_LIBRARY)
+    message(FATAL_ERROR "Unable to find the LZ4 library")
+  endif()
+
+  link_libraries(${LZ4_LIBRARY})
+endif()
@@ -111,6 +111,7 @@ endif()
 
 if (NOT ENABLE_LUA)
   unset(USE_SYSTEM_LUA CACHE)
+  unset(USE_LUAJIT CACHE)
   unset(ENABLE_LUA_MODULES CACHE)
   unset(ORTHANC_LUA_VERSION)
   add_definitions(-DORTHANC_ENABLE_LUA=0)
@@ -160,6 +161,7 @@ endif()
 #####################################################################
 
 set(ORTHANC_CORE_SOURCES_INTERNAL
+  ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Cache/CacheStatistics.cpp
   ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Cache/MemoryCache.cpp
   ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Cache/MemoryObjectCache.cpp
   ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Cache/SharedObjectCache.cpp
@@ -170,6 +172,7 @@ set(ORTHANC_CORE_SOURCES_INTERNAL
   ${CMAKE_CURRENT_LIST_DIR}/../../Sources/ElapsedTimer.cpp
   ${CMAKE_CURRENT_LIST_DIR}/../../Sources/EnumerationDictionary.h
   ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Enumerations.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../../Sources/FileStorage/ContentAddressedStorageArea.cpp
   ${CMAKE_CURRENT_LIST_DIR}/../../Sources/FileStorage/FileInfo.cpp
   ${CMAKE_CURRENT_LIST_DIR}/../../Sources/FileStorage/MemoryStorageArea.cpp
   ${CMAKE_CURRENT_LIST_DIR}/../../Sources/FileStorage/PluginStorageAreaAdapter.cpp
@@ -199,6 +202,7 @@ if (ENABLE_MODULE_IMAGES)
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Images/Image.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Images/ImageAccessor.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Images/ImageBuffer.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Images/ImageBufferPool.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Images/ImageProcessing.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Images/NumpyWriter.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Images/PamReader.cpp
@@ -208,8 +212,10 @@ endif()
 
 if (ENABLE_MODULE_DICOM)
   list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomFormat/CompactDicomMap.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomFormat/DicomArray.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomFormat/DicomElement.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomFormat/DicomFrameOffsets.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomFormat/DicomImageInformation.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomFormat/DicomInstanceHasher.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomFormat/DicomIntegerPixelAccessor.cpp
@@ -338,6 +344,7 @@ if (ENABLE_WEB_SERVER)
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/RestApi/RestApiCall.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/RestApi/RestApiCallDocumentation.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/RestApi/RestApiGetCall.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/RestApi/RestApiJsonWriter.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/RestApi/RestApiOutput.cpp
     )
 
@@ -396,20 +403,54 @@ if (ENABLE_ZLIB)
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Compression/GzipCompressor.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Compression/IBufferCompressor.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Compression/ZipReader.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Compression/ZipStreamReader.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Compression/ZlibCompressor.cpp
     )
 
   if (NOT ORTHANC_SANDBOXED)
     list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Compression/HierarchicalZipWriter.cpp
+      ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Compression/StoredZipLayout.cpp
+      ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Compression/TarWriter.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Compression/ZipWriter.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/FileStorage/StorageAccessor.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/FileStorage/StorageCache.cpp
+      ${CMAKE_CURRENT_LIST_DIR}/../../Sources/FileStorage/StorageDiskCache.cpp
       )
   endif()
 endif()
 
 
+##
+## zstd and LZ4 support, as additional compression types for the
+## storage area (new in Orthanc 1.12.12)
+##
+
+if (ENABLE_ZLIB AND ENABLE_ZSTD)
+  include(${CMAKE_CURRENT_LIST_DIR}/ZstdConfiguration.cmake)
+  add_definitions(-DORTHANC_ENABLE_ZSTD=1)
+
+  list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Compression/ZstdCompressor.cpp
+    )
+else()
+  unset(USE_SYSTEM_ZSTD CACHE)
+  add_definitions(-DORTHANC_ENABLE_ZSTD=0)
+endif()
+
+if (ENABLE_ZLIB AND ENABLE_LZ4)
+  include(${CMAKE_CURRENT_LIST_DIR}/Lz4Configuration.cmake)
+  add_definitions(-DORTHANC_ENABLE_LZ4=1)
+
+  list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Compression/Lz4Compressor.cpp
+    )
+else()
+  unset(USE_SYSTEM_LZ4 CACHE)
+  add_definitions(-DORTHANC_ENABLE_LZ4=0)
+endif()
+
+
 ##
 ## PNG support: libpng (in conjunction with zlib)
 ##
@@ -574,9 +615,13 @@ if (ENABLE_DCMTK)
     list(APPEND ORTHANC_DICOM_SOURCES_INTERNAL
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/DicomAssociation.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/DicomAssociationParameters.cpp
+      ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/DicomAssociationQuotas.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/DicomConnectionInfo.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/DicomControlUserConnection.cpp
+      ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/DicomNetworkMetrics.cpp
+      ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/DicomPresentationContextsHistory.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/DicomServer.cpp
+      ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/DicomStoreConnectionPool.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/DicomStoreUserConnection.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/DimseErrorPayload.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DicomNetworking/Internals/CommandDispatcher.cpp
@@ -634,6 +679,20 @@ else()
 endif()
 
 
+if (ENABLE_LOCK_PROFILING)
+  add_definitions(-DORTHANC_ENABLE_LOCK_PROFILING=1)
+else()
+  add_definitions(-DORTHANC_ENABLE_LOCK_PROFILING=0)
+endif()
+
+
+if (ENABLE_CPU_PROFILER AND NOT ORTHANC_SANDBOXED)
+  add_definitions(-DORTHANC_ENABLE_CPU_PROFILER=1)
+else()
+  add_definitions(-DORTHANC_ENABLE_CPU_PROFILER=0)
+endif()
+
+
 if (ORTHANC_SANDBOXED)
   add_definitions(
     -DORTHANC_SANDBOXED=1
@@ -657,6 +716,7 @@ else()
   list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Cache/MemoryStringCache.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Cache/SharedArchive.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/CpuProfiler.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DataSource/DataSourceAnswer.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DataSource/DataSourceMemoryBudget.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DataSource/DataSourceReader.cpp
@@ -664,18 +724,27 @@ else()
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/DataSource/StorageAreaDataSource.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/FileBuffer.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/FileStorage/FilesystemStorage.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/FileStorage/MultiRootStorageArea.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MemoryMappedFileBuffer.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MetricsRegistry.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/BlockingSharedMessageQueue.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/BoundedMessageQueue.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/CallableGroup.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/ExecutorTask.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/FairSharedMutex.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/Future.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/FutureState.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/LockProfiler.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/RunnableWorkersPool.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/Semaphore.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/SharedMessageQueue.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/ThreadPool.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/MultiThreading/WorkStealingThreadPool.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/RequestTimings.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/SharedLibrary.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/SystemToolbox.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../../Sources/TemporaryFile.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../../Sources/Tracing.cpp
     )
 
   if (ENABLE_DCMTK)
@@ -686,6 +755,7 @@ else()
 
   if (ENABLE_MODULE_JOBS)
     list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
+      ${CMAKE_CURRENT_LIST_DIR}/../../Sources/JobsEngine/JobTasksExecutor.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/JobsEngine/JobsEngine.cpp
       ${CMAKE_CURRENT_LIST_DIR}/../../Sources/JobsEngine/JobsRegistry.cpp
       )
@@ -54,8 +54,12 @@ set(STATIC_BUILD OFF CACHE BOOL "Static build of the third-party libraries (nece
 set(ENABLE_CIVETWEB ON CACHE BOOL "Use Civetweb instead of Mongoose (Mongoose was the default embedded HTTP server in Orthanc <= 1.5.1)")
 set(ENABLE_PKCS11 OFF CACHE BOOL "Enable PKCS#11 for HTTPS client authentication using hardware security modules and smart cards")
 set(ENABLE_PROFILING OFF CACHE BOOL "Whether to enable the generation of profiling information with gprof")
+set(ENABLE_LOCK_PROFILING OFF CACHE BOOL "Whether to record the contention on the main mutexes, and to export it as metrics (new in Orthanc 1.12.12)")
+set(ENABLE_CPU_PROFILER OFF CACHE BOOL "Whether to include the sampling CPU profiler that can be triggered through the REST API, only on Linux (new in Orthanc 1.12.12)")
 set(ENABLE_SSL ON CACHE BOOL "Include support for SSL")
 set(ENABLE_LUA_MODULES OFF CACHE BOOL "Enable support for loading external Lua modules (only meaningful if using static version of the Lua engine)")
+set(ENABLE_ZSTD OFF CACHE BOOL "Enable the zstd compression of the attachments (only meaningful if zlib is enabled, new in Orthanc 1.12.12)")
+set(ENABLE_LZ4 OFF CACHE BOOL "Enable the LZ4 compression of the attachments (only meaningful if zlib is enabled, new in Orthanc 1.12.12)")
 
 # Parameters to fine-tune linking against system libraries
 set(USE_SYSTEM_BOOST ON CACHE BOOL "Use the system version of Boost")
@@ -68,7 +72,9 @@ set(USE_SYSTEM_LIBICU ON CACHE BOOL "Use the system version of libicu")
 set(USE_SYSTEM_LIBJPEG ON CACHE BOOL "Use the system version of libjpeg")
 set(USE_SYSTEM_LIBP11 OFF CACHE BOOL "Use the system version of libp11 (PKCS#11 wrapper library)")
 set(USE_SYSTEM_LIBPNG ON CACHE BOOL "Use the system version of libpng")
+set(USE_SYSTEM_LZ4 ON CACHE BOOL "Use the system version of LZ4 (new in Orthanc 1.12.12)")
 set(USE_SYSTEM_LUA ON CACHE BOOL "Use the system version of Lua")
+set(USE_LUAJIT OFF CACHE BOOL "Use the system version of LuaJIT instead of Lua (only meaningful if USE_SYSTEM_LUA is ON, new in Orthanc 1.12.12)")
 set(USE_SYSTEM_MINIZIP OFF CACHE BOOL "Use the system version minizip (new in Orthanc 1.12.11)")
 set(USE_SYSTEM_MONGOOSE ON CACHE BOOL "Use the system version of Mongoose")
 set(USE_SYSTEM_OPENSSL ON CACHE BOOL "Use the system version of OpenSSL")
@@ -77,6 +83,7 @@ set(USE_SYSTEM_PUGIXML ON CACHE BOOL "Use the system version of Pugixml")
 set(USE_SYSTEM_SQLITE ON CACHE BOOL "Use the system version of SQLite")
 set(USE_SYSTEM_UUID ON CACHE BOOL "Use the system version of the uuid library from e2fsprogs")
 set(USE_SYSTEM_ZLIB ON CACHE BOOL "Use the system version of ZLib")
+set(USE_SYSTEM_ZSTD ON CACHE BOOL "Use the system version of zstd (new in Orthanc 1.12.12)")
 
 set(DCMTK_DICTIONARY_DIR "" CACHE PATH "Directory containing the DCMTK dictionaries \"dicom.dic\" and \"private.dic\" (only when using system version of DCMTK)")
 set(DCMTK_STATIC_VERSION "3.7.0" CACHE STRING "Version of DCMTK to be used in static builds (can be \"3.6.0\", \"3.6.2\", \"3.6.4\", \"3.6.5\", \"3.6.6\", \"3.6.7\", \"3.6.8\", \"3.6.9\", or \"3.7.0\")")
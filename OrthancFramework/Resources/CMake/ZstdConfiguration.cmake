@@ -0,0 +1,38 @@
+# Orthanc - A Lightweight, RESTful DICOM Store
+# Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+# Department, University Hospital of Liege, Belgium
+# Copyright (C) 2017-2023 Osimis S.A., Belgium
+# Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+# Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+#
+# This program is free software: you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public License
+# as published by the Free Software Foundation, either version 3 of
+# the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this program. If not, see
+# <http://www.gnu.org/licenses/>.
+
+
+
+if (STATIC_BUILD OR NOT USE_SYSTEM_ZSTD)
+  message(FATAL_ERROR "Static linking against zstd is not supported, set USE_SYSTEM_ZSTD to ON or ENABLE_ZSTD to OFF")
+else()
+  CHECK_INCLUDE_FILE(zstd.h HAVE_ZSTD_H)
+  if (NOT HAVE_ZSTD_H)
+    message(FATAL_ERROR "Please install the libzstd-dev package")
+  endif()
+
+  find_library(ZSTD_LIBRARY NAMES zstd)
+  if (NOT ZSTD_LIBRARY)
+    message(FATAL_ERROR "Unable to find the zstd library")
+  endif()
+
+  link_libraries(${ZSTD_LIBRARY})
+endif()
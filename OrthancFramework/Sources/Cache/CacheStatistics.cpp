@@ -0,0 +1,77 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "CacheStatistics.h"
+
+
+namespace Orthanc
+{
+  CacheStatistics::CacheStatistics()
+  {
+    Clear();
+  }
+
+
+  void CacheStatistics::Clear()
+  {
+    hits_ = 0;
+    misses_ = 0;
+    evictions_ = 0;
+    loads_ = 0;
+    loadTime_ = 0;
+  }
+
+
+  void CacheStatistics::AddLoad(uint64_t microseconds)
+  {
+    loads_++;
+    loadTime_ += microseconds;
+  }
+
+
+  void CacheStatistics::Merge(const CacheStatistics& other)
+  {
+    hits_ += other.hits_;
+    misses_ += other.misses_;
+    evictions_ += other.evictions_;
+    loads_ += other.loads_;
+    loadTime_ += other.loadTime_;
+  }
+
+
+  float CacheStatistics::GetAverageLoadTimeMilliseconds() const
+  {
+    if (loads_ == 0)
+    {
+      return 0;
+    }
+    else
+    {
+      return static_cast<float>(loadTime_) / static_cast<float>(loads_) / 1000.0f;
+    }
+  }
+}
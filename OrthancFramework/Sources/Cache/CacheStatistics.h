@@ -0,0 +1,102 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#include <stdint.h>
+
+
+namespace Orthanc
+{
+  /**
+   * Counters describing the efficiency of one cache, that are
+   * reported by "GET /tools/caches" and published as metrics. New in
+   * Orthanc 1.12.12.
+   *
+   * Note: this class is NOT thread safe, the cache that owns it must
+   * protect it with its own mutex.
+   **/
+  class ORTHANC_PUBLIC CacheStatistics
+  {
+  private:
+    uint64_t  hits_;
+    uint64_t  misses_;
+    uint64_t  evictions_;
+    uint64_t  loads_;
+    uint64_t  loadTime_;  // In microseconds
+
+  public:
+    CacheStatistics();
+
+    void Clear();
+
+    void AddHit()
+    {
+      hits_++;
+    }
+
+    void AddMiss()
+    {
+      misses_++;
+    }
+
+    void AddEviction()
+    {
+      evictions_++;
+    }
+
+    // Records the time that was needed to load one item after a miss
+    void AddLoad(uint64_t microseconds);
+
+    // Accumulates the counters of another cache (e.g. of one shard)
+    void Merge(const CacheStatistics& other);
+
+    uint64_t GetHits() const
+    {
+      return hits_;
+    }
+
+    uint64_t GetMisses() const
+    {
+      return misses_;
+    }
+
+    uint64_t GetEvictions() const
+    {
+      return evictions_;
+    }
+
+    uint64_t GetLoads() const
+    {
+      return loads_;
+    }
+
+    // Returns 0 if no item has been loaded yet
+    float GetAverageLoadTimeMilliseconds() const;
+  };
+}
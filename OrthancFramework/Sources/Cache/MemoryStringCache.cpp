@@ -25,10 +25,19 @@
 #include "../PrecompiledHeaders.h"
 #include "MemoryStringCache.h"
 
+#include "../ElapsedTimer.h"
 #include "../Logging.h"
+#include "../MultiThreading/LockProfiler.h"
+#include "../SystemToolbox.h"
 
 namespace Orthanc
 {
+#if ORTHANC_ENABLE_LOCK_PROFILING == 1
+  // Shared by all the shards of all the caches. The waits for the
+  // items that are being loaded are not profiled.
+  static LockProfiler  memoryStringCacheLockProfiler_("MemoryStringCache");
+#endif
+
   class MemoryStringCache::StringValue : public ICacheable
   {
   private:
@@ -57,9 +66,353 @@ namespace Orthanc
   };
 
 
+  /**
+   * With the "2Q" policy, each shard is made of two queues. Newly
+   * added items enter the "probation" FIFO queue, which is limited to
+   * a fraction of the shard size. Items are only promoted to the
+   * "protected" LRU queue once they are accessed a second time, or if
+   * they are reloaded shortly after having been evicted from the
+   * probation queue (which is tracked by the "ghosts" index). A
+   * sequential scan over many items thus only flushes the probation
+   * queue. With the "LRU" policy, only the protected queue is used.
+   **/
+  class MemoryStringCache::Shard : public boost::noncopyable
+  {
+  private:
+    typedef LeastRecentlyUsedIndex<std::string, StringValue*>  Queue;
+
+    mutable boost::mutex      cacheMutex_;  // note: we can not use recursive_mutex with condition_variable
+    boost::condition_variable cacheCond_;
+    std::set<std::string>     itemsBeingLoaded_;
+
+    CachePolicy  policy_;
+    size_t       currentSize_;
+    size_t       probationSize_;
+    size_t       maxSize_;
+    Queue        content_;
+    Queue        probation_;
+    LeastRecentlyUsedIndex<std::string>  ghosts_;
+    CacheStatistics           statistics_;
+
+    size_t GetMaximumProbationSize() const
+    {
+      return maxSize_ / 4;
+    }
+
+    void RemoveOldestProbation()
+    {
+      StringValue* item = NULL;
+      const std::string key = probation_.RemoveOldest(item);
+
+      assert(item != NULL);
+      const size_t size = item->GetMemoryUsage();
+      delete item;
+
+      assert(currentSize_ >= size &&
+             probationSize_ >= size);
+      currentSize_ -= size;
+      probationSize_ -= size;
+      statistics_.AddEviction();
+
+      // Remember the evicted key, limiting the number of ghosts to
+      // half the number of items that are currently cached
+      ghosts_.AddOrMakeMostRecent(key);
+
+      while (!ghosts_.IsEmpty() &&
+             ghosts_.GetSize() > 1 + (content_.GetSize() + probation_.GetSize()) / 2)
+      {
+        ghosts_.RemoveOldest();
+      }
+    }
+
+    void RemoveOldestContent()
+    {
+      StringValue* item = NULL;
+      content_.RemoveOldest(item);
+
+      assert(item != NULL);
+      const size_t size = item->GetMemoryUsage();
+      delete item;
+
+      assert(currentSize_ >= size);
+      currentSize_ -= size;
+      statistics_.AddEviction();
+    }
+
+    void Recycle(size_t targetSize)
+    {
+      // WARNING: "cacheMutex_" must be locked
+      while (currentSize_ > targetSize ||
+             (targetSize == 0 && (!content_.IsEmpty() || !probation_.IsEmpty())))  // also remove empty items
+      {
+        assert(!content_.IsEmpty() || !probation_.IsEmpty());
+
+        if (!probation_.IsEmpty() &&
+            (content_.IsEmpty() || probationSize_ > GetMaximumProbationSize()))
+        {
+          RemoveOldestProbation();
+        }
+        else
+        {
+          RemoveOldestContent();
+        }
+      }
+
+      if (targetSize == 0)
+      {
+        while (!ghosts_.IsEmpty())
+        {
+          ghosts_.RemoveOldest();
+        }
+      }
+
+      // Post-condition: "currentSize_ <= targetSize"
+    }
+
+    void RemoveFromItemsBeingLoadedInternal(const std::string& key)
+    {
+      // notify all waiting users, some of them potentially waiting for this item
+      itemsBeingLoaded_.erase(key);
+      cacheCond_.notify_all();
+    }
+
+    bool ContainsInternal(const std::string& key) const
+    {
+      return content_.Contains(key) || probation_.Contains(key);
+    }
+
+  public:
+    Shard(size_t maxSize,
+          CachePolicy policy) :
+      policy_(policy),
+      currentSize_(0),
+      probationSize_(0),
+      maxSize_(maxSize)
+    {
+    }
+
+    ~Shard()
+    {
+      Recycle(0);  // Evictions are not counted anymore at this point
+      assert(content_.IsEmpty() &&
+             probation_.IsEmpty());
+    }
+
+    void SetMaximumSize(size_t size)
+    {
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, cacheLock, cacheMutex_, memoryStringCacheLockProfiler_);
+
+      Recycle(size);
+      maxSize_ = size;
+    }
+
+    void Add(const std::string& key,
+             const char* buffer,
+             size_t size)
+    {
+      {
+        ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, cacheLock, cacheMutex_, memoryStringCacheLockProfiler_);
+
+        if (size > maxSize_)
+        {
+          // Don't copy objects that are too large to be stored in the cache
+          RemoveFromItemsBeingLoadedInternal(key);
+          return;
+        }
+      }
+
+      std::unique_ptr<StringValue> item(new StringValue(buffer, size));
+
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, cacheLock, cacheMutex_, memoryStringCacheLockProfiler_);
+
+      if (size > maxSize_)
+      {
+        // This object is too large to be stored in the cache, discard it
+      }
+      else if (content_.Contains(key))
+      {
+        // Value already stored, don't overwrite the old value but put it on top of the cache
+        content_.MakeMostRecent(key);
+      }
+      else if (probation_.Contains(key))
+      {
+        // Value already stored in the probation queue, which is a FIFO
+      }
+      else
+      {
+        Recycle(maxSize_ - size);   // Post-condition: currentSize_ <= maxSize_ - size
+        assert(currentSize_ + size <= maxSize_);
+
+        if (policy_ == CachePolicy_LeastRecentlyUsed)
+        {
+          content_.Add(key, item.release());
+        }
+        else if (ghosts_.Contains(key))
+        {
+          // This item was recently evicted from the probation queue
+          ghosts_.Invalidate(key);
+          content_.Add(key, item.release());
+        }
+        else
+        {
+          probation_.Add(key, item.release());
+          probationSize_ += size;
+        }
+
+        currentSize_ += size;
+      }
+
+      RemoveFromItemsBeingLoadedInternal(key);
+    }
+
+    void Invalidate(const std::string& key)
+    {
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, cacheLock, cacheMutex_, memoryStringCacheLockProfiler_);
+
+      StringValue* item = NULL;
+      if (content_.Contains(key, item))
+      {
+        assert(item != NULL);
+        const size_t size = item->GetMemoryUsage();
+        delete item;
+
+        content_.Invalidate(key);
+          
+        assert(currentSize_ >= size);
+        currentSize_ -= size;
+      }
+      else if (probation_.Contains(key, item))
+      {
+        assert(item != NULL);
+        const size_t size = item->GetMemoryUsage();
+        delete item;
+
+        probation_.Invalidate(key);
+
+        assert(currentSize_ >= size &&
+               probationSize_ >= size);
+        currentSize_ -= size;
+        probationSize_ -= size;
+      }
+
+      if (ghosts_.Contains(key))
+      {
+        ghosts_.Invalidate(key);
+      }
+
+      RemoveFromItemsBeingLoadedInternal(key);
+    }
+
+    bool Fetch(std::string& value,
+               const std::string& key,
+               bool admission)
+    {
+      boost::mutex::scoped_lock cacheLock(cacheMutex_);
+
+      StringValue* item;
+
+      // if another client is currently loading the item, wait for it.
+      while (itemsBeingLoaded_.find(key) != itemsBeingLoaded_.end() && !ContainsInternal(key))
+      {
+        cacheCond_.wait(cacheLock);
+      }
+
+      if (content_.Contains(key, item))
+      {
+        value = dynamic_cast<StringValue&>(*item).GetContent();
+        statistics_.AddHit();
+
+        if (admission)
+        {
+          content_.MakeMostRecent(key);
+        }
+
+        return true;
+      }
+      else if (probation_.Contains(key, item))
+      {
+        value = dynamic_cast<StringValue&>(*item).GetContent();
+        statistics_.AddHit();
+
+        if (admission)
+        {
+          // Second access: Promote the item to the protected queue
+          probation_.Invalidate(key);
+          content_.Add(key, item);
+
+          assert(probationSize_ >= item->GetMemoryUsage());
+          probationSize_ -= item->GetMemoryUsage();
+        }
+
+        return true;
+      }
+      else
+      {
+        statistics_.AddMiss();
+
+        if (admission)
+        {
+          // note that this accessor will be in charge of loading and adding.
+          itemsBeingLoaded_.insert(key);
+        }
+
+        return false;
+      }
+    }
+
+    void RemoveFromItemsBeingLoaded(const std::string& key)
+    {
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, cacheLock, cacheMutex_, memoryStringCacheLockProfiler_);
+      RemoveFromItemsBeingLoadedInternal(key);
+    }
+
+    void AddLoad(uint64_t microseconds)
+    {
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, cacheLock, cacheMutex_, memoryStringCacheLockProfiler_);
+      statistics_.AddLoad(microseconds);
+    }
+
+    void GetStatistics(CacheStatistics& target) const
+    {
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, cacheLock, cacheMutex_, memoryStringCacheLockProfiler_);
+      target.Merge(statistics_);
+    }
+
+    bool IsIdle() const
+    {
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, cacheLock, cacheMutex_, memoryStringCacheLockProfiler_);
+      return itemsBeingLoaded_.empty();
+    }
+
+    size_t GetCurrentSize() const
+    {
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, cacheLock, cacheMutex_, memoryStringCacheLockProfiler_);
+      return currentSize_;
+    }
+
+    size_t GetNumberOfItems() const
+    {
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, cacheLock, cacheMutex_, memoryStringCacheLockProfiler_);
+      return content_.GetSize() + probation_.GetSize();
+    }
+  };
+
+
   MemoryStringCache::Accessor::Accessor(MemoryStringCache& cache)
   : cache_(cache),
-    shouldAdd_(false)
+    admission_(true),
+    shouldAdd_(false),
+    numaNode_(cache.GetCurrentNumaNode())
+  {
+  }
+
+
+  MemoryStringCache::Accessor::Accessor(MemoryStringCache& cache,
+                                        bool admission)
+  : cache_(cache),
+    admission_(admission),
+    shouldAdd_(false),
+    numaNode_(cache.GetCurrentNumaNode())
   {
   }
 
@@ -71,7 +424,7 @@ namespace Orthanc
     // stop waiting for it.
     if (shouldAdd_)
     {
-      cache_.RemoveFromItemsBeingLoaded(keyToAdd_);
+      cache_.RemoveFromItemsBeingLoaded(numaNode_, keyToAdd_);
     }
   }
 
@@ -83,212 +436,341 @@ namespace Orthanc
     // others will wait.
     // if the first one fails to add, or, if the content was too large to fit in the cache,
     // the next one will be in charge of adding ...
-    if (!cache_.Fetch(value, key))
+    // if this accessor has no admission, it never becomes in charge of adding.
+    if (!cache_.Fetch(numaNode_, value, key, admission_))
     {
-      shouldAdd_ = true;
+      shouldAdd_ = admission_;
       keyToAdd_ = key;
+
+      if (admission_)
+      {
+        loadTimer_.reset(new ElapsedTimer);
+      }
+
       return false;
     }
 
     shouldAdd_ = false;
     keyToAdd_.clear();
+    loadTimer_.reset(NULL);
 
     return true;
   }
 
 
+  void MemoryStringCache::Accessor::AddLoadTime(const std::string& key)
+  {
+    if (shouldAdd_ &&
+        loadTimer_.get() != NULL &&
+        keyToAdd_ == key)
+    {
+      cache_.AddLoad(numaNode_, key, loadTimer_->GetElapsedMicroseconds());
+      loadTimer_.reset(NULL);
+    }
+  }
+
+
   void MemoryStringCache::Accessor::Add(const std::string& key, const std::string& value)
   {
-    cache_.Add(key, value);
-    shouldAdd_ = false;
+    if (admission_)
+    {
+      AddLoadTime(key);
+      cache_.Add(numaNode_, key, value);
+      shouldAdd_ = false;
+    }
   }
 
 
   void MemoryStringCache::Accessor::Add(const std::string& key, const char* buffer, size_t size)
   {
-    cache_.Add(key, buffer, size);
-    shouldAdd_ = false;
+    if (admission_)
+    {
+      AddLoadTime(key);
+      cache_.Add(numaNode_, key, buffer, size);
+      shouldAdd_ = false;
+    }
+  }
+
+
+  void MemoryStringCache::AddLoad(size_t numaNode,
+                                  const std::string& key,
+                                  uint64_t microseconds)
+  {
+    GetShard(numaNode, key).AddLoad(microseconds);
   }
 
 
   MemoryStringCache::MemoryStringCache() :
-    currentSize_(0),
-    maxSize_(static_cast<size_t>(100) * 1024 * 1024)  // 100 MB
+    maxSize_(static_cast<size_t>(100) * 1024 * 1024),  // 100 MB
+    policy_(CachePolicy_LeastRecentlyUsed),
+    numaNodesCount_(1)
   {
+    shards_.push_back(new Shard(maxSize_, policy_));
   }
 
 
   MemoryStringCache::~MemoryStringCache()
   {
-    try
-    {
-      Recycle(0);
-    }
-    catch (OrthancException& e)
+    for (size_t i = 0; i < shards_.size(); i++)
     {
-      // Don't throw exceptions in destructors
-      LOG(ERROR) << "Exception in destructor: " << e.What();
+      assert(shards_[i] != NULL);
+      delete shards_[i];
     }
-
-    assert(content_.IsEmpty());
   }
 
 
-  size_t MemoryStringCache::GetMaximumSize()
+  void MemoryStringCache::ResetShards(size_t count,
+                                      CachePolicy policy)
   {
-    return maxSize_;
-  }
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      assert(shards_[i] != NULL);
+      if (!shards_[i]->IsIdle())
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                               "Cannot reconfigure the cache while items are being loaded");
+      }
+    }
+
+    // The content of the cache is discarded
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      delete shards_[i];
+    }
 
+    shards_.clear();
 
-  void MemoryStringCache::SetMaximumSize(size_t size)
-  {
-    // // Make sure no accessor is currently open (as its data may be
-    // // removed if recycling is needed)
-    // WriterLock contentLock(contentMutex_);
+    for (size_t i = 0; i < count * numaNodesCount_; i++)
+    {
+      shards_.push_back(new Shard(0, policy));
+    }
 
-    // Lock the global structure of the cache
-    boost::mutex::scoped_lock cacheLock(cacheMutex_);
+    policy_ = policy;
 
-    Recycle(size);
-    maxSize_ = size;
+    if (count != 0)
+    {
+      SetMaximumSize(maxSize_);
+    }
   }
 
 
-  void MemoryStringCache::Add(const std::string& key,
-                               const std::string& value)
+  MemoryStringCache::Shard& MemoryStringCache::GetShard(size_t numaNode,
+                                                        const std::string& key) const
   {
-    std::unique_ptr<StringValue> item(new StringValue(value));
-    size_t size = value.size();
+    assert(!shards_.empty() &&
+           numaNode < numaNodesCount_);
 
-    boost::mutex::scoped_lock cacheLock(cacheMutex_);
+    const size_t shardsPerNode = shards_.size() / numaNodesCount_;
 
-    if (size > maxSize_)
+    if (shardsPerNode == 1)
+    {
+      return *shards_[numaNode];
+    }
+    else
     {
-      // This object is too large to be stored in the cache, discard it
+      // 32-bit FNV-1a hash of the key
+      uint32_t hash = 2166136261u;
+      for (size_t i = 0; i < key.size(); i++)
+      {
+        hash = (hash ^ static_cast<uint8_t>(key[i])) * 16777619u;
+      }
+
+      return *shards_[numaNode * shardsPerNode + hash % shardsPerNode];
     }
-    else if (content_.Contains(key))
+  }
+
+
+  size_t MemoryStringCache::GetCurrentNumaNode() const
+  {
+    unsigned int cpu;
+
+    if (numaNodesCount_ > 1 &&
+        SystemToolbox::GetCurrentCpu(cpu) &&
+        cpu < cpuToNumaNode_.size())
     {
-      // Value already stored, don't overwrite the old value but put it on top of the cache
-      content_.MakeMostRecent(key);
+      return cpuToNumaNode_[cpu];
     }
     else
     {
-      Recycle(maxSize_ - size);   // Post-condition: currentSize_ <= maxSize_ - size
-      assert(currentSize_ + size <= maxSize_);
-
-      content_.Add(key, item.release());
-      currentSize_ += size;
+      return 0;
     }
-
-    RemoveFromItemsBeingLoadedInternal(key);
   }
 
 
-  void MemoryStringCache::Add(const std::string& key,
-                              const void* buffer,
-                              size_t size)
+  size_t MemoryStringCache::GetMaximumSize()
   {
-    Add(key, std::string(reinterpret_cast<const char*>(buffer), size));
+    return maxSize_;
   }
 
 
-  void MemoryStringCache::Invalidate(const std::string &key)
+  void MemoryStringCache::SetMaximumSize(size_t size)
   {
-    boost::mutex::scoped_lock cacheLock(cacheMutex_);
+    // The first shard receives the remainder of the division
+    const size_t shardSize = size / shards_.size();
+    const size_t remainder = size % shards_.size();
 
-    StringValue* item = NULL;
-    if (content_.Contains(key, item))
+    for (size_t i = 0; i < shards_.size(); i++)
     {
-      assert(item != NULL);
-      const size_t size = item->GetMemoryUsage();
-      delete item;
-
-      content_.Invalidate(key);
-          
-      assert(currentSize_ >= size);
-      currentSize_ -= size;
+      shards_[i]->SetMaximumSize(i == 0 ? shardSize + remainder : shardSize);
     }
 
-    RemoveFromItemsBeingLoadedInternal(key);
+    maxSize_ = size;
   }
 
 
-  bool MemoryStringCache::Fetch(std::string& value,
-                                const std::string& key)
+  void MemoryStringCache::SetNumberOfShards(size_t count)
   {
-    boost::mutex::scoped_lock cacheLock(cacheMutex_);
-
-    StringValue* item;
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The storage cache must have at least one shard");
+    }
 
-    // if another client is currently loading the item, wait for it.
-    while (itemsBeingLoaded_.find(key) != itemsBeingLoaded_.end() && !content_.Contains(key, item))
+    if (count != GetNumberOfShards())
     {
-      cacheCond_.wait(cacheLock);
+      ResetShards(count, policy_);
     }
+  }
 
-    if (content_.Contains(key, item))
+
+  void MemoryStringCache::SetPolicy(CachePolicy policy)
+  {
+    if (policy != policy_)
     {
-      value = dynamic_cast<StringValue&>(*item).GetContent();
-      content_.MakeMostRecent(key);
+      ResetShards(GetNumberOfShards(), policy);
+    }
+  }
+
+
+  void MemoryStringCache::SetNumaAware(bool numaAware)
+  {
+    std::vector<size_t> cpuToNumaNode;
+    size_t numaNodesCount = 1;
 
-      return true;
+    if (numaAware)
+    {
+      std::vector<std::set<unsigned int> > nodes;
+      SystemToolbox::GetNumaNodes(nodes);
+
+      if (nodes.size() > 1)
+      {
+        numaNodesCount = nodes.size();
+
+        for (size_t node = 0; node < nodes.size(); node++)
+        {
+          for (std::set<unsigned int>::const_iterator cpu = nodes[node].begin(); cpu != nodes[node].end(); ++cpu)
+          {
+            if (*cpu >= cpuToNumaNode.size())
+            {
+              cpuToNumaNode.resize(*cpu + 1, 0);
+            }
+
+            cpuToNumaNode[*cpu] = node;
+          }
+        }
+      }
+      else
+      {
+        LOG(WARNING) << "The NUMA topology is unknown or has a single node, the cache is not split by NUMA node";
+      }
     }
-    else
+
+    if (numaNodesCount != numaNodesCount_)
     {
-      // note that this accessor will be in charge of loading and adding.
-      itemsBeingLoaded_.insert(key);
-      return false;
+      const size_t shardsPerNode = GetNumberOfShards();
+      const size_t previousCount = numaNodesCount_;
+
+      numaNodesCount_ = numaNodesCount;
+      cpuToNumaNode_.swap(cpuToNumaNode);
+
+      try
+      {
+        ResetShards(shardsPerNode, policy_);
+      }
+      catch (OrthancException&)
+      {
+        numaNodesCount_ = previousCount;
+        cpuToNumaNode_.swap(cpuToNumaNode);
+        throw;
+      }
     }
   }
 
 
-  void MemoryStringCache::RemoveFromItemsBeingLoaded(const std::string& key)
+  void MemoryStringCache::Add(size_t numaNode,
+                              const std::string& key,
+                              const std::string& value)
   {
-    boost::mutex::scoped_lock cacheLock(cacheMutex_);
-    RemoveFromItemsBeingLoadedInternal(key);
+    GetShard(numaNode, key).Add(key, value.c_str(), value.size());
   }
 
 
-  void MemoryStringCache::RemoveFromItemsBeingLoadedInternal(const std::string& key)
+  void MemoryStringCache::Add(size_t numaNode,
+                              const std::string& key,
+                              const void* buffer,
+                              size_t size)
   {
-    // notify all waiting users, some of them potentially waiting for this item
-    itemsBeingLoaded_.erase(key);
-    cacheCond_.notify_all();
+    GetShard(numaNode, key).Add(key, reinterpret_cast<const char*>(buffer), size);
   }
 
-  void MemoryStringCache::Recycle(size_t targetSize)
+
+  void MemoryStringCache::Invalidate(const std::string &key)
   {
-    // WARNING: "cacheMutex_" must be locked
-    while (currentSize_ > targetSize)
+    // The item might have been cached by each NUMA node
+    for (size_t node = 0; node < numaNodesCount_; node++)
     {
-      assert(!content_.IsEmpty());
-        
-      StringValue* item = NULL;
-      content_.RemoveOldest(item);
+      GetShard(node, key).Invalidate(key);
+    }
+  }
 
-      assert(item != NULL);
-      const size_t size = item->GetMemoryUsage();
-      delete item;
 
-      assert(currentSize_ >= size);
-      currentSize_ -= size;
-    }
+  bool MemoryStringCache::Fetch(size_t numaNode,
+                                std::string& value,
+                                const std::string& key,
+                                bool admission)
+  {
+    return GetShard(numaNode, key).Fetch(value, key, admission);
+  }
 
-    // Post-condition: "currentSize_ <= targetSize"
+
+  void MemoryStringCache::RemoveFromItemsBeingLoaded(size_t numaNode,
+                                                     const std::string& key)
+  {
+    GetShard(numaNode, key).RemoveFromItemsBeingLoaded(key);
   }
 
+
   size_t MemoryStringCache::GetCurrentSize() const
   {
-    boost::mutex::scoped_lock cacheLock(cacheMutex_);
+    size_t size = 0;
 
-    return currentSize_;
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      size += shards_[i]->GetCurrentSize();
+    }
+
+    return size;
   }
     
   size_t MemoryStringCache::GetNumberOfItems() const
   {
-    boost::mutex::scoped_lock cacheLock(cacheMutex_);
-    return content_.GetSize();
+    size_t count = 0;
+
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      count += shards_[i]->GetNumberOfItems();
+    }
 
+    return count;
   }
 
+
+  void MemoryStringCache::GetStatistics(CacheStatistics& target) const
+  {
+    target.Clear();
+
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      shards_[i]->GetStatistics(target);
+    }
+  }
 }
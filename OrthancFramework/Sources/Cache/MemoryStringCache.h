@@ -25,15 +25,21 @@
 #pragma once
 
 #include "../OrthancFramework.h"
+#include "../Compatibility.h"  // For std::unique_ptr<>
+#include "../Enumerations.h"
+#include "CacheStatistics.h"
 #include "ICacheable.h"
 #include "LeastRecentlyUsedIndex.h"
 
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
+#include <vector>
 
 
 namespace Orthanc
 {
+  class ElapsedTimer;
+
   /**
    * Class that caches a dictionary
    * of strings, using the "fetch/add" paradigm of memcached.
@@ -42,6 +48,15 @@ namespace Orthanc
    * an inexistent item at the same time, only one of them will load it
    * and the others will wait until the first one has loaded the data.
    * 
+   * Starting from 1.12.12, the cache can be split into several
+   * shards that are selected by hashing the key, in order to reduce
+   * lock contention between threads. The eviction policy can also be
+   * set to a scan-resistant "2Q" policy, and accessors can be created
+   * "without admission" so that bulk readers can benefit from the
+   * cache without polluting it. Finally, the shards can be grouped
+   * by NUMA node, so that the cached items are local to the threads
+   * that use them.
+   * 
    * The MemoryStringCache is only accessible through an Accessor.
    * 
    * Note: this class is thread safe
@@ -55,12 +70,20 @@ namespace Orthanc
       MemoryStringCache& cache_;
 
     private:
+      bool                admission_;  // if "false", this accessor never inserts new items into the cache
       bool                shouldAdd_;  // when this accessor is the one who should load and add the data
       std::string         keyToAdd_;
+      std::unique_ptr<ElapsedTimer>  loadTimer_;  // measures the time to load "keyToAdd_"
+      size_t              numaNode_;   // group of shards that is used by this accessor
 
+      void AddLoadTime(const std::string& key);
 
     public:
       explicit Accessor(MemoryStringCache& cache);
+
+      Accessor(MemoryStringCache& cache,
+               bool admission);
+
       ~Accessor();
 
       bool Fetch(std::string& value, const std::string& key);
@@ -70,16 +93,24 @@ namespace Orthanc
 
   private:
     class StringValue;
+    class Shard;
 
-    mutable boost::mutex      cacheMutex_;  // note: we can not use recursive_mutex with condition_variable
-    boost::condition_variable cacheCond_;
-    std::set<std::string>     itemsBeingLoaded_;
+    // The vector of shards is only modified by "SetNumberOfShards()",
+    // which must be called before the cache is shared between threads.
+    // It is made of "numaNodesCount_" consecutive groups of shards.
+    std::vector<Shard*>  shards_;
+    size_t               maxSize_;
+    CachePolicy          policy_;
+    size_t               numaNodesCount_;
+    std::vector<size_t>  cpuToNumaNode_;
 
-    size_t currentSize_;
-    size_t maxSize_;
-    LeastRecentlyUsedIndex<std::string, StringValue*>  content_;
+    Shard& GetShard(size_t numaNode,
+                    const std::string& key) const;
 
-    void Recycle(size_t targetSize);
+    size_t GetCurrentNumaNode() const;
+
+    void ResetShards(size_t count,
+                     CachePolicy policy);
 
   public:
     MemoryStringCache();
@@ -90,26 +121,75 @@ namespace Orthanc
     
     void SetMaximumSize(size_t size);
 
+    // Number of shards per NUMA node
+    size_t GetNumberOfShards() const
+    {
+      return shards_.size() / numaNodesCount_;
+    }
+
+    // New in Orthanc 1.12.12. The cache is split into "count"
+    // independent LRU shards, each of them having its own mutex and
+    // an equal fraction of the maximum size: This prevents concurrent
+    // cache hits from being serialized by one single mutex. Items
+    // that are larger than the size of one shard are never cached.
+    void SetNumberOfShards(size_t count);
+
+    CachePolicy GetPolicy() const
+    {
+      return policy_;
+    }
+
+    // New in Orthanc 1.12.12. Like "SetNumberOfShards()", this
+    // discards the content of the cache, and must be called before
+    // the cache is shared between threads.
+    void SetPolicy(CachePolicy policy);
+
+    size_t GetNumaNodesCount() const
+    {
+      return numaNodesCount_;
+    }
+
+    // New in Orthanc 1.12.12. On a NUMA system, this creates one
+    // group of shards per NUMA node, the maximum size being split
+    // between the nodes. An accessor uses the group of the node that
+    // runs the thread creating it: The memory of the cached items is
+    // thus local to the threads using them (provided that the threads
+    // are pinned to a node), at the price of possibly caching the
+    // same item once per node. Like "SetNumberOfShards()", this
+    // discards the content of the cache, and must be called before
+    // the cache is shared between threads.
+    void SetNumaAware(bool numaAware);
+
     void Invalidate(const std::string& key);
 
     size_t GetCurrentSize() const;
     
     size_t GetNumberOfItems() const;
 
+    // New in Orthanc 1.12.12. The load time is measured between a
+    // cache miss and the call to "Add()" by the same accessor.
+    void GetStatistics(CacheStatistics& target) const;
+
   private:
-    void Add(const std::string& key,
+    void Add(size_t numaNode,
+             const std::string& key,
              const std::string& value);
 
-    void Add(const std::string& key,
+    void Add(size_t numaNode,
+             const std::string& key,
              const void* buffer,
              size_t size);
 
-    bool Fetch(std::string& value,
-               const std::string& key);
+    bool Fetch(size_t numaNode,
+               std::string& value,
+               const std::string& key,
+               bool admission);
 
-    void RemoveFromItemsBeingLoaded(const std::string& key);
-    void RemoveFromItemsBeingLoadedInternal(const std::string& key);
+    void RemoveFromItemsBeingLoaded(size_t numaNode,
+                                    const std::string& key);
 
-    void AddToItemsBeingLoadedInternal(const std::string& key);
+    void AddLoad(size_t numaNode,
+                 const std::string& key,
+                 uint64_t microseconds);
   };
 }
@@ -25,6 +25,7 @@
 #include "../PrecompiledHeaders.h"
 #include "SharedArchive.h"
 
+#include "ICacheable.h"
 #include "../Toolbox.h"
 
 
@@ -39,7 +40,10 @@ namespace Orthanc
 
     if (it != archive_.end())
     {
-      delete it->second;
+      assert(memoryUsage_ >= it->second.memoryUsage_);
+      memoryUsage_ -= it->second.memoryUsage_;
+
+      delete it->second.object_;
       archive_.erase(it);
 
       lru_.Invalidate(id);
@@ -47,14 +51,67 @@ namespace Orthanc
   }
 
 
+  bool SharedArchive::IsExpired(const Item& item,
+                                const boost::posix_time::ptime& now) const
+  {
+    return (timeToLive_ != 0 &&
+            (now - item.creation_).total_seconds() >= static_cast<long>(timeToLive_));
+  }
+
+
+  void SharedArchive::PurgeInternal(const std::string& keep)
+  {
+    // This function assumes that "mutex_" is locked by a WriterLock,
+    // and that "lruMutex_" is locked
+
+    if (timeToLive_ != 0)
+    {
+      const boost::posix_time::ptime now = boost::posix_time::second_clock::universal_time();
+
+      std::vector<std::string> expired;
+      for (Archive::const_iterator it = archive_.begin(); it != archive_.end(); ++it)
+      {
+        if (it->first != keep &&
+            IsExpired(it->second, now))
+        {
+          expired.push_back(it->first);
+        }
+      }
+
+      for (size_t i = 0; i < expired.size(); i++)
+      {
+        RemoveInternal(expired[i]);
+        statistics_.AddEviction();
+      }
+    }
+
+    // Never evict the object that was just added, nor the last
+    // object, even if it is larger than the memory quota on its own
+    while (!lru_.IsEmpty() &&
+           lru_.GetOldest() != keep &&
+           (archive_.size() > maxSize_ ||
+            (maxMemoryUsage_ != 0 && memoryUsage_ > maxMemoryUsage_ && archive_.size() > 1)))
+    {
+      RemoveInternal(lru_.GetOldest());
+      statistics_.AddEviction();
+    }
+  }
+
+
   SharedArchive::Accessor::Accessor(SharedArchive& that,
                                     const std::string& id) :
     lock_(that.mutex_)
   {
     Archive::iterator it = that.archive_.find(id);
 
-    if (it == that.archive_.end())
+    if (it == that.archive_.end() ||
+        that.IsExpired(it->second, boost::posix_time::second_clock::universal_time()))
     {
+      {
+        boost::mutex::scoped_lock lock(that.lruMutex_);
+        that.statistics_.AddMiss();
+      }
+
       item_ = NULL;
     }
     else
@@ -62,9 +119,10 @@ namespace Orthanc
       {
         boost::mutex::scoped_lock lock(that.lruMutex_);
         that.lru_.MakeMostRecent(id);
+        that.statistics_.AddHit();
       }
 
-      item_ = it->second;
+      item_ = it->second.object_;
     }
   }
 
@@ -89,7 +147,10 @@ namespace Orthanc
 
 
   SharedArchive::SharedArchive(size_t maxSize) : 
-    maxSize_(maxSize)
+    maxSize_(maxSize),
+    maxMemoryUsage_(0),
+    timeToLive_(0),
+    memoryUsage_(0)
   {
     if (maxSize == 0)
     {
@@ -103,28 +164,39 @@ namespace Orthanc
     for (Archive::iterator it = archive_.begin();
          it != archive_.end(); ++it)
     {
-      delete it->second;
+      delete it->second.object_;
     }
   }
 
 
   std::string SharedArchive::Add(IDynamicObject* obj)
   {
-    WriterLock lock(mutex_);
-    boost::mutex::scoped_lock lruLock(lruMutex_);
-
-    if (archive_.size() == maxSize_)
+    if (obj == NULL)
     {
-      // The quota has been reached, remove the oldest element
-      RemoveInternal(lru_.GetOldest());
+      throw OrthancException(ErrorCode_NullPointer);
     }
 
+    Item item;
+    item.object_ = obj;
+    item.creation_ = boost::posix_time::second_clock::universal_time();
+
+    // The memory usage is evaluated outside of the mutexes
+    const ICacheable* cacheable = dynamic_cast<const ICacheable*>(obj);
+    item.memoryUsage_ = (cacheable == NULL ? 0 : cacheable->GetMemoryUsage());
+
+    WriterLock lock(mutex_);
+    boost::mutex::scoped_lock lruLock(lruMutex_);
+
     std::string id = Toolbox::GenerateUuid();
     RemoveInternal(id);  // Should never be useful because of UUID
 
-    archive_[id] = obj;
+    archive_[id] = item;
+    memoryUsage_ += item.memoryUsage_;
     lru_.Add(id);
 
+    // Remove the oldest elements if the quotas have been reached
+    PurgeInternal(id);
+
     return id;
   }
 
@@ -140,6 +212,8 @@ namespace Orthanc
 
   void SharedArchive::List(std::list<std::string>& items)
   {
+    RemoveExpired();
+
     items.clear();
 
     {
@@ -152,4 +226,89 @@ namespace Orthanc
       }
     }
   }
+
+
+  size_t SharedArchive::GetNumberOfItems()
+  {
+    ReaderLock lock(mutex_);
+    return archive_.size();
+  }
+
+
+  size_t SharedArchive::GetMaximumSize()
+  {
+    ReaderLock lock(mutex_);  // "maxSize_" is only modified with a writer lock
+    return maxSize_;
+  }
+
+
+  void SharedArchive::SetMaximumSize(size_t size)
+  {
+    if (size == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    WriterLock lock(mutex_);
+    boost::mutex::scoped_lock lruLock(lruMutex_);
+
+    maxSize_ = size;
+    PurgeInternal("");
+  }
+
+
+  size_t SharedArchive::GetMemoryUsage()
+  {
+    ReaderLock lock(mutex_);
+    return memoryUsage_;
+  }
+
+
+  size_t SharedArchive::GetMaximumMemoryUsage()
+  {
+    ReaderLock lock(mutex_);
+    return maxMemoryUsage_;
+  }
+
+
+  void SharedArchive::SetMaximumMemoryUsage(size_t size)
+  {
+    WriterLock lock(mutex_);
+    boost::mutex::scoped_lock lruLock(lruMutex_);
+
+    maxMemoryUsage_ = size;
+    PurgeInternal("");
+  }
+
+
+  unsigned int SharedArchive::GetTimeToLive()
+  {
+    ReaderLock lock(mutex_);
+    return timeToLive_;
+  }
+
+
+  void SharedArchive::SetTimeToLive(unsigned int seconds)
+  {
+    WriterLock lock(mutex_);
+    boost::mutex::scoped_lock lruLock(lruMutex_);
+
+    timeToLive_ = seconds;
+    PurgeInternal("");
+  }
+
+
+  void SharedArchive::RemoveExpired()
+  {
+    WriterLock lock(mutex_);
+    boost::mutex::scoped_lock lruLock(lruMutex_);
+    PurgeInternal("");
+  }
+
+
+  void SharedArchive::GetStatistics(CacheStatistics& target)
+  {
+    boost::mutex::scoped_lock lruLock(lruMutex_);
+    target = statistics_;
+  }
 }
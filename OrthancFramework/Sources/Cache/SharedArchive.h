@@ -32,31 +32,57 @@
 #  error The class SharedArchive cannot be used in sandboxed environments
 #endif
 
+#include "CacheStatistics.h"
 #include "LeastRecentlyUsedIndex.h"
 #include "../IDynamicObject.h"
 
 #include <map>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/thread.hpp>
 
 namespace Orthanc
 {
+  /**
+   * Since Orthanc 1.12.12, the objects that also derive from
+   * "ICacheable" are accounted for their memory usage, which is
+   * evaluated once they are added to the archive. The archive can
+   * then be limited by its total memory usage and by the age of its
+   * objects, on top of its number of objects.
+   **/
   class ORTHANC_PUBLIC SharedArchive : public boost::noncopyable
   {
   private:
-    typedef std::map<std::string, IDynamicObject*>  Archive;
+    struct Item
+    {
+      IDynamicObject*           object_;
+      size_t                    memoryUsage_;
+      boost::posix_time::ptime  creation_;
+    };
+
+    typedef std::map<std::string, Item>  Archive;
     typedef boost::shared_lock<boost::shared_mutex> ReaderLock;
     typedef boost::unique_lock<boost::shared_mutex> WriterLock;
 
     size_t                  maxSize_;
+    size_t                  maxMemoryUsage_;  // In bytes, "0" means no limit
+    unsigned int            timeToLive_;      // In seconds, "0" means no expiration
+    size_t                  memoryUsage_;
     boost::shared_mutex     mutex_;
     Archive                 archive_;
 
-    // The LRU index is not protected by "mutex_", but by "lruMutex_"
+    // The LRU index and the statistics are not protected by
+    // "mutex_", but by "lruMutex_"
     boost::mutex                        lruMutex_;
     LeastRecentlyUsedIndex<std::string> lru_;
+    CacheStatistics                     statistics_;
 
     void RemoveInternal(const std::string& id);
 
+    bool IsExpired(const Item& item,
+                   const boost::posix_time::ptime& now) const;
+
+    void PurgeInternal(const std::string& keep);
+
   public:
     class ORTHANC_PUBLIC Accessor : public boost::noncopyable
     {
@@ -82,5 +108,36 @@ namespace Orthanc
     void Remove(const std::string& id);
 
     void List(std::list<std::string>& items);
+
+    size_t GetNumberOfItems();
+
+    // The maximum size is expressed as a number of items. The oldest
+    // items are removed if the archive shrinks (new in Orthanc 1.12.12).
+    size_t GetMaximumSize();
+
+    void SetMaximumSize(size_t size);
+
+    // The total memory usage of the objects, in bytes. The oldest
+    // items are removed if the quota is exceeded, except the most
+    // recent one. A value of "0" indicates no limit (new in Orthanc
+    // 1.12.12).
+    size_t GetMemoryUsage();
+
+    size_t GetMaximumMemoryUsage();
+
+    void SetMaximumMemoryUsage(size_t size);
+
+    // Number of seconds after which an object is removed, even if the
+    // quotas are not reached. A value of "0" indicates that the
+    // objects never expire (new in Orthanc 1.12.12).
+    unsigned int GetTimeToLive();
+
+    void SetTimeToLive(unsigned int seconds);
+
+    // Removes the expired objects (new in Orthanc 1.12.12)
+    void RemoveExpired();
+
+    // Only the hits, the misses and the evictions are tracked
+    void GetStatistics(CacheStatistics& target);
   };
 }
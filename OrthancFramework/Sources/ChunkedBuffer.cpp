@@ -29,20 +29,119 @@
 
 #include <cassert>
 #include <string.h>
+#include <vector>
+
+#if ORTHANC_SANDBOXED != 1
+#  include <boost/thread/mutex.hpp>
+#endif
 
 
 namespace Orthanc
 {
+  namespace
+  {
+    /**
+     * Global pool of the unused chunks of "POOLED_CHUNK_SIZE" bytes
+     * (new in Orthanc 1.12.12), in order not to go through "malloc()"
+     * for each chunk of each buffer.
+     **/
+    class ChunksPool : public boost::noncopyable
+    {
+    private:
+      // Bounds the memory that is retained by the pool to 4MB
+      static const size_t MAXIMUM_COUNT = 256;
+
+#if ORTHANC_SANDBOXED != 1
+      boost::mutex              mutex_;
+#endif
+      std::vector<std::string>  unused_;
+
+    public:
+      ChunksPool()
+      {
+        unused_.reserve(MAXIMUM_COUNT);
+      }
+
+      // Replaces the content of "target" by a chunk of "POOLED_CHUNK_SIZE" bytes
+      void Acquire(std::string& target)
+      {
+        {
+#if ORTHANC_SANDBOXED != 1
+          boost::mutex::scoped_lock lock(mutex_);
+#endif
+
+          if (!unused_.empty())
+          {
+            target.swap(unused_.back());
+            unused_.pop_back();
+            return;
+          }
+        }
+
+        try
+        {
+          std::string chunk;
+          chunk.resize(ChunkedBuffer::POOLED_CHUNK_SIZE);
+          target.swap(chunk);
+        }
+        catch (...)
+        {
+          throw OrthancException(ErrorCode_NotEnoughMemory);
+        }
+      }
+
+      // The content of "chunk" is undefined after this call
+      void Release(std::string& chunk)
+      {
+        if (chunk.size() == ChunkedBuffer::POOLED_CHUNK_SIZE &&
+            chunk.capacity() < 2 * ChunkedBuffer::POOLED_CHUNK_SIZE)
+        {
+#if ORTHANC_SANDBOXED != 1
+          boost::mutex::scoped_lock lock(mutex_);
+#endif
+
+          if (unused_.size() < MAXIMUM_COUNT)
+          {
+            unused_.push_back(std::string());
+            unused_.back().swap(chunk);
+          }
+        }
+      }
+
+      size_t GetCount()
+      {
+#if ORTHANC_SANDBOXED != 1
+        boost::mutex::scoped_lock lock(mutex_);
+#endif
+        return unused_.size();
+      }
+    };
+
+
+    // This object is never destroyed, as some buffers might be
+    // released during the destruction of the static objects
+    ChunksPool& GetChunksPool()
+    {
+      static ChunksPool* pool = new ChunksPool;
+      return *pool;
+    }
+  }
+
+
   void ChunkedBuffer::Clear()
   {
     numBytes_ = 0;
     pendingPos_ = 0;
 
+    ChunksPool& pool = GetChunksPool();
+
     for (Chunks::iterator it = chunks_.begin(); 
          it != chunks_.end(); ++it)
     {
-      delete *it;
+      pool.Release(*it);
     }
+
+    chunks_.clear();
   }
 
 
@@ -59,7 +158,8 @@ namespace Orthanc
 
       try
       {
-        chunks_.push_back(new std::string(reinterpret_cast<const char*>(chunkData), chunkSize));
+        chunks_.push_back(std::string());
+        chunks_.back().assign(reinterpret_cast<const char*>(chunkData), chunkSize);
       }
       catch (...)
       {
@@ -75,7 +175,27 @@ namespace Orthanc
   {
     assert(pendingPos_ <= pendingBuffer_.size());
     
-    if (!pendingBuffer_.empty())
+    if (pendingPos_ == POOLED_CHUNK_SIZE &&
+        pendingBuffer_.size() == POOLED_CHUNK_SIZE)
+    {
+      // The pending buffer is a full chunk: Move it at the end of the
+      // list without copying it, and get a new chunk from the pool
+      try
+      {
+        chunks_.push_back(std::string());
+      }
+      catch (...)
+      {
+        throw OrthancException(ErrorCode_NotEnoughMemory);
+      }
+
+      chunks_.back().swap(pendingBuffer_);
+      numBytes_ += POOLED_CHUNK_SIZE;
+      pendingPos_ = 0;
+
+      GetChunksPool().Acquire(pendingBuffer_);
+    }
+    else if (!pendingBuffer_.empty())
     {
       AddChunkInternal(pendingBuffer_.c_str(), pendingPos_);
     }
@@ -92,13 +212,15 @@ namespace Orthanc
     numBytes_(0),
     pendingPos_(0)
   {
-    pendingBuffer_.resize(static_cast<size_t>(16) * 1024);  // Default size of the pending buffer: 16KB
+    // Default size of the pending buffer: 16KB
+    GetChunksPool().Acquire(pendingBuffer_);
   }
 
 
   ChunkedBuffer::~ChunkedBuffer()
   {
     Clear();
+    GetChunksPool().Release(pendingBuffer_);
   }
 
 
@@ -126,11 +248,38 @@ namespace Orthanc
   {
     if (chunkSize > 0)
     {
-#if 1
       assert(sizeof(char) == 1);
-      
+
+      if (pendingBuffer_.size() == POOLED_CHUNK_SIZE)
+      {
+        // Optimization if Orthanc >= 1.12.12: Fill the fixed-size
+        // chunks, that are moved to the list once full
+        const char* source = reinterpret_cast<const char*>(chunkData);
+
+        while (chunkSize > 0)
+        {
+          assert(pendingPos_ < POOLED_CHUNK_SIZE);
+
+          size_t s = POOLED_CHUNK_SIZE - pendingPos_;
+          if (s > chunkSize)
+          {
+            s = chunkSize;
+          }
+
+          memcpy(&pendingBuffer_[pendingPos_], source, s);
+          pendingPos_ += s;
+          source += s;
+          chunkSize -= s;
+
+          if (pendingPos_ == POOLED_CHUNK_SIZE)
+          {
+            FlushPendingBuffer();
+          }
+        }
+      }
+#if 1
       // Optimization if Orthanc >= 1.7.3, to speed up in the presence of many small chunks
-      if (pendingPos_ + chunkSize <= pendingBuffer_.size())
+      else if (pendingPos_ + chunkSize <= pendingBuffer_.size())
       {
         // There remains enough place in the pending buffer
         memcpy(&pendingBuffer_[pendingPos_], chunkData, chunkSize);
@@ -152,8 +301,11 @@ namespace Orthanc
         }
       }
 #else
-      // Non-optimized implementation in Orthanc <= 1.7.2
-      AddChunkInternal(chunkData, chunkSize);
+      else
+      {
+        // Non-optimized implementation in Orthanc <= 1.7.2
+        AddChunkInternal(chunkData, chunkSize);
+      }
 #endif
     }
   }
@@ -196,15 +348,13 @@ namespace Orthanc
     else if (chunks_.size() == 1)
     {
       // Avoid reallocating a buffer if there is a single chunk
-      assert(chunks_.front() != NULL);
-      if (chunks_.front()->size() != numBytes_)
+      if (chunks_.front().size() != numBytes_)
       {
         THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
       }
       else
       {
-        chunks_.front()->swap(result);
-        delete chunks_.front();
+        chunks_.front().swap(result);
       }
     }
     else
@@ -219,24 +369,43 @@ namespace Orthanc
       }
 
       size_t pos = 0;
-      for (Chunks::iterator it = chunks_.begin();
+      for (Chunks::const_iterator it = chunks_.begin();
            it != chunks_.end(); ++it)
       {
-        assert(*it != NULL);
-
-        size_t s = (*it)->size();
+        size_t s = it->size();
         if (s != 0)
         {
-          memcpy(&result[pos], (*it)->c_str(), s);
+          memcpy(&result[pos], it->c_str(), s);
           pos += s;
         }
+      }
+    }
+
+    // Reset the data structure, and give the chunks back to the pool
+    Clear();
+  }
+
 
-        delete *it;
+  void ChunkedBuffer::Visit(IVisitor& visitor) const
+  {
+    for (Chunks::const_iterator it = chunks_.begin();
+         it != chunks_.end(); ++it)
+    {
+      if (!it->empty())
+      {
+        visitor.VisitChunk(it->c_str(), it->size());
       }
     }
 
-    // Reset the data structure
-    chunks_.clear();
-    numBytes_ = 0;
+    if (pendingPos_ > 0)
+    {
+      visitor.VisitChunk(pendingBuffer_.c_str(), pendingPos_);
+    }
+  }
+
+
+  size_t ChunkedBuffer::GetPooledChunksCount()
+  {
+    return GetChunksPool().GetCount();
   }
 }
@@ -34,8 +34,34 @@ namespace Orthanc
 {
   class ORTHANC_PUBLIC ChunkedBuffer : public boost::noncopyable
   {
+  public:
+    /**
+     * Scatter-gather access to the content of the buffer, without
+     * flattening it into one contiguous memory block (new in Orthanc
+     * 1.12.12). The pointers are only valid during the call.
+     **/
+    class ORTHANC_PUBLIC IVisitor : public boost::noncopyable
+    {
+    public:
+      virtual ~IVisitor()
+      {
+      }
+
+      virtual void VisitChunk(const void* data,
+                              size_t size) = 0;
+    };
+
+    /**
+     * In Orthanc >= 1.12.12, if the pending buffer has its default
+     * size, the content is stored as chunks of this fixed size, that
+     * are recycled by a global pool once released. The data is only
+     * copied once into the chunks, and the large buffers never need
+     * one contiguous memory block, unless they are flattened.
+     **/
+    static const size_t POOLED_CHUNK_SIZE = 16 * 1024;
+
   private:
-    typedef std::list<std::string*>  Chunks;
+    typedef std::list<std::string>  Chunks;
     
     size_t       numBytes_;
     Chunks       chunks_;
@@ -69,5 +95,11 @@ namespace Orthanc
                   const std::string::const_iterator& end);
 
     void Flatten(std::string& result);
+
+    // The chunks are visited in order, and the buffer is not modified
+    void Visit(IVisitor& visitor) const;
+
+    // Number of unused chunks that are kept by the global pool
+    static size_t GetPooledChunksCount();
   };
 }
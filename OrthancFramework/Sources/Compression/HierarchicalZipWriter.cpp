@@ -132,9 +132,36 @@ namespace Orthanc
   }
 
 
+  HierarchicalZipWriter::HierarchicalZipWriter(TarWriter* tar) :
+    tar_(tar)
+  {
+    if (tar == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+  }
+
+
   HierarchicalZipWriter::~HierarchicalZipWriter()
   {
-    writer_.Close();
+    if (tar_.get() == NULL)
+    {
+      writer_.Close();
+    }
+  }
+
+
+  std::string HierarchicalZipWriter::OpenFileInIndex(const std::string& name)
+  {
+    std::string p = indexer_.OpenFile(name, IsAllowUtf8());
+
+    if (tar_.get() != NULL)
+    {
+      // Same normalization as in "ZipWriter::OpenFile()"
+      p = Toolbox::NormalizePath(p, IsAllowUtf8(), true /* allow slashes, necessary for subdirectories */);
+    }
+
+    return p;
   }
 
   void HierarchicalZipWriter::SetZip64(bool isZip64)
@@ -157,6 +184,11 @@ namespace Orthanc
     return writer_.GetCompressionLevel();
   }
 
+  void HierarchicalZipWriter::SetCompressionThreads(unsigned int threads)
+  {
+    writer_.SetCompressionThreads(threads);
+  }
+
   void HierarchicalZipWriter::SetAppendToExisting(bool append)
   {
     writer_.SetAppendToExisting(append);
@@ -169,8 +201,38 @@ namespace Orthanc
 
   void HierarchicalZipWriter::OpenFile(const std::string& name)
   {
-    std::string p = indexer_.OpenFile(name, IsAllowUtf8());
-    writer_.OpenFile(p.c_str());
+    OpenFile(name, true);
+  }
+
+  void HierarchicalZipWriter::OpenFile(const std::string& name,
+                                       bool compress)
+  {
+    std::string p = OpenFileInIndex(name);
+
+    if (tar_.get() != NULL)
+    {
+      tar_->OpenFile(p);
+    }
+    else
+    {
+      writer_.OpenFile(p.c_str(), compress);
+    }
+  }
+
+  void HierarchicalZipWriter::OpenStreamedFile(const std::string& name,
+                                               bool compress,
+                                               uint64_t size)
+  {
+    std::string p = OpenFileInIndex(name);
+
+    if (tar_.get() != NULL)
+    {
+      tar_->OpenFile(p, size);
+    }
+    else
+    {
+      writer_.OpenStreamedFile(p.c_str(), compress);
+    }
   }
 
   void HierarchicalZipWriter::OpenDirectory(const std::string& name)
@@ -191,12 +253,26 @@ namespace Orthanc
   void HierarchicalZipWriter::Write(const void *data,
                                     size_t length)
   {
-    writer_.Write(data, length);
+    if (tar_.get() != NULL)
+    {
+      tar_->Write(data, length);
+    }
+    else
+    {
+      writer_.Write(data, length);
+    }
   }
 
   void HierarchicalZipWriter::Write(const std::string& data)
   {
-    writer_.Write(data);
+    if (tar_.get() != NULL)
+    {
+      tar_->Write(data);
+    }
+    else
+    {
+      writer_.Write(data);
+    }
   }
 
   HierarchicalZipWriter* HierarchicalZipWriter::CreateToMemory(std::string& target,
@@ -207,16 +283,37 @@ namespace Orthanc
 
   void HierarchicalZipWriter::CancelStream()
   {
-    writer_.CancelStream();
+    if (tar_.get() != NULL)
+    {
+      tar_->CancelStream();
+    }
+    else
+    {
+      writer_.CancelStream();
+    }
   }
 
   void HierarchicalZipWriter::Close()
   {
-    writer_.Close();
+    if (tar_.get() != NULL)
+    {
+      tar_->Close();
+    }
+    else
+    {
+      writer_.Close();
+    }
   }
 
   uint64_t HierarchicalZipWriter::GetArchiveSize() const
   {
-    return writer_.GetArchiveSize();
+    if (tar_.get() != NULL)
+    {
+      return tar_->GetArchiveSize();
+    }
+    else
+    {
+      return writer_.GetArchiveSize();
+    }
   }
 }
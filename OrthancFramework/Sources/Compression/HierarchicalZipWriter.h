@@ -24,6 +24,7 @@
 
 #pragma once
 
+#include "TarWriter.h"
 #include "ZipWriter.h"
 
 #include <map>
@@ -42,7 +43,9 @@ namespace Orthanc
     FRIEND_TEST(HierarchicalZipWriter, Index);
 #endif
 
-  private:
+  public:
+    // Public since Orthanc 1.12.12, in order to compute the filenames
+    // of the entries without writing the archive
     class ORTHANC_PUBLIC Index
     {
     private:
@@ -79,8 +82,12 @@ namespace Orthanc
       std::string GetCurrentDirectoryPath() const;
     };
 
+  private:
     Index indexer_;
     ZipWriter writer_;
+    std::unique_ptr<TarWriter> tar_;  // If not NULL, replaces "writer_" (new in Orthanc 1.12.12)
+
+    std::string OpenFileInIndex(const std::string& name);
 
   public:
     explicit HierarchicalZipWriter(const boost::filesystem::path& path);
@@ -88,8 +95,17 @@ namespace Orthanc
     HierarchicalZipWriter(ZipWriter::IOutputStream* stream,  // transfers ownership
                           bool isZip64);
 
+    // Writes an uncompressed TAR archive instead of a ZIP archive. The
+    // options that are specific to ZIP are ignored (new in Orthanc 1.12.12).
+    explicit HierarchicalZipWriter(TarWriter* tar);  // transfers ownership
+
     ~HierarchicalZipWriter();
 
+    bool IsTar() const
+    {
+      return tar_.get() != NULL;
+    }
+
     void SetZip64(bool isZip64);
 
     bool IsZip64() const;
@@ -108,12 +124,27 @@ namespace Orthanc
 
     uint8_t GetCompressionLevel() const;
 
+    void SetCompressionThreads(unsigned int threads);
+
+    unsigned int GetCompressionThreads() const
+    {
+      return writer_.GetCompressionThreads();
+    }
+
     void SetAppendToExisting(bool append);
     
     bool IsAppendToExisting() const;
     
     void OpenFile(const std::string& name);
 
+    void OpenFile(const std::string& name,
+                  bool compress);
+
+    // The size of the file is only needed by TAR archives
+    void OpenStreamedFile(const std::string& name,
+                          bool compress,
+                          uint64_t size);
+
     void OpenDirectory(const std::string& name);
 
     void CloseDirectory();
@@ -25,6 +25,17 @@
 #include "../PrecompiledHeaders.h"
 #include "IBufferCompressor.h"
 
+#include "../OrthancException.h"
+#include "ZlibCompressor.h"
+
+#if ORTHANC_ENABLE_ZSTD == 1
+#  include "ZstdCompressor.h"
+#endif
+
+#if ORTHANC_ENABLE_LZ4 == 1
+#  include "Lz4Compressor.h"
+#endif
+
 
 namespace Orthanc
 {
@@ -45,4 +56,31 @@ namespace Orthanc
                           compressed.size() == 0 ? NULL : compressed.c_str(), 
                           compressed.size());
   }
+
+
+  IBufferCompressor* IBufferCompressor::Create(CompressionType compression)
+  {
+    switch (compression)
+    {
+      case CompressionType_ZlibWithSize:
+        return new ZlibCompressor;  // Prefixed with the uncompressed size by default
+
+      case CompressionType_ZstdWithSize:
+#if ORTHANC_ENABLE_ZSTD == 1
+        return new ZstdCompressor;
+#else
+        throw OrthancException(ErrorCode_NotImplemented, "This version of Orthanc was built without support for zstd");
+#endif
+
+      case CompressionType_Lz4WithSize:
+#if ORTHANC_ENABLE_LZ4 == 1
+        return new Lz4Compressor;
+#else
+        throw OrthancException(ErrorCode_NotImplemented, "This version of Orthanc was built without support for LZ4");
+#endif
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
 }
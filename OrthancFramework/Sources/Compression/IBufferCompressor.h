@@ -24,6 +24,7 @@
 
 #pragma once
 
+#include "../Enumerations.h"
 #include "../OrthancFramework.h"
 
 #include <string>
@@ -53,5 +54,10 @@ namespace Orthanc
     static void Uncompress(std::string& uncompressed,
                            IBufferCompressor& compressor,
                            const std::string& compressed);
+
+    // Creates the compressor that implements one of the compression
+    // types of the attachments. Throws "ErrorCode_NotImplemented" if
+    // Orthanc was built without support for this compression type.
+    static IBufferCompressor* Create(CompressionType compression);
   };
 }
@@ -0,0 +1,125 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "Lz4Compressor.h"
+
+#include "../Endianness.h"
+#include "../OrthancException.h"
+
+#include <limits>
+#include <string.h>
+#include <lz4.h>
+
+namespace Orthanc
+{
+  void Lz4Compressor::Compress(std::string& compressed,
+                               const void* uncompressed,
+                               size_t uncompressedSize)
+  {
+    if (uncompressedSize == 0)
+    {
+      compressed.clear();
+      return;
+    }
+
+    // The LZ4 block format is limited to about 2GB
+    if (uncompressedSize > static_cast<size_t>(LZ4_MAX_INPUT_SIZE))
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory, "Buffer is too large for LZ4 compression");
+    }
+
+    const int bound = LZ4_compressBound(static_cast<int>(uncompressedSize));
+    compressed.resize(sizeof(uint64_t) + static_cast<size_t>(bound));
+
+    const int compressedSize = LZ4_compress_default(reinterpret_cast<const char*>(uncompressed),
+                                                    &compressed[sizeof(uint64_t)],
+                                                    static_cast<int>(uncompressedSize), bound);
+
+    if (compressedSize <= 0)
+    {
+      compressed.clear();
+      throw OrthancException(ErrorCode_InternalError, "Error in LZ4 compression");
+    }
+
+    // Explicitly use litte-endian encoding in size prefix
+    const uint64_t s = htole64(static_cast<uint64_t>(uncompressedSize));
+    memcpy(&compressed[0], &s, sizeof(uint64_t));
+
+    compressed.resize(sizeof(uint64_t) + static_cast<size_t>(compressedSize));
+  }
+
+
+  void Lz4Compressor::Uncompress(std::string& uncompressed,
+                                 const void* compressed,
+                                 size_t compressedSize)
+  {
+    if (compressedSize == 0)
+    {
+      uncompressed.clear();
+      return;
+    }
+
+    if (compressedSize < sizeof(uint64_t))
+    {
+      throw OrthancException(ErrorCode_CorruptedFile, "The compressed buffer is ill-formed");
+    }
+
+    uint64_t uncompressedSize;
+    memcpy(&uncompressedSize, compressed, sizeof(uint64_t));
+    uncompressedSize = le64toh(uncompressedSize);
+
+    if (uncompressedSize > static_cast<uint64_t>(LZ4_MAX_INPUT_SIZE) ||
+        compressedSize - sizeof(uint64_t) > static_cast<size_t>(std::numeric_limits<int>::max()))
+    {
+      throw OrthancException(ErrorCode_CorruptedFile, "The compressed buffer is ill-formed");
+    }
+
+    try
+    {
+      uncompressed.resize(static_cast<size_t>(uncompressedSize));
+    }
+    catch (...)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    if (uncompressedSize == 0)
+    {
+      return;
+    }
+
+    const int size = LZ4_decompress_safe(reinterpret_cast<const char*>(compressed) + sizeof(uint64_t),
+                                         &uncompressed[0],
+                                         static_cast<int>(compressedSize - sizeof(uint64_t)),
+                                         static_cast<int>(uncompressedSize));
+
+    if (size < 0 ||
+        static_cast<uint64_t>(size) != uncompressedSize)
+    {
+      uncompressed.clear();
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+  }
+}
@@ -0,0 +1,56 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "IBufferCompressor.h"
+#include "../Compatibility.h"  // For ORTHANC_OVERRIDE
+
+#if !defined(ORTHANC_ENABLE_LZ4)
+#  error The macro ORTHANC_ENABLE_LZ4 must be defined
+#endif
+
+#if ORTHANC_ENABLE_LZ4 != 1
+#  error LZ4 support must be enabled to include this file
+#endif
+
+namespace Orthanc
+{
+  /**
+   * Compression using the LZ4 block format, in the format of
+   * "CompressionType_Lz4WithSize" (the LZ4 block is prefixed with
+   * the size of the uncompressed buffer). New in Orthanc 1.12.12.
+   **/
+  class ORTHANC_PUBLIC Lz4Compressor : public IBufferCompressor
+  {
+  public:
+    virtual void Compress(std::string& compressed,
+                          const void* uncompressed,
+                          size_t uncompressedSize) ORTHANC_OVERRIDE;
+
+    virtual void Uncompress(std::string& uncompressed,
+                            const void* compressed,
+                            size_t compressedSize) ORTHANC_OVERRIDE;
+  };
+}
@@ -0,0 +1,504 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "StoredZipLayout.h"
+
+#include "../OrthancException.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <zlib.h>
+
+
+namespace Orthanc
+{
+  // https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+  static const size_t   LOCAL_HEADER_SIZE = 30;
+  static const size_t   LOCAL_EXTRA_SIZE = 20;        // ZIP64 extended information
+  static const size_t   DATA_DESCRIPTOR_SIZE = 24;    // ZIP64 data descriptor
+  static const size_t   CENTRAL_HEADER_SIZE = 46;
+  static const size_t   CENTRAL_EXTRA_SIZE = 28;      // ZIP64 extended information
+  static const size_t   ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE = 56;
+  static const size_t   ZIP64_LOCATOR_SIZE = 20;
+  static const size_t   END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+  static const uint16_t VERSION_ZIP64 = 45;
+
+  static void WriteUInt16(std::string& target,
+                          uint16_t value)
+  {
+    target.push_back(static_cast<char>(value & 0xff));
+    target.push_back(static_cast<char>((value >> 8) & 0xff));
+  }
+
+  static void WriteUInt32(std::string& target,
+                          uint32_t value)
+  {
+    WriteUInt16(target, static_cast<uint16_t>(value & 0xffff));
+    WriteUInt16(target, static_cast<uint16_t>((value >> 16) & 0xffff));
+  }
+
+  static void WriteUInt64(std::string& target,
+                          uint64_t value)
+  {
+    WriteUInt32(target, static_cast<uint32_t>(value & 0xffffffffu));
+    WriteUInt32(target, static_cast<uint32_t>((value >> 32) & 0xffffffffu));
+  }
+
+
+  uint16_t StoredZipLayout::GetFlags() const
+  {
+    // Bit 3: CRC-32 in the data descriptor, bit 11: UTF-8 filenames
+    return (allowUtf8_ ? 0x0808 : 0x0008);
+  }
+
+
+  uint64_t StoredZipLayout::GetEntryEnd(size_t index) const
+  {
+    assert(index < entries_.size());
+
+    if (index + 1 == entries_.size())
+    {
+      return centralDirectoryOffset_;
+    }
+    else
+    {
+      return entries_[index + 1].offset_;
+    }
+  }
+
+
+  void StoredZipLayout::ComputeCrc32(size_t index,
+                                     const std::string& content,
+                                     IEntrySource& source)
+  {
+    assert(index < entries_.size());
+
+    if (!entries_[index].hasCrc32_)
+    {
+      uLong crc = crc32(0L, Z_NULL, 0);
+
+      const Bytef* p = reinterpret_cast<const Bytef*>(content.c_str());
+      size_t remaining = content.size();
+
+      while (remaining > 0)
+      {
+        const size_t block = std::min(remaining, static_cast<size_t>(std::numeric_limits<uInt>::max()));
+        crc = crc32(crc, p, static_cast<uInt>(block));
+        p += block;
+        remaining -= block;
+      }
+
+      SetCrc32(index, static_cast<uint32_t>(crc));
+      source.HandleCrc32(index, static_cast<uint32_t>(crc));
+    }
+  }
+
+
+  void StoredZipLayout::ReadEntryContent(std::string& content,
+                                         size_t index,
+                                         IEntrySource& source)
+  {
+    assert(index < entries_.size());
+
+    source.ReadEntry(content, index);
+
+    if (content.size() != entries_[index].size_)
+    {
+      // The size must match the layout, otherwise the archive is corrupted
+      throw OrthancException(ErrorCode_InternalError,
+                             "The size of a ZIP entry has changed since its layout was computed");
+    }
+
+    ComputeCrc32(index, content, source);
+  }
+
+
+  void StoredZipLayout::FormatLocalHeader(std::string& target,
+                                          size_t index) const
+  {
+    assert(index < entries_.size());
+    const Entry& entry = entries_[index];
+
+    target.clear();
+    target.reserve(LOCAL_HEADER_SIZE + entry.filename_.size() + LOCAL_EXTRA_SIZE);
+
+    WriteUInt32(target, 0x04034b50);  // Signature
+    WriteUInt16(target, VERSION_ZIP64);
+    WriteUInt16(target, GetFlags());
+    WriteUInt16(target, 0);  // Method: stored
+    WriteUInt16(target, dosTime_);
+    WriteUInt16(target, dosDate_);
+    WriteUInt32(target, 0);  // CRC-32, in the data descriptor
+    WriteUInt32(target, 0xffffffffu);  // Compressed size, in the ZIP64 extra field
+    WriteUInt32(target, 0xffffffffu);  // Uncompressed size, in the ZIP64 extra field
+    WriteUInt16(target, static_cast<uint16_t>(entry.filename_.size()));
+    WriteUInt16(target, LOCAL_EXTRA_SIZE);
+    target.append(entry.filename_);
+
+    WriteUInt16(target, 0x0001);  // ZIP64 extended information
+    WriteUInt16(target, 16);
+    WriteUInt64(target, entry.size_);  // Uncompressed size
+    WriteUInt64(target, entry.size_);  // Compressed size
+
+    assert(target.size() == LOCAL_HEADER_SIZE + entry.filename_.size() + LOCAL_EXTRA_SIZE);
+  }
+
+
+  void StoredZipLayout::FormatDataDescriptor(std::string& target,
+                                             size_t index) const
+  {
+    assert(index < entries_.size());
+    const Entry& entry = entries_[index];
+
+    if (!entry.hasCrc32_)
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    target.clear();
+    target.reserve(DATA_DESCRIPTOR_SIZE);
+
+    WriteUInt32(target, 0x08074b50);  // Signature
+    WriteUInt32(target, entry.crc32_);
+    WriteUInt64(target, entry.size_);  // Compressed size
+    WriteUInt64(target, entry.size_);  // Uncompressed size
+
+    assert(target.size() == DATA_DESCRIPTOR_SIZE);
+  }
+
+
+  void StoredZipLayout::FormatTail(std::string& target) const
+  {
+    target.clear();
+    target.reserve(centralDirectorySize_ + ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE +
+                   ZIP64_LOCATOR_SIZE + END_OF_CENTRAL_DIRECTORY_SIZE);
+
+    for (size_t i = 0; i < entries_.size(); i++)
+    {
+      const Entry& entry = entries_[i];
+
+      if (!entry.hasCrc32_)
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      WriteUInt32(target, 0x02014b50);  // Signature
+      WriteUInt16(target, VERSION_ZIP64);  // Version made by (MS-DOS)
+      WriteUInt16(target, VERSION_ZIP64);  // Version needed to extract
+      WriteUInt16(target, GetFlags());
+      WriteUInt16(target, 0);  // Method: stored
+      WriteUInt16(target, dosTime_);
+      WriteUInt16(target, dosDate_);
+      WriteUInt32(target, entry.crc32_);
+      WriteUInt32(target, 0xffffffffu);  // Compressed size, in the ZIP64 extra field
+      WriteUInt32(target, 0xffffffffu);  // Uncompressed size, in the ZIP64 extra field
+      WriteUInt16(target, static_cast<uint16_t>(entry.filename_.size()));
+      WriteUInt16(target, CENTRAL_EXTRA_SIZE);
+      WriteUInt16(target, 0);  // Comment length
+      WriteUInt16(target, 0);  // Disk number
+      WriteUInt16(target, 0);  // Internal attributes
+      WriteUInt32(target, 0);  // External attributes
+      WriteUInt32(target, 0xffffffffu);  // Offset of the local header, in the ZIP64 extra field
+      target.append(entry.filename_);
+
+      WriteUInt16(target, 0x0001);  // ZIP64 extended information
+      WriteUInt16(target, 24);
+      WriteUInt64(target, entry.size_);  // Uncompressed size
+      WriteUInt64(target, entry.size_);  // Compressed size
+      WriteUInt64(target, entry.offset_);
+    }
+
+    assert(target.size() == centralDirectorySize_);
+
+    const uint64_t zip64EndOffset = centralDirectoryOffset_ + centralDirectorySize_;
+
+    WriteUInt32(target, 0x06064b50);  // ZIP64 end of central directory record
+    WriteUInt64(target, ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE - 12);
+    WriteUInt16(target, VERSION_ZIP64);
+    WriteUInt16(target, VERSION_ZIP64);
+    WriteUInt32(target, 0);  // Number of this disk
+    WriteUInt32(target, 0);  // Disk of the central directory
+    WriteUInt64(target, entries_.size());
+    WriteUInt64(target, entries_.size());
+    WriteUInt64(target, centralDirectorySize_);
+    WriteUInt64(target, centralDirectoryOffset_);
+
+    WriteUInt32(target, 0x07064b50);  // ZIP64 end of central directory locator
+    WriteUInt32(target, 0);  // Disk of the ZIP64 end of central directory
+    WriteUInt64(target, zip64EndOffset);
+    WriteUInt32(target, 1);  // Total number of disks
+
+    WriteUInt32(target, 0x06054b50);  // End of central directory record
+    WriteUInt16(target, 0);
+    WriteUInt16(target, 0);
+    WriteUInt16(target, 0xffff);  // Number of entries, in the ZIP64 record
+    WriteUInt16(target, 0xffff);
+    WriteUInt32(target, 0xffffffffu);  // Size of the central directory, in the ZIP64 record
+    WriteUInt32(target, 0xffffffffu);  // Offset of the central directory, in the ZIP64 record
+    WriteUInt16(target, 0);  // Comment length
+
+    assert(target.size() == GetArchiveSize() - centralDirectoryOffset_);
+  }
+
+
+  void StoredZipLayout::ReadEntryChunk(std::string& target,
+                                       size_t index,
+                                       uint64_t start,
+                                       uint64_t end,
+                                       IEntrySource& source)
+  {
+    assert(index < entries_.size());
+    const Entry& entry = entries_[index];
+
+    // Offsets of the regions of the entry, relative to the archive
+    const uint64_t dataStart = entry.offset_ + LOCAL_HEADER_SIZE + entry.filename_.size() + LOCAL_EXTRA_SIZE;
+    const uint64_t dataEnd = dataStart + entry.size_;
+
+    assert(start >= entry.offset_ &&
+           start < end &&
+           end <= GetEntryEnd(index) &&
+           GetEntryEnd(index) == dataEnd + DATA_DESCRIPTOR_SIZE);
+
+    std::string content;
+    if ((start < dataEnd && end > dataStart) ||  // The chunk overlaps the content
+        (end > dataEnd && !entry.hasCrc32_))     // The data descriptor needs the CRC-32
+    {
+      ReadEntryContent(content, index, source);
+    }
+
+    target.clear();
+    target.reserve(static_cast<size_t>(end - start));
+
+    if (start < dataStart)
+    {
+      std::string header;
+      FormatLocalHeader(header, index);
+      target.append(header, static_cast<size_t>(start - entry.offset_),
+                    static_cast<size_t>(std::min(end, dataStart) - start));
+    }
+
+    if (start < dataEnd &&
+        end > dataStart)
+    {
+      const uint64_t from = std::max(start, dataStart);
+      const uint64_t to = std::min(end, dataEnd);
+      target.append(content, static_cast<size_t>(from - dataStart), static_cast<size_t>(to - from));
+    }
+
+    if (end > dataEnd)
+    {
+      std::string descriptor;
+      FormatDataDescriptor(descriptor, index);
+
+      const uint64_t from = std::max(start, dataEnd);
+      target.append(descriptor, static_cast<size_t>(from - dataEnd), static_cast<size_t>(end - from));
+    }
+
+    assert(target.size() == end - start);
+  }
+
+
+  StoredZipLayout::StoredZipLayout() :
+    allowUtf8_(false),
+    dosTime_(0),
+    dosDate_((1 << 5) | 1),  // January 1st, 1980
+    centralDirectoryOffset_(0),
+    centralDirectorySize_(0)
+  {
+  }
+
+
+  void StoredZipLayout::SetAllowUtf8(bool allowUtf8)
+  {
+    allowUtf8_ = allowUtf8;
+  }
+
+
+  void StoredZipLayout::SetTimestamp(const boost::posix_time::ptime& timestamp)
+  {
+    if (timestamp.is_special())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    const boost::gregorian::date date = timestamp.date();
+    const boost::posix_time::time_duration time = timestamp.time_of_day();
+
+    if (date.year() < 1980 ||
+        date.year() > 2107)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Date out of the range of the ZIP format");
+    }
+
+    // MS-DOS date and time formats
+    dosDate_ = static_cast<uint16_t>(((date.year() - 1980) << 9) | (date.month() << 5) | date.day());
+    dosTime_ = static_cast<uint16_t>((time.hours() << 11) | (time.minutes() << 5) | (time.seconds() / 2));
+  }
+
+
+  size_t StoredZipLayout::AddEntry(const std::string& filename,
+                                   uint64_t size)
+  {
+    if (filename.empty() ||
+        filename.size() > 0xffffu)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    Entry entry;
+    entry.filename_ = filename;
+    entry.size_ = size;
+    entry.offset_ = centralDirectoryOffset_;
+    entry.hasCrc32_ = false;
+    entry.crc32_ = 0;
+    entries_.push_back(entry);
+
+    centralDirectoryOffset_ += (LOCAL_HEADER_SIZE + filename.size() + LOCAL_EXTRA_SIZE +
+                                size + DATA_DESCRIPTOR_SIZE);
+    centralDirectorySize_ += CENTRAL_HEADER_SIZE + filename.size() + CENTRAL_EXTRA_SIZE;
+
+    return entries_.size() - 1;
+  }
+
+
+  const std::string& StoredZipLayout::GetEntryFilename(size_t index) const
+  {
+    if (index >= entries_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      return entries_[index].filename_;
+    }
+  }
+
+
+  uint64_t StoredZipLayout::GetEntrySize(size_t index) const
+  {
+    if (index >= entries_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      return entries_[index].size_;
+    }
+  }
+
+
+  void StoredZipLayout::SetCrc32(size_t index,
+                                 uint32_t crc32)
+  {
+    if (index >= entries_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      entries_[index].hasCrc32_ = true;
+      entries_[index].crc32_ = crc32;
+    }
+  }
+
+
+  bool StoredZipLayout::LookupCrc32(uint32_t& crc32,
+                                    size_t index) const
+  {
+    if (index >= entries_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else if (entries_[index].hasCrc32_)
+    {
+      crc32 = entries_[index].crc32_;
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  uint64_t StoredZipLayout::GetArchiveSize() const
+  {
+    return (centralDirectoryOffset_ + centralDirectorySize_ + ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE +
+            ZIP64_LOCATOR_SIZE + END_OF_CENTRAL_DIRECTORY_SIZE);
+  }
+
+
+  void StoredZipLayout::ReadChunk(std::string& target,
+                                  uint64_t start,
+                                  uint64_t end,
+                                  IEntrySource& source)
+  {
+    if (start >= end ||
+        end > GetArchiveSize())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (start < centralDirectoryOffset_)
+    {
+      // Look for the entry that contains the "start" offset
+      size_t low = 0;
+      size_t high = entries_.size();
+
+      while (high - low > 1)
+      {
+        const size_t middle = low + (high - low) / 2;
+        if (entries_[middle].offset_ <= start)
+        {
+          low = middle;
+        }
+        else
+        {
+          high = middle;
+        }
+      }
+
+      ReadEntryChunk(target, low, start, std::min(end, GetEntryEnd(low)), source);
+    }
+    else
+    {
+      // The central directory needs the CRC-32 of all the entries
+      for (size_t i = 0; i < entries_.size(); i++)
+      {
+        if (!entries_[i].hasCrc32_)
+        {
+          std::string content;
+          ReadEntryContent(content, i, source);
+        }
+      }
+
+      std::string tail;
+      FormatTail(tail);
+
+      target.assign(tail, static_cast<size_t>(start - centralDirectoryOffset_), static_cast<size_t>(end - start));
+    }
+  }
+}
@@ -0,0 +1,170 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#if !defined(ORTHANC_ENABLE_ZLIB)
+#  error The macro ORTHANC_ENABLE_ZLIB must be defined
+#endif
+
+#if ORTHANC_ENABLE_ZLIB != 1
+#  error ZLIB support must be enabled to include this file
+#endif
+
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/noncopyable.hpp>
+
+
+namespace Orthanc
+{
+  /**
+   * Layout of a ZIP64 archive whose entries are all stored without
+   * compression. As the size of the entries is known in advance, the
+   * size of the archive and the location of each of its bytes can be
+   * computed without reading the content of the entries. Any range of
+   * bytes of the archive can then be generated by reading only the
+   * entries that overlap this range, which allows to serve the
+   * "Range" HTTP requests and to resume the interrupted downloads.
+   *
+   * The CRC-32 of the entries are written in data descriptors after
+   * the content of the entries, and are computed on-the-fly. The
+   * central directory requires the CRC-32 of all the entries: The
+   * entries whose CRC-32 was not provided by "SetCrc32()" are read
+   * when the central directory is generated (new in Orthanc 1.12.12).
+   **/
+  class ORTHANC_PUBLIC StoredZipLayout : public boost::noncopyable
+  {
+  public:
+    class ORTHANC_PUBLIC IEntrySource : public boost::noncopyable
+    {
+    public:
+      virtual ~IEntrySource()
+      {
+      }
+
+      virtual void ReadEntry(std::string& content,
+                             size_t index) = 0;
+
+      // Notifies a CRC-32 that was computed by the layout, e.g. to
+      // cache it for subsequent requests
+      virtual void HandleCrc32(size_t index,
+                               uint32_t crc32) = 0;
+    };
+
+  private:
+    struct Entry
+    {
+      std::string  filename_;
+      uint64_t     size_;
+      uint64_t     offset_;   // Offset of the local file header
+      bool         hasCrc32_;
+      uint32_t     crc32_;
+    };
+
+    std::vector<Entry>  entries_;
+    bool                allowUtf8_;
+    uint16_t            dosTime_;
+    uint16_t            dosDate_;
+    uint64_t            centralDirectoryOffset_;
+    uint64_t            centralDirectorySize_;
+
+    uint16_t GetFlags() const;
+
+    uint64_t GetEntryEnd(size_t index) const;
+
+    void ComputeCrc32(size_t index,
+                      const std::string& content,
+                      IEntrySource& source);
+
+    void ReadEntryContent(std::string& content,
+                          size_t index,
+                          IEntrySource& source);
+
+    void FormatLocalHeader(std::string& target,
+                           size_t index) const;
+
+    void FormatDataDescriptor(std::string& target,
+                              size_t index) const;
+
+    void FormatTail(std::string& target) const;
+
+    void ReadEntryChunk(std::string& target,
+                        size_t index,
+                        uint64_t start,
+                        uint64_t end,
+                        IEntrySource& source);
+
+  public:
+    StoredZipLayout();
+
+    void SetAllowUtf8(bool allowUtf8);
+
+    bool IsAllowUtf8() const
+    {
+      return allowUtf8_;
+    }
+
+    // The timestamp of the entries, which must not change across
+    // requests for the archive to be byte-identical
+    void SetTimestamp(const boost::posix_time::ptime& timestamp);
+
+    // Returns the index of the new entry
+    size_t AddEntry(const std::string& filename,
+                    uint64_t size);
+
+    size_t GetEntriesCount() const
+    {
+      return entries_.size();
+    }
+
+    const std::string& GetEntryFilename(size_t index) const;
+
+    uint64_t GetEntrySize(size_t index) const;
+
+    void SetCrc32(size_t index,
+                  uint32_t crc32);
+
+    bool LookupCrc32(uint32_t& crc32,
+                     size_t index) const;
+
+    uint64_t GetArchiveSize() const;
+
+    /**
+     * Generates the bytes of the archive starting at "start", and
+     * ending at "end" (exclusive) at the latest. The chunk is possibly
+     * shorter, if "start" and "end" do not lie in the same entry: The
+     * caller must loop until the full range is generated.
+     **/
+    void ReadChunk(std::string& target,
+                   uint64_t start,
+                   uint64_t end,
+                   IEntrySource& source);
+  };
+}
@@ -0,0 +1,428 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "TarWriter.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+
+#include <boost/filesystem/fstream.hpp>
+#include <cassert>
+#include <ctime>
+#include <string.h>
+
+
+namespace Orthanc
+{
+  // https://www.gnu.org/software/tar/manual/html_node/Standard.html
+  static const size_t BLOCK_SIZE = 512;
+  static const size_t NAME_SIZE = 100;
+  static const size_t PREFIX_SIZE = 155;
+  static const size_t FLUSH_SIZE = 1024 * 1024;
+
+  static const char TYPE_REGULAR_FILE = '0';
+  static const char TYPE_GNU_LONG_NAME = 'L';
+
+
+  class TarWriter::FileStream : public ZipWriter::IOutputStream
+  {
+  private:
+    boost::filesystem::ofstream  file_;
+    uint64_t                     archiveSize_;
+
+  public:
+    explicit FileStream(const boost::filesystem::path& path) :
+      archiveSize_(0)
+    {
+      file_.open(path, std::ofstream::out | std::ofstream::binary);
+      if (!file_.good())
+      {
+        throw OrthancException(ErrorCode_CannotWriteFile, "Cannot create new TAR archive");
+      }
+    }
+
+    virtual void Write(const std::string& chunk) ORTHANC_OVERRIDE
+    {
+      if (!chunk.empty())
+      {
+        file_.write(chunk.c_str(), static_cast<std::streamsize>(chunk.size()));
+        if (!file_.good())
+        {
+          throw OrthancException(ErrorCode_CannotWriteFile);
+        }
+
+        archiveSize_ += chunk.size();
+      }
+    }
+
+    virtual void Close() ORTHANC_OVERRIDE
+    {
+      file_.close();
+    }
+
+    virtual uint64_t GetArchiveSize() const ORTHANC_OVERRIDE
+    {
+      return archiveSize_;
+    }
+  };
+
+
+  // Writes "value" as a NUL-terminated octal number in "field"
+  static bool FormatOctal(char* field,
+                          size_t fieldSize,
+                          uint64_t value)
+  {
+    assert(fieldSize >= 2);
+
+    field[fieldSize - 1] = '\0';
+
+    for (size_t i = fieldSize - 1; i > 0; i--)
+    {
+      field[i - 1] = static_cast<char>('0' + (value & 7));
+      value >>= 3;
+    }
+
+    return (value == 0);
+  }
+
+
+  static void FormatSize(char* field /* 12 bytes */,
+                         uint64_t size)
+  {
+    if (!FormatOctal(field, 12, size))
+    {
+      // GNU extension for the files >= 8GB: Big-endian base-256
+      // number, whose first byte has its most significant bit set
+      field[0] = static_cast<char>(0x80);
+      for (size_t i = 11; i > 0; i--)
+      {
+        field[i] = static_cast<char>(size & 0xff);
+        size >>= 8;
+      }
+    }
+  }
+
+
+  // Splits "name" between the "prefix" and "name" fields of the
+  // "ustar" header, which can only be done at a slash
+  static bool SplitName(std::string& prefix,
+                        std::string& suffix,
+                        const std::string& name)
+  {
+    if (name.size() <= NAME_SIZE)
+    {
+      prefix.clear();
+      suffix = name;
+      return true;
+    }
+
+    for (size_t i = 0; i < name.size(); i++)
+    {
+      if (name[i] == '/' &&
+          i <= PREFIX_SIZE &&
+          name.size() - i - 1 <= NAME_SIZE &&
+          name.size() - i - 1 > 0)
+      {
+        prefix = name.substr(0, i);
+        suffix = name.substr(i + 1);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  TarWriter::TarWriter(const boost::filesystem::path& path) :
+    output_(new FileStream(path)),
+    archiveSize_(0),
+    hasFile_(false),
+    isBuffered_(false),
+    remaining_(0),
+    isCancelled_(false),
+    isClosed_(false)
+  {
+  }
+
+
+  TarWriter::TarWriter(ZipWriter::IOutputStream* stream) :
+    output_(stream),
+    archiveSize_(0),
+    hasFile_(false),
+    isBuffered_(false),
+    remaining_(0),
+    isCancelled_(false),
+    isClosed_(false)
+  {
+    if (stream == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+  }
+
+
+  TarWriter::~TarWriter()
+  {
+    try
+    {
+      Close();
+    }
+    catch (OrthancException& e)
+    {
+      // Don't throw exceptions in destructors
+      LOG(ERROR) << "Cannot close the TAR archive: " << e.What();
+    }
+  }
+
+
+  void TarWriter::Flush()
+  {
+    if (!pending_.empty())
+    {
+      output_->Write(pending_);
+      pending_.clear();
+    }
+  }
+
+
+  void TarWriter::WriteRaw(const void* data,
+                           size_t size)
+  {
+    if (size >= FLUSH_SIZE)
+    {
+      // Avoid a copy of the large chunks into "pending_"
+      Flush();
+      output_->Write(std::string(reinterpret_cast<const char*>(data), size));
+    }
+    else
+    {
+      pending_.append(reinterpret_cast<const char*>(data), size);
+
+      if (pending_.size() >= FLUSH_SIZE)
+      {
+        Flush();
+      }
+    }
+
+    archiveSize_ += size;
+  }
+
+
+  void TarWriter::WritePadding(uint64_t size)
+  {
+    const size_t padding = static_cast<size_t>((BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE);
+
+    if (padding > 0)
+    {
+      const std::string zeros(padding, '\0');
+      WriteRaw(zeros.c_str(), zeros.size());
+    }
+  }
+
+
+  void TarWriter::WriteHeader(const std::string& name,
+                              uint64_t size,
+                              char type)
+  {
+    std::string prefix, suffix;
+
+    if (!SplitName(prefix, suffix, name))
+    {
+      // GNU extension: The long filename is stored in a pseudo-file
+      // that precedes the actual file
+      const std::string longName = name + '\0';
+      WriteHeader("././@LongLink", longName.size(), TYPE_GNU_LONG_NAME);
+      WriteRaw(longName.c_str(), longName.size());
+      WritePadding(longName.size());
+
+      prefix.clear();
+      suffix = name.substr(0, NAME_SIZE);
+    }
+
+    char header[BLOCK_SIZE];
+    memset(header, 0, sizeof(header));
+
+    memcpy(header, suffix.c_str(), suffix.size());        // name
+    FormatOctal(header + 100, 8, 0644);                   // mode
+    FormatOctal(header + 108, 8, 0);                      // uid
+    FormatOctal(header + 116, 8, 0);                      // gid
+    FormatSize(header + 124, size);                       // size
+    FormatOctal(header + 136, 12, static_cast<uint64_t>(time(NULL)));  // mtime
+    memset(header + 148, ' ', 8);                         // checksum, computed below
+    header[156] = type;                                   // typeflag
+    memcpy(header + 257, "ustar", 6);                     // magic
+    memcpy(header + 263, "00", 2);                        // version
+    memcpy(header + 345, prefix.c_str(), prefix.size());  // prefix
+
+    unsigned int checksum = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; i++)
+    {
+      checksum += static_cast<uint8_t>(header[i]);
+    }
+
+    FormatOctal(header + 148, 7, checksum);
+    header[155] = ' ';
+
+    WriteRaw(header, sizeof(header));
+  }
+
+
+  void TarWriter::CloseCurrentFile()
+  {
+    if (hasFile_)
+    {
+      hasFile_ = false;
+
+      if (isBuffered_)
+      {
+        WriteHeader(bufferedName_, bufferedContent_.size(), TYPE_REGULAR_FILE);
+
+        if (!bufferedContent_.empty())
+        {
+          WriteRaw(bufferedContent_.c_str(), bufferedContent_.size());
+        }
+
+        WritePadding(bufferedContent_.size());
+
+        bufferedName_.clear();
+        bufferedContent_.clear();
+      }
+      else if (remaining_ != 0)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                               "Missing bytes at the end of a file in a TAR archive");
+      }
+      else
+      {
+        WritePadding(archiveSize_);  // The entries are aligned on blocks
+      }
+    }
+  }
+
+
+  void TarWriter::OpenFile(const std::string& name)
+  {
+    if (isCancelled_ ||
+        isClosed_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    CloseCurrentFile();
+
+    hasFile_ = true;
+    isBuffered_ = true;
+    bufferedName_ = name;
+  }
+
+
+  void TarWriter::OpenFile(const std::string& name,
+                           uint64_t size)
+  {
+    if (isCancelled_ ||
+        isClosed_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    CloseCurrentFile();
+
+    WriteHeader(name, size, TYPE_REGULAR_FILE);
+
+    hasFile_ = true;
+    isBuffered_ = false;
+    remaining_ = size;
+  }
+
+
+  void TarWriter::Write(const void* data,
+                        size_t length)
+  {
+    if (!hasFile_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "Call first OpenFile()");
+    }
+    else if (length == 0)
+    {
+      return;
+    }
+    else if (isBuffered_)
+    {
+      bufferedContent_.append(reinterpret_cast<const char*>(data), length);
+    }
+    else if (length > remaining_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                             "Too many bytes written into a file of a TAR archive");
+    }
+    else
+    {
+      WriteRaw(data, length);
+      remaining_ -= length;
+    }
+  }
+
+
+  void TarWriter::Write(const std::string& data)
+  {
+    if (!data.empty())
+    {
+      Write(data.c_str(), data.size());
+    }
+  }
+
+
+  void TarWriter::CancelStream()
+  {
+    // As in "ZipWriter::CancelStream()", nothing more is written:
+    // The archive is left incomplete, without the end-of-archive marker
+    isCancelled_ = true;
+    hasFile_ = false;
+    pending_.clear();
+    bufferedContent_.clear();
+  }
+
+
+  void TarWriter::Close()
+  {
+    if (!isClosed_)
+    {
+      isClosed_ = true;
+
+      if (!isCancelled_)
+      {
+        CloseCurrentFile();
+
+        // The end of the archive is marked by two blocks of zeros
+        const std::string zeros(2 * BLOCK_SIZE, '\0');
+        WriteRaw(zeros.c_str(), zeros.size());
+
+        Flush();
+      }
+
+      output_->Close();
+    }
+  }
+}
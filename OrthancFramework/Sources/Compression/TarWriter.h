@@ -0,0 +1,104 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "ZipWriter.h"
+
+#include <stdint.h>
+#include <string>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+
+namespace Orthanc
+{
+  /**
+   * Writer of uncompressed TAR archives (POSIX "ustar" format, with
+   * the GNU extensions for the long filenames and the large files).
+   * In contrast with ZIP archives, there is neither central directory
+   * nor CRC-32, which makes the TAR archives appropriate to quickly
+   * stream a large amount of files to another computer. The size of
+   * a file must be written before its content: The content of the
+   * files that are opened with "OpenFile(name)" is buffered in memory
+   * until the next file is opened (new in Orthanc 1.12.12).
+   **/
+  class ORTHANC_PUBLIC TarWriter : public boost::noncopyable
+  {
+  private:
+    class FileStream;
+
+    std::unique_ptr<ZipWriter::IOutputStream>  output_;
+    std::string  pending_;         // Bytes waiting to be sent to "output_"
+    uint64_t     archiveSize_;
+    bool         hasFile_;
+    bool         isBuffered_;
+    std::string  bufferedName_;
+    std::string  bufferedContent_;
+    uint64_t     remaining_;       // Bytes to be written in the current unbuffered file
+    bool         isCancelled_;
+    bool         isClosed_;
+
+    void WriteRaw(const void* data,
+                  size_t size);
+
+    void WriteHeader(const std::string& name,
+                     uint64_t size,
+                     char type);
+
+    void WritePadding(uint64_t size);
+
+    void CloseCurrentFile();
+
+    void Flush();
+
+  public:
+    explicit TarWriter(const boost::filesystem::path& path);
+
+    explicit TarWriter(ZipWriter::IOutputStream* stream);  // transfers ownership
+
+    ~TarWriter();
+
+    // The content is buffered until the next file is opened
+    void OpenFile(const std::string& name);
+
+    // The content is directly written, and must contain exactly "size" bytes
+    void OpenFile(const std::string& name,
+                  uint64_t size);
+
+    void Write(const void* data,
+               size_t length);
+
+    void Write(const std::string& data);
+
+    void CancelStream();
+
+    void Close();
+
+    uint64_t GetArchiveSize() const
+    {
+      return archiveSize_;
+    }
+  };
+}
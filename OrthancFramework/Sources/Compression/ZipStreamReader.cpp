@@ -0,0 +1,604 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ZipStreamReader.h"
+
+#include "../MultiThreading/ReaderWriterLock.h"
+#include "../OrthancException.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cassert>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+
+static Orthanc::ReaderWriterLock maximumUncompressedFileSizeMutex_;
+static bool hasMaximumUncompressedFileSize_ = false;
+static size_t maximumUncompressedFileSize_ = 0;
+
+
+namespace Orthanc
+{
+  static const uint32_t SIGNATURE_LOCAL_FILE_HEADER = 0x04034b50;
+  static const uint32_t SIGNATURE_DATA_DESCRIPTOR = 0x08074b50;
+  static const uint32_t SIGNATURE_CENTRAL_DIRECTORY = 0x02014b50;
+  static const uint32_t SIGNATURE_END_OF_CENTRAL_DIRECTORY = 0x06054b50;
+  static const uint32_t SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY = 0x06064b50;
+
+  static const size_t LOCAL_FILE_HEADER_SIZE = 30;
+
+  static const uint16_t FLAG_ENCRYPTED = 0x0001;
+  static const uint16_t FLAG_DATA_DESCRIPTOR = 0x0008;
+
+  static const uint16_t METHOD_STORED = 0;
+  static const uint16_t METHOD_DEFLATE = 8;
+
+
+  static uint16_t ReadUInt16(const char* p)
+  {
+    const uint8_t* q = reinterpret_cast<const uint8_t*>(p);
+    return (static_cast<uint16_t>(q[0]) |
+            static_cast<uint16_t>(q[1]) << 8);
+  }
+
+
+  static uint32_t ReadUInt32(const char* p)
+  {
+    const uint8_t* q = reinterpret_cast<const uint8_t*>(p);
+    return (static_cast<uint32_t>(q[0]) |
+            static_cast<uint32_t>(q[1]) << 8 |
+            static_cast<uint32_t>(q[2]) << 16 |
+            static_cast<uint32_t>(q[3]) << 24);
+  }
+
+
+  static uint64_t ReadUInt64(const char* p)
+  {
+    return (static_cast<uint64_t>(ReadUInt32(p)) |
+            static_cast<uint64_t>(ReadUInt32(p + 4)) << 32);
+  }
+
+
+  struct ZipStreamReader::PImpl
+  {
+    enum State
+    {
+      State_LocalHeader,
+      State_FileData,
+      State_DataDescriptor,
+      State_Done
+    };
+
+    IHandler&    handler_;
+    State        state_;
+    std::string  buffer_;    // Received bytes that are not consumed yet
+    size_t       position_;  // Position of the first unconsumed byte in "buffer_"
+    bool         hasMaximumSize_;
+    size_t       maximumSize_;
+    bool         isFirstSignature_;
+
+    // Information about the file that is currently being read
+    std::string  filename_;
+    uint16_t     method_;
+    bool         hasDataDescriptor_;
+    bool         isZip64_;
+    uint32_t     expectedCrc_;
+    uint64_t     compressedSize_;
+    uint64_t     uncompressedSize_;
+    uint64_t     consumed_;
+    uLong        crc_;
+    std::string  content_;
+    bool         isInflating_;
+    z_stream     stream_;
+
+    explicit PImpl(IHandler& handler) :
+      handler_(handler),
+      state_(State_LocalHeader),
+      position_(0),
+      hasMaximumSize_(false),
+      maximumSize_(0),
+      isFirstSignature_(true),
+      method_(METHOD_STORED),
+      hasDataDescriptor_(false),
+      isZip64_(false),
+      expectedCrc_(0),
+      compressedSize_(0),
+      uncompressedSize_(0),
+      consumed_(0),
+      crc_(0),
+      isInflating_(false)
+    {
+      memset(&stream_, 0, sizeof(stream_));
+    }
+
+    ~PImpl()
+    {
+      if (isInflating_)
+      {
+        inflateEnd(&stream_);
+      }
+    }
+
+    size_t GetAvailableBytes() const
+    {
+      assert(position_ <= buffer_.size());
+      return buffer_.size() - position_;
+    }
+
+    const char* GetCurrent() const
+    {
+      return buffer_.c_str() + position_;
+    }
+
+    void CheckMaximumSize(uint64_t size) const
+    {
+      if (hasMaximumSize_ &&
+          size > maximumSize_)
+      {
+        char s[32];
+        sprintf(s, "%0.1f", static_cast<float>(maximumSize_) / (1024.0f * 1024.0f));
+        throw OrthancException(ErrorCode_BadFileFormat, "Uncompressed size exceeds limit (" + std::string(s) + "MB)");
+      }
+    }
+
+    void AppendContent(const char* data,
+                       size_t size)
+    {
+      if (size > 0)
+      {
+        CheckMaximumSize(static_cast<uint64_t>(content_.size()) + size);
+        content_.append(data, size);
+
+        // "crc32()" takes a "uInt" as its size argument
+        while (size > 0)
+        {
+          uInt block = (size > static_cast<size_t>(0x40000000) ? 0x40000000 : static_cast<uInt>(size));
+          crc_ = crc32(crc_, reinterpret_cast<const Bytef*>(data), block);
+          data += block;
+          size -= block;
+        }
+      }
+    }
+
+    bool ParseLocalHeader()
+    {
+      if (GetAvailableBytes() < 4)
+      {
+        return false;  // Not enough data available
+      }
+
+      const char* p = GetCurrent();
+      const uint32_t signature = ReadUInt32(p);
+
+      if (isFirstSignature_ &&
+          signature == SIGNATURE_DATA_DESCRIPTOR)
+      {
+        // Marker of a spanned archive that was written to a single stream
+        isFirstSignature_ = false;
+        position_ += 4;
+        return true;
+      }
+
+      isFirstSignature_ = false;
+
+      if (signature == SIGNATURE_CENTRAL_DIRECTORY ||
+          signature == SIGNATURE_END_OF_CENTRAL_DIRECTORY ||
+          signature == SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY)
+      {
+        // All the files have been read, the trailing index is ignored
+        state_ = State_Done;
+        return true;
+      }
+
+      if (signature != SIGNATURE_LOCAL_FILE_HEADER)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Corrupted local file header in ZIP archive");
+      }
+
+      if (GetAvailableBytes() < LOCAL_FILE_HEADER_SIZE)
+      {
+        return false;
+      }
+
+      const uint16_t flags = ReadUInt16(p + 6);
+      const uint16_t method = ReadUInt16(p + 8);
+      const uint32_t crc = ReadUInt32(p + 14);
+      uint64_t compressedSize = ReadUInt32(p + 18);
+      uint64_t uncompressedSize = ReadUInt32(p + 22);
+      const uint16_t filenameLength = ReadUInt16(p + 26);
+      const uint16_t extraLength = ReadUInt16(p + 28);
+
+      if (GetAvailableBytes() < LOCAL_FILE_HEADER_SIZE + filenameLength + extraLength)
+      {
+        return false;
+      }
+
+      if (flags & FLAG_ENCRYPTED)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Encrypted ZIP archives are not supported");
+      }
+
+      if (method != METHOD_STORED &&
+          method != METHOD_DEFLATE)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Unsupported compression method in ZIP archive: " +
+                               boost::lexical_cast<std::string>(method));
+      }
+
+      bool isZip64 = false;
+
+      const char* extra = p + LOCAL_FILE_HEADER_SIZE + filenameLength;
+      size_t pos = 0;
+      while (pos + 4 <= extraLength)
+      {
+        const uint16_t id = ReadUInt16(extra + pos);
+        const uint16_t length = ReadUInt16(extra + pos + 2);
+        pos += 4;
+
+        if (pos + length > extraLength)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat, "Corrupted extra field in ZIP archive");
+        }
+
+        if (id == 0x0001)
+        {
+          // ZIP64 extended information: The 64bit sizes are only
+          // present if the corresponding 32bit values are saturated
+          isZip64 = true;
+
+          size_t offset = 0;
+          if (uncompressedSize == 0xffffffffu &&
+              offset + 8 <= length)
+          {
+            uncompressedSize = ReadUInt64(extra + pos + offset);
+            offset += 8;
+          }
+
+          if (compressedSize == 0xffffffffu &&
+              offset + 8 <= length)
+          {
+            compressedSize = ReadUInt64(extra + pos + offset);
+          }
+        }
+
+        pos += length;
+      }
+
+      const bool hasDataDescriptor = ((flags & FLAG_DATA_DESCRIPTOR) != 0);
+
+      if (method == METHOD_STORED &&
+          hasDataDescriptor)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Cannot stream a stored file of unknown size from a ZIP archive");
+      }
+
+      if (!hasDataDescriptor)
+      {
+        CheckMaximumSize(uncompressedSize);
+      }
+
+      filename_.assign(p + LOCAL_FILE_HEADER_SIZE, filenameLength);
+      method_ = method;
+      hasDataDescriptor_ = hasDataDescriptor;
+      isZip64_ = isZip64;
+      expectedCrc_ = crc;
+      compressedSize_ = compressedSize;
+      uncompressedSize_ = uncompressedSize;
+      consumed_ = 0;
+      crc_ = crc32(0L, Z_NULL, 0);
+      content_.clear();
+
+      if (method == METHOD_DEFLATE)
+      {
+        memset(&stream_, 0, sizeof(stream_));
+
+        // Negative window bits: Raw deflate stream, without zlib header
+        if (inflateInit2(&stream_, -MAX_WBITS) != Z_OK)
+        {
+          throw OrthancException(ErrorCode_InternalError, "Cannot initialize zlib");
+        }
+
+        isInflating_ = true;
+      }
+
+      position_ += LOCAL_FILE_HEADER_SIZE + filenameLength + extraLength;
+      state_ = State_FileData;
+      return true;
+    }
+
+    void CompleteFile(uint32_t crc,
+                      uint64_t uncompressedSize)
+    {
+      if (static_cast<uint32_t>(crc_) != crc ||
+          static_cast<uint64_t>(content_.size()) != uncompressedSize)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Corrupted file in ZIP archive: " + filename_);
+      }
+
+      // Clear the content before calling the handler, to release memory
+      // even if the handler throws an exception
+      std::string content;
+      content.swap(content_);
+      state_ = State_LocalHeader;
+
+      handler_.HandleFile(filename_, content.empty() ? NULL : content.c_str(), content.size());
+    }
+
+    void EndOfFileData()
+    {
+      if (hasDataDescriptor_)
+      {
+        state_ = State_DataDescriptor;
+      }
+      else if (consumed_ != compressedSize_)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Corrupted file in ZIP archive: " + filename_);
+      }
+      else
+      {
+        CompleteFile(expectedCrc_, uncompressedSize_);
+      }
+    }
+
+    bool ParseStoredData()
+    {
+      assert(consumed_ <= compressedSize_);
+
+      const uint64_t remaining = compressedSize_ - consumed_;
+      const size_t count = (remaining < static_cast<uint64_t>(GetAvailableBytes()) ?
+                            static_cast<size_t>(remaining) : GetAvailableBytes());
+
+      AppendContent(GetCurrent(), count);
+      position_ += count;
+      consumed_ += count;
+
+      if (consumed_ == compressedSize_)
+      {
+        EndOfFileData();
+        return true;
+      }
+      else
+      {
+        return false;  // Wait for more data
+      }
+    }
+
+    bool ParseDeflatedData()
+    {
+      if (GetAvailableBytes() == 0)
+      {
+        return false;
+      }
+
+      const size_t available = (GetAvailableBytes() > static_cast<size_t>(0x40000000) ?
+                                static_cast<size_t>(0x40000000) : GetAvailableBytes());
+
+      stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(GetCurrent()));
+      stream_.avail_in = static_cast<uInt>(available);
+
+      char tmp[65536];
+      int error;
+
+      do
+      {
+        stream_.next_out = reinterpret_cast<Bytef*>(tmp);
+        stream_.avail_out = static_cast<uInt>(sizeof(tmp));
+
+        error = inflate(&stream_, Z_NO_FLUSH);
+
+        const size_t produced = sizeof(tmp) - stream_.avail_out;
+
+        if (error != Z_OK &&
+            error != Z_STREAM_END &&
+            !(error == Z_BUF_ERROR && produced == 0))
+        {
+          throw OrthancException(ErrorCode_BadFileFormat, "Corrupted deflate stream in ZIP archive: " + filename_);
+        }
+
+        AppendContent(tmp, produced);
+
+        if (error == Z_BUF_ERROR)
+        {
+          break;  // No progress is possible, wait for more input
+        }
+      }
+      while (error != Z_STREAM_END &&
+             (stream_.avail_in > 0 ||
+              stream_.avail_out == 0));
+
+      const size_t used = available - stream_.avail_in;
+      position_ += used;
+      consumed_ += used;
+
+      if (error == Z_STREAM_END)
+      {
+        inflateEnd(&stream_);
+        isInflating_ = false;
+
+        EndOfFileData();
+        return true;
+      }
+      else
+      {
+        return false;  // Wait for more data
+      }
+    }
+
+    bool ParseDataDescriptor()
+    {
+      const size_t sizesLength = (isZip64_ ? 16 : 8);
+
+      if (GetAvailableBytes() < 4)
+      {
+        return false;
+      }
+
+      // The signature of the data descriptor is optional
+      const size_t offset = (ReadUInt32(GetCurrent()) == SIGNATURE_DATA_DESCRIPTOR ? 4 : 0);
+
+      if (GetAvailableBytes() < offset + 4 + sizesLength)
+      {
+        return false;
+      }
+
+      const char* p = GetCurrent() + offset;
+      const uint32_t crc = ReadUInt32(p);
+
+      uint64_t compressedSize, uncompressedSize;
+      if (isZip64_)
+      {
+        compressedSize = ReadUInt64(p + 4);
+        uncompressedSize = ReadUInt64(p + 12);
+      }
+      else
+      {
+        compressedSize = ReadUInt32(p + 4);
+        uncompressedSize = ReadUInt32(p + 8);
+      }
+
+      if (compressedSize != consumed_)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Corrupted data descriptor in ZIP archive: " + filename_);
+      }
+
+      position_ += offset + 4 + sizesLength;
+      CompleteFile(crc, uncompressedSize);
+      return true;
+    }
+
+    void Parse()
+    {
+      for (;;)
+      {
+        bool progress;
+
+        switch (state_)
+        {
+          case State_LocalHeader:
+            progress = ParseLocalHeader();
+            break;
+
+          case State_FileData:
+            progress = (method_ == METHOD_STORED ? ParseStoredData() : ParseDeflatedData());
+            break;
+
+          case State_DataDescriptor:
+            progress = ParseDataDescriptor();
+            break;
+
+          case State_Done:
+            buffer_.clear();
+            position_ = 0;
+            return;
+
+          default:
+            throw OrthancException(ErrorCode_InternalError);
+        }
+
+        if (!progress)
+        {
+          break;
+        }
+      }
+
+      buffer_.erase(0, position_);
+      position_ = 0;
+    }
+  };
+
+
+  ZipStreamReader::ZipStreamReader(IHandler& handler) :
+    pimpl_(new PImpl(handler))
+  {
+    ReaderWriterLock::ReadLock lock(maximumUncompressedFileSizeMutex_);
+    pimpl_->hasMaximumSize_ = hasMaximumUncompressedFileSize_;
+    pimpl_->maximumSize_ = maximumUncompressedFileSize_;
+  }
+
+
+  ZipStreamReader::~ZipStreamReader()
+  {
+  }
+
+
+  void ZipStreamReader::AddChunk(const void* data,
+                                 size_t size)
+  {
+    if (pimpl_->state_ != PImpl::State_Done &&
+        size > 0)
+    {
+      pimpl_->buffer_.append(reinterpret_cast<const char*>(data), size);
+      pimpl_->Parse();
+    }
+  }
+
+
+  void ZipStreamReader::AddChunk(const std::string& data)
+  {
+    if (!data.empty())
+    {
+      AddChunk(data.c_str(), data.size());
+    }
+  }
+
+
+  void ZipStreamReader::CloseStream()
+  {
+    if (pimpl_->state_ == PImpl::State_Done ||
+        (pimpl_->state_ == PImpl::State_LocalHeader &&
+         pimpl_->buffer_.empty()))
+    {
+      // The stream ends between two files: Tolerate a missing central directory
+      pimpl_->state_ = PImpl::State_Done;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Truncated ZIP archive");
+    }
+  }
+
+
+  bool ZipStreamReader::IsDone() const
+  {
+    return pimpl_->state_ == PImpl::State_Done;
+  }
+
+
+  void ZipStreamReader::SetMaximumUncompressedFileSize(uint64_t size)
+  {
+    if (static_cast<uint64_t>(static_cast<size_t>(size)) != size)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+    else
+    {
+      ReaderWriterLock::WriteLock lock(maximumUncompressedFileSizeMutex_);
+      hasMaximumUncompressedFileSize_ = true;
+      maximumUncompressedFileSize_ = size;
+    }
+  }
+}
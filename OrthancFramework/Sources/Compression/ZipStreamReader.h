@@ -0,0 +1,92 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#if !defined(ORTHANC_ENABLE_ZLIB)
+#  error The macro ORTHANC_ENABLE_ZLIB must be defined
+#endif
+
+#if ORTHANC_ENABLE_ZLIB != 1
+#  error ZLIB support must be enabled to include this file
+#endif
+
+
+#include <stdint.h>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Incremental reader for ZIP archives that are received as a
+   * stream (e.g. through the body of a HTTP request). Contrarily to
+   * "ZipReader", the central directory at the end of the archive is
+   * never used: The local file headers are parsed as soon as they
+   * are received, and each file is passed to the handler as soon as
+   * it has been fully uncompressed. The memory consumption is thus
+   * bounded by the size of the largest file in the archive. Only
+   * the "stored" and "deflate" compression methods are supported.
+   **/
+  class ORTHANC_PUBLIC ZipStreamReader : public boost::noncopyable
+  {
+  public:
+    class ORTHANC_PUBLIC IHandler : public boost::noncopyable
+    {
+    public:
+      virtual ~IHandler()
+      {
+      }
+
+      virtual void HandleFile(const std::string& filename,
+                              const void* content,
+                              size_t size) = 0;
+    };
+
+  private:
+    struct PImpl;
+    boost::shared_ptr<PImpl>  pimpl_;
+
+  public:
+    explicit ZipStreamReader(IHandler& handler);
+
+    ~ZipStreamReader();
+
+    void AddChunk(const void* data,
+                  size_t size);
+
+    void AddChunk(const std::string& data);
+
+    // Throws "BadFileFormat" if the archive is truncated
+    void CloseStream();
+
+    bool IsDone() const;
+
+    static void SetMaximumUncompressedFileSize(uint64_t size);
+  };
+}
@@ -35,9 +35,11 @@
 #include "ZipWriter.h"
 
 
+#include <deque>
 #include <limits>
 #include <boost/filesystem.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
 
 #if ORTHANC_USE_SYSTEM_MINIZIP == 1
 #  include <minizip/zip.h>
@@ -435,15 +437,478 @@ namespace Orthanc
   };
   
 
+  /**
+   * The entries are split into blocks that are compressed
+   * independently as raw deflate streams. All the blocks but the last
+   * one are terminated by "Z_SYNC_FLUSH", which aligns them on a byte
+   * boundary, so that their concatenation is a valid deflate
+   * stream. The preceding 32KB of the entry are used as the
+   * dictionary of each block, in order to keep the compression ratio
+   * close to that of a single stream. This is the approach of "pigz".
+   **/
+  static const size_t PARALLEL_BLOCK_SIZE = 512 * 1024;
+  static const size_t PARALLEL_DICTIONARY_SIZE = 32 * 1024;  // Size of the deflate window
+
+  class ZipWriter::ParallelCompressor : public boost::noncopyable
+  {
+  public:
+    class Entry;
+
+  private:
+    class Block : public boost::noncopyable
+    {
+    private:
+      const std::string&  data_;  // Owned by the entry
+      size_t              offset_;
+      size_t              size_;
+      bool                isLast_;
+      uint8_t             level_;
+      bool                isDone_;
+      bool                success_;
+      std::string         compressed_;
+      uLong               crc32_;
+
+    public:
+      Block(const std::string& data,
+            size_t offset,
+            size_t size,
+            bool isLast,
+            uint8_t level) :
+        data_(data),
+        offset_(offset),
+        size_(size),
+        isLast_(isLast),
+        level_(level),
+        isDone_(false),
+        success_(false),
+        crc32_(0)
+      {
+      }
+
+      // Executed by the worker threads, without any mutex locked
+      void Compress()
+      {
+        const Bytef* input = reinterpret_cast<const Bytef*>(data_.empty() ? NULL : data_.c_str() + offset_);
+
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+
+        if (deflateInit2(&stream, level_, Z_DEFLATED, -MAX_WBITS /* raw deflate */,
+                         8 /* default memory level */, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+          return;
+        }
+
+        if (offset_ > 0)
+        {
+          const size_t dictionarySize = std::min(offset_, PARALLEL_DICTIONARY_SIZE);
+          if (deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(data_.c_str() + offset_ - dictionarySize),
+                                   static_cast<uInt>(dictionarySize)) != Z_OK)
+          {
+            deflateEnd(&stream);
+            return;
+          }
+        }
+
+        // Margin for the empty stored block of "Z_SYNC_FLUSH"
+        compressed_.resize(deflateBound(&stream, static_cast<uLong>(size_)) + 64);
+
+        stream.next_in = const_cast<Bytef*>(input);
+        stream.avail_in = static_cast<uInt>(size_);
+
+        const int flush = (isLast_ ? Z_FINISH : Z_SYNC_FLUSH);
+
+        for (;;)
+        {
+          if (stream.total_out == compressed_.size())
+          {
+            compressed_.resize(2 * compressed_.size());
+          }
+
+          stream.next_out = reinterpret_cast<Bytef*>(&compressed_[0]) + stream.total_out;
+          stream.avail_out = static_cast<uInt>(compressed_.size() - stream.total_out);
+
+          int result = deflate(&stream, flush);
+
+          if (result == Z_STREAM_ERROR)
+          {
+            deflateEnd(&stream);
+            return;
+          }
+          else if (isLast_ ?
+                   (result == Z_STREAM_END) :
+                   (stream.avail_in == 0 && stream.avail_out != 0))
+          {
+            break;
+          }
+        }
+
+        compressed_.resize(stream.total_out);
+        deflateEnd(&stream);
+
+        crc32_ = crc32(crc32(0L, Z_NULL, 0), input, static_cast<uInt>(size_));
+        success_ = true;
+      }
+
+      void SetDone()
+      {
+        isDone_ = true;
+      }
+
+      bool IsDone() const
+      {
+        return isDone_;
+      }
+
+      bool IsSuccess() const
+      {
+        return success_;
+      }
+
+      size_t GetSize() const
+      {
+        return size_;
+      }
+
+      const std::string& GetCompressed() const
+      {
+        return compressed_;
+      }
+
+      uLong GetCrc32() const
+      {
+        return crc32_;
+      }
+    };
+
+  public:
+    class Entry : public boost::noncopyable
+    {
+      friend class ParallelCompressor;
+
+    private:
+      std::string          filename_;
+      bool                 compress_;
+      zip_fileinfo         info_;
+      uint8_t              level_;
+      std::string          data_;
+      std::vector<Block*>  blocks_;
+
+    public:
+      Entry(const std::string& filename,
+            bool compress) :
+        filename_(filename),
+        compress_(compress),
+        level_(0)
+      {
+        PrepareFileInfo(info_);
+      }
+
+      ~Entry()
+      {
+        for (size_t i = 0; i < blocks_.size(); i++)
+        {
+          assert(blocks_[i] != NULL);
+          delete blocks_[i];
+        }
+      }
+
+      void Append(const void* data,
+                  size_t length)
+      {
+        data_.append(reinterpret_cast<const char*>(data), length);
+      }
+
+      const std::string& GetFilename() const
+      {
+        return filename_;
+      }
+
+      bool IsCompressed() const
+      {
+        return compress_;
+      }
+
+      const zip_fileinfo& GetFileInfo() const
+      {
+        return info_;
+      }
+
+      const std::string& GetData() const
+      {
+        return data_;
+      }
+
+      uint8_t GetLevel() const
+      {
+        return level_;
+      }
+
+      uint64_t GetUncompressedSize() const
+      {
+        return data_.size();
+      }
+
+      size_t GetBlocksCount() const
+      {
+        return blocks_.size();
+      }
+
+      const std::string& GetCompressedBlock(size_t i) const
+      {
+        assert(i < blocks_.size());
+        return blocks_[i]->GetCompressed();
+      }
+
+      uLong GetCrc32() const
+      {
+        uLong crc = crc32(0L, Z_NULL, 0);
+
+        for (size_t i = 0; i < blocks_.size(); i++)
+        {
+          crc = crc32_combine(crc, blocks_[i]->GetCrc32(), static_cast<z_off_t>(blocks_[i]->GetSize()));
+        }
+
+        return crc;
+      }
+    };
+
+  private:
+    boost::mutex                  mutex_;
+    boost::condition_variable     queueNotEmpty_;
+    boost::condition_variable     blockDone_;
+    std::deque<Block*>            queue_;
+    bool                          stopped_;
+    std::vector<boost::thread*>   workers_;
+
+    // Only accessed by the thread that owns the ZipWriter
+    std::deque<Entry*>            entries_;
+    uint64_t                      pendingBytes_;
+
+    static void Worker(ParallelCompressor* that)
+    {
+      for (;;)
+      {
+        Block* block = NULL;
+
+        {
+          boost::mutex::scoped_lock lock(that->mutex_);
+
+          while (that->queue_.empty() &&
+                 !that->stopped_)
+          {
+            that->queueNotEmpty_.wait(lock);
+          }
+
+          if (that->stopped_)
+          {
+            return;
+          }
+
+          block = that->queue_.front();
+          that->queue_.pop_front();
+        }
+
+        assert(block != NULL);
+        block->Compress();
+
+        {
+          boost::mutex::scoped_lock lock(that->mutex_);
+          block->SetDone();
+        }
+
+        that->blockDone_.notify_all();
+      }
+    }
+
+  public:
+    explicit ParallelCompressor(unsigned int threads) :
+      stopped_(false),
+      pendingBytes_(0)
+    {
+      if (threads == 0)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      workers_.resize(threads);
+
+      for (size_t i = 0; i < threads; i++)
+      {
+        workers_[i] = new boost::thread(Worker, this);
+      }
+    }
+
+    ~ParallelCompressor()
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        stopped_ = true;
+      }
+
+      queueNotEmpty_.notify_all();
+
+      for (size_t i = 0; i < workers_.size(); i++)
+      {
+        if (workers_[i]->joinable())
+        {
+          workers_[i]->join();
+        }
+
+        delete workers_[i];
+      }
+
+      // The blocks that remain in "queue_" are owned by the entries
+      for (size_t i = 0; i < entries_.size(); i++)
+      {
+        assert(entries_[i] != NULL);
+        delete entries_[i];
+      }
+    }
+
+    size_t GetThreadsCount() const
+    {
+      return workers_.size();
+    }
+
+    void Submit(Entry* entry,  // Takes ownership
+                uint8_t level)
+    {
+      std::unique_ptr<Entry> protection(entry);
+
+      if (entry == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+
+      const size_t size = entry->data_.size();
+
+      if (entry->compress_)
+      {
+        entry->level_ = level;
+
+        size_t offset = 0;
+        do
+        {
+          const size_t blockSize = std::min(PARALLEL_BLOCK_SIZE, size - offset);
+          entry->blocks_.push_back(new Block(entry->data_, offset, blockSize, offset + blockSize == size, level));
+          offset += blockSize;
+        }
+        while (offset < size);
+      }
+      else
+      {
+        entry->level_ = 0;  // Stored entry, without any block to compress
+      }
+
+      entries_.push_back(protection.release());
+      pendingBytes_ += size;
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        for (size_t i = 0; i < entry->blocks_.size(); i++)
+        {
+          queue_.push_back(entry->blocks_[i]);
+        }
+      }
+
+      queueNotEmpty_.notify_all();
+    }
+
+    bool HasEntries() const
+    {
+      return !entries_.empty();
+    }
+
+    size_t GetEntriesCount() const
+    {
+      return entries_.size();
+    }
+
+    uint64_t GetPendingBytes() const
+    {
+      return pendingBytes_;
+    }
+
+    bool IsOldestDone()
+    {
+      assert(!entries_.empty());
+
+      boost::mutex::scoped_lock lock(mutex_);
+
+      const Entry& entry = *entries_.front();
+      for (size_t i = 0; i < entry.blocks_.size(); i++)
+      {
+        if (!entry.blocks_[i]->IsDone())
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    // Waits for the compression of the oldest entry to be over
+    const Entry& WaitOldest()
+    {
+      assert(!entries_.empty());
+
+      const Entry& entry = *entries_.front();
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        for (size_t i = 0; i < entry.blocks_.size(); i++)
+        {
+          while (!entry.blocks_[i]->IsDone())
+          {
+            blockDone_.wait(lock);
+          }
+        }
+      }
+
+      for (size_t i = 0; i < entry.blocks_.size(); i++)
+      {
+        if (!entry.blocks_[i]->IsSuccess())
+        {
+          throw OrthancException(ErrorCode_InternalError, "Cannot compress an entry of the ZIP archive");
+        }
+      }
+
+      return entry;
+    }
+
+    void RemoveOldest()
+    {
+      assert(!entries_.empty());
+
+      Entry* entry = entries_.front();
+      entries_.pop_front();
+
+      assert(pendingBytes_ >= entry->data_.size());
+      pendingBytes_ -= entry->data_.size();
+
+      delete entry;
+    }
+  };
+
+
   struct ZipWriter::PImpl : public boost::noncopyable
   {
     zipFile file_;
     std::unique_ptr<StreamBuffer> streamBuffer_;
     uint64_t  archiveSize_;
 
+    // New in Orthanc 1.12.12
+    std::unique_ptr<ParallelCompressor>  compressor_;
+    std::unique_ptr<ParallelCompressor::Entry>  currentEntry_;
+    bool  streamedEntry_;  // Whether the current file bypasses "compressor_"
+
     PImpl() :
       file_(NULL),
-      archiveSize_(0)
+      archiveSize_(0),
+      streamedEntry_(false)
     {
     }
   };
@@ -454,7 +919,8 @@ namespace Orthanc
     allowUtf8_(false),
     hasFileInZip_(false),
     append_(false),
-    compressionLevel_(6)
+    compressionLevel_(6),
+    compressionThreads_(1)
   {
   }
 
@@ -474,6 +940,28 @@ namespace Orthanc
   {
     if (IsOpen())
     {
+      if (pimpl_->compressor_.get() != NULL)
+      {
+        try
+        {
+          SubmitParallelEntry();
+          WriteParallelEntries(true /* all */);
+        }
+        catch (OrthancException&)
+        {
+          pimpl_->compressor_.reset(NULL);
+          pimpl_->currentEntry_.reset(NULL);
+          zipClose(pimpl_->file_, "Created by Orthanc");
+          pimpl_->file_ = NULL;
+          hasFileInZip_ = false;
+          pimpl_->streamBuffer_.reset(NULL);
+          outputStream_.reset(NULL);
+          throw;
+        }
+
+        pimpl_->compressor_.reset(NULL);
+      }
+
       zipClose(pimpl_->file_, "Created by Orthanc");
       pimpl_->file_ = NULL;
       hasFileInZip_ = false;
@@ -569,6 +1057,12 @@ namespace Orthanc
                                "Cannot create new ZIP archive");  // we do not log the path anymore since it can contain PHI
       }
     }
+
+    if (compressionThreads_ > 1 &&
+        compressionLevel_ > 0)
+    {
+      pimpl_->compressor_.reset(new ParallelCompressor(compressionThreads_));
+    }
   }
 
   void ZipWriter::SetOutputPath(const boost::filesystem::path& path)
@@ -630,15 +1124,182 @@ namespace Orthanc
     return compressionLevel_;
   }
 
+  void ZipWriter::SetCompressionThreads(unsigned int threads)
+  {
+    if (IsOpen())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                             "The number of compression threads must be set before opening the ZIP archive");
+    }
+    else if (threads == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "At least one thread is needed to compress a ZIP archive");
+    }
+    else
+    {
+      compressionThreads_ = threads;
+    }
+  }
+
+  void ZipWriter::SubmitParallelEntry()
+  {
+    assert(pimpl_->compressor_.get() != NULL);
+
+    if (pimpl_->currentEntry_.get() != NULL)
+    {
+      pimpl_->compressor_->Submit(pimpl_->currentEntry_.release(), compressionLevel_);
+    }
+  }
+
+  void ZipWriter::WriteParallelEntries(bool all)
+  {
+    assert(pimpl_->compressor_.get() != NULL);
+
+    static const uint64_t MAX_PENDING_BYTES = 64 * 1024 * 1024;
+
+    ParallelCompressor& compressor = *pimpl_->compressor_;
+
+    // Back-pressure: Bound the memory that is used by the entries
+    // whose compression is pending
+    const size_t maxPendingEntries = 4 * compressor.GetThreadsCount();
+
+    while (compressor.HasEntries() &&
+           (all ||
+            compressor.IsOldestDone() ||
+            compressor.GetPendingBytes() > MAX_PENDING_BYTES ||
+            compressor.GetEntriesCount() > maxPendingEntries))
+    {
+      const ParallelCompressor::Entry& entry = compressor.WaitOldest();
+
+      if (!entry.IsCompressed())
+      {
+        int result = zipOpenNewFileInZip2_64(pimpl_->file_, entry.GetFilename().c_str(),
+                                             &entry.GetFileInfo(),
+                                             NULL,   0,
+                                             NULL,   0,
+                                             "",  // Comment
+                                             0 /* stored */, 0,
+                                             0 /* not raw */,
+                                             isZip64_ ? 1 : 0);
+
+        if (result != ZIP_OK)
+        {
+          throw OrthancException(ErrorCode_CannotWriteFile,
+                                 "Cannot add new file inside ZIP archive - error code = " + boost::lexical_cast<std::string>(result)); // we do not log the path anymore since it can contain PHI
+        }
+
+        if (!entry.GetData().empty())
+        {
+          WriteInternal(entry.GetData().c_str(), entry.GetData().size());
+        }
+
+        result = zipCloseFileInZip(pimpl_->file_);
+        if (result != ZIP_OK)
+        {
+          throw OrthancException(ErrorCode_CannotWriteFile,
+                                 "Cannot close file inside ZIP archive - error code = " + boost::lexical_cast<std::string>(result));
+        }
+
+        compressor.RemoveOldest();
+        continue;
+      }
+
+      // The compressed blocks are written as a raw deflate stream
+      int result = zipOpenNewFileInZip2_64(pimpl_->file_, entry.GetFilename().c_str(),
+                                           &entry.GetFileInfo(),
+                                           NULL,   0,
+                                           NULL,   0,
+                                           "",  // Comment
+                                           Z_DEFLATED,
+                                           entry.GetLevel(),
+                                           1 /* raw */,
+                                           isZip64_ ? 1 : 0);
+
+      if (result != ZIP_OK)
+      {
+        throw OrthancException(ErrorCode_CannotWriteFile,
+                               "Cannot add new file inside ZIP archive - error code = " + boost::lexical_cast<std::string>(result)); // we do not log the path anymore since it can contain PHI
+      }
+
+      for (size_t i = 0; i < entry.GetBlocksCount(); i++)
+      {
+        const std::string& block = entry.GetCompressedBlock(i);
+        if (!block.empty())
+        {
+          WriteInternal(block.c_str(), block.size());
+        }
+      }
+
+      result = zipCloseFileInZipRaw64(pimpl_->file_, entry.GetUncompressedSize(), entry.GetCrc32());
+      if (result != ZIP_OK)
+      {
+        throw OrthancException(ErrorCode_CannotWriteFile,
+                               "Cannot close file inside ZIP archive - error code = " + boost::lexical_cast<std::string>(result));
+      }
+
+      compressor.RemoveOldest();
+    }
+  }
+
   void ZipWriter::OpenFile(const std::string& filename)
+  {
+    OpenFile(filename, true);
+  }
+
+  void ZipWriter::OpenFile(const std::string& filename,
+                           bool compress)
+  {
+    Open();
+
+    const std::string normalized = Toolbox::NormalizePath(filename, allowUtf8_, true /* allow slashes, necessary for subdirectories */);
+
+    if (pimpl_->compressor_.get() != NULL)
+    {
+      // The compression of the previous file is delegated to the
+      // worker threads, and the file itself is written once its
+      // compression is over, in the order of the calls to "OpenFile()"
+      SubmitParallelEntry();
+      WriteParallelEntries(false);
+      pimpl_->currentEntry_.reset(new ParallelCompressor::Entry(normalized, compress));
+      pimpl_->streamedEntry_ = false;
+      hasFileInZip_ = true;
+      return;
+    }
+
+    OpenFileInternal(normalized, compress);
+  }
+
+
+  void ZipWriter::OpenStreamedFile(const std::string& filename,
+                                   bool compress)
   {
     Open();
 
     const std::string normalized = Toolbox::NormalizePath(filename, allowUtf8_, true /* allow slashes, necessary for subdirectories */);
 
+    if (pimpl_->compressor_.get() != NULL)
+    {
+      // The previous files must be written before this one, which
+      // is a barrier for the parallel compression
+      SubmitParallelEntry();
+      WriteParallelEntries(true /* all */);
+      pimpl_->streamedEntry_ = true;
+    }
+
+    OpenFileInternal(normalized, compress);
+  }
+
+
+  void ZipWriter::OpenFileInternal(const std::string& normalized,
+                                   bool compress)
+  {
     zip_fileinfo zfi;
     PrepareFileInfo(zfi);
 
+    const int method = (compress ? Z_DEFLATED : 0 /* stored */);
+    const int level = (compress ? compressionLevel_ : 0);
+
     int result;
 
     if (isZip64_)
@@ -648,8 +1309,8 @@ namespace Orthanc
                                      NULL,   0,
                                      NULL,   0,
                                      "",  // Comment
-                                     Z_DEFLATED,
-                                     compressionLevel_, 1);
+                                     method,
+                                     level, 1);
     }
     else
     {
@@ -658,8 +1319,8 @@ namespace Orthanc
                                    NULL,   0,
                                    NULL,   0,
                                    "",  // Comment
-                                   Z_DEFLATED,
-                                   compressionLevel_);
+                                   method,
+                                   level);
     }
 
     if (result != ZIP_OK)
@@ -687,7 +1348,21 @@ namespace Orthanc
     {
       throw OrthancException(ErrorCode_BadSequenceOfCalls, "Call first OpenFile()");
     }
+    else if (pimpl_->compressor_.get() != NULL &&
+             !pimpl_->streamedEntry_)
+    {
+      assert(pimpl_->currentEntry_.get() != NULL);
+      pimpl_->currentEntry_->Append(data, length);
+    }
+    else
+    {
+      WriteInternal(data, length);
+    }
+  }
 
+
+  void ZipWriter::WriteInternal(const void* data, size_t length)
+  {
     const size_t maxBytesInAStep = std::numeric_limits<int32_t>::max();
 
     const char* p = reinterpret_cast<const char*>(data);
@@ -761,6 +1436,9 @@ namespace Orthanc
     }
     else
     {
+      // Discard the entries whose compression is pending
+      pimpl_->compressor_.reset(NULL);
+      pimpl_->currentEntry_.reset(NULL);
       pimpl_->streamBuffer_->Cancel();
     }
   }
@@ -125,6 +125,7 @@ namespace Orthanc
     
   private:
     class StreamBuffer;
+    class ParallelCompressor;
     
     struct PImpl;
     boost::shared_ptr<PImpl> pimpl_;
@@ -134,10 +135,21 @@ namespace Orthanc
     bool hasFileInZip_;
     bool append_;
     uint8_t compressionLevel_;
+    unsigned int compressionThreads_;  // New in Orthanc 1.12.12
     boost::filesystem::path path_;
 
     std::unique_ptr<IOutputStream> outputStream_;
 
+    void WriteInternal(const void* data,
+                       size_t length);
+
+    void SubmitParallelEntry();
+
+    void WriteParallelEntries(bool all);
+
+    void OpenFileInternal(const std::string& normalized,
+                          bool compress);
+
   public:
     ZipWriter();
 
@@ -171,6 +183,21 @@ namespace Orthanc
 
     uint8_t GetCompressionLevel() const;
 
+    /**
+     * New in Orthanc 1.12.12. If "threads" is above 1, the entries
+     * are compressed in parallel by a pool of worker threads, the
+     * large entries being split into independent blocks of raw
+     * deflate data (as in "pigz"). The compressed entries are written
+     * in order by the thread that calls "OpenFile()", "Write()" or
+     * "Close()". Must be called before "Open()".
+     **/
+    void SetCompressionThreads(unsigned int threads);
+
+    unsigned int GetCompressionThreads() const
+    {
+      return compressionThreads_;
+    }
+
     void SetAppendToExisting(bool append);
     
     bool IsAppendToExisting() const;
@@ -187,6 +214,23 @@ namespace Orthanc
 
     void OpenFile(const std::string& filename);
 
+    /**
+     * If "compress" is "false", the file is stored without
+     * compression, which is faster and as space-efficient for data
+     * that is already compressed (new in Orthanc 1.12.12).
+     **/
+    void OpenFile(const std::string& filename,
+                  bool compress);
+
+    /**
+     * Same as "OpenFile()", but the content of the file is directly
+     * written into the archive, instead of being buffered in memory
+     * for the parallel compression. This is intended for very large
+     * files that are written by chunks (new in Orthanc 1.12.12).
+     **/
+    void OpenStreamedFile(const std::string& filename,
+                          bool compress);
+
     void Write(const void* data,
                size_t length);
 
@@ -0,0 +1,172 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "ZstdCompressor.h"
+
+#include "../Endianness.h"
+#include "../OrthancException.h"
+
+#include <boost/lexical_cast.hpp>
+#include <string.h>
+#include <zstd.h>
+
+// Same default as the "zstd" command-line tool, which favors the
+// speed of decompression over the compression ratio
+static const int DEFAULT_COMPRESSION_LEVEL = 3;
+
+namespace Orthanc
+{
+  ZstdCompressor::ZstdCompressor() :
+    compressionLevel_(DEFAULT_COMPRESSION_LEVEL),
+    prefixWithUncompressedSize_(true)
+  {
+  }
+
+
+  void ZstdCompressor::SetCompressionLevel(int level)
+  {
+    if (level < 1 ||
+        level > ZSTD_maxCLevel())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "The zstd compression level must be between 1 and " +
+                             boost::lexical_cast<std::string>(ZSTD_maxCLevel()));
+    }
+    else
+    {
+      compressionLevel_ = level;
+    }
+  }
+
+
+  void ZstdCompressor::Compress(std::string& compressed,
+                                const void* uncompressed,
+                                size_t uncompressedSize)
+  {
+    if (uncompressedSize == 0)
+    {
+      compressed.clear();
+      return;
+    }
+
+    const size_t bound = ZSTD_compressBound(uncompressedSize);
+    if (ZSTD_isError(bound))
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    const size_t offset = (prefixWithUncompressedSize_ ? sizeof(uint64_t) : 0);
+
+    compressed.resize(offset + bound);
+
+    const size_t compressedSize = ZSTD_compress(&compressed[offset], bound,
+                                                uncompressed, uncompressedSize, compressionLevel_);
+
+    if (ZSTD_isError(compressedSize))
+    {
+      compressed.clear();
+      throw OrthancException(ErrorCode_InternalError,
+                             "Error in zstd compression: " + std::string(ZSTD_getErrorName(compressedSize)));
+    }
+
+    if (prefixWithUncompressedSize_)
+    {
+      // Explicitly use litte-endian encoding in size prefix
+      const uint64_t s = htole64(static_cast<uint64_t>(uncompressedSize));
+      memcpy(&compressed[0], &s, sizeof(uint64_t));
+    }
+
+    compressed.resize(offset + compressedSize);
+  }
+
+
+  void ZstdCompressor::Uncompress(std::string& uncompressed,
+                                  const void* compressed,
+                                  size_t compressedSize)
+  {
+    if (compressedSize == 0)
+    {
+      uncompressed.clear();
+      return;
+    }
+
+    const size_t offset = (prefixWithUncompressedSize_ ? sizeof(uint64_t) : 0);
+
+    uint64_t uncompressedSize;
+
+    if (prefixWithUncompressedSize_)
+    {
+      if (compressedSize < sizeof(uint64_t))
+      {
+        throw OrthancException(ErrorCode_CorruptedFile, "The compressed buffer is ill-formed");
+      }
+
+      memcpy(&uncompressedSize, compressed, sizeof(uint64_t));
+      uncompressedSize = le64toh(uncompressedSize);
+    }
+    else
+    {
+      // The size is read from the header of the zstd frame
+      const unsigned long long s = ZSTD_getFrameContentSize(compressed, compressedSize);
+      if (s == ZSTD_CONTENTSIZE_UNKNOWN ||
+          s == ZSTD_CONTENTSIZE_ERROR)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile, "The compressed buffer is ill-formed");
+      }
+
+      uncompressedSize = static_cast<uint64_t>(s);
+    }
+
+    if (static_cast<uint64_t>(static_cast<size_t>(uncompressedSize)) != uncompressedSize)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    try
+    {
+      uncompressed.resize(static_cast<size_t>(uncompressedSize));
+    }
+    catch (...)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    if (uncompressedSize == 0)
+    {
+      return;
+    }
+
+    const size_t size = ZSTD_decompress(&uncompressed[0], uncompressed.size(),
+                                        reinterpret_cast<const uint8_t*>(compressed) + offset,
+                                        compressedSize - offset);
+
+    if (ZSTD_isError(size) ||
+        size != uncompressed.size())
+    {
+      uncompressed.clear();
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+  }
+}
@@ -0,0 +1,381 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeaders.h"
+#include "CpuProfiler.h"
+
+#include "OrthancException.h"
+
+#if ORTHANC_ENABLE_CPU_PROFILER == 1 && defined(__linux__)
+#  define ORTHANC_HAS_CPU_PROFILER 1
+#else
+#  define ORTHANC_HAS_CPU_PROFILER 0
+#endif
+
+#if ORTHANC_HAS_CPU_PROFILER == 1
+#  include "Logging.h"
+#  include "SystemToolbox.h"
+
+#  include <algorithm>
+#  include <boost/atomic.hpp>
+#  include <boost/lexical_cast.hpp>
+#  include <boost/thread.hpp>
+#  include <cxxabi.h>
+#  include <dlfcn.h>
+#  include <errno.h>
+#  include <execinfo.h>
+#  include <map>
+#  include <signal.h>
+#  include <stdio.h>
+#  include <stdlib.h>
+#  include <string.h>
+#  include <sys/syscall.h>
+#  include <sys/time.h>
+#  include <unistd.h>
+#  include <vector>
+#endif
+
+
+namespace Orthanc
+{
+#if ORTHANC_HAS_CPU_PROFILER == 1
+  static const size_t THREAD_NAME_SIZE = 16;  // Same limit as in "Logging"
+  static const int    MAX_STACK_DEPTH = 48;
+  static const int    SKIPPED_FRAMES = 2;     // The signal handler, and the trampoline of the kernel
+  static const size_t MAX_SAMPLES = 65536;
+
+  namespace
+  {
+    struct Sample
+    {
+      char   threadName_[THREAD_NAME_SIZE + 1];
+      pid_t  threadId_;
+      int    depth_;
+      void*  frames_[MAX_STACK_DEPTH];
+    };
+  }
+
+  // The "initial-exec" model guarantees that the signal handler
+  // never allocates memory while accessing this thread-local name
+  static __thread char currentThreadName_[THREAD_NAME_SIZE + 1] __attribute__((tls_model("initial-exec")));
+
+  static boost::mutex           profileMutex_;
+  static Sample*                samples_ = NULL;
+  static size_t                 samplesCapacity_ = 0;
+  static boost::atomic<size_t>  samplesCount_(0);
+  static boost::atomic<bool>    recording_(false);
+  static boost::atomic<int>     activeHandlers_(0);
+
+
+  // Only async-signal-safe functions can be used here ("backtrace()"
+  // is safe once it has been called outside of the handler)
+  static void SignalHandler(int /* signal */,
+                            siginfo_t* /* info */,
+                            void* /* context */)
+  {
+    const int savedErrno = errno;
+    activeHandlers_.fetch_add(1);
+
+    if (recording_.load())
+    {
+      const size_t index = samplesCount_.fetch_add(1);
+      if (index < samplesCapacity_)
+      {
+        Sample& sample = samples_[index];
+        memcpy(sample.threadName_, currentThreadName_, sizeof(sample.threadName_));
+        sample.threadName_[THREAD_NAME_SIZE] = '\0';
+        sample.threadId_ = static_cast<pid_t>(syscall(SYS_gettid));
+        sample.depth_ = backtrace(sample.frames_, MAX_STACK_DEPTH);
+      }
+    }
+
+    activeHandlers_.fetch_sub(1);
+    errno = savedErrno;
+  }
+
+
+  static std::string FormatAddress(const void* address)
+  {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "0x%lx", static_cast<unsigned long>(reinterpret_cast<uintptr_t>(address)));
+    return buffer;
+  }
+
+
+  static std::string GetFunctionName(const void* address)
+  {
+    Dl_info info;
+    if (dladdr(address, &info) == 0)
+    {
+      return "[" + FormatAddress(address) + "]";
+    }
+    else if (info.dli_sname != NULL)
+    {
+      int status;
+      char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+
+      if (demangled == NULL)
+      {
+        return info.dli_sname;
+      }
+      else
+      {
+        std::string s(demangled);
+        free(demangled);
+        return s;
+      }
+    }
+    else if (info.dli_fname != NULL)
+    {
+      // Not an exported symbol: Report the offset in the module
+      const char* module = strrchr(info.dli_fname, '/');
+      return (std::string(module == NULL ? info.dli_fname : module + 1) + "+" +
+              FormatAddress(reinterpret_cast<const void*>(reinterpret_cast<uintptr_t>(address) -
+                                                          reinterpret_cast<uintptr_t>(info.dli_fbase))));
+    }
+    else
+    {
+      return "[" + FormatAddress(address) + "]";
+    }
+  }
+
+
+  namespace
+  {
+    // Stops the sampling even if the recording thread is interrupted
+    class Recording : public boost::noncopyable
+    {
+    private:
+      struct sigaction  previous_;
+
+    public:
+      explicit Recording(unsigned int frequency)
+      {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = SignalHandler;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+
+        if (sigaction(SIGPROF, &action, &previous_) != 0)
+        {
+          throw OrthancException(ErrorCode_InternalError, "Cannot install the handler of SIGPROF");
+        }
+
+        if (!(previous_.sa_flags & SA_SIGINFO) &&
+            previous_.sa_handler != SIG_DFL &&
+            previous_.sa_handler != SIG_IGN)
+        {
+          // Another profiler (e.g. gprof) is using SIGPROF
+          sigaction(SIGPROF, &previous_, NULL);
+          throw OrthancException(ErrorCode_BadSequenceOfCalls, "SIGPROF is already used by another profiler");
+        }
+
+        const long period = 1000000l / static_cast<long>(frequency);  // In microseconds
+
+        struct itimerval timer;
+        timer.it_interval.tv_sec = period / 1000000l;
+        timer.it_interval.tv_usec = period % 1000000l;
+        timer.it_value = timer.it_interval;
+
+        recording_ = true;
+
+        if (setitimer(ITIMER_PROF, &timer, NULL) != 0)
+        {
+          recording_ = false;
+          sigaction(SIGPROF, &previous_, NULL);
+          throw OrthancException(ErrorCode_InternalError, "Cannot start the profiling timer");
+        }
+      }
+
+      ~Recording()
+      {
+        struct itimerval timer;
+        memset(&timer, 0, sizeof(timer));
+        setitimer(ITIMER_PROF, &timer, NULL);
+
+        recording_ = false;
+
+        // Discard the pending signals before restoring the previous
+        // handler, whose default action would terminate the process
+        struct sigaction ignore;
+        memset(&ignore, 0, sizeof(ignore));
+        ignore.sa_handler = SIG_IGN;
+        sigemptyset(&ignore.sa_mask);
+        sigaction(SIGPROF, &ignore, NULL);
+
+        while (activeHandlers_.load() > 0)
+        {
+          boost::this_thread::yield();
+        }
+
+        sigaction(SIGPROF, &previous_, NULL);
+      }
+    };
+  }
+
+
+  static void FormatCollapsedStacks(std::string& target,
+                                    size_t count)
+  {
+    typedef std::map<const void*, std::string>  Symbols;
+    typedef std::map<std::string, uint64_t>     Stacks;
+
+    Symbols symbols;
+    Stacks stacks;
+
+    for (size_t i = 0; i < count; i++)
+    {
+      const Sample& sample = samples_[i];
+
+      std::string stack = sample.threadName_;
+      if (stack.empty())
+      {
+        stack = "thread-" + boost::lexical_cast<std::string>(sample.threadId_);
+      }
+
+      // From the root of the stack to the interrupted function
+      for (int j = sample.depth_ - 1; j >= SKIPPED_FRAMES; j--)
+      {
+        // The return addresses point to the instruction after the
+        // call, which might belong to the next function
+        const void* address = (j == SKIPPED_FRAMES ? sample.frames_[j] :
+                               reinterpret_cast<const char*>(sample.frames_[j]) - 1);
+
+        Symbols::const_iterator found = symbols.find(address);
+        if (found == symbols.end())
+        {
+          std::string name = GetFunctionName(address);
+          std::replace(name.begin(), name.end(), ';', ':');  // ";" separates the frames
+          found = symbols.insert(std::make_pair(address, name)).first;
+        }
+
+        stack += ";" + found->second;
+      }
+
+      stacks[stack] += 1;
+    }
+
+    target.clear();
+
+    for (Stacks::const_iterator it = stacks.begin(); it != stacks.end(); ++it)
+    {
+      target += it->first + " " + boost::lexical_cast<std::string>(it->second) + "\n";
+    }
+  }
+#endif
+
+
+  const unsigned int CpuProfiler::MAX_DURATION;
+  const unsigned int CpuProfiler::MAX_FREQUENCY;
+
+
+  bool CpuProfiler::IsAvailable()
+  {
+#if ORTHANC_HAS_CPU_PROFILER == 1
+    return true;
+#else
+    return false;
+#endif
+  }
+
+
+  void CpuProfiler::Profile(std::string& collapsedStacks,
+                            unsigned int duration,
+                            unsigned int frequency)
+  {
+#if ORTHANC_HAS_CPU_PROFILER == 1
+    if (duration == 0 ||
+        duration > MAX_DURATION)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The duration of a CPU profile must be between 1 and " +
+                             boost::lexical_cast<std::string>(MAX_DURATION) + " seconds");
+    }
+
+    if (frequency == 0 ||
+        frequency > MAX_FREQUENCY)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The sampling frequency of a CPU profile must be between 1 and " +
+                             boost::lexical_cast<std::string>(MAX_FREQUENCY) + " Hz");
+    }
+
+    boost::unique_lock<boost::mutex> lock(profileMutex_, boost::try_to_lock);
+    if (!lock.owns_lock())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "Another CPU profile is being recorded");
+    }
+
+    // The signals are generated at the given frequency for each CPU
+    // that is busy running Orthanc
+    const uint64_t expected = (static_cast<uint64_t>(duration) * static_cast<uint64_t>(frequency) *
+                               static_cast<uint64_t>(std::max(1u, SystemToolbox::GetHardwareConcurrency())));
+
+    std::vector<Sample> samples(static_cast<size_t>(std::min(expected, static_cast<uint64_t>(MAX_SAMPLES))));
+
+    {
+      // Load the unwinder before the first signal
+      void* warmup[1];
+      backtrace(warmup, 1);
+    }
+
+    samples_ = &samples[0];
+    samplesCapacity_ = samples.size();
+    samplesCount_ = 0;
+
+    LOG(WARNING) << "Recording a CPU profile during " << duration << " seconds at " << frequency << " Hz";
+
+    {
+      Recording recording(frequency);
+      boost::this_thread::sleep(boost::posix_time::seconds(duration));
+    }
+
+    const size_t count = samplesCount_.load();
+
+    if (count > samplesCapacity_)
+    {
+      LOG(WARNING) << "The CPU profile is truncated, " << (count - samplesCapacity_) << " samples were dropped";
+    }
+
+    FormatCollapsedStacks(collapsedStacks, std::min(count, samplesCapacity_));
+
+    samples_ = NULL;
+    samplesCapacity_ = 0;
+
+    LOG(INFO) << "The CPU profile contains " << std::min(count, samples.size()) << " samples";
+#else
+    throw OrthancException(ErrorCode_NotImplemented, "The CPU profiler is only available on Linux, "
+                           "if the framework is built with the ENABLE_CPU_PROFILER CMake option");
+#endif
+  }
+
+
+  void CpuProfiler::SetCurrentThreadName(const std::string& name)
+  {
+#if ORTHANC_HAS_CPU_PROFILER == 1
+    const size_t size = std::min(name.size(), THREAD_NAME_SIZE);
+    memcpy(currentThreadName_, name.c_str(), size);
+    currentThreadName_[size] = '\0';
+#endif
+  }
+}
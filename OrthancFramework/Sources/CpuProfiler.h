@@ -0,0 +1,74 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "OrthancFramework.h"
+
+#if !defined(ORTHANC_ENABLE_CPU_PROFILER)
+#  error The macro ORTHANC_ENABLE_CPU_PROFILER must be defined
+#endif
+
+#include <boost/noncopyable.hpp>
+#include <string>
+
+
+namespace Orthanc
+{
+  /**
+   * Sampling CPU profiler that can be triggered at runtime, without
+   * attaching an external tool to the process (new in Orthanc
+   * 1.12.12). While a profile is recorded, the kernel interrupts the
+   * threads that consume CPU time at a fixed frequency ("SIGPROF"
+   * signal), and the call stack of the interrupted thread is saved
+   * together with the name of the thread, as set by
+   * "Logging::SetCurrentThreadName()". The profile is formatted as
+   * collapsed stacks ("thread;caller;callee count" lines), that can
+   * be directly turned into flame graphs.
+   *
+   * The profiler is only available on Linux, if the framework is
+   * built with the "ENABLE_CPU_PROFILER" CMake option. The function
+   * names are only resolved for the symbols that are exported, which
+   * requires linking with "-rdynamic" for the executable itself.
+   **/
+  class ORTHANC_PUBLIC CpuProfiler : public boost::noncopyable
+  {
+  public:
+    static const unsigned int MAX_DURATION = 300;  // In seconds
+
+    static const unsigned int MAX_FREQUENCY = 1000;  // In Hz
+
+    static bool IsAvailable();
+
+    // Blocks the calling thread for "duration" seconds. Only one
+    // profile can be recorded at once.
+    static void Profile(std::string& collapsedStacks,
+                        unsigned int duration,
+                        unsigned int frequency);
+
+    // Invoked by "Logging", an empty name clears the name of the
+    // calling thread
+    static void SetCurrentThreadName(const std::string& name);
+  };
+}
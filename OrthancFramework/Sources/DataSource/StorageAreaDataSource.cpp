@@ -31,7 +31,7 @@
 #include "DataSourceReader.h"
 
 #if ORTHANC_ENABLE_ZLIB == 1
-#  include "../Compression/ZlibCompressor.h"
+#  include "../Compression/IBufferCompressor.h"
 #endif
 
 #include <boost/lexical_cast.hpp>
@@ -227,12 +227,14 @@ namespace Orthanc
           return range.release();
 
         case CompressionType_ZlibWithSize:
+        case CompressionType_ZstdWithSize:
+        case CompressionType_Lz4WithSize:
         {
 #if ORTHANC_ENABLE_ZLIB == 1
-          ZlibCompressor zlib;
+          std::unique_ptr<IBufferCompressor> compressor(IBufferCompressor::Create(attachment.GetCompressionType()));
 
           std::string content;
-          zlib.Uncompress(content, range->GetData(), range->GetSize());
+          compressor->Uncompress(content, range->GetData(), range->GetSize());
 
           if (checkMD5)
           {
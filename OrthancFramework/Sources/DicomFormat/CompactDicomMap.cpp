@@ -0,0 +1,276 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "CompactDicomMap.h"
+
+#include "../OrthancException.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+namespace Orthanc
+{
+  namespace
+  {
+    class EntryComparator
+    {
+    public:
+      template <typename EntryType>
+      bool operator() (const EntryType& entry,
+                       const DicomTag& tag) const
+      {
+        return entry.tag_ < tag;
+      }
+    };
+  }
+
+
+  const CompactDicomMap::Entry* CompactDicomMap::Find(const DicomTag& tag) const
+  {
+    std::vector<Entry>::const_iterator found =
+      std::lower_bound(entries_.begin(), entries_.end(), tag, EntryComparator());
+
+    if (found != entries_.end() &&
+        found->tag_ == tag)
+    {
+      return &(*found);
+    }
+    else
+    {
+      return NULL;
+    }
+  }
+
+
+  const CompactDicomMap::Entry& CompactDicomMap::GetEntry(size_t index) const
+  {
+    if (index >= entries_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      return entries_[index];
+    }
+  }
+
+
+  void CompactDicomMap::SetInternal(const DicomTag& tag,
+                                    ValueType type,
+                                    const void* data,
+                                    size_t size)
+  {
+    const size_t offset = arena_.size();
+
+    if (size > 0)
+    {
+      arena_.append(reinterpret_cast<const char*>(data), size);
+    }
+
+    const Entry entry(tag, type, offset, size);
+
+    if (entries_.empty() ||
+        entries_.back().tag_ < tag)
+    {
+      // Most frequent case, as the tags are usually added in increasing order
+      entries_.push_back(entry);
+    }
+    else
+    {
+      std::vector<Entry>::iterator found =
+        std::lower_bound(entries_.begin(), entries_.end(), tag, EntryComparator());
+
+      if (found != entries_.end() &&
+          found->tag_ == tag)
+      {
+        *found = entry;
+      }
+      else
+      {
+        entries_.insert(found, entry);
+      }
+    }
+  }
+
+
+  void CompactDicomMap::Clear()
+  {
+    entries_.clear();
+    arena_.clear();
+  }
+
+
+  void CompactDicomMap::Reserve(size_t countTags,
+                                size_t countBytes)
+  {
+    entries_.reserve(countTags);
+    arena_.reserve(countBytes);
+  }
+
+
+  void CompactDicomMap::SetNullValue(const DicomTag& tag)
+  {
+    SetInternal(tag, ValueType_Null, NULL, 0);
+  }
+
+
+  void CompactDicomMap::SetValue(const DicomTag& tag,
+                                 const std::string& value,
+                                 bool isBinary)
+  {
+    SetInternal(tag, isBinary ? ValueType_Binary : ValueType_String,
+                value.empty() ? NULL : value.c_str(), value.size());
+  }
+
+
+  void CompactDicomMap::Remove(const DicomTag& tag)
+  {
+    std::vector<Entry>::iterator found =
+      std::lower_bound(entries_.begin(), entries_.end(), tag, EntryComparator());
+
+    if (found != entries_.end() &&
+        found->tag_ == tag)
+    {
+      entries_.erase(found);
+    }
+  }
+
+
+  bool CompactDicomMap::LookupStringValue(std::string& result,
+                                          const DicomTag& tag,
+                                          bool allowBinary) const
+  {
+    const Entry* entry = Find(tag);
+
+    if (entry == NULL ||
+        entry->type_ == ValueType_Null ||
+        (entry->type_ == ValueType_Binary && !allowBinary))
+    {
+      return false;
+    }
+    else
+    {
+      result.assign(arena_, entry->offset_, entry->size_);
+      return true;
+    }
+  }
+
+
+  void CompactDicomMap::GetValue(std::string& target,
+                                 size_t index) const
+  {
+    const Entry& entry = GetEntry(index);
+
+    if (entry.type_ == ValueType_Null)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      target.assign(arena_, entry.offset_, entry.size_);
+    }
+  }
+
+
+  void CompactDicomMap::Assign(const DicomMap& source)
+  {
+    Clear();
+
+    const DicomMap::Content& content = source.content_;
+
+    size_t countBytes = 0;
+    for (DicomMap::Content::const_iterator it = content.begin(); it != content.end(); ++it)
+    {
+      assert(it->second != NULL);
+      if (it->second->IsSequence())
+      {
+        Clear();
+        throw OrthancException(ErrorCode_NotImplemented, "The sequences cannot be stored in a compact DICOM map");
+      }
+      else if (!it->second->IsNull())
+      {
+        countBytes += it->second->GetContent().size();
+      }
+    }
+
+    Reserve(content.size(), countBytes);
+
+    // The source is sorted by tags, so "SetInternal()" always appends
+    for (DicomMap::Content::const_iterator it = content.begin(); it != content.end(); ++it)
+    {
+      if (it->second->IsNull())
+      {
+        SetNullValue(it->first);
+      }
+      else
+      {
+        SetValue(it->first, it->second->GetContent(), it->second->IsBinary());
+      }
+    }
+  }
+
+
+  void CompactDicomMap::Export(DicomMap& target) const
+  {
+    for (size_t i = 0; i < entries_.size(); i++)
+    {
+      const Entry& entry = entries_[i];
+
+      if (entry.type_ == ValueType_Null)
+      {
+        target.SetNullValue(entry.tag_);
+      }
+      else
+      {
+        target.SetValue(entry.tag_, arena_.substr(entry.offset_, entry.size_),
+                        entry.type_ == ValueType_Binary);
+      }
+    }
+  }
+
+
+  bool CompactDicomMap::CopyTagIfExists(DicomMap& target,
+                                        const DicomTag& tag) const
+  {
+    const Entry* entry = Find(tag);
+
+    if (entry == NULL)
+    {
+      return false;
+    }
+    else if (entry->type_ == ValueType_Null)
+    {
+      target.SetNullValue(tag);
+      return true;
+    }
+    else
+    {
+      target.SetValue(tag, arena_.substr(entry->offset_, entry->size_),
+                      entry->type_ == ValueType_Binary);
+      return true;
+    }
+  }
+}
@@ -0,0 +1,152 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "DicomMap.h"
+
+#include <vector>
+
+
+namespace Orthanc
+{
+  /**
+   * Compact variant of "DicomMap", for the read-mostly paths that
+   * keep the tags of many resources in memory. The tags are stored
+   * in a vector that is sorted by tag, and all the values share one
+   * memory arena, which avoids one heap allocation per tag. Only the
+   * null, string and binary values are supported, not the sequences.
+   * Replacing a value does not release its previous bytes in the
+   * arena (new in Orthanc 1.12.12).
+   **/
+  class ORTHANC_PUBLIC CompactDicomMap : public boost::noncopyable
+  {
+  private:
+    enum ValueType
+    {
+      ValueType_Null,
+      ValueType_String,
+      ValueType_Binary
+    };
+
+    struct Entry
+    {
+      DicomTag   tag_;
+      ValueType  type_;
+      size_t     offset_;  // In "arena_"
+      size_t     size_;
+
+      Entry(const DicomTag& tag,
+            ValueType type,
+            size_t offset,
+            size_t size) :
+        tag_(tag),
+        type_(type),
+        offset_(offset),
+        size_(size)
+      {
+      }
+    };
+
+    std::vector<Entry>  entries_;
+    std::string         arena_;
+
+    const Entry* Find(const DicomTag& tag) const;
+
+    const Entry& GetEntry(size_t index) const;
+
+    void SetInternal(const DicomTag& tag,
+                     ValueType type,
+                     const void* data,
+                     size_t size);
+
+  public:
+    void Clear();
+
+    void Reserve(size_t countTags,
+                 size_t countBytes);
+
+    size_t GetSize() const
+    {
+      return entries_.size();
+    }
+
+    bool IsEmpty() const
+    {
+      return entries_.empty();
+    }
+
+    void SetNullValue(const DicomTag& tag);
+
+    void SetValue(const DicomTag& tag,
+                  const std::string& value,
+                  bool isBinary);
+
+    bool HasTag(const DicomTag& tag) const
+    {
+      return Find(tag) != NULL;
+    }
+
+    void Remove(const DicomTag& tag);
+
+    // Same semantics as "DicomMap::LookupStringValue()"
+    bool LookupStringValue(std::string& result,
+                           const DicomTag& tag,
+                           bool allowBinary) const;
+
+    // The tags are sorted by increasing values
+    const DicomTag& GetTag(size_t index) const
+    {
+      return GetEntry(index).tag_;
+    }
+
+    bool IsNull(size_t index) const
+    {
+      return GetEntry(index).type_ == ValueType_Null;
+    }
+
+    bool IsBinary(size_t index) const
+    {
+      return GetEntry(index).type_ == ValueType_Binary;
+    }
+
+    void GetValue(std::string& target,
+                  size_t index) const;
+
+    // Throws "ErrorCode_NotImplemented" if "source" contains sequences
+    void Assign(const DicomMap& source);
+
+    // Adds the tags to "target", replacing the existing values
+    void Export(DicomMap& target) const;
+
+    // Returns "false" if the tag is absent from this map
+    bool CopyTagIfExists(DicomMap& target,
+                         const DicomTag& tag) const;
+
+    size_t GetArenaSize() const
+    {
+      return arena_.size();
+    }
+  };
+}
@@ -0,0 +1,519 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "DicomFrameOffsets.h"
+
+#include "../OrthancException.h"
+
+#include <cassert>
+#include <limits>
+
+
+// Version of the binary format of "DicomFrameOffsets::Serialize()"
+static const uint8_t SERIALIZATION_VERSION = 1;
+
+static const uint8_t FLAG_ENCAPSULATED = 0x01;
+static const uint8_t FLAG_EXPLICIT_VR = 0x02;
+
+// Version (1 byte), flags (1 byte), VR (2 bytes), number of fragments (4 bytes), number of frames (4 bytes)
+static const size_t SERIALIZATION_HEADER_SIZE = 12;
+
+// Offset (8 bytes) and size (4 bytes) of one fragment
+static const size_t SERIALIZATION_FRAGMENT_SIZE = 12;
+
+
+namespace Orthanc
+{
+  static uint16_t ReadUInt16(const uint8_t* p)
+  {
+    return (static_cast<uint16_t>(p[0]) |
+            static_cast<uint16_t>(p[1]) << 8);
+  }
+
+
+  static uint32_t ReadUInt32(const uint8_t* p)
+  {
+    return (static_cast<uint32_t>(p[0]) |
+            static_cast<uint32_t>(p[1]) << 8 |
+            static_cast<uint32_t>(p[2]) << 16 |
+            static_cast<uint32_t>(p[3]) << 24);
+  }
+
+
+  static uint64_t ReadUInt64(const uint8_t* p)
+  {
+    return (static_cast<uint64_t>(ReadUInt32(p)) |
+            static_cast<uint64_t>(ReadUInt32(p + 4)) << 32);
+  }
+
+
+  static void WriteUInt16(std::string& target,
+                          uint16_t value)
+  {
+    target.push_back(static_cast<char>(value & 0xff));
+    target.push_back(static_cast<char>((value >> 8) & 0xff));
+  }
+
+
+  static void WriteUInt32(std::string& target,
+                          uint32_t value)
+  {
+    WriteUInt16(target, static_cast<uint16_t>(value & 0xffff));
+    WriteUInt16(target, static_cast<uint16_t>(value >> 16));
+  }
+
+
+  static void WriteUInt64(std::string& target,
+                          uint64_t value)
+  {
+    WriteUInt32(target, static_cast<uint32_t>(value & 0xffffffffu));
+    WriteUInt32(target, static_cast<uint32_t>(value >> 32));
+  }
+
+
+  static void WriteElementHeader(std::string& target,
+                                 uint16_t group,
+                                 uint16_t element,
+                                 uint32_t length)
+  {
+    WriteUInt16(target, group);
+    WriteUInt16(target, element);
+    WriteUInt32(target, length);
+  }
+
+
+  void DicomFrameOffsets::Clear()
+  {
+    encapsulated_ = false;
+    explicitVR_ = false;
+    vr_.clear();
+    fragments_.clear();
+    firstFragment_.clear();
+  }
+
+
+  bool DicomFrameOffsets::ParseEncapsulated(const uint8_t* dicom,
+                                            size_t size,
+                                            size_t position,
+                                            unsigned int countFrames)
+  {
+    // Loop over the items of the pixel sequence, the first one being
+    // the basic offset table
+    std::vector<Fragment> items;
+
+    for (;;)
+    {
+      if (position > size ||
+          size - position < 8)
+      {
+        return false;
+      }
+
+      const uint16_t group = ReadUInt16(dicom + position);
+      const uint16_t element = ReadUInt16(dicom + position + 2);
+      const uint32_t length = ReadUInt32(dicom + position + 4);
+
+      if (group == 0xfffe &&
+          element == 0xe0dd)
+      {
+        break;   // Sequence delimitation item
+      }
+
+      if (group != 0xfffe ||
+          element != 0xe000 ||
+          length > size - position - 8)
+      {
+        return false;
+      }
+
+      Fragment item;
+      item.offset_ = position + 8;
+      item.size_ = length;
+      items.push_back(item);
+
+      position += 8 + static_cast<size_t>(length);
+    }
+
+    if (items.empty() ||
+        items.size() - 1 < countFrames)
+    {
+      return false;
+    }
+
+    const Fragment table = items[0];
+    fragments_.assign(items.begin() + 1, items.end());
+    firstFragment_.resize(countFrames);
+
+    if (fragments_.size() == countFrames)
+    {
+      // Simple case: There is one fragment per frame
+      for (unsigned int i = 0; i < countFrames; i++)
+      {
+        firstFragment_[i] = i;
+      }
+
+      return true;
+    }
+
+    if (countFrames == 1)
+    {
+      // The single frame overlaps all the fragments
+      firstFragment_[0] = 0;
+      return true;
+    }
+
+    // Use the basic offset table. The extended offset table is not
+    // supported, which is the case if the basic table is empty.
+    if (table.size_ != 4 * countFrames ||
+        ReadUInt32(dicom + table.offset_) != 0)
+    {
+      return false;
+    }
+
+    // Same algorithm as in "DicomFrameIndex::FragmentIndex", where 8
+    // bytes is the overhead for the item tag and length field
+    unsigned int frame = 0;
+    uint64_t offset = 0;
+
+    for (size_t i = 0; i < fragments_.size(); i++)
+    {
+      if (frame < countFrames)
+      {
+        const uint32_t start = ReadUInt32(dicom + table.offset_ + 4 * frame);
+
+        if (offset == start)
+        {
+          firstFragment_[frame] = i;
+          frame++;
+        }
+        else if (offset > start)
+        {
+          return false;  // The offset table doesn't match the fragments
+        }
+      }
+
+      offset += 8 + static_cast<uint64_t>(fragments_[i].size_);
+    }
+
+    return (frame == countFrames);
+  }
+
+
+  const DicomFrameOffsets::Fragment& DicomFrameOffsets::GetFragment(unsigned int frame,
+                                                                    size_t index) const
+  {
+    if (index >= GetFragmentsCount(frame))
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      return fragments_[firstFragment_[frame] + index];
+    }
+  }
+
+
+  DicomFrameOffsets::DicomFrameOffsets()
+  {
+    Clear();
+  }
+
+
+  bool DicomFrameOffsets::Parse(const void* dicom,
+                                size_t size,
+                                uint64_t pixelDataOffset,
+                                bool explicitVR,
+                                unsigned int countFrames,
+                                size_t frameSize)
+  {
+    Clear();
+
+    if (countFrames == 0 ||
+        pixelDataOffset >= static_cast<uint64_t>(size) ||
+        size - static_cast<size_t>(pixelDataOffset) < 12)
+    {
+      return false;
+    }
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(dicom);
+    size_t position = static_cast<size_t>(pixelDataOffset);
+
+    if (ReadUInt16(p + position) != 0x7fe0 ||
+        ReadUInt16(p + position + 2) != 0x0010)
+    {
+      return false;
+    }
+
+    uint32_t length;
+
+    if (explicitVR)
+    {
+      vr_.assign(reinterpret_cast<const char*>(p + position + 4), 2);
+      if ((vr_ != "OB" && vr_ != "OW") ||
+          ReadUInt16(p + position + 6) != 0)
+      {
+        Clear();
+        return false;
+      }
+
+      length = ReadUInt32(p + position + 8);
+      position += 12;
+    }
+    else
+    {
+      // Implicit Little Endian has always "OW" VR for pixel data
+      vr_ = "OW";
+      length = ReadUInt32(p + position + 4);
+      position += 8;
+    }
+
+    explicitVR_ = explicitVR;
+
+    if (length == 0xffffffffu)
+    {
+      encapsulated_ = true;
+
+      if (ParseEncapsulated(p, size, position, countFrames))
+      {
+        return true;
+      }
+      else
+      {
+        Clear();
+        return false;
+      }
+    }
+    else
+    {
+      if (frameSize == 0 ||
+          static_cast<uint64_t>(frameSize) > std::numeric_limits<uint32_t>::max() ||
+          static_cast<uint64_t>(length) > static_cast<uint64_t>(size - position) ||
+          static_cast<uint64_t>(frameSize) * static_cast<uint64_t>(countFrames) > static_cast<uint64_t>(length))
+      {
+        Clear();
+        return false;
+      }
+
+      fragments_.resize(countFrames);
+      firstFragment_.resize(countFrames);
+
+      for (unsigned int i = 0; i < countFrames; i++)
+      {
+        fragments_[i].offset_ = static_cast<uint64_t>(position) + static_cast<uint64_t>(i) * static_cast<uint64_t>(frameSize);
+        fragments_[i].size_ = static_cast<uint32_t>(frameSize);
+        firstFragment_[i] = i;
+      }
+
+      return true;
+    }
+  }
+
+
+  size_t DicomFrameOffsets::GetFragmentsCount(unsigned int frame) const
+  {
+    if (frame >= firstFragment_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else if (frame + 1 == firstFragment_.size())
+    {
+      return fragments_.size() - firstFragment_[frame];
+    }
+    else
+    {
+      return firstFragment_[frame + 1] - firstFragment_[frame];
+    }
+  }
+
+
+  uint64_t DicomFrameOffsets::GetFragmentOffset(unsigned int frame,
+                                                size_t index) const
+  {
+    return GetFragment(frame, index).offset_;
+  }
+
+
+  uint32_t DicomFrameOffsets::GetFragmentSize(unsigned int frame,
+                                              size_t index) const
+  {
+    return GetFragment(frame, index).size_;
+  }
+
+
+  uint64_t DicomFrameOffsets::GetFrameSize(unsigned int frame) const
+  {
+    const size_t count = GetFragmentsCount(frame);
+
+    uint64_t size = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      size += fragments_[firstFragment_[frame] + i].size_;
+    }
+
+    return size;
+  }
+
+
+  void DicomFrameOffsets::FormatSingleFramePixelData(std::string& target,
+                                                     const std::string& frame) const
+  {
+    if (firstFragment_.empty())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    // The length of the DICOM values must be even
+    const bool padding = (frame.size() % 2 == 1);
+
+    if (static_cast<uint64_t>(frame.size()) + 1 >= static_cast<uint64_t>(std::numeric_limits<uint32_t>::max()))
+    {
+      throw OrthancException(ErrorCode_NotImplemented, "Frame is too large");
+    }
+
+    const uint32_t length = static_cast<uint32_t>(frame.size() + (padding ? 1 : 0));
+
+    target.clear();
+    target.reserve(frame.size() + 40);
+
+    WriteUInt16(target, 0x7fe0);
+    WriteUInt16(target, 0x0010);
+
+    const uint32_t elementLength = (encapsulated_ ? 0xffffffffu : length);
+
+    if (explicitVR_)
+    {
+      target.append(encapsulated_ ? "OB" : vr_);
+      WriteUInt16(target, 0);
+    }
+
+    WriteUInt32(target, elementLength);
+
+    if (encapsulated_)
+    {
+      WriteElementHeader(target, 0xfffe, 0xe000, 0);  // Empty basic offset table
+      WriteElementHeader(target, 0xfffe, 0xe000, length);
+    }
+
+    target.append(frame);
+
+    if (padding)
+    {
+      target.push_back('\0');
+    }
+
+    if (encapsulated_)
+    {
+      WriteElementHeader(target, 0xfffe, 0xe0dd, 0);  // Sequence delimitation item
+    }
+  }
+
+
+  void DicomFrameOffsets::Serialize(std::string& target) const
+  {
+    if (fragments_.size() > std::numeric_limits<uint32_t>::max())
+    {
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+
+    target.clear();
+    target.reserve(SERIALIZATION_HEADER_SIZE + fragments_.size() * SERIALIZATION_FRAGMENT_SIZE +
+                   firstFragment_.size() * 4);
+
+    target.push_back(static_cast<char>(SERIALIZATION_VERSION));
+    target.push_back(static_cast<char>((encapsulated_ ? FLAG_ENCAPSULATED : 0) |
+                                       (explicitVR_ ? FLAG_EXPLICIT_VR : 0)));
+    target.append(vr_.size() == 2 ? vr_ : std::string("OB"));
+    WriteUInt32(target, static_cast<uint32_t>(fragments_.size()));
+    WriteUInt32(target, static_cast<uint32_t>(firstFragment_.size()));
+
+    for (size_t i = 0; i < fragments_.size(); i++)
+    {
+      WriteUInt64(target, fragments_[i].offset_);
+      WriteUInt32(target, fragments_[i].size_);
+    }
+
+    for (size_t i = 0; i < firstFragment_.size(); i++)
+    {
+      WriteUInt32(target, static_cast<uint32_t>(firstFragment_[i]));
+    }
+  }
+
+
+  void DicomFrameOffsets::Unserialize(const std::string& source)
+  {
+    Clear();
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(source.c_str());
+
+    if (source.size() < SERIALIZATION_HEADER_SIZE ||
+        p[0] != SERIALIZATION_VERSION)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Invalid index of the frames");
+    }
+
+    const uint32_t countFragments = ReadUInt32(p + 4);
+    const uint32_t countFrames = ReadUInt32(p + 8);
+
+    if (static_cast<uint64_t>(source.size()) !=
+        static_cast<uint64_t>(SERIALIZATION_HEADER_SIZE) +
+        static_cast<uint64_t>(countFragments) * static_cast<uint64_t>(SERIALIZATION_FRAGMENT_SIZE) +
+        static_cast<uint64_t>(countFrames) * 4u)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Invalid index of the frames");
+    }
+
+    DicomFrameOffsets tmp;
+    tmp.encapsulated_ = ((p[1] & FLAG_ENCAPSULATED) != 0);
+    tmp.explicitVR_ = ((p[1] & FLAG_EXPLICIT_VR) != 0);
+    tmp.vr_.assign(source, 2, 2);
+    tmp.fragments_.resize(countFragments);
+    tmp.firstFragment_.resize(countFrames);
+
+    const uint8_t* q = p + SERIALIZATION_HEADER_SIZE;
+
+    for (uint32_t i = 0; i < countFragments; i++, q += SERIALIZATION_FRAGMENT_SIZE)
+    {
+      tmp.fragments_[i].offset_ = ReadUInt64(q);
+      tmp.fragments_[i].size_ = ReadUInt32(q + 8);
+    }
+
+    for (uint32_t i = 0; i < countFrames; i++, q += 4)
+    {
+      tmp.firstFragment_[i] = ReadUInt32(q);
+
+      if (tmp.firstFragment_[i] >= countFragments ||
+          (i > 0 && tmp.firstFragment_[i] <= tmp.firstFragment_[i - 1]))
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Invalid index of the frames");
+      }
+    }
+
+    encapsulated_ = tmp.encapsulated_;
+    explicitVR_ = tmp.explicitVR_;
+    vr_.swap(tmp.vr_);
+    fragments_.swap(tmp.fragments_);
+    firstFragment_.swap(tmp.firstFragment_);
+  }
+}
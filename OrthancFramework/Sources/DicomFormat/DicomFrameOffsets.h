@@ -0,0 +1,121 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * Location of the frames of a DICOM instance inside its file, as
+   * computed from the raw bytes of the pixel data element, without
+   * parsing the file with DCMTK. This index allows to read one frame
+   * of a large multi-frame instance by range requests to the storage
+   * area. Only the little endian transfer syntaxes are supported. New
+   * in Orthanc 1.12.12.
+   **/
+  class ORTHANC_PUBLIC DicomFrameOffsets : public boost::noncopyable
+  {
+  private:
+    struct Fragment
+    {
+      uint64_t  offset_;
+      uint32_t  size_;
+    };
+
+    bool                   encapsulated_;
+    bool                   explicitVR_;
+    std::string            vr_;  // "OB" or "OW", only for uncompressed pixel data
+    std::vector<Fragment>  fragments_;
+    std::vector<size_t>    firstFragment_;  // Index of the first fragment of each frame
+
+    void Clear();
+
+    bool ParseEncapsulated(const uint8_t* dicom,
+                           size_t size,
+                           size_t position,
+                           unsigned int countFrames);
+
+    const Fragment& GetFragment(unsigned int frame,
+                                size_t index) const;
+
+  public:
+    DicomFrameOffsets();
+
+    /**
+     * "pixelDataOffset" is the offset of the pixel data tag (as
+     * provided by "DicomStreamReader::LookupPixelDataOffset()"), and
+     * "frameSize" is the size of one uncompressed frame (as provided
+     * by "DicomImageInformation::GetFrameSize()"). Returns "false" if
+     * the layout of the pixel data is not supported.
+     **/
+    bool Parse(const void* dicom,
+               size_t size,
+               uint64_t pixelDataOffset,
+               bool explicitVR,
+               unsigned int countFrames,
+               size_t frameSize);
+
+    unsigned int GetFramesCount() const
+    {
+      return static_cast<unsigned int>(firstFragment_.size());
+    }
+
+    bool IsEncapsulated() const
+    {
+      return encapsulated_;
+    }
+
+    size_t GetFragmentsCount(unsigned int frame) const;
+
+    uint64_t GetFragmentOffset(unsigned int frame,
+                               size_t index) const;
+
+    uint32_t GetFragmentSize(unsigned int frame,
+                             size_t index) const;
+
+    // Size of the frame, once its fragments are concatenated
+    uint64_t GetFrameSize(unsigned int frame) const;
+
+    /**
+     * Creates the pixel data element of a single-frame instance
+     * containing "frame", in the same encoding as the indexed
+     * file. Appending this element to the bytes preceding the pixel
+     * data of the indexed file, and setting "NumberOfFrames" to 1,
+     * gives a valid DICOM instance.
+     **/
+    void FormatSingleFramePixelData(std::string& target,
+                                    const std::string& frame) const;
+
+    void Serialize(std::string& target) const;
+
+    void Unserialize(const std::string& source);
+  };
+}
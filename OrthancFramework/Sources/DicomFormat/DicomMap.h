@@ -41,6 +41,7 @@ namespace Orthanc
 
   private:
     class MainDicomTagsConfiguration;
+    friend class CompactDicomMap;
     friend class DicomArray;
     friend class FromDcmtkBridge;
     friend class ParsedDicomFile;
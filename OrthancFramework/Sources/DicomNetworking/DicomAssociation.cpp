@@ -32,6 +32,7 @@
 #include "../Compatibility.h"
 #include "../Logging.h"
 #include "../OrthancException.h"
+#include "DicomNetworkMetrics.h"
 #include "NetworkingCompatibility.h"
 
 #ifdef _WIN32
@@ -371,7 +372,15 @@ namespace Orthanc
     }
 
     // Do the association
-    CheckConnecting(parameters, ASC_requestAssociation(net_, params_, &assoc_));
+    OFCondition cond;
+
+    {
+      DicomNetworkMetrics::Timer timer("orthanc_dicom_scu_association_setup_ms",
+                                       parameters.GetRemoteModality().GetApplicationEntityTitle());
+      cond = ASC_requestAssociation(net_, params_, &assoc_);
+    }
+
+    CheckConnecting(parameters, cond);
     isOpen_ = true;
 
     {
@@ -592,6 +601,9 @@ namespace Orthanc
   {
     if (cond.bad())
     {
+      DicomNetworkMetrics::AddNetworkFailure(true, (command == "connecting" ? "A-ASSOCIATE" : command),
+                                             parameters.GetRemoteModality().GetApplicationEntityTitle());
+
       // Reformat the error message from DCMTK by turning multiline
       // errors into a single line
       
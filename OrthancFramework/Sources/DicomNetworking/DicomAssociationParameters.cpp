@@ -36,6 +36,8 @@
 
 #include <boost/lexical_cast.hpp>
 #include <boost/thread/mutex.hpp>
+#include <limits>
+#include <stdlib.h>  // For setenv()
 
 // By default, the default timeout for client DICOM connections is set to 10 seconds
 static boost::mutex  defaultConfigurationMutex_;
@@ -47,9 +49,26 @@ static unsigned int  defaultMaximumPduLength_ = ASC_DEFAULTMAXPDU;
 static bool          defaultRemoteCertificateRequired_ = true;
 static unsigned int  minimumTlsVersion_ = 0;
 static std::set<std::string> acceptedCiphers_;
+static unsigned int  socketBufferSize_ = 0;
+static bool          tcpNoDelay_ = true;
 
 namespace Orthanc
 {
+  static void SetEnvironmentVariable(const std::string& name,
+                                     const std::string& value)  // An empty value unsets the variable
+  {
+#if defined(_WIN32)
+    const std::string s = name + "=" + value;
+    if (_putenv(s.c_str()) != 0)
+#else
+    if ((value.empty() ? unsetenv(name.c_str()) : setenv(name.c_str(), value.c_str(), 1)) != 0)
+#endif
+    {
+      throw OrthancException(ErrorCode_InternalError, "Cannot set environment variable: " + name);
+    }
+  }
+
+
   void DicomAssociationParameters::CheckHost(const std::string& host)
   {
     if (host.size() > HOST_NAME_MAX - 10)
@@ -125,6 +144,11 @@ namespace Orthanc
       timeout_ = remote.GetTimeout();
       assert(timeout_ != 0);
     }
+
+    if (remote.HasMaximumPduLength())
+    {
+      maximumPduLength_ = remote.GetMaximumPduLength();
+    }
   }
 
   void DicomAssociationParameters::SetRemoteApplicationEntityTitle(const std::string &aet)
@@ -520,4 +544,39 @@ namespace Orthanc
     boost::mutex::scoped_lock lock(defaultConfigurationMutex_);
     return defaultRemoteCertificateRequired_;
   }
+
+
+  void DicomAssociationParameters::SetSocketBufferSize(unsigned int bytes)
+  {
+    if (bytes > static_cast<unsigned int>(std::numeric_limits<int>::max()))
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Socket buffer size is too large");
+    }
+
+    boost::mutex::scoped_lock lock(defaultConfigurationMutex_);
+    SetEnvironmentVariable("TCP_BUFFER_LENGTH", bytes == 0 ? "" : boost::lexical_cast<std::string>(bytes));
+    socketBufferSize_ = bytes;
+  }
+
+
+  unsigned int DicomAssociationParameters::GetSocketBufferSize()
+  {
+    boost::mutex::scoped_lock lock(defaultConfigurationMutex_);
+    return socketBufferSize_;
+  }
+
+
+  void DicomAssociationParameters::SetTcpNoDelay(bool enabled)
+  {
+    boost::mutex::scoped_lock lock(defaultConfigurationMutex_);
+    SetEnvironmentVariable("TCP_NODELAY", enabled ? "1" : "0");
+    tcpNoDelay_ = enabled;
+  }
+
+
+  bool DicomAssociationParameters::IsTcpNoDelay()
+  {
+    boost::mutex::scoped_lock lock(defaultConfigurationMutex_);
+    return tcpNoDelay_;
+  }
 }
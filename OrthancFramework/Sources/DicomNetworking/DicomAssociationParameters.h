@@ -125,6 +125,25 @@ namespace Orthanc
 
     static unsigned int GetDefaultMaximumPduLength();
 
+    /**
+     * Size of the TCP send and receive buffers of the DICOM sockets,
+     * for both Orthanc SCU and Orthanc SCP. DCMTK reads this value
+     * from the "TCP_BUFFER_LENGTH" environment variable whenever a
+     * connection is established, and uses 32KB if the variable is
+     * unset, which corresponds to the value "0". As the environment
+     * is not thread-safe, this must be set before any association.
+     **/
+    static void SetSocketBufferSize(unsigned int bytes);
+
+    static unsigned int GetSocketBufferSize();
+
+    // Whether to disable the Nagle algorithm on the DICOM sockets
+    // (TCP_NODELAY), which is the default of DCMTK. Same remark as
+    // for "SetSocketBufferSize()".
+    static void SetTcpNoDelay(bool enabled);
+
+    static bool IsTcpNoDelay();
+
     static void SetDefaultRemoteCertificateRequired(bool required);
 
     static bool GetDefaultRemoteCertificateRequired();
@@ -0,0 +1,374 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "DicomAssociationQuotas.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+
+namespace Orthanc
+{
+  class DicomAssociationQuotas::QuotaClass : public boost::noncopyable
+  {
+  private:
+    std::string            name_;
+    unsigned int           maxAssociations_;
+    unsigned int           maxAssociationsPerAet_;
+    std::set<std::string>  callingAets_;
+    std::set<std::string>  hosts_;
+    unsigned int           active_;
+    ActivePerAet           activePerAet_;
+    uint64_t               rejected_;
+
+  public:
+    QuotaClass(const std::string& name,
+               unsigned int maxAssociations,
+               unsigned int maxAssociationsPerAet,
+               const std::set<std::string>& callingAets,
+               const std::set<std::string>& hosts) :
+      name_(name),
+      maxAssociations_(maxAssociations),
+      maxAssociationsPerAet_(maxAssociationsPerAet),
+      callingAets_(callingAets),
+      hosts_(hosts),
+      active_(0),
+      rejected_(0)
+    {
+    }
+
+    const std::string& GetName() const
+    {
+      return name_;
+    }
+
+    void SetLimits(unsigned int maxAssociations,
+                   unsigned int maxAssociationsPerAet)
+    {
+      maxAssociations_ = maxAssociations;
+      maxAssociationsPerAet_ = maxAssociationsPerAet;
+    }
+
+    bool IsMember(const std::string& remoteAet,
+                  const std::string& remoteIp) const
+    {
+      return (callingAets_.find(remoteAet) != callingAets_.end() ||
+              hosts_.find(remoteIp) != hosts_.end());
+    }
+
+    bool HasRoom(const std::string& remoteAet) const
+    {
+      if (maxAssociations_ != 0 &&
+          active_ >= maxAssociations_)
+      {
+        return false;
+      }
+
+      if (maxAssociationsPerAet_ != 0)
+      {
+        ActivePerAet::const_iterator found = activePerAet_.find(remoteAet);
+        if (found != activePerAet_.end() &&
+            found->second >= maxAssociationsPerAet_)
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    void Add(const std::string& remoteAet)
+    {
+      active_++;
+      activePerAet_[remoteAet]++;
+    }
+
+    void Remove(const std::string& remoteAet)
+    {
+      ActivePerAet::iterator found = activePerAet_.find(remoteAet);
+      if (active_ == 0 ||
+          found == activePerAet_.end())
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      active_--;
+
+      if (found->second == 1)
+      {
+        activePerAet_.erase(found);
+      }
+      else
+      {
+        found->second--;
+      }
+    }
+
+    void Reject()
+    {
+      rejected_++;
+    }
+
+    unsigned int GetActiveAssociations() const
+    {
+      return active_;
+    }
+
+    uint64_t GetRejectedAssociations() const
+    {
+      return rejected_;
+    }
+  };
+
+
+  DicomAssociationQuotas::Slot::Slot(DicomAssociationQuotas& that,
+                                     QuotaClass& quotaClass,
+                                     const std::string& remoteAet) :
+    that_(that),
+    quotaClass_(quotaClass),
+    remoteAet_(remoteAet)
+  {
+  }
+
+
+  DicomAssociationQuotas::Slot::~Slot()
+  {
+    try
+    {
+      that_.Release(quotaClass_, remoteAet_);
+    }
+    catch (OrthancException& e)
+    {
+      CLOG(ERROR, DICOM) << "Cannot release an association quota: " << e.What();
+    }
+  }
+
+
+  const std::string& DicomAssociationQuotas::Slot::GetClassName() const
+  {
+    return quotaClass_.GetName();
+  }
+
+
+  DicomAssociationQuotas::QuotaClass& DicomAssociationQuotas::LookupClass(const std::string& remoteAet,
+                                                                          const std::string& remoteIp) const
+  {
+    assert(!classes_.empty());
+
+    for (size_t i = 1; i < classes_.size(); i++)
+    {
+      assert(classes_[i] != NULL);
+      if (classes_[i]->IsMember(remoteAet, remoteIp))
+      {
+        return *classes_[i];
+      }
+    }
+
+    return *classes_[0];
+  }
+
+
+  const DicomAssociationQuotas::QuotaClass& DicomAssociationQuotas::GetClassByName(const std::string& className) const
+  {
+    for (size_t i = 0; i < classes_.size(); i++)
+    {
+      assert(classes_[i] != NULL);
+      if (classes_[i]->GetName() == className)
+      {
+        return *classes_[i];
+      }
+    }
+
+    throw OrthancException(ErrorCode_InexistentItem, "Unknown association quota class: " + className);
+  }
+
+
+  void DicomAssociationQuotas::UpdateMetrics(const QuotaClass& quotaClass)
+  {
+    if (metrics_ != NULL)
+    {
+      metrics_->SetIntegerValue("orthanc_dicom_associations_active_" + quotaClass.GetName(),
+                                quotaClass.GetActiveAssociations());
+      metrics_->SetIntegerValue("orthanc_dicom_associations_rejected_" + quotaClass.GetName(),
+                                static_cast<int64_t>(quotaClass.GetRejectedAssociations()));
+    }
+  }
+
+
+  void DicomAssociationQuotas::Release(QuotaClass& quotaClass,
+                                       const std::string& remoteAet)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      quotaClass.Remove(remoteAet);
+      UpdateMetrics(quotaClass);
+    }
+
+    released_.notify_all();
+  }
+
+
+  DicomAssociationQuotas::DicomAssociationQuotas() :
+    waitTimeout_(0),
+    metrics_(NULL)
+  {
+    classes_.push_back(new QuotaClass("default", 0, 0, std::set<std::string>(), std::set<std::string>()));
+  }
+
+
+  DicomAssociationQuotas::~DicomAssociationQuotas()
+  {
+    for (size_t i = 0; i < classes_.size(); i++)
+    {
+      assert(classes_[i] != NULL);
+      delete classes_[i];
+    }
+  }
+
+
+  void DicomAssociationQuotas::SetDefaultClass(unsigned int maxAssociations,
+                                               unsigned int maxAssociationsPerAet)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    classes_[0]->SetLimits(maxAssociations, maxAssociationsPerAet);
+  }
+
+
+  void DicomAssociationQuotas::AddClass(const std::string& name,
+                                        unsigned int maxAssociations,
+                                        unsigned int maxAssociationsPerAet,
+                                        const std::set<std::string>& callingAets,
+                                        const std::set<std::string>& hosts)
+  {
+    if (name.empty())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The name of an association quota class cannot be empty");
+    }
+
+    for (size_t i = 0; i < name.size(); i++)
+    {
+      // The name is part of the name of the metrics
+      if (!isalnum(name[i]) &&
+          name[i] != '_')
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange,
+                               "The name of an association quota class can only contain alphanumeric characters and underscores: " + name);
+      }
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    for (size_t i = 0; i < classes_.size(); i++)
+    {
+      if (classes_[i]->GetName() == name)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls, "Association quota class defined twice: " + name);
+      }
+    }
+
+    classes_.push_back(new QuotaClass(name, maxAssociations, maxAssociationsPerAet, callingAets, hosts));
+  }
+
+
+  void DicomAssociationQuotas::SetWaitTimeout(unsigned int milliseconds)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    waitTimeout_ = milliseconds;
+  }
+
+
+  unsigned int DicomAssociationQuotas::GetWaitTimeout() const
+  {
+    return waitTimeout_;
+  }
+
+
+  void DicomAssociationQuotas::SetMetricsRegistry(MetricsRegistry& metrics)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    metrics_ = &metrics;
+
+    for (size_t i = 0; i < classes_.size(); i++)
+    {
+      UpdateMetrics(*classes_[i]);
+    }
+  }
+
+
+  DicomAssociationQuotas::Slot* DicomAssociationQuotas::Acquire(const std::string& remoteAet,
+                                                                const std::string& remoteIp)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    QuotaClass& quotaClass = LookupClass(remoteAet, remoteIp);
+
+    if (!quotaClass.HasRoom(remoteAet) &&
+        waitTimeout_ != 0)
+    {
+      const boost::system_time deadline = (boost::get_system_time() +
+                                           boost::posix_time::milliseconds(waitTimeout_));
+
+      while (!quotaClass.HasRoom(remoteAet))
+      {
+        if (!released_.timed_wait(lock, deadline))
+        {
+          break;
+        }
+      }
+    }
+
+    if (quotaClass.HasRoom(remoteAet))
+    {
+      quotaClass.Add(remoteAet);
+      UpdateMetrics(quotaClass);
+      return new Slot(*this, quotaClass, remoteAet);
+    }
+    else
+    {
+      quotaClass.Reject();
+      UpdateMetrics(quotaClass);
+
+      CLOG(WARNING, DICOM) << "Association quota of class \"" << quotaClass.GetName()
+                           << "\" is exhausted for AET " << remoteAet << " on IP " << remoteIp;
+      return NULL;
+    }
+  }
+
+
+  unsigned int DicomAssociationQuotas::GetActiveAssociations(const std::string& className)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return GetClassByName(className).GetActiveAssociations();
+  }
+
+
+  uint64_t DicomAssociationQuotas::GetRejectedAssociations(const std::string& className)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return GetClassByName(className).GetRejectedAssociations();
+  }
+}
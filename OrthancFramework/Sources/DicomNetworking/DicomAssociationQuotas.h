@@ -0,0 +1,123 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../MetricsRegistry.h"
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * Admission control for the associations that are accepted by the
+   * DICOM server. The remote modalities are grouped into classes,
+   * each with its own budget of concurrent associations: This makes
+   * it possible to reserve capacity for critical modalities (e.g. the
+   * ER scanners), whose class is not shared with the other callers.
+   * The modalities that do not belong to any class are accounted in
+   * the "default" class. In every class, the number of concurrent
+   * associations from one calling AET can also be bounded.
+   **/
+  class ORTHANC_PUBLIC DicomAssociationQuotas : public boost::noncopyable
+  {
+  private:
+    class QuotaClass;
+
+    typedef std::map<std::string, unsigned int>  ActivePerAet;
+
+    boost::mutex                 mutex_;
+    boost::condition_variable    released_;
+    std::vector<QuotaClass*>     classes_;   // The first one is "default"
+    unsigned int                 waitTimeout_;
+    MetricsRegistry*             metrics_;
+
+    QuotaClass& LookupClass(const std::string& remoteAet,
+                            const std::string& remoteIp) const;
+
+    // Mutex must be locked
+    const QuotaClass& GetClassByName(const std::string& className) const;
+
+    // Mutex must be locked
+    void UpdateMetrics(const QuotaClass& quotaClass);
+
+    void Release(QuotaClass& quotaClass,
+                 const std::string& remoteAet);
+
+  public:
+    // The slot of one accepted association, released on destruction
+    class ORTHANC_PUBLIC Slot : public boost::noncopyable
+    {
+    private:
+      DicomAssociationQuotas&  that_;
+      QuotaClass&              quotaClass_;
+      std::string              remoteAet_;
+
+    public:
+      Slot(DicomAssociationQuotas& that,
+           QuotaClass& quotaClass,
+           const std::string& remoteAet);
+
+      ~Slot();
+
+      const std::string& GetClassName() const;
+    };
+
+    DicomAssociationQuotas();
+
+    ~DicomAssociationQuotas();
+
+    // "0" means no limit
+    void SetDefaultClass(unsigned int maxAssociations,
+                         unsigned int maxAssociationsPerAet);
+
+    // The "callingAets" and "hosts" are the members of the class
+    void AddClass(const std::string& name,
+                  unsigned int maxAssociations,
+                  unsigned int maxAssociationsPerAet,
+                  const std::set<std::string>& callingAets,
+                  const std::set<std::string>& hosts);
+
+    // Time to wait, in milliseconds, before rejecting an association
+    // whose class is saturated ("0" means immediate rejection)
+    void SetWaitTimeout(unsigned int milliseconds);
+
+    unsigned int GetWaitTimeout() const;
+
+    void SetMetricsRegistry(MetricsRegistry& metrics);
+
+    // Returns NULL if the association must be rejected because of congestion
+    Slot* Acquire(const std::string& remoteAet,
+                  const std::string& remoteIp);
+
+    // Number of the active associations in one class (for tests and metrics)
+    unsigned int GetActiveAssociations(const std::string& className);
+
+    uint64_t GetRejectedAssociations(const std::string& className);
+  };
+}
@@ -32,6 +32,7 @@
 #include "../Logging.h"
 #include "../OrthancException.h"
 #include "DicomAssociation.h"
+#include "DicomNetworkMetrics.h"
 
 #include <dcmtk/dcmdata/dcdeftag.h>
 #include <dcmtk/dcmnet/diutil.h>
@@ -354,15 +355,21 @@ namespace Orthanc
                          << s.str();
     }
 
-    OFCondition cond = DIMSE_findUser(
-      &association_->GetDcmtkAssociation(), presID, &request, dataset,
+    OFCondition cond;
+
+    {
+      DicomNetworkMetrics::Timer timer("orthanc_dicom_scu_c_find_duration_ms",
+                                       parameters_.GetRemoteModality().GetApplicationEntityTitle());
+      cond = DIMSE_findUser(
+        &association_->GetDcmtkAssociation(), presID, &request, dataset,
 #if DCMTK_VERSION_NUMBER >= 364
-      responseCount,
+        responseCount,
 #endif
-      FindCallback, &payload,
-      /*opt_blockMode*/ (parameters_.HasTimeout() ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
-      /*opt_dimse_timeout*/ static_cast<int>(parameters_.GetTimeout()),
-      &response, &statusDetail);
+        FindCallback, &payload,
+        /*opt_blockMode*/ (parameters_.HasTimeout() ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
+        /*opt_dimse_timeout*/ static_cast<int>(parameters_.GetTimeout()),
+        &response, &statusDetail);
+    }
     
     if (statusDetail)
     {
@@ -370,6 +377,8 @@ namespace Orthanc
     }
 
     DicomAssociation::CheckCondition(cond, parameters_, "C-FIND");
+    DicomNetworkMetrics::AddDimseStatus(true, "C-FIND", parameters_.GetRemoteModality().GetApplicationEntityTitle(),
+                                        response.DimseStatus);
 
     {
       OFString str;
@@ -475,13 +484,19 @@ namespace Orthanc
     T_DIMSE_C_MoveRSP response;
     DcmDataset* statusDetail = NULL;
     DcmDataset* responseIdentifiers = NULL;
-    OFCondition cond = DIMSE_moveUser(
-      &association_->GetDcmtkAssociation(), presID, &request, dataset, 
-      (progressListener_ != NULL ? MoveProgressCallback : NULL), progressListener_,
-      /*opt_blockMode*/ (parameters_.HasTimeout() ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
-      /*opt_dimse_timeout*/ static_cast<int>(parameters_.GetTimeout()),
-      &association_->GetDcmtkNetwork(), /*subOpCallback*/ NULL, NULL,
-      &response, &statusDetail, &responseIdentifiers);
+    OFCondition cond;
+
+    {
+      DicomNetworkMetrics::Timer timer("orthanc_dicom_scu_c_move_duration_ms",
+                                       parameters_.GetRemoteModality().GetApplicationEntityTitle());
+      cond = DIMSE_moveUser(
+        &association_->GetDcmtkAssociation(), presID, &request, dataset, 
+        (progressListener_ != NULL ? MoveProgressCallback : NULL), progressListener_,
+        /*opt_blockMode*/ (parameters_.HasTimeout() ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
+        /*opt_dimse_timeout*/ static_cast<int>(parameters_.GetTimeout()),
+        &association_->GetDcmtkNetwork(), /*subOpCallback*/ NULL, NULL,
+        &response, &statusDetail, &responseIdentifiers);
+    }
 
     if (statusDetail)
     {
@@ -494,6 +509,8 @@ namespace Orthanc
     }
 
     DicomAssociation::CheckCondition(cond, parameters_, "C-MOVE");
+    DicomNetworkMetrics::AddDimseStatus(true, "C-MOVE", parameters_.GetRemoteModality().GetApplicationEntityTitle(),
+                                        response.DimseStatus);
 
     {
       OFString str;
@@ -150,6 +150,32 @@ namespace Orthanc
   }
 
 
+  size_t DicomFindAnswers::GetMemoryUsage() const
+  {
+    // Fixed overhead per answer for the DCMTK objects, on top of the
+    // encoded size of the datasets, which is a rough estimate of the
+    // memory that is used by the values of the tags
+    static const size_t OVERHEAD_PER_ANSWER = 1024;
+
+    size_t result = 0;
+
+    for (size_t i = 0; i < answers_.size(); i++)
+    {
+      assert(answers_[i] != NULL);
+      DcmDataset* dataset = answers_[i]->GetDcmtkObject().getDataset();
+
+      result += OVERHEAD_PER_ANSWER;
+
+      if (dataset != NULL)
+      {
+        result += dataset->getLength(EXS_LittleEndianExplicit);
+      }
+    }
+
+    return result;
+  }
+
+
   ParsedDicomFile& DicomFindAnswers::GetAnswer(size_t index) const
   {
     if (index < answers_.size())
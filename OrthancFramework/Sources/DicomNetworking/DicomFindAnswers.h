@@ -76,6 +76,10 @@ namespace Orthanc
 
     size_t GetSize() const;
 
+    // Estimate of the memory that is used by the answers, in bytes
+    // (new in Orthanc 1.12.12)
+    size_t GetMemoryUsage() const;
+
     ParsedDicomFile& GetAnswer(size_t index) const;
 
     DcmDataset* ExtractDcmDataset(size_t index) const;
@@ -0,0 +1,177 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "DicomNetworkMetrics.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <stdio.h>
+
+
+namespace Orthanc
+{
+  static boost::mutex      registryMutex_;
+  static MetricsRegistry*  registry_ = NULL;
+
+
+  static std::string FormatName(const std::string& name,
+                                const std::string& labels)
+  {
+    return name + "{" + labels + "}";
+  }
+
+
+  static std::string FormatStatus(bool isScu,
+                                  const std::string& operation,
+                                  const std::string& remoteAet,
+                                  const std::string& status)
+  {
+    return FormatName(isScu ? "orthanc_dicom_scu_failures_total" : "orthanc_dicom_scp_failures_total",
+                      (DicomNetworkMetrics::FormatLabel("aet", remoteAet) + "," +
+                       DicomNetworkMetrics::FormatLabel("operation", operation) + "," +
+                       DicomNetworkMetrics::FormatLabel("status", status)));
+  }
+
+
+  struct DicomNetworkMetrics::Timer::PImpl
+  {
+    boost::posix_time::ptime  start_;
+  };
+
+
+  DicomNetworkMetrics::Timer::Timer(const std::string& name,
+                                    const std::string& remoteAet) :
+    pimpl_(new PImpl),
+    name_(name),
+    remoteAet_(remoteAet)
+  {
+    pimpl_->start_ = boost::posix_time::microsec_clock::universal_time();
+  }
+
+
+  DicomNetworkMetrics::Timer::~Timer()
+  {
+    boost::posix_time::time_duration diff = boost::posix_time::microsec_clock::universal_time() - pimpl_->start_;
+    AddDuration(name_, remoteAet_, static_cast<double>(diff.total_microseconds()) / 1000.0);
+    delete pimpl_;
+  }
+
+
+  void DicomNetworkMetrics::SetRegistry(MetricsRegistry& registry)
+  {
+    boost::mutex::scoped_lock lock(registryMutex_);
+    registry_ = &registry;
+  }
+
+
+  void DicomNetworkMetrics::ResetRegistry()
+  {
+    boost::mutex::scoped_lock lock(registryMutex_);
+    registry_ = NULL;
+  }
+
+
+  std::string DicomNetworkMetrics::FormatLabel(const std::string& name,
+                                               const std::string& value)
+  {
+    return MetricsRegistry::FormatPrometheusLabel(name, value);
+  }
+
+
+  void DicomNetworkMetrics::IncrementCounter(const std::string& name,
+                                             const std::string& remoteAet,
+                                             int64_t delta)
+  {
+    boost::mutex::scoped_lock lock(registryMutex_);
+
+    if (registry_ != NULL &&
+        registry_->IsEnabled())
+    {
+      registry_->IncrementIntegerValue(FormatName(name, FormatLabel("aet", remoteAet)), delta);
+    }
+  }
+
+
+  void DicomNetworkMetrics::AddDuration(const std::string& name,
+                                        const std::string& remoteAet,
+                                        double milliseconds)
+  {
+    boost::mutex::scoped_lock lock(registryMutex_);
+
+    if (registry_ != NULL &&
+        registry_->IsEnabled())
+    {
+      registry_->AddHistogramSample(name, FormatLabel("aet", remoteAet), MetricsRegistry::GetDefaultDurationBuckets(), milliseconds);
+    }
+  }
+
+
+  bool DicomNetworkMetrics::IsFailure(uint16_t status)
+  {
+    // http://dicom.nema.org/medical/dicom/current/output/chtml/part07/chapter_C.html
+    return (status != 0x0000 /* Success */ &&
+            status != 0x0001 /* Warning - Requested optional attributes are not supported */ &&
+            status != 0x0107 /* Warning - Attribute list error */ &&
+            status != 0x0111 /* Warning - Duplicate SOP instance UID */ &&
+            status != 0xFF00 /* Pending */ &&
+            status != 0xFF01 /* Pending - Optional keys not supported */ &&
+            (status & 0xF000) != 0xB000 /* Warning */);
+  }
+
+
+  void DicomNetworkMetrics::AddDimseStatus(bool isScu,
+                                           const std::string& operation,
+                                           const std::string& remoteAet,
+                                           uint16_t status)
+  {
+    if (IsFailure(status))
+    {
+      char buf[16];
+      sprintf(buf, "0x%04X", status);
+
+      boost::mutex::scoped_lock lock(registryMutex_);
+
+      if (registry_ != NULL &&
+          registry_->IsEnabled())
+      {
+        registry_->IncrementIntegerValue(FormatStatus(isScu, operation, remoteAet, buf), 1);
+      }
+    }
+  }
+
+
+  void DicomNetworkMetrics::AddNetworkFailure(bool isScu,
+                                              const std::string& operation,
+                                              const std::string& remoteAet)
+  {
+    boost::mutex::scoped_lock lock(registryMutex_);
+
+    if (registry_ != NULL &&
+        registry_->IsEnabled())
+    {
+      registry_->IncrementIntegerValue(FormatStatus(isScu, operation, remoteAet, "network"), 1);
+    }
+  }
+}
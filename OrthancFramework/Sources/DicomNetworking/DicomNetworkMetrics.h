@@ -0,0 +1,114 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../MetricsRegistry.h"
+
+#include <boost/noncopyable.hpp>
+#include <string>
+#include <stdint.h>
+
+namespace Orthanc
+{
+  /**
+   * Process-wide collection of the metrics of the DICOM network
+   * (both SCP and SCU), labeled by the AET of the remote modality.
+   * The metrics are only collected once a registry is installed,
+   * which is done by the Orthanc server at startup. The names of the
+   * metrics embed their Prometheus labels, and the durations are
+   * exported as Prometheus histograms (in milliseconds).
+   **/
+  class ORTHANC_PUBLIC DicomNetworkMetrics : public boost::noncopyable
+  {
+  public:
+    // Measures the lifetime of the object as a duration
+    class ORTHANC_PUBLIC Timer : public boost::noncopyable
+    {
+    private:
+      struct PImpl;  // To hold "boost::posix_time::ptime  start_"
+      PImpl*       pimpl_;
+      std::string  name_;
+      std::string  remoteAet_;
+
+    public:
+      Timer(const std::string& name,
+            const std::string& remoteAet);
+
+      ~Timer();
+    };
+
+    // Copies the DIMSE status of a response once its callback returns
+    class ORTHANC_PUBLIC StatusObserver : public boost::noncopyable
+    {
+    private:
+      uint16_t&        target_;
+      const uint16_t&  source_;
+
+    public:
+      StatusObserver(uint16_t& target,
+                     const uint16_t& source) :
+        target_(target),
+        source_(source)
+      {
+      }
+
+      ~StatusObserver()
+      {
+        target_ = source_;
+      }
+    };
+
+    static void SetRegistry(MetricsRegistry& registry);
+
+    static void ResetRegistry();
+
+    static std::string FormatLabel(const std::string& name,
+                                   const std::string& value);
+
+    static void IncrementCounter(const std::string& name,
+                                 const std::string& remoteAet,
+                                 int64_t delta);
+
+    static void AddDuration(const std::string& name,
+                            const std::string& remoteAet,
+                            double milliseconds);
+
+    // Whether a DIMSE status is neither "Success", "Pending", nor a warning
+    static bool IsFailure(uint16_t status);
+
+    // Only the failure statuses are counted, in the metrics
+    // "orthanc_dicom_{scp|scu}_failures_total"
+    static void AddDimseStatus(bool isScu,
+                               const std::string& operation,
+                               const std::string& remoteAet,
+                               uint16_t status);
+
+    // Failure that has no DIMSE status (network error, timeout...)
+    static void AddNetworkFailure(bool isScu,
+                                  const std::string& operation,
+                                  const std::string& remoteAet);
+  };
+}
@@ -0,0 +1,177 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "DicomPresentationContextsHistory.h"
+
+#include "../OrthancException.h"
+
+#include <boost/lexical_cast.hpp>
+
+
+namespace Orthanc
+{
+  DicomPresentationContextsHistory::DicomPresentationContextsHistory(size_t maxModalities) :
+    maxModalities_(maxModalities)
+  {
+    if (maxModalities == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  DicomPresentationContextsHistory::~DicomPresentationContextsHistory()
+  {
+    Clear();
+  }
+
+
+  DicomPresentationContextsHistory& DicomPresentationContextsHistory::GetGlobalInstance()
+  {
+    static DicomPresentationContextsHistory instance(256);
+    return instance;
+  }
+
+
+  std::string DicomPresentationContextsHistory::FormatKey(const DicomAssociationParameters& parameters)
+  {
+    // The accepted presentation contexts might depend on the calling AET
+    const RemoteModalityParameters& remote = parameters.GetRemoteModality();
+    return (parameters.GetLocalApplicationEntityTitle() + "|" +
+            remote.GetApplicationEntityTitle() + "|" +
+            remote.GetHost() + "|" +
+            boost::lexical_cast<std::string>(remote.GetPortNumber()));
+  }
+
+
+  void DicomPresentationContextsHistory::SetMaxModalities(size_t maxModalities)
+  {
+    if (maxModalities == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    maxModalities_ = maxModalities;
+
+    while (modalities_.GetSize() > maxModalities_)
+    {
+      AcceptedClasses* oldest = NULL;
+      modalities_.RemoveOldest(oldest);
+      delete oldest;
+    }
+  }
+
+
+  size_t DicomPresentationContextsHistory::GetMaxModalities()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return maxModalities_;
+  }
+
+
+  void DicomPresentationContextsHistory::Record(const std::string& modality,
+                                                const std::string& sopClassUid,
+                                                const std::set<DicomTransferSyntax>& acceptedSyntaxes)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    AcceptedClasses* classes = NULL;
+    if (modalities_.Contains(modality, classes))
+    {
+      modalities_.MakeMostRecent(modality);
+    }
+    else
+    {
+      while (modalities_.GetSize() >= maxModalities_)
+      {
+        AcceptedClasses* oldest = NULL;
+        modalities_.RemoveOldest(oldest);
+        delete oldest;
+      }
+
+      classes = new AcceptedClasses;
+      modalities_.Add(modality, classes);
+    }
+
+    assert(classes != NULL);
+    (*classes) [sopClassUid] = acceptedSyntaxes;
+  }
+
+
+  bool DicomPresentationContextsHistory::Lookup(std::set<DicomTransferSyntax>& acceptedSyntaxes,
+                                                const std::string& modality,
+                                                const std::string& sopClassUid)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    AcceptedClasses* classes = NULL;
+    if (modalities_.Contains(modality, classes))
+    {
+      assert(classes != NULL);
+
+      AcceptedClasses::const_iterator found = classes->find(sopClassUid);
+      if (found != classes->end())
+      {
+        acceptedSyntaxes = found->second;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  void DicomPresentationContextsHistory::Forget(const std::string& modality)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (modalities_.Contains(modality))
+    {
+      delete modalities_.Invalidate(modality);
+    }
+  }
+
+
+  void DicomPresentationContextsHistory::Clear()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    while (!modalities_.IsEmpty())
+    {
+      AcceptedClasses* oldest = NULL;
+      modalities_.RemoveOldest(oldest);
+      delete oldest;
+    }
+  }
+
+
+  size_t DicomPresentationContextsHistory::GetModalitiesCount()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return modalities_.GetSize();
+  }
+}
@@ -0,0 +1,86 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Cache/LeastRecentlyUsedIndex.h"
+#include "DicomAssociationParameters.h"
+
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <set>
+
+namespace Orthanc
+{
+  /**
+   * Process-wide history of the presentation contexts that were
+   * accepted by the remote modalities during the previous C-STORE
+   * associations (SOP class UID -> accepted transfer syntaxes). This
+   * history is used by "DicomStoreUserConnection" to only propose the
+   * presentation contexts that have a chance to be accepted, which
+   * leaves room for more SOP classes in the 128 presentation
+   * contexts of one association. Only the least recently negotiated
+   * modalities are forgotten.
+   **/
+  class ORTHANC_PUBLIC DicomPresentationContextsHistory : public boost::noncopyable
+  {
+  private:
+    typedef std::map<std::string, std::set<DicomTransferSyntax> >  AcceptedClasses;
+    typedef LeastRecentlyUsedIndex<std::string, AcceptedClasses*>  Modalities;
+
+    boost::mutex  mutex_;
+    Modalities    modalities_;
+    size_t        maxModalities_;
+
+  public:
+    explicit DicomPresentationContextsHistory(size_t maxModalities);
+
+    ~DicomPresentationContextsHistory();
+
+    static DicomPresentationContextsHistory& GetGlobalInstance();
+
+    static std::string FormatKey(const DicomAssociationParameters& parameters);
+
+    void SetMaxModalities(size_t maxModalities);
+
+    size_t GetMaxModalities();
+
+    // An empty set of syntaxes means that the SOP class was rejected
+    void Record(const std::string& modality,
+                const std::string& sopClassUid,
+                const std::set<DicomTransferSyntax>& acceptedSyntaxes);
+
+    // Returns "false" if the SOP class has never been proposed to the modality
+    bool Lookup(std::set<DicomTransferSyntax>& acceptedSyntaxes,
+                const std::string& modality,
+                const std::string& sopClassUid);
+
+    void Forget(const std::string& modality);
+
+    void Clear();
+
+    size_t GetModalitiesCount();
+  };
+}
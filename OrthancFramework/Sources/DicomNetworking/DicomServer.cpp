@@ -31,6 +31,7 @@
 #include "../SystemToolbox.h"
 #include "../Toolbox.h"
 #include "DicomAssociationParameters.h"
+#include "DicomAssociationQuotas.h"
 #include "Internals/CommandDispatcher.h"
 
 #include <boost/lexical_cast.hpp>
@@ -51,6 +52,7 @@ namespace Orthanc
   {
     boost::thread  thread_;
     T_ASC_Network *network_;
+    DicomAssociationQuotas                quotas_;   // Must outlive the workers
     std::unique_ptr<RunnableWorkersPool>  workers_;
 
 #if ORTHANC_ENABLE_SSL == 1
@@ -113,7 +115,8 @@ namespace Orthanc
     maximumPduLength_(ASC_DEFAULTMAXPDU),
     remoteCertificateRequired_(true),
     minimumTlsVersion_(0),
-    metricsRegistry_(NULL)
+    metricsRegistry_(NULL),
+    accessLog_(false)
   {
   }
 
@@ -439,11 +442,13 @@ namespace Orthanc
 
     if (metricsRegistry_ == NULL)
     {
-      pimpl_->workers_.reset(new RunnableWorkersPool(threadsCount_, dicomThreadNamesPrefix_ + "-"));
+      pimpl_->workers_.reset(new RunnableWorkersPool(threadsCount_, dicomThreadNamesPrefix_ + "-", threadsAffinity_));
     }
     else
     {
-      pimpl_->workers_.reset(new RunnableWorkersPool(threadsCount_, dicomThreadNamesPrefix_ + "-", *metricsRegistry_, "orthanc_available_dicom_threads"));
+      pimpl_->workers_.reset(new RunnableWorkersPool(threadsCount_, dicomThreadNamesPrefix_ + "-", *metricsRegistry_, "orthanc_available_dicom_threads",
+                                                     threadsAffinity_));
+      pimpl_->quotas_.SetMetricsRegistry(*metricsRegistry_);
     }
 
     pimpl_->thread_ = boost::thread(ServerThread, this, maximumPduLength_, useDicomTls_);
@@ -633,9 +638,32 @@ namespace Orthanc
     threadsCount_ = threads;
   }
 
+  void DicomServer::SetThreadsAffinity(const std::set<unsigned int>& cpus)
+  {
+    Stop();
+    threadsAffinity_ = cpus;
+  }
+
   void DicomServer::SetMetricsRegistry(MetricsRegistry& registry)
   {
     Stop();
     metricsRegistry_ = &registry;
   }
+
+
+  DicomAssociationQuotas& DicomServer::GetAssociationQuotas() const
+  {
+    return pimpl_->quotas_;
+  }
+
+  void DicomServer::SetAccessLogEnabled(bool enabled)
+  {
+    Stop();
+    accessLog_ = enabled;
+  }
+
+  bool DicomServer::IsAccessLogEnabled() const
+  {
+    return accessLog_;
+  }
 }
@@ -43,10 +43,12 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
+#include <set>
 
 
 namespace Orthanc
 {
+  class DicomAssociationQuotas;
   class MetricsRegistry;
 
   class DicomServer : public boost::noncopyable
@@ -79,6 +81,7 @@ namespace Orthanc
     std::string dicomThreadNamesPrefix_;
     uint32_t associationTimeout_;
     unsigned int threadsCount_;
+    std::set<unsigned int> threadsAffinity_;  // New in Orthanc 1.12.12
     IRemoteModalities* modalities_;
     IFindRequestHandlerFactory* findRequestHandlerFactory_;
     IMoveRequestHandlerFactory* moveRequestHandlerFactory_;
@@ -98,6 +101,7 @@ namespace Orthanc
     unsigned int minimumTlsVersion_;          // New in 1.12.4
     std::set<std::string> acceptedCiphers_;   // New in 1.12.4
     MetricsRegistry* metricsRegistry_;        // New in 1.12.9
+    bool         accessLog_;                  // New in 1.12.12
 
     static void ServerThread(DicomServer* server,
                              unsigned int maximumPduLength,
@@ -180,6 +184,16 @@ namespace Orthanc
 
     void SetThreadsCount(unsigned int threadsCount);
 
+    // New in Orthanc 1.12.12 (empty means no affinity)
+    void SetThreadsAffinity(const std::set<unsigned int>& cpus);
+
     void SetMetricsRegistry(MetricsRegistry& registry);
+
+    // New in Orthanc 1.12.12
+    DicomAssociationQuotas& GetAssociationQuotas() const;
+
+    // New in Orthanc 1.12.12: Log one JSON object per DIMSE command
+    void SetAccessLogEnabled(bool enabled);
+    bool IsAccessLogEnabled() const;
   };
 }
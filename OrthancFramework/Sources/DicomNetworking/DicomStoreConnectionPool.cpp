@@ -0,0 +1,269 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "DicomStoreConnectionPool.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+
+namespace Orthanc
+{
+  static boost::posix_time::ptime GetNow()
+  {
+    return boost::posix_time::microsec_clock::universal_time();
+  }
+
+
+  static bool IsSameAssociation(const DicomAssociationParameters& a,
+                                const DicomAssociationParameters& b)
+  {
+    if (!a.IsEqual(b))
+    {
+      return false;
+    }
+    else
+    {
+      // "IsEqual()" ignores some of the per-modality options (such
+      // as DICOM TLS), that are part of the serialized modality
+      Json::Value sa, sb;
+      a.GetRemoteModality().Serialize(sa, true /* force advanced format */);
+      b.GetRemoteModality().Serialize(sb, true /* force advanced format */);
+      return sa == sb;
+    }
+  }
+
+
+  DicomStoreConnectionPool::Accessor::Accessor(DicomStoreConnectionPool& pool,
+                                               const DicomAssociationParameters& parameters) :
+    pool_(pool),
+    connection_(pool.Acquire(parameters)),
+    success_(false)
+  {
+  }
+
+
+  DicomStoreConnectionPool::Accessor::~Accessor()
+  {
+    if (success_)
+    {
+      pool_.Release(connection_.release());
+    }
+  }
+
+
+  DicomStoreUserConnection& DicomStoreConnectionPool::Accessor::GetConnection()
+  {
+    if (connection_.get() == NULL)
+    {
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+    else
+    {
+      return *connection_;
+    }
+  }
+
+
+  void DicomStoreConnectionPool::Accessor::SetSuccess()
+  {
+    success_ = true;
+  }
+
+
+  // Mutex must be locked
+  void DicomStoreConnectionPool::CloseExpiredInternal()
+  {
+    const boost::posix_time::ptime now = GetNow();
+
+    IdleConnections::iterator it = idle_.begin();
+    while (it != idle_.end())
+    {
+      if (now - it->lastUse_ >= idleTimeout_)
+      {
+        CLOG(INFO, DICOM) << "Closing inactive DICOM association with modality: "
+                          << it->connection_->GetParameters().GetRemoteModality().GetApplicationEntityTitle();
+
+        delete it->connection_;
+        it = idle_.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+
+
+  // Mutex must be locked
+  void DicomStoreConnectionPool::ClearInternal()
+  {
+    for (IdleConnections::iterator it = idle_.begin(); it != idle_.end(); ++it)
+    {
+      assert(it->connection_ != NULL);
+      delete it->connection_;
+    }
+
+    idle_.clear();
+  }
+
+
+  DicomStoreConnectionPool::DicomStoreConnectionPool() :
+    maxIdlePerModality_(0),
+    idleTimeout_(boost::posix_time::seconds(10))
+  {
+  }
+
+
+  DicomStoreConnectionPool::~DicomStoreConnectionPool()
+  {
+    Clear();
+  }
+
+
+  void DicomStoreConnectionPool::SetMaxIdlePerModality(unsigned int count)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    maxIdlePerModality_ = count;
+
+    if (count == 0)
+    {
+      ClearInternal();
+    }
+  }
+
+
+  unsigned int DicomStoreConnectionPool::GetMaxIdlePerModality()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return maxIdlePerModality_;
+  }
+
+
+  void DicomStoreConnectionPool::SetIdleTimeout(unsigned int milliseconds)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    idleTimeout_ = boost::posix_time::milliseconds(milliseconds);
+    CloseExpiredInternal();
+  }
+
+
+  unsigned int DicomStoreConnectionPool::GetIdleTimeout()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return static_cast<unsigned int>(idleTimeout_.total_milliseconds());
+  }
+
+
+  DicomStoreUserConnection* DicomStoreConnectionPool::Acquire(const DicomAssociationParameters& parameters)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      CloseExpiredInternal();
+
+      for (IdleConnections::iterator it = idle_.begin(); it != idle_.end(); ++it)
+      {
+        if (IsSameAssociation(it->connection_->GetParameters(), parameters))
+        {
+          CLOG(INFO, DICOM) << "Reusing a pooled DICOM association with modality: "
+                            << parameters.GetRemoteModality().GetApplicationEntityTitle();
+
+          DicomStoreUserConnection* connection = it->connection_;
+          idle_.erase(it);
+          return connection;
+        }
+      }
+    }
+
+    return new DicomStoreUserConnection(parameters);
+  }
+
+
+  void DicomStoreConnectionPool::Release(DicomStoreUserConnection* connection)
+  {
+    if (connection == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    std::unique_ptr<DicomStoreUserConnection> protection(connection);
+
+    if (!connection->IsOpen())
+    {
+      return;  // Nothing worth keeping
+    }
+
+    try
+    {
+      // Collect the outstanding responses, and restore the default
+      // synchronous mode for the next user of the association
+      connection->SetAsynchronousStore(false);
+    }
+    catch (OrthancException& e)
+    {
+      LOG(WARNING) << "Not keeping a DICOM association in the pool: " << e.What();
+      return;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    unsigned int count = 0;
+    for (IdleConnections::const_iterator it = idle_.begin(); it != idle_.end(); ++it)
+    {
+      if (IsSameAssociation(it->connection_->GetParameters(), connection->GetParameters()))
+      {
+        count++;
+      }
+    }
+
+    if (count < maxIdlePerModality_)
+    {
+      IdleConnection item;
+      item.connection_ = protection.release();
+      item.lastUse_ = GetNow();
+      idle_.push_front(item);
+    }
+  }
+
+
+  size_t DicomStoreConnectionPool::GetIdleCount()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return idle_.size();
+  }
+
+
+  void DicomStoreConnectionPool::CloseIfInactive()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    CloseExpiredInternal();
+  }
+
+
+  void DicomStoreConnectionPool::Clear()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    ClearInternal();
+  }
+}
@@ -0,0 +1,127 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#if !defined(ORTHANC_ENABLE_DCMTK_NETWORKING)
+#  error The macro ORTHANC_ENABLE_DCMTK_NETWORKING must be defined
+#endif
+
+#if ORTHANC_ENABLE_DCMTK_NETWORKING != 1
+#  error The macro ORTHANC_ENABLE_DCMTK_NETWORKING must be 1 to use this file
+#endif
+
+
+#include "../Compatibility.h"
+#include "DicomStoreUserConnection.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/mutex.hpp>
+#include <list>
+
+namespace Orthanc
+{
+  /**
+   * Pool of the idle C-STORE SCU associations, shared by all the
+   * jobs and REST calls. A connection that is given back to the pool
+   * keeps its negotiated presentation contexts, and is handed to the
+   * next caller targeting the same modality with the same local AET
+   * and association parameters. The idle connections are closed
+   * after a timeout, and at most "maxIdlePerModality" of them are
+   * kept open for each remote modality.
+   **/
+  class ORTHANC_PUBLIC DicomStoreConnectionPool : public boost::noncopyable
+  {
+  private:
+    struct IdleConnection
+    {
+      DicomStoreUserConnection*  connection_;
+      boost::posix_time::ptime   lastUse_;
+    };
+
+    typedef std::list<IdleConnection>  IdleConnections;
+
+    boost::mutex                      mutex_;
+    IdleConnections                   idle_;  // The most recently used come first
+    unsigned int                      maxIdlePerModality_;
+    boost::posix_time::time_duration  idleTimeout_;
+
+    // Mutex must be locked
+    void CloseExpiredInternal();
+
+    // Mutex must be locked
+    void ClearInternal();
+
+  public:
+    /**
+     * RAII helper for the callers that use one connection during a
+     * single scope. The connection is dropped instead of being given
+     * back to the pool if an exception leaves the scope.
+     **/
+    class Accessor : public boost::noncopyable
+    {
+    private:
+      DicomStoreConnectionPool&                  pool_;
+      std::unique_ptr<DicomStoreUserConnection>  connection_;
+      bool                                       success_;
+
+    public:
+      Accessor(DicomStoreConnectionPool& pool,
+               const DicomAssociationParameters& parameters);
+
+      ~Accessor();
+
+      DicomStoreUserConnection& GetConnection();
+
+      // To be called once the connection was used without error
+      void SetSuccess();
+    };
+
+    DicomStoreConnectionPool();
+
+    ~DicomStoreConnectionPool();
+
+    // Setting it to "0" disables the pooling
+    void SetMaxIdlePerModality(unsigned int count);
+
+    unsigned int GetMaxIdlePerModality();
+
+    void SetIdleTimeout(unsigned int milliseconds);
+
+    unsigned int GetIdleTimeout();  // In milliseconds
+
+    // The caller takes the ownership of the returned connection
+    DicomStoreUserConnection* Acquire(const DicomAssociationParameters& parameters);
+
+    // The pool takes the ownership of the connection, that is either
+    // kept open for a next caller, or closed
+    void Release(DicomStoreUserConnection* connection);
+
+    size_t GetIdleCount();
+
+    void CloseIfInactive();
+
+    void Clear();
+  };
+}
@@ -30,7 +30,10 @@
 #include "../DicomParsing/ParsedDicomFile.h"
 #include "../Logging.h"
 #include "../OrthancException.h"
+#include "../Tracing.h"
 #include "DicomAssociation.h"
+#include "DicomNetworkMetrics.h"
+#include "DicomPresentationContextsHistory.h"
 
 #include <dcmtk/dcmdata/dcdeftag.h>
 
@@ -46,6 +49,47 @@ namespace Orthanc
     return buf;
   }
 
+  static void CheckStoreStatus(const DicomAssociationParameters& parameters,
+                               uint16_t dimseStatus,
+                               const std::string& sopInstanceUid)
+  {
+    /**
+     * New in Orthanc 1.6.0: Deal with failures during C-STORE.
+     * http://dicom.nema.org/medical/dicom/current/output/chtml/part04/sect_B.2.3.html#table_B.2-1
+     **/
+
+    const std::string& remoteAet = parameters.GetRemoteModality().GetApplicationEntityTitle();
+
+    if (DicomNetworkMetrics::IsFailure(dimseStatus))
+    {
+      DicomNetworkMetrics::AddDimseStatus(true, "C-STORE", remoteAet, dimseStatus);
+    }
+    else
+    {
+      DicomNetworkMetrics::IncrementCounter("orthanc_dicom_scu_instances_sent_total", remoteAet, 1);
+    }
+    
+    if (dimseStatus != 0x0000 &&  // Success
+        dimseStatus != 0xB000 &&  // Warning - Coercion of Data Elements
+        dimseStatus != 0xB007 &&  // Warning - Data Set does not match SOP Class
+        dimseStatus != 0xB006 &&  // Warning - Elements Discarded
+        dimseStatus != 0x0111)    // Warning - Duplicate SOPInstanceUID (https://discourse.orthanc-server.org/t/ignore-dimse-status-0x0111-when-sending-partial-duplicate-studies/4555/3)
+    {
+      std::string details = ("C-STORE SCU to AET \"" +
+                             parameters.GetRemoteModality().GetApplicationEntityTitle() +
+                             "\" has failed with DIMSE status " + DimseToHexString(dimseStatus));
+
+      if (!sopInstanceUid.empty())
+      {
+        details += " for SOP instance UID " + sopInstanceUid;
+      }
+
+      throw OrthancException(ErrorCode_NetworkProtocol, details)
+        .SetPayload(MakeDimseErrorStatusPayload(dimseStatus));
+    }
+  }
+
+
   static void ProgressCallback(void * /*callbackData*/,
                                T_DIMSE_StoreProgress *progress,
                                T_DIMSE_C_StoreRQ * req)
@@ -63,10 +107,30 @@ namespace Orthanc
   bool DicomStoreUserConnection::ProposeStorageClass(const std::string& sopClassUid,
                                                      const std::set<DicomTransferSyntax>& sourceSyntaxes,
                                                      bool hasPreferred,
-                                                     DicomTransferSyntax preferred)
+                                                     DicomTransferSyntax preferred,
+                                                     bool useHistory)
   {
     typedef std::list< std::list<DicomTransferSyntax> >  GroupsOfSyntaxes;
 
+    std::set<DicomTransferSyntax> accepted;
+    bool hasHistory = false;
+
+    if (useHistory)
+    {
+      hasHistory = DicomPresentationContextsHistory::GetGlobalInstance().Lookup(
+        accepted, DicomPresentationContextsHistory::FormatKey(parameters_), sopClassUid);
+
+      if (hasHistory &&
+          accepted.empty())
+      {
+        // This SOP class was rejected by the remote modality during
+        // the previous association: Don't waste room proposing it
+        // again, it will be proposed anyway if an instance of this
+        // class must be sent by this association
+        return true;
+      }
+    }
+
     GroupsOfSyntaxes  groups;
 
     // Firstly, add one group for each individual transfer syntax
@@ -115,6 +179,34 @@ namespace Orthanc
       }
     }
 
+    if (hasHistory)
+    {
+      // Only keep the transfer syntaxes that were accepted during the
+      // previous association with this remote modality
+      GroupsOfSyntaxes filtered;
+
+      for (GroupsOfSyntaxes::const_iterator it = groups.begin(); it != groups.end(); ++it)
+      {
+        std::list<DicomTransferSyntax> group;
+
+        for (std::list<DicomTransferSyntax>::const_iterator
+               syntax = it->begin(); syntax != it->end(); ++syntax)
+        {
+          if (accepted.find(*syntax) != accepted.end())
+          {
+            group.push_back(*syntax);
+          }
+        }
+
+        if (!group.empty())
+        {
+          filtered.push_back(group);
+        }
+      }
+
+      groups.swap(filtered);
+    }
+
     // Now, propose each of these groups of transfer syntaxes
     if (association_->GetRemainingPropositions() <= groups.size())
     {
@@ -122,6 +214,11 @@ namespace Orthanc
     }
     else
     {
+      if (!groups.empty())
+      {
+        proposedClasses_.insert(sopClassUid);
+      }
+
       for (GroupsOfSyntaxes::const_iterator it = groups.begin(); it != groups.end(); ++it)
       {
         association_->ProposePresentationContext(sopClassUid, *it);
@@ -140,6 +237,30 @@ namespace Orthanc
   }
 
 
+  void DicomStoreUserConnection::RecordAcceptedPresentationContexts()
+  {
+    DicomPresentationContextsHistory& history = DicomPresentationContextsHistory::GetGlobalInstance();
+    const std::string key = DicomPresentationContextsHistory::FormatKey(parameters_);
+
+    for (ProposedClasses::const_iterator it = proposedClasses_.begin(); it != proposedClasses_.end(); ++it)
+    {
+      std::set<DicomTransferSyntax> accepted;
+
+      std::map<DicomTransferSyntax, uint8_t> contexts;
+      if (association_->LookupAcceptedPresentationContext(contexts, *it))
+      {
+        for (std::map<DicomTransferSyntax, uint8_t>::const_iterator
+               syntax = contexts.begin(); syntax != contexts.end(); ++syntax)
+        {
+          accepted.insert(syntax->first);
+        }
+      }
+
+      history.Record(key, *it, accepted);
+    }
+  }
+
+
   bool DicomStoreUserConnection::LookupPresentationContext(
     uint8_t& presentationContextId,
     const std::string& sopClassUid,
@@ -169,8 +290,25 @@ namespace Orthanc
     association_(new DicomAssociation),
     proposeCommonClasses_(true),
     proposeUncompressedSyntaxes_(true),
-    proposeRetiredBigEndian_(false)
+    proposeRetiredBigEndian_(false),
+    asynchronousStore_(false)
+  {
+  }
+
+
+  DicomStoreUserConnection::~DicomStoreUserConnection()
   {
+    if (!pendingStores_.empty())
+    {
+      try
+      {
+        WaitPendingStores();
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Error while closing an asynchronous C-STORE association: " << e.What();
+      }
+    }
   }
 
   const DicomAssociationParameters &DicomStoreUserConnection::GetParameters() const
@@ -178,6 +316,11 @@ namespace Orthanc
     return parameters_;
   }
 
+  bool DicomStoreUserConnection::IsOpen() const
+  {
+    return association_->IsOpen();
+  }
+
   void DicomStoreUserConnection::SetCommonClassesProposed(bool proposed)
   {
     proposeCommonClasses_ = proposed;
@@ -278,6 +421,10 @@ namespace Orthanc
     // The association must be re-negotiated
     if (association_->IsOpen())
     {
+      // The responses to the outstanding requests would be lost once
+      // the association is closed
+      WaitPendingStores();
+
       CLOG(INFO, DICOM) << "No accepted presentation context found, re-negotiating DICOM association with "
                         << parameters_.GetRemoteModality().GetApplicationEntityTitle()
                         << " for SOPClassUID " << sopClassUid << " TransferSyntax =" << GetTransferSyntaxUid(transferSyntax);
@@ -301,11 +448,14 @@ namespace Orthanc
 
     association_->ClearPresentationContexts();
     proposedOriginalClasses_.clear();
+    proposedClasses_.clear();
     RegisterStorageClass(sopClassUid, transferSyntax);  // (*)
 
     
     /**
-     * Step 2: Propose at least the mandatory SOP class.
+     * Step 2: Propose at least the mandatory SOP class. The history of
+     * the previous associations is not used for this class, as it
+     * might be outdated if the remote modality was reconfigured.
      **/
 
     {
@@ -318,7 +468,7 @@ namespace Orthanc
         THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
       }
 
-      if (!ProposeStorageClass(sopClassUid, mandatory->second, hasPreferred, preferred))
+      if (!ProposeStorageClass(sopClassUid, mandatory->second, hasPreferred, preferred, false))
       {
         // Should never happen in real life: There are no more than
         // 128 transfer syntaxes in DICOM!
@@ -330,7 +480,10 @@ namespace Orthanc
       
     /**
      * Step 3: Propose all the previously spotted SOP classes, as
-     * registered through the "RegisterStorageClass()" method.
+     * registered through the "RegisterStorageClass()" method. New in
+     * Orthanc 1.12.12: If this remote modality was already contacted,
+     * only the transfer syntaxes it accepted are proposed, which
+     * leaves room for more SOP classes in the association.
      **/
       
     for (RegisteredClasses::const_iterator it = registeredClasses_.begin();
@@ -338,7 +491,7 @@ namespace Orthanc
     {
       if (it->first != sopClassUid)
       {
-        ProposeStorageClass(it->first, it->second, hasPreferred, preferred);
+        ProposeStorageClass(it->first, it->second, hasPreferred, preferred, true);
       }
     }
       
@@ -364,7 +517,7 @@ namespace Orthanc
         if (c != sopClassUid &&
             registeredClasses_.find(c) == registeredClasses_.end())
         {
-          ProposeStorageClass(c, ts, hasPreferred, preferred);
+          ProposeStorageClass(c, ts, hasPreferred, preferred, true);
         }
       }
     }
@@ -376,6 +529,8 @@ namespace Orthanc
      **/
 
     association_->Open(parameters_);
+    RecordAcceptedPresentationContexts();
+
     return LookupPresentationContext(presentationContextId, sopClassUid, transferSyntax);
   }
 
@@ -392,6 +547,14 @@ namespace Orthanc
 
     LOG(INFO) << "Performing C-Store on instance of SOPClassUID '" << sopClassUid << "'";
 
+    Tracing::Span span("DIMSE C-STORE", Tracing::SpanKind_Client);
+
+    if (span.IsRecording())
+    {
+      span.SetAttribute("orthanc.dicom.remote_aet", parameters_.GetRemoteModality().GetApplicationEntityTitle());
+      span.SetAttribute("orthanc.dicom.sop_instance_uid", sopInstanceUid);
+    }
+
     uint8_t presID;
     if (!NegotiatePresentationContext(presID, sopClassUid, transferSyntax, proposeUncompressedSyntaxes_,
                                       DicomTransferSyntax_LittleEndianExplicit))
@@ -428,16 +591,82 @@ namespace Orthanc
       THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
     }
 
+    DicomNetworkMetrics::IncrementCounter("orthanc_dicom_scu_bytes_sent_total",
+                                          parameters_.GetRemoteModality().GetApplicationEntityTitle(),
+                                          dicom.getDataset()->getLength(dicom.getDataset()->getCurrentXfer()));
+
+    const unsigned int window = parameters_.GetRemoteModality().GetMaxOperationsInvoked();
+
+    if (asynchronousStore_ &&
+        window > 1)
+    {
+      // Make room in the asynchronous operations window. A failure of
+      // a previous instance must not prevent the current one from
+      // being sent, as long as the association is still usable.
+      std::unique_ptr<OrthancException> previousFailure;
+
+      while (pendingStores_.size() >= window)
+      {
+        try
+        {
+          ReceiveStoreResponse();
+        }
+        catch (OrthancException& e)
+        {
+          if (!association_->IsOpen())
+          {
+            throw;
+          }
+
+          previousFailure.reset(new OrthancException(e));
+        }
+      }
+
+      {
+        OFString str;
+        CLOG(TRACE, DICOM) << "Sending asynchronous Store Request:" << std::endl
+                           << DIMSE_dumpMessage(str, request, DIMSE_OUTGOING);
+      }
+
+      T_DIMSE_Message message;
+      memset(&message, 0, sizeof(message));
+      message.CommandField = DIMSE_C_STORE_RQ;
+      message.msg.CStoreRQ = request;
+
+      DicomAssociation::CheckCondition(
+        DIMSE_sendMessageUsingMemoryData(&association_->GetDcmtkAssociation(), presID, &message,
+                                         NULL /* status detail */, dicom.getDataset(),
+                                         NULL /* callback */, NULL /* callback context */,
+                                         NULL /* commandSet */),
+        GetParameters(), "C-STORE");
+
+      pendingStores_[request.MessageID] = sopInstanceUid;
+
+      if (previousFailure.get() != NULL)
+      {
+        throw OrthancException(*previousFailure);
+      }
+
+      return;
+    }
+
     // Finally conduct transmission of data
     T_DIMSE_C_StoreRSP response;
     DcmDataset* statusDetail = NULL;
-    DicomAssociation::CheckCondition(
-      DIMSE_storeUser(&association_->GetDcmtkAssociation(), presID, &request,
-                      NULL, dicom.getDataset(), ProgressCallback, NULL,
-                      /*opt_blockMode*/ (GetParameters().HasTimeout() ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
-                      /*opt_dimse_timeout*/ static_cast<int>(GetParameters().GetTimeout()),
-                      &response, &statusDetail, NULL),
-      GetParameters(), "C-STORE");
+    OFCondition cond;
+
+    {
+      // The response time is only measured for synchronous C-STORE
+      DicomNetworkMetrics::Timer timer("orthanc_dicom_scu_c_store_duration_ms",
+                                       parameters_.GetRemoteModality().GetApplicationEntityTitle());
+      cond = DIMSE_storeUser(&association_->GetDcmtkAssociation(), presID, &request,
+                             NULL, dicom.getDataset(), ProgressCallback, NULL,
+                             /*opt_blockMode*/ (GetParameters().HasTimeout() ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
+                             /*opt_dimse_timeout*/ static_cast<int>(GetParameters().GetTimeout()),
+                             &response, &statusDetail, NULL);
+    }
+
+    DicomAssociation::CheckCondition(cond, GetParameters(), "C-STORE");
 
     if (statusDetail != NULL) 
     {
@@ -449,23 +678,92 @@ namespace Orthanc
       CLOG(TRACE, DICOM) << "Received Store Response:" << std::endl
                          << DIMSE_dumpMessage(str, response, DIMSE_INCOMING, NULL, presID);
     }
-    
-    /**
-     * New in Orthanc 1.6.0: Deal with failures during C-STORE.
-     * http://dicom.nema.org/medical/dicom/current/output/chtml/part04/sect_B.2.3.html#table_B.2-1
-     **/
-    
-    if (response.DimseStatus != 0x0000 &&  // Success
-        response.DimseStatus != 0xB000 &&  // Warning - Coercion of Data Elements
-        response.DimseStatus != 0xB007 &&  // Warning - Data Set does not match SOP Class
-        response.DimseStatus != 0xB006 &&  // Warning - Elements Discarded
-        response.DimseStatus != 0x0111)    // Warning - Duplicate SOPInstanceUID (https://discourse.orthanc-server.org/t/ignore-dimse-status-0x0111-when-sending-partial-duplicate-studies/4555/3)
+
+    CheckStoreStatus(GetParameters(), response.DimseStatus, "");
+  }
+
+
+  void DicomStoreUserConnection::ReceiveStoreResponse()
+  {
+    T_ASC_PresentationContextID presID = 0;
+    T_DIMSE_Message message;
+    DcmDataset* statusDetail = NULL;
+
+    OFCondition cond = DIMSE_receiveCommand(
+      &association_->GetDcmtkAssociation(),
+      (GetParameters().HasTimeout() ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
+      static_cast<int>(GetParameters().GetTimeout()), &presID, &message, &statusDetail);
+
+    if (statusDetail != NULL) 
+    {
+      delete statusDetail;
+    }
+
+    if (cond.bad() ||
+        message.CommandField != DIMSE_C_STORE_RSP)
+    {
+      // The association is not usable anymore, and the outcome of
+      // the outstanding requests is unknown
+      pendingStores_.clear();
+      association_->Close();
+
+      if (cond.bad())
+      {
+        DicomAssociation::CheckCondition(cond, GetParameters(), "C-STORE");
+      }
+
+      throw OrthancException(ErrorCode_NetworkProtocol,
+                             "Unexpected DIMSE command while waiting for a C-STORE response from AET \"" +
+                             GetParameters().GetRemoteModality().GetApplicationEntityTitle() + "\"");
+    }
+
+    const T_DIMSE_C_StoreRSP& response = message.msg.CStoreRSP;
+
+    {
+      OFString str;
+      CLOG(TRACE, DICOM) << "Received asynchronous Store Response:" << std::endl
+                         << DIMSE_dumpMessage(str, response, DIMSE_INCOMING, NULL, presID);
+    }
+
+    // The responses are matched by message ID, as the remote
+    // modality may answer the requests out of order
+    PendingStores::iterator found = pendingStores_.find(response.MessageIDBeingRespondedTo);
+    if (found == pendingStores_.end())
     {
       throw OrthancException(ErrorCode_NetworkProtocol,
-                             "C-STORE SCU to AET \"" +
-                             GetParameters().GetRemoteModality().GetApplicationEntityTitle() +
-                             "\" has failed with DIMSE status " + DimseToHexString(response.DimseStatus))
-        .SetPayload(MakeDimseErrorStatusPayload(response.DimseStatus));
+                             "C-STORE response for an unknown message ID from AET \"" +
+                             GetParameters().GetRemoteModality().GetApplicationEntityTitle() + "\"");
+    }
+
+    const std::string sopInstanceUid = found->second;
+    pendingStores_.erase(found);
+
+    CheckStoreStatus(GetParameters(), response.DimseStatus, sopInstanceUid);
+  }
+
+
+  void DicomStoreUserConnection::SetAsynchronousStore(bool enabled)
+  {
+    if (!enabled)
+    {
+      WaitPendingStores();
+    }
+
+    asynchronousStore_ = enabled;
+  }
+
+
+  bool DicomStoreUserConnection::IsAsynchronousStore() const
+  {
+    return asynchronousStore_;
+  }
+
+
+  void DicomStoreUserConnection::WaitPendingStores()
+  {
+    while (!pendingStores_.empty())
+    {
+      ReceiveStoreResponse();
     }
   }
 
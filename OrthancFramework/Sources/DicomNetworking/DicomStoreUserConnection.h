@@ -36,6 +36,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
+#include <map>
 #include <set>
 #include <stdint.h>  // For uint8_t
 
@@ -73,19 +74,34 @@ namespace Orthanc
     // that were proposed with a single transfer syntax
     typedef std::set< std::pair<std::string, DicomTransferSyntax> > ProposedOriginalClasses;
 
+    // SOP classes that were proposed in the current association
+    typedef std::set<std::string>  ProposedClasses;
+
+    // Outstanding asynchronous C-STORE requests: Message ID -> SOP instance UID
+    typedef std::map<uint16_t, std::string>  PendingStores;
+
     DicomAssociationParameters           parameters_;
     boost::shared_ptr<DicomAssociation>  association_;  // "shared_ptr" is for PImpl
     RegisteredClasses                    registeredClasses_;
     ProposedOriginalClasses              proposedOriginalClasses_;
+    ProposedClasses                      proposedClasses_;
     bool                                 proposeCommonClasses_;
     bool                                 proposeUncompressedSyntaxes_;
     bool                                 proposeRetiredBigEndian_;
+    bool                                 asynchronousStore_;
+    PendingStores                        pendingStores_;
 
-    // Return "false" if there is not enough room remaining in the association
+    // Return "false" if there is not enough room remaining in the
+    // association. If "useHistory" is "true", only the transfer
+    // syntaxes that were accepted by the remote modality during the
+    // previous associations are proposed.
     bool ProposeStorageClass(const std::string& sopClassUid,
                              const std::set<DicomTransferSyntax>& sourceSyntaxes,
                              bool hasPreferred,
-                             DicomTransferSyntax preferred);
+                             DicomTransferSyntax preferred,
+                             bool useHistory);
+
+    void RecordAcceptedPresentationContexts();
 
     bool LookupPresentationContext(uint8_t& presentationContextId,
                                    const std::string& sopClassUid,
@@ -97,6 +113,8 @@ namespace Orthanc
                                       bool hasPreferred,
                                       DicomTransferSyntax preferred);
 
+    void ReceiveStoreResponse();
+
 #if ORTHANC_ENABLE_DCMTK_TRANSCODING == 1
     void LookupTranscoding(std::set<DicomTransferSyntax>& acceptedSyntaxes,
                            const std::string& sopClassUid,
@@ -107,9 +125,14 @@ namespace Orthanc
 
   public:
     explicit DicomStoreUserConnection(const DicomAssociationParameters& params);
+
+    ~DicomStoreUserConnection();
     
     const DicomAssociationParameters& GetParameters() const;
 
+    // Whether the association has already been negotiated
+    bool IsOpen() const;
+
     void SetCommonClassesProposed(bool proposed);
 
     bool IsCommonClassesProposed() const;
@@ -122,6 +145,20 @@ namespace Orthanc
 
     bool IsRetiredBigEndianProposed() const;
 
+    /**
+     * If enabled, "Store()" does not wait for the C-STORE-RSP as long
+     * as there are less than "MaxOperationsInvoked" outstanding
+     * requests for the remote modality. A failure may therefore be
+     * reported by a later call to "Store()", or by
+     * "WaitPendingStores()" that must be called once the last
+     * instance is sent.
+     **/
+    void SetAsynchronousStore(bool enabled);
+
+    bool IsAsynchronousStore() const;
+
+    void WaitPendingStores();
+
     void RegisterStorageClass(const std::string& sopClassUid,
                               DicomTransferSyntax syntax);
 
@@ -26,6 +26,7 @@
 
 #include "DicomConnectionInfo.h"
 #include "DicomFindAnswers.h"
+#include "../OrthancException.h"
 
 #include <list>
 
@@ -34,6 +35,28 @@ namespace Orthanc
   class IFindRequestHandler : public boost::noncopyable
   {
   public:
+    /**
+     * Receives the answers to a C-FIND query while they are produced
+     * by "HandleStreaming()", so that the C-FIND SCP sends the pending
+     * responses before the lookup is over (new in Orthanc 1.12.12).
+     **/
+    class IAnswersStream : public boost::noncopyable
+    {
+    public:
+      virtual ~IAnswersStream()
+      {
+      }
+
+      /**
+       * Moves the content of "answers" to the stream, then clears
+       * "answers". Blocks as long as too many answers are waiting to
+       * be sent. The "IsComplete()" flag of the last pushed answers
+       * tells whether all the matches were reported. Throws
+       * "ErrorCode_CanceledJob" if the SCU has canceled the query.
+       **/
+      virtual void Push(DicomFindAnswers& answers) = 0;
+    };
+
     virtual ~IFindRequestHandler()
     {
     }
@@ -42,5 +65,22 @@ namespace Orthanc
                         const DicomMap& input,
                         const std::list<DicomTag>& sequencesToReturn,
                         const DicomConnectionInfo& connection) = 0;
+
+    // Whether "HandleStreaming()" can be used instead of "Handle()"
+    // (new in Orthanc 1.12.12)
+    virtual bool HasStreamingSupport() const
+    {
+      return false;
+    }
+
+    // Called from a thread that is distinct from the thread of the
+    // DICOM association (new in Orthanc 1.12.12)
+    virtual void HandleStreaming(IAnswersStream& stream,
+                                 const DicomMap& input,
+                                 const std::list<DicomTag>& sequencesToReturn,
+                                 const DicomConnectionInfo& connection)
+    {
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
   };
 }
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "../DicomFormat/DicomMap.h"
+#include "../OrthancException.h"
 
 #include <vector>
 #include <string>
@@ -32,6 +33,11 @@
 
 class DcmDataset;
 
+namespace Orthanc
+{
+  class TemporaryFile;
+}
+
 namespace Orthanc
 {
   class IStoreRequestHandler : public boost::noncopyable
@@ -47,5 +53,29 @@ namespace Orthanc
                             const std::string& calledAet,
                             uint16_t originatorMessageId,
                             const std::string& originatorAet) = 0;
+
+    /**
+     * If this method returns a temporary file, the PDVs of the
+     * incoming C-STORE request are written to this file as they
+     * arrive, and "HandleFile()" is invoked instead of "Handle()",
+     * which avoids building the full DICOM dataset in memory. The
+     * default implementation returns NULL, i.e. the dataset is
+     * received in memory (new in Orthanc 1.12.12).
+     **/
+    virtual TemporaryFile* CreateSpoolFile()
+    {
+      return NULL;
+    }
+
+    // The "path" contains a DICOM file with its meta-header
+    virtual uint16_t HandleFile(const std::string& path,
+                                const std::string& remoteIp,
+                                const std::string& remoteAet,
+                                const std::string& calledAet,
+                                uint16_t originatorMessageId,
+                                const std::string& originatorAet)
+    {
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
   };
 }
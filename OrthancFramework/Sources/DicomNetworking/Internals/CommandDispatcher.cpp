@@ -80,9 +80,12 @@
 
 #include "../../Compatibility.h"
 #include "../../DicomParsing/FromDcmtkBridge.h"
+#include "../../ElapsedTimer.h"
 #include "../../Logging.h"
 #include "../../OrthancException.h"
+#include "../../RequestTimings.h"
 #include "../../Toolbox.h"
+#include "../../Tracing.h"
 #include "FindScp.h"
 #include "GetScp.h"
 #include "MoveScp.h"
@@ -634,6 +637,30 @@ namespace Orthanc
         return NULL;
       }
 
+      /**
+       * Admission control (new in Orthanc 1.12.12): The slot is held
+       * by the dispatcher until the association is released, which
+       * bounds the number of the DICOM threads that can be used by
+       * one calling AET or by one class of modalities.
+       **/
+      std::unique_ptr<DicomAssociationQuotas::Slot> quotaSlot(
+        server.GetAssociationQuotas().Acquire(remoteAet, remoteIp));
+
+      if (quotaSlot.get() == NULL)
+      {
+        CLOG(WARNING, DICOM) << "Rejected association for remote AET " << remoteAet << " on IP " << remoteIp
+                             << ", because of temporary congestion";
+        T_ASC_RejectParameters rej =
+          {
+            ASC_RESULT_REJECTEDTRANSIENT,
+            ASC_SOURCE_SERVICEPROVIDER_PRESENTATION_RELATED,
+            ASC_REASON_SP_PRES_TEMPORARYCONGESTION
+          };
+        ASC_rejectAssociation(assoc, &rej);
+        AssociationCleanup(assoc);
+        return NULL;
+      }
+
       if (opt_rejectWithoutImplementationUID && 
           strlen(assoc->params->theirImplementationClassUID) == 0)
       {
@@ -681,7 +708,34 @@ namespace Orthanc
       }
 
       IApplicationEntityFilter* filter = server.HasApplicationEntityFilter() ? &server.GetApplicationEntityFilter() : NULL;
-      return new CommandDispatcher(server, assoc, remoteIp, remoteAet, calledAet, maximumPduLength, filter);
+      return new CommandDispatcher(server, assoc, remoteIp, remoteAet, calledAet, maximumPduLength, filter, quotaSlot.release());
+    }
+
+
+    // Structured access log, with one JSON object per DIMSE command
+    // (new in Orthanc 1.12.12)
+    static void LogAccess(const RequestTimings::Scope& timings,
+                          ElapsedTimer& timer,
+                          DicomRequestType request,
+                          const std::string& remoteIp,
+                          const std::string& remoteAet,
+                          const std::string& calledAet,
+                          const OFCondition& cond)
+    {
+      Json::Value entry;
+      timings.Format(entry);
+      entry["Protocol"] = "DICOM";
+      entry["Command"] = EnumerationToString(request);
+      entry["RemoteIp"] = remoteIp;
+      entry["RemoteAet"] = remoteAet;
+      entry["CalledAet"] = calledAet;
+      entry["Success"] = cond.good();
+      entry["DurationMs"] = static_cast<double>(timer.GetElapsedMicroseconds()) / 1000.0;
+
+      std::string s;
+      Toolbox::WriteFastJson(s, entry);
+
+      CLOG(WARNING, DICOM) << "Access log: " << Toolbox::StripSpaces(s);
     }
 
 
@@ -691,13 +745,15 @@ namespace Orthanc
                                          const std::string& remoteAet,
                                          const std::string& calledAet,
                                          unsigned int maximumPduLength,
-                                         IApplicationEntityFilter* filter) :
+                                         IApplicationEntityFilter* filter,
+                                         DicomAssociationQuotas::Slot* quotaSlot) :
       server_(server),
       assoc_(assoc),
       remoteIp_(remoteIp),
       remoteAet_(remoteAet),
       calledAet_(calledAet),
-      filter_(filter)
+      filter_(filter),
+      quotaSlot_(quotaSlot)
     {
       associationTimeout_ = server.GetAssociationTimeout();
       elapsedTimeSinceLastCommand_ = 0;
@@ -844,6 +900,20 @@ namespace Orthanc
         // in case we received a supported message, process this command
         if (supported)
         {
+          // Each DIMSE command starts a new trace, as DICOM cannot propagate the trace context
+          Tracing::Span span("DIMSE " + std::string(EnumerationToString(request)), Tracing::SpanKind_Server);
+
+          if (span.IsRecording())
+          {
+            span.SetAttribute("client.address", remoteIp_);
+            span.SetAttribute("orthanc.dicom.remote_aet", remoteAet_);
+            span.SetAttribute("orthanc.dicom.called_aet", calledAet_);
+          }
+
+          // Accounting of the resources that are consumed by this command
+          RequestTimings::Scope timings;
+          ElapsedTimer timer;
+
           // If anything goes wrong, there will be a "BADCOMMANDTYPE" answer
           cond = DIMSE_BADCOMMANDTYPE;
 
@@ -926,6 +996,16 @@ namespace Orthanc
               // Should never happen
               break;
           }
+
+          if (cond.bad())
+          {
+            span.SetError(cond.text());
+          }
+
+          if (server_.IsAccessLogEnabled())
+          {
+            LogAccess(timings, timer, request, remoteIp_, remoteAet_, calledAet_, cond);
+          }
         }
       }
       else
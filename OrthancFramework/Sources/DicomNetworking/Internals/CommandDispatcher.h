@@ -24,6 +24,8 @@
 
 #pragma once
 
+#include "../../Compatibility.h"
+#include "../DicomAssociationQuotas.h"
 #include "../DicomServer.h"
 #include "../../MultiThreading/IRunnableBySteps.h"
 
@@ -46,6 +48,7 @@ namespace Orthanc
       std::string remoteAet_;
       std::string calledAet_;
       IApplicationEntityFilter* filter_;
+      std::unique_ptr<DicomAssociationQuotas::Slot> quotaSlot_;
 
       OFCondition NActionScp(T_DIMSE_Message* msg, 
                              T_ASC_PresentationContextID presID);
@@ -60,7 +63,8 @@ namespace Orthanc
                         const std::string& remoteAet,
                         const std::string& calledAet,
                         unsigned int maximumPduLength,
-                        IApplicationEntityFilter* filter);
+                        IApplicationEntityFilter* filter,
+                        DicomAssociationQuotas::Slot* quotaSlot /* takes ownership */);
 
       virtual ~CommandDispatcher() ORTHANC_OVERRIDE;
 
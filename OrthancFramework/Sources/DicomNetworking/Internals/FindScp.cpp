@@ -80,10 +80,14 @@
 #include "../../DicomParsing/ToDcmtkBridge.h"
 #include "../../Logging.h"
 #include "../../OrthancException.h"
+#include "../DicomNetworkMetrics.h"
 
 #include <dcmtk/dcmdata/dcfilefo.h>
 #include <dcmtk/dcmdata/dcdeftag.h>
 
+#include <boost/thread.hpp>
+#include <deque>
+
 
 
 /**
@@ -129,15 +133,193 @@ namespace Orthanc
 {
   namespace
   {  
+    /**
+     * Bounded queue between the thread that runs the lookup of a
+     * streamed C-FIND query ("IFindRequestHandler::HandleStreaming()")
+     * and the DCMTK callback that sends the pending responses.
+     **/
+    class AnswersStream : public IFindRequestHandler::IAnswersStream
+    {
+    private:
+      // Maximum number of answers that are waiting to be sent
+      static const size_t MAX_QUEUE_SIZE = 128;
+
+      boost::mutex               mutex_;
+      boost::condition_variable  producerCondition_;  // Signaled if room is available, or if canceled
+      boost::condition_variable  consumerCondition_;  // Signaled if an answer is available, or if done
+      std::deque<DcmDataset*>    queue_;
+      bool                       done_;
+      bool                       success_;
+      bool                       complete_;
+      bool                       canceled_;
+      DicomMap                   input_;
+      std::list<DicomTag>        sequencesToReturn_;
+      std::unique_ptr<DicomConnectionInfo>  connection_;
+      boost::thread              thread_;
+
+      static void Worker(AnswersStream* that,
+                         IFindRequestHandler* handler)
+      {
+        bool success = false;
+
+        try
+        {
+          handler->HandleStreaming(*that, that->input_, that->sequencesToReturn_, *that->connection_);
+          success = true;
+        }
+        catch (OrthancException& e)
+        {
+          if (e.GetErrorCode() == ErrorCode_CanceledJob)
+          {
+            CLOG(INFO, DICOM) << "C-FIND request was canceled by the SCU";
+          }
+          else
+          {
+            CLOG(ERROR, DICOM) << "C-FIND request handler has failed: " << e.What();
+          }
+        }
+        catch (...)
+        {
+          CLOG(ERROR, DICOM) << "Native exception in the C-FIND request handler";
+        }
+
+        boost::mutex::scoped_lock lock(that->mutex_);
+        that->done_ = true;
+        that->success_ = success;
+        that->consumerCondition_.notify_all();
+      }
+
+    public:
+      AnswersStream() :
+        done_(false),
+        success_(false),
+        complete_(true),
+        canceled_(false)
+      {
+      }
+
+      virtual ~AnswersStream()
+      {
+        Cancel();
+
+        if (thread_.joinable())
+        {
+          thread_.join();
+        }
+
+        for (std::deque<DcmDataset*>::iterator it = queue_.begin(); it != queue_.end(); ++it)
+        {
+          delete *it;
+        }
+      }
+
+      void Start(IFindRequestHandler& handler,
+                 const DicomMap& input,
+                 const std::list<DicomTag>& sequencesToReturn,
+                 const DicomConnectionInfo& connection)
+      {
+        if (thread_.joinable())
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+
+        input_.Assign(input);
+        sequencesToReturn_ = sequencesToReturn;
+        connection_.reset(new DicomConnectionInfo(connection));
+
+        thread_ = boost::thread(Worker, this, &handler);
+      }
+
+      virtual void Push(DicomFindAnswers& answers) ORTHANC_OVERRIDE
+      {
+        for (size_t i = 0; i < answers.GetSize(); i++)
+        {
+          std::unique_ptr<DcmDataset> dataset(answers.ExtractDcmDataset(i));
+
+          boost::mutex::scoped_lock lock(mutex_);
+
+          while (queue_.size() >= MAX_QUEUE_SIZE &&
+                 !canceled_)
+          {
+            producerCondition_.wait(lock);
+          }
+
+          if (canceled_)
+          {
+            throw OrthancException(ErrorCode_CanceledJob, "C-FIND request was canceled", false /* don't log */);
+          }
+
+          queue_.push_back(dataset.release());
+          consumerCondition_.notify_one();
+        }
+
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          complete_ = answers.IsComplete();
+        }
+
+        answers.Clear();
+      }
+
+      // Returns "false" if the lookup is over and all its answers were sent
+      bool Pop(DcmDataset*& answer)
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        while (queue_.empty() &&
+               !done_)
+        {
+          consumerCondition_.wait(lock);
+        }
+
+        if (queue_.empty())
+        {
+          answer = NULL;
+          return false;
+        }
+        else
+        {
+          answer = queue_.front();
+          queue_.pop_front();
+          producerCondition_.notify_one();
+          return true;
+        }
+      }
+
+      void Cancel()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        canceled_ = true;
+        producerCondition_.notify_all();
+      }
+
+      // Only valid once "Pop()" has returned "false"
+      bool IsSuccess()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        return success_;
+      }
+
+      // Only valid once "Pop()" has returned "false"
+      bool IsComplete()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        return complete_;
+      }
+    };
+
+
     struct FindScpData
     {
       IFindRequestHandler* findHandler_;
       IWorklistRequestHandler* worklistHandler_;
       DicomFindAnswers answers_;
+      std::unique_ptr<AnswersStream> stream_;  // Only used by streamed C-FIND queries (new in Orthanc 1.12.12)
       DcmDataset* lastRequest_;
       const std::string* remoteIp_;
       const std::string* remoteAet_;
       const std::string* calledAet_;
+      uint16_t lastStatus_;
 
       FindScpData() :
         findHandler_(NULL),
@@ -146,7 +328,8 @@ namespace Orthanc
         lastRequest_(NULL),
         remoteIp_(NULL),
         remoteAet_(NULL),
-        calledAet_(NULL)
+        calledAet_(NULL),
+        lastStatus_(0)
       {
       }
     };
@@ -213,6 +396,7 @@ namespace Orthanc
       std::string sopClassUid(request->AffectedSOPClassUID);
 
       FindScpData& data = *reinterpret_cast<FindScpData*>(callbackData);
+      DicomNetworkMetrics::StatusObserver observer(data.lastStatus_, response->DimseStatus);
       if (data.lastRequest_ == NULL)
       {
         {
@@ -287,7 +471,18 @@ namespace Orthanc
               DicomConnectionInfo connection(*data.remoteIp_, *data.remoteAet_,
                                             *data.calledAet_, modality.GetManufacturer());
 
-              data.findHandler_->Handle(data.answers_, filtered, sequencesToReturn, connection);
+              if (data.findHandler_->HasStreamingSupport())
+              {
+                // The pending responses are sent while the lookup is
+                // running in another thread (new in Orthanc 1.12.12)
+                data.stream_.reset(new AnswersStream);
+                data.stream_->Start(*data.findHandler_, filtered, sequencesToReturn, connection);
+              }
+              else
+              {
+                data.findHandler_->Handle(data.answers_, filtered, sequencesToReturn, connection);
+              }
+
               ok = true;
             }
             else
@@ -319,6 +514,57 @@ namespace Orthanc
         return;
       }
 
+      if (cancelled)
+      {
+        // A C-CANCEL request was received from the SCU: Stop the
+        // lookup, and don't send the remaining answers
+        CLOG(INFO, DICOM) << "C-FIND request was canceled by the SCU after "
+                          << (responseCount - 1) << " response(s)";
+
+        if (data.stream_.get() != NULL)
+        {
+          data.stream_->Cancel();
+        }
+
+        response->DimseStatus = STATUS_FIND_Cancel_MatchingTerminatedDueToCancelRequest;
+        *responseIdentifiers = NULL;
+        return;
+      }
+
+      if (data.stream_.get() != NULL)
+      {
+        DcmDataset* answer = NULL;
+
+        if (data.stream_->Pop(answer))
+        {
+          assert(answer != NULL);
+          response->DimseStatus = STATUS_Pending;
+          *responseIdentifiers = answer;
+
+          std::stringstream s;  // DcmObject::PrintHelper cannot be used with VS2008
+          answer->print(s);
+          CLOG(TRACE, DICOM) << "Sending C-FIND Response " << responseCount << ":" << std::endl << s.str();
+        }
+        else if (!data.stream_->IsSuccess())
+        {
+          response->DimseStatus = STATUS_FIND_Failed_UnableToProcess;
+          *responseIdentifiers = NULL;
+        }
+        else if (data.stream_->IsComplete())
+        {
+          response->DimseStatus = STATUS_Success;
+          *responseIdentifiers = NULL;
+        }
+        else
+        {
+          CLOG(WARNING, DICOM) <<  "Too many results for an incoming C-FIND query";
+          response->DimseStatus = STATUS_FIND_Cancel_MatchingTerminatedDueToCancelRequest;
+          *responseIdentifiers = NULL;
+        }
+
+        return;
+      }
+
       if (responseCount <= static_cast<int>(data.answers_.GetSize()))
       {
         // There are pending results that are still to be sent
@@ -370,16 +616,30 @@ namespace Orthanc
     data.remoteAet_ = &remoteAet;
     data.calledAet_ = &calledAet;
 
-    OFCondition cond = DIMSE_findProvider(assoc, presID, &msg->msg.CFindRQ, 
-                                          FindScpCallback, &data,
-                                          /*opt_blockMode*/ (timeout ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
-                                          /*opt_dimse_timeout*/ timeout);
+    OFCondition cond;
+
+    {
+      DicomNetworkMetrics::Timer timer("orthanc_dicom_scp_c_find_duration_ms", remoteAet);
+      cond = DIMSE_findProvider(assoc, presID, &msg->msg.CFindRQ, 
+                                FindScpCallback, &data,
+                                /*opt_blockMode*/ (timeout ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
+                                /*opt_dimse_timeout*/ timeout);
+    }
+
+    // Stop the lookup of a streamed C-FIND query if the association
+    // was interrupted before all the answers were sent
+    data.stream_.reset(NULL);
 
     // if some error occured, dump corresponding information and remove the outfile if necessary
     if (cond.bad())
     {
       OFString temp_str;
       CLOG(ERROR, DICOM) << "Find SCP Failed: " << cond.text();
+      DicomNetworkMetrics::AddNetworkFailure(false, "C-FIND", remoteAet);
+    }
+    else
+    {
+      DicomNetworkMetrics::AddDimseStatus(false, "C-FIND", remoteAet, data.lastStatus_);
     }
 
     return cond;
@@ -80,6 +80,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "../../DicomParsing/ToDcmtkBridge.h"
 #include "../../Logging.h"
 #include "../../OrthancException.h"
+#include "../DicomNetworkMetrics.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -109,6 +110,7 @@ namespace Orthanc
       const std::string* remoteIp_;
       const std::string* remoteAet_;
       const std::string* calledAet_;
+      uint16_t lastStatus_;
     };
 
 
@@ -168,6 +170,8 @@ namespace Orthanc
       *responseIdentifiers = NULL;   
 
       MoveScpData& data = *reinterpret_cast<MoveScpData*>(callbackData);
+      DicomNetworkMetrics::StatusObserver observer(data.lastStatus_, response->DimseStatus);
+
       if (data.lastRequest_ == NULL)
       {
         {
@@ -289,17 +293,28 @@ namespace Orthanc
     data.remoteIp_ = &remoteIp;
     data.remoteAet_ = &remoteAet;
     data.calledAet_ = &calledAet;
+    data.lastStatus_ = 0;
+
+    OFCondition cond;
 
-    OFCondition cond = DIMSE_moveProvider(assoc, presID, &msg->msg.CMoveRQ, 
-                                          MoveScpCallback, &data,
-                                          /*opt_blockMode*/ (timeout ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
-                                          /*opt_dimse_timeout*/ timeout);
+    {
+      DicomNetworkMetrics::Timer timer("orthanc_dicom_scp_c_move_duration_ms", remoteAet);
+      cond = DIMSE_moveProvider(assoc, presID, &msg->msg.CMoveRQ, 
+                                MoveScpCallback, &data,
+                                /*opt_blockMode*/ (timeout ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
+                                /*opt_dimse_timeout*/ timeout);
+    }
 
     // if some error occured, dump corresponding information and remove the outfile if necessary
     if (cond.bad())
     {
       OFString temp_str;
       CLOG(ERROR, DICOM) << "Move SCP Failed: " << cond.text();
+      DicomNetworkMetrics::AddNetworkFailure(false, "C-MOVE", remoteAet);
+    }
+    else
+    {
+      DicomNetworkMetrics::AddDimseStatus(false, "C-MOVE", remoteAet, data.lastStatus_);
     }
 
     return cond;
@@ -78,10 +78,17 @@
 #  error The macro DCMTK_VERSION_NUMBER must be defined
 #endif
 
+#include "../../Compatibility.h"
+#include "../../DicomFormat/DicomStreamReader.h"
 #include "../../DicomParsing/FromDcmtkBridge.h"
 #include "../../DicomParsing/ToDcmtkBridge.h"
 #include "../../OrthancException.h"
 #include "../../Logging.h"
+#include "../../TemporaryFile.h"
+#include "../../Toolbox.h"
+#include "../DicomNetworkMetrics.h"
+
+#include <boost/filesystem/fstream.hpp>
 
 #include <dcmtk/dcmdata/dcfilefo.h>
 #include <dcmtk/dcmdata/dcmetinf.h>
@@ -103,8 +110,125 @@ namespace Orthanc
       const char* modality;
       const char* affectedSOPInstanceUID;
       uint32_t messageID;
+      const TemporaryFile* spoolFile;
     };
 
+
+    class SopUidsVisitor : public DicomStreamReader::IVisitor
+    {
+    private:
+      bool         hasSopClassUid_;
+      bool         hasSopInstanceUid_;
+      std::string  sopClassUid_;
+      std::string  sopInstanceUid_;
+
+      static std::string StripPadding(const std::string& value)
+      {
+        // UI values are padded with a trailing NULL character
+        std::string s = value;
+        while (!s.empty() && s[s.size() - 1] == '\0')
+        {
+          s.resize(s.size() - 1);
+        }
+
+        return Toolbox::StripSpaces(s);
+      }
+
+    public:
+      SopUidsVisitor() :
+        hasSopClassUid_(false),
+        hasSopInstanceUid_(false)
+      {
+      }
+
+      virtual void VisitMetaHeaderTag(const DicomTag& tag,
+                                      const ValueRepresentation& vr,
+                                      const std::string& value) ORTHANC_OVERRIDE
+      {
+      }
+
+      virtual void VisitTransferSyntax(DicomTransferSyntax transferSyntax) ORTHANC_OVERRIDE
+      {
+      }
+
+      virtual bool VisitDatasetTag(const DicomTag& tag,
+                                   const ValueRepresentation& vr,
+                                   const std::string& value,
+                                   bool isLittleEndian,
+                                   uint64_t fileOffset) ORTHANC_OVERRIDE
+      {
+        if (tag == DICOM_TAG_SOP_CLASS_UID)
+        {
+          hasSopClassUid_ = true;
+          sopClassUid_ = StripPadding(value);
+        }
+        else if (tag == DICOM_TAG_SOP_INSTANCE_UID)
+        {
+          hasSopInstanceUid_ = true;
+          sopInstanceUid_ = StripPadding(value);
+        }
+
+        return !(hasSopClassUid_ && hasSopInstanceUid_);  // Stop as soon as both UIDs are known
+      }
+
+      bool IsComplete() const
+      {
+        return hasSopClassUid_ && hasSopInstanceUid_;
+      }
+
+      const std::string& GetSopClassUid() const
+      {
+        return sopClassUid_;
+      }
+
+      const std::string& GetSopInstanceUid() const
+      {
+        return sopInstanceUid_;
+      }
+    };
+
+
+    /**
+     * Read the SOP Class UID and the SOP Instance UID of a spooled
+     * file, without loading it into memory: the stream reader stops
+     * as soon as both tags are found, and before the pixel data.
+     **/
+    static bool LookupSopUidsInFile(std::string& sopClassUid,
+                                    std::string& sopInstanceUid,
+                                    const TemporaryFile& file)
+    {
+      boost::filesystem::ifstream stream;
+      stream.open(file.GetPath(), std::ifstream::in | std::ifstream::binary);
+
+      if (!stream.good())
+      {
+        return false;
+      }
+
+      SopUidsVisitor visitor;
+
+      try
+      {
+        DicomStreamReader reader(stream);
+        reader.Consume(visitor, DICOM_TAG_PIXEL_DATA);
+      }
+      catch (OrthancException&)
+      {
+        return false;
+      }
+
+      if (visitor.IsComplete())
+      {
+        sopClassUid = visitor.GetSopClassUid();
+        sopInstanceUid = visitor.GetSopInstanceUid();
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
     
     static void
     storeScpCallback(
@@ -152,9 +276,44 @@ namespace Orthanc
         // then the status will reflect this.  The callback function is still called to allow cleanup.
         //rsp->DimseStatus = STATUS_Success;
 
+        DicomNetworkMetrics::IncrementCounter("orthanc_dicom_scp_bytes_received_total",
+                                              cbdata->remoteAET, progress->progressBytes);
+
         // we want to write the received information to a file only if this information
         // is present and the options opt_bitPreserving and opt_ignore are not set.
-        if ((imageDataSet != NULL) && (*imageDataSet != NULL))
+        if (cbdata->spoolFile != NULL)
+        {
+          // The dataset was written to the spool file as it arrived over the network
+          if (rsp->DimseStatus == STATUS_Success)
+          {
+            std::string spooledSopClass, spooledSopInstance;
+            
+            if (!LookupSopUidsInFile(spooledSopClass, spooledSopInstance, *cbdata->spoolFile))
+            {
+              rsp->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
+            }
+            else if (spooledSopClass != req->AffectedSOPClassUID ||
+                     spooledSopInstance != req->AffectedSOPInstanceUID)
+            {
+              rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+            }
+            else
+            {
+              try
+              {
+                rsp->DimseStatus = cbdata->handler->HandleFile(cbdata->spoolFile->GetPath().string(), *cbdata->remoteIp,
+                                                               cbdata->remoteAET, cbdata->calledAET,
+                                                               req->MoveOriginatorID, req->MoveOriginatorApplicationEntityTitle);
+              }
+              catch (OrthancException& e)
+              {
+                rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+                CLOG(ERROR, DICOM) << "Exception while storing spooled DICOM: " << e.What();
+              }
+            }
+          }
+        }
+        else if ((imageDataSet != NULL) && (*imageDataSet != NULL))
         {
           // check the image to make sure it is consistent, i.e. that its sopClass and sopInstance correspond
           // to those mentioned in the request. If not, set the status in the response message variable.
@@ -202,6 +361,15 @@ namespace Orthanc
               }
           }
         }
+
+        if (DicomNetworkMetrics::IsFailure(rsp->DimseStatus))
+        {
+          DicomNetworkMetrics::AddDimseStatus(false, "C-STORE", cbdata->remoteAET, rsp->DimseStatus);
+        }
+        else
+        {
+          DicomNetworkMetrics::IncrementCounter("orthanc_dicom_scp_instances_received_total", cbdata->remoteAET, 1);
+        }
       }
     }
   }
@@ -250,6 +418,35 @@ namespace Orthanc
       data.calledAET = "";
     }
 
+    // The duration covers both the reception of the dataset and its storage
+    DicomNetworkMetrics::Timer timer("orthanc_dicom_scp_c_store_duration_ms", data.remoteAET);
+
+    std::unique_ptr<TemporaryFile> spoolFile(handler.CreateSpoolFile());
+    data.spoolFile = spoolFile.get();
+
+    if (spoolFile.get() != NULL)
+    {
+      /**
+       * Bit-preserving mode: DCMTK writes the PDVs, together with a
+       * meta-header, to the spool file as they are received, instead
+       * of building the full dataset in memory.
+       **/
+      const std::string path = spoolFile->GetPath().string();
+
+      cond = DIMSE_storeProvider(assoc, presID, req, path.c_str(), /*opt_useMetaheader*/OFTrue, NULL,
+                                 storeScpCallback, &data,
+                                 /*opt_blockMode*/ (timeout ? DIMSE_NONBLOCKING : DIMSE_BLOCKING),
+                                 /*opt_dimse_timeout*/ timeout);
+
+      if (cond.bad())
+      {
+        CLOG(ERROR, DICOM) << "Store SCP Failed: " << cond.text();
+        DicomNetworkMetrics::AddNetworkFailure(false, "C-STORE", data.remoteAET);
+      }
+
+      return cond;  // The destructor of "TemporaryFile" removes the spool file
+    }
+
     DcmFileFormat dcmff;
 
     // store SourceApplicationEntityTitle in metaheader
@@ -272,6 +469,7 @@ namespace Orthanc
     {
       OFString temp_str;
       CLOG(ERROR, DICOM) << "Store SCP Failed: " << cond.text();
+      DicomNetworkMetrics::AddNetworkFailure(false, "C-STORE", data.remoteAET);
     }
 
     // return return value
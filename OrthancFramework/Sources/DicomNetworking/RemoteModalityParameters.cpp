@@ -29,6 +29,7 @@
 #include "../OrthancException.h"
 #include "../SerializationToolbox.h"
 #include "../Toolbox.h"
+#include "DicomAssociationParameters.h"
 
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
@@ -53,6 +54,9 @@ static const char* KEY_USE_DICOM_TLS = "UseDicomTls";
 static const char* KEY_LOCAL_AET = "LocalAet";
 static const char* KEY_TIMEOUT = "Timeout";
 static const char* KEY_RETRIEVE_METHOD = "RetrieveMethod";
+static const char* KEY_MAX_PARALLEL_ASSOCIATIONS = "MaxParallelAssociations";
+static const char* KEY_MAX_OPERATIONS_INVOKED = "MaxOperationsInvoked";
+static const char* KEY_MAXIMUM_PDU_LENGTH = "MaximumPduLength";
 
 
 namespace Orthanc
@@ -76,6 +80,9 @@ namespace Orthanc
     localAet_.clear();
     timeout_ = 0;
     retrieveMethod_ = RetrieveMethod_SystemDefault;
+    maxParallelAssociations_ = 1;
+    maxOperationsInvoked_ = 1;
+    maximumPduLength_ = 0;
   }
 
 
@@ -323,6 +330,20 @@ namespace Orthanc
       retrieveMethod_ = RetrieveMethod_SystemDefault;
     }
 
+    if (serialized.isMember(KEY_MAX_PARALLEL_ASSOCIATIONS))
+    {
+      SetMaxParallelAssociations(SerializationToolbox::ReadUnsignedInteger(serialized, KEY_MAX_PARALLEL_ASSOCIATIONS));
+    }
+
+    if (serialized.isMember(KEY_MAX_OPERATIONS_INVOKED))
+    {
+      SetMaxOperationsInvoked(SerializationToolbox::ReadUnsignedInteger(serialized, KEY_MAX_OPERATIONS_INVOKED));
+    }
+
+    if (serialized.isMember(KEY_MAXIMUM_PDU_LENGTH))
+    {
+      SetMaximumPduLength(SerializationToolbox::ReadUnsignedInteger(serialized, KEY_MAXIMUM_PDU_LENGTH));
+    }
   }
 
 
@@ -415,7 +436,10 @@ namespace Orthanc
             !allowNEventReport_ ||
             !allowTranscoding_ ||
             useDicomTls_ ||
-            HasLocalAet());
+            HasLocalAet() ||
+            maxParallelAssociations_ != 1 ||
+            maxOperationsInvoked_ != 1 ||
+            HasMaximumPduLength());
   }
 
   
@@ -443,6 +467,9 @@ namespace Orthanc
       target[KEY_LOCAL_AET] = localAet_;
       target[KEY_TIMEOUT] = timeout_;
       target[KEY_RETRIEVE_METHOD] = EnumerationToString(retrieveMethod_);
+      target[KEY_MAX_PARALLEL_ASSOCIATIONS] = maxParallelAssociations_;
+      target[KEY_MAX_OPERATIONS_INVOKED] = maxOperationsInvoked_;
+      target[KEY_MAXIMUM_PDU_LENGTH] = maximumPduLength_;
     }
     else
     {
@@ -548,4 +575,60 @@ namespace Orthanc
     retrieveMethod_ = retrieveMethod;
   }
 
+  void RemoteModalityParameters::SetMaxParallelAssociations(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "The maximum number of parallel associations must be at least 1");
+    }
+    else
+    {
+      maxParallelAssociations_ = count;
+    }
+  }
+
+  unsigned int RemoteModalityParameters::GetMaxParallelAssociations() const
+  {
+    return maxParallelAssociations_;
+  }
+
+  void RemoteModalityParameters::SetMaxOperationsInvoked(unsigned int count)
+  {
+    if (count == 0 ||
+        count > 65535)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "The maximum number of outstanding operations must be between 1 and 65535");
+    }
+    else
+    {
+      maxOperationsInvoked_ = count;
+    }
+  }
+
+  unsigned int RemoteModalityParameters::GetMaxOperationsInvoked() const
+  {
+    return maxOperationsInvoked_;
+  }
+
+  void RemoteModalityParameters::SetMaximumPduLength(unsigned int pdu)
+  {
+    if (pdu != 0)
+    {
+      DicomAssociationParameters::CheckMaximumPduLength(pdu);
+    }
+
+    maximumPduLength_ = pdu;
+  }
+
+  unsigned int RemoteModalityParameters::GetMaximumPduLength() const
+  {
+    return maximumPduLength_;
+  }
+
+  bool RemoteModalityParameters::HasMaximumPduLength() const
+  {
+    return maximumPduLength_ != 0;
+  }
 }
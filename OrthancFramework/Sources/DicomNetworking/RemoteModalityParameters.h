@@ -52,6 +52,9 @@ namespace Orthanc
     std::string           localAet_;
     uint32_t              timeout_;
     RetrieveMethod        retrieveMethod_;   // New in Orthanc 1.12.6
+    unsigned int          maxParallelAssociations_;   // New in Orthanc 1.12.12
+    unsigned int          maxOperationsInvoked_;      // New in Orthanc 1.12.12
+    unsigned int          maximumPduLength_;          // New in Orthanc 1.12.12
 
     void Clear();
 
@@ -123,5 +126,27 @@ namespace Orthanc
     RetrieveMethod GetRetrieveMethod() const;
 
     void SetRetrieveMethod(RetrieveMethod retrieveMethod);
+
+    // Number of concurrent associations used by one C-STORE job (1 means sequential)
+    void SetMaxParallelAssociations(unsigned int count);
+
+    unsigned int GetMaxParallelAssociations() const;
+
+    /**
+     * Number of C-STORE requests that may be outstanding on one
+     * association (1 means synchronous). DCMTK cannot propose the
+     * "Asynchronous Operations Window" sub-item, so this is a
+     * configuration of the remote modality, not a negotiated value.
+     **/
+    void SetMaxOperationsInvoked(unsigned int count);
+
+    unsigned int GetMaxOperationsInvoked() const;
+
+    // Setting it to "0" will use "DicomAssociationParameters::GetDefaultMaximumPduLength()"
+    void SetMaximumPduLength(unsigned int pdu);
+
+    unsigned int GetMaximumPduLength() const;
+
+    bool HasMaximumPduLength() const;
   };
 }
@@ -38,10 +38,14 @@
 #include "FromDcmtkBridge.h"
 #include "Internals/SopInstanceUidFixer.h"
 #include "../Logging.h"
+#include "../MultiThreading/CallableGroup.h"
 #include "../OrthancException.h"
 #include "../Toolbox.h"
 
 #include <dcmtk/dcmdata/dcdeftag.h>
+#include <dcmtk/dcmdata/dcpixel.h>
+#include <dcmtk/dcmdata/dcpixseq.h>
+#include <dcmtk/dcmdata/dcpxitem.h>
 #include <dcmtk/dcmjpeg/djrploss.h>  // for DJ_RPLossy
 #include <dcmtk/dcmjpeg/djrplol.h>   // for DJ_RPLossless
 #include <dcmtk/dcmjpls/djrparam.h>  // for DJLSRepresentationParameter
@@ -53,7 +57,8 @@ namespace Orthanc
 {
   DcmtkTranscoder::DcmtkTranscoder(unsigned int maxConcurrentExecutions) :
   defaultLossyQuality_(90),
-    maxConcurrentExecutionsSemaphore_(maxConcurrentExecutions)
+    maxConcurrentExecutionsSemaphore_(maxConcurrentExecutions),
+    framesThreads_(1)
   {
   }
 
@@ -87,6 +92,399 @@ namespace Orthanc
     return defaultLossyQuality_;
   }
 
+
+  void DcmtkTranscoder::SetFramesTranscodingThreads(unsigned int countThreads)
+  {
+    if (countThreads == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else if (framesWorkers_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else if (countThreads > 1)
+    {
+      LOG(INFO) << "The frames of the multi-frame instances are transcoded using DCMTK by " << countThreads << " threads";
+      framesWorkers_.reset(new ThreadPool);
+      framesWorkers_->SetLoggingThreadName("TRANSCODING");
+      framesWorkers_->SetCountThreads(countThreads);
+      framesWorkers_->Start();
+    }
+
+    framesThreads_ = countThreads;
+  }
+
+
+  unsigned int DcmtkTranscoder::GetFramesTranscodingThreads() const
+  {
+    return framesThreads_;
+  }
+
+
+  namespace
+  {
+    class EncodedFrame : public IDynamicObject
+    {
+    private:
+      std::unique_ptr<DcmDataset>  header_;
+      std::vector<std::string>     fragments_;
+
+    public:
+      explicit EncodedFrame(DcmDataset* header /* takes ownership */) :
+        header_(header)
+      {
+      }
+
+      void AddFragment(const Uint8* data,
+                       Uint32 size)
+      {
+        if (size == 0)
+        {
+          fragments_.push_back(std::string());
+        }
+        else
+        {
+          fragments_.push_back(std::string(reinterpret_cast<const char*>(data), size));
+        }
+      }
+
+      void RemovePixelData()
+      {
+        header_->findAndDeleteElement(DCM_PixelData);
+      }
+
+      DcmDataset* ReleaseHeader()
+      {
+        return header_.release();
+      }
+
+      const std::vector<std::string>& GetFragments() const
+      {
+        return fragments_;
+      }
+    };
+
+
+    class FrameEncoder : public ICallable
+    {
+    private:
+      std::unique_ptr<DcmDataset>        dataset_;  // Copy of the dataset, without the pixel data
+      const Uint8*                       frame_;    // Owned by the source dataset
+      size_t                             frameSize_;
+      bool                               isWord_;
+      E_TransferSyntax                   xfer_;
+      const DcmRepresentationParameter*  parameters_;
+
+    public:
+      FrameEncoder(DcmDataset* dataset /* takes ownership */,
+                   const Uint8* frame,
+                   size_t frameSize,
+                   bool isWord,
+                   E_TransferSyntax xfer,
+                   const DcmRepresentationParameter* parameters) :
+        dataset_(dataset),
+        frame_(frame),
+        frameSize_(frameSize),
+        isWord_(isWord),
+        xfer_(xfer),
+        parameters_(parameters)
+      {
+      }
+
+      virtual IDynamicObject* Call() ORTHANC_OVERRIDE
+      {
+        // Each frame is encoded by DCMTK as a single-frame dataset
+        OFCondition inserted;
+        if (isWord_)
+        {
+          inserted = dataset_->putAndInsertUint16Array(DCM_PixelData, reinterpret_cast<const Uint16*>(frame_), frameSize_ / 2);
+        }
+        else
+        {
+          inserted = dataset_->putAndInsertUint8Array(DCM_PixelData, frame_, frameSize_);
+        }
+
+        DcmElement* element = NULL;
+        DcmPixelSequence* sequence = NULL;
+
+        if (!inserted.good() ||
+            !dataset_->chooseRepresentation(xfer_, parameters_).good() ||
+            !dataset_->canWriteXfer(xfer_) ||
+            !dataset_->findAndGetElement(DCM_PixelData, element).good() ||
+            element == NULL ||
+            !dynamic_cast<DcmPixelData&>(*element).getEncapsulatedRepresentation(xfer_, parameters_, sequence).good() ||
+            sequence == NULL)
+        {
+          throw OrthancException(ErrorCode_InternalError, "Cannot encode a frame using DCMTK");
+        }
+
+        std::unique_ptr<EncodedFrame> result(new EncodedFrame(dataset_.release()));
+
+        // The first item of the sequence is the basic offset table
+        for (unsigned long i = 1; i < sequence->card(); i++)
+        {
+          DcmPixelItem* item = NULL;
+          Uint8* data = NULL;
+
+          if (!sequence->getItem(item, i).good() ||
+              item == NULL)
+          {
+            throw OrthancException(ErrorCode_InternalError, "Cannot encode a frame using DCMTK");
+          }
+
+          if (item->getLength() == 0)
+          {
+            result->AddFragment(NULL, 0);
+          }
+          else if (item->getUint8Array(data).good() &&
+                   data != NULL)
+          {
+            result->AddFragment(data, item->getLength());
+          }
+          else
+          {
+            throw OrthancException(ErrorCode_InternalError, "Cannot encode a frame using DCMTK");
+          }
+        }
+
+        // Only keep the attributes, that may have been updated by the codec
+        result->RemovePixelData();
+
+        return result.release();
+      }
+    };
+  }
+
+
+  bool DcmtkTranscoder::TranscodeFramesInParallel(DcmFileFormat& dicom,
+                                                  DicomTransferSyntax syntax,
+                                                  const DcmRepresentationParameter* parameters)
+  {
+    E_TransferSyntax xfer;
+    if (!FromDcmtkBridge::LookupDcmtkTransferSyntax(xfer, syntax) ||
+        !DcmXfer(xfer).isEncapsulated() ||
+        dicom.getDataset() == NULL)
+    {
+      return false;
+    }
+
+    DcmDataset& dataset = *dicom.getDataset();
+
+    Sint32 countFrames = 0;
+    Uint16 rows, columns, bitsAllocated, samplesPerPixel;
+    if (!dataset.findAndGetSint32(DCM_NumberOfFrames, countFrames).good() ||
+        countFrames <= 1 ||
+        !dataset.findAndGetUint16(DCM_Rows, rows).good() ||
+        !dataset.findAndGetUint16(DCM_Columns, columns).good() ||
+        !dataset.findAndGetUint16(DCM_BitsAllocated, bitsAllocated).good() ||
+        !dataset.findAndGetUint16(DCM_SamplesPerPixel, samplesPerPixel).good() ||
+        (bitsAllocated != 8 && bitsAllocated != 16))
+    {
+      return false;
+    }
+
+    const char* numberOfFrames = NULL;
+    if (!dataset.findAndGetString(DCM_NumberOfFrames, numberOfFrames).good() ||
+        numberOfFrames == NULL)
+    {
+      return false;
+    }
+
+    const std::string originalNumberOfFrames(numberOfFrames);
+
+    // The frames must be uncompressed before being split. The
+    // decompression of the source is kept sequential, as DCMTK
+    // cannot decode one pixel sequence concurrently.
+    E_TransferSyntax sourceXfer = dataset.getCurrentXfer();
+    if (sourceXfer == EXS_Unknown)
+    {
+      dataset.updateOriginalXfer();
+      sourceXfer = dataset.getOriginalXfer();
+    }
+
+    if (sourceXfer == EXS_Unknown ||
+        (DcmXfer(sourceXfer).isEncapsulated() &&
+         !dataset.chooseRepresentation(EXS_LittleEndianExplicit, NULL).good()))
+    {
+      return false;
+    }
+
+    const size_t frameSize = (static_cast<size_t>(rows) * static_cast<size_t>(columns) *
+                              static_cast<size_t>(samplesPerPixel) * static_cast<size_t>(bitsAllocated / 8));
+
+    DcmElement* element = NULL;
+    const Uint8* pixels = NULL;
+
+    if (!dataset.findAndGetElement(DCM_PixelData, element).good() ||
+        element == NULL)
+    {
+      return false;
+    }
+
+    if (bitsAllocated == 8)
+    {
+      Uint8* p = NULL;
+      if (element->getUint8Array(p).good())
+      {
+        pixels = p;
+      }
+    }
+    else
+    {
+      Uint16* p = NULL;
+      if (element->getUint16Array(p).good())
+      {
+        pixels = reinterpret_cast<const Uint8*>(p);
+      }
+    }
+
+    if (pixels == NULL ||
+        frameSize == 0 ||
+        static_cast<uint64_t>(element->getLength()) < static_cast<uint64_t>(countFrames) * static_cast<uint64_t>(frameSize))
+    {
+      return false;
+    }
+
+    // Copy of the dataset without the pixel data, shared by the frames
+    DcmDataset header;
+    for (unsigned long i = 0; i < dataset.card(); i++)
+    {
+      DcmElement* current = dataset.getElement(i);
+      if (current != NULL &&
+          current->getTag() != DCM_PixelData)
+      {
+        header.insert(dynamic_cast<DcmElement*>(current->clone()), OFTrue);
+      }
+    }
+
+    if (!header.putAndInsertString(DCM_NumberOfFrames, "1").good())
+    {
+      return false;
+    }
+
+    std::unique_ptr<DcmPixelSequence> sequence(new DcmPixelSequence(DcmTag(DCM_PixelData, EVR_OB)));
+
+    DcmPixelItem* offsetTable = new DcmPixelItem(DcmTag(DCM_Item, EVR_OB));
+    sequence->insert(offsetTable);
+
+    DcmOffsetList offsets;
+    std::unique_ptr<DcmDataset> firstHeader;
+
+    {
+      CallableGroup group(framesWorkers_, 2 * framesThreads_);
+
+      for (Sint32 i = 0; i < countFrames; i++)
+      {
+        group.Submit(new FrameEncoder(new DcmDataset(header), pixels + static_cast<size_t>(i) * frameSize,
+                                      frameSize, (bitsAllocated == 16), xfer, parameters));
+      }
+
+      CallableGroup::Iterator iterator(group);
+
+      try
+      {
+        while (iterator.HasNext())
+        {
+          std::unique_ptr<IDynamicObject> next(iterator.Next());
+          EncodedFrame& frame = dynamic_cast<EncodedFrame&>(*next);
+
+          if (firstHeader.get() == NULL)
+          {
+            firstHeader.reset(frame.ReleaseHeader());
+          }
+
+          Uint32 frameLength = 0;
+
+          for (size_t j = 0; j < frame.GetFragments().size(); j++)
+          {
+            const std::string& fragment = frame.GetFragments() [j];
+
+            DcmPixelItem* item = new DcmPixelItem(DcmTag(DCM_Item, EVR_OB));
+            sequence->insert(item);
+
+            if (!fragment.empty() &&
+                !item->putUint8Array(reinterpret_cast<const Uint8*>(fragment.c_str()), fragment.size()).good())
+            {
+              throw OrthancException(ErrorCode_NotEnoughMemory);
+            }
+
+            frameLength += 8 /* item header */ + item->getLength();
+          }
+
+          offsets.push_back(frameLength);
+        }
+      }
+      catch (OrthancException& e)
+      {
+        LOG(INFO) << "Cannot transcode the frames by multiple threads, fallback to DCMTK: " << e.What();
+
+        // Wait for the running workers, as they read the pixel data of "dataset"
+        while (iterator.HasNext())
+        {
+          try
+          {
+            std::unique_ptr<IDynamicObject> ignored(iterator.Next());
+          }
+          catch (OrthancException&)  // NOLINT(bugprone-empty-catch)
+          {
+          }
+        }
+
+        return false;
+      }
+    }
+
+    if (firstHeader.get() == NULL ||
+        !offsetTable->createOffsetTable(offsets).good())
+    {
+      return false;
+    }
+
+    // Replace the source dataset by the attributes that have been
+    // updated by the codec (e.g. photometric interpretation or lossy
+    // compression), followed by the concatenated pixel sequences
+    dataset.clear();
+
+    for (unsigned long i = 0; i < firstHeader->card(); i++)
+    {
+      DcmElement* current = firstHeader->getElement(i);
+      if (current != NULL)
+      {
+        dataset.insert(dynamic_cast<DcmElement*>(current->clone()), OFTrue);
+      }
+    }
+
+    std::unique_ptr<DcmPixelData> pixelData(new DcmPixelData(DcmTag(DCM_PixelData, EVR_OB)));
+    pixelData->putOriginalRepresentation(xfer, parameters, sequence.release());
+
+    if (!dataset.putAndInsertString(DCM_NumberOfFrames, originalNumberOfFrames.c_str()).good() ||
+        !dataset.insert(pixelData.release(), OFTrue).good())
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    // The pixel data is now in the target representation: This only
+    // updates the transfer syntax of the dataset and of the meta-header
+    return FromDcmtkBridge::Transcode(dicom, syntax, parameters);
+  }
+
+
+  bool DcmtkTranscoder::TranscodeFrames(DcmFileFormat& dicom,
+                                        DicomTransferSyntax syntax,
+                                        const DcmRepresentationParameter* parameters)
+  {
+    if (framesWorkers_.get() != NULL &&
+        TranscodeFramesInParallel(dicom, syntax, parameters))
+    {
+      return true;
+    }
+    else
+    {
+      return FromDcmtkBridge::Transcode(dicom, syntax, parameters);
+    }
+  }
+
   bool TryTranscode(std::vector<std::string>& failureReasons, /* out */
                     DicomTransferSyntax& selectedSyntax, /* out*/
                     DcmFileFormat& dicom, /* in/out */
@@ -180,7 +578,7 @@ namespace Orthanc
         // Check out "dcmjpeg/apps/dcmcjpeg.cc"
         DJ_RPLossy parameters(static_cast<int>(lossyQuality));
           
-        if (FromDcmtkBridge::Transcode(dicom, DicomTransferSyntax_JPEGProcess1, &parameters))
+        if (TranscodeFrames(dicom, DicomTransferSyntax_JPEGProcess1, &parameters))
         {
           fixer.Apply(dicom);
           selectedSyntax = DicomTransferSyntax_JPEGProcess1;
@@ -206,7 +604,7 @@ namespace Orthanc
       {
         // Check out "dcmjpeg/apps/dcmcjpeg.cc"
         DJ_RPLossy parameters(static_cast<int>(lossyQuality));
-        if (FromDcmtkBridge::Transcode(dicom, DicomTransferSyntax_JPEGProcess2_4, &parameters))
+        if (TranscodeFrames(dicom, DicomTransferSyntax_JPEGProcess2_4, &parameters))
         {
           fixer.Apply(dicom);
           selectedSyntax = DicomTransferSyntax_JPEGProcess2_4;
@@ -223,7 +621,7 @@ namespace Orthanc
       // Check out "dcmjpeg/apps/dcmcjpeg.cc"
       DJ_RPLossless parameters(6 /* opt_selection_value */,
                                0 /* opt_point_transform */);
-      if (FromDcmtkBridge::Transcode(dicom, DicomTransferSyntax_JPEGProcess14, &parameters))
+      if (TranscodeFrames(dicom, DicomTransferSyntax_JPEGProcess14, &parameters))
       {
         fixer.Apply(dicom);
         selectedSyntax = DicomTransferSyntax_JPEGProcess14;
@@ -239,7 +637,7 @@ namespace Orthanc
       // Check out "dcmjpeg/apps/dcmcjpeg.cc"
       DJ_RPLossless parameters(6 /* opt_selection_value */,
                                0 /* opt_point_transform */);
-      if (FromDcmtkBridge::Transcode(dicom, DicomTransferSyntax_JPEGProcess14SV1, &parameters))
+      if (TranscodeFrames(dicom, DicomTransferSyntax_JPEGProcess14SV1, &parameters))
       {
         selectedSyntax = DicomTransferSyntax_JPEGProcess14SV1;
         return true;
@@ -259,7 +657,7 @@ namespace Orthanc
        * WARNING: This call results in a segmentation fault if using
        * the DCMTK package 3.6.2 from Ubuntu 18.04.
        **/              
-      if (FromDcmtkBridge::Transcode(dicom, DicomTransferSyntax_JPEGLSLossless, &parameters))
+      if (TranscodeFrames(dicom, DicomTransferSyntax_JPEGLSLossless, &parameters))
       {
         selectedSyntax = DicomTransferSyntax_JPEGLSLossless;
         return true;
@@ -280,7 +678,7 @@ namespace Orthanc
        * WARNING: This call results in a segmentation fault if using
        * the DCMTK package 3.6.2 from Ubuntu 18.04.
        **/              
-      if (FromDcmtkBridge::Transcode(dicom, DicomTransferSyntax_JPEGLSLossy, &parameters))
+      if (TranscodeFrames(dicom, DicomTransferSyntax_JPEGLSLossy, &parameters))
       {
         fixer.Apply(dicom);
         selectedSyntax = DicomTransferSyntax_JPEGLSLossy;
@@ -34,6 +34,11 @@
 
 #include "IDicomTranscoder.h"
 #include "../MultiThreading/Semaphore.h"
+#include "../MultiThreading/ThreadPool.h"
+
+#include <boost/shared_ptr.hpp>
+
+class DcmRepresentationParameter;
 
 
 namespace Orthanc
@@ -43,6 +48,16 @@ namespace Orthanc
   private:
     unsigned int  defaultLossyQuality_;
     Semaphore maxConcurrentExecutionsSemaphore_;
+    boost::shared_ptr<ThreadPool>  framesWorkers_;  // New in Orthanc 1.12.12
+    unsigned int                   framesThreads_;
+
+    bool TranscodeFramesInParallel(DcmFileFormat& dicom,
+                                   DicomTransferSyntax syntax,
+                                   const DcmRepresentationParameter* parameters);
+
+    bool TranscodeFrames(DcmFileFormat& dicom,
+                         DicomTransferSyntax syntax,
+                         const DcmRepresentationParameter* parameters);
 
     bool InplaceTranscode(DicomTransferSyntax& selectedSyntax /* out */,
                           std::string& failureReason /* out */,
@@ -57,6 +72,16 @@ namespace Orthanc
     void SetDefaultLossyQuality(unsigned int quality);
 
     unsigned int GetDefaultLossyQuality() const;
+
+    /**
+     * Encode the frames of the multi-frame instances on a pool of
+     * threads, if transcoding to a compressed transfer syntax. A
+     * value of "1" (the default) keeps the sequential encoding by
+     * DCMTK. This method must be called before the first transcoding.
+     **/
+    void SetFramesTranscodingThreads(unsigned int countThreads);
+
+    unsigned int GetFramesTranscodingThreads() const;
     
     static bool IsSupported(DicomTransferSyntax syntax);
 
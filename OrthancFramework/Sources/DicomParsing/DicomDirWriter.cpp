@@ -150,33 +150,136 @@ namespace Orthanc
     }
 
 
-    static bool GetUtf8TagValue(std::string& result,
-                                DcmItem& source,
-                                Encoding encoding,
-                                bool hasCodeExtensions,
-                                const DcmTagKey& key)
+    /**
+     * Abstraction over the origin of the values of the records, that
+     * are either read from a parsed DICOM file, or from the main DICOM
+     * tags of the instance that are stored in the index of Orthanc.
+     **/
+    class ITagSource : public boost::noncopyable
     {
-      DcmElement* element = NULL;
-      result.clear();
+    public:
+      virtual ~ITagSource()
+      {
+      }
+
+      virtual bool HasTag(const DcmTagKey& key) const = 0;
+
+      virtual bool HasTagWithValue(const DcmTagKey& key) const = 0;
+
+      virtual bool GetUtf8TagValue(std::string& result,
+                                   const DcmTagKey& key) const = 0;
 
-      if (source.findAndGetElement(key, element).good())
+      virtual bool GetTransferSyntaxUid(std::string& result) const = 0;
+    };
+
+
+    class DatasetTagSource : public ITagSource
+    {
+    private:
+      DcmDataset&   dataset_;
+      DcmMetaInfo&  metaInfo_;
+      Encoding      encoding_;
+      bool          hasCodeExtensions_;
+
+      static bool GetUtf8TagValueInternal(std::string& result,
+                                          DcmItem& source,
+                                          Encoding encoding,
+                                          bool hasCodeExtensions,
+                                          const DcmTagKey& key)
       {
-        char* s = NULL;
-        if (element->isLeaf() &&
-            element->getString(s).good())
+        DcmElement* element = NULL;
+        result.clear();
+
+        if (source.findAndGetElement(key, element).good())
         {
-          if (s != NULL)
+          char* s = NULL;
+          if (element->isLeaf() &&
+              element->getString(s).good())
           {
-            const bool skipBacklashes = true;  // cf. "ISO_IR 13": In this method, the VR will never be UT, ST, or LT
-            result = Toolbox::ConvertToUtf8(s, encoding, hasCodeExtensions, skipBacklashes);
-          }
+            if (s != NULL)
+            {
+              const bool skipBacklashes = true;  // cf. "ISO_IR 13": In this method, the VR will never be UT, ST, or LT
+              result = Toolbox::ConvertToUtf8(s, encoding, hasCodeExtensions, skipBacklashes);
+            }
           
-          return true;
+            return true;
+          }
         }
+
+        return false;
       }
 
-      return false;
-    }
+    public:
+      explicit DatasetTagSource(ParsedDicomFile& dicom) :
+        dataset_(*dicom.GetDcmtkObject().getDataset()),
+        metaInfo_(*dicom.GetDcmtkObject().getMetaInfo())
+      {
+        encoding_ = dicom.DetectEncoding(hasCodeExtensions_);
+      }
+
+      virtual bool HasTag(const DcmTagKey& key) const ORTHANC_OVERRIDE
+      {
+        return dataset_.tagExists(key);
+      }
+
+      virtual bool HasTagWithValue(const DcmTagKey& key) const ORTHANC_OVERRIDE
+      {
+        return dataset_.tagExistsWithValue(key);
+      }
+
+      virtual bool GetUtf8TagValue(std::string& result,
+                                   const DcmTagKey& key) const ORTHANC_OVERRIDE
+      {
+        return GetUtf8TagValueInternal(result, dataset_, encoding_, hasCodeExtensions_, key);
+      }
+
+      virtual bool GetTransferSyntaxUid(std::string& result) const ORTHANC_OVERRIDE
+      {
+        return GetUtf8TagValueInternal(result, metaInfo_, encoding_, hasCodeExtensions_, DCM_TransferSyntaxUID);
+      }
+    };
+
+
+    class MapTagSource : public ITagSource
+    {
+    private:
+      const DicomMap&  tags_;
+
+      static DicomTag Convert(const DcmTagKey& key)
+      {
+        return DicomTag(key.getGroup(), key.getElement());
+      }
+
+    public:
+      explicit MapTagSource(const DicomMap& tags) :
+        tags_(tags)
+      {
+      }
+
+      virtual bool HasTag(const DcmTagKey& key) const ORTHANC_OVERRIDE
+      {
+        return tags_.HasTag(Convert(key));
+      }
+
+      virtual bool HasTagWithValue(const DcmTagKey& key) const ORTHANC_OVERRIDE
+      {
+        std::string value;
+        return (tags_.LookupStringValue(value, Convert(key), false) &&
+                !value.empty());
+      }
+
+      virtual bool GetUtf8TagValue(std::string& result,
+                                   const DcmTagKey& key) const ORTHANC_OVERRIDE
+      {
+        // The main DICOM tags in the index are already encoded in UTF-8
+        return tags_.LookupStringValue(result, Convert(key), false);
+      }
+
+      virtual bool GetTransferSyntaxUid(std::string& result) const ORTHANC_OVERRIDE
+      {
+        return tags_.LookupStringValue(result, DICOM_TAG_TRANSFER_SYNTAX_UID, false);
+      }
+    };
 
 
     static void SetTagValue(DcmDirectoryRecord& target,
@@ -194,22 +297,20 @@ namespace Orthanc
 
 
     static bool CopyString(DcmDirectoryRecord& target,
-                           DcmDataset& source,
-                           Encoding encoding,
-                           bool hasCodeExtensions,
+                           const ITagSource& source,
                            const DcmTagKey& key,
                            bool optional,
                            bool copyEmpty)
     {
       if (optional &&
-          !source.tagExistsWithValue(key) &&
-          !(copyEmpty && source.tagExists(key)))
+          !source.HasTagWithValue(key) &&
+          !(copyEmpty && source.HasTag(key)))
       {
         return false;
       }
 
       std::string value;
-      bool found = GetUtf8TagValue(value, source, encoding, hasCodeExtensions, key);
+      bool found = source.GetUtf8TagValue(value, key);
 
       if (!found)
       {
@@ -224,39 +325,31 @@ namespace Orthanc
 
 
     static void CopyStringType1(DcmDirectoryRecord& target,
-                                DcmDataset& source,
-                                Encoding encoding,
-                                bool hasCodeExtensions,
+                                const ITagSource& source,
                                 const DcmTagKey& key)
     {
-      CopyString(target, source, encoding, hasCodeExtensions, key, false, false);
+      CopyString(target, source, key, false, false);
     }
 
     static void CopyStringType1C(DcmDirectoryRecord& target,
-                                 DcmDataset& source,
-                                 Encoding encoding,
-                                 bool hasCodeExtensions,
+                                 const ITagSource& source,
                                  const DcmTagKey& key)
     {
-      CopyString(target, source, encoding, hasCodeExtensions, key, true, false);
+      CopyString(target, source, key, true, false);
     }
 
     static void CopyStringType2(DcmDirectoryRecord& target,
-                                DcmDataset& source,
-                                Encoding encoding,
-                                bool hasCodeExtensions,
+                                const ITagSource& source,
                                 const DcmTagKey& key)
     {
-      CopyString(target, source, encoding, hasCodeExtensions, key, false, true);
+      CopyString(target, source, key, false, true);
     }
 
     static void CopyStringType3(DcmDirectoryRecord& target,
-                                DcmDataset& source,
-                                Encoding encoding,
-                                bool hasCodeExtensions,
+                                const ITagSource& source,
                                 const DcmTagKey& key)
     {
-      CopyString(target, source, encoding, hasCodeExtensions, key, true, true);
+      CopyString(target, source, key, true, true);
     }
 
 
@@ -296,20 +389,16 @@ namespace Orthanc
     }
 
     static void FillPatient(DcmDirectoryRecord& record,
-                            DcmDataset& dicom,
-                            Encoding encoding,
-                            bool hasCodeExtensions)
+                            const ITagSource& dicom)
     {
       // cf. "DicomDirInterface::buildPatientRecord()"
 
-      CopyStringType1C(record, dicom, encoding, hasCodeExtensions, DCM_PatientID);
-      CopyStringType2(record, dicom, encoding, hasCodeExtensions, DCM_PatientName);
+      CopyStringType1C(record, dicom, DCM_PatientID);
+      CopyStringType2(record, dicom, DCM_PatientName);
     }
 
     void FillStudy(DcmDirectoryRecord& record,
-                   DcmDataset& dicom,
-                   Encoding encoding,
-                   bool hasCodeExtensions)
+                   const ITagSource& dicom)
     {
       // cf. "DicomDirInterface::buildStudyRecord()"
 
@@ -317,19 +406,19 @@ namespace Orthanc
       SystemToolbox::GetNowDicom(nowDate, nowTime, utc_);
 
       std::string studyDate;
-      if (!GetUtf8TagValue(studyDate, dicom, encoding, hasCodeExtensions, DCM_StudyDate) &&
-          !GetUtf8TagValue(studyDate, dicom, encoding, hasCodeExtensions, DCM_SeriesDate) &&
-          !GetUtf8TagValue(studyDate, dicom, encoding, hasCodeExtensions, DCM_AcquisitionDate) &&
-          !GetUtf8TagValue(studyDate, dicom, encoding, hasCodeExtensions, DCM_ContentDate))
+      if (!dicom.GetUtf8TagValue(studyDate, DCM_StudyDate) &&
+          !dicom.GetUtf8TagValue(studyDate, DCM_SeriesDate) &&
+          !dicom.GetUtf8TagValue(studyDate, DCM_AcquisitionDate) &&
+          !dicom.GetUtf8TagValue(studyDate, DCM_ContentDate))
       {
         studyDate = nowDate;
       }
           
       std::string studyTime;
-      if (!GetUtf8TagValue(studyTime, dicom, encoding, hasCodeExtensions, DCM_StudyTime) &&
-          !GetUtf8TagValue(studyTime, dicom, encoding, hasCodeExtensions, DCM_SeriesTime) &&
-          !GetUtf8TagValue(studyTime, dicom, encoding, hasCodeExtensions, DCM_AcquisitionTime) &&
-          !GetUtf8TagValue(studyTime, dicom, encoding, hasCodeExtensions, DCM_ContentTime))
+      if (!dicom.GetUtf8TagValue(studyTime, DCM_StudyTime) &&
+          !dicom.GetUtf8TagValue(studyTime, DCM_SeriesTime) &&
+          !dicom.GetUtf8TagValue(studyTime, DCM_AcquisitionTime) &&
+          !dicom.GetUtf8TagValue(studyTime, DCM_ContentTime))
       {
         studyTime = nowTime;
       }
@@ -337,54 +426,49 @@ namespace Orthanc
       /* copy attribute values from dataset to study record */
       SetTagValue(record, DCM_StudyDate, studyDate);
       SetTagValue(record, DCM_StudyTime, studyTime);
-      CopyStringType2(record, dicom, encoding, hasCodeExtensions, DCM_StudyDescription);
-      CopyStringType1(record, dicom, encoding, hasCodeExtensions, DCM_StudyInstanceUID);
+      CopyStringType2(record, dicom, DCM_StudyDescription);
+      CopyStringType1(record, dicom, DCM_StudyInstanceUID);
       /* use type 1C instead of 1 in order to avoid unwanted overwriting */
-      CopyStringType1C(record, dicom, encoding, hasCodeExtensions, DCM_StudyID);
-      CopyStringType2(record, dicom, encoding, hasCodeExtensions, DCM_AccessionNumber);
+      CopyStringType1C(record, dicom, DCM_StudyID);
+      CopyStringType2(record, dicom, DCM_AccessionNumber);
     }
 
     void FillSeries(DcmDirectoryRecord& record,
-                    DcmDataset& dicom,
-                    Encoding encoding,
-                    bool hasCodeExtensions)
+                    const ITagSource& dicom)
     {
       // cf. "DicomDirInterface::buildSeriesRecord()"
 
       /* copy attribute values from dataset to series record */
-      CopyStringType1(record, dicom, encoding, hasCodeExtensions, DCM_Modality);
-      CopyStringType1(record, dicom, encoding, hasCodeExtensions, DCM_SeriesInstanceUID);
+      CopyStringType1(record, dicom, DCM_Modality);
+      CopyStringType1(record, dicom, DCM_SeriesInstanceUID);
       /* use type 1C instead of 1 in order to avoid unwanted overwriting */
-      CopyStringType1C(record, dicom, encoding, hasCodeExtensions, DCM_SeriesNumber);
+      CopyStringType1C(record, dicom, DCM_SeriesNumber);
 
       // Add extended (non-standard) type 3 tags, those are not generated by DCMTK
       // http://dicom.nema.org/medical/Dicom/2016a/output/chtml/part02/sect_7.3.html
       // https://groups.google.com/d/msg/orthanc-users/Y7LOvZMDeoc/9cp3kDgxAwAJ
       if (extendedSopClass_)
       {
-        CopyStringType3(record, dicom, encoding, hasCodeExtensions, DCM_SeriesDescription);
+        CopyStringType3(record, dicom, DCM_SeriesDescription);
       }
     }
 
     static void FillInstance(DcmDirectoryRecord& record,
-                             DcmDataset& dicom,
-                             Encoding encoding,
-                             bool hasCodeExtensions,
-                             DcmMetaInfo& metaInfo,
+                             const ITagSource& dicom,
                              const char* path)
     {
       // cf. "DicomDirInterface::buildImageRecord()"
 
       /* copy attribute values from dataset to image record */
-      CopyStringType1(record, dicom, encoding, hasCodeExtensions, DCM_InstanceNumber);
-      //CopyElementType1C(record, dicom, encoding, hasCodeExtensions, DCM_ImageType);
+      CopyStringType1(record, dicom, DCM_InstanceNumber);
+      //CopyElementType1C(record, dicom, DCM_ImageType);
 
       // REMOVED since 0.9.7: copyElementType1C(dicom, DCM_ReferencedImageSequence, record);
 
       std::string sopClassUid, sopInstanceUid, transferSyntaxUid;
-      if (!GetUtf8TagValue(sopClassUid, dicom, encoding, hasCodeExtensions, DCM_SOPClassUID) ||
-          !GetUtf8TagValue(sopInstanceUid, dicom, encoding, hasCodeExtensions, DCM_SOPInstanceUID) ||
-          !GetUtf8TagValue(transferSyntaxUid, metaInfo, encoding, hasCodeExtensions, DCM_TransferSyntaxUID))
+      if (!dicom.GetUtf8TagValue(sopClassUid, DCM_SOPClassUID) ||
+          !dicom.GetUtf8TagValue(sopInstanceUid, DCM_SOPInstanceUID) ||
+          !dicom.GetTransferSyntaxUid(transferSyntaxUid))
       {
         throw OrthancException(ErrorCode_BadFileFormat);
       }
@@ -399,15 +483,10 @@ namespace Orthanc
 
     bool CreateResource(DcmDirectoryRecord*& target,
                         ResourceType level,
-                        ParsedDicomFile& dicom,
+                        const ITagSource& dicom,
                         const char* filename,
                         const char* path)
     {
-      DcmDataset& dataset = *dicom.GetDcmtkObject().getDataset();
-
-      bool hasCodeExtensions;
-      Encoding encoding = dicom.DetectEncoding(hasCodeExtensions);
-
       bool found;
       std::string id;
       E_DirRecType type;
@@ -415,7 +494,7 @@ namespace Orthanc
       switch (level)
       {
         case ResourceType_Patient:
-          if (!GetUtf8TagValue(id, dataset, encoding, hasCodeExtensions, DCM_PatientID))
+          if (!dicom.GetUtf8TagValue(id, DCM_PatientID))
           {
             // Be tolerant about missing patient ID. Fixes issue #124
             // (GET /studies/ID/media fails for certain dicom file).
@@ -427,17 +506,17 @@ namespace Orthanc
           break;
 
         case ResourceType_Study:
-          found = GetUtf8TagValue(id, dataset, encoding, hasCodeExtensions, DCM_StudyInstanceUID);
+          found = dicom.GetUtf8TagValue(id, DCM_StudyInstanceUID);
           type = ERT_Study;
           break;
 
         case ResourceType_Series:
-          found = GetUtf8TagValue(id, dataset, encoding, hasCodeExtensions, DCM_SeriesInstanceUID);
+          found = dicom.GetUtf8TagValue(id, DCM_SeriesInstanceUID);
           type = ERT_Series;
           break;
 
         case ResourceType_Instance:
-          found = GetUtf8TagValue(id, dataset, encoding, hasCodeExtensions, DCM_SOPInstanceUID);
+          found = dicom.GetUtf8TagValue(id, DCM_SOPInstanceUID);
           type = ERT_Image;
           break;
 
@@ -464,26 +543,26 @@ namespace Orthanc
       switch (level)
       {
         case ResourceType_Patient:
-          FillPatient(*record, dataset, encoding, hasCodeExtensions);
+          FillPatient(*record, dicom);
           break;
 
         case ResourceType_Study:
-          FillStudy(*record, dataset, encoding, hasCodeExtensions);
+          FillStudy(*record, dicom);
           break;
 
         case ResourceType_Series:
-          FillSeries(*record, dataset, encoding, hasCodeExtensions);
+          FillSeries(*record, dicom);
           break;
 
         case ResourceType_Instance:
-          FillInstance(*record, dataset, encoding, hasCodeExtensions, *dicom.GetDcmtkObject().getMetaInfo(), path);
+          FillInstance(*record, dicom, path);
           break;
 
         default:
           THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
       }
 
-      CopyStringType1C(*record, dataset, encoding, hasCodeExtensions, DCM_SpecificCharacterSet);
+      CopyStringType1C(*record, dicom, DCM_SpecificCharacterSet);
 
       target = record.get();
       GetRoot().insertSub(record.release());
@@ -492,6 +571,66 @@ namespace Orthanc
       return true;   // Newly created
     }
 
+    void AddInternal(const std::string& directory,
+                     const std::string& filename,
+                     const ITagSource& dicom)
+    {
+      std::string path;
+      if (directory.empty())
+      {
+        path = filename;
+      }
+      else
+      {
+        if (directory[directory.length() - 1] == '/' ||
+            directory[directory.length() - 1] == '\\')
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        path = directory + '\\' + filename;
+      }
+
+      DcmDirectoryRecord* instance;
+      bool isNewInstance = CreateResource(instance, ResourceType_Instance, dicom, filename.c_str(), path.c_str());
+      if (isNewInstance)
+      {
+        DcmDirectoryRecord* series;
+        bool isNewSeries = CreateResource(series, ResourceType_Series, dicom, filename.c_str(), NULL);
+        series->insertSub(instance);
+
+        if (isNewSeries)
+        {
+          DcmDirectoryRecord* study;
+          bool isNewStudy = CreateResource(study, ResourceType_Study, dicom, filename.c_str(), NULL);
+          study->insertSub(series);
+  
+          if (isNewStudy)
+          {
+            DcmDirectoryRecord* patient;
+            CreateResource(patient, ResourceType_Patient, dicom, filename.c_str(), NULL);
+            patient->insertSub(study);
+          }
+        }
+      }
+    }
+
+    void Add(const std::string& directory,
+             const std::string& filename,
+             ParsedDicomFile& dicom)
+    {
+      DatasetTagSource source(dicom);
+      AddInternal(directory, filename, source);
+    }
+
+    void Add(const std::string& directory,
+             const std::string& filename,
+             const DicomMap& tags)
+    {
+      MapTagSource source(tags);
+      AddInternal(directory, filename, source);
+    }
+
     void Write(std::string& s)
     {
       if (!GetDicomDir().write(DICOMDIR_DEFAULT_TRANSFERSYNTAX, 
@@ -535,44 +674,14 @@ namespace Orthanc
                            const std::string& filename,
                            ParsedDicomFile& dicom)
   {
-    std::string path;
-    if (directory.empty())
-    {
-      path = filename;
-    }
-    else
-    {
-      if (directory[directory.length() - 1] == '/' ||
-          directory[directory.length() - 1] == '\\')
-      {
-        throw OrthancException(ErrorCode_ParameterOutOfRange);
-      }
-
-      path = directory + '\\' + filename;
-    }
-
-    DcmDirectoryRecord* instance;
-    bool isNewInstance = pimpl_->CreateResource(instance, ResourceType_Instance, dicom, filename.c_str(), path.c_str());
-    if (isNewInstance)
-    {
-      DcmDirectoryRecord* series;
-      bool isNewSeries = pimpl_->CreateResource(series, ResourceType_Series, dicom, filename.c_str(), NULL);
-      series->insertSub(instance);
+    pimpl_->Add(directory, filename, dicom);
+  }
 
-      if (isNewSeries)
-      {
-        DcmDirectoryRecord* study;
-        bool isNewStudy = pimpl_->CreateResource(study, ResourceType_Study, dicom, filename.c_str(), NULL);
-        study->insertSub(series);
-  
-        if (isNewStudy)
-        {
-          DcmDirectoryRecord* patient;
-          pimpl_->CreateResource(patient, ResourceType_Patient, dicom, filename.c_str(), NULL);
-          patient->insertSub(study);
-        }
-      }
-    }
+  void DicomDirWriter::Add(const std::string& directory,
+                           const std::string& filename,
+                           const DicomMap& tags)
+  {
+    pimpl_->Add(directory, filename, tags);
   }
 
   void DicomDirWriter::Encode(std::string& target)
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "ParsedDicomFile.h"
+#include "../DicomFormat/DicomMap.h"
 
 #include <boost/noncopyable.hpp>
 
@@ -49,6 +50,17 @@ namespace Orthanc
              const std::string& filename,
              ParsedDicomFile& dicom);
 
+    /**
+     * Same as above, but builds the records of the DICOMDIR from the
+     * given tags (encoded in UTF-8), without having to parse the
+     * DICOM file. The tags must contain the patient, study, series
+     * and instance levels, together with "SOPClassUID" and
+     * "TransferSyntaxUID". New in Orthanc 1.12.12.
+     **/
+    void Add(const std::string& directory,
+             const std::string& filename,
+             const DicomMap& tags);
+
     void Encode(std::string& target);
 
     void EnableExtendedSopClass(bool enable);
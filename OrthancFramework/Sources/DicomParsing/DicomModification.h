@@ -28,6 +28,10 @@
 
 #include <list>
 
+#if ORTHANC_SANDBOXED == 0
+#  include <boost/thread/mutex.hpp>
+#endif
+
 
 namespace Orthanc
 {
@@ -69,6 +73,7 @@ namespace Orthanc
 
   private:
     class RelationshipsVisitor;
+    class ModificationPlan;
 
     class DicomTagRange
     {
@@ -170,6 +175,20 @@ namespace Orthanc
     // New in Orthanc 1.12.10
     std::unique_ptr<IDicomModifier>   dicomModifier_;
 
+    // New in Orthanc 1.12.12: Removals and clearings of the
+    // first-level tags, compiled once for all the calls to "Apply()"
+    std::unique_ptr<ModificationPlan>  plan_;
+
+#if ORTHANC_SANDBOXED == 0
+    // New in Orthanc 1.12.12: Protects "uidMap_", so that the same
+    // source identifier is mapped to the same identifier by all the
+    // threads that call "Apply()" at once
+    mutable boost::mutex  uidMapMutex_;
+
+    // New in Orthanc 1.12.12: Protects the lazy compilation of "plan_"
+    boost::mutex  planMutex_;
+#endif
+
     std::string MapDicomIdentifier(const std::string& original,
                                    ResourceType level);
 
@@ -182,6 +201,10 @@ namespace Orthanc
 
     void MarkNotOrthancAnonymization();
 
+    void InvalidatePlan();
+
+    const ModificationPlan& GetPlan();
+
     void ClearReplacements();
 
     void CancelReplacement(const DicomTag& tag);
@@ -254,6 +277,11 @@ namespace Orthanc
     // The "toModify" might be replaced by a new object
     void Apply(std::unique_ptr<ParsedDicomFile>& toModify);
 
+    // Tells whether "Apply()" can be called by several threads at
+    // once. This is not the case if a custom identifier generator or
+    // a custom modifier is installed (new in Orthanc 1.12.12).
+    bool IsApplyThreadSafe() const;
+
     void SetAllowManualIdentifiers(bool check);
 
     bool AreAllowManualIdentifiers() const;
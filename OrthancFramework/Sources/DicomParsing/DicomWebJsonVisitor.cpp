@@ -34,6 +34,17 @@
 
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <json/version.h>
+#include <json/writer.h>
+#include <sstream>
+
+// Same choice of the JsonCpp writer as in "Toolbox.cpp"
+#if (JSONCPP_VERSION_MAJOR >= 2 ||                                      \
+     (JSONCPP_VERSION_MAJOR == 1 && JSONCPP_VERSION_MINOR >= 8))
+#  define JSONCPP_USE_DEPRECATED 0
+#else
+#  define JSONCPP_USE_DEPRECATED 1
+#endif
 
 
 static const char* const KEY_ALPHABETIC = "Alphabetic";
@@ -48,6 +59,8 @@ static const char* const KEY_VALUE = "Value";
 static const char* const KEY_VR = "vr";
 static const char* const KEY_NUMBER = "number";
 
+static const size_t STREAMING_CHUNK_SIZE = 64 * 1024;
+
 
 namespace Orthanc
 {
@@ -238,10 +251,106 @@ namespace Orthanc
   }
 
     
+  class DicomWebJsonVisitor::StreamingState : public boost::noncopyable
+  {
+  private:
+    IStreamWriter&  writer_;
+    bool            isObjectOpen_;
+    std::string     buffer_;   // Text that is not sent to the writer yet
+
+#if JSONCPP_USE_DEPRECATED == 1
+    Json::FastWriter                     jsonWriter_;
+#else
+    std::unique_ptr<Json::StreamWriter>  jsonWriter_;
+    std::ostringstream                   stream_;
+#endif
+
+  public:
+    explicit StreamingState(IStreamWriter& writer) :
+      writer_(writer),
+      isObjectOpen_(false)
+    {
+#if JSONCPP_USE_DEPRECATED == 0
+      Json::StreamWriterBuilder builder;
+      builder.settings_["indentation"] = "";
+      jsonWriter_.reset(builder.newStreamWriter());
+#endif
+    }
+
+    void WriteElement(const std::string& tag,
+                      const Json::Value& content)
+    {
+      buffer_.push_back(isObjectOpen_ ? ',' : '{');
+      isObjectOpen_ = true;
+
+      buffer_.push_back('"');
+      buffer_.append(tag);
+      buffer_.append("\":");
+
+#if JSONCPP_USE_DEPRECATED == 1
+      std::string s = jsonWriter_.write(content);
+      if (!s.empty() &&
+          s[s.size() - 1] == '\n')
+      {
+        s.resize(s.size() - 1);  // "Json::FastWriter" appends a newline
+      }
+
+      buffer_.append(s);
+#else
+      stream_.str("");
+      jsonWriter_->write(content, &stream_);
+      buffer_.append(stream_.str());
+#endif
+
+      if (buffer_.size() >= STREAMING_CHUNK_SIZE)
+      {
+        writer_.Write(buffer_);
+        buffer_.clear();
+      }
+    }
+
+    void Finalize()
+    {
+      buffer_.append(isObjectOpen_ ? "}" : "{}");
+      isObjectOpen_ = false;
+
+      writer_.Write(buffer_);
+      buffer_.clear();
+    }
+  };
+
+
+  void DicomWebJsonVisitor::StreamCompletedElements(const std::string& currentTag)
+  {
+    if (streaming_.get() != NULL &&
+        !result_.empty() &&
+        (result_.size() > 1 || !result_.isMember(currentTag)))
+    {
+      // The visitor has moved to another top-level element: Write the
+      // previous ones, which are sorted by increasing tags
+      const Json::Value::Members members = result_.getMemberNames();
+
+      for (size_t i = 0; i < members.size(); i++)
+      {
+        if (members[i] != currentTag)
+        {
+          streaming_->WriteElement(members[i], result_[members[i]]);
+          result_.removeMember(members[i]);
+        }
+      }
+    }
+  }
+
+
   Json::Value& DicomWebJsonVisitor::CreateNode(const std::vector<DicomTag>& parentTags,
                                                const std::vector<size_t>& parentIndexes,
                                                const DicomTag& tag)
   {
+    if (parentTags.empty())
+    {
+      StreamCompletedElements(FormatTag(tag));
+    }
+
     Json::Value& node = CreateEmptyNode(parentTags, parentIndexes);
     assert(node.type() == Json::objectValue);
 
@@ -263,6 +372,11 @@ namespace Orthanc
   {
     assert(parentTags.size() == parentIndexes.size());      
 
+    if (!parentTags.empty())
+    {
+      StreamCompletedElements(FormatTag(parentTags[0]));
+    }
+
     Json::Value* node = &result_;
 
     for (size_t i = 0; i < parentTags.size(); i++)
@@ -383,6 +497,11 @@ namespace Orthanc
     Clear();
   }
 
+
+  DicomWebJsonVisitor::~DicomWebJsonVisitor()
+  {
+  }
+
   void DicomWebJsonVisitor::SetFormatter(DicomWebJsonVisitor::IBinaryFormatter &formatter)
   {
     formatter_ = &formatter;
@@ -399,9 +518,42 @@ namespace Orthanc
   }
 
 
+  void DicomWebJsonVisitor::SetStreamWriter(IStreamWriter& writer)
+  {
+    if (!result_.empty())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                             "The streaming mode must be enabled before visiting a dataset");
+    }
+    else
+    {
+      streaming_.reset(new StreamingState(writer));
+    }
+  }
+
+
+  void DicomWebJsonVisitor::FinalizeStream()
+  {
+    if (streaming_.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "The streaming mode is not enabled");
+    }
+    else
+    {
+      StreamCompletedElements("");
+      streaming_->Finalize();
+    }
+  }
+
+
 #if ORTHANC_ENABLE_PUGIXML == 1
   void DicomWebJsonVisitor::FormatXml(std::string& target) const
   {
+    if (streaming_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "XML cannot be generated in the streaming mode");
+    }
+
     pugi::xml_document doc;
     DicomWebJsonToXml(doc, result_);
     Toolbox::XmlToString(target, doc);
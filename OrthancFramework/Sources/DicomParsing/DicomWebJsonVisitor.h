@@ -32,6 +32,7 @@
 #include "../Compatibility.h"  // For ORTHANC_OVERRIDE
 
 #include <json/value.h>
+#include <memory>
 
 
 namespace Orthanc
@@ -62,12 +63,28 @@ namespace Orthanc
                                 const DicomTag& tag,
                                 ValueRepresentation vr) = 0;
     };
+
+    // Receives the JSON text in the streaming mode (new in Orthanc 1.12.12)
+    class IStreamWriter : public boost::noncopyable
+    {
+    public:
+      virtual ~IStreamWriter()
+      {
+      }
+
+      virtual void Write(const std::string& chunk) = 0;
+    };
     
   private:
+    class StreamingState;
+
     Json::Value        result_;
     IBinaryFormatter  *formatter_;
+    std::unique_ptr<StreamingState>  streaming_;
 
     static std::string FormatTag(const DicomTag& tag);
+
+    void StreamCompletedElements(const std::string& currentTag);
     
     Json::Value& CreateNode(const std::vector<DicomTag>& parentTags,
                             const std::vector<size_t>& parentIndexes,
@@ -85,12 +102,29 @@ namespace Orthanc
   public:
     DicomWebJsonVisitor();
 
+    virtual ~DicomWebJsonVisitor();
+
     void SetFormatter(IBinaryFormatter& formatter);
     
     void Clear();
 
     const Json::Value& GetResult() const;
 
+    /**
+     * Streaming mode (new in Orthanc 1.12.12): Each top-level element
+     * is written as JSON text to "writer" as soon as it is complete,
+     * then removed from "GetResult()", so that the full tree is never
+     * built. The escaping and the BulkData rules are the same as in
+     * the default mode. Must be called before visiting a dataset, and
+     * "FinalizeStream()" must be called once the dataset is visited.
+     * The writer must outlive the visitor.
+     **/
+    void SetStreamWriter(IStreamWriter& writer);
+
+    // Writes the remaining elements and closes the JSON object. The
+    // visitor can then be reused for the next dataset.
+    void FinalizeStream();
+
 #if ORTHANC_ENABLE_PUGIXML == 1
     void FormatXml(std::string& target) const;
 #endif
@@ -1443,10 +1443,11 @@ namespace Orthanc
   }
 
 
-  void FromDcmtkBridge::ExtractDicomSummary(DicomMap& target,
-                                            DcmItem& dataset,
-                                            unsigned int maxStringLength,
-                                            const std::set<DicomTag>& ignoreTagLength)
+  void FromDcmtkBridge::ExtractDicomSummaryInternal(DicomMap& target,
+                                                    DcmItem& dataset,
+                                                    unsigned int maxStringLength,
+                                                    const std::set<DicomTag>& ignoreTagLength,
+                                                    const std::set<DicomTag>* whitelist)
   {
     const Encoding defaultEncoding = GetDefaultDicomEncoding();
     
@@ -1457,6 +1458,14 @@ namespace Orthanc
     for (unsigned long i = 0; i < dataset.card(); i++)
     {
       DcmElement* element = dataset.getElement(i);
+
+      if (element != NULL &&
+          whitelist != NULL &&
+          whitelist->find(GetTag(*element)) == whitelist->end())
+      {
+        continue;  // Skip the element without converting it
+      }
+
       if (element && element->isLeaf())
       {
         target.SetValueInternal(element->getTag().getGTag(),
@@ -1477,7 +1486,7 @@ namespace Orthanc
             Json::Value& v = jsonSequence.append(Json::objectValue);
             DatasetToJson(v, *child, DicomToJsonFormat_Full, DicomToJsonFlags_Default, 
                           maxStringLength, encoding, hasCodeExtensions,
-                          ignoreTagLength, 1);
+                          ignoreTagLength, 1, NULL);
           }
 
           target.SetSequenceValue(DicomTag(element->getTag().getGTag(), element->getTag().getETag()),
@@ -1488,6 +1497,25 @@ namespace Orthanc
   }
 
 
+  void FromDcmtkBridge::ExtractDicomSummary(DicomMap& target,
+                                            DcmItem& dataset,
+                                            unsigned int maxStringLength,
+                                            const std::set<DicomTag>& ignoreTagLength)
+  {
+    ExtractDicomSummaryInternal(target, dataset, maxStringLength, ignoreTagLength, NULL);
+  }
+
+
+  void FromDcmtkBridge::ExtractDicomSummary(DicomMap& target,
+                                            DcmItem& dataset,
+                                            unsigned int maxStringLength,
+                                            const std::set<DicomTag>& ignoreTagLength,
+                                            const std::set<DicomTag>& whitelist)
+  {
+    ExtractDicomSummaryInternal(target, dataset, maxStringLength, ignoreTagLength, &whitelist);
+  }
+
+
   DicomTag FromDcmtkBridge::Convert(const DcmTag& tag)
   {
     return DicomTag(tag.getGTag(), tag.getETag());
@@ -2002,7 +2030,7 @@ namespace Orthanc
         DcmItem* child = sequence.getItem(i);
         Json::Value& v = target.append(Json::objectValue);
         DatasetToJson(v, *child, format, flags, maxStringLength, encoding, hasCodeExtensions,
-                      ignoreTagLength, depth + 1);
+                      ignoreTagLength, depth + 1, NULL);
       }
     }
   }
@@ -2016,9 +2044,11 @@ namespace Orthanc
                                       Encoding encoding,
                                       bool hasCodeExtensions,
                                       const std::set<DicomTag>& ignoreTagLength,
-                                      unsigned int depth)
+                                      unsigned int depth,
+                                      const std::set<DicomTag>* whitelist)
   {
     assert(parent.type() == Json::objectValue);
+    assert(depth == 0 || whitelist == NULL);
 
     if (depth >= 64)
     {
@@ -2035,6 +2065,13 @@ namespace Orthanc
 
       DicomTag tag(FromDcmtkBridge::Convert(element->getTag()));
 
+      // New in Orthanc 1.12.12
+      if (whitelist != NULL &&
+          whitelist->find(tag) == whitelist->end())
+      {
+        continue;
+      }
+
       // New flag in Orthanc 1.9.1
       if (depth == 0 &&
           (flags & DicomToJsonFlags_StopAfterPixelData) &&
@@ -2095,7 +2132,25 @@ namespace Orthanc
     Encoding encoding = DetectEncoding(hasCodeExtensions, dataset, defaultEncoding);
 
     target = Json::objectValue;
-    DatasetToJson(target, dataset, format, flags, maxStringLength, encoding, hasCodeExtensions, ignoreTagLength, 0);
+    DatasetToJson(target, dataset, format, flags, maxStringLength, encoding, hasCodeExtensions, ignoreTagLength, 0, NULL);
+  }
+
+
+  void FromDcmtkBridge::ExtractDicomAsJson(Json::Value& target, 
+                                           DcmDataset& dataset,
+                                           DicomToJsonFormat format,
+                                           DicomToJsonFlags flags,
+                                           unsigned int maxStringLength,
+                                           const std::set<DicomTag>& ignoreTagLength,
+                                           const std::set<DicomTag>& whitelist)
+  {
+    const Encoding defaultEncoding = GetDefaultDicomEncoding();
+    
+    bool hasCodeExtensions;
+    Encoding encoding = DetectEncoding(hasCodeExtensions, dataset, defaultEncoding);
+
+    target = Json::objectValue;
+    DatasetToJson(target, dataset, format, flags, maxStringLength, encoding, hasCodeExtensions, ignoreTagLength, 0, &whitelist);
   }
 
 
@@ -2107,7 +2162,7 @@ namespace Orthanc
   {
     std::set<DicomTag> ignoreTagLength;
     target = Json::objectValue;
-    DatasetToJson(target, dataset, format, flags, maxStringLength, Encoding_Ascii, false, ignoreTagLength, 0);
+    DatasetToJson(target, dataset, format, flags, maxStringLength, Encoding_Ascii, false, ignoreTagLength, 0, NULL);
   }
 
 
@@ -132,7 +132,8 @@ namespace Orthanc
                               Encoding encoding,
                               bool hasCodeExtensions,
                               const std::set<DicomTag>& ignoreTagLength,
-                              unsigned int depth);
+                              unsigned int depth,
+                              const std::set<DicomTag>* whitelist /* only used at the first level, can be NULL */);
 
     static void ElementToJson(Json::Value& parent,
                               DcmElement& element,
@@ -144,6 +145,12 @@ namespace Orthanc
                               const std::set<DicomTag>& ignoreTagLength,
                               unsigned int depth);
 
+    static void ExtractDicomSummaryInternal(DicomMap& target,
+                                            DcmItem& dataset,
+                                            unsigned int maxStringLength,
+                                            const std::set<DicomTag>& ignoreTagLength,
+                                            const std::set<DicomTag>* whitelist);
+
     static void ChangeStringEncoding(DcmItem& dataset,
                                      Encoding source,
                                      bool hasSourceCodeExtensions,
@@ -297,6 +304,26 @@ namespace Orthanc
                                    unsigned int maxStringLength,
                                    const std::set<DicomTag>& ignoreTagLength);
 
+    /**
+     * The two flavors below only convert the first-level elements
+     * whose tag belongs to "whitelist": The other elements are
+     * skipped without being converted, and the sequences that are
+     * not in the whitelist are not explored (new in Orthanc 1.12.12).
+     **/
+    static void ExtractDicomSummary(DicomMap& target, 
+                                    DcmItem& dataset,
+                                    unsigned int maxStringLength,
+                                    const std::set<DicomTag>& ignoreTagLength,
+                                    const std::set<DicomTag>& whitelist);
+
+    static void ExtractDicomAsJson(Json::Value& target, 
+                                   DcmDataset& dataset,
+                                   DicomToJsonFormat format,
+                                   DicomToJsonFlags flags,
+                                   unsigned int maxStringLength,
+                                   const std::set<DicomTag>& ignoreTagLength,
+                                   const std::set<DicomTag>& whitelist);
+
     static void InitializeCodecs();
 
     static void FinalizeCodecs();
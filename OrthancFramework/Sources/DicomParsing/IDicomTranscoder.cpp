@@ -68,6 +68,35 @@ namespace Orthanc
   }
 
 
+  void IDicomTranscoder::TranscodeBatch(std::vector<bool>& success,
+                                        const std::vector<DicomImage*>& targets,
+                                        const std::vector<DicomImage*>& sources,
+                                        const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                                        TranscodingSopInstanceUidMode mode,
+                                        unsigned int lossyQuality)
+  {
+    if (targets.size() != sources.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    success.assign(sources.size(), false);
+
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+      if (targets[i] == NULL ||
+          sources[i] == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+      else
+      {
+        success[i] = Transcode(*targets[i], *sources[i], allowedSyntaxes, mode, lossyQuality);
+      }
+    }
+  }
+
+
   std::string IDicomTranscoder::GetSopInstanceUid(DcmFileFormat& dicom)
   {
     if (dicom.getDataset() == NULL)
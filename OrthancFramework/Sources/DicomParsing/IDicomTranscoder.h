@@ -29,6 +29,7 @@
 
 #include <boost/noncopyable.hpp>
 #include <set>
+#include <vector>
 
 class DcmFileFormat;
 
@@ -83,6 +84,13 @@ namespace Orthanc
 
       ParsedDicomFile* ReleaseAsParsedDicomFile();
 
+      // Whether the image is available as a DCMTK object, without
+      // parsing its buffer (new in Orthanc 1.12.12)
+      bool HasParsed() const
+      {
+        return parsed_.get() != NULL;
+      }
+
       const void* GetBufferData();
 
       size_t GetBufferSize();
@@ -122,6 +130,21 @@ namespace Orthanc
                            TranscodingSopInstanceUidMode mode,
                            unsigned int lossyQuality) = 0;
 
+    /**
+     * Transcode a batch of DICOM instances at once, which gives the
+     * transcoder the opportunity to amortize its setup over several
+     * instances (new in Orthanc 1.12.12). On exit, "success[i]"
+     * tells whether "*targets[i]" contains the transcoded version of
+     * "*sources[i]". The default implementation calls "Transcode()"
+     * on each instance in turn.
+     **/
+    virtual void TranscodeBatch(std::vector<bool>& success /* out */,
+                                const std::vector<DicomImage*>& targets,
+                                const std::vector<DicomImage*>& sources /* in, "GetParsed()" possibly modified */,
+                                const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                                TranscodingSopInstanceUidMode mode,
+                                unsigned int lossyQuality);
+
     static std::string GetSopInstanceUid(DcmFileFormat& dicom);
   };
 }
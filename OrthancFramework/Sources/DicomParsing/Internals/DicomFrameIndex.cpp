@@ -251,6 +251,41 @@ namespace Orthanc
       }
       return content;
     }
+
+    virtual bool LookupRawFrameBuffer(const uint8_t*& buffer,
+                                      size_t& size,
+                                      unsigned int index) const ORTHANC_OVERRIDE
+    {
+      if (index >= startFragment_.size())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      if (countFragments_[index] != 1)
+      {
+        return false;
+      }
+
+      size = frameSize_[index];
+
+      if (size == 0)
+      {
+        buffer = NULL;
+      }
+      else
+      {
+        uint8_t* content = NULL;
+        if (!startFragment_[index]->getUint8Array(content).good() ||
+            content == NULL)
+        {
+          THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+        }
+
+        buffer = content;
+      }
+
+      return true;
+    }
   };
 
 
@@ -307,6 +342,15 @@ namespace Orthanc
     {
       return pixelData_ + index * frameSize_;
     }
+
+    virtual bool LookupRawFrameBuffer(const uint8_t*& buffer,
+                                      size_t& size,
+                                      unsigned int index) const ORTHANC_OVERRIDE
+    {
+      buffer = (frameSize_ > 0 ? pixelData_ + index * frameSize_ : NULL);
+      size = frameSize_;
+      return true;
+    }
   };
 
 
@@ -343,6 +387,16 @@ namespace Orthanc
     {
       THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_NotImplemented);
     }
+
+    virtual bool LookupRawFrameBuffer(const uint8_t*& buffer,
+                                      size_t& size,
+                                      unsigned int index) const ORTHANC_OVERRIDE
+    {
+      // The frames are stored in the decoded copy of the pixel data
+      buffer = (frameSize_ > 0 ? reinterpret_cast<const uint8_t*>(pixelData_.c_str()) + index * frameSize_ : NULL);
+      size = frameSize_;
+      return true;
+    }
   };
 
 
@@ -459,4 +513,32 @@ namespace Orthanc
       throw OrthancException(ErrorCode_BadFileFormat, "Cannot access a raw frame");
     }
   }
+
+
+  bool DicomFrameIndex::LookupRawFrameBuffer(const void*& buffer,
+                                             size_t& size,
+                                             unsigned int index) const
+  {
+    if (index >= countFrames_)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else if (index_.get() != NULL)
+    {
+      const uint8_t* p = NULL;
+      if (index_->LookupRawFrameBuffer(p, size, index))
+      {
+        buffer = p;
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Cannot access a raw frame");
+    }
+  }
 }
@@ -50,6 +50,10 @@ namespace Orthanc
                                unsigned int index) const = 0;
 
       virtual uint8_t* GetRawFrameBuffer(unsigned int index) = 0;
+
+      virtual bool LookupRawFrameBuffer(const uint8_t*& buffer,
+                                        size_t& size,
+                                        unsigned int index) const = 0;
     };
 
     class FragmentIndex;
@@ -73,5 +77,13 @@ namespace Orthanc
     static unsigned int GetFramesCount(DcmDataset& dicom);
 
     uint8_t* GetRawFrameBuffer(unsigned int index);
+
+    // New in Orthanc 1.12.12: Direct access to the raw frame, without
+    // copy, if it is stored as one contiguous buffer. Returns "false"
+    // otherwise (e.g. if the frame is split into several fragments).
+    // The buffer is valid as long as the dataset is not modified.
+    bool LookupRawFrameBuffer(const void*& buffer,
+                              size_t& size,
+                              unsigned int index) const;
   };
 }
@@ -1249,9 +1249,18 @@ namespace Orthanc
                                           ImageExtractionMode mode,
                                           bool invert)
   {
-    ApplyExtractionMode(image, mode, invert);
-
     PngWriter writer;
+    ExtractPngImage(result, image, mode, invert, writer);
+  }
+
+
+  void DicomImageDecoder::ExtractPngImage(std::string& result,
+                                          std::unique_ptr<ImageAccessor>& image,
+                                          ImageExtractionMode mode,
+                                          bool invert,
+                                          PngWriter& writer)
+  {
+    ApplyExtractionMode(image, mode, invert);
     IImageWriter::WriteToMemory(writer, result, *image);
   }
 #endif
@@ -1263,6 +1272,18 @@ namespace Orthanc
                                            ImageExtractionMode mode,
                                            bool invert,
                                            uint8_t quality)
+  {
+    JpegWriter writer;
+    writer.SetQuality(quality);
+    ExtractJpegImage(result, image, mode, invert, writer);
+  }
+
+
+  void DicomImageDecoder::ExtractJpegImage(std::string& result,
+                                           std::unique_ptr<ImageAccessor>& image,
+                                           ImageExtractionMode mode,
+                                           bool invert,
+                                           JpegWriter& writer)
   {
     if (mode != ImageExtractionMode_UInt8 &&
         mode != ImageExtractionMode_Preview)
@@ -1271,9 +1292,6 @@ namespace Orthanc
     }
 
     ApplyExtractionMode(image, mode, invert);
-
-    JpegWriter writer;
-    writer.SetQuality(quality);
     IImageWriter::WriteToMemory(writer, result, *image);
   }
 #endif
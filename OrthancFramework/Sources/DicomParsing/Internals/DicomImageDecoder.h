@@ -53,7 +53,9 @@ class DcmRepresentationParameter;
 
 namespace Orthanc
 {
+  class JpegWriter;
   class ParsedDicomFile;
+  class PngWriter;
   
   class ORTHANC_PUBLIC DicomImageDecoder : public boost::noncopyable
   {
@@ -111,6 +113,13 @@ namespace Orthanc
                                 std::unique_ptr<ImageAccessor>& image,
                                 ImageExtractionMode mode,
                                 bool invert);
+
+    // Encode using the settings of the given writer (new in Orthanc 1.12.12)
+    static void ExtractPngImage(std::string& result,
+                                std::unique_ptr<ImageAccessor>& image,
+                                ImageExtractionMode mode,
+                                bool invert,
+                                PngWriter& writer);
 #endif
 
 #if ORTHANC_ENABLE_JPEG == 1
@@ -119,6 +128,13 @@ namespace Orthanc
                                  ImageExtractionMode mode,
                                  bool invert,
                                  uint8_t quality);
+
+    // Encode using the settings of the given writer (new in Orthanc 1.12.12)
+    static void ExtractJpegImage(std::string& result,
+                                 std::unique_ptr<ImageAccessor>& image,
+                                 ImageExtractionMode mode,
+                                 bool invert,
+                                 JpegWriter& writer);
 #endif
   };
 }
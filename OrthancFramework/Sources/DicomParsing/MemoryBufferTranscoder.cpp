@@ -30,6 +30,8 @@
 #include "FromDcmtkBridge.h"
 #include "Internals/SopInstanceUidFixer.h"
 
+#include <boost/shared_ptr.hpp>
+
 #if !defined(NDEBUG)  // For debugging
 #  include "ParsedDicomFile.h"
 #endif
@@ -111,4 +113,81 @@ namespace Orthanc
       return false;
     }
   }
+
+
+  void MemoryBufferTranscoder::TranscodeBufferBatch(std::vector<bool>& success,
+                                                    std::vector<std::string>& targets,
+                                                    const std::vector<const void*>& buffers,
+                                                    const std::vector<size_t>& sizes,
+                                                    const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                                                    bool allowNewSopInstanceUid)
+  {
+    if (buffers.size() != sizes.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    success.assign(buffers.size(), false);
+    targets.resize(buffers.size());
+
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+      success[i] = TranscodeBuffer(targets[i], buffers[i], sizes[i], allowedSyntaxes, allowNewSopInstanceUid);
+    }
+  }
+
+
+  void MemoryBufferTranscoder::TranscodeBatch(std::vector<bool>& success,
+                                              const std::vector<DicomImage*>& targets,
+                                              const std::vector<DicomImage*>& sources,
+                                              const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                                              TranscodingSopInstanceUidMode mode,
+                                              unsigned int lossyQualityNotUsed)
+  {
+    if (targets.size() != sources.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    const bool allowNewSopInstanceUid = (mode == TranscodingSopInstanceUidMode_AllowNew ||
+                                         mode == TranscodingSopInstanceUidMode_Preserve);
+
+    std::vector<boost::shared_ptr<Internals::SopInstanceUidFixer> > fixers(sources.size());
+    std::vector<const void*> buffers(sources.size());
+    std::vector<size_t> sizes(sources.size());
+
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+      if (targets[i] == NULL ||
+          sources[i] == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+
+      targets[i]->Clear();
+      fixers[i].reset(new Internals::SopInstanceUidFixer(mode, *sources[i]));
+      buffers[i] = sources[i]->GetBufferData();
+      sizes[i] = sources[i]->GetBufferSize();
+    }
+
+    std::vector<std::string> transcoded;
+    TranscodeBufferBatch(success, transcoded, buffers, sizes, allowedSyntaxes, allowNewSopInstanceUid);
+
+    if (success.size() != sources.size() ||
+        transcoded.size() != sources.size())
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+      if (success[i])
+      {
+        CheckTargetSyntax(transcoded[i], allowedSyntaxes);  // For debug only
+
+        targets[i]->AcquireBuffer(transcoded[i]);
+        fixers[i]->Apply(*targets[i]);
+      }
+    }
+  }
 }
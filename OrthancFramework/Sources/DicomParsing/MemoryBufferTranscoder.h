@@ -37,6 +37,15 @@ namespace Orthanc
                                  size_t size,
                                  const std::set<DicomTransferSyntax>& allowedSyntaxes,
                                  bool allowNewSopInstanceUid) = 0;
+
+    // New in Orthanc 1.12.12. The default implementation calls
+    // "TranscodeBuffer()" on each buffer in turn.
+    virtual void TranscodeBufferBatch(std::vector<bool>& success /* out */,
+                                      std::vector<std::string>& targets /* out */,
+                                      const std::vector<const void*>& buffers,
+                                      const std::vector<size_t>& sizes,
+                                      const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                                      bool allowNewSopInstanceUid);
     
   public:
     virtual bool Transcode(DicomImage& target /* out */,
@@ -49,5 +58,12 @@ namespace Orthanc
                            const std::set<DicomTransferSyntax>& allowedSyntaxes,
                            TranscodingSopInstanceUidMode mode,
                            unsigned int lossyQualityNotUsed) ORTHANC_OVERRIDE;
+
+    virtual void TranscodeBatch(std::vector<bool>& success /* out */,
+                                const std::vector<DicomImage*>& targets,
+                                const std::vector<DicomImage*>& sources,
+                                const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                                TranscodingSopInstanceUidMode mode,
+                                unsigned int lossyQualityNotUsed) ORTHANC_OVERRIDE;
   };
 }
@@ -29,17 +29,24 @@
 
 namespace Orthanc
 {
-  class ParsedDicomCache::Item : public ICacheable
+  class ParsedDicomCache::Item : public boost::noncopyable
   {
   private:
+#if !defined(__EMSCRIPTEN__)
+    boost::mutex                      mutex_;
+#endif
+
     std::unique_ptr<ParsedDicomFile>  dicom_;
     size_t                            fileSize_;
+    std::string                       revision_;
 
   public:
     Item(ParsedDicomFile* dicom,
-         size_t fileSize) :
+         size_t fileSize,
+         const std::string& revision) :
       dicom_(dicom),
-      fileSize_(fileSize)
+      fileSize_(fileSize),
+      revision_(revision)
     {
       if (dicom == NULL)
       {
@@ -47,11 +54,23 @@ namespace Orthanc
       }
     }
 
-    virtual size_t GetMemoryUsage() const ORTHANC_OVERRIDE
+#if !defined(__EMSCRIPTEN__)
+    boost::mutex& GetMutex()
+    {
+      return mutex_;
+    }
+#endif
+
+    size_t GetFileSize() const
     {
       return fileSize_;
     }
 
+    const std::string& GetRevision() const
+    {
+      return revision_;
+    }
+
     ParsedDicomFile& GetDicom() const
     {
       assert(dicom_.get() != NULL);
@@ -60,9 +79,43 @@ namespace Orthanc
   };
 
 
+  void ParsedDicomCache::Recycle(std::vector<boost::shared_ptr<Item> >& recycled,
+                                 size_t targetSize)
+  {
+    // WARNING: "mutex_" must be locked. The recycled items are
+    // destroyed by the caller after the mutex is released, which
+    // avoids blocking the lookups while freeing the DCMTK objects.
+    while (currentSize_ > targetSize)
+    {
+      assert(!content_.IsEmpty());
+
+      boost::shared_ptr<Item> item;
+      content_.RemoveOldest(item);
+
+      assert(item.get() != NULL &&
+             currentSize_ >= item->GetFileSize());
+      currentSize_ -= item->GetFileSize();
+      recycled.push_back(item);
+      statistics_.AddEviction();
+    }
+  }
+
+
+  void ParsedDicomCache::RemoveInternal(const std::string& id,
+                                        const boost::shared_ptr<Item>& item)
+  {
+    // WARNING: "mutex_" must be locked
+    content_.Invalidate(id);
+
+    assert(item.get() != NULL &&
+           currentSize_ >= item->GetFileSize());
+    currentSize_ -= item->GetFileSize();
+  }
+
+
   ParsedDicomCache::ParsedDicomCache(size_t size) :
     cacheSize_(size),
-    largeSize_(0)
+    currentSize_(0)
   {
     if (size == 0)
     {
@@ -77,16 +130,7 @@ namespace Orthanc
     boost::mutex::scoped_lock lock(mutex_);
 #endif
 
-    if (cache_.get() == NULL)
-    {
-      return (largeDicom_.get() == NULL ? 0 : 1);
-    }
-    else
-    {
-      assert(largeDicom_.get() == NULL);
-      assert(largeSize_ == 0);
-      return cache_->GetNumberOfItems();
-    }
+    return content_.GetSize();
   }
 
 
@@ -96,34 +140,73 @@ namespace Orthanc
     boost::mutex::scoped_lock lock(mutex_);
 #endif
 
-    if (cache_.get() == NULL)
+    return currentSize_;
+  }
+
+  
+  size_t ParsedDicomCache::GetMaximumSize()
+  {
+#if !defined(__EMSCRIPTEN__)
+    boost::mutex::scoped_lock lock(mutex_);
+#endif
+
+    return cacheSize_;
+  }
+
+
+  void ParsedDicomCache::SetMaximumSize(size_t size)
+  {
+    if (size == 0)
     {
-      return largeSize_;
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
-    else
+
+    std::vector<boost::shared_ptr<Item> > recycled;  // Released after the mutex
+
     {
-      assert(largeDicom_.get() == NULL);
-      assert(largeSize_ == 0);
-      return cache_->GetCurrentSize();
+#if !defined(__EMSCRIPTEN__)
+      boost::mutex::scoped_lock lock(mutex_);
+#endif
+
+      Recycle(recycled, size);
+      cacheSize_ = size;
     }
   }
 
-  
-  void ParsedDicomCache::Invalidate(const std::string& id)
+
+  void ParsedDicomCache::AddLoad(uint64_t microseconds)
   {
 #if !defined(__EMSCRIPTEN__)
     boost::mutex::scoped_lock lock(mutex_);
 #endif
-      
-    if (cache_.get() != NULL)
-    {
-      cache_->Invalidate(id);
-    }
 
-    if (largeId_ == id)
+    statistics_.AddLoad(microseconds);
+  }
+
+
+  void ParsedDicomCache::GetStatistics(CacheStatistics& target)
+  {
+#if !defined(__EMSCRIPTEN__)
+    boost::mutex::scoped_lock lock(mutex_);
+#endif
+
+    target = statistics_;
+  }
+
+
+  void ParsedDicomCache::Invalidate(const std::string& id)
+  {
+    boost::shared_ptr<Item> item;  // Released after the mutex
+
     {
-      largeDicom_.reset(NULL);
-      largeSize_ = 0;
+#if !defined(__EMSCRIPTEN__)
+      boost::mutex::scoped_lock lock(mutex_);
+#endif
+
+      if (content_.Contains(id, item))
+      {
+        RemoveInternal(id, item);
+      }
     }
   }
 
@@ -132,65 +215,113 @@ namespace Orthanc
                                  ParsedDicomFile* dicom,  // Takes ownership
                                  size_t fileSize)
   {
+    Acquire(id, dicom, fileSize, "");
+  }
+
+
+  void ParsedDicomCache::Acquire(const std::string& id,
+                                 ParsedDicomFile* dicom,  // Takes ownership
+                                 size_t fileSize,
+                                 const std::string& revision)
+  {
+    // These objects are declared before the lock, so that they are
+    // released after the mutex
+    boost::shared_ptr<Item> item(new Item(dicom, fileSize, revision));
+    boost::shared_ptr<Item> outdated;
+    std::vector<boost::shared_ptr<Item> > recycled;
+
 #if !defined(__EMSCRIPTEN__)
     boost::mutex::scoped_lock lock(mutex_);
 #endif
-      
-    if (fileSize >= cacheSize_)
+
+    if (content_.Contains(id, outdated) &&
+        outdated->GetRevision() != revision)
     {
-      cache_.reset(NULL);
-      largeDicom_.reset(dicom);
-      largeId_ = id;
-      largeSize_ = fileSize;
+      // The file was modified since the old value was stored
+      RemoveInternal(id, outdated);
+    }
+
+    if (content_.Contains(id))
+    {
+      // Value already stored, don't overwrite the old value
+      content_.MakeMostRecent(id);
+    }
+    else if (fileSize >= cacheSize_)
+    {
+      // This file is too large for the cache, it is kept as the
+      // single item of the cache until the next call to "Acquire()"
+      Recycle(recycled, 0);
+      content_.Add(id, item);
+      currentSize_ = fileSize;
     }
     else
     {
-      largeDicom_.reset(NULL);
-      largeSize_ = 0;
+      Recycle(recycled, cacheSize_ - fileSize);  // Post-condition: currentSize_ <= cacheSize_ - fileSize
+      content_.Add(id, item);
+      currentSize_ += fileSize;
+    }
+  }
+
+
+  void ParsedDicomCache::Accessor::Lookup(ParsedDicomCache& that,
+                                          const std::string& id,
+                                          const std::string* expectedRevision)
+  {
+    boost::shared_ptr<Item> outdated;  // Released after the mutex
+
+    {
+#if !defined(__EMSCRIPTEN__)
+      boost::mutex::scoped_lock lock(that.mutex_);
+#endif
 
-      if (cache_.get() == NULL)
+      if (that.content_.Contains(id, item_) &&
+          expectedRevision != NULL &&
+          item_->GetRevision() != *expectedRevision)
       {
-        cache_.reset(new MemoryObjectCache);
-        cache_->SetMaximumSize(cacheSize_);
+        outdated.swap(item_);
+        that.RemoveInternal(id, outdated);
+        that.statistics_.AddEviction();  // Outdated entry
       }
 
-      cache_->Acquire(id, new Item(dicom, fileSize));
+      if (item_.get() != NULL)
+      {
+        that.content_.MakeMostRecent(id);
+        that.statistics_.AddHit();
+      }
+      else
+      {
+        that.statistics_.AddMiss();
+      }
+    }
+
+#if !defined(__EMSCRIPTEN__)
+    if (item_.get() != NULL)
+    {
+      // Only lock this entry, after the global mutex is released
+      lock_ = boost::mutex::scoped_lock(item_->GetMutex());
     }
+#endif
   }
 
 
   ParsedDicomCache::Accessor::Accessor(ParsedDicomCache& that,
-                                       const std::string& id) :
-#if !defined(__EMSCRIPTEN__)
-    lock_(that.mutex_),
-#endif
-    id_(id),
-    file_(NULL),
-    fileSize_(0)
+                                       const std::string& id)
   {
-    if (that.largeDicom_.get() != NULL &&
-        that.largeId_ == id)
-    {
-      file_ = that.largeDicom_.get();
-      fileSize_ = that.largeSize_;
-    }
-    else if (that.cache_.get() != NULL)
-    {
-      accessor_.reset(new MemoryObjectCache::Accessor(
-                        *that.cache_, id, true /* unique */));
-      if (accessor_->IsValid())
-      {            
-        const Item& item = dynamic_cast<const Item&>(accessor_->GetValue());
-        file_ = &item.GetDicom();
-        fileSize_ = item.GetMemoryUsage();
-      }
-    }
+    Lookup(that, id, NULL);
+  }
+
+
+  ParsedDicomCache::Accessor::Accessor(ParsedDicomCache& that,
+                                       const std::string& id,
+                                       const std::string& expectedRevision)
+  {
+    Lookup(that, id, &expectedRevision);
   }
 
 
   bool ParsedDicomCache::Accessor::IsValid() const
   {
-    return file_ != NULL;
+    return item_.get() != NULL;
   }
 
 
@@ -198,8 +329,7 @@ namespace Orthanc
   {
     if (IsValid())
     {
-      assert(file_ != NULL);
-      return *file_;
+      return item_->GetDicom();
     }
     else
     {
@@ -212,7 +342,7 @@ namespace Orthanc
   {
     if (IsValid())
     {
-      return fileSize_;
+      return item_->GetFileSize();
     }
     else
     {
@@ -24,32 +24,66 @@
 
 #pragma once
 
-#include "../Cache/MemoryObjectCache.h"
+#include "../Cache/CacheStatistics.h"
+#include "../Cache/LeastRecentlyUsedIndex.h"
 #include "ParsedDicomFile.h"
 
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+#if !defined(__EMSCRIPTEN__)
+#  include <boost/thread/mutex.hpp>
+#endif
+
 namespace Orthanc
 {
+  /**
+   * Cache of parsed DICOM files. The global mutex of the cache is
+   * only held while looking up or modifying the index. Each entry
+   * is reference-counted and has its own mutex, so that accessors
+   * to different files run in parallel, and that an entry that is
+   * recycled or invalidated remains alive until its last accessor
+   * is released. Two accessors to the same file are serialized, as
+   * DCMTK objects are not safe for concurrent use, even read-only.
+   **/
   class ORTHANC_PUBLIC ParsedDicomCache : public boost::noncopyable
   {
   private:
     class Item;
 
+    typedef LeastRecentlyUsedIndex<std::string, boost::shared_ptr<Item> >  Content;
+
 #if !defined(__EMSCRIPTEN__)
-    boost::mutex                        mutex_;
+    boost::mutex  mutex_;
 #endif
     
-    size_t                              cacheSize_;
-    std::unique_ptr<MemoryObjectCache>  cache_;
-    std::unique_ptr<ParsedDicomFile>    largeDicom_;
-    std::string                         largeId_;
-    size_t                              largeSize_;
+    size_t           cacheSize_;
+    size_t           currentSize_;
+    Content          content_;
+    CacheStatistics  statistics_;
+
+    void Recycle(std::vector<boost::shared_ptr<Item> >& recycled,
+                 size_t targetSize);
+
+    void RemoveInternal(const std::string& id,
+                        const boost::shared_ptr<Item>& item);
 
   public:
     explicit ParsedDicomCache(size_t size);
 
-    size_t GetNumberOfItems();  // For unit tests only
+    size_t GetNumberOfItems();
+
+    size_t GetCurrentSize();
+
+    size_t GetMaximumSize();
 
-    size_t GetCurrentSize();  // For unit tests only
+    void SetMaximumSize(size_t size);
+
+    // Records the time that was needed to read and parse one file
+    // after a cache miss (new in Orthanc 1.12.12)
+    void AddLoad(uint64_t microseconds);
+
+    void GetStatistics(CacheStatistics& target);
 
     void Invalidate(const std::string& id);
 
@@ -57,23 +91,42 @@ namespace Orthanc
                  ParsedDicomFile* dicom,  // Takes ownership
                  size_t fileSize);
 
+    /**
+     * New in Orthanc 1.12.12: The entry is tagged with a revision
+     * (typically, the UUID of the attachment it was read from). An
+     * existing entry with another revision is replaced, which keeps
+     * the cache coherent if the same file is modified by another
+     * Orthanc server that shares the same database.
+     **/
+    void Acquire(const std::string& id,
+                 ParsedDicomFile* dicom,  // Takes ownership
+                 size_t fileSize,
+                 const std::string& revision);
+
     class ORTHANC_PUBLIC Accessor : public boost::noncopyable
     {
     private:
+      boost::shared_ptr<Item>    item_;
+
 #if !defined(__EMSCRIPTEN__)
       boost::mutex::scoped_lock  lock_;
 #endif
-      
-      std::string                id_;
-      ParsedDicomFile*           file_;
-      size_t                     fileSize_;
 
-      std::unique_ptr<MemoryObjectCache::Accessor>  accessor_;
-      
+      void Lookup(ParsedDicomCache& that,
+                  const std::string& id,
+                  const std::string* expectedRevision);
+
     public:
       Accessor(ParsedDicomCache& that,
                const std::string& id);
 
+      // New in Orthanc 1.12.12: An entry whose revision differs from
+      // "expectedRevision" is considered as outdated: It is removed
+      // from the cache, and the accessor is invalid (cache miss)
+      Accessor(ParsedDicomCache& that,
+               const std::string& id,
+               const std::string& expectedRevision);
+
       bool IsValid() const;
 
       ParsedDicomFile& GetDicom() const;
@@ -99,6 +99,7 @@
 #  include "../Images/PngReader.h"
 #endif
 
+#include <algorithm>
 #include <list>
 #include <limits>
 
@@ -258,6 +259,11 @@ namespace Orthanc
         return EnumerationToString(MimeType_Binary);
       }
 
+      virtual bool LookupLocalFile(std::string& path) ORTHANC_OVERRIDE
+      {
+        return false;
+      }
+
       virtual uint64_t  GetContentLength() ORTHANC_OVERRIDE
       {
         return length_;
@@ -544,6 +550,65 @@ namespace Orthanc
   }
 
 
+  void ParsedDicomFile::RemoveAndClearTags(const std::vector<DicomTag>& removals,
+                                           const std::vector<DicomTag>& clearings,
+                                           bool removePrivateTags,
+                                           const std::set<DicomTag>& privateTagsToKeep)
+  {
+    InvalidateCache();
+
+    DcmDataset& dataset = *GetDcmtkObject().getDataset();
+
+    // Loop over the first-level tags of the dataset to detect the
+    // tags to be removed or cleared
+    typedef std::list<DcmElement*> Tags;
+    Tags toRemove;
+    std::list<DcmTagKey> toClear;
+
+    for (unsigned long i = 0; i < dataset.card(); i++)
+    {
+      DcmElement* element = dataset.getElement(i);
+      DcmTag tag(element->getTag());
+      DicomTag tmp = FromDcmtkBridge::Convert(tag);
+
+      if (removePrivateTags &&
+          tag.isPrivate() &&
+          privateTagsToKeep.find(tmp) == privateTagsToKeep.end())
+      {
+        toRemove.push_back(element);
+      }
+      else if (std::binary_search(removals.begin(), removals.end(), tmp))
+      {
+        toRemove.push_back(element);
+      }
+      else if (tmp.GetElement() != 0x0000 &&  // Generic group length tags are handled by DCMTK serialization
+               std::binary_search(clearings.begin(), clearings.end(), tmp))
+      {
+        toClear.push_back(tag);
+      }
+    }
+
+    // Apply the modifications once the loop is over, as they would
+    // invalidate the indices of the elements
+    for (Tags::iterator it = toRemove.begin(); it != toRemove.end(); ++it)
+    {
+      DcmElement* removed = dataset.remove(*it);
+      if (removed != NULL)
+      {
+        delete removed;
+      }
+    }
+
+    for (std::list<DcmTagKey>::const_iterator it = toClear.begin(); it != toClear.end(); ++it)
+    {
+      if (!dataset.insertEmptyElement(*it, OFTrue /* replace old value */).good())
+      {
+        THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+      }
+    }
+  }
+
+
   static void InsertInternal(DcmDataset& dicom,
                              DcmElement* element)
   {
@@ -1555,6 +1620,18 @@ namespace Orthanc
   }
 
 
+  void ParsedDicomFile::DatasetToJson(Json::Value& target, 
+                                      DicomToJsonFormat format,
+                                      DicomToJsonFlags flags,
+                                      unsigned int maxStringLength,
+                                      const std::set<DicomTag>& ignoreTagLength,
+                                      const std::set<DicomTag>& whitelist) const
+  {
+    FromDcmtkBridge::ExtractDicomAsJson(target, *GetDcmtkObjectConst().getDataset(),
+                                        format, flags, maxStringLength, ignoreTagLength, whitelist);
+  }
+
+
   void ParsedDicomFile::HeaderToJson(Json::Value& target, 
                                      DicomToJsonFormat format) const
   {
@@ -1685,6 +1762,23 @@ namespace Orthanc
   }
 
 
+  static MimeType GetRawFrameMimeType(E_TransferSyntax transferSyntax)
+  {
+    switch (transferSyntax)
+    {
+      case EXS_JPEGProcess1:
+        return MimeType_Jpeg;
+       
+      case EXS_JPEG2000LosslessOnly:
+      case EXS_JPEG2000:
+        return MimeType_Jpeg2000;
+
+      default:
+        return MimeType_Binary;
+    }
+  }
+
+
   void ParsedDicomFile::GetRawFrame(std::string& target,
                                     MimeType& mime,
                                     unsigned int frameId) const
@@ -1710,21 +1804,42 @@ namespace Orthanc
 
     pimpl_->frameIndex_->GetRawFrame(target, frameId);
 
-    E_TransferSyntax transferSyntax = dcmDataset->getCurrentXfer();
-    switch (transferSyntax)
+    mime = GetRawFrameMimeType(dcmDataset->getCurrentXfer());
+  }
+
+
+  bool ParsedDicomFile::LookupRawFrameBuffer(const void*& buffer,
+                                             size_t& size,
+                                             MimeType& mime,
+                                             unsigned int frameId) const
+  {
+    DcmDataset* dcmDataset = GetDcmtkObjectConst().getDataset();
+
+    if (dcmDataset == NULL)
     {
-      case EXS_JPEGProcess1:
-        mime = MimeType_Jpeg;
-        break;
-       
-      case EXS_JPEG2000LosslessOnly:
-      case EXS_JPEG2000:
-        mime = MimeType_Jpeg2000;
-        break;
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
 
-      default:
-        mime = MimeType_Binary;
-        break;
+    if (!this->HasTag(DICOM_TAG_PIXEL_DATA) &&
+        !DicomImageDecoder::IsPsmctRle1(*dcmDataset))
+    {
+      throw OrthancException(ErrorCode_BadRequest, "Cannot extract a frame from a DICOM file that does not have pixel data.");
+    }
+
+    if (pimpl_->frameIndex_.get() == NULL)
+    {
+      assert(pimpl_->file_ != NULL);
+      pimpl_->frameIndex_.reset(new DicomFrameIndex(*dcmDataset));
+    }
+
+    if (pimpl_->frameIndex_->LookupRawFrameBuffer(buffer, size, frameId))
+    {
+      mime = GetRawFrameMimeType(dcmDataset->getCurrentXfer());
+      return true;
+    }
+    else
+    {
+      return false;
     }
   }
 
@@ -1774,6 +1889,16 @@ namespace Orthanc
   }
 
 
+  void ParsedDicomFile::ExtractDicomSummary(DicomMap& target,
+                                            unsigned int maxTagLength,
+                                            const std::set<DicomTag>& ignoreTagLength,
+                                            const std::set<DicomTag>& whitelist) const
+  {
+    FromDcmtkBridge::ExtractDicomSummary(target, *GetDcmtkObjectConst().getDataset(),
+                                         maxTagLength, ignoreTagLength, whitelist);
+  }
+
+
   bool ParsedDicomFile::LookupTransferSyntax(DicomTransferSyntax& result) const
   {
     return FromDcmtkBridge::LookupOrthancTransferSyntax(result, GetDcmtkObjectConst());
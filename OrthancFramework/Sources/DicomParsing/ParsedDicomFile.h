@@ -198,6 +198,16 @@ namespace Orthanc
 
     void RemovePrivateTags(const std::set<DicomTag>& toKeep);
 
+    // Removes the first-level tags of "removals" and clears the
+    // existing first-level tags of "clearings", in one single pass
+    // over the dataset. The private tags that are not listed in
+    // "privateTagsToKeep" are also removed if "removePrivateTags" is
+    // "true". Both vectors must be sorted (new in Orthanc 1.12.12).
+    void RemoveAndClearTags(const std::vector<DicomTag>& removals,
+                            const std::vector<DicomTag>& clearings,
+                            bool removePrivateTags,
+                            const std::set<DicomTag>& privateTagsToKeep);
+
     // WARNING: This function handles the decoding of strings to UTF8
     bool GetTagValue(std::string& value,
                      const DicomTag& tag) const;
@@ -238,6 +248,15 @@ namespace Orthanc
                        DicomToJsonFlags flags,
                        unsigned int maxStringLength,
                        const std::set<DicomTag>& ignoreTagLength) const;
+
+    // Only converts the first-level tags listed in "whitelist", the
+    // other elements being skipped (new in Orthanc 1.12.12)
+    void DatasetToJson(Json::Value& target, 
+                       DicomToJsonFormat format,
+                       DicomToJsonFlags flags,
+                       unsigned int maxStringLength,
+                       const std::set<DicomTag>& ignoreTagLength,
+                       const std::set<DicomTag>& whitelist) const;
       
     void HeaderToJson(Json::Value& target, 
                       DicomToJsonFormat format) const;
@@ -250,6 +269,15 @@ namespace Orthanc
                      MimeType& mime,   // OUT
                      unsigned int frameId) const;  // IN
 
+    // New in Orthanc 1.12.12: Same as "GetRawFrame()", but without
+    // copy. Returns "false" if the frame is not stored as one
+    // contiguous buffer, in which case "GetRawFrame()" must be used.
+    // The buffer is only valid until the file is modified.
+    bool LookupRawFrameBuffer(const void*& buffer, // OUT
+                              size_t& size,        // OUT
+                              MimeType& mime,      // OUT
+                              unsigned int frameId) const;  // IN
+
     unsigned int GetFramesCount() const;
 
     static ParsedDicomFile* CreateFromJson(const Json::Value& value,
@@ -275,6 +303,16 @@ namespace Orthanc
                              unsigned int maxTagLength,
                              const std::set<DicomTag>& ignoreTagLength) const;
 
+    /**
+     * This flavor only extracts the first-level tags listed in
+     * "whitelist", without converting the other elements (new in
+     * Orthanc 1.12.12).
+     **/
+    void ExtractDicomSummary(DicomMap& target,
+                             unsigned int maxTagLength,
+                             const std::set<DicomTag>& ignoreTagLength,
+                             const std::set<DicomTag>& whitelist) const;
+
     bool LookupTransferSyntax(DicomTransferSyntax& result) const;
 
     bool LookupPhotometricInterpretation(PhotometricInterpretation& result) const;
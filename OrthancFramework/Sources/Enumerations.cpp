@@ -1122,6 +1122,9 @@ namespace Orthanc
       case MimeType_Stl:
         return MIME_STL;
 
+      case MimeType_Tar:
+        return MIME_TAR;
+
       default:
         throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
@@ -1908,6 +1911,11 @@ namespace Orthanc
       target = MimeType_Stl;
       return true;
     }
+    else if (source == MIME_TAR)
+    {
+      target = MimeType_Tar;
+      return true;
+    }
     else
     {
       return false;
@@ -2592,6 +2600,108 @@ namespace Orthanc
         throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
   }
+
+  const char* EnumerationToString(CachePolicy policy)
+  {
+    switch (policy)
+    {
+      case CachePolicy_LeastRecentlyUsed:
+        return "LRU";
+
+      case CachePolicy_TwoQueues:
+        return "2Q";
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+  CachePolicy StringToCachePolicy(const std::string& str)
+  {
+    if (str == "LRU")
+    {
+      return CachePolicy_LeastRecentlyUsed;
+    }
+    else if (str == "2Q")
+    {
+      return CachePolicy_TwoQueues;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "CachePolicy can be \"LRU\" or \"2Q\": " + str);
+    }
+  }
+
+
+  const char* EnumerationToString(CompressionType compression)
+  {
+    switch (compression)
+    {
+      case CompressionType_None:
+        return "None";
+
+      case CompressionType_ZlibWithSize:
+        return "Zlib";
+
+      case CompressionType_ZstdWithSize:
+        return "Zstd";
+
+      case CompressionType_Lz4WithSize:
+        return "Lz4";
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  CompressionType StringToCompressionType(const std::string& str)
+  {
+    if (str == "None")
+    {
+      return CompressionType_None;
+    }
+    else if (str == "Zlib")
+    {
+      return CompressionType_ZlibWithSize;
+    }
+    else if (str == "Zstd")
+    {
+      return CompressionType_ZstdWithSize;
+    }
+    else if (str == "Lz4")
+    {
+      return CompressionType_Lz4WithSize;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "CompressionType can be \"None\", \"Zlib\", \"Zstd\" or \"Lz4\": " + str);
+    }
+  }
+
+
+  bool IsCompressionTypeSupported(CompressionType compression)
+  {
+    switch (compression)
+    {
+      case CompressionType_None:
+        return true;
+
+      case CompressionType_ZlibWithSize:
+        return (ORTHANC_ENABLE_ZLIB == 1);
+
+      case CompressionType_ZstdWithSize:
+        return (ORTHANC_ENABLE_ZSTD == 1);
+
+      case CompressionType_Lz4WithSize:
+        return (ORTHANC_ENABLE_LZ4 == 1);
+
+      default:
+        return false;
+    }
+  }
 }
 
 
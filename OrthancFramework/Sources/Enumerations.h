@@ -48,6 +48,9 @@ namespace Orthanc
   static const char* const MIME_MTL = "model/mtl";
   static const char* const MIME_STL = "model/stl";
 
+  // Added in Orthanc 1.12.12
+  static const char* const MIME_TAR = "application/x-tar";
+
   static const char* const MIME_CSS = "text/css";
   static const char* const MIME_DICOM = "application/dicom";
   static const char* const MIME_GIF = "image/gif";
@@ -109,7 +112,8 @@ namespace Orthanc
     MimeType_Ico,
     MimeType_Mtl,             // MTL - New in Orthanc 1.12.1
     MimeType_Obj,             // OBJ - New in Orthanc 1.12.1
-    MimeType_Stl              // STL - New in Orthanc 1.12.1
+    MimeType_Stl,             // STL - New in Orthanc 1.12.1
+    MimeType_Tar              // TAR - New in Orthanc 1.12.12
   };
 
   
@@ -494,7 +498,8 @@ namespace Orthanc
   {
     HttpCompression_None,
     HttpCompression_Deflate,
-    HttpCompression_Gzip
+    HttpCompression_Gzip,
+    HttpCompression_Zstd     // New in Orthanc 1.12.12
   };
 
 
@@ -784,7 +789,27 @@ namespace Orthanc
      * buffer is non-empty, the buffer is compatible with the
      * "deflate" HTTP compression.
      **/
-    CompressionType_ZlibWithSize = 2
+    CompressionType_ZlibWithSize = 2,
+
+    /**
+     * Buffer that is compressed using zstd, prefixed with a
+     * "uint64_t" (8 bytes, little-endian) that encodes the size of
+     * the uncompressed buffer. If the compressed buffer is empty, its
+     * represents an empty uncompressed buffer. This format is
+     * internal to Orthanc, and requires Orthanc to be built with
+     * zstd support (new in Orthanc 1.12.12).
+     **/
+    CompressionType_ZstdWithSize = 3,
+
+    /**
+     * Buffer that is compressed using the LZ4 block format, prefixed
+     * with a "uint64_t" (8 bytes, little-endian) that encodes the
+     * size of the uncompressed buffer. If the compressed buffer is
+     * empty, its represents an empty uncompressed buffer. This format
+     * is internal to Orthanc, and requires Orthanc to be built with
+     * LZ4 support (new in Orthanc 1.12.12).
+     **/
+    CompressionType_Lz4WithSize = 4
   };
 
   enum FileContentType
@@ -795,6 +820,14 @@ namespace Orthanc
     FileContentType_Dicom = 1,
     FileContentType_DicomAsJson = 2,          // For Orthanc <= 1.9.0
     FileContentType_DicomUntilPixelData = 3,  // New in Orthanc 1.9.1
+    FileContentType_SeriesThumbnail = 4,      // New in Orthanc 1.12.12
+    FileContentType_DicomFrameOffsets = 5,    // New in Orthanc 1.12.12
+
+    // Range of the instances transcoded to each transfer syntax, as
+    // "FileContentType_TranscodedInstanceFirst + DicomTransferSyntax"
+    // (new in Orthanc 1.12.12)
+    FileContentType_TranscodedInstanceFirst = 256,
+    FileContentType_TranscodedInstanceLast = 511,
 
     // Make sure that the value "65535" can be stored into this enumeration
     FileContentType_StartUser = 1024,
@@ -831,6 +864,12 @@ namespace Orthanc
     TranscodingSopInstanceUidMode_Preserve    // Allow transcoding to lossless and lossy (if lossy, preserve the original SOP Instance UID)
   };
 
+  enum CachePolicy                            // new in Orthanc 1.12.12
+  {
+    CachePolicy_LeastRecentlyUsed,   // Evict the least recently used item
+    CachePolicy_TwoQueues            // Scan-resistant "2Q": New items must be accessed twice before being protected
+  };
+
 
   ORTHANC_PUBLIC
   const char* EnumerationToString(ErrorCode code);
@@ -997,4 +1036,19 @@ namespace Orthanc
 
   ORTHANC_PUBLIC 
   RetrieveMethod StringToRetrieveMethod(const std::string& str);
+
+  ORTHANC_PUBLIC
+  const char* EnumerationToString(CachePolicy policy);
+
+  ORTHANC_PUBLIC
+  CachePolicy StringToCachePolicy(const std::string& str);
+
+  ORTHANC_PUBLIC
+  const char* EnumerationToString(CompressionType compression);
+
+  ORTHANC_PUBLIC
+  CompressionType StringToCompressionType(const std::string& str);
+
+  ORTHANC_PUBLIC
+  bool IsCompressionTypeSupported(CompressionType compression);
 }
@@ -0,0 +1,324 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ContentAddressedStorageArea.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+#include "../Toolbox.h"
+
+#include <boost/lexical_cast.hpp>
+#include <ctype.h>
+#include <string.h>
+
+
+// Prefix of the custom data of the content-addressed attachments,
+// followed by the key of the content, by a colon, and by the custom
+// data of the content in the underlying storage area
+static const char* const CUSTOM_DATA_PREFIX = "orthanc-content:";
+static const size_t KEY_LENGTH = 36;
+
+
+namespace Orthanc
+{
+  ContentAddressedStorageArea::IReferences& ContentAddressedStorageArea::GetReferences() const
+  {
+    if (references_ == NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "No reference counting for the content-addressed storage");
+    }
+    else
+    {
+      return *references_;
+    }
+  }
+
+
+  ContentAddressedStorageArea::ContentAddressedStorageArea(IPluginStorageArea& area) :
+    area_(area),
+    references_(NULL),
+    deduplication_(true)
+  {
+  }
+
+
+  void ContentAddressedStorageArea::SetReferences(IReferences& references)
+  {
+    references_ = &references;
+  }
+
+
+  std::string ContentAddressedStorageArea::ComputeKey(const void* content,
+                                                      size_t size,
+                                                      FileContentType type,
+                                                      CompressionType compression)
+  {
+    std::string name;
+    Toolbox::ComputeSHA1(name, content, size);
+    name += "|" + boost::lexical_cast<std::string>(static_cast<int>(type)) +
+      "|" + boost::lexical_cast<std::string>(static_cast<int>(compression));
+
+    std::string digest;
+    Toolbox::ComputeSHA1(digest, name);
+
+    std::string hex;
+    hex.reserve(40);
+
+    for (size_t i = 0; i < digest.size(); i++)
+    {
+      if (digest[i] != '-')
+      {
+        hex.push_back(digest[i]);
+      }
+    }
+
+    if (hex.size() != 40)
+    {
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
+    // Set the version (5) and the variant (RFC 4122) of the UUID
+    static const char* const VARIANTS = "89ab";
+    const char variant = VARIANTS[(isdigit(hex[16]) ? hex[16] - '0' : tolower(hex[16]) - 'a' + 10) & 3];
+
+    return (hex.substr(0, 8) + "-" + hex.substr(8, 4) + "-5" + hex.substr(13, 3) + "-" +
+            variant + hex.substr(17, 3) + "-" + hex.substr(20, 12));
+  }
+
+
+  std::string ContentAddressedStorageArea::FormatCustomData(const std::string& key,
+                                                            const std::string& areaCustomData)
+  {
+    if (key.size() != KEY_LENGTH)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      return CUSTOM_DATA_PREFIX + key + ":" + areaCustomData;
+    }
+  }
+
+
+  bool ContentAddressedStorageArea::ParseCustomData(std::string& key,
+                                                    std::string& areaCustomData,
+                                                    const std::string& customData)
+  {
+    const size_t prefixLength = strlen(CUSTOM_DATA_PREFIX);
+
+    if (customData.size() >= prefixLength + KEY_LENGTH + 1 &&
+        customData.compare(0, prefixLength, CUSTOM_DATA_PREFIX) == 0 &&
+        customData[prefixLength + KEY_LENGTH] == ':')
+    {
+      key = customData.substr(prefixLength, KEY_LENGTH);
+      areaCustomData = customData.substr(prefixLength + KEY_LENGTH + 1);
+      return Toolbox::IsUuid(key);
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  void ContentAddressedStorageArea::Create(std::string& customData,
+                                           const std::string& uuid,
+                                           const void* content,
+                                           size_t size,
+                                           FileContentType type,
+                                           CompressionType compression,
+                                           const DicomInstanceToStore* dicomInstance)
+  {
+    if (!deduplication_)
+    {
+      area_.Create(customData, uuid, content, size, type, compression, dicomInstance);
+      return;
+    }
+
+    IReferences& references = GetReferences();
+
+    const std::string key = ComputeKey(content, size, type, compression);
+
+    std::string areaCustomData;
+
+    switch (references.AddReference(areaCustomData, key))
+    {
+      case ReferenceStatus_Added:
+        LOG(INFO) << "Attachment " << uuid << " is deduplicated as content " << key;
+        customData = FormatCustomData(key, areaCustomData);
+        return;
+
+      case ReferenceStatus_Missing:
+      {
+        try
+        {
+          area_.Create(areaCustomData, key, content, size, type, compression, dicomInstance);
+        }
+        catch (OrthancException& e)
+        {
+          // Typically, another writer is concurrently storing the same
+          // content, or the previous copy of the content is not fully
+          // removed yet: Fallback to a non-deduplicated write
+          LOG(INFO) << "Cannot store content " << key << ", attachment " << uuid
+                    << " is not deduplicated: " << e.What();
+          area_.Create(customData, uuid, content, size, type, compression, dicomInstance);
+          return;
+        }
+
+        std::string registered = areaCustomData;
+        bool isFirst;
+
+        try
+        {
+          isFirst = references.Register(registered, key);
+        }
+        catch (OrthancException& e)
+        {
+          // The content has been concurrently stored then deleted by
+          // other writers, which might have removed our copy: Don't
+          // reference it
+          LOG(INFO) << "Cannot register content " << key << ", attachment " << uuid
+                    << " is not deduplicated: " << e.What();
+          area_.Create(customData, uuid, content, size, type, compression, dicomInstance);
+          return;
+        }
+
+        if (!isFirst &&
+            registered != areaCustomData)
+        {
+          // Another writer has concurrently stored the same content
+          // at another location: Discard our copy and use theirs
+          try
+          {
+            area_.Remove(key, type, areaCustomData);
+          }
+          catch (OrthancException& e)
+          {
+            LOG(WARNING) << "Cannot remove a duplicate copy of content " << key << ": " << e.What();
+          }
+        }
+
+        customData = FormatCustomData(key, registered);
+        return;
+      }
+
+      case ReferenceStatus_Deleting:
+        // Don't write the content while its previous copy is being
+        // removed, as this copy could be removed after the write
+        LOG(INFO) << "Content " << key << " is being deleted, attachment " << uuid << " is not deduplicated";
+        area_.Create(customData, uuid, content, size, type, compression, dicomInstance);
+        return;
+
+      default:
+        THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+  }
+
+
+  IMemoryBuffer* ContentAddressedStorageArea::ReadRange(const std::string& uuid,
+                                                        FileContentType type,
+                                                        uint64_t start /* inclusive */,
+                                                        uint64_t end /* exclusive */,
+                                                        const std::string& customData)
+  {
+    std::string key, areaCustomData;
+    if (ParseCustomData(key, areaCustomData, customData))
+    {
+      return area_.ReadRange(key, type, start, end, areaCustomData);
+    }
+    else
+    {
+      return area_.ReadRange(uuid, type, start, end, customData);
+    }
+  }
+
+
+  void ContentAddressedStorageArea::Remove(const std::string& uuid,
+                                           FileContentType type,
+                                           const std::string& customData)
+  {
+    std::string key, areaCustomData;
+    if (ParseCustomData(key, areaCustomData, customData))
+    {
+      IReferences& references = GetReferences();
+
+      if (references.RemoveReference(key))
+      {
+        LOG(INFO) << "Removing content " << key << ", as its last attachment " << uuid << " was deleted";
+
+        try
+        {
+          area_.Remove(key, type, areaCustomData);
+        }
+        catch (OrthancException&)
+        {
+          references.Forget(key);
+          throw;
+        }
+
+        references.Forget(key);
+      }
+    }
+    else
+    {
+      area_.Remove(uuid, type, customData);
+    }
+  }
+
+
+  bool ContentAddressedStorageArea::LookupLocalPath(std::string& path,
+                                                    const std::string& uuid,
+                                                    FileContentType type,
+                                                    const std::string& customData) const
+  {
+    std::string key, areaCustomData;
+    if (ParseCustomData(key, areaCustomData, customData))
+    {
+      return area_.LookupLocalPath(path, key, type, areaCustomData);
+    }
+    else
+    {
+      return area_.LookupLocalPath(path, uuid, type, customData);
+    }
+  }
+
+
+  IStorageAreaReader* ContentAddressedStorageArea::OpenRead(const std::string& uuid,
+                                                            FileContentType type,
+                                                            const std::string& customData)
+  {
+    std::string key, areaCustomData;
+    if (ParseCustomData(key, areaCustomData, customData))
+    {
+      return area_.OpenRead(key, type, areaCustomData);
+    }
+    else
+    {
+      return area_.OpenRead(uuid, type, customData);
+    }
+  }
+}
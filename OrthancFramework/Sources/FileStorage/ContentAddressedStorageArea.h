@@ -0,0 +1,181 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include "IStorageArea.h"
+#include "../Compatibility.h"  // For ORTHANC_OVERRIDE
+
+
+namespace Orthanc
+{
+  /**
+   * Decorator that deduplicates the identical attachments, by storing
+   * them in the underlying storage area under a key that is derived
+   * from the hash of their content (new in Orthanc 1.12.12). Each
+   * attachment keeps its own UUID in the database, and its custom
+   * data records the key of its content, whose references are
+   * counted by "IReferences" (typically in the database index). The
+   * file is only written by the first reference and removed with the
+   * last one. The attachments without such custom data (e.g. stored
+   * before the deduplication was enabled, or through "OpenWrite()")
+   * are forwarded as such to the underlying storage area.
+   **/
+  class ORTHANC_PUBLIC ContentAddressedStorageArea : public IPluginStorageArea
+  {
+  public:
+    enum ReferenceStatus
+    {
+      ReferenceStatus_Missing,   // The content is not stored yet
+      ReferenceStatus_Added,     // The content is stored, and one reference was added to it
+      ReferenceStatus_Deleting   // The last reference was removed, and the content is being deleted
+    };
+
+    // The implementations must be thread-safe, each method being atomic
+    class IReferences : public boost::noncopyable
+    {
+    public:
+      virtual ~IReferences()
+      {
+      }
+
+      // If the content is stored, adds one reference to it, and
+      // returns the custom data of the content in the underlying
+      // storage area
+      virtual ReferenceStatus AddReference(std::string& customData /* out */,
+                                           const std::string& key) = 0;
+
+      // Registers a content that was just written, with one
+      // reference. Returns "false" if the content was concurrently
+      // registered by another writer, in which case one reference is
+      // added to it, and its custom data is returned. Throws if the
+      // content is being deleted.
+      virtual bool Register(std::string& customData /* in-out */,
+                            const std::string& key) = 0;
+
+      // Returns "true" iff the last reference was removed, in which
+      // case the content is marked as being deleted until "Forget()"
+      virtual bool RemoveReference(const std::string& key) = 0;
+
+      virtual void Forget(const std::string& key) = 0;
+    };
+
+  private:
+    IPluginStorageArea&  area_;
+    IReferences*         references_;
+    bool                 deduplication_;
+
+    IReferences& GetReferences() const;
+
+  public:
+    explicit ContentAddressedStorageArea(IPluginStorageArea& area);
+
+    // Must be called before the first write or removal
+    void SetReferences(IReferences& references);
+
+    // If disabled, the new attachments are written as such to the
+    // underlying storage area, but the content-addressed attachments
+    // are still read and removed through their references
+    void SetDeduplication(bool enabled)
+    {
+      deduplication_ = enabled;
+    }
+
+    bool IsDeduplication() const
+    {
+      return deduplication_;
+    }
+
+    // The key is formatted as a name-based UUID (version 5), derived
+    // from the SHA-1 of the stored bytes, of their type and of their
+    // compression
+    static std::string ComputeKey(const void* content,
+                                  size_t size,
+                                  FileContentType type,
+                                  CompressionType compression);
+
+    static std::string FormatCustomData(const std::string& key,
+                                        const std::string& areaCustomData);
+
+    // Returns "false" if the attachment is not content-addressed
+    static bool ParseCustomData(std::string& key /* out */,
+                                std::string& areaCustomData /* out */,
+                                const std::string& customData);
+
+    virtual void Create(std::string& customData,
+                        const std::string& uuid,
+                        const void* content,
+                        size_t size,
+                        FileContentType type,
+                        CompressionType compression,
+                        const DicomInstanceToStore* dicomInstance) ORTHANC_OVERRIDE;
+
+    virtual IMemoryBuffer* ReadRange(const std::string& uuid,
+                                     FileContentType type,
+                                     uint64_t start /* inclusive */,
+                                     uint64_t end /* exclusive */,
+                                     const std::string& customData) ORTHANC_OVERRIDE;
+
+    virtual bool HasEfficientReadRange() const ORTHANC_OVERRIDE
+    {
+      return area_.HasEfficientReadRange();
+    }
+
+    virtual void Remove(const std::string& uuid,
+                        FileContentType type,
+                        const std::string& customData) ORTHANC_OVERRIDE;
+
+    virtual bool LookupLocalPath(std::string& path,
+                                 const std::string& uuid,
+                                 FileContentType type,
+                                 const std::string& customData) const ORTHANC_OVERRIDE;
+
+    virtual bool HasStreamingAccess() const ORTHANC_OVERRIDE
+    {
+      return area_.HasStreamingAccess();
+    }
+
+    // The streamed writes are not deduplicated, as their hash is only
+    // known once they are complete
+    virtual IStorageAreaWriter* OpenWrite(const std::string& uuid,
+                                          FileContentType type,
+                                          CompressionType compression,
+                                          uint64_t size,
+                                          const DicomInstanceToStore* dicomInstance) ORTHANC_OVERRIDE
+    {
+      return area_.OpenWrite(uuid, type, compression, size, dicomInstance);
+    }
+
+    virtual IStorageAreaReader* OpenRead(const std::string& uuid,
+                                         FileContentType type,
+                                         const std::string& customData) ORTHANC_OVERRIDE;
+
+    virtual const std::string& GetBackendName() const ORTHANC_OVERRIDE
+    {
+      return area_.GetBackendName();
+    }
+  };
+}
@@ -31,6 +31,7 @@
 
 #include "../ElapsedTimer.h"
 #include "../Logging.h"
+#include "../MemoryMappedFileBuffer.h"
 #include "../OrthancException.h"
 #include "../StringMemoryBuffer.h"
 #include "../SystemToolbox.h"
@@ -38,6 +39,13 @@
 
 #include <boost/filesystem/fstream.hpp>
 
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
 
 static std::string ToString(const boost::filesystem::path& p)
 {
@@ -81,21 +89,234 @@ namespace Orthanc
     SystemToolbox::MakeDirectory(root);
   }
 
+  class FilesystemStorage::GroupCommit : public boost::noncopyable
+  {
+  private:
+    struct Batch : public boost::noncopyable
+    {
+      std::set<boost::filesystem::path>  files_;
+      bool                               done_;
+      bool                               success_;
+
+      Batch() :
+        done_(false),
+        success_(false)
+      {
+      }
+    };
+
+    boost::filesystem::path    root_;
+    unsigned int               window_;
+    boost::mutex               mutex_;
+    boost::condition_variable  pendingCondition_;
+    boost::condition_variable  doneCondition_;
+    boost::shared_ptr<Batch>   current_;
+    bool                       stopped_;
+    boost::thread              flusher_;
+
+#if !defined(__linux__) || defined(__LSB_VERSION__)
+    static bool SyncPath(const boost::filesystem::path& path,
+                         bool isDirectory)
+    {
+#  if defined(_WIN32)
+      if (isDirectory)
+      {
+        return true;  // Directories cannot be flushed on Microsoft Windows
+      }
+
+      HANDLE handle = ::CreateFileW(path.wstring().c_str(), GENERIC_WRITE,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+      if (handle == INVALID_HANDLE_VALUE)
+      {
+        return false;
+      }
+
+      const bool success = (::FlushFileBuffers(handle) != 0);
+      ::CloseHandle(handle);
+      return success;
+#  else
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+      {
+        return false;
+      }
+
+      const bool success = (::fsync(fd) == 0);
+      ::close(fd);
+      return success;
+#  endif
+    }
+#endif
+
+    bool Flush(const Batch& batch) const
+    {
+#if defined(__linux__) && !defined(__LSB_VERSION__)
+      // One single "syncfs()" makes all the files of the batch and
+      // their parent directories durable at once
+      int fd = ::open(root_.c_str(), O_RDONLY | O_DIRECTORY);
+      if (fd < 0)
+      {
+        return false;
+      }
+
+      const bool success = (::syncfs(fd) == 0);
+      ::close(fd);
+      return success;
+#else
+      bool success = true;
+      std::set<boost::filesystem::path> directories;
+
+      for (std::set<boost::filesystem::path>::const_iterator
+             it = batch.files_.begin(); it != batch.files_.end(); ++it)
+      {
+        success = SyncPath(*it, false) && success;
+        directories.insert(it->parent_path());
+      }
+
+      for (std::set<boost::filesystem::path>::const_iterator
+             it = directories.begin(); it != directories.end(); ++it)
+      {
+        success = SyncPath(*it, true) && success;
+      }
+
+      return success;
+#endif
+    }
+
+    void Worker()
+    {
+      for (;;)
+      {
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+
+          while (!stopped_ &&
+                 current_->files_.empty())
+          {
+            pendingCondition_.wait(lock);
+          }
+
+          if (current_->files_.empty())
+          {
+            assert(stopped_);
+            return;
+          }
+        }
+
+        // Give the other writers a chance to join the current batch
+        boost::this_thread::sleep(boost::posix_time::milliseconds(window_));
+
+        boost::shared_ptr<Batch> batch;
+
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          batch = current_;
+          current_.reset(new Batch);
+        }
+
+        const bool success = Flush(*batch);
+
+        if (!success)
+        {
+          LOG(ERROR) << "Cannot force flush to disk a batch of " << batch->files_.size() << " files";
+        }
+
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          batch->done_ = true;
+          batch->success_ = success;
+        }
+
+        doneCondition_.notify_all();
+      }
+    }
+
+  public:
+    GroupCommit(const boost::filesystem::path& root,
+                unsigned int window) :
+      root_(root),
+      window_(window),
+      current_(new Batch),
+      stopped_(false)
+    {
+      flusher_ = boost::thread(&GroupCommit::Worker, this);
+    }
+
+    ~GroupCommit()
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        stopped_ = true;
+      }
+
+      pendingCondition_.notify_all();
+
+      if (flusher_.joinable())
+      {
+        flusher_.join();
+      }
+    }
+
+    void WaitDurable(const boost::filesystem::path& path)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      boost::shared_ptr<Batch> batch = current_;
+      batch->files_.insert(path);
+      pendingCondition_.notify_one();
+
+      while (!batch->done_)
+      {
+        doneCondition_.wait(lock);
+      }
+
+      if (!batch->success_)
+      {
+        throw OrthancException(ErrorCode_CannotWriteFile, "Cannot force flush to disk");
+      }
+    }
+  };
+
+
   FilesystemStorage::FilesystemStorage(const boost::filesystem::path &root) :
-    fsyncOnWrite_(false)
+    fsyncOnWrite_(false),
+    memoryMappingThreshold_(0)
   {
     Setup(root);
   }
 
   FilesystemStorage::FilesystemStorage(const boost::filesystem::path &root,
                                        bool fsyncOnWrite) :
-    fsyncOnWrite_(fsyncOnWrite)
+    fsyncOnWrite_(fsyncOnWrite),
+    memoryMappingThreshold_(0)
   {
     Setup(root);
   }
 
 
 
+  FilesystemStorage::~FilesystemStorage()
+  {
+    // Stops the flusher thread, if any, after its last batch
+    groupCommit_.reset(NULL);
+  }
+
+
+  void FilesystemStorage::SetGroupCommitWindow(unsigned int window)
+  {
+    if (!fsyncOnWrite_ ||
+        window == 0)
+    {
+      groupCommit_.reset(NULL);
+    }
+    else
+    {
+      groupCommit_.reset(new GroupCommit(root_, window));
+    }
+  }
+
+
   static const char* GetDescriptionInternal(FileContentType content)
   {
     // This function is for logging only (internal use), a more
@@ -114,8 +335,22 @@ namespace Orthanc
       case FileContentType_DicomUntilPixelData:
         return "DICOM until pixel data";
 
+      case FileContentType_SeriesThumbnail:
+        return "Thumbnail of series";
+
+      case FileContentType_DicomFrameOffsets:
+        return "Offsets of the DICOM frames";
+
       default:
-        return "User-defined";
+        if (content >= FileContentType_TranscodedInstanceFirst &&
+            content <= FileContentType_TranscodedInstanceLast)
+        {
+          return "Transcoded DICOM";
+        }
+        else
+        {
+          return "User-defined";
+        }
     }
   }
 
@@ -172,10 +407,8 @@ namespace Orthanc
 
       try 
       {
-        SystemToolbox::WriteFile(content, size, path, fsyncOnWrite_);
-        
-        LOG(INFO) << "Created attachment \"" << uuid << "\" (" << timer.GetHumanTransferSpeed(true, size) << ")";
-        return;
+        SystemToolbox::WriteFile(content, size, path, fsyncOnWrite_ && groupCommit_.get() == NULL);
+        break;
       }
       catch (OrthancException&)
       {
@@ -185,6 +418,32 @@ namespace Orthanc
         }
       }
     }
+
+    if (groupCommit_.get() != NULL)
+    {
+      groupCommit_->WaitDurable(path);
+    }
+
+    LOG(INFO) << "Created attachment \"" << uuid << "\" (" << timer.GetHumanTransferSpeed(true, size) << ")";
+  }
+
+
+  IMemoryBuffer* FilesystemStorage::ReadRangeInternal(const boost::filesystem::path& path,
+                                                      uint64_t start,
+                                                      uint64_t end)
+  {
+    if (memoryMappingThreshold_ != 0 &&
+        start <= end &&
+        end - start >= memoryMappingThreshold_)
+    {
+      return new MemoryMappedFileBuffer(path, start, end);
+    }
+    else
+    {
+      std::string content;
+      SystemToolbox::ReadFileRange(content, path, start, end, true /* throw if overflow */);
+      return StringMemoryBuffer::CreateFromSwap(content);
+    }
   }
 
 
@@ -195,12 +454,24 @@ namespace Orthanc
     LOG(INFO) << "Reading attachment \"" << uuid << "\" of \"" << GetDescriptionInternal(type) 
               << "\" content type";
 
-    std::string content;
-    SystemToolbox::ReadFile(content, GetPath(uuid));
+    const boost::filesystem::path path = GetPath(uuid);
 
-    LOG(INFO) << "Read attachment \"" << uuid << "\" (" << timer.GetHumanTransferSpeed(true, content.size()) << ")";
+    std::unique_ptr<IMemoryBuffer> buffer;
 
-    return StringMemoryBuffer::CreateFromSwap(content);
+    if (memoryMappingThreshold_ == 0)
+    {
+      std::string content;
+      SystemToolbox::ReadFile(content, path);
+      buffer.reset(StringMemoryBuffer::CreateFromSwap(content));
+    }
+    else
+    {
+      buffer.reset(ReadRangeInternal(path, 0, SystemToolbox::GetFileSize(path)));
+    }
+
+    LOG(INFO) << "Read attachment \"" << uuid << "\" (" << timer.GetHumanTransferSpeed(true, buffer->GetSize()) << ")";
+
+    return buffer.release();
   }
 
 
@@ -213,12 +484,10 @@ namespace Orthanc
     LOG(INFO) << "Reading attachment \"" << uuid << "\" of \"" << GetDescriptionInternal(type) 
               << "\" content type (range from " << start << " to " << end << ")";
 
-    std::string content;
-    SystemToolbox::ReadFileRange(
-      content, GetPath(uuid), start, end, true /* throw if overflow */);
+    std::unique_ptr<IMemoryBuffer> buffer(ReadRangeInternal(GetPath(uuid), start, end));
 
-    LOG(INFO) << "Read range of attachment \"" << uuid << "\" (" << timer.GetHumanTransferSpeed(true, content.size()) << ")";
-    return StringMemoryBuffer::CreateFromSwap(content);
+    LOG(INFO) << "Read range of attachment \"" << uuid << "\" (" << timer.GetHumanTransferSpeed(true, buffer->GetSize()) << ")";
+    return buffer.release();
   }
 
 
@@ -324,6 +593,15 @@ namespace Orthanc
   }
 
 
+  bool FilesystemStorage::LookupLocalPath(std::string& path,
+                                          const std::string& uuid,
+                                          FileContentType type) const
+  {
+    path = SystemToolbox::PathToUtf8(GetPath(uuid));
+    return true;
+  }
+
+
   uintmax_t FilesystemStorage::GetCapacity() const
   {
     return boost::filesystem::space(root_).capacity;
@@ -337,7 +615,8 @@ namespace Orthanc
 
 #if ORTHANC_BUILDING_FRAMEWORK_LIBRARY == 1
   FilesystemStorage::FilesystemStorage(std::string root) :
-    fsyncOnWrite_(false)
+    fsyncOnWrite_(false),
+    memoryMappingThreshold_(0)
   {
     Setup(root);
   }
@@ -39,6 +39,7 @@
 
 #include <stdint.h>
 #include <boost/filesystem.hpp>
+#include <memory>
 #include <set>
 
 namespace Orthanc
@@ -50,8 +51,16 @@ namespace Orthanc
     friend class FileStorageAccessor;
 
   private:
+    class GroupCommit;
+
     boost::filesystem::path root_;
     bool                    fsyncOnWrite_;
+    uint64_t                memoryMappingThreshold_;
+    std::unique_ptr<GroupCommit>  groupCommit_;
+
+    IMemoryBuffer* ReadRangeInternal(const boost::filesystem::path& path,
+                                     uint64_t start,
+                                     uint64_t end);
 
     boost::filesystem::path GetPath(const std::string& uuid) const;
 
@@ -75,6 +84,34 @@ namespace Orthanc
     FilesystemStorage(const boost::filesystem::path& root,
                       bool fsyncOnWrite);
 
+    virtual ~FilesystemStorage();
+
+    /**
+     * Group commit of the "fsync()" calls (new in Orthanc 1.12.12).
+     * If "fsyncOnWrite" is enabled and "window" is not zero, the new
+     * files are not flushed one by one, but by a background thread
+     * that waits for "window" milliseconds so that the files written
+     * concurrently are made durable in one single batch (together
+     * with their parent directories). "Create()" only returns once
+     * the batch containing its file is durable. This method must be
+     * called before the storage area is shared between threads.
+     **/
+    void SetGroupCommitWindow(unsigned int window);
+
+    // Reads of at least "threshold" bytes are served by mapping the
+    // file into memory instead of copying it into the heap. A value
+    // of "0" disables memory mapping (this is the default). New in
+    // Orthanc 1.12.12.
+    void SetMemoryMappingThreshold(uint64_t threshold)
+    {
+      memoryMappingThreshold_ = threshold;
+    }
+
+    uint64_t GetMemoryMappingThreshold() const
+    {
+      return memoryMappingThreshold_;
+    }
+
     virtual void Create(const std::string& uuid,
                         const void* content, 
                         size_t size,
@@ -97,6 +134,10 @@ namespace Orthanc
     virtual void Remove(const std::string& uuid,
                         FileContentType type) ORTHANC_OVERRIDE;
 
+    virtual bool LookupLocalPath(std::string& path,
+                                 const std::string& uuid,
+                                 FileContentType type) const ORTHANC_OVERRIDE;
+
     void ListAllFiles(std::set<std::string>& result) const;
 
     uintmax_t GetSize(const std::string& uuid) const;
@@ -57,6 +57,46 @@ namespace Orthanc
 
     virtual void Remove(const std::string& uuid,
                         FileContentType type) = 0;
+
+    // Returns "true" iff the file is stored as such on the local
+    // filesystem, in which case it can be sent over HTTP without
+    // being read into memory (new in Orthanc 1.12.12)
+    virtual bool LookupLocalPath(std::string& path,
+                                 const std::string& uuid,
+                                 FileContentType type) const = 0;
+  };
+
+
+  // Streamed write of one file to a storage area (new in Orthanc
+  // 1.12.12). If the writer is destroyed before "Commit()" succeeds,
+  // the partially written file must be discarded.
+  class IStorageAreaWriter : public boost::noncopyable
+  {
+  public:
+    virtual ~IStorageAreaWriter()
+    {
+    }
+
+    virtual void AppendChunk(const void* chunk,
+                             size_t size) = 0;
+
+    virtual void Commit(std::string& customData /* out */) = 0;
+  };
+
+
+  // Streamed read of one file from a storage area (new in Orthanc 1.12.12)
+  class IStorageAreaReader : public boost::noncopyable
+  {
+  public:
+    virtual ~IStorageAreaReader()
+    {
+    }
+
+    // Reads at most "size" bytes into "target", and returns the
+    // number of bytes that were actually read. Returns zero once the
+    // end of the file is reached.
+    virtual size_t ReadChunk(void* target,
+                             size_t size) = 0;
   };
 
 
@@ -87,5 +127,30 @@ namespace Orthanc
     virtual void Remove(const std::string& uuid,
                         FileContentType type,
                         const std::string& customData) = 0;
+
+    // New in Orthanc 1.12.12
+    virtual bool LookupLocalPath(std::string& path,
+                                 const std::string& uuid,
+                                 FileContentType type,
+                                 const std::string& customData) const = 0;
+
+    // Returns "true" iff "OpenWrite()" and "OpenRead()" are available,
+    // which allows to transfer large files by chunks, without having
+    // them entirely in memory (new in Orthanc 1.12.12)
+    virtual bool HasStreamingAccess() const = 0;
+
+    virtual IStorageAreaWriter* OpenWrite(const std::string& uuid,
+                                          FileContentType type,
+                                          CompressionType compression,
+                                          uint64_t size,
+                                          const DicomInstanceToStore* dicomInstance /* can be NULL */) = 0;
+
+    virtual IStorageAreaReader* OpenRead(const std::string& uuid,
+                                         FileContentType type,
+                                         const std::string& customData) = 0;
+
+    // Short name of the backend (e.g. "filesystem" or "plugin"), that
+    // labels the metrics of the storage area (new in Orthanc 1.12.12)
+    virtual const std::string& GetBackendName() const = 0;
   };
 }
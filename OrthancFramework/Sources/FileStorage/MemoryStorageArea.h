@@ -61,5 +61,12 @@ namespace Orthanc
 
     virtual void Remove(const std::string& uuid,
                         FileContentType type) ORTHANC_OVERRIDE;
+
+    virtual bool LookupLocalPath(std::string& path,
+                                 const std::string& uuid,
+                                 FileContentType type) const ORTHANC_OVERRIDE
+    {
+      return false;
+    }
   };
 }
@@ -0,0 +1,474 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "MultiRootStorageArea.h"
+
+#include "../Logging.h"
+#include "../MultiThreading/ThreadPool.h"
+#include "../OrthancException.h"
+#include "../SystemToolbox.h"
+#include "../Toolbox.h"
+
+#include <cassert>
+#include <cstdlib>
+
+
+namespace Orthanc
+{
+  class MultiRootStorageArea::Root : public boost::noncopyable
+  {
+  private:
+    std::string        name_;
+    FilesystemStorage  storage_;
+    unsigned int       weight_;
+    ThreadPool         workers_;  // Must be destructed before "storage_"
+
+  public:
+    Root(const std::string& name,
+         const boost::filesystem::path& path,
+         bool fsyncOnWrite,
+         unsigned int weight,
+         unsigned int threads) :
+      name_(name),
+      storage_(path, fsyncOnWrite),
+      weight_(weight)
+    {
+      workers_.SetLoggingThreadName("STORAGE-" + name);
+      workers_.SetCountThreads(threads);
+      workers_.Start();
+    }
+
+    const std::string& GetName() const
+    {
+      return name_;
+    }
+
+    FilesystemStorage& GetStorage()
+    {
+      return storage_;
+    }
+
+    const FilesystemStorage& GetStorage() const
+    {
+      return storage_;
+    }
+
+    unsigned int GetWeight() const
+    {
+      return weight_;
+    }
+
+    // Runs the operation in the I/O threads of this root, and waits
+    // for its completion. The exceptions are forwarded to the caller.
+    IDynamicObject* Execute(ICallable* operation /* takes ownership */)
+    {
+      std::unique_ptr<Future> future(workers_.Submit(operation));
+      return future->ReleaseResult();
+    }
+
+    bool HasFile(const std::string& uuid,
+                 FileContentType type) const
+    {
+      std::string path;
+      return (storage_.LookupLocalPath(path, uuid, type) &&
+              SystemToolbox::IsRegularFile(SystemToolbox::PathFromUtf8(path)));
+    }
+  };
+
+
+  namespace
+  {
+    class MemoryBufferObject : public IDynamicObject
+    {
+    private:
+      std::unique_ptr<IMemoryBuffer>  buffer_;
+
+    public:
+      explicit MemoryBufferObject(IMemoryBuffer* buffer) :
+        buffer_(buffer)
+      {
+        if (buffer == NULL)
+        {
+          throw OrthancException(ErrorCode_NullPointer);
+        }
+      }
+
+      IMemoryBuffer* ReleaseBuffer()
+      {
+        return buffer_.release();
+      }
+    };
+  }
+
+
+  class MultiRootStorageArea::CreateOperation : public ICallable
+  {
+  private:
+    FilesystemStorage&  storage_;
+    std::string         uuid_;
+    const void*         content_;  // Owned by the caller, that waits for the completion
+    size_t              size_;
+    FileContentType     type_;
+
+  public:
+    CreateOperation(FilesystemStorage& storage,
+                    const std::string& uuid,
+                    const void* content,
+                    size_t size,
+                    FileContentType type) :
+      storage_(storage),
+      uuid_(uuid),
+      content_(content),
+      size_(size),
+      type_(type)
+    {
+    }
+
+    virtual IDynamicObject* Call() ORTHANC_OVERRIDE
+    {
+      storage_.Create(uuid_, content_, size_, type_);
+      return new SingleValueObject<bool>(true);
+    }
+  };
+
+
+  class MultiRootStorageArea::ReadRangeOperation : public ICallable
+  {
+  private:
+    FilesystemStorage&  storage_;
+    std::string         uuid_;
+    FileContentType     type_;
+    uint64_t            start_;
+    uint64_t            end_;
+
+  public:
+    ReadRangeOperation(FilesystemStorage& storage,
+                       const std::string& uuid,
+                       FileContentType type,
+                       uint64_t start,
+                       uint64_t end) :
+      storage_(storage),
+      uuid_(uuid),
+      type_(type),
+      start_(start),
+      end_(end)
+    {
+    }
+
+    virtual IDynamicObject* Call() ORTHANC_OVERRIDE
+    {
+      return new MemoryBufferObject(storage_.ReadRange(uuid_, type_, start_, end_));
+    }
+  };
+
+
+  class MultiRootStorageArea::RemoveOperation : public ICallable
+  {
+  private:
+    FilesystemStorage&  storage_;
+    std::string         uuid_;
+    FileContentType     type_;
+
+  public:
+    RemoveOperation(FilesystemStorage& storage,
+                    const std::string& uuid,
+                    FileContentType type) :
+      storage_(storage),
+      uuid_(uuid),
+      type_(type)
+    {
+    }
+
+    virtual IDynamicObject* Call() ORTHANC_OVERRIDE
+    {
+      storage_.Remove(uuid_, type_);
+      return new SingleValueObject<bool>(true);
+    }
+  };
+
+
+  MultiRootStorageArea::Root& MultiRootStorageArea::SelectRoot(const std::string& uuid) const
+  {
+    if (roots_.empty())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "No root was added to the storage area");
+    }
+
+    if (!Toolbox::IsUuid(uuid))
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    switch (placement_)
+    {
+      case Placement_Hash:
+      case Placement_Weight:
+      {
+        // The UUIDs are random, so their first 32 bits are uniformly distributed
+        const uint64_t hash = static_cast<uint64_t>(strtoul(uuid.substr(0, 8).c_str(), NULL, 16));
+
+        if (placement_ == Placement_Hash)
+        {
+          Roots::const_iterator it = roots_.begin();
+          std::advance(it, hash % roots_.size());
+          return *it->second;
+        }
+        else
+        {
+          assert(totalWeight_ > 0);
+          uint64_t position = hash % totalWeight_;
+
+          for (Roots::const_iterator it = roots_.begin(); it != roots_.end(); ++it)
+          {
+            if (position < it->second->GetWeight())
+            {
+              return *it->second;
+            }
+            else
+            {
+              position -= it->second->GetWeight();
+            }
+          }
+
+          THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);  // Should never happen
+        }
+      }
+
+      case Placement_FreeSpace:
+      {
+        Root* best = NULL;
+        uintmax_t bestSpace = 0;
+
+        for (Roots::const_iterator it = roots_.begin(); it != roots_.end(); ++it)
+        {
+          uintmax_t space = 0;
+
+          try
+          {
+            space = it->second->GetStorage().GetAvailableSpace();
+          }
+          catch (boost::filesystem::filesystem_error& e)
+          {
+            LOG(WARNING) << "Cannot get the available space in storage root \""
+                         << it->first << "\": " << e.what();
+          }
+
+          if (best == NULL ||
+              space > bestSpace)
+          {
+            best = it->second;
+            bestSpace = space;
+          }
+        }
+
+        assert(best != NULL);
+        return *best;
+      }
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  MultiRootStorageArea::Root& MultiRootStorageArea::LocateRoot(const std::string& uuid,
+                                                                 const std::string& customData) const
+  {
+    if (roots_.empty())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "No root was added to the storage area");
+    }
+
+    if (customData.empty())
+    {
+      // The attachment was stored before the storage area spanned
+      // multiple roots, or by a database backend without support for
+      // the custom data: Look for the root that contains the file
+      for (Roots::const_iterator it = roots_.begin(); it != roots_.end(); ++it)
+      {
+        if (it->second->HasFile(uuid, FileContentType_Unknown))
+        {
+          return *it->second;
+        }
+      }
+
+      return *roots_.begin()->second;  // Will fail with a missing file
+    }
+    else
+    {
+      Roots::const_iterator found = roots_.find(customData);
+      if (found == roots_.end())
+      {
+        throw OrthancException(ErrorCode_UnknownResource, "Attachment " + uuid +
+                               " is stored in an unknown root of the storage area: " + customData);
+      }
+      else
+      {
+        return *found->second;
+      }
+    }
+  }
+
+
+  MultiRootStorageArea::MultiRootStorageArea(Placement placement) :
+    placement_(placement),
+    totalWeight_(0),
+    backendName_("filesystem")
+  {
+  }
+
+
+  MultiRootStorageArea::~MultiRootStorageArea()
+  {
+    for (Roots::iterator it = roots_.begin(); it != roots_.end(); ++it)
+    {
+      assert(it->second != NULL);
+      delete it->second;
+    }
+  }
+
+
+  MultiRootStorageArea::Placement MultiRootStorageArea::StringToPlacement(const std::string& value)
+  {
+    if (value == "Hash")
+    {
+      return Placement_Hash;
+    }
+    else if (value == "Weight")
+    {
+      return Placement_Weight;
+    }
+    else if (value == "FreeSpace")
+    {
+      return Placement_FreeSpace;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "Unknown placement policy for the storage roots: " + value);
+    }
+  }
+
+
+  FilesystemStorage& MultiRootStorageArea::AddRoot(const std::string& name,
+                                                   const boost::filesystem::path& path,
+                                                   bool fsyncOnWrite,
+                                                   unsigned int weight,
+                                                   unsigned int threads)
+  {
+    if (name.empty() ||
+        threads == 0 ||
+        (placement_ == Placement_Weight && weight == 0))
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (roots_.find(name) != roots_.end())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "Storage root registered twice: " + name);
+    }
+
+    std::unique_ptr<Root> root(new Root(name, path, fsyncOnWrite, weight, threads));
+    FilesystemStorage& storage = root->GetStorage();
+
+    roots_[name] = root.release();
+    totalWeight_ += weight;
+
+    return storage;
+  }
+
+
+  const std::string& MultiRootStorageArea::GetPlacementRoot(const std::string& uuid) const
+  {
+    return SelectRoot(uuid).GetName();
+  }
+
+
+  void MultiRootStorageArea::Create(std::string& customData,
+                                    const std::string& uuid,
+                                    const void* content,
+                                    size_t size,
+                                    FileContentType type,
+                                    CompressionType compression,
+                                    const DicomInstanceToStore* dicomInstance)
+  {
+    Root& root = SelectRoot(uuid);
+
+    std::unique_ptr<IDynamicObject> done(root.Execute(new CreateOperation(root.GetStorage(), uuid, content, size, type)));
+    customData = root.GetName();
+  }
+
+
+  IMemoryBuffer* MultiRootStorageArea::ReadRange(const std::string& uuid,
+                                                 FileContentType type,
+                                                 uint64_t start /* inclusive */,
+                                                 uint64_t end /* exclusive */,
+                                                 const std::string& customData)
+  {
+    Root& root = LocateRoot(uuid, customData);
+
+    std::unique_ptr<IDynamicObject> result(root.Execute(new ReadRangeOperation(root.GetStorage(), uuid, type, start, end)));
+    return dynamic_cast<MemoryBufferObject&>(*result).ReleaseBuffer();
+  }
+
+
+  void MultiRootStorageArea::Remove(const std::string& uuid,
+                                    FileContentType type,
+                                    const std::string& customData)
+  {
+    Root& root = LocateRoot(uuid, customData);
+
+    std::unique_ptr<IDynamicObject> done(root.Execute(new RemoveOperation(root.GetStorage(), uuid, type)));
+  }
+
+
+  bool MultiRootStorageArea::LookupLocalPath(std::string& path,
+                                             const std::string& uuid,
+                                             FileContentType type,
+                                             const std::string& customData) const
+  {
+    return LocateRoot(uuid, customData).GetStorage().LookupLocalPath(path, uuid, type);
+  }
+
+
+  IStorageAreaWriter* MultiRootStorageArea::OpenWrite(const std::string& uuid,
+                                                      FileContentType type,
+                                                      CompressionType compression,
+                                                      uint64_t size,
+                                                      const DicomInstanceToStore* dicomInstance)
+  {
+    throw OrthancException(ErrorCode_NotImplemented, "This storage area has no streaming access");
+  }
+
+
+  IStorageAreaReader* MultiRootStorageArea::OpenRead(const std::string& uuid,
+                                                     FileContentType type,
+                                                     const std::string& customData)
+  {
+    throw OrthancException(ErrorCode_NotImplemented, "This storage area has no streaming access");
+  }
+}
@@ -0,0 +1,165 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 1
+#  error The class MultiRootStorageArea cannot be used in sandboxed environments
+#endif
+
+#include "FilesystemStorage.h"
+
+#include <map>
+
+
+namespace Orthanc
+{
+  /**
+   * Storage area that spreads the attachments over several roots of
+   * the filesystem, typically one per volume (new in Orthanc
+   * 1.12.12). The root of a new attachment is chosen by a
+   * deterministic placement policy, and its name is returned as the
+   * custom data of the attachment, which routes the subsequent reads
+   * and removals. Each root has its own pool of I/O threads, so that
+   * the accesses to distinct volumes are done in parallel, and that a
+   * slow volume doesn't hold the threads that access the other ones.
+   **/
+  class ORTHANC_PUBLIC MultiRootStorageArea : public IPluginStorageArea
+  {
+  public:
+    enum Placement
+    {
+      Placement_Hash,       // Uniform distribution according to the UUID
+      Placement_Weight,     // Distribution according to the UUID, proportional to the weights
+      Placement_FreeSpace   // Root with the most available space
+    };
+
+  private:
+    class Root;
+    class CreateOperation;
+    class ReadRangeOperation;
+    class RemoveOperation;
+
+    typedef std::map<std::string, Root*>  Roots;
+
+    Roots        roots_;
+    Placement    placement_;
+    uint64_t     totalWeight_;
+    std::string  backendName_;
+
+    Root& SelectRoot(const std::string& uuid) const;
+
+    Root& LocateRoot(const std::string& uuid,
+                     const std::string& customData) const;
+
+  public:
+    explicit MultiRootStorageArea(Placement placement);
+
+    virtual ~MultiRootStorageArea();
+
+    static Placement StringToPlacement(const std::string& value);
+
+    Placement GetPlacement() const
+    {
+      return placement_;
+    }
+
+    /**
+     * Adds one root, whose "name" is stored in the custom data of the
+     * attachments, and must thus never change. The "weight" is only
+     * used by "Placement_Weight". The returned storage area can be
+     * used to further configure the root. This method must be called
+     * before the storage area is shared between threads.
+     **/
+    FilesystemStorage& AddRoot(const std::string& name,
+                               const boost::filesystem::path& path,
+                               bool fsyncOnWrite,
+                               unsigned int weight,
+                               unsigned int threads);
+
+    size_t GetRootsCount() const
+    {
+      return roots_.size();
+    }
+
+    // Name of the root where a new attachment would be placed
+    const std::string& GetPlacementRoot(const std::string& uuid) const;
+
+    virtual void Create(std::string& customData,
+                        const std::string& uuid,
+                        const void* content,
+                        size_t size,
+                        FileContentType type,
+                        CompressionType compression,
+                        const DicomInstanceToStore* dicomInstance) ORTHANC_OVERRIDE;
+
+    virtual IMemoryBuffer* ReadRange(const std::string& uuid,
+                                     FileContentType type,
+                                     uint64_t start /* inclusive */,
+                                     uint64_t end /* exclusive */,
+                                     const std::string& customData) ORTHANC_OVERRIDE;
+
+    virtual bool HasEfficientReadRange() const ORTHANC_OVERRIDE
+    {
+      return true;
+    }
+
+    virtual void Remove(const std::string& uuid,
+                        FileContentType type,
+                        const std::string& customData) ORTHANC_OVERRIDE;
+
+    virtual bool LookupLocalPath(std::string& path,
+                                 const std::string& uuid,
+                                 FileContentType type,
+                                 const std::string& customData) const ORTHANC_OVERRIDE;
+
+    virtual bool HasStreamingAccess() const ORTHANC_OVERRIDE
+    {
+      return false;
+    }
+
+    virtual IStorageAreaWriter* OpenWrite(const std::string& uuid,
+                                          FileContentType type,
+                                          CompressionType compression,
+                                          uint64_t size,
+                                          const DicomInstanceToStore* dicomInstance) ORTHANC_OVERRIDE;
+
+    virtual IStorageAreaReader* OpenRead(const std::string& uuid,
+                                         FileContentType type,
+                                         const std::string& customData) ORTHANC_OVERRIDE;
+
+    virtual const std::string& GetBackendName() const ORTHANC_OVERRIDE
+    {
+      return backendName_;
+    }
+  };
+}
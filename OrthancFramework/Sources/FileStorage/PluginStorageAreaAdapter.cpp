@@ -30,7 +30,20 @@
 namespace Orthanc
 {
   PluginStorageAreaAdapter::PluginStorageAreaAdapter(IStorageArea* storage) :
-    storage_(storage)
+    storage_(storage),
+    backendName_("builtin")
+  {
+    if (storage == NULL)
+    {
+      throw OrthancException(Orthanc::ErrorCode_NullPointer);
+    }
+  }
+
+
+  PluginStorageAreaAdapter::PluginStorageAreaAdapter(IStorageArea* storage,
+                                                     const std::string& backendName) :
+    storage_(storage),
+    backendName_(backendName)
   {
     if (storage == NULL)
     {
@@ -50,4 +63,22 @@ namespace Orthanc
     customData.clear();
     storage_->Create(uuid, content, size, type);
   }
+
+
+  IStorageAreaWriter* PluginStorageAreaAdapter::OpenWrite(const std::string& uuid,
+                                                          FileContentType type,
+                                                          CompressionType compression,
+                                                          uint64_t size,
+                                                          const DicomInstanceToStore* dicomInstance)
+  {
+    throw OrthancException(ErrorCode_NotImplemented, "This storage area has no streaming access");
+  }
+
+
+  IStorageAreaReader* PluginStorageAreaAdapter::OpenRead(const std::string& uuid,
+                                                         FileContentType type,
+                                                         const std::string& customData)
+  {
+    throw OrthancException(ErrorCode_NotImplemented, "This storage area has no streaming access");
+  }
 }
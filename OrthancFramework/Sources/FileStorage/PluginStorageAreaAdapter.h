@@ -33,10 +33,16 @@ namespace Orthanc
   {
   private:
     std::unique_ptr<IStorageArea> storage_;
+    std::string                   backendName_;
 
   public:
+    // The backend is named "builtin"
     explicit PluginStorageAreaAdapter(IStorageArea* storage /* takes ownership */);
 
+    // New in Orthanc 1.12.12
+    PluginStorageAreaAdapter(IStorageArea* storage /* takes ownership */,
+                             const std::string& backendName);
+
     virtual void Create(std::string& customData,
                         const std::string& uuid,
                         const void* content,
@@ -65,5 +71,33 @@ namespace Orthanc
     {
       return storage_->HasEfficientReadRange();
     }
+
+    virtual bool LookupLocalPath(std::string& path,
+                                 const std::string& uuid,
+                                 FileContentType type,
+                                 const std::string& customData) const ORTHANC_OVERRIDE
+    {
+      return storage_->LookupLocalPath(path, uuid, type);
+    }
+
+    virtual bool HasStreamingAccess() const ORTHANC_OVERRIDE
+    {
+      return false;
+    }
+
+    virtual IStorageAreaWriter* OpenWrite(const std::string& uuid,
+                                          FileContentType type,
+                                          CompressionType compression,
+                                          uint64_t size,
+                                          const DicomInstanceToStore* dicomInstance) ORTHANC_OVERRIDE;
+
+    virtual IStorageAreaReader* OpenRead(const std::string& uuid,
+                                         FileContentType type,
+                                         const std::string& customData) ORTHANC_OVERRIDE;
+
+    virtual const std::string& GetBackendName() const ORTHANC_OVERRIDE
+    {
+      return backendName_;
+    }
   };
 }
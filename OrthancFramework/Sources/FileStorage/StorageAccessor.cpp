@@ -25,55 +25,253 @@
 #include "../PrecompiledHeaders.h"
 #include "StorageAccessor.h"
 #include "StorageCache.h"
+#include "StorageDiskCache.h"
 
 #include "../Logging.h"
 #include "../StringMemoryBuffer.h"
-#include "../Compression/ZlibCompressor.h"
+#include "../Compression/IBufferCompressor.h"
 #include "../MetricsRegistry.h"
 #include "../OrthancException.h"
+#include "../RequestTimings.h"
 #include "../SerializationToolbox.h"
 #include "../Toolbox.h"
+#include "../Tracing.h"
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
+#  include "../HttpServer/FilesystemHttpSender.h"
 #  include "../HttpServer/HttpStreamTranscoder.h"
 #endif
 
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 
 
 static const std::string METRICS_CREATE_DURATION = "orthanc_storage_create_duration_ms";
 static const std::string METRICS_READ_DURATION = "orthanc_storage_read_duration_ms";
+static const std::string METRICS_READ_RANGE_DURATION = "orthanc_storage_read_range_duration_ms";
 static const std::string METRICS_REMOVE_DURATION = "orthanc_storage_remove_duration_ms";
+static const std::string METRICS_IN_FLIGHT = "orthanc_storage_in_flight";
 static const std::string METRICS_READ_BYTES = "orthanc_storage_read_bytes";
 static const std::string METRICS_WRITTEN_BYTES = "orthanc_storage_written_bytes";
 static const std::string METRICS_CACHE_HIT_COUNT = "orthanc_storage_cache_hit_count";
 static const std::string METRICS_CACHE_MISS_COUNT = "orthanc_storage_cache_miss_count";
+static const std::string METRICS_DISK_CACHE_HIT_COUNT = "orthanc_storage_disk_cache_hit_count";
+static const std::string METRICS_DISK_CACHE_MISS_COUNT = "orthanc_storage_disk_cache_miss_count";
+static const std::string METRICS_PREFETCH_COUNT = "orthanc_storage_prefetch_count";
+
+// Size of the chunks that are exchanged with the storage areas that
+// support streaming. This is above the minimum part size of the
+// multipart uploads of the usual object stores (5MB).
+static const size_t STREAMING_CHUNK_SIZE = 8 * 1024 * 1024;
 
 
 namespace Orthanc
 {
+  static const char* GetContentTypeLabel(FileContentType type)
+  {
+    // The transcoded instances and the user-defined attachments are
+    // grouped, in order to bound the cardinality of the metrics
+    if (type >= FileContentType_TranscodedInstanceFirst &&
+        type <= FileContentType_TranscodedInstanceLast)
+    {
+      return "transcoded-instance";
+    }
+    else if (type >= FileContentType_StartUser &&
+             type <= FileContentType_EndUser)
+    {
+      return "user";
+    }
+
+    switch (type)
+    {
+      case FileContentType_Dicom:
+        return "dicom";
+
+      case FileContentType_DicomAsJson:
+        return "dicom-as-json";
+
+      case FileContentType_DicomUntilPixelData:
+        return "dicom-until-pixel-data";
+
+      case FileContentType_SeriesThumbnail:
+        return "series-thumbnail";
+
+      case FileContentType_DicomFrameOffsets:
+        return "dicom-frame-offsets";
+
+      default:
+        return "unknown";
+    }
+  }
+
+
+  static std::string FormatStorageLabels(const IPluginStorageArea& area,
+                                         FileContentType type)
+  {
+    return (MetricsRegistry::FormatPrometheusLabel("content_type", GetContentTypeLabel(type)) + "," +
+            MetricsRegistry::FormatPrometheusLabel("backend", area.GetBackendName()));
+  }
+
+
   class StorageAccessor::MetricsTimer : public boost::noncopyable
   {
   private:
-    std::unique_ptr<MetricsRegistry::Timer>  timer_;
+    MetricsRegistry*                                  metrics_;
+    std::string                                       inFlight_;
+    std::unique_ptr<MetricsRegistry::HistogramTimer>  timer_;
+    RequestTimings::Timer                             timings_;
+    Tracing::Span                                     span_;
 
   public:
     MetricsTimer(StorageAccessor& that,
-                 const std::string& name)
+                 const std::string& name,
+                 const std::string& spanName,
+                 const std::string& operation,
+                 FileContentType type) :
+      metrics_(that.metrics_),
+      timings_(RequestTimings::Category_Storage),
+      span_(spanName, Tracing::SpanKind_Internal)
+    {
+      if (metrics_ != NULL &&
+          metrics_->IsEnabled())
+      {
+        inFlight_ = (METRICS_IN_FLIGHT + "{" + MetricsRegistry::FormatPrometheusLabel("operation", operation) + "," +
+                     MetricsRegistry::FormatPrometheusLabel("backend", that.area_.GetBackendName()) + "}");
+        metrics_->IncrementIntegerValue(inFlight_, 1);
+
+        timer_.reset(new MetricsRegistry::HistogramTimer(*metrics_, name, FormatStorageLabels(that.area_, type)));
+      }
+    }
+
+    ~MetricsTimer()
     {
-      if (that.metrics_ != NULL)
+      if (!inFlight_.empty())
       {
-        timer_.reset(new MetricsRegistry::Timer(*that.metrics_, name));
+        try
+        {
+          metrics_->IncrementIntegerValue(inFlight_, -1);
+        }
+        catch (OrthancException& e)
+        {
+          // Don't throw exceptions in destructors
+          LOG(ERROR) << "Exception in destructor: " << e.What();
+        }
       }
     }
   };
 
 
+  static void CountCacheHit(MetricsRegistry* metrics,
+                            const std::string& name)
+  {
+    if (metrics != NULL)
+    {
+      metrics->IncrementIntegerValue(name, 1);
+    }
+
+    RequestTimings::AddToCounter(RequestTimings::Counter_StorageCacheHits, 1);
+  }
+
+
+  void StorageAccessor::AddTransferredBytes(const std::string& name,
+                                            FileContentType type,
+                                            uint64_t size)
+  {
+    if (metrics_ != NULL &&
+        metrics_->IsEnabled())
+    {
+      metrics_->IncrementIntegerValue(name + "{" + FormatStorageLabels(area_, type) + "}", static_cast<int64_t>(size));
+    }
+  }
+
+
+#if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
+  namespace
+  {
+    // Sends a file of the storage area over HTTP, by chunks
+    class StreamingHttpSender : public HttpFileSender
+    {
+    private:
+      std::unique_ptr<IStorageAreaReader>  reader_;
+      MetricsRegistry*                     metrics_;
+      std::string                          metricsName_;
+      uint64_t                             size_;
+      uint64_t                             position_;
+      std::string                          chunk_;
+      size_t                               chunkSize_;
+
+    public:
+      StreamingHttpSender(IStorageAreaReader* reader /* takes ownership */,
+                          uint64_t size,
+                          MetricsRegistry* metrics /* can be NULL */,
+                          const std::string& metricsLabels) :
+        reader_(reader),
+        metrics_(metrics),
+        metricsName_(METRICS_READ_BYTES + "{" + metricsLabels + "}"),
+        size_(size),
+        position_(0),
+        chunkSize_(0)
+      {
+        if (reader == NULL)
+        {
+          throw OrthancException(ErrorCode_NullPointer);
+        }
+
+        chunk_.resize(static_cast<size_t>(std::min(static_cast<uint64_t>(STREAMING_CHUNK_SIZE), size)));
+      }
+
+      virtual uint64_t GetContentLength() ORTHANC_OVERRIDE
+      {
+        return size_;
+      }
+
+      virtual bool ReadNextChunk() ORTHANC_OVERRIDE
+      {
+        if (position_ >= size_)
+        {
+          return false;
+        }
+
+        const size_t maxSize = static_cast<size_t>(std::min(static_cast<uint64_t>(chunk_.size()), size_ - position_));
+        chunkSize_ = reader_->ReadChunk(&chunk_[0], maxSize);
+
+        if (chunkSize_ == 0)
+        {
+          throw OrthancException(ErrorCode_StorageAreaPlugin, "The storage area has returned a truncated file");
+        }
+
+        position_ += chunkSize_;
+
+        RequestTimings::AddToCounter(RequestTimings::Counter_StorageBytesRead, chunkSize_);
+
+        if (metrics_ != NULL)
+        {
+          metrics_->IncrementIntegerValue(metricsName_, static_cast<int64_t>(chunkSize_));
+        }
+
+        return true;
+      }
+
+      virtual const char* GetChunkContent() ORTHANC_OVERRIDE
+      {
+        return chunk_.c_str();
+      }
+
+      virtual size_t GetChunkSize() ORTHANC_OVERRIDE
+      {
+        return chunkSize_;
+      }
+    };
+  }
+#endif
+
+
   StorageAccessor::StorageAccessor(IPluginStorageArea& area) :
     area_(area),
     cache_(NULL),
-    metrics_(NULL)
+    metrics_(NULL),
+    cacheAdmission_(true)
   {
   }
   
@@ -82,7 +280,8 @@ namespace Orthanc
                                    StorageCache& cache) :
     area_(area),
     cache_(&cache),
-    metrics_(NULL)
+    metrics_(NULL),
+    cacheAdmission_(true)
   {
   }
 
@@ -91,7 +290,8 @@ namespace Orthanc
                                    MetricsRegistry& metrics) :
     area_(area),
     cache_(NULL),
-    metrics_(&metrics)
+    metrics_(&metrics),
+    cacheAdmission_(true)
   {
   }
 
@@ -100,11 +300,64 @@ namespace Orthanc
                                    MetricsRegistry& metrics) :
     area_(area),
     cache_(&cache),
-    metrics_(&metrics)
+    metrics_(&metrics),
+    cacheAdmission_(true)
   {
   }
 
 
+  void StorageAccessor::CreateInArea(std::string& customData,
+                                     std::string* md5,
+                                     const std::string& uuid,
+                                     const void* data,
+                                     size_t size,
+                                     FileContentType type,
+                                     CompressionType compression,
+                                     const DicomInstanceToStore* instance)
+  {
+    MetricsTimer timer(*this, METRICS_CREATE_DURATION, "storage.write", "create", type);
+
+    if (area_.HasStreamingAccess() &&
+        size > STREAMING_CHUNK_SIZE)
+    {
+      std::unique_ptr<IStorageAreaWriter> writer(area_.OpenWrite(uuid, type, compression, size, instance));
+
+      // Hash each chunk just before writing it, instead of doing an
+      // additional pass over the whole buffer
+      Toolbox::MD5Context md5Context;
+
+      const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+      for (size_t pos = 0; pos < size; pos += STREAMING_CHUNK_SIZE)
+      {
+        const size_t chunkSize = std::min(STREAMING_CHUNK_SIZE, size - pos);
+
+        if (md5 != NULL)
+        {
+          md5Context.Append(p + pos, chunkSize);
+        }
+
+        writer->AppendChunk(p + pos, chunkSize);
+      }
+
+      writer->Commit(customData);
+
+      if (md5 != NULL)
+      {
+        md5Context.Export(*md5);
+      }
+    }
+    else
+    {
+      if (md5 != NULL)
+      {
+        Toolbox::ComputeMD5(*md5, data, size);
+      }
+
+      area_.Create(customData, uuid, data, size, type, compression, instance);
+    }
+  }
+
+
   void StorageAccessor::Write(FileInfo& info,
                               const void* data,
                               size_t size,
@@ -130,10 +383,8 @@ namespace Orthanc
 
     std::string md5 = precomputedMd5;
 
-    if (storeMd5 && md5.empty()) // if it has not been precomputed, compute it now
-    {
-      Toolbox::ComputeMD5(md5, data, size);
-    }
+    // If it has not been precomputed, the MD5 must be computed now
+    const bool computeMd5 = (storeMd5 && md5.empty());
 
     std::string customData;
 
@@ -141,15 +392,10 @@ namespace Orthanc
     {
       case CompressionType_None:
       {
-        {
-          MetricsTimer timer(*this, METRICS_CREATE_DURATION);
-          area_.Create(customData, uuid, data, size, type, compression, instance);
-        }
+        // The MD5 of the uncompressed data is computed while writing
+        CreateInArea(customData, computeMd5 ? &md5 : NULL, uuid, data, size, type, compression, instance);
 
-        if (metrics_ != NULL)
-        {
-          metrics_->IncrementIntegerValue(METRICS_WRITTEN_BYTES, static_cast<int64_t>(size));
-        }
+        AddTransferredBytes(METRICS_WRITTEN_BYTES, type, size);
         
         if (cache_ != NULL)
         {
@@ -163,37 +409,33 @@ namespace Orthanc
       }
 
       case CompressionType_ZlibWithSize:
+      case CompressionType_ZstdWithSize:
+      case CompressionType_Lz4WithSize:
       {
-        ZlibCompressor zlib;
+        if (computeMd5)
+        {
+          Toolbox::ComputeMD5(md5, data, size);
+        }
+
+        std::unique_ptr<IBufferCompressor> compressor(IBufferCompressor::Create(compression));
 
         std::string compressed;
-        zlib.Compress(compressed, data, size);
+        compressor->Compress(compressed, data, size);
 
+        // The MD5 of the compressed data is computed while writing
         std::string compressedMD5;
-      
-        if (storeMd5)
-        {
-          Toolbox::ComputeMD5(compressedMD5, compressed);
-        }
 
+        if (compressed.size() > 0)
         {
-          MetricsTimer timer(*this, METRICS_CREATE_DURATION);
-
-          if (compressed.size() > 0)
-          {
-            area_.Create(customData, uuid, &compressed[0], compressed.size(), type, compression, instance);
-          }
-          else
-          {
-            area_.Create(customData, uuid, NULL, 0, type, compression, instance);
-          }
+          CreateInArea(customData, storeMd5 ? &compressedMD5 : NULL, uuid, &compressed[0], compressed.size(), type, compression, instance);
         }
-
-        if (metrics_ != NULL)
+        else
         {
-          metrics_->IncrementIntegerValue(METRICS_WRITTEN_BYTES, static_cast<int64_t>(compressed.size()));
+          CreateInArea(customData, storeMd5 ? &compressedMD5 : NULL, uuid, NULL, 0, type, compression, instance);
         }
 
+        AddTransferredBytes(METRICS_WRITTEN_BYTES, type, compressed.size());
+
         if (cache_ != NULL)
         {
           StorageCache::Accessor cacheAccessor(*cache_);
@@ -201,7 +443,7 @@ namespace Orthanc
         }
 
         info = FileInfo(uuid, type, size, md5,
-                        CompressionType_ZlibWithSize, compressed.size(), compressedMD5);
+                        compression, compressed.size(), compressedMD5);
         info.SetCustomData(customData);
         return;
       }
@@ -220,7 +462,7 @@ namespace Orthanc
     }
     else
     {
-      StorageCache::Accessor cacheAccessor(*cache_);
+      StorageCache::Accessor cacheAccessor(*cache_, cacheAdmission_);
 
       if (!cacheAccessor.Fetch(content, info.GetUuid(), info.GetContentType()))
       {
@@ -234,13 +476,42 @@ namespace Orthanc
         // always store the uncompressed data in cache
         cacheAccessor.Add(info.GetUuid(), info.GetContentType(), content);
       } 
-      else if (metrics_ != NULL)
+      else
       {
-        metrics_->IncrementIntegerValue(METRICS_CACHE_HIT_COUNT, 1);
+        CountCacheHit(metrics_, METRICS_CACHE_HIT_COUNT);
       }
     }
   }
 
+  bool StorageAccessor::Prefetch(const FileInfo& info)
+  {
+    if (cache_ == NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "Prefetching requires a storage cache");
+    }
+
+    StorageCache::Accessor cacheAccessor(*cache_, true /* always admit prefetched files */);
+
+    std::string content;
+    if (cacheAccessor.Fetch(content, info.GetUuid(), info.GetContentType()))
+    {
+      return false;
+    }
+    else
+    {
+      ReadWholeInternal(content, info);
+      cacheAccessor.Add(info.GetUuid(), info.GetContentType(), content);
+
+      if (metrics_ != NULL)
+      {
+        metrics_->IncrementIntegerValue(METRICS_PREFETCH_COUNT, 1);
+      }
+
+      return true;
+    }
+  }
+
+
   void StorageAccessor::ReadWholeInternal(std::string& content,
                                           const FileInfo& info)
   {
@@ -248,40 +519,20 @@ namespace Orthanc
     {
       case CompressionType_None:
       {
-        std::unique_ptr<IMemoryBuffer> buffer;
-
-        {
-          MetricsTimer timer(*this, METRICS_READ_DURATION);
-          buffer.reset(area_.ReadRange(info.GetUuid(), info.GetContentType(), 0, info.GetCompressedSize(), info.GetCustomData()));
-        }
-
-        if (metrics_ != NULL)
-        {
-          metrics_->IncrementIntegerValue(METRICS_READ_BYTES, static_cast<int64_t>(buffer->GetSize()));
-        }
-
+        std::unique_ptr<IMemoryBuffer> buffer(ReadRangeFromArea(info, 0, info.GetCompressedSize()));
         buffer->MoveToString(content);
 
         break;
       }
 
       case CompressionType_ZlibWithSize:
+      case CompressionType_ZstdWithSize:
+      case CompressionType_Lz4WithSize:
       {
-        ZlibCompressor zlib;
+        std::unique_ptr<IBufferCompressor> compressor(IBufferCompressor::Create(info.GetCompressionType()));
 
-        std::unique_ptr<IMemoryBuffer> compressed;
-        
-        {
-          MetricsTimer timer(*this, METRICS_READ_DURATION);
-          compressed.reset(area_.ReadRange(info.GetUuid(), info.GetContentType(), 0, info.GetCompressedSize(), info.GetCustomData()));
-        }
-        
-        if (metrics_ != NULL)
-        {
-          metrics_->IncrementIntegerValue(METRICS_READ_BYTES, static_cast<int64_t>(compressed->GetSize()));
-        }
-
-        zlib.Uncompress(content, compressed->GetData(), compressed->GetSize());
+        std::unique_ptr<IMemoryBuffer> compressed(ReadRangeFromArea(info, 0, info.GetCompressedSize()));
+        compressor->Uncompress(content, compressed->GetData(), compressed->GetSize());
 
         break;
       }
@@ -305,7 +556,7 @@ namespace Orthanc
     }
     else
     {// use the cache only if the data is uncompressed.
-      StorageCache::Accessor cacheAccessor(*cache_);
+      StorageCache::Accessor cacheAccessor(*cache_, cacheAdmission_);
 
       if (!cacheAccessor.Fetch(content, info.GetUuid(), info.GetContentType()))
       {
@@ -318,29 +569,123 @@ namespace Orthanc
 
         cacheAccessor.Add(info.GetUuid(), info.GetContentType(), content);
       }
-      else if (metrics_ != NULL)
+      else
       {
-        metrics_->IncrementIntegerValue(METRICS_CACHE_HIT_COUNT, 1);
+        CountCacheHit(metrics_, METRICS_CACHE_HIT_COUNT);
       }
     }
   }
 
+  IMemoryBuffer* StorageAccessor::ReadBuffer(const FileInfo& info)
+  {
+    if (info.GetCompressionType() == CompressionType_None)
+    {
+      return ReadRawBuffer(info);
+    }
+    else
+    {
+      std::string content;
+      Read(content, info);
+      return StringMemoryBuffer::CreateFromSwap(content);
+    }
+  }
+
+
   void StorageAccessor::ReadRawInternal(std::string& content,
                                         const FileInfo& info)
   {
+    std::unique_ptr<IMemoryBuffer> buffer(ReadRangeFromArea(info, 0, info.GetCompressedSize()));
+    buffer->MoveToString(content);
+  }
+
+
+  IMemoryBuffer* StorageAccessor::ReadRawBuffer(const FileInfo& info)
+  {
+    if (cache_ == NULL || info.GetCompressionType() != CompressionType_None)
+    {
+      return ReadRangeFromArea(info, 0, info.GetCompressedSize());
+    }
+    else
+    {
+      StorageCache::Accessor cacheAccessor(*cache_, cacheAdmission_);
+
+      std::string content;
+      if (cacheAccessor.Fetch(content, info.GetUuid(), info.GetContentType()))
+      {
+        CountCacheHit(metrics_, METRICS_CACHE_HIT_COUNT);
+
+        return StringMemoryBuffer::CreateFromSwap(content);
+      }
+      else
+      {
+        if (metrics_ != NULL)
+        {
+          metrics_->IncrementIntegerValue(METRICS_CACHE_MISS_COUNT, 1);
+        }
+
+        std::unique_ptr<IMemoryBuffer> buffer(ReadRangeFromArea(info, 0, info.GetCompressedSize()));
+
+        // The buffer is only copied if it fits in the cache
+        cacheAccessor.Add(info.GetUuid(), info.GetContentType(), buffer->GetData(), buffer->GetSize());
+
+        return buffer.release();
+      }
+    }
+  }
+
+
+  IMemoryBuffer* StorageAccessor::ReadRangeFromArea(const FileInfo& info,
+                                                    uint64_t start,
+                                                    uint64_t end)
+  {
+    StorageDiskCache* diskCache = (cache_ == NULL ? NULL : cache_->GetDiskCache());
+    const bool isWholeFile = (start == 0 && end == info.GetCompressedSize());
+
+    if (diskCache != NULL)
+    {
+      std::string content;
+
+      if (isWholeFile ?
+          diskCache->Read(content, info.GetUuid(), info.GetContentType()) :
+          diskCache->ReadRange(content, info.GetUuid(), info.GetContentType(), start, end))
+      {
+        CountCacheHit(metrics_, METRICS_DISK_CACHE_HIT_COUNT);
+
+        return StringMemoryBuffer::CreateFromSwap(content);
+      }
+      else if (metrics_ != NULL)
+      {
+        metrics_->IncrementIntegerValue(METRICS_DISK_CACHE_MISS_COUNT, 1);
+      }
+    }
+
     std::unique_ptr<IMemoryBuffer> buffer;
 
     {
-      MetricsTimer timer(*this, METRICS_READ_DURATION);
-      buffer.reset(area_.ReadRange(info.GetUuid(), info.GetContentType(), 0, info.GetCompressedSize(), info.GetCustomData()));
+      // Partial reads are timed separately, as they are much faster
+      // than the reading of a whole file on most backends
+      MetricsTimer timer(*this, isWholeFile ? METRICS_READ_DURATION : METRICS_READ_RANGE_DURATION,
+                         "storage.read", isWholeFile ? "read" : "read-range", info.GetContentType());
+      buffer.reset(area_.ReadRange(info.GetUuid(), info.GetContentType(), start, end, info.GetCustomData()));
     }
 
-    if (metrics_ != NULL)
+    AddTransferredBytes(METRICS_READ_BYTES, info.GetContentType(), buffer->GetSize());
+    RequestTimings::AddToCounter(RequestTimings::Counter_StorageBytesRead, buffer->GetSize());
+
+    if (diskCache != NULL &&
+        cacheAdmission_)
     {
-      metrics_->IncrementIntegerValue(METRICS_READ_BYTES, static_cast<int64_t>(buffer->GetSize()));
+      if (isWholeFile)
+      {
+        diskCache->Add(info.GetUuid(), info.GetContentType(), buffer->GetData(), buffer->GetSize());
+      }
+      else if (start == 0)
+      {
+        diskCache->AddStartRange(info.GetUuid(), info.GetContentType(), buffer->GetData(), buffer->GetSize());
+      }
     }
 
-    buffer->MoveToString(content);
+    return buffer.release();
   }
 
 
@@ -354,7 +699,7 @@ namespace Orthanc
     }
 
     {
-      MetricsTimer timer(*this, METRICS_REMOVE_DURATION);
+      MetricsTimer timer(*this, METRICS_REMOVE_DURATION, "storage.remove", "remove", type);
       area_.Remove(fileUuid, type, customData);
     }
   }
@@ -376,11 +721,11 @@ namespace Orthanc
     }
     else
     {
-      StorageCache::Accessor accessorStartRange(*cache_);
+      StorageCache::Accessor accessorStartRange(*cache_, cacheAdmission_);
       if (!accessorStartRange.FetchStartRange(target, info.GetUuid(), info.GetContentType(), end))
       {
         // the start range is not in cache, let's check if the whole file is
-        StorageCache::Accessor accessorWhole(*cache_);
+        StorageCache::Accessor accessorWhole(*cache_, cacheAdmission_);
         if (!accessorWhole.Fetch(target, info.GetUuid(), info.GetContentType()))
         {
           if (metrics_ != NULL)
@@ -394,10 +739,7 @@ namespace Orthanc
         }
         else
         {
-          if (metrics_ != NULL)
-          {
-            metrics_->IncrementIntegerValue(METRICS_CACHE_HIT_COUNT, 1);
-          }
+          CountCacheHit(metrics_, METRICS_CACHE_HIT_COUNT);
 
           // we have read the whole file, check size and resize if needed
           if (target.size() < end)
@@ -408,9 +750,9 @@ namespace Orthanc
           target.resize(end);
         }
       }
-      else if (metrics_ != NULL)
+      else
       {
-        metrics_->IncrementIntegerValue(METRICS_CACHE_HIT_COUNT, 1);
+        CountCacheHit(metrics_, METRICS_CACHE_HIT_COUNT);
       }
     }
   }
@@ -419,18 +761,8 @@ namespace Orthanc
                                                 const FileInfo& info,
                                                 uint64_t end /* exclusive */)
   {
-    std::unique_ptr<IMemoryBuffer> buffer;
-
-    {
-      MetricsTimer timer(*this, METRICS_READ_DURATION);
-      buffer.reset(area_.ReadRange(info.GetUuid(), info.GetContentType(), 0, end, info.GetCustomData()));
-      assert(buffer->GetSize() == end);
-    }
-
-    if (metrics_ != NULL)
-    {
-      metrics_->IncrementIntegerValue(METRICS_READ_BYTES, static_cast<int64_t>(buffer->GetSize()));
-    }
+    std::unique_ptr<IMemoryBuffer> buffer(ReadRangeFromArea(info, 0, end));
+    assert(buffer->GetSize() == end);
 
     buffer->MoveToString(target);
   }
@@ -447,7 +779,7 @@ namespace Orthanc
       // An uncompression is needed in this case
       if (cache_ != NULL)
       {
-        StorageCache::Accessor cacheAccessor(*cache_);
+        StorageCache::Accessor cacheAccessor(*cache_, cacheAdmission_);
 
         std::string content;
         if (cacheAccessor.Fetch(content, info.GetUuid(), info.GetContentType()))
@@ -468,7 +800,7 @@ namespace Orthanc
           cache_ != NULL)
       {
         // Check out whether the raw attachment is already present in the cache, by chance
-        StorageCache::Accessor cacheAccessor(*cache_);
+        StorageCache::Accessor cacheAccessor(*cache_, cacheAdmission_);
 
         std::string content;
         if (cacheAccessor.Fetch(content, info.GetUuid(), info.GetContentType()))
@@ -489,19 +821,19 @@ namespace Orthanc
       if (range.HasStart() &&
           range.HasEnd())
       {
-        buffer.reset(area_.ReadRange(info.GetUuid(), info.GetContentType(), range.GetStartInclusive(), range.GetEndInclusive() + 1, info.GetCustomData()));
+        buffer.reset(ReadRangeFromArea(info, range.GetStartInclusive(), range.GetEndInclusive() + 1));
       }
       else if (range.HasStart())
       {
-        buffer.reset(area_.ReadRange(info.GetUuid(), info.GetContentType(), range.GetStartInclusive(), info.GetCompressedSize(), info.GetCustomData()));
+        buffer.reset(ReadRangeFromArea(info, range.GetStartInclusive(), info.GetCompressedSize()));
       }
       else if (range.HasEnd())
       {
-        buffer.reset(area_.ReadRange(info.GetUuid(), info.GetContentType(), 0, range.GetEndInclusive() + 1, info.GetCustomData()));
+        buffer.reset(ReadRangeFromArea(info, 0, range.GetEndInclusive() + 1));
       }
       else
       {
-        buffer.reset(area_.ReadRange(info.GetUuid(), info.GetContentType(), 0, info.GetCompressedSize(), info.GetCustomData()));
+        buffer.reset(ReadRangeFromArea(info, 0, info.GetCompressedSize()));
       }
 
       buffer->MoveToString(target);
@@ -509,14 +841,59 @@ namespace Orthanc
   }
 
 
+#if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
+  bool StorageAccessor::LookupLocalFile(std::string& path,
+                                        const FileInfo& info)
+  {
+    // The uncompressed attachments that are stored as such on the
+    // local filesystem can be sent over HTTP by the kernel, without
+    // being read into memory (new in Orthanc 1.12.12)
+    if (info.GetCompressionType() == CompressionType_None &&
+        area_.LookupLocalPath(path, info.GetUuid(), info.GetContentType(), info.GetCustomData()))
+    {
+      AddTransferredBytes(METRICS_READ_BYTES, info.GetContentType(), info.GetCompressedSize());
+      RequestTimings::AddToCounter(RequestTimings::Counter_StorageBytesRead, info.GetCompressedSize());
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+#endif
+
+
+#if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
+  bool StorageAccessor::IsStreamingRead(const FileInfo& info)
+  {
+    // The large uncompressed files are streamed from the storage area
+    // if they cannot be served by the caches (new in Orthanc 1.12.12)
+    return (info.GetCompressionType() == CompressionType_None &&
+            info.GetCompressedSize() > STREAMING_CHUNK_SIZE &&
+            area_.HasStreamingAccess() &&
+            (cache_ == NULL ||
+             (cache_->GetDiskCache() == NULL &&
+              info.GetCompressedSize() > cache_->GetMaximumSize())));
+  }
+#endif
+
+
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
   void StorageAccessor::SetupSender(BufferHttpSender& sender,
                                     const FileInfo& info,
                                     const std::string& mime)
   {
-    std::string tmp;
-    Read(tmp, info);
-    sender.SwapBuffer(tmp);
+    if (info.GetCompressionType() == CompressionType_None)
+    {
+      // Avoid copying large files (new in Orthanc 1.12.12)
+      sender.AcquireBuffer(ReadRawBuffer(info));
+    }
+    else
+    {
+      std::string tmp;
+      Read(tmp, info);
+      sender.SwapBuffer(tmp);
+    }
 
     sender.SetContentType(mime);
 
@@ -532,9 +909,21 @@ namespace Orthanc
         extension = ".json";
         break;
 
+      case FileContentType_SeriesThumbnail:
+        extension = ".jpg";
+        break;
+
       default:
-        // Non-standard content type
-        extension = "";
+        if (info.GetContentType() >= FileContentType_TranscodedInstanceFirst &&
+            info.GetContentType() <= FileContentType_TranscodedInstanceLast)
+        {
+          extension = ".dcm";
+        }
+        else
+        {
+          // Non-standard content type
+          extension = "";
+        }
     }
 
     sender.SetContentFilename(info.GetUuid() + std::string(extension));
@@ -559,6 +948,26 @@ namespace Orthanc
                                    const std::string& mime,
                                    const std::string& contentFilename)
   {
+    std::string path;
+    if (LookupLocalFile(path, info))
+    {
+      FilesystemHttpSender sender(path);
+      sender.SetContentType(mime);
+      sender.SetContentFilename(contentFilename);
+      output.Answer(sender);
+      return;
+    }
+
+    if (IsStreamingRead(info))
+    {
+      StreamingHttpSender sender(area_.OpenRead(info.GetUuid(), info.GetContentType(), info.GetCustomData()),
+                                 info.GetCompressedSize(), metrics_, FormatStorageLabels(area_, info.GetContentType()));
+      sender.SetContentType(mime);
+      sender.SetContentFilename(contentFilename);
+      output.Answer(sender);
+      return;
+    }
+
     BufferHttpSender sender;
     SetupSender(sender, info, mime);
     sender.SetContentFilename(contentFilename);
@@ -586,6 +995,26 @@ namespace Orthanc
                                    const std::string& mime,
                                    const std::string& contentFilename)
   {
+    std::string path;
+    if (LookupLocalFile(path, info))
+    {
+      FilesystemHttpSender sender(path);
+      sender.SetContentType(mime);
+      sender.SetContentFilename(contentFilename);
+      output.AnswerStream(sender);
+      return;
+    }
+
+    if (IsStreamingRead(info))
+    {
+      StreamingHttpSender sender(area_.OpenRead(info.GetUuid(), info.GetContentType(), info.GetCustomData()),
+                                 info.GetCompressedSize(), metrics_, FormatStorageLabels(area_, info.GetContentType()));
+      sender.SetContentType(mime);
+      sender.SetContentFilename(contentFilename);
+      output.AnswerStream(sender);
+      return;
+    }
+
     BufferHttpSender sender;
     SetupSender(sender, info, mime);
     sender.SetContentFilename(contentFilename);
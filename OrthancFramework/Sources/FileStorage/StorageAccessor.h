@@ -70,13 +70,36 @@ namespace Orthanc
     IPluginStorageArea&     area_;
     StorageCache*     cache_;
     MetricsRegistry*  metrics_;
+    bool              cacheAdmission_;
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
+    bool LookupLocalFile(std::string& path,
+                         const FileInfo& info);
+
     void SetupSender(BufferHttpSender& sender,
                      const FileInfo& info,
                      const std::string& mime);
+
+    bool IsStreamingRead(const FileInfo& info);
 #endif
 
+    // The byte counters are labelled by content type and by backend
+    void AddTransferredBytes(const std::string& name,
+                             FileContentType type,
+                             uint64_t size);
+
+    // If "md5" is not NULL, it receives the MD5 of "data", which is
+    // computed while the chunks are written if the storage area
+    // supports streaming (new in Orthanc 1.12.12)
+    void CreateInArea(std::string& customData,
+                      std::string* md5,
+                      const std::string& uuid,
+                      const void* data,
+                      size_t size,
+                      FileContentType type,
+                      CompressionType compression,
+                      const DicomInstanceToStore* instance);
+
   public:
     explicit StorageAccessor(IPluginStorageArea& area);
 
@@ -90,6 +113,20 @@ namespace Orthanc
                     StorageCache& cache,
                     MetricsRegistry& metrics);
 
+    // If set to "false", reads are served from the storage cache if
+    // possible, but the files that are missing from the cache are not
+    // inserted into it. This prevents bulk readers (e.g. archives)
+    // from flushing the cache. New in Orthanc 1.12.12.
+    void SetCacheAdmission(bool admission)
+    {
+      cacheAdmission_ = admission;
+    }
+
+    bool HasCacheAdmission() const
+    {
+      return cacheAdmission_;
+    }
+
     void Write(FileInfo& info /* out */,
                const void* data,
                size_t size,
@@ -113,6 +150,17 @@ namespace Orthanc
     void ReadRaw(std::string& content,
                  const FileInfo& info);
 
+    // Same as "Read()", but returns the uncompressed content as a
+    // memory buffer. If the attachment is not compressed, the buffer
+    // provided by the storage area is returned without any copy. New
+    // in Orthanc 1.12.12.
+    IMemoryBuffer* ReadBuffer(const FileInfo& info);
+
+    // Loads the uncompressed attachment into the storage cache,
+    // regardless of the cache admission. Returns "false" if the
+    // attachment was already cached. New in Orthanc 1.12.12.
+    bool Prefetch(const FileInfo& info);
+
     void ReadStartRange(std::string& target,
                         const FileInfo& info,
                         uint64_t end /* exclusive */);
@@ -161,5 +209,14 @@ namespace Orthanc
     void ReadRawInternal(std::string& content,
                          const FileInfo& info);
 
+    // Read from the storage area, going through the disk cache if any
+    IMemoryBuffer* ReadRangeFromArea(const FileInfo& info,
+                                     uint64_t start /* inclusive */,
+                                     uint64_t end /* exclusive */);
+
+    // Same as "ReadRaw()", but returns the buffer of the storage area
+    // (which might be a memory-mapped file) without copying it
+    IMemoryBuffer* ReadRawBuffer(const FileInfo& info);
+
   };
 }
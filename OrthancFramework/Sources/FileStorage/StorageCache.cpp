@@ -59,6 +59,37 @@ namespace Orthanc
   {
     cache_.SetMaximumSize(size);
   }
+
+
+  size_t StorageCache::GetMaximumSize()
+  {
+    return cache_.GetMaximumSize();
+  }
+
+
+  void StorageCache::SetNumberOfShards(size_t count)
+  {
+    cache_.SetNumberOfShards(count);
+  }
+
+
+  void StorageCache::SetPolicy(CachePolicy policy)
+  {
+    cache_.SetPolicy(policy);
+  }
+
+
+  void StorageCache::SetNumaAware(bool numaAware)
+  {
+    cache_.SetNumaAware(numaAware);
+    headersCache_.SetNumaAware(numaAware);
+  }
+
+
+  void StorageCache::SetDiskCache(StorageDiskCache* diskCache)
+  {
+    diskCache_.reset(diskCache);
+  }
   
 
   void StorageCache::Invalidate(const std::string& uuid,
@@ -83,6 +114,16 @@ namespace Orthanc
       const std::string keyTransferSyntax = GetCacheKeyTranscodedInstance(uuid, *it);
       cache_.Invalidate(keyTransferSyntax);
     }
+
+    if (contentType == FileContentType_Dicom)
+    {
+      headersCache_.Invalidate(uuid);
+    }
+
+    if (diskCache_.get() != NULL)
+    {
+      diskCache_->Invalidate(uuid, contentType);
+    }
   }
 
 
@@ -92,6 +133,13 @@ namespace Orthanc
   {
   }
 
+  StorageCache::Accessor::Accessor(StorageCache& cache,
+                                   bool admission)
+  : MemoryStringCache::Accessor(cache.cache_, admission),
+    storageCache_(cache)
+  {
+  }
+
   void StorageCache::Accessor::Add(const std::string& uuid, 
                                    FileContentType contentType,
                                    const std::string& value)
@@ -198,4 +246,68 @@ namespace Orthanc
     return cache_.GetNumberOfItems();
   }
 
+
+  void StorageCache::SetMaximumHeadersSize(size_t size)
+  {
+    headersCache_.SetMaximumSize(size);
+  }
+
+
+  size_t StorageCache::GetHeadersCurrentSize() const
+  {
+    return headersCache_.GetCurrentSize();
+  }
+
+
+  size_t StorageCache::GetHeadersNumberOfItems() const
+  {
+    return headersCache_.GetNumberOfItems();
+  }
+
+
+  size_t StorageCache::GetHeadersMaximumSize()
+  {
+    return headersCache_.GetMaximumSize();
+  }
+
+
+  void StorageCache::GetStatistics(CacheStatistics& target) const
+  {
+    cache_.GetStatistics(target);
+  }
+
+
+  void StorageCache::GetHeadersStatistics(CacheStatistics& target) const
+  {
+    headersCache_.GetStatistics(target);
+  }
+
+
+  StorageCache::HeaderAccessor::HeaderAccessor(StorageCache& cache) :
+    MemoryStringCache::Accessor(cache.headersCache_)
+  {
+  }
+
+
+  bool StorageCache::HeaderAccessor::FetchDicomHeader(std::string& header,
+                                                      const std::string& uuid)
+  {
+    if (MemoryStringCache::Accessor::Fetch(header, uuid))
+    {
+      LOG(INFO) << "Read DICOM header of attachment \"" << uuid << "\" from cache";
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  void StorageCache::HeaderAccessor::AddDicomHeader(const std::string& uuid,
+                                                    const std::string& header)
+  {
+    MemoryStringCache::Accessor::Add(uuid, header);
+  }
+
 }
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "../Cache/MemoryStringCache.h"
+#include "StorageDiskCache.h"
 
 #include "../Compatibility.h"  // For ORTHANC_OVERRIDE
 
@@ -51,6 +52,11 @@ namespace Orthanc
       public:
         explicit Accessor(StorageCache& cache);
 
+        // An accessor without admission reads from the cache, but
+        // never inserts new items (useful for bulk readers)
+        Accessor(StorageCache& cache,
+                 bool admission);
+
         void Add(const std::string& uuid, 
                  FileContentType contentType,
                  const std::string& value);
@@ -83,14 +89,58 @@ namespace Orthanc
                                    size_t size);
       };
 
+      // Accessor to the dedicated cache of the DICOM headers (i.e. the
+      // bytes of the DICOM files that precede the pixel data), that is
+      // kept apart from the cache of the full files so that the
+      // headers are not evicted by large files. The key is the UUID of
+      // the "FileContentType_Dicom" attachment. New in Orthanc 1.12.12.
+      class HeaderAccessor : public MemoryStringCache::Accessor
+      {
+      public:
+        explicit HeaderAccessor(StorageCache& cache);
+
+        bool FetchDicomHeader(std::string& header,
+                              const std::string& uuid);
+
+        void AddDicomHeader(const std::string& uuid,
+                            const std::string& header);
+      };
+
     private:
       MemoryStringCache             cache_;
+      MemoryStringCache             headersCache_;
+      std::unique_ptr<StorageDiskCache>  diskCache_;
       std::set<DicomTransferSyntax> subKeysTransferSyntax_;
       boost::mutex                  subKeysMutex_;
 
     public:
       void SetMaximumSize(size_t size);
 
+      size_t GetMaximumSize();
+
+      // Must be called before the cache is shared between threads
+      void SetNumberOfShards(size_t count);
+
+      // Must be called before the cache is shared between threads
+      void SetPolicy(CachePolicy policy);
+
+      // Creates one group of shards per NUMA node, both for the files
+      // and for the DICOM headers. Must be called before the cache is
+      // shared between threads. New in Orthanc 1.12.12.
+      void SetNumaAware(bool numaAware);
+
+      // Optional second tier on the local disk, that is used by
+      // "StorageAccessor" between the RAM cache and the storage
+      // area. Takes ownership; must be called before the cache is
+      // shared between threads. New in Orthanc 1.12.12.
+      void SetDiskCache(StorageDiskCache* diskCache);
+
+      // Can return NULL
+      StorageDiskCache* GetDiskCache() const
+      {
+        return diskCache_.get();
+      }
+
       void Invalidate(const std::string& uuid,
                       FileContentType contentType);
 
@@ -98,6 +148,18 @@ namespace Orthanc
       
       size_t GetNumberOfItems() const;
 
+      void SetMaximumHeadersSize(size_t size);
+
+      size_t GetHeadersCurrentSize() const;
+
+      size_t GetHeadersNumberOfItems() const;
+
+      size_t GetHeadersMaximumSize();
+
+      void GetStatistics(CacheStatistics& target) const;
+
+      void GetHeadersStatistics(CacheStatistics& target) const;
+
     private:
       void Add(const std::string& uuid, 
                FileContentType contentType,
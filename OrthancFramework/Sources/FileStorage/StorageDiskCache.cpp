@@ -0,0 +1,418 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "StorageDiskCache.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+#include "../SerializationToolbox.h"
+#include "../SystemToolbox.h"
+#include "../Toolbox.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
+
+
+static const char* const START_RANGE_SUFFIX = ".start";
+static const char* const TEMPORARY_SUFFIX = ".tmp";
+
+
+namespace Orthanc
+{
+  static std::string GetFilename(const std::string& uuid,
+                                 FileContentType type,
+                                 bool isStartRange)
+  {
+    if (!Toolbox::IsUuid(uuid))
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    std::string s = uuid + "." + boost::lexical_cast<std::string>(static_cast<int>(type));
+
+    if (isStartRange)
+    {
+      s += START_RANGE_SUFFIX;
+    }
+
+    return s;
+  }
+
+
+  static bool IsCacheFilename(const std::string& filename)
+  {
+    // Format: "<uuid>.<type>" or "<uuid>.<type>.start"
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, filename, '.');
+
+    int type;
+    return ((tokens.size() == 2 ||
+             (tokens.size() == 3 && "." + tokens[2] == START_RANGE_SUFFIX)) &&
+            Toolbox::IsUuid(tokens[0]) &&
+            SerializationToolbox::ParseInteger32(type, tokens[1]));
+  }
+
+
+  boost::filesystem::path StorageDiskCache::GetPath(const std::string& filename) const
+  {
+    assert(filename.size() > 2);
+    return root_ / filename.substr(0, 2) / filename;
+  }
+
+
+  void StorageDiskCache::Recycle(uint64_t targetSize)
+  {
+    // WARNING: "mutex_" must be locked
+    while (currentSize_ > targetSize)
+    {
+      assert(!index_.IsEmpty());
+
+      uint64_t size = 0;
+      const std::string filename = index_.RemoveOldest(size);
+
+      try
+      {
+        boost::filesystem::remove(GetPath(filename));
+      }
+      catch (boost::filesystem::filesystem_error& e)
+      {
+        LOG(WARNING) << "Cannot remove file from the storage disk cache: " << e.what();
+      }
+
+      assert(currentSize_ >= size);
+      currentSize_ -= size;
+      statistics_.AddEviction();
+    }
+  }
+
+
+  void StorageDiskCache::IndexExistingFiles()
+  {
+    namespace fs = boost::filesystem;
+
+    for (fs::recursive_directory_iterator current(root_), end; current != end ; ++current)
+    {
+      try
+      {
+        const fs::path p = current->path();
+
+        if (SystemToolbox::IsRegularFile(p))
+        {
+          const std::string filename = p.filename().string();
+
+          if (IsCacheFilename(filename) &&
+              p.parent_path().filename().string() == filename.substr(0, 2) &&
+              p.parent_path().parent_path() == root_)
+          {
+            const uint64_t size = static_cast<uint64_t>(fs::file_size(p));
+            index_.Add(filename, size);
+            currentSize_ += size;
+          }
+          else if (boost::algorithm::ends_with(filename, TEMPORARY_SUFFIX))
+          {
+            // Leftover from a crash while writing
+            fs::remove(p);
+          }
+        }
+      }
+      catch (fs::filesystem_error&)  // NOLINT(bugprone-empty-catch)
+      {
+      }
+    }
+  }
+
+
+  StorageDiskCache::StorageDiskCache(const boost::filesystem::path& root,
+                                     uint64_t maxSize) :
+    root_(root),
+    maxSize_(maxSize),
+    currentSize_(0)
+  {
+    SystemToolbox::MakeDirectory(root_);
+    IndexExistingFiles();
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      Recycle(maxSize_);
+    }
+
+    LOG(WARNING) << "Storage disk cache in directory \"" << SystemToolbox::PathToUtf8(root_)
+                 << "\" contains " << index_.GetSize() << " files ("
+                 << (currentSize_ / (1024 * 1024)) << " MB)";
+  }
+
+
+  bool StorageDiskCache::ReadInternal(std::string& content,
+                                      const std::string& filename,
+                                      uint64_t start,
+                                      uint64_t end,
+                                      bool wholeFile)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      uint64_t size;
+      if (!index_.Contains(filename, size) ||
+          (!wholeFile && end > size))
+      {
+        return false;
+      }
+
+      index_.MakeMostRecent(filename);
+
+      if (wholeFile)
+      {
+        start = 0;
+        end = size;
+      }
+    }
+
+    try
+    {
+      SystemToolbox::ReadFileRange(content, GetPath(filename), start, end, true /* throw if overflow */);
+      return true;
+    }
+    catch (OrthancException&)
+    {
+      // The file was removed in the meantime (or is corrupted)
+      InvalidateInternal(filename);
+      return false;
+    }
+  }
+
+
+  void StorageDiskCache::AddInternal(const std::string& filename,
+                                     const void* data,
+                                     size_t size)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (size > maxSize_ ||
+          index_.Contains(filename))
+      {
+        return;
+      }
+    }
+
+    const boost::filesystem::path path = GetPath(filename);
+    const boost::filesystem::path tmp = path.string() + "." + Toolbox::GenerateUuid() + TEMPORARY_SUFFIX;
+
+    try
+    {
+      SystemToolbox::MakeDirectory(path.parent_path());
+
+      // Write to a temporary file, then atomically rename it, so that
+      // readers never see partially written files
+      SystemToolbox::WriteFile(data, size, tmp, false /* no fsync */);
+      boost::filesystem::rename(tmp, path);
+    }
+    catch (OrthancException& e)
+    {
+      LOG(WARNING) << "Cannot write to the storage disk cache: " << e.What();
+      SystemToolbox::RemoveFile(tmp);
+      return;
+    }
+    catch (boost::filesystem::filesystem_error& e)
+    {
+      LOG(WARNING) << "Cannot write to the storage disk cache: " << e.what();
+      SystemToolbox::RemoveFile(tmp);
+      return;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (size > maxSize_)
+    {
+      // The cache was shrunk while the file was being written
+      SystemToolbox::RemoveFile(path);
+    }
+    else if (!index_.Contains(filename))
+    {
+      Recycle(maxSize_ - size);
+      index_.Add(filename, size);
+      currentSize_ += size;
+    }
+  }
+
+
+  void StorageDiskCache::InvalidateInternal(const std::string& filename)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    uint64_t size;
+    if (index_.Contains(filename, size))
+    {
+      index_.Invalidate(filename);
+
+      assert(currentSize_ >= size);
+      currentSize_ -= size;
+
+      try
+      {
+        boost::filesystem::remove(GetPath(filename));
+      }
+      catch (boost::filesystem::filesystem_error& e)
+      {
+        LOG(WARNING) << "Cannot remove file from the storage disk cache: " << e.what();
+      }
+    }
+  }
+
+
+  bool StorageDiskCache::Read(std::string& content,
+                              const std::string& uuid,
+                              FileContentType type)
+  {
+    const bool found = ReadInternal(content, GetFilename(uuid, type, false), 0, 0, true /* whole file */);
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (found)
+      {
+        statistics_.AddHit();
+      }
+      else
+      {
+        statistics_.AddMiss();
+      }
+    }
+
+    return found;
+  }
+
+
+  bool StorageDiskCache::ReadRange(std::string& content,
+                                   const std::string& uuid,
+                                   FileContentType type,
+                                   uint64_t start,
+                                   uint64_t end)
+  {
+    if (start > end)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    const bool found = (ReadInternal(content, GetFilename(uuid, type, false), start, end, false) ||
+                        (start == 0 &&
+                         ReadInternal(content, GetFilename(uuid, type, true), start, end, false)));
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (found)
+      {
+        statistics_.AddHit();
+      }
+      else
+      {
+        statistics_.AddMiss();
+      }
+    }
+
+    return found;
+  }
+
+
+  void StorageDiskCache::Add(const std::string& uuid,
+                             FileContentType type,
+                             const void* data,
+                             size_t size)
+  {
+    AddInternal(GetFilename(uuid, type, false), data, size);
+
+    // The start range is not needed anymore
+    InvalidateInternal(GetFilename(uuid, type, true));
+  }
+
+
+  void StorageDiskCache::AddStartRange(const std::string& uuid,
+                                       FileContentType type,
+                                       const void* data,
+                                       size_t size)
+  {
+    AddInternal(GetFilename(uuid, type, true), data, size);
+  }
+
+
+  void StorageDiskCache::Invalidate(const std::string& uuid,
+                                    FileContentType type)
+  {
+    InvalidateInternal(GetFilename(uuid, type, false));
+    InvalidateInternal(GetFilename(uuid, type, true));
+  }
+
+
+  uint64_t StorageDiskCache::GetCurrentSize()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return currentSize_;
+  }
+
+
+  size_t StorageDiskCache::GetNumberOfItems()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return index_.GetSize();
+  }
+
+
+  uint64_t StorageDiskCache::GetMaximumSize()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return maxSize_;
+  }
+
+
+  void StorageDiskCache::SetMaximumSize(uint64_t size)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    Recycle(size);
+    maxSize_ = size;
+  }
+
+
+  uint64_t StorageDiskCache::GetHitsCount()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return statistics_.GetHits();
+  }
+
+
+  uint64_t StorageDiskCache::GetMissesCount()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return statistics_.GetMisses();
+  }
+
+
+  void StorageDiskCache::GetStatistics(CacheStatistics& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    target = statistics_;
+  }
+}
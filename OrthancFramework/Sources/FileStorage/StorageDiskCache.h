@@ -0,0 +1,143 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 1
+#  error The class StorageDiskCache cannot be used in sandboxed environments
+#endif
+
+#include "../Cache/CacheStatistics.h"
+#include "../Cache/LeastRecentlyUsedIndex.h"
+#include "../Enumerations.h"
+
+#include <stdint.h>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+
+
+namespace Orthanc
+{
+  /**
+   * Second-tier cache that stores the raw content of attachments (as
+   * returned by the storage area, i.e. possibly compressed) as files
+   * in a local directory, typically on a fast SSD in front of a slow
+   * storage plugin (such as an object store). The full files and the
+   * start ranges (as used by "ReadDicomUntilPixelData()") are cached
+   * separately. Files are evicted in LRU order once the maximum size
+   * is reached.
+   *
+   * As the content of one attachment never changes, the files that
+   * are already present in the directory are indexed at startup.
+   *
+   * New in Orthanc 1.12.12.
+   *
+   * Note: this class is thread safe
+   **/
+  class ORTHANC_PUBLIC StorageDiskCache : public boost::noncopyable
+  {
+  private:
+    boost::mutex                                 mutex_;
+    boost::filesystem::path                      root_;
+    uint64_t                                     maxSize_;
+    uint64_t                                     currentSize_;
+    LeastRecentlyUsedIndex<std::string, uint64_t>  index_;   // Filename => size
+    CacheStatistics                              statistics_;
+
+    boost::filesystem::path GetPath(const std::string& filename) const;
+
+    void Recycle(uint64_t targetSize);
+
+    void IndexExistingFiles();
+
+    bool ReadInternal(std::string& content,
+                      const std::string& filename,
+                      uint64_t start,
+                      uint64_t end,
+                      bool wholeFile);
+
+    void AddInternal(const std::string& filename,
+                     const void* data,
+                     size_t size);
+
+    void InvalidateInternal(const std::string& filename);
+
+  public:
+    StorageDiskCache(const boost::filesystem::path& root,
+                     uint64_t maxSize);
+
+    uint64_t GetMaximumSize();
+
+    // The files in excess are immediately removed if the cache shrinks
+    void SetMaximumSize(uint64_t size);
+
+    const boost::filesystem::path& GetRoot() const
+    {
+      return root_;
+    }
+
+    // Read the whole raw content of one attachment from the cache
+    bool Read(std::string& content,
+              const std::string& uuid,
+              FileContentType type);
+
+    // Read a range from the whole raw content of one attachment, or
+    // from its cached start range if "start == 0"
+    bool ReadRange(std::string& content,
+                   const std::string& uuid,
+                   FileContentType type,
+                   uint64_t start /* inclusive */,
+                   uint64_t end /* exclusive */);
+
+    void Add(const std::string& uuid,
+             FileContentType type,
+             const void* data,
+             size_t size);
+
+    void AddStartRange(const std::string& uuid,
+                       FileContentType type,
+                       const void* data,
+                       size_t size);
+
+    void Invalidate(const std::string& uuid,
+                    FileContentType type);
+
+    uint64_t GetCurrentSize();
+
+    size_t GetNumberOfItems();
+
+    uint64_t GetHitsCount();
+
+    uint64_t GetMissesCount();
+
+    void GetStatistics(CacheStatistics& target);
+  };
+}
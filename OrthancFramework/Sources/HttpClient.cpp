@@ -30,15 +30,20 @@
 #include "Logging.h"
 #include "ChunkedBuffer.h"
 #include "SystemToolbox.h"
+#include "Tracing.h"
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/thread/mutex.hpp>
+#include <cassert>
 #include <curl/curl.h>
+#include <list>
+#include <map>
 #include <string.h>
 
 // Default timeout = 60 seconds (in Orthanc <= 1.5.6, it was 10 seconds)
 static const unsigned int DEFAULT_HTTP_TIMEOUT = 60;
+static const unsigned int DEFAULT_CONNECTIONS_POOL_SIZE = 8;
 
 
 #if ORTHANC_ENABLE_PKCS11 == 1
@@ -200,6 +205,28 @@ namespace Orthanc
       CheckCode(curl_easy_setopt(curl, CURLOPT_HTTPHEADER, content_));
     }
 
+    void CopyFrom(const CurlHeaders& other)
+    {
+      Clear();
+
+      for (const struct curl_slist* item = other.content_; item != NULL; item = item->next)
+      {
+        struct curl_slist *tmp = curl_slist_append(content_, item->data);
+
+        if (tmp == NULL)
+        {
+          throw OrthancException(ErrorCode_NotEnoughMemory);
+        }
+        else
+        {
+          content_ = tmp;
+        }
+      }
+
+      isChunkedTransfer_ = other.isChunkedTransfer_;
+      hasExpect_ = other.hasExpect_;
+    }
+
     bool HasExpect() const
     {
       return hasExpect_;
@@ -465,10 +492,20 @@ namespace Orthanc
     long            timeout_;
     bool            verbose_;
 
+    // Pool of the idle curl handles, indexed by "scheme://host:port"
+    // (new in Orthanc 1.12.12). The handles keep their open
+    // connections, their DNS cache and their TLS sessions.
+    typedef std::map<std::string, std::list<CURL*> >  CurlHandles;
+
+    boost::mutex    poolMutex_;
+    CurlHandles     pool_;
+    unsigned int    poolSize_;
+
     GlobalParameters() : 
       httpsVerifyPeers_(true),
       timeout_(0),
-      verbose_(false)
+      verbose_(false),
+      poolSize_(DEFAULT_CONNECTIONS_POOL_SIZE)
     {
     }
 
@@ -553,16 +590,178 @@ namespace Orthanc
     {
       verbose_ = verbose;
     }
+
+    void SetConnectionsPoolSize(unsigned int size)
+    {
+      boost::mutex::scoped_lock lock(poolMutex_);
+      poolSize_ = size;
+
+      // Shrink the pool if need be
+      for (CurlHandles::iterator it = pool_.begin(); it != pool_.end(); ++it)
+      {
+        while (it->second.size() > size)
+        {
+          curl_easy_cleanup(it->second.back());
+          it->second.pop_back();
+        }
+      }
+    }
+
+    // Returns NULL if no idle handle is available for this host
+    CURL* AcquireCurlHandle(const std::string& key)
+    {
+      boost::mutex::scoped_lock lock(poolMutex_);
+
+      CurlHandles::iterator found = pool_.find(key);
+      if (found == pool_.end() ||
+          found->second.empty())
+      {
+        return NULL;
+      }
+      else
+      {
+        // LIFO, to reuse the most recent connection, which is the
+        // most likely to be still open on the remote side
+        CURL* handle = found->second.front();
+        found->second.pop_front();
+        return handle;
+      }
+    }
+
+    void ReleaseCurlHandle(const std::string& key,
+                           CURL* handle)
+    {
+      assert(handle != NULL);
+
+      // Forget all the options (credentials, client certificates...)
+      // of the previous owner, but keep the live connections
+      curl_easy_reset(handle);
+
+      {
+        boost::mutex::scoped_lock lock(poolMutex_);
+
+        if (!key.empty())
+        {
+          std::list<CURL*>& handles = pool_[key];
+          if (handles.size() < poolSize_)
+          {
+            handles.push_front(handle);
+            return;
+          }
+        }
+      }
+
+      curl_easy_cleanup(handle);
+    }
+
+    void ClearConnectionsPool()
+    {
+      boost::mutex::scoped_lock lock(poolMutex_);
+
+      for (CurlHandles::iterator it = pool_.begin(); it != pool_.end(); ++it)
+      {
+        for (std::list<CURL*>::iterator handle = it->second.begin(); handle != it->second.end(); ++handle)
+        {
+          curl_easy_cleanup(*handle);
+        }
+      }
+
+      pool_.clear();
+    }
   };
 
 
+  // Returns "scheme://host:port", the key of the pool of curl handles
+  static std::string GetConnectionKey(const std::string& url)
+  {
+    size_t start = url.find("://");
+    if (start == std::string::npos)
+    {
+      return "";
+    }
+
+    size_t end = url.find_first_of("/?#", start + 3);
+    if (end == std::string::npos)
+    {
+      return url;
+    }
+    else
+    {
+      return url.substr(0, end);
+    }
+  }
+
+
   struct HttpClient::PImpl
   {
     CURL* curl_;
+    std::string curlKey_;  // Key of "curl_" in the pool of handles
     CurlHeaders defaultPostHeaders_;
     CurlHeaders defaultChunkedHeaders_;
     CurlHeaders userHeaders_;
+    CurlHeaders tracedHeaders_;  // Headers plus the "traceparent"
     CurlRequestBody requestBody_;
+
+    PImpl() :
+      curl_(NULL)
+    {
+    }
+
+    ~PImpl()
+    {
+      if (curl_ != NULL)
+      {
+        GlobalParameters::GetInstance().ReleaseCurlHandle(curlKey_, curl_);
+      }
+    }
+
+    // Makes "curl_" point to a handle that is suitable for "url",
+    // reusing the idle connections to the same host if possible
+    void AssignCurlHandle(const std::string& url)
+    {
+      const std::string key = GetConnectionKey(url);
+
+      if (curl_ != NULL)
+      {
+        if (key == curlKey_)
+        {
+          return;
+        }
+        else
+        {
+          GlobalParameters::GetInstance().ReleaseCurlHandle(curlKey_, curl_);
+          curl_ = NULL;
+        }
+      }
+
+      curl_ = GlobalParameters::GetInstance().AcquireCurlHandle(key);
+
+      if (curl_ == NULL)
+      {
+        curl_ = curl_easy_init();
+
+        if (curl_ == NULL)
+        {
+          throw OrthancException(ErrorCode_InternalError, "Cannot initialize libcurl");
+        }
+      }
+
+      curlKey_ = key;
+
+      CheckCode(curl_easy_setopt(curl_, CURLOPT_HEADERFUNCTION, &CurlAnswer::HeaderCallback));
+      CheckCode(curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, &CurlAnswer::BodyCallback));
+      CheckCode(curl_easy_setopt(curl_, CURLOPT_HEADER, 0));
+      CheckCode(curl_easy_setopt(curl_, CURLOPT_FOLLOWLOCATION, 1));
+
+      // This fixes the "longjmp causes uninitialized stack frame" crash
+      // that happens on modern Linux versions.
+      // http://stackoverflow.com/questions/9191668/error-longjmp-causes-uninitialized-stack-frame
+      CheckCode(curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1));
+
+      // Prevent the idle connections of the pool from being silently
+      // dropped by firewalls and NAT devices
+      CheckCode(curl_easy_setopt(curl_, CURLOPT_TCP_KEEPALIVE, 1L));
+    }
   };
 
 
@@ -622,17 +821,8 @@ namespace Orthanc
     pimpl_->defaultChunkedHeaders_.AddHeader("Expect", "");
     pimpl_->defaultChunkedHeaders_.AddHeader("Transfer-Encoding", "chunked");
 
-    pimpl_->curl_ = curl_easy_init();
-
-    CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HEADERFUNCTION, &CurlAnswer::HeaderCallback));
-    CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_WRITEFUNCTION, &CurlAnswer::BodyCallback));
-    CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HEADER, 0));
-    CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_FOLLOWLOCATION, 1));
-
-    // This fixes the "longjmp causes uninitialized stack frame" crash
-    // that happens on modern Linux versions.
-    // http://stackoverflow.com/questions/9191668/error-longjmp-causes-uninitialized-stack-frame
-    CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_NOSIGNAL, 1));
+    // The curl handle is only assigned by "ApplyInternal()", once
+    // the URL (hence the remote host) is known
 
     url_ = "";
     method_ = HttpMethod_Get;
@@ -702,7 +892,7 @@ namespace Orthanc
 
   HttpClient::~HttpClient()
   {
-    curl_easy_cleanup(pimpl_->curl_);
+    // The curl handle is given back to the pool by "~PImpl()"
   }
 
   void HttpClient::SetUrl(const char *url)
@@ -809,17 +999,7 @@ namespace Orthanc
 
   void HttpClient::SetVerbose(bool isVerbose)
   {
-    isVerbose_ = isVerbose;
-
-    if (isVerbose_)
-    {
-      CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_VERBOSE, 1));
-      //CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_DEBUGFUNCTION, &CurlDebugCallback));
-    }
-    else
-    {
-      CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_VERBOSE, 0));
-    }
+    isVerbose_ = isVerbose;  // Applied to the curl handle by "ApplyInternal()"
   }
 
   bool HttpClient::IsVerbose() const
@@ -853,6 +1033,18 @@ namespace Orthanc
     CLOG(INFO, HTTP) << "New HTTP request to: " << url_ << " (timeout: "
                      << boost::lexical_cast<std::string>(timeout_ <= 0 ? DEFAULT_HTTP_TIMEOUT : timeout_) << "s)";
     
+    pimpl_->AssignCurlHandle(url_);
+
+    if (isVerbose_)
+    {
+      CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_VERBOSE, 1));
+      //CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_DEBUGFUNCTION, &CurlDebugCallback));
+    }
+    else
+    {
+      CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_VERBOSE, 0));
+    }
+
     CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_URL, url_.c_str()));
     CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HEADERDATA, &answer));
 
@@ -933,7 +1125,8 @@ namespace Orthanc
     }
 
     // Reset the parameters from previous calls to Apply()
-    pimpl_->userHeaders_.Assign(pimpl_->curl_);
+    const CurlHeaders* headers = &pimpl_->userHeaders_;
+    headers->Assign(pimpl_->curl_);
     CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HTTPGET, 0L));
     CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_POST, 0L));
     CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_NOBODY, 0L));
@@ -1020,7 +1213,8 @@ namespace Orthanc
     
         if (pimpl_->userHeaders_.IsEmpty())
         {
-          pimpl_->defaultChunkedHeaders_.Assign(pimpl_->curl_);
+          headers = &pimpl_->defaultChunkedHeaders_;
+          headers->Assign(pimpl_->curl_);
         }
         else if (!pimpl_->userHeaders_.IsChunkedTransfer())
         {
@@ -1042,7 +1236,8 @@ namespace Orthanc
 
         if (pimpl_->userHeaders_.IsEmpty())
         {
-          pimpl_->defaultPostHeaders_.Assign(pimpl_->curl_);
+          headers = &pimpl_->defaultPostHeaders_;
+          headers->Assign(pimpl_->curl_);
         }
 
         if (hasExternalBody_)
@@ -1064,6 +1259,19 @@ namespace Orthanc
     }
 
 
+    // Propagate the trace context, if a trace is in progress in the
+    // calling thread
+    Tracing::Span span("HTTP " + std::string(EnumerationToString(method_)), Tracing::SpanKind_Client);
+
+    std::string traceparent;
+    if (span.FormatTraceparent(traceparent))
+    {
+      span.SetAttribute("url.full", url_);
+      pimpl_->tracedHeaders_.CopyFrom(*headers);
+      pimpl_->tracedHeaders_.AddHeader("traceparent", traceparent);
+      pimpl_->tracedHeaders_.Assign(pimpl_->curl_);
+    }
+
     // Do the actual request
     CURLcode code;
     long status = 0;
@@ -1092,6 +1300,17 @@ namespace Orthanc
       CLOG(INFO, HTTP) << "cURL status code: " << code;
     }
 
+    span.SetAttribute("http.response.status_code", static_cast<int64_t>(status));
+
+    if (code != CURLE_OK)
+    {
+      span.SetError(curl_easy_strerror(code));
+    }
+    else if (status >= 400)
+    {
+      span.SetError("HTTP status " + boost::lexical_cast<std::string>(status));
+    }
+
     CheckCode(code, url_);  // throws on HTTP error
 
     if (status == 0)
@@ -1230,6 +1449,7 @@ namespace Orthanc
 
   void HttpClient::GlobalFinalize()
   {
+    GlobalParameters::GetInstance().ClearConnectionsPool();
     curl_global_cleanup();
 
 #if ORTHANC_ENABLE_PKCS11 == 1
@@ -1256,6 +1476,13 @@ namespace Orthanc
   }
 
 
+  void HttpClient::SetConnectionsPoolSize(unsigned int size)
+  {
+    CLOG(INFO, HTTP) << "Setting the number of idle HTTP client connections kept per remote host: " << size;
+    GlobalParameters::GetInstance().SetConnectionsPoolSize(size);
+  }
+
+
   bool HttpClient::Apply(IAnswer& answer)
   {
     CurlAnswer wrapper(answer, headersToLowerCase_);
@@ -240,6 +240,12 @@ namespace Orthanc
 
     static void SetDefaultTimeout(long timeout);
 
+    // New in Orthanc 1.12.12. Maximum number of idle curl handles
+    // (hence of open connections) that are kept for each remote host,
+    // in order to be reused by the next HttpClient objects. "0"
+    // disables the reuse of the connections.
+    static void SetConnectionsPoolSize(unsigned int size);
+
     void ApplyAndThrowException(IAnswer& answer);
 
     void ApplyAndThrowException(std::string& answerBody);
@@ -84,6 +84,26 @@ namespace Orthanc
     ResetFromInternalBuffer();
   }
 
+  void BufferHttpSender::AcquireBuffer(IMemoryBuffer* buffer)
+  {
+    std::unique_ptr<IMemoryBuffer> protection(buffer);
+
+    if (buffer == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+    else if (position_ != 0)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      externalBuffer_.reset(protection.release());
+      internalBuffer_.reset(NULL);
+      SetBuffer(externalBuffer_->GetData(), externalBuffer_->GetSize());
+    }
+  }
+
   void BufferHttpSender::SetChunkSize(size_t chunkSize)
   {
     chunkSize_ = chunkSize;
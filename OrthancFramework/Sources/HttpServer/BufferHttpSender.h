@@ -24,6 +24,7 @@
 #pragma once
 
 #include "HttpFileSender.h"
+#include "../IMemoryBuffer.h"
 
 namespace Orthanc
 {
@@ -31,6 +32,7 @@ namespace Orthanc
   {
   private:
     std::unique_ptr<std::string>  internalBuffer_;
+    std::unique_ptr<IMemoryBuffer>  externalBuffer_;
 
     const char*  data_;
     size_t       size_;
@@ -51,6 +53,10 @@ namespace Orthanc
     // This flavor is more efficient
     void SwapBuffer(std::string& buffer);
 
+    // Sends the content of the memory buffer without copying it,
+    // which is useful for memory-mapped files (new in Orthanc 1.12.12)
+    void AcquireBuffer(IMemoryBuffer* buffer /* takes ownership */);
+
     // This is for test purpose. If "chunkSize" is set to "0" (the
     // default), the entire buffer is consumed at once.
     void SetChunkSize(size_t chunkSize);
@@ -34,7 +34,8 @@ namespace Orthanc
   void FilesystemHttpSender::Initialize(const boost::filesystem::path& path)
   {
     SetContentFilename(path.filename().string());
-    file_.open(SystemToolbox::PathToUtf8(path).c_str(), std::ifstream::binary);
+    path_ = SystemToolbox::PathToUtf8(path);
+    file_.open(path_.c_str(), std::ifstream::binary);
 
     if (!file_.is_open())
     {
@@ -44,6 +45,9 @@ namespace Orthanc
     file_.seekg(0, file_.end);
     size_ = file_.tellg();
     file_.seekg(0, file_.beg);
+
+    hasRange_ = false;
+    remaining_ = 0;
   }
 
   FilesystemHttpSender::FilesystemHttpSender(const std::string& path)
@@ -76,9 +80,30 @@ namespace Orthanc
     Initialize(storage.GetPath(uuid));
   }
 
+  void FilesystemHttpSender::SetRange(uint64_t start,
+                                      uint64_t end)
+  {
+    if (start > end ||
+        end >= size_)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    file_.seekg(static_cast<std::streamoff>(start), file_.beg);
+
+    if (file_.fail())
+    {
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+
+    hasRange_ = true;
+    remaining_ = end - start + 1;
+  }
+
+
   uint64_t FilesystemHttpSender::GetContentLength()
   {
-    return size_;
+    return (hasRange_ ? remaining_ : size_);
   }
 
 
@@ -89,7 +114,21 @@ namespace Orthanc
       chunk_.resize(CHUNK_SIZE);
     }
 
-    file_.read(&chunk_[0], static_cast<std::streamsize>(chunk_.size()));
+    size_t toRead = chunk_.size();
+    if (hasRange_)
+    {
+      if (remaining_ == 0)
+      {
+        chunkSize_ = 0;
+        return false;
+      }
+      else if (remaining_ < static_cast<uint64_t>(toRead))
+      {
+        toRead = static_cast<size_t>(remaining_);
+      }
+    }
+
+    file_.read(&chunk_[0], static_cast<std::streamsize>(toRead));
 
     if ((file_.flags() & std::istream::failbit) ||
         file_.gcount() < 0)
@@ -99,6 +138,11 @@ namespace Orthanc
 
     chunkSize_ = static_cast<size_t>(file_.gcount());
 
+    if (hasRange_)
+    {
+      remaining_ -= chunkSize_;
+    }
+
     return chunkSize_ > 0;
   }
 
@@ -111,4 +155,17 @@ namespace Orthanc
   {
     return chunkSize_;
   }
+
+  bool FilesystemHttpSender::LookupLocalFile(std::string& path)
+  {
+    if (hasRange_)
+    {
+      return false;  // "sendfile()" would send the whole file
+    }
+    else
+    {
+      path = path_;
+      return true;
+    }
+  }
 }
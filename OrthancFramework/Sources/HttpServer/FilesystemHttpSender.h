@@ -35,9 +35,12 @@ namespace Orthanc
   {
   private:
     std::ifstream    file_;
+    std::string      path_;
     uint64_t         size_;
     std::string      chunk_;
     size_t           chunkSize_;
+    bool             hasRange_;   // New in Orthanc 1.12.12
+    uint64_t         remaining_;  // Only meaningful if "hasRange_"
 
     void Initialize(const boost::filesystem::path& path);
 
@@ -55,6 +58,16 @@ namespace Orthanc
     FilesystemHttpSender(const FilesystemStorage& storage,
                          const std::string& uuid);
 
+    // Only send the bytes "[start, end]" of the file, which disables
+    // the zero-copy transmission (new in Orthanc 1.12.12)
+    void SetRange(uint64_t start,
+                  uint64_t end);
+
+    uint64_t GetFileSize() const
+    {
+      return size_;
+    }
+
     /**
      * Implementation of the IHttpStreamAnswer interface.
      **/
@@ -66,5 +79,7 @@ namespace Orthanc
     virtual const char* GetChunkContent() ORTHANC_OVERRIDE;
 
     virtual size_t GetChunkSize() ORTHANC_OVERRIDE;
+
+    virtual bool LookupLocalFile(std::string& path) ORTHANC_OVERRIDE;
   };
 }
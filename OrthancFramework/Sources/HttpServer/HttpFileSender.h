@@ -57,5 +57,10 @@ namespace Orthanc
     virtual bool HasContentFilename(std::string& filename) ORTHANC_OVERRIDE;
     
     virtual std::string GetContentType() ORTHANC_OVERRIDE;
+
+    virtual bool LookupLocalFile(std::string& path) ORTHANC_OVERRIDE
+    {
+      return false;
+    }
   };
 }
@@ -30,15 +30,26 @@
 #include "../Compression/ZlibCompressor.h"
 #include "../Logging.h"
 #include "../OrthancException.h"
+#include "../RequestTimings.h"
 #include "../Toolbox.h"
 #include "../SystemToolbox.h"
 
+#include <cassert>
 #include <iostream>
 #include <vector>
 #include <stdio.h>
+#include <string.h>
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
 
+#if !defined(ORTHANC_ENABLE_ZSTD)
+#  error The macro ORTHANC_ENABLE_ZSTD must be defined
+#endif
+
+#if ORTHANC_ENABLE_ZSTD == 1
+#  include "../Compression/ZstdCompressor.h"
+#endif
+
 #if ORTHANC_ENABLE_CIVETWEB == 1
 #  if !defined(CIVETWEB_HAS_DISABLE_KEEP_ALIVE)
 #    error Macro CIVETWEB_HAS_DISABLE_KEEP_ALIVE must be defined
@@ -48,6 +59,18 @@
 static const std::string X_CONTENT_TYPE_OPTIONS = "X-Content-Type-Options";
 
 
+static void AddServerTimingHeader(std::string& header)
+{
+  // The accounting is the one that is known when the HTTP header is
+  // sent, which might miss the end of the streamed answers
+  std::string value;
+  if (Orthanc::RequestTimings::FormatCurrentServerTiming(value))
+  {
+    header += "Server-Timing: " + value + "\r\n";
+  }
+}
+
+
 namespace Orthanc
 {
   HttpOutput::StateMachine::StateMachine(IHttpOutputStream& stream,
@@ -63,7 +86,8 @@ namespace Orthanc
     keepAlive_(isKeepAlive),
     keepAliveTimeout_(keepAliveTimeout),
     hasXContentTypeOptions_(false),
-    hasContentType_(false)
+    hasContentType_(false),
+    sentBodySize_(0)
   {
   }
 
@@ -236,6 +260,8 @@ namespace Orthanc
         s += *it;
       }
 
+      AddServerTimingHeader(s);
+
       if (!hasXContentTypeOptions_)
       {
         // Always include this header to prevent MIME Confusion attacks:
@@ -243,7 +269,8 @@ namespace Orthanc
         s += X_CONTENT_TYPE_OPTIONS + ": nosniff\r\n";
       }
 
-      if (status_ != HttpStatus_200_Ok)
+      if (status_ != HttpStatus_200_Ok &&
+          status_ != HttpStatus_206_PartialContent)
       {
         hasContentLength_ = false;
       }
@@ -266,6 +293,7 @@ namespace Orthanc
     {
       stream_.Send(false, buffer, length);
       contentPosition_ += length;
+      sentBodySize_ += length;
     }
 
     if (!hasContentLength_ ||
@@ -276,6 +304,32 @@ namespace Orthanc
   }
 
 
+  bool HttpOutput::StateMachine::IsSendFileSupported() const
+  {
+    return stream_.IsSendFileSupported();
+  }
+
+
+  void HttpOutput::StateMachine::SendFileBody(const std::string& path)
+  {
+    if (state_ != State_WritingHeader ||
+        !hasContentLength_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    SendBody(NULL, 0);  // Only sends the HTTP header
+
+    if (state_ == State_WritingBody)
+    {
+      stream_.SendFile(path);
+      contentPosition_ = contentLength_;
+      sentBodySize_ += contentLength_;
+      state_ = State_Done;
+    }
+  }
+
+
   void HttpOutput::StateMachine::CloseBody()
   {
     switch (state_)
@@ -315,14 +369,19 @@ namespace Orthanc
   HttpCompression HttpOutput::GetPreferredCompression(size_t bodySize) const
   {
     // Do not compress small files since there is no real size benefit.
-    if (bodySize < 2048)
+    if (bodySize < compressionMinimumSize_)
     {
       return HttpCompression_None;
     }
 
-    // Prefer "gzip" over "deflate" if the choice is offered
+    // Prefer "zstd" over "gzip" over "deflate" if the choice is
+    // offered, as zstd is both faster and more efficient
 
-    if (isGzipAllowed_)
+    if (isZstdAllowed_)
+    {
+      return HttpCompression_Zstd;
+    }
+    else if (isGzipAllowed_)
     {
       return HttpCompression_Gzip;
     }
@@ -342,7 +401,10 @@ namespace Orthanc
                          unsigned int keepAliveTimeout) :
     stateMachine_(stream, isKeepAlive, keepAliveTimeout),
     isDeflateAllowed_(false),
-    isGzipAllowed_(false)
+    isGzipAllowed_(false),
+    isZstdAllowed_(false),
+    compressionMinimumSize_(2048),
+    zstdCompressionLevel_(3)
   {
   }
 
@@ -366,6 +428,37 @@ namespace Orthanc
     return isGzipAllowed_;
   }
 
+  void HttpOutput::SetZstdAllowed(bool allowed)
+  {
+#if ORTHANC_ENABLE_ZSTD == 1
+    isZstdAllowed_ = allowed;
+#else
+    isZstdAllowed_ = false;  // Silently ignore, as zstd cannot be used
+#endif
+  }
+
+  bool HttpOutput::IsZstdAllowed() const
+  {
+    return isZstdAllowed_;
+  }
+
+  void HttpOutput::SetCompressionMinimumSize(size_t size)
+  {
+    compressionMinimumSize_ = size;
+  }
+
+  void HttpOutput::SetZstdCompressionLevel(int level)
+  {
+    if (level < 1)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      zstdCompressionLevel_ = level;
+    }
+  }
+
 
   void HttpOutput::SendMethodNotAllowed(const std::string& allowed)
   {
@@ -527,6 +620,18 @@ namespace Orthanc
         break;
       }
 
+#if ORTHANC_ENABLE_ZSTD == 1
+      case HttpCompression_Zstd:
+      {
+        encoding = "zstd";
+        ZstdCompressor compressor;
+        compressor.SetCompressionLevel(zstdCompressionLevel_);
+        compressor.SetPrefixWithUncompressedSize(false);  // Plain zstd frame
+        compressor.Compress(compressed, buffer, length);
+        break;
+      }
+#endif
+
       default:
         THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
     }
@@ -555,6 +660,82 @@ namespace Orthanc
   }
 
 
+  class HttpOutput::ChunksSender : public ChunkedBuffer::IVisitor
+  {
+  private:
+    StateMachine&  stateMachine_;
+
+  public:
+    explicit ChunksSender(StateMachine& stateMachine) :
+      stateMachine_(stateMachine)
+    {
+    }
+
+    virtual void VisitChunk(const void* data,
+                            size_t size) ORTHANC_OVERRIDE
+    {
+      stateMachine_.SendBody(data, size);
+    }
+  };
+
+
+  namespace
+  {
+    class ChunksCopier : public ChunkedBuffer::IVisitor
+    {
+    private:
+      std::string&  target_;
+      size_t        pos_;
+
+    public:
+      ChunksCopier(std::string& target,
+                   size_t size) :
+        target_(target),
+        pos_(0)
+      {
+        target_.resize(size);
+      }
+
+      virtual void VisitChunk(const void* data,
+                              size_t size) ORTHANC_OVERRIDE
+      {
+        assert(pos_ + size <= target_.size());
+        memcpy(&target_[pos_], data, size);
+        pos_ += size;
+      }
+    };
+  }
+
+
+  void HttpOutput::Answer(const ChunkedBuffer& body)
+  {
+    const size_t length = body.GetNumBytes();
+
+    if (length != 0 &&
+        (GetPreferredCompression(length) == HttpCompression_None ||
+         !IsContentCompressible()))
+    {
+      // Scatter-gather output
+      stateMachine_.SetContentLength(length);
+
+      ChunksSender sender(stateMachine_);
+      body.Visit(sender);
+    }
+    else
+    {
+      // The compressors need one contiguous memory block
+      std::string flattened;
+
+      {
+        ChunksCopier copier(flattened, length);
+        body.Visit(copier);
+      }
+
+      Answer(flattened);
+    }
+  }
+
+
   void HttpOutput::AnswerEmpty()
   {
     stateMachine_.CloseBody();
@@ -685,6 +866,8 @@ namespace Orthanc
       header += *it;
     }
 
+    AddServerTimingHeader(header);
+
     header += ("Content-Type: " + contentType + "\r\n\r\n");
 
     stream_.Send(true, header.c_str(), header.size());
@@ -785,6 +968,7 @@ namespace Orthanc
     }
 
     stream_.Send(false, "\r\n", 2);    
+    sentBodySize_ += header.size() + length + 2;
   }
 
 
@@ -801,6 +985,7 @@ namespace Orthanc
     {
       std::string header = "--" + multipartBoundary_ + "--\r\n";
       stream_.Send(false, header.c_str(), header.size());
+      sentBodySize_ += header.size();
     }
     catch (OrthancException&) //NOLINT(bugprone-empty-catch)
     {
@@ -824,6 +1009,7 @@ namespace Orthanc
       if (size > 0)
       {
         stream_.Send(false, data, size);
+        sentBodySize_ += size;
       }
     }
   }
@@ -857,9 +1043,6 @@ namespace Orthanc
       }
     }
 
-    std::string s;
-    buffer.Flatten(s);
-
     output.SetContentType(stream.GetContentType());
     
     std::string filename;
@@ -868,7 +1051,7 @@ namespace Orthanc
       output.SetContentFilename(filename.c_str());
     }
 
-    output.Answer(s);
+    output.Answer(buffer);
   }
 
 
@@ -876,11 +1059,20 @@ namespace Orthanc
   {
     HttpCompression compression = stream.SetupHttpCompression(isGzipAllowed_, isDeflateAllowed_);
 
+    // New in Orthanc 1.12.12: Zero-copy transmission of the files of
+    // the local filesystem, if supported by the HTTP server
+    std::string localFile;
+    const bool isLocalFile = (compression == HttpCompression_None &&
+                              stateMachine_.IsSendFileSupported() &&
+                              stream.LookupLocalFile(localFile));
+
     switch (compression)
     {
       case HttpCompression_None:
       {
-        if (isGzipAllowed_ || isDeflateAllowed_)
+        if ((isGzipAllowed_ || isDeflateAllowed_ || isZstdAllowed_) &&
+            (!isLocalFile ||
+             SystemToolbox::IsContentCompressible(stream.GetContentType())))
         {
           // New in Orthanc 1.5.7: Compress streams without built-in
           // compression, if requested by the "Accept-Encoding" HTTP
@@ -920,6 +1112,55 @@ namespace Orthanc
       SetContentFilename(filename.c_str());
     }
 
+    if (isLocalFile)
+    {
+      stateMachine_.SendFileBody(localFile);
+    }
+    else
+    {
+      while (stream.ReadNextChunk())
+      {
+        stateMachine_.SendBody(stream.GetChunkContent(),
+                               stream.GetChunkSize());
+      }
+    }
+
+    stateMachine_.CloseBody();
+  }
+
+
+  void HttpOutput::AnswerPartialContent(IHttpStreamAnswer& stream,
+                                        uint64_t start,
+                                        uint64_t resourceSize)
+  {
+    const uint64_t length = stream.GetContentLength();
+
+    if (length == 0 ||
+        start + length > resourceSize)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    stateMachine_.SetHttpStatus(HttpStatus_206_PartialContent);
+    stateMachine_.AddHeader("Content-Range", "bytes " + boost::lexical_cast<std::string>(start) + "-" +
+                            boost::lexical_cast<std::string>(start + length - 1) + "/" +
+                            boost::lexical_cast<std::string>(resourceSize));
+    stateMachine_.SetContentLength(length);
+
+    std::string contentType = stream.GetContentType();
+    if (contentType.empty())
+    {
+      contentType = MIME_BINARY;
+    }
+
+    stateMachine_.SetContentType(contentType.c_str());
+
+    std::string filename;
+    if (stream.HasContentFilename(filename))
+    {
+      SetContentFilename(filename.c_str());
+    }
+
     while (stream.ReadNextChunk())
     {
       stateMachine_.SendBody(stream.GetChunkContent(),
@@ -964,9 +1205,7 @@ namespace Orthanc
 
     chunked.AddChunk("--" + boundary + "--\r\n");
 
-    std::string body;
-    chunked.Flatten(body);
-    Answer(body);
+    Answer(chunked);
   }
 
 
@@ -1010,4 +1249,39 @@ namespace Orthanc
     stateMachine_.CloseStream();
   }
 
+
+  void HttpOutput::StartBody(const std::string& contentType,
+                             uint64_t contentLength)
+  {
+    if (stateMachine_.GetState() != StateMachine::State_WritingHeader)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    stateMachine_.SetContentType(contentType.empty() ? MIME_BINARY : contentType.c_str());
+    stateMachine_.SetContentLength(contentLength);
+    stateMachine_.SendBody(NULL, 0);  // Only sends the HTTP header
+  }
+
+  void HttpOutput::SendBodyChunk(const void* data,
+                                 size_t size)
+  {
+    if (stateMachine_.GetState() != StateMachine::State_WritingBody &&
+        !(stateMachine_.GetState() == StateMachine::State_Done && size == 0))
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    stateMachine_.SendBody(data, size);
+  }
+
+  void HttpOutput::CloseBody()
+  {
+    stateMachine_.CloseBody();
+  }
+
+  bool HttpOutput::IsWritingBody() const
+  {
+    return stateMachine_.GetState() == StateMachine::State_WritingBody;
+  }
 }
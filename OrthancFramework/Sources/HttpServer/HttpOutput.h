@@ -24,6 +24,7 @@
 
 #pragma once
 
+#include "../ChunkedBuffer.h"
 #include "../Enumerations.h"
 #include "IHttpOutputStream.h"
 #include "IHttpStreamAnswer.h"
@@ -67,6 +68,7 @@ namespace Orthanc
       std::list<std::string> headers_;
       bool hasXContentTypeOptions_;
       bool hasContentType_;
+      uint64_t sentBodySize_;
 
       std::string multipartBoundary_;
       std::string multipartContentType_;
@@ -100,6 +102,11 @@ namespace Orthanc
 
       void SendBody(const void* buffer, size_t length);
 
+      bool IsSendFileSupported() const;
+
+      // The content length must have been set to the size of the file
+      void SendFileBody(const std::string& path);
+
       void StartMultipart(const std::string& subType,
                           const std::string& contentType);
 
@@ -131,14 +138,30 @@ namespace Orthanc
       {
         return hasContentType_;
       }
+
+      // Number of bytes sent after the HTTP header
+      uint64_t GetSentBodySize() const
+      {
+        return sentBodySize_;
+      }
+
+      HttpStatus GetHttpStatus() const
+      {
+        return status_;
+      }
     };
 
     StateMachine stateMachine_;
     bool         isDeflateAllowed_;
     bool         isGzipAllowed_;
+    bool         isZstdAllowed_;
+    size_t       compressionMinimumSize_;
+    int          zstdCompressionLevel_;
 
     HttpCompression GetPreferredCompression(size_t bodySize) const;
 
+    class ChunksSender;
+
   public:
     HttpOutput(IHttpOutputStream& stream,
                bool isKeepAlive,
@@ -152,11 +175,45 @@ namespace Orthanc
 
     bool IsGzipAllowed() const;
 
+    // New in Orthanc 1.12.12. Only effective if Orthanc is built with zstd support.
+    void SetZstdAllowed(bool allowed);
+
+    bool IsZstdAllowed() const;
+
+    // New in Orthanc 1.12.12. Bodies that are smaller are never compressed.
+    void SetCompressionMinimumSize(size_t size);
+
+    size_t GetCompressionMinimumSize() const
+    {
+      return compressionMinimumSize_;
+    }
+
+    // New in Orthanc 1.12.12
+    void SetZstdCompressionLevel(int level);
+
+    int GetZstdCompressionLevel() const
+    {
+      return zstdCompressionLevel_;
+    }
+
     bool IsContentCompressible() const
     {
       return stateMachine_.IsContentCompressible();
     }
 
+    // New in Orthanc 1.12.12. Size of the body that was sent so far
+    // (after compression, and including the multipart separators).
+    uint64_t GetSentBodySize() const
+    {
+      return stateMachine_.GetSentBodySize();
+    }
+
+    // New in Orthanc 1.12.12
+    HttpStatus GetHttpStatus() const
+    {
+      return stateMachine_.GetHttpStatus();
+    }
+
     void SendStatus(HttpStatus status,
 		    const char* message,
 		    size_t messageSize);
@@ -183,6 +240,11 @@ namespace Orthanc
 
     void Answer(const std::string& str);
 
+    // New in Orthanc 1.12.12: If the answer is not compressed, the
+    // chunks of the buffer are directly sent one after the other,
+    // without being flattened into one contiguous memory block
+    void Answer(const ChunkedBuffer& body);
+
     void AnswerEmpty();
 
     void SendMethodNotAllowed(const std::string& allowed);
@@ -204,6 +266,14 @@ namespace Orthanc
 
     void Answer(IHttpStreamAnswer& stream);
 
+    // New in Orthanc 1.12.12: Answers with status "206 Partial
+    // Content", the stream only containing the bytes from "start" of
+    // a resource whose full size is "resourceSize". The stream is
+    // never compressed.
+    void AnswerPartialContent(IHttpStreamAnswer& stream,
+                              uint64_t start,
+                              uint64_t resourceSize);
+
     /**
      * This method is a replacement to the combination
      * "StartMultipart()" + "SendMultipartItem()". It generates the
@@ -233,5 +303,22 @@ namespace Orthanc
     void CloseStream();
 
     bool IsWritingStream() const;
+
+    /**
+     * New in Orthanc 1.12.12: Sends a body whose size is known in
+     * advance by successive chunks, with a "Content-Length" header
+     * instead of a chunked transfer. The body is neither buffered nor
+     * compressed. "CloseBody()" fails if fewer bytes than announced
+     * were sent.
+     **/
+    void StartBody(const std::string& contentType,
+                   uint64_t contentLength);
+
+    void SendBodyChunk(const void* data,
+                       size_t size);
+
+    void CloseBody();
+
+    bool IsWritingBody() const;
   };
 }
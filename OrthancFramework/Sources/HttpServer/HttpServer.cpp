@@ -46,6 +46,14 @@
 #  include "IWebDavBucket.h"
 #endif
 
+#if !defined(ORTHANC_ENABLE_ZSTD)
+#  error The macro ORTHANC_ENABLE_ZSTD must be defined
+#endif
+
+#if ORTHANC_ENABLE_ZSTD == 1
+#  include "../Compression/ZstdCompressor.h"
+#endif
+
 #if ORTHANC_ENABLE_MONGOOSE == 1
 #  include <mongoose.h>
 
@@ -150,6 +158,33 @@ namespace Orthanc
         // Ignore this
       }
 
+      virtual bool IsSendFileSupported() const ORTHANC_OVERRIDE
+      {
+#if ORTHANC_ENABLE_CIVETWEB == 1
+        return true;
+#else
+        return false;
+#endif
+      }
+
+      virtual void SendFile(const std::string& path) ORTHANC_OVERRIDE
+      {
+#if ORTHANC_ENABLE_CIVETWEB == 1
+        /**
+         * CivetWeb relies on "sendfile()" on Linux, which avoids
+         * copying the file through the user space. It falls back to
+         * "fread()/mg_write()" if HTTPS or throttling is in use.
+         **/
+        if (mg_send_file_body(connection_, path.c_str()) < 0)
+        {
+          throw OrthancException(ErrorCode_InexistentFile);
+        }
+#else
+        throw OrthancException(ErrorCode_NotImplemented,
+                               "Only available if using CivetWeb");
+#endif
+      }
+
       virtual void DisableKeepAlive() ORTHANC_OVERRIDE
       {
 #if ORTHANC_ENABLE_MONGOOSE == 1
@@ -481,20 +516,59 @@ namespace Orthanc
   };
 
 
-  void HttpServer::ProcessMultipartFormData(const std::string& remoteIp,
-                                            const std::string& username,
-                                            const UriComponents& uri,
-                                            const std::map<std::string, std::string>& headers,
-                                            const std::string& body,
-                                            const std::string& boundary,
-                                            const std::string& authenticationPayload)
+  class HttpServer::MultipartFormDataReader : public IHttpHandler::IChunkedRequestReader
   {
-    MultipartFormDataHandler handler(GetHandler(), pimpl_->chunkStore_, remoteIp, username, uri, headers, authenticationPayload);
-          
-    MultipartStreamReader reader(boundary);
-    reader.SetHandler(handler);
-    reader.AddChunk(body);        
-    reader.CloseStream();
+  private:
+    std::string               remoteIp_;
+    std::string               username_;
+    UriComponents             uri_;
+    std::string               authenticationPayload_;
+    MultipartFormDataHandler  handler_;
+    MultipartStreamReader     reader_;
+
+  public:
+    MultipartFormDataReader(IHttpHandler& handler,
+                            ChunkStore& chunkStore,
+                            const std::string& remoteIp,
+                            const std::string& username,
+                            const UriComponents& uri,
+                            const MultipartStreamReader::HttpHeaders& headers,
+                            const std::string& boundary,
+                            const std::string& authenticationPayload) :
+      remoteIp_(remoteIp),
+      username_(username),
+      uri_(uri),
+      authenticationPayload_(authenticationPayload),
+      handler_(handler, chunkStore, remoteIp_, username_, uri_, headers, authenticationPayload_),
+      reader_(boundary)
+    {
+      reader_.SetHandler(handler_);
+    }
+
+    virtual void AddBodyChunk(const void* data,
+                              size_t size) ORTHANC_OVERRIDE
+    {
+      // Each part is handled as soon as it is complete, while the
+      // remainder of the body is still being received (new in Orthanc 1.12.12)
+      reader_.AddChunk(data, size);
+    }
+
+    virtual void Execute(HttpOutput& output) ORTHANC_OVERRIDE
+    {
+      reader_.CloseStream();
+      output.SendStatus(HttpStatus_200_Ok);
+    }
+  };
+
+
+  IHttpHandler::IChunkedRequestReader* HttpServer::CreateMultipartFormDataReader(const std::string& remoteIp,
+                                                                                 const std::string& username,
+                                                                                 const UriComponents& uri,
+                                                                                 const std::map<std::string, std::string>& headers,
+                                                                                 const std::string& boundary,
+                                                                                 const std::string& authenticationPayload)
+  {
+    return new MultipartFormDataReader(GetHandler(), pimpl_->chunkStore_, remoteIp, username, uri, headers, boundary, authenticationPayload);
   }
 
 
@@ -544,17 +618,13 @@ namespace Orthanc
   }
 
 
-  static PostDataStatus ReadBodyWithContentLength(std::string& body,
-                                                  struct mg_connection *connection,
-                                                  const std::string& contentLength,
-                                                  bool hasMaxBodySize,
-                                                  size_t maxBodySize)
+  static PostDataStatus ParseContentLength(size_t& length,
+                                           const std::string& contentLength,
+                                           bool hasMaxBodySize,
+                                           size_t maxBodySize)
   {
-    static const size_t MAXIMUM_BODY_SIZE_IN_MEMORY = static_cast<size_t>(100) * 1024 * 1024;  // 100MB
-
     assert(!hasMaxBodySize || maxBodySize > 0);
 
-    size_t length;
     try
     {
       int64_t tmp = boost::lexical_cast<int64_t>(contentLength);
@@ -579,6 +649,27 @@ namespace Orthanc
     {
       return PostDataStatus_RequestEntityTooLarge;
     }
+    else
+    {
+      return PostDataStatus_Success;
+    }
+  }
+
+
+  static PostDataStatus ReadBodyWithContentLength(std::string& body,
+                                                  struct mg_connection *connection,
+                                                  const std::string& contentLength,
+                                                  bool hasMaxBodySize,
+                                                  size_t maxBodySize)
+  {
+    static const size_t MAXIMUM_BODY_SIZE_IN_MEMORY = static_cast<size_t>(100) * 1024 * 1024;  // 100MB
+
+    size_t length;
+    PostDataStatus status = ParseContentLength(length, contentLength, hasMaxBodySize, maxBodySize);
+    if (status != PostDataStatus_Success)
+    {
+      return status;
+    }
 
     if (length < MAXIMUM_BODY_SIZE_IN_MEMORY)
     {
@@ -666,26 +757,46 @@ namespace Orthanc
                                          bool hasMaxBodySize,
                                          size_t maxBodySize)
   {
+    static const size_t CHUNK_SIZE = static_cast<size_t>(1024) * 1024;  // 1MB
+
     HttpToolbox::Arguments::const_iterator contentLength = headers.find("content-length");
 
     if (contentLength != headers.end())
     {
-      // "Content-Length" is available
-      std::string body;
-      PostDataStatus status = ReadBodyWithContentLength(body, connection, contentLength->second, hasMaxBodySize, maxBodySize);
+      /**
+       * "Content-Length" is available. Since Orthanc 1.12.12, the
+       * body is also streamed in this case, instead of being
+       * collected into one single memory buffer.
+       **/
+      size_t length;
+      PostDataStatus status = ParseContentLength(length, contentLength->second, hasMaxBodySize, maxBodySize);
+      if (status != PostDataStatus_Success)
+      {
+        return status;
+      }
 
-      if (status == PostDataStatus_Success &&
-          !body.empty())
+      std::string tmp(std::min(length, CHUNK_SIZE), 0);
+
+      while (length > 0)
       {
-        stream.AddBodyChunk(body.c_str(), body.size());
+        int r = mg_read(connection, &tmp[0], std::min(length, tmp.size()));
+        if (r <= 0)
+        {
+          return PostDataStatus_Failure;
+        }
+
+        assert(static_cast<size_t>(r) <= length);
+        stream.AddBodyChunk(tmp.c_str(), r);
+        length -= r;
       }
 
-      return status;
+      return PostDataStatus_Success;
     }
     else
     {
       // No Content-Length: This is a chunked transfer. Stream the HTTP connection.
-      std::string tmp(static_cast<size_t>(1024) * 1024, 0);
+      std::string tmp(CHUNK_SIZE, 0);
+      uint64_t readSoFar = 0;
       
       for (;;)
       {
@@ -700,6 +811,14 @@ namespace Orthanc
         }
         else
         {
+          readSoFar += r;
+
+          if (hasMaxBodySize &&
+              readSoFar > maxBodySize)
+          {
+            return PostDataStatus_RequestEntityTooLarge;
+          }
+
           stream.AddBodyChunk(tmp.c_str(), r);
         }
       }
@@ -865,8 +984,12 @@ namespace Orthanc
 
 
   static void ConfigureHttpCompression(HttpOutput& output,
+                                       const HttpServer& server,
                                        const HttpToolbox::Arguments& headers)
   {
+    output.SetCompressionMinimumSize(server.GetHttpCompressionMinimumSize());
+    output.SetZstdCompressionLevel(server.GetHttpZstdCompressionLevel());
+
     // Look if the client wishes HTTP compression
     // https://en.wikipedia.org/wiki/HTTP_compression
     HttpToolbox::Arguments::const_iterator it = headers.find("accept-encoding");
@@ -887,6 +1010,11 @@ namespace Orthanc
         {
           output.SetGzipAllowed(true);
         }
+        else if (s == "zstd")
+        {
+          // New in Orthanc 1.12.12 (no-op if zstd support is disabled)
+          output.SetZstdAllowed(true);
+        }
       }
     }
   }
@@ -1007,7 +1135,7 @@ namespace Orthanc
             std::string answer;
           
             MimeType mime;
-            std::string content;
+            uint64_t contentLength;
             boost::posix_time::ptime modificationTime = boost::posix_time::second_clock::universal_time();
 
             if (bucket->second->IsExistingFolder(path))
@@ -1035,13 +1163,13 @@ namespace Orthanc
               }
             }
             else if (!path.empty() &&
-                     bucket->second->GetFileContent(mime, content, modificationTime, path))
+                     bucket->second->GetFileInfo(mime, contentLength, modificationTime, path))
             {
               if (depth == 0 ||
                   depth == 1)
               {
                 std::unique_ptr<IWebDavBucket::File> f(new IWebDavBucket::File(path.back()));
-                f->SetContentLength(content.size());
+                f->SetContentLength(contentLength);
                 f->SetModificationTime(modificationTime);
                 f->SetMimeType(mime);
 
@@ -1320,7 +1448,7 @@ namespace Orthanc
 
     if (server.IsHttpCompressionEnabled())
     {
-      ConfigureHttpCompression(output, headers);
+      ConfigureHttpCompression(output, server, headers);
     }
 
 
@@ -1527,11 +1655,13 @@ namespace Orthanc
          **/
         isMultipartForm = true;
 
-        postStatus = ReadBodyToString(body, connection, headers, server.HasMaxBodySize(), server.GetMaxBodySize());
+        std::unique_ptr<IHttpHandler::IChunkedRequestReader> stream(
+          server.CreateMultipartFormDataReader(remoteIp, username, uri, headers, boundary, authenticationPayload));
+
+        postStatus = ReadBodyToStream(*stream, connection, headers, server.HasMaxBodySize(), server.GetMaxBodySize());
         if (postStatus == PostDataStatus_Success)
         {
-          server.ProcessMultipartFormData(remoteIp, username, uri, headers, body, boundary, authenticationPayload);
-          output.SendStatus(HttpStatus_200_Ok);
+          stream->Execute(output);
           return;
         }
       }
@@ -1764,6 +1894,8 @@ namespace Orthanc
     keepAlive_(false),
     keepAliveTimeout_(1),
     httpCompression_(true),
+    httpCompressionMinimumSize_(2048),
+    httpZstdCompressionLevel_(3),
     exceptionFormatter_(NULL),
     realm_(ORTHANC_REALM),
     threadsCount_(50),  // Default value in mongoose/civetweb
@@ -2277,6 +2409,39 @@ namespace Orthanc
     CLOG(WARNING, HTTP) << "HTTP compression is " << (enabled ? "enabled" : "disabled");
   }
 
+  size_t HttpServer::GetHttpCompressionMinimumSize() const
+  {
+    return httpCompressionMinimumSize_;
+  }
+
+  void HttpServer::SetHttpCompressionMinimumSize(size_t size)
+  {
+    Stop();
+    httpCompressionMinimumSize_ = size;
+  }
+
+  int HttpServer::GetHttpZstdCompressionLevel() const
+  {
+    return httpZstdCompressionLevel_;
+  }
+
+  void HttpServer::SetHttpZstdCompressionLevel(int level)
+  {
+#if ORTHANC_ENABLE_ZSTD == 1
+    // Validate the level against the range supported by the zstd library
+    ZstdCompressor compressor;
+    compressor.SetCompressionLevel(level);
+#else
+    if (level < 1)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+#endif
+
+    Stop();
+    httpZstdCompressionLevel_ = level;
+  }
+
   IIncomingHttpRequestFilter *HttpServer::GetIncomingHttpRequestFilter() const
   {
     return filter_;
@@ -2340,6 +2505,13 @@ namespace Orthanc
   }
 
 
+  void HttpServer::SetThreadsAffinity(const std::set<unsigned int>& cpus)
+  {
+    Stop();
+    threadsAffinity_ = cpus;
+  }
+
+
   void HttpServer::SetThreadsCount(unsigned int threads)
   {
     if (threads == 0)
@@ -2469,11 +2641,17 @@ namespace Orthanc
 
   void HttpServer::UpdateCurrentThreadName()
   {
-    // threads are created in CivetWeb -> assign them a name the first time they are used
+    // threads are created in CivetWeb -> assign them a name (and
+    // their CPU affinity) the first time they are used
     if (!Logging::HasCurrentThreadName())
     {
       boost::mutex::scoped_lock lock(threadCounterMutex_);
       Logging::SetCurrentThreadName(std::string("HTTP-") + boost::lexical_cast<std::string>(threadCounter_++));
+
+      if (!threadsAffinity_.empty())
+      {
+        SystemToolbox::SetCurrentThreadAffinity(threadsAffinity_);
+      }
     }
   }
 
@@ -45,6 +45,7 @@
 #endif
 
 
+#include "IHttpHandler.h"
 #include "IIncomingHttpRequestFilter.h"
 #include "../MetricsRegistry.h"
 
@@ -90,6 +91,7 @@ namespace Orthanc
 
     class ChunkStore;
     class MultipartFormDataHandler;
+    class MultipartFormDataReader;
 
     IHttpHandler *handler_;
 
@@ -111,6 +113,8 @@ namespace Orthanc
     bool keepAlive_;
     unsigned int keepAliveTimeout_;
     bool httpCompression_;
+    size_t httpCompressionMinimumSize_;
+    int httpZstdCompressionLevel_;
     IHttpExceptionFormatter* exceptionFormatter_;
     std::string realm_;
     unsigned int threadsCount_;
@@ -120,6 +124,7 @@ namespace Orthanc
 
     boost::mutex threadCounterMutex_;  // New in Orthanc 1.12.9
     uint16_t threadCounter_;           // Introduced as a global, static variable in Orthanc 1.12.2
+    std::set<unsigned int> threadsAffinity_;  // New in Orthanc 1.12.12, empty means no affinity
 
     // New in Orthanc 1.12.11
     bool    hasMaxBodySize_;
@@ -189,6 +194,14 @@ namespace Orthanc
 
     void SetHttpCompressionEnabled(bool enabled);
 
+    size_t GetHttpCompressionMinimumSize() const;
+
+    void SetHttpCompressionMinimumSize(size_t size);
+
+    int GetHttpZstdCompressionLevel() const;
+
+    void SetHttpZstdCompressionLevel(int level);
+
     IIncomingHttpRequestFilter* GetIncomingHttpRequestFilter() const;
 
     void SetIncomingHttpRequestFilter(IIncomingHttpRequestFilter& filter);
@@ -213,6 +226,10 @@ namespace Orthanc
 
     unsigned int GetThreadsCount() const;
 
+    // New in Orthanc 1.12.12, not available for Mongoose. Pins the
+    // threads of CivetWeb to the given CPUs (empty means no affinity).
+    void SetThreadsAffinity(const std::set<unsigned int>& cpus);
+
     // New in Orthanc 1.5.2, not available for Mongoose
     void SetTcpNoDelay(bool tcpNoDelay);
 
@@ -232,13 +249,12 @@ namespace Orthanc
 #endif
 
     ORTHANC_LOCAL
-    void ProcessMultipartFormData(const std::string& remoteIp,
-                                  const std::string& username,
-                                  const UriComponents& uri,
-                                  const std::map<std::string, std::string>& headers,
-                                  const std::string& body,
-                                  const std::string& boundary,
-                                  const std::string& authenticationPayload);
+    IHttpHandler::IChunkedRequestReader* CreateMultipartFormDataReader(const std::string& remoteIp,
+                                                                       const std::string& username,
+                                                                       const UriComponents& uri,
+                                                                       const std::map<std::string, std::string>& headers,
+                                                                       const std::string& boundary,
+                                                                       const std::string& authenticationPayload);
 
     static std::string GetRelativePathToRoot(const std::string& uri);
 
@@ -261,4 +261,17 @@ namespace Orthanc
       return static_cast<size_t>(source_.GetChunkSize() - currentChunkOffset_);
     }
   }
+
+
+  bool HttpStreamTranscoder::LookupLocalFile(std::string& path)
+  {
+    if (!ready_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    // The file can only be sent as such if it is not transcoded
+    return (sourceCompression_ == CompressionType_None &&
+            source_.LookupLocalFile(path));
+  }
 }
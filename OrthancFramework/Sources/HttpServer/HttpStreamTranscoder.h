@@ -67,5 +67,7 @@ namespace Orthanc
     virtual const char* GetChunkContent() ORTHANC_OVERRIDE;
 
     virtual size_t GetChunkSize() ORTHANC_OVERRIDE;
+
+    virtual bool LookupLocalFile(std::string& path) ORTHANC_OVERRIDE;
   };
 }
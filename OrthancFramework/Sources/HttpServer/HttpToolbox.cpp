@@ -25,6 +25,8 @@
 #include "../PrecompiledHeaders.h"
 #include "HttpToolbox.h"
 
+#include "../OrthancException.h"
+
 #include <string.h>
 
 #if (ORTHANC_ENABLE_MONGOOSE == 1 || ORTHANC_ENABLE_CIVETWEB == 1)
@@ -190,6 +192,108 @@ namespace Orthanc
   }
 
 
+  static bool ParseByteRangeValue(uint64_t& target,
+                                  const std::string& value)
+  {
+    if (value.empty() ||
+        value.size() > 19 /* avoid overflows */)
+    {
+      return false;
+    }
+
+    target = 0;
+    for (size_t i = 0; i < value.size(); i++)
+    {
+      if (value[i] < '0' ||
+          value[i] > '9')
+      {
+        return false;
+      }
+
+      target = target * 10 + static_cast<uint64_t>(value[i] - '0');
+    }
+
+    return true;
+  }
+
+
+  bool HttpToolbox::ParseByteRange(uint64_t& start,
+                                   uint64_t& end,
+                                   const std::string& header,
+                                   uint64_t resourceSize)
+  {
+    const std::string range = Toolbox::StripSpaces(header);
+
+    if (!Toolbox::StartsWith(range, "bytes=") ||
+        range.find(',') != std::string::npos  /* multiple ranges are not supported */)
+    {
+      return false;
+    }
+
+    const size_t dash = range.find('-', 6);
+    if (dash == std::string::npos)
+    {
+      return false;
+    }
+
+    const std::string first = Toolbox::StripSpaces(range.substr(6, dash - 6));
+    const std::string last = Toolbox::StripSpaces(range.substr(dash + 1));
+
+    if (first.empty())
+    {
+      // Suffix range: "bytes=-500" stands for the last 500 bytes
+      uint64_t suffix;
+      if (!ParseByteRangeValue(suffix, last))
+      {
+        return false;
+      }
+
+      if (suffix == 0 ||
+          resourceSize == 0)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "Unsatisfiable range: " + header)
+          .SetHttpStatus(HttpStatus_416_RequestedRangeNotSatisfiable);
+      }
+
+      start = (suffix >= resourceSize ? 0 : resourceSize - suffix);
+      end = resourceSize - 1;
+      return true;
+    }
+    else
+    {
+      if (!ParseByteRangeValue(start, first))
+      {
+        return false;
+      }
+
+      if (last.empty())
+      {
+        end = resourceSize - 1;  // Open range: "bytes=500-"
+      }
+      else if (!ParseByteRangeValue(end, last))
+      {
+        return false;
+      }
+      else if (end < start)
+      {
+        return false;  // Syntactically invalid, must be ignored
+      }
+      else if (end >= resourceSize)
+      {
+        end = resourceSize - 1;
+      }
+
+      if (start >= resourceSize)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "Unsatisfiable range: " + header)
+          .SetHttpStatus(HttpStatus_416_RequestedRangeNotSatisfiable);
+      }
+
+      return true;
+    }
+  }
+
+
 
 #if (ORTHANC_ENABLE_MONGOOSE == 1 || ORTHANC_ENABLE_CIVETWEB == 1)
   bool HttpToolbox::SimpleGet(std::string& result,
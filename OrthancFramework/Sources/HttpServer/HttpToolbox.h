@@ -63,6 +63,19 @@ namespace Orthanc
     static void CompileGetArguments(Arguments& compiled,
                                     const GetArguments& source);
 
+    /**
+     * Parses the value of a "Range" HTTP header that contains a single
+     * range of bytes (RFC 7233), given the size of the resource. The
+     * "end" is inclusive. Returns "false" if the header must be
+     * ignored, in which case the full resource is sent. Throws with
+     * status 416 if the range cannot be satisfied. New in Orthanc
+     * 1.12.12.
+     **/
+    static bool ParseByteRange(uint64_t& start,
+                               uint64_t& end,
+                               const std::string& header,
+                               uint64_t resourceSize);
+
 #if (ORTHANC_ENABLE_MONGOOSE == 1 || ORTHANC_ENABLE_CIVETWEB == 1)
     ORTHANC_DEPRECATED(static bool SimpleGet(std::string& result,
                                              IHttpHandler& handler,
@@ -45,5 +45,12 @@ namespace Orthanc
     // Disable HTTP keep alive for this single HTTP connection. Must
     // be called before sending the "HTTP/1.1 200 OK" header.
     virtual void DisableKeepAlive() = 0;
+
+    // Zero-copy transmission of the whole content of a file of the
+    // local filesystem (new in Orthanc 1.12.12). "SendFile()" must
+    // only be called if "IsSendFileSupported()" returns "true".
+    virtual bool IsSendFileSupported() const = 0;
+
+    virtual void SendFile(const std::string& path) = 0;
   };
 }
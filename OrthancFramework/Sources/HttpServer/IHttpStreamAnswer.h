@@ -54,5 +54,10 @@ namespace Orthanc
     virtual const char* GetChunkContent() = 0;
 
     virtual size_t GetChunkSize() = 0;
+
+    // Returns "true" iff the body is the whole content of a file of
+    // the local filesystem, which can then be sent without calling
+    // "ReadNextChunk()" (new in Orthanc 1.12.12)
+    virtual bool LookupLocalFile(std::string& path) = 0;
   };
 }
@@ -82,6 +82,14 @@ namespace Orthanc
   }
 
 
+  void IWebDavBucket::Resource::CopyTimes(const Resource& source)
+  {
+    hasModificationTime_ = source.hasModificationTime_;
+    creationTime_ = source.creationTime_;
+    modificationTime_ = source.modificationTime_;
+  }
+
+
   void IWebDavBucket::Resource::SetCreationTime(const boost::posix_time::ptime& t)
   {
     if (t.is_special())
@@ -208,6 +216,17 @@ namespace Orthanc
   }
 
 
+  IWebDavBucket::Resource* IWebDavBucket::File::Clone() const
+  {
+    std::unique_ptr<File> f(new File(GetDisplayName()));
+    f->CopyTimes(*this);
+    f->hasContentLength_ = hasContentLength_;
+    f->contentLength_ = contentLength_;
+    f->mime_ = mime_;
+    return f.release();
+  }
+
+
   void IWebDavBucket::Folder::Format(pugi::xml_node& node,
                                      const std::string& parentPath) const
   {
@@ -229,6 +248,14 @@ namespace Orthanc
   }
 
 
+  IWebDavBucket::Resource* IWebDavBucket::Folder::Clone() const
+  {
+    std::unique_ptr<Folder> f(new Folder(GetDisplayName()));
+    f->CopyTimes(*this);
+    return f.release();
+  }
+
+
   IWebDavBucket::Collection::~Collection()
   {
     for (std::list<Resource*>::iterator it = resources_.begin(); it != resources_.end(); ++it)
@@ -252,6 +279,16 @@ namespace Orthanc
   }
 
 
+  void IWebDavBucket::Collection::CopyTo(Collection& target) const
+  {
+    for (std::list<Resource*>::const_iterator it = resources_.begin(); it != resources_.end(); ++it)
+    {
+      assert(*it != NULL);
+      target.AddResource((*it)->Clone());
+    }
+  }
+
+
   void IWebDavBucket::Collection::ListDisplayNames(std::set<std::string>& target)
   {
     for (std::list<Resource*>::iterator it = resources_.begin(); it != resources_.end(); ++it)
@@ -387,4 +424,22 @@ namespace Orthanc
   {
     output.SendStatus(HttpStatus_204_NoContent);
   }
+
+
+  bool IWebDavBucket::GetFileInfo(MimeType& mime,
+                                  uint64_t& contentLength,
+                                  boost::posix_time::ptime& modificationTime,
+                                  const std::vector<std::string>& path)
+  {
+    std::string content;
+    if (GetFileContent(mime, content, modificationTime, path))
+    {
+      contentLength = content.size();
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
 }
@@ -58,6 +58,9 @@ namespace Orthanc
       boost::posix_time::ptime  creationTime_;
       boost::posix_time::ptime  modificationTime_;
 
+    protected:
+      void CopyTimes(const Resource& source);
+
     public:
       explicit Resource(const std::string& displayName);
 
@@ -86,6 +89,9 @@ namespace Orthanc
 
       virtual void Format(pugi::xml_node& node,
                           const std::string& parentPath) const = 0;
+
+      // New in Orthanc 1.12.12
+      virtual Resource* Clone() const = 0;
     };
 
 
@@ -118,6 +124,8 @@ namespace Orthanc
 
       virtual void Format(pugi::xml_node& node,
                           const std::string& parentPath) const ORTHANC_OVERRIDE;
+
+      virtual Resource* Clone() const ORTHANC_OVERRIDE;
     };
 
 
@@ -131,6 +139,8 @@ namespace Orthanc
       
       virtual void Format(pugi::xml_node& node,
                           const std::string& parentPath) const ORTHANC_OVERRIDE;
+
+      virtual Resource* Clone() const ORTHANC_OVERRIDE;
     };
 
 
@@ -151,6 +161,9 @@ namespace Orthanc
 
       void AddResource(Resource* resource);  // Takes ownership
 
+      // Appends a deep copy of the resources to "target" (new in Orthanc 1.12.12)
+      void CopyTo(Collection& target) const;
+
       void Format(std::string& target,
                   const std::string& parentPath) const;
     };
@@ -170,6 +183,17 @@ namespace Orthanc
                                 boost::posix_time::ptime& modificationTime, 
                                 const std::vector<std::string>& path) = 0;
 
+    /**
+     * Returns the size of a file without necessarily reading its
+     * content, which is used to answer PROPFIND requests (new in
+     * Orthanc 1.12.12). The default implementation reads the full
+     * content using "GetFileContent()".
+     **/
+    virtual bool GetFileInfo(MimeType& mime,
+                             uint64_t& contentLength,
+                             boost::posix_time::ptime& modificationTime,
+                             const std::vector<std::string>& path);
+
     // "false" returns indicate a read-only target
     virtual bool StoreFile(const std::string& content,
                            const std::vector<std::string>& path) = 0;
@@ -64,6 +64,12 @@ namespace Orthanc
     }
   }
 
+
+  void StringHttpOutput::SendFile(const std::string& path)
+  {
+    throw OrthancException(ErrorCode_NotImplemented);
+  }
+
   
   void StringHttpOutput::GetBody(std::string& output)
   {
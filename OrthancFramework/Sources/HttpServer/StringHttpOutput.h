@@ -57,6 +57,13 @@ namespace Orthanc
     {
     }
 
+    virtual bool IsSendFileSupported() const ORTHANC_OVERRIDE
+    {
+      return false;
+    }
+
+    virtual void SendFile(const std::string& path) ORTHANC_OVERRIDE;
+
     HttpStatus GetStatus() const
     {
       return status_;
@@ -25,11 +25,11 @@
 #include "../PrecompiledHeaders.h"
 #include "ImageBuffer.h"
 
+#include "ImageBufferPool.h"
 #include "../OrthancException.h"
 
 #include <boost/lexical_cast.hpp>
 #include <stdio.h>
-#include <stdlib.h>
 
 namespace Orthanc
 {
@@ -63,8 +63,11 @@ namespace Orthanc
       }
       else
       {
-        buffer_ = malloc(static_cast<size_t>(size));
-        if (buffer_ == NULL)
+        try
+        {
+          buffer_ = ImageBufferPool::Allocate(capacity_, static_cast<size_t>(size));
+        }
+        catch (OrthancException&)
         {
           throw OrthancException(ErrorCode_NotEnoughMemory,
                                  "Failed to allocate an image buffer of size " + boost::lexical_cast<std::string>(width_) + "x" + boost::lexical_cast<std::string>(height_));
@@ -80,8 +83,9 @@ namespace Orthanc
   {
     if (buffer_ != NULL)
     {
-      free(buffer_);
+      ImageBufferPool::Release(buffer_, capacity_);
       buffer_ = NULL;
+      capacity_ = 0;
       changed_ = true;
     }
   }
@@ -124,6 +128,7 @@ namespace Orthanc
     height_ = 0;
     pitch_ = 0;
     buffer_ = NULL;
+    capacity_ = 0;
   }
 
 
@@ -208,6 +213,7 @@ namespace Orthanc
     height_ = other.height_;
     pitch_ = other.pitch_;
     buffer_ = other.buffer_;
+    capacity_ = other.capacity_;
 
     // Force the reinitialization of the other image
     other.Initialize();
@@ -43,6 +43,7 @@ namespace Orthanc
     unsigned int height_;
     unsigned int pitch_;
     void *buffer_;
+    size_t capacity_;  // Returned by "ImageBufferPool::Allocate()"
 
     void Initialize();
     
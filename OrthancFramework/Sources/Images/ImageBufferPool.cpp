@@ -0,0 +1,271 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ImageBufferPool.h"
+
+#include "../OrthancException.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cassert>
+#include <limits>
+#include <map>
+#include <stdlib.h>
+#include <vector>
+
+#if ORTHANC_SANDBOXED != 1
+#  include <boost/thread/mutex.hpp>
+#endif
+
+
+namespace Orthanc
+{
+  namespace
+  {
+    class PoolState : public boost::noncopyable
+    {
+    public:
+      typedef std::map<size_t, std::vector<void*> >  Buffers;
+
+#if ORTHANC_SANDBOXED != 1
+      boost::mutex     mutex_;
+#endif
+      uint64_t         maximumSize_;
+      uint64_t         unusedSize_;
+      size_t           countUnused_;
+      Buffers          unused_;  // Indexed by capacity
+      CacheStatistics  statistics_;
+
+      PoolState() :
+        maximumSize_(0),
+        unusedSize_(0),
+        countUnused_(0)
+      {
+      }
+
+      // Frees the unused buffers of the largest classes, until the
+      // unused size fits under "target"
+      void Shrink(uint64_t target)
+      {
+        while (unusedSize_ > target)
+        {
+          assert(!unused_.empty());
+
+          Buffers::iterator largest = unused_.end();
+          --largest;
+
+          assert(!largest->second.empty());
+          free(largest->second.back());
+          largest->second.pop_back();
+
+          unusedSize_ -= largest->first;
+          countUnused_--;
+          statistics_.AddEviction();
+
+          if (largest->second.empty())
+          {
+            unused_.erase(largest);
+          }
+        }
+      }
+    };
+
+
+    // This object is never destroyed, as some images might be
+    // released during the destruction of the static objects
+    PoolState& GetPoolState()
+    {
+      static PoolState* state = new PoolState;
+      return *state;
+    }
+  }
+
+
+#if ORTHANC_SANDBOXED != 1
+#  define ORTHANC_POOL_LOCK(state)  boost::mutex::scoped_lock lock((state).mutex_)
+#else
+#  define ORTHANC_POOL_LOCK(state)
+#endif
+
+
+  size_t ImageBufferPool::GetCapacity(size_t size)
+  {
+    if (size < MINIMUM_POOLED_SIZE)
+    {
+      return size;
+    }
+
+    // Position of the highest bit of "size - 1"
+    unsigned int highest = 0;
+    for (size_t s = size - 1; s > 1; s >>= 1)
+    {
+      highest++;
+    }
+
+    // Four classes between two consecutive powers of two ("highest"
+    // is at least 16, given the minimum size)
+    const size_t step = static_cast<size_t>(1) << (highest - 2);
+
+    if (size > std::numeric_limits<size_t>::max() - step)
+    {
+      return size;
+    }
+    else
+    {
+      return (size + step - 1) / step * step;
+    }
+  }
+
+
+  void ImageBufferPool::SetMaximumSize(uint64_t size)
+  {
+    PoolState& state = GetPoolState();
+    ORTHANC_POOL_LOCK(state);
+    state.maximumSize_ = size;
+    state.Shrink(size);
+  }
+
+
+  uint64_t ImageBufferPool::GetMaximumSize()
+  {
+    PoolState& state = GetPoolState();
+    ORTHANC_POOL_LOCK(state);
+    return state.maximumSize_;
+  }
+
+
+  void* ImageBufferPool::Allocate(size_t& capacity,
+                                  size_t size)
+  {
+    if (size == 0)
+    {
+      capacity = 0;
+      return NULL;
+    }
+
+    void* buffer = NULL;
+
+    if (size >= MINIMUM_POOLED_SIZE)
+    {
+      capacity = GetCapacity(size);
+
+      PoolState& state = GetPoolState();
+      ORTHANC_POOL_LOCK(state);
+
+      if (state.maximumSize_ != 0)
+      {
+        PoolState::Buffers::iterator found = state.unused_.find(capacity);
+
+        if (found == state.unused_.end())
+        {
+          state.statistics_.AddMiss();
+        }
+        else
+        {
+          assert(!found->second.empty());
+          buffer = found->second.back();
+          found->second.pop_back();
+
+          state.unusedSize_ -= capacity;
+          state.countUnused_--;
+          state.statistics_.AddHit();
+
+          if (found->second.empty())
+          {
+            state.unused_.erase(found);
+          }
+        }
+      }
+    }
+    else
+    {
+      capacity = size;
+    }
+
+    if (buffer == NULL)
+    {
+      buffer = malloc(capacity);
+    }
+
+    if (buffer == NULL)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory,
+                             "Failed to allocate an image buffer of " + boost::lexical_cast<std::string>(size) + " bytes");
+    }
+
+    return buffer;
+  }
+
+
+  void ImageBufferPool::Release(void* buffer,
+                                size_t capacity)
+  {
+    if (buffer == NULL)
+    {
+      return;
+    }
+
+    if (capacity >= MINIMUM_POOLED_SIZE &&
+        capacity == GetCapacity(capacity))
+    {
+      PoolState& state = GetPoolState();
+      ORTHANC_POOL_LOCK(state);
+
+      if (state.unusedSize_ + capacity <= state.maximumSize_)
+      {
+        state.unused_[capacity].push_back(buffer);
+        state.unusedSize_ += capacity;
+        state.countUnused_++;
+        return;
+      }
+      else if (state.maximumSize_ != 0)
+      {
+        state.statistics_.AddEviction();
+      }
+    }
+
+    free(buffer);
+  }
+
+
+  void ImageBufferPool::Clear()
+  {
+    PoolState& state = GetPoolState();
+    ORTHANC_POOL_LOCK(state);
+    state.Shrink(0);
+  }
+
+
+  void ImageBufferPool::GetStatistics(CacheStatistics& statistics,
+                                      size_t& countUnused,
+                                      uint64_t& unusedSize)
+  {
+    PoolState& state = GetPoolState();
+    ORTHANC_POOL_LOCK(state);
+    statistics = state.statistics_;
+    countUnused = state.countUnused_;
+    unusedSize = state.unusedSize_;
+  }
+}
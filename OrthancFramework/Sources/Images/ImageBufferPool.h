@@ -0,0 +1,78 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Cache/CacheStatistics.h"
+
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Orthanc
+{
+  /**
+   * Pool of the pixel buffers of the images, by classes of sizes (new
+   * in Orthanc 1.12.12). The large buffers that are released by
+   * "ImageBuffer" are kept for the next images of the same class,
+   * instead of being returned to "malloc()": Allocating and freeing
+   * buffers of several MB at a high rate (e.g. in "/rendered")
+   * fragments the arenas of glibc. The classes are spaced by a quarter
+   * of a power of two, which wastes at most 25% of the capacity.
+   *
+   * The pool is disabled as long as its maximum size is zero, which
+   * is the default. The maximum size only bounds the buffers that are
+   * currently unused, i.e. waiting for their next image.
+   **/
+  class ORTHANC_PUBLIC ImageBufferPool : public boost::noncopyable
+  {
+  public:
+    // Below this size, the buffers are directly allocated by "malloc()"
+    static const size_t MINIMUM_POOLED_SIZE = 64 * 1024;
+
+    // Setting a smaller size frees the unused buffers that exceed it
+    static void SetMaximumSize(uint64_t size);
+
+    static uint64_t GetMaximumSize();
+
+    // Returns the capacity of the buffer in "capacity", which must be
+    // provided to "Release()". Throws if out of memory.
+    static void* Allocate(size_t& capacity,
+                          size_t size);
+
+    static void Release(void* buffer,
+                        size_t capacity);
+
+    // Frees all the unused buffers
+    static void Clear();
+
+    static void GetStatistics(CacheStatistics& statistics,
+                              size_t& countUnused,
+                              uint64_t& unusedSize);
+
+    // Exposed for the unit tests
+    static size_t GetCapacity(size_t size);
+  };
+}
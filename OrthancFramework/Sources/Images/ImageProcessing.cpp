@@ -40,6 +40,22 @@
 #include <stdint.h>
 #include <string.h>
 
+#if ORTHANC_SANDBOXED != 1
+#  include "../MultiThreading/IExecutorService.h"
+#  include <boost/thread/condition_variable.hpp>
+#  include <boost/thread/mutex.hpp>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+// SSE2 is part of the baseline of x86-64, and the scalar floating-point
+// operations use the same SSE registers, which makes the vectorized
+// kernels bit-exact with respect to the scalar code
+#  define ORTHANC_IMAGE_PROCESSING_SSE2 1
+#  include <emmintrin.h>
+#else
+#  define ORTHANC_IMAGE_PROCESSING_SSE2 0
+#endif
+
 namespace Orthanc
 {
   ImageProcessing::ImagePoint::ImagePoint(int32_t x,
@@ -83,6 +99,495 @@ namespace Orthanc
     return std::abs(a * static_cast<double>(GetX()) + b * static_cast<double>(GetY()) + c) / pow(a * a + b * b, 0.5);
   }
 
+  namespace
+  {
+    // Processes the rows in the range [firstRow, lastRow) of an image
+    class IRowBandsProcessor : public boost::noncopyable
+    {
+    public:
+      virtual ~IRowBandsProcessor()
+      {
+      }
+
+      virtual void Process(unsigned int firstRow,
+                           unsigned int lastRow) = 0;
+    };
+  }
+
+
+#if ORTHANC_SANDBOXED == 1
+  void ImageProcessing::SetParallelExecutor(const boost::shared_ptr<IExecutorService>& executor,
+                                            unsigned int countThreads)
+  {
+    throw OrthancException(ErrorCode_NotImplemented, "No thread in sandboxed environments");
+  }
+
+
+  static void ProcessRowBands(IRowBandsProcessor& processor,
+                              unsigned int height,
+                              uint64_t countPixels)
+  {
+    processor.Process(0, height);
+  }
+
+#else
+
+  // Below this number of pixels, the overhead of the threads
+  // outweighs the gain of the parallel processing
+  static const uint64_t PARALLEL_MINIMUM_PIXELS = 1024 * 1024;
+
+  static boost::mutex                         parallelExecutorMutex_;
+  static boost::shared_ptr<IExecutorService>  parallelExecutor_;
+  static unsigned int                         parallelThreads_ = 0;
+
+
+  namespace
+  {
+    /**
+     * The bands are claimed one after the other, both by the calling
+     * thread and by the workers of the pool. A worker that starts
+     * once all the bands are claimed does nothing: The calling thread
+     * thus never waits for workers that are still queued in a busy
+     * (or stopped) pool.
+     **/
+    class RowBands : public boost::noncopyable
+    {
+    private:
+      boost::mutex                       mutex_;
+      boost::condition_variable          completed_;
+      IRowBandsProcessor&                processor_;  // Only accessed while a band is claimed
+      unsigned int                       height_;
+      unsigned int                       countBands_;
+      unsigned int                       nextBand_;
+      unsigned int                       running_;
+      std::unique_ptr<OrthancException>  error_;
+
+      bool Claim(unsigned int& firstRow,
+                 unsigned int& lastRow)
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (error_.get() != NULL ||
+            nextBand_ == countBands_)
+        {
+          return false;
+        }
+        else
+        {
+          firstRow = static_cast<unsigned int>(static_cast<uint64_t>(height_) * nextBand_ / countBands_);
+          nextBand_++;
+          lastRow = static_cast<unsigned int>(static_cast<uint64_t>(height_) * nextBand_ / countBands_);
+          running_++;
+          return true;
+        }
+      }
+
+      void Complete(const OrthancException* error)
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (error != NULL &&
+            error_.get() == NULL)
+        {
+          error_.reset(new OrthancException(*error));
+        }
+
+        assert(running_ > 0);
+        running_--;
+        completed_.notify_all();
+      }
+
+    public:
+      RowBands(IRowBandsProcessor& processor,
+               unsigned int height,
+               unsigned int countBands) :
+        processor_(processor),
+        height_(height),
+        countBands_(countBands),
+        nextBand_(0),
+        running_(0)
+      {
+        assert(countBands_ > 0 &&
+               countBands_ <= height_);
+      }
+
+      void Work()
+      {
+        unsigned int firstRow, lastRow;
+
+        while (Claim(firstRow, lastRow))
+        {
+          try
+          {
+            processor_.Process(firstRow, lastRow);
+            Complete(NULL);
+          }
+          catch (OrthancException& e)
+          {
+            Complete(&e);
+          }
+          catch (std::bad_alloc&)
+          {
+            OrthancException e(ErrorCode_NotEnoughMemory);
+            Complete(&e);
+          }
+          catch (...)
+          {
+            OrthancException e(ErrorCode_InternalError);
+            Complete(&e);
+          }
+        }
+      }
+
+      void Wait()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        while (running_ > 0)
+        {
+          completed_.wait(lock);
+        }
+
+        if (error_.get() != NULL)
+        {
+          throw OrthancException(*error_);
+        }
+      }
+    };
+
+
+    class RowBandsWorker : public IRunnable
+    {
+    private:
+      boost::shared_ptr<RowBands>  bands_;
+
+    public:
+      explicit RowBandsWorker(const boost::shared_ptr<RowBands>& bands) :
+        bands_(bands)
+      {
+      }
+
+      virtual void Run() ORTHANC_OVERRIDE
+      {
+        bands_->Work();
+      }
+    };
+  }
+
+
+  void ImageProcessing::SetParallelExecutor(const boost::shared_ptr<IExecutorService>& executor,
+                                            unsigned int countThreads)
+  {
+    boost::mutex::scoped_lock lock(parallelExecutorMutex_);
+    parallelExecutor_ = executor;
+    parallelThreads_ = (executor.get() == NULL ? 0 : countThreads);
+  }
+
+
+  static void ProcessRowBands(IRowBandsProcessor& processor,
+                              unsigned int height,
+                              uint64_t countPixels)
+  {
+    boost::shared_ptr<IExecutorService> executor;
+    unsigned int countThreads;
+
+    {
+      boost::mutex::scoped_lock lock(parallelExecutorMutex_);
+      executor = parallelExecutor_;
+      countThreads = parallelThreads_;
+    }
+
+    if (executor.get() == NULL ||
+        countThreads == 0 ||
+        height < 2 ||
+        countPixels < PARALLEL_MINIMUM_PIXELS)
+    {
+      processor.Process(0, height);
+      return;
+    }
+
+    // Several bands per thread, in order to balance the load
+    const unsigned int countBands = std::min(height, 4 * (countThreads + 1));
+
+    boost::shared_ptr<RowBands> bands(new RowBands(processor, height, countBands));
+
+    for (unsigned int i = 0; i < countThreads; i++)
+    {
+      try
+      {
+        executor->Submit(new RowBandsWorker(bands));
+      }
+      catch (OrthancException&)
+      {
+        break;  // The pool is stopped: The calling thread processes the remaining bands
+      }
+    }
+
+    bands->Work();
+    bands->Wait();
+  }
+#endif
+
+
+  /**
+   * Vectorized kernels for the hot paths of the rendering. Each of
+   * them processes the first pixels of a row, and returns their
+   * number, the remaining pixels being processed by the scalar
+   * code. The default implementations process no pixel.
+   **/
+  template <typename TargetType, typename SourceType>
+  struct ConvertAccelerator
+  {
+    static unsigned int Apply(TargetType* target,
+                              const SourceType* source,
+                              unsigned int width)
+    {
+      return 0;
+    }
+  };
+
+  template <typename TargetType, typename SourceType, bool UseRound, bool Invert>
+  struct ShiftScaleAccelerator
+  {
+    static unsigned int Apply(TargetType* target,
+                              const SourceType* source,
+                              unsigned int width,
+                              float a,
+                              float b)
+    {
+      return 0;
+    }
+  };
+
+  template <typename PixelType>
+  struct MinMaxAccelerator
+  {
+    static unsigned int Apply(PixelType& minValue,
+                              PixelType& maxValue,
+                              const PixelType* row,
+                              unsigned int width)
+    {
+      return 0;
+    }
+  };
+
+
+#if ORTHANC_IMAGE_PROCESSING_SSE2 == 1
+  template <>
+  struct ConvertAccelerator<uint8_t, uint16_t>
+  {
+    static unsigned int Apply(uint8_t* target,
+                              const uint16_t* source,
+                              unsigned int width)
+    {
+      // "_mm_packus_epi16()" saturates signed integers: Clamp to 255 first
+      const __m128i maxValue = _mm_set1_epi16(255);
+
+      unsigned int x = 0;
+      for (; x + 16 <= width; x += 16)
+      {
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+        __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x + 8));
+        v1 = _mm_sub_epi16(v1, _mm_subs_epu16(v1, maxValue));
+        v2 = _mm_sub_epi16(v2, _mm_subs_epu16(v2, maxValue));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + x), _mm_packus_epi16(v1, v2));
+      }
+
+      return x;
+    }
+  };
+
+  template <>
+  struct ConvertAccelerator<uint8_t, int16_t>
+  {
+    static unsigned int Apply(uint8_t* target,
+                              const int16_t* source,
+                              unsigned int width)
+    {
+      unsigned int x = 0;
+      for (; x + 16 <= width; x += 16)
+      {
+        const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+        const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + x), _mm_packus_epi16(v1, v2));
+      }
+
+      return x;
+    }
+  };
+
+
+  // Converts 8 consecutive pixels to 2 vectors of 4 floats
+  static inline void LoadFloat8(__m128& low,
+                                __m128& high,
+                                const uint8_t* source)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source)), zero);
+    low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+    high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));
+  }
+
+  static inline void LoadFloat8(__m128& low,
+                                __m128& high,
+                                const uint16_t* source)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+    low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+    high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));
+  }
+
+  static inline void LoadFloat8(__m128& low,
+                                __m128& high,
+                                const int16_t* source)
+  {
+    // Sign extension, by duplicating each value in the high word
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+    low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+    high = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+  }
+
+  static inline void LoadFloat8(__m128& low,
+                                __m128& high,
+                                const float* source)
+  {
+    low = _mm_loadu_ps(source);
+    high = _mm_loadu_ps(source + 4);
+  }
+
+
+  // Same as the scalar code: The clamping to [0, 255] followed by a
+  // truncation is the same as "std::floor()" on the clamped values
+  static inline __m128i ShiftScaleToInt32(__m128 v,
+                                          __m128 a,
+                                          __m128 b)
+  {
+    v = _mm_add_ps(_mm_mul_ps(a, v), b);
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+    return _mm_cvttps_epi32(v);
+  }
+
+  template <typename SourceType>
+  struct ShiftScaleAccelerator<uint8_t, SourceType, false, false>
+  {
+    // This function can be applied inplace, as each block of pixels
+    // is read before being written
+    static unsigned int Apply(uint8_t* target,
+                              const SourceType* source,
+                              unsigned int width,
+                              float a,
+                              float b)
+    {
+      const __m128 va = _mm_set1_ps(a);
+      const __m128 vb = _mm_set1_ps(b);
+
+      unsigned int x = 0;
+      for (; x + 16 <= width; x += 16)
+      {
+        __m128 f1, f2, f3, f4;
+        LoadFloat8(f1, f2, source + x);
+        LoadFloat8(f3, f4, source + x + 8);
+
+        const __m128i low = _mm_packs_epi32(ShiftScaleToInt32(f1, va, vb), ShiftScaleToInt32(f2, va, vb));
+        const __m128i high = _mm_packs_epi32(ShiftScaleToInt32(f3, va, vb), ShiftScaleToInt32(f4, va, vb));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + x), _mm_packus_epi16(low, high));
+      }
+
+      return x;
+    }
+  };
+
+
+  // SSE2 only provides the minimum and the maximum of signed 16-bit
+  // integers: The unsigned integers are biased by 0x8000, which maps
+  // them onto the signed integers while preserving their order
+  static unsigned int GetMinMaxInt16(int16_t& minValue,
+                                     int16_t& maxValue,
+                                     const void* row,
+                                     unsigned int width,
+                                     uint16_t bias)
+  {
+    if (width < 8)
+    {
+      return 0;
+    }
+
+    const __m128i vbias = _mm_set1_epi16(static_cast<int16_t>(bias));
+    const __m128i* p = reinterpret_cast<const __m128i*>(row);
+
+    __m128i vmin = _mm_xor_si128(_mm_loadu_si128(p), vbias);
+    __m128i vmax = vmin;
+
+    unsigned int x = 8;
+    for (; x + 8 <= width; x += 8)
+    {
+      const __m128i v = _mm_xor_si128(_mm_loadu_si128(p + x / 8), vbias);
+      vmin = _mm_min_epi16(vmin, v);
+      vmax = _mm_max_epi16(vmax, v);
+    }
+
+    int16_t mins[8], maxs[8];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(mins), vmin);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(maxs), vmax);
+
+    minValue = mins[0];
+    maxValue = maxs[0];
+
+    for (unsigned int i = 1; i < 8; i++)
+    {
+      minValue = std::min(minValue, mins[i]);
+      maxValue = std::max(maxValue, maxs[i]);
+    }
+
+    minValue = static_cast<int16_t>(static_cast<uint16_t>(minValue) ^ bias);
+    maxValue = static_cast<int16_t>(static_cast<uint16_t>(maxValue) ^ bias);
+
+    return x;
+  }
+
+  template <>
+  struct MinMaxAccelerator<uint16_t>
+  {
+    static unsigned int Apply(uint16_t& minValue,
+                              uint16_t& maxValue,
+                              const uint16_t* row,
+                              unsigned int width)
+    {
+      int16_t a, b;
+      const unsigned int x = GetMinMaxInt16(a, b, row, width, 0x8000);
+      if (x != 0)
+      {
+        minValue = std::min(minValue, static_cast<uint16_t>(a));
+        maxValue = std::max(maxValue, static_cast<uint16_t>(b));
+      }
+
+      return x;
+    }
+  };
+
+  template <>
+  struct MinMaxAccelerator<int16_t>
+  {
+    static unsigned int Apply(int16_t& minValue,
+                              int16_t& maxValue,
+                              const int16_t* row,
+                              unsigned int width)
+    {
+      int16_t a, b;
+      const unsigned int x = GetMinMaxInt16(a, b, row, width, 0);
+      if (x != 0)
+      {
+        minValue = std::min(minValue, a);
+        maxValue = std::max(maxValue, b);
+      }
+
+      return x;
+    }
+  };
+#endif
+
+
   template <typename TargetType, typename SourceType>
   static void ConvertInternal(ImageAccessor& target,
                               const ImageAccessor& source)
@@ -101,7 +606,11 @@ namespace Orthanc
       TargetType* t = reinterpret_cast<TargetType*>(target.GetRow(y));
       const SourceType* s = reinterpret_cast<const SourceType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < width; x++, t++, s++)
+      unsigned int x = ConvertAccelerator<TargetType, SourceType>::Apply(t, s, width);
+      t += x;
+      s += x;
+
+      for (; x < width; x++, t++, s++)
       {
         if (static_cast<int32_t>(*s) < static_cast<int32_t>(minValue))
         {
@@ -282,7 +791,10 @@ namespace Orthanc
     {
       const PixelType* p = reinterpret_cast<const PixelType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < width; x++, p++)
+      unsigned int x = MinMaxAccelerator<PixelType>::Apply(minValue, maxValue, p, width);
+      p += x;
+
+      for (; x < width; x++, p++)
       {
         if (*p < minValue)
         {
@@ -437,7 +949,11 @@ namespace Orthanc
       TargetType* p = reinterpret_cast<TargetType*>(target.GetRow(y));
       const SourceType* q = reinterpret_cast<const SourceType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < width; x++, p++, q++)
+      unsigned int x = ShiftScaleAccelerator<TargetType, SourceType, UseRound, Invert>::Apply(p, q, width, a, b);
+      p += x;
+      q += x;
+
+      for (; x < width; x++, p++, q++)
       {
         float v = a * static_cast<float>(*q) + b;
 
@@ -661,24 +1177,15 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::Convert(ImageAccessor& target,
+  static void ConvertSequential(ImageAccessor& target,
                                 const ImageAccessor& source)
   {
-    if (target.GetWidth() != source.GetWidth() ||
-        target.GetHeight() != source.GetHeight())
-    {
-      throw OrthancException(ErrorCode_IncompatibleImageSize);
-    }
+    assert(target.GetWidth() == source.GetWidth() &&
+           target.GetHeight() == source.GetHeight());
 
     const unsigned int width = source.GetWidth();
     const unsigned int height = source.GetHeight();
 
-    if (source.GetFormat() == target.GetFormat())
-    {
-      Copy(target, source);
-      return;
-    }
-
     if (target.GetFormat() == PixelFormat_Grayscale16 &&
         source.GetFormat() == PixelFormat_Grayscale8)
     {
@@ -1072,6 +1579,56 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    class ConvertBands : public IRowBandsProcessor
+    {
+    private:
+      ImageAccessor&        target_;
+      const ImageAccessor&  source_;
+
+    public:
+      ConvertBands(ImageAccessor& target,
+                   const ImageAccessor& source) :
+        target_(target),
+        source_(source)
+      {
+      }
+
+      virtual void Process(unsigned int firstRow,
+                           unsigned int lastRow) ORTHANC_OVERRIDE
+      {
+        ImageAccessor target, source;
+        target_.GetRegion(target, 0, firstRow, target_.GetWidth(), lastRow - firstRow);
+        source_.GetRegion(source, 0, firstRow, source_.GetWidth(), lastRow - firstRow);
+        ConvertSequential(target, source);
+      }
+    };
+  }
+
+
+  void ImageProcessing::Convert(ImageAccessor& target,
+                                const ImageAccessor& source)
+  {
+    if (target.GetWidth() != source.GetWidth() ||
+        target.GetHeight() != source.GetHeight())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    if (source.GetFormat() == target.GetFormat())
+    {
+      Copy(target, source);
+    }
+    else
+    {
+      ConvertBands bands(target, source);
+      ProcessRowBands(bands, source.GetHeight(),
+                      static_cast<uint64_t>(source.GetWidth()) * static_cast<uint64_t>(source.GetHeight()));
+    }
+  }
+
+
 
   void ImageProcessing::Set(ImageAccessor& image,
                             int64_t value)
@@ -2366,30 +2923,21 @@ namespace Orthanc
   }
 
 
+  // Resizes the rows in the range [firstTargetY, lastTargetY) of the target
   template <PixelFormat Format>
-  static void ResizeInternal(ImageAccessor& target,
-                             const ImageAccessor& source)
+  static void ResizeRows(ImageAccessor& target,
+                         const ImageAccessor& source,
+                         unsigned int firstTargetY,
+                         unsigned int lastTargetY)
   {
-    assert(target.GetFormat() == source.GetFormat() &&
-           target.GetFormat() == Format);
-      
     const unsigned int sourceWidth = source.GetWidth();
     const unsigned int sourceHeight = source.GetHeight();
     const unsigned int targetWidth = target.GetWidth();
     const unsigned int targetHeight = target.GetHeight();
 
-    if (targetWidth == 0 || targetHeight == 0)
-    {
-      return;
-    }
+    assert(sourceWidth != 0 && sourceHeight != 0 &&
+           firstTargetY <= lastTargetY && lastTargetY <= targetHeight);
 
-    if (sourceWidth == 0 || sourceHeight == 0)
-    {
-      // Avoids division by zero below
-      ImageProcessing::Set(target, 0);
-      return;
-    }
-      
     const float scaleX = static_cast<float>(sourceWidth) / static_cast<float>(targetWidth);
     const float scaleY = static_cast<float>(sourceHeight) / static_cast<float>(targetHeight);
 
@@ -2419,7 +2967,7 @@ namespace Orthanc
       
     std::vector<unsigned int>  lookupY(targetHeight);
       
-    for (unsigned int y = 0; y < targetHeight; y++)
+    for (unsigned int y = firstTargetY; y < lastTargetY; y++)
     {
       int sourceY = static_cast<int>(std::floor((static_cast<float>(y) + 0.5f) * scaleY));
       if (sourceY < 0)
@@ -2439,7 +2987,7 @@ namespace Orthanc
      * Actual resizing
      **/
       
-    for (unsigned int targetY = 0; targetY < targetHeight; targetY++)
+    for (unsigned int targetY = firstTargetY; targetY < lastTargetY; targetY++)
     {
       unsigned int sourceY = lookupY[targetY];
 
@@ -2455,6 +3003,59 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    template <PixelFormat Format>
+    class ResizeBands : public IRowBandsProcessor
+    {
+    private:
+      ImageAccessor&        target_;
+      const ImageAccessor&  source_;
+
+    public:
+      ResizeBands(ImageAccessor& target,
+                  const ImageAccessor& source) :
+        target_(target),
+        source_(source)
+      {
+      }
+
+      virtual void Process(unsigned int firstRow,
+                           unsigned int lastRow) ORTHANC_OVERRIDE
+      {
+        ResizeRows<Format>(target_, source_, firstRow, lastRow);
+      }
+    };
+  }
+
+
+  template <PixelFormat Format>
+  static void ResizeInternal(ImageAccessor& target,
+                             const ImageAccessor& source)
+  {
+    assert(target.GetFormat() == source.GetFormat() &&
+           target.GetFormat() == Format);
+      
+    if (target.GetWidth() == 0 ||
+        target.GetHeight() == 0)
+    {
+      return;
+    }
+
+    if (source.GetWidth() == 0 ||
+        source.GetHeight() == 0)
+    {
+      // Avoids division by zero in "ResizeRows()"
+      ImageProcessing::Set(target, 0);
+      return;
+    }
+
+    ResizeBands<Format> bands(target, source);
+    ProcessRowBands(bands, target.GetHeight(),
+                    static_cast<uint64_t>(target.GetWidth()) * static_cast<uint64_t>(target.GetHeight()));
+  }
+
+
 
   void ImageProcessing::Resize(ImageAccessor& target,
                                const ImageAccessor& source)
@@ -2623,160 +3224,228 @@ namespace Orthanc
   
 
   
-  // This is an implementation of separable convolution that uses
-  // floating-point arithmetics, and an intermediate Float32
-  // image. The out-of-image values are taken as the border
-  // value. Further optimization is possible.
-  template <typename RawPixel, unsigned int ChannelsCount, bool UseRound>
-  static void SeparableConvolutionFloat(ImageAccessor& image /* inplace */,
-                                        const std::vector<float>& horizontal,
-                                        size_t horizontalAnchor,
-                                        const std::vector<float>& vertical,
-                                        size_t verticalAnchor,
-                                        float normalization)
+  namespace
   {
-    // WARNING - "::min()" should be replaced by "::lowest()" if
-    // dealing with float or double (which is not the case so far)
-    assert(sizeof(RawPixel) <= 2);  // Safeguard to remember about "float/double"
-
-    const unsigned int width = image.GetWidth();
-    const unsigned int height = image.GetHeight();
-    
-
-    /**
-     * Horizontal convolution
-     **/
-
-    Image tmp(PixelFormat_Float32, ChannelsCount * width, height, false);
-
-    for (unsigned int y = 0; y < height; y++)
+    template <typename RawPixel, unsigned int ChannelsCount>
+    class HorizontalConvolutionBands : public IRowBandsProcessor
     {
-      const RawPixel* row = reinterpret_cast<const RawPixel*>(image.GetConstRow(y));
+    private:
+      const ImageAccessor&       image_;
+      ImageAccessor&             tmp_;
+      const std::vector<float>&  horizontal_;
+      size_t                     horizontalAnchor_;
 
-      float leftBorder[ChannelsCount], rightBorder[ChannelsCount];
-      
-      for (unsigned int c = 0; c < ChannelsCount; c++)
+    public:
+      HorizontalConvolutionBands(const ImageAccessor& image,
+                                 ImageAccessor& tmp,
+                                 const std::vector<float>& horizontal,
+                                 size_t horizontalAnchor) :
+        image_(image),
+        tmp_(tmp),
+        horizontal_(horizontal),
+        horizontalAnchor_(horizontalAnchor)
       {
-        leftBorder[c] = row[c];
-        rightBorder[c] = row[ChannelsCount * (width - 1) + c];
       }
 
-      float* p = static_cast<float*>(tmp.GetRow(y));
-
-      if (width < horizontal.size())
-      {
-        // It is not possible to have the full kernel within the image, use the direct implementation
-        for (unsigned int x = 0; x < width; x++)
-        {
-          for (unsigned int c = 0; c < ChannelsCount; c++, p++)
-          {
-            *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
-              (image, horizontal, horizontalAnchor, x, y, leftBorder[c], rightBorder[c], c);
-          }
-        }
-      }
-      else
+      virtual void Process(unsigned int firstRow,
+                           unsigned int lastRow) ORTHANC_OVERRIDE
       {
-        // Deal with the left border
-        for (unsigned int x = 0; x < horizontalAnchor; x++)
+        const unsigned int width = image_.GetWidth();
+
+        for (unsigned int y = firstRow; y < lastRow; y++)
         {
-          for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+          const RawPixel* row = reinterpret_cast<const RawPixel*>(image_.GetConstRow(y));
+
+          float leftBorder[ChannelsCount], rightBorder[ChannelsCount];
+      
+          for (unsigned int c = 0; c < ChannelsCount; c++)
           {
-            *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
-              (image, horizontal, horizontalAnchor, x, y, leftBorder[c], rightBorder[c], c);
+            leftBorder[c] = row[c];
+            rightBorder[c] = row[ChannelsCount * (width - 1) + c];
           }
-        }
 
-        // Deal with the central portion of the image (all pixel values
-        // scanned by the kernel lie inside the image)
+          float* p = static_cast<float*>(tmp_.GetRow(y));
 
-        for (unsigned int x = 0; x < width - horizontal.size() + 1; x++)
-        {
-          for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+          if (width < horizontal_.size())
           {
-            *p = 0;
-            for (unsigned int k = 0; k < horizontal.size(); k++)
+            // It is not possible to have the full kernel within the image, use the direct implementation
+            for (unsigned int x = 0; x < width; x++)
             {
-              *p += static_cast<float>(row[(x + k) * ChannelsCount + c]) * horizontal[k];
+              for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+              {
+                *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
+                  (image_, horizontal_, horizontalAnchor_, x, y, leftBorder[c], rightBorder[c], c);
+              }
             }
           }
-        }
-
-        // Deal with the right border
-        for (unsigned int x = static_cast<unsigned int>(
-               horizontalAnchor + width - horizontal.size() + 1); x < width; x++)
-        {
-          for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+          else
           {
-            *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
-              (image, horizontal, horizontalAnchor, x, y, leftBorder[c], rightBorder[c], c);
+            // Deal with the left border
+            for (unsigned int x = 0; x < horizontalAnchor_; x++)
+            {
+              for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+              {
+                *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
+                  (image_, horizontal_, horizontalAnchor_, x, y, leftBorder[c], rightBorder[c], c);
+              }
+            }
+
+            // Deal with the central portion of the image (all pixel values
+            // scanned by the kernel lie inside the image)
+
+            for (unsigned int x = 0; x < width - horizontal_.size() + 1; x++)
+            {
+              for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+              {
+                *p = 0;
+                for (unsigned int k = 0; k < horizontal_.size(); k++)
+                {
+                  *p += static_cast<float>(row[(x + k) * ChannelsCount + c]) * horizontal_[k];
+                }
+              }
+            }
+
+            // Deal with the right border
+            for (unsigned int x = static_cast<unsigned int>(
+                   horizontalAnchor_ + width - horizontal_.size() + 1); x < width; x++)
+            {
+              for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+              {
+                *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
+                  (image_, horizontal_, horizontalAnchor_, x, y, leftBorder[c], rightBorder[c], c);
+              }
+            }
           }
         }
       }
-    }
-
-
-    /**
-     * Vertical convolution
-     **/
+    };
 
-    std::vector<const float*> rows(vertical.size());
 
-    for (unsigned int y = 0; y < height; y++)
+    template <typename RawPixel, unsigned int ChannelsCount, bool UseRound>
+    class VerticalConvolutionBands : public IRowBandsProcessor
     {
-      for (unsigned int k = 0; k < vertical.size(); k++)
+    private:
+      ImageAccessor&             image_;
+      const ImageAccessor&       tmp_;
+      const std::vector<float>&  vertical_;
+      size_t                     verticalAnchor_;
+      float                      normalization_;
+
+    public:
+      VerticalConvolutionBands(ImageAccessor& image,
+                               const ImageAccessor& tmp,
+                               const std::vector<float>& vertical,
+                               size_t verticalAnchor,
+                               float normalization) :
+        image_(image),
+        tmp_(tmp),
+        vertical_(vertical),
+        verticalAnchor_(verticalAnchor),
+        normalization_(normalization)
       {
-        if (y + k < verticalAnchor)
-        {
-          rows[k] = reinterpret_cast<const float*>(tmp.GetConstRow(0));   // Use top border
-        }
-        else if (y + k >= height + verticalAnchor)
-        {
-          rows[k] = reinterpret_cast<const float*>(tmp.GetConstRow(height - 1));  // Use bottom border
-        }
-        else
-        {
-          rows[k] = reinterpret_cast<const float*>(tmp.GetConstRow(static_cast<unsigned int>(y + k - verticalAnchor)));
-        }
       }
 
-      RawPixel* p = reinterpret_cast<RawPixel*>(image.GetRow(y));
-        
-      for (unsigned int x = 0; x < width; x++)
+      virtual void Process(unsigned int firstRow,
+                           unsigned int lastRow) ORTHANC_OVERRIDE
       {
-        for (unsigned int c = 0; c < ChannelsCount; c++, p++)
-        {
-          float accumulator = 0;
-        
-          for (unsigned int k = 0; k < vertical.size(); k++)
-          {
-            accumulator += rows[k][ChannelsCount * x + c] * vertical[k];
-          }
+        const unsigned int width = image_.GetWidth();
+        const unsigned int height = image_.GetHeight();
 
-          accumulator *= normalization;
+        std::vector<const float*> rows(vertical_.size());
 
-          if (accumulator <= static_cast<float>(std::numeric_limits<RawPixel>::min()))
-          {
-            *p = std::numeric_limits<RawPixel>::min();
-          }
-          else if (accumulator >= static_cast<float>(std::numeric_limits<RawPixel>::max()))
-          {
-            *p = std::numeric_limits<RawPixel>::max();
-          }
-          else
+        for (unsigned int y = firstRow; y < lastRow; y++)
+        {
+          for (unsigned int k = 0; k < vertical_.size(); k++)
           {
-            if (UseRound)
+            if (y + k < verticalAnchor_)
+            {
+              rows[k] = reinterpret_cast<const float*>(tmp_.GetConstRow(0));   // Use top border
+            }
+            else if (y + k >= height + verticalAnchor_)
             {
-              assert(sizeof(RawPixel) < sizeof(int));
-              *p = static_cast<RawPixel>(Math::iround(accumulator));
+              rows[k] = reinterpret_cast<const float*>(tmp_.GetConstRow(height - 1));  // Use bottom border
             }
             else
             {
-              *p = static_cast<RawPixel>(accumulator);
+              rows[k] = reinterpret_cast<const float*>(tmp_.GetConstRow(static_cast<unsigned int>(y + k - verticalAnchor_)));
+            }
+          }
+
+          RawPixel* p = reinterpret_cast<RawPixel*>(image_.GetRow(y));
+        
+          for (unsigned int x = 0; x < width; x++)
+          {
+            for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+            {
+              float accumulator = 0;
+        
+              for (unsigned int k = 0; k < vertical_.size(); k++)
+              {
+                accumulator += rows[k][ChannelsCount * x + c] * vertical_[k];
+              }
+
+              accumulator *= normalization_;
+
+              if (accumulator <= static_cast<float>(std::numeric_limits<RawPixel>::min()))
+              {
+                *p = std::numeric_limits<RawPixel>::min();
+              }
+              else if (accumulator >= static_cast<float>(std::numeric_limits<RawPixel>::max()))
+              {
+                *p = std::numeric_limits<RawPixel>::max();
+              }
+              else
+              {
+                if (UseRound)
+                {
+                  assert(sizeof(RawPixel) < sizeof(int));
+                  *p = static_cast<RawPixel>(Math::iround(accumulator));
+                }
+                else
+                {
+                  *p = static_cast<RawPixel>(accumulator);
+                }
+              }
             }
           }
         }
       }
+    };
+  }
+
+
+  // This is an implementation of separable convolution that uses
+  // floating-point arithmetics, and an intermediate Float32
+  // image. The out-of-image values are taken as the border
+  // value. Further optimization is possible. Both passes are
+  // processed by bands of rows, the vertical pass starting once the
+  // horizontal pass is over.
+  template <typename RawPixel, unsigned int ChannelsCount, bool UseRound>
+  static void SeparableConvolutionFloat(ImageAccessor& image /* inplace */,
+                                        const std::vector<float>& horizontal,
+                                        size_t horizontalAnchor,
+                                        const std::vector<float>& vertical,
+                                        size_t verticalAnchor,
+                                        float normalization)
+  {
+    // WARNING - "::min()" should be replaced by "::lowest()" if
+    // dealing with float or double (which is not the case so far)
+    assert(sizeof(RawPixel) <= 2);  // Safeguard to remember about "float/double"
+
+    const unsigned int width = image.GetWidth();
+    const unsigned int height = image.GetHeight();
+    const uint64_t countPixels = static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+
+    Image tmp(PixelFormat_Float32, ChannelsCount * width, height, false);
+
+    {
+      HorizontalConvolutionBands<RawPixel, ChannelsCount> bands(image, tmp, horizontal, horizontalAnchor);
+      ProcessRowBands(bands, height, countPixels);
+    }
+
+    {
+      VerticalConvolutionBands<RawPixel, ChannelsCount, UseRound> bands(image, tmp, vertical, verticalAnchor, normalization);
+      ProcessRowBands(bands, height, countPixels);
     }
   }
 
@@ -32,9 +32,12 @@
 #include <vector>
 #include <stdint.h>
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
 
 namespace Orthanc
 {
+  class IExecutorService;
+
   class ORTHANC_PUBLIC ImageProcessing : public boost::noncopyable
   {
   public:
@@ -78,6 +81,19 @@ namespace Orthanc
                         int x2) = 0;
     };
 
+    /**
+     * Process the large images by bands of rows, in the given pool
+     * of "countThreads" threads, together with the calling thread.
+     * This applies to "Convert()", "Resize()", "FitSize()" and
+     * "SeparableConvolution()" (hence "SmoothGaussian5x5()" and
+     * "MeanFilter()"). The small images are still processed by the
+     * calling thread only. A NULL executor disables the parallel
+     * processing, which is the default. Not available in sandboxed
+     * environments (new in Orthanc 1.12.12).
+     **/
+    static void SetParallelExecutor(const boost::shared_ptr<IExecutorService>& executor,
+                                    unsigned int countThreads);
+
     static void Copy(ImageAccessor& target,
                      const ImageAccessor& source);
 
@@ -33,6 +33,9 @@
 #  include "../SystemToolbox.h"
 #endif
 
+#include <algorithm>
+#include <cassert>
+#include <jerror.h>
 #include <stdlib.h>
 #include <vector>
 
@@ -60,12 +63,83 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    /**
+     * Destination manager of libjpeg that writes the compressed data
+     * directly into the target string, which avoids the copy from the
+     * buffer that is allocated by "jpeg_mem_dest()". The memory that
+     * is already allocated by the string is reused. The first field
+     * must be the "public" structure expected by libjpeg.
+     **/
+    struct StringDestination
+    {
+      struct jpeg_destination_mgr  pub;
+      std::string*                 target;
+      size_t                       initialSize;
+    };
+  }
+
+
+  static void InitStringDestination(j_compress_ptr cinfo)
+  {
+    StringDestination* dest = reinterpret_cast<StringDestination*>(cinfo->dest);
+
+    try
+    {
+      dest->target->resize(std::max(dest->target->capacity(), dest->initialSize));
+    }
+    catch (std::bad_alloc&)
+    {
+      cinfo->err->msg_code = JERR_OUT_OF_MEMORY;
+      cinfo->err->error_exit(reinterpret_cast<j_common_ptr>(cinfo));
+    }
+
+    dest->pub.next_output_byte = reinterpret_cast<JOCTET*>(&(*dest->target) [0]);
+    dest->pub.free_in_buffer = dest->target->size();
+  }
+
+
+  static boolean EmptyStringDestination(j_compress_ptr cinfo)
+  {
+    // The whole buffer is full: Double its size
+    StringDestination* dest = reinterpret_cast<StringDestination*>(cinfo->dest);
+    const size_t used = dest->target->size();
+
+    try
+    {
+      dest->target->resize(2 * used);
+    }
+    catch (std::bad_alloc&)
+    {
+      cinfo->err->msg_code = JERR_OUT_OF_MEMORY;
+      cinfo->err->error_exit(reinterpret_cast<j_common_ptr>(cinfo));
+    }
+
+    dest->pub.next_output_byte = reinterpret_cast<JOCTET*>(&(*dest->target) [used]);
+    dest->pub.free_in_buffer = dest->target->size() - used;
+
+    return static_cast<boolean>(true);
+  }
+
+
+  static void TermStringDestination(j_compress_ptr cinfo)
+  {
+    StringDestination* dest = reinterpret_cast<StringDestination*>(cinfo->dest);
+    assert(dest->pub.free_in_buffer <= dest->target->size());
+    dest->target->resize(dest->target->size() - dest->pub.free_in_buffer);
+  }
+
+
   static void Compress(struct jpeg_compress_struct& cinfo,
                        std::vector<uint8_t*>& lines,
                        unsigned int width,
                        unsigned int height,
                        PixelFormat format,
-                       uint8_t quality)
+                       uint8_t quality,
+                       JpegWriter::ChromaSubsampling subsampling,
+                       bool fastDct,
+                       bool optimizedHuffman)
   {
     cinfo.image_width = width;
     cinfo.image_height = height;
@@ -91,6 +165,42 @@ namespace Orthanc
     // The "static_cast" is necessary on OS X:
     // https://github.com/simonfuhrmann/mve/issues/371
     jpeg_set_quality(&cinfo, quality, static_cast<boolean>(true));
+
+    if (format == PixelFormat_RGB24)
+    {
+      // "jpeg_set_defaults()" has selected the YCbCr color space,
+      // whose first component is the luminance
+      assert(cinfo.num_components == 3);
+
+      switch (subsampling)
+      {
+        case JpegWriter::ChromaSubsampling_420:
+          cinfo.comp_info[0].h_samp_factor = 2;
+          cinfo.comp_info[0].v_samp_factor = 2;
+          break;
+
+        case JpegWriter::ChromaSubsampling_422:
+          cinfo.comp_info[0].h_samp_factor = 2;
+          cinfo.comp_info[0].v_samp_factor = 1;
+          break;
+
+        case JpegWriter::ChromaSubsampling_444:
+          cinfo.comp_info[0].h_samp_factor = 1;
+          cinfo.comp_info[0].v_samp_factor = 1;
+          break;
+
+        default:
+          THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+      }
+    }
+
+    if (fastDct)
+    {
+      cinfo.dct_method = JDCT_IFAST;
+    }
+
+    cinfo.optimize_coding = static_cast<boolean>(optimizedHuffman);
+
     jpeg_start_compress(&cinfo, static_cast<boolean>(true));
     
     jpeg_write_scanlines(&cinfo, &lines[0], height);
@@ -99,7 +209,11 @@ namespace Orthanc
   }
                        
 
-  JpegWriter::JpegWriter() : quality_(90)
+  JpegWriter::JpegWriter() :
+    quality_(90),
+    chromaSubsampling_(ChromaSubsampling_420),
+    fastDct_(false),
+    optimizedHuffman_(false)
   {
   }
 
@@ -115,6 +229,19 @@ namespace Orthanc
   }
 
 
+  void JpegWriter::SetChromaSubsampling(ChromaSubsampling subsampling)
+  {
+    if (subsampling != ChromaSubsampling_420 &&
+        subsampling != ChromaSubsampling_422 &&
+        subsampling != ChromaSubsampling_444)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    chromaSubsampling_ = subsampling;
+  }
+
+
 #if ORTHANC_SANDBOXED == 0
   void JpegWriter::WriteToFileInternal(const std::string& filename,
                                        unsigned int width,
@@ -153,7 +280,7 @@ namespace Orthanc
 
     jpeg_create_compress(&cinfo);
     jpeg_stdio_dest(&cinfo, fp);
-    Compress(cinfo, lines, width, height, format, quality_);
+    Compress(cinfo, lines, width, height, format, quality_, chromaSubsampling_, fastDct_, optimizedHuffman_);
 
     // Everything went fine, "setjmp()" didn't get called
 
@@ -177,27 +304,20 @@ namespace Orthanc
 
     Internals::JpegErrorManager jerr;
 
-    unsigned char* data = NULL;
+    StringDestination dest;
+    memset(&dest, 0, sizeof(StringDestination));
+    dest.pub.init_destination = InitStringDestination;
+    dest.pub.empty_output_buffer = EmptyStringDestination;
+    dest.pub.term_destination = TermStringDestination;
+    dest.target = &jpeg;
 
-#if ((JPEG_LIB_VERSION_MAJOR < 9) ||                                    \
-     (JPEG_LIB_VERSION_MAJOR == 9 && JPEG_LIB_VERSION_MINOR <= 3))
-    /**
-     * jpeg_mem_dest() has "unsigned long*" as its 3rd parameter until
-     * jpeg-9c. Since jpeg-9d, this is a "size_t*".
-     **/
-    unsigned long size;
-#else
-    size_t size;
-#endif
+    // Rough guess of the compressed size, which is enlarged if needed
+    dest.initialSize = std::max(static_cast<size_t>(4096), static_cast<size_t>(pitch) * static_cast<size_t>(height) / 8);
 
     if (setjmp(jerr.GetJumpBuffer())) 
     {
       jpeg_destroy_compress(&cinfo);
-
-      if (data != NULL)
-      {
-        free(data);
-      }
+      jpeg.clear();
 
       throw OrthancException(ErrorCode_InternalError,
                              "Error during JPEG encoding: " + jerr.GetMessage());
@@ -207,14 +327,11 @@ namespace Orthanc
 
     jpeg_create_compress(&cinfo);
     cinfo.err = jerr.GetPublic();
-    jpeg_mem_dest(&cinfo, &data, &size);
+    cinfo.dest = &dest.pub;
 
-    Compress(cinfo, lines, width, height, format, quality_);
+    Compress(cinfo, lines, width, height, format, quality_, chromaSubsampling_, fastDct_, optimizedHuffman_);
 
     // Everything went fine, "setjmp()" didn't get called
-
-    jpeg.assign(reinterpret_cast<const char*>(data), static_cast<size_t>(size));
-    free(data);
   }
 
   uint8_t JpegWriter::GetQuality() const
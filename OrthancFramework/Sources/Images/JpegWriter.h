@@ -56,8 +56,21 @@ namespace Orthanc
                                        PixelFormat format,
                                        const void* buffer) ORTHANC_OVERRIDE;
 
+  public:
+    // Subsampling of the chroma components of the color images (new
+    // in Orthanc 1.12.12)
+    enum ChromaSubsampling
+    {
+      ChromaSubsampling_420,  // Default of libjpeg
+      ChromaSubsampling_422,
+      ChromaSubsampling_444   // No subsampling
+    };
+
   private:
-    uint8_t  quality_;
+    uint8_t            quality_;
+    ChromaSubsampling  chromaSubsampling_;
+    bool               fastDct_;
+    bool               optimizedHuffman_;
 
   public:
     JpegWriter();
@@ -65,5 +78,35 @@ namespace Orthanc
     void SetQuality(uint8_t quality);
 
     uint8_t GetQuality() const;
+
+    void SetChromaSubsampling(ChromaSubsampling subsampling);
+
+    ChromaSubsampling GetChromaSubsampling() const
+    {
+      return chromaSubsampling_;
+    }
+
+    // Use the fast, less accurate integer DCT (new in Orthanc 1.12.12)
+    void SetFastDct(bool fast)
+    {
+      fastDct_ = fast;
+    }
+
+    bool IsFastDct() const
+    {
+      return fastDct_;
+    }
+
+    // Compute optimal Huffman tables, which produces smaller files at
+    // the price of a second pass over the coefficients (new in Orthanc 1.12.12)
+    void SetOptimizedHuffman(bool optimized)
+    {
+      optimizedHuffman_ = optimized;
+    }
+
+    bool IsOptimizedHuffman() const
+    {
+      return optimizedHuffman_;
+    }
   };
 }
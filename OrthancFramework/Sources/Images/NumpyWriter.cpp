@@ -240,4 +240,219 @@ namespace Orthanc
   {
     return compressed_;
   }
+
+
+#if (ORTHANC_ENABLE_ZLIB == 1) && (ORTHANC_SANDBOXED == 0)
+  class NumpyStreamWriter::ZipOutput : public ZipWriter::IOutputStream
+  {
+  private:
+    IOutput&  output_;
+    uint64_t  archiveSize_;
+
+  public:
+    explicit ZipOutput(IOutput& output) :
+      output_(output),
+      archiveSize_(0)
+    {
+    }
+
+    virtual void Write(const std::string& chunk) ORTHANC_OVERRIDE
+    {
+      if (!chunk.empty())
+      {
+        output_.Write(chunk.c_str(), chunk.size());
+        archiveSize_ += chunk.size();
+      }
+    }
+
+    virtual void Close() ORTHANC_OVERRIDE
+    {
+    }
+
+    virtual uint64_t GetArchiveSize() const ORTHANC_OVERRIDE
+    {
+      return archiveSize_;
+    }
+  };
+#endif
+
+
+  void NumpyStreamWriter::Flush()
+  {
+    if (!buffer_.empty())
+    {
+#if (ORTHANC_ENABLE_ZLIB == 1) && (ORTHANC_SANDBOXED == 0)
+      if (zip_.get() != NULL)
+      {
+        zip_->Write(buffer_);
+      }
+      else
+#endif
+      {
+        output_.Write(buffer_.c_str(), buffer_.size());
+      }
+
+      buffer_.clear();
+    }
+  }
+
+
+  void NumpyStreamWriter::WriteInternal(const void* data,
+                                        size_t size)
+  {
+    static const size_t FLUSH_SIZE = 1024 * 1024;
+
+    buffer_.append(reinterpret_cast<const char*>(data), size);
+
+    if (buffer_.size() >= FLUSH_SIZE)
+    {
+      Flush();
+    }
+  }
+
+
+  NumpyStreamWriter::NumpyStreamWriter(IOutput& output,
+                                       bool compress) :
+    output_(output),
+    compress_(compress),
+    hasHeader_(false),
+    isClosed_(false),
+    width_(0),
+    height_(0),
+    format_(PixelFormat_Grayscale8),  // Dummy initialization
+    remainingRows_(0)
+  {
+#if (ORTHANC_ENABLE_ZLIB == 0) || (ORTHANC_SANDBOXED == 1)
+    if (compress)
+    {
+      throw OrthancException(ErrorCode_InternalError, "Orthanc was compiled without support for ZIP");
+    }
+#endif
+  }
+
+
+  NumpyStreamWriter::~NumpyStreamWriter()
+  {
+#if (ORTHANC_ENABLE_ZLIB == 1) && (ORTHANC_SANDBOXED == 0)
+    if (zip_.get() != NULL &&
+        !isClosed_)
+    {
+      try
+      {
+        // Don't write an incomplete archive to the output
+        zip_->CancelStream();
+      }
+      catch (OrthancException&)  // NOLINT(bugprone-empty-catch)
+      {
+      }
+    }
+#endif
+  }
+
+
+  void NumpyStreamWriter::WriteHeader(unsigned int depth,
+                                      unsigned int width,
+                                      unsigned int height,
+                                      PixelFormat format)
+  {
+    if (hasHeader_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    ChunkedBuffer header;
+    NumpyWriter::WriteHeader(header, depth, width, height, format);
+
+    std::string s;
+    header.Flatten(s);
+
+    remainingRows_ = static_cast<uint64_t>(depth == 0 ? 1 : depth) * static_cast<uint64_t>(height);
+
+#if (ORTHANC_ENABLE_ZLIB == 1) && (ORTHANC_SANDBOXED == 0)
+    if (compress_)
+    {
+      // This is the default name of the first array, as in "NumpyWriter::Finalize()"
+      const char* ARRAY_NAME = "arr_0";
+
+      const uint64_t uncompressedSize = (static_cast<uint64_t>(s.size()) +
+                                         remainingRows_ * static_cast<uint64_t>(width) *
+                                         static_cast<uint64_t>(GetBytesPerPixel(format)));
+      const bool isZip64 = (uncompressedSize >= 1lu * 1024lu * 1024lu * 1024lu);
+
+      zip_.reset(new ZipWriter);
+      zip_->AcquireOutputStream(new ZipOutput(output_), isZip64);
+      zip_->Open();
+      zip_->OpenStreamedFile(ARRAY_NAME, true);
+    }
+#endif
+
+    hasHeader_ = true;
+    width_ = width;
+    height_ = height;
+    format_ = format;
+
+    WriteInternal(s.c_str(), s.size());
+  }
+
+
+  void NumpyStreamWriter::WritePixels(const ImageAccessor& frames)
+  {
+    if (!hasHeader_ ||
+        isClosed_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else if (frames.GetFormat() != format_)
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageFormat);
+    }
+    else if (frames.GetWidth() != width_ ||
+             (height_ == 0 && frames.GetHeight() != 0) ||
+             (height_ != 0 && frames.GetHeight() % height_ != 0))
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+    else if (frames.GetHeight() > remainingRows_)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Too many frames were written to the numpy array");
+    }
+    else
+    {
+      const size_t rowSize = static_cast<size_t>(frames.GetBytesPerPixel()) * frames.GetWidth();
+
+      for (unsigned int y = 0; y < frames.GetHeight(); y++)
+      {
+        WriteInternal(frames.GetConstRow(y), rowSize);
+      }
+
+      remainingRows_ -= frames.GetHeight();
+    }
+  }
+
+
+  void NumpyStreamWriter::Close()
+  {
+    if (!hasHeader_ ||
+        isClosed_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else if (remainingRows_ != 0)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "Some frames are missing in the numpy array");
+    }
+    else
+    {
+      Flush();
+
+#if (ORTHANC_ENABLE_ZLIB == 1) && (ORTHANC_SANDBOXED == 0)
+      if (zip_.get() != NULL)
+      {
+        zip_->Close();
+      }
+#endif
+
+      isClosed_ = true;
+    }
+  }
 }
@@ -32,8 +32,12 @@
 #include "../ChunkedBuffer.h"
 #include "../Compatibility.h"  // For ORTHANC_OVERRIDE
 
+#include <memory>
+
 namespace Orthanc
 {
+  class ZipWriter;
+
   class ORTHANC_PUBLIC NumpyWriter : public IImageWriter
   {
   protected:
@@ -76,4 +80,67 @@ namespace Orthanc
                          ChunkedBuffer& source,
                          bool compress);
   };
+
+
+  /**
+   * Writes a numpy array by chunks, without keeping the full array in
+   * memory (new in Orthanc 1.12.12). The header is written as soon as
+   * the shape of the array is known, then the frames are written in
+   * order. If compression is enabled, the output is a NPZ archive
+   * whose single entry is "arr_0": The ZIP stream buffers the
+   * compressed entry until it is closed, as its size must be written
+   * in its local header.
+   **/
+  class ORTHANC_PUBLIC NumpyStreamWriter : public boost::noncopyable
+  {
+  public:
+    class ORTHANC_PUBLIC IOutput : public boost::noncopyable
+    {
+    public:
+      virtual ~IOutput()
+      {
+      }
+
+      virtual void Write(const void* data,
+                         size_t size) = 0;
+    };
+
+  private:
+    class ZipOutput;
+
+    IOutput&                    output_;
+    bool                        compress_;
+#if (ORTHANC_ENABLE_ZLIB == 1) && (ORTHANC_SANDBOXED == 0)
+    std::unique_ptr<ZipWriter>  zip_;
+#endif
+    bool                        hasHeader_;
+    bool                        isClosed_;
+    unsigned int                width_;
+    unsigned int                height_;
+    PixelFormat                 format_;
+    uint64_t                    remainingRows_;
+    std::string                 buffer_;
+
+    void Flush();
+
+    void WriteInternal(const void* data,
+                       size_t size);
+
+  public:
+    NumpyStreamWriter(IOutput& output,
+                      bool compress);
+
+    ~NumpyStreamWriter();
+
+    void WriteHeader(unsigned int depth,  // Must be "0" for 2D images
+                     unsigned int width,
+                     unsigned int height,
+                     PixelFormat format);
+
+    // The height of "frames" can be a multiple of the height of the
+    // frames, if several consecutive frames are stacked in one image
+    void WritePixels(const ImageAccessor& frames);
+
+    void Close();
+  };
 }
@@ -181,8 +181,40 @@ namespace Orthanc
     void Compress(unsigned int width,
                   unsigned int height,
                   unsigned int pitch,
-                  PixelFormat format)
+                  PixelFormat format,
+                  int compressionLevel,
+                  FilterStrategy filterStrategy)
     {
+      if (compressionLevel >= 0)
+      {
+        png_set_compression_level(png_, compressionLevel);
+      }
+
+      switch (filterStrategy)
+      {
+        case FilterStrategy_Adaptive:
+          break;  // Keep the default filters of libpng
+
+        case FilterStrategy_None:
+          png_set_filter(png_, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+          break;
+
+        case FilterStrategy_Sub:
+          png_set_filter(png_, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+          break;
+
+        case FilterStrategy_Up:
+          png_set_filter(png_, PNG_FILTER_TYPE_BASE, PNG_FILTER_UP);
+          break;
+
+        case FilterStrategy_Paeth:
+          png_set_filter(png_, PNG_FILTER_TYPE_BASE, PNG_FILTER_PAETH);
+          break;
+
+        default:
+          THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+      }
+
       png_set_IHDR(png_, info_, width, height,
                    bitDepth_, colorType_, PNG_INTERLACE_NONE,
                    PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
@@ -219,6 +251,93 @@ namespace Orthanc
   };
 
 
+  PngWriter::PngWriter() :
+    compressionLevel_(-1),  // Default of zlib
+    filterStrategy_(FilterStrategy_Adaptive)
+  {
+  }
+
+
+  void PngWriter::SetCompressionLevel(unsigned int level)
+  {
+    if (level > 9)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "The level of the PNG compression must be between 0 and 9");
+    }
+
+    compressionLevel_ = static_cast<int>(level);
+  }
+
+
+  unsigned int PngWriter::GetCompressionLevel() const
+  {
+    if (compressionLevel_ < 0)
+    {
+      return 6;  // This is "Z_DEFAULT_COMPRESSION" in zlib
+    }
+    else
+    {
+      return static_cast<unsigned int>(compressionLevel_);
+    }
+  }
+
+
+  void PngWriter::SetFilterStrategy(FilterStrategy strategy)
+  {
+    if (strategy != FilterStrategy_Adaptive &&
+        strategy != FilterStrategy_None &&
+        strategy != FilterStrategy_Sub &&
+        strategy != FilterStrategy_Up &&
+        strategy != FilterStrategy_Paeth)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    filterStrategy_ = strategy;
+  }
+
+
+  PngWriter::FilterStrategy PngWriter::StringToFilterStrategy(const std::string& value)
+  {
+    std::string s;
+    Toolbox::ToLowerCase(s, value);
+
+    if (s == "adaptive")
+    {
+      return FilterStrategy_Adaptive;
+    }
+    else if (s == "none")
+    {
+      return FilterStrategy_None;
+    }
+    else if (s == "sub")
+    {
+      return FilterStrategy_Sub;
+    }
+    else if (s == "up")
+    {
+      return FilterStrategy_Up;
+    }
+    else if (s == "paeth")
+    {
+      return FilterStrategy_Paeth;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "Unknown PNG filter strategy (must be \"adaptive\", \"none\", \"sub\", \"up\" or \"paeth\"): " + value);
+    }
+  }
+
+
+  void PngWriter::SetFastEncoding()
+  {
+    compressionLevel_ = 1;
+    filterStrategy_ = FilterStrategy_None;
+  }
+
+
 #if ORTHANC_SANDBOXED == 0
   void PngWriter::WriteToFileInternal(const std::string& filename,
                                       unsigned int width,
@@ -245,7 +364,7 @@ namespace Orthanc
       throw OrthancException(ErrorCode_CannotWriteFile);      
     }
 
-    context.Compress(width, height, pitch, format);
+    context.Compress(width, height, pitch, format, compressionLevel_, filterStrategy_);
 
     fclose(fp);
   }
@@ -282,7 +401,7 @@ namespace Orthanc
 
     png_set_write_fn(context.GetObject(), &chunks, MemoryCallback, NULL);
 
-    context.Compress(width, height, pitch, format);
+    context.Compress(width, height, pitch, format, compressionLevel_, filterStrategy_);
 
     chunks.Flatten(png);
   }
@@ -41,9 +41,24 @@ namespace Orthanc
 {
   class ORTHANC_PUBLIC PngWriter : public IImageWriter
   {
+  public:
+    // Filters that are applied to the rows before their compression
+    // by zlib (new in Orthanc 1.12.12)
+    enum FilterStrategy
+    {
+      FilterStrategy_Adaptive,  // Default of libpng: Best filter for each row
+      FilterStrategy_None,      // Fastest
+      FilterStrategy_Sub,
+      FilterStrategy_Up,
+      FilterStrategy_Paeth
+    };
+
   private:
     class Context;
 
+    int             compressionLevel_;
+    FilterStrategy  filterStrategy_;
+
   protected:
 #if ORTHANC_SANDBOXED == 0
     virtual void WriteToFileInternal(const std::string& filename,
@@ -60,5 +75,35 @@ namespace Orthanc
                                        unsigned int pitch,
                                        PixelFormat format,
                                        const void* buffer) ORTHANC_OVERRIDE;
+
+  public:
+    PngWriter();
+
+    // Level of the zlib compression, between 0 (no compression,
+    // fastest) and 9 (smallest files). New in Orthanc 1.12.12.
+    void SetCompressionLevel(unsigned int level);
+
+    bool HasCompressionLevel() const
+    {
+      return compressionLevel_ >= 0;
+    }
+
+    // Returns the default level of zlib if not explicitly set
+    unsigned int GetCompressionLevel() const;
+
+    void SetFilterStrategy(FilterStrategy strategy);
+
+    FilterStrategy GetFilterStrategy() const
+    {
+      return filterStrategy_;
+    }
+
+    // Parses "adaptive", "none", "sub", "up" or "paeth" (case-insensitive)
+    static FilterStrategy StringToFilterStrategy(const std::string& value);
+
+    // Selects the fastest encoding, whose files are typically twice
+    // as large. Useful if the transfer time is smaller than the
+    // encoding time. New in Orthanc 1.12.12.
+    void SetFastEncoding();
   };
 }
@@ -0,0 +1,344 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "JobTasksExecutor.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cassert>
+
+
+namespace Orthanc
+{
+  bool JobTasksExecutor::Group::IsReady() const
+  {
+    return (!tasks_.empty() &&
+            (maxParallelism_ == 0 ||
+             running_ < maxParallelism_));
+  }
+
+
+  JobTasksExecutor::Group::Group(JobTasksExecutor& executor,
+                                 size_t maxParallelism) :
+    executor_(executor),
+    maxParallelism_(maxParallelism),
+    running_(0)
+  {
+  }
+
+
+  JobTasksExecutor::Group::~Group()
+  {
+    try
+    {
+      Cancel();
+      Wait(0);
+    }
+    catch (OrthancException& e)
+    {
+      // Don't throw exceptions in destructors
+      LOG(ERROR) << "Exception in destructor: " << e.What();
+    }
+  }
+
+
+  void JobTasksExecutor::Group::Submit(IRunnable* task)
+  {
+    if (task == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+    else
+    {
+      executor_.Enqueue(*this, task);
+    }
+  }
+
+
+  void JobTasksExecutor::Group::Cancel()
+  {
+    boost::mutex::scoped_lock lock(executor_.mutex_);
+
+    for (std::deque<IRunnable*>::iterator it = tasks_.begin(); it != tasks_.end(); ++it)
+    {
+      assert(*it != NULL);
+      delete *it;
+    }
+
+    tasks_.clear();
+    executor_.Remove(*this);
+    executor_.taskComplete_.notify_all();
+  }
+
+
+  bool JobTasksExecutor::Group::Wait(unsigned int timeout)
+  {
+    const boost::system_time deadline = (boost::get_system_time() +
+                                         boost::posix_time::milliseconds(timeout));
+
+    boost::mutex::scoped_lock lock(executor_.mutex_);
+
+    for (;;)
+    {
+      if (tasks_.empty() &&
+          running_ == 0)
+      {
+        return true;
+      }
+      else if (timeout != 0 &&
+               boost::get_system_time() >= deadline)
+      {
+        return false;
+      }
+      else if (IsReady())
+      {
+        // Help the other threads by executing one of our own sub-tasks
+        executor_.Execute(lock, *this);
+      }
+      else if (timeout == 0)
+      {
+        executor_.taskComplete_.wait(lock);
+      }
+      else
+      {
+        executor_.taskComplete_.timed_wait(lock, deadline);
+      }
+    }
+  }
+
+
+  void JobTasksExecutor::Enqueue(Group& group,
+                                 IRunnable* task)
+  {
+    assert(task != NULL);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (group.tasks_.empty())
+    {
+      readyGroups_.push_back(&group);
+    }
+
+    group.tasks_.push_back(task);
+    taskAvailable_.notify_one();
+  }
+
+
+  void JobTasksExecutor::Remove(Group& group)
+  {
+    // The mutex must be locked by the caller
+    readyGroups_.remove(&group);
+  }
+
+
+  JobTasksExecutor::Group* JobTasksExecutor::LookupReadyGroup() const
+  {
+    // The mutex must be locked by the caller
+    for (std::list<Group*>::const_iterator it = readyGroups_.begin(); it != readyGroups_.end(); ++it)
+    {
+      if ((*it)->IsReady())
+      {
+        return *it;
+      }
+    }
+
+    return NULL;
+  }
+
+
+  void JobTasksExecutor::Execute(boost::mutex::scoped_lock& lock,
+                                 Group& group)
+  {
+    // The mutex must be locked by the caller
+    assert(group.IsReady());
+
+    std::unique_ptr<IRunnable> task(group.tasks_.front());
+    group.tasks_.pop_front();
+    group.running_++;
+
+    // Round-robin between the groups, so that one job with many
+    // sub-tasks does not starve the other jobs
+    Remove(group);
+    if (!group.tasks_.empty())
+    {
+      readyGroups_.push_back(&group);
+    }
+
+    lock.unlock();
+
+    try
+    {
+      task->Run();
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "Exception while executing a sub-task of a job: " << e.What();
+    }
+    catch (...)
+    {
+      LOG(ERROR) << "Native exception while executing a sub-task of a job";
+    }
+
+    task.reset();
+
+    lock.lock();
+
+    // The group cannot have been destroyed in the meantime, as its
+    // destructor waits for "running_" to become zero
+    assert(group.running_ > 0);
+    group.running_--;
+
+    taskComplete_.notify_all();
+
+    if (!group.tasks_.empty())
+    {
+      // One slot of parallelism was released in this group
+      taskAvailable_.notify_all();
+    }
+  }
+
+
+  void JobTasksExecutor::Worker(JobTasksExecutor* that,
+                                size_t index)
+  {
+    assert(that != NULL);
+    Logging::ScopedCurrentThreadNameSetter setter(std::string("JOBS-TASKS-") + boost::lexical_cast<std::string>(index));
+
+    boost::mutex::scoped_lock lock(that->mutex_);
+
+    for (;;)
+    {
+      Group* group = NULL;
+
+      while (!that->stopping_ &&
+             (group = that->LookupReadyGroup()) == NULL)
+      {
+        that->taskAvailable_.wait(lock);
+      }
+
+      if (that->stopping_)
+      {
+        return;
+      }
+      else
+      {
+        assert(group != NULL);
+        that->Execute(lock, *group);
+      }
+    }
+  }
+
+
+  JobTasksExecutor::JobTasksExecutor() :
+    stopping_(false)
+  {
+  }
+
+
+  JobTasksExecutor::~JobTasksExecutor()
+  {
+    Stop();
+
+    if (!readyGroups_.empty())
+    {
+      LOG(ERROR) << "INTERNAL ERROR: Some groups of sub-tasks are still alive while destroying their executor";
+    }
+  }
+
+
+  void JobTasksExecutor::Start(size_t countThreads)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (stopping_ ||
+        !threads_.empty())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    for (size_t i = 0; i < countThreads; i++)
+    {
+      threads_.push_back(new boost::thread(Worker, this, i));
+    }
+  }
+
+
+  void JobTasksExecutor::Stop()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stopping_ = true;
+      taskAvailable_.notify_all();
+    }
+
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+      assert(threads_[i] != NULL);
+
+      if (threads_[i]->joinable())
+      {
+        threads_[i]->join();
+      }
+
+      delete threads_[i];
+    }
+
+    threads_.clear();
+  }
+
+
+  bool JobTasksExecutor::ExecuteOne(unsigned int timeout)
+  {
+    const boost::system_time deadline = (boost::get_system_time() +
+                                         boost::posix_time::milliseconds(timeout));
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Group* group = LookupReadyGroup();
+
+    while (group == NULL)
+    {
+      if (timeout == 0 ||
+          !taskAvailable_.timed_wait(lock, deadline))
+      {
+        return false;
+      }
+
+      group = LookupReadyGroup();
+    }
+
+    Execute(lock, *group);
+    return true;
+  }
+
+
+  bool JobTasksExecutor::HasTasks()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return (LookupReadyGroup() != NULL);
+  }
+}
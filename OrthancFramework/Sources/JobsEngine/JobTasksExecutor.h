@@ -0,0 +1,132 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 1
+#  error The job engine cannot be used in sandboxed environments
+#endif
+
+#include "../Compatibility.h"
+#include "../OrthancFramework.h"
+#include "../MultiThreading/IRunnable.h"
+
+#include <deque>
+#include <list>
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Executor that is shared by all the jobs of one jobs engine, so
+   * that the jobs can split their steps into sub-tasks. Each job
+   * pushes its sub-tasks into its own "Group", and executes them
+   * itself while waiting for the group. The threads of the executor
+   * and the idle workers of the jobs engine steal the sub-tasks from
+   * the groups in a round-robin fashion, which bounds the total number
+   * of threads, whatever the number of running jobs (new in Orthanc
+   * 1.12.12).
+   **/
+  class ORTHANC_PUBLIC JobTasksExecutor : public boost::noncopyable
+  {
+  public:
+    class ORTHANC_PUBLIC Group : public boost::noncopyable
+    {
+      friend class JobTasksExecutor;
+
+    private:
+      JobTasksExecutor&       executor_;
+      size_t                  maxParallelism_;
+      std::deque<IRunnable*>  tasks_;     // Protected by the mutex of the executor
+      size_t                  running_;   // Protected by the mutex of the executor
+
+      bool IsReady() const;
+
+    public:
+      // A "maxParallelism" of zero means that the number of sub-tasks
+      // that run at the same time is only limited by the executor
+      Group(JobTasksExecutor& executor,
+            size_t maxParallelism);
+
+      // Cancels the sub-tasks that have not started yet, and waits
+      // for the completion of the running ones
+      ~Group();
+
+      void Submit(IRunnable* task /* takes ownership */);
+
+      void Cancel();
+
+      // Executes the sub-tasks of this group in the calling thread,
+      // until all the sub-tasks are complete. Returns "false" if the
+      // timeout has elapsed. A timeout of zero means no timeout.
+      bool Wait(unsigned int timeout);
+    };
+
+  private:
+    boost::mutex                 mutex_;
+    boost::condition_variable    taskAvailable_;
+    boost::condition_variable    taskComplete_;
+    std::list<Group*>            readyGroups_;   // Groups with sub-tasks that have not started
+    std::vector<boost::thread*>  threads_;
+    bool                         stopping_;
+
+    void Enqueue(Group& group,
+                 IRunnable* task);
+
+    void Remove(Group& group);
+
+    Group* LookupReadyGroup() const;
+
+    void Execute(boost::mutex::scoped_lock& lock,
+                 Group& group);
+
+    static void Worker(JobTasksExecutor* that,
+                       size_t index);
+
+  public:
+    JobTasksExecutor();
+
+    ~JobTasksExecutor();
+
+    // Starts the threads that are dedicated to the sub-tasks. This is
+    // optional, as the sub-tasks are also executed by their job, and
+    // by the idle workers of the jobs engine.
+    void Start(size_t countThreads);
+
+    void Stop();
+
+    // Executes at most one sub-task of any group in the calling
+    // thread. Returns "false" if no sub-task was available before the
+    // timeout. A timeout of zero means not to wait at all.
+    bool ExecuteOne(unsigned int timeout);
+
+    bool HasTasks();
+  };
+}
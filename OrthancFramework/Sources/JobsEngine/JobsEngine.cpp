@@ -27,6 +27,7 @@
 
 #include "../Logging.h"
 #include "../OrthancException.h"
+#include "../SystemToolbox.h"
 #include "../Toolbox.h"
 
 
@@ -115,8 +116,9 @@ namespace Orthanc
 
     while (engine->IsRunning())
     {
-      boost::this_thread::sleep(boost::posix_time::milliseconds(engine->threadSleep_));
-      engine->GetRegistry().ScheduleRetries();
+      // Wakes up as soon as the earliest retry is due, without
+      // scanning the jobs that are not ready yet
+      engine->GetRegistry().WaitAndScheduleRetries(engine->threadSleep_);
     }
   }
 
@@ -128,9 +130,18 @@ namespace Orthanc
     Logging::ScopedCurrentThreadNameSetter setter(std::string("JOBS-WORKER-") + boost::lexical_cast<std::string>(workerIndex));
     CLOG(INFO, JOBS) << "Worker thread " << workerIndex << " has started";
 
+    if (!engine->threadsAffinity_.empty())
+    {
+      SystemToolbox::SetCurrentThreadAffinity(engine->threadsAffinity_);
+    }
+
     while (engine->IsRunning())
     {
-      JobsRegistry::RunningJob running(engine->GetRegistry(), engine->threadSleep_);
+      // Don't sleep for long if some sub-tasks are waiting for an
+      // idle worker
+      const unsigned int timeout = (engine->tasksExecutor_.HasTasks() ? 1 : engine->threadSleep_);
+
+      JobsRegistry::RunningJob running(engine->GetRegistry(), timeout);
 
       if (running.IsValid())
       {
@@ -148,7 +159,13 @@ namespace Orthanc
           }
         }
       }
-    }      
+      else
+      {
+        // No pending job: Help the running jobs by stealing one of
+        // their sub-tasks, if any
+        engine->tasksExecutor_.ExecuteOne(0);
+      }
+    }
   }
 
 
@@ -156,7 +173,8 @@ namespace Orthanc
     state_(State_Setup),
     registry_(new JobsRegistry(maxCompletedJobs)),
     threadSleep_(200),
-    workers_(1)
+    workers_(1),
+    tasksThreadsCount_(0)
   {
   }
 
@@ -229,6 +247,20 @@ namespace Orthanc
   }
 
 
+  void JobsEngine::SetThreadsAffinity(const std::set<unsigned int>& cpus)
+  {
+    boost::mutex::scoped_lock lock(stateMutex_);
+      
+    if (state_ != State_Setup)
+    {
+      // Can only be invoked before calling "Start()"
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    threadsAffinity_ = cpus;
+  }
+
+
   void JobsEngine::SetThreadSleep(unsigned int sleep)
   {
     boost::mutex::scoped_lock lock(stateMutex_);
@@ -243,6 +275,20 @@ namespace Orthanc
   }
 
 
+  void JobsEngine::SetTasksThreadsCount(size_t count)
+  {
+    boost::mutex::scoped_lock lock(stateMutex_);
+      
+    if (state_ != State_Setup)
+    {
+      // Can only be invoked before calling "Start()"
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    tasksThreadsCount_ = count;
+  }
+
+
   void JobsEngine::Start()
   {
     boost::mutex::scoped_lock lock(stateMutex_);
@@ -273,6 +319,8 @@ namespace Orthanc
       workers_[i] = new boost::thread(Worker, this, i);
     }
 
+    tasksExecutor_.Start(tasksThreadsCount_);
+
     state_ = State_Running;
 
     CLOG(WARNING, JOBS) << "The jobs engine has started with " << workers_.size() << " threads";
@@ -310,6 +358,8 @@ namespace Orthanc
 
       delete workers_[i];
     }
+
+    tasksExecutor_.Stop();
       
     {
       boost::mutex::scoped_lock lock(stateMutex_);
@@ -24,11 +24,13 @@
 
 #pragma once
 
+#include "JobTasksExecutor.h"
 #include "JobsRegistry.h"
 
 #include "../Compatibility.h"
 
 #include <boost/thread.hpp>
+#include <set>
 
 namespace Orthanc
 {
@@ -45,10 +47,13 @@ namespace Orthanc
 
     boost::mutex                 stateMutex_;
     State                        state_;
+    JobTasksExecutor             tasksExecutor_;  // Must be destroyed after the registry
     std::unique_ptr<JobsRegistry>  registry_;
     boost::thread                retryHandler_;
     unsigned int                 threadSleep_;
     std::vector<boost::thread*>  workers_;
+    size_t                       tasksThreadsCount_;
+    std::set<unsigned int>       threadsAffinity_;
 
     bool IsRunning();
     
@@ -67,6 +72,11 @@ namespace Orthanc
 
     JobsRegistry& GetRegistry();
 
+    JobTasksExecutor& GetTasksExecutor()
+    {
+      return tasksExecutor_;
+    }
+
     void LoadRegistryFromJson(IJobUnserializer& unserializer,
                               const Json::Value& serialized);
 
@@ -77,6 +87,14 @@ namespace Orthanc
 
     void SetThreadSleep(unsigned int sleep);
 
+    // Pins the workers to the given CPUs, empty means no affinity
+    // (new in Orthanc 1.12.12)
+    void SetThreadsAffinity(const std::set<unsigned int>& cpus);
+
+    // Number of threads that are dedicated to the sub-tasks of the
+    // jobs, on the top of the idle workers (new in Orthanc 1.12.12)
+    void SetTasksThreadsCount(size_t count);
+
     void Start();
 
     void Stop();
@@ -29,6 +29,10 @@
 #include "../OrthancException.h"
 #include "../Toolbox.h"
 #include "../SerializationToolbox.h"
+#include "../MultiThreading/LockProfiler.h"
+
+#include <algorithm>
+#include <stdlib.h>
 
 namespace Orthanc
 {
@@ -47,20 +51,49 @@ namespace Orthanc
   static const char* ERROR_PAYLOAD_TYPE = "ErrorPayloadType";
   static const char* ERROR_PAYLOAD = "ErrorPayload";
 
+#if ORTHANC_ENABLE_LOCK_PROFILING == 1
+  // The waits on the condition variables are not profiled, as they
+  // would be accounted as holding the mutex
+  static LockProfiler  jobsRegistryLockProfiler_("JobsRegistry");
+#endif
+
   class JobsRegistry::LastModificationTimeUpdater
   {
   private:
-    JobsRegistry&  registry_;
+    JobsRegistry&       registry_;
+    const std::string*  jobId_;
 
   public:
     explicit LastModificationTimeUpdater(JobsRegistry& registry) :
-      registry_(registry)
+      registry_(registry),
+      jobId_(NULL)
+    {
+    }
+
+    // The job is reported by "SerializeModifiedJobs()". The
+    // identifier is read on destruction, so that it can be set after
+    // the construction of the updater.
+    LastModificationTimeUpdater(JobsRegistry& registry,
+                                const std::string& jobId) :
+      registry_(registry),
+      jobId_(&jobId)
     {
     }
 
     ~LastModificationTimeUpdater()
     {
       registry_.lastModificationTime_ = boost::posix_time::microsec_clock::universal_time();
+
+      if (jobId_ != NULL &&
+          !jobId_->empty())
+      {
+        registry_.modifiedJobs_.insert(*jobId_);
+
+        if (registry_.observer_ != NULL)
+        {
+          registry_.observer_->SignalJobUpdated(*jobId_);
+        }
+      }
     }
   };
 
@@ -79,6 +112,8 @@ namespace Orthanc
     bool                              pauseScheduled_;
     bool                              cancelScheduled_;
     JobStatus                         lastStatus_;
+    uint64_t                          sequence_;  // Position in the pending or completed jobs
+    unsigned int                      retryCount_;  // Number of retries since the last completion
 
     void Touch()
     {
@@ -94,6 +129,12 @@ namespace Orthanc
 
     void SetStateInternal(JobState state)
     {
+      if (state == JobState_Success ||
+          state == JobState_Failure)
+      {
+        retryCount_ = 0;
+      }
+
       state_ = state;
       pauseScheduled_ = false;
       cancelScheduled_ = false;
@@ -112,7 +153,9 @@ namespace Orthanc
       runtime_(boost::posix_time::milliseconds(0)),
       retryTime_(creationTime_),
       pauseScheduled_(false),
-      cancelScheduled_(false)
+      cancelScheduled_(false),
+      sequence_(0),
+      retryCount_(0)
     {
       if (job == NULL)
       {
@@ -141,6 +184,16 @@ namespace Orthanc
       priority_ = priority;
     }
 
+    uint64_t GetSequence() const
+    {
+      return sequence_;
+    }
+
+    void SetSequence(uint64_t sequence)
+    {
+      sequence_ = sequence;
+    }
+
     int GetPriority() const
     {
       return priority_;
@@ -215,6 +268,22 @@ namespace Orthanc
       return cancelScheduled_;
     }
 
+    const boost::posix_time::ptime& GetRetryTime() const
+    {
+      return retryTime_;
+    }
+
+    const std::string& GetJobType() const
+    {
+      return jobType_;
+    }
+
+    // Returns the number of retries before this one
+    unsigned int IncrementRetryCount()
+    {
+      return retryCount_++;
+    }
+
     bool IsRetryReady(const boost::posix_time::ptime& now) const
     {
       if (state_ != JobState_Retry)
@@ -342,7 +411,9 @@ namespace Orthanc
                const std::string& id) :
       id_(id),
       pauseScheduled_(false),
-      cancelScheduled_(false)
+      cancelScheduled_(false),
+      sequence_(0),
+      retryCount_(0)
     {
       state_ = StringToJobState(SerializationToolbox::ReadString(serialized, STATE));
       priority_ = SerializationToolbox::ReadInteger(serialized, PRIORITY);
@@ -393,10 +464,38 @@ namespace Orthanc
   };
 
 
-  bool JobsRegistry::PriorityComparator::operator() (const JobHandler* const& a,
-                                                     const JobHandler* const& b) const
+  bool JobsRegistry::PriorityComparator::operator() (const JobHandler* a,
+                                                     const JobHandler* b) const
+  {
+    if (a->GetPriority() != b->GetPriority())
+    {
+      return a->GetPriority() > b->GetPriority();
+    }
+    else
+    {
+      return a->GetSequence() < b->GetSequence();
+    }
+  }
+
+
+  bool JobsRegistry::CompletionComparator::operator() (const JobHandler* a,
+                                                       const JobHandler* b) const
   {
-    return a->GetPriority() < b->GetPriority();
+    return a->GetSequence() < b->GetSequence();
+  }
+
+
+  bool JobsRegistry::RetryComparator::operator() (const JobHandler* a,
+                                                  const JobHandler* b) const
+  {
+    if (a->GetRetryTime() != b->GetRetryTime())
+    {
+      return a->GetRetryTime() < b->GetRetryTime();
+    }
+    else
+    {
+      return a < b;
+    }
   }
 
 
@@ -408,32 +507,16 @@ namespace Orthanc
 #else
   bool JobsRegistry::IsPendingJob(const JobHandler& job) const
   {
-    PendingJobs copy = pendingJobs_;
-    while (!copy.empty())
-    {
-      if (copy.top() == &job)
-      {
-        return true;
-      }
-
-      copy.pop();
-    }
-
-    return false;
+    PendingJobs::const_iterator found = pendingJobs_.find(const_cast<JobHandler*>(&job));
+    return (found != pendingJobs_.end() &&
+            *found == &job);
   }
 
   bool JobsRegistry::IsCompletedJob(const JobHandler& job) const
   {
-    for (CompletedJobs::const_iterator it = completedJobs_.begin();
-         it != completedJobs_.end(); ++it)
-    {
-      if (*it == &job)
-      {
-        return true;
-      }
-    }
-
-    return false;
+    CompletedJobs::const_iterator found = completedJobs_.find(const_cast<JobHandler*>(&job));
+    return (found != completedJobs_.end() &&
+            *found == &job);
   }
 
   bool JobsRegistry::IsRetryJob(JobHandler& job) const
@@ -443,13 +526,10 @@ namespace Orthanc
 
   void JobsRegistry::CheckInvariants() const
   {
+    for (PendingJobs::const_iterator it = pendingJobs_.begin();
+         it != pendingJobs_.end(); ++it)
     {
-      PendingJobs copy = pendingJobs_;
-      while (!copy.empty())
-      {
-        assert(copy.top()->GetState() == JobState_Pending);
-        copy.pop();
-      }
+      assert((*it)->GetState() == JobState_Pending);
     }
 
     assert(completedJobs_.size() <= maxCompletedJobs_);
@@ -506,14 +586,17 @@ namespace Orthanc
   {
     while (completedJobs_.size() > maxCompletedJobs_)
     {
-      assert(completedJobs_.front() != NULL);
+      JobHandler* oldest = *completedJobs_.begin();
+      assert(oldest != NULL);
 
-      std::string id = completedJobs_.front()->GetId();
+      std::string id = oldest->GetId();
       assert(jobsIndex_.find(id) != jobsIndex_.end());
 
       jobsIndex_.erase(id);
-      delete(completedJobs_.front());
-      completedJobs_.pop_front();
+      completedJobs_.erase(completedJobs_.begin());
+      delete oldest;
+
+      modifiedJobs_.insert(id);
     }
 
     CheckInvariants();
@@ -524,8 +607,9 @@ namespace Orthanc
                                      bool success)
   {
     job.SetState(success ? JobState_Success : JobState_Failure);
+    job.SetSequence(sequence_++);
 
-    completedJobs_.push_back(&job);
+    completedJobs_.insert(&job);
     someJobComplete_.notify_all();
   }
 
@@ -586,6 +670,23 @@ namespace Orthanc
   void JobsRegistry::MarkRunningAsRetry(JobHandler& job,
                                         unsigned int timeout)
   {
+    const unsigned int previousRetries = job.IncrementRetryCount();
+
+    RetryBackoff::const_iterator backoff = retryBackoff_.find(job.GetJobType());
+    if (backoff != retryBackoff_.end())
+    {
+      // Exponential backoff, with a random jitter so that the jobs
+      // that failed at the same time are not retried all at once
+      uint64_t delay = std::max(1u, timeout);
+      for (unsigned int i = 0; i < previousRetries && delay < backoff->second; i++)
+      {
+        delay *= 2;
+      }
+
+      delay = std::min(delay, static_cast<uint64_t>(backoff->second));
+      timeout = static_cast<unsigned int>(delay / 2 + rand() % (delay / 2 + 1));
+    }
+
     LOG(INFO) << "Job scheduled for retry in " << timeout << "ms: " << job.GetId();
 
     CheckInvariants();
@@ -593,8 +694,15 @@ namespace Orthanc
     assert(job.GetState() == JobState_Running &&
            retryJobs_.find(&job) == retryJobs_.end());
 
-    retryJobs_.insert(&job);
+    // The retry time must be set before inserting into "retryJobs_"
     job.SetRetryState(timeout);
+    retryJobs_.insert(&job);
+
+    if (*retryJobs_.begin() == &job)
+    {
+      // Wake up the retry handler, that waits for the earliest retry
+      retryJobAvailable_.notify_all();
+    }
 
     CheckInvariants();
   }
@@ -643,7 +751,7 @@ namespace Orthanc
 
   void JobsRegistry::SetMaxCompletedJobs(size_t n)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
     LastModificationTimeUpdater updater(*this);
     CheckInvariants();
 
@@ -656,7 +764,7 @@ namespace Orthanc
 
   size_t JobsRegistry::GetMaxCompletedJobs()
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
     CheckInvariants();
     return maxCompletedJobs_;
   }
@@ -664,7 +772,7 @@ namespace Orthanc
 
   void JobsRegistry::ListJobs(std::set<std::string>& target)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
     CheckInvariants();
 
     for (JobsIndex::const_iterator it = jobsIndex_.begin();
@@ -675,10 +783,98 @@ namespace Orthanc
   }
 
 
+  template <typename Container>
+  static void ListFromIndex(std::list<std::string>& target,
+                            const Container& jobs,
+                            JobState state,
+                            size_t since,
+                            size_t limit)
+  {
+    size_t skipped = 0;
+
+    for (typename Container::const_iterator it = jobs.begin(); it != jobs.end(); ++it)
+    {
+      if (limit != 0 &&
+          target.size() >= limit)
+      {
+        return;
+      }
+      else if ((*it)->GetState() == state)
+      {
+        if (skipped < since)
+        {
+          skipped++;
+        }
+        else
+        {
+          target.push_back((*it)->GetId());
+        }
+      }
+    }
+  }
+
+
+  void JobsRegistry::ListJobs(std::list<std::string>& target,
+                              JobState state,
+                              size_t since,
+                              size_t limit)
+  {
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    CheckInvariants();
+
+    target.clear();
+
+    switch (state)
+    {
+      case JobState_Pending:
+        ListFromIndex(target, pendingJobs_, state, since, limit);
+        break;
+
+      case JobState_Retry:
+        ListFromIndex(target, retryJobs_, state, since, limit);
+        break;
+
+      case JobState_Success:
+      case JobState_Failure:
+        ListFromIndex(target, completedJobs_, state, since, limit);
+        break;
+
+      case JobState_Running:
+      case JobState_Paused:
+      {
+        // These jobs are not indexed, but their number is bounded by
+        // the number of workers and by the user actions
+        size_t skipped = 0;
+
+        for (JobsIndex::const_iterator it = jobsIndex_.begin();
+             it != jobsIndex_.end() && (limit == 0 || target.size() < limit); ++it)
+        {
+          if (it->second->GetState() == state)
+          {
+            if (skipped < since)
+            {
+              skipped++;
+            }
+            else
+            {
+              target.push_back(it->first);
+            }
+          }
+        }
+
+        break;
+      }
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
   bool JobsRegistry::GetJobInfo(JobInfo& target,
                                 const std::string& id)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
     CheckInvariants();
 
     JobsIndex::const_iterator found = jobsIndex_.find(id);
@@ -707,8 +903,8 @@ namespace Orthanc
   {
     LOG(INFO) << "Deleting job: " << id;
 
-    boost::mutex::scoped_lock lock(mutex_);
-    LastModificationTimeUpdater updater(*this);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    LastModificationTimeUpdater updater(*this, id);
     CheckInvariants();
 
     JobsIndex::iterator found = jobsIndex_.find(id);
@@ -720,22 +916,24 @@ namespace Orthanc
     }
     else
     {
-      for (CompletedJobs::iterator it = completedJobs_.begin();
-           it != completedJobs_.end(); ++it)
+      if (found->second->GetState() == JobState_Success ||
+          found->second->GetState() == JobState_Failure)
       {
-        if (*it == found->second)
-        {
-          found->second->GetJob().DeleteAllOutputs();
-          delete found->second;
-          
-          completedJobs_.erase(it);
-          jobsIndex_.erase(id);
-          return true;
-        }
-      }
+        JobHandler* handler = found->second;
+        assert(completedJobs_.find(handler) != completedJobs_.end());
 
-      LOG(WARNING) << "Can not delete a job that is not complete: " << id;
-      return false;
+        completedJobs_.erase(handler);
+        jobsIndex_.erase(found);
+
+        handler->GetJob().DeleteAllOutputs();
+        delete handler;
+        return true;
+      }
+      else
+      {
+        LOG(WARNING) << "Can not delete a job that is not complete: " << id;
+        return false;
+      }
     }
   }
 
@@ -746,7 +944,7 @@ namespace Orthanc
                                   const std::string& job,
                                   const std::string& key)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
     CheckInvariants();
 
     JobsIndex::const_iterator found = jobsIndex_.find(job);
@@ -773,8 +971,8 @@ namespace Orthanc
   bool JobsRegistry::DeleteJobOutput(const std::string& job,
                                      const std::string& key)
   {
-    boost::mutex::scoped_lock lock(mutex_);
-    LastModificationTimeUpdater updater(*this);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    LastModificationTimeUpdater updater(*this, job);
     CheckInvariants();
 
     JobsIndex::const_iterator found = jobsIndex_.find(job);
@@ -811,8 +1009,8 @@ namespace Orthanc
     std::unique_ptr<JobHandler>  protection(handler);
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
-      LastModificationTimeUpdater updater(*this);
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+      LastModificationTimeUpdater updater(*this, id);
       CheckInvariants();
 
       id = handler->GetId();
@@ -826,8 +1024,7 @@ namespace Orthanc
         case JobState_Retry:
         case JobState_Running:
           handler->SetState(JobState_Pending);
-          pendingJobs_.push(handler);
-          pendingJobAvailable_.notify_one();
+          AddPendingJob(*handler);
           break;
 
         case JobState_Success:
@@ -874,6 +1071,7 @@ namespace Orthanc
 
   JobsRegistry::JobsRegistry(size_t maxCompletedJobs) :
     lastModificationTime_(boost::posix_time::neg_infin),
+    sequence_(0),
     maxCompletedJobs_(maxCompletedJobs),
     observer_(NULL)
   {
@@ -901,8 +1099,21 @@ namespace Orthanc
                                    int priority)
   {
     std::string id;
+    SubmitAndWait(successContent, id, job, priority, 0 /* wait forever */);
+  }
+
+
+  bool JobsRegistry::SubmitAndWait(Json::Value& successContent,
+                                   std::string& id,
+                                   IJob* job,        // Takes ownership
+                                   int priority,
+                                   unsigned int timeout)
+  {
     Submit(id, job, priority);
 
+    const boost::system_time deadline = (boost::get_system_time() +
+                                         boost::posix_time::milliseconds(timeout));
+
     JobState state = JobState_Pending;  // Dummy initialization
 
     {
@@ -965,13 +1176,18 @@ namespace Orthanc
             successContent = status.GetPublicContent();
           }
 
-          return;
+          return true;
         }
-        else
+        else if (timeout == 0)
         {
           // This job has not finished yet, wait for new completion
           someJobComplete_.wait(lock);
         }
+        else if (!someJobComplete_.timed_wait(lock, deadline))
+        {
+          // The job is still running in the background
+          return false;
+        }
       }
     }
   }
@@ -982,8 +1198,8 @@ namespace Orthanc
   {
     LOG(INFO) << "Changing priority to " << priority << " for job: " << id;
 
-    boost::mutex::scoped_lock lock(mutex_);
-    LastModificationTimeUpdater updater(*this);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    LastModificationTimeUpdater updater(*this, id);
     CheckInvariants();
 
     JobsIndex::iterator found = jobsIndex_.find(id);
@@ -995,22 +1211,20 @@ namespace Orthanc
     }
     else
     {
-      found->second->SetPriority(priority);
-
       if (found->second->GetState() == JobState_Pending)
       {
-        // If the job is pending, we need to reconstruct the
-        // priority queue, as the heap condition has changed
-
-        PendingJobs copy;
-        std::swap(copy, pendingJobs_);
-
-        assert(pendingJobs_.empty());
-        while (!copy.empty())
-        {
-          pendingJobs_.push(copy.top());
-          copy.pop();
-        }
+        // The key of a pending job must not change while it lies in
+        // the ordered set: Remove the job, then insert it back
+        PendingJobs::iterator item = pendingJobs_.find(found->second);
+        assert(item != pendingJobs_.end());
+        pendingJobs_.erase(item);
+
+        found->second->SetPriority(priority);
+        pendingJobs_.insert(found->second);
+      }
+      else
+      {
+        found->second->SetPriority(priority);
       }
 
       CheckInvariants();
@@ -1019,23 +1233,20 @@ namespace Orthanc
   }
 
 
-  void JobsRegistry::RemovePendingJob(const std::string& id)
+  void JobsRegistry::AddPendingJob(JobHandler& job)
   {
-    // If the job is pending, we need to reconstruct the priority
-    // queue to remove it
-    PendingJobs copy;
-    std::swap(copy, pendingJobs_);
+    assert(job.GetState() == JobState_Pending);
+    job.SetSequence(sequence_++);
+    pendingJobs_.insert(&job);
+    pendingJobAvailable_.notify_one();
+  }
 
-    assert(pendingJobs_.empty());
-    while (!copy.empty())
-    {
-      if (copy.top()->GetId() != id)
-      {
-        pendingJobs_.push(copy.top());
-      }
 
-      copy.pop();
-    }
+  void JobsRegistry::RemovePendingJob(JobHandler& job)
+  {
+    PendingJobs::iterator item = pendingJobs_.find(&job);
+    assert(item != pendingJobs_.end());
+    pendingJobs_.erase(item);
   }
 
 
@@ -1051,8 +1262,8 @@ namespace Orthanc
   {
     LOG(INFO) << "Pausing job: " << id;
 
-    boost::mutex::scoped_lock lock(mutex_);
-    LastModificationTimeUpdater updater(*this);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    LastModificationTimeUpdater updater(*this, id);
     CheckInvariants();
 
     JobsIndex::iterator found = jobsIndex_.find(id);
@@ -1067,7 +1278,7 @@ namespace Orthanc
       switch (found->second->GetState())
       {
         case JobState_Pending:
-          RemovePendingJob(id);
+          RemovePendingJob(*found->second);
           found->second->SetState(JobState_Paused);
           break;
 
@@ -1100,8 +1311,8 @@ namespace Orthanc
   {
     LOG(INFO) << "Canceling job: " << id;
 
-    boost::mutex::scoped_lock lock(mutex_);
-    LastModificationTimeUpdater updater(*this);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    LastModificationTimeUpdater updater(*this, id);
     CheckInvariants();
 
     JobsIndex::iterator found = jobsIndex_.find(id);
@@ -1116,7 +1327,7 @@ namespace Orthanc
       switch (found->second->GetState())
       {
         case JobState_Pending:
-          RemovePendingJob(id);
+          RemovePendingJob(*found->second);
           SetCompletedJob(*found->second, false);
           found->second->SetLastErrorCode(ErrorCode_CanceledJob);
           break;
@@ -1158,8 +1369,8 @@ namespace Orthanc
   {
     LOG(INFO) << "Resuming job: " << id;
 
-    boost::mutex::scoped_lock lock(mutex_);
-    LastModificationTimeUpdater updater(*this);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    LastModificationTimeUpdater updater(*this, id);
     CheckInvariants();
 
     JobsIndex::iterator found = jobsIndex_.find(id);
@@ -1177,8 +1388,7 @@ namespace Orthanc
     else
     {
       found->second->SetState(JobState_Pending);
-      pendingJobs_.push(found->second);
-      pendingJobAvailable_.notify_one();
+      AddPendingJob(*found->second);
       CheckInvariants();
       return true;
     }
@@ -1189,8 +1399,8 @@ namespace Orthanc
   {
     LOG(INFO) << "Resubmitting failed job: " << id;
 
-    boost::mutex::scoped_lock lock(mutex_);
-    LastModificationTimeUpdater updater(*this);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    LastModificationTimeUpdater updater(*this, id);
     CheckInvariants();
 
     JobsIndex::iterator found = jobsIndex_.find(id);
@@ -1209,25 +1419,13 @@ namespace Orthanc
     {
       found->second->GetJob().Reset();
 
-      bool ok = false;
-      for (CompletedJobs::iterator it = completedJobs_.begin();
-           it != completedJobs_.end(); ++it)
-      {
-        if (*it == found->second)
-        {
-          ok = true;
-          completedJobs_.erase(it);
-          break;
-        }
-      }
-
-      (void) ok;  // Remove warning about unused variable in release builds
-      assert(ok);
+      CompletedJobs::iterator item = completedJobs_.find(found->second);
+      assert(item != completedJobs_.end());
+      completedJobs_.erase(item);
 
       found->second->ResetRuntime();
       found->second->SetState(JobState_Pending);
-      pendingJobs_.push(found->second);
-      pendingJobAvailable_.notify_one();
+      AddPendingJob(*found->second);
 
       CheckInvariants();
       return true;
@@ -1236,30 +1434,54 @@ namespace Orthanc
 
 
   void JobsRegistry::ScheduleRetries()
+  {
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    ScheduleRetriesInternal();
+  }
+
+
+  void JobsRegistry::WaitAndScheduleRetries(unsigned int timeout)
   {
     boost::mutex::scoped_lock lock(mutex_);
-    CheckInvariants();
 
-    RetryJobs copy;
-    std::swap(copy, retryJobs_);
+    boost::posix_time::ptime deadline = (boost::posix_time::microsec_clock::universal_time() +
+                                         boost::posix_time::milliseconds(timeout));
+
+    // The retry jobs are sorted by increasing retry time: Only the
+    // earliest one has to be waited for
+    if (!retryJobs_.empty() &&
+        (*retryJobs_.begin())->GetRetryTime() < deadline)
+    {
+      deadline = (*retryJobs_.begin())->GetRetryTime();
+    }
+
+    if (deadline > boost::posix_time::microsec_clock::universal_time())
+    {
+      retryJobAvailable_.timed_wait(lock, deadline);
+    }
+
+    ScheduleRetriesInternal();
+  }
+
+
+  void JobsRegistry::ScheduleRetriesInternal()
+  {
+    // The mutex must be locked
+    CheckInvariants();
 
     const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
 
-    assert(retryJobs_.empty());
-    for (RetryJobs::iterator it = copy.begin(); it != copy.end(); ++it)
+    // The retry jobs are sorted by increasing retry time
+    while (!retryJobs_.empty() &&
+           (*retryJobs_.begin())->IsRetryReady(now))
     {
-      if ((*it)->IsRetryReady(now))
-      {
-        LastModificationTimeUpdater updater(*this);
-        LOG(INFO) << "Retrying job: " << (*it)->GetId();
-        (*it)->SetState(JobState_Pending);
-        pendingJobs_.push(*it);
-        pendingJobAvailable_.notify_one();
-      }
-      else
-      {
-        retryJobs_.insert(*it);
-      }
+      JobHandler* job = *retryJobs_.begin();
+      retryJobs_.erase(retryJobs_.begin());
+
+      LastModificationTimeUpdater updater(*this, job->GetId());
+      LOG(INFO) << "Retrying job: " << job->GetId();
+      job->SetState(JobState_Pending);
+      AddPendingJob(*job);
     }
 
     CheckInvariants();
@@ -1269,25 +1491,85 @@ namespace Orthanc
   bool JobsRegistry::GetState(JobState& state,
                               const std::string& id)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
     return GetStateInternal(state, id);
   }
 
 
   void JobsRegistry::SetObserver(JobsRegistry::IObserver& observer)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
     observer_ = &observer;
   }
 
 
   void JobsRegistry::ResetObserver()
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
     observer_ = NULL;
   }
 
 
+  void JobsRegistry::SetRetryBackoff(const std::string& jobType,
+                                     unsigned int maxTimeout)
+  {
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+
+    if (maxTimeout == 0)
+    {
+      retryBackoff_.erase(jobType);
+    }
+    else
+    {
+      retryBackoff_[jobType] = maxTimeout;
+    }
+  }
+
+
+  JobsRegistry::JobHandler* JobsRegistry::LookupNextPendingJob() const
+  {
+    // The mutex must be locked
+    for (PendingJobs::const_iterator it = pendingJobs_.begin(); it != pendingJobs_.end(); ++it)
+    {
+      JobTypesCounts::const_iterator limit = maxRunningJobs_.find((*it)->GetJobType());
+
+      if (limit == maxRunningJobs_.end())
+      {
+        return *it;
+      }
+      else
+      {
+        JobTypesCounts::const_iterator running = runningJobsPerType_.find((*it)->GetJobType());
+        if (running == runningJobsPerType_.end() ||
+            running->second < limit->second)
+        {
+          return *it;
+        }
+      }
+    }
+
+    return NULL;
+  }
+
+
+  void JobsRegistry::SetMaxRunningJobs(const std::string& jobType,
+                                       unsigned int maxRunning)
+  {
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+
+    if (maxRunning == 0)
+    {
+      maxRunningJobs_.erase(jobType);
+    }
+    else
+    {
+      maxRunningJobs_[jobType] = maxRunning;
+    }
+
+    pendingJobAvailable_.notify_all();
+  }
+
+
   JobsRegistry::RunningJob::RunningJob(JobsRegistry& registry,
                                        unsigned int timeout) :
     registry_(registry),
@@ -1299,7 +1581,9 @@ namespace Orthanc
     {
       boost::mutex::scoped_lock lock(registry_.mutex_);
 
-      while (registry_.pendingJobs_.empty())
+      JobHandler* next = NULL;
+
+      while ((next = registry_.LookupNextPendingJob()) == NULL)
       {
         if (timeout == 0)
         {
@@ -1317,10 +1601,12 @@ namespace Orthanc
         }
       }
 
-      LastModificationTimeUpdater updater(registry_);
+      LastModificationTimeUpdater updater(registry_, id_);
 
-      handler_ = registry_.pendingJobs_.top();
-      registry_.pendingJobs_.pop();
+      handler_ = next;
+      registry_.RemovePendingJob(*handler_);
+
+      registry_.runningJobsPerType_[handler_->GetJobType()]++;
 
       assert(handler_->GetState() == JobState_Pending);
       handler_->SetState(JobState_Running);
@@ -1337,8 +1623,28 @@ namespace Orthanc
   {
     if (IsValid())
     {
-      boost::mutex::scoped_lock lock(registry_.mutex_);
-      LastModificationTimeUpdater updater(registry_);
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, registry_.mutex_, jobsRegistryLockProfiler_);
+      LastModificationTimeUpdater updater(registry_, id_);
+
+      // Must be done before changing the state, as the handler might
+      // be deleted if the history of the jobs is full
+      JobTypesCounts::iterator running = registry_.runningJobsPerType_.find(handler_->GetJobType());
+      if (running != registry_.runningJobsPerType_.end())
+      {
+        assert(running->second > 0);
+        running->second--;
+
+        if (running->second == 0)
+        {
+          registry_.runningJobsPerType_.erase(running);
+        }
+      }
+
+      if (registry_.maxRunningJobs_.find(handler_->GetJobType()) != registry_.maxRunningJobs_.end())
+      {
+        // Some pending job of the same type might now be dispatched
+        registry_.pendingJobAvailable_.notify_all();
+      }
 
       try
       {
@@ -1428,7 +1734,7 @@ namespace Orthanc
     }
     else
     {
-      boost::mutex::scoped_lock lock(registry_.mutex_);
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, registry_.mutex_, jobsRegistryLockProfiler_);
       registry_.CheckInvariants();
       assert(handler_->GetState() == JobState_Running);
 
@@ -1445,7 +1751,7 @@ namespace Orthanc
     }
     else
     {
-      boost::mutex::scoped_lock lock(registry_.mutex_);
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, registry_.mutex_, jobsRegistryLockProfiler_);
       registry_.CheckInvariants();
       assert(handler_->GetState() == JobState_Running);
 
@@ -1534,8 +1840,8 @@ namespace Orthanc
       JobStatus status(code, details, *job_);
       status.GetErrorPayload() = errorPayload;
 
-      boost::mutex::scoped_lock lock(registry_.mutex_);
-      LastModificationTimeUpdater updater(registry_);
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, registry_.mutex_, jobsRegistryLockProfiler_);
+      LastModificationTimeUpdater updater(registry_, id_);
       registry_.CheckInvariants();
       assert(handler_->GetState() == JobState_Running);
 
@@ -1555,8 +1861,8 @@ namespace Orthanc
     {
       JobStatus status(code, details, *job_);
 
-      boost::mutex::scoped_lock lock(registry_.mutex_);
-      LastModificationTimeUpdater updater(registry_);
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, registry_.mutex_, jobsRegistryLockProfiler_);
+      LastModificationTimeUpdater updater(registry_, id_);
       registry_.CheckInvariants();
       assert(handler_->GetState() == JobState_Running);
 
@@ -1568,7 +1874,7 @@ namespace Orthanc
 
   void JobsRegistry::Serialize(Json::Value& target)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
     CheckInvariants();
 
     target = Json::objectValue;
@@ -1591,93 +1897,157 @@ namespace Orthanc
                              const Json::Value& s,
                              size_t maxCompletedJobs) :
     lastModificationTime_(boost::posix_time::neg_infin),
+    sequence_(0),
     maxCompletedJobs_(maxCompletedJobs),
     observer_(NULL)
   {
-    if (SerializationToolbox::ReadString(s, TYPE) != JOBS_REGISTRY ||
-        !s.isMember(JOBS) ||
-        s[JOBS].type() != Json::objectValue)
+    AddSerializedJobs(unserializer, s);
+  }
+
+
+  bool JobsRegistry::UnserializeJob(IJobUnserializer& unserializer,
+                                    const std::string& id,
+                                    const Json::Value& serialized)
+  {
+    std::unique_ptr<JobHandler> job;
+
+    try
     {
-      throw OrthancException(ErrorCode_BadFileFormat);
+      job.reset(new JobHandler(unserializer, serialized, id));
+    }
+    catch (OrthancException& e)
+    {
+      LOG(WARNING) << "Cannot unserialize one job from previous execution, "
+                   << "skipping it: " << e.What();
+      return false;
     }
 
-    Json::Value::Members members = s[JOBS].getMemberNames();
+    const boost::posix_time::ptime lastChangeTime = job->GetLastStateChangeTime();
 
-    for (Json::Value::Members::const_iterator it = members.begin();
-         it != members.end(); ++it)
+    std::string submittedId;
+    SubmitInternal(submittedId, job.release(), true);
+
+    // Check whether the job has not been removed (which could be
+    // the case if the "maxCompletedJobs_" value gets smaller)
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    JobsIndex::iterator found = jobsIndex_.find(submittedId);
+    if (found != jobsIndex_.end())
     {
-      std::unique_ptr<JobHandler> job;
+      // The job still lies in the history: Update the time of its
+      // last change to the time that was serialized
+      assert(found->second != NULL);
+      found->second->SetLastStateChangeTime(lastChangeTime);
+    }
 
-      try
+    return true;
+  }
+
+
+  void JobsRegistry::SerializeModifiedJobs(std::map<std::string, Json::Value>& modified,
+                                           std::set<std::string>& removed)
+  {
+    modified.clear();
+    removed.clear();
+
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    CheckInvariants();
+
+    for (std::set<std::string>::const_iterator it = modifiedJobs_.begin();
+         it != modifiedJobs_.end(); ++it)
+    {
+      JobsIndex::const_iterator found = jobsIndex_.find(*it);
+
+      Json::Value v;
+      if (found != jobsIndex_.end() &&
+          found->second->Serialize(v))
       {
-        job.reset(new JobHandler(unserializer, s[JOBS][*it], *it));
+        modified[*it] = v;
       }
-      catch (OrthancException& e)
+      else
       {
-        LOG(WARNING) << "Cannot unserialize one job from previous execution, "
-                     << "skipping it: " << e.What();
-        continue;
+        removed.insert(*it);
       }
+    }
+
+    modifiedJobs_.clear();
+  }
 
-      const boost::posix_time::ptime lastChangeTime = job->GetLastStateChangeTime();
 
-      std::string id;
-      SubmitInternal(id, job.release(), true);
+  void JobsRegistry::MarkModifiedJobs(const std::set<std::string>& jobs)
+  {
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    modifiedJobs_.insert(jobs.begin(), jobs.end());
+  }
+
 
-      // Check whether the job has not been removed (which could be
-      // the case if the "maxCompletedJobs_" value gets smaller)
-      JobsIndex::iterator found = jobsIndex_.find(id);
-      if (found != jobsIndex_.end())
+  bool JobsRegistry::AddSerializedJob(IJobUnserializer& unserializer,
+                                      const std::string& id,
+                                      const Json::Value& serialized)
+  {
+    if (UnserializeJob(unserializer, id, serialized))
+    {
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+
+      if (jobsIndex_.find(id) != jobsIndex_.end())
       {
-        // The job still lies in the history: Update the time of its
-        // last change to the time that was serialized
-        assert(found->second != NULL);
-        found->second->SetLastStateChangeTime(lastChangeTime);
+        // The job is already saved as such. Otherwise, it was
+        // immediately forgotten, and must be removed from the storage.
+        modifiedJobs_.erase(id);
       }
+
+      return true;
+    }
+    else
+    {
+      return false;
     }
   }
 
 
-  void JobsRegistry::GetStatistics(unsigned int& pending,
-                                   unsigned int& running)
+  size_t JobsRegistry::AddSerializedJobs(IJobUnserializer& unserializer,
+                                        const Json::Value& s)
   {
-    boost::mutex::scoped_lock lock(mutex_);
-    CheckInvariants();
+    if (SerializationToolbox::ReadString(s, TYPE) != JOBS_REGISTRY ||
+        !s.isMember(JOBS) ||
+        s[JOBS].type() != Json::objectValue)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
 
-    pending = 0;
-    running = 0;
+    Json::Value::Members members = s[JOBS].getMemberNames();
 
-    for (JobsIndex::const_iterator it = jobsIndex_.begin();
-         it != jobsIndex_.end(); ++it)
-    {
-      const JobHandler& job = *it->second;
+    size_t count = 0;
 
-      switch (job.GetState())
+    for (Json::Value::Members::const_iterator it = members.begin();
+         it != members.end(); ++it)
+    {
+      if (UnserializeJob(unserializer, *it, s[JOBS][*it]))
       {
-        case JobState_Retry:
-        case JobState_Pending:
-          pending ++;
-          break;
+        count++;
+      }
+    }
 
-        case JobState_Paused:
-        case JobState_Running:
-          running ++;
-          break;
+    return count;
+  }
 
-        case JobState_Success:
-        case JobState_Failure:
-          // not counted since 1.12.11+
-          break;
 
-        default:
-          THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
-      }
-    }
+  void JobsRegistry::GetStatistics(unsigned int& pending,
+                                   unsigned int& running)
+  {
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
+    CheckInvariants();
+
+    // The completed jobs are not counted since 1.12.11+. This runs
+    // in constant time, as the jobs are indexed by state.
+    assert(pendingJobs_.size() + retryJobs_.size() + completedJobs_.size() <= jobsIndex_.size());
+    pending = static_cast<unsigned int>(pendingJobs_.size() + retryJobs_.size());
+    running = static_cast<unsigned int>(jobsIndex_.size() - pendingJobs_.size() -
+                                        retryJobs_.size() - completedJobs_.size());
   }
 
   void JobsRegistry::GetLastModificationTime(boost::posix_time::ptime& modificationTime) const
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex_, jobsRegistryLockProfiler_);
     
     modificationTime = lastModificationTime_;
   }
@@ -37,7 +37,7 @@
 
 #include <list>
 #include <set>
-#include <queue>
+#include <map>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 
@@ -59,6 +59,14 @@ namespace Orthanc
       virtual void SignalJobSuccess(const std::string& jobId) = 0;
 
       virtual void SignalJobFailure(const std::string& jobId) = 0;
+
+      // Called whenever the state, the progress or the priority of a
+      // job changes, or when the job is removed. The mutex of the
+      // registry is locked: The observer must not call the registry
+      // (new in Orthanc 1.12.12).
+      virtual void SignalJobUpdated(const std::string& jobId)
+      {
+      }
     };
 
   private:
@@ -72,18 +80,41 @@ namespace Orthanc
     class JobHandler;
     class LastModificationTimeUpdater;
 
+    // Highest priority first, then first in, first out
     struct PriorityComparator
     {
-      bool operator() (const JobHandler* const& a,
-                       const JobHandler* const& b) const;
+      bool operator() (const JobHandler* a,
+                       const JobHandler* b) const;
     };
 
-    typedef std::map<std::string, JobHandler*>              JobsIndex;
-    typedef std::list<JobHandler*>                          CompletedJobs;
-    typedef std::set<JobHandler*>                           RetryJobs;
-    typedef std::priority_queue<JobHandler*,
-                                std::vector<JobHandler*>,   // Could be a "std::deque"
-                                PriorityComparator>         PendingJobs;
+    // Order of completion, the oldest job first
+    struct CompletionComparator
+    {
+      bool operator() (const JobHandler* a,
+                       const JobHandler* b) const;
+    };
+
+    // Earliest retry time first
+    struct RetryComparator
+    {
+      bool operator() (const JobHandler* a,
+                       const JobHandler* b) const;
+    };
+
+    /**
+     * The jobs are indexed by state, so that submitting, scheduling,
+     * canceling or forgetting one job takes a logarithmic time, even
+     * with a very large number of jobs (new in Orthanc 1.12.12). The
+     * sets of pending and completed jobs are ordered by the "sequence
+     * number" of the handlers, that is assigned when the job enters
+     * the set, and that must not change while it is in the set.
+     **/
+    typedef std::map<std::string, JobHandler*>                        JobsIndex;
+    typedef std::set<JobHandler*, CompletionComparator>               CompletedJobs;
+    typedef std::set<JobHandler*, RetryComparator>                    RetryJobs;
+    typedef std::set<JobHandler*, PriorityComparator>                 PendingJobs;
+    typedef std::map<std::string, unsigned int>                       RetryBackoff;
+    typedef std::map<std::string, unsigned int>                       JobTypesCounts;
 
     mutable boost::mutex       mutex_;
     boost::posix_time::ptime   lastModificationTime_;
@@ -91,13 +122,27 @@ namespace Orthanc
     PendingJobs                pendingJobs_;
     CompletedJobs              completedJobs_;
     RetryJobs                  retryJobs_;
+    uint64_t                   sequence_;
 
     boost::condition_variable  pendingJobAvailable_;
     boost::condition_variable  someJobComplete_;
+    boost::condition_variable  retryJobAvailable_;
     size_t                     maxCompletedJobs_;
 
     IObserver*                 observer_;
 
+    // Jobs that were modified or removed since the last call to
+    // "SerializeModifiedJobs()" (new in Orthanc 1.12.12)
+    std::set<std::string>      modifiedJobs_;
+
+    // Maximum retry timeout of the job types with exponential backoff
+    RetryBackoff               retryBackoff_;
+
+    // Admission control: Maximum number of running jobs per job type,
+    // and number of running jobs of each type (new in Orthanc 1.12.12)
+    JobTypesCounts             maxRunningJobs_;
+    JobTypesCounts             runningJobsPerType_;
+
 
 #ifndef NDEBUG
     bool IsPendingJob(const JobHandler& job) const;
@@ -125,10 +170,20 @@ namespace Orthanc
     bool GetStateInternal(JobState& state,
                           const std::string& id);
 
-    void RemovePendingJob(const std::string& id);
+    void AddPendingJob(JobHandler& job);
+
+    void RemovePendingJob(JobHandler& job);
 
     void RemoveRetryJob(JobHandler* handler);
 
+    void ScheduleRetriesInternal();
+
+    JobHandler* LookupNextPendingJob() const;
+
+    bool UnserializeJob(IJobUnserializer& unserializer,
+                        const std::string& id,
+                        const Json::Value& serialized);
+
     void SubmitInternal(std::string& id,
                         JobHandler* handler,
                         bool fromSerialization);
@@ -148,6 +203,14 @@ namespace Orthanc
 
     void ListJobs(std::set<std::string>& target);
 
+    // List the jobs in one given state, by decreasing priority for
+    // the pending jobs and by completion time for the completed jobs.
+    // A "limit" of zero means no limit (new in Orthanc 1.12.12).
+    void ListJobs(std::list<std::string>& target,
+                  JobState state,
+                  size_t since,
+                  size_t limit);
+
     bool GetJobInfo(JobInfo& target,
                     const std::string& id);
 
@@ -164,6 +227,40 @@ namespace Orthanc
 
     void Serialize(Json::Value& target);
 
+    /**
+     * Incremental serialization of the registry (new in Orthanc
+     * 1.12.12). "modified" receives, for each job that was created or
+     * modified since the previous call, its serialization (as done by
+     * "Serialize()"). "removed" receives the jobs that were deleted
+     * since the previous call, or that cannot be serialized.
+     **/
+    void SerializeModifiedJobs(std::map<std::string, Json::Value>& modified,
+                               std::set<std::string>& removed);
+
+    // Report the given jobs again by the next call to
+    // "SerializeModifiedJobs()", typically because they could not be
+    // saved (new in Orthanc 1.12.12)
+    void MarkModifiedJobs(const std::set<std::string>& jobs);
+
+    /**
+     * Add one job that was serialized during a previous execution
+     * (new in Orthanc 1.12.12), which allows to reload the registry
+     * one job at a time. Returns "false" if the job cannot be
+     * unserialized. The job is not reported as modified.
+     **/
+    bool AddSerializedJob(IJobUnserializer& unserializer,
+                          const std::string& id,
+                          const Json::Value& serialized);
+
+    /**
+     * Add all the jobs of a registry that was serialized as a whole
+     * by "Serialize()" (new in Orthanc 1.12.12). Contrarily to the
+     * constructor, this can be invoked while the jobs engine is
+     * running. Returns the number of jobs that were unserialized.
+     **/
+    size_t AddSerializedJobs(IJobUnserializer& unserializer,
+                             const Json::Value& serialized);
+
     void Submit(std::string& id,
                 IJob* job,        // Takes ownership
                 int priority);
@@ -175,6 +272,16 @@ namespace Orthanc
                        IJob* job,        // Takes ownership
                        int priority);
 
+    // New in Orthanc 1.12.12. Returns "false" if the job has not
+    // completed after "timeout" milliseconds ("0" means to wait
+    // forever), in which case the job keeps running and "id" can be
+    // used to monitor it.
+    bool SubmitAndWait(Json::Value& successContent,
+                       std::string& id,
+                       IJob* job,        // Takes ownership
+                       int priority,
+                       unsigned int timeout);
+
     bool SetPriority(const std::string& id,
                      int priority);
 
@@ -188,6 +295,30 @@ namespace Orthanc
 
     void ScheduleRetries();
 
+    // Waits for at most "timeout" milliseconds, or until the earliest
+    // retry time is reached, then schedules the jobs to be retried
+    void WaitAndScheduleRetries(unsigned int timeout);
+
+    /**
+     * Enables the exponential backoff of the retries of one type of
+     * jobs (new in Orthanc 1.12.12). The timeout of the retry that is
+     * requested by the job is doubled after each consecutive retry,
+     * up to "maxTimeout" milliseconds, with a random jitter between
+     * half and all of this value. "0" disables the backoff.
+     **/
+    void SetRetryBackoff(const std::string& jobType,
+                         unsigned int maxTimeout);
+
+    /**
+     * Limits the number of jobs of one type that run at the same time
+     * (new in Orthanc 1.12.12). The pending jobs of this type wait
+     * until a running job of this type stops, while the pending jobs
+     * of the other types are dispatched, even if their priority is
+     * lower. "0" removes the limit.
+     **/
+    void SetMaxRunningJobs(const std::string& jobType,
+                           unsigned int maxRunning);
+
     bool GetState(JobState& state,
                   const std::string& id);
 
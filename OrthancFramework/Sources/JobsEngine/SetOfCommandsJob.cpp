@@ -25,19 +25,26 @@
 #include "../PrecompiledHeaders.h"
 #include "SetOfCommandsJob.h"
 
+#include "../ElapsedTimer.h"
 #include "../Logging.h"
 #include "../OrthancException.h"
 #include "../SerializationToolbox.h"
 
+#include <boost/thread/mutex.hpp>
 #include <cassert>
 #include <memory>
 
 namespace Orthanc
 {
+  static boost::mutex defaultStepDurationMutex_;
+  static unsigned int defaultStepDuration_ = 0;
+
+
   SetOfCommandsJob::SetOfCommandsJob() :
     started_(false),
     permissive_(false),
-    position_(0)
+    position_(0),
+    stepDuration_(GetDefaultStepDuration())
   {
   }
 
@@ -170,6 +177,32 @@ namespace Orthanc
   }
       
 
+  void SetOfCommandsJob::SetStepDuration(unsigned int milliseconds)
+  {
+    stepDuration_ = milliseconds;
+  }
+
+
+  unsigned int SetOfCommandsJob::GetStepDuration() const
+  {
+    return stepDuration_;
+  }
+
+
+  void SetOfCommandsJob::SetDefaultStepDuration(unsigned int milliseconds)
+  {
+    boost::mutex::scoped_lock lock(defaultStepDurationMutex_);
+    defaultStepDuration_ = milliseconds;
+  }
+
+
+  unsigned int SetOfCommandsJob::GetDefaultStepDuration()
+  {
+    boost::mutex::scoped_lock lock(defaultStepDurationMutex_);
+    return defaultStepDuration_;
+  }
+
+
   JobStepResult SetOfCommandsJob::Step(const std::string& jobId)
   {
     if (!started_)
@@ -191,41 +224,49 @@ namespace Orthanc
       throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
 
-    try
+    ElapsedTimer timer;
+
+    for (;;)
     {
-      // Not at the trailing step: Handle the current command
-      if (!commands_[position_]->Execute(jobId))
+      try
+      {
+        // Not at the trailing step: Handle the current command
+        if (!commands_[position_]->Execute(jobId))
+        {
+          // Error
+          if (!permissive_)
+          {
+            return JobStepResult::Failure(ErrorCode_InternalError, NULL);
+          }
+        }
+      }
+      catch (OrthancException& e)
       {
-        // Error
-        if (!permissive_)
+        if (permissive_)
         {
-          return JobStepResult::Failure(ErrorCode_InternalError, NULL);
+          LOG(WARNING) << "Ignoring an error in a permissive job: " << e.What();
+        }
+        else
+        {
+          return JobStepResult::Failure(e);
         }
       }
-    }
-    catch (OrthancException& e)
-    {
-      if (permissive_)
+
+      position_ += 1;
+
+      if (position_ == commands_.size())
       {
-        LOG(WARNING) << "Ignoring an error in a permissive job: " << e.What();
+        // We're done
+        return JobStepResult::Success();
       }
-      else
+      else if (stepDuration_ == 0 ||
+               timer.GetElapsedMilliseconds() >= stepDuration_)
       {
-        return JobStepResult::Failure(e);
+        // Give the hand back to the jobs engine, that can pause or
+        // cancel the job, and update its progress
+        return JobStepResult::Continue();
       }
     }
-
-    position_ += 1;
-
-    if (position_ == commands_.size())
-    {
-      // We're done
-      return JobStepResult::Success();
-    }
-    else
-    {
-      return JobStepResult::Continue();
-    }
   }
 
 
@@ -274,7 +315,8 @@ namespace Orthanc
 
   SetOfCommandsJob::SetOfCommandsJob(ICommandUnserializer* unserializer,
                                      const Json::Value& source) :
-    started_(false)
+    started_(false),
+    stepDuration_(GetDefaultStepDuration())
   {
     std::unique_ptr<ICommandUnserializer> raii(unserializer);
 
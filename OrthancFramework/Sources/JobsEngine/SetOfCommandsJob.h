@@ -64,6 +64,7 @@ namespace Orthanc
     size_t                  position_;
     std::string             description_;
     Json::Value             userData_;
+    unsigned int            stepDuration_;
 
   public:
     SetOfCommandsJob();
@@ -89,6 +90,23 @@ namespace Orthanc
 
     void SetPermissive(bool permissive);
 
+    /**
+     * Target duration of one step of the job, in milliseconds: The
+     * commands are executed one after the other until this duration
+     * is reached, which limits the bookkeeping of the jobs engine
+     * between the commands, while keeping the pause and cancellation
+     * responsive. "0" means that each step executes exactly one
+     * command (new in Orthanc 1.12.12).
+     **/
+    void SetStepDuration(unsigned int milliseconds);
+
+    unsigned int GetStepDuration() const;
+
+    // Default step duration of the jobs that are created afterward
+    static void SetDefaultStepDuration(unsigned int milliseconds);
+
+    static unsigned int GetDefaultStepDuration();
+
     virtual void Reset() ORTHANC_OVERRIDE;
     
     virtual void Start() ORTHANC_OVERRIDE;
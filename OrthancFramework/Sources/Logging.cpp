@@ -31,6 +31,10 @@
 #include <stdint.h>
 #include <string.h>
 
+#if ORTHANC_ENABLE_CPU_PROFILER == 1
+#  include "CpuProfiler.h"
+#endif
+
 #if defined(__linux__) && !defined(NDEBUG)
 #  include <pthread.h>
 #endif
@@ -1044,6 +1048,10 @@ namespace Orthanc
           writer.SetThreadName(name);
         }
 
+#if ORTHANC_ENABLE_CPU_PROFILER == 1
+        CpuProfiler::SetCurrentThreadName(name);
+#endif
+
 #if defined(__linux__) && !defined(NDEBUG) && !defined(__LSB_VERSION__)
         // set the thread name at "system" level too -> required to have the thread names visible in GDB !
         pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());  // thread names are limited to 15 in Linux
@@ -1074,8 +1082,14 @@ namespace Orthanc
     {
       if (pluginContext_ == NULL)
       {
-        ThreadsInformations::CurrentThreadWriter writer(threadsInformations_);
-        writer.ClearThreadName();
+        {
+          ThreadsInformations::CurrentThreadWriter writer(threadsInformations_);
+          writer.ClearThreadName();
+        }
+
+#if ORTHANC_ENABLE_CPU_PROFILER == 1
+        CpuProfiler::SetCurrentThreadName("");
+#endif
       }
       else if (hasClearThreadName_) // only recent runtimes support it (from 1.12.12)
       {
@@ -419,7 +419,7 @@ namespace Orthanc
     }
     else if (value.isArray())
     {
-      lua_newtable(lua_);
+      lua_createtable(lua_, static_cast<int>(value.size()), 0);
 
       // http://lua-users.org/wiki/SimpleLuaApiExample
       for (Json::Value::ArrayIndex i = 0; i < value.size(); i++)
@@ -436,18 +436,18 @@ namespace Orthanc
     }
     else if (value.isObject())
     {
-      lua_newtable(lua_);
+      lua_createtable(lua_, 0, static_cast<int>(value.size()));
 
-      Json::Value::Members members = value.getMemberNames();
-
-      for (Json::Value::Members::const_iterator 
-             it = members.begin(); it != members.end(); ++it)
+      // Iterate over the members, instead of looking up each name
+      // returned by "getMemberNames()"
+      for (Json::Value::const_iterator it = value.begin(); it != value.end(); ++it)
       {
         // Push the index of the cell
-        lua_pushlstring(lua_, it->c_str(), it->size());
+        const std::string key = it.key().asString();
+        lua_pushlstring(lua_, key.c_str(), key.size());
 
         // Push the value of the cell
-        PushJson(value[*it]);
+        PushJson(*it);
 
         // Stores the pair in the table
         lua_rawset(lua_, -3);
@@ -617,11 +617,33 @@ namespace Orthanc
   }
 
 
+  static bool IsPrecompiledChunk(const std::string& chunk)
+  {
+    // The signature of the binary chunks starts with the ESC
+    // character, both in Lua ("\033Lua") and in LuaJIT ("\033LJ")
+    return (!chunk.empty() &&
+            chunk[0] == '\033');
+  }
+
+
   void LuaContext::ExecuteInternal(std::string* output,
                                    const std::string& command)
+  {
+    if (IsPrecompiledChunk(command))
+    {
+      // Prevent the execution of forged bytecode, e.g. from the REST API
+      throw OrthancException(ErrorCode_CannotExecuteLua, "Precompiled Lua chunks can only be run by ExecuteCompiled()");
+    }
+
+    ExecuteChunk(output, command);
+  }
+
+
+  void LuaContext::ExecuteChunk(std::string* output,
+                                const std::string& chunk)
   {
     log_.clear();
-    int error = (luaL_loadbuffer(lua_, command.c_str(), command.size(), "line") ||
+    int error = (luaL_loadbuffer(lua_, chunk.c_str(), chunk.size(), "line") ||
                  lua_pcall(lua_, 0, 0, 0));
 
     if (error) 
@@ -640,6 +662,59 @@ namespace Orthanc
   }
 
 
+  static int WriteCompiledChunk(lua_State* /* state */,
+                                const void* data,
+                                size_t size,
+                                void* payload)
+  {
+    reinterpret_cast<std::string*>(payload)->append(reinterpret_cast<const char*>(data), size);
+    return 0;
+  }
+
+
+  void LuaContext::Compile(std::string& target,
+                           const std::string& command)
+  {
+    if (IsPrecompiledChunk(command))
+    {
+      target = command;
+      return;
+    }
+
+    if (luaL_loadbuffer(lua_, command.c_str(), command.size(), "line"))
+    {
+      assert(lua_gettop(lua_) >= 1);
+
+      std::string description(lua_tostring(lua_, -1));
+      lua_pop(lua_, 1); /* pop error message from the stack */
+      throw OrthancException(ErrorCode_CannotExecuteLua, description);
+    }
+
+    target.clear();
+
+    // The debug information is kept, so that the errors still report
+    // the line numbers of the scripts
+#if LUA_VERSION_NUM >= 503
+    int error = lua_dump(lua_, WriteCompiledChunk, &target, 0 /* don't strip */);
+#else
+    int error = lua_dump(lua_, WriteCompiledChunk, &target);
+#endif
+
+    lua_pop(lua_, 1);  /* pop the compiled function from the stack */
+
+    if (error != 0)
+    {
+      throw OrthancException(ErrorCode_CannotExecuteLua, "Cannot compile a Lua chunk");
+    }
+  }
+
+
+  void LuaContext::ExecuteCompiled(const std::string& compiled)
+  {
+    ExecuteChunk(NULL, compiled);
+  }
+
+
   bool LuaContext::IsExistingFunction(const char* name)
   {
     lua_settop(lua_, 0);
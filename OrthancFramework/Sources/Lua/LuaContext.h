@@ -85,6 +85,9 @@ namespace Orthanc
     void ExecuteInternal(std::string* output,
                          const std::string& command);
 
+    void ExecuteChunk(std::string* output,
+                      const std::string& chunk);
+
     static void GetJson(Json::Value& result,
                         lua_State* state,
                         int top,
@@ -105,6 +108,14 @@ namespace Orthanc
     void Execute(Json::Value& output,
                  const std::string& command);
 
+    // Compile a script into a binary chunk, without running it. The
+    // chunk can be run in any "LuaContext" of the same process, which
+    // avoids parsing the same scripts again (new in Orthanc 1.12.12).
+    void Compile(std::string& target,
+                 const std::string& command);
+
+    void ExecuteCompiled(const std::string& compiled);
+
     bool IsExistingFunction(const char* name);
 
     void RegisterFunction(const char* name,
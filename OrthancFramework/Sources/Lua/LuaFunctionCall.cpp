@@ -164,15 +164,19 @@ namespace Orthanc
 
   void LuaFunctionCall::PushStringMap(const std::map<std::string, std::string>& value)
   {
-    Json::Value json = Json::objectValue;
+    CheckAlreadyExecuted();
+
+    // The Lua table is directly created, without an intermediate JSON
+    lua_State* state = GetState();
+    lua_createtable(state, 0, static_cast<int>(value.size()));
 
     for (std::map<std::string, std::string>::const_iterator
            it = value.begin(); it != value.end(); ++it)
     {
-      json[it->first] = it->second;
+      lua_pushlstring(state, it->first.c_str(), it->first.size());
+      lua_pushlstring(state, it->second.c_str(), it->second.size());
+      lua_rawset(state, -3);
     }
-
-    PushJson(json);
   }
 
 
@@ -185,16 +189,29 @@ namespace Orthanc
 
   void LuaFunctionCall::PushDicom(const DicomArray& dicom)
   {
-    Json::Value value = Json::objectValue;
+    CheckAlreadyExecuted();
+
+    lua_State* state = GetState();
+    lua_createtable(state, 0, static_cast<int>(dicom.GetSize()));
 
     for (size_t i = 0; i < dicom.GetSize(); i++)
     {
       const DicomValue& v = dicom.GetElement(i).GetValue();
-      std::string s = (v.IsNull() || v.IsBinary()) ? "" : v.GetContent();
-      value[dicom.GetElement(i).GetTag().Format()] = s;
-    }
+      const std::string tag = dicom.GetElement(i).GetTag().Format();
+      lua_pushlstring(state, tag.c_str(), tag.size());
 
-    PushJson(value);
+      if (v.IsNull() || v.IsBinary())
+      {
+        lua_pushlstring(state, "", 0);
+      }
+      else
+      {
+        const std::string& s = v.GetContent();
+        lua_pushlstring(state, s.c_str(), s.size());
+      }
+
+      lua_rawset(state, -3);
+    }
   }
 
   void LuaFunctionCall::Execute()
@@ -0,0 +1,220 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeaders.h"
+#include "MemoryMappedFileBuffer.h"
+
+#include "Logging.h"
+#include "OrthancException.h"
+#include "SystemToolbox.h"
+
+#if defined(_WIN32)
+#  include <windows.h>
+#elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__)) || defined(__FreeBSD_kernel__) || defined(__FreeBSD__) || defined(__OpenBSD__)
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <string.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#else
+#  error Support your platform here
+#endif
+
+
+namespace Orthanc
+{
+  static uint64_t GetAllocationGranularity()
+  {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    return static_cast<uint64_t>(info.dwAllocationGranularity);
+#else
+    return static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+#endif
+  }
+
+
+  void MemoryMappedFileBuffer::Clear()
+  {
+    if (mapping_ != NULL)
+    {
+#if defined(_WIN32)
+      if (!::UnmapViewOfFile(mapping_))
+#else
+      if (::munmap(mapping_, mappingSize_) != 0)
+#endif
+      {
+        LOG(ERROR) << "Cannot unmap a memory-mapped file";
+      }
+
+      mapping_ = NULL;
+    }
+
+    mappingSize_ = 0;
+    data_ = NULL;
+    size_ = 0;
+  }
+
+
+  MemoryMappedFileBuffer::MemoryMappedFileBuffer(const boost::filesystem::path& path) :
+    mapping_(NULL),
+    mappingSize_(0),
+    data_(NULL),
+    size_(0)
+  {
+    // Delegating constructors are not available in C++03
+    MemoryMappedFileBuffer tmp(path, 0, SystemToolbox::GetFileSize(path));
+
+    std::swap(mapping_, tmp.mapping_);
+    std::swap(mappingSize_, tmp.mappingSize_);
+    std::swap(data_, tmp.data_);
+    std::swap(size_, tmp.size_);
+  }
+
+
+  MemoryMappedFileBuffer::MemoryMappedFileBuffer(const boost::filesystem::path& path,
+                                                 uint64_t start,
+                                                 uint64_t end) :
+    mapping_(NULL),
+    mappingSize_(0),
+    data_(NULL),
+    size_(0)
+  {
+    if (start > end)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (static_cast<uint64_t>(static_cast<size_t>(end - start)) != end - start)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory,
+                             "Cannot map such a large range of a file in a 32bit process");
+    }
+
+    if (start == end)
+    {
+      return;  // Nothing to map
+    }
+
+    // The offset of a mapping must be a multiple of the allocation granularity
+    const uint64_t granularity = GetAllocationGranularity();
+    const uint64_t alignedStart = (start / granularity) * granularity;
+    const size_t mappingSize = static_cast<size_t>(end - alignedStart);
+
+#if defined(_WIN32)
+    HANDLE file = ::CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+      throw OrthancException(ErrorCode_InexistentFile,
+                             "Cannot open file: " + SystemToolbox::PathToUtf8(path));
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!::GetFileSizeEx(file, &fileSize) ||
+        static_cast<uint64_t>(fileSize.QuadPart) < end)
+    {
+      ::CloseHandle(file);
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "Range is beyond the end of file: " + SystemToolbox::PathToUtf8(path));
+    }
+
+    HANDLE mapping = ::CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    ::CloseHandle(file);  // The mapping object keeps a reference to the file
+
+    if (mapping == NULL)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory,
+                             "Cannot map file into memory: " + SystemToolbox::PathToUtf8(path));
+    }
+
+    mapping_ = ::MapViewOfFile(mapping, FILE_MAP_READ,
+                               static_cast<DWORD>(alignedStart >> 32),
+                               static_cast<DWORD>(alignedStart & 0xffffffffu),
+                               mappingSize);
+    ::CloseHandle(mapping);  // The view keeps a reference to the mapping object
+
+    if (mapping_ == NULL)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory,
+                             "Cannot map file into memory: " + SystemToolbox::PathToUtf8(path));
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      throw OrthancException(ErrorCode_InexistentFile,
+                             "Cannot open file: " + SystemToolbox::PathToUtf8(path));
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 ||
+        static_cast<uint64_t>(info.st_size) < end)
+    {
+      ::close(fd);
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "Range is beyond the end of file: " + SystemToolbox::PathToUtf8(path));
+    }
+
+    void* mapping = ::mmap(NULL, mappingSize, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(alignedStart));
+    ::close(fd);  // The mapping keeps a reference to the file
+
+    if (mapping == MAP_FAILED)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory,
+                             "Cannot map file into memory: " + SystemToolbox::PathToUtf8(path) +
+                             " (" + std::string(strerror(errno)) + ")");
+    }
+
+    mapping_ = mapping;
+#endif
+
+    mappingSize_ = mappingSize;
+    data_ = reinterpret_cast<const char*>(mapping_) + (start - alignedStart);
+    size_ = static_cast<size_t>(end - start);
+  }
+
+
+  MemoryMappedFileBuffer::~MemoryMappedFileBuffer()
+  {
+    Clear();
+  }
+
+
+  void MemoryMappedFileBuffer::MoveToString(std::string& target)
+  {
+    if (size_ == 0)
+    {
+      target.clear();
+    }
+    else
+    {
+      target.assign(data_, size_);
+    }
+
+    Clear();
+  }
+}
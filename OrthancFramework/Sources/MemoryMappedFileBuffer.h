@@ -0,0 +1,85 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "OrthancFramework.h"
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 1
+#  error The class MemoryMappedFileBuffer cannot be used in sandboxed environments
+#endif
+
+#include "Compatibility.h"
+#include "IMemoryBuffer.h"
+
+#include <boost/filesystem.hpp>
+#include <stdint.h>  // For uint64_t
+
+
+namespace Orthanc
+{
+  /**
+   * Read-only memory buffer that maps a range of a file into the
+   * address space of the process, instead of copying it into the
+   * heap. The pages are loaded lazily by the operating system, which
+   * avoids large allocations when serving big files. New in Orthanc
+   * 1.12.12.
+   **/
+  class ORTHANC_PUBLIC MemoryMappedFileBuffer : public IMemoryBuffer
+  {
+  private:
+    void*        mapping_;      // Start of the mapped view (aligned on pages)
+    size_t       mappingSize_;
+    const char*  data_;         // Start of the requested range within the view
+    size_t       size_;
+
+    void Clear();
+
+  public:
+    // Maps the whole file
+    explicit MemoryMappedFileBuffer(const boost::filesystem::path& path);
+
+    MemoryMappedFileBuffer(const boost::filesystem::path& path,
+                           uint64_t start /* inclusive */,
+                           uint64_t end /* exclusive */);
+
+    virtual ~MemoryMappedFileBuffer();
+
+    virtual void MoveToString(std::string& target) ORTHANC_OVERRIDE;
+
+    virtual const void* GetData() const ORTHANC_OVERRIDE
+    {
+      return data_;
+    }
+
+    virtual size_t GetSize() const ORTHANC_OVERRIDE
+    {
+      return size_;
+    }
+  };
+}
@@ -29,13 +29,22 @@
 #include "Compatibility.h"
 #include "CompatibilityMath.h"
 #include "Logging.h"
+#include "MultiThreading/LockProfiler.h"
 #include "OrthancException.h"
 
+#include <boost/atomic.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
 
 
 namespace Orthanc
 {
+#if ORTHANC_ENABLE_LOCK_PROFILING == 1
+  static LockProfiler  metricsRegistryLockProfiler_("MetricsRegistry");
+#endif
+
   static const boost::posix_time::ptime GetNow()
   {
     return boost::posix_time::microsec_clock::universal_time();
@@ -250,6 +259,13 @@ namespace Orthanc
       return policy_;
     }
 
+    // Whether the item can be incremented while the registry is
+    // only locked in shared mode
+    virtual bool IsLockFree() const
+    {
+      return false;
+    }
+
     virtual void UpdateFloat(float value) = 0;
 
     virtual void UpdateInteger(int64_t value) = 0;
@@ -260,7 +276,7 @@ namespace Orthanc
 
     virtual bool HasValue() const = 0;
 
-    virtual const boost::posix_time::ptime& GetTime() const = 0;
+    virtual boost::posix_time::ptime GetTime() const = 0;
     
     virtual std::string FormatValue() const = 0;
 
@@ -306,7 +322,7 @@ namespace Orthanc
       return value_.HasValue();
     }
 
-    virtual const boost::posix_time::ptime& GetTime() const ORTHANC_OVERRIDE
+    virtual boost::posix_time::ptime GetTime() const ORTHANC_OVERRIDE
     {
       return value_.GetTime();
     }
@@ -364,7 +380,7 @@ namespace Orthanc
       return value_.HasValue();
     }
 
-    virtual const boost::posix_time::ptime& GetTime() const ORTHANC_OVERRIDE
+    virtual boost::posix_time::ptime GetTime() const ORTHANC_OVERRIDE
     {
       return value_.GetTime();
     }
@@ -386,6 +402,115 @@ namespace Orthanc
   };
 
 
+  class MetricsRegistry::CounterItem : public Item
+  {
+  private:
+    static const size_t SHARDS_COUNT = 16;
+
+    // Each shard has its own cache line, to avoid false sharing
+    struct Shard
+    {
+      boost::atomic<int64_t>  value_;
+      char                    padding_[64 - sizeof(boost::atomic<int64_t>)];
+    };
+
+    Shard  shards_[SHARDS_COUNT];
+
+    static size_t GetCurrentShard()
+    {
+      // Fibonacci hashing of the thread identifier, whose low-order
+      // bits are not well distributed if it derives from an address
+      const uint64_t h = static_cast<uint64_t>(boost::hash<boost::thread::id>()(boost::this_thread::get_id()));
+      return static_cast<size_t>((h * 0x9e3779b97f4a7c15ull) >> 60) % SHARDS_COUNT;
+    }
+
+    void SetValue(int64_t value)
+    {
+      // Not atomic with respect to the concurrent increments, which
+      // is acceptable for the "Directly" update policy
+      shards_[0].value_.store(value, boost::memory_order_relaxed);
+
+      for (size_t i = 1; i < SHARDS_COUNT; i++)
+      {
+        shards_[i].value_.store(0, boost::memory_order_relaxed);
+      }
+    }
+
+  public:
+    CounterItem() :
+      Item(MetricsUpdatePolicy_Directly)
+    {
+      for (size_t i = 0; i < SHARDS_COUNT; i++)
+      {
+        shards_[i].value_.store(0, boost::memory_order_relaxed);
+      }
+    }
+
+    virtual bool IsLockFree() const ORTHANC_OVERRIDE
+    {
+      return true;
+    }
+
+    virtual void UpdateFloat(float value) ORTHANC_OVERRIDE
+    {
+      SetValue(Orthanc::Math::llround(value));
+    }
+
+    virtual void UpdateInteger(int64_t value) ORTHANC_OVERRIDE
+    {
+      SetValue(value);
+    }
+
+    virtual void IncrementInteger(int64_t delta) ORTHANC_OVERRIDE
+    {
+      shards_[GetCurrentShard()].value_.fetch_add(delta, boost::memory_order_relaxed);
+    }
+
+    virtual MetricsDataType GetDataType() const ORTHANC_OVERRIDE
+    {
+      return MetricsDataType_Integer;
+    }
+
+    virtual bool HasValue() const ORTHANC_OVERRIDE
+    {
+      return true;
+    }
+
+    virtual boost::posix_time::ptime GetTime() const ORTHANC_OVERRIDE
+    {
+      // The time of the last increment is not tracked, as reading
+      // the clock would be more costly than the increment itself
+      return GetNow();
+    }
+
+    int64_t GetSum() const
+    {
+      int64_t sum = 0;
+
+      for (size_t i = 0; i < SHARDS_COUNT; i++)
+      {
+        sum += shards_[i].value_.load(boost::memory_order_relaxed);
+      }
+
+      return sum;
+    }
+
+    virtual std::string FormatValue() const ORTHANC_OVERRIDE
+    {
+      return boost::lexical_cast<std::string>(GetSum());
+    }
+
+    virtual void Refresh() ORTHANC_OVERRIDE
+    {
+    }
+
+    virtual void SetInitialValue(int64_t value) ORTHANC_OVERRIDE
+    {
+      SetValue(value);
+    }
+  };
+
+
   MetricsRegistry::~MetricsRegistry()
   {
     for (Content::iterator it = content_.begin(); it != content_.end(); ++it)
@@ -403,7 +528,7 @@ namespace Orthanc
 
   void MetricsRegistry::SetEnabled(bool enabled)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::unique_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
     enabled_ = enabled;
   }
 
@@ -412,7 +537,7 @@ namespace Orthanc
                                  MetricsUpdatePolicy policy,
                                  MetricsDataType type)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::unique_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
 
     if (content_.find(name) != content_.end())
     {
@@ -459,6 +584,38 @@ namespace Orthanc
     }
   }
 
+  MetricsRegistry::CounterItem& MetricsRegistry::GetCounterInternal(const std::string& name)
+  {
+    Content::iterator found = content_.find(name);
+
+    if (found == content_.end())
+    {
+      CounterItem* item = new CounterItem;
+      content_[name] = item;
+      return *item;
+    }
+    else
+    {
+      assert(found->second != NULL);
+
+      CounterItem* item = dynamic_cast<CounterItem*>(found->second);
+      if (item == NULL)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls, "The metrics is not a counter: " + name);
+      }
+      else
+      {
+        return *item;
+      }
+    }
+  }
+
+  MetricsRegistry::CounterItem& MetricsRegistry::RegisterCounter(const std::string& name)
+  {
+    ORTHANC_PROFILED_LOCK(boost::unique_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
+    return GetCounterInternal(name);
+  }
+
   MetricsRegistry::MetricsRegistry() :
     enabled_(true)
   {
@@ -472,7 +629,7 @@ namespace Orthanc
     // Inlining to avoid loosing time if metrics are disabled
     if (enabled_)
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      ORTHANC_PROFILED_LOCK(boost::unique_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
       GetItemInternal(name, policy, MetricsDataType_Float).UpdateFloat(value);
     }
   }
@@ -485,7 +642,7 @@ namespace Orthanc
     // Inlining to avoid loosing time if metrics are disabled
     if (enabled_)
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      ORTHANC_PROFILED_LOCK(boost::unique_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
       GetItemInternal(name, policy, MetricsDataType_Integer).UpdateInteger(value);
     }
   }
@@ -497,17 +654,215 @@ namespace Orthanc
     // Inlining to avoid loosing time if metrics are disabled
     if (enabled_)
     {
-      boost::mutex::scoped_lock lock(mutex_);
-      GetItemInternal(name, MetricsUpdatePolicy_Directly, MetricsDataType_Integer).IncrementInteger(delta);
+      {
+        // Fast path: The counter already exists, and is incremented
+        // while the registry is only locked in shared mode
+        ORTHANC_PROFILED_LOCK(boost::shared_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
+
+        Content::const_iterator found = content_.find(name);
+        if (found != content_.end() &&
+            found->second->IsLockFree())
+        {
+          found->second->IncrementInteger(delta);
+          return;
+        }
+      }
+
+      ORTHANC_PROFILED_LOCK(boost::unique_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
+
+      Content::iterator found = content_.find(name);
+      if (found == content_.end())
+      {
+        GetCounterInternal(name).IncrementInteger(delta);
+      }
+      else
+      {
+        // The metrics was created by another method
+        assert(found->second != NULL);
+        found->second->IncrementInteger(delta);
+      }
     }
   }
 
+
+  std::string MetricsRegistry::FormatPrometheusLabel(const std::string& name,
+                                                     const std::string& value)
+  {
+    // https://prometheus.io/docs/instrumenting/exposition_formats/#text-based-format
+    std::string escaped;
+    escaped.reserve(value.size());
+
+    for (size_t i = 0; i < value.size(); i++)
+    {
+      switch (value[i])
+      {
+        case '\\':
+          escaped += "\\\\";
+          break;
+
+        case '"':
+          escaped += "\\\"";
+          break;
+
+        case '\n':
+          escaped += "\\n";
+          break;
+
+        default:
+          escaped.push_back(value[i]);
+      }
+    }
+
+    return name + "=\"" + escaped + "\"";
+  }
+
+
+  static std::string FormatHistogramName(const std::string& name,
+                                         const std::string& labels)
+  {
+    if (labels.empty())
+    {
+      return name;
+    }
+    else
+    {
+      return name + "{" + labels + "}";
+    }
+  }
+
+
+  void MetricsRegistry::AddHistogramSample(const std::string& name,
+                                           const std::string& labels,
+                                           const double* bucketsUpperBounds,
+                                           size_t bucketsCount,
+                                           double value)
+  {
+    if (enabled_)
+    {
+      const std::string prefix = (labels.empty() ? "" : labels + ",");
+
+      // The buckets are cumulative. They are all created at once
+      // (possibly with a zero delta), as expected by Prometheus.
+      std::vector<std::string> names;
+      std::vector<int64_t> deltas;
+      names.reserve(bucketsCount + 3);
+      deltas.reserve(bucketsCount + 3);
+
+      for (size_t i = 0; i < bucketsCount; i++)
+      {
+        const std::string le = FormatPrometheusLabel("le", boost::lexical_cast<std::string>(bucketsUpperBounds[i]));
+        names.push_back(FormatHistogramName(name + "_bucket", prefix + le));
+        deltas.push_back(value <= bucketsUpperBounds[i] ? 1 : 0);
+      }
+
+      names.push_back(FormatHistogramName(name + "_bucket", prefix + FormatPrometheusLabel("le", "+Inf")));
+      deltas.push_back(1);
+      names.push_back(FormatHistogramName(name + "_count", labels));
+      deltas.push_back(1);
+      names.push_back(FormatHistogramName(name + "_sum", labels));
+      deltas.push_back(static_cast<int64_t>(value + 0.5));
+
+      {
+        // Fast path: The histogram already exists, and its counters
+        // are incremented while the registry is locked in shared mode
+        ORTHANC_PROFILED_LOCK(boost::shared_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
+
+        std::vector<Item*> items(names.size());
+
+        bool found = true;
+        for (size_t i = 0; found && i < names.size(); i++)
+        {
+          Content::const_iterator it = content_.find(names[i]);
+          if (it == content_.end() ||
+              !it->second->IsLockFree())
+          {
+            found = false;
+          }
+          else
+          {
+            items[i] = it->second;
+          }
+        }
+
+        if (found)
+        {
+          for (size_t i = 0; i < items.size(); i++)
+          {
+            items[i]->IncrementInteger(deltas[i]);
+          }
+
+          return;
+        }
+      }
+
+      ORTHANC_PROFILED_LOCK(boost::unique_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
+
+      for (size_t i = 0; i < names.size(); i++)
+      {
+        Content::iterator found = content_.find(names[i]);
+        if (found == content_.end())
+        {
+          GetCounterInternal(names[i]).IncrementInteger(deltas[i]);
+        }
+        else
+        {
+          assert(found->second != NULL);
+          found->second->IncrementInteger(deltas[i]);
+        }
+      }
+    }
+  }
+
+
+  void MetricsRegistry::AddHistogramSample(const std::string& name,
+                                           const std::string& labels,
+                                           const std::vector<double>& bucketsUpperBounds,
+                                           double value)
+  {
+    AddHistogramSample(name, labels, (bucketsUpperBounds.empty() ? NULL : &bucketsUpperBounds[0]),
+                       bucketsUpperBounds.size(), value);
+  }
+
+
+  const std::vector<double>& MetricsRegistry::GetDefaultDurationBuckets()
+  {
+    static const double BUCKETS[] = {
+      1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000
+    };
+
+    static const std::vector<double> buckets(BUCKETS, BUCKETS + sizeof(BUCKETS) / sizeof(double));
+    return buckets;
+  }
+
+
+  void MetricsRegistry::GetExponentialBuckets(std::vector<double>& target,
+                                              double start,
+                                              double factor,
+                                              size_t count)
+  {
+    if (start <= 0 ||
+        factor <= 1)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    target.resize(count);
+
+    double bound = start;
+    for (size_t i = 0; i < count; i++)
+    {
+      target[i] = bound;
+      bound *= factor;
+    }
+  }
+
+
   void MetricsRegistry::SetInitialValue(const std::string& name,
                                         int64_t value)
   {
     if (enabled_)
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      ORTHANC_PROFILED_LOCK(boost::unique_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
       GetItemInternal(name, MetricsUpdatePolicy_Directly, MetricsDataType_Integer).SetInitialValue(value);
     }
   }
@@ -515,7 +870,7 @@ namespace Orthanc
 
   MetricsUpdatePolicy MetricsRegistry::GetUpdatePolicy(const std::string& metrics)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
 
     Content::const_iterator found = content_.find(metrics);
 
@@ -533,7 +888,7 @@ namespace Orthanc
 
   MetricsDataType MetricsRegistry::GetDataType(const std::string& metrics)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
 
     Content::const_iterator found = content_.find(metrics);
 
@@ -554,7 +909,7 @@ namespace Orthanc
     // https://www.boost.org/doc/libs/1_69_0/doc/html/date_time/examples.html#date_time.examples.seconds_since_epoch
     static const boost::posix_time::ptime EPOCH(boost::gregorian::date(1970, 1, 1));
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::unique_lock<boost::shared_mutex>, lock, mutex_, metricsRegistryLockProfiler_);
 
     s.clear();
 
@@ -612,6 +967,26 @@ namespace Orthanc
     registry_.SetInitialValue(name_, value_);
   }
 
+  MetricsRegistry::Counter::Counter(MetricsRegistry& registry,
+                                    const std::string& name) :
+    registry_(registry),
+    item_(registry.RegisterCounter(name))
+  {
+  }
+
+  void MetricsRegistry::Counter::Increment(int64_t delta)
+  {
+    if (registry_.IsEnabled())
+    {
+      item_.IncrementInteger(delta);
+    }
+  }
+
+  int64_t MetricsRegistry::Counter::GetValue() const
+  {
+    return item_.GetSum();
+  }
+
   MetricsRegistry::ActiveCounter::ActiveCounter(MetricsRegistry::SharedMetrics &metrics) :
     metrics_(metrics)
   {
@@ -715,4 +1090,68 @@ namespace Orthanc
     assert(pimpl_ != NULL);
     delete pimpl_;
   }
+
+
+  struct MetricsRegistry::HistogramTimer::PImpl
+  {
+    boost::posix_time::ptime  start_;
+  };
+
+
+  MetricsRegistry::HistogramTimer::HistogramTimer(MetricsRegistry& registry,
+                                                  const std::string& name,
+                                                  const std::string& labels) :
+    pimpl_(new PImpl),
+    registry_(registry),
+    name_(name),
+    labels_(labels),
+    buckets_(GetDefaultDurationBuckets()),
+    active_(registry.IsEnabled())
+  {
+    if (active_)
+    {
+      pimpl_->start_ = GetNow();
+    }
+  }
+
+
+  MetricsRegistry::HistogramTimer::HistogramTimer(MetricsRegistry& registry,
+                                                  const std::string& name,
+                                                  const std::string& labels,
+                                                  const std::vector<double>& bucketsUpperBounds) :
+    pimpl_(new PImpl),
+    registry_(registry),
+    name_(name),
+    labels_(labels),
+    buckets_(bucketsUpperBounds),
+    active_(registry.IsEnabled())
+  {
+    if (active_)
+    {
+      pimpl_->start_ = GetNow();
+    }
+  }
+
+
+  MetricsRegistry::HistogramTimer::~HistogramTimer()
+  {
+    if (active_)
+    {
+      boost::posix_time::time_duration diff = GetNow() - pimpl_->start_;
+
+      try
+      {
+        registry_.AddHistogramSample(name_, labels_, buckets_,
+                                     static_cast<double>(diff.total_microseconds()) / 1000.0);
+      }
+      catch (OrthancException& e)
+      {
+        // Don't throw exceptions in destructors
+        LOG(ERROR) << "Exception in destructor: " << e.What();
+      }
+    }
+
+    assert(pimpl_ != NULL);
+    delete pimpl_;
+  }
 }
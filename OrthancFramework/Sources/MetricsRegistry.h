@@ -36,8 +36,10 @@
 
 #include <boost/noncopyable.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
 #include <map>
 #include <stdint.h>
+#include <vector>
 
 
 namespace Orthanc
@@ -63,18 +65,24 @@ namespace Orthanc
     class Item;
     class FloatItem;
     class IntegerItem;
+    class CounterItem;
 
     typedef std::map<std::string, Item*>   Content;
 
-    bool          enabled_;
-    boost::mutex  mutex_;
-    Content       content_;
+    bool                 enabled_;
+    boost::shared_mutex  mutex_;
+    Content              content_;
 
-    // The mutex must be locked
+    // The mutex must be locked in exclusive mode
     Item& GetItemInternal(const std::string& name,
                           MetricsUpdatePolicy policy,
                           MetricsDataType type);
 
+    // The mutex must be locked in exclusive mode
+    CounterItem& GetCounterInternal(const std::string& name);
+
+    CounterItem& RegisterCounter(const std::string& name);
+
   public:
     MetricsRegistry();
 
@@ -111,9 +119,45 @@ namespace Orthanc
     void SetInitialValue(const std::string& name,
                          int64_t value);
 
+    // Since Orthanc 1.12.12, the metrics that are only incremented
+    // are sharded counters, that are updated without locking the
+    // registry in exclusive mode
     void IncrementIntegerValue(const std::string& name,
                                int64_t delta);
 
+    // New in Orthanc 1.12.12. Formats one Prometheus label, to be
+    // embedded in the name of a metrics: name="value" (escaped)
+    static std::string FormatPrometheusLabel(const std::string& name,
+                                             const std::string& value);
+
+    // New in Orthanc 1.12.12. Adds one sample to the Prometheus
+    // histogram "name", whose cumulative buckets have the given upper
+    // bounds. The "labels" string (possibly empty) is a
+    // comma-separated list of labels created by
+    // "FormatPrometheusLabel()".
+    void AddHistogramSample(const std::string& name,
+                            const std::string& labels,
+                            const double* bucketsUpperBounds,
+                            size_t bucketsCount,
+                            double value);
+
+    void AddHistogramSample(const std::string& name,
+                            const std::string& labels,
+                            const std::vector<double>& bucketsUpperBounds,
+                            double value);
+
+    // New in Orthanc 1.12.12. Upper bounds of the buckets that are
+    // used by default for the histograms of durations, in
+    // milliseconds (from 1ms to 1 minute)
+    static const std::vector<double>& GetDefaultDurationBuckets();
+
+    // New in Orthanc 1.12.12. Upper bounds of "count" exponential
+    // buckets: start, start * factor, start * factor^2...
+    static void GetExponentialBuckets(std::vector<double>& target,
+                                      double start,
+                                      double factor,
+                                      size_t count);
+
     MetricsUpdatePolicy GetUpdatePolicy(const std::string& metrics);
 
     MetricsDataType GetDataType(const std::string& metrics);
@@ -141,6 +185,35 @@ namespace Orthanc
     };
 
 
+    /**
+     * Pre-registered handle to an integer metrics that is only
+     * incremented (new in Orthanc 1.12.12). The value is sharded
+     * over several atomic counters, that are only summed by
+     * "ExportPrometheusText()": "Increment()" neither locks the
+     * registry nor looks up the name of the metrics. The registry
+     * must outlive the handle.
+     **/
+    class ORTHANC_PUBLIC Counter : public boost::noncopyable
+    {
+    private:
+      MetricsRegistry&  registry_;
+      CounterItem&      item_;
+
+    public:
+      Counter(MetricsRegistry& registry,
+              const std::string& name);
+
+      void Increment(int64_t delta);
+
+      void Increment()
+      {
+        Increment(1);
+      }
+
+      int64_t GetValue() const;
+    };
+
+
     class ORTHANC_PUBLIC ActiveCounter : public boost::noncopyable
     {
     private:
@@ -187,5 +260,39 @@ namespace Orthanc
 
       ~Timer();
     };
+
+
+    /**
+     * Variant of "Timer" that records the duration into a Prometheus
+     * histogram, in milliseconds, instead of a gauge (new in Orthanc
+     * 1.12.12). This exposes the tail latencies that are hidden by
+     * the "MaxOver10Seconds" policy of "Timer".
+     **/
+    class ORTHANC_PUBLIC HistogramTimer : public boost::noncopyable
+    {
+    private:
+      struct PImpl;  // To hold "boost::posix_time::ptime  start_"
+      PImpl* pimpl_;
+
+      MetricsRegistry&            registry_;
+      std::string                 name_;
+      std::string                 labels_;
+      const std::vector<double>&  buckets_;
+      bool                        active_;
+
+    public:
+      // Uses "GetDefaultDurationBuckets()"
+      HistogramTimer(MetricsRegistry& registry,
+                     const std::string& name,
+                     const std::string& labels);
+
+      // The buckets must outlive the timer
+      HistogramTimer(MetricsRegistry& registry,
+                     const std::string& name,
+                     const std::string& labels,
+                     const std::vector<double>& bucketsUpperBounds);
+
+      ~HistogramTimer();
+    };
   };
 }
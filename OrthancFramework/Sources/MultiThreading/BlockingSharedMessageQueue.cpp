@@ -50,11 +50,18 @@ namespace Orthanc
   {
     boost::mutex::scoped_lock lock(mutex_);
 
-    if (maxSize_ != 0 && queue_.size() >= maxSize_)
+    if (maxSize_ != 0)
     {
-      if (!roomAvailable_.timed_wait(lock, boost::posix_time::milliseconds(millisecondsTimeout)))
+      // Loop, as another producer might have filled the room in the meantime
+      const boost::system_time deadline = (boost::get_system_time() +
+                                           boost::posix_time::milliseconds(millisecondsTimeout));
+
+      while (queue_.size() >= maxSize_)
       {
-        return false;
+        if (!roomAvailable_.timed_wait(lock, deadline))
+        {
+          return false;
+        }
       }
     }
 
@@ -68,7 +75,7 @@ namespace Orthanc
   {
     boost::mutex::scoped_lock lock(mutex_);
 
-    if (maxSize_ != 0 && queue_.size() >= maxSize_)
+    while (maxSize_ != 0 && queue_.size() >= maxSize_)
     {
       roomAvailable_.wait(lock);
     }
@@ -158,6 +165,23 @@ namespace Orthanc
     emptied_.notify_all();
   }
 
+  void BlockingSharedMessageQueue::SetMaxSize(unsigned int maxSize)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    maxSize_ = maxSize;
+
+    // The producers that are waiting might have room now
+    roomAvailable_.notify_all();
+  }
+
+
+  unsigned int BlockingSharedMessageQueue::GetMaxSize()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return maxSize_;
+  }
+
+
   size_t BlockingSharedMessageQueue::GetSize()
   {
     boost::mutex::scoped_lock lock(mutex_);
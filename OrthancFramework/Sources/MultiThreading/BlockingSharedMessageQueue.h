@@ -76,6 +76,12 @@ namespace Orthanc
 
     void Clear();
 
+    // New in Orthanc 1.12.12. A value of "0" means no limit. The
+    // messages that are already in the queue are kept.
+    void SetMaxSize(unsigned int maxSize);
+
+    unsigned int GetMaxSize();
+
     size_t GetSize();
   };
 }
@@ -0,0 +1,305 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "BoundedMessageQueue.h"
+
+#include "../OrthancException.h"
+
+#include <limits>
+
+
+namespace Orthanc
+{
+  struct BoundedMessageQueue::Cell
+  {
+    boost::atomic<size_t>  sequence_;
+    IDynamicObject*        message_;
+  };
+
+
+  bool BoundedMessageQueue::TryEnqueueInternal(IDynamicObject* message)
+  {
+    size_t position = enqueuePosition_.load(boost::memory_order_relaxed);
+
+    for (;;)
+    {
+      Cell& cell = cells_[position & mask_];
+      const size_t sequence = cell.sequence_.load(boost::memory_order_acquire);
+      const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+      if (difference == 0)
+      {
+        // The cell is free: Try and claim it
+        if (enqueuePosition_.compare_exchange_weak(position, position + 1, boost::memory_order_relaxed))
+        {
+          cell.message_ = message;
+          cell.sequence_.store(position + 1, boost::memory_order_release);
+          return true;
+        }
+      }
+      else if (difference < 0)
+      {
+        return false;  // The queue is full
+      }
+      else
+      {
+        // Another producer has claimed the cell in the meantime
+        position = enqueuePosition_.load(boost::memory_order_relaxed);
+      }
+    }
+  }
+
+
+  IDynamicObject* BoundedMessageQueue::TryDequeueInternal()
+  {
+    size_t position = dequeuePosition_.load(boost::memory_order_relaxed);
+
+    for (;;)
+    {
+      Cell& cell = cells_[position & mask_];
+      const size_t sequence = cell.sequence_.load(boost::memory_order_acquire);
+      const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+      if (difference == 0)
+      {
+        if (dequeuePosition_.compare_exchange_weak(position, position + 1, boost::memory_order_relaxed))
+        {
+          IDynamicObject* message = cell.message_;
+
+          // Make the cell available for the producer of the next lap
+          cell.sequence_.store(position + mask_ + 1, boost::memory_order_release);
+          return message;
+        }
+      }
+      else if (difference < 0)
+      {
+        return NULL;  // The queue is empty
+      }
+      else
+      {
+        position = dequeuePosition_.load(boost::memory_order_relaxed);
+      }
+    }
+  }
+
+
+  void BoundedMessageQueue::WakeUp(boost::atomic<unsigned int>& waiting,
+                                   boost::condition_variable& condition)
+  {
+    // This fence pairs with the one of the waiting thread: Either the
+    // waiting thread sees the change in the queue, or this thread sees
+    // the waiting thread. Taking the mutex before notifying ensures
+    // that the waiting thread is actually waiting on the condition.
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+    if (waiting.load(boost::memory_order_relaxed) > 0)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      condition.notify_all();
+    }
+  }
+
+
+  BoundedMessageQueue::BoundedMessageQueue(size_t capacity) :
+    cells_(NULL),
+    mask_(0),
+    enqueuePosition_(0),
+    dequeuePosition_(0),
+    waitingProducers_(0),
+    waitingConsumers_(0)
+  {
+    if (capacity == 0 ||
+        capacity > std::numeric_limits<size_t>::max() / 4)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    size_t rounded = 1;
+    while (rounded < capacity)
+    {
+      rounded *= 2;
+    }
+
+    cells_ = new Cell[rounded];
+    mask_ = rounded - 1;
+
+    for (size_t i = 0; i < rounded; i++)
+    {
+      cells_[i].sequence_.store(i, boost::memory_order_relaxed);
+      cells_[i].message_ = NULL;
+    }
+  }
+
+
+  BoundedMessageQueue::~BoundedMessageQueue()
+  {
+    Clear();
+    delete[] cells_;
+  }
+
+
+  bool BoundedMessageQueue::Enqueue(std::unique_ptr<IDynamicObject>& message,
+                                    int32_t millisecondsTimeout)
+  {
+    if (message.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    if (!TryEnqueueInternal(message.get()))
+    {
+      if (millisecondsTimeout <= 0)
+      {
+        return false;
+      }
+
+      const boost::system_time deadline = (boost::get_system_time() +
+                                           boost::posix_time::milliseconds(millisecondsTimeout));
+
+      boost::mutex::scoped_lock lock(mutex_);
+      waitingProducers_.fetch_add(1, boost::memory_order_relaxed);
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+      while (!TryEnqueueInternal(message.get()))
+      {
+        if (!roomAvailable_.timed_wait(lock, deadline))
+        {
+          waitingProducers_.fetch_sub(1, boost::memory_order_relaxed);
+          return false;
+        }
+      }
+
+      waitingProducers_.fetch_sub(1, boost::memory_order_relaxed);
+    }
+
+    message.release();  // take ownership only when pushed into the queue
+    WakeUp(waitingConsumers_, elementAvailable_);
+    return true;
+  }
+
+
+  void BoundedMessageQueue::Enqueue(IDynamicObject* message)
+  {
+    std::unique_ptr<IDynamicObject> protection(message);
+
+    if (message == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    if (!TryEnqueueInternal(message))
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      waitingProducers_.fetch_add(1, boost::memory_order_relaxed);
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+      while (!TryEnqueueInternal(message))
+      {
+        roomAvailable_.wait(lock);
+      }
+
+      waitingProducers_.fetch_sub(1, boost::memory_order_relaxed);
+    }
+
+    protection.release();
+    WakeUp(waitingConsumers_, elementAvailable_);
+  }
+
+
+  IDynamicObject* BoundedMessageQueue::Dequeue(int32_t millisecondsTimeout)
+  {
+    IDynamicObject* message = TryDequeueInternal();
+
+    if (message == NULL)
+    {
+      const boost::system_time deadline = (boost::get_system_time() +
+                                           boost::posix_time::milliseconds(millisecondsTimeout));
+
+      boost::mutex::scoped_lock lock(mutex_);
+      waitingConsumers_.fetch_add(1, boost::memory_order_relaxed);
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+      for (;;)
+      {
+        message = TryDequeueInternal();
+
+        if (message != NULL)
+        {
+          break;
+        }
+        else if (millisecondsTimeout == 0)
+        {
+          elementAvailable_.wait(lock);
+        }
+        else if (!elementAvailable_.timed_wait(lock, deadline))
+        {
+          waitingConsumers_.fetch_sub(1, boost::memory_order_relaxed);
+          return NULL;
+        }
+      }
+
+      waitingConsumers_.fetch_sub(1, boost::memory_order_relaxed);
+    }
+
+    WakeUp(waitingProducers_, roomAvailable_);
+    return message;
+  }
+
+
+  IDynamicObject* BoundedMessageQueue::TryDequeue()
+  {
+    IDynamicObject* message = TryDequeueInternal();
+
+    if (message != NULL)
+    {
+      WakeUp(waitingProducers_, roomAvailable_);
+    }
+
+    return message;
+  }
+
+
+  size_t BoundedMessageQueue::GetSize() const
+  {
+    // Read the consumers first, so that the difference cannot be negative
+    const size_t dequeued = dequeuePosition_.load(boost::memory_order_acquire);
+    const size_t enqueued = enqueuePosition_.load(boost::memory_order_acquire);
+    return (enqueued >= dequeued ? enqueued - dequeued : 0);
+  }
+
+
+  void BoundedMessageQueue::Clear()
+  {
+    for (;;)
+    {
+      std::unique_ptr<IDynamicObject> message(TryDequeue());
+      if (message.get() == NULL)
+      {
+        return;
+      }
+    }
+  }
+}
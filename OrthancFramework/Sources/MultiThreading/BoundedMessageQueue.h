@@ -0,0 +1,110 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Compatibility.h"
+#include "../IDynamicObject.h"
+
+#include <stdint.h>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Bounded FIFO queue of messages, that can be shared by multiple
+   * producers and multiple consumers (new in Orthanc 1.12.12). The
+   * messages are stored in a ring buffer whose cells are claimed
+   * with atomic operations (algorithm of Dmitry Vyukov), so that
+   * there is no mutex as long as the queue is neither empty nor full.
+   * The producers (resp. consumers) only sleep on a condition variable
+   * if the queue is full (resp. empty).
+   *
+   * Contrarily to BlockingSharedMessageQueue, the capacity is fixed
+   * at construction, and is rounded up to a power of 2.
+   **/
+  class ORTHANC_PUBLIC BoundedMessageQueue : public boost::noncopyable
+  {
+  private:
+    struct Cell;
+
+    // Distinct cache lines for the positions of the producers and of
+    // the consumers, to avoid false sharing between them
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    Cell*                         cells_;
+    size_t                        mask_;
+    char                          padding1_[CACHE_LINE_SIZE];
+    boost::atomic<size_t>         enqueuePosition_;
+    char                          padding2_[CACHE_LINE_SIZE];
+    boost::atomic<size_t>         dequeuePosition_;
+    char                          padding3_[CACHE_LINE_SIZE];
+    boost::atomic<unsigned int>   waitingProducers_;
+    boost::atomic<unsigned int>   waitingConsumers_;
+    boost::mutex                  mutex_;
+    boost::condition_variable     elementAvailable_;
+    boost::condition_variable     roomAvailable_;
+
+    bool TryEnqueueInternal(IDynamicObject* message);
+
+    IDynamicObject* TryDequeueInternal();
+
+    void WakeUp(boost::atomic<unsigned int>& waiting,
+                boost::condition_variable& condition);
+
+  public:
+    explicit BoundedMessageQueue(size_t capacity);
+
+    ~BoundedMessageQueue();
+
+    size_t GetCapacity() const
+    {
+      return mask_ + 1;
+    }
+
+    // This transfers the ownership of the message only if it is
+    // actually pushed in the queue (hence the unique_ptr). A timeout
+    // of "0" means that the call never blocks.
+    bool Enqueue(std::unique_ptr<IDynamicObject>& message,
+                 int32_t millisecondsTimeout);
+
+    // This transfers the ownership of the message, and blocks until
+    // there is room in the queue
+    void Enqueue(IDynamicObject* message);
+
+    // The caller is responsible to delete the dequeued message! A
+    // timeout of "0" means to wait forever, as in SharedMessageQueue.
+    IDynamicObject* Dequeue(int32_t millisecondsTimeout);
+
+    // Never blocks, returns NULL if the queue is empty
+    IDynamicObject* TryDequeue();
+
+    // Approximate if there are concurrent producers or consumers
+    size_t GetSize() const;
+
+    void Clear();
+  };
+}
@@ -0,0 +1,130 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ExecutorTask.h"
+
+#include "../OrthancException.h"
+#include "FutureState.h"
+
+#include <boost/weak_ptr.hpp>
+
+
+namespace Orthanc
+{
+  namespace Internals
+  {
+    class CallableTask : public ExecutorTask
+    {
+    private:
+      std::unique_ptr<ICallable>    callable_;
+      boost::weak_ptr<FutureState>  state_;
+
+    public:
+      CallableTask(ICallable* callable,
+                   boost::shared_ptr<FutureState>& state) :
+        callable_(callable),
+        state_(state)
+      {
+        assert(callable != NULL);
+      }
+
+      void Execute() ORTHANC_OVERRIDE
+      {
+        boost::shared_ptr<FutureState> locked = state_.lock();
+
+        if (locked)
+        {
+          try
+          {
+            locked->AcquireResult(callable_->Call());
+          }
+          catch (const OrthancException& e)
+          {
+            locked->SetError(e);
+          }
+          catch (...)
+          {
+            locked->SetError(OrthancException(ErrorCode_InternalError, "Unknown exception in ICallable::Call()"));
+          }
+        }
+        else
+        {
+          // Nothing to do: The future was canceled before we even started
+        }
+      }
+
+      void Cancel() ORTHANC_OVERRIDE
+      {
+        boost::shared_ptr<FutureState> locked = state_.lock();
+
+        if (locked)
+        {
+          locked->SetError(OrthancException(ErrorCode_CanceledJob));
+        }
+        else
+        {
+          // Nothing to do: The future was canceled before we even started
+        }
+      }
+    };
+
+
+    class RunnableTask : public ExecutorTask
+    {
+    private:
+      std::unique_ptr<IRunnable>  runnable_;
+
+    public:
+      explicit RunnableTask(IRunnable* runnable) :
+        runnable_(runnable)
+      {
+        assert(runnable != NULL);
+      }
+
+      void Execute() ORTHANC_OVERRIDE
+      {
+        runnable_->Run();
+      }
+
+      void Cancel() ORTHANC_OVERRIDE
+      {
+      }
+    };
+
+
+    ExecutorTask* ExecutorTask::CreateCallable(ICallable* callable,
+                                               boost::shared_ptr<FutureState>& state)
+    {
+      return new CallableTask(callable, state);
+    }
+
+
+    ExecutorTask* ExecutorTask::CreateRunnable(IRunnable* runnable)
+    {
+      return new RunnableTask(runnable);
+    }
+  }
+}
@@ -0,0 +1,63 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Compatibility.h"
+#include "../IDynamicObject.h"
+#include "ICallable.h"
+#include "IRunnable.h"
+
+#include <boost/shared_ptr.hpp>
+
+namespace Orthanc
+{
+  namespace Internals
+  {
+    class FutureState;
+
+    /**
+     * Unit of work that is queued by the implementations of
+     * IExecutorService. A task is either executed by a worker, or
+     * canceled if the executor is stopped before it runs.
+     **/
+    class ExecutorTask : public IDynamicObject
+    {
+    public:
+      virtual ~ExecutorTask()
+      {
+      }
+
+      virtual void Execute() = 0;
+
+      virtual void Cancel() = 0;
+
+      static ExecutorTask* CreateCallable(ICallable* callable /* takes ownership */,
+                                          boost::shared_ptr<FutureState>& state);
+
+      static ExecutorTask* CreateRunnable(IRunnable* runnable /* takes ownership */);
+    };
+  }
+}
@@ -0,0 +1,310 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "FairSharedMutex.h"
+
+#include "../OrthancException.h"
+
+#include <cassert>
+
+
+namespace Orthanc
+{
+  bool FairSharedMutex::CanAdmitReader() const
+  {
+    return (!writer_ &&
+            !upgrading_ &&
+            waitingWriters_ == 0);
+  }
+
+
+  bool FairSharedMutex::CanAdmitWriter() const
+  {
+    return (!writer_ &&
+            !upgrader_ &&
+            activeReaders_ == 0 &&
+            pendingReaders_ == 0);
+  }
+
+
+  void FairSharedMutex::ReleaseWriter()
+  {
+    // Must be called while holding "mutex_"
+    assert(writer_);
+    writer_ = false;
+
+    if (waitingReaders_ > 0)
+    {
+      // Start a new read phase: The readers that were queued behind
+      // this writer will run before the next writer
+      pendingReaders_ = waitingReaders_;
+      readPhase_++;
+    }
+
+    condition_.notify_all();
+  }
+
+
+  FairSharedMutex::FairSharedMutex() :
+    activeReaders_(0),
+    waitingReaders_(0),
+    pendingReaders_(0),
+    waitingWriters_(0),
+    writer_(false),
+    upgrader_(false),
+    upgrading_(false),
+    readPhase_(0)
+  {
+  }
+
+
+  void FairSharedMutex::lock()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    waitingWriters_++;
+
+    while (!CanAdmitWriter())
+    {
+      condition_.wait(lock);
+    }
+
+    waitingWriters_--;
+    writer_ = true;
+  }
+
+
+  bool FairSharedMutex::try_lock()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (CanAdmitWriter())
+    {
+      writer_ = true;
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  void FairSharedMutex::unlock()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!writer_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    ReleaseWriter();
+  }
+
+
+  void FairSharedMutex::lock_shared()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (CanAdmitReader())
+    {
+      activeReaders_++;
+      return;
+    }
+
+    const uint64_t phase = readPhase_;
+    waitingReaders_++;
+
+    for (;;)
+    {
+      if (!writer_ &&
+          !upgrading_ &&
+          readPhase_ != phase)
+      {
+        // Admitted by the writer that has just finished, even if
+        // other writers are waiting
+        assert(pendingReaders_ > 0);
+        pendingReaders_--;
+        break;
+      }
+      else if (CanAdmitReader())
+      {
+        break;
+      }
+
+      condition_.wait(lock);
+    }
+
+    waitingReaders_--;
+    activeReaders_++;
+  }
+
+
+  bool FairSharedMutex::try_lock_shared()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (CanAdmitReader())
+    {
+      activeReaders_++;
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  void FairSharedMutex::unlock_shared()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (activeReaders_ == 0)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    activeReaders_--;
+
+    if (activeReaders_ == 0)
+    {
+      condition_.notify_all();
+    }
+  }
+
+
+  void FairSharedMutex::lock_upgrade()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    while (upgrader_ ||
+           !CanAdmitReader())
+    {
+      condition_.wait(lock);
+    }
+
+    upgrader_ = true;
+  }
+
+
+  bool FairSharedMutex::try_lock_upgrade()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!upgrader_ &&
+        CanAdmitReader())
+    {
+      upgrader_ = true;
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  void FairSharedMutex::unlock_upgrade()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!upgrader_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    upgrader_ = false;
+    condition_.notify_all();
+  }
+
+
+  void FairSharedMutex::unlock_upgrade_and_lock()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!upgrader_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    // No new reader is admitted, and the writers are kept waiting
+    // as long as "upgrader_" is set
+    upgrading_ = true;
+
+    while (activeReaders_ > 0)
+    {
+      condition_.wait(lock);
+    }
+
+    upgrading_ = false;
+    upgrader_ = false;
+    writer_ = true;
+  }
+
+
+  void FairSharedMutex::unlock_and_lock_upgrade()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!writer_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    upgrader_ = true;
+    ReleaseWriter();
+  }
+
+
+  void FairSharedMutex::unlock_upgrade_and_lock_shared()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!upgrader_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    upgrader_ = false;
+    activeReaders_++;
+    condition_.notify_all();
+  }
+
+
+  unsigned int FairSharedMutex::GetActiveReadersCount()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return activeReaders_;
+  }
+
+
+  unsigned int FairSharedMutex::GetWaitingWritersCount()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return waitingWriters_;
+  }
+}
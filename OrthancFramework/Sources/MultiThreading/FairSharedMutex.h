@@ -0,0 +1,109 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <stdint.h>
+
+namespace Orthanc
+{
+  /**
+   * Reader-writer lock that is fair between readers and writers
+   * (new in Orthanc 1.12.12). As soon as a writer is waiting, the
+   * new readers are queued behind it, which prevents a constant flow
+   * of readers from starving the writers. Conversely, the readers
+   * that were queued behind a writer are all admitted before the
+   * next writer ("phase-fair" policy), so that readers are not
+   * starved by a constant flow of writers either.
+   *
+   * One thread at a time can hold an "upgradeable" read access,
+   * which coexists with the plain readers and can be atomically
+   * converted into a write access, without letting another writer
+   * modify the protected data in the meantime.
+   *
+   * This class implements the "SharedMutex" and "UpgradeLockable"
+   * concepts of Boost, so that it can be used through
+   * "boost::shared_lock<>", "boost::unique_lock<>",
+   * "boost::upgrade_lock<>" and "boost::upgrade_to_unique_lock<>",
+   * as a drop-in replacement for "boost::shared_mutex". This lock is
+   * not recursive.
+   **/
+  class ORTHANC_PUBLIC FairSharedMutex : public boost::noncopyable
+  {
+  private:
+    boost::mutex               mutex_;
+    boost::condition_variable  condition_;
+    unsigned int               activeReaders_;
+    unsigned int               waitingReaders_;
+    unsigned int               pendingReaders_;  // Readers admitted by the last writer, but not running yet
+    unsigned int               waitingWriters_;
+    bool                       writer_;
+    bool                       upgrader_;
+    bool                       upgrading_;       // The upgrader waits for the readers to leave
+    uint64_t                   readPhase_;
+
+    bool CanAdmitReader() const;
+
+    bool CanAdmitWriter() const;
+
+    void ReleaseWriter();
+
+  public:
+    FairSharedMutex();
+
+    void lock();
+
+    bool try_lock();
+
+    void unlock();
+
+    void lock_shared();
+
+    bool try_lock_shared();
+
+    void unlock_shared();
+
+    void lock_upgrade();
+
+    bool try_lock_upgrade();
+
+    void unlock_upgrade();
+
+    void unlock_upgrade_and_lock();
+
+    void unlock_and_lock_upgrade();
+
+    void unlock_upgrade_and_lock_shared();
+
+    // For statistics and tests only, the values might be outdated
+    unsigned int GetActiveReadersCount();
+
+    unsigned int GetWaitingWritersCount();
+  };
+}
@@ -38,6 +38,7 @@ namespace Orthanc
   class ORTHANC_PUBLIC Future : public boost::noncopyable
   {
     friend class ThreadPool;
+    friend class WorkStealingThreadPool;
 
   private:
     boost::shared_ptr<Internals::FutureState>  state_;
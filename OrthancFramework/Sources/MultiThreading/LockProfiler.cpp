@@ -0,0 +1,213 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "LockProfiler.h"
+
+#include "../MetricsRegistry.h"
+
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+#include <list>
+#include <vector>
+
+
+namespace Orthanc
+{
+  static const uint64_t BUCKETS[LockProfiler::BUCKETS_COUNT] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+
+  namespace
+  {
+    // The list of all the profilers. This object is never destroyed,
+    // as the profilers are static objects.
+    class ProfilersRegistry : public boost::noncopyable
+    {
+    public:
+      boost::mutex               mutex_;
+      std::list<LockProfiler*>   profilers_;
+    };
+
+    ProfilersRegistry& GetProfilersRegistry()
+    {
+      static ProfilersRegistry* registry = new ProfilersRegistry;
+      return *registry;
+    }
+
+
+    struct TopWaiter
+    {
+      const char*  name_;
+      uint64_t     count_;
+      uint64_t     totalWait_;
+
+      bool operator< (const TopWaiter& other) const
+      {
+        return totalWait_ > other.totalWait_;  // Decreasing total wait
+      }
+    };
+  }
+
+
+  LockProfiler::Histogram::Histogram() :
+    count_(0),
+    sum_(0)
+  {
+    for (size_t i = 0; i <= BUCKETS_COUNT; i++)
+    {
+      buckets_[i].store(0);
+    }
+  }
+
+
+  void LockProfiler::Histogram::AddSample(uint64_t microseconds)
+  {
+    size_t bucket = 0;
+    while (bucket < BUCKETS_COUNT &&
+           microseconds > BUCKETS[bucket])
+    {
+      bucket++;
+    }
+
+    buckets_[bucket].fetch_add(1, boost::memory_order_relaxed);
+    count_.fetch_add(1, boost::memory_order_relaxed);
+    sum_.fetch_add(microseconds, boost::memory_order_relaxed);
+  }
+
+
+  void LockProfiler::Histogram::Publish(MetricsRegistry& registry,
+                                        const std::string& name,
+                                        const std::string& labels) const
+  {
+    // The buckets are cumulative in Prometheus
+    uint64_t cumulative = 0;
+
+    for (size_t i = 0; i <= BUCKETS_COUNT; i++)
+    {
+      cumulative += buckets_[i].load(boost::memory_order_relaxed);
+
+      const std::string le = (i < BUCKETS_COUNT ? boost::lexical_cast<std::string>(BUCKETS[i]) : "+Inf");
+      registry.SetIntegerValue(name + "_bucket{" + labels + "," + MetricsRegistry::FormatPrometheusLabel("le", le) + "}",
+                               static_cast<int64_t>(cumulative));
+    }
+
+    registry.SetIntegerValue(name + "_count{" + labels + "}", static_cast<int64_t>(count_.load(boost::memory_order_relaxed)));
+    registry.SetIntegerValue(name + "_sum{" + labels + "}", static_cast<int64_t>(sum_.load(boost::memory_order_relaxed)));
+  }
+
+
+  LockProfiler::LockProfiler(const std::string& name) :
+    name_(name),
+    acquisitions_(0),
+    contended_(0)
+  {
+    ProfilersRegistry& registry = GetProfilersRegistry();
+    boost::mutex::scoped_lock lock(registry.mutex_);
+    registry.profilers_.push_back(this);
+  }
+
+
+  LockProfiler::~LockProfiler()
+  {
+    ProfilersRegistry& registry = GetProfilersRegistry();
+    boost::mutex::scoped_lock lock(registry.mutex_);
+    registry.profilers_.remove(this);
+  }
+
+
+  void LockProfiler::RecordUncontendedAcquisition()
+  {
+    acquisitions_.fetch_add(1, boost::memory_order_relaxed);
+    wait_.AddSample(0);
+  }
+
+
+  void LockProfiler::RecordContendedAcquisition(uint64_t waitMicroseconds,
+                                                const char* waiter)
+  {
+    acquisitions_.fetch_add(1, boost::memory_order_relaxed);
+    contended_.fetch_add(1, boost::memory_order_relaxed);
+    wait_.AddSample(waitMicroseconds);
+
+    // Only the contended acquisitions have to lock this mutex
+    boost::mutex::scoped_lock lock(waitersMutex_);
+    Waiter& item = waiters_[waiter];
+    item.count_++;
+    item.totalWait_ += waitMicroseconds;
+  }
+
+
+  void LockProfiler::RecordHold(uint64_t holdMicroseconds)
+  {
+    hold_.AddSample(holdMicroseconds);
+  }
+
+
+  void LockProfiler::PublishMetrics(MetricsRegistry& registry)
+  {
+    ProfilersRegistry& profilers = GetProfilersRegistry();
+    boost::mutex::scoped_lock lock(profilers.mutex_);
+
+    for (std::list<LockProfiler*>::const_iterator it = profilers.profilers_.begin();
+         it != profilers.profilers_.end(); ++it)
+    {
+      LockProfiler& profiler = **it;
+      const std::string labels = MetricsRegistry::FormatPrometheusLabel("mutex", profiler.name_);
+
+      registry.SetIntegerValue("orthanc_lock_acquisitions_count{" + labels + "}",
+                               static_cast<int64_t>(profiler.GetAcquisitionsCount()));
+      registry.SetIntegerValue("orthanc_lock_contended_count{" + labels + "}",
+                               static_cast<int64_t>(profiler.GetContendedCount()));
+      profiler.wait_.Publish(registry, "orthanc_lock_wait_us", labels);
+      profiler.hold_.Publish(registry, "orthanc_lock_hold_us", labels);
+
+      // Copy the waiters, as the metrics registry might itself be profiled
+      std::vector<TopWaiter> waiters;
+
+      {
+        boost::mutex::scoped_lock waitersLock(profiler.waitersMutex_);
+        waiters.reserve(profiler.waiters_.size());
+
+        for (Waiters::const_iterator waiter = profiler.waiters_.begin();
+             waiter != profiler.waiters_.end(); ++waiter)
+        {
+          TopWaiter item;
+          item.name_ = waiter->first;
+          item.count_ = waiter->second.count_;
+          item.totalWait_ = waiter->second.totalWait_;
+          waiters.push_back(item);
+        }
+      }
+
+      std::sort(waiters.begin(), waiters.end());
+
+      for (size_t i = 0; i < waiters.size() && i < TOP_WAITERS_COUNT; i++)
+      {
+        const std::string waiterLabels = (labels + "," + MetricsRegistry::FormatPrometheusLabel("waiter", waiters[i].name_));
+        registry.SetIntegerValue("orthanc_lock_waiter_count{" + waiterLabels + "}", static_cast<int64_t>(waiters[i].count_));
+        registry.SetIntegerValue("orthanc_lock_waiter_wait_us{" + waiterLabels + "}", static_cast<int64_t>(waiters[i].totalWait_));
+      }
+    }
+  }
+}
@@ -0,0 +1,202 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#if !defined(ORTHANC_ENABLE_LOCK_PROFILING)
+#  error The macro ORTHANC_ENABLE_LOCK_PROFILING must be defined
+#endif
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <stdint.h>
+#include <string>
+
+#if ORTHANC_ENABLE_LOCK_PROFILING == 1
+#  include "../ElapsedTimer.h"
+#  include <boost/thread/locks.hpp>
+#endif
+
+
+namespace Orthanc
+{
+  class MetricsRegistry;
+
+  /**
+   * Statistics about the acquisitions of one named mutex (new in
+   * Orthanc 1.12.12): The time spent waiting for the mutex, the time
+   * during which the mutex is held, the number of contended
+   * acquisitions, and the functions that have waited the most. The
+   * objects are meant to be static, and register themselves in a
+   * global list that is exported by "PublishMetrics()".
+   *
+   * The profiling is only active if the framework is built with the
+   * "ENABLE_LOCK_PROFILING" CMake option. Otherwise, the macro
+   * "ORTHANC_PROFILED_LOCK()" below expands to the plain Boost lock,
+   * and the profilers should not be declared, which has no cost.
+   **/
+  class ORTHANC_PUBLIC LockProfiler : public boost::noncopyable
+  {
+  public:
+    // The upper bounds of the buckets of the histograms, in microseconds
+    static const size_t BUCKETS_COUNT = 7;
+
+  private:
+    class Histogram : public boost::noncopyable
+    {
+    private:
+      boost::atomic<uint64_t>  buckets_[BUCKETS_COUNT + 1];  // The last one is "+Inf"
+      boost::atomic<uint64_t>  count_;
+      boost::atomic<uint64_t>  sum_;
+
+    public:
+      Histogram();
+
+      void AddSample(uint64_t microseconds);
+
+      void Publish(MetricsRegistry& registry,
+                   const std::string& name,
+                   const std::string& labels) const;
+    };
+
+    struct Waiter
+    {
+      uint64_t  count_;
+      uint64_t  totalWait_;
+
+      Waiter() :
+        count_(0),
+        totalWait_(0)
+      {
+      }
+    };
+
+    // Indexed by the address of the name of the function, which is a
+    // string literal
+    typedef std::map<const char*, Waiter>  Waiters;
+
+    std::string              name_;
+    boost::atomic<uint64_t>  acquisitions_;
+    boost::atomic<uint64_t>  contended_;
+    Histogram                wait_;
+    Histogram                hold_;
+    boost::mutex             waitersMutex_;
+    Waiters                  waiters_;
+
+  public:
+    // Number of waiters that are exported by "PublishMetrics()"
+    static const size_t TOP_WAITERS_COUNT = 5;
+
+    explicit LockProfiler(const std::string& name);
+
+    ~LockProfiler();
+
+    const std::string& GetName() const
+    {
+      return name_;
+    }
+
+    void RecordUncontendedAcquisition();
+
+    void RecordContendedAcquisition(uint64_t waitMicroseconds,
+                                    const char* waiter);
+
+    void RecordHold(uint64_t holdMicroseconds);
+
+    uint64_t GetAcquisitionsCount() const
+    {
+      return acquisitions_.load(boost::memory_order_relaxed);
+    }
+
+    uint64_t GetContendedCount() const
+    {
+      return contended_.load(boost::memory_order_relaxed);
+    }
+
+    // Publishes the metrics of all the profilers
+    static void PublishMetrics(MetricsRegistry& registry);
+  };
+
+
+#if ORTHANC_ENABLE_LOCK_PROFILING == 1
+  /**
+   * Drop-in replacement for the Boost locks ("boost::mutex::scoped_lock",
+   * "boost::shared_lock<>", ...) that records its waiting and holding
+   * times. It derives from the Boost lock, so that it can be
+   * provided to the condition variables, but the holding time then
+   * includes the time spent in the condition variable.
+   **/
+  template <typename Lock>
+  class ProfiledLock : public Lock
+  {
+  private:
+    LockProfiler&  profiler_;
+    ElapsedTimer   holdTimer_;
+
+  public:
+    template <typename Mutex>
+    ProfiledLock(Mutex& mutex,
+                 LockProfiler& profiler,
+                 const char* waiter) :
+      Lock(mutex, boost::defer_lock),
+      profiler_(profiler)
+    {
+      if (Lock::try_lock())
+      {
+        profiler_.RecordUncontendedAcquisition();
+      }
+      else
+      {
+        ElapsedTimer waitTimer;
+        Lock::lock();
+        profiler_.RecordContendedAcquisition(waitTimer.GetElapsedMicroseconds(), waiter);
+      }
+
+      holdTimer_.Restart();
+    }
+
+    ~ProfiledLock()
+    {
+      if (Lock::owns_lock())
+      {
+        profiler_.RecordHold(holdTimer_.GetElapsedMicroseconds());
+      }
+    }
+  };
+
+#  define ORTHANC_PROFILED_LOCK(lockType, lock, mutex, profiler)      \
+  ::Orthanc::ProfiledLock< lockType > lock(mutex, profiler, __FUNCTION__)
+
+#else
+
+#  define ORTHANC_PROFILED_LOCK(lockType, lock, mutex, profiler)  \
+  lockType lock(mutex)
+
+#endif
+}
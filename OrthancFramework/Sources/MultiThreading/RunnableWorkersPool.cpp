@@ -29,6 +29,7 @@
 #include "../Compatibility.h"
 #include "../OrthancException.h"
 #include "../Logging.h"
+#include "../SystemToolbox.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -45,11 +46,17 @@ namespace Orthanc
       boost::thread         thread_;
       std::string           threadName_;
       MetricsRegistry::SharedMetrics* availableWorkers_;
+      const std::set<unsigned int>& threadsAffinity_;
  
       static void WorkerThread(Worker* that)
       {
         Logging::ScopedCurrentThreadNameSetter setter(that->threadName_);
 
+        if (!that->threadsAffinity_.empty())
+        {
+          SystemToolbox::SetCurrentThreadAffinity(that->threadsAffinity_);
+        }
+
         while (that->continue_)
         {
           try
@@ -98,11 +105,13 @@ namespace Orthanc
       Worker(const bool& globalContinue,
              SharedMessageQueue& queue,
              const std::string& threadName,
-             MetricsRegistry::SharedMetrics* availableWorkers) :
+             MetricsRegistry::SharedMetrics* availableWorkers,
+             const std::set<unsigned int>& threadsAffinity) :
         continue_(globalContinue),
         queue_(queue),
         threadName_(threadName),
-        availableWorkers_(availableWorkers)
+        availableWorkers_(availableWorkers),
+        threadsAffinity_(threadsAffinity)
       {
         thread_ = boost::thread(WorkerThread, this);
       }
@@ -120,6 +129,7 @@ namespace Orthanc
     std::vector<Worker*>  workers_;
     SharedMessageQueue    queue_;
     std::unique_ptr<MetricsRegistry::SharedMetrics>  availableWorkers_;
+    std::set<unsigned int>  threadsAffinity_;
 
   public:
     explicit PImpl(MetricsRegistry::SharedMetrics* availableWorkers /* takes ownership */) :
@@ -132,7 +142,8 @@ namespace Orthanc
 
   void RunnableWorkersPool::Start(size_t countWorkers,
                                   const std::string& baseThreadName,
-                                  MetricsRegistry::SharedMetrics* availableWorkers)
+                                  MetricsRegistry::SharedMetrics* availableWorkers,
+                                  const std::set<unsigned int>& threadsAffinity)
   {
     std::unique_ptr<MetricsRegistry::SharedMetrics> protection(availableWorkers);
 
@@ -143,6 +154,7 @@ namespace Orthanc
 
     pimpl_.reset(new PImpl(protection.release()));
     pimpl_->continue_ = true;
+    pimpl_->threadsAffinity_ = threadsAffinity;
 
     if (countWorkers == 0)
     {
@@ -154,15 +166,39 @@ namespace Orthanc
     for (size_t i = 0; i < countWorkers; i++)
     {
       std::string workerName = baseThreadName + boost::lexical_cast<std::string>(i);
-      pimpl_->workers_[i] = new PImpl::Worker(pimpl_->continue_, pimpl_->queue_, workerName, pimpl_->availableWorkers_.get());
+      pimpl_->workers_[i] = new PImpl::Worker(pimpl_->continue_, pimpl_->queue_, workerName,
+                                               pimpl_->availableWorkers_.get(), pimpl_->threadsAffinity_);
     }
   }
 
 
+  void RunnableWorkersPool::StartWithMetrics(size_t countWorkers,
+                                              const std::string& baseThreadName,
+                                              MetricsRegistry& registry,
+                                              const char* availableWorkersMetricsName,
+                                              const std::set<unsigned int>& threadsAffinity)
+  {
+    std::unique_ptr<MetricsRegistry::SharedMetrics> availableWorkers(
+      new MetricsRegistry::SharedMetrics(registry, availableWorkersMetricsName, MetricsUpdatePolicy_MinOver10Seconds));
+
+    availableWorkers->Add(static_cast<int64_t>(countWorkers)); // mark all workers as available in the metrics
+
+    Start(countWorkers, baseThreadName, availableWorkers.release(), threadsAffinity);
+  }
+
+
   RunnableWorkersPool::RunnableWorkersPool(size_t countWorkers,
                                            const std::string& baseThreadName)
   {
-    Start(countWorkers, baseThreadName, NULL);
+    Start(countWorkers, baseThreadName, NULL, std::set<unsigned int>());
+  }
+
+
+  RunnableWorkersPool::RunnableWorkersPool(size_t countWorkers,
+                                           const std::string& baseThreadName,
+                                           const std::set<unsigned int>& threadsAffinity)
+  {
+    Start(countWorkers, baseThreadName, NULL, threadsAffinity);
   }
 
 
@@ -171,12 +207,17 @@ namespace Orthanc
                                            MetricsRegistry& registry,
                                            const char* availableWorkersMetricsName)
   {
-    std::unique_ptr<MetricsRegistry::SharedMetrics> availableWorkers(
-      new MetricsRegistry::SharedMetrics(registry, availableWorkersMetricsName, MetricsUpdatePolicy_MinOver10Seconds));
+    StartWithMetrics(countWorkers, baseThreadName, registry, availableWorkersMetricsName, std::set<unsigned int>());
+  }
 
-    availableWorkers->Add(static_cast<int64_t>(countWorkers)); // mark all workers as available in the metrics
 
-    Start(countWorkers, baseThreadName, availableWorkers.release());
+  RunnableWorkersPool::RunnableWorkersPool(size_t countWorkers,
+                                           const std::string& baseThreadName,
+                                           MetricsRegistry& registry,
+                                           const char* availableWorkersMetricsName,
+                                           const std::set<unsigned int>& threadsAffinity)
+  {
+    StartWithMetrics(countWorkers, baseThreadName, registry, availableWorkersMetricsName, threadsAffinity);
   }
 
 
@@ -29,6 +29,7 @@
 #include "../MetricsRegistry.h"
 
 #include <boost/shared_ptr.hpp>
+#include <set>
 
 namespace Orthanc
 {
@@ -40,17 +41,36 @@ namespace Orthanc
 
     void Start(size_t countWorkers,
                const std::string& baseThreadName,
-               MetricsRegistry::SharedMetrics* availableWorkers /* can be NULL */);
+               MetricsRegistry::SharedMetrics* availableWorkers /* can be NULL */,
+               const std::set<unsigned int>& threadsAffinity);
+
+    void StartWithMetrics(size_t countWorkers,
+                          const std::string& baseThreadName,
+                          MetricsRegistry& registry,
+                          const char* availableWorkersMetricsName,
+                          const std::set<unsigned int>& threadsAffinity);
 
   public:
     RunnableWorkersPool(size_t countWorkers,
                         const std::string& baseThreadName);
 
+    // New in Orthanc 1.12.12: The workers are pinned to the given
+    // CPUs (an empty set means no affinity)
+    RunnableWorkersPool(size_t countWorkers,
+                        const std::string& baseThreadName,
+                        const std::set<unsigned int>& threadsAffinity);
+
     RunnableWorkersPool(size_t countWorkers,
                         const std::string& name,
                         MetricsRegistry& registry,
                         const char* availableWorkersMetricsName);
 
+    RunnableWorkersPool(size_t countWorkers,
+                        const std::string& name,
+                        MetricsRegistry& registry,
+                        const char* availableWorkersMetricsName,
+                        const std::set<unsigned int>& threadsAffinity);
+
     ~RunnableWorkersPool();
 
     void Add(IRunnableBySteps* runnable);  // Takes the ownership
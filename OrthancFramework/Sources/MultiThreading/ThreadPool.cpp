@@ -27,10 +27,10 @@
 
 #include "../Logging.h"
 #include "../OrthancException.h"
+#include "ExecutorTask.h"
 #include "FutureState.h"
 
 #include <boost/lexical_cast.hpp>
-#include <boost/weak_ptr.hpp>
 
 
 static const unsigned int DEFAULT_DEQUEUE_TIMEOUT_MS = 100;
@@ -38,98 +38,6 @@ static const unsigned int DEFAULT_DEQUEUE_TIMEOUT_MS = 100;
 
 namespace Orthanc
 {
-  class ThreadPool::ITask : public IDynamicObject
-  {
-  public:
-    virtual ~ITask()
-    {
-    }
-
-    virtual void Execute() = 0;
-
-    virtual void Cancel() = 0;
-  };
-
-
-  class ThreadPool::CallableTask : public ITask
-  {
-  private:
-    std::unique_ptr<ICallable>               callable_;
-    boost::weak_ptr<Internals::FutureState>  state_;
-
-  public:
-    CallableTask(ICallable* callable,
-                 boost::shared_ptr<Internals::FutureState>& state) :
-      callable_(callable),
-      state_(state)
-    {
-      assert(callable != NULL);
-    }
-
-    void Execute() ORTHANC_OVERRIDE
-    {
-      boost::shared_ptr<Internals::FutureState> locked = state_.lock();
-
-      if (locked)
-      {
-        try
-        {
-          locked->AcquireResult(callable_->Call());
-        }
-        catch (const OrthancException& e)
-        {
-          locked->SetError(e);
-        }
-        catch (...)
-        {
-          locked->SetError(OrthancException(ErrorCode_InternalError, "Unknown exception in ICallable::Call()"));
-        }
-      }
-      else
-      {
-        // Nothing to do: The future was canceled before we even started
-      }
-    }
-
-    void Cancel() ORTHANC_OVERRIDE
-    {
-      boost::shared_ptr<Internals::FutureState> locked = state_.lock();
-
-      if (locked)
-      {
-        locked->SetError(OrthancException(ErrorCode_CanceledJob));
-      }
-      else
-      {
-        // Nothing to do: The future was canceled before we even started
-      }
-    }
-  };
-
-
-  class ThreadPool::RunnableTask : public ITask
-  {
-  private:
-    std::unique_ptr<IRunnable>  runnable_;
-
-  public:
-    explicit RunnableTask(IRunnable* runnable) :
-      runnable_(runnable)
-    {
-      assert(runnable != NULL);
-    }
-
-    void Execute() ORTHANC_OVERRIDE
-    {
-      runnable_->Run();
-    }
-
-    void Cancel() ORTHANC_OVERRIDE
-    {
-    }
-  };
-
-
   template <bool throws>
   void ThreadPool::StopInternal()
   {
@@ -191,7 +99,7 @@ namespace Orthanc
       {
         try
         {
-          dynamic_cast<ITask&>(*task).Cancel();
+          dynamic_cast<Internals::ExecutorTask&>(*task).Cancel();
         }
         catch (OrthancException& e)
         {
@@ -235,7 +143,7 @@ namespace Orthanc
       {
         try
         {
-          dynamic_cast<ITask&>(*task).Execute();
+          dynamic_cast<Internals::ExecutorTask&>(*task).Execute();
         }
         catch (const OrthancException& e)
         {
@@ -384,7 +292,7 @@ namespace Orthanc
 
     boost::shared_ptr<Internals::FutureState> state(boost::make_shared<Internals::FutureState>());
 
-    queue_.Enqueue(new CallableTask(protection.release(), state));
+    queue_.Enqueue(Internals::ExecutorTask::CreateCallable(protection.release(), state));
 
     return new Future(state);
   }
@@ -408,7 +316,7 @@ namespace Orthanc
       }
     }
 
-    queue_.Enqueue(new RunnableTask(protection.release()));
+    queue_.Enqueue(Internals::ExecutorTask::CreateRunnable(protection.release()));
   }
 
 
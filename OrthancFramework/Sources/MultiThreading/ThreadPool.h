@@ -42,10 +42,6 @@ namespace Orthanc
       State_Finalization
     };
 
-    class ITask;
-    class CallableTask;
-    class RunnableTask;
-
     SharedMessageQueue                    queue_;
     std::unique_ptr<boost::thread_group>  workers_;
     boost::mutex                          mutex_;
@@ -0,0 +1,547 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "WorkStealingThreadPool.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+#include "ExecutorTask.h"
+#include "FutureState.h"
+
+#include <boost/lexical_cast.hpp>
+
+
+static const unsigned int DEFAULT_DEQUEUE_TIMEOUT_MS = 100;
+
+
+namespace Orthanc
+{
+  namespace
+  {
+    /**
+     * Information about the current thread, so that the tasks that
+     * are submitted by a worker go to its own deque, and so that the
+     * round-robin distribution of the other threads does not need a
+     * shared counter.
+     **/
+    struct SubmitterInfo
+    {
+      const WorkStealingThreadPool*  pool_;
+      size_t                         worker_;
+      size_t                         next_;
+
+      SubmitterInfo() :
+        pool_(NULL),
+        worker_(0),
+        next_(0)
+      {
+      }
+    };
+
+    static boost::thread_specific_ptr<SubmitterInfo>  submitter_;
+
+    static SubmitterInfo& GetSubmitterInfo()
+    {
+      if (submitter_.get() == NULL)
+      {
+        submitter_.reset(new SubmitterInfo);
+      }
+
+      return *submitter_;
+    }
+  }
+
+
+  class WorkStealingThreadPool::Worker : public boost::noncopyable
+  {
+  private:
+    boost::mutex                           mutex_;
+    boost::condition_variable              wakeup_;
+    std::deque<Internals::ExecutorTask*>   tasks_;
+    bool                                   running_;
+
+  public:
+    Worker() :
+      running_(true)
+    {
+    }
+
+    ~Worker()
+    {
+      assert(tasks_.empty());
+    }
+
+    // Returns "false" iff the worker is stopping
+    bool Push(Internals::ExecutorTask* task)
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (!running_)
+        {
+          return false;
+        }
+
+        tasks_.push_back(task);
+      }
+
+      wakeup_.notify_one();
+      return true;
+    }
+
+    // Used by the owner of the deque: Last-in, first-out, as the most
+    // recent task is the most likely to be still in the CPU cache
+    Internals::ExecutorTask* PopBack(unsigned int timeout,
+                                     bool& running)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (timeout > 0 &&
+          running_ &&
+          tasks_.empty())
+      {
+        wakeup_.timed_wait(lock, boost::posix_time::milliseconds(timeout));
+      }
+
+      running = running_;
+
+      if (!running_ ||
+          tasks_.empty())
+      {
+        return NULL;
+      }
+      else
+      {
+        Internals::ExecutorTask* task = tasks_.back();
+        tasks_.pop_back();
+        return task;
+      }
+    }
+
+    // Used by the thieves: The oldest task is taken. "try_lock()"
+    // avoids piling up several thieves on the same deque.
+    Internals::ExecutorTask* StealFront()
+    {
+      boost::mutex::scoped_lock lock(mutex_, boost::try_to_lock);
+
+      if (!lock.owns_lock() ||
+          !running_ ||
+          tasks_.empty())
+      {
+        return NULL;
+      }
+      else
+      {
+        Internals::ExecutorTask* task = tasks_.front();
+        tasks_.pop_front();
+        return task;
+      }
+    }
+
+    void SignalStop()
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        running_ = false;
+      }
+
+      wakeup_.notify_all();
+    }
+
+    // Only used once the thread of the worker is stopped
+    Internals::ExecutorTask* PopRemaining()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (tasks_.empty())
+      {
+        return NULL;
+      }
+      else
+      {
+        Internals::ExecutorTask* task = tasks_.front();
+        tasks_.pop_front();
+        return task;
+      }
+    }
+  };
+
+
+  template <bool throws>
+  void WorkStealingThreadPool::StopInternal()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      switch (state_)
+      {
+        case State_Initialization:
+          if (throws)
+          {
+            throw OrthancException(ErrorCode_BadSequenceOfCalls, "Start() has not been called");
+          }
+          else
+          {
+            return;  // This is for the destructor
+          }
+
+        case State_Finalization:
+          if (throws)
+          {
+            throw OrthancException(ErrorCode_BadSequenceOfCalls, "Concurrent access to Stop()");
+          }
+          else
+          {
+            return;  // This is for the destructor, should never happen
+          }
+
+        case State_Running:
+          state_ = State_Finalization;
+          break;
+
+        default:
+          if (throws)
+          {
+            THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+          }
+          else
+          {
+            return;  // This is for the destructor
+          }
+      }
+    }
+
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+      workers_[i]->SignalStop();
+    }
+
+    assert(threads_.get() != NULL);
+    threads_->join_all();
+    threads_.reset(NULL);
+
+    // Cancel all the remaining tasks in the deques
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+      for (;;)
+      {
+        std::unique_ptr<Internals::ExecutorTask> task(workers_[i]->PopRemaining());
+
+        if (task.get() == NULL)
+        {
+          break;
+        }
+        else
+        {
+          try
+          {
+            task->Cancel();
+          }
+          catch (OrthancException& e)
+          {
+            LOG(ERROR) << "Error while canceling task during shutdown: " << e.What();
+          }
+        }
+      }
+
+      delete workers_[i];
+    }
+
+    workers_.clear();
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      state_ = State_Initialization;
+    }
+  }
+
+
+  Internals::ExecutorTask* WorkStealingThreadPool::StealTask(size_t thief)
+  {
+    // Start with the neighbour, so that the thieves do not all target the same victim
+    for (size_t i = 1; i < workers_.size(); i++)
+    {
+      Internals::ExecutorTask* task = workers_[(thief + i) % workers_.size()]->StealFront();
+      if (task != NULL)
+      {
+        return task;
+      }
+    }
+
+    return NULL;
+  }
+
+
+  void WorkStealingThreadPool::WorkerLoop(size_t index,
+                                          const std::string& threadName)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter(threadName);
+
+    {
+      SubmitterInfo& info = GetSubmitterInfo();
+      info.pool_ = this;
+      info.worker_ = index;
+    }
+
+    assert(index < workers_.size());
+    Worker& worker = *workers_[index];
+
+    for (;;)
+    {
+      // Don't wait if an idle worker could steal some task
+      bool running;
+      std::unique_ptr<Internals::ExecutorTask> task(worker.PopBack(0, running));
+
+      if (!running)
+      {
+        break;
+      }
+
+      if (task.get() == NULL)
+      {
+        task.reset(StealTask(index));
+      }
+
+      if (task.get() == NULL)
+      {
+        task.reset(worker.PopBack(dequeueTimeoutMilliseconds_, running));
+
+        if (!running)
+        {
+          break;
+        }
+      }
+
+      if (task.get() != NULL)
+      {
+        try
+        {
+          task->Execute();
+        }
+        catch (const OrthancException& e)
+        {
+          LOG(ERROR) << "Exception while executing a task: " << e.What();
+        }
+        catch (...)
+        {
+          LOG(ERROR) << "Native exception while executing a task";
+        }
+      }
+    }
+
+    submitter_.reset(NULL);
+  }
+
+
+  void WorkStealingThreadPool::Enqueue(Internals::ExecutorTask* task)
+  {
+    std::unique_ptr<Internals::ExecutorTask> protection(task);
+
+    if (workers_.empty())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "The thread pool is not running");
+    }
+
+    SubmitterInfo& info = GetSubmitterInfo();
+
+    size_t target;
+    if (info.pool_ == this)
+    {
+      target = info.worker_;
+    }
+    else
+    {
+      target = info.next_ % workers_.size();
+      info.next_++;
+    }
+
+    if (workers_[target]->Push(protection.get()))
+    {
+      protection.release();
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "The thread pool is not running");
+    }
+  }
+
+
+  WorkStealingThreadPool::WorkStealingThreadPool() :
+    loggingThreadName_("POOL"),
+    countThreads_(1),
+    state_(State_Initialization),
+    dequeueTimeoutMilliseconds_(DEFAULT_DEQUEUE_TIMEOUT_MS)
+  {
+  }
+
+
+  WorkStealingThreadPool::~WorkStealingThreadPool()
+  {
+    StopInternal<false>();  // don't throw in destructor
+  }
+
+
+  void WorkStealingThreadPool::SetLoggingThreadName(const std::string& name)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (state_ == State_Initialization)
+    {
+      loggingThreadName_ = name;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "Start() has already been called");
+    }
+  }
+
+
+  void WorkStealingThreadPool::SetCountThreads(unsigned int count)
+  {
+    if (count < 1)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (state_ == State_Initialization)
+      {
+        countThreads_ = count;
+      }
+      else
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls, "Start() has already been called");
+      }
+    }
+  }
+
+
+  unsigned int WorkStealingThreadPool::GetCountThreads()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return countThreads_;
+  }
+
+
+  void WorkStealingThreadPool::SetDequeueTimeout(unsigned int milliseconds)
+  {
+    if (milliseconds < 1)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (state_ == State_Initialization)
+      {
+        dequeueTimeoutMilliseconds_ = milliseconds;
+      }
+      else
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls, "Start() has already been called");
+      }
+    }
+  }
+
+
+  unsigned int WorkStealingThreadPool::GetDequeueTimeout()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return dequeueTimeoutMilliseconds_;
+  }
+
+
+  void WorkStealingThreadPool::Start()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (state_ == State_Initialization)
+    {
+      assert(countThreads_ >= 1);
+
+      state_ = State_Running;
+
+      // All the workers must exist before the first thread starts stealing
+      assert(workers_.empty());
+      for (unsigned int i = 0; i < countThreads_; i++)
+      {
+        workers_.push_back(new Worker);
+      }
+
+      assert(threads_.get() == NULL);
+      threads_.reset(new boost::thread_group);
+
+      for (unsigned int i = 0; i < countThreads_; i++)
+      {
+        const std::string threadName = loggingThreadName_ + "-" + boost::lexical_cast<std::string>(i);
+        threads_->create_thread(boost::bind(&WorkStealingThreadPool::WorkerLoop, this, i, threadName));
+      }
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "Start() has not been called");
+    }
+  }
+
+
+  Future* WorkStealingThreadPool::Submit(ICallable* callable)
+  {
+    std::unique_ptr<ICallable> protection(callable);
+
+    if (callable == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    boost::shared_ptr<Internals::FutureState> state(boost::make_shared<Internals::FutureState>());
+
+    Enqueue(Internals::ExecutorTask::CreateCallable(protection.release(), state));
+
+    return new Future(state);
+  }
+
+
+  void WorkStealingThreadPool::Submit(IRunnable* runnable)
+  {
+    std::unique_ptr<IRunnable> protection(runnable);
+
+    if (runnable == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    Enqueue(Internals::ExecutorTask::CreateRunnable(protection.release()));
+  }
+
+
+  void WorkStealingThreadPool::Stop()
+  {
+    StopInternal<true>();
+  }
+}
@@ -0,0 +1,110 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Compatibility.h"
+#include "IExecutorService.h"
+
+#include <boost/thread.hpp>
+#include <deque>
+#include <vector>
+
+namespace Orthanc
+{
+  namespace Internals
+  {
+    class ExecutorTask;
+  }
+
+  /**
+   * Drop-in replacement for ThreadPool, that is meant to execute
+   * large numbers of small tasks. Each worker owns a deque of tasks
+   * that is protected by its own mutex, instead of sharing one single
+   * queue between all the workers. The tasks are submitted in a
+   * round-robin fashion (or to the own deque of the submitting
+   * thread, if it is a worker of the pool), each worker pops the
+   * most recent tasks of its own deque, and the idle workers steal
+   * the oldest tasks from the deques of the other workers.
+   *
+   * Contrarily to ThreadPool, "Submit()" must not be called
+   * concurrently with "Start()" or "Stop()".
+   **/
+  class ORTHANC_PUBLIC WorkStealingThreadPool : public IExecutorService
+  {
+  private:
+    enum State
+    {
+      State_Initialization,
+      State_Running,
+      State_Finalization
+    };
+
+    class Worker;
+
+    std::vector<Worker*>                  workers_;
+    std::unique_ptr<boost::thread_group>  threads_;
+    boost::mutex                          mutex_;
+    std::string                           loggingThreadName_;
+    unsigned int                          countThreads_;
+    State                                 state_;
+    unsigned int                          dequeueTimeoutMilliseconds_;
+
+    template <bool throws>
+    void StopInternal();
+
+    void WorkerLoop(size_t index,
+                    const std::string& threadName);
+
+    Internals::ExecutorTask* StealTask(size_t thief);
+
+    void Enqueue(Internals::ExecutorTask* task /* takes ownership */);
+
+  public:
+    WorkStealingThreadPool();
+
+    virtual ~WorkStealingThreadPool() ORTHANC_OVERRIDE;
+
+    void SetLoggingThreadName(const std::string& name);
+
+    void SetCountThreads(unsigned int count);
+
+    unsigned int GetCountThreads();
+
+    // Maximum time spent by an idle worker before it tries to steal
+    // tasks from the other workers
+    void SetDequeueTimeout(unsigned int milliseconds);
+
+    unsigned int GetDequeueTimeout();
+
+    void Start();
+
+    virtual Future* Submit(ICallable* callable /* takes ownership */) ORTHANC_OVERRIDE;
+
+    virtual void Submit(IRunnable* runnable /* takes ownership */) ORTHANC_OVERRIDE;
+
+    virtual void Stop() ORTHANC_OVERRIDE;
+  };
+}
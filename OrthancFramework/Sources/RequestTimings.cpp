@@ -0,0 +1,232 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeaders.h"
+#include "RequestTimings.h"
+
+#include "ElapsedTimer.h"
+#include "OrthancException.h"
+
+#include <boost/thread/tss.hpp>
+#include <cassert>
+#include <stdio.h>
+
+
+namespace Orthanc
+{
+  static void NoCleanup(RequestTimings::Scope* scope)
+  {
+    // The scopes are owned by their creator, not by the thread
+  }
+
+  static boost::thread_specific_ptr<RequestTimings::Scope>  currentScope_(NoCleanup);
+
+
+  RequestTimings::Scope::Scope() :
+    previous_(currentScope_.get()),
+    activeTimers_(0),
+    serverTiming_(false)
+  {
+    for (int i = 0; i < Category_Count; i++)
+    {
+      microseconds_[i] = 0;
+    }
+
+    for (int i = 0; i < Counter_Count; i++)
+    {
+      counters_[i] = 0;
+    }
+
+    currentScope_.reset(this);
+  }
+
+
+  RequestTimings::Scope::~Scope()
+  {
+    currentScope_.reset(previous_);
+  }
+
+
+  uint64_t RequestTimings::Scope::GetMicroseconds(Category category) const
+  {
+    if (category < 0 ||
+        category >= Category_Count)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      return microseconds_[category];
+    }
+  }
+
+
+  uint64_t RequestTimings::Scope::GetCounter(Counter counter) const
+  {
+    if (counter < 0 ||
+        counter >= Counter_Count)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      return counters_[counter];
+    }
+  }
+
+
+  static double ToMilliseconds(uint64_t microseconds)
+  {
+    return static_cast<double>(microseconds) / 1000.0;
+  }
+
+
+  std::string RequestTimings::Scope::Format() const
+  {
+    char buf[256];
+    sprintf(buf, "database %.1fms (%llu transactions, %llu retries), storage %.1fms "
+            "(%llu bytes read, %llu cache hits), codec %.1fms, plugins %.1fms",
+            ToMilliseconds(microseconds_[Category_Database]),
+            static_cast<unsigned long long>(counters_[Counter_DatabaseTransactions]),
+            static_cast<unsigned long long>(counters_[Counter_DatabaseRetries]),
+            ToMilliseconds(microseconds_[Category_Storage]),
+            static_cast<unsigned long long>(counters_[Counter_StorageBytesRead]),
+            static_cast<unsigned long long>(counters_[Counter_StorageCacheHits]),
+            ToMilliseconds(microseconds_[Category_Codec]),
+            ToMilliseconds(microseconds_[Category_Plugins]));
+    return buf;
+  }
+
+
+  std::string RequestTimings::Scope::FormatServerTiming() const
+  {
+    // https://www.w3.org/TR/server-timing/
+    char buf[384];
+    sprintf(buf, "db;dur=%.1f;desc=\"%llu transactions, %llu retries\", "
+            "storage;dur=%.1f;desc=\"%llu bytes read, %llu cache hits\", "
+            "codec;dur=%.1f, plugins;dur=%.1f",
+            ToMilliseconds(microseconds_[Category_Database]),
+            static_cast<unsigned long long>(counters_[Counter_DatabaseTransactions]),
+            static_cast<unsigned long long>(counters_[Counter_DatabaseRetries]),
+            ToMilliseconds(microseconds_[Category_Storage]),
+            static_cast<unsigned long long>(counters_[Counter_StorageBytesRead]),
+            static_cast<unsigned long long>(counters_[Counter_StorageCacheHits]),
+            ToMilliseconds(microseconds_[Category_Codec]),
+            ToMilliseconds(microseconds_[Category_Plugins]));
+    return buf;
+  }
+
+
+  void RequestTimings::Scope::Format(Json::Value& target) const
+  {
+    target = Json::objectValue;
+    target["DatabaseMs"] = ToMilliseconds(microseconds_[Category_Database]);
+    target["DatabaseTransactions"] = static_cast<Json::UInt64>(counters_[Counter_DatabaseTransactions]);
+    target["DatabaseRetries"] = static_cast<Json::UInt64>(counters_[Counter_DatabaseRetries]);
+    target["StorageMs"] = ToMilliseconds(microseconds_[Category_Storage]);
+    target["StorageBytesRead"] = static_cast<Json::UInt64>(counters_[Counter_StorageBytesRead]);
+    target["StorageCacheHits"] = static_cast<Json::UInt64>(counters_[Counter_StorageCacheHits]);
+    target["CodecMs"] = ToMilliseconds(microseconds_[Category_Codec]);
+    target["PluginsMs"] = ToMilliseconds(microseconds_[Category_Plugins]);
+  }
+
+
+  struct RequestTimings::Timer::PImpl
+  {
+    Category      category_;
+    ElapsedTimer  timer_;
+  };
+
+
+  RequestTimings::Timer::Timer(Category category) :
+    pimpl_(NULL),
+    scope_(currentScope_.get())
+  {
+    if (scope_ != NULL)
+    {
+      if (scope_->activeTimers_ == 0)
+      {
+        pimpl_ = new PImpl;
+        pimpl_->category_ = category;
+      }
+
+      scope_->activeTimers_++;
+    }
+  }
+
+
+  RequestTimings::Timer::~Timer()
+  {
+    if (scope_ != NULL)
+    {
+      assert(scope_->activeTimers_ > 0);
+      scope_->activeTimers_--;
+
+      if (pimpl_ != NULL)
+      {
+        scope_->microseconds_[pimpl_->category_] += pimpl_->timer_.GetElapsedMicroseconds();
+        delete pimpl_;
+      }
+    }
+  }
+
+
+  const RequestTimings::Scope* RequestTimings::GetCurrentScope()
+  {
+    return currentScope_.get();
+  }
+
+
+  void RequestTimings::AddToCounter(Counter counter,
+                                    uint64_t value)
+  {
+    if (counter < 0 ||
+        counter >= Counter_Count)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    Scope* scope = currentScope_.get();
+    if (scope != NULL)
+    {
+      scope->counters_[counter] += value;
+    }
+  }
+
+
+  bool RequestTimings::FormatCurrentServerTiming(std::string& target)
+  {
+    const Scope* scope = currentScope_.get();
+    if (scope != NULL &&
+        scope->serverTiming_)
+    {
+      target = scope->FormatServerTiming();
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+}
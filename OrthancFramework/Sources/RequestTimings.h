@@ -0,0 +1,144 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "OrthancFramework.h"
+
+#include <boost/noncopyable.hpp>
+#include <json/value.h>
+#include <stdint.h>
+#include <string>
+
+
+namespace Orthanc
+{
+  /**
+   * Breakdown of the time spent by the current thread while serving
+   * one request (e.g. one REST call), in the main subsystems of
+   * Orthanc. A "Scope" object installs the accumulators for the
+   * calling thread, and the "Timer" objects created by this thread
+   * during the lifetime of the scope add their duration to the
+   * accumulators. If no scope is installed, the timers are no-op.
+   * Nested timers are attributed to the outermost timer, so that
+   * the same time is never counted twice. The scope also holds
+   * counters of the resources that are consumed by the request
+   * (database transactions, bytes read from the storage area...),
+   * which are incremented by "AddToCounter()".
+   *
+   * The accounting can be exposed to the HTTP clients through the
+   * "Server-Timing" header of the W3C, which is then added by
+   * "HttpOutput" when sending the HTTP header of the answer.
+   **/
+  class ORTHANC_PUBLIC RequestTimings : public boost::noncopyable
+  {
+  public:
+    enum Category
+    {
+      Category_Database,
+      Category_Storage,
+      Category_Codec,
+      Category_Plugins,  // New in Orthanc 1.12.12
+      Category_Count     // Must be the last value
+    };
+
+    enum Counter
+    {
+      Counter_DatabaseTransactions,
+      Counter_DatabaseRetries,
+      Counter_StorageBytesRead,
+      Counter_StorageCacheHits,
+      Counter_Count  // Must be the last value
+    };
+
+    class Timer;
+
+    class ORTHANC_PUBLIC Scope : public boost::noncopyable
+    {
+    private:
+      Scope*        previous_;
+      unsigned int  activeTimers_;
+      uint64_t      microseconds_[Category_Count];
+      uint64_t      counters_[Counter_Count];
+      bool          serverTiming_;
+
+      friend class Timer;
+      friend class RequestTimings;
+
+    public:
+      Scope();
+
+      ~Scope();
+
+      uint64_t GetMicroseconds(Category category) const;
+
+      uint64_t GetCounter(Counter counter) const;
+
+      // Whether "HttpOutput" must add the "Server-Timing" header
+      void SetServerTimingExposed(bool exposed)
+      {
+        serverTiming_ = exposed;
+      }
+
+      bool IsServerTimingExposed() const
+      {
+        return serverTiming_;
+      }
+
+      // Returns e.g. "database 12.3ms (2 transactions, 0 retries), storage 0.4ms
+      // (1024 bytes read, 1 cache hits), codec 0.0ms, plugins 0.0ms"
+      std::string Format() const;
+
+      // Returns the value of the "Server-Timing" HTTP header
+      std::string FormatServerTiming() const;
+
+      // For structured logs
+      void Format(Json::Value& target) const;
+    };
+
+    class ORTHANC_PUBLIC Timer : public boost::noncopyable
+    {
+    private:
+      struct PImpl;  // To hold "ElapsedTimer"
+      PImpl*  pimpl_;
+      Scope*  scope_;
+
+    public:
+      explicit Timer(Category category);
+
+      ~Timer();
+    };
+
+    // Returns NULL if no scope is installed in the calling thread
+    static const Scope* GetCurrentScope();
+
+    // No-op if no scope is installed in the calling thread
+    static void AddToCounter(Counter counter,
+                             uint64_t value);
+
+    // Returns "false" if no scope is installed in the calling thread,
+    // or if this scope doesn't expose the "Server-Timing" header
+    static bool FormatCurrentServerTiming(std::string& target);
+  };
+}
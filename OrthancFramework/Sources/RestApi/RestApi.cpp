@@ -53,9 +53,11 @@ namespace Orthanc
       const HttpToolbox::Arguments& getArguments_;
       const void* bodyData_;
       size_t bodySize_;
+      std::string& route_;
 
     public:
-      HttpHandlerVisitor(RestApi& api,
+      HttpHandlerVisitor(std::string& route /* out */,
+                         RestApi& api,
                          RestApiOutput& output,
                          RequestOrigin origin,
                          const char* remoteIp,
@@ -74,7 +76,8 @@ namespace Orthanc
         headers_(headers),
         getArguments_(getArguments),
         bodyData_(bodyData),
-        bodySize_(bodySize)
+        bodySize_(bodySize),
+        route_(route)
       {
       }
 
@@ -86,6 +89,8 @@ namespace Orthanc
       {
         if (resource.HasHandler(method_))
         {
+          route_ = resource.GetPath();
+
           switch (method_)
           {
             case HttpMethod_Get:
@@ -795,6 +800,27 @@ namespace Orthanc
                        size_t bodySize,
                        const std::string& authenticationPayload)
   {
+    std::string route;
+    return HandleAndGetRoute(route, output, origin, remoteIp, username, method,
+                             uri, headers, getArguments, bodyData, bodySize, authenticationPayload);
+  }
+
+
+  bool RestApi::HandleAndGetRoute(std::string& route,
+                                  HttpOutput& output,
+                                  RequestOrigin origin,
+                                  const char* remoteIp,
+                                  const char* username,
+                                  HttpMethod method,
+                                  const UriComponents& uri,
+                                  const HttpToolbox::Arguments& headers,
+                                  const HttpToolbox::GetArguments& getArguments,
+                                  const void* bodyData,
+                                  size_t bodySize,
+                                  const std::string& authenticationPayload)
+  {
+    route.clear();
+
     RestApiOutput wrappedOutput(output, method);
 
 #if ORTHANC_ENABLE_PUGIXML == 1
@@ -825,7 +851,9 @@ namespace Orthanc
     HttpToolbox::Arguments compiled;
     HttpToolbox::CompileGetArguments(compiled, getArguments);
 
-    HttpHandlerVisitor visitor(*this, wrappedOutput, origin, remoteIp, username, 
+    // The route is set before invoking the handler, so that it is
+    // available to the caller even if the handler throws an exception
+    HttpHandlerVisitor visitor(route, *this, wrappedOutput, origin, remoteIp, username, 
                                method, headers, compiled, bodyData, bodySize);
 
     if (root_.LookupResource(uri, visitor))
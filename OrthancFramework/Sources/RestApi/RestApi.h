@@ -61,6 +61,21 @@ namespace Orthanc
                         size_t bodySize,
                         const std::string& authenticationPayload) ORTHANC_OVERRIDE;
 
+    // Same as "Handle()", but also returns the template of the URI of
+    // the route that served the request (empty if no route matched)
+    bool HandleAndGetRoute(std::string& route,
+                           HttpOutput& output,
+                           RequestOrigin origin,
+                           const char* remoteIp,
+                           const char* username,
+                           HttpMethod method,
+                           const UriComponents& uri,
+                           const HttpToolbox::Arguments& headers,
+                           const HttpToolbox::GetArguments& getArguments,
+                           const void* bodyData,
+                           size_t bodySize,
+                           const std::string& authenticationPayload);
+
     void Register(const std::string& path,
                   RestApiGetCall::Handler handler);
 
@@ -189,10 +189,12 @@ namespace Orthanc
       if (path.IsUniversalTrailing())
       {
         handlersWithTrailing_.Register(handler);
+        handlersWithTrailing_.SetPath(path.Format());
       }
       else
       {
         handlers_.Register(handler);
+        handlers_.SetPath(path.Format());
       }
     }
     else
@@ -43,10 +43,21 @@ namespace Orthanc
       RestApiPostCall::Handler    postHandler_;
       RestApiPutCall::Handler     putHandler_;
       RestApiDeleteCall::Handler  deleteHandler_;
+      std::string                 path_;  // Template of the registered URI
 
     public:
       Resource();
 
+      void SetPath(const std::string& path)
+      {
+        path_ = path;
+      }
+
+      const std::string& GetPath() const
+      {
+        return path_;
+      }
+
       bool HasHandler(HttpMethod method) const;
 
       void Register(RestApiGetCall::Handler handler);
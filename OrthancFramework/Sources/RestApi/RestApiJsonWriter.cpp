@@ -0,0 +1,124 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "RestApiJsonWriter.h"
+
+#include "../OrthancException.h"
+#include "../Toolbox.h"
+
+#include <json/writer.h>
+
+
+namespace Orthanc
+{
+  void RestApiJsonWriter::OpenItem()
+  {
+    if (isClosed_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "The JSON answer is already closed");
+    }
+
+    if (count_ > 0)
+    {
+      buffer_ += ",\n";
+    }
+
+    count_++;
+  }
+
+
+  RestApiJsonWriter::RestApiJsonWriter(Json::ValueType type) :
+    isClosed_(false),
+    count_(0)
+  {
+    switch (type)
+    {
+      case Json::arrayValue:
+        isArray_ = true;
+        buffer_ = "[\n";
+        break;
+
+      case Json::objectValue:
+        isArray_ = false;
+        buffer_ = "{\n";
+        break;
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  void RestApiJsonWriter::Append(const Json::Value& item)
+  {
+    if (!isArray_)
+    {
+      throw OrthancException(ErrorCode_BadParameterType, "The JSON answer is not an array");
+    }
+
+    OpenItem();
+
+    std::string s;
+    Toolbox::WriteStyledJson(s, item);
+    buffer_ += s;
+  }
+
+
+  void RestApiJsonWriter::SetMember(const std::string& key,
+                                    const Json::Value& value)
+  {
+    if (isArray_)
+    {
+      throw OrthancException(ErrorCode_BadParameterType, "The JSON answer is not an object");
+    }
+
+    OpenItem();
+
+    std::string s;
+    Toolbox::WriteStyledJson(s, value);
+
+    buffer_ += Json::valueToQuotedString(key.c_str());
+    buffer_ += " : ";
+    buffer_ += s;
+  }
+
+
+  const std::string& RestApiJsonWriter::GetSerialized()
+  {
+    if (!isClosed_)
+    {
+      if (count_ > 0)
+      {
+        buffer_ += "\n";
+      }
+
+      buffer_ += (isArray_ ? "]\n" : "}\n");
+      isClosed_ = true;
+    }
+
+    return buffer_;
+  }
+}
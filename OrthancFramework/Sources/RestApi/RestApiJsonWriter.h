@@ -0,0 +1,74 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#include <boost/noncopyable.hpp>
+#include <json/value.h>
+#include <string>
+
+namespace Orthanc
+{
+  /**
+   * Serializes the JSON array or the JSON object that answers a REST
+   * call, item after item (new in Orthanc 1.12.12). Contrarily to the
+   * construction of a Json::Value for the full answer, each item can
+   * be freed as soon as it is appended: The answer is only stored in
+   * one serialized buffer, which avoids the allocation of all the
+   * nodes and strings of the full JSON tree. The layout is the same
+   * as "Toolbox::WriteStyledJson()" for each item.
+   **/
+  class RestApiJsonWriter : public boost::noncopyable
+  {
+  private:
+    bool         isArray_;
+    bool         isClosed_;
+    size_t       count_;
+    std::string  buffer_;
+
+    void OpenItem();
+
+  public:
+    // "type" must be "Json::arrayValue" or "Json::objectValue"
+    explicit RestApiJsonWriter(Json::ValueType type);
+
+    // Only for arrays
+    void Append(const Json::Value& item);
+
+    // Only for objects. The keys are not checked for uniqueness.
+    void SetMember(const std::string& key,
+                   const Json::Value& value);
+
+    size_t GetCount() const
+    {
+      return count_;
+    }
+
+    // Returns the serialized JSON, which is closed on the first call
+    const std::string& GetSerialized();
+  };
+}
@@ -87,6 +87,60 @@ namespace Orthanc
   }
 
 
+  void RestApiOutput::AnswerPartialContent(IHttpStreamAnswer& stream,
+                                           uint64_t start,
+                                           uint64_t resourceSize)
+  {
+    CheckStatus();
+    output_.AnswerPartialContent(stream, start, resourceSize);
+    alreadySent_ = true;
+  }
+
+
+  void RestApiOutput::StartStream(const std::string& contentType)
+  {
+    CheckStatus();
+    output_.StartStream(contentType);
+    alreadySent_ = true;
+  }
+
+
+  void RestApiOutput::SendStreamItem(const void* data,
+                                     size_t size)
+  {
+    output_.SendStreamItem(data, size);
+  }
+
+
+  void RestApiOutput::CloseStream()
+  {
+    output_.CloseStream();
+  }
+
+
+  void RestApiOutput::StartMultipart(const std::string& subType,
+                                     const std::string& contentType)
+  {
+    CheckStatus();
+    output_.StartMultipart(subType, contentType);
+    alreadySent_ = true;
+  }
+
+
+  void RestApiOutput::SendMultipartItem(const void* item,
+                                        size_t size,
+                                        const std::map<std::string, std::string>& headers)
+  {
+    output_.SendMultipartItem(item, size, headers);
+  }
+
+
+  void RestApiOutput::CloseMultipart()
+  {
+    output_.CloseMultipart();
+  }
+
+
   void RestApiOutput::AnswerJson(const Json::Value& value)
   {
     CheckStatus();
@@ -115,6 +169,59 @@ namespace Orthanc
     alreadySent_ = true;
   }
 
+  void RestApiOutput::AnswerJson(const Json::Value& value,
+                                 HttpStatus status)
+  {
+    CheckStatus();
+
+    std::string s;
+
+    if (convertJsonToXml_)
+    {
+#if ORTHANC_ENABLE_PUGIXML == 1
+      Toolbox::JsonToXml(s, value);
+      output_.SetContentType(MIME_XML_UTF8);
+#else
+      throw OrthancException(ErrorCode_InternalError,
+                             "Orthanc was compiled without XML support");
+#endif
+    }
+    else
+    {
+      Toolbox::WriteStyledJson(s, value);
+      output_.SetContentType(MIME_JSON_UTF8);
+    }
+
+    output_.SendStatus(status, s);
+    alreadySent_ = true;
+  }
+
+  void RestApiOutput::AnswerJson(RestApiJsonWriter& writer)
+  {
+    CheckStatus();
+
+    const std::string& serialized = writer.GetSerialized();
+
+    if (convertJsonToXml_)
+    {
+      Json::Value json;
+      if (Toolbox::ReadJson(json, serialized))
+      {
+        AnswerJson(json);
+      }
+      else
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+    else
+    {
+      output_.SetContentType(MIME_JSON_UTF8);
+      output_.Answer(serialized);
+      alreadySent_ = true;
+    }
+  }
+
   void RestApiOutput::AnswerBuffer(const std::string& buffer,
                                    MimeType contentType)
   {
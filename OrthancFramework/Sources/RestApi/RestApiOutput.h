@@ -26,6 +26,7 @@
 
 #include "../HttpServer/HttpOutput.h"
 #include "../HttpServer/HttpFileSender.h"
+#include "RestApiJsonWriter.h"
 
 #include <json/value.h>
 
@@ -70,8 +71,46 @@ namespace Orthanc
 
     void AnswerWithoutBuffering(IHttpStreamAnswer& stream);
 
+    // Answers with "206 Partial Content" (new in Orthanc 1.12.12)
+    void AnswerPartialContent(IHttpStreamAnswer& stream,
+                              uint64_t start,
+                              uint64_t resourceSize);
+
+    /**
+     * Sends an answer whose content is produced progressively, using
+     * chunked transfer (new in Orthanc 1.12.12). Contrarily to
+     * "AnswerWithoutBuffering()", the caller pushes the items. Such
+     * an answer cannot be compressed.
+     **/
+    void StartStream(const std::string& contentType);
+
+    void SendStreamItem(const void* data,
+                        size_t size);
+
+    void CloseStream();
+
+    // Same as the streams above, for a multipart answer whose items
+    // are pushed by the caller (new in Orthanc 1.12.12)
+    void StartMultipart(const std::string& subType,
+                        const std::string& contentType);
+
+    void SendMultipartItem(const void* item,
+                           size_t size,
+                           const std::map<std::string, std::string>& headers);
+
+    void CloseMultipart();
+
     void AnswerJson(const Json::Value& value);
 
+    // New in Orthanc 1.12.12, for the HTTP status codes of success
+    // other than "200 OK" (e.g. "202 Accepted"). The answer is not
+    // compressed.
+    void AnswerJson(const Json::Value& value,
+                    HttpStatus status);
+
+    // New in Orthanc 1.12.12
+    void AnswerJson(RestApiJsonWriter& writer);
+
     void AnswerBuffer(const std::string& buffer,
                       MimeType contentType);
 
@@ -179,5 +179,36 @@ namespace Orthanc
 
     return uri_[level];
   }
-}
 
+
+  std::string RestApiPath::Format() const
+  {
+    assert(uri_.size() == components_.size());
+
+    std::string s;
+
+    for (size_t i = 0; i < uri_.size(); i++)
+    {
+      if (IsWildcardLevel(i))
+      {
+        s += "/{" + components_[i] + "}";
+      }
+      else
+      {
+        s += "/" + uri_[i];
+      }
+    }
+
+    if (hasTrailing_)
+    {
+      s += "/*";
+    }
+
+    if (s.empty())
+    {
+      s = "/";
+    }
+
+    return s;
+  }
+}
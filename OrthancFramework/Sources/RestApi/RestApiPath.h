@@ -61,5 +61,8 @@ namespace Orthanc
 
     const std::string& GetLevelName(size_t level) const;
 
+    // Rebuilds the template of the path, e.g. "/instances/{id}/frames/{frame}"
+    std::string Format() const;
+
   };
 }
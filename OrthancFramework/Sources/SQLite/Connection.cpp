@@ -60,7 +60,12 @@ namespace Orthanc
 {
   namespace SQLite
   {
+    static const size_t DEFAULT_MAXIMUM_DYNAMIC_STATEMENTS = 128;
+
+
     Connection::Connection() :
+      dynamicStatementsClock_(0),
+      maximumDynamicStatements_(DEFAULT_MAXIMUM_DYNAMIC_STATEMENTS),
       db_(NULL),
       transactionNesting_(0),
       needsRollback_(false)
@@ -129,6 +134,64 @@ namespace Orthanc
       }
 
       cachedStatements_.clear();
+      dynamicStatements_.clear();
+    }
+
+
+    void Connection::RecycleDynamicStatements(size_t targetCount)
+    {
+      while (dynamicStatements_.size() > targetCount)
+      {
+        // Look for the least recently used statement that is not in use
+        DynamicStatements::iterator oldest = dynamicStatements_.end();
+
+        for (DynamicStatements::iterator it = dynamicStatements_.begin();
+             it != dynamicStatements_.end(); ++it)
+        {
+          CachedStatements::const_iterator found = cachedStatements_.find(it->first);
+          assert(found != cachedStatements_.end());
+
+          if (found->second->GetReferenceCount() == 0 &&
+              (oldest == dynamicStatements_.end() ||
+               it->second < oldest->second))
+          {
+            oldest = it;
+          }
+        }
+
+        if (oldest == dynamicStatements_.end())
+        {
+          return;  // All the dynamic statements are in use
+        }
+
+        CachedStatements::iterator found = cachedStatements_.find(oldest->first);
+        delete found->second;
+        cachedStatements_.erase(found);
+        dynamicStatements_.erase(oldest);
+      }
+    }
+
+
+    void Connection::SetMaximumDynamicStatements(size_t count)
+    {
+      maximumDynamicStatements_ = count;
+
+      if (count != 0)
+      {
+        RecycleDynamicStatements(count);
+      }
+    }
+
+
+    size_t Connection::GetMaximumDynamicStatements() const
+    {
+      return maximumDynamicStatements_;
+    }
+
+
+    size_t Connection::GetDynamicStatementsCount() const
+    {
+      return dynamicStatements_.size();
     }
 
 
@@ -143,12 +206,29 @@ namespace Orthanc
           throw OrthancSQLiteException(ErrorCode_SQLiteStatementAlreadyUsed);
         }
 
+        if (id.IsDynamic())
+        {
+          dynamicStatements_[id] = ++dynamicStatementsClock_;
+        }
+
         return *i->second;
       }
       else
       {
+        if (id.IsDynamic() &&
+            maximumDynamicStatements_ != 0)
+        {
+          RecycleDynamicStatements(maximumDynamicStatements_ - 1);  // Make room for the new statement
+        }
+
         StatementReference* statement = new StatementReference(db_, sql);
         cachedStatements_[id] = statement;
+
+        if (id.IsDynamic())
+        {
+          dynamicStatements_[id] = ++dynamicStatementsClock_;
+        }
+
         return *statement;
       }
     }
@@ -74,6 +74,13 @@ namespace Orthanc
       typedef std::map<StatementId, StatementReference*>  CachedStatements;
       CachedStatements cachedStatements_;
 
+      // Last use of each cached dynamic statement (whose SQL is
+      // generated at runtime), to evict the least recently used ones
+      typedef std::map<StatementId, uint64_t>  DynamicStatements;
+      DynamicStatements dynamicStatements_;
+      uint64_t dynamicStatementsClock_;
+      size_t maximumDynamicStatements_;
+
       // The actual sqlite database. Will be NULL before Init has been called or if
       // Init resulted in an error.
       sqlite3* db_;
@@ -88,6 +95,8 @@ namespace Orthanc
 
       void ClearCache();
 
+      void RecycleDynamicStatements(size_t targetCount);
+
       void CheckIsOpen() const;
 
       sqlite3* GetWrappedObject()
@@ -123,6 +132,12 @@ namespace Orthanc
 
       IScalarFunction* Register(IScalarFunction* func);  // Takes the ownership of the function
 
+      // Maximum number of cached dynamic statements ("0" means no
+      // limit). The static statements are always cached.
+      void SetMaximumDynamicStatements(size_t count);
+
+      size_t GetMaximumDynamicStatements() const;
+
       // Info querying -------------------------------------------------------------
 
       // Used to check a |sql| statement for syntactic validity. If the
@@ -167,6 +182,8 @@ namespace Orthanc
     
       bool HasCachedStatement(const StatementId& id) const;
 
+      size_t GetDynamicStatementsCount() const;
+
       int GetTransactionNesting() const;
 
       // Transactions --------------------------------------------------------------
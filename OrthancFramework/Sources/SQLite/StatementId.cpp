@@ -71,8 +71,9 @@ namespace Orthanc
       if (line_ != other.line_)
         return line_ < other.line_;
 
-      if (strcmp(file_, other.file_) < 0)
-        return true;
+      int cmp = strcmp(file_, other.file_);
+      if (cmp != 0)
+        return cmp < 0;
 
       return statement_ < other.statement_;
     }
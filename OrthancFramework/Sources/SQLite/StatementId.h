@@ -68,6 +68,12 @@ namespace Orthanc
                   const std::string& statement);
 
       bool operator< (const StatementId& other) const;
+
+      // Dynamic statements carry their SQL text, which is part of the key
+      bool IsDynamic() const
+      {
+        return !statement_.empty();
+      }
     };
   }
 }
@@ -62,6 +62,12 @@
 #endif
 
 
+#if defined(__linux__)
+#  include <pthread.h>       // For "pthread_setaffinity_np()"
+#  include <sched.h>         // For "sched_getcpu()"
+#endif
+
+
 #if defined(__OpenBSD__)
 #  include <sys/sysctl.h>    // For "sysctl", "CTL_KERN" and "KERN_PROC_ARGS"
 #endif
@@ -843,6 +849,177 @@ namespace Orthanc
     }
   }
 
+  static unsigned int ParseCpuIndex(const std::string& s,
+                                    const std::string& cpus)
+  {
+    if (s.empty() ||
+        s.size() > 6)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Bad list of CPUs: " + cpus);
+    }
+
+    for (size_t i = 0; i < s.size(); i++)
+    {
+      if (!isdigit(s[i]))
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "Bad list of CPUs: " + cpus);
+      }
+    }
+
+    return boost::lexical_cast<unsigned int>(s);
+  }
+
+
+  void SystemToolbox::ParseCpuList(std::set<unsigned int>& target,
+                                   const std::string& cpus)
+  {
+    target.clear();
+
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, Toolbox::StripSpaces(cpus), ',');
+
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+      const std::string token = Toolbox::StripSpaces(tokens[i]);
+      const size_t dash = token.find('-');
+
+      if (dash == std::string::npos)
+      {
+        target.insert(ParseCpuIndex(token, cpus));
+      }
+      else
+      {
+        const unsigned int first = ParseCpuIndex(Toolbox::StripSpaces(token.substr(0, dash)), cpus);
+        const unsigned int last = ParseCpuIndex(Toolbox::StripSpaces(token.substr(dash + 1)), cpus);
+
+        if (first > last)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange, "Bad list of CPUs: " + cpus);
+        }
+
+        for (unsigned int cpu = first; cpu <= last; cpu++)
+        {
+          target.insert(cpu);
+        }
+      }
+    }
+
+    if (target.empty())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Empty list of CPUs: " + cpus);
+    }
+  }
+
+
+  bool SystemToolbox::SetCurrentThreadAffinity(const std::set<unsigned int>& cpus)
+  {
+    if (cpus.empty())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Empty list of CPUs");
+    }
+
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (std::set<unsigned int>::const_iterator it = cpus.begin(); it != cpus.end(); ++it)
+    {
+      if (*it >= CPU_SETSIZE)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange,
+                               "CPU index is too large: " + boost::lexical_cast<std::string>(*it));
+      }
+
+      CPU_SET(*it, &set);
+    }
+
+    const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error == 0)
+    {
+      return true;
+    }
+    else
+    {
+      // For instance, none of the CPUs is online
+      LOG(WARNING) << "Cannot set the CPU affinity of the current thread: " << strerror(error);
+      return false;
+    }
+#else
+    LOG(WARNING) << "CPU affinity is not supported on this platform";
+    return false;
+#endif
+  }
+
+
+  bool SystemToolbox::GetCurrentCpu(unsigned int& cpu)
+  {
+#if defined(__linux__)
+    const int current = sched_getcpu();
+    if (current >= 0)
+    {
+      cpu = static_cast<unsigned int>(current);
+      return true;
+    }
+#endif
+
+    return false;
+  }
+
+
+  void SystemToolbox::GetNumaNodes(std::vector<std::set<unsigned int> >& target)
+  {
+    target.clear();
+
+#if defined(__linux__)
+    const boost::filesystem::path root("/sys/devices/system/node");
+
+    try
+    {
+      if (!boost::filesystem::is_directory(root))
+      {
+        return;
+      }
+
+      std::map<unsigned int, std::set<unsigned int> > nodes;
+
+      for (boost::filesystem::directory_iterator it(root); it != boost::filesystem::directory_iterator(); ++it)
+      {
+        const std::string name = it->path().filename().string();
+        const boost::filesystem::path cpulist = it->path() / "cpulist";
+
+        if (name.size() > 4 &&
+            name.compare(0, 4, "node") == 0 &&
+            boost::filesystem::is_regular_file(cpulist))
+        {
+          std::string content;
+          ReadFile(content, cpulist, false /* no log */);
+
+          // A node without CPU (e.g. a memory-only node) has an empty list
+          if (!Toolbox::StripSpaces(content).empty())
+          {
+            ParseCpuList(nodes[ParseCpuIndex(name.substr(4), name)], content);
+          }
+        }
+      }
+
+      for (std::map<unsigned int, std::set<unsigned int> >::const_iterator
+             it = nodes.begin(); it != nodes.end(); ++it)
+      {
+        target.push_back(it->second);
+      }
+    }
+    catch (boost::filesystem::filesystem_error&)
+    {
+      target.clear();
+    }
+    catch (OrthancException&)
+    {
+      target.clear();
+    }
+#endif
+  }
+
+
   bool SystemToolbox::IsContentCompressible(MimeType mime)
   {
     switch (mime)
@@ -1002,6 +1179,10 @@ namespace Orthanc
     {
       return MimeType_Stl;
     }
+    else if (extension == ".tar")
+    {
+      return MimeType_Tar;
+    }
 
     // Default type
     else
@@ -41,6 +41,7 @@
 #include "Enumerations.h"
 
 #include <map>
+#include <set>
 #include <vector>
 #include <string>
 #include <stdint.h>
@@ -146,6 +147,26 @@ namespace Orthanc
 
     static void GetMacAddresses(std::set<std::string>& target);
 
+    // New in Orthanc 1.12.12. Parses a list of CPUs in the format of
+    // the Linux "cpulist" files, e.g. "0-3,8,10-11"
+    static void ParseCpuList(std::set<unsigned int>& target,
+                             const std::string& cpus);
+
+    // New in Orthanc 1.12.12. Pins the calling thread to the given
+    // CPUs. Returns "false" (and logs a warning) if this fails or if
+    // the platform does not support CPU affinity (only Linux is
+    // supported for now).
+    static bool SetCurrentThreadAffinity(const std::set<unsigned int>& cpus);
+
+    // New in Orthanc 1.12.12. Returns the CPU that is running the
+    // calling thread, or "false" if unknown
+    static bool GetCurrentCpu(unsigned int& cpu);
+
+    // New in Orthanc 1.12.12. Returns the CPUs of each NUMA node,
+    // ordered by the index of the nodes. The vector is empty if the
+    // topology is unknown (only Linux is supported for now).
+    static void GetNumaNodes(std::vector<std::set<unsigned int> >& target);
+
 #ifdef _WIN32
     static std::wstring Utf8ToWString(const std::string& str);
 
@@ -878,6 +878,99 @@ namespace Orthanc
 #endif
 
 
+  /**
+   * Word-at-a-time ("SWAR") scanning of byte strings, 8 bytes per
+   * iteration. This is portable across compilers and CPUs, and
+   * provides most of the speedup of SIMD instructions on the short
+   * strings that are found in the DICOM datasets (new in Orthanc
+   * 1.12.12).
+   **/
+  static const uint64_t SWAR_ONES = 0x0101010101010101ull;
+  static const uint64_t SWAR_HIGH_BITS = 0x8080808080808080ull;
+
+  static inline uint64_t LoadSwarWord(const uint8_t* p)
+  {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));  // Handles unaligned accesses
+    return word;
+  }
+
+  // Non-zero iff one of the bytes of "word" is below "n" (with n <= 128)
+  static inline uint64_t SwarHasByteLessThan(uint64_t word,
+                                             uint8_t n)
+  {
+    return (word - SWAR_ONES * n) & ~word & SWAR_HIGH_BITS;
+  }
+
+  // Non-zero iff one of the bytes of "word" equals "n"
+  static inline uint64_t SwarHasByte(uint64_t word,
+                                     uint8_t n)
+  {
+    return SwarHasByteLessThan(word ^ (SWAR_ONES * n), 1);
+  }
+
+  // Returns the number of leading bytes that are known to be 7-bit,
+  // by blocks of 8 bytes
+  static size_t SkipSevenBitWords(const uint8_t* p,
+                                  size_t size)
+  {
+    size_t i = 0;
+    while (i + sizeof(uint64_t) <= size &&
+           (LoadSwarWord(p + i) & SWAR_HIGH_BITS) == 0)
+    {
+      i += sizeof(uint64_t);
+    }
+
+    return i;
+  }
+
+  static bool IsSevenBitString(const std::string& s)
+  {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(s.c_str());
+    for (size_t i = SkipSevenBitWords(p, s.size()); i < s.size(); i++)
+    {
+      if (p[i] >= 0x80)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+#if ORTHANC_ENABLE_LOCALE == 1
+  // Tells whether the 7-bit characters of the given encoding are
+  // the same as in US-ASCII, in which case a 7-bit string needs no
+  // conversion to or from UTF-8. The Japanese encodings are excluded
+  // because of the Yen sign and of ISO 2022 JIS, and Korean because
+  // its Boost locale encoding has no ASCII range.
+  static bool IsAsciiCompatibleEncoding(Encoding encoding)
+  {
+    switch (encoding)
+    {
+      case Encoding_Utf8:
+      case Encoding_Latin1:
+      case Encoding_Latin2:
+      case Encoding_Latin3:
+      case Encoding_Latin4:
+      case Encoding_Latin5:
+      case Encoding_Cyrillic:
+      case Encoding_Windows1251:
+      case Encoding_Arabic:
+      case Encoding_Greek:
+      case Encoding_Hebrew:
+      case Encoding_Thai:
+      case Encoding_Chinese:
+        return true;
+
+      default:
+        return false;
+    }
+  }
+#endif
+
+
 #if ORTHANC_ENABLE_LOCALE == 1
   // http://dicom.nema.org/medical/dicom/current/output/chtml/part03/sect_C.12.html#sect_C.12.1.1.2
   std::string Toolbox::ConvertToUtf8(const std::string& source,
@@ -897,6 +990,18 @@ namespace Orthanc
 #  endif
 #endif
 
+    /**
+     * Fast path for the (most common) case of pure ASCII strings: No
+     * conversion is needed. If code extensions are present, the
+     * control characters must be absent, as they could belong to ISO
+     * 2022 escape sequences (new in Orthanc 1.12.12).
+     **/
+    if (IsAsciiCompatibleEncoding(sourceEncoding) &&
+        (hasCodeExtensions ? IsAsciiString(source) : IsSevenBitString(source)))
+    {
+      return source;
+    }
+
     // The "::skip" flag makes boost skip invalid UTF-8
     // characters. This can occur in badly-encoded DICOM files.
     
@@ -979,6 +1084,13 @@ namespace Orthanc
 #  endif
 #endif
 
+    // Fast path for pure ASCII strings (new in Orthanc 1.12.12)
+    if (IsAsciiCompatibleEncoding(targetEncoding) &&
+        IsSevenBitString(source))
+    {
+      return source;
+    }
+
     // The "::skip" flag makes boost skip invalid UTF-8
     // characters. This can occur in badly-encoded DICOM files.
     
@@ -1065,9 +1177,28 @@ namespace Orthanc
   {
     const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
 
-    for (size_t i = 0; i < size; i++, p++)
+    size_t i = 0;
+
+    // Skip the blocks of 8 bytes that only contain printable
+    // characters in the range [0x20, 0x7e]
+    while (i + sizeof(uint64_t) <= size)
     {
-      if (!IsAsciiCharacter(*p))
+      const uint64_t word = LoadSwarWord(p + i);
+      if ((word & SWAR_HIGH_BITS) == 0 &&
+          !SwarHasByteLessThan(word, 0x20) &&
+          !SwarHasByte(word, 0x7f))
+      {
+        i += sizeof(uint64_t);
+      }
+      else
+      {
+        break;
+      }
+    }
+
+    for (; i < size; i++)
+    {
+      if (!IsAsciiCharacter(p[i]))
       {
         return false;
       }
@@ -1085,6 +1216,11 @@ namespace Orthanc
 
   std::string Toolbox::ConvertToAscii(const std::string& source)
   {
+    if (IsAsciiString(source))
+    {
+      return source;  // Fast path, new in Orthanc 1.12.12
+    }
+
     std::string result;
 
     result.reserve(source.size() + 1);
@@ -1099,10 +1235,44 @@ namespace Orthanc
     return result;
   }
 
+#if ORTHANC_ENABLE_SSL == 1 || BOOST_VERSION >= 108600
+  static void FormatSHA1(std::string& result,
+                         const unsigned char digest[20])
+  {
+    result.resize(8 * 5 + 4);
+    sprintf(&result[0], "%02x%02x%02x%02x-%02x%02x%02x%02x-%02x%02x%02x%02x-%02x%02x%02x%02x-%02x%02x%02x%02x",
+            digest[0], digest[1], digest[2], digest[3],
+            digest[4], digest[5], digest[6], digest[7],
+            digest[8], digest[9], digest[10], digest[11],
+            digest[12], digest[13], digest[14], digest[15],
+            digest[16], digest[17], digest[18], digest[19]);
+  }
+#endif
+
+
   void Toolbox::ComputeSHA1(std::string& result,
                             const void* data,
                             size_t size)
   {
+#if ORTHANC_ENABLE_SSL == 1
+    /**
+     * OpenSSL selects at runtime the fastest implementation of SHA-1
+     * that is supported by the CPU (SHA-NI on x86, cryptography
+     * extensions on ARMv8), which gives the same digest as Boost
+     * (new in Orthanc 1.12.12).
+     **/
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestSize = 0;
+
+    if (EVP_Digest(size > 0 ? data : "", size, digest, &digestSize, EVP_sha1(), NULL) != 1 ||
+        digestSize != 20)
+    {
+      throw OrthancException(ErrorCode_InternalError, "Cannot compute a SHA-1 digest using OpenSSL");
+    }
+
+    FormatSHA1(result, digest);
+
+#else
     boost::uuids::detail::sha1 sha1;
 
     if (size > 0)
@@ -1110,7 +1280,7 @@ namespace Orthanc
       sha1.process_bytes(data, size);
     }
 
-#if BOOST_VERSION >= 108600
+#  if BOOST_VERSION >= 108600
     unsigned char digest[20];
 
     // Sanity check for the memory layout: A SHA-1 digest is 160 bits wide
@@ -1121,15 +1291,9 @@ namespace Orthanc
     // Always perform the cast even if it is useless for Boost < 1.86
     sha1.get_digest(digest);
 
-    result.resize(8 * 5 + 4);
-    sprintf(&result[0], "%02x%02x%02x%02x-%02x%02x%02x%02x-%02x%02x%02x%02x-%02x%02x%02x%02x-%02x%02x%02x%02x",
-            digest[0], digest[1], digest[2], digest[3],
-            digest[4], digest[5], digest[6], digest[7],
-            digest[8], digest[9], digest[10], digest[11],
-            digest[12], digest[13], digest[14], digest[15],
-            digest[16], digest[17], digest[18], digest[19]);
+    FormatSHA1(result, digest);
 
-#else
+#  else
     unsigned int digest[5];
     // Sanity check for the memory layout: A SHA-1 digest is 160 bits wide
     assert(sizeof(unsigned int) == 4 && sizeof(digest) == (160 / 8));
@@ -1145,8 +1309,8 @@ namespace Orthanc
             digest[3],
             digest[4]);
 
+#  endif
 #endif
-
   }
 
   void Toolbox::ComputeSHA1(std::string& result,
@@ -2907,8 +3071,10 @@ namespace Orthanc
 
       if (b1 <= 0x7fu)
       {
-        // 1-byte (ASCII): 0xxxxxxx
+        // 1-byte (ASCII): 0xxxxxxx. Skip the subsequent blocks of 8
+        // ASCII bytes at once (new in Orthanc 1.12.12).
         i++;
+        i += SkipSevenBitWords(bytes + i, len - i);
       }
       else if ((b1 >> 5) == 0x06u)
       {
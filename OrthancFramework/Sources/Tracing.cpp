@@ -0,0 +1,788 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeaders.h"
+#include "Tracing.h"
+
+#include "Logging.h"
+#include "OrthancException.h"
+#include "Toolbox.h"
+
+#if ORTHANC_ENABLE_CURL == 1
+#  include "HttpClient.h"
+#endif
+
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <cassert>
+
+
+namespace Orthanc
+{
+  // The spans are exported as soon as this number of spans is
+  // pending, or after the delay below
+  static const size_t        BATCH_SIZE = 512;
+  static const unsigned int  BATCH_DELAY = 1000;  // In milliseconds
+
+  // Beyond this number of pending spans, the new spans are dropped,
+  // in order to bound the memory if the exporter is too slow
+  static const size_t        MAX_PENDING_SPANS = 16384;
+
+
+  static void NoCleanup(Tracing::Span* span)
+  {
+    // The spans are owned by their creator, not by the thread
+  }
+
+  static boost::thread_specific_ptr<Tracing::Span>  currentSpan_(NoCleanup);
+
+  static boost::atomic<bool>  enabled_(false);
+  static double               samplingRatio_ = 1.0;  // Only modified while tracing is disabled
+
+
+  namespace
+  {
+    class Tracer : public boost::noncopyable
+    {
+    private:
+      std::unique_ptr<Tracing::ISpanExporter>  exporter_;
+      std::string                              serviceName_;
+      boost::mutex                             mutex_;
+      boost::condition_variable                batchReady_;
+      std::vector<Tracing::SpanRecord*>        pending_;
+      bool                                     done_;
+      uint64_t                                 droppedSpans_;
+      boost::thread                            thread_;
+
+      void Export(std::vector<Tracing::SpanRecord*>& batch)
+      {
+        if (!batch.empty())
+        {
+          std::vector<const Tracing::SpanRecord*> spans(batch.begin(), batch.end());
+
+          try
+          {
+            exporter_->Export(serviceName_, spans);
+          }
+          catch (OrthancException& e)
+          {
+            LOG(WARNING) << "Cannot export " << batch.size() << " tracing span(s): " << e.What();
+          }
+
+          for (size_t i = 0; i < batch.size(); i++)
+          {
+            assert(batch[i] != NULL);
+            delete batch[i];
+          }
+
+          batch.clear();
+        }
+      }
+
+      static void Worker(Tracer* that)
+      {
+        Logging::ScopedCurrentThreadNameSetter threadName("TRACING");
+
+        for (;;)
+        {
+          std::vector<Tracing::SpanRecord*> batch;
+          bool done;
+
+          {
+            boost::mutex::scoped_lock lock(that->mutex_);
+
+            if (!that->done_ &&
+                that->pending_.size() < BATCH_SIZE)
+            {
+              that->batchReady_.timed_wait(lock, boost::posix_time::milliseconds(BATCH_DELAY));
+            }
+
+            batch.swap(that->pending_);
+            done = that->done_;
+          }
+
+          that->Export(batch);
+
+          if (done)
+          {
+            return;
+          }
+        }
+      }
+
+    public:
+      Tracer(Tracing::ISpanExporter* exporter,
+             const std::string& serviceName) :
+        exporter_(exporter),
+        serviceName_(serviceName),
+        done_(false),
+        droppedSpans_(0)
+      {
+        if (exporter == NULL)
+        {
+          throw OrthancException(ErrorCode_NullPointer);
+        }
+
+        thread_ = boost::thread(Worker, this);
+      }
+
+      ~Tracer()
+      {
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          done_ = true;
+          batchReady_.notify_one();
+        }
+
+        if (thread_.joinable())
+        {
+          thread_.join();
+        }
+
+        // The worker has exported all the spans before stopping
+        assert(pending_.empty());
+
+        if (droppedSpans_ != 0)
+        {
+          LOG(WARNING) << "Number of tracing spans that have been dropped " 
+                       << "because the exporter was too slow: " << droppedSpans_;
+        }
+      }
+
+      void Push(Tracing::SpanRecord* span)
+      {
+        std::unique_ptr<Tracing::SpanRecord> protection(span);
+
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (done_ ||
+            pending_.size() >= MAX_PENDING_SPANS)
+        {
+          droppedSpans_++;
+        }
+        else
+        {
+          pending_.push_back(protection.release());
+
+          if (pending_.size() == BATCH_SIZE)
+          {
+            batchReady_.notify_one();
+          }
+        }
+      }
+    };
+  }
+
+
+  static boost::mutex  tracerMutex_;
+  static Tracer*       tracer_ = NULL;
+
+
+  static uint64_t GetNanosecondsSinceEpoch()
+  {
+    static const boost::posix_time::ptime EPOCH(boost::gregorian::date(1970, 1, 1));
+    const boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - EPOCH;
+    return static_cast<uint64_t>(elapsed.total_microseconds()) * 1000;
+  }
+
+
+  static std::string GenerateRandomHex()
+  {
+    // 32 hexadecimal characters, out of the 36 characters of a UUID
+    std::string uuid = Toolbox::GenerateUuid();
+    std::string hex;
+    hex.reserve(32);
+
+    for (size_t i = 0; i < uuid.size(); i++)
+    {
+      if (uuid[i] != '-')
+      {
+        hex.push_back(static_cast<char>(tolower(uuid[i])));
+      }
+    }
+
+    return hex;
+  }
+
+
+  static std::string GenerateSpanId()
+  {
+    // Skip the character at index 12, that contains the version of the UUID
+    const std::string hex = GenerateRandomHex();
+    return hex.substr(0, 12) + hex.substr(13, 4);
+  }
+
+
+  static bool IsLowercaseHex(const std::string& s,
+                             size_t offset,
+                             size_t length)
+  {
+    for (size_t i = offset; i < offset + length; i++)
+    {
+      if (!((s[i] >= '0' && s[i] <= '9') ||
+            (s[i] >= 'a' && s[i] <= 'f')))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  static bool IsValidIdentifier(const std::string& s,
+                                size_t offset,
+                                size_t length)
+  {
+    if (!IsLowercaseHex(s, offset, length))
+    {
+      return false;
+    }
+
+    // The identifiers made only of zeros are invalid
+    for (size_t i = offset; i < offset + length; i++)
+    {
+      if (s[i] != '0')
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  static int GetOtlpKind(Tracing::SpanKind kind)
+  {
+    // Values of the "SpanKind" enumeration of OTLP, that are encoded
+    // as integers in OTLP/JSON
+    switch (kind)
+    {
+      case Tracing::SpanKind_Internal:
+        return 1;
+
+      case Tracing::SpanKind_Server:
+        return 2;
+
+      case Tracing::SpanKind_Client:
+        return 3;
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  Tracing::SpanRecord::SpanRecord(const std::string& name,
+                                  SpanKind kind,
+                                  const std::string& traceId,
+                                  const std::string& parentSpanId) :
+    name_(name),
+    kind_(kind),
+    traceId_(traceId),
+    spanId_(GenerateSpanId()),
+    parentSpanId_(parentSpanId),
+    startTime_(GetNanosecondsSinceEpoch()),
+    endTime_(0),
+    isError_(false)
+  {
+  }
+
+
+  void Tracing::SpanRecord::SetAttribute(const std::string& key,
+                                         const std::string& value)
+  {
+    attributes_[key] = value;
+  }
+
+
+  bool Tracing::SpanRecord::LookupAttribute(std::string& value,
+                                            const std::string& key) const
+  {
+    Attributes::const_iterator found = attributes_.find(key);
+
+    if (found == attributes_.end())
+    {
+      return false;
+    }
+    else
+    {
+      value = found->second;
+      return true;
+    }
+  }
+
+
+  void Tracing::SpanRecord::SetError(const std::string& message)
+  {
+    isError_ = true;
+    errorMessage_ = message;
+  }
+
+
+  void Tracing::SpanRecord::SetEnd()
+  {
+    endTime_ = GetNanosecondsSinceEpoch();
+  }
+
+
+  void Tracing::SpanRecord::Format(Json::Value& target) const
+  {
+    target = Json::objectValue;
+    target["traceId"] = traceId_;
+    target["spanId"] = spanId_;
+
+    if (!parentSpanId_.empty())
+    {
+      target["parentSpanId"] = parentSpanId_;
+    }
+
+    target["name"] = name_;
+    target["kind"] = GetOtlpKind(kind_);
+
+    // The 64-bit integers are encoded as strings in OTLP/JSON
+    target["startTimeUnixNano"] = boost::lexical_cast<std::string>(startTime_);
+    target["endTimeUnixNano"] = boost::lexical_cast<std::string>(endTime_);
+
+    Json::Value attributes = Json::arrayValue;
+    for (Attributes::const_iterator it = attributes_.begin(); it != attributes_.end(); ++it)
+    {
+      Json::Value value = Json::objectValue;
+      value["stringValue"] = it->second;
+
+      Json::Value attribute = Json::objectValue;
+      attribute["key"] = it->first;
+      attribute["value"] = value;
+      attributes.append(attribute);
+    }
+
+    target["attributes"] = attributes;
+
+    if (isError_)
+    {
+      Json::Value status = Json::objectValue;
+      status["code"] = 2;  // STATUS_CODE_ERROR
+      status["message"] = errorMessage_;
+      target["status"] = status;
+    }
+  }
+
+
+  Tracing::FileExporter::FileExporter(const std::string& path) :
+    path_(path)
+  {
+  }
+
+
+  void Tracing::FileExporter::Export(const std::string& serviceName,
+                                     const std::vector<const SpanRecord*>& spans)
+  {
+    std::string lines;
+
+    for (size_t i = 0; i < spans.size(); i++)
+    {
+      assert(spans[i] != NULL);
+
+      Json::Value span;
+      spans[i]->Format(span);
+      span["service"] = serviceName;
+
+      std::string line;
+      Toolbox::WriteFastJson(line, span);
+      Toolbox::StripSpaces(line);
+
+      if (path_.empty())
+      {
+        LOG(INFO) << "Tracing span: " << line;
+      }
+      else
+      {
+        lines += line + "\n";
+      }
+    }
+
+    if (!path_.empty())
+    {
+      boost::filesystem::ofstream f;
+      f.open(path_, std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+
+      if (!f.good())
+      {
+        throw OrthancException(ErrorCode_CannotWriteFile, "Cannot write the tracing spans to: " + path_);
+      }
+
+      f.write(lines.c_str(), lines.size());
+      f.close();
+    }
+  }
+
+
+#if ORTHANC_ENABLE_CURL == 1
+  Tracing::OtlpHttpExporter::OtlpHttpExporter(const std::string& url,
+                                              long timeout) :
+    url_(url),
+    timeout_(timeout)
+  {
+  }
+
+
+  void Tracing::OtlpHttpExporter::Export(const std::string& serviceName,
+                                         const std::vector<const SpanRecord*>& spans)
+  {
+    Json::Value items = Json::arrayValue;
+
+    for (size_t i = 0; i < spans.size(); i++)
+    {
+      assert(spans[i] != NULL);
+      Json::Value span;
+      spans[i]->Format(span);
+      items.append(span);
+    }
+
+    Json::Value scope = Json::objectValue;
+    scope["name"] = "orthanc";
+    scope["version"] = ORTHANC_VERSION;
+
+    Json::Value scopeSpans = Json::objectValue;
+    scopeSpans["scope"] = scope;
+    scopeSpans["spans"] = items;
+
+    Json::Value value = Json::objectValue;
+    value["stringValue"] = serviceName;
+
+    Json::Value attribute = Json::objectValue;
+    attribute["key"] = "service.name";
+    attribute["value"] = value;
+
+    Json::Value resource = Json::objectValue;
+    resource["attributes"] = Json::arrayValue;
+    resource["attributes"].append(attribute);
+
+    Json::Value resourceSpans = Json::objectValue;
+    resourceSpans["resource"] = resource;
+    resourceSpans["scopeSpans"] = Json::arrayValue;
+    resourceSpans["scopeSpans"].append(scopeSpans);
+
+    Json::Value request = Json::objectValue;
+    request["resourceSpans"] = Json::arrayValue;
+    request["resourceSpans"].append(resourceSpans);
+
+    std::string body;
+    Toolbox::WriteFastJson(body, request);
+
+    // No span is active in the thread of the tracer, so that this
+    // HTTP request is not traced itself
+    HttpClient client;
+    client.SetUrl(url_);
+    client.SetMethod(HttpMethod_Post);
+    client.SetTimeout(timeout_);
+    client.AddHeader("Content-Type", MIME_JSON);
+    client.AddHeader("Expect", "");
+    client.AssignBody(body);
+
+    std::string answer;
+    if (!client.Apply(answer))
+    {
+      throw OrthancException(ErrorCode_NetworkProtocol, "The OpenTelemetry collector has returned HTTP status " +
+                             boost::lexical_cast<std::string>(client.GetLastStatus()) + ": " + url_);
+    }
+  }
+#endif
+
+
+  void Tracing::Span::Setup(const std::string& name,
+                            SpanKind kind,
+                            const std::string& traceId,
+                            const std::string& parentSpanId,
+                            bool sampled)
+  {
+    previous_ = currentSpan_.get();
+
+    if (sampled)
+    {
+      record_ = new SpanRecord(name, kind, traceId, parentSpanId);
+      currentSpan_.reset(this);
+    }
+  }
+
+
+  void Tracing::Span::SetupFromCurrentThread(const std::string& name,
+                                             SpanKind kind)
+  {
+    const Span* parent = currentSpan_.get();
+
+    if (parent != NULL)
+    {
+      assert(parent->record_ != NULL);
+      Setup(name, kind, parent->record_->GetTraceId(), parent->record_->GetSpanId(), true);
+    }
+    else if (kind == SpanKind_Server)
+    {
+      // Start a new trace. Its sampling only depends on the
+      // identifier of the trace, whose first 8 characters are
+      // uniformly distributed.
+      const std::string traceId = GenerateRandomHex();
+      const uint32_t r = static_cast<uint32_t>(strtoul(traceId.substr(0, 8).c_str(), NULL, 16));
+      Setup(name, kind, traceId, "", static_cast<double>(r) < samplingRatio_ * 4294967296.0);
+    }
+  }
+
+
+  Tracing::Span::Span(const std::string& name,
+                      SpanKind kind) :
+    record_(NULL),
+    previous_(NULL)
+  {
+    if (enabled_)
+    {
+      SetupFromCurrentThread(name, kind);
+    }
+  }
+
+
+  Tracing::Span::Span(const std::string& name,
+                      SpanKind kind,
+                      const std::string& traceparent) :
+    record_(NULL),
+    previous_(NULL)
+  {
+    if (enabled_)
+    {
+      std::string traceId, parentSpanId;
+      bool sampled;
+
+      if (!traceparent.empty() &&
+          ParseTraceparent(traceId, parentSpanId, sampled, traceparent))
+      {
+        // The sampling decision of the remote parent is respected
+        Setup(name, kind, traceId, parentSpanId, sampled);
+      }
+      else
+      {
+        SetupFromCurrentThread(name, kind);
+      }
+    }
+  }
+
+
+  Tracing::Span::~Span()
+  {
+    if (record_ != NULL)
+    {
+      record_->SetEnd();
+
+      assert(currentSpan_.get() == this);
+      currentSpan_.reset(previous_);
+
+      boost::mutex::scoped_lock lock(tracerMutex_);
+      if (tracer_ == NULL)
+      {
+        delete record_;
+      }
+      else
+      {
+        tracer_->Push(record_);
+      }
+    }
+  }
+
+
+  void Tracing::Span::SetAttribute(const std::string& key,
+                                   const std::string& value)
+  {
+    if (record_ != NULL)
+    {
+      record_->SetAttribute(key, value);
+    }
+  }
+
+
+  void Tracing::Span::SetAttribute(const std::string& key,
+                                   int64_t value)
+  {
+    if (record_ != NULL)
+    {
+      record_->SetAttribute(key, boost::lexical_cast<std::string>(value));
+    }
+  }
+
+
+  void Tracing::Span::SetError(const std::string& message)
+  {
+    if (record_ != NULL)
+    {
+      record_->SetError(message);
+    }
+  }
+
+
+  bool Tracing::Span::FormatTraceparent(std::string& target) const
+  {
+    if (record_ == NULL)
+    {
+      return false;
+    }
+    else
+    {
+      target = Tracing::FormatTraceparent(record_->GetTraceId(), record_->GetSpanId(), true);
+      return true;
+    }
+  }
+
+
+  bool Tracing::ParseTraceparent(std::string& traceId,
+                                 std::string& parentSpanId,
+                                 bool& sampled,
+                                 const std::string& traceparent)
+  {
+    // https://www.w3.org/TR/trace-context/#traceparent-header
+    // "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01"
+
+    if (traceparent.size() < 55 ||
+        traceparent[2] != '-' ||
+        traceparent[35] != '-' ||
+        traceparent[52] != '-')
+    {
+      return false;
+    }
+
+    if (!IsLowercaseHex(traceparent, 0, 2) ||      // Version
+        !IsValidIdentifier(traceparent, 3, 32) ||   // Trace identifier
+        !IsValidIdentifier(traceparent, 36, 16) ||  // Parent identifier
+        !IsLowercaseHex(traceparent, 53, 2))        // Flags
+    {
+      return false;
+    }
+
+    const std::string version = traceparent.substr(0, 2);
+
+    if (version == "ff" ||
+        (version == "00" && traceparent.size() != 55) ||
+        (version != "00" && traceparent.size() > 55 && traceparent[55] != '-'))
+    {
+      // Version "ff" is forbidden, and the future versions can only
+      // append new fields
+      return false;
+    }
+
+    traceId = traceparent.substr(3, 32);
+    parentSpanId = traceparent.substr(36, 16);
+
+    // The "sampled" flag is the least significant bit of the flags
+    const char flags = traceparent[54];
+    const int value = (flags <= '9' ? flags - '0' : flags - 'a' + 10);
+    sampled = ((value & 1) != 0);
+
+    return true;
+  }
+
+
+  std::string Tracing::FormatTraceparent(const std::string& traceId,
+                                         const std::string& spanId,
+                                         bool sampled)
+  {
+    if (traceId.size() != 32 ||
+        spanId.size() != 16)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      return "00-" + traceId + "-" + spanId + (sampled ? "-01" : "-00");
+    }
+  }
+
+
+  void Tracing::Initialize(ISpanExporter* exporter,
+                           const std::string& serviceName,
+                           double samplingRatio)
+  {
+    std::unique_ptr<ISpanExporter> protection(exporter);
+
+    if (samplingRatio < 0.0 ||
+        samplingRatio > 1.0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The sampling ratio of the traces must be between 0 and 1");
+    }
+
+    boost::mutex::scoped_lock lock(tracerMutex_);
+
+    if (tracer_ != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "Tracing is already initialized");
+    }
+
+    tracer_ = new Tracer(protection.release(), serviceName);
+    samplingRatio_ = samplingRatio;
+    enabled_ = true;
+  }
+
+
+  void Tracing::Finalize()
+  {
+    enabled_ = false;
+
+    Tracer* tracer = NULL;
+
+    {
+      boost::mutex::scoped_lock lock(tracerMutex_);
+      tracer = tracer_;
+      tracer_ = NULL;
+    }
+
+    // Deleting the tracer waits for the export of the pending spans,
+    // which must be done without the global lock
+    delete tracer;
+  }
+
+
+  bool Tracing::IsEnabled()
+  {
+    return enabled_;
+  }
+
+
+  bool Tracing::GetCurrentTraceparent(std::string& target)
+  {
+    const Span* span = currentSpan_.get();
+    return (span != NULL &&
+            span->FormatTraceparent(target));
+  }
+
+
+  void Tracing::SetCurrentAttribute(const std::string& key,
+                                    const std::string& value)
+  {
+    Span* span = currentSpan_.get();
+
+    if (span != NULL)
+    {
+      span->SetAttribute(key, value);
+    }
+  }
+}
@@ -0,0 +1,266 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "Compatibility.h"
+#include "OrthancFramework.h"
+
+#include <boost/noncopyable.hpp>
+#include <json/value.h>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+namespace Orthanc
+{
+  /**
+   * Minimal distributed tracing, following the data model of
+   * OpenTelemetry (new in Orthanc 1.12.12). A "Span" object measures
+   * one operation of the calling thread, and automatically becomes
+   * the child of the span that is currently active in this thread,
+   * if any. The context of the traces is propagated across processes
+   * using the "traceparent" HTTP header of the W3C Trace Context
+   * recommendation. The finished spans are exported in batches by a
+   * background thread, so that the exporters never slow down the
+   * traced operations.
+   *
+   * If tracing is disabled, or if no trace is in progress in the
+   * calling thread, creating a span only reads one atomic flag or
+   * one thread-specific pointer. New traces are only started by the
+   * "server" spans, which correspond to incoming requests.
+   **/
+  class ORTHANC_PUBLIC Tracing : public boost::noncopyable
+  {
+  public:
+    enum SpanKind
+    {
+      SpanKind_Internal,
+      SpanKind_Server,
+      SpanKind_Client
+    };
+
+    class ORTHANC_PUBLIC SpanRecord : public boost::noncopyable
+    {
+    private:
+      typedef std::map<std::string, std::string>  Attributes;
+
+      std::string  name_;
+      SpanKind     kind_;
+      std::string  traceId_;
+      std::string  spanId_;
+      std::string  parentSpanId_;
+      uint64_t     startTime_;  // Nanoseconds since the UNIX epoch
+      uint64_t     endTime_;
+      Attributes   attributes_;
+      bool         isError_;
+      std::string  errorMessage_;
+
+    public:
+      SpanRecord(const std::string& name,
+                 SpanKind kind,
+                 const std::string& traceId,
+                 const std::string& parentSpanId /* empty for root spans */);
+
+      const std::string& GetName() const
+      {
+        return name_;
+      }
+
+      SpanKind GetKind() const
+      {
+        return kind_;
+      }
+
+      const std::string& GetTraceId() const
+      {
+        return traceId_;
+      }
+
+      const std::string& GetSpanId() const
+      {
+        return spanId_;
+      }
+
+      const std::string& GetParentSpanId() const
+      {
+        return parentSpanId_;
+      }
+
+      uint64_t GetStartTime() const
+      {
+        return startTime_;
+      }
+
+      uint64_t GetEndTime() const
+      {
+        return endTime_;
+      }
+
+      bool IsError() const
+      {
+        return isError_;
+      }
+
+      void SetAttribute(const std::string& key,
+                        const std::string& value);
+
+      bool LookupAttribute(std::string& value,
+                           const std::string& key) const;
+
+      void SetError(const std::string& message);
+
+      void SetEnd();
+
+      // Serialization using the JSON encoding of the OTLP protocol
+      void Format(Json::Value& target) const;
+    };
+
+
+    class ORTHANC_PUBLIC ISpanExporter : public boost::noncopyable
+    {
+    public:
+      virtual ~ISpanExporter()
+      {
+      }
+
+      // Called from the background thread of the tracer. The spans
+      // remain owned by the caller.
+      virtual void Export(const std::string& serviceName,
+                          const std::vector<const SpanRecord*>& spans) = 0;
+    };
+
+
+    // Writes one JSON object per span. If the path is empty, the
+    // spans are written to the logs.
+    class ORTHANC_PUBLIC FileExporter : public ISpanExporter
+    {
+    private:
+      std::string  path_;
+
+    public:
+      explicit FileExporter(const std::string& path);
+
+      virtual void Export(const std::string& serviceName,
+                          const std::vector<const SpanRecord*>& spans) ORTHANC_OVERRIDE;
+    };
+
+
+#if ORTHANC_ENABLE_CURL == 1
+    // Posts the spans to an OpenTelemetry collector, using the
+    // "OTLP/HTTP" protocol with JSON encoding
+    class ORTHANC_PUBLIC OtlpHttpExporter : public ISpanExporter
+    {
+    private:
+      std::string  url_;
+      long         timeout_;
+
+    public:
+      OtlpHttpExporter(const std::string& url /* e.g. "http://localhost:4318/v1/traces" */,
+                       long timeout /* in seconds */);
+
+      virtual void Export(const std::string& serviceName,
+                          const std::vector<const SpanRecord*>& spans) ORTHANC_OVERRIDE;
+    };
+#endif
+
+
+    class ORTHANC_PUBLIC Span : public boost::noncopyable
+    {
+    private:
+      SpanRecord*  record_;   // NULL if this span is not recorded
+      Span*        previous_;
+
+      void Setup(const std::string& name,
+                 SpanKind kind,
+                 const std::string& traceId,
+                 const std::string& parentSpanId,
+                 bool sampled);
+
+      void SetupFromCurrentThread(const std::string& name,
+                                  SpanKind kind);
+
+    public:
+      // Child of the span that is active in the calling thread
+      Span(const std::string& name,
+           SpanKind kind);
+
+      // Child of a remote span, as described by the value of a
+      // "traceparent" HTTP header. If this value is empty or invalid,
+      // and if "kind" is "SpanKind_Server", a new trace is started.
+      Span(const std::string& name,
+           SpanKind kind,
+           const std::string& traceparent);
+
+      ~Span();
+
+      bool IsRecording() const
+      {
+        return record_ != NULL;
+      }
+
+      void SetAttribute(const std::string& key,
+                        const std::string& value);
+
+      void SetAttribute(const std::string& key,
+                        int64_t value);
+
+      void SetError(const std::string& message);
+
+      // Returns "false" if this span is not recorded
+      bool FormatTraceparent(std::string& target) const;
+    };
+
+
+    static bool ParseTraceparent(std::string& traceId,
+                                 std::string& parentSpanId,
+                                 bool& sampled,
+                                 const std::string& traceparent);
+
+    static std::string FormatTraceparent(const std::string& traceId,
+                                         const std::string& spanId,
+                                         bool sampled);
+
+    // Takes the ownership of the exporter, and starts the background thread
+    static void Initialize(ISpanExporter* exporter,
+                           const std::string& serviceName,
+                           double samplingRatio /* in [0,1] */);
+
+    // Exports the pending spans, and stops the background thread
+    static void Finalize();
+
+    static bool IsEnabled();
+
+    // Get the "traceparent" of the span that is active in the calling
+    // thread. Returns "false" if no trace is in progress.
+    static bool GetCurrentTraceparent(std::string& target);
+
+    // Set an attribute of the span that is active in the calling
+    // thread, if any
+    static void SetCurrentAttribute(const std::string& key,
+                                    const std::string& value);
+  };
+}
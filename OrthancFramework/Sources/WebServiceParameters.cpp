@@ -50,6 +50,7 @@ namespace Orthanc
   static const char* KEY_URL_2 = "URL";
   static const char* KEY_USERNAME = "Username";
   static const char* KEY_TIMEOUT = "Timeout";
+  static const char* KEY_MAX_PARALLEL_TRANSFERS = "MaxParallelTransfers";
 
 
   static bool IsReservedKey(const std::string& key)
@@ -63,13 +64,15 @@ namespace Orthanc
             key == KEY_URL ||
             key == KEY_URL_2 ||
             key == KEY_USERNAME ||
-            key == KEY_TIMEOUT);
+            key == KEY_TIMEOUT ||
+            key == KEY_MAX_PARALLEL_TRANSFERS);
   }
 
 
   WebServiceParameters::WebServiceParameters() : 
     pkcs11Enabled_(false),
-    timeout_(0)
+    timeout_(0),
+    maxParallelTransfers_(1)
   {
     SetUrl("http://127.0.0.1:8042/");
   }
@@ -221,6 +224,7 @@ namespace Orthanc
 
     pkcs11Enabled_ = false;
     timeout_ = 0;
+    maxParallelTransfers_ = 1;
     ClearClientCertificate();
 
     if (peer.size() != 1 && 
@@ -383,6 +387,15 @@ namespace Orthanc
     {
       timeout_ = 0;
     }
+
+    if (peer.isMember(KEY_MAX_PARALLEL_TRANSFERS))
+    {
+      SetMaxParallelTransfers(SerializationToolbox::ReadUnsignedInteger(peer, KEY_MAX_PARALLEL_TRANSFERS));
+    }
+    else
+    {
+      maxParallelTransfers_ = 1;
+    }
   }
 
 
@@ -531,7 +544,8 @@ namespace Orthanc
             pkcs11Enabled_ ||
             !headers_.empty() ||
             !userProperties_.empty() ||
-            timeout_ != 0);
+            timeout_ != 0 ||
+            maxParallelTransfers_ != 1);
   }
 
 
@@ -575,6 +589,12 @@ namespace Orthanc
       value[KEY_PKCS11] = pkcs11Enabled_;
       value[KEY_TIMEOUT] = timeout_;
 
+      if (maxParallelTransfers_ != 1)
+      {
+        // Only written if need be, for compatibility with older versions of Orthanc
+        value[KEY_MAX_PARALLEL_TRANSFERS] = maxParallelTransfers_;
+      }
+
       value[KEY_HTTP_HEADERS] = Json::objectValue;
       for (Dictionary::const_iterator it = headers_.begin();
            it != headers_.end(); ++it)
@@ -649,6 +669,7 @@ namespace Orthanc
 
     target[KEY_PKCS11] = pkcs11Enabled_;
     target[KEY_TIMEOUT] = timeout_;
+    target[KEY_MAX_PARALLEL_TRANSFERS] = maxParallelTransfers_;
 
     Json::Value headers = Json::arrayValue;
       
@@ -683,4 +704,18 @@ namespace Orthanc
   {
     return (timeout_ != 0);
   }
+
+
+  void WebServiceParameters::SetMaxParallelTransfers(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "The number of parallel transfers to a Web service must be >= 1");
+    }
+    else
+    {
+      maxParallelTransfers_ = count;
+    }
+  }
 }
@@ -54,6 +54,7 @@ namespace Orthanc
     Dictionary   headers_;
     Dictionary   userProperties_;
     unsigned int timeout_;
+    unsigned int maxParallelTransfers_;
 
     void FromSimpleFormat(const Json::Value& peer);
 
@@ -140,5 +141,14 @@ namespace Orthanc
     uint32_t GetTimeout() const;
 
     bool HasTimeout() const;    
+
+    // New in Orthanc 1.12.12. Number of uploads that are kept in
+    // flight while sending a sequence of instances to this Web service.
+    void SetMaxParallelTransfers(unsigned int count);
+
+    unsigned int GetMaxParallelTransfers() const
+    {
+      return maxParallelTransfers_;
+    }
   };
 }
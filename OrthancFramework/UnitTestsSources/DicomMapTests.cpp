@@ -35,6 +35,8 @@
 
 #include "../Sources/Compatibility.h"
 #include "../Sources/OrthancException.h"
+#include "../Sources/DicomFormat/CompactDicomMap.h"
+#include "../Sources/DicomFormat/DicomFrameOffsets.h"
 #include "../Sources/DicomFormat/DicomMap.h"
 #include "../Sources/DicomFormat/DicomStreamReader.h"
 #include "../Sources/DicomParsing/FromDcmtkBridge.h"
@@ -934,6 +936,203 @@ TEST(DicomWebJson, PixelSpacing)
 }
 
 
+namespace
+{
+  class StringStreamWriter : public DicomWebJsonVisitor::IStreamWriter
+  {
+  private:
+    std::string  text_;
+    size_t       countChunks_;
+
+  public:
+    StringStreamWriter() :
+      countChunks_(0)
+    {
+    }
+
+    virtual void Write(const std::string& chunk) ORTHANC_OVERRIDE
+    {
+      text_.append(chunk);
+      countChunks_++;
+    }
+
+    const std::string& GetText() const
+    {
+      return text_;
+    }
+
+    size_t GetCountChunks() const
+    {
+      return countChunks_;
+    }
+  };
+}
+
+
+TEST(DicomWebJson, Streaming)
+{
+  Json::Value v = Json::objectValue;
+  v["PatientName"] = "Hello \"World\"\\";
+  v["PatientID"] = "";
+  v["ImageOrientationPatient"] = "1.5\\\\\\2.5";
+
+  {
+    Json::Value item = Json::objectValue;
+    item["ReferencedSOPClassUID"] = "1.2.840.10008.5.1.4.1.1.4";
+    item["ReferencedSOPInstanceUID"] = "1.2.3";
+
+    Json::Value a = Json::arrayValue;
+    a.append(item);
+    a.append(Json::objectValue);
+    a.append(item);
+    v["ReferencedImageSequence"] = a;
+  }
+
+  v["ReferencedPerformedProcedureStepSequence"] = Json::arrayValue;
+
+  std::unique_ptr<ParsedDicomFile> dicom(ParsedDicomFile::CreateFromJson(v, DicomFromJsonFlags_None, ""));
+
+  DicomWebJsonVisitor reference;
+  dicom->Apply(reference);
+
+  StringStreamWriter writer;
+  DicomWebJsonVisitor visitor;
+  visitor.SetStreamWriter(writer);
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    dicom->Apply(visitor);
+    ASSERT_LE(visitor.GetResult().size(), 1u);  // Only the last top-level element is kept
+    ASSERT_THROW(visitor.SetStreamWriter(writer), OrthancException);
+
+    std::string xml;
+    ASSERT_THROW(visitor.FormatXml(xml), OrthancException);
+
+    visitor.FinalizeStream();
+    ASSERT_EQ(0u, visitor.GetResult().size());
+    ASSERT_EQ(i + 1, writer.GetCountChunks());
+  }
+
+  const std::string& text = writer.GetText();
+  ASSERT_EQ('{', text[0]);
+  ASSERT_EQ('}', text[text.size() - 1]);
+
+  // The visitor is reused for the second dataset
+  const size_t half = text.size() / 2;
+  ASSERT_EQ(text.substr(0, half), text.substr(half));
+
+  Json::Value streamed;
+  ASSERT_TRUE(Toolbox::ReadJson(streamed, text.substr(0, half)));
+  ASSERT_EQ(reference.GetResult().toStyledString(), streamed.toStyledString());
+
+  {
+    StringStreamWriter emptyWriter;
+    DicomWebJsonVisitor emptyVisitor;
+    emptyVisitor.SetStreamWriter(emptyWriter);
+    emptyVisitor.FinalizeStream();
+    ASSERT_EQ("{}", emptyWriter.GetText());
+  }
+
+  {
+    DicomWebJsonVisitor defaultVisitor;
+    ASSERT_THROW(defaultVisitor.FinalizeStream(), OrthancException);
+  }
+}
+
+
+TEST(CompactDicomMap, Basic)
+{
+  CompactDicomMap m;
+  ASSERT_TRUE(m.IsEmpty());
+
+  // Insert the tags out of order
+  m.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "1.2.3", false);
+  m.SetValue(DICOM_TAG_PATIENT_ID, "PATIENT", false);
+  m.SetNullValue(DICOM_TAG_PATIENT_NAME);
+  m.SetValue(DICOM_TAG_PIXEL_DATA, std::string("\0\1\2", 3), true);
+  m.SetValue(DICOM_TAG_STUDY_DESCRIPTION, "", false);
+
+  ASSERT_EQ(5u, m.GetSize());
+  for (size_t i = 1; i < m.GetSize(); i++)
+  {
+    ASSERT_TRUE(m.GetTag(i - 1) < m.GetTag(i));
+  }
+
+  std::string s;
+  ASSERT_TRUE(m.LookupStringValue(s, DICOM_TAG_PATIENT_ID, false));
+  ASSERT_EQ("PATIENT", s);
+  ASSERT_TRUE(m.LookupStringValue(s, DICOM_TAG_STUDY_DESCRIPTION, false));
+  ASSERT_TRUE(s.empty());
+  ASSERT_FALSE(m.LookupStringValue(s, DICOM_TAG_PATIENT_NAME, false));
+  ASSERT_FALSE(m.LookupStringValue(s, DICOM_TAG_PIXEL_DATA, false));
+  ASSERT_TRUE(m.LookupStringValue(s, DICOM_TAG_PIXEL_DATA, true));
+  ASSERT_EQ(3u, s.size());
+  ASSERT_EQ(2, s[2]);
+  ASSERT_FALSE(m.LookupStringValue(s, DICOM_TAG_MODALITY, true));
+  ASSERT_TRUE(m.HasTag(DICOM_TAG_PATIENT_NAME));
+  ASSERT_FALSE(m.HasTag(DICOM_TAG_MODALITY));
+
+  // Replace a value
+  m.SetValue(DICOM_TAG_PATIENT_ID, "OTHER", false);
+  ASSERT_EQ(5u, m.GetSize());
+  ASSERT_TRUE(m.LookupStringValue(s, DICOM_TAG_PATIENT_ID, false));
+  ASSERT_EQ("OTHER", s);
+
+  DicomMap exported;
+  m.Export(exported);
+  ASSERT_EQ(5u, exported.GetSize());
+  ASSERT_TRUE(exported.GetValue(DICOM_TAG_PATIENT_NAME).IsNull());
+  ASSERT_TRUE(exported.GetValue(DICOM_TAG_PIXEL_DATA).IsBinary());
+  ASSERT_EQ("1.2.3", exported.GetValue(DICOM_TAG_SERIES_INSTANCE_UID).GetContent());
+
+  CompactDicomMap copy;
+  copy.Assign(exported);
+  ASSERT_EQ(5u, copy.GetSize());
+
+  for (size_t i = 0; i < copy.GetSize(); i++)
+  {
+    ASSERT_EQ(m.GetTag(i), copy.GetTag(i));
+    ASSERT_EQ(m.IsNull(i), copy.IsNull(i));
+    ASSERT_EQ(m.IsBinary(i), copy.IsBinary(i));
+
+    if (!m.IsNull(i))
+    {
+      std::string a, b;
+      m.GetValue(a, i);
+      copy.GetValue(b, i);
+      ASSERT_EQ(a, b);
+    }
+  }
+
+  ASSERT_EQ(DICOM_TAG_PATIENT_NAME, m.GetTag(1));  // After StudyDescription (0008,1030)
+  ASSERT_THROW(m.GetValue(s, 1), OrthancException);  // PatientName is null
+  ASSERT_THROW(m.GetTag(5), OrthancException);
+
+  DicomMap target;
+  ASSERT_TRUE(m.CopyTagIfExists(target, DICOM_TAG_PATIENT_NAME));
+  ASSERT_TRUE(m.CopyTagIfExists(target, DICOM_TAG_PATIENT_ID));
+  ASSERT_FALSE(m.CopyTagIfExists(target, DICOM_TAG_MODALITY));
+  ASSERT_EQ(2u, target.GetSize());
+  ASSERT_TRUE(target.GetValue(DICOM_TAG_PATIENT_NAME).IsNull());
+  ASSERT_EQ("OTHER", target.GetValue(DICOM_TAG_PATIENT_ID).GetContent());
+
+  m.Remove(DICOM_TAG_PATIENT_ID);
+  m.Remove(DICOM_TAG_MODALITY);
+  ASSERT_EQ(4u, m.GetSize());
+  ASSERT_FALSE(m.HasTag(DICOM_TAG_PATIENT_ID));
+
+  Json::Value sequence = Json::arrayValue;
+  sequence.append(Json::objectValue);
+  exported.SetSequenceValue(DicomTag(0x0008, 0x1140), sequence);
+  ASSERT_THROW(copy.Assign(exported), OrthancException);
+  ASSERT_TRUE(copy.IsEmpty());
+
+  m.Clear();
+  ASSERT_TRUE(m.IsEmpty());
+  ASSERT_EQ(0u, m.GetArenaSize());
+}
+
+
 TEST(DicomMap, MainTagNames)
 {
   ASSERT_EQ(3, ResourceType_Instance - ResourceType_Patient);
@@ -1942,6 +2141,164 @@ TEST(DicomWebJson, BinaryModes)
 }
 
 
+static void AppendUInt16(std::string& target, uint16_t v)
+{
+  target.push_back(static_cast<char>(v & 0xff));
+  target.push_back(static_cast<char>(v >> 8));
+}
+
+
+static void AppendUInt32(std::string& target, uint32_t v)
+{
+  AppendUInt16(target, static_cast<uint16_t>(v & 0xffff));
+  AppendUInt16(target, static_cast<uint16_t>(v >> 16));
+}
+
+
+static void AppendItem(std::string& target, const std::string& content)
+{
+  AppendUInt16(target, 0xfffe);
+  AppendUInt16(target, 0xe000);
+  AppendUInt32(target, static_cast<uint32_t>(content.size()));
+  target += content;
+}
+
+
+TEST(DicomFrameOffsets, Uncompressed)
+{
+  // Implicit VR: Tag, length, then 3 frames of 4 bytes
+  std::string dicom = "HEADER";
+  AppendUInt16(dicom, 0x7fe0);
+  AppendUInt16(dicom, 0x0010);
+  AppendUInt32(dicom, 12);
+  dicom += "aaaabbbbcccc";
+
+  DicomFrameOffsets offsets;
+  ASSERT_FALSE(offsets.Parse(dicom.c_str(), dicom.size(), 5, false, 3, 4));
+  ASSERT_FALSE(offsets.Parse(dicom.c_str(), dicom.size(), 6, false, 4, 4));  // Not enough pixel data
+  ASSERT_FALSE(offsets.Parse(dicom.c_str(), dicom.size(), 6, true, 3, 4));   // Not explicit VR
+  ASSERT_TRUE(offsets.Parse(dicom.c_str(), dicom.size(), 6, false, 3, 4));
+
+  ASSERT_FALSE(offsets.IsEncapsulated());
+  ASSERT_EQ(3u, offsets.GetFramesCount());
+  ASSERT_EQ(1u, offsets.GetFragmentsCount(2));
+  ASSERT_EQ(22u, offsets.GetFragmentOffset(2, 0));
+  ASSERT_EQ(4u, offsets.GetFragmentSize(2, 0));
+  ASSERT_EQ(4u, offsets.GetFrameSize(1));
+  ASSERT_EQ("bbbb", dicom.substr(offsets.GetFragmentOffset(1, 0), offsets.GetFragmentSize(1, 0)));
+  ASSERT_THROW(offsets.GetFragmentsCount(3), OrthancException);
+  ASSERT_THROW(offsets.GetFragmentOffset(0, 1), OrthancException);
+
+  std::string s;
+  offsets.FormatSingleFramePixelData(s, "ccc");
+  ASSERT_EQ(12u, s.size());  // With padding
+
+  DicomFrameOffsets single;
+  ASSERT_TRUE(single.Parse(s.c_str(), s.size(), 0, false, 1, 3));
+  ASSERT_EQ(1u, single.GetFramesCount());
+  ASSERT_EQ("ccc", s.substr(single.GetFragmentOffset(0, 0), single.GetFragmentSize(0, 0)));
+
+  // Explicit VR
+  dicom = "HEADER";
+  AppendUInt16(dicom, 0x7fe0);
+  AppendUInt16(dicom, 0x0010);
+  dicom += "OW";
+  AppendUInt16(dicom, 0);
+  AppendUInt32(dicom, 8);
+  dicom += "aaaabbbb";
+
+  ASSERT_TRUE(offsets.Parse(dicom.c_str(), dicom.size(), 6, true, 2, 4));
+  ASSERT_EQ(2u, offsets.GetFramesCount());
+  ASSERT_EQ("bbbb", dicom.substr(offsets.GetFragmentOffset(1, 0), offsets.GetFragmentSize(1, 0)));
+
+  offsets.FormatSingleFramePixelData(s, "bbbb");
+  ASSERT_EQ(16u, s.size());
+  ASSERT_EQ("OW", s.substr(4, 2));
+}
+
+
+TEST(DicomFrameOffsets, Encapsulated)
+{
+  std::string pixelData;
+  AppendUInt16(pixelData, 0x7fe0);
+  AppendUInt16(pixelData, 0x0010);
+  pixelData += "OB";
+  AppendUInt16(pixelData, 0);
+  AppendUInt32(pixelData, 0xffffffffu);
+
+  // Basic offset table for 2 frames: The first frame has 2
+  // fragments of 2 bytes, the second one has 1 fragment of 4 bytes
+  std::string table;
+  AppendUInt32(table, 0);
+  AppendUInt32(table, 20);
+
+  std::string dicom = "HEADER" + pixelData;
+  AppendItem(dicom, table);
+  AppendItem(dicom, "aa");
+  AppendItem(dicom, "bb");
+  AppendItem(dicom, "cccc");
+  AppendUInt16(dicom, 0xfffe);
+  AppendUInt16(dicom, 0xe0dd);
+  AppendUInt32(dicom, 0);
+
+  DicomFrameOffsets offsets;
+  ASSERT_FALSE(offsets.Parse(dicom.c_str(), dicom.size(), 6, true, 4, 0));    // Not enough fragments
+  ASSERT_FALSE(offsets.Parse(dicom.c_str(), dicom.size() - 8, 6, true, 2, 0));  // Truncated
+  ASSERT_TRUE(offsets.Parse(dicom.c_str(), dicom.size(), 6, true, 2, 0));
+
+  ASSERT_TRUE(offsets.IsEncapsulated());
+  ASSERT_EQ(2u, offsets.GetFramesCount());
+  ASSERT_EQ(2u, offsets.GetFragmentsCount(0));
+  ASSERT_EQ(1u, offsets.GetFragmentsCount(1));
+  ASSERT_EQ(4u, offsets.GetFrameSize(0));
+  ASSERT_EQ(4u, offsets.GetFrameSize(1));
+  ASSERT_EQ("aa", dicom.substr(offsets.GetFragmentOffset(0, 0), offsets.GetFragmentSize(0, 0)));
+  ASSERT_EQ("bb", dicom.substr(offsets.GetFragmentOffset(0, 1), offsets.GetFragmentSize(0, 1)));
+  ASSERT_EQ("cccc", dicom.substr(offsets.GetFragmentOffset(1, 0), offsets.GetFragmentSize(1, 0)));
+
+  {
+    // Single frame overlapping all the fragments
+    DicomFrameOffsets single;
+    ASSERT_TRUE(single.Parse(dicom.c_str(), dicom.size(), 6, true, 1, 0));
+    ASSERT_EQ(1u, single.GetFramesCount());
+    ASSERT_EQ(3u, single.GetFragmentsCount(0));
+    ASSERT_EQ(8u, single.GetFrameSize(0));
+  }
+
+  {
+    // One fragment per frame
+    DicomFrameOffsets three;
+    ASSERT_TRUE(three.Parse(dicom.c_str(), dicom.size(), 6, true, 3, 0));
+    ASSERT_EQ(3u, three.GetFramesCount());
+    ASSERT_EQ(1u, three.GetFragmentsCount(1));
+    ASSERT_EQ("bb", dicom.substr(three.GetFragmentOffset(1, 0), three.GetFragmentSize(1, 0)));
+  }
+
+  std::string serialized;
+  offsets.Serialize(serialized);
+
+  DicomFrameOffsets unserialized;
+  unserialized.Unserialize(serialized);
+  ASSERT_TRUE(unserialized.IsEncapsulated());
+  ASSERT_EQ(2u, unserialized.GetFramesCount());
+  ASSERT_EQ(2u, unserialized.GetFragmentsCount(0));
+  ASSERT_EQ(offsets.GetFragmentOffset(1, 0), unserialized.GetFragmentOffset(1, 0));
+  ASSERT_EQ(offsets.GetFragmentSize(0, 1), unserialized.GetFragmentSize(0, 1));
+
+  ASSERT_THROW(unserialized.Unserialize(serialized.substr(0, serialized.size() - 1)), OrthancException);
+  ASSERT_THROW(unserialized.Unserialize(""), OrthancException);
+
+  std::string s;
+  offsets.FormatSingleFramePixelData(s, "aabb");
+  ASSERT_EQ(pixelData, s.substr(0, pixelData.size()));
+
+  DicomFrameOffsets single;
+  ASSERT_TRUE(single.Parse(s.c_str(), s.size(), 0, true, 1, 0));
+  ASSERT_EQ(1u, single.GetFragmentsCount(0));
+  ASSERT_EQ("aabb", s.substr(single.GetFragmentOffset(0, 0), single.GetFragmentSize(0, 0)));
+}
+
+
 #if ORTHANC_SANDBOXED != 1
 
 #include "../Sources/SystemToolbox.h"
@@ -29,15 +29,24 @@
 
 #include <gtest/gtest.h>
 
+#include "../Sources/FileStorage/ContentAddressedStorageArea.h"
 #include "../Sources/FileStorage/FilesystemStorage.h"
+#include "../Sources/FileStorage/MemoryStorageArea.h"
+#include "../Sources/FileStorage/MultiRootStorageArea.h"
 #include "../Sources/FileStorage/PluginStorageAreaAdapter.h"
 #include "../Sources/FileStorage/StorageAccessor.h"
 #include "../Sources/FileStorage/StorageCache.h"
+#include "../Sources/FileStorage/StorageDiskCache.h"
+#include "../Sources/HttpServer/HttpOutput.h"
 #include "../Sources/Logging.h"
+#include "../Sources/MemoryMappedFileBuffer.h"
+#include "../Sources/MetricsRegistry.h"
 #include "../Sources/OrthancException.h"
+#include "../Sources/StringMemoryBuffer.h"
 #include "../Sources/Toolbox.h"
 #include "../Sources/SystemToolbox.h"
 
+#include <boost/thread.hpp>
 #include <ctype.h>
 
 
@@ -76,6 +85,94 @@ TEST(FilesystemStorage, Basic)
   }
 }
 
+TEST(FilesystemStorage, MemoryMapping)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  s.SetMemoryMappingThreshold(5);
+
+  const std::string data = "Hello world";
+  const std::string uid = Toolbox::GenerateUuid();
+  s.Create(uid, data.c_str(), data.size(), FileContentType_Unknown);
+
+  {
+    std::unique_ptr<IMemoryBuffer> buffer(s.ReadWhole(uid, FileContentType_Unknown));
+    ASSERT_TRUE(dynamic_cast<MemoryMappedFileBuffer*>(buffer.get()) != NULL);
+    ASSERT_EQ(data, std::string(reinterpret_cast<const char*>(buffer->GetData()), buffer->GetSize()));
+  }
+
+  {
+    std::unique_ptr<IMemoryBuffer> buffer(s.ReadRange(uid, FileContentType_Unknown, 6, 11));
+    ASSERT_TRUE(dynamic_cast<MemoryMappedFileBuffer*>(buffer.get()) != NULL);
+
+    std::string d;
+    buffer->MoveToString(d);
+    ASSERT_EQ("world", d);
+    ASSERT_EQ(0u, buffer->GetSize());
+  }
+
+  {
+    // Below the threshold
+    std::unique_ptr<IMemoryBuffer> buffer(s.ReadRange(uid, FileContentType_Unknown, 0, 4));
+    ASSERT_TRUE(dynamic_cast<MemoryMappedFileBuffer*>(buffer.get()) == NULL);
+    ASSERT_EQ(4u, buffer->GetSize());
+  }
+
+  ASSERT_THROW(s.ReadRange(uid, FileContentType_Unknown, 6, 12), OrthancException);
+  s.Remove(uid, FileContentType_Unknown);
+}
+
+
+static void GroupCommitWriter(FilesystemStorage* storage,
+                              std::vector<std::string>* uuids)
+{
+  for (size_t i = 0; i < uuids->size(); i++)
+  {
+    const std::string& uuid = (*uuids) [i];
+    storage->Create(uuid, uuid.c_str(), uuid.size(), FileContentType_Unknown);
+  }
+}
+
+
+TEST(FilesystemStorage, GroupCommit)
+{
+  FilesystemStorage s("UnitTestsStorage", true /* fsync */);
+  s.SetGroupCommitWindow(5);
+
+  std::vector<std::string> uuids[4];
+  std::vector<boost::thread*> threads;
+
+  for (size_t i = 0; i < 4; i++)
+  {
+    for (size_t j = 0; j < 10; j++)
+    {
+      uuids[i].push_back(Toolbox::GenerateUuid());
+    }
+
+    threads.push_back(new boost::thread(GroupCommitWriter, &s, &uuids[i]));
+  }
+
+  for (size_t i = 0; i < threads.size(); i++)
+  {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  for (size_t i = 0; i < 4; i++)
+  {
+    for (size_t j = 0; j < uuids[i].size(); j++)
+    {
+      std::unique_ptr<IMemoryBuffer> buffer(s.ReadWhole(uuids[i][j], FileContentType_Unknown));
+
+      std::string d;
+      buffer->MoveToString(d);
+      ASSERT_EQ(uuids[i][j], d);
+
+      s.Remove(uuids[i][j], FileContentType_Unknown);
+    }
+  }
+}
+
+
 TEST(FilesystemStorage, Basic2)
 {
   FilesystemStorage s("UnitTestsStorage");
@@ -193,6 +290,253 @@ TEST(FilesystemStorage, EndToEnd)
 }
 
 
+TEST(MultiRootStorageArea, Basic)
+{
+  ASSERT_EQ(MultiRootStorageArea::Placement_Hash, MultiRootStorageArea::StringToPlacement("Hash"));
+  ASSERT_EQ(MultiRootStorageArea::Placement_Weight, MultiRootStorageArea::StringToPlacement("Weight"));
+  ASSERT_EQ(MultiRootStorageArea::Placement_FreeSpace, MultiRootStorageArea::StringToPlacement("FreeSpace"));
+  ASSERT_THROW(MultiRootStorageArea::StringToPlacement("Nope"), OrthancException);
+
+  FilesystemStorage legacy("UnitTestsStorageRoot1");
+  legacy.Clear();
+
+  // File created before the storage area spanned multiple roots
+  const std::string oldUuid = Toolbox::GenerateUuid();
+  legacy.Create(oldUuid, "old", 3, FileContentType_Unknown);
+
+  MultiRootStorageArea s(MultiRootStorageArea::Placement_Weight);
+  s.AddRoot("root1", "UnitTestsStorageRoot1", false, 1, 2);
+  FilesystemStorage& root2 = s.AddRoot("root2", "UnitTestsStorageRoot2", false, 3, 2);
+  root2.Clear();
+  ASSERT_THROW(s.AddRoot("root2", "UnitTestsStorageRoot3", false, 1, 1), OrthancException);
+  ASSERT_THROW(s.AddRoot("root3", "UnitTestsStorageRoot3", false, 0, 1), OrthancException);
+  ASSERT_EQ(2u, s.GetRootsCount());
+
+  // The placement only depends on the UUID
+  ASSERT_EQ("root1", s.GetPlacementRoot("00000000-0000-0000-0000-000000000000"));
+  ASSERT_EQ("root2", s.GetPlacementRoot("00000001-0000-0000-0000-000000000000"));
+  ASSERT_EQ("root2", s.GetPlacementRoot("00000003-0000-0000-0000-000000000000"));
+  ASSERT_EQ("root1", s.GetPlacementRoot("00000004-0000-0000-0000-000000000000"));
+
+  std::map<std::string, std::string> customData;  // UUID => root
+  unsigned int count1 = 0;
+
+  for (unsigned int i = 0; i < 40; i++)
+  {
+    const std::string uuid = Toolbox::GenerateUuid();
+
+    std::string data;
+    s.Create(data, uuid, uuid.c_str(), uuid.size(), FileContentType_Unknown, CompressionType_None, NULL);
+    ASSERT_EQ(s.GetPlacementRoot(uuid), data);
+    customData[uuid] = data;
+
+    if (data == "root1")
+    {
+      count1++;
+    }
+  }
+
+  std::set<std::string> files;
+  legacy.ListAllFiles(files);
+  ASSERT_EQ(count1 + 1u, files.size());
+  root2.ListAllFiles(files);
+  ASSERT_EQ(40u - count1, files.size());
+
+  for (std::map<std::string, std::string>::const_iterator it = customData.begin(); it != customData.end(); ++it)
+  {
+    std::unique_ptr<IMemoryBuffer> buffer(s.ReadRange(it->first, FileContentType_Unknown, 0, 8, it->second));
+    std::string content;
+    buffer->MoveToString(content);
+    ASSERT_EQ(it->first.substr(0, 8), content);
+
+    std::string path;
+    ASSERT_TRUE(s.LookupLocalPath(path, it->first, FileContentType_Unknown, it->second));
+    ASSERT_TRUE(SystemToolbox::IsRegularFile(SystemToolbox::PathFromUtf8(path)));
+  }
+
+  // Routing of the attachments without custom data
+  {
+    std::unique_ptr<IMemoryBuffer> buffer(s.ReadRange(oldUuid, FileContentType_Unknown, 0, 3, ""));
+    std::string content;
+    buffer->MoveToString(content);
+    ASSERT_EQ("old", content);
+  }
+
+  ASSERT_THROW(s.ReadRange(oldUuid, FileContentType_Unknown, 0, 3, "nope"), OrthancException);
+
+  for (std::map<std::string, std::string>::const_iterator it = customData.begin(); it != customData.end(); ++it)
+  {
+    s.Remove(it->first, FileContentType_Unknown, it->second);
+  }
+
+  s.Remove(oldUuid, FileContentType_Unknown, "");
+
+  legacy.ListAllFiles(files);
+  ASSERT_TRUE(files.empty());
+  root2.ListAllFiles(files);
+  ASSERT_TRUE(files.empty());
+}
+
+
+namespace
+{
+  class MemoryReferences : public ContentAddressedStorageArea::IReferences
+  {
+  private:
+    struct Content
+    {
+      unsigned int  count_;
+      std::string   customData_;
+    };
+
+    std::map<std::string, Content>  contents_;
+
+  public:
+    virtual ContentAddressedStorageArea::ReferenceStatus AddReference(std::string& customData,
+                                                                      const std::string& key) ORTHANC_OVERRIDE
+    {
+      std::map<std::string, Content>::iterator found = contents_.find(key);
+      if (found == contents_.end())
+      {
+        return ContentAddressedStorageArea::ReferenceStatus_Missing;
+      }
+      else if (found->second.count_ == 0)
+      {
+        return ContentAddressedStorageArea::ReferenceStatus_Deleting;
+      }
+      else
+      {
+        found->second.count_++;
+        customData = found->second.customData_;
+        return ContentAddressedStorageArea::ReferenceStatus_Added;
+      }
+    }
+
+    virtual bool Register(std::string& customData,
+                          const std::string& key) ORTHANC_OVERRIDE
+    {
+      std::string existing;
+      ContentAddressedStorageArea::ReferenceStatus status = AddReference(existing, key);
+
+      if (status == ContentAddressedStorageArea::ReferenceStatus_Added)
+      {
+        customData = existing;
+        return false;
+      }
+      else if (status == ContentAddressedStorageArea::ReferenceStatus_Deleting)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+      else
+      {
+        contents_[key].count_ = 1;
+        contents_[key].customData_ = customData;
+        return true;
+      }
+    }
+
+    virtual bool RemoveReference(const std::string& key) ORTHANC_OVERRIDE
+    {
+      std::map<std::string, Content>::iterator found = contents_.find(key);
+      return (found != contents_.end() &&
+              found->second.count_ > 0 &&
+              --found->second.count_ == 0);
+    }
+
+    virtual void Forget(const std::string& key) ORTHANC_OVERRIDE
+    {
+      contents_.erase(key);
+    }
+
+    unsigned int GetCount(const std::string& key) const
+    {
+      std::map<std::string, Content>::const_iterator found = contents_.find(key);
+      return (found == contents_.end() ? 0 : found->second.count_);
+    }
+  };
+}
+
+
+TEST(ContentAddressedStorageArea, Basic)
+{
+  const std::string key = ContentAddressedStorageArea::ComputeKey("hello", 5, FileContentType_Dicom, CompressionType_None);
+  ASSERT_TRUE(Toolbox::IsUuid(key));
+  ASSERT_EQ('5', key[14]);
+  ASSERT_TRUE(key[19] == '8' || key[19] == '9' || key[19] == 'a' || key[19] == 'b');
+  ASSERT_EQ(key, ContentAddressedStorageArea::ComputeKey("hello", 5, FileContentType_Dicom, CompressionType_None));
+  ASSERT_NE(key, ContentAddressedStorageArea::ComputeKey("hello", 5, FileContentType_DicomAsJson, CompressionType_None));
+  ASSERT_NE(key, ContentAddressedStorageArea::ComputeKey("hello", 5, FileContentType_Dicom, CompressionType_ZlibWithSize));
+  ASSERT_NE(key, ContentAddressedStorageArea::ComputeKey("hellp", 5, FileContentType_Dicom, CompressionType_None));
+
+  std::string k, c;
+  ASSERT_TRUE(ContentAddressedStorageArea::ParseCustomData(k, c, ContentAddressedStorageArea::FormatCustomData(key, "")));
+  ASSERT_EQ(key, k);
+  ASSERT_TRUE(c.empty());
+  ASSERT_TRUE(ContentAddressedStorageArea::ParseCustomData(k, c, ContentAddressedStorageArea::FormatCustomData(key, "a:b")));
+  ASSERT_EQ(key, k);
+  ASSERT_EQ("a:b", c);
+  ASSERT_FALSE(ContentAddressedStorageArea::ParseCustomData(k, c, ""));
+  ASSERT_FALSE(ContentAddressedStorageArea::ParseCustomData(k, c, "root1"));
+
+  MemoryStorageArea* memory = new MemoryStorageArea;
+  PluginStorageAreaAdapter adapter(memory);
+  ContentAddressedStorageArea s(adapter);
+  MemoryReferences references;
+
+  std::string customData1, customData2, customData3;
+  ASSERT_THROW(s.Create(customData1, Toolbox::GenerateUuid(), "hello", 5, FileContentType_Dicom, CompressionType_None, NULL), OrthancException);
+
+  s.SetReferences(references);
+
+  const std::string uuid1 = Toolbox::GenerateUuid();
+  const std::string uuid2 = Toolbox::GenerateUuid();
+  const std::string uuid3 = Toolbox::GenerateUuid();
+  s.Create(customData1, uuid1, "hello", 5, FileContentType_Dicom, CompressionType_None, NULL);
+  s.Create(customData2, uuid2, "hello", 5, FileContentType_Dicom, CompressionType_None, NULL);
+  s.Create(customData3, uuid3, "world", 5, FileContentType_Dicom, CompressionType_None, NULL);
+  ASSERT_EQ(customData1, customData2);
+  ASSERT_NE(customData1, customData3);
+  ASSERT_EQ(2u, references.GetCount(key));
+
+  // The content is stored once, under its key
+  std::unique_ptr<IMemoryBuffer> stored(memory->ReadRange(key, FileContentType_Dicom, 0, 5));
+  ASSERT_THROW(memory->ReadRange(uuid1, FileContentType_Dicom, 0, 5), OrthancException);
+  ASSERT_THROW(memory->ReadRange(uuid2, FileContentType_Dicom, 0, 5), OrthancException);
+
+  {
+    std::unique_ptr<IMemoryBuffer> buffer(s.ReadRange(uuid2, FileContentType_Dicom, 0, 5, customData2));
+    std::string content;
+    buffer->MoveToString(content);
+    ASSERT_EQ("hello", content);
+  }
+
+  s.Remove(uuid1, FileContentType_Dicom, customData1);
+  ASSERT_EQ(1u, references.GetCount(key));
+  stored.reset(memory->ReadRange(key, FileContentType_Dicom, 0, 5));
+
+  s.Remove(uuid2, FileContentType_Dicom, customData2);
+  ASSERT_EQ(0u, references.GetCount(key));
+  ASSERT_THROW(memory->ReadRange(key, FileContentType_Dicom, 0, 5), OrthancException);
+
+  // Attachments that are not content-addressed
+  const std::string uuid4 = Toolbox::GenerateUuid();
+  adapter.Create(customData1, uuid4, "plain", 5, FileContentType_Dicom, CompressionType_None, NULL);
+  ASSERT_TRUE(customData1.empty());
+
+  {
+    std::unique_ptr<IMemoryBuffer> buffer(s.ReadRange(uuid4, FileContentType_Dicom, 0, 5, customData1));
+    std::string content;
+    buffer->MoveToString(content);
+    ASSERT_EQ("plain", content);
+  }
+
+  s.Remove(uuid4, FileContentType_Dicom, customData1);
+  ASSERT_THROW(memory->ReadRange(uuid4, FileContentType_Dicom, 0, 5), OrthancException);
+
+  s.Remove(uuid3, FileContentType_Dicom, customData3);
+}
+
+
 TEST(StorageAccessor, NoCompression)
 {
   PluginStorageAreaAdapter s(new FilesystemStorage("UnitTestsStorage"));
@@ -216,6 +560,404 @@ TEST(StorageAccessor, NoCompression)
 }
 
 
+#if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
+namespace
+{
+  class SendFileOutputStream : public IHttpOutputStream
+  {
+  private:
+    std::string  header_;
+    std::string  body_;
+    std::string  sentFile_;
+
+  public:
+    virtual void OnHttpStatusReceived(HttpStatus status) ORTHANC_OVERRIDE
+    {
+    }
+
+    virtual void Send(bool isHeader, const void* buffer, size_t length) ORTHANC_OVERRIDE
+    {
+      (isHeader ? header_ : body_).append(reinterpret_cast<const char*>(buffer), length);
+    }
+
+    virtual void DisableKeepAlive() ORTHANC_OVERRIDE
+    {
+    }
+
+    virtual bool IsSendFileSupported() const ORTHANC_OVERRIDE
+    {
+      return true;
+    }
+
+    virtual void SendFile(const std::string& path) ORTHANC_OVERRIDE
+    {
+      sentFile_ = path;
+    }
+
+    const std::string& GetHeader() const
+    {
+      return header_;
+    }
+
+    const std::string& GetBody() const
+    {
+      return body_;
+    }
+
+    const std::string& GetSentFile() const
+    {
+      return sentFile_;
+    }
+  };
+}
+
+
+TEST(StorageAccessor, SendFile)
+{
+  PluginStorageAreaAdapter s(new FilesystemStorage("UnitTestsStorage"));
+  StorageAccessor accessor(s);
+
+  const std::string data = "Hello world";
+  FileInfo uncompressed, compressed;
+  accessor.Write(uncompressed, data.c_str(), data.size(), FileContentType_Dicom, CompressionType_None, true, NULL);
+  accessor.Write(compressed, data.c_str(), data.size(), FileContentType_Dicom, CompressionType_ZlibWithSize, true, NULL);
+
+  std::string path;
+  ASSERT_TRUE(s.LookupLocalPath(path, uncompressed.GetUuid(), FileContentType_Dicom, ""));
+
+  std::string content;
+  SystemToolbox::ReadFile(content, path);
+  ASSERT_EQ(data, content);
+
+  {
+    SendFileOutputStream stream;
+    HttpOutput output(stream, false, 0);
+    output.SetGzipAllowed(true);
+    accessor.AnswerFile(output, uncompressed, MimeType_Dicom, "a.dcm");
+    ASSERT_EQ(path, stream.GetSentFile());
+    ASSERT_TRUE(stream.GetBody().empty());
+    ASSERT_NE(std::string::npos, stream.GetHeader().find("Content-Length: 11\r\n"));
+  }
+
+  {
+    // Compressed attachments go through the memory
+    SendFileOutputStream stream;
+    HttpOutput output(stream, false, 0);
+    accessor.AnswerFile(output, compressed, MimeType_Dicom, "b.dcm");
+    ASSERT_TRUE(stream.GetSentFile().empty());
+    ASSERT_EQ(data, stream.GetBody());
+  }
+
+  {
+    // Compressible content types are not sent as such if the client accepts gzip
+    SendFileOutputStream stream;
+    HttpOutput output(stream, false, 0);
+    output.SetGzipAllowed(true);
+    accessor.AnswerFile(output, uncompressed, MimeType_Json, "c.json");
+    ASSERT_TRUE(stream.GetSentFile().empty());
+  }
+
+  {
+    MemoryStorageArea memory;
+    ASSERT_FALSE(memory.LookupLocalPath(path, uncompressed.GetUuid(), FileContentType_Dicom));
+  }
+
+  accessor.Remove(uncompressed);
+  accessor.Remove(compressed);
+}
+
+
+namespace
+{
+  class StreamingStorageArea : public IPluginStorageArea
+  {
+  private:
+    typedef std::map<std::string, std::string>  Content;
+
+    class Writer : public IStorageAreaWriter
+    {
+    private:
+      StreamingStorageArea&  that_;
+      std::string            uuid_;
+      std::string            content_;
+
+    public:
+      Writer(StreamingStorageArea& that,
+             const std::string& uuid) :
+        that_(that),
+        uuid_(uuid)
+      {
+      }
+
+      virtual void AppendChunk(const void* chunk,
+                               size_t size) ORTHANC_OVERRIDE
+      {
+        content_.append(reinterpret_cast<const char*>(chunk), size);
+        that_.writtenChunks_++;
+      }
+
+      virtual void Commit(std::string& customData) ORTHANC_OVERRIDE
+      {
+        that_.content_[uuid_].swap(content_);
+        customData = "streamed";
+      }
+    };
+
+    class Reader : public IStorageAreaReader
+    {
+    private:
+      StreamingStorageArea&  that_;
+      const std::string&     content_;
+      size_t                 position_;
+
+    public:
+      Reader(StreamingStorageArea& that,
+             const std::string& content) :
+        that_(that),
+        content_(content),
+        position_(0)
+      {
+      }
+
+      virtual size_t ReadChunk(void* target,
+                               size_t size) ORTHANC_OVERRIDE
+      {
+        size_t count = std::min(size, content_.size() - position_);
+        memcpy(target, content_.c_str() + position_, count);
+        position_ += count;
+        that_.readChunks_++;
+        return count;
+      }
+    };
+
+    Content       content_;
+    unsigned int  writtenChunks_;
+    unsigned int  readChunks_;
+
+    const std::string& GetContent(const std::string& uuid) const
+    {
+      Content::const_iterator found = content_.find(uuid);
+      if (found == content_.end())
+      {
+        throw OrthancException(ErrorCode_InexistentFile);
+      }
+      else
+      {
+        return found->second;
+      }
+    }
+
+  public:
+    StreamingStorageArea() :
+      writtenChunks_(0),
+      readChunks_(0)
+    {
+    }
+
+    unsigned int GetWrittenChunks() const
+    {
+      return writtenChunks_;
+    }
+
+    unsigned int GetReadChunks() const
+    {
+      return readChunks_;
+    }
+
+    virtual void Create(std::string& customData,
+                        const std::string& uuid,
+                        const void* content,
+                        size_t size,
+                        FileContentType type,
+                        CompressionType compression,
+                        const DicomInstanceToStore* dicomInstance) ORTHANC_OVERRIDE
+    {
+      content_[uuid].assign(reinterpret_cast<const char*>(content), size);
+    }
+
+    virtual IMemoryBuffer* ReadRange(const std::string& uuid,
+                                     FileContentType type,
+                                     uint64_t start,
+                                     uint64_t end,
+                                     const std::string& customData) ORTHANC_OVERRIDE
+    {
+      return StringMemoryBuffer::CreateFromCopy(GetContent(uuid), start, end);
+    }
+
+    virtual bool HasEfficientReadRange() const ORTHANC_OVERRIDE
+    {
+      return true;
+    }
+
+    virtual void Remove(const std::string& uuid,
+                        FileContentType type,
+                        const std::string& customData) ORTHANC_OVERRIDE
+    {
+      content_.erase(uuid);
+    }
+
+    virtual bool LookupLocalPath(std::string& path,
+                                 const std::string& uuid,
+                                 FileContentType type,
+                                 const std::string& customData) const ORTHANC_OVERRIDE
+    {
+      return false;
+    }
+
+    virtual bool HasStreamingAccess() const ORTHANC_OVERRIDE
+    {
+      return true;
+    }
+
+    virtual const std::string& GetBackendName() const ORTHANC_OVERRIDE
+    {
+      static const std::string NAME = "streaming";
+      return NAME;
+    }
+
+    virtual IStorageAreaWriter* OpenWrite(const std::string& uuid,
+                                          FileContentType type,
+                                          CompressionType compression,
+                                          uint64_t size,
+                                          const DicomInstanceToStore* dicomInstance) ORTHANC_OVERRIDE
+    {
+      return new Writer(*this, uuid);
+    }
+
+    virtual IStorageAreaReader* OpenRead(const std::string& uuid,
+                                         FileContentType type,
+                                         const std::string& customData) ORTHANC_OVERRIDE
+    {
+      return new Reader(*this, GetContent(uuid));
+    }
+  };
+}
+
+
+TEST(StorageAccessor, Streaming)
+{
+  StreamingStorageArea s;
+  StorageAccessor accessor(s);
+
+  std::string large;
+  large.resize(20 * 1024 * 1024);
+  for (size_t i = 0; i < large.size(); i++)
+  {
+    large[i] = static_cast<char>(i % 251);
+  }
+
+  const std::string small = "Hello world";
+
+  FileInfo a, b;
+  accessor.Write(a, large.c_str(), large.size(), FileContentType_Dicom, CompressionType_None, false, NULL);
+  ASSERT_EQ(3u, s.GetWrittenChunks());  // 8MB + 8MB + 4MB
+  ASSERT_EQ("streamed", a.GetCustomData());
+
+  accessor.Write(b, small.c_str(), small.size(), FileContentType_Dicom, CompressionType_None, false, NULL);
+  ASSERT_EQ(3u, s.GetWrittenChunks());  // Small files are not streamed
+  ASSERT_TRUE(b.GetCustomData().empty());
+
+  {
+    SendFileOutputStream stream;
+    HttpOutput output(stream, false, 0);
+    accessor.AnswerFile(output, a, MimeType_Dicom, "a.dcm");
+    ASSERT_EQ(3u, s.GetReadChunks());
+    ASSERT_TRUE(large == stream.GetBody());
+  }
+
+  {
+    SendFileOutputStream stream;
+    HttpOutput output(stream, false, 0);
+    accessor.AnswerFile(output, b, MimeType_Dicom, "b.dcm");
+    ASSERT_EQ(3u, s.GetReadChunks());
+    ASSERT_EQ(small, stream.GetBody());
+  }
+
+  std::string r;
+  accessor.Read(r, a);
+  ASSERT_TRUE(large == r);
+
+  {
+    // The MD5 is computed while streaming the chunks
+    std::string md5;
+    Toolbox::ComputeMD5(md5, large);
+
+    FileInfo c;
+    accessor.Write(c, large.c_str(), large.size(), FileContentType_Dicom, CompressionType_None, true, NULL);
+    ASSERT_EQ(6u, s.GetWrittenChunks());
+    ASSERT_EQ(md5, c.GetUncompressedMD5());
+    ASSERT_EQ(md5, c.GetCompressedMD5());
+  }
+}
+
+
+TEST(StorageAccessor, Metrics)
+{
+  MetricsRegistry metrics;
+  StreamingStorageArea s;
+  StorageAccessor accessor(s, metrics);
+
+  const std::string content = "Hello world";
+
+  FileInfo info;
+  accessor.Write(info, content.c_str(), content.size(), FileContentType_Dicom, CompressionType_None, false, NULL);
+
+  std::string r;
+  accessor.Read(r, info);
+  ASSERT_EQ(content, r);
+
+  accessor.ReadStartRange(r, info, 5);
+  ASSERT_EQ("Hello", r);
+
+  accessor.Remove(info);
+
+  std::string text;
+  metrics.ExportPrometheusText(text);
+
+  const std::string labels = "{content_type=\"dicom\",backend=\"streaming\"}";
+  ASSERT_NE(std::string::npos, text.find("orthanc_storage_written_bytes" + labels + " 11 "));
+  ASSERT_NE(std::string::npos, text.find("orthanc_storage_read_bytes" + labels + " 16 "));
+  ASSERT_NE(std::string::npos, text.find("orthanc_storage_create_duration_ms_count" + labels + " 1 "));
+  ASSERT_NE(std::string::npos, text.find("orthanc_storage_read_duration_ms_count" + labels + " 1 "));
+  ASSERT_NE(std::string::npos, text.find("orthanc_storage_read_range_duration_ms_count" + labels + " 1 "));
+  ASSERT_NE(std::string::npos, text.find("orthanc_storage_remove_duration_ms_count" + labels + " 1 "));
+  ASSERT_NE(std::string::npos, text.find("orthanc_storage_in_flight{operation=\"read\",backend=\"streaming\"} 0 "));
+}
+
+
+TEST(HttpOutput, StartBody)
+{
+  {
+    SendFileOutputStream stream;
+    HttpOutput output(stream, false, 0);
+    output.SetGzipAllowed(true);  // Must be ignored, as the body is not buffered
+    output.StartBody("text/plain", 11);
+    ASSERT_TRUE(output.IsWritingBody());
+    output.SendBodyChunk("Hello", 5);
+    output.SendBodyChunk(" world", 6);
+    ASSERT_FALSE(output.IsWritingBody());
+    output.CloseBody();
+    ASSERT_EQ("Hello world", stream.GetBody());
+    ASSERT_NE(std::string::npos, stream.GetHeader().find("Content-Length: 11\r\n"));
+    ASSERT_NE(std::string::npos, stream.GetHeader().find("Content-Type: text/plain\r\n"));
+    ASSERT_EQ(std::string::npos, stream.GetHeader().find("Transfer-Encoding"));
+    ASSERT_THROW(output.SendBodyChunk("!", 1), OrthancException);
+  }
+
+  {
+    SendFileOutputStream stream;
+    HttpOutput output(stream, false, 0);
+    output.StartBody("", 10);
+    ASSERT_NE(std::string::npos, stream.GetHeader().find("Content-Type: application/octet-stream\r\n"));
+    ASSERT_THROW(output.StartBody("", 10), OrthancException);
+    output.SendBodyChunk("Hello", 5);
+    ASSERT_THROW(output.SendBodyChunk("Hello world", 11), OrthancException);  // Too large
+    ASSERT_THROW(output.CloseBody(), OrthancException);  // Too small
+  }
+}
+#endif
+
+
 TEST(StorageAccessor, Compression)
 {
   PluginStorageAreaAdapter s(new FilesystemStorage("UnitTestsStorage"));
@@ -238,6 +980,45 @@ TEST(StorageAccessor, Compression)
 }
 
 
+TEST(StorageAccessor, FastCompression)
+{
+  PluginStorageAreaAdapter s(new FilesystemStorage("UnitTestsStorage"));
+
+  std::string data = Toolbox::GenerateUuid();
+  data = data + data + data + data;
+
+  const CompressionType types[] = { CompressionType_ZstdWithSize, CompressionType_Lz4WithSize };
+
+  for (size_t i = 0; i < sizeof(types) / sizeof(CompressionType); i++)
+  {
+    StorageAccessor accessor(s);
+    FileInfo info;
+
+    if (IsCompressionTypeSupported(types[i]))
+    {
+      accessor.Write(info, data.c_str(), data.size(), FileContentType_Dicom, types[i], true, NULL);
+      ASSERT_EQ(types[i], info.GetCompressionType());
+      ASSERT_EQ(data.size(), info.GetUncompressedSize());
+      ASSERT_LT(info.GetCompressedSize(), info.GetUncompressedSize());
+
+      std::string r;
+      accessor.Read(r, info);
+      ASSERT_EQ(data, r);
+
+      StorageRange range;
+      range.SetStartInclusive(10);
+      range.SetEndInclusive(19);
+      accessor.ReadRange(r, info, range, true /* uncompress */);
+      ASSERT_EQ(data.substr(10, 10), r);
+    }
+    else
+    {
+      ASSERT_THROW(accessor.Write(info, data.c_str(), data.size(), FileContentType_Dicom, types[i], true, NULL), OrthancException);
+    }
+  }
+}
+
+
 TEST(StorageAccessor, Mix)
 {
   PluginStorageAreaAdapter s(new FilesystemStorage("UnitTestsStorage"));
@@ -268,6 +1049,202 @@ TEST(StorageAccessor, Mix)
 }
 
 
+TEST(StorageCache, Headers)
+{
+  StorageCache cache;
+  cache.SetMaximumHeadersSize(10);
+
+  const std::string uuid = Toolbox::GenerateUuid();
+
+  {
+    std::string s;
+    StorageCache::HeaderAccessor headers(cache);
+    ASSERT_FALSE(headers.FetchDicomHeader(s, uuid));
+    headers.AddDicomHeader(uuid, "Header");
+  }
+
+  {
+    // The cache of the full files is not affected
+    std::string s;
+    StorageCache::Accessor accessor(cache);
+    ASSERT_FALSE(accessor.Fetch(s, uuid, FileContentType_Dicom));
+  }
+
+  ASSERT_EQ(0u, cache.GetNumberOfItems());
+  ASSERT_EQ(1u, cache.GetHeadersNumberOfItems());
+  ASSERT_EQ(6u, cache.GetHeadersCurrentSize());
+
+  {
+    std::string s;
+    StorageCache::HeaderAccessor headers(cache);
+    ASSERT_TRUE(headers.FetchDicomHeader(s, uuid));
+    ASSERT_EQ("Header", s);
+  }
+
+  cache.Invalidate(uuid, FileContentType_DicomAsJson);
+  ASSERT_EQ(1u, cache.GetHeadersNumberOfItems());
+
+  cache.Invalidate(uuid, FileContentType_Dicom);
+  ASSERT_EQ(0u, cache.GetHeadersNumberOfItems());
+
+  {
+    std::string s;
+    StorageCache::HeaderAccessor headers(cache);
+    ASSERT_FALSE(headers.FetchDicomHeader(s, uuid));
+    headers.AddDicomHeader(uuid, "This header is too large");
+  }
+
+  ASSERT_EQ(0u, cache.GetHeadersNumberOfItems());
+}
+
+
+TEST(StorageDiskCache, Basic)
+{
+  const boost::filesystem::path root("UnitTestsResults/StorageDiskCache");
+  boost::filesystem::remove_all(root);
+
+  const std::string uuid1 = Toolbox::GenerateUuid();
+  const std::string uuid2 = Toolbox::GenerateUuid();
+
+  {
+    StorageDiskCache cache(root, 20);
+    ASSERT_EQ(0u, cache.GetNumberOfItems());
+
+    std::string s;
+    ASSERT_FALSE(cache.Read(s, uuid1, FileContentType_Dicom));
+
+    cache.AddStartRange(uuid1, FileContentType_Dicom, "Hello", 5);
+    ASSERT_FALSE(cache.Read(s, uuid1, FileContentType_Dicom));
+    ASSERT_TRUE(cache.ReadRange(s, uuid1, FileContentType_Dicom, 0, 3));  ASSERT_EQ("Hel", s);
+    ASSERT_FALSE(cache.ReadRange(s, uuid1, FileContentType_Dicom, 0, 6));
+    ASSERT_FALSE(cache.ReadRange(s, uuid1, FileContentType_Dicom, 1, 3));
+
+    cache.Add(uuid1, FileContentType_Dicom, "Hello world", 11);
+    ASSERT_EQ(1u, cache.GetNumberOfItems());  // The start range was replaced
+    ASSERT_EQ(11u, cache.GetCurrentSize());
+    ASSERT_TRUE(cache.Read(s, uuid1, FileContentType_Dicom));  ASSERT_EQ("Hello world", s);
+    ASSERT_TRUE(cache.ReadRange(s, uuid1, FileContentType_Dicom, 6, 11));  ASSERT_EQ("world", s);
+    ASSERT_FALSE(cache.Read(s, uuid1, FileContentType_DicomAsJson));
+
+    cache.Add(uuid2, FileContentType_Dicom, "0123456789", 10);  // Evicts "uuid1"
+    ASSERT_EQ(1u, cache.GetNumberOfItems());
+    ASSERT_EQ(10u, cache.GetCurrentSize());
+    ASSERT_FALSE(cache.Read(s, uuid1, FileContentType_Dicom));
+
+    cache.Add(uuid1, FileContentType_Dicom, "This is too large for the cache", 31);
+    ASSERT_EQ(1u, cache.GetNumberOfItems());
+    ASSERT_FALSE(cache.Read(s, uuid1, FileContentType_Dicom));
+  }
+
+  {
+    // The content of the cache survives restarts
+    StorageDiskCache cache(root, 20);
+    ASSERT_EQ(1u, cache.GetNumberOfItems());
+    ASSERT_EQ(10u, cache.GetCurrentSize());
+
+    std::string s;
+    ASSERT_TRUE(cache.Read(s, uuid2, FileContentType_Dicom));  ASSERT_EQ("0123456789", s);
+
+    cache.Invalidate(uuid2, FileContentType_Dicom);
+    ASSERT_EQ(0u, cache.GetNumberOfItems());
+    ASSERT_FALSE(cache.Read(s, uuid2, FileContentType_Dicom));
+  }
+}
+
+
+TEST(StorageAccessor, DiskCache)
+{
+  const boost::filesystem::path root("UnitTestsResults/StorageDiskCache");
+  boost::filesystem::remove_all(root);
+
+  PluginStorageAreaAdapter s(new FilesystemStorage("UnitTestsStorage"));
+  StorageCache cache;
+  cache.SetMaximumSize(0);  // Only use the disk tier
+  cache.SetDiskCache(new StorageDiskCache(root, 1024 * 1024));
+
+  StorageAccessor accessor(s, cache);
+
+  const std::string data = "Hello world";
+  FileInfo info;
+  accessor.Write(info, data.c_str(), data.size(), FileContentType_Dicom, CompressionType_ZlibWithSize, true, NULL);
+  ASSERT_EQ(0u, cache.GetDiskCache()->GetNumberOfItems());  // Writes are not cached on the disk
+
+  std::string r;
+  accessor.Read(r, info);
+  ASSERT_EQ(data, r);
+  ASSERT_EQ(1u, cache.GetDiskCache()->GetNumberOfItems());
+  ASSERT_EQ(info.GetCompressedSize(), cache.GetDiskCache()->GetCurrentSize());
+
+  // Remove the file from the storage area, the disk cache must still serve it
+  s.Remove(info.GetUuid(), info.GetContentType(), info.GetCustomData());
+  accessor.Read(r, info);
+  ASSERT_EQ(data, r);
+  ASSERT_EQ(1u, cache.GetDiskCache()->GetHitsCount());
+
+  cache.Invalidate(info.GetUuid(), info.GetContentType());
+  ASSERT_EQ(0u, cache.GetDiskCache()->GetNumberOfItems());
+  ASSERT_THROW(accessor.Read(r, info), OrthancException);
+}
+
+
+TEST(StorageAccessor, Prefetch)
+{
+  PluginStorageAreaAdapter s(new FilesystemStorage("UnitTestsStorage"));
+
+  const std::string data = "Hello world";
+  FileInfo info;
+
+  {
+    StorageAccessor accessor(s);
+    accessor.Write(info, data.c_str(), data.size(), FileContentType_Dicom, CompressionType_ZlibWithSize, true, NULL);
+    ASSERT_THROW(accessor.Prefetch(info), OrthancException);  // No cache
+  }
+
+  StorageCache cache;
+  StorageAccessor accessor(s, cache);
+  accessor.SetCacheAdmission(false);  // Prefetching ignores the cache admission
+
+  ASSERT_TRUE(accessor.Prefetch(info));
+  ASSERT_EQ(1u, cache.GetNumberOfItems());
+  ASSERT_EQ(data.size(), cache.GetCurrentSize());
+  ASSERT_FALSE(accessor.Prefetch(info));
+
+  // The prefetched file is served from the cache
+  s.Remove(info.GetUuid(), info.GetContentType(), info.GetCustomData());
+
+  std::string r;
+  accessor.Read(r, info);
+  ASSERT_EQ(data, r);
+}
+
+
+TEST(StorageAccessor, ReadBuffer)
+{
+  PluginStorageAreaAdapter s(new FilesystemStorage("UnitTestsStorage"));
+  StorageCache cache;
+  StorageAccessor accessor(s, cache);
+
+  const std::string data = "Hello world";
+  FileInfo raw, compressed;
+  accessor.Write(raw, data.c_str(), data.size(), FileContentType_Dicom, CompressionType_None, true, NULL);
+  accessor.Write(compressed, data.c_str(), data.size(), FileContentType_Dicom, CompressionType_ZlibWithSize, true, NULL);
+
+  for (unsigned int i = 0; i < 2; i++)  // The second iteration is served from the cache
+  {
+    std::unique_ptr<IMemoryBuffer> buffer(accessor.ReadBuffer(raw));
+    ASSERT_EQ(data.size(), buffer->GetSize());
+    ASSERT_EQ(0, memcmp(data.c_str(), buffer->GetData(), data.size()));
+
+    buffer.reset(accessor.ReadBuffer(compressed));
+    std::string r;
+    buffer->MoveToString(r);
+    ASSERT_EQ(data, r);
+  }
+
+  ASSERT_EQ(2u, cache.GetNumberOfItems());
+}
+
+
 TEST(StorageAccessor, Range)
 {
   {
@@ -37,20 +37,25 @@
 
 #include "../Sources/CompatibilityMath.h"
 #include "../Sources/DicomFormat/DicomTag.h"
+#include "../Sources/ElapsedTimer.h"
 #include "../Sources/HttpServer/HttpToolbox.h"
 #include "../Sources/Logging.h"
 #include "../Sources/OrthancException.h"
 #include "../Sources/Toolbox.h"
 
 #if ORTHANC_SANDBOXED != 1
+#  include "../Sources/CpuProfiler.h"
 #  include "../Sources/FileBuffer.h"
 #  include "../Sources/MetricsRegistry.h"
+#  include "../Sources/RequestTimings.h"
 #  include "../Sources/SystemToolbox.h"
 #  include "../Sources/TemporaryFile.h"
+#  include "../Sources/Tracing.h"
 
 #  include <boost/thread.hpp>
 #endif
 
+#include <boost/lexical_cast.hpp>
 #include <ctype.h>
 #include <limits>
 
@@ -163,6 +168,42 @@ TEST(ParseGetArguments, SingleEmpty)
 }
 
 
+TEST(HttpToolbox, ParseByteRange)
+{
+  uint64_t start, end;
+  ASSERT_TRUE(HttpToolbox::ParseByteRange(start, end, "bytes=0-99", 1000));
+  ASSERT_EQ(0u, start);
+  ASSERT_EQ(99u, end);
+
+  ASSERT_TRUE(HttpToolbox::ParseByteRange(start, end, "bytes=500-", 1000));
+  ASSERT_EQ(500u, start);
+  ASSERT_EQ(999u, end);
+
+  ASSERT_TRUE(HttpToolbox::ParseByteRange(start, end, "bytes=900-2000", 1000));
+  ASSERT_EQ(900u, start);
+  ASSERT_EQ(999u, end);
+
+  ASSERT_TRUE(HttpToolbox::ParseByteRange(start, end, "bytes=-100", 1000));
+  ASSERT_EQ(900u, start);
+  ASSERT_EQ(999u, end);
+
+  ASSERT_TRUE(HttpToolbox::ParseByteRange(start, end, "bytes=-2000", 1000));
+  ASSERT_EQ(0u, start);
+  ASSERT_EQ(999u, end);
+
+  ASSERT_FALSE(HttpToolbox::ParseByteRange(start, end, "", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseByteRange(start, end, "items=0-99", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseByteRange(start, end, "bytes=0-9,20-29", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseByteRange(start, end, "bytes=99-0", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseByteRange(start, end, "bytes=a-b", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseByteRange(start, end, "bytes=-", 1000));
+
+  ASSERT_THROW(HttpToolbox::ParseByteRange(start, end, "bytes=1000-", 1000), OrthancException);
+  ASSERT_THROW(HttpToolbox::ParseByteRange(start, end, "bytes=-0", 1000), OrthancException);
+  ASSERT_THROW(HttpToolbox::ParseByteRange(start, end, "bytes=0-", 0), OrthancException);
+}
+
+
 TEST(ParseGetQuery, Test1)
 {
   UriComponents uri;
@@ -372,6 +413,7 @@ TEST(Uri, AutodetectMimeType)
   ASSERT_STREQ("model/obj", EnumerationToString(SystemToolbox::AutodetectMimeType(".obj")));
   ASSERT_STREQ("model/mtl", EnumerationToString(SystemToolbox::AutodetectMimeType(".mtl")));
   ASSERT_STREQ("model/stl", EnumerationToString(SystemToolbox::AutodetectMimeType(".stl")));
+  ASSERT_STREQ("application/x-tar", EnumerationToString(SystemToolbox::AutodetectMimeType(".tar")));
 
   // test with utf8 strings
   ASSERT_STREQ("model/stl", EnumerationToString(SystemToolbox::AutodetectMimeType("\xd0\x94.stl")));
@@ -656,6 +698,100 @@ TEST(Toolbox, IsAsciiString)
 }
 
 
+TEST(Toolbox, AsciiFastPath)
+{
+  // Check the word-at-a-time scanning at every offset of long strings
+  const std::string base = "The quick brown fox jumps over the lazy dog 0123456789";
+  ASSERT_TRUE(Toolbox::IsAsciiString(base));
+  ASSERT_TRUE(Toolbox::IsValidUtf8(base));
+
+  for (size_t i = 0; i < base.size(); i++)
+  {
+    std::string s = base;
+
+    s[i] = '\x7f';
+    ASSERT_FALSE(Toolbox::IsAsciiString(s));
+    ASSERT_TRUE(Toolbox::IsValidUtf8(s));
+
+    s[i] = '\r';
+    ASSERT_FALSE(Toolbox::IsAsciiString(s));
+
+    s[i] = '\n';
+    ASSERT_TRUE(Toolbox::IsAsciiString(s));
+
+    s[i] = '\xe9';  // Latin-1 "e" with acute accent
+    ASSERT_FALSE(Toolbox::IsAsciiString(s));
+    ASSERT_FALSE(Toolbox::IsValidUtf8(s));
+    ASSERT_EQ(base.size() - 1, Toolbox::ConvertToAscii(s).size());
+
+    const std::string utf8 = Toolbox::ConvertToUtf8(s, Encoding_Latin1, false, false);
+    ASSERT_EQ(base.size() + 1, utf8.size());
+    ASSERT_TRUE(Toolbox::IsValidUtf8(utf8));
+    ASSERT_EQ(s, Toolbox::ConvertFromUtf8(utf8, Encoding_Latin1));
+
+    s = base.substr(0, i) + "\xc3" + base.substr(i);  // Truncated 2-byte sequence
+    ASSERT_FALSE(Toolbox::IsValidUtf8(s));
+  }
+
+  // Pure ASCII strings are returned unchanged
+  ASSERT_EQ(base, Toolbox::ConvertToUtf8(base, Encoding_Latin1, false, false));
+  ASSERT_EQ(base, Toolbox::ConvertToUtf8(base, Encoding_Utf8, true, false));
+  ASSERT_EQ(base, Toolbox::ConvertToUtf8(base, Encoding_Ascii, false, false));
+  ASSERT_EQ(base, Toolbox::ConvertFromUtf8(base, Encoding_Greek));
+  ASSERT_EQ(base, Toolbox::ConvertToAscii(base));
+
+  // The ISO 2022 escape sequences are still removed if code extensions are present
+  ASSERT_EQ("Hello world", Toolbox::ConvertToUtf8("Hello\x1b(B world", Encoding_Latin1, true, false));
+  ASSERT_EQ("Hello\x1b(B world", Toolbox::ConvertToUtf8("Hello\x1b(B world", Encoding_Latin1, false, false));
+}
+
+
+TEST(Toolbox, DISABLED_AsciiFastPathBenchmark)
+{
+  std::vector<std::string> values;
+  for (size_t i = 0; i < 64; i++)
+  {
+    values.push_back("1.2.840.113619.2.55.3.604688119.969." + boost::lexical_cast<std::string>(i));
+  }
+
+  static const size_t COUNT = 100000;
+
+  {
+    ElapsedTimer timer;
+    size_t size = 0;
+    for (size_t i = 0; i < COUNT; i++)
+    {
+      size += Toolbox::ConvertToUtf8(values[i % values.size()], Encoding_Latin1, false, false).size();
+    }
+
+    printf("ConvertToUtf8(): %s for %d strings (%d bytes)\n", timer.GetHumanElapsedDuration().c_str(),
+           static_cast<int>(COUNT), static_cast<int>(size));
+  }
+
+  {
+    ElapsedTimer timer;
+    size_t count = 0;
+    for (size_t i = 0; i < COUNT; i++)
+    {
+      count += (Toolbox::IsAsciiString(values[i % values.size()]) ? 1 : 0);
+    }
+
+    printf("IsAsciiString(): %s for %d strings\n", timer.GetHumanElapsedDuration().c_str(), static_cast<int>(count));
+  }
+
+  {
+    ElapsedTimer timer;
+    size_t count = 0;
+    for (size_t i = 0; i < COUNT; i++)
+    {
+      count += (Toolbox::IsValidUtf8(values[i % values.size()]) ? 1 : 0);
+    }
+
+    printf("IsValidUtf8(): %s for %d strings\n", timer.GetHumanElapsedDuration().c_str(), static_cast<int>(count));
+  }
+}
+
+
 #if defined(__linux__)
 TEST(Toolbox, AbsoluteDirectory)
 {
@@ -930,6 +1066,7 @@ TEST(Toolbox, Enumerations)
   ASSERT_EQ(MimeType_Mtl, StringToMimeType(EnumerationToString(MimeType_Mtl)));
   ASSERT_EQ(MimeType_Obj, StringToMimeType(EnumerationToString(MimeType_Obj)));
   ASSERT_EQ(MimeType_Stl, StringToMimeType(EnumerationToString(MimeType_Stl)));
+  ASSERT_EQ(MimeType_Tar, StringToMimeType(EnumerationToString(MimeType_Tar)));
   ASSERT_THROW(StringToMimeType("nope"), OrthancException);
 
   ASSERT_TRUE(IsResourceLevelAboveOrEqual(ResourceType_Patient, ResourceType_Patient));
@@ -1670,6 +1807,484 @@ TEST(MetricsRegistry, Basic)
     }
   }
 }
+
+
+TEST(MetricsRegistry, Histogram)
+{
+  ASSERT_EQ("route=\"/a/{id}\"", MetricsRegistry::FormatPrometheusLabel("route", "/a/{id}"));
+  ASSERT_EQ("aet=\"a\\\"b\\\\c\\n\"", MetricsRegistry::FormatPrometheusLabel("aet", "a\"b\\c\n"));
+
+  static const double BUCKETS[] = { 10, 100 };
+
+  MetricsRegistry mr;
+  const std::string labels = MetricsRegistry::FormatPrometheusLabel("method", "GET");
+  mr.AddHistogramSample("h", labels, BUCKETS, 2, 5);
+  mr.AddHistogramSample("h", labels, BUCKETS, 2, 50);
+  mr.AddHistogramSample("h", labels, BUCKETS, 2, 500);
+  mr.AddHistogramSample("unlabeled", "", BUCKETS, 2, 20);
+
+  std::map<std::string, std::string> values;
+  GetValuesDico(values, mr);
+  ASSERT_EQ(10u, values.size());
+  ASSERT_EQ("1", values["h_bucket{method=\"GET\",le=\"10\"}"]);
+  ASSERT_EQ("2", values["h_bucket{method=\"GET\",le=\"100\"}"]);
+  ASSERT_EQ("3", values["h_bucket{method=\"GET\",le=\"+Inf\"}"]);
+  ASSERT_EQ("3", values["h_count{method=\"GET\"}"]);
+  ASSERT_EQ("555", values["h_sum{method=\"GET\"}"]);
+  ASSERT_EQ("0", values["unlabeled_bucket{le=\"10\"}"]);
+  ASSERT_EQ("1", values["unlabeled_bucket{le=\"100\"}"]);
+  ASSERT_EQ("1", values["unlabeled_count"]);
+  ASSERT_EQ("20", values["unlabeled_sum"]);
+
+  mr.SetEnabled(false);
+  mr.AddHistogramSample("other", "", BUCKETS, 2, 20);
+  mr.SetEnabled(true);
+  GetValuesDico(values, mr);
+  ASSERT_EQ(values.end(), values.find("other_count"));
+}
+
+
+static void IncrementMetricsCounter(MetricsRegistry* registry,
+                                    MetricsRegistry::Counter* counter)
+{
+  for (unsigned int i = 0; i < 1000; i++)
+  {
+    counter->Increment();
+    registry->IncrementIntegerValue("counter", 2);
+  }
+}
+
+
+TEST(MetricsRegistry, Counter)
+{
+  MetricsRegistry mr;
+  MetricsRegistry::Counter counter(mr, "counter");
+  ASSERT_EQ(0, counter.GetValue());
+
+  std::map<std::string, std::string> values;
+  GetValuesDico(values, mr);
+  ASSERT_EQ("0", values["counter"]);  // Pre-registered counters are exported from the start
+  ASSERT_EQ(MetricsDataType_Integer, mr.GetDataType("counter"));
+  ASSERT_EQ(MetricsUpdatePolicy_Directly, mr.GetUpdatePolicy("counter"));
+
+  {
+    MetricsRegistry::Counter same(mr, "counter");  // Handles to the same counter
+    same.Increment(5);
+    ASSERT_EQ(5, counter.GetValue());
+  }
+
+  {
+    std::vector<boost::thread*> threads;
+
+    for (unsigned int i = 0; i < 4; i++)
+    {
+      threads.push_back(new boost::thread(IncrementMetricsCounter, &mr, &counter));
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+      threads[i]->join();
+      delete threads[i];
+    }
+  }
+
+  ASSERT_EQ(12005, counter.GetValue());
+  GetValuesDico(values, mr);
+  ASSERT_EQ("12005", values["counter"]);
+
+  mr.SetIntegerValue("counter", 42);
+  ASSERT_EQ(42, counter.GetValue());
+
+  mr.SetEnabled(false);
+  counter.Increment();
+  mr.SetEnabled(true);
+  ASSERT_EQ(42, counter.GetValue());
+
+  mr.SetIntegerValue("gauge", 10);
+  ASSERT_THROW(MetricsRegistry::Counter(mr, "gauge"), OrthancException);
+  mr.IncrementIntegerValue("gauge", 1);  // Not a counter, but can still be incremented
+  GetValuesDico(values, mr);
+  ASSERT_EQ("11", values["gauge"]);
+}
+
+
+TEST(MetricsRegistry, HistogramTimer)
+{
+  std::vector<double> buckets;
+  MetricsRegistry::GetExponentialBuckets(buckets, 10, 2, 4);
+  ASSERT_EQ(4u, buckets.size());
+  ASSERT_DOUBLE_EQ(10, buckets[0]);
+  ASSERT_DOUBLE_EQ(20, buckets[1]);
+  ASSERT_DOUBLE_EQ(40, buckets[2]);
+  ASSERT_DOUBLE_EQ(80, buckets[3]);
+  ASSERT_THROW(MetricsRegistry::GetExponentialBuckets(buckets, 0, 2, 4), OrthancException);
+  ASSERT_THROW(MetricsRegistry::GetExponentialBuckets(buckets, 10, 1, 4), OrthancException);
+
+  ASSERT_EQ(14u, MetricsRegistry::GetDefaultDurationBuckets().size());
+  ASSERT_DOUBLE_EQ(1, MetricsRegistry::GetDefaultDurationBuckets().front());
+  ASSERT_DOUBLE_EQ(60000, MetricsRegistry::GetDefaultDurationBuckets().back());
+
+  MetricsRegistry mr;
+  const std::string labels = MetricsRegistry::FormatPrometheusLabel("operation", "test");
+
+  {
+    MetricsRegistry::HistogramTimer timer(mr, "fast", labels, buckets);
+  }
+
+  {
+    MetricsRegistry::HistogramTimer timer(mr, "slow", "");
+    boost::this_thread::sleep(boost::posix_time::milliseconds(30));
+  }
+
+  std::map<std::string, std::string> values;
+  GetValuesDico(values, mr);
+  ASSERT_EQ(7u /* fast */ + 17u /* slow */, values.size());
+  ASSERT_EQ("1", values["fast_bucket{operation=\"test\",le=\"10\"}"]);
+  ASSERT_EQ("1", values["fast_bucket{operation=\"test\",le=\"+Inf\"}"]);
+  ASSERT_EQ("1", values["fast_count{operation=\"test\"}"]);
+  ASSERT_EQ("0", values["slow_bucket{le=\"25\"}"]);
+  ASSERT_EQ("1", values["slow_bucket{le=\"10000\"}"]);
+  ASSERT_EQ("1", values["slow_count"]);
+  ASSERT_LE(30, boost::lexical_cast<int>(values["slow_sum"]));
+
+  mr.SetEnabled(false);
+
+  {
+    MetricsRegistry::HistogramTimer timer(mr, "disabled", "");
+  }
+
+  mr.SetEnabled(true);
+  GetValuesDico(values, mr);
+  ASSERT_EQ(values.end(), values.find("disabled_count"));
+}
+
+
+TEST(RequestTimings, Basic)
+{
+  {
+    // No scope is installed: The timers are ignored
+    RequestTimings::Timer timer(RequestTimings::Category_Database);
+  }
+
+  RequestTimings::Scope scope;
+
+  {
+    RequestTimings::Timer timer(RequestTimings::Category_Storage);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+
+    {
+      // Nested timers are attributed to the outermost timer
+      RequestTimings::Timer nested(RequestTimings::Category_Codec);
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+  }
+
+  ASSERT_EQ(0u, scope.GetMicroseconds(RequestTimings::Category_Database));
+  ASSERT_LE(30000u, scope.GetMicroseconds(RequestTimings::Category_Storage));
+  ASSERT_EQ(0u, scope.GetMicroseconds(RequestTimings::Category_Codec));
+  ASSERT_THROW(scope.GetMicroseconds(RequestTimings::Category_Count), OrthancException);
+
+  {
+    RequestTimings::Scope inner;
+
+    {
+      RequestTimings::Timer timer(RequestTimings::Category_Codec);
+    }
+
+    // The inner scope hides the outer scope
+    ASSERT_EQ(0u, scope.GetMicroseconds(RequestTimings::Category_Codec));
+  }
+
+  {
+    RequestTimings::Timer timer(RequestTimings::Category_Database);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+  }
+
+  ASSERT_LT(0u, scope.GetMicroseconds(RequestTimings::Category_Database));
+}
+
+
+TEST(RequestTimings, Counters)
+{
+  std::string s;
+  ASSERT_EQ(NULL, RequestTimings::GetCurrentScope());
+  ASSERT_FALSE(RequestTimings::FormatCurrentServerTiming(s));
+  RequestTimings::AddToCounter(RequestTimings::Counter_DatabaseTransactions, 1);  // Ignored
+
+  RequestTimings::Scope scope;
+  ASSERT_EQ(&scope, RequestTimings::GetCurrentScope());
+  ASSERT_FALSE(scope.IsServerTimingExposed());
+  ASSERT_FALSE(RequestTimings::FormatCurrentServerTiming(s));
+
+  RequestTimings::AddToCounter(RequestTimings::Counter_DatabaseTransactions, 1);
+  RequestTimings::AddToCounter(RequestTimings::Counter_DatabaseTransactions, 2);
+  RequestTimings::AddToCounter(RequestTimings::Counter_StorageBytesRead, 1024);
+  ASSERT_THROW(RequestTimings::AddToCounter(RequestTimings::Counter_Count, 1), OrthancException);
+
+  ASSERT_EQ(3u, scope.GetCounter(RequestTimings::Counter_DatabaseTransactions));
+  ASSERT_EQ(0u, scope.GetCounter(RequestTimings::Counter_DatabaseRetries));
+  ASSERT_EQ(1024u, scope.GetCounter(RequestTimings::Counter_StorageBytesRead));
+  ASSERT_EQ(0u, scope.GetCounter(RequestTimings::Counter_StorageCacheHits));
+  ASSERT_THROW(scope.GetCounter(RequestTimings::Counter_Count), OrthancException);
+
+  scope.SetServerTimingExposed(true);
+  ASSERT_TRUE(RequestTimings::FormatCurrentServerTiming(s));
+  ASSERT_EQ("db;dur=0.0;desc=\"3 transactions, 0 retries\", storage;dur=0.0;desc=\"1024 bytes read, "
+            "0 cache hits\", codec;dur=0.0, plugins;dur=0.0", s);
+  ASSERT_EQ("database 0.0ms (3 transactions, 0 retries), storage 0.0ms (1024 bytes read, "
+            "0 cache hits), codec 0.0ms, plugins 0.0ms", scope.Format());
+
+  Json::Value json;
+  scope.Format(json);
+  ASSERT_EQ(8u, json.size());
+  ASSERT_EQ(3u, json["DatabaseTransactions"].asUInt());
+  ASSERT_EQ(1024u, json["StorageBytesRead"].asUInt());
+  ASSERT_DOUBLE_EQ(0.0, json["PluginsMs"].asDouble());
+
+  {
+    RequestTimings::Scope inner;
+    ASSERT_FALSE(RequestTimings::FormatCurrentServerTiming(s));
+    RequestTimings::AddToCounter(RequestTimings::Counter_StorageCacheHits, 1);
+    ASSERT_EQ(1u, inner.GetCounter(RequestTimings::Counter_StorageCacheHits));
+  }
+
+  ASSERT_EQ(0u, scope.GetCounter(RequestTimings::Counter_StorageCacheHits));
+}
+#endif
+
+
+#if ORTHANC_SANDBOXED != 1
+TEST(Tracing, Traceparent)
+{
+  std::string traceId, parentId;
+  bool sampled;
+
+  ASSERT_TRUE(Tracing::ParseTraceparent(traceId, parentId, sampled, "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01"));
+  ASSERT_EQ("4bf92f3577b34da6a3ce929d0e0e4736", traceId);
+  ASSERT_EQ("00f067aa0ba902b7", parentId);
+  ASSERT_TRUE(sampled);
+
+  ASSERT_TRUE(Tracing::ParseTraceparent(traceId, parentId, sampled, "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-02"));
+  ASSERT_FALSE(sampled);
+
+  // Future versions can append fields
+  ASSERT_TRUE(Tracing::ParseTraceparent(traceId, parentId, sampled, "01-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-03-hello"));
+  ASSERT_TRUE(sampled);
+
+  ASSERT_FALSE(Tracing::ParseTraceparent(traceId, parentId, sampled, ""));
+  ASSERT_FALSE(Tracing::ParseTraceparent(traceId, parentId, sampled, "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01-hello"));
+  ASSERT_FALSE(Tracing::ParseTraceparent(traceId, parentId, sampled, "ff-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01"));
+  ASSERT_FALSE(Tracing::ParseTraceparent(traceId, parentId, sampled, "00-4BF92F3577B34DA6A3CE929D0E0E4736-00f067aa0ba902b7-01"));
+  ASSERT_FALSE(Tracing::ParseTraceparent(traceId, parentId, sampled, "00-00000000000000000000000000000000-00f067aa0ba902b7-01"));
+  ASSERT_FALSE(Tracing::ParseTraceparent(traceId, parentId, sampled, "00-4bf92f3577b34da6a3ce929d0e0e4736-0000000000000000-01"));
+  ASSERT_FALSE(Tracing::ParseTraceparent(traceId, parentId, sampled, "00-4bf92f3577b34da6a3ce929d0e0e4736_00f067aa0ba902b7-01"));
+
+  ASSERT_EQ("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01",
+            Tracing::FormatTraceparent("4bf92f3577b34da6a3ce929d0e0e4736", "00f067aa0ba902b7", true));
+  ASSERT_EQ("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00",
+            Tracing::FormatTraceparent("4bf92f3577b34da6a3ce929d0e0e4736", "00f067aa0ba902b7", false));
+  ASSERT_THROW(Tracing::FormatTraceparent("4bf9", "00f067aa0ba902b7", true), OrthancException);
+}
+
+
+namespace
+{
+  class MemorySpanExporter : public Tracing::ISpanExporter
+  {
+  private:
+    Json::Value&  spans_;
+
+  public:
+    explicit MemorySpanExporter(Json::Value& spans) :
+      spans_(spans)
+    {
+    }
+
+    virtual void Export(const std::string& serviceName,
+                        const std::vector<const Tracing::SpanRecord*>& spans) ORTHANC_OVERRIDE
+    {
+      for (size_t i = 0; i < spans.size(); i++)
+      {
+        Json::Value span;
+        spans[i]->Format(span);
+        span["service"] = serviceName;
+        spans_.append(span);
+      }
+    }
+  };
+}
+
+
+TEST(Tracing, Spans)
+{
+  ASSERT_FALSE(Tracing::IsEnabled());
+
+  {
+    // Tracing is disabled
+    Tracing::Span span("nope", Tracing::SpanKind_Server);
+    ASSERT_FALSE(span.IsRecording());
+  }
+
+  Json::Value spans = Json::arrayValue;
+  Tracing::Initialize(new MemorySpanExporter(spans), "test", 1.0);
+  ASSERT_TRUE(Tracing::IsEnabled());
+  ASSERT_THROW(Tracing::Initialize(new MemorySpanExporter(spans), "test", 1.0), OrthancException);
+
+  std::string s, traceparent;
+
+  {
+    // Only the server spans can start a new trace
+    Tracing::Span span("internal", Tracing::SpanKind_Internal);
+    ASSERT_FALSE(span.IsRecording());
+    ASSERT_FALSE(Tracing::GetCurrentTraceparent(s));
+  }
+
+  {
+    Tracing::Span root("root", Tracing::SpanKind_Server);
+    ASSERT_TRUE(root.IsRecording());
+    ASSERT_TRUE(root.FormatTraceparent(traceparent));
+    ASSERT_TRUE(Tracing::GetCurrentTraceparent(s));
+    ASSERT_EQ(traceparent, s);
+    root.SetAttribute("hello", "world");
+
+    {
+      Tracing::Span child("child", Tracing::SpanKind_Client);
+      ASSERT_TRUE(child.IsRecording());
+      ASSERT_TRUE(Tracing::GetCurrentTraceparent(s));
+      ASSERT_NE(traceparent, s);
+      child.SetAttribute("answer", static_cast<int64_t>(42));
+      child.SetError("failure");
+    }
+
+    ASSERT_TRUE(Tracing::GetCurrentTraceparent(s));
+    ASSERT_EQ(traceparent, s);
+  }
+
+  ASSERT_FALSE(Tracing::GetCurrentTraceparent(s));
+
+  {
+    // Remote parent, sampled
+    Tracing::Span span("remote", Tracing::SpanKind_Server, "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01");
+    ASSERT_TRUE(span.IsRecording());
+  }
+
+  {
+    // Remote parent, not sampled
+    Tracing::Span span("unsampled", Tracing::SpanKind_Server, "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00");
+    ASSERT_FALSE(span.IsRecording());
+
+    Tracing::Span child("child", Tracing::SpanKind_Internal);
+    ASSERT_FALSE(child.IsRecording());
+  }
+
+  Tracing::Finalize();  // Exports the pending spans
+  ASSERT_FALSE(Tracing::IsEnabled());
+
+  ASSERT_EQ(3u, spans.size());
+
+  // The children are finished before their parents
+  const Json::Value& child = spans[0];
+  const Json::Value& root = spans[1];
+  const Json::Value& remote = spans[2];
+
+  ASSERT_EQ("child", child["name"].asString());
+  ASSERT_EQ(3, child["kind"].asInt());
+  ASSERT_EQ(root["traceId"].asString(), child["traceId"].asString());
+  ASSERT_EQ(root["spanId"].asString(), child["parentSpanId"].asString());
+  ASSERT_EQ(2, child["status"]["code"].asInt());
+  ASSERT_EQ("failure", child["status"]["message"].asString());
+  ASSERT_EQ(1u, child["attributes"].size());
+  ASSERT_EQ("answer", child["attributes"][0]["key"].asString());
+  ASSERT_EQ("42", child["attributes"][0]["value"]["stringValue"].asString());
+
+  ASSERT_EQ("root", root["name"].asString());
+  ASSERT_EQ(2, root["kind"].asInt());
+  ASSERT_EQ("test", root["service"].asString());
+  ASSERT_FALSE(root.isMember("parentSpanId"));
+  ASSERT_FALSE(root.isMember("status"));
+  ASSERT_EQ(32u, root["traceId"].asString().size());
+  ASSERT_EQ(16u, root["spanId"].asString().size());
+  ASSERT_EQ(traceparent, Tracing::FormatTraceparent(root["traceId"].asString(), root["spanId"].asString(), true));
+  ASSERT_LE(boost::lexical_cast<uint64_t>(root["startTimeUnixNano"].asString()),
+            boost::lexical_cast<uint64_t>(child["startTimeUnixNano"].asString()));
+  ASSERT_GE(boost::lexical_cast<uint64_t>(root["endTimeUnixNano"].asString()),
+            boost::lexical_cast<uint64_t>(child["endTimeUnixNano"].asString()));
+
+  ASSERT_EQ("4bf92f3577b34da6a3ce929d0e0e4736", remote["traceId"].asString());
+  ASSERT_EQ("00f067aa0ba902b7", remote["parentSpanId"].asString());
+
+  {
+    // Sampling ratio of zero
+    Tracing::Initialize(new MemorySpanExporter(spans), "test", 0.0);
+    Tracing::Span span("root", Tracing::SpanKind_Server);
+    ASSERT_FALSE(span.IsRecording());
+  }
+
+  Tracing::Finalize();
+  ASSERT_EQ(3u, spans.size());
+}
+
+
+namespace
+{
+  class BusyThread : public boost::noncopyable
+  {
+  private:
+    volatile bool  done_;
+    boost::thread  thread_;
+
+    static void Worker(BusyThread* that)
+    {
+      Logging::ScopedCurrentThreadNameSetter setter("PROFILED");
+
+      volatile uint64_t value = 0;
+      while (!that->done_)
+      {
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+      }
+    }
+
+  public:
+    BusyThread() :
+      done_(false)
+    {
+      thread_ = boost::thread(Worker, this);
+    }
+
+    ~BusyThread()
+    {
+      done_ = true;
+      thread_.join();
+    }
+  };
+}
+
+
+TEST(CpuProfiler, Profile)
+{
+  std::string profile;
+
+  if (CpuProfiler::IsAvailable())
+  {
+    ASSERT_THROW(CpuProfiler::Profile(profile, 0, 100), OrthancException);
+    ASSERT_THROW(CpuProfiler::Profile(profile, 1, 0), OrthancException);
+    ASSERT_THROW(CpuProfiler::Profile(profile, CpuProfiler::MAX_DURATION + 1, 100), OrthancException);
+
+    {
+      BusyThread busy;
+      CpuProfiler::Profile(profile, 1, 100);
+    }
+
+    // Collapsed stacks: One "thread;frames... count" line per stack
+    ASSERT_FALSE(profile.empty());
+    ASSERT_EQ('\n', profile[profile.size() - 1]);
+    ASSERT_NE(std::string::npos, profile.find("PROFILED;"));
+  }
+  else
+  {
+    ASSERT_THROW(CpuProfiler::Profile(profile, 1, 100), OrthancException);
+  }
+}
 #endif
 
 
@@ -1759,6 +2374,56 @@ TEST(Toolbox, GetMacAddressess)
     printf("MAC address: [%s]\n", it->c_str());
   }
 }
+
+
+#if defined(__linux__)
+static void PinToFirstCpu(bool* success)
+{
+  std::set<unsigned int> cpus;
+  cpus.insert(0);
+
+  unsigned int cpu;
+  *success = (SystemToolbox::SetCurrentThreadAffinity(cpus) &&
+              (!SystemToolbox::GetCurrentCpu(cpu) || cpu == 0));
+}
+#endif
+
+
+TEST(Toolbox, CpuAffinity)
+{
+  std::set<unsigned int> cpus;
+  SystemToolbox::ParseCpuList(cpus, "3");
+  ASSERT_EQ(1u, cpus.size());
+  ASSERT_EQ(1u, cpus.count(3));
+
+  SystemToolbox::ParseCpuList(cpus, " 0-2, 8 ,5-5");
+  ASSERT_EQ(5u, cpus.size());
+  ASSERT_EQ(1u, cpus.count(0));
+  ASSERT_EQ(1u, cpus.count(1));
+  ASSERT_EQ(1u, cpus.count(2));
+  ASSERT_EQ(1u, cpus.count(5));
+  ASSERT_EQ(1u, cpus.count(8));
+
+  ASSERT_THROW(SystemToolbox::ParseCpuList(cpus, ""), OrthancException);
+  ASSERT_THROW(SystemToolbox::ParseCpuList(cpus, "a"), OrthancException);
+  ASSERT_THROW(SystemToolbox::ParseCpuList(cpus, "3-1"), OrthancException);
+  ASSERT_THROW(SystemToolbox::ParseCpuList(cpus, "1,,2"), OrthancException);
+  ASSERT_THROW(SystemToolbox::ParseCpuList(cpus, "-1"), OrthancException);
+
+  cpus.clear();
+  ASSERT_THROW(SystemToolbox::SetCurrentThreadAffinity(cpus), OrthancException);
+
+  std::vector<std::set<unsigned int> > nodes;
+  SystemToolbox::GetNumaNodes(nodes);
+
+#if defined(__linux__)
+  // Pin another thread, not to constrain the threads of the next tests
+  bool success = false;
+  boost::thread pinned(PinToFirstCpu, &success);
+  pinned.join();
+  ASSERT_TRUE(success);
+#endif
+}
 #endif
 
 
@@ -81,6 +81,7 @@
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 
 #if ORTHANC_ENABLE_PUGIXML == 1
 #  include <pugixml.hpp>
@@ -186,6 +187,143 @@ TEST(DicomModification, Anonymization)
 }
 
 
+static void ApplyConcurrentModification(DicomModification* modification,
+                                        std::string* studyUid)
+{
+  std::unique_ptr<ParsedDicomFile> dicom(new ParsedDicomFile(true));
+  dicom->ReplacePlainString(DICOM_TAG_STUDY_INSTANCE_UID, "1.2.3.4");
+  modification->Apply(dicom);
+
+  if (!dicom->GetTagValue(*studyUid, DICOM_TAG_STUDY_INSTANCE_UID))
+  {
+    studyUid->clear();
+  }
+}
+
+
+TEST(DicomModification, ConcurrentApply)
+{
+  DicomModification m;
+  m.SetupAnonymization(DicomVersion_2008);
+  ASSERT_TRUE(m.IsApplyThreadSafe());
+
+  static const size_t COUNT = 8;
+  std::vector<std::string> studyUids(COUNT);
+
+  std::vector<boost::thread*> threads(COUNT);
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    threads[i] = new boost::thread(ApplyConcurrentModification, &m, &studyUids[i]);
+  }
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  // All the threads must map the source study to the same new UID
+  ASSERT_FALSE(studyUids[0].empty());
+  ASSERT_NE("1.2.3.4", studyUids[0]);
+
+  for (size_t i = 1; i < COUNT; i++)
+  {
+    ASSERT_EQ(studyUids[0], studyUids[i]);
+  }
+}
+
+
+TEST(DicomModification, SinglePass)
+{
+  const DicomTag privateTag(0x0045, 0x1010);
+  const DicomTag privateTag2(0x0031, 0x1020);
+
+  ParsedDicomFile source(true);
+  source.ReplacePlainString(DICOM_TAG_PATIENT_NAME, "name");
+  source.ReplacePlainString(DICOM_TAG_ACCESSION_NUMBER, "accession");
+  source.ReplacePlainString(DICOM_TAG_INSTITUTION_NAME, "institution");
+  source.ReplacePlainString(DICOM_TAG_STUDY_DESCRIPTION, "description");
+  source.Insert(privateTag, "private", false, "OrthancCreator");
+  source.Insert(privateTag2, "private2", false, "OrthancCreator");
+
+  std::set<DicomTag> removals;
+  removals.insert(DICOM_TAG_ACCESSION_NUMBER);
+  removals.insert(DICOM_TAG_SERIES_DESCRIPTION);  // Absent from the source
+  removals.insert(DICOM_TAG_INSTITUTION_NAME);
+
+  std::set<DicomTag> clearings;
+  clearings.insert(DICOM_TAG_STUDY_DESCRIPTION);
+  clearings.insert(DICOM_TAG_REFERRING_PHYSICIAN_NAME);  // Absent from the source
+  clearings.insert(privateTag);
+
+  std::set<DicomTag> privateTagsToKeep;
+  privateTagsToKeep.insert(privateTag2);
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    const bool removePrivateTags = (i == 0);
+
+    // Reference: One lookup in the dataset per rule
+    std::unique_ptr<ParsedDicomFile> expected(source.Clone(true));
+    if (removePrivateTags)
+    {
+      expected->RemovePrivateTags(privateTagsToKeep);
+    }
+
+    for (std::set<DicomTag>::const_iterator it = clearings.begin(); it != clearings.end(); ++it)
+    {
+      expected->Clear(*it, true);
+    }
+
+    for (std::set<DicomTag>::const_iterator it = removals.begin(); it != removals.end(); ++it)
+    {
+      expected->Remove(*it);
+    }
+
+    std::unique_ptr<ParsedDicomFile> actual(source.Clone(true));
+    actual->RemoveAndClearTags(std::vector<DicomTag>(removals.begin(), removals.end()),
+                               std::vector<DicomTag>(clearings.begin(), clearings.end()),
+                               removePrivateTags, privateTagsToKeep);
+
+    Json::Value a, b;
+    expected->DatasetToJson(a, DicomToJsonFormat_Full, DicomToJsonFlags_Default, 0);
+    actual->DatasetToJson(b, DicomToJsonFormat_Full, DicomToJsonFlags_Default, 0);
+    ASSERT_EQ(a.toStyledString(), b.toStyledString());
+
+    std::string s;
+    ASSERT_TRUE(actual->GetTagValue(s, DICOM_TAG_PATIENT_NAME));
+    ASSERT_EQ("name", s);
+    ASSERT_FALSE(actual->GetTagValue(s, DICOM_TAG_ACCESSION_NUMBER));
+    ASSERT_FALSE(actual->GetTagValue(s, DICOM_TAG_INSTITUTION_NAME));
+    ASSERT_FALSE(actual->GetTagValue(s, DICOM_TAG_REFERRING_PHYSICIAN_NAME));
+    ASSERT_TRUE(actual->GetTagValue(s, DICOM_TAG_STUDY_DESCRIPTION));
+    ASSERT_TRUE(s.empty());
+    ASSERT_TRUE(actual->GetTagValue(s, privateTag2));
+    ASSERT_EQ("private2", s);
+    ASSERT_EQ(!removePrivateTags, actual->GetTagValue(s, privateTag));
+  }
+
+  // The compiled plan must be updated if the modification changes
+  DicomModification m;
+  m.SetupAnonymization(DicomVersion_2023b);
+
+  std::unique_ptr<ParsedDicomFile> dicom(source.Clone(true));
+  m.Apply(dicom);
+
+  std::string s;
+  ASSERT_TRUE(dicom->GetTagValue(s, DICOM_TAG_ACCESSION_NUMBER));  // Cleared by the profile
+  ASSERT_TRUE(s.empty());
+  ASSERT_FALSE(dicom->GetTagValue(s, DICOM_TAG_INSTITUTION_NAME));
+  ASSERT_FALSE(dicom->GetTagValue(s, privateTag));
+
+  m.Keep(DICOM_TAG_INSTITUTION_NAME);
+  dicom.reset(source.Clone(true));
+  m.Apply(dicom);
+  ASSERT_TRUE(dicom->GetTagValue(s, DICOM_TAG_INSTITUTION_NAME));
+  ASSERT_EQ("institution", s);
+}
+
+
 #include <dcmtk/dcmdata/dcuid.h>
 
 TEST(DicomModification, Png)
@@ -757,6 +895,62 @@ TEST(ParsedDicomFile, ToJsonFlags3)
 }
 
 
+TEST(ParsedDicomFile, Whitelist)
+{
+  ParsedDicomFile f(true);
+  f.ReplacePlainString(DICOM_TAG_PATIENT_NAME, "HELLO");
+  f.ReplacePlainString(DICOM_TAG_STUDY_DESCRIPTION, std::string(1000, 'a'));
+  f.Replace(DICOM_TAG_REFERENCED_IMAGE_SEQUENCE, Json::Value(Json::arrayValue), false,
+            DicomReplaceMode_InsertIfAbsent, "");
+
+  {
+    Json::Value item = Json::objectValue;
+    item["ReferencedSOPInstanceUID"] = "1.2.3";
+    Json::Value sequence = Json::arrayValue;
+    sequence.append(item);
+    f.Replace(DICOM_TAG_SOURCE_IMAGE_SEQUENCE, sequence, false, DicomReplaceMode_InsertIfAbsent, "");
+  }
+
+  std::set<DicomTag> whitelist;
+  whitelist.insert(DICOM_TAG_PATIENT_NAME);
+  whitelist.insert(DICOM_TAG_STUDY_DESCRIPTION);
+  whitelist.insert(DICOM_TAG_SOURCE_IMAGE_SEQUENCE);
+  whitelist.insert(DICOM_TAG_ACCESSION_NUMBER);  // Absent from the file
+
+  std::set<DicomTag> ignoreTagLength;
+
+  {
+    DicomMap full, summary;
+    f.ExtractDicomSummary(full, 256);
+    f.ExtractDicomSummary(summary, 256, ignoreTagLength, whitelist);
+
+    ASSERT_EQ(3u, summary.GetSize());
+    ASSERT_EQ("HELLO", summary.GetStringValue(DICOM_TAG_PATIENT_NAME, "", false));
+    ASSERT_TRUE(summary.GetValue(DICOM_TAG_STUDY_DESCRIPTION).IsNull());  // Too long
+    ASSERT_TRUE(summary.GetValue(DICOM_TAG_SOURCE_IMAGE_SEQUENCE).IsSequence());
+    ASSERT_EQ(full.GetValue(DICOM_TAG_SOURCE_IMAGE_SEQUENCE).GetSequenceContent().toStyledString(),
+              summary.GetValue(DICOM_TAG_SOURCE_IMAGE_SEQUENCE).GetSequenceContent().toStyledString());
+    ASSERT_FALSE(summary.HasTag(DICOM_TAG_SOP_INSTANCE_UID));
+    ASSERT_FALSE(summary.HasTag(DICOM_TAG_REFERENCED_IMAGE_SEQUENCE));
+  }
+
+  {
+    Json::Value full, v;
+    f.DatasetToJson(full, DicomToJsonFormat_Full, DicomToJsonFlags_Default, 256, whitelist /* ignoreTagLength */);
+    f.DatasetToJson(v, DicomToJsonFormat_Full, DicomToJsonFlags_Default, 256, whitelist /* ignoreTagLength */, whitelist);
+
+    ASSERT_EQ(Json::objectValue, v.type());
+    ASSERT_EQ(3u, v.size());
+    ASSERT_EQ(full["0010,0010"].toStyledString(), v["0010,0010"].toStyledString());
+    ASSERT_EQ(full["0008,1030"].toStyledString(), v["0008,1030"].toStyledString());
+    ASSERT_EQ(full["0008,2112"].toStyledString(), v["0008,2112"].toStyledString());
+    ASSERT_EQ(std::string(1000, 'a'), v["0008,1030"]["Value"].asString());  // Not truncated
+    ASSERT_FALSE(v.isMember("0008,0018"));
+    ASSERT_FALSE(v.isMember("0008,1140"));
+  }
+}
+
+
 TEST(DicomFindAnswers, Basic)
 {
   DicomFindAnswers a(false);
@@ -940,6 +1134,20 @@ TEST(TestImages, PatternGrayscale8)
       const void* b = decoded->GetConstRow(y);
       ASSERT_EQ(0, memcmp(a, b, 256));
     }
+
+    // The raw frame is directly accessible, without copy
+    std::string raw;
+    MimeType mime;
+    f.GetRawFrame(raw, mime, 0);
+    ASSERT_EQ(256u * 256u, raw.size());
+
+    const void* buffer = NULL;
+    size_t size = 0;
+    ASSERT_TRUE(f.LookupRawFrameBuffer(buffer, size, mime, 0));
+    ASSERT_EQ(MimeType_Binary, mime);
+    ASSERT_EQ(raw.size(), size);
+    ASSERT_EQ(0, memcmp(raw.c_str(), buffer, size));
+    ASSERT_THROW(f.LookupRawFrameBuffer(buffer, size, mime, 1), OrthancException);
   }
 }
 
@@ -2427,6 +2635,91 @@ TEST(ParsedDicomCache, Basic)
   ASSERT_FALSE(ParsedDicomCache::Accessor(cache, "e").IsValid());
 }
 
+TEST(ParsedDicomCache, Revisions)
+{
+  ParsedDicomCache cache(10);
+
+  DicomMap tags;
+  tags.SetValue(DICOM_TAG_PATIENT_ID, "patient1", false);
+  cache.Acquire("a", new ParsedDicomFile(tags, Encoding_Latin1, true), 5, "rev1");
+  ASSERT_EQ(5u, cache.GetCurrentSize());
+
+  ASSERT_TRUE(ParsedDicomCache::Accessor(cache, "a").IsValid());
+  ASSERT_TRUE(ParsedDicomCache::Accessor(cache, "a", "rev1").IsValid());
+
+  // Same revision: The old value is kept
+  tags.SetValue(DICOM_TAG_PATIENT_ID, "ignored", false);
+  cache.Acquire("a", new ParsedDicomFile(tags, Encoding_Latin1, true), 3, "rev1");
+  ASSERT_EQ(5u, cache.GetCurrentSize());
+
+  // Another revision: The old value is replaced
+  tags.SetValue(DICOM_TAG_PATIENT_ID, "patient2", false);
+  cache.Acquire("a", new ParsedDicomFile(tags, Encoding_Latin1, true), 4, "rev2");
+  ASSERT_EQ(4u, cache.GetCurrentSize());
+  ASSERT_EQ(1u, cache.GetNumberOfItems());
+
+  {
+    ParsedDicomCache::Accessor accessor(cache, "a", "rev2");
+    ASSERT_TRUE(accessor.IsValid());
+    std::string s;
+    ASSERT_TRUE(accessor.GetDicom().GetTagValue(s, DICOM_TAG_PATIENT_ID));
+    ASSERT_EQ("patient2", s);
+  }
+
+  // An outdated entry is dropped on access
+  ASSERT_FALSE(ParsedDicomCache::Accessor(cache, "a", "rev3").IsValid());
+  ASSERT_EQ(0u, cache.GetCurrentSize());
+  ASSERT_EQ(0u, cache.GetNumberOfItems());
+  ASSERT_FALSE(ParsedDicomCache::Accessor(cache, "a").IsValid());
+}
+
+TEST(ParsedDicomCache, Accessors)
+{
+  ParsedDicomCache cache(10);
+
+  DicomMap tags;
+  tags.SetValue(DICOM_TAG_PATIENT_ID, "patient1", false);
+  cache.Acquire("a", new ParsedDicomFile(tags, Encoding_Latin1, true), 5);
+  tags.SetValue(DICOM_TAG_PATIENT_ID, "patient2", false);
+  cache.Acquire("b", new ParsedDicomFile(tags, Encoding_Latin1, true), 5);
+
+  {
+    // Accessors to different items do not block each other
+    ParsedDicomCache::Accessor a(cache, "a");
+    ParsedDicomCache::Accessor b(cache, "b");
+    ASSERT_TRUE(a.IsValid());
+    ASSERT_TRUE(b.IsValid());
+
+    // The items remain alive as long as an accessor uses them
+    cache.Invalidate("a");
+    cache.Acquire("c", new ParsedDicomFile(true), 15);
+    ASSERT_EQ(15u, cache.GetCurrentSize());
+    ASSERT_EQ(1u, cache.GetNumberOfItems());
+    ASSERT_FALSE(ParsedDicomCache::Accessor(cache, "a").IsValid());
+    ASSERT_FALSE(ParsedDicomCache::Accessor(cache, "b").IsValid());
+
+    std::string s;
+    ASSERT_TRUE(a.GetDicom().GetTagValue(s, DICOM_TAG_PATIENT_ID));
+    ASSERT_EQ("patient1", s);
+    ASSERT_EQ(5u, a.GetFileSize());
+    ASSERT_TRUE(b.GetDicom().GetTagValue(s, DICOM_TAG_PATIENT_ID));
+    ASSERT_EQ("patient2", s);
+  }
+
+  ASSERT_TRUE(ParsedDicomCache::Accessor(cache, "c").IsValid());
+
+  CacheStatistics statistics;
+  cache.GetStatistics(statistics);
+  ASSERT_EQ(3u, statistics.GetHits());
+  ASSERT_EQ(2u, statistics.GetMisses());
+  ASSERT_EQ(1u, statistics.GetEvictions());
+
+  ASSERT_THROW(cache.SetMaximumSize(0), OrthancException);
+  cache.SetMaximumSize(5);
+  ASSERT_EQ(5u, cache.GetMaximumSize());
+  ASSERT_EQ(0u, cache.GetNumberOfItems());
+}
+
 
 static bool MyIsMatch(const DicomPath& a,
                       const DicomPath& b)
@@ -4159,4 +4452,313 @@ TEST(Toto, DISABLED_Transcode4)
   }
 }
 
+
+
+TEST(DcmtkTranscoder, FramesTranscodingThreads)
+{
+  static const unsigned int WIDTH = 17;
+  static const unsigned int HEIGHT = 11;
+  static const unsigned int FRAMES = 7;
+
+  std::string pixels(WIDTH * HEIGHT * FRAMES, '\0');
+  for (size_t i = 0; i < pixels.size(); i++)
+  {
+    pixels[i] = static_cast<char>((i * 7) % 251);
+  }
+
+  std::unique_ptr<DcmFileFormat> source;
+
+  {
+    ParsedDicomFile dicom(true);
+    DcmDataset& dataset = *dicom.GetDcmtkObject().getDataset();
+    ASSERT_TRUE(dataset.putAndInsertUint16(DCM_Rows, HEIGHT).good());
+    ASSERT_TRUE(dataset.putAndInsertUint16(DCM_Columns, WIDTH).good());
+    ASSERT_TRUE(dataset.putAndInsertUint16(DCM_SamplesPerPixel, 1).good());
+    ASSERT_TRUE(dataset.putAndInsertUint16(DCM_BitsAllocated, 8).good());
+    ASSERT_TRUE(dataset.putAndInsertUint16(DCM_BitsStored, 8).good());
+    ASSERT_TRUE(dataset.putAndInsertUint16(DCM_HighBit, 7).good());
+    ASSERT_TRUE(dataset.putAndInsertUint16(DCM_PixelRepresentation, 0).good());
+    ASSERT_TRUE(dataset.putAndInsertString(DCM_PhotometricInterpretation, "MONOCHROME2").good());
+    ASSERT_TRUE(dataset.putAndInsertString(DCM_NumberOfFrames, boost::lexical_cast<std::string>(FRAMES).c_str()).good());
+    ASSERT_TRUE(dataset.putAndInsertUint8Array(DCM_PixelData, reinterpret_cast<const Uint8*>(pixels.c_str()), pixels.size()).good());
+    source.reset(dynamic_cast<DcmFileFormat*>(dicom.GetDcmtkObject().clone()));
+  }
+
+  DcmtkTranscoder sequential(1);
+  ASSERT_EQ(1u, sequential.GetFramesTranscodingThreads());
+
+  DcmtkTranscoder parallel(1);
+  ASSERT_THROW(parallel.SetFramesTranscodingThreads(0), OrthancException);
+  parallel.SetFramesTranscodingThreads(3);
+  ASSERT_EQ(3u, parallel.GetFramesTranscodingThreads());
+  ASSERT_THROW(parallel.SetFramesTranscodingThreads(2), OrthancException);
+
+  std::set<DicomTransferSyntax> syntaxes;
+  syntaxes.insert(DicomTransferSyntax_JPEGProcess14SV1);
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    IDicomTranscoder::DicomImage a, b;
+    a.AcquireParsed(dynamic_cast<DcmFileFormat*>(source->clone()));
+
+    DcmtkTranscoder& transcoder = (i == 0 ? sequential : parallel);
+    ASSERT_TRUE(transcoder.Transcode(b, a, syntaxes, TranscodingSopInstanceUidMode_NoChange));
+
+    DicomTransferSyntax syntax;
+    ASSERT_TRUE(FromDcmtkBridge::LookupOrthancTransferSyntax(syntax, b.GetParsed()));
+    ASSERT_EQ(DicomTransferSyntax_JPEGProcess14SV1, syntax);
+
+    // The parallel encoding must produce the same lossless frames, in the same order
+    ParsedDicomFile transcoded(b.GetParsed());
+    ASSERT_EQ(FRAMES, transcoded.GetFramesCount());
+
+    for (unsigned int frame = 0; frame < FRAMES; frame++)
+    {
+      std::unique_ptr<ImageAccessor> decoded(transcoded.DecodeFrame(frame));
+      ASSERT_EQ(PixelFormat_Grayscale8, decoded->GetFormat());
+      ASSERT_EQ(WIDTH, decoded->GetWidth());
+      ASSERT_EQ(HEIGHT, decoded->GetHeight());
+
+      for (unsigned int y = 0; y < HEIGHT; y++)
+      {
+        ASSERT_EQ(0, memcmp(decoded->GetConstRow(y), pixels.c_str() + (frame * HEIGHT + y) * WIDTH, WIDTH));
+      }
+    }
+  }
+}
+
+
+TEST(DcmtkTranscoder, TranscodeBatch)
+{
+  static const size_t COUNT = 3;
+
+  std::vector<boost::shared_ptr<IDicomTranscoder::DicomImage> > images;
+  std::vector<IDicomTranscoder::DicomImage*> sources, targets;
+  std::vector<std::string> sopInstanceUids;
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    ParsedDicomFile dicom(true);
+    dicom.ReplacePlainString(DICOM_TAG_PATIENT_ID, "PATIENT" + boost::lexical_cast<std::string>(i));
+
+    std::string uid;
+    ASSERT_TRUE(dicom.GetTagValue(uid, DICOM_TAG_SOP_INSTANCE_UID));
+    sopInstanceUids.push_back(uid);
+
+    boost::shared_ptr<IDicomTranscoder::DicomImage> source(new IDicomTranscoder::DicomImage);
+    source->AcquireParsed(dynamic_cast<DcmFileFormat*>(dicom.GetDcmtkObject().clone()));
+    images.push_back(source);
+    sources.push_back(source.get());
+
+    boost::shared_ptr<IDicomTranscoder::DicomImage> target(new IDicomTranscoder::DicomImage);
+    images.push_back(target);
+    targets.push_back(target.get());
+  }
+
+  std::set<DicomTransferSyntax> syntaxes;
+  syntaxes.insert(DicomTransferSyntax_BigEndianExplicit);
+
+  DcmtkTranscoder transcoder(1);
+
+  std::vector<bool> success;
+  transcoder.TranscodeBatch(success, targets, sources, syntaxes, TranscodingSopInstanceUidMode_NoChange, 90);
+  ASSERT_EQ(COUNT, success.size());
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    ASSERT_TRUE(success[i]);
+
+    DicomTransferSyntax syntax;
+    ASSERT_TRUE(FromDcmtkBridge::LookupOrthancTransferSyntax(syntax, targets[i]->GetParsed()));
+    ASSERT_EQ(DicomTransferSyntax_BigEndianExplicit, syntax);
+    ASSERT_EQ(sopInstanceUids[i], IDicomTranscoder::GetSopInstanceUid(targets[i]->GetParsed()));
+  }
+
+  targets.pop_back();
+  ASSERT_THROW(transcoder.TranscodeBatch(success, targets, sources, syntaxes,
+                                         TranscodingSopInstanceUidMode_NoChange, 90), OrthancException);
+}
+
+#endif
+
+
+#if ORTHANC_ENABLE_DCMTK_NETWORKING == 1
+
+#include "../Sources/DicomNetworking/DicomStoreConnectionPool.h"
+
+TEST(DicomStoreConnectionPool, Basic)
+{
+  DicomStoreConnectionPool pool;
+  ASSERT_EQ(0u, pool.GetMaxIdlePerModality());
+  ASSERT_EQ(10000u, pool.GetIdleTimeout());
+  pool.SetMaxIdlePerModality(2);
+  pool.SetIdleTimeout(500);
+  ASSERT_EQ(2u, pool.GetMaxIdlePerModality());
+  ASSERT_EQ(500u, pool.GetIdleTimeout());
+
+  RemoteModalityParameters remote("REMOTE", "localhost", 104, ModalityManufacturer_Generic);
+  DicomAssociationParameters parameters("ORTHANC", remote);
+
+  std::unique_ptr<DicomStoreUserConnection> connection(pool.Acquire(parameters));
+  ASSERT_TRUE(connection.get() != NULL);
+  ASSERT_FALSE(connection->IsOpen());
+  ASSERT_EQ("REMOTE", connection->GetParameters().GetRemoteModality().GetApplicationEntityTitle());
+
+  // An association that was never negotiated is not worth keeping
+  pool.Release(connection.release());
+  ASSERT_EQ(0u, pool.GetIdleCount());
+
+  ASSERT_THROW(pool.Release(NULL), OrthancException);
+
+  {
+    DicomStoreConnectionPool::Accessor accessor(pool, parameters);
+    ASSERT_FALSE(accessor.GetConnection().IsOpen());
+    accessor.SetSuccess();
+  }
+
+  ASSERT_EQ(0u, pool.GetIdleCount());
+}
+
+
+
+#include "../Sources/DicomNetworking/DicomAssociationQuotas.h"
+
+TEST(DicomAssociationQuotas, Basic)
+{
+  DicomAssociationQuotas quotas;
+  quotas.SetDefaultClass(3, 2);
+
+  std::set<std::string> aets, hosts;
+  aets.insert("ER");
+  hosts.insert("10.0.0.1");
+  quotas.AddClass("emergency", 1, 0, aets, hosts);
+
+  ASSERT_THROW(quotas.AddClass("emergency", 1, 0, aets, hosts), OrthancException);
+  ASSERT_THROW(quotas.AddClass("default", 1, 0, aets, hosts), OrthancException);
+  ASSERT_THROW(quotas.AddClass("bad-name", 1, 0, aets, hosts), OrthancException);
+  ASSERT_THROW(quotas.GetActiveAssociations("nope"), OrthancException);
+
+  {
+    std::unique_ptr<DicomAssociationQuotas::Slot> a(quotas.Acquire("MODALITY", "10.0.0.2"));
+    std::unique_ptr<DicomAssociationQuotas::Slot> b(quotas.Acquire("MODALITY", "10.0.0.2"));
+    ASSERT_TRUE(a.get() != NULL);
+    ASSERT_TRUE(b.get() != NULL);
+    ASSERT_EQ("default", a->GetClassName());
+
+    // Per-AET limit of the default class
+    ASSERT_TRUE(quotas.Acquire("MODALITY", "10.0.0.2") == NULL);
+    ASSERT_EQ(1u, quotas.GetRejectedAssociations("default"));
+
+    // Global limit of the default class
+    std::unique_ptr<DicomAssociationQuotas::Slot> c(quotas.Acquire("OTHER", "10.0.0.3"));
+    ASSERT_TRUE(c.get() != NULL);
+    ASSERT_TRUE(quotas.Acquire("THIRD", "10.0.0.4") == NULL);
+    ASSERT_EQ(3u, quotas.GetActiveAssociations("default"));
+
+    // The emergency class is not affected by the saturated default class
+    std::unique_ptr<DicomAssociationQuotas::Slot> d(quotas.Acquire("ER", "10.0.0.5"));
+    ASSERT_TRUE(d.get() != NULL);
+    ASSERT_EQ("emergency", d->GetClassName());
+    ASSERT_TRUE(quotas.Acquire("ANY", "10.0.0.1") == NULL);  // Member by its host
+    ASSERT_EQ(1u, quotas.GetActiveAssociations("emergency"));
+    ASSERT_EQ(1u, quotas.GetRejectedAssociations("emergency"));
+
+    b.reset();
+    std::unique_ptr<DicomAssociationQuotas::Slot> e(quotas.Acquire("THIRD", "10.0.0.4"));
+    ASSERT_TRUE(e.get() != NULL);
+  }
+
+  ASSERT_EQ(0u, quotas.GetActiveAssociations("default"));
+  ASSERT_EQ(0u, quotas.GetActiveAssociations("emergency"));
+  ASSERT_EQ(2u, quotas.GetRejectedAssociations("default"));
+}
+
+#include "../Sources/DicomNetworking/DicomPresentationContextsHistory.h"
+
+TEST(DicomPresentationContextsHistory, Basic)
+{
+  DicomPresentationContextsHistory history(2);
+
+  RemoteModalityParameters remote("PACS", "192.168.0.10", 104, ModalityManufacturer_Generic);
+  DicomAssociationParameters params("ORTHANC", remote);
+  const std::string a = DicomPresentationContextsHistory::FormatKey(params);
+
+  params.SetLocalApplicationEntityTitle("OTHER");
+  const std::string b = DicomPresentationContextsHistory::FormatKey(params);
+  ASSERT_NE(a, b);
+
+  std::set<DicomTransferSyntax> s;
+  ASSERT_FALSE(history.Lookup(s, a, "1.2.840.10008.5.1.4.1.1.2"));
+
+  s.insert(DicomTransferSyntax_LittleEndianImplicit);
+  s.insert(DicomTransferSyntax_JPEG2000);
+  history.Record(a, "1.2.840.10008.5.1.4.1.1.2", s);
+  history.Record(a, "1.2.840.10008.5.1.4.1.1.4", std::set<DicomTransferSyntax>());
+  ASSERT_EQ(1u, history.GetModalitiesCount());
+
+  s.clear();
+  ASSERT_TRUE(history.Lookup(s, a, "1.2.840.10008.5.1.4.1.1.2"));
+  ASSERT_EQ(2u, s.size());
+  ASSERT_TRUE(s.find(DicomTransferSyntax_JPEG2000) != s.end());
+  ASSERT_TRUE(history.Lookup(s, a, "1.2.840.10008.5.1.4.1.1.4"));
+  ASSERT_TRUE(s.empty());  // Rejected
+  ASSERT_FALSE(history.Lookup(s, b, "1.2.840.10008.5.1.4.1.1.2"));
+
+  history.Record(b, "1.2.840.10008.5.1.4.1.1.2", s);
+  history.Record("c", "1.2.840.10008.5.1.4.1.1.2", s);  // "a" is the least recently used
+  ASSERT_EQ(2u, history.GetModalitiesCount());
+  ASSERT_FALSE(history.Lookup(s, a, "1.2.840.10008.5.1.4.1.1.2"));
+  ASSERT_TRUE(history.Lookup(s, b, "1.2.840.10008.5.1.4.1.1.2"));
+
+  history.Forget(b);
+  ASSERT_EQ(1u, history.GetModalitiesCount());
+  history.SetMaxModalities(1);
+  history.Clear();
+  ASSERT_EQ(0u, history.GetModalitiesCount());
+  ASSERT_THROW(history.SetMaxModalities(0), OrthancException);
+}
+
+#include "../Sources/DicomNetworking/DicomNetworkMetrics.h"
+
+TEST(DicomNetworkMetrics, Basic)
+{
+  ASSERT_EQ("aet=\"A\\\"B\\\\\"", DicomNetworkMetrics::FormatLabel("aet", "A\"B\\"));
+
+  ASSERT_FALSE(DicomNetworkMetrics::IsFailure(0x0000));
+  ASSERT_FALSE(DicomNetworkMetrics::IsFailure(0xFF00));
+  ASSERT_FALSE(DicomNetworkMetrics::IsFailure(0xB007));
+  ASSERT_FALSE(DicomNetworkMetrics::IsFailure(0x0111));
+  ASSERT_TRUE(DicomNetworkMetrics::IsFailure(0xA700));
+  ASSERT_TRUE(DicomNetworkMetrics::IsFailure(0xC000));
+
+  // No registry is installed
+  DicomNetworkMetrics::IncrementCounter("orthanc_dicom_scp_bytes_received_total", "PACS", 10);
+
+  MetricsRegistry registry;
+  DicomNetworkMetrics::SetRegistry(registry);
+
+  DicomNetworkMetrics::IncrementCounter("orthanc_dicom_scp_bytes_received_total", "PACS", 10);
+  DicomNetworkMetrics::IncrementCounter("orthanc_dicom_scp_bytes_received_total", "PACS", 32);
+  DicomNetworkMetrics::AddDuration("orthanc_dicom_scu_c_find_duration_ms", "PACS", 7);
+  DicomNetworkMetrics::AddDimseStatus(true, "C-STORE", "PACS", 0x0000);
+  DicomNetworkMetrics::AddDimseStatus(true, "C-STORE", "PACS", 0xA700);
+  DicomNetworkMetrics::AddNetworkFailure(false, "C-FIND", "PACS");
+
+  DicomNetworkMetrics::ResetRegistry();
+  DicomNetworkMetrics::IncrementCounter("orthanc_dicom_scp_bytes_received_total", "PACS", 100);
+
+  std::string s;
+  registry.ExportPrometheusText(s);
+
+  ASSERT_NE(std::string::npos, s.find("orthanc_dicom_scp_bytes_received_total{aet=\"PACS\"} 42 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_dicom_scu_c_find_duration_ms_bucket{aet=\"PACS\",le=\"5\"} 0 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_dicom_scu_c_find_duration_ms_bucket{aet=\"PACS\",le=\"10\"} 1 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_dicom_scu_c_find_duration_ms_bucket{aet=\"PACS\",le=\"+Inf\"} 1 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_dicom_scu_c_find_duration_ms_count{aet=\"PACS\"} 1 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_dicom_scu_c_find_duration_ms_sum{aet=\"PACS\"} 7 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_dicom_scu_failures_total{aet=\"PACS\",operation=\"C-STORE\",status=\"0xA700\"} 1 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_dicom_scp_failures_total{aet=\"PACS\",operation=\"C-FIND\",status=\"network\"} 1 "));
+  ASSERT_EQ(std::string::npos, s.find("status=\"0x0000\""));
+}
+
 #endif
@@ -34,8 +34,11 @@
 #include "../Sources/Images/Image.h"
 #include "../Sources/Images/ImageProcessing.h"
 #include "../Sources/Images/ImageTraits.h"
+#include "../Sources/MultiThreading/ThreadPool.h"
 #include "../Sources/OrthancException.h"
 
+#include <cmath>
+#include <limits>
 #include <memory>
 
 using namespace Orthanc;
@@ -1280,6 +1283,293 @@ TEST(ImageProcessing, ShiftScale2)
 }
 
 
+// The width is not a multiple of the size of the vectors, so that both
+// the vectorized kernels and the scalar code process each row
+static const unsigned int ACCELERATED_WIDTH = 16 * 4 + 7;
+static const unsigned int ACCELERATED_HEIGHT = 5;
+
+
+template <PixelFormat Format>
+static void FillRandom(ImageAccessor& image)
+{
+  typedef typename PixelTraits<Format>::PixelType PixelType;
+
+  for (unsigned int y = 0; y < image.GetHeight(); y++)
+  {
+    PixelType* p = reinterpret_cast<PixelType*>(image.GetRow(y));
+    for (unsigned int x = 0; x < image.GetWidth(); x++, p++)
+    {
+      // Cover the whole dynamic range, including the extreme values
+      switch (rand() % 8)
+      {
+        case 0:
+          PixelTraits<Format>::SetMinValue(*p);
+          break;
+
+        case 1:
+          PixelTraits<Format>::SetMaxValue(*p);
+          break;
+
+        default:
+          *p = static_cast<PixelType>(rand());
+          break;
+      }
+    }
+  }
+}
+
+
+template <PixelFormat Format>
+static void CheckAcceleratedShiftScale(float offset,
+                                       float scaling)
+{
+  typedef typename PixelTraits<Format>::PixelType PixelType;
+
+  Image source(Format, ACCELERATED_WIDTH, ACCELERATED_HEIGHT, false);
+  FillRandom<Format>(source);
+
+  Image target(PixelFormat_Grayscale8, ACCELERATED_WIDTH, ACCELERATED_HEIGHT, false);
+  ImageProcessing::ShiftScale2(target, source, offset, scaling, false);
+
+  for (unsigned int y = 0; y < ACCELERATED_HEIGHT; y++)
+  {
+    const PixelType* p = reinterpret_cast<const PixelType*>(source.GetConstRow(y));
+    const uint8_t* q = reinterpret_cast<const uint8_t*>(target.GetConstRow(y));
+
+    for (unsigned int x = 0; x < ACCELERATED_WIDTH; x++, p++, q++)
+    {
+      // Scalar reference implementation
+      const float v = scaling * static_cast<float>(*p) + offset;
+
+      uint8_t expected;
+      if (v >= 255.0f)
+      {
+        expected = 255;
+      }
+      else if (v <= 0.0f)
+      {
+        expected = 0;
+      }
+      else
+      {
+        expected = static_cast<uint8_t>(std::floor(v));
+      }
+
+      ASSERT_EQ(expected, *q);
+    }
+  }
+}
+
+
+TEST(ImageProcessing, AcceleratedShiftScale)
+{
+  std::vector<std::pair<float, float> > transforms;
+  transforms.push_back(std::make_pair(0.0f, 1.0f / 256.0f));
+  transforms.push_back(std::make_pair(-127.3f, 0.0317f));
+  transforms.push_back(std::make_pair(128.5f, 0.00389f));
+  transforms.push_back(std::make_pair(300.0f, -1.7f));
+  transforms.push_back(std::make_pair(0.5f, 1.0f));
+
+  for (size_t i = 0; i < transforms.size(); i++)
+  {
+    CheckAcceleratedShiftScale<PixelFormat_Grayscale8>(transforms[i].first, transforms[i].second);
+    CheckAcceleratedShiftScale<PixelFormat_Grayscale16>(transforms[i].first, transforms[i].second);
+    CheckAcceleratedShiftScale<PixelFormat_SignedGrayscale16>(transforms[i].first, transforms[i].second);
+  }
+
+  {
+    Image source(PixelFormat_Float32, ACCELERATED_WIDTH, 1, false);
+    float* p = reinterpret_cast<float*>(source.GetRow(0));
+    for (unsigned int x = 0; x < ACCELERATED_WIDTH; x++)
+    {
+      p[x] = static_cast<float>(x) * 4.13f - 17.0f;
+    }
+
+    Image target(PixelFormat_Grayscale8, ACCELERATED_WIDTH, 1, false);
+    ImageProcessing::ShiftScale2(target, source, 0.7f, 0.9f, false);
+
+    const uint8_t* q = reinterpret_cast<const uint8_t*>(target.GetConstRow(0));
+    for (unsigned int x = 0; x < ACCELERATED_WIDTH; x++)
+    {
+      const float v = 0.9f * p[x] + 0.7f;
+      ASSERT_EQ(v <= 0.0f ? 0 : (v >= 255.0f ? 255 : static_cast<int>(std::floor(v))), q[x]);
+    }
+  }
+}
+
+
+template <PixelFormat SourceFormat>
+static void CheckAcceleratedConvertToGrayscale8()
+{
+  typedef typename PixelTraits<SourceFormat>::PixelType PixelType;
+
+  Image source(SourceFormat, ACCELERATED_WIDTH, ACCELERATED_HEIGHT, false);
+  FillRandom<SourceFormat>(source);
+
+  Image target(PixelFormat_Grayscale8, ACCELERATED_WIDTH, ACCELERATED_HEIGHT, false);
+  ImageProcessing::Convert(target, source);
+
+  for (unsigned int y = 0; y < ACCELERATED_HEIGHT; y++)
+  {
+    const PixelType* p = reinterpret_cast<const PixelType*>(source.GetConstRow(y));
+    const uint8_t* q = reinterpret_cast<const uint8_t*>(target.GetConstRow(y));
+
+    for (unsigned int x = 0; x < ACCELERATED_WIDTH; x++, p++, q++)
+    {
+      const int32_t v = static_cast<int32_t>(*p);
+      ASSERT_EQ(v < 0 ? 0 : (v > 255 ? 255 : v), static_cast<int32_t>(*q));
+    }
+  }
+}
+
+
+template <PixelFormat Format>
+static void CheckAcceleratedMinMax()
+{
+  typedef typename PixelTraits<Format>::PixelType PixelType;
+
+  Image image(Format, ACCELERATED_WIDTH, ACCELERATED_HEIGHT, false);
+
+  for (unsigned int i = 0; i < 10; i++)
+  {
+    FillRandom<Format>(image);
+
+    if (i == 0)
+    {
+      ImageProcessing::Set(image, 42);
+    }
+
+    // The extreme values are possibly only found by the scalar code
+    // at the end of the rows
+    if (i % 2 == 1)
+    {
+      ImageProcessing::Set(image, 1000);
+      reinterpret_cast<PixelType*>(image.GetRow(ACCELERATED_HEIGHT - 1))[ACCELERATED_WIDTH - 1] = 1;
+      reinterpret_cast<PixelType*>(image.GetRow(2))[ACCELERATED_WIDTH - 2] = 30000;
+    }
+
+    int64_t expectedMin = std::numeric_limits<int64_t>::max();
+    int64_t expectedMax = std::numeric_limits<int64_t>::min();
+
+    for (unsigned int y = 0; y < ACCELERATED_HEIGHT; y++)
+    {
+      const PixelType* p = reinterpret_cast<const PixelType*>(image.GetConstRow(y));
+      for (unsigned int x = 0; x < ACCELERATED_WIDTH; x++)
+      {
+        expectedMin = std::min(expectedMin, static_cast<int64_t>(p[x]));
+        expectedMax = std::max(expectedMax, static_cast<int64_t>(p[x]));
+      }
+    }
+
+    int64_t minValue, maxValue;
+    ImageProcessing::GetMinMaxIntegerValue(minValue, maxValue, image);
+    ASSERT_EQ(expectedMin, minValue);
+    ASSERT_EQ(expectedMax, maxValue);
+  }
+}
+
+
+TEST(ImageProcessing, AcceleratedConvertAndMinMax)
+{
+  CheckAcceleratedConvertToGrayscale8<PixelFormat_Grayscale16>();
+  CheckAcceleratedConvertToGrayscale8<PixelFormat_SignedGrayscale16>();
+
+  CheckAcceleratedMinMax<PixelFormat_Grayscale16>();
+  CheckAcceleratedMinMax<PixelFormat_SignedGrayscale16>();
+}
+
+
+static bool IsSameImage(const ImageAccessor& a,
+                        const ImageAccessor& b)
+{
+  if (a.GetFormat() != b.GetFormat() ||
+      a.GetWidth() != b.GetWidth() ||
+      a.GetHeight() != b.GetHeight())
+  {
+    return false;
+  }
+
+  for (unsigned int y = 0; y < a.GetHeight(); y++)
+  {
+    if (memcmp(a.GetConstRow(y), b.GetConstRow(y), a.GetWidth() * a.GetBytesPerPixel()) != 0)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+static void ProcessLargeImages(std::vector<boost::shared_ptr<Image> >& results)
+{
+  // Large enough to be processed by bands of rows
+  Image source(PixelFormat_Grayscale16, 1283, 1031, false);
+  FillRandom<PixelFormat_Grayscale16>(source);
+
+  boost::shared_ptr<Image> converted(new Image(PixelFormat_Grayscale8, source.GetWidth(), source.GetHeight(), false));
+  ImageProcessing::Convert(*converted, source);
+  results.push_back(converted);
+
+  boost::shared_ptr<Image> resized(new Image(PixelFormat_Grayscale8, 1500, 997, false));
+  ImageProcessing::Resize(*resized, *converted);
+  results.push_back(resized);
+
+  boost::shared_ptr<Image> smoothed(Image::Clone(*converted));
+  ImageProcessing::SmoothGaussian5x5(*smoothed, true);
+  results.push_back(smoothed);
+
+  boost::shared_ptr<Image> fitted(new Image(PixelFormat_Grayscale8, 1200, 1100, false));
+  ImageProcessing::FitSize(*fitted, *converted);
+  results.push_back(fitted);
+}
+
+
+TEST(ImageProcessing, ParallelRowBands)
+{
+  srand(42);
+  std::vector<boost::shared_ptr<Image> > sequential;
+  ProcessLargeImages(sequential);
+
+  boost::shared_ptr<ThreadPool> pool(new ThreadPool);
+  pool->SetCountThreads(3);
+  pool->Start();
+
+  ImageProcessing::SetParallelExecutor(pool, 3);
+
+  srand(42);
+  std::vector<boost::shared_ptr<Image> > parallel;
+  ProcessLargeImages(parallel);
+
+  ASSERT_EQ(sequential.size(), parallel.size());
+  for (size_t i = 0; i < sequential.size(); i++)
+  {
+    ASSERT_TRUE(IsSameImage(*sequential[i], *parallel[i]));
+  }
+
+  {
+    // The errors are reported to the calling thread
+    Image source(PixelFormat_RGB48, 1283, 1031, false);
+    Image target(PixelFormat_Float32, 1283, 1031, false);
+    ASSERT_THROW(ImageProcessing::Convert(target, source), OrthancException);
+  }
+
+  // Once the pool is stopped, the calling thread processes all the bands
+  pool->Stop();
+
+  srand(42);
+  parallel.clear();
+  ProcessLargeImages(parallel);
+
+  for (size_t i = 0; i < sequential.size(); i++)
+  {
+    ASSERT_TRUE(IsSameImage(*sequential[i], *parallel[i]));
+  }
+
+  ImageProcessing::SetParallelExecutor(boost::shared_ptr<IExecutorService>(), 0);
+}
+
+
 namespace
 {
   class PolygonSegments : public ImageProcessing::IPolygonFiller
@@ -31,9 +31,11 @@
 
 #include "../Sources/Images/Font.h"
 #include "../Sources/Images/Image.h"
+#include "../Sources/Images/ImageBufferPool.h"
 #include "../Sources/Images/ImageProcessing.h"
 #include "../Sources/Images/JpegReader.h"
 #include "../Sources/Images/JpegWriter.h"
+#include "../Sources/Images/NumpyWriter.h"
 #include "../Sources/Images/PamReader.h"
 #include "../Sources/Images/PamWriter.h"
 #include "../Sources/Images/PngReader.h"
@@ -357,6 +359,67 @@ TEST(JpegWriter, Basic)
 }
 
 
+TEST(JpegWriter, Settings)
+{
+  // Large image, so that the output buffer must be enlarged
+  Orthanc::Image img(Orthanc::PixelFormat_RGB24, 301, 203, false);
+  for (unsigned int y = 0; y < img.GetHeight(); y++)
+  {
+    uint8_t* p = reinterpret_cast<uint8_t*>(img.GetRow(y));
+    for (unsigned int x = 0; x < img.GetWidth(); x++, p += 3)
+    {
+      p[0] = static_cast<uint8_t>(x * y);
+      p[1] = static_cast<uint8_t>(x + y);
+      p[2] = static_cast<uint8_t>((x * 7) ^ y);
+    }
+  }
+
+  Orthanc::JpegWriter w;
+  ASSERT_EQ(Orthanc::JpegWriter::ChromaSubsampling_420, w.GetChromaSubsampling());
+  ASSERT_FALSE(w.IsFastDct());
+  ASSERT_FALSE(w.IsOptimizedHuffman());
+  ASSERT_THROW(w.SetChromaSubsampling(static_cast<Orthanc::JpegWriter::ChromaSubsampling>(42)), Orthanc::OrthancException);
+
+  std::string s420, s444, optimized;
+  Orthanc::IImageWriter::WriteToMemory(w, s420, img);
+
+  w.SetChromaSubsampling(Orthanc::JpegWriter::ChromaSubsampling_444);
+  Orthanc::IImageWriter::WriteToMemory(w, s444, img);
+  ASSERT_GT(s444.size(), s420.size());
+
+  w.SetOptimizedHuffman(true);
+  Orthanc::IImageWriter::WriteToMemory(w, optimized, img);
+  ASSERT_LT(optimized.size(), s444.size());
+
+  // The target string is reused, and shrunk to the compressed size
+  std::string reused(10 * s444.size(), 'x');
+  w.SetOptimizedHuffman(false);
+  Orthanc::IImageWriter::WriteToMemory(w, reused, img);
+  ASSERT_EQ(s444, reused);
+
+#if ORTHANC_SANDBOXED != 1
+  // The file and memory backends produce the same content
+  std::string t;
+  Orthanc::IImageWriter::WriteToFile(w, "UnitTestsResults/settings.jpg", img);
+  Orthanc::SystemToolbox::ReadFile(t, Orthanc::SystemToolbox::PathFromUtf8("UnitTestsResults/settings.jpg"));
+  ASSERT_EQ(s444, t);
+#endif
+
+  w.SetChromaSubsampling(Orthanc::JpegWriter::ChromaSubsampling_422);
+  w.SetFastDct(true);
+  w.SetOptimizedHuffman(true);
+
+  std::string s;
+  Orthanc::IImageWriter::WriteToMemory(w, s, img);
+
+  Orthanc::JpegReader r;
+  r.ReadFromMemory(s);
+  ASSERT_EQ(Orthanc::PixelFormat_RGB24, r.GetFormat());
+  ASSERT_EQ(301u, r.GetWidth());
+  ASSERT_EQ(203u, r.GetHeight());
+}
+
+
 TEST(PamWriter, ColorPattern)
 {
   Orthanc::PamWriter w;
@@ -625,6 +688,221 @@ TEST(PngWriter, Gray16Then8)
 }
 
 
+TEST(PngWriter, Settings)
+{
+  Orthanc::Image image(Orthanc::PixelFormat_Grayscale16, 97, 83, false);
+  for (unsigned int y = 0; y < image.GetHeight(); y++)
+  {
+    uint16_t* p = reinterpret_cast<uint16_t*>(image.GetRow(y));
+    for (unsigned int x = 0; x < image.GetWidth(); x++, p++)
+    {
+      *p = static_cast<uint16_t>(100 * x + 7 * y);
+    }
+  }
+
+  Orthanc::PngWriter w;
+  ASSERT_FALSE(w.HasCompressionLevel());
+  ASSERT_EQ(6u, w.GetCompressionLevel());
+  ASSERT_EQ(Orthanc::PngWriter::FilterStrategy_Adaptive, w.GetFilterStrategy());
+  ASSERT_THROW(w.SetCompressionLevel(10), Orthanc::OrthancException);
+  ASSERT_THROW(w.SetFilterStrategy(static_cast<Orthanc::PngWriter::FilterStrategy>(42)), Orthanc::OrthancException);
+  ASSERT_EQ(Orthanc::PngWriter::FilterStrategy_Paeth, Orthanc::PngWriter::StringToFilterStrategy("Paeth"));
+  ASSERT_EQ(Orthanc::PngWriter::FilterStrategy_None, Orthanc::PngWriter::StringToFilterStrategy("none"));
+  ASSERT_THROW(Orthanc::PngWriter::StringToFilterStrategy("avg"), Orthanc::OrthancException);
+
+  std::string defaultPng, fastPng, uncompressedPng;
+  Orthanc::IImageWriter::WriteToMemory(w, defaultPng, image);
+
+  w.SetFastEncoding();
+  ASSERT_TRUE(w.HasCompressionLevel());
+  ASSERT_EQ(1u, w.GetCompressionLevel());
+  ASSERT_EQ(Orthanc::PngWriter::FilterStrategy_None, w.GetFilterStrategy());
+  Orthanc::IImageWriter::WriteToMemory(w, fastPng, image);
+
+  w.SetCompressionLevel(0);
+  Orthanc::IImageWriter::WriteToMemory(w, uncompressedPng, image);
+  ASSERT_LT(defaultPng.size(), fastPng.size());
+  ASSERT_LT(fastPng.size(), uncompressedPng.size());
+
+  const std::string* pngs[] = { &defaultPng, &fastPng, &uncompressedPng };
+  for (size_t i = 0; i < sizeof(pngs) / sizeof(pngs[0]); i++)
+  {
+    // All the settings are lossless
+    Orthanc::PngReader r;
+    r.ReadFromMemory(*pngs[i]);
+    ASSERT_EQ(Orthanc::PixelFormat_Grayscale16, r.GetFormat());
+    ASSERT_EQ(image.GetWidth(), r.GetWidth());
+    ASSERT_EQ(image.GetHeight(), r.GetHeight());
+
+    for (unsigned int y = 0; y < image.GetHeight(); y++)
+    {
+      ASSERT_EQ(0, memcmp(image.GetConstRow(y), r.GetConstRow(y), 2 * image.GetWidth()));
+    }
+  }
+}
+
+
+TEST(ImageBufferPool, Basic)
+{
+  ASSERT_EQ(100u, Orthanc::ImageBufferPool::GetCapacity(100));
+  ASSERT_EQ(64u * 1024u, Orthanc::ImageBufferPool::GetCapacity(64 * 1024));
+  ASSERT_EQ(80u * 1024u, Orthanc::ImageBufferPool::GetCapacity(64 * 1024 + 1));
+  ASSERT_EQ(128u * 1024u, Orthanc::ImageBufferPool::GetCapacity(128 * 1024));
+  ASSERT_EQ(160u * 1024u, Orthanc::ImageBufferPool::GetCapacity(128 * 1024 + 1));
+
+  for (size_t size = 64 * 1024; size < 4 * 1024 * 1024; size += 4099)
+  {
+    const size_t capacity = Orthanc::ImageBufferPool::GetCapacity(size);
+    ASSERT_GE(capacity, size);
+    ASSERT_LE(capacity, size + size / 4);
+    ASSERT_EQ(capacity, Orthanc::ImageBufferPool::GetCapacity(capacity));
+  }
+
+  const uint64_t previous = Orthanc::ImageBufferPool::GetMaximumSize();
+  Orthanc::ImageBufferPool::SetMaximumSize(0);
+
+  Orthanc::CacheStatistics statistics;
+  size_t countUnused;
+  uint64_t unusedSize;
+  Orthanc::ImageBufferPool::GetStatistics(statistics, countUnused, unusedSize);
+  ASSERT_EQ(0u, countUnused);
+  ASSERT_EQ(0u, unusedSize);
+
+  Orthanc::ImageBufferPool::SetMaximumSize(4 * 1024 * 1024);
+  const uint64_t hits = statistics.GetHits();
+
+  {
+    Orthanc::Image image(Orthanc::PixelFormat_Grayscale16, 512, 512, false);
+  }
+
+  Orthanc::ImageBufferPool::GetStatistics(statistics, countUnused, unusedSize);
+  ASSERT_EQ(1u, countUnused);
+  ASSERT_EQ(512u * 1024u, unusedSize);
+
+  {
+    // Same class of sizes, the buffer is reused
+    Orthanc::Image image(Orthanc::PixelFormat_Grayscale8, 500, 1000, false);
+    Orthanc::ImageBufferPool::GetStatistics(statistics, countUnused, unusedSize);
+    ASSERT_EQ(hits + 1u, statistics.GetHits());
+    ASSERT_EQ(0u, countUnused);
+
+    // Too large to be kept in the pool
+    Orthanc::Image large(Orthanc::PixelFormat_RGB24, 2048, 2048, false);
+  }
+
+  Orthanc::ImageBufferPool::GetStatistics(statistics, countUnused, unusedSize);
+  ASSERT_EQ(1u, countUnused);
+  ASSERT_EQ(512u * 1024u, unusedSize);
+
+  {
+    // Small images are not pooled
+    Orthanc::Image small(Orthanc::PixelFormat_Grayscale8, 16, 16, false);
+  }
+
+  Orthanc::ImageBufferPool::GetStatistics(statistics, countUnused, unusedSize);
+  ASSERT_EQ(1u, countUnused);
+
+  Orthanc::ImageBufferPool::Clear();
+  Orthanc::ImageBufferPool::GetStatistics(statistics, countUnused, unusedSize);
+  ASSERT_EQ(0u, countUnused);
+  ASSERT_EQ(0u, unusedSize);
+
+  Orthanc::ImageBufferPool::SetMaximumSize(previous);
+}
+
+
+namespace
+{
+  class NumpyStringOutput : public Orthanc::NumpyStreamWriter::IOutput
+  {
+  private:
+    std::string  content_;
+
+  public:
+    virtual void Write(const void* data,
+                       size_t size) ORTHANC_OVERRIDE
+    {
+      content_.append(reinterpret_cast<const char*>(data), size);
+    }
+
+    const std::string& GetContent() const
+    {
+      return content_;
+    }
+  };
+}
+
+
+TEST(NumpyWriter, Stream)
+{
+  // Volume of 3 frames of size 5x4, stacked in one image
+  Orthanc::Image volume(Orthanc::PixelFormat_Grayscale16, 5, 3 * 4, false);
+  for (unsigned int y = 0; y < volume.GetHeight(); y++)
+  {
+    uint16_t* p = reinterpret_cast<uint16_t*>(volume.GetRow(y));
+    for (unsigned int x = 0; x < volume.GetWidth(); x++, p++)
+    {
+      *p = static_cast<uint16_t>(1000 * y + x);
+    }
+  }
+
+  std::string expected;
+
+  {
+    Orthanc::ChunkedBuffer buffer;
+    Orthanc::NumpyWriter::WriteHeader(buffer, 3, 5, 4, Orthanc::PixelFormat_Grayscale16);
+    Orthanc::NumpyWriter::WritePixels(buffer, volume);
+    Orthanc::NumpyWriter::Finalize(expected, buffer, false);
+  }
+
+  Orthanc::ImageAccessor first, others;
+  volume.GetRegion(first, 0, 0, 5, 4);
+  volume.GetRegion(others, 0, 4, 5, 8);
+
+  {
+    NumpyStringOutput output;
+    Orthanc::NumpyStreamWriter writer(output, false);
+    ASSERT_THROW(writer.WritePixels(first), Orthanc::OrthancException);
+    writer.WriteHeader(3, 5, 4, Orthanc::PixelFormat_Grayscale16);
+    ASSERT_THROW(writer.WriteHeader(3, 5, 4, Orthanc::PixelFormat_Grayscale16), Orthanc::OrthancException);
+    writer.WritePixels(first);
+    ASSERT_THROW(writer.Close(), Orthanc::OrthancException);  // Missing frames
+    writer.WritePixels(others);
+    ASSERT_THROW(writer.WritePixels(first), Orthanc::OrthancException);  // Too many frames
+    writer.Close();
+    ASSERT_EQ(expected, output.GetContent());
+  }
+
+  {
+    Orthanc::Image wrongFormat(Orthanc::PixelFormat_Grayscale8, 5, 4, false);
+    Orthanc::Image wrongHeight(Orthanc::PixelFormat_Grayscale16, 5, 3, false);
+
+    NumpyStringOutput output;
+    Orthanc::NumpyStreamWriter writer(output, false);
+    writer.WriteHeader(3, 5, 4, Orthanc::PixelFormat_Grayscale16);
+    ASSERT_THROW(writer.WritePixels(wrongFormat), Orthanc::OrthancException);
+    ASSERT_THROW(writer.WritePixels(wrongHeight), Orthanc::OrthancException);
+  }
+
+#if ORTHANC_SANDBOXED != 1
+  {
+    NumpyStringOutput output;
+
+    {
+      Orthanc::NumpyStreamWriter writer(output, true);
+      writer.WriteHeader(3, 5, 4, Orthanc::PixelFormat_Grayscale16);
+      writer.WritePixels(volume);
+      writer.Close();
+    }
+
+    // The NPZ archive is a ZIP file
+    ASSERT_LT(4u, output.GetContent().size());
+    ASSERT_EQ("PK", output.GetContent().substr(0, 2));
+  }
+#endif
+}
+
+
 TEST(ImageAccessor, Broken)
 {
   // This test checks whether ImageAccessor was broken by the
@@ -34,6 +34,7 @@
 #include "../../OrthancFramework/Sources/DicomNetworking/RemoteModalityParameters.h"
 #include "../../OrthancFramework/Sources/DicomParsing/DicomModification.h"
 #include "../../OrthancFramework/Sources/DicomParsing/ParsedDicomFile.h"
+#include "../../OrthancFramework/Sources/ElapsedTimer.h"
 #include "../../OrthancFramework/Sources/JobsEngine/GenericJobUnserializer.h"
 #include "../../OrthancFramework/Sources/JobsEngine/JobsEngine.h"
 #include "../../OrthancFramework/Sources/JobsEngine/Operations/JobOperationValues.h"
@@ -43,9 +44,14 @@
 #include "../../OrthancFramework/Sources/JobsEngine/Operations/StringOperationValue.h"
 #include "../../OrthancFramework/Sources/JobsEngine/SetOfInstancesJob.h"
 #include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/MetricsRegistry.h"
 #include "../../OrthancFramework/Sources/MultiThreading/BlockingSharedMessageQueue.h"
+#include "../../OrthancFramework/Sources/MultiThreading/BoundedMessageQueue.h"
+#include "../../OrthancFramework/Sources/MultiThreading/FairSharedMutex.h"
+#include "../../OrthancFramework/Sources/MultiThreading/LockProfiler.h"
 #include "../../OrthancFramework/Sources/MultiThreading/SharedMessageQueue.h"
 #include "../../OrthancFramework/Sources/MultiThreading/ThreadPool.h"
+#include "../../OrthancFramework/Sources/MultiThreading/WorkStealingThreadPool.h"
 #include "../../OrthancFramework/Sources/OrthancException.h"
 #include "../../OrthancFramework/Sources/SerializationToolbox.h"
 
@@ -417,6 +423,222 @@ TEST(MultiThreading, BlockingSharedMessageQueueClean)
 }
 
 
+static void DequeueAfterDelay(BlockingSharedMessageQueue* q)
+{
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  delete q->Dequeue(0);
+}
+
+TEST(MultiThreading, BlockingSharedMessageQueueMaxSize)
+{
+  std::set<int> s; // keeps a copy of all DynamicInteger objects
+
+  std::unique_ptr<IDynamicObject> o10(new DynamicInteger(10, s));
+  std::unique_ptr<IDynamicObject> o20(new DynamicInteger(20, s));
+  std::unique_ptr<IDynamicObject> o30(new DynamicInteger(30, s));
+
+  BlockingSharedMessageQueue q;
+  ASSERT_EQ(0u, q.GetMaxSize());
+
+  q.SetMaxSize(1);
+  ASSERT_EQ(1u, q.GetMaxSize());
+  ASSERT_TRUE(q.Enqueue(o10, 0));
+  ASSERT_FALSE(q.Enqueue(o20, 0));
+  ASSERT_EQ(3u, s.size());  // The message is kept by the caller
+
+  {
+    // Room is made by another thread before the timeout
+    boost::thread t(DequeueAfterDelay, &q);
+    ASSERT_TRUE(q.Enqueue(o20, 5000));
+    t.join();
+  }
+
+  ASSERT_EQ(1u, q.GetSize());
+  ASSERT_EQ(2u, s.size());
+
+  q.SetMaxSize(0);
+  ASSERT_TRUE(q.Enqueue(o30, 0));
+  ASSERT_EQ(2u, q.GetSize());
+
+  std::unique_ptr<DynamicInteger> i;
+  i.reset(dynamic_cast<DynamicInteger*>(q.Dequeue(1))); ASSERT_EQ(20, i->GetValue());
+  i.reset(dynamic_cast<DynamicInteger*>(q.Dequeue(1))); ASSERT_EQ(30, i->GetValue());
+  i.reset();
+  ASSERT_EQ(0u, s.size());
+}
+
+
+TEST(MultiThreading, BoundedMessageQueueBasic)
+{
+  ASSERT_THROW(BoundedMessageQueue(0), OrthancException);
+
+  std::set<int> s; // keeps a copy of all DynamicInteger objects
+
+  {
+    BoundedMessageQueue q(3);
+    ASSERT_EQ(4u, q.GetCapacity());  // Rounded up to a power of 2
+    ASSERT_EQ(0u, q.GetSize());
+    ASSERT_TRUE(q.TryDequeue() == NULL);
+    ASSERT_TRUE(q.Dequeue(1) == NULL);
+
+    for (int i = 0; i < 4; i++)
+    {
+      std::unique_ptr<IDynamicObject> o(new DynamicInteger(i, s));
+      ASSERT_TRUE(q.Enqueue(o, 0));
+      ASSERT_TRUE(o.get() == NULL);
+    }
+
+    ASSERT_EQ(4u, q.GetSize());
+
+    std::unique_ptr<IDynamicObject> o(new DynamicInteger(4, s));
+    ASSERT_FALSE(q.Enqueue(o, 0));
+    ASSERT_FALSE(q.Enqueue(o, 1));
+    ASSERT_TRUE(o.get() != NULL);  // The message is kept by the caller
+
+    std::unique_ptr<DynamicInteger> i;
+    i.reset(dynamic_cast<DynamicInteger*>(q.Dequeue(1))); ASSERT_EQ(0, i->GetValue());
+    ASSERT_TRUE(q.Enqueue(o, 0));
+
+    // FIFO, after the positions have wrapped around the ring
+    i.reset(dynamic_cast<DynamicInteger*>(q.TryDequeue())); ASSERT_EQ(1, i->GetValue());
+    i.reset(dynamic_cast<DynamicInteger*>(q.Dequeue(0))); ASSERT_EQ(2, i->GetValue());
+    i.reset();
+    ASSERT_EQ(2u, q.GetSize());
+    ASSERT_EQ(2u, s.size());
+
+    q.Enqueue(new DynamicInteger(5, s));
+    q.Clear();
+    ASSERT_EQ(0u, q.GetSize());
+    ASSERT_EQ(0u, s.size());
+
+    // The destructor deletes the remaining messages
+    q.Enqueue(new DynamicInteger(6, s));
+  }
+
+  ASSERT_EQ(0u, s.size());
+}
+
+
+namespace
+{
+  class BoundedQueueProducer : public boost::noncopyable
+  {
+  private:
+    BoundedMessageQueue&  queue_;
+    int                   first_;
+    int                   count_;
+
+  public:
+    BoundedQueueProducer(BoundedMessageQueue& queue,
+                         int first,
+                         int count) :
+      queue_(queue),
+      first_(first),
+      count_(count)
+    {
+    }
+
+    void operator() ()
+    {
+      for (int i = 0; i < count_; i++)
+      {
+        queue_.Enqueue(new SingleValueObject<int>(first_ + i));
+      }
+    }
+  };
+
+
+  class BoundedQueueConsumer : public boost::noncopyable
+  {
+  private:
+    BoundedMessageQueue&  queue_;
+    int                   count_;
+    std::vector<int>&     received_;
+
+  public:
+    BoundedQueueConsumer(BoundedMessageQueue& queue,
+                         int count,
+                         std::vector<int>& received) :
+      queue_(queue),
+      count_(count),
+      received_(received)
+    {
+    }
+
+    void operator() ()
+    {
+      for (int i = 0; i < count_; i++)
+      {
+        std::unique_ptr<IDynamicObject> message(queue_.Dequeue(0));
+        received_.push_back(dynamic_cast<SingleValueObject<int>&>(*message).GetValue());
+      }
+    }
+  };
+}
+
+
+TEST(MultiThreading, BoundedMessageQueueConcurrency)
+{
+  static const int PRODUCERS = 4;
+  static const int CONSUMERS = 3;
+  static const int COUNT = 6000;  // Divisible by PRODUCERS and by CONSUMERS
+
+  // A very small queue, so that both the producers and the consumers block
+  BoundedMessageQueue q(4);
+
+  std::vector< std::vector<int> > received(CONSUMERS);
+
+  boost::thread_group threads;
+  std::vector<BoundedQueueProducer*> producers;
+  std::vector<BoundedQueueConsumer*> consumers;
+
+  for (int i = 0; i < CONSUMERS; i++)
+  {
+    consumers.push_back(new BoundedQueueConsumer(q, COUNT / CONSUMERS, received[i]));
+    threads.create_thread(boost::ref(*consumers.back()));
+  }
+
+  for (int i = 0; i < PRODUCERS; i++)
+  {
+    producers.push_back(new BoundedQueueProducer(q, i * (COUNT / PRODUCERS), COUNT / PRODUCERS));
+    threads.create_thread(boost::ref(*producers.back()));
+  }
+
+  threads.join_all();
+
+  std::vector<int> all;
+  for (int i = 0; i < CONSUMERS; i++)
+  {
+    // FIFO: Each consumer receives the messages of one producer in increasing order
+    std::vector<int> last(PRODUCERS, -1);
+    for (size_t j = 0; j < received[i].size(); j++)
+    {
+      const int producer = received[i][j] / (COUNT / PRODUCERS);
+      ASSERT_LT(last[producer], received[i][j]);
+      last[producer] = received[i][j];
+    }
+
+    all.insert(all.end(), received[i].begin(), received[i].end());
+    delete consumers[i];
+  }
+
+  for (int i = 0; i < PRODUCERS; i++)
+  {
+    delete producers[i];
+  }
+
+  // Each message is received exactly once
+  std::sort(all.begin(), all.end());
+  ASSERT_EQ(static_cast<size_t>(COUNT), all.size());
+  for (int i = 0; i < COUNT; i++)
+  {
+    ASSERT_EQ(i, all[i]);
+  }
+
+  ASSERT_EQ(0u, q.GetSize());
+}
+
+
 
 
 static bool CheckState(JobsRegistry& registry,
@@ -641,6 +863,85 @@ TEST(JobsRegistry, Retry)
 }
 
 
+TEST(JobsRegistry, RetryBackoff)
+{
+  JobsRegistry registry(10);
+  registry.SetRetryBackoff("DummyJob", 100000);
+
+  std::string id;
+  registry.Submit(id, new DummyJob(), 10);
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    {
+      JobsRegistry::RunningJob job(registry, 0);
+      ASSERT_TRUE(job.IsValid());
+      job.MarkRetry(0);
+    }
+
+    // The earliest retry is already due: No wait
+    ASSERT_TRUE(CheckState(registry, id, JobState_Retry));
+    registry.WaitAndScheduleRetries(100000);
+    ASSERT_TRUE(CheckState(registry, id, JobState_Pending));
+  }
+
+  {
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_TRUE(job.IsValid());
+    job.MarkRetry(1000);  // The third retry is delayed by at least 2 seconds
+  }
+
+  registry.WaitAndScheduleRetries(10);
+  ASSERT_TRUE(CheckState(registry, id, JobState_Retry));
+
+  registry.Cancel(id);
+  ASSERT_TRUE(CheckState(registry, id, JobState_Failure));
+}
+
+TEST(JobsRegistry, MaxRunningJobs)
+{
+  JobsRegistry registry(10);
+  registry.SetMaxRunningJobs("DummyJob", 1);
+
+  std::string a, b, c;
+  registry.Submit(a, new DummyJob(), 10);
+  registry.Submit(b, new DummyJob(), 10);
+  registry.Submit(c, new DummyInstancesJob(), 0);
+
+  {
+    std::unique_ptr<JobsRegistry::RunningJob> job1(new JobsRegistry::RunningJob(registry, 0));
+    ASSERT_TRUE(job1->IsValid());
+    ASSERT_EQ(a, job1->GetId());
+
+    {
+      // "b" has a higher priority, but its type is saturated
+      JobsRegistry::RunningJob job2(registry, 10);
+      ASSERT_TRUE(job2.IsValid());
+      ASSERT_EQ(c, job2.GetId());
+      job2.MarkSuccess();
+    }
+
+    {
+      JobsRegistry::RunningJob job3(registry, 10);
+      ASSERT_FALSE(job3.IsValid());
+    }
+
+    ASSERT_TRUE(CheckState(registry, b, JobState_Pending));
+    job1->MarkSuccess();
+  }
+
+  {
+    JobsRegistry::RunningJob job4(registry, 10);
+    ASSERT_TRUE(job4.IsValid());
+    ASSERT_EQ(b, job4.GetId());
+    job4.MarkSuccess();
+  }
+
+  ASSERT_TRUE(CheckState(registry, a, JobState_Success));
+  ASSERT_TRUE(CheckState(registry, b, JobState_Success));
+  ASSERT_TRUE(CheckState(registry, c, JobState_Success));
+}
+
 TEST(JobsRegistry, PausePending)
 {
   JobsRegistry registry(10);
@@ -833,6 +1134,74 @@ TEST(JobsRegistry, Cancel)
 
 
 
+TEST(JobsRegistry, ListByState)
+{
+  JobsRegistry registry(10);
+
+  std::string i1, i2, i3, i4;
+  registry.Submit(i1, new DummyJob(), 10);
+  registry.Submit(i2, new DummyJob(), 30);
+  registry.Submit(i3, new DummyJob(), 10);
+  registry.Submit(i4, new DummyJob(), 20);
+
+  std::list<std::string> l;
+  registry.ListJobs(l, JobState_Pending, 0, 0);
+  ASSERT_EQ(4u, l.size());
+  ASSERT_EQ(i2, l.front());  l.pop_front();
+  ASSERT_EQ(i4, l.front());  l.pop_front();
+  ASSERT_EQ(i1, l.front());  l.pop_front();  // Same priority: First in, first out
+  ASSERT_EQ(i3, l.front());
+
+  registry.ListJobs(l, JobState_Pending, 1, 2);
+  ASSERT_EQ(2u, l.size());
+  ASSERT_EQ(i4, l.front());
+  ASSERT_EQ(i1, l.back());
+
+  registry.ListJobs(l, JobState_Pending, 10, 0);
+  ASSERT_TRUE(l.empty());
+
+  ASSERT_TRUE(registry.SetPriority(i3, 40));
+  ASSERT_TRUE(registry.Pause(i1));
+
+  registry.ListJobs(l, JobState_Pending, 0, 0);
+  ASSERT_EQ(3u, l.size());
+  ASSERT_EQ(i3, l.front());
+
+  registry.ListJobs(l, JobState_Paused, 0, 0);
+  ASSERT_EQ(1u, l.size());
+  ASSERT_EQ(i1, l.front());
+
+  unsigned int pending, running;
+  registry.GetStatistics(pending, running);
+  ASSERT_EQ(3u, pending);
+  ASSERT_EQ(1u, running);  // Paused jobs are counted as running
+
+  {
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_EQ(i3, job.GetId());
+    job.MarkSuccess();
+  }
+
+  ASSERT_TRUE(registry.Cancel(i4));
+
+  registry.ListJobs(l, JobState_Success, 0, 0);
+  ASSERT_EQ(1u, l.size());
+  ASSERT_EQ(i3, l.front());
+
+  registry.ListJobs(l, JobState_Failure, 0, 0);
+  ASSERT_EQ(1u, l.size());
+  ASSERT_EQ(i4, l.front());
+
+  registry.GetStatistics(pending, running);
+  ASSERT_EQ(1u, pending);
+  ASSERT_EQ(1u, running);
+
+  ASSERT_TRUE(registry.DeleteJobInfo(i3));
+  registry.ListJobs(l, JobState_Success, 0, 0);
+  ASSERT_TRUE(l.empty());
+}
+
+
 TEST(JobsEngine, SubmitAndWait)
 {
   JobsEngine engine(10);
@@ -849,10 +1218,94 @@ TEST(JobsEngine, SubmitAndWait)
   ASSERT_THROW(engine.GetRegistry().SubmitAndWait(content, new DummyJob(true), rand() % 10), OrthancException);
   ASSERT_EQ(Json::nullValue, content.type());
 
+  std::string id;
+  content = Json::nullValue;
+  ASSERT_TRUE(engine.GetRegistry().SubmitAndWait(content, id, new DummyJob(), rand() % 10, 10000));
+  ASSERT_FALSE(id.empty());
+  ASSERT_EQ("world", content["hello"].asString());
+
   engine.Stop();
 }
 
 
+TEST(JobsRegistry, SerializeModifiedJobs)
+{
+  JobsRegistry registry(10);
+
+  std::map<std::string, Json::Value> modified;
+  std::set<std::string> removed;
+  registry.SerializeModifiedJobs(modified, removed);
+  ASSERT_TRUE(modified.empty());
+  ASSERT_TRUE(removed.empty());
+
+  std::string i1, i2;
+  registry.Submit(i1, new DummyJob(), 10);
+  registry.Submit(i2, new DummyJob(), 20);
+
+  registry.SerializeModifiedJobs(modified, removed);
+  ASSERT_EQ(2u, modified.size());
+  ASSERT_TRUE(removed.empty());
+  ASSERT_EQ(10, modified[i1]["Priority"].asInt());
+  ASSERT_EQ(20, modified[i2]["Priority"].asInt());
+
+  // Nothing has changed since the previous call
+  registry.SerializeModifiedJobs(modified, removed);
+  ASSERT_TRUE(modified.empty());
+  ASSERT_TRUE(removed.empty());
+
+  ASSERT_TRUE(registry.SetPriority(i2, 30));
+  registry.SerializeModifiedJobs(modified, removed);
+  ASSERT_EQ(1u, modified.size());
+  ASSERT_EQ(30, modified[i2]["Priority"].asInt());
+
+  ASSERT_TRUE(registry.Cancel(i1));
+  ASSERT_TRUE(registry.DeleteJobInfo(i1));
+  registry.SerializeModifiedJobs(modified, removed);
+  ASSERT_TRUE(modified.empty());
+  ASSERT_EQ(1u, removed.size());
+  ASSERT_EQ(i1, *removed.begin());
+
+  std::set<std::string> retry;
+  retry.insert(i2);
+  registry.MarkModifiedJobs(retry);
+  registry.SerializeModifiedJobs(modified, removed);
+  ASSERT_EQ(1u, modified.size());
+  ASSERT_TRUE(removed.empty());
+
+  // Reload the job in another registry, one job at a time
+  Json::Value serialized = modified[i2];
+
+  {
+    JobsRegistry registry2(10);
+    DummyUnserializer unserializer;
+    ASSERT_TRUE(registry2.AddSerializedJob(unserializer, i2, serialized));
+    ASSERT_FALSE(registry2.AddSerializedJob(unserializer, "nope", Json::objectValue));
+
+    JobState state;
+    ASSERT_TRUE(registry2.GetState(state, i2));
+    ASSERT_EQ(JobState_Pending, state);
+
+    // A reloaded job is not reported as modified
+    registry2.SerializeModifiedJobs(modified, removed);
+    ASSERT_TRUE(modified.empty());
+    ASSERT_TRUE(removed.empty());
+  }
+}
+
+
+TEST(JobsRegistry, SubmitAndWaitTimeout)
+{
+  // No worker is running the jobs of this registry
+  JobsRegistry registry(10);
+
+  std::string id;
+  Json::Value content = Json::nullValue;
+  ASSERT_FALSE(registry.SubmitAndWait(content, id, new DummyJob(), 0, 50));
+  ASSERT_EQ(Json::nullValue, content.type());
+  ASSERT_TRUE(CheckState(registry, id, JobState_Pending));
+}
+
+
 TEST(JobsEngine, SequenceOfOperationsJob)
 {
   JobsEngine engine(10);
@@ -1275,6 +1728,20 @@ TEST(JobsSerialization, Registry)
     registry.Serialize(t);
     ASSERT_TRUE(CheckSameJson(s, t));
   }
+
+  {
+    // Reload a registry that was serialized as a whole into an
+    // existing registry (new in Orthanc 1.12.12)
+    DummyUnserializer unserializer;
+    JobsRegistry registry(10);
+    ASSERT_EQ(2u, registry.AddSerializedJobs(unserializer, s));
+
+    Json::Value t;
+    registry.Serialize(t);
+    ASSERT_TRUE(CheckSameJson(s, t));
+
+    ASSERT_THROW(registry.AddSerializedJobs(unserializer, Json::objectValue), OrthancException);
+  }
 }
 
 
@@ -1426,6 +1893,51 @@ TEST(JobsSerialization, TrailingStep)
 }
 
 
+TEST(JobsSerialization, BatchedSteps)
+{
+  ASSERT_EQ(0u, SetOfCommandsJob::GetDefaultStepDuration());
+
+  {
+    DummyInstancesJob job;
+    ASSERT_EQ(0u, job.GetStepDuration());
+    job.SetStepDuration(10000);  // Large enough for all the instances to be handled at once
+    job.AddInstance("hello");
+    job.AddInstance("nope");
+    job.AddInstance("world");
+    job.AddTrailingStep();
+    job.SetPermissive(true);
+
+    job.Start();
+    ASSERT_EQ(JobStepCode_Success, job.Step("jobId").GetCode());
+    ASSERT_EQ(4u, job.GetPosition());
+    ASSERT_TRUE(job.IsTrailingStepDone());
+    ASSERT_EQ(1u, job.GetFailedInstances().size());
+    ASSERT_TRUE(job.IsFailedInstance("nope"));
+  }
+
+  {
+    DummyInstancesJob job;
+    job.SetStepDuration(10000);
+    job.AddInstance("hello");
+    job.AddInstance("nope");
+    job.AddInstance("world");
+
+    // Not permissive: The batch stops at the first error
+    job.Start();
+    ASSERT_EQ(JobStepCode_Failure, job.Step("jobId").GetCode());
+    ASSERT_EQ(1u, job.GetPosition());
+  }
+
+  SetOfCommandsJob::SetDefaultStepDuration(10000);
+
+  {
+    DummyInstancesJob job;
+    ASSERT_EQ(10000u, job.GetStepDuration());
+  }
+
+  SetOfCommandsJob::SetDefaultStepDuration(0);
+}
+
 TEST(JobsSerialization, RemoteModalityParameters)
 {
   Json::Value s;
@@ -1573,6 +2085,71 @@ TEST(JobsSerialization, RemoteModalityParameters)
     ASSERT_EQ("hello", modality.GetLocalAet());
     ASSERT_TRUE(modality.HasTimeout());
     ASSERT_EQ(42u, modality.GetTimeout());
+    ASSERT_EQ(1u, modality.GetMaxParallelAssociations());
+  }
+
+  s = Json::nullValue;
+
+  {
+    RemoteModalityParameters modality;
+    ASSERT_THROW(modality.SetMaxParallelAssociations(0), OrthancException);
+    modality.SetMaxParallelAssociations(4);
+    ASSERT_TRUE(modality.IsAdvancedFormatNeeded());
+    modality.Serialize(s, false);
+    ASSERT_EQ(Json::objectValue, s.type());
+  }
+
+  {
+    RemoteModalityParameters modality(s);
+    ASSERT_EQ(4u, modality.GetMaxParallelAssociations());
+    ASSERT_EQ(1u, modality.GetMaxOperationsInvoked());
+  }
+
+  s["MaxParallelAssociations"] = 0;
+  ASSERT_THROW(RemoteModalityParameters m(s), OrthancException);
+
+  s = Json::nullValue;
+
+  {
+    RemoteModalityParameters modality;
+    ASSERT_THROW(modality.SetMaxOperationsInvoked(0), OrthancException);
+    ASSERT_THROW(modality.SetMaxOperationsInvoked(65536), OrthancException);
+    modality.SetMaxOperationsInvoked(16);
+    ASSERT_TRUE(modality.IsAdvancedFormatNeeded());
+    modality.Serialize(s, false);
+    ASSERT_EQ(Json::objectValue, s.type());
+  }
+
+  {
+    RemoteModalityParameters modality(s);
+    ASSERT_EQ(1u, modality.GetMaxParallelAssociations());
+    ASSERT_EQ(16u, modality.GetMaxOperationsInvoked());
+  }
+
+  s = Json::nullValue;
+
+  {
+    RemoteModalityParameters modality;
+    ASSERT_FALSE(modality.HasMaximumPduLength());
+    ASSERT_THROW(modality.SetMaximumPduLength(1024), OrthancException);
+    modality.SetMaximumPduLength(65536);
+    ASSERT_TRUE(modality.IsAdvancedFormatNeeded());
+    modality.Serialize(s, false);
+    ASSERT_EQ(Json::objectValue, s.type());
+  }
+
+  {
+    RemoteModalityParameters modality(s);
+    ASSERT_TRUE(modality.HasMaximumPduLength());
+    ASSERT_EQ(65536u, modality.GetMaximumPduLength());
+
+    DicomAssociationParameters params("ORTHANC", modality);
+    ASSERT_EQ(65536u, params.GetMaximumPduLength());
+
+    modality.SetMaximumPduLength(0);
+    ASSERT_FALSE(modality.HasMaximumPduLength());
+    DicomAssociationParameters params2("ORTHANC", modality);
+    ASSERT_EQ(DicomAssociationParameters::GetDefaultMaximumPduLength(), params2.GetMaximumPduLength());
   }
 
   {
@@ -1903,3 +2480,445 @@ TEST(ThreadPool, Basic)
 
   ASSERT_EQ(11u, counter_);
 }
+
+
+namespace
+{
+  class ChecksumCallable : public ICallable
+  {
+  private:
+    unsigned int  value_;
+
+  public:
+    explicit ChecksumCallable(unsigned int value) :
+      value_(value)
+    {
+    }
+
+    virtual IDynamicObject* Call() ORTHANC_OVERRIDE
+    {
+      unsigned int checksum = value_;
+      for (unsigned int i = 0; i < 100; i++)
+      {
+        checksum = checksum * 31 + i;
+      }
+
+      return new SingleValueObject<unsigned int>(checksum % 1000);
+    }
+  };
+
+
+  class FanOutRunnable : public IRunnable
+  {
+  private:
+    IExecutorService&  executor_;
+    boost::mutex&      mutex_;
+    unsigned int&      count_;
+    unsigned int       depth_;
+
+  public:
+    FanOutRunnable(IExecutorService& executor,
+                   boost::mutex& mutex,
+                   unsigned int& count,
+                   unsigned int depth) :
+      executor_(executor),
+      mutex_(mutex),
+      count_(count),
+      depth_(depth)
+    {
+    }
+
+    virtual void Run() ORTHANC_OVERRIDE
+    {
+      if (depth_ > 0)
+      {
+        // Submitted from a worker, to its own deque
+        executor_.Submit(new FanOutRunnable(executor_, mutex_, count_, depth_ - 1));
+        executor_.Submit(new FanOutRunnable(executor_, mutex_, count_, depth_ - 1));
+      }
+
+      boost::mutex::scoped_lock lock(mutex_);
+      count_++;
+    }
+  };
+}
+
+
+TEST(WorkStealingThreadPool, Basic)
+{
+  WorkStealingThreadPool pool;
+  ASSERT_THROW(pool.SetCountThreads(0), OrthancException);
+  ASSERT_THROW(pool.SetDequeueTimeout(0), OrthancException);
+  pool.SetDequeueTimeout(1);
+  pool.SetCountThreads(4);
+  ASSERT_EQ(4u, pool.GetCountThreads());
+  ASSERT_EQ(1u, pool.GetDequeueTimeout());
+
+  ASSERT_THROW(pool.Submit(new ChecksumCallable(0)), OrthancException);
+  ASSERT_THROW(pool.Stop(), OrthancException);
+
+  pool.Start();
+  ASSERT_THROW(pool.Start(), OrthancException);
+  ASSERT_THROW(pool.SetCountThreads(2), OrthancException);
+
+  {
+    std::vector< boost::shared_ptr<Future> > futures;
+    for (unsigned int i = 0; i < 1000; i++)
+    {
+      futures.push_back(boost::shared_ptr<Future>(pool.Submit(new ChecksumCallable(i))));
+    }
+
+    std::unique_ptr<Future> failure(pool.Submit(new ExceptionCallable));
+
+    for (unsigned int i = 0; i < futures.size(); i++)
+    {
+      std::unique_ptr<IDynamicObject> result(futures[i]->ReleaseResult());
+      ChecksumCallable reference(i);
+      std::unique_ptr<IDynamicObject> expected(reference.Call());
+      ASSERT_EQ(dynamic_cast< SingleValueObject<unsigned int>&>(*expected).GetValue(),
+                dynamic_cast< SingleValueObject<unsigned int>&>(*result).GetValue());
+    }
+
+    try
+    {
+      std::unique_ptr<IDynamicObject> result(failure->ReleaseResult());
+      ASSERT_TRUE(false);
+    }
+    catch (OrthancException& e)
+    {
+      ASSERT_EQ(ErrorCode_NetworkProtocol, e.GetErrorCode());
+    }
+  }
+
+  {
+    boost::mutex mutex;
+    unsigned int count = 0;
+
+    // The children of each task are stolen by the other workers. Depth 9 gives 2^10 - 1 tasks.
+    pool.Submit(new FanOutRunnable(pool, mutex, count, 9));
+
+    for (unsigned int i = 0; i < 1000; i++)
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex);
+        if (count == 1023u)
+        {
+          break;
+        }
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+    ASSERT_EQ(1023u, count);
+  }
+
+  pool.Stop();
+  ASSERT_THROW(pool.Stop(), OrthancException);
+  ASSERT_THROW(pool.Submit(new ChecksumCallable(0)), OrthancException);
+
+  // The pool can be restarted with another number of threads
+  pool.SetCountThreads(2);
+  pool.Start();
+
+  {
+    std::unique_ptr<Future> future(pool.Submit(new ChecksumCallable(42)));
+    std::unique_ptr<IDynamicObject> result(future->ReleaseResult());
+    ASSERT_TRUE(dynamic_cast< SingleValueObject<unsigned int>*>(result.get()) != NULL);
+  }
+}
+
+
+template <typename Pool>
+static void RunExecutorContentionBenchmark(const char* name,
+                                           unsigned int countThreads,
+                                           unsigned int countTasks)
+{
+  Pool pool;
+  pool.SetCountThreads(countThreads);
+  pool.Start();
+
+  ElapsedTimer timer;
+
+  std::vector< boost::shared_ptr<Future> > futures;
+  futures.reserve(countTasks);
+
+  for (unsigned int i = 0; i < countTasks; i++)
+  {
+    futures.push_back(boost::shared_ptr<Future>(pool.Submit(new ChecksumCallable(i))));
+  }
+
+  uint64_t sum = 0;
+  for (size_t i = 0; i < futures.size(); i++)
+  {
+    std::unique_ptr<IDynamicObject> result(futures[i]->ReleaseResult());
+    sum += dynamic_cast< SingleValueObject<unsigned int>&>(*result).GetValue();
+  }
+
+  printf("%s with %u threads: %s for %u tasks (checksum %u)\n", name, countThreads,
+         timer.GetHumanElapsedDuration().c_str(), countTasks, static_cast<unsigned int>(sum));
+
+  pool.Stop();
+}
+
+
+TEST(WorkStealingThreadPool, DISABLED_ContentionBenchmark)
+{
+  static const unsigned int COUNT_TASKS = 200000;
+
+  for (unsigned int threads = 1; threads <= 16; threads *= 2)
+  {
+    RunExecutorContentionBenchmark<ThreadPool>("ThreadPool", threads, COUNT_TASKS);
+    RunExecutorContentionBenchmark<WorkStealingThreadPool>("WorkStealingThreadPool", threads, COUNT_TASKS);
+  }
+}
+
+
+namespace
+{
+  class CountingTask : public IRunnable
+  {
+  private:
+    boost::mutex&  mutex_;
+    unsigned int&  count_;
+    unsigned int&  running_;
+    unsigned int&  maxRunning_;
+
+  public:
+    CountingTask(boost::mutex& mutex,
+                 unsigned int& count,
+                 unsigned int& running,
+                 unsigned int& maxRunning) :
+      mutex_(mutex),
+      count_(count),
+      running_(running),
+      maxRunning_(maxRunning)
+    {
+    }
+
+    virtual void Run() ORTHANC_OVERRIDE
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        running_++;
+        maxRunning_ = std::max(maxRunning_, running_);
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        running_--;
+        count_++;
+      }
+    }
+  };
+}
+
+
+TEST(JobTasksExecutor, Basic)
+{
+  boost::mutex mutex;
+  unsigned int count = 0;
+  unsigned int running = 0;
+  unsigned int maxRunning = 0;
+
+  JobTasksExecutor executor;
+  ASSERT_FALSE(executor.ExecuteOne(0));
+  ASSERT_FALSE(executor.HasTasks());
+
+  {
+    // No thread in the executor: The sub-tasks are executed by the waiting thread
+    JobTasksExecutor::Group group(executor, 0);
+    ASSERT_TRUE(group.Wait(0));
+
+    group.Submit(new CountingTask(mutex, count, running, maxRunning));
+    group.Submit(new CountingTask(mutex, count, running, maxRunning));
+    ASSERT_TRUE(executor.HasTasks());
+    ASSERT_TRUE(executor.ExecuteOne(0));  // Stolen by another thread
+    ASSERT_EQ(1u, count);
+
+    ASSERT_TRUE(group.Wait(0));
+    ASSERT_EQ(2u, count);
+    ASSERT_FALSE(executor.HasTasks());
+  }
+
+  {
+    JobTasksExecutor::Group group(executor, 0);
+    group.Submit(new CountingTask(mutex, count, running, maxRunning));
+    group.Cancel();
+    ASSERT_FALSE(executor.HasTasks());
+    ASSERT_TRUE(group.Wait(0));
+    ASSERT_EQ(2u, count);
+  }
+
+  executor.Start(4);
+  ASSERT_THROW(executor.Start(4), OrthancException);
+
+  {
+    // At most 2 sub-tasks of the group at the same time
+    JobTasksExecutor::Group group(executor, 2);
+
+    for (unsigned int i = 0; i < 50; i++)
+    {
+      group.Submit(new CountingTask(mutex, count, running, maxRunning));
+    }
+
+    ASSERT_TRUE(group.Wait(0));
+    ASSERT_EQ(52u, count);
+    ASSERT_EQ(0u, running);
+    ASSERT_LE(maxRunning, 2u);
+  }
+
+  {
+    // The destructor cancels the pending sub-tasks, and waits for the running ones
+    JobTasksExecutor::Group group(executor, 1);
+
+    for (unsigned int i = 0; i < 1000; i++)
+    {
+      group.Submit(new CountingTask(mutex, count, running, maxRunning));
+    }
+
+    ASSERT_FALSE(group.Wait(1));
+  }
+
+  ASSERT_EQ(0u, running);
+  ASSERT_LT(count, 1052u);
+
+  executor.Stop();
+}
+
+
+static void LockFairSharedMutex(FairSharedMutex* mutex,
+                                bool* done)
+{
+  boost::unique_lock<FairSharedMutex> lock(*mutex);
+  *done = true;
+}
+
+TEST(FairSharedMutex, Basic)
+{
+  FairSharedMutex mutex;
+
+  {
+    boost::shared_lock<FairSharedMutex> lock1(mutex);
+    boost::shared_lock<FairSharedMutex> lock2(mutex);
+    ASSERT_EQ(2u, mutex.GetActiveReadersCount());
+    ASSERT_FALSE(mutex.try_lock());
+  }
+
+  ASSERT_EQ(0u, mutex.GetActiveReadersCount());
+
+  {
+    boost::unique_lock<FairSharedMutex> lock(mutex);
+    ASSERT_FALSE(mutex.try_lock());
+    ASSERT_FALSE(mutex.try_lock_shared());
+    ASSERT_FALSE(mutex.try_lock_upgrade());
+  }
+
+  {
+    // The upgradeable read access coexists with the readers, but
+    // not with the other upgraders or with the writers
+    boost::upgrade_lock<FairSharedMutex> upgrade(mutex);
+    ASSERT_FALSE(mutex.try_lock_upgrade());
+    ASSERT_FALSE(mutex.try_lock());
+
+    ASSERT_TRUE(mutex.try_lock_shared());
+    mutex.unlock_shared();
+
+    {
+      boost::upgrade_to_unique_lock<FairSharedMutex> exclusive(upgrade);
+      ASSERT_FALSE(mutex.try_lock_shared());
+    }
+
+    ASSERT_TRUE(mutex.try_lock_shared());
+    mutex.unlock_shared();
+  }
+
+  ASSERT_TRUE(mutex.try_lock());
+  mutex.unlock();
+
+  ASSERT_THROW(mutex.unlock(), OrthancException);
+  ASSERT_THROW(mutex.unlock_shared(), OrthancException);
+  ASSERT_THROW(mutex.unlock_upgrade(), OrthancException);
+}
+
+TEST(FairSharedMutex, WriterIsNotStarved)
+{
+  FairSharedMutex mutex;
+  bool done = false;
+
+  std::unique_ptr<boost::shared_lock<FairSharedMutex> > reader(new boost::shared_lock<FairSharedMutex>(mutex));
+
+  boost::thread writer(LockFairSharedMutex, &mutex, &done);
+
+  while (mutex.GetWaitingWritersCount() == 0)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+  }
+
+  // The new readers are queued behind the waiting writer
+  ASSERT_FALSE(mutex.try_lock_shared());
+  ASSERT_FALSE(done);
+
+  reader.reset();
+  writer.join();
+  ASSERT_TRUE(done);
+
+  ASSERT_TRUE(mutex.try_lock_shared());
+  mutex.unlock_shared();
+}
+
+
+#if ORTHANC_ENABLE_LOCK_PROFILING == 1
+static void HoldProfiledMutex(boost::mutex* mutex,
+                              LockProfiler* profiler)
+{
+  ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, *mutex, *profiler);
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+}
+
+TEST(LockProfiler, Basic)
+{
+  LockProfiler profiler("UnitTests");
+  boost::mutex mutex;
+
+  {
+    ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex, profiler);
+    ASSERT_TRUE(lock.owns_lock());
+  }
+
+  ASSERT_EQ(1u, profiler.GetAcquisitionsCount());
+  ASSERT_EQ(0u, profiler.GetContendedCount());
+
+  {
+    boost::thread t(HoldProfiledMutex, &mutex, &profiler);
+
+    while (profiler.GetAcquisitionsCount() < 2u)
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+    {
+      ORTHANC_PROFILED_LOCK(boost::mutex::scoped_lock, lock, mutex, profiler);
+    }
+
+    t.join();
+  }
+
+  ASSERT_EQ(3u, profiler.GetAcquisitionsCount());
+  ASSERT_EQ(1u, profiler.GetContendedCount());
+
+  MetricsRegistry registry;
+  LockProfiler::PublishMetrics(registry);
+
+  std::string s;
+  registry.ExportPrometheusText(s);
+  ASSERT_NE(std::string::npos, s.find("orthanc_lock_acquisitions_count{mutex=\"UnitTests\"} 3"));
+  ASSERT_NE(std::string::npos, s.find("orthanc_lock_contended_count{mutex=\"UnitTests\"} 1"));
+  ASSERT_NE(std::string::npos, s.find("orthanc_lock_wait_us_count{mutex=\"UnitTests\"} 3"));
+  ASSERT_NE(std::string::npos, s.find("orthanc_lock_hold_us_count{mutex=\"UnitTests\"} 3"));
+  ASSERT_NE(std::string::npos, s.find("waiter=\"TestBody\""));
+}
+#endif
@@ -182,3 +182,47 @@ TEST(Lua, ReturnJson)
     ASSERT_EQ(s, t);
   }
 }
+
+
+TEST(Lua, Compiled)
+{
+  std::string compiled;
+
+  {
+    Orthanc::LuaContext lua;
+    lua.Compile(compiled, "function twice(s) return s .. s end");
+    ASSERT_FALSE(lua.IsExistingFunction("twice"));  // Compiling doesn't run the chunk
+    ASSERT_THROW(lua.Compile(compiled, "function ("), Orthanc::OrthancException);
+    lua.Compile(compiled, "function twice(s) return s .. s end");
+  }
+
+  Orthanc::LuaContext lua;
+  ASSERT_THROW(lua.Execute(compiled), Orthanc::OrthancException);  // Bytecode is refused by "Execute()"
+  lua.ExecuteCompiled(compiled);
+  ASSERT_TRUE(lua.IsExistingFunction("twice"));
+
+  {
+    Orthanc::LuaFunctionCall f(lua, "twice");
+    f.PushString("ab");
+    std::string s;
+    f.ExecuteToString(s);
+    ASSERT_EQ("abab", s);
+  }
+
+  lua.Execute("function identity(a) return a end");
+
+  {
+    std::map<std::string, std::string> m;
+    m["Hello"] = "World";
+    m["Empty"] = "";
+
+    Orthanc::LuaFunctionCall f(lua, "identity");
+    f.PushStringMap(m);
+    Json::Value v;
+    f.ExecuteToJson(v, true);
+    ASSERT_EQ(Json::objectValue, v.type());
+    ASSERT_EQ(2u, v.size());
+    ASSERT_EQ("World", v["Hello"].asString());
+    ASSERT_EQ("", v["Empty"].asString());
+  }
+}
@@ -316,6 +316,89 @@ TEST(LRU, SharedArchive)
 }
 
 
+TEST(LRU, SharedArchiveStatistics)
+{
+  Orthanc::SharedArchive a(3);
+  const std::string first = a.Add(new S("First item"));
+  a.Add(new S("Second item"));
+  a.Add(new S("Third item"));
+  a.Add(new S("Fourth item"));
+  ASSERT_EQ(3u, a.GetNumberOfItems());
+
+  ASSERT_FALSE(Orthanc::SharedArchive::Accessor(a, first).IsValid());  // Evicted
+
+  const std::string last = a.Add(new S("Last item"));
+  ASSERT_TRUE(Orthanc::SharedArchive::Accessor(a, last).IsValid());
+
+  ASSERT_THROW(a.SetMaximumSize(0), Orthanc::OrthancException);
+  a.SetMaximumSize(1);
+  ASSERT_EQ(1u, a.GetMaximumSize());
+  ASSERT_EQ(1u, a.GetNumberOfItems());
+  ASSERT_TRUE(Orthanc::SharedArchive::Accessor(a, last).IsValid());
+
+  Orthanc::CacheStatistics statistics;
+  a.GetStatistics(statistics);
+  ASSERT_EQ(2u, statistics.GetHits());
+  ASSERT_EQ(1u, statistics.GetMisses());
+  ASSERT_EQ(4u, statistics.GetEvictions());
+  ASSERT_EQ(0u, statistics.GetLoads());
+}
+
+
+namespace
+{
+  class SizedItem : public Orthanc::IDynamicObject, public Orthanc::ICacheable
+  {
+  private:
+    size_t size_;
+
+  public:
+    explicit SizedItem(size_t size) : size_(size)
+    {
+    }
+
+    virtual size_t GetMemoryUsage() const ORTHANC_OVERRIDE
+    {
+      return size_;
+    }
+  };
+}
+
+
+TEST(LRU, SharedArchiveMemoryUsage)
+{
+  Orthanc::SharedArchive a(10);
+  ASSERT_EQ(0u, a.GetMaximumMemoryUsage());
+
+  const std::string first = a.Add(new SizedItem(100));
+  a.Add(new S("Not accounted"));
+  a.Add(new SizedItem(200));
+  ASSERT_EQ(3u, a.GetNumberOfItems());
+  ASSERT_EQ(300u, a.GetMemoryUsage());
+
+  a.SetMaximumMemoryUsage(250);
+  ASSERT_EQ(2u, a.GetNumberOfItems());
+  ASSERT_EQ(200u, a.GetMemoryUsage());
+  ASSERT_FALSE(Orthanc::SharedArchive::Accessor(a, first).IsValid());
+
+  // The most recent object is kept, even if it is larger than the quota
+  const std::string large = a.Add(new SizedItem(1000));
+  ASSERT_EQ(1u, a.GetNumberOfItems());
+  ASSERT_EQ(1000u, a.GetMemoryUsage());
+  ASSERT_TRUE(Orthanc::SharedArchive::Accessor(a, large).IsValid());
+
+  a.Remove(large);
+  ASSERT_EQ(0u, a.GetNumberOfItems());
+  ASSERT_EQ(0u, a.GetMemoryUsage());
+
+  a.SetTimeToLive(3600);
+  ASSERT_EQ(3600u, a.GetTimeToLive());
+  const std::string item = a.Add(new SizedItem(10));
+  a.RemoveExpired();
+  ASSERT_TRUE(Orthanc::SharedArchive::Accessor(a, item).IsValid());
+}
+
+
 TEST(MemoryStringCache, Basic)
 {
   Orthanc::MemoryStringCache c;
@@ -394,6 +477,221 @@ TEST(MemoryStringCache, Invalidate)
 }
 
 
+TEST(MemoryStringCache, Shards)
+{
+  Orthanc::MemoryStringCache c;
+  ASSERT_EQ(1u, c.GetNumberOfShards());
+  ASSERT_THROW(c.SetNumberOfShards(0), Orthanc::OrthancException);
+
+  c.SetMaximumSize(1000);
+  c.SetNumberOfShards(4);
+  ASSERT_EQ(4u, c.GetNumberOfShards());
+  ASSERT_EQ(1000u, c.GetMaximumSize());
+
+  std::string v;
+
+  {
+    Orthanc::MemoryStringCache::Accessor a(c);
+
+    for (unsigned int i = 0; i < 20; i++)
+    {
+      const std::string key = "key" + boost::lexical_cast<std::string>(i);
+      ASSERT_FALSE(a.Fetch(v, key));
+      a.Add(key, std::string(10, 'a' + i));
+    }
+
+    ASSERT_EQ(20u, c.GetNumberOfItems());
+    ASSERT_EQ(200u, c.GetCurrentSize());
+
+    for (unsigned int i = 0; i < 20; i++)
+    {
+      ASSERT_TRUE(a.Fetch(v, "key" + boost::lexical_cast<std::string>(i)));
+      ASSERT_EQ(std::string(10, 'a' + i), v);
+    }
+
+    // Larger than one shard (250 bytes), hence not cached
+    ASSERT_FALSE(a.Fetch(v, "large"));
+    a.Add("large", std::string(300, 'z'));
+    ASSERT_FALSE(a.Fetch(v, "large"));
+    a.Add("large", std::string(300, 'z'));
+
+    c.Invalidate("key3");
+    ASSERT_FALSE(a.Fetch(v, "key3"));
+    a.Add("key3", "hello");
+    ASSERT_EQ(19u * 10u + 5u, c.GetCurrentSize());
+
+    c.SetMaximumSize(0);
+    ASSERT_EQ(0u, c.GetCurrentSize());
+    ASSERT_EQ(0u, c.GetNumberOfItems());
+  }
+
+  c.SetMaximumSize(1000);
+  c.SetNumberOfShards(1);
+
+  {
+    Orthanc::MemoryStringCache::Accessor a(c);
+    ASSERT_FALSE(a.Fetch(v, "large"));
+    a.Add("large", std::string(300, 'z'));
+    ASSERT_TRUE(a.Fetch(v, "large"));
+    ASSERT_EQ(300u, v.size());
+  }
+}
+
+
+TEST(MemoryStringCache, NumaAware)
+{
+  Orthanc::MemoryStringCache c;
+  c.SetMaximumSize(1000);
+  c.SetNumberOfShards(2);
+  c.SetNumaAware(true);
+
+  // The number of shards is per NUMA node, which depends on the host
+  ASSERT_EQ(2u, c.GetNumberOfShards());
+  ASSERT_LE(1u, c.GetNumaNodesCount());
+  ASSERT_EQ(1000u, c.GetMaximumSize());
+
+  std::string v;
+
+  {
+    Orthanc::MemoryStringCache::Accessor a(c);
+    a.Add("hello", "world");
+    ASSERT_TRUE(a.Fetch(v, "hello"));
+    ASSERT_EQ("world", v);
+    ASSERT_EQ(1u, c.GetNumberOfItems());
+
+    c.Invalidate("hello");
+    ASSERT_FALSE(a.Fetch(v, "hello"));
+    ASSERT_EQ(0u, c.GetNumberOfItems());
+  }
+
+  c.SetNumaAware(false);
+  ASSERT_EQ(1u, c.GetNumaNodesCount());
+  ASSERT_EQ(2u, c.GetNumberOfShards());
+}
+
+
+TEST(MemoryStringCache, TwoQueues)
+{
+  Orthanc::MemoryStringCache c;
+  c.SetMaximumSize(100);
+  c.SetPolicy(Orthanc::CachePolicy_TwoQueues);
+  ASSERT_EQ(Orthanc::CachePolicy_TwoQueues, c.GetPolicy());
+
+  std::string v;
+  Orthanc::MemoryStringCache::Accessor a(c);
+
+  // "hot" is accessed twice, hence promoted to the protected queue
+  ASSERT_FALSE(a.Fetch(v, "hot"));
+  a.Add("hot", std::string(10, 'h'));
+  ASSERT_TRUE(a.Fetch(v, "hot"));
+
+  // A sequential scan over items that are accessed only once
+  for (unsigned int i = 0; i < 50; i++)
+  {
+    const std::string key = "scan" + boost::lexical_cast<std::string>(i);
+    ASSERT_FALSE(a.Fetch(v, key));
+    a.Add(key, std::string(10, 's'));
+  }
+
+  ASSERT_LE(c.GetCurrentSize(), 100u);
+  ASSERT_TRUE(a.Fetch(v, "hot"));
+  ASSERT_EQ(std::string(10, 'h'), v);
+  ASSERT_TRUE(a.Fetch(v, "scan49"));
+  ASSERT_FALSE(a.Fetch(v, "scan0"));
+  a.Add("scan0", std::string(10, 's'));
+  ASSERT_FALSE(a.Fetch(v, "scan40"));
+
+  // "scan40" was recently evicted from the probation queue: It is
+  // now directly inserted into the protected queue
+  a.Add("scan40", std::string(10, 's'));
+  for (unsigned int i = 100; i < 150; i++)
+  {
+    const std::string key = "scan" + boost::lexical_cast<std::string>(i);
+    ASSERT_FALSE(a.Fetch(v, key));
+    a.Add(key, std::string(10, 's'));
+  }
+
+  ASSERT_TRUE(a.Fetch(v, "hot"));
+  ASSERT_TRUE(a.Fetch(v, "scan40"));
+  ASSERT_FALSE(a.Fetch(v, "scan0"));
+  a.Add("scan0", "");
+
+  c.Invalidate("hot");
+  ASSERT_FALSE(a.Fetch(v, "hot"));
+  a.Add("hot", "");
+}
+
+
+TEST(MemoryStringCache, Statistics)
+{
+  Orthanc::MemoryStringCache c;
+  c.SetMaximumSize(10);
+
+  std::string v;
+
+  {
+    Orthanc::MemoryStringCache::Accessor a(c);
+    ASSERT_FALSE(a.Fetch(v, "a"));
+    a.Add("a", "hello");
+    ASSERT_TRUE(a.Fetch(v, "a"));
+    ASSERT_FALSE(a.Fetch(v, "b"));
+    a.Add("b", "world");
+    ASSERT_FALSE(a.Fetch(v, "c"));
+    a.Add("c", "!");  // Evicts "a"
+  }
+
+  {
+    Orthanc::MemoryStringCache::Accessor a(c, false);
+    ASSERT_FALSE(a.Fetch(v, "d"));
+    a.Add("d", "ignored");  // No admission, hence no load
+  }
+
+  Orthanc::CacheStatistics statistics;
+  c.GetStatistics(statistics);
+  ASSERT_EQ(1u, statistics.GetHits());
+  ASSERT_EQ(4u, statistics.GetMisses());
+  ASSERT_EQ(1u, statistics.GetEvictions());
+  ASSERT_EQ(3u, statistics.GetLoads());
+
+  c.SetNumberOfShards(4);
+  c.GetStatistics(statistics);
+  ASSERT_EQ(0u, statistics.GetHits());
+  ASSERT_EQ(0u, statistics.GetMisses());
+  ASSERT_FLOAT_EQ(0.0f, statistics.GetAverageLoadTimeMilliseconds());
+}
+
+
+TEST(MemoryStringCache, NoAdmission)
+{
+  Orthanc::MemoryStringCache c;
+  c.SetMaximumSize(100);
+
+  std::string v;
+
+  {
+    Orthanc::MemoryStringCache::Accessor a(c, false);
+    ASSERT_FALSE(a.Fetch(v, "a"));
+    a.Add("a", "hello");
+    ASSERT_EQ(0u, c.GetNumberOfItems());
+    ASSERT_FALSE(a.Fetch(v, "a"));
+  }
+
+  {
+    Orthanc::MemoryStringCache::Accessor a(c);
+    ASSERT_FALSE(a.Fetch(v, "a"));
+    a.Add("a", "hello");
+    ASSERT_EQ(1u, c.GetNumberOfItems());
+  }
+
+  {
+    // Accessors without admission still benefit from the cache
+    Orthanc::MemoryStringCache::Accessor a(c, false);
+    ASSERT_TRUE(a.Fetch(v, "a"));
+    ASSERT_EQ("hello", v);
+  }
+}
+
+
 static int ThreadingScenarioHappyStep = 0;
 static Orthanc::MemoryStringCache ThreadingScenarioHappyCache;
 
@@ -31,12 +31,15 @@
 
 #include "../Sources/ChunkedBuffer.h"
 #include "../Sources/Compression/ZlibCompressor.h"
+#include "../Sources/ElapsedTimer.h"
 #include "../Sources/HttpServer/HttpContentNegociation.h"
 #include "../Sources/HttpServer/MultipartStreamReader.h"
 #include "../Sources/HttpServer/StringMatcher.h"
 #include "../Sources/Logging.h"
 #include "../Sources/OrthancException.h"
 #include "../Sources/RestApi/RestApiHierarchy.h"
+#include "../Sources/RestApi/RestApiJsonWriter.h"
+#include "../Sources/Toolbox.h"
 #include "../Sources/WebServiceParameters.h"
 
 #include <ctype.h>
@@ -184,6 +187,126 @@ TEST(ChunkedBuffer, Basic)
 }
 
 
+namespace
+{
+  class ChunksAccumulator : public ChunkedBuffer::IVisitor
+  {
+  private:
+    std::string  content_;
+    size_t       count_;
+
+  public:
+    ChunksAccumulator() :
+      count_(0)
+    {
+    }
+
+    virtual void VisitChunk(const void* data,
+                            size_t size) ORTHANC_OVERRIDE
+    {
+      ASSERT_LT(0u, size);
+      content_.append(reinterpret_cast<const char*>(data), size);
+      count_++;
+    }
+
+    const std::string& GetContent() const
+    {
+      return content_;
+    }
+
+    size_t GetCount() const
+    {
+      return count_;
+    }
+  };
+}
+
+
+TEST(ChunkedBuffer, Visit)
+{
+  std::string expected;
+  for (size_t i = 0; i < 5 * ChunkedBuffer::POOLED_CHUNK_SIZE + 123; i++)
+  {
+    expected.push_back(static_cast<char>('a' + (i % 26)));
+  }
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    ChunkedBuffer b;
+
+    if (i == 0)
+    {
+      // Fixed-size chunks
+      b.AddChunk(expected.substr(0, 10));
+      b.AddChunk(expected.substr(10));
+    }
+    else
+    {
+      // Non-pooled chunks
+      b.SetPendingBufferSize(100);
+      b.AddChunk(expected.substr(0, 10));
+      b.AddChunk(expected.substr(10, 3 * ChunkedBuffer::POOLED_CHUNK_SIZE));
+      b.AddChunk(expected.substr(10 + 3 * ChunkedBuffer::POOLED_CHUNK_SIZE));
+    }
+
+    ASSERT_EQ(expected.size(), b.GetNumBytes());
+
+    {
+      ChunksAccumulator accumulator;
+      b.Visit(accumulator);
+      ASSERT_EQ(expected, accumulator.GetContent());
+
+      if (i == 0)
+      {
+        ASSERT_EQ(6u, accumulator.GetCount());
+      }
+    }
+
+    // Visiting doesn't modify the buffer
+    ASSERT_EQ(expected.size(), b.GetNumBytes());
+
+    std::string s;
+    b.Flatten(s);
+    ASSERT_EQ(expected, s);
+    ASSERT_EQ(0u, b.GetNumBytes());
+
+    ChunksAccumulator accumulator;
+    b.Visit(accumulator);
+    ASSERT_EQ(0u, accumulator.GetCount());
+  }
+}
+
+
+TEST(ChunkedBuffer, Pool)
+{
+  {
+    ChunkedBuffer b;
+    b.AddChunk(std::string(3 * ChunkedBuffer::POOLED_CHUNK_SIZE, 'x'));
+  }
+
+  // The full chunks and the pending buffer were given back to the pool
+  const size_t count = ChunkedBuffer::GetPooledChunksCount();
+  ASSERT_LE(1u, count);
+
+  {
+    ChunkedBuffer b;
+    ASSERT_EQ(count - 1, ChunkedBuffer::GetPooledChunksCount());
+
+    b.AddChunk(std::string(ChunkedBuffer::POOLED_CHUNK_SIZE / 2, 'y'));
+    b.AddChunk(std::string(ChunkedBuffer::POOLED_CHUNK_SIZE, 'z'));
+    ASSERT_EQ(count - 2, ChunkedBuffer::GetPooledChunksCount());
+
+    std::string s;
+    b.Flatten(s);
+    ASSERT_EQ(ChunkedBuffer::POOLED_CHUNK_SIZE / 2 * 3, s.size());
+    ASSERT_EQ('y', s[0]);
+    ASSERT_EQ('z', s[s.size() - 1]);
+  }
+
+  ASSERT_EQ(count, ChunkedBuffer::GetPooledChunksCount());
+}
+
+
 TEST(RestApi, ParseCookies)
 {
   HttpToolbox::Arguments headers;
@@ -245,6 +368,8 @@ TEST(RestApi, RestApiPath)
 
     ASSERT_EQ("d", uri.GetLevelName(2));
     ASSERT_THROW(uri.GetWildcardName(2), OrthancException);
+
+    ASSERT_EQ("/coucou/{abc}/d/*", uri.Format());
   }
 
   {
@@ -266,6 +391,8 @@ TEST(RestApi, RestApiPath)
 
     ASSERT_EQ("d", uri.GetLevelName(2));
     ASSERT_THROW(uri.GetWildcardName(2), OrthancException);
+
+    ASSERT_EQ("/coucou/{abc}/d", uri.Format());
   }
 
   {
@@ -279,6 +406,7 @@ TEST(RestApi, RestApiPath)
 
     ASSERT_EQ(0u, uri.GetLevelCount());
     ASSERT_TRUE(uri.IsUniversalTrailing());
+    ASSERT_EQ("/*", uri.Format());
   }
 }
 
@@ -719,6 +847,27 @@ TEST(WebServiceParameters, Serialization)
     ASSERT_TRUE(p2.LookupHttpHeader(s, "c")); ASSERT_EQ("d", s);
     ASSERT_FALSE(p2.LookupHttpHeader(s, "nope"));
   }
+
+  {
+    WebServiceParameters p;
+    ASSERT_EQ(1u, p.GetMaxParallelTransfers());
+    ASSERT_THROW(p.SetMaxParallelTransfers(0), OrthancException);
+    p.SetMaxParallelTransfers(4);
+    ASSERT_TRUE(p.IsAdvancedFormatNeeded());
+
+    Json::Value v2;
+    p.Serialize(v2, false, true);
+    ASSERT_EQ(Json::objectValue, v2.type());
+    ASSERT_EQ(4, v2["MaxParallelTransfers"].asInt());
+
+    WebServiceParameters p2(v2);
+    ASSERT_EQ(4u, p2.GetMaxParallelTransfers());
+    ASSERT_TRUE(p2.GetUserProperties().empty());
+
+    p2.SetMaxParallelTransfers(1);
+    p2.Serialize(v2, true, true);
+    ASSERT_FALSE(v2.isMember("MaxParallelTransfers"));
+  }
 }
 
 
@@ -1230,6 +1379,124 @@ TEST(ChunkedBuffer, Pending)
 }
 
 
+TEST(RestApiJsonWriter, Basic)
+{
+  ASSERT_THROW(RestApiJsonWriter(Json::stringValue), OrthancException);
+
+  {
+    RestApiJsonWriter writer(Json::arrayValue);
+
+    Json::Value v;
+    ASSERT_TRUE(Toolbox::ReadJson(v, writer.GetSerialized()));
+    ASSERT_EQ(Json::arrayValue, v.type());
+    ASSERT_EQ(0u, v.size());
+  }
+
+  {
+    RestApiJsonWriter writer(Json::objectValue);
+
+    Json::Value v;
+    ASSERT_TRUE(Toolbox::ReadJson(v, writer.GetSerialized()));
+    ASSERT_EQ(Json::objectValue, v.type());
+    ASSERT_EQ(0u, v.size());
+  }
+
+  Json::Value item = Json::objectValue;
+  item["Hello"] = "World";
+  item["Values"] = Json::arrayValue;
+  item["Values"].append(42);
+  item["Values"].append("\"quoted\"\n");
+
+  {
+    RestApiJsonWriter writer(Json::arrayValue);
+    writer.Append(item);
+    writer.Append("hello");
+    writer.Append(Json::objectValue);
+    ASSERT_THROW(writer.SetMember("a", item), OrthancException);
+    ASSERT_EQ(3u, writer.GetCount());
+
+    Json::Value expected = Json::arrayValue;
+    expected.append(item);
+    expected.append("hello");
+    expected.append(Json::objectValue);
+
+    Json::Value v;
+    ASSERT_TRUE(Toolbox::ReadJson(v, writer.GetSerialized()));
+    ASSERT_EQ(expected, v);
+
+    // The answer is closed
+    ASSERT_EQ(writer.GetSerialized(), writer.GetSerialized());
+    ASSERT_THROW(writer.Append(item), OrthancException);
+  }
+
+  {
+    RestApiJsonWriter writer(Json::objectValue);
+    writer.SetMember("first", item);
+    writer.SetMember("second \"key\"", 42);
+    ASSERT_THROW(writer.Append(item), OrthancException);
+
+    Json::Value expected = Json::objectValue;
+    expected["first"] = item;
+    expected["second \"key\""] = 42;
+
+    Json::Value v;
+    ASSERT_TRUE(Toolbox::ReadJson(v, writer.GetSerialized()));
+    ASSERT_EQ(expected, v);
+  }
+}
+
+
+TEST(RestApiJsonWriter, DISABLED_Benchmark)
+{
+  // Answer similar to "/studies?expand" for many studies
+  static const unsigned int COUNT = 20000;
+
+  Json::Value item = Json::objectValue;
+  item["ID"] = "6b9e19d9-62094390-5f9ddb01-4a191ae7-9766b715";
+  item["IsStable"] = true;
+  item["LastUpdate"] = "20260101T120000";
+  item["MainDicomTags"] = Json::objectValue;
+  item["MainDicomTags"]["StudyDate"] = "20260101";
+  item["MainDicomTags"]["StudyDescription"] = "Benchmark";
+  item["MainDicomTags"]["StudyInstanceUID"] = "1.2.840.113619.2.55.3.604688119.969.1268071029.320";
+  item["Series"] = Json::arrayValue;
+  for (unsigned int i = 0; i < 10; i++)
+  {
+    item["Series"].append("f2635388-f01d89f3-2d7ac749-fb1d7ab6-" + boost::lexical_cast<std::string>(i));
+  }
+
+  {
+    ElapsedTimer timer;
+
+    Json::Value answer = Json::arrayValue;
+    for (unsigned int i = 0; i < COUNT; i++)
+    {
+      Json::Value copy = item;
+      answer.append(copy);
+    }
+
+    std::string s;
+    Toolbox::WriteStyledJson(s, answer);
+    printf("Json::Value: %s for %u items (%u bytes)\n", timer.GetHumanElapsedDuration().c_str(),
+           COUNT, static_cast<unsigned int>(s.size()));
+  }
+
+  {
+    ElapsedTimer timer;
+
+    RestApiJsonWriter writer(Json::arrayValue);
+    for (unsigned int i = 0; i < COUNT; i++)
+    {
+      Json::Value copy = item;
+      writer.Append(copy);
+    }
+
+    printf("RestApiJsonWriter: %s for %u items (%u bytes)\n", timer.GetHumanElapsedDuration().c_str(),
+           COUNT, static_cast<unsigned int>(writer.GetSerialized().size()));
+  }
+}
+
+
 
 #if ORTHANC_SANDBOXED != 1
 
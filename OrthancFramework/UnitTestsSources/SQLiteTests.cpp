@@ -335,3 +335,83 @@ TEST(SQLite, Types)
     ASSERT_FALSE(s.Step());
   }
 }
+
+
+TEST(SQLite, DynamicStatementsCache)
+{
+  SQLite::Connection c;
+  c.OpenInMemory();
+  c.Execute("CREATE TABLE t(a INTEGER)");
+  c.Execute("INSERT INTO t VALUES(42)");
+
+  c.SetMaximumDynamicStatements(3);
+  ASSERT_EQ(3u, c.GetMaximumDynamicStatements());
+
+  const std::string sql1 = "SELECT a FROM t WHERE a=?";
+  const std::string sql2 = "SELECT a FROM t WHERE a>?";
+  const std::string sql3 = "SELECT a FROM t WHERE a<?";
+  const std::string sql4 = "SELECT a FROM t WHERE a<>?";
+
+  {
+    SQLite::Statement s(c, SQLITE_FROM_HERE, "SELECT COUNT(*) FROM t");  // Static statement, not counted
+    ASSERT_TRUE(s.Step());
+    ASSERT_EQ(1, s.ColumnInt(0));
+  }
+
+  for (int i = 0; i < 2; i++)
+  {
+    // The prepared statement is shared by different values of the parameter
+    SQLite::Statement s(c, SQLite::StatementId("test", 1, sql1), sql1);
+    s.BindInt(0, 42 + i);
+    ASSERT_EQ(i == 0, s.Step());
+  }
+
+  ASSERT_EQ(1u, c.GetDynamicStatementsCount());
+
+  {
+    SQLite::Statement s(c, SQLite::StatementId("test", 1, sql2), sql2);
+    s.BindInt(0, 0);
+    ASSERT_TRUE(s.Step());
+  }
+
+  {
+    SQLite::Statement s(c, SQLite::StatementId("test", 1, sql3), sql3);
+    s.BindInt(0, 0);
+    ASSERT_FALSE(s.Step());
+  }
+
+  ASSERT_EQ(3u, c.GetDynamicStatementsCount());
+
+  {
+    // Make "sql1" the most recently used statement
+    SQLite::Statement s(c, SQLite::StatementId("test", 1, sql1), sql1);
+    s.BindInt(0, 42);
+    ASSERT_TRUE(s.Step());
+  }
+
+  {
+    // Evicts "sql2", which is the least recently used
+    SQLite::Statement s(c, SQLite::StatementId("test", 1, sql4), sql4);
+    s.BindInt(0, 0);
+    ASSERT_TRUE(s.Step());
+  }
+
+  ASSERT_EQ(3u, c.GetDynamicStatementsCount());
+  ASSERT_TRUE(c.HasCachedStatement(SQLite::StatementId("test", 1, sql1)));
+  ASSERT_FALSE(c.HasCachedStatement(SQLite::StatementId("test", 1, sql2)));
+  ASSERT_TRUE(c.HasCachedStatement(SQLite::StatementId("test", 1, sql3)));
+  ASSERT_TRUE(c.HasCachedStatement(SQLite::StatementId("test", 1, sql4)));
+
+  {
+    // The statements that are in use are never evicted
+    SQLite::Statement s1(c, SQLite::StatementId("test", 1, sql1), sql1);
+    SQLite::Statement s3(c, SQLite::StatementId("test", 1, sql3), sql3);
+    SQLite::Statement s4(c, SQLite::StatementId("test", 1, sql4), sql4);
+    SQLite::Statement s2(c, SQLite::StatementId("test", 1, sql2), sql2);
+    ASSERT_EQ(4u, c.GetDynamicStatementsCount());
+  }
+
+  c.SetMaximumDynamicStatements(1);
+  ASSERT_EQ(1u, c.GetDynamicStatementsCount());
+  ASSERT_TRUE(c.HasCachedStatement(SQLite::StatementId("test", 1, sql2)));
+}
@@ -36,6 +36,14 @@
 #include "../Sources/Compression/ZlibCompressor.h"
 #include "../Sources/Compression/GzipCompressor.h"
 
+#if ORTHANC_ENABLE_ZSTD == 1
+#  include "../Sources/Compression/ZstdCompressor.h"
+#endif
+
+#if ORTHANC_ENABLE_LZ4 == 1
+#  include "../Sources/Compression/Lz4Compressor.h"
+#endif
+
 #if ORTHANC_SANDBOXED != 1
 #  include "../Sources/HttpServer/FilesystemHttpSender.h"
 #  include "../Sources/SystemToolbox.h"
@@ -176,6 +184,110 @@ TEST(Zlib, Empty)
 }
 
 
+TEST(IBufferCompressor, Create)
+{
+  std::unique_ptr<IBufferCompressor> c(IBufferCompressor::Create(CompressionType_ZlibWithSize));
+  ASSERT_TRUE(dynamic_cast<ZlibCompressor&>(*c).HasPrefixWithUncompressedSize());
+  ASSERT_THROW(IBufferCompressor::Create(CompressionType_None), OrthancException);
+
+  ASSERT_EQ(CompressionType_ZstdWithSize, StringToCompressionType(EnumerationToString(CompressionType_ZstdWithSize)));
+  ASSERT_EQ(CompressionType_Lz4WithSize, StringToCompressionType("Lz4"));
+  ASSERT_THROW(StringToCompressionType("lz4"), OrthancException);
+
+  const CompressionType types[] = { CompressionType_ZlibWithSize, CompressionType_ZstdWithSize, CompressionType_Lz4WithSize };
+
+  for (size_t i = 0; i < sizeof(types) / sizeof(CompressionType); i++)
+  {
+    if (IsCompressionTypeSupported(types[i]))
+    {
+      std::string s = Toolbox::GenerateUuid();
+      s = s + s + s + s;
+
+      c.reset(IBufferCompressor::Create(types[i]));
+
+      std::string compressed, uncompressed;
+      IBufferCompressor::Compress(compressed, *c, s);
+      IBufferCompressor::Uncompress(uncompressed, *c, compressed);
+      ASSERT_EQ(s, uncompressed);
+
+      s.clear();
+      IBufferCompressor::Compress(compressed, *c, s);
+      ASSERT_TRUE(compressed.empty());
+      IBufferCompressor::Uncompress(uncompressed, *c, compressed);
+      ASSERT_TRUE(uncompressed.empty());
+    }
+    else
+    {
+      ASSERT_THROW(IBufferCompressor::Create(types[i]), OrthancException);
+    }
+  }
+}
+
+
+#if ORTHANC_ENABLE_ZSTD == 1
+TEST(Zstd, Corrupted)
+{
+  std::string s = Toolbox::GenerateUuid();
+  s = s + s + s + s;
+
+  std::string compressed;
+  ZstdCompressor c;
+  ASSERT_THROW(c.SetCompressionLevel(0), OrthancException);
+  c.SetCompressionLevel(19);
+  IBufferCompressor::Compress(compressed, c, s);
+
+  std::string u;
+  ASSERT_THROW(IBufferCompressor::Uncompress(u, c, compressed.substr(0, compressed.size() - 1)), OrthancException);
+  ASSERT_THROW(IBufferCompressor::Uncompress(u, c, compressed.substr(0, 4)), OrthancException);
+}
+
+
+TEST(Zstd, WithoutPrefix)
+{
+  std::string s = Toolbox::GenerateUuid();
+  s = s + s + s + s;
+
+  ZstdCompressor c;
+  ASSERT_TRUE(c.HasPrefixWithUncompressedSize());
+
+  std::string withPrefix;
+  IBufferCompressor::Compress(withPrefix, c, s);
+
+  // Plain zstd frame, as used by the "zstd" HTTP content coding
+  c.SetPrefixWithUncompressedSize(false);
+
+  std::string compressed;
+  IBufferCompressor::Compress(compressed, c, s);
+  ASSERT_EQ(withPrefix.size(), compressed.size() + sizeof(uint64_t));
+  ASSERT_EQ(withPrefix.substr(sizeof(uint64_t)), compressed);
+
+  std::string u;
+  IBufferCompressor::Uncompress(u, c, compressed);
+  ASSERT_EQ(s, u);
+
+  ASSERT_THROW(IBufferCompressor::Uncompress(u, c, compressed.substr(0, compressed.size() - 1)), OrthancException);
+  ASSERT_THROW(IBufferCompressor::Uncompress(u, c, "Hello"), OrthancException);
+}
+#endif
+
+
+#if ORTHANC_ENABLE_LZ4 == 1
+TEST(Lz4, Corrupted)
+{
+  std::string s = Toolbox::GenerateUuid();
+  s = s + s + s + s;
+
+  std::string compressed;
+  Lz4Compressor c;
+  IBufferCompressor::Compress(compressed, c, s);
+
+  std::string u;
+  ASSERT_THROW(IBufferCompressor::Uncompress(u, c, compressed.substr(0, compressed.size() - 1)), OrthancException);
+  ASSERT_THROW(IBufferCompressor::Uncompress(u, c, compressed.substr(0, 4)), OrthancException);
+}
+#endif
+
+
 #if ORTHANC_SANDBOXED != 1
 static bool ReadAllStream(std::string& result,
                           IHttpStreamAnswer& stream,
@@ -30,7 +30,10 @@
 #include <gtest/gtest.h>
 
 #include "../Sources/Compression/HierarchicalZipWriter.h"
+#include "../Sources/Compression/StoredZipLayout.h"
+#include "../Sources/Compression/TarWriter.h"
 #include "../Sources/Compression/ZipReader.h"
+#include "../Sources/Compression/ZipStreamReader.h"
 #include "../Sources/OrthancException.h"
 #include "../Sources/SystemToolbox.h"
 #include "../Sources/TemporaryFile.h"
@@ -334,6 +337,577 @@ TEST(ZipWriter, Stream)
 }
 
 
+TEST(ZipWriter, ParallelCompression)
+{
+  std::string random;
+  random.resize(static_cast<size_t>(3) * 1024 * 1024 + 17);
+  for (size_t i = 0; i < random.size(); i++)
+  {
+    random[i] = static_cast<char>(rand() % 256);
+  }
+
+  std::string text;
+  while (text.size() < static_cast<size_t>(2) * 1024 * 1024)
+  {
+    text += "Orthanc is a lightweight DICOM server " + std::string(1, static_cast<char>('a' + text.size() % 26)) + "\n";
+  }
+
+  {
+    ZipWriter w;
+    ASSERT_EQ(1u, w.GetCompressionThreads());
+    ASSERT_THROW(w.SetCompressionThreads(0), OrthancException);
+
+    std::string memory;
+    w.SetMemoryOutput(memory, false);
+    w.Open();
+    ASSERT_THROW(w.SetCompressionThreads(4), OrthancException);
+  }
+
+  for (int i = 0; i < 2; i++)
+  {
+    std::string sequential, parallel;
+
+    for (int j = 0; j < 2; j++)
+    {
+      ZipWriter w;
+      w.SetMemoryOutput(j == 0 ? sequential : parallel, (i == 0) /* ZIP64? */);
+      w.SetCompressionThreads(j == 0 ? 1 : 4);
+      w.Open();
+
+      w.OpenFile("random");
+      w.Write(random);
+      w.OpenFile("empty");
+      w.OpenFile("text");
+      w.Write(text.substr(0, 1000));
+      w.Write(text.substr(1000));
+      w.OpenFile("small");
+      w.Write("Hello world");
+      w.Close();
+    }
+
+    // The block-wise compression must not degrade much the compression ratio
+    ASSERT_LT(parallel.size(), sequential.size() + sequential.size() / 50);
+
+    std::unique_ptr<ZipReader> reader(ZipReader::CreateFromMemory(parallel));
+    ASSERT_EQ(4u, reader->GetFilesCount());
+
+    std::string filename, content;
+    ASSERT_TRUE(reader->ReadNextFile(filename, content));
+    ASSERT_EQ("random", filename);
+    ASSERT_TRUE(random == content);
+    ASSERT_TRUE(reader->ReadNextFile(filename, content));
+    ASSERT_EQ("empty", filename);
+    ASSERT_TRUE(content.empty());
+    ASSERT_TRUE(reader->ReadNextFile(filename, content));
+    ASSERT_EQ("text", filename);
+    ASSERT_TRUE(text == content);
+    ASSERT_TRUE(reader->ReadNextFile(filename, content));
+    ASSERT_EQ("small", filename);
+    ASSERT_EQ("Hello world", content);
+    ASSERT_FALSE(reader->ReadNextFile(filename, content));
+  }
+
+  {
+    // Cancelling a stream must discard the pending entries
+    std::string memory;
+
+    {
+      ZipWriter w;
+      w.SetMemoryOutput(memory, true);
+      w.SetCompressionThreads(2);
+      w.Open();
+      w.OpenFile("hello");
+      w.Write(text);
+      w.OpenFile("world");
+      w.Write(text);
+      w.CancelStream();
+    }
+
+    ASSERT_THROW(ZipReader::CreateFromMemory(memory), OrthancException);
+  }
+}
+
+
+TEST(ZipWriter, StreamedFile)
+{
+  std::string text;
+  while (text.size() < static_cast<size_t>(1024) * 1024)
+  {
+    text += "Orthanc is a lightweight DICOM server " + std::string(1, static_cast<char>('a' + text.size() % 26)) + "\n";
+  }
+
+  for (unsigned int threads = 1; threads <= 4; threads += 3)
+  {
+    std::string memory;
+
+    {
+      ZipWriter w;
+      w.SetMemoryOutput(memory, true);
+      w.SetCompressionThreads(threads);
+      w.Open();
+
+      // The streamed files are written in the order of the archive,
+      // between the entries that are compressed in parallel
+      w.OpenFile("a");
+      w.Write(text);
+      w.OpenStreamedFile("b", true);
+      w.Write(text.substr(0, 1000));
+      w.Write(text.substr(1000));
+      w.OpenStreamedFile("c", false);
+      w.Write("Hello");
+      w.OpenFile("d");
+      w.Write("world");
+      w.Close();
+    }
+
+    std::unique_ptr<ZipReader> reader(ZipReader::CreateFromMemory(memory));
+    ASSERT_EQ(4u, reader->GetFilesCount());
+
+    std::string filename, content;
+    ASSERT_TRUE(reader->ReadNextFile(filename, content));
+    ASSERT_EQ("a", filename);
+    ASSERT_TRUE(text == content);
+    ASSERT_TRUE(reader->ReadNextFile(filename, content));
+    ASSERT_EQ("b", filename);
+    ASSERT_TRUE(text == content);
+    ASSERT_TRUE(reader->ReadNextFile(filename, content));
+    ASSERT_EQ("c", filename);
+    ASSERT_EQ("Hello", content);
+    ASSERT_TRUE(reader->ReadNextFile(filename, content));
+    ASSERT_EQ("d", filename);
+    ASSERT_EQ("world", content);
+    ASSERT_FALSE(reader->ReadNextFile(filename, content));
+  }
+}
+
+
+TEST(TarWriter, Basic)
+{
+  const std::string veryLongName = std::string(300, 'c');
+
+  std::string tar;
+
+  {
+    HierarchicalZipWriter w(new TarWriter(new ZipWriter::MemoryStream(tar)));
+    ASSERT_TRUE(w.IsTar());
+
+    w.OpenFile("hello");
+    w.Write("Hello");
+    w.Write(" world");
+    w.OpenDirectory("dir");
+    w.OpenStreamedFile("streamed", true, 1000);
+    w.Write(std::string(400, 'x'));
+    ASSERT_THROW(w.Write(std::string(601, 'y')), OrthancException);
+    w.Write(std::string(600, 'y'));
+    w.OpenFile("empty");
+    w.CloseDirectory();
+    w.OpenDirectory(std::string(120, 'a'));
+    w.OpenFile(std::string(90, 'b'));  // Split between the "prefix" and "name" fields
+    w.Write("long");
+    w.CloseDirectory();
+    w.OpenFile(veryLongName);
+    w.Write("very long");
+    w.Close();
+
+    ASSERT_EQ(tar.size(), w.GetArchiveSize());
+  }
+
+  // Each file has a 512-byte header, and its content is padded to
+  // 512 bytes. The name that cannot fit in the "ustar" header uses a
+  // GNU header of its own. Two blocks of zeros end the archive.
+  ASSERT_EQ(512u * (2 + 3 + 1 + 2 + 4 + 2), tar.size());
+  ASSERT_EQ(std::string(1024, '\0'), tar.substr(tar.size() - 1024));
+
+  ASSERT_EQ("hello", std::string(tar.c_str()));
+  ASSERT_EQ("00000000013", std::string(tar.c_str() + 124));  // Size in octal
+  ASSERT_EQ("ustar", std::string(tar.c_str() + 257));
+  ASSERT_EQ("Hello world", tar.substr(512, 11));
+  ASSERT_EQ(std::string(512 - 11, '\0'), tar.substr(512 + 11, 512 - 11));
+
+  ASSERT_EQ("dir/streamed", std::string(tar.c_str() + 1024));
+  ASSERT_EQ("00000001750", std::string(tar.c_str() + 1024 + 124));
+  ASSERT_EQ(std::string(400, 'x') + std::string(600, 'y'), tar.substr(1536, 1000));
+  ASSERT_EQ(std::string(24, '\0'), tar.substr(1536 + 1000, 24));
+
+  ASSERT_EQ("dir/empty", std::string(tar.c_str() + 512 * 5));
+
+  ASSERT_EQ(std::string(90, 'b'), std::string(tar.c_str() + 512 * 6));
+  ASSERT_EQ(std::string(120, 'a'), std::string(tar.c_str() + 512 * 6 + 345));
+
+  ASSERT_EQ("././@LongLink", std::string(tar.c_str() + 512 * 8));
+  ASSERT_EQ('L', tar[512 * 8 + 156]);
+  ASSERT_EQ(veryLongName, std::string(tar.c_str() + 512 * 9));
+  ASSERT_EQ("very long", tar.substr(512 * 11, 9));
+
+  for (size_t i = 0; i + 1024 < tar.size(); i += 512)
+  {
+    if (tar[i] != '\0' &&
+        tar.substr(i + 257, 5) == "ustar")
+    {
+      // Verify the checksum of the headers
+      unsigned int checksum = 0;
+      for (size_t j = 0; j < 512; j++)
+      {
+        checksum += (j >= 148 && j < 156) ? ' ' : static_cast<uint8_t>(tar[i + j]);
+      }
+
+      ASSERT_EQ(checksum, static_cast<unsigned int>(strtol(tar.c_str() + i + 148, NULL, 8)));
+    }
+  }
+
+  {
+    std::string cancelled;
+
+    {
+      TarWriter w(new ZipWriter::MemoryStream(cancelled));
+      w.OpenFile("hello", 10);
+      w.Write("Hello");
+      ASSERT_THROW(w.OpenFile("world"), OrthancException);  // Missing bytes
+      w.CancelStream();
+      ASSERT_THROW(w.OpenFile("world"), OrthancException);
+    }
+
+    ASSERT_LT(cancelled.size(), 1024u);
+  }
+}
+
+
+TEST(ZipWriter, StoredEntries)
+{
+  std::string text;
+  while (text.size() < static_cast<size_t>(1024) * 1024)
+  {
+    text += "Hello world ";
+  }
+
+  for (unsigned int threads = 1; threads <= 4; threads += 3)
+  {
+    std::string stored, compressed;
+
+    for (int i = 0; i < 2; i++)
+    {
+      ZipWriter w;
+      w.SetMemoryOutput(i == 0 ? stored : compressed, false);
+      w.SetCompressionThreads(threads);
+      w.Open();
+      w.OpenFile("a", (i == 1) /* compress */);
+      w.Write(text);
+      w.OpenFile("b", false);
+      w.OpenFile("c", (i == 1));
+      w.Write("Hello");
+      w.Close();
+    }
+
+    ASSERT_GT(stored.size(), text.size());
+    ASSERT_LT(compressed.size(), text.size() / 10);
+
+    for (int i = 0; i < 2; i++)
+    {
+      std::unique_ptr<ZipReader> reader(ZipReader::CreateFromMemory(i == 0 ? stored : compressed));
+      ASSERT_EQ(3u, reader->GetFilesCount());
+
+      std::string filename, content;
+      ASSERT_TRUE(reader->ReadNextFile(filename, content));
+      ASSERT_EQ("a", filename);
+      ASSERT_TRUE(text == content);
+      ASSERT_TRUE(reader->ReadNextFile(filename, content));
+      ASSERT_EQ("b", filename);
+      ASSERT_TRUE(content.empty());
+      ASSERT_TRUE(reader->ReadNextFile(filename, content));
+      ASSERT_EQ("c", filename);
+      ASSERT_EQ("Hello", content);
+      ASSERT_FALSE(reader->ReadNextFile(filename, content));
+    }
+  }
+}
+
+
+namespace
+{
+  class MemoryEntrySource : public StoredZipLayout::IEntrySource
+  {
+  private:
+    std::vector<std::string>  contents_;
+    std::map<size_t, uint32_t>  crc32_;
+    unsigned int              countReads_;
+
+  public:
+    MemoryEntrySource() :
+      countReads_(0)
+    {
+    }
+
+    void Add(const std::string& content)
+    {
+      contents_.push_back(content);
+    }
+
+    virtual void ReadEntry(std::string& content,
+                           size_t index) ORTHANC_OVERRIDE
+    {
+      content = contents_[index];
+      countReads_++;
+    }
+
+    virtual void HandleCrc32(size_t index,
+                             uint32_t crc32) ORTHANC_OVERRIDE
+    {
+      crc32_[index] = crc32;
+    }
+
+    unsigned int GetCountReads() const
+    {
+      return countReads_;
+    }
+
+    const std::map<size_t, uint32_t>& GetCrc32() const
+    {
+      return crc32_;
+    }
+  };
+}
+
+
+static void ReadStoredZip(std::string& target,
+                          StoredZipLayout& layout,
+                          StoredZipLayout::IEntrySource& source,
+                          uint64_t start,
+                          uint64_t end,
+                          uint64_t maxChunkSize)
+{
+  target.clear();
+
+  while (start < end)
+  {
+    std::string chunk;
+    layout.ReadChunk(chunk, start, std::min(end, start + maxChunkSize), source);
+    ASSERT_FALSE(chunk.empty());
+    target += chunk;
+    start += chunk.size();
+  }
+}
+
+
+TEST(StoredZipLayout, Basic)
+{
+  std::string random;
+  random.resize(100000);
+  for (size_t i = 0; i < random.size(); i++)
+  {
+    random[i] = static_cast<char>(rand() % 256);
+  }
+
+  MemoryEntrySource source;
+  source.Add("Hello world");
+  source.Add("");
+  source.Add(random);
+
+  StoredZipLayout layout;
+  layout.SetTimestamp(boost::posix_time::ptime(boost::gregorian::date(2024, 3, 14), boost::posix_time::hours(15)));
+  ASSERT_EQ(0u, layout.AddEntry("hello.txt", 11));
+  ASSERT_EQ(1u, layout.AddEntry("dir/empty", 0));
+  ASSERT_EQ(2u, layout.AddEntry("dir/random", random.size()));
+  ASSERT_EQ(3u, layout.GetEntriesCount());
+  ASSERT_THROW(layout.AddEntry("", 10), OrthancException);
+
+  const uint64_t size = layout.GetArchiveSize();
+  ASSERT_GT(size, 100011u);
+
+  std::string header;
+  ReadStoredZip(header, layout, source, 0, 10, 1000);
+  ASSERT_EQ(10u, header.size());
+  ASSERT_EQ(0u, source.GetCountReads());  // The local header is generated without reading the entry
+
+  std::string full;
+  ReadStoredZip(full, layout, source, 0, size, 1000);
+  ASSERT_EQ(size, full.size());
+  ASSERT_EQ(3u, source.GetCrc32().size());
+
+  {
+    std::unique_ptr<ZipReader> reader(ZipReader::CreateFromMemory(full));
+    ASSERT_EQ(3u, reader->GetFilesCount());
+
+    std::string filename, content;
+    ASSERT_TRUE(reader->ReadNextFile(filename, content));
+    ASSERT_EQ("hello.txt", filename);
+    ASSERT_EQ("Hello world", content);
+    ASSERT_TRUE(reader->ReadNextFile(filename, content));
+    ASSERT_EQ("dir/empty", filename);
+    ASSERT_TRUE(content.empty());
+    ASSERT_TRUE(reader->ReadNextFile(filename, content));
+    ASSERT_EQ("dir/random", filename);
+    ASSERT_TRUE(random == content);
+    ASSERT_FALSE(reader->ReadNextFile(filename, content));
+  }
+
+  {
+    // Resume the download in another layout, with the cached CRC-32
+    StoredZipLayout layout2;
+    layout2.SetTimestamp(boost::posix_time::ptime(boost::gregorian::date(2024, 3, 14), boost::posix_time::hours(15)));
+    layout2.AddEntry("hello.txt", 11);
+    layout2.AddEntry("dir/empty", 0);
+    layout2.AddEntry("dir/random", random.size());
+    ASSERT_EQ(size, layout2.GetArchiveSize());
+
+    for (std::map<size_t, uint32_t>::const_iterator it = source.GetCrc32().begin();
+         it != source.GetCrc32().end(); ++it)
+    {
+      layout2.SetCrc32(it->first, it->second);
+    }
+
+    MemoryEntrySource source2;
+    source2.Add("Hello world");
+    source2.Add("");
+    source2.Add(random);
+
+    const uint64_t start = size - 300;  // Central directory only
+    std::string tail;
+    ReadStoredZip(tail, layout2, source2, start, size, 7);
+    ASSERT_EQ(0u, source2.GetCountReads());
+    ASSERT_TRUE(full.substr(start) == tail);
+
+    std::string middle;
+    ReadStoredZip(middle, layout2, source2, 20, 50000, 100000);
+    ASSERT_TRUE(full.substr(20, 50000 - 20) == middle);
+  }
+
+  {
+    // A cold request for the central directory reads all the entries
+    MemoryEntrySource source3;
+    source3.Add("Hello world");
+    source3.Add("");
+    source3.Add(random);
+
+    StoredZipLayout layout3;
+    layout3.AddEntry("hello.txt", 11);
+    layout3.AddEntry("dir/empty", 0);
+    layout3.AddEntry("dir/random", random.size() - 1);  // Wrong size
+
+    std::string tail;
+    ASSERT_THROW(layout3.ReadChunk(tail, layout3.GetArchiveSize() - 10, layout3.GetArchiveSize(), source3), OrthancException);
+    ASSERT_THROW(layout3.ReadChunk(tail, 0, layout3.GetArchiveSize() + 1, source3), OrthancException);
+  }
+}
+
+
+namespace
+{
+  class ZipStreamCollector : public ZipStreamReader::IHandler
+  {
+  private:
+    std::vector<std::string>  filenames_;
+    std::vector<std::string>  contents_;
+
+  public:
+    virtual void HandleFile(const std::string& filename,
+                            const void* content,
+                            size_t size) ORTHANC_OVERRIDE
+    {
+      filenames_.push_back(filename);
+      contents_.push_back(std::string(reinterpret_cast<const char*>(content), size));
+    }
+
+    size_t GetSize() const
+    {
+      return filenames_.size();
+    }
+
+    const std::string& GetFilename(size_t i) const
+    {
+      return filenames_[i];
+    }
+
+    const std::string& GetContent(size_t i) const
+    {
+      return contents_[i];
+    }
+  };
+}
+
+
+TEST(ZipStreamReader, Basic)
+{
+  std::string large;
+  large.resize(static_cast<size_t>(4) * 65536);
+  for (size_t i = 0; i < large.size(); i++)
+  {
+    large[i] = static_cast<char>(rand() % 256);
+  }
+
+  for (int i = 0; i < 2; i++)
+  {
+    std::string memory;
+    
+    {
+      ZipWriter w;
+      w.SetMemoryOutput(memory, (i == 0) /* ZIP64? */);
+      w.Open();
+      w.OpenFile("world/hello");
+      w.Write(large);
+      w.OpenFile("world/empty");
+      w.OpenFile("world/hello2");
+      w.Write("Hello world");
+      w.Close();
+    }
+
+    ASSERT_TRUE(ZipReader::IsZipMemoryBuffer(memory));
+
+    static const size_t CHUNK_SIZES[] = { 1, 13, 4096, 0 };
+
+    for (size_t j = 0; j < sizeof(CHUNK_SIZES) / sizeof(size_t); j++)
+    {
+      // A chunk size of zero means that the archive is sent in one single chunk
+      const size_t chunkSize = (CHUNK_SIZES[j] == 0 ? memory.size() : CHUNK_SIZES[j]);
+
+      ZipStreamCollector collector;
+      ZipStreamReader reader(collector);
+
+      for (size_t pos = 0; pos < memory.size(); pos += chunkSize)
+      {
+        reader.AddChunk(memory.c_str() + pos, std::min(chunkSize, memory.size() - pos));
+      }
+
+      ASSERT_TRUE(reader.IsDone());
+      reader.CloseStream();
+
+      ASSERT_EQ(3u, collector.GetSize());
+      ASSERT_EQ("world/hello", collector.GetFilename(0));
+      ASSERT_TRUE(large == collector.GetContent(0));
+      ASSERT_EQ("world/empty", collector.GetFilename(1));
+      ASSERT_TRUE(collector.GetContent(1).empty());
+      ASSERT_EQ("world/hello2", collector.GetFilename(2));
+      ASSERT_EQ("Hello world", collector.GetContent(2));
+    }
+
+    {
+      // Truncated archive
+      ZipStreamCollector collector;
+      ZipStreamReader reader(collector);
+      reader.AddChunk(memory.c_str(), memory.size() / 2);
+      ASSERT_FALSE(reader.IsDone());
+      ASSERT_THROW(reader.CloseStream(), OrthancException);
+      ASSERT_EQ(0u, collector.GetSize());
+    }
+
+    {
+      // Corrupted archive
+      std::string corrupted = memory;
+      corrupted[corrupted.size() / 4] = ~corrupted[corrupted.size() / 4];
+
+      ZipStreamCollector collector;
+      ZipStreamReader reader(collector);
+      ASSERT_THROW(reader.AddChunk(corrupted), OrthancException);
+    }
+  }
+
+  {
+    ZipStreamCollector collector;
+    ZipStreamReader reader(collector);
+    ASSERT_THROW(reader.AddChunk("Hello world"), OrthancException);
+  }
+}
+
+
 namespace Orthanc
 {
   // The namespace is necessary because of FRIEND_TEST
@@ -0,0 +1,65 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include <benchmark/benchmark.h>
+
+#include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/Toolbox.h"
+#include "../Sources/OrthancInitialization.h"
+
+using namespace Orthanc;
+
+
+/**
+ * The results can be exported in a machine-readable format using the
+ * command-line options of Google Benchmark, for instance:
+ *
+ *   ./OrthancBenchmarks --benchmark_out=results.json --benchmark_out_format=json
+ *   ./OrthancBenchmarks --benchmark_filter=BM_JpegWriter --benchmark_repetitions=10
+ **/
+int main(int argc, char **argv)
+{
+  Logging::Initialize();
+  Toolbox::DetectEndianness();
+  OrthancInitialize("");
+
+  ::benchmark::Initialize(&argc, argv);
+
+  int result = 0;
+
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv))
+  {
+    result = -1;
+  }
+  else
+  {
+    ::benchmark::RunSpecifiedBenchmarks();
+  }
+
+  ::benchmark::Shutdown();
+
+  OrthancFinalize();
+  Logging::Finalize();
+
+  return result;
+}
@@ -0,0 +1,172 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include <benchmark/benchmark.h>
+
+#include "SyntheticImages.h"
+
+#include "../../OrthancFramework/Sources/DicomFormat/DicomMap.h"
+#include "../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
+#include "../../OrthancFramework/Sources/DicomParsing/Internals/DicomImageDecoder.h"
+#include "../../OrthancFramework/Sources/DicomParsing/ParsedDicomFile.h"
+#include "../../OrthancFramework/Sources/Toolbox.h"
+
+#include <dcmtk/dcmdata/dcfilefo.h>
+
+using namespace Orthanc;
+
+
+static const std::string& GetDicom(int64_t type)
+{
+  // Argument: 0 for the CT, 1 for the RGB ultrasound, 2 for the
+  // multi-frame image
+  static std::string ct, us, multiFrame;
+
+  switch (type)
+  {
+    case 0:
+      if (ct.empty())
+      {
+        SyntheticImages::CreateComputedTomographyDicom(ct);
+      }
+      return ct;
+
+    case 1:
+      if (us.empty())
+      {
+        SyntheticImages::CreateUltrasoundDicom(us);
+      }
+      return us;
+
+    case 2:
+      if (multiFrame.empty())
+      {
+        SyntheticImages::CreateMultiFrameDicom(multiFrame);
+      }
+      return multiFrame;
+
+    default:
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+  }
+}
+
+
+static void BM_ParsedDicomFile_Parse(benchmark::State& state)
+{
+  const std::string& dicom = GetDicom(state.range(0));
+
+  for (auto _ : state)
+  {
+    ParsedDicomFile parsed(dicom);
+    benchmark::DoNotOptimize(&parsed);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(dicom.size()));
+}
+
+BENCHMARK(BM_ParsedDicomFile_Parse)->Arg(0)->Arg(1)->Arg(2);
+
+
+static void BM_FromDcmtkBridge_ExtractDicomSummary(benchmark::State& state)
+{
+  ParsedDicomFile parsed(GetDicom(state.range(0)));
+  DcmDataset& dataset = *parsed.GetDcmtkObject().getDataset();
+
+  const std::set<DicomTag> ignoreTagLength;
+
+  for (auto _ : state)
+  {
+    DicomMap summary;
+    FromDcmtkBridge::ExtractDicomSummary(summary, dataset, ORTHANC_MAXIMUM_TAG_LENGTH, ignoreTagLength);
+    benchmark::DoNotOptimize(&summary);
+  }
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_FromDcmtkBridge_ExtractDicomSummary)->Arg(0)->Arg(1);
+
+
+static void BM_DicomImageDecoder_Decode(benchmark::State& state)
+{
+  // Decodes all the frames of the image
+  ParsedDicomFile parsed(GetDicom(state.range(0)));
+  DcmDataset& dataset = *parsed.GetDcmtkObject().getDataset();
+
+  const unsigned int frames = (state.range(0) == 2 ? SyntheticImages::MULTI_FRAME_COUNT : 1);
+  int64_t bytes = 0;
+
+  for (auto _ : state)
+  {
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+      std::unique_ptr<ImageAccessor> decoded(DicomImageDecoder::Decode(dataset, frame));
+      bytes += static_cast<int64_t>(decoded->GetHeight() * decoded->GetPitch());
+    }
+  }
+
+  state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_DicomImageDecoder_Decode)->Arg(0)->Arg(1)->Arg(2);
+
+
+static void BM_Toolbox_ConvertToUtf8(benchmark::State& state)
+{
+  // Argument: the source encoding. The string contains all the
+  // printable characters of the 8-bit character sets.
+  const Encoding encoding = static_cast<Encoding>(state.range(0));
+
+  std::string source;
+  for (unsigned int i = 0; i < 32; i++)
+  {
+    for (unsigned int c = 0x20; c < 0x100; c++)
+    {
+      if (c < 0x7f ||
+          c >= 0xa0)
+      {
+        source.push_back(static_cast<char>(c));
+      }
+    }
+  }
+
+  if (encoding == Encoding_Utf8)
+  {
+    source = Toolbox::ConvertToUtf8(source, Encoding_Latin1, false, false);
+  }
+
+  for (auto _ : state)
+  {
+    std::string utf8 = Toolbox::ConvertToUtf8(source, encoding, false, false);
+    benchmark::DoNotOptimize(utf8.data());
+  }
+
+  state.SetLabel(EnumerationToString(encoding));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(source.size()));
+}
+
+BENCHMARK(BM_Toolbox_ConvertToUtf8)
+->Arg(Encoding_Ascii)
+->Arg(Encoding_Utf8)
+->Arg(Encoding_Latin1)
+->Arg(Encoding_Cyrillic);
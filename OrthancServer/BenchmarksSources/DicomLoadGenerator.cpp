@@ -0,0 +1,716 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Load generator that uses the DICOM SCU of Orthanc to send C-STORE
+ * or C-FIND requests to a remote modality, at a given concurrency
+ * and rate (new in Orthanc 1.12.12). This tool is meant to size the
+ * DICOM gateways. Sample invocations:
+ *
+ *   # Push 10,000 synthetic instances from 8 associations, at most 200 instances/s
+ *   ./OrthancDicomLoadGenerator --host=pacs --port=4242 --aet=ORTHANC --count=10000 --threads=8 --rate=200
+ *
+ *   # Push the DICOM files of a folder, with a new association every 100 instances
+ *   ./OrthancDicomLoadGenerator --host=pacs --port=4242 --aet=ORTHANC --input=/data --association-size=100
+ *
+ *   # Send 1,000 C-FIND at the study level
+ *   ./OrthancDicomLoadGenerator --host=pacs --port=4242 --aet=ORTHANC --operation=find --count=1000
+ **/
+
+
+#include "InstanceTemplate.h"
+#include "LatencySamples.h"
+#include "SyntheticImages.h"
+
+#include "../../OrthancFramework/Sources/DicomNetworking/DicomControlUserConnection.h"
+#include "../../OrthancFramework/Sources/DicomNetworking/DicomFindAnswers.h"
+#include "../../OrthancFramework/Sources/DicomNetworking/DicomStoreUserConnection.h"
+#include "../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
+#include "../../OrthancFramework/Sources/ElapsedTimer.h"
+#include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+#include "../../OrthancFramework/Sources/OrthancFramework.h"
+#include "../../OrthancFramework/Sources/SystemToolbox.h"
+#include "../../OrthancFramework/Sources/Toolbox.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+
+#include <dcmtk/dcmdata/dcfilefo.h>
+
+using namespace Orthanc;
+
+
+namespace
+{
+  enum Operation
+  {
+    Operation_Store,
+    Operation_Find
+  };
+
+
+  struct Parameters
+  {
+    Operation                 operation_;
+    std::string               localAet_;
+    std::string               remoteAet_;
+    std::string               host_;
+    uint16_t                  port_;
+    uint32_t                  timeout_;
+    unsigned int              count_;
+    unsigned int              countThreads_;
+    unsigned int              rate_;              // Operations per second, 0 for unlimited
+    unsigned int              associationSize_;   // Operations per association, 0 for unlimited
+    unsigned int              firstIndex_;        // To generate new UIDs at each run
+    bool                      asynchronous_;
+    std::vector<std::string>  synthetic_;
+    std::string               input_;
+    std::string               output_;
+
+    Parameters() :
+      operation_(Operation_Store),
+      localAet_("LOADGEN"),
+      remoteAet_("ORTHANC"),
+      host_("127.0.0.1"),
+      port_(4242),
+      timeout_(10),
+      count_(1000),
+      countThreads_(4),
+      rate_(0),
+      associationSize_(0),
+      firstIndex_(0),
+      asynchronous_(false)
+    {
+      synthetic_.push_back("CT");
+    }
+  };
+
+
+  /**
+   * Source of the instances to be sent, either synthetic instances
+   * with new UIDs, or the DICOM files of a folder that are sent
+   * round-robin.
+   **/
+  class InstancesSource : public boost::noncopyable
+  {
+  private:
+    static const unsigned int INSTANCES_PER_SERIES = 50;
+    static const unsigned int SERIES_PER_STUDY = 4;
+
+    std::vector<InstanceTemplate*>  templates_;
+    std::vector<std::string>        files_;
+    unsigned int                    firstIndex_;
+
+  public:
+    explicit InstancesSource(const Parameters& parameters) :
+      firstIndex_(parameters.firstIndex_)
+    {
+      if (parameters.input_.empty())
+      {
+        for (size_t i = 0; i < parameters.synthetic_.size(); i++)
+        {
+          const std::string& type = parameters.synthetic_[i];
+
+          std::string dicom;
+          if (type == "CT")
+          {
+            SyntheticImages::CreateComputedTomographyDicom(dicom);
+          }
+          else if (type == "US")
+          {
+            SyntheticImages::CreateUltrasoundDicom(dicom);
+          }
+          else if (type == "XA")
+          {
+            SyntheticImages::CreateMultiFrameDicom(dicom);
+          }
+          else
+          {
+            throw OrthancException(ErrorCode_ParameterOutOfRange, "Unknown type of synthetic instance: " + type);
+          }
+
+          templates_.push_back(new InstanceTemplate(type, dicom));
+        }
+      }
+      else
+      {
+        namespace fs = boost::filesystem;
+
+        for (fs::recursive_directory_iterator current(parameters.input_), end; current != end; ++current)
+        {
+          if (SystemToolbox::IsRegularFile(current->path()))
+          {
+            files_.push_back(std::string());
+            SystemToolbox::ReadFile(files_.back(), current->path());
+          }
+        }
+
+        LOG(WARNING) << "Number of files read from " << parameters.input_ << ": " << files_.size();
+      }
+
+      if (templates_.empty() &&
+          files_.empty())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "No instance to be sent");
+      }
+    }
+
+    ~InstancesSource()
+    {
+      for (size_t i = 0; i < templates_.size(); i++)
+      {
+        assert(templates_[i] != NULL);
+        delete templates_[i];
+      }
+    }
+
+    void GetInstance(std::string& target,
+                     unsigned int index) const
+    {
+      if (files_.empty())
+      {
+        const unsigned int instance = firstIndex_ + index;
+        const unsigned int series = instance / INSTANCES_PER_SERIES;
+        templates_[series % templates_.size()]->Generate(target, series / SERIES_PER_STUDY, series, instance);
+      }
+      else
+      {
+        target = files_[index % files_.size()];
+      }
+    }
+  };
+
+
+  class LoadGenerator : public boost::noncopyable
+  {
+  private:
+    const Parameters&           parameters_;
+    DicomAssociationParameters  association_;
+    const InstancesSource*      source_;  // Only for C-STORE
+    ElapsedTimer                start_;
+    boost::mutex                mutex_;
+    unsigned int                next_;
+    unsigned int                failures_;
+    uint64_t                    bytes_;
+    unsigned int                countAssociations_;
+
+    // If the operation is C-FIND, the first operation on each new
+    // association is a C-ECHO. If the operation is C-STORE, the
+    // first operation on each new association is a C-STORE, whose
+    // latency includes the negotiation of the association.
+    LatencySamples              associationSamples_;
+    LatencySamples              operationSamples_;
+    LatencySamples              releaseSamples_;
+
+    bool GetNextOperation(unsigned int& index)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (next_ < parameters_.count_)
+      {
+        index = next_++;
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    void WaitSchedule(unsigned int index)
+    {
+      if (parameters_.rate_ != 0)
+      {
+        uint64_t elapsed;
+
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          elapsed = start_.GetElapsedMicroseconds();
+        }
+
+        const uint64_t scheduled = static_cast<uint64_t>(index) * 1000000 / parameters_.rate_;
+        if (scheduled > elapsed)
+        {
+          boost::this_thread::sleep(boost::posix_time::microseconds(scheduled - elapsed));
+        }
+      }
+    }
+
+    void AddFailure()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      failures_++;
+    }
+
+    void AddNewAssociation()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      countAssociations_++;
+    }
+
+    void RunStoreWorker()
+    {
+      std::unique_ptr<DicomStoreUserConnection> connection;
+      unsigned int operationsOnAssociation = 0;
+
+      unsigned int index;
+      while (GetNextOperation(index))
+      {
+        WaitSchedule(index);
+
+        try
+        {
+          // Prepare the instance before starting the timer
+          std::string buffer;
+          source_->GetInstance(buffer, index);
+
+          std::unique_ptr<DcmFileFormat> dicom(FromDcmtkBridge::LoadFromMemoryBuffer(buffer.c_str(), buffer.size()));
+          if (dicom.get() == NULL)
+          {
+            throw OrthancException(ErrorCode_BadFileFormat);
+          }
+
+          if (connection.get() == NULL)
+          {
+            connection.reset(new DicomStoreUserConnection(association_));
+            connection->SetAsynchronousStore(parameters_.asynchronous_);
+            operationsOnAssociation = 0;
+            AddNewAssociation();
+          }
+
+          ElapsedTimer timer;
+          std::string sopClassUid, sopInstanceUid;
+          connection->Store(sopClassUid, sopInstanceUid, *dicom, false, "", 0);
+
+          if (operationsOnAssociation == 0)
+          {
+            associationSamples_.Add(timer.GetElapsedMicroseconds());
+          }
+          else
+          {
+            operationSamples_.Add(timer.GetElapsedMicroseconds());
+          }
+
+          operationsOnAssociation++;
+
+          {
+            boost::mutex::scoped_lock lock(mutex_);
+            bytes_ += buffer.size();
+          }
+
+          if (operationsOnAssociation == parameters_.associationSize_)
+          {
+            ElapsedTimer release;
+            connection->WaitPendingStores();
+            connection.reset(NULL);
+            releaseSamples_.Add(release.GetElapsedMicroseconds());
+          }
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Error in C-STORE: " << e.What() << " " << e.GetDetails();
+          AddFailure();
+          connection.reset(NULL);  // The association is most probably broken
+        }
+      }
+
+      if (connection.get() != NULL)
+      {
+        try
+        {
+          ElapsedTimer release;
+          connection->WaitPendingStores();
+          connection.reset(NULL);
+          releaseSamples_.Add(release.GetElapsedMicroseconds());
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Error in C-STORE: " << e.What() << " " << e.GetDetails();
+          AddFailure();
+        }
+      }
+    }
+
+    void RunFindWorker()
+    {
+      std::unique_ptr<DicomControlUserConnection> connection;
+      unsigned int operationsOnAssociation = 0;
+
+      unsigned int index;
+      while (GetNextOperation(index))
+      {
+        WaitSchedule(index);
+
+        try
+        {
+          if (connection.get() == NULL)
+          {
+            connection.reset(new DicomControlUserConnection(
+                               association_, static_cast<ScuOperationFlags>(ScuOperationFlags_Echo | ScuOperationFlags_FindStudy)));
+            operationsOnAssociation = 0;
+            AddNewAssociation();
+
+            ElapsedTimer timer;
+            if (!connection->Echo())
+            {
+              throw OrthancException(ErrorCode_NetworkProtocol, "C-ECHO has failed");
+            }
+
+            associationSamples_.Add(timer.GetElapsedMicroseconds());
+          }
+
+          // Rotate over the initial of the patient name
+          DicomMap query;
+          query.SetValue(DICOM_TAG_PATIENT_NAME, std::string(1, static_cast<char>('A' + index % 26)) + "*", false);
+          query.SetValue(DICOM_TAG_PATIENT_ID, "", false);
+          query.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "", false);
+          query.SetValue(DICOM_TAG_STUDY_DATE, "", false);
+          query.SetValue(DICOM_TAG_STUDY_DESCRIPTION, "", false);
+          query.SetValue(DICOM_TAG_ACCESSION_NUMBER, "", false);
+          query.SetValue(DICOM_TAG_MODALITIES_IN_STUDY, "", false);
+
+          ElapsedTimer timer;
+          DicomFindAnswers answers(false /* not a worklist */);
+          connection->Find(answers, ResourceType_Study, query, true /* normalize */);
+          operationSamples_.Add(timer.GetElapsedMicroseconds());
+
+          operationsOnAssociation++;
+
+          if (operationsOnAssociation == parameters_.associationSize_)
+          {
+            ElapsedTimer release;
+            connection->Close();
+            connection.reset(NULL);
+            releaseSamples_.Add(release.GetElapsedMicroseconds());
+          }
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Error in C-FIND: " << e.What() << " " << e.GetDetails();
+          AddFailure();
+          connection.reset(NULL);
+        }
+      }
+
+      if (connection.get() != NULL)
+      {
+        try
+        {
+          ElapsedTimer release;
+          connection->Close();
+          connection.reset(NULL);
+          releaseSamples_.Add(release.GetElapsedMicroseconds());
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Error in C-FIND: " << e.What() << " " << e.GetDetails();
+          AddFailure();
+        }
+      }
+    }
+
+    static void Worker(LoadGenerator* that)
+    {
+      switch (that->parameters_.operation_)
+      {
+        case Operation_Store:
+          that->RunStoreWorker();
+          break;
+
+        case Operation_Find:
+          that->RunFindWorker();
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+    }
+
+  public:
+    LoadGenerator(const Parameters& parameters,
+                  const InstancesSource* source) :
+      parameters_(parameters),
+      source_(source),
+      next_(0),
+      failures_(0),
+      bytes_(0),
+      countAssociations_(0)
+    {
+      RemoteModalityParameters remote(parameters.remoteAet_, parameters.host_, parameters.port_, ModalityManufacturer_Generic);
+      association_ = DicomAssociationParameters(parameters.localAet_, remote);
+      association_.SetTimeout(parameters.timeout_);
+
+      if (parameters.operation_ == Operation_Store &&
+          source == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+    }
+
+    void Run(Json::Value& target)
+    {
+      start_.Restart();
+
+      std::vector<boost::thread*> threads;
+      for (unsigned int i = 0; i < parameters_.countThreads_; i++)
+      {
+        threads.push_back(new boost::thread(Worker, this));
+      }
+
+      for (size_t i = 0; i < threads.size(); i++)
+      {
+        threads[i]->join();
+        delete threads[i];
+      }
+
+      const double seconds = static_cast<double>(start_.GetElapsedMicroseconds()) / 1000000.0;
+
+      target = Json::objectValue;
+      target["Operation"] = (parameters_.operation_ == Operation_Store ? "C-STORE" : "C-FIND");
+      target["Operations"] = parameters_.count_;
+      target["Threads"] = parameters_.countThreads_;
+      target["Rate"] = parameters_.rate_;
+      target["Associations"] = countAssociations_;
+      target["Failures"] = failures_;
+      target["Seconds"] = seconds;
+      target["OperationsPerSecond"] = static_cast<double>(parameters_.count_ - failures_) / seconds;
+
+      if (parameters_.operation_ == Operation_Store)
+      {
+        target["MegabytesPerSecond"] = static_cast<double>(bytes_) / (1024.0 * 1024.0) / seconds;
+        target["Asynchronous"] = parameters_.asynchronous_;
+      }
+
+      Json::Value latencies = Json::objectValue;
+      associationSamples_.Format(latencies[parameters_.operation_ == Operation_Store ?
+                                           "AssociationAndFirstStore" : "AssociationAndEcho"]);
+      operationSamples_.Format(latencies[parameters_.operation_ == Operation_Store ? "Store" : "Find"]);
+      releaseSamples_.Format(latencies["Release"]);
+      target["LatencyMilliseconds"] = latencies;
+    }
+  };
+}
+
+
+static void PrintHelp(const char* path)
+{
+  std::cout
+    << "Usage: " << path << " [OPTION]..." << std::endl
+    << "Load generator using the DICOM SCU of Orthanc, for capacity testing." << std::endl
+    << std::endl
+    << "  --host=HOST\t\t\thost of the remote modality (default: 127.0.0.1)" << std::endl
+    << "  --port=PORT\t\t\tport of the remote modality (default: 4242)" << std::endl
+    << "  --aet=AET\t\t\tAET of the remote modality (default: ORTHANC)" << std::endl
+    << "  --local-aet=AET\t\tlocal AET (default: LOADGEN)" << std::endl
+    << "  --timeout=SECONDS\t\tDICOM timeout (default: 10)" << std::endl
+    << "  --operation=store|find\ttype of the requests (default: store)" << std::endl
+    << "  --count=N\t\t\tnumber of requests (default: 1000)" << std::endl
+    << "  --threads=N\t\t\tnumber of concurrent associations (default: 4)" << std::endl
+    << "  --rate=N\t\t\tmaximum number of requests per second (default: unlimited)" << std::endl
+    << "  --association-size=N\t\tnumber of requests per association (default: unlimited)" << std::endl
+    << "  --asynchronous\t\tdon't wait for each C-STORE-RSP (latencies are then submission times)" << std::endl
+    << "  --synthetic=CT,US,XA\t\ttypes of the synthetic instances (default: CT)" << std::endl
+    << "  --first-index=N\t\tindex of the first synthetic instance, to get new UIDs (default: 0)" << std::endl
+    << "  --input=FOLDER\t\tsend the DICOM files of this folder instead of synthetic instances" << std::endl
+    << "  --output=FILE\t\t\twrite the results as JSON to this file" << std::endl
+    << std::endl;
+}
+
+
+static unsigned int ParseInteger(const std::string& value,
+                                 bool allowZero)
+{
+  unsigned int result;
+
+  try
+  {
+    result = boost::lexical_cast<unsigned int>(value);
+  }
+  catch (boost::bad_lexical_cast&)
+  {
+    throw OrthancException(ErrorCode_ParameterOutOfRange, "Not an integer: " + value);
+  }
+
+  if (result == 0 && !allowZero)
+  {
+    throw OrthancException(ErrorCode_ParameterOutOfRange, "Not a positive integer: " + value);
+  }
+
+  return result;
+}
+
+
+static bool ParseParameters(Parameters& target,
+                            int argc,
+                            char* argv[])
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string argument(argv[i]);
+
+    if (argument == "--help")
+    {
+      PrintHelp(argv[0]);
+      return false;
+    }
+    else if (argument == "--asynchronous")
+    {
+      target.asynchronous_ = true;
+    }
+    else if (boost::starts_with(argument, "--host="))
+    {
+      target.host_ = argument.substr(7);
+    }
+    else if (boost::starts_with(argument, "--port="))
+    {
+      unsigned int port = ParseInteger(argument.substr(7), false);
+      if (port > 65535)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "Bad port: " + argument);
+      }
+
+      target.port_ = static_cast<uint16_t>(port);
+    }
+    else if (boost::starts_with(argument, "--aet="))
+    {
+      target.remoteAet_ = argument.substr(6);
+    }
+    else if (boost::starts_with(argument, "--local-aet="))
+    {
+      target.localAet_ = argument.substr(12);
+    }
+    else if (boost::starts_with(argument, "--timeout="))
+    {
+      target.timeout_ = ParseInteger(argument.substr(10), true);
+    }
+    else if (argument == "--operation=store")
+    {
+      target.operation_ = Operation_Store;
+    }
+    else if (argument == "--operation=find")
+    {
+      target.operation_ = Operation_Find;
+    }
+    else if (boost::starts_with(argument, "--count="))
+    {
+      target.count_ = ParseInteger(argument.substr(8), false);
+    }
+    else if (boost::starts_with(argument, "--threads="))
+    {
+      target.countThreads_ = ParseInteger(argument.substr(10), false);
+    }
+    else if (boost::starts_with(argument, "--rate="))
+    {
+      target.rate_ = ParseInteger(argument.substr(7), true);
+    }
+    else if (boost::starts_with(argument, "--association-size="))
+    {
+      target.associationSize_ = ParseInteger(argument.substr(19), true);
+    }
+    else if (boost::starts_with(argument, "--first-index="))
+    {
+      target.firstIndex_ = ParseInteger(argument.substr(14), true);
+    }
+    else if (boost::starts_with(argument, "--synthetic="))
+    {
+      Toolbox::TokenizeString(target.synthetic_, argument.substr(12), ',');
+    }
+    else if (boost::starts_with(argument, "--input="))
+    {
+      target.input_ = argument.substr(8);
+    }
+    else if (boost::starts_with(argument, "--output="))
+    {
+      target.output_ = argument.substr(9);
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Unknown option: " + argument);
+    }
+  }
+
+  return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+  Parameters parameters;
+
+  try
+  {
+    if (!ParseParameters(parameters, argc, argv))
+    {
+      return 0;
+    }
+  }
+  catch (OrthancException& e)
+  {
+    std::cerr << e.What() << ": " << e.GetDetails() << std::endl;
+    return -1;
+  }
+
+  InitializeFramework("", false /* don't load the private dictionary */);
+
+  int status = 0;
+
+  try
+  {
+    std::unique_ptr<InstancesSource> source;
+    if (parameters.operation_ == Operation_Store)
+    {
+      source.reset(new InstancesSource(parameters));
+    }
+
+    Json::Value results;
+
+    {
+      LoadGenerator generator(parameters, source.get());
+      generator.Run(results);
+    }
+
+    std::string s;
+    Toolbox::WriteStyledJson(s, results);
+
+    if (parameters.output_.empty())
+    {
+      std::cout << s;
+    }
+    else
+    {
+      SystemToolbox::WriteFile(s, parameters.output_);
+    }
+  }
+  catch (OrthancException& e)
+  {
+    LOG(ERROR) << "Uncaught exception, stopping now: [" << e.What() << "] (code " << e.GetErrorCode() << ")";
+    status = -1;
+  }
+
+  FinalizeFramework();
+
+  return status;
+}
@@ -0,0 +1,653 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Benchmark of the lookups of resources through "/tools/find" and
+ * C-FIND, against a large database of synthetic resources (new in
+ * Orthanc 1.12.12). Sample invocations:
+ *
+ *   # Everything in memory
+ *   ./OrthancFindBenchmark --patients=10000 --queries=2000 --threads=4
+ *
+ *   # Generate a SQLite database once, then replay the queries
+ *   ./OrthancFindBenchmark --database=index.db --generate --patients=500000
+ *   ./OrthancFindBenchmark --database=index.db --patients=500000 --queries=5000 --output=find.json
+ *
+ * The dimensions of the database must be the same when generating
+ * and when querying, as the queries look for values that are known
+ * to exist.
+ **/
+
+
+#include "LatencySamples.h"
+#include "SyntheticDatabase.h"
+
+#include "../../OrthancFramework/Sources/DicomNetworking/DicomConnectionInfo.h"
+#include "../../OrthancFramework/Sources/DicomNetworking/DicomFindAnswers.h"
+#include "../../OrthancFramework/Sources/ElapsedTimer.h"
+#include "../../OrthancFramework/Sources/FileStorage/MemoryStorageArea.h"
+#include "../../OrthancFramework/Sources/FileStorage/PluginStorageAreaAdapter.h"
+#include "../../OrthancFramework/Sources/HttpServer/IHttpHandler.h"
+#include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+#include "../../OrthancFramework/Sources/SystemToolbox.h"
+#include "../../OrthancFramework/Sources/Toolbox.h"
+#include "../Sources/Database/SQLiteDatabaseWrapper.h"
+#include "../Sources/OrthancConfiguration.h"
+#include "../Sources/OrthancFindRequestHandler.h"
+#include "../Sources/OrthancInitialization.h"
+#include "../Sources/OrthancRestApi/OrthancRestApi.h"
+#include "../Sources/ServerContext.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+
+using namespace Orthanc;
+
+
+namespace
+{
+  enum Query
+  {
+    Query_StudiesByPatientId,
+    Query_StudiesByPatientNameWildcard,
+    Query_StudiesByDateAndModality,
+    Query_SeriesByModalityAndBodyPart,
+    Query_StudiesByLabel,
+    Query_StudyByAccessionNumberExpanded,
+    Query_StudiesOrderedByDate,
+    Query_InstancesOfStudy,
+    Query_CFindStudiesByNameAndDate,
+    Query_CFindSeriesOfStudy,
+    Query_Count
+  };
+
+
+  const char* GetQueryName(Query query)
+  {
+    switch (query)
+    {
+      case Query_StudiesByPatientId:
+        return "FindStudiesByPatientId";
+
+      case Query_StudiesByPatientNameWildcard:
+        return "FindStudiesByPatientNameWildcard";
+
+      case Query_StudiesByDateAndModality:
+        return "FindStudiesByDateAndModality";
+
+      case Query_SeriesByModalityAndBodyPart:
+        return "FindSeriesByModalityAndBodyPart";
+
+      case Query_StudiesByLabel:
+        return "FindStudiesByLabel";
+
+      case Query_StudyByAccessionNumberExpanded:
+        return "FindStudyByAccessionNumberExpanded";
+
+      case Query_StudiesOrderedByDate:
+        return "FindStudiesOrderedByDate";
+
+      case Query_InstancesOfStudy:
+        return "FindInstancesOfStudy";
+
+      case Query_CFindStudiesByNameAndDate:
+        return "CFindStudiesByNameAndDate";
+
+      case Query_CFindSeriesOfStudy:
+        return "CFindSeriesOfStudy";
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  struct Parameters
+  {
+    std::string   database_;        // Empty for an in-memory database
+    bool          generate_;
+    unsigned int  countPatients_;
+    unsigned int  studiesPerPatient_;
+    unsigned int  seriesPerStudy_;
+    unsigned int  instancesPerSeries_;
+    unsigned int  countQueries_;
+    unsigned int  countThreads_;
+    std::string   configuration_;
+    std::string   output_;
+
+    Parameters() :
+      generate_(false),
+      countPatients_(1000),
+      studiesPerPatient_(3),
+      seriesPerStudy_(4),
+      instancesPerSeries_(50),
+      countQueries_(1000),
+      countThreads_(4)
+    {
+    }
+  };
+
+
+  class FindBenchmark : public boost::noncopyable
+  {
+  private:
+    const Parameters&             parameters_;
+    OrthancRestApi                restApi_;
+    OrthancFindRequestHandler     findHandler_;
+    unsigned int                  countPatients_;
+    unsigned int                  countStudies_;
+    boost::mutex                  mutex_;
+    unsigned int                  next_;
+    unsigned int                  failures_;
+    uint64_t                      answers_[Query_Count];
+    LatencySamples                samples_[Query_Count];
+
+    static std::string GetDateRange(unsigned int start,
+                                    unsigned int days)
+    {
+      return (SyntheticDatabase::FormatDate(start) + "-" +
+              SyntheticDatabase::FormatDate(start + days));
+    }
+
+    static void AddReturnKey(DicomMap& query,
+                             const DicomTag& tag)
+    {
+      query.SetValue(tag, "", false);
+    }
+
+    size_t RunToolsFind(const Json::Value& request)
+    {
+      std::string body;
+      Toolbox::WriteFastJson(body, request);
+
+      std::string answer;
+      HttpToolbox::Arguments headers;
+      if (IHttpHandler::SimplePost(answer, NULL, restApi_, RequestOrigin_RestApi, "/tools/find",
+                                   body.c_str(), body.size(), headers) != HttpStatus_200_Ok)
+      {
+        throw OrthancException(ErrorCode_InternalError, "Error in /tools/find: " + body);
+      }
+
+      Json::Value json;
+      if (!Toolbox::ReadJson(json, answer) ||
+          json.type() != Json::arrayValue)
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      return json.size();
+    }
+
+    size_t RunCFind(const DicomMap& query)
+    {
+      DicomFindAnswers answers(false /* not a worklist */);
+      std::list<DicomTag> sequencesToReturn;
+      findHandler_.Handle(answers, query, sequencesToReturn, DicomConnectionInfo("127.0.0.1", "BENCHMARK", "ORTHANC"));
+      return answers.GetSize();
+    }
+
+    // The values of the queries are a deterministic function of the
+    // index of the query, so that two runs are comparable
+    size_t RunQuery(Query query,
+                    unsigned int index)
+    {
+      const unsigned int patient = SyntheticDatabase::Hash(index, 100) % countPatients_;
+      const unsigned int study = SyntheticDatabase::Hash(index, 101) % countStudies_;
+      const unsigned int day = SyntheticDatabase::Hash(index, 102) % 3600;
+
+      Json::Value request = Json::objectValue;
+      request["Level"] = "Study";
+      request["Query"] = Json::objectValue;
+
+      switch (query)
+      {
+        case Query_StudiesByPatientId:
+          request["Query"]["PatientID"] = SyntheticDatabase::GetPatientId(patient);
+          return RunToolsFind(request);
+
+        case Query_StudiesByPatientNameWildcard:
+          request["Query"]["PatientName"] = SyntheticDatabase::GetFamilyName(patient) + "*";
+          request["Limit"] = 100;
+          return RunToolsFind(request);
+
+        case Query_StudiesByDateAndModality:
+          request["Query"]["StudyDate"] = GetDateRange(day, 30);
+          request["Query"]["ModalitiesInStudy"] = SyntheticDatabase::GetStudyModality(study);
+          request["Limit"] = 100;
+          return RunToolsFind(request);
+
+        case Query_SeriesByModalityAndBodyPart:
+          request["Level"] = "Series";
+          request["Query"]["Modality"] = SyntheticDatabase::GetStudyModality(study);
+          request["Query"]["BodyPartExamined"] = SyntheticDatabase::GetStudyBodyPart(study);
+          request["Limit"] = 100;
+          return RunToolsFind(request);
+
+        case Query_StudiesByLabel:
+        {
+          const std::string label = SyntheticDatabase::GetStudyLabel(study);
+          request["Labels"] = Json::arrayValue;
+          request["Labels"].append(label.empty() ? "urgent" : label);
+          request["LabelsConstraint"] = "All";
+          request["Limit"] = 100;
+          return RunToolsFind(request);
+        }
+
+        case Query_StudyByAccessionNumberExpanded:
+          request["Query"]["AccessionNumber"] = SyntheticDatabase::GetAccessionNumber(study);
+          request["Expand"] = true;
+          return RunToolsFind(request);
+
+        case Query_StudiesOrderedByDate:
+        {
+          Json::Value orderBy = Json::objectValue;
+          orderBy["Type"] = "DicomTag";
+          orderBy["Key"] = "StudyDate";
+          orderBy["Direction"] = "DESC";
+
+          request["Query"]["StudyDescription"] = "*" + SyntheticDatabase::GetStudyBodyPart(study);
+          request["OrderBy"] = Json::arrayValue;
+          request["OrderBy"].append(orderBy);
+          request["Limit"] = 50;
+          request["Expand"] = true;
+          return RunToolsFind(request);
+        }
+
+        case Query_InstancesOfStudy:
+          request["Level"] = "Instance";
+          request["Query"]["StudyInstanceUID"] = SyntheticDatabase::GetStudyInstanceUid(study);
+          return RunToolsFind(request);
+
+        case Query_CFindStudiesByNameAndDate:
+        {
+          DicomMap cfind;
+          cfind.SetValue(DICOM_TAG_QUERY_RETRIEVE_LEVEL, "STUDY", false);
+          cfind.SetValue(DICOM_TAG_PATIENT_NAME, SyntheticDatabase::GetFamilyName(patient) + "*", false);
+          cfind.SetValue(DICOM_TAG_STUDY_DATE, GetDateRange(day, 365), false);
+          AddReturnKey(cfind, DICOM_TAG_PATIENT_ID);
+          AddReturnKey(cfind, DICOM_TAG_STUDY_INSTANCE_UID);
+          AddReturnKey(cfind, DICOM_TAG_STUDY_DESCRIPTION);
+          AddReturnKey(cfind, DICOM_TAG_ACCESSION_NUMBER);
+          AddReturnKey(cfind, DICOM_TAG_MODALITIES_IN_STUDY);
+          AddReturnKey(cfind, DICOM_TAG_NUMBER_OF_STUDY_RELATED_INSTANCES);
+          return RunCFind(cfind);
+        }
+
+        case Query_CFindSeriesOfStudy:
+        {
+          DicomMap cfind;
+          cfind.SetValue(DICOM_TAG_QUERY_RETRIEVE_LEVEL, "SERIES", false);
+          cfind.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, SyntheticDatabase::GetStudyInstanceUid(study), false);
+          AddReturnKey(cfind, DICOM_TAG_SERIES_INSTANCE_UID);
+          AddReturnKey(cfind, DICOM_TAG_MODALITY);
+          AddReturnKey(cfind, DICOM_TAG_SERIES_DESCRIPTION);
+          AddReturnKey(cfind, DICOM_TAG_NUMBER_OF_SERIES_RELATED_INSTANCES);
+          return RunCFind(cfind);
+        }
+
+        default:
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+    }
+
+    bool GetNextQuery(unsigned int& index)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (next_ < parameters_.countQueries_)
+      {
+        index = next_++;
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    static void Worker(FindBenchmark* that)
+    {
+      unsigned int index;
+      while (that->GetNextQuery(index))
+      {
+        // Round-robin over the types of queries
+        const Query query = static_cast<Query>(index % Query_Count);
+
+        try
+        {
+          ElapsedTimer timer;
+          const size_t answers = that->RunQuery(query, index);
+          that->samples_[query].Add(timer.GetElapsedMicroseconds());
+
+          boost::mutex::scoped_lock lock(that->mutex_);
+          that->answers_[query] += answers;
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Error in query " << GetQueryName(query) << ": " << e.What();
+
+          boost::mutex::scoped_lock lock(that->mutex_);
+          that->failures_++;
+        }
+      }
+    }
+
+  public:
+    FindBenchmark(const Parameters& parameters,
+                  ServerContext& context,
+                  const SyntheticDatabase& database) :
+      parameters_(parameters),
+      restApi_(context, false /* no Orthanc Explorer */),
+      findHandler_(context),
+      countPatients_(database.GetCountPatients()),
+      countStudies_(database.GetCountStudies()),
+      next_(0),
+      failures_(0)
+    {
+      if (countPatients_ == 0 ||
+          countStudies_ == 0)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "The database is empty");
+      }
+
+      {
+        OrthancConfiguration::ReaderLock lock;
+        findHandler_.SetMaxResults(lock.GetConfiguration().GetUnsignedIntegerParameter("LimitFindResults"));
+        findHandler_.SetMaxInstances(lock.GetConfiguration().GetUnsignedIntegerParameter("LimitFindInstances"));
+      }
+
+      for (int i = 0; i < Query_Count; i++)
+      {
+        answers_[i] = 0;
+      }
+    }
+
+    void Run(Json::Value& target)
+    {
+      ElapsedTimer timer;
+
+      std::vector<boost::thread*> threads;
+      for (unsigned int i = 0; i < parameters_.countThreads_; i++)
+      {
+        threads.push_back(new boost::thread(Worker, this));
+      }
+
+      for (size_t i = 0; i < threads.size(); i++)
+      {
+        threads[i]->join();
+        delete threads[i];
+      }
+
+      const double seconds = static_cast<double>(timer.GetElapsedMicroseconds()) / 1000000.0;
+
+      target = Json::objectValue;
+      target["Queries"] = parameters_.countQueries_;
+      target["Threads"] = parameters_.countThreads_;
+      target["Failures"] = failures_;
+      target["Seconds"] = seconds;
+      target["QueriesPerSecond"] = static_cast<double>(parameters_.countQueries_) / seconds;
+
+      Json::Value queries = Json::objectValue;
+      for (int i = 0; i < Query_Count; i++)
+      {
+        Json::Value& item = queries[GetQueryName(static_cast<Query>(i))];
+        samples_[i].Format(item["LatencyMilliseconds"]);
+
+        const size_t count = samples_[i].GetCount();
+        item["MeanAnswers"] = (count == 0 ? 0.0 : static_cast<double>(answers_[i]) / static_cast<double>(count));
+      }
+
+      target["Lookups"] = queries;
+    }
+  };
+}
+
+
+static void PrintHelp(const char* path)
+{
+  std::cout
+    << "Usage: " << path << " [OPTION]..." << std::endl
+    << "Benchmark of /tools/find and C-FIND against a database of synthetic resources." << std::endl
+    << std::endl
+    << "  --database=FILE\tSQLite database (default: in memory, which implies --generate)" << std::endl
+    << "  --generate\t\tfill the database, that must be empty, with synthetic resources" << std::endl
+    << "  --patients=N\t\tnumber of patients (default: 1000)" << std::endl
+    << "  --studies=N\t\tmean number of studies per patient (default: 3)" << std::endl
+    << "  --series=N\t\tmean number of series per study (default: 4)" << std::endl
+    << "  --instances=N\t\tmean number of instances per series (default: 50)" << std::endl
+    << "  --queries=N\t\tnumber of queries to run, 0 to only generate (default: 1000)" << std::endl
+    << "  --threads=N\t\tnumber of concurrent threads (default: 4)" << std::endl
+    << "  --config=FILE\t\tOrthanc configuration file" << std::endl
+    << "  --output=FILE\t\twrite the results as JSON to this file" << std::endl
+    << std::endl;
+}
+
+
+static unsigned int ParseInteger(const std::string& value,
+                                 bool allowZero)
+{
+  unsigned int result;
+
+  try
+  {
+    result = boost::lexical_cast<unsigned int>(value);
+  }
+  catch (boost::bad_lexical_cast&)
+  {
+    throw OrthancException(ErrorCode_ParameterOutOfRange, "Not an integer: " + value);
+  }
+
+  if (result == 0 && !allowZero)
+  {
+    throw OrthancException(ErrorCode_ParameterOutOfRange, "Not a positive integer: " + value);
+  }
+
+  return result;
+}
+
+
+static bool ParseParameters(Parameters& target,
+                            int argc,
+                            char* argv[])
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string argument(argv[i]);
+
+    if (argument == "--help")
+    {
+      PrintHelp(argv[0]);
+      return false;
+    }
+    else if (argument == "--generate")
+    {
+      target.generate_ = true;
+    }
+    else if (boost::starts_with(argument, "--database="))
+    {
+      target.database_ = argument.substr(11);
+    }
+    else if (boost::starts_with(argument, "--patients="))
+    {
+      target.countPatients_ = ParseInteger(argument.substr(11), false);
+    }
+    else if (boost::starts_with(argument, "--studies="))
+    {
+      target.studiesPerPatient_ = ParseInteger(argument.substr(10), false);
+    }
+    else if (boost::starts_with(argument, "--series="))
+    {
+      target.seriesPerStudy_ = ParseInteger(argument.substr(9), false);
+    }
+    else if (boost::starts_with(argument, "--instances="))
+    {
+      target.instancesPerSeries_ = ParseInteger(argument.substr(12), false);
+    }
+    else if (boost::starts_with(argument, "--queries="))
+    {
+      target.countQueries_ = ParseInteger(argument.substr(10), true);
+    }
+    else if (boost::starts_with(argument, "--threads="))
+    {
+      target.countThreads_ = ParseInteger(argument.substr(10), false);
+    }
+    else if (boost::starts_with(argument, "--config="))
+    {
+      target.configuration_ = argument.substr(9);
+    }
+    else if (boost::starts_with(argument, "--output="))
+    {
+      target.output_ = argument.substr(9);
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Unknown option: " + argument);
+    }
+  }
+
+  if (target.database_.empty())
+  {
+    target.generate_ = true;
+  }
+
+  return true;
+}
+
+
+static void RunBenchmark(Json::Value& results,
+                         const Parameters& parameters)
+{
+  SyntheticDatabase synthetic;
+  synthetic.SetCountPatients(parameters.countPatients_);
+  synthetic.SetStudiesPerPatient(parameters.studiesPerPatient_);
+  synthetic.SetSeriesPerStudy(parameters.seriesPerStudy_);
+  synthetic.SetInstancesPerSeries(parameters.instancesPerSeries_);
+
+  std::unique_ptr<SQLiteDatabaseWrapper> database;
+  if (parameters.database_.empty())
+  {
+    database.reset(new SQLiteDatabaseWrapper);   // The SQLite DB is in memory
+  }
+  else
+  {
+    database.reset(new SQLiteDatabaseWrapper(parameters.database_));
+  }
+
+  database->Open();
+
+  {
+    // The attachments are never read by the lookups
+    PluginStorageAreaAdapter storage(new MemoryStorageArea);
+
+    ServerContext context(*database, storage, false /* not running unit tests */, 10, false /* readonly */);
+    context.SetupJobsEngine(false, false);
+
+    results = Json::objectValue;
+
+    if (parameters.generate_)
+    {
+      ElapsedTimer timer;
+      const uint64_t count = synthetic.Populate(context.GetIndex());
+      const double seconds = static_cast<double>(timer.GetElapsedMicroseconds()) / 1000000.0;
+
+      results["Generation"]["Instances"] = static_cast<Json::UInt64>(count);
+      results["Generation"]["Seconds"] = seconds;
+      results["Generation"]["InstancesPerSecond"] = static_cast<double>(count) / seconds;
+    }
+
+    uint64_t diskSize, uncompressedSize, countPatients, countStudies, countSeries, countInstances;
+    context.GetIndex().GetGlobalStatistics(diskSize, uncompressedSize, countPatients,
+                                           countStudies, countSeries, countInstances);
+
+    results["Database"]["Patients"] = static_cast<Json::UInt64>(countPatients);
+    results["Database"]["Studies"] = static_cast<Json::UInt64>(countStudies);
+    results["Database"]["Series"] = static_cast<Json::UInt64>(countSeries);
+    results["Database"]["Instances"] = static_cast<Json::UInt64>(countInstances);
+
+    if (parameters.countQueries_ > 0)
+    {
+      FindBenchmark benchmark(parameters, context, synthetic);
+      benchmark.Run(results["Find"]);
+    }
+
+    context.Stop();
+  }
+
+  database->Close();
+}
+
+
+int main(int argc, char* argv[])
+{
+  Parameters parameters;
+
+  try
+  {
+    if (!ParseParameters(parameters, argc, argv))
+    {
+      return 0;
+    }
+  }
+  catch (OrthancException& e)
+  {
+    std::cerr << e.What() << ": " << e.GetDetails() << std::endl;
+    return -1;
+  }
+
+  Logging::Initialize();
+  Toolbox::DetectEndianness();
+
+  int status = 0;
+
+  try
+  {
+    OrthancInitialize(parameters.configuration_);
+
+    Json::Value results;
+    RunBenchmark(results, parameters);
+
+    std::string s;
+    Toolbox::WriteStyledJson(s, results);
+
+    if (parameters.output_.empty())
+    {
+      std::cout << s;
+    }
+    else
+    {
+      SystemToolbox::WriteFile(s, parameters.output_);
+    }
+  }
+  catch (OrthancException& e)
+  {
+    LOG(ERROR) << "Uncaught exception, stopping now: [" << e.What() << "] (code " << e.GetErrorCode() << ")";
+    status = -1;
+  }
+
+  OrthancFinalize();
+  Logging::Finalize();
+
+  return status;
+}
@@ -0,0 +1,204 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include <benchmark/benchmark.h>
+
+#include "SyntheticImages.h"
+
+#include "../../OrthancFramework/Sources/Images/Image.h"
+#include "../../OrthancFramework/Sources/Images/ImageProcessing.h"
+#include "../../OrthancFramework/Sources/Images/JpegWriter.h"
+#include "../../OrthancFramework/Sources/Images/PngWriter.h"
+
+using namespace Orthanc;
+
+
+static const ImageAccessor& GetComputedTomography()
+{
+  static std::unique_ptr<ImageAccessor> image(SyntheticImages::CreateComputedTomography());
+  return *image;
+}
+
+
+static const ImageAccessor& GetUltrasound()
+{
+  static std::unique_ptr<ImageAccessor> image(SyntheticImages::CreateUltrasound());
+  return *image;
+}
+
+
+static void SetImageBytesProcessed(benchmark::State& state,
+                                   const ImageAccessor& image)
+{
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(image.GetHeight() * image.GetPitch()));
+}
+
+
+static void BM_ImageProcessing_ConvertGrayscale16ToGrayscale8(benchmark::State& state)
+{
+  const ImageAccessor& source = GetComputedTomography();
+  Image target(PixelFormat_Grayscale8, source.GetWidth(), source.GetHeight(), false);
+
+  for (auto _ : state)
+  {
+    ImageProcessing::Convert(target, source);
+    benchmark::ClobberMemory();
+  }
+
+  SetImageBytesProcessed(state, source);
+}
+
+BENCHMARK(BM_ImageProcessing_ConvertGrayscale16ToGrayscale8);
+
+
+static void BM_ImageProcessing_ConvertRGB24ToGrayscale8(benchmark::State& state)
+{
+  const ImageAccessor& source = GetUltrasound();
+  Image target(PixelFormat_Grayscale8, source.GetWidth(), source.GetHeight(), false);
+
+  for (auto _ : state)
+  {
+    ImageProcessing::Convert(target, source);
+    benchmark::ClobberMemory();
+  }
+
+  SetImageBytesProcessed(state, source);
+}
+
+BENCHMARK(BM_ImageProcessing_ConvertRGB24ToGrayscale8);
+
+
+static void BM_ImageProcessing_ShiftScale(benchmark::State& state)
+{
+  // Windowing of the CT to 8 bits, with a window of [900, 1200]
+  const ImageAccessor& source = GetComputedTomography();
+  Image target(PixelFormat_Grayscale8, source.GetWidth(), source.GetHeight(), false);
+
+  const float scaling = 255.0f / 300.0f;
+
+  for (auto _ : state)
+  {
+    ImageProcessing::ShiftScale2(target, source, -900.0f * scaling, scaling, false);
+    benchmark::ClobberMemory();
+  }
+
+  SetImageBytesProcessed(state, source);
+}
+
+BENCHMARK(BM_ImageProcessing_ShiftScale);
+
+
+static void BM_ImageProcessing_SmoothGaussian5x5(benchmark::State& state)
+{
+  const ImageAccessor& source = GetComputedTomography();
+  Image image(source.GetFormat(), source.GetWidth(), source.GetHeight(), false);
+
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    ImageProcessing::Copy(image, source);
+    state.ResumeTiming();
+
+    ImageProcessing::SmoothGaussian5x5(image, false);
+    benchmark::ClobberMemory();
+  }
+
+  SetImageBytesProcessed(state, source);
+}
+
+BENCHMARK(BM_ImageProcessing_SmoothGaussian5x5);
+
+
+static void BM_ImageProcessing_Resize(benchmark::State& state)
+{
+  // Typical rendering of a thumbnail of an ultrasound frame
+  const ImageAccessor& source = GetUltrasound();
+  Image target(PixelFormat_RGB24, source.GetWidth() / 2, source.GetHeight() / 2, false);
+
+  for (auto _ : state)
+  {
+    ImageProcessing::Resize(target, source);
+    benchmark::ClobberMemory();
+  }
+
+  SetImageBytesProcessed(state, source);
+}
+
+BENCHMARK(BM_ImageProcessing_Resize);
+
+
+static void BM_JpegWriter(benchmark::State& state)
+{
+  // Argument: 0 for the 8-bit rendering of the CT, 1 for the RGB ultrasound
+  std::unique_ptr<ImageAccessor> source;
+
+  if (state.range(0) == 0)
+  {
+    const ImageAccessor& ct = GetComputedTomography();
+    source.reset(new Image(PixelFormat_Grayscale8, ct.GetWidth(), ct.GetHeight(), false));
+    ImageProcessing::Convert(*source, ct);
+  }
+  else
+  {
+    source.reset(new Image(PixelFormat_RGB24, GetUltrasound().GetWidth(), GetUltrasound().GetHeight(), false));
+    ImageProcessing::Copy(*source, GetUltrasound());
+  }
+
+  JpegWriter writer;
+  writer.SetQuality(90);
+
+  std::string jpeg;
+
+  for (auto _ : state)
+  {
+    IImageWriter::WriteToMemory(writer, jpeg, *source);
+    benchmark::DoNotOptimize(jpeg.data());
+  }
+
+  SetImageBytesProcessed(state, *source);
+  state.counters["CompressedBytes"] = static_cast<double>(jpeg.size());
+}
+
+BENCHMARK(BM_JpegWriter)->Arg(0)->Arg(1);
+
+
+static void BM_PngWriter(benchmark::State& state)
+{
+  // Argument: 0 for the 16-bit CT, 1 for the RGB ultrasound
+  const ImageAccessor& source = (state.range(0) == 0 ? GetComputedTomography() : GetUltrasound());
+
+  PngWriter writer;
+  std::string png;
+
+  for (auto _ : state)
+  {
+    IImageWriter::WriteToMemory(writer, png, source);
+    benchmark::DoNotOptimize(png.data());
+  }
+
+  SetImageBytesProcessed(state, source);
+  state.counters["CompressedBytes"] = static_cast<double>(png.size());
+}
+
+BENCHMARK(BM_PngWriter)->Arg(0)->Arg(1);
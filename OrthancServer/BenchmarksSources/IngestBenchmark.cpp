@@ -0,0 +1,674 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * End-to-end benchmark of the ingest of DICOM instances through
+ * "ServerContext::Store()", on top of an in-memory SQLite database
+ * and of an in-memory storage area (new in Orthanc 1.12.12). Sample
+ * invocation:
+ *
+ *   ./OrthancIngestBenchmark --instances=5000 --threads=8 --mix=CT:8,US:1,XA:1 --output=ingest.json
+ *
+ * The ingest transcoding is enabled by "--transcode=<transfer syntax
+ * UID>", or by the "IngestTranscoding" option of the configuration
+ * file that is provided with "--config=<file>".
+ **/
+
+
+#include "InstanceTemplate.h"
+#include "LatencySamples.h"
+#include "SyntheticImages.h"
+
+#include "../../OrthancFramework/Sources/ElapsedTimer.h"
+#include "../../OrthancFramework/Sources/FileStorage/MemoryStorageArea.h"
+#include "../../OrthancFramework/Sources/FileStorage/PluginStorageAreaAdapter.h"
+#include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+#include "../../OrthancFramework/Sources/SystemToolbox.h"
+#include "../../OrthancFramework/Sources/TemporaryFile.h"
+#include "../../OrthancFramework/Sources/Toolbox.h"
+#include "../Sources/Database/SQLiteDatabaseWrapper.h"
+#include "../Sources/DicomInstanceToStore.h"
+#include "../Sources/OrthancInitialization.h"
+#include "../Sources/ServerContext.h"
+#include "../Sources/ServerTranscoder.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+
+using namespace Orthanc;
+
+
+namespace
+{
+  enum Stage
+  {
+    Stage_Store,        // The whole "ServerContext::Store()"
+    Stage_Transcoding,  // Ingest transcoding
+    Stage_Storage,      // Writes to the storage area
+    Stage_Index,        // The remainder: Summary, filters, compression, and database
+    Stage_Count
+  };
+
+
+  const char* GetStageName(Stage stage)
+  {
+    switch (stage)
+    {
+      case Stage_Store:
+        return "Store";
+
+      case Stage_Transcoding:
+        return "Transcoding";
+
+      case Stage_Storage:
+        return "Storage";
+
+      case Stage_Index:
+        return "Index";
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  /**
+   * The storage and the transcoding are run by the thread that calls
+   * "ServerContext::Store()": Their durations are accumulated into a
+   * thread-specific counter, so that they can be attributed to the
+   * instance that is currently stored by this thread.
+   **/
+  class StageClock : public boost::noncopyable
+  {
+  private:
+    struct Durations
+    {
+      uint64_t  storage_;
+      uint64_t  transcoding_;
+    };
+
+    boost::thread_specific_ptr<Durations>  durations_;
+
+    Durations& GetDurations()
+    {
+      if (durations_.get() == NULL)
+      {
+        durations_.reset(new Durations);
+        durations_->storage_ = 0;
+        durations_->transcoding_ = 0;
+      }
+
+      return *durations_;
+    }
+
+  public:
+    void Reset()
+    {
+      GetDurations().storage_ = 0;
+      GetDurations().transcoding_ = 0;
+    }
+
+    void AddStorage(uint64_t microseconds)
+    {
+      GetDurations().storage_ += microseconds;
+    }
+
+    void AddTranscoding(uint64_t microseconds)
+    {
+      GetDurations().transcoding_ += microseconds;
+    }
+
+    uint64_t GetStorage()
+    {
+      return GetDurations().storage_;
+    }
+
+    uint64_t GetTranscoding()
+    {
+      return GetDurations().transcoding_;
+    }
+  };
+
+
+  class TimedStorageArea : public IStorageArea
+  {
+  private:
+    StageClock&                    clock_;
+    std::unique_ptr<IStorageArea>  storage_;
+
+  public:
+    TimedStorageArea(StageClock& clock,
+                     IStorageArea* storage /* takes ownership */) :
+      clock_(clock),
+      storage_(storage)
+    {
+    }
+
+    virtual void Create(const std::string& uuid,
+                        const void* content,
+                        size_t size,
+                        FileContentType type) ORTHANC_OVERRIDE
+    {
+      ElapsedTimer timer;
+      storage_->Create(uuid, content, size, type);
+      clock_.AddStorage(timer.GetElapsedMicroseconds());
+    }
+
+    virtual IMemoryBuffer* ReadRange(const std::string& uuid,
+                                     FileContentType type,
+                                     uint64_t start /* inclusive */,
+                                     uint64_t end /* exclusive */) ORTHANC_OVERRIDE
+    {
+      return storage_->ReadRange(uuid, type, start, end);
+    }
+
+    virtual bool HasEfficientReadRange() const ORTHANC_OVERRIDE
+    {
+      return storage_->HasEfficientReadRange();
+    }
+
+    virtual void Remove(const std::string& uuid,
+                        FileContentType type) ORTHANC_OVERRIDE
+    {
+      storage_->Remove(uuid, type);
+    }
+
+    virtual bool LookupLocalPath(std::string& path,
+                                 const std::string& uuid,
+                                 FileContentType type) const ORTHANC_OVERRIDE
+    {
+      return storage_->LookupLocalPath(path, uuid, type);
+    }
+  };
+
+
+  class TimedTranscoder : public ServerTranscoder
+  {
+  private:
+    StageClock&  clock_;
+
+  public:
+    TimedTranscoder(StageClock& clock,
+                    unsigned int maxConcurrentDcmtkTranscoder) :
+      ServerTranscoder(maxConcurrentDcmtkTranscoder),
+      clock_(clock)
+    {
+    }
+
+    virtual bool Transcode(DicomImage& target,
+                           DicomImage& source,
+                           const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                           TranscodingSopInstanceUidMode mode) ORTHANC_OVERRIDE
+    {
+      ElapsedTimer timer;
+      bool success = ServerTranscoder::Transcode(target, source, allowedSyntaxes, mode);
+      clock_.AddTranscoding(timer.GetElapsedMicroseconds());
+      return success;
+    }
+
+    virtual bool Transcode(DicomImage& target,
+                           DicomImage& source,
+                           const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                           TranscodingSopInstanceUidMode mode,
+                           unsigned int lossyQuality) ORTHANC_OVERRIDE
+    {
+      ElapsedTimer timer;
+      bool success = ServerTranscoder::Transcode(target, source, allowedSyntaxes, mode, lossyQuality);
+      clock_.AddTranscoding(timer.GetElapsedMicroseconds());
+      return success;
+    }
+  };
+
+
+  struct Parameters
+  {
+    unsigned int                         countInstances_;
+    unsigned int                         countThreads_;
+    unsigned int                         instancesPerSeries_;
+    unsigned int                         seriesPerStudy_;
+    std::map<std::string, unsigned int>  mix_;  // Weights of the types of series
+    std::string                          transcoding_;
+    std::string                          configuration_;
+    std::string                          output_;
+
+    Parameters() :
+      countInstances_(1000),
+      countThreads_(4),
+      instancesPerSeries_(50),
+      seriesPerStudy_(4)
+    {
+      mix_["CT"] = 8;
+      mix_["US"] = 1;
+      mix_["XA"] = 1;
+    }
+  };
+
+
+  class IngestBenchmark : public boost::noncopyable
+  {
+  private:
+    const Parameters&                     parameters_;
+    ServerContext&                        context_;
+    StageClock&                           clock_;
+    std::vector<const InstanceTemplate*>  cycle_;  // Type of the series, by weighted round-robin
+    boost::mutex                          mutex_;
+    unsigned int                          next_;
+    uint64_t                              bytes_;
+    unsigned int                          failures_;
+    LatencySamples                        samples_[Stage_Count];
+
+    bool GetNextInstance(unsigned int& instance)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (next_ < parameters_.countInstances_)
+      {
+        instance = next_++;
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    void Store(unsigned int instance)
+    {
+      const unsigned int series = instance / parameters_.instancesPerSeries_;
+      const unsigned int study = series / parameters_.seriesPerStudy_;
+      const InstanceTemplate& source = *cycle_[series % cycle_.size()];
+
+      std::string buffer;
+      source.Generate(buffer, study, series, instance);
+
+      std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromBuffer(buffer));
+      toStore->SetOrigin(DicomInstanceOrigin::FromPlugins());
+
+      clock_.Reset();
+
+      ElapsedTimer timer;
+      std::string publicId;
+      ServerContext::StoreResult result = context_.Store(publicId, *toStore);
+      const uint64_t store = timer.GetElapsedMicroseconds();
+
+      const uint64_t storage = clock_.GetStorage();
+      const uint64_t transcoding = clock_.GetTranscoding();
+
+      samples_[Stage_Store].Add(store);
+      samples_[Stage_Storage].Add(storage);
+      samples_[Stage_Index].Add(store - std::min(store, storage + transcoding));
+
+      if (transcoding > 0)
+      {
+        samples_[Stage_Transcoding].Add(transcoding);
+      }
+
+      boost::mutex::scoped_lock lock(mutex_);
+      bytes_ += buffer.size();
+
+      if (result.GetStatus() != StoreStatus_Success)
+      {
+        failures_++;
+      }
+    }
+
+    static void Worker(IngestBenchmark* that)
+    {
+      unsigned int instance;
+      while (that->GetNextInstance(instance))
+      {
+        try
+        {
+          that->Store(instance);
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Cannot store instance " << instance << ": " << e.What();
+
+          boost::mutex::scoped_lock lock(that->mutex_);
+          that->failures_++;
+        }
+      }
+    }
+
+  public:
+    IngestBenchmark(const Parameters& parameters,
+                    ServerContext& context,
+                    StageClock& clock,
+                    const std::vector<InstanceTemplate*>& templates) :
+      parameters_(parameters),
+      context_(context),
+      clock_(clock),
+      next_(0),
+      bytes_(0),
+      failures_(0)
+    {
+      for (size_t i = 0; i < templates.size(); i++)
+      {
+        std::map<std::string, unsigned int>::const_iterator weight = parameters.mix_.find(templates[i]->GetName());
+        if (weight != parameters.mix_.end())
+        {
+          for (unsigned int j = 0; j < weight->second; j++)
+          {
+            cycle_.push_back(templates[i]);
+          }
+        }
+      }
+
+      if (cycle_.empty())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "The SOP mix is empty");
+      }
+    }
+
+    void Run(Json::Value& target)
+    {
+      ElapsedTimer timer;
+
+      std::vector<boost::thread*> threads;
+      for (unsigned int i = 0; i < parameters_.countThreads_; i++)
+      {
+        threads.push_back(new boost::thread(Worker, this));
+      }
+
+      for (size_t i = 0; i < threads.size(); i++)
+      {
+        threads[i]->join();
+        delete threads[i];
+      }
+
+      const double seconds = static_cast<double>(timer.GetElapsedMicroseconds()) / 1000000.0;
+
+      target = Json::objectValue;
+      target["Instances"] = parameters_.countInstances_;
+      target["Threads"] = parameters_.countThreads_;
+      target["Failures"] = failures_;
+      target["Seconds"] = seconds;
+      target["InstancesPerSecond"] = static_cast<double>(parameters_.countInstances_) / seconds;
+      target["MegabytesPerSecond"] = static_cast<double>(bytes_) / (1024.0 * 1024.0) / seconds;
+      target["Transcoding"] = parameters_.transcoding_;
+
+      Json::Value mix = Json::objectValue;
+      for (std::map<std::string, unsigned int>::const_iterator
+             it = parameters_.mix_.begin(); it != parameters_.mix_.end(); ++it)
+      {
+        mix[it->first] = it->second;
+      }
+      target["Mix"] = mix;
+
+      Json::Value stages = Json::objectValue;
+      for (int i = 0; i < Stage_Count; i++)
+      {
+        samples_[i].Format(stages[GetStageName(static_cast<Stage>(i))]);
+      }
+      target["LatencyMilliseconds"] = stages;
+    }
+  };
+}
+
+
+static void PrintHelp(const char* path)
+{
+  std::cout
+    << "Usage: " << path << " [OPTION]..." << std::endl
+    << "End-to-end benchmark of the ingest of synthetic DICOM instances by Orthanc," << std::endl
+    << "using an in-memory SQLite database and an in-memory storage area." << std::endl
+    << std::endl
+    << "  --instances=N\t\tnumber of instances to store (default: 1000)" << std::endl
+    << "  --threads=N\t\tnumber of concurrent threads (default: 4)" << std::endl
+    << "  --series-size=N\tnumber of instances per series (default: 50)" << std::endl
+    << "  --study-size=N\tnumber of series per study (default: 4)" << std::endl
+    << "  --mix=CT:W,US:W,XA:W\trelative weights of the 16-bit CT, of the RGB" << std::endl
+    << "\t\t\tultrasound and of the multi-frame series (default: CT:8,US:1,XA:1)" << std::endl
+    << "  --transcode=UID\tenable ingest transcoding to this transfer syntax" << std::endl
+    << "  --config=FILE\t\tOrthanc configuration file" << std::endl
+    << "  --output=FILE\t\twrite the results as JSON to this file" << std::endl
+    << std::endl;
+}
+
+
+static unsigned int ParsePositiveInteger(const std::string& value)
+{
+  unsigned int result;
+
+  try
+  {
+    result = boost::lexical_cast<unsigned int>(value);
+  }
+  catch (boost::bad_lexical_cast&)
+  {
+    throw OrthancException(ErrorCode_ParameterOutOfRange, "Not a positive integer: " + value);
+  }
+
+  if (result == 0)
+  {
+    throw OrthancException(ErrorCode_ParameterOutOfRange, "Not a positive integer: " + value);
+  }
+
+  return result;
+}
+
+
+static void ParseMix(std::map<std::string, unsigned int>& target,
+                     const std::string& value)
+{
+  target.clear();
+
+  std::vector<std::string> tokens;
+  Toolbox::TokenizeString(tokens, value, ',');
+
+  for (size_t i = 0; i < tokens.size(); i++)
+  {
+    std::vector<std::string> items;
+    Toolbox::TokenizeString(items, tokens[i], ':');
+
+    if (items.size() != 2 ||
+        (items[0] != "CT" && items[0] != "US" && items[0] != "XA"))
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Bad SOP mix: " + value);
+    }
+
+    target[items[0]] = boost::lexical_cast<unsigned int>(items[1]);
+  }
+}
+
+
+static bool ParseParameters(Parameters& target,
+                            int argc,
+                            char* argv[])
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string argument(argv[i]);
+
+    if (argument == "--help")
+    {
+      PrintHelp(argv[0]);
+      return false;
+    }
+    else if (boost::starts_with(argument, "--instances="))
+    {
+      target.countInstances_ = ParsePositiveInteger(argument.substr(12));
+    }
+    else if (boost::starts_with(argument, "--threads="))
+    {
+      target.countThreads_ = ParsePositiveInteger(argument.substr(10));
+    }
+    else if (boost::starts_with(argument, "--series-size="))
+    {
+      target.instancesPerSeries_ = ParsePositiveInteger(argument.substr(14));
+    }
+    else if (boost::starts_with(argument, "--study-size="))
+    {
+      target.seriesPerStudy_ = ParsePositiveInteger(argument.substr(13));
+    }
+    else if (boost::starts_with(argument, "--mix="))
+    {
+      ParseMix(target.mix_, argument.substr(6));
+    }
+    else if (boost::starts_with(argument, "--transcode="))
+    {
+      target.transcoding_ = argument.substr(12);
+    }
+    else if (boost::starts_with(argument, "--config="))
+    {
+      target.configuration_ = argument.substr(9);
+    }
+    else if (boost::starts_with(argument, "--output="))
+    {
+      target.output_ = argument.substr(9);
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Unknown option: " + argument);
+    }
+  }
+
+  if (!target.transcoding_.empty() &&
+      !target.configuration_.empty())
+  {
+    throw OrthancException(ErrorCode_ParameterOutOfRange,
+                           "Use the \"IngestTranscoding\" option of the configuration file instead of \"--transcode\"");
+  }
+
+  return true;
+}
+
+
+static void RunBenchmark(Json::Value& results,
+                         const Parameters& parameters)
+{
+  std::string ct, us, xa;
+  SyntheticImages::CreateComputedTomographyDicom(ct);
+  SyntheticImages::CreateUltrasoundDicom(us);
+  SyntheticImages::CreateMultiFrameDicom(xa);
+
+  InstanceTemplate ctTemplate("CT", ct);
+  InstanceTemplate usTemplate("US", us);
+  InstanceTemplate xaTemplate("XA", xa);
+
+  std::vector<InstanceTemplate*> templates;
+  templates.push_back(&ctTemplate);
+  templates.push_back(&usTemplate);
+  templates.push_back(&xaTemplate);
+
+  StageClock clock;
+
+  SQLiteDatabaseWrapper database;   // The SQLite DB is in memory
+  database.Open();
+
+  {
+    PluginStorageAreaAdapter storage(new TimedStorageArea(clock, new MemoryStorageArea));
+
+    ServerContext context(database, storage, false /* not running unit tests */, 10, false /* readonly */);
+    context.SetTranscoder(new TimedTranscoder(clock, parameters.countThreads_));
+    context.SetupJobsEngine(false, false);
+
+    IngestBenchmark benchmark(parameters, context, clock, templates);
+    benchmark.Run(results);
+
+    Json::Value sizes = Json::objectValue;
+    for (size_t i = 0; i < templates.size(); i++)
+    {
+      sizes[templates[i]->GetName()] = static_cast<Json::UInt64>(templates[i]->GetSize());
+    }
+    results["InstanceBytes"] = sizes;
+
+    context.Stop();
+  }
+
+  database.Close();
+}
+
+
+int main(int argc, char* argv[])
+{
+  Parameters parameters;
+
+  try
+  {
+    if (!ParseParameters(parameters, argc, argv))
+    {
+      return 0;
+    }
+  }
+  catch (OrthancException& e)
+  {
+    std::cerr << e.What() << ": " << e.GetDetails() << std::endl;
+    return -1;
+  }
+
+  Logging::Initialize();
+  Toolbox::DetectEndianness();
+
+  int status = 0;
+
+  try
+  {
+    if (parameters.transcoding_.empty())
+    {
+      OrthancInitialize(parameters.configuration_);
+    }
+    else
+    {
+      TemporaryFile configuration;
+
+      Json::Value json = Json::objectValue;
+      json["IngestTranscoding"] = parameters.transcoding_;
+
+      std::string s;
+      Toolbox::WriteStyledJson(s, json);
+      configuration.Write(s);
+
+      OrthancInitialize(configuration.GetPath());
+    }
+
+    Json::Value results;
+    RunBenchmark(results, parameters);
+
+    std::string s;
+    Toolbox::WriteStyledJson(s, results);
+
+    if (parameters.output_.empty())
+    {
+      std::cout << s;
+    }
+    else
+    {
+      SystemToolbox::WriteFile(s, parameters.output_);
+    }
+  }
+  catch (OrthancException& e)
+  {
+    LOG(ERROR) << "Uncaught exception, stopping now: [" << e.What() << "] (code " << e.GetErrorCode() << ")";
+    status = -1;
+  }
+
+  OrthancFinalize();
+  Logging::Finalize();
+
+  return status;
+}
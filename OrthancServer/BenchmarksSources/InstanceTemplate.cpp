@@ -0,0 +1,111 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "InstanceTemplate.h"
+
+#include "../../OrthancFramework/Sources/DicomParsing/ParsedDicomFile.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+namespace Orthanc
+{
+  static const size_t DIGITS = 10;
+
+  static const char* const STUDY = "1.2.276.0.7230010.3.1.2.2.";
+  static const char* const SERIES = "1.2.276.0.7230010.3.1.3.2.";
+  static const char* const INSTANCE = "1.2.276.0.7230010.3.1.4.2.";
+
+
+  static std::string GetPlaceholder(const std::string& prefix)
+  {
+    // The prefix has an even length, so that the placeholder fits
+    // the UI value representation without padding
+    return prefix + std::string(DIGITS, '0');
+  }
+
+
+  static void Patch(std::string& target,
+                    const std::vector<size_t>& offsets,
+                    unsigned int value)
+  {
+    char digits[DIGITS + 1];
+    sprintf(digits, "%010u", value);
+
+    for (size_t i = 0; i < offsets.size(); i++)
+    {
+      memcpy(&target[offsets[i]], digits, DIGITS);
+    }
+  }
+
+
+  void InstanceTemplate::LocatePlaceholders(Offsets& target,
+                                            const std::string& prefix) const
+  {
+    // The SOP Instance UID is also found in the meta-header, as the
+    // Media Storage SOP Instance UID
+    const std::string placeholder = GetPlaceholder(prefix);
+
+    size_t offset = buffer_.find(placeholder);
+    while (offset != std::string::npos)
+    {
+      target.push_back(offset + prefix.size());
+      offset = buffer_.find(placeholder, offset + placeholder.size());
+    }
+
+    if (target.empty())
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+  }
+
+
+  InstanceTemplate::InstanceTemplate(const std::string& name,
+                                     const std::string& dicom) :
+    name_(name)
+  {
+    ParsedDicomFile parsed(dicom);
+    parsed.ReplacePlainString(DICOM_TAG_STUDY_INSTANCE_UID, GetPlaceholder(STUDY));
+    parsed.ReplacePlainString(DICOM_TAG_SERIES_INSTANCE_UID, GetPlaceholder(SERIES));
+    parsed.ReplacePlainString(DICOM_TAG_SOP_INSTANCE_UID, GetPlaceholder(INSTANCE));
+    parsed.SaveToMemoryBuffer(buffer_);
+
+    LocatePlaceholders(study_, STUDY);
+    LocatePlaceholders(series_, SERIES);
+    LocatePlaceholders(instance_, INSTANCE);
+  }
+
+
+  void InstanceTemplate::Generate(std::string& target,
+                                  unsigned int study,
+                                  unsigned int series,
+                                  unsigned int instance) const
+  {
+    target = buffer_;
+    Patch(target, study_, study);
+    Patch(target, series_, series);
+    Patch(target, instance_, instance);
+  }
+}
@@ -0,0 +1,73 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <string>
+#include <vector>
+
+
+namespace Orthanc
+{
+  /**
+   * Template of one type of instance for the benchmarks, whose DICOM
+   * identifiers are replaced by placeholders of constant length (new
+   * in Orthanc 1.12.12). This allows to generate new instances by
+   * overwriting the placeholders in a copy of the buffer, which is
+   * negligible wrt. the cost of the operations that are measured.
+   **/
+  class InstanceTemplate : public boost::noncopyable
+  {
+  private:
+    typedef std::vector<size_t>  Offsets;
+
+    std::string  name_;
+    std::string  buffer_;
+    Offsets      study_;
+    Offsets      series_;
+    Offsets      instance_;
+
+    void LocatePlaceholders(Offsets& target,
+                            const std::string& prefix) const;
+
+  public:
+    InstanceTemplate(const std::string& name,
+                     const std::string& dicom);
+
+    const std::string& GetName() const
+    {
+      return name_;
+    }
+
+    size_t GetSize() const
+    {
+      return buffer_.size();
+    }
+
+    void Generate(std::string& target,
+                  unsigned int study,
+                  unsigned int series,
+                  unsigned int instance) const;
+  };
+}
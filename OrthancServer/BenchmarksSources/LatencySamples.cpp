@@ -0,0 +1,90 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "LatencySamples.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+namespace Orthanc
+{
+  static double GetPercentile(const std::vector<uint64_t>& sorted,
+                              double percentile)
+  {
+    assert(!sorted.empty());
+    size_t rank = static_cast<size_t>(percentile / 100.0 * static_cast<double>(sorted.size()) + 0.5);
+
+    if (rank >= 1)
+    {
+      rank -= 1;
+    }
+
+    return static_cast<double>(sorted[std::min(rank, sorted.size() - 1)]) / 1000.0;
+  }
+
+
+  void LatencySamples::Add(uint64_t microseconds)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    samples_.push_back(microseconds);
+  }
+
+
+  size_t LatencySamples::GetCount()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return samples_.size();
+  }
+
+
+  void LatencySamples::Format(Json::Value& target)
+  {
+    std::vector<uint64_t> sorted;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      sorted = samples_;
+    }
+
+    std::sort(sorted.begin(), sorted.end());
+
+    target = Json::objectValue;
+    target["Count"] = static_cast<Json::UInt64>(sorted.size());
+
+    if (!sorted.empty())
+    {
+      uint64_t sum = 0;
+      for (size_t i = 0; i < sorted.size(); i++)
+      {
+        sum += sorted[i];
+      }
+
+      target["Mean"] = static_cast<double>(sum) / static_cast<double>(sorted.size()) / 1000.0;
+      target["P50"] = GetPercentile(sorted, 50);
+      target["P90"] = GetPercentile(sorted, 90);
+      target["P99"] = GetPercentile(sorted, 99);
+      target["Max"] = static_cast<double>(sorted.back()) / 1000.0;
+    }
+  }
+}
@@ -23,47 +23,32 @@
 
 #pragma once
 
-#include "../../../OrthancFramework/Sources/JobsEngine/SetOfInstancesJob.h"
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <json/value.h>
+#include <stdint.h>
+#include <vector>
+
 
 namespace Orthanc
 {
-  class ServerContext;
-  
-  class CleaningInstancesJob : public SetOfInstancesJob
+  /**
+   * Thread-safe collection of the latencies of one operation in the
+   * benchmarks (new in Orthanc 1.12.12). The samples are provided in
+   * microseconds, and are reported in milliseconds.
+   **/
+  class LatencySamples : public boost::noncopyable
   {
   private:
-    ServerContext&  context_;
-    bool            keepSource_;
-    
-  protected:
-    virtual bool HandleTrailingStep() ORTHANC_OVERRIDE;
-    
-  public:
-    CleaningInstancesJob(ServerContext& context,
-                         bool keepSource) :
-      context_(context),
-      keepSource_(keepSource)
-    {
-    }
+    boost::mutex           mutex_;
+    std::vector<uint64_t>  samples_;
 
-    CleaningInstancesJob(ServerContext& context,
-                         const Json::Value& serialized,
-                         bool defaultKeepSource);
-
-    ServerContext& GetContext() const
-    {
-      return context_;
-    }
-    
-    bool IsKeepSource() const
-    {
-      return keepSource_;
-    }
-    
-    void SetKeepSource(bool keep);
+  public:
+    void Add(uint64_t microseconds);
 
-    virtual bool Serialize(Json::Value& target) const ORTHANC_OVERRIDE;
+    size_t GetCount();
 
-    virtual void Start() ORTHANC_OVERRIDE;
+    // Mean, P50, P90, P99 and maximum, using the nearest-rank method
+    void Format(Json::Value& target);
   };
 }
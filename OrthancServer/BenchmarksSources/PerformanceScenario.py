@@ -0,0 +1,452 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Orthanc - A Lightweight, RESTful DICOM Store
+# Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+# Department, University Hospital of Liege, Belgium
+# Copyright (C) 2017-2023 Osimis S.A., Belgium
+# Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+# Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+#
+# This program is free software: you can redistribute it and/or
+# modify it under the terms of the GNU General Public License as
+# published by the Free Software Foundation, either version 3 of the
+# License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#
+# Reproducible performance scenario, to detect the regressions
+# between two builds of Orthanc (new in Orthanc 1.12.12). The
+# scenario starts the Orthanc server of a build directory that was
+# configured with "-DBUILD_BENCHMARKS=ON", on an empty temporary
+# storage, then successively runs:
+#
+#  1. The ingest of synthetic studies with "OrthancDicomLoadGenerator"
+#     (C-STORE), followed by a C-FIND workload against the server.
+#  2. The "/tools/find" workload of "OrthancFindBenchmark" against
+#     its own database of synthetic resources.
+#  3. The rendering of the ingested instances ("/instances/{id}/rendered").
+#  4. The download of the ingested studies as ZIP archives.
+#
+# The throughputs and the latency percentiles (P50/P99) measured by
+# the clients are complemented by the server-side latencies of the
+# HTTP routes, estimated from the histograms that are published by
+# "/tools/metrics-prometheus". The results are compared with a
+# baseline that was recorded by a previous run ("--update-baseline"),
+# and the script exits with status 1 if some metric has regressed by
+# more than the threshold. The baseline must be recorded on the same
+# machine as the runs it is compared with. Sample invocation:
+#
+#   ./PerformanceScenario.py --build=/tmp/orthanc-build --baseline=baseline.json
+#
+# This script only depends on the Python 3 standard library.
+#
+
+
+import argparse
+import json
+import math
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import urllib.request
+
+
+# Must match the constants of "DicomLoadGenerator.cpp"
+INSTANCES_PER_STUDY = 200
+
+HTTP_PORT = 8142
+DICOM_PORT = 4342
+AET = 'PERFSCENARIO'
+
+
+
+##
+## Measurements
+##
+
+def GetPercentile(sorted_samples, percentile):
+    # Nearest-rank method, consistently with "LatencySamples.cpp"
+    rank = int(percentile / 100.0 * len(sorted_samples) + 0.5)
+    if rank >= 1:
+        rank -= 1
+    return sorted_samples[min(rank, len(sorted_samples) - 1)]
+
+
+class Results:
+    def __init__(self):
+        self.metrics = {}
+
+    def Add(self, name, value, unit, higher_is_better):
+        self.metrics[name] = {
+            'Value' : value,
+            'Unit' : unit,
+            'HigherIsBetter' : higher_is_better,
+        }
+
+    def AddThroughput(self, name, value, unit):
+        self.Add(name + '.throughput', value, unit, True)
+
+    def AddLatencies(self, name, p50, p99):
+        self.Add(name + '.p50', p50, 'ms', False)
+        self.Add(name + '.p99', p99, 'ms', False)
+
+
+def RunHttpWorkload(url, paths, threads):
+    # Returns the throughput (in requests per second) and the sorted
+    # latencies (in milliseconds) of GET requests on the given paths
+    latencies = []
+    failures = []
+    lock = threading.Lock()
+    queue = list(paths)
+
+    def Worker():
+        while True:
+            with lock:
+                if len(queue) == 0:
+                    return
+                path = queue.pop()
+
+            start = time.perf_counter()
+            try:
+                with urllib.request.urlopen(url + path) as answer:
+                    answer.read()
+                elapsed = (time.perf_counter() - start) * 1000.0
+                with lock:
+                    latencies.append(elapsed)
+            except Exception as e:
+                with lock:
+                    failures.append('%s: %s' % (path, e))
+
+    start = time.perf_counter()
+    workers = [ threading.Thread(target = Worker) for i in range(threads) ]
+    for w in workers:
+        w.start()
+    for w in workers:
+        w.join()
+    seconds = time.perf_counter() - start
+
+    if len(failures) > 0:
+        raise Exception('%d HTTP requests have failed, first one: %s' % (len(failures), failures[0]))
+
+    return (len(latencies) / seconds, sorted(latencies))
+
+
+def ParsePrometheusHistograms(text, name):
+    # Returns a dictionary that maps the labels of the histogram
+    # (except "le") to the list of its cumulative buckets
+    pattern = re.compile(r'^' + name + r'_bucket\{(.*)\}\s+(\S+)')
+    histograms = {}
+
+    for line in text.splitlines():
+        m = pattern.match(line)
+        if m != None:
+            labels = {}
+            for item in re.findall(r'(\w+)="((?:[^"\\]|\\.)*)"', m.group(1)):
+                labels[item[0]] = item[1]
+
+            le = labels.pop('le')
+            key = tuple(sorted(labels.items()))
+            histograms.setdefault(key, []).append(
+                (math.inf if le == '+Inf' else float(le), float(m.group(2))))
+
+    for buckets in histograms.values():
+        buckets.sort()
+
+    return histograms
+
+
+def EstimateHistogramQuantile(buckets, quantile):
+    # Linear interpolation within the bucket, as in the
+    # "histogram_quantile()" function of Prometheus
+    total = buckets[-1][1]
+    if total == 0:
+        return None
+
+    rank = quantile * total
+    lower_bound = 0.0
+    lower_count = 0.0
+
+    for (upper_bound, count) in buckets:
+        if count >= rank:
+            if math.isinf(upper_bound):
+                return lower_bound
+            elif count == lower_count:
+                return upper_bound
+            else:
+                return lower_bound + (upper_bound - lower_bound) * (rank - lower_count) / (count - lower_count)
+        lower_bound = upper_bound
+        lower_count = count
+
+    return lower_bound
+
+
+
+##
+## Orthanc server
+##
+
+class OrthancServer:
+    def __init__(self, build, workdir):
+        self.url = 'http://127.0.0.1:%d' % HTTP_PORT
+        self.log = open(os.path.join(workdir, 'Orthanc.log'), 'w')
+
+        storage = os.path.join(workdir, 'OrthancStorage')
+        configuration = os.path.join(workdir, 'Configuration.json')
+
+        with open(configuration, 'w') as f:
+            json.dump({
+                'Name' : 'PerformanceScenario',
+                'StorageDirectory' : storage,
+                'IndexDirectory' : storage,
+                'HttpPort' : HTTP_PORT,
+                'DicomPort' : DICOM_PORT,
+                'DicomAet' : AET,
+                'RemoteAccessAllowed' : False,
+                'AuthenticationEnabled' : False,
+                'MetricsEnabled' : True,
+                'DicomAlwaysAllowStore' : True,
+                'DicomAlwaysAllowFind' : True,
+                'Plugins' : [ ],
+            }, f, indent = 2)
+
+        self.process = subprocess.Popen([ os.path.join(build, 'Orthanc'), configuration ],
+                                        stdout = self.log, stderr = subprocess.STDOUT)
+
+        for i in range(600):
+            if self.process.poll() != None:
+                raise Exception('Orthanc has stopped during its startup, check out: ' + self.log.name)
+            try:
+                self.Get('/system')
+                return
+            except Exception:
+                time.sleep(0.1)
+
+        self.Stop()
+        raise Exception('Orthanc has not started in time')
+
+    def Get(self, path):
+        with urllib.request.urlopen(self.url + path) as answer:
+            return answer.read()
+
+    def GetJson(self, path):
+        return json.loads(self.Get(path))
+
+    def Stop(self):
+        self.process.terminate()
+        try:
+            self.process.wait(timeout = 60)
+        except subprocess.TimeoutExpired:
+            self.process.kill()
+        self.log.close()
+
+
+
+##
+## Scenario
+##
+
+def RunBenchmarkExecutable(build, workdir, name, arguments):
+    output = os.path.join(workdir, name + '.json')
+    subprocess.check_call([ os.path.join(build, name) ] + arguments + [ '--output=' + output ])
+    with open(output, 'r') as f:
+        return json.load(f)
+
+
+def RunScenario(args, workdir):
+    results = Results()
+
+    server = OrthancServer(args.build, workdir)
+
+    try:
+        loadgen = [ '--host=127.0.0.1', '--port=%d' % DICOM_PORT, '--aet=' + AET,
+                    '--threads=%d' % args.threads ]
+
+        print('Ingesting %d studies...' % args.studies)
+        ingest = RunBenchmarkExecutable(args.build, workdir, 'OrthancDicomLoadGenerator', loadgen + [
+            '--operation=store', '--count=%d' % (args.studies * INSTANCES_PER_STUDY) ])
+        if ingest['Failures'] != 0:
+            raise Exception('Some C-STORE have failed')
+        results.AddThroughput('ingest', ingest['OperationsPerSecond'], 'instances/s')
+        results.AddLatencies('ingest', ingest['LatencyMilliseconds']['Store']['P50'],
+                             ingest['LatencyMilliseconds']['Store']['P99'])
+
+        print('Running the C-FIND workload...')
+        cfind = RunBenchmarkExecutable(args.build, workdir, 'OrthancDicomLoadGenerator', loadgen + [
+            '--operation=find', '--count=%d' % args.queries ])
+        results.AddThroughput('c-find', cfind['OperationsPerSecond'], 'queries/s')
+        results.AddLatencies('c-find', cfind['LatencyMilliseconds']['Find']['P50'],
+                             cfind['LatencyMilliseconds']['Find']['P99'])
+
+        instances = server.GetJson('/instances')
+        studies = server.GetJson('/studies')
+        if len(studies) != args.studies:
+            raise Exception('Expected %d studies, found %d' % (args.studies, len(studies)))
+
+        # The seed makes the sequence of the requests reproducible
+        rng = random.Random(42)
+
+        print('Rendering %d instances...' % args.renderings)
+        paths = [ '/instances/%s/rendered' % rng.choice(instances) for i in range(args.renderings) ]
+        (throughput, latencies) = RunHttpWorkload(server.url, paths, args.threads)
+        results.AddThroughput('rendering', throughput, 'requests/s')
+        results.AddLatencies('rendering', GetPercentile(latencies, 50), GetPercentile(latencies, 99))
+
+        print('Downloading %d archives...' % len(studies))
+        paths = [ '/studies/%s/archive' % study for study in studies ]
+        (throughput, latencies) = RunHttpWorkload(server.url, paths, args.threads)
+        results.AddThroughput('archive', throughput, 'requests/s')
+        results.AddLatencies('archive', GetPercentile(latencies, 50), GetPercentile(latencies, 99))
+
+        # Latencies measured by the server itself, which exclude the client and the network
+        histograms = ParsePrometheusHistograms(server.Get('/tools/metrics-prometheus').decode('utf-8'),
+                                               'orthanc_http_request_duration_ms')
+
+        for (name, route) in [ ('rendering', '/instances/{id}/rendered'),
+                               ('archive', '/studies/{id}/archive') ]:
+            key = (('method', 'GET'), ('route', route))
+            if key in histograms:
+                p50 = EstimateHistogramQuantile(histograms[key], 0.5)
+                p99 = EstimateHistogramQuantile(histograms[key], 0.99)
+                if p50 != None and p99 != None:
+                    results.AddLatencies('server.' + name, p50, p99)
+
+    finally:
+        server.Stop()
+
+    print('Running the synthetic find benchmark...')
+    find = RunBenchmarkExecutable(args.build, workdir, 'OrthancFindBenchmark', [
+        '--patients=%d' % args.patients, '--queries=%d' % args.queries,
+        '--threads=%d' % args.threads ])
+    results.AddThroughput('find', find['Find']['QueriesPerSecond'], 'queries/s')
+
+    for (lookup, item) in sorted(find['Find']['Lookups'].items()):
+        if item['LatencyMilliseconds']['Count'] > 0:
+            results.AddLatencies('find.' + lookup, item['LatencyMilliseconds']['P50'],
+                                 item['LatencyMilliseconds']['P99'])
+
+    return results
+
+
+
+##
+## Comparison with the baseline
+##
+
+def Compare(metrics, baseline, threshold):
+    # Returns the list of the names of the metrics that have regressed
+    regressions = []
+
+    print('')
+    print('%-32s %14s %14s %9s' % ('Metric', 'Baseline', 'Current', 'Change'))
+
+    for name in sorted(metrics.keys()):
+        current = metrics[name]
+
+        if not name in baseline:
+            print('%-32s %14s %14.2f %9s' % (name, '-', current['Value'], 'new'))
+            continue
+
+        reference = baseline[name]['Value']
+        if reference == 0:
+            change = 0.0
+        else:
+            change = (current['Value'] - reference) / reference * 100.0
+
+        if current['HigherIsBetter']:
+            regression = (change < -threshold)
+        else:
+            regression = (change > threshold)
+
+        print('%-32s %14.2f %14.2f %+8.1f%%%s' % (name, reference, current['Value'], change,
+                                                  ' REGRESSION' if regression else ''))
+
+        if regression:
+            regressions.append(name)
+
+    return regressions
+
+
+def Main():
+    parser = argparse.ArgumentParser(description = 'Performance regression scenario for Orthanc.')
+    parser.add_argument('--build', required = True,
+                        help = 'Build directory that contains "Orthanc" and the benchmarks')
+    parser.add_argument('--baseline', help = 'JSON file with the baseline results')
+    parser.add_argument('--update-baseline', action = 'store_true',
+                        help = 'Store the results as the new baseline, instead of comparing')
+    parser.add_argument('--threshold', type = float, default = 10.0,
+                        help = 'Relative change (in percent) that is reported as a regression (default: 10)')
+    parser.add_argument('--output', help = 'Write the results as JSON to this file')
+    parser.add_argument('--studies', type = int, default = 10,
+                        help = 'Number of synthetic studies to ingest (default: 10)')
+    parser.add_argument('--queries', type = int, default = 1000,
+                        help = 'Number of C-FIND and /tools/find queries (default: 1000)')
+    parser.add_argument('--renderings', type = int, default = 500,
+                        help = 'Number of rendered frames (default: 500)')
+    parser.add_argument('--patients', type = int, default = 1000,
+                        help = 'Number of patients of the synthetic database (default: 1000)')
+    parser.add_argument('--threads', type = int, default = 4,
+                        help = 'Number of concurrent clients (default: 4)')
+    parser.add_argument('--workdir', help = 'Directory to keep the storage and the logs (default: temporary)')
+    args = parser.parse_args()
+
+    if args.update_baseline and args.baseline == None:
+        parser.error('--update-baseline requires --baseline')
+
+    if args.workdir == None:
+        workdir = tempfile.mkdtemp(prefix = 'OrthancPerformance')
+    else:
+        workdir = args.workdir
+        os.makedirs(workdir, exist_ok = True)
+
+    try:
+        results = RunScenario(args, workdir)
+    finally:
+        if args.workdir == None:
+            shutil.rmtree(workdir, ignore_errors = True)
+
+    if args.output != None:
+        with open(args.output, 'w') as f:
+            json.dump(results.metrics, f, indent = 2, sort_keys = True)
+
+    if args.baseline == None:
+        print(json.dumps(results.metrics, indent = 2, sort_keys = True))
+        return 0
+
+    elif args.update_baseline:
+        with open(args.baseline, 'w') as f:
+            json.dump(results.metrics, f, indent = 2, sort_keys = True)
+        print('Baseline written to: %s' % args.baseline)
+        return 0
+
+    else:
+        with open(args.baseline, 'r') as f:
+            baseline = json.load(f)
+
+        regressions = Compare(results.metrics, baseline, args.threshold)
+
+        if len(regressions) == 0:
+            print('\nNo regression above %.1f%%' % args.threshold)
+            return 0
+        else:
+            print('\n%d regression(s) above %.1f%%: %s' % (len(regressions), args.threshold,
+                                                         ', '.join(regressions)))
+            return 1
+
+
+if __name__ == '__main__':
+    sys.exit(Main())
@@ -0,0 +1,446 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "SyntheticDatabase.h"
+
+#include "../../OrthancFramework/Sources/DicomFormat/DicomInstanceHasher.h"
+#include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+#include "../../OrthancFramework/Sources/Toolbox.h"
+#include "../Sources/DicomInstanceOrigin.h"
+
+#include <boost/date_time/gregorian/gregorian.hpp>
+#include <boost/lexical_cast.hpp>
+#include <stdio.h>
+
+
+namespace Orthanc
+{
+  namespace
+  {
+    struct ModalityInfo
+    {
+      const char*  modality_;
+      unsigned int weight_;             // Relative frequency of the studies
+      double       seriesSizeFactor_;   // Wrt. the mean number of instances per series, 0 for one instance
+      uint64_t     fileSize_;           // Typical size of one instance
+      const char*  sopClassUid_;
+    };
+
+    const ModalityInfo MODALITIES[] =
+    {
+      { "CT", 25, 2.0,    530000, "1.2.840.10008.5.1.4.1.1.2" },
+      { "MR", 18, 1.0,    135000, "1.2.840.10008.5.1.4.1.1.4" },
+      { "CR", 15, 0.0,   9500000, "1.2.840.10008.5.1.4.1.1.1" },
+      { "DX", 10, 0.0,   9500000, "1.2.840.10008.5.1.4.1.1.1.1" },
+      { "US", 10, 0.5,    920000, "1.2.840.10008.5.1.4.1.1.6.1" },
+      { "MG",  6, 0.0,  25000000, "1.2.840.10008.5.1.4.1.1.1.2" },
+      { "SR",  5, 0.0,     12000, "1.2.840.10008.5.1.4.1.1.88.22" },
+      { "PT",  4, 2.0,     65000, "1.2.840.10008.5.1.4.1.1.128" },
+      { "XA",  4, 0.2,  35000000, "1.2.840.10008.5.1.4.1.1.12.1" },
+      { "NM",  3, 0.2,    260000, "1.2.840.10008.5.1.4.1.1.20" }
+    };
+
+    const char* const BODY_PARTS[] =
+    {
+      "CHEST", "ABDOMEN", "HEAD", "PELVIS", "SPINE", "KNEE", "SHOULDER", "BREAST", "HEART", "NECK"
+    };
+
+    const char* const FAMILY_NAMES[] =
+    {
+      "SMITH", "JOHNSON", "WILLIAMS", "BROWN", "JONES", "GARCIA", "MILLER", "DAVIS",
+      "MARTIN", "BERNARD", "DUBOIS", "THOMAS", "ROBERT", "RICHARD", "PETIT", "DURAND",
+      "LEROY", "MOREAU", "SIMON", "LAURENT", "MULLER", "SCHMIDT", "SCHNEIDER", "FISCHER",
+      "WEBER", "MEYER", "WAGNER", "BECKER", "PEETERS", "JANSSENS", "MAES", "JACOBS",
+      "MERTENS", "WILLEMS", "CLAES", "GOOSSENS", "WOUTERS", "ROSSI", "RUSSO", "FERRARI"
+    };
+
+    const char* const GIVEN_NAMES[] =
+    {
+      "JOHN", "MARY", "JAMES", "PATRICIA", "ROBERT", "JENNIFER", "MICHAEL", "LINDA",
+      "MARIE", "JEAN", "PIERRE", "ANNE", "LUCAS", "EMMA", "NOAH", "OLIVIA"
+    };
+
+    const size_t COUNT_MODALITIES = sizeof(MODALITIES) / sizeof(ModalityInfo);
+    const size_t COUNT_BODY_PARTS = sizeof(BODY_PARTS) / sizeof(const char*);
+    const size_t COUNT_FAMILY_NAMES = sizeof(FAMILY_NAMES) / sizeof(const char*);
+    const size_t COUNT_GIVEN_NAMES = sizeof(GIVEN_NAMES) / sizeof(const char*);
+  }
+
+
+  static const ModalityInfo& GetStudyModalityInfo(unsigned int study)
+  {
+    unsigned int total = 0;
+    for (size_t i = 0; i < COUNT_MODALITIES; i++)
+    {
+      total += MODALITIES[i].weight_;
+    }
+
+    unsigned int value = SyntheticDatabase::Hash(study, 3) % total;
+
+    for (size_t i = 0; i < COUNT_MODALITIES; i++)
+    {
+      if (value < MODALITIES[i].weight_)
+      {
+        return MODALITIES[i];
+      }
+      else
+      {
+        value -= MODALITIES[i].weight_;
+      }
+    }
+
+    throw OrthancException(ErrorCode_InternalError);
+  }
+
+
+  static const ModalityInfo& GetModalityInfo(const std::string& modality)
+  {
+    for (size_t i = 0; i < COUNT_MODALITIES; i++)
+    {
+      if (modality == MODALITIES[i].modality_)
+      {
+        return MODALITIES[i];
+      }
+    }
+
+    throw OrthancException(ErrorCode_InternalError);
+  }
+
+
+  static unsigned int GetRandomSize(unsigned int mean,
+                                    uint32_t value,
+                                    uint32_t salt)
+  {
+    // Uniform distribution between 1 and "2 * mean - 1"
+    if (mean <= 1)
+    {
+      return 1;
+    }
+    else
+    {
+      return 1 + SyntheticDatabase::Hash(value, salt) % (2 * mean - 1);
+    }
+  }
+
+
+  static std::string FormatUid(const char* prefix,
+                               unsigned int index)
+  {
+    return std::string(prefix) + boost::lexical_cast<std::string>(index);
+  }
+
+
+  SyntheticDatabase::SyntheticDatabase() :
+    countPatients_(1000),
+    studiesPerPatient_(3),
+    seriesPerStudy_(4),
+    instancesPerSeries_(50)
+  {
+  }
+
+
+  void SyntheticDatabase::SetCountPatients(unsigned int count)
+  {
+    countPatients_ = count;
+  }
+
+
+  void SyntheticDatabase::SetStudiesPerPatient(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    studiesPerPatient_ = count;
+  }
+
+
+  void SyntheticDatabase::SetSeriesPerStudy(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    seriesPerStudy_ = count;
+  }
+
+
+  void SyntheticDatabase::SetInstancesPerSeries(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    instancesPerSeries_ = count;
+  }
+
+
+  void SyntheticDatabase::StoreStudy(ServerIndex& index,
+                                     unsigned int& nextSeries,
+                                     unsigned int& nextInstance,
+                                     unsigned int patient,
+                                     unsigned int study) const
+  {
+    const ModalityInfo& modality = GetStudyModalityInfo(study);
+    const std::string remoteAet = std::string(modality.modality_) + "_SCANNER";
+
+    const uint32_t time = Hash(study, 4) % (12 * 3600);  // Between 07:00 and 19:00
+    char studyTime[16];
+    sprintf(studyTime, "%02u%02u%02u", 7 + time / 3600, (time / 60) % 60, time % 60);
+
+    const unsigned int birthYear = 1930 + Hash(patient, 5) % 90;
+    char birthDate[16];
+    sprintf(birthDate, "%04u%02u%02u", birthYear, 1 + Hash(patient, 6) % 12, 1 + Hash(patient, 7) % 28);
+
+    DicomMap summary;
+    summary.SetValue(DICOM_TAG_PATIENT_ID, GetPatientId(patient), false);
+    summary.SetValue(DICOM_TAG_PATIENT_NAME, GetFamilyName(patient) + "^" +
+                     GIVEN_NAMES[Hash(patient, 8) % COUNT_GIVEN_NAMES], false);
+    summary.SetValue(DICOM_TAG_PATIENT_BIRTH_DATE, birthDate, false);
+    summary.SetValue(DICOM_TAG_PATIENT_SEX, (Hash(patient, 9) % 2 == 0 ? "F" : "M"), false);
+    summary.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, GetStudyInstanceUid(study), false);
+    summary.SetValue(DICOM_TAG_STUDY_DATE, GetStudyDate(study), false);
+    summary.SetValue(DICOM_TAG_STUDY_TIME, studyTime, false);
+    summary.SetValue(DICOM_TAG_STUDY_DESCRIPTION, std::string(modality.modality_) + " " + GetStudyBodyPart(study), false);
+    summary.SetValue(DICOM_TAG_ACCESSION_NUMBER, GetAccessionNumber(study), false);
+    summary.SetValue(DICOM_TAG_STUDY_ID, boost::lexical_cast<std::string>(study % 10000), false);
+    summary.SetValue(DICOM_TAG_INSTITUTION_NAME, (Hash(study, 10) % 4 == 0 ? "Clinic" : "University Hospital"), false);
+    summary.SetValue(DICOM_TAG_REFERRING_PHYSICIAN_NAME, std::string(FAMILY_NAMES[Hash(study, 11) % COUNT_FAMILY_NAMES]) + "^DR", false);
+
+    const unsigned int countSeries = GetRandomSize(seriesPerStudy_, study, 12);
+
+    std::string studyPublicId;
+
+    for (unsigned int i = 0; i < countSeries; i++)
+    {
+      const unsigned int series = nextSeries++;
+
+      // Some reports are attached at the end of the imaging studies
+      const bool isReport = (i > 0 && i == countSeries - 1 && Hash(series, 13) % 10 == 0);
+      const ModalityInfo& seriesModality = (isReport ? GetModalityInfo("SR") : modality);
+
+      unsigned int countInstances = 1;
+      if (seriesModality.seriesSizeFactor_ > 0)
+      {
+        const double mean = seriesModality.seriesSizeFactor_ * static_cast<double>(instancesPerSeries_);
+        countInstances = GetRandomSize(mean < 1.0 ? 1 : static_cast<unsigned int>(mean), series, 14);
+      }
+
+      summary.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, FormatUid("1.2.276.0.7230010.3.1.3.9.", series), false);
+      summary.SetValue(DICOM_TAG_SERIES_NUMBER, boost::lexical_cast<std::string>(i + 1), false);
+      summary.SetValue(DICOM_TAG_SERIES_DATE, GetStudyDate(study), false);
+      summary.SetValue(DICOM_TAG_SERIES_DESCRIPTION, std::string(seriesModality.modality_) + " series " +
+                       boost::lexical_cast<std::string>(i + 1), false);
+      summary.SetValue(DICOM_TAG_MODALITY, seriesModality.modality_, false);
+      summary.SetValue(DICOM_TAG_BODY_PART_EXAMINED, GetStudyBodyPart(study), false);
+      summary.SetValue(DICOM_TAG_SOP_CLASS_UID, seriesModality.sopClassUid_, false);
+
+      StatelessDatabaseOperations::MetadataMap metadata;
+      metadata[std::make_pair(ResourceType_Series, MetadataType_Series_ExpectedNumberOfInstances)] =
+        boost::lexical_cast<std::string>(countInstances);
+
+      for (unsigned int j = 0; j < countInstances; j++)
+      {
+        const unsigned int instance = nextInstance++;
+
+        summary.SetValue(DICOM_TAG_SOP_INSTANCE_UID, FormatUid("1.2.276.0.7230010.3.1.4.9.", instance), false);
+        summary.SetValue(DICOM_TAG_INSTANCE_NUMBER, boost::lexical_cast<std::string>(j + 1), false);
+
+        // The attachment is only registered in the database
+        StatelessDatabaseOperations::Attachments attachments;
+        attachments.push_back(FileInfo(Toolbox::GenerateUuid(), FileContentType_Dicom, seriesModality.fileSize_,
+                                       "d41d8cd98f00b204e9800998ecf8427e"));
+
+        std::map<MetadataType, std::string> instanceMetadata;
+        StoreStatus status = index.Store(
+          instanceMetadata, summary, attachments, metadata,
+          DicomInstanceOrigin::FromDicomProtocol("127.0.0.1", remoteAet.c_str(), "ORTHANC"),
+          false /* don't overwrite */, true, DicomTransferSyntax_LittleEndianExplicit,
+          true, 1200 /* pixel data offset */, ValueRepresentation_OtherWord, false /* not a reconstruction */);
+
+        if (status != StoreStatus_Success)
+        {
+          throw OrthancException(ErrorCode_InternalError, "Cannot store synthetic instance " +
+                                 boost::lexical_cast<std::string>(instance));
+        }
+      }
+
+      if (studyPublicId.empty())
+      {
+        DicomInstanceHasher hasher(summary);
+        studyPublicId = hasher.HashStudy();
+      }
+    }
+
+    const std::string label = GetStudyLabel(study);
+    if (!label.empty())
+    {
+      index.ModifyLabel(studyPublicId, ResourceType_Study, label, StatelessDatabaseOperations::LabelOperation_Add);
+    }
+  }
+
+
+  uint64_t SyntheticDatabase::Populate(ServerIndex& index) const
+  {
+    unsigned int nextStudy = 0;
+    unsigned int nextSeries = 0;
+    unsigned int nextInstance = 0;
+
+    for (unsigned int patient = 0; patient < countPatients_; patient++)
+    {
+      const unsigned int countStudies = GetRandomSize(studiesPerPatient_, patient, 2);
+
+      for (unsigned int i = 0; i < countStudies; i++)
+      {
+        StoreStudy(index, nextSeries, nextInstance, patient, nextStudy++);
+      }
+
+      if ((patient + 1) % 1000 == 0)
+      {
+        LOG(WARNING) << "Synthetic database: " << (patient + 1) << " patients out of "
+                     << countPatients_ << " (" << nextInstance << " instances)";
+      }
+    }
+
+    return nextInstance;
+  }
+
+
+  unsigned int SyntheticDatabase::GetCountStudies() const
+  {
+    unsigned int count = 0;
+
+    for (unsigned int patient = 0; patient < countPatients_; patient++)
+    {
+      count += GetRandomSize(studiesPerPatient_, patient, 2);
+    }
+
+    return count;
+  }
+
+
+  uint32_t SyntheticDatabase::Hash(uint32_t value,
+                                   uint32_t salt)
+  {
+    // Finalizer of MurmurHash3, to get a uniform distribution from
+    // consecutive indices
+    uint32_t h = value ^ (salt * 0x9e3779b9u);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+  }
+
+
+  std::string SyntheticDatabase::GetPatientId(unsigned int patient)
+  {
+    char buffer[32];
+    sprintf(buffer, "P%08u", patient);
+    return buffer;
+  }
+
+
+  std::string SyntheticDatabase::GetFamilyName(unsigned int patient)
+  {
+    // Skewed distribution, so that some family names are much more
+    // frequent than the others
+    const uint64_t value = Hash(patient, 1) % COUNT_FAMILY_NAMES;
+    return FAMILY_NAMES[(value * value) / COUNT_FAMILY_NAMES];
+  }
+
+
+  std::string SyntheticDatabase::GetStudyInstanceUid(unsigned int study)
+  {
+    return FormatUid("1.2.276.0.7230010.3.1.2.9.", study);
+  }
+
+
+  std::string SyntheticDatabase::GetAccessionNumber(unsigned int study)
+  {
+    char buffer[32];
+    sprintf(buffer, "A%010u", study);
+    return buffer;
+  }
+
+
+  std::string SyntheticDatabase::GetStudyDate(unsigned int study)
+  {
+    return FormatDate(Hash(study, 15) % 3652);
+  }
+
+
+  std::string SyntheticDatabase::FormatDate(unsigned int daysSince2015)
+  {
+    const boost::gregorian::date date = boost::gregorian::date(2015, 1, 1) + boost::gregorian::days(daysSince2015);
+    return boost::gregorian::to_iso_string(date);
+  }
+
+
+  std::string SyntheticDatabase::GetStudyModality(unsigned int study)
+  {
+    return GetStudyModalityInfo(study).modality_;
+  }
+
+
+  std::string SyntheticDatabase::GetStudyBodyPart(unsigned int study)
+  {
+    if (GetStudyModality(study) == "MG")
+    {
+      return "BREAST";
+    }
+    else
+    {
+      return BODY_PARTS[Hash(study, 16) % COUNT_BODY_PARTS];
+    }
+  }
+
+
+  std::string SyntheticDatabase::GetStudyLabel(unsigned int study)
+  {
+    // 5% of urgent studies, 10% of research studies, 2% of teaching studies
+    const uint32_t value = Hash(study, 17) % 100;
+
+    if (value < 5)
+    {
+      return "urgent";
+    }
+    else if (value < 15)
+    {
+      return "research";
+    }
+    else if (value < 17)
+    {
+      return "teaching";
+    }
+    else
+    {
+      return "";
+    }
+  }
+}
@@ -0,0 +1,105 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../Sources/ServerIndex.h"
+
+
+namespace Orthanc
+{
+  /**
+   * Generator of a large database of synthetic patients, studies,
+   * series and instances (new in Orthanc 1.12.12). The resources are
+   * written directly into the index, without any DICOM file: The
+   * attachments are registered in the database, but their content is
+   * not written to the storage area.
+   *
+   * The values of the main DICOM tags are a deterministic function
+   * of the index of the resource, so that the query benchmarks can
+   * look for values that are known to exist.
+   **/
+  class SyntheticDatabase : public boost::noncopyable
+  {
+  private:
+    unsigned int  countPatients_;
+
+    // Mean sizes of the resources, the actual sizes being uniformly
+    // distributed between 1 and twice the mean
+    unsigned int  studiesPerPatient_;
+    unsigned int  seriesPerStudy_;
+    unsigned int  instancesPerSeries_;
+
+    void StoreStudy(ServerIndex& index,
+                    unsigned int& nextSeries,
+                    unsigned int& nextInstance,
+                    unsigned int patient,
+                    unsigned int study) const;
+
+  public:
+    SyntheticDatabase();
+
+    void SetCountPatients(unsigned int count);
+
+    unsigned int GetCountPatients() const
+    {
+      return countPatients_;
+    }
+
+    void SetStudiesPerPatient(unsigned int count);
+
+    void SetSeriesPerStudy(unsigned int count);
+
+    void SetInstancesPerSeries(unsigned int count);
+
+    // Must be applied to an empty database. Returns the number of
+    // generated instances.
+    uint64_t Populate(ServerIndex& index) const;
+
+    // The studies are numbered from zero, in the order of the patients
+    unsigned int GetCountStudies() const;
+
+    static uint32_t Hash(uint32_t value,
+                         uint32_t salt);
+
+    static std::string GetPatientId(unsigned int patient);
+
+    static std::string GetFamilyName(unsigned int patient);
+
+    static std::string GetStudyInstanceUid(unsigned int study);
+
+    static std::string GetAccessionNumber(unsigned int study);
+
+    // Dates are uniformly distributed over 10 years, from 2015
+    static std::string GetStudyDate(unsigned int study);
+
+    static std::string FormatDate(unsigned int daysSince2015);
+
+    // Weighted according to the usual activity of a hospital
+    static std::string GetStudyModality(unsigned int study);
+
+    static std::string GetStudyBodyPart(unsigned int study);
+
+    static std::string GetStudyLabel(unsigned int study);  // Empty if no label
+  };
+}
@@ -0,0 +1,245 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "SyntheticImages.h"
+
+#include "../../OrthancFramework/Sources/DicomFormat/DicomMap.h"
+#include "../../OrthancFramework/Sources/DicomParsing/ParsedDicomFile.h"
+#include "../../OrthancFramework/Sources/Images/Image.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cmath>
+
+
+namespace Orthanc
+{
+  namespace
+  {
+    // Linear congruential generator, to get the same images on all
+    // the platforms (contrarily to "rand()")
+    class Generator : public boost::noncopyable
+    {
+    private:
+      uint32_t state_;
+
+    public:
+      explicit Generator(uint32_t seed) :
+        state_(seed)
+      {
+      }
+
+      unsigned int Next(unsigned int range)
+      {
+        state_ = state_ * 1664525u + 1013904223u;
+        return (state_ >> 8) % range;
+      }
+    };
+  }
+
+
+  static double GetRadius(unsigned int x,
+                          unsigned int y,
+                          unsigned int width,
+                          unsigned int height)
+  {
+    const double dx = static_cast<double>(x) - static_cast<double>(width) / 2.0;
+    const double dy = static_cast<double>(y) - static_cast<double>(height) / 2.0;
+    return sqrt(dx * dx + dy * dy);
+  }
+
+
+  ImageAccessor* SyntheticImages::CreateComputedTomography()
+  {
+    std::unique_ptr<Image> image(new Image(PixelFormat_Grayscale16, CT_WIDTH, CT_HEIGHT, false));
+    Generator generator(42);
+
+    for (unsigned int y = 0; y < CT_HEIGHT; y++)
+    {
+      uint16_t* p = reinterpret_cast<uint16_t*>(image->GetRow(y));
+
+      for (unsigned int x = 0; x < CT_WIDTH; x++, p++)
+      {
+        // Air around a disk of soft tissues, with a dense "bone" ring
+        const double r = GetRadius(x, y, CT_WIDTH, CT_HEIGHT);
+
+        unsigned int value;
+        if (r > 220.0)
+        {
+          value = 24;
+        }
+        else if (r > 200.0)
+        {
+          value = 2000 + generator.Next(200);
+        }
+        else
+        {
+          value = 1000 + static_cast<unsigned int>(40.0 * sin(static_cast<double>(x) / 9.0)) + generator.Next(60);
+        }
+
+        *p = static_cast<uint16_t>(value);
+      }
+    }
+
+    return image.release();
+  }
+
+
+  ImageAccessor* SyntheticImages::CreateUltrasound()
+  {
+    std::unique_ptr<Image> image(new Image(PixelFormat_RGB24, US_WIDTH, US_HEIGHT, false));
+    Generator generator(43);
+
+    for (unsigned int y = 0; y < US_HEIGHT; y++)
+    {
+      uint8_t* p = reinterpret_cast<uint8_t*>(image->GetRow(y));
+
+      for (unsigned int x = 0; x < US_WIDTH; x++, p += 3)
+      {
+        // Speckle inside a sector, with a colored Doppler region
+        const double r = GetRadius(x, y + US_HEIGHT / 2, US_WIDTH, US_HEIGHT);
+        const uint8_t speckle = (r < 450.0 ? static_cast<uint8_t>(generator.Next(160)) : 0);
+
+        if (x > 280 && x < 360 && y > 180 && y < 260)
+        {
+          p[0] = static_cast<uint8_t>(speckle / 4 + 150);
+          p[1] = static_cast<uint8_t>(speckle / 4);
+          p[2] = static_cast<uint8_t>(200 - speckle / 4);
+        }
+        else
+        {
+          p[0] = speckle;
+          p[1] = speckle;
+          p[2] = speckle;
+        }
+      }
+    }
+
+    return image.release();
+  }
+
+
+  ImageAccessor* SyntheticImages::CreateMultiFrame()
+  {
+    std::unique_ptr<Image> image(new Image(PixelFormat_Grayscale8, MULTI_FRAME_WIDTH,
+                                           MULTI_FRAME_HEIGHT * MULTI_FRAME_COUNT, false));
+    Generator generator(44);
+
+    for (unsigned int frame = 0; frame < MULTI_FRAME_COUNT; frame++)
+    {
+      for (unsigned int y = 0; y < MULTI_FRAME_HEIGHT; y++)
+      {
+        uint8_t* p = reinterpret_cast<uint8_t*>(image->GetRow(frame * MULTI_FRAME_HEIGHT + y));
+
+        for (unsigned int x = 0; x < MULTI_FRAME_WIDTH; x++, p++)
+        {
+          // A moving blob, as in a cine loop
+          const double r = GetRadius(x + 2 * frame, y, MULTI_FRAME_WIDTH, MULTI_FRAME_HEIGHT);
+          *p = static_cast<uint8_t>((r < 60.0 ? 180 : 40) + generator.Next(40));
+        }
+      }
+    }
+
+    return image.release();
+  }
+
+
+  static void CreateDicom(std::string& target,
+                          const ImageAccessor& image,
+                          const std::string& modality,
+                          unsigned int numberOfFrames,
+                          unsigned int index)
+  {
+    // Valid (and constant) DICOM identifiers
+    const std::string suffix = boost::lexical_cast<std::string>(index);
+
+    DicomMap tags;
+    tags.SetValue(DICOM_TAG_PATIENT_ID, "BENCHMARK", false);
+    tags.SetValue(DICOM_TAG_PATIENT_NAME, "Benchmark^Synthetic", false);
+    tags.SetValue(DICOM_TAG_STUDY_DESCRIPTION, "Synthetic study", false);
+    tags.SetValue(DICOM_TAG_SERIES_DESCRIPTION, "Synthetic " + modality, false);
+    tags.SetValue(DICOM_TAG_MODALITY, modality, false);
+    tags.SetValue(DICOM_TAG_SOP_CLASS_UID, "1.2.840.10008.5.1.4.1.1.7", false);  // Secondary capture
+    tags.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "1.2.276.0.7230010.3.1.2.1." + suffix, false);
+    tags.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "1.2.276.0.7230010.3.1.3.1." + suffix, false);
+    tags.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "1.2.276.0.7230010.3.1.4.1." + suffix, false);
+
+    // Usual acquisition tags, to get a realistic size of the header
+    tags.SetValue(DicomTag(0x0008, 0x0020), "20260101", false);        // Study Date
+    tags.SetValue(DicomTag(0x0008, 0x0030), "120000", false);          // Study Time
+    tags.SetValue(DicomTag(0x0008, 0x0050), "ACC" + suffix, false);    // Accession Number
+    tags.SetValue(DicomTag(0x0008, 0x0070), "Orthanc", false);         // Manufacturer
+    tags.SetValue(DicomTag(0x0008, 0x0080), "Synthetic Hospital", false);  // Institution Name
+    tags.SetValue(DicomTag(0x0008, 0x0090), "Referring^Physician", false);  // Referring Physician's Name
+    tags.SetValue(DicomTag(0x0010, 0x0030), "19700101", false);        // Patient's Birth Date
+    tags.SetValue(DicomTag(0x0010, 0x0040), "O", false);               // Patient's Sex
+    tags.SetValue(DicomTag(0x0018, 0x0015), "CHEST", false);           // Body Part Examined
+    tags.SetValue(DicomTag(0x0018, 0x0050), "1.25", false);            // Slice Thickness
+    tags.SetValue(DicomTag(0x0018, 0x0060), "120", false);             // KVP
+    tags.SetValue(DicomTag(0x0020, 0x0011), "1", false);               // Series Number
+    tags.SetValue(DicomTag(0x0020, 0x0013), "1", false);               // Instance Number
+    tags.SetValue(DicomTag(0x0020, 0x0032), "-250\\-250\\100", false);   // Image Position Patient
+    tags.SetValue(DicomTag(0x0020, 0x0037), "1\\0\\0\\0\\1\\0", false);  // Image Orientation Patient
+    tags.SetValue(DicomTag(0x0028, 0x0030), "0.9765625\\0.9765625", false);  // Pixel Spacing
+
+    ParsedDicomFile dicom(tags, Encoding_Latin1, true /* permissive */);
+    dicom.EmbedImage(image);
+
+    if (numberOfFrames > 1)
+    {
+      // The frames are stacked vertically in "image", which
+      // corresponds to the layout of an uncompressed multi-frame
+      // pixel data
+      if (image.GetHeight() % numberOfFrames != 0)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      dicom.ReplacePlainString(DICOM_TAG_ROWS, boost::lexical_cast<std::string>(image.GetHeight() / numberOfFrames));
+      dicom.ReplacePlainString(DICOM_TAG_NUMBER_OF_FRAMES, boost::lexical_cast<std::string>(numberOfFrames));
+    }
+
+    dicom.SaveToMemoryBuffer(target);
+  }
+
+
+  void SyntheticImages::CreateComputedTomographyDicom(std::string& target)
+  {
+    std::unique_ptr<ImageAccessor> image(CreateComputedTomography());
+    CreateDicom(target, *image, "CT", 1, 1);
+  }
+
+
+  void SyntheticImages::CreateUltrasoundDicom(std::string& target)
+  {
+    std::unique_ptr<ImageAccessor> image(CreateUltrasound());
+    CreateDicom(target, *image, "US", 1, 2);
+  }
+
+
+  void SyntheticImages::CreateMultiFrameDicom(std::string& target)
+  {
+    std::unique_ptr<ImageAccessor> image(CreateMultiFrame());
+    CreateDicom(target, *image, "XA", MULTI_FRAME_COUNT, 3);
+  }
+}
@@ -0,0 +1,68 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../../OrthancFramework/Sources/Images/ImageAccessor.h"
+
+#include <string>
+
+
+namespace Orthanc
+{
+  /**
+   * Reproducible inputs for the benchmarks (new in Orthanc
+   * 1.12.12). The pixels are generated by a fixed pseudo-random
+   * generator on top of smooth structures, so that the images
+   * compress like real images, and so that the results of two
+   * versions of Orthanc can be compared.
+   **/
+  class SyntheticImages : public boost::noncopyable
+  {
+  public:
+    static const unsigned int CT_WIDTH = 512;
+    static const unsigned int CT_HEIGHT = 512;
+    static const unsigned int US_WIDTH = 640;
+    static const unsigned int US_HEIGHT = 480;
+    static const unsigned int MULTI_FRAME_WIDTH = 256;
+    static const unsigned int MULTI_FRAME_HEIGHT = 256;
+    static const unsigned int MULTI_FRAME_COUNT = 32;
+
+    // 16-bit CT slice (Grayscale16)
+    static ImageAccessor* CreateComputedTomography();
+
+    // RGB ultrasound frame (RGB24)
+    static ImageAccessor* CreateUltrasound();
+
+    // All the frames of a 8-bit multi-frame image, stacked vertically
+    // (Grayscale8, of height "MULTI_FRAME_HEIGHT * MULTI_FRAME_COUNT")
+    static ImageAccessor* CreateMultiFrame();
+
+    // Uncompressed DICOM instances (Explicit VR Little Endian)
+    static void CreateComputedTomographyDicom(std::string& target);
+
+    static void CreateUltrasoundDicom(std::string& target);
+
+    static void CreateMultiFrameDicom(std::string& target);
+  };
+}
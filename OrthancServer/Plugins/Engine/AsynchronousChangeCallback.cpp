@@ -0,0 +1,330 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../../Sources/PrecompiledHeadersServer.h"
+#include "AsynchronousChangeCallback.h"
+
+#include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/OrthancException.h"
+#include "PluginsCallbacksMetrics.h"
+#include "PluginsErrorDictionary.h"
+
+#include <boost/functional/hash.hpp>
+
+
+namespace Orthanc
+{
+  static const int32_t QUEUE_TIMEOUT = 100;  // In milliseconds
+
+
+  class AsynchronousChangeCallback::Change : public IDynamicObject
+  {
+  private:
+    OrthancPluginChangeType    changeType_;
+    OrthancPluginResourceType  resourceType_;
+    bool                       hasResource_;
+    std::string                resource_;
+
+  public:
+    Change(OrthancPluginChangeType changeType,
+           OrthancPluginResourceType resourceType,
+           const char* resource) :
+      changeType_(changeType),
+      resourceType_(resourceType),
+      hasResource_(resource != NULL),
+      resource_(resource == NULL ? "" : resource)
+    {
+    }
+
+    void Apply(PluginsErrorDictionary& dictionary,
+               PluginsCallbacksMetrics& metrics,
+               OrthancPluginOnChangeCallback callback) const
+    {
+      OrthancPluginErrorCode error;
+
+      {
+        PluginsCallbacksMetrics::Timer timer(metrics, callback, "change");
+        error = callback(changeType_, resourceType_, hasResource_ ? resource_.c_str() : NULL);
+        timer.SetResult(error);
+      }
+
+      if (error != OrthancPluginErrorCode_Success)
+      {
+        // There is no caller to report the error to
+        dictionary.LogError(error, true);
+        CLOG(ERROR, PLUGINS) << "Error in an asynchronous OnChange callback, the change is lost";
+      }
+    }
+  };
+
+
+  class AsynchronousChangeCallback::Lane : public boost::noncopyable
+  {
+  private:
+    PluginsErrorDictionary&        dictionary_;
+    PluginsCallbacksMetrics&       metrics_;
+    OrthancPluginOnChangeCallback  callback_;
+    BlockingSharedMessageQueue     queue_;
+    bool                           continue_;
+    boost::thread                  thread_;
+
+    static void Worker(Lane* that)
+    {
+      for (;;)
+      {
+        std::unique_ptr<IDynamicObject> change(that->queue_.Dequeue(QUEUE_TIMEOUT));
+
+        if (change.get() != NULL)
+        {
+          try
+          {
+            dynamic_cast<const Change&>(*change).Apply(that->dictionary_, that->metrics_, that->callback_);
+          }
+          catch (OrthancException& e)
+          {
+            CLOG(ERROR, PLUGINS) << "Exception in an asynchronous OnChange callback: " << e.What();
+          }
+          catch (...)
+          {
+            CLOG(ERROR, PLUGINS) << "Native exception in an asynchronous OnChange callback";
+          }
+        }
+        else if (!that->continue_)
+        {
+          // The queue is drained and a stop was requested
+          return;
+        }
+      }
+    }
+
+  public:
+    Lane(PluginsErrorDictionary& dictionary,
+         PluginsCallbacksMetrics& metrics,
+         OrthancPluginOnChangeCallback callback,
+         unsigned int queueSize) :
+      dictionary_(dictionary),
+      metrics_(metrics),
+      callback_(callback),
+      queue_(queueSize),
+      continue_(true)
+    {
+      thread_ = boost::thread(Worker, this);
+    }
+
+    ~Lane()
+    {
+      Stop();
+    }
+
+    // Returns "false" iff the change was discarded
+    bool Enqueue(std::unique_ptr<IDynamicObject>& change,
+                 bool discardOnOverflow)
+    {
+      if (discardOnOverflow)
+      {
+        return queue_.Enqueue(change, 0);
+      }
+      else
+      {
+        while (continue_)
+        {
+          if (queue_.Enqueue(change, QUEUE_TIMEOUT))
+          {
+            return true;
+          }
+        }
+
+        return false;
+      }
+    }
+
+    void Stop()
+    {
+      continue_ = false;
+
+      if (thread_.joinable())
+      {
+        thread_.join();
+      }
+    }
+
+    size_t GetQueueDepth()
+    {
+      return queue_.GetSize();
+    }
+  };
+
+
+  AsynchronousChangeCallback::Lane& AsynchronousChangeCallback::SelectLane(const std::string& orderingKey)
+  {
+    assert(!lanes_.empty());
+
+    size_t index;
+
+    if (ordering_ == OrthancPluginChangeOrdering_None)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      index = nextLane_;
+      nextLane_ = (nextLane_ + 1) % lanes_.size();
+    }
+    else
+    {
+      index = boost::hash<std::string>()(orderingKey) % lanes_.size();
+    }
+
+    assert(lanes_[index] != NULL);
+    return *lanes_[index];
+  }
+
+
+  AsynchronousChangeCallback::AsynchronousChangeCallback(PluginsErrorDictionary& dictionary,
+                                                         PluginsCallbacksMetrics& metrics,
+                                                         OrthancPluginOnChangeCallback callback,
+                                                         unsigned int threadsCount,
+                                                         unsigned int queueSize,
+                                                         OrthancPluginChangeOrdering ordering,
+                                                         bool discardOnOverflow) :
+    callback_(callback),
+    ordering_(ordering),
+    discardOnOverflow_(discardOnOverflow),
+    nextLane_(0),
+    droppedCount_(0),
+    stopped_(false)
+  {
+    if (callback == NULL ||
+        threadsCount == 0 ||
+        queueSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (ordering != OrthancPluginChangeOrdering_None &&
+        ordering != OrthancPluginChangeOrdering_Resource &&
+        ordering != OrthancPluginChangeOrdering_Study)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Unknown ordering of the changes");
+    }
+
+    lanes_.reserve(threadsCount);
+
+    try
+    {
+      for (unsigned int i = 0; i < threadsCount; i++)
+      {
+        lanes_.push_back(new Lane(dictionary, metrics, callback, queueSize));
+      }
+    }
+    catch (...)
+    {
+      for (size_t i = 0; i < lanes_.size(); i++)
+      {
+        delete lanes_[i];
+      }
+
+      throw;
+    }
+  }
+
+
+  AsynchronousChangeCallback::~AsynchronousChangeCallback()
+  {
+    for (size_t i = 0; i < lanes_.size(); i++)
+    {
+      assert(lanes_[i] != NULL);
+      delete lanes_[i];
+    }
+  }
+
+
+  void AsynchronousChangeCallback::Enqueue(const std::string& orderingKey,
+                                           OrthancPluginChangeType changeType,
+                                           OrthancPluginResourceType resourceType,
+                                           const char* resource)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (stopped_)
+      {
+        return;
+      }
+    }
+
+    std::unique_ptr<IDynamicObject> change(new Change(changeType, resourceType, resource));
+
+    if (!SelectLane(orderingKey).Enqueue(change, discardOnOverflow_))
+    {
+      uint64_t count;
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        droppedCount_++;
+        count = droppedCount_;
+      }
+
+      CLOG(WARNING, PLUGINS) << "The queue of an asynchronous OnChange callback is full, discarding change about: "
+                             << (resource == NULL ? "" : resource) << " (" << count << " changes discarded so far)";
+    }
+  }
+
+
+  void AsynchronousChangeCallback::Stop()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (stopped_)
+      {
+        return;
+      }
+
+      stopped_ = true;
+    }
+
+    for (size_t i = 0; i < lanes_.size(); i++)
+    {
+      assert(lanes_[i] != NULL);
+      lanes_[i]->Stop();
+    }
+  }
+
+
+  size_t AsynchronousChangeCallback::GetQueueDepth()
+  {
+    size_t depth = 0;
+
+    for (size_t i = 0; i < lanes_.size(); i++)
+    {
+      assert(lanes_[i] != NULL);
+      depth += lanes_[i]->GetQueueDepth();
+    }
+
+    return depth;
+  }
+
+
+  uint64_t AsynchronousChangeCallback::GetDroppedCount()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return droppedCount_;
+  }
+}
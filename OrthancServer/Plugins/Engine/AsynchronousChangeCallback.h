@@ -0,0 +1,95 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#if ORTHANC_ENABLE_PLUGINS != 1
+#  error The plugin support is disabled
+#endif
+
+#include "../../../OrthancFramework/Sources/MultiThreading/BlockingSharedMessageQueue.h"
+#include "../Include/orthanc/OrthancCPlugin.h"
+
+#include <vector>
+
+namespace Orthanc
+{
+  class PluginsCallbacksMetrics;
+  class PluginsErrorDictionary;
+
+  /**
+   * Invokes an OnChange callback that was registered by
+   * "OrthancPluginRegisterOnChangeCallback2()" from a pool of
+   * threads. Each thread ("lane") has its own bounded queue. The
+   * changes sharing the same ordering key are routed to the same
+   * lane, which preserves their relative order.
+   **/
+  class AsynchronousChangeCallback : public boost::noncopyable
+  {
+  private:
+    class Change;
+    class Lane;
+
+    OrthancPluginOnChangeCallback  callback_;
+    OrthancPluginChangeOrdering    ordering_;
+    bool                           discardOnOverflow_;
+    std::vector<Lane*>             lanes_;
+    boost::mutex                   mutex_;
+    size_t                         nextLane_;
+    uint64_t                       droppedCount_;
+    bool                           stopped_;
+
+    Lane& SelectLane(const std::string& orderingKey);
+
+  public:
+    AsynchronousChangeCallback(PluginsErrorDictionary& dictionary,
+                               PluginsCallbacksMetrics& metrics,
+                               OrthancPluginOnChangeCallback callback,
+                               unsigned int threadsCount,
+                               unsigned int queueSize,
+                               OrthancPluginChangeOrdering ordering,
+                               bool discardOnOverflow);
+
+    ~AsynchronousChangeCallback();
+
+    OrthancPluginChangeOrdering GetOrdering() const
+    {
+      return ordering_;
+    }
+
+    // The ordering key is ignored if the ordering is "None"
+    void Enqueue(const std::string& orderingKey,
+                 OrthancPluginChangeType changeType,
+                 OrthancPluginResourceType resourceType,
+                 const char* resource);
+
+    // Waits for the pending changes to be processed, then stops the
+    // threads. The changes that are enqueued afterward are discarded.
+    void Stop();
+
+    size_t GetQueueDepth();
+
+    uint64_t GetDroppedCount();
+  };
+}
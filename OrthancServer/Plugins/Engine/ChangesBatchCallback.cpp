@@ -0,0 +1,208 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../../Sources/PrecompiledHeadersServer.h"
+#include "ChangesBatchCallback.h"
+
+#include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/OrthancException.h"
+#include "../../Sources/ServerContext.h"
+#include "PluginsCallbacksMetrics.h"
+#include "PluginsEnumerations.h"
+#include "PluginsErrorDictionary.h"
+
+#include <vector>
+
+
+namespace Orthanc
+{
+  static const unsigned int WAIT_TIMEOUT = 100;   // In milliseconds
+  static const unsigned int RETRY_DELAY = 1000;   // In milliseconds
+
+
+  bool ChangesBatchCallback::Invoke(const std::list<ServerIndexChange>& changes)
+  {
+    // The strings are owned by "changes", that is not modified during the call
+    std::vector<OrthancPluginChangeEntry> batch;
+    batch.reserve(changes.size());
+
+    for (std::list<ServerIndexChange>::const_iterator it = changes.begin(); it != changes.end(); ++it)
+    {
+      OrthancPluginChangeEntry change;
+      change.seq = it->GetSeq();
+      change.changeType = Plugins::Convert(it->GetChangeType());
+      change.resourceType = Plugins::Convert(it->GetResourceType());
+      change.resourceId = it->GetPublicId().c_str();
+      change.date = it->GetDate().c_str();
+      batch.push_back(change);
+    }
+
+    OrthancPluginErrorCode error;
+
+    {
+      PluginsCallbacksMetrics::Timer timer(metrics_, callback_, "changes_batch");
+      error = callback_(&batch[0], static_cast<uint32_t>(batch.size()));
+      timer.SetResult(error);
+    }
+
+    if (error == OrthancPluginErrorCode_Success)
+    {
+      return true;
+    }
+    else
+    {
+      dictionary_.LogError(error, true);
+      CLOG(ERROR, PLUGINS) << "Error in a batched changes callback, the batch after change "
+                           << since_ << " will be submitted again";
+      return false;
+    }
+  }
+
+
+  void ChangesBatchCallback::Sleep(unsigned int milliseconds)
+  {
+    // Sleep by small steps, so that "Stop()" is not delayed
+    for (unsigned int t = 0; t < milliseconds && continue_; t += WAIT_TIMEOUT)
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(WAIT_TIMEOUT));
+    }
+  }
+
+
+  void ChangesBatchCallback::Worker(ChangesBatchCallback* that,
+                                    ServerContext* context)
+  {
+    assert(that != NULL &&
+           context != NULL);
+
+    while (that->continue_)
+    {
+      // Read before the database, so that no commit is missed by "WaitChange()"
+      const uint64_t generation = context->GetChangesFeed().GetGeneration();
+
+      try
+      {
+        if (that->since_ < 0)
+        {
+          // Start from the end of the log
+          uint64_t committedWrites;
+          context->GetIndex().GetContentStamp(that->since_, committedWrites);
+        }
+
+        std::list<ServerIndexChange> changes;
+        const bool done = context->GetIndex().GetChanges(changes, that->since_, that->maxBatchSize_);
+
+        if (!changes.empty())
+        {
+          if (that->Invoke(changes))
+          {
+            that->since_ = changes.back().GetSeq();
+
+            if (!done)
+            {
+              continue;  // Don't wait, as more changes are pending
+            }
+          }
+          else
+          {
+            that->Sleep(RETRY_DELAY);
+            continue;
+          }
+        }
+      }
+      catch (OrthancException& e)
+      {
+        CLOG(ERROR, PLUGINS) << "Exception in a batched changes callback: " << e.What();
+        that->Sleep(RETRY_DELAY);
+        continue;
+      }
+      catch (...)
+      {
+        CLOG(ERROR, PLUGINS) << "Native exception in a batched changes callback";
+        that->Sleep(RETRY_DELAY);
+        continue;
+      }
+
+      if (!context->GetChangesFeed().WaitChange(generation, WAIT_TIMEOUT) &&
+          context->GetChangesFeed().IsStopped())
+      {
+        // The feed doesn't wait anymore during the shutdown of Orthanc
+        that->Sleep(WAIT_TIMEOUT);
+      }
+    }
+  }
+
+
+  ChangesBatchCallback::ChangesBatchCallback(PluginsErrorDictionary& dictionary,
+                                             PluginsCallbacksMetrics& metrics,
+                                             OrthancPluginChangesBatchCallback callback,
+                                             unsigned int maxBatchSize,
+                                             int64_t since) :
+    dictionary_(dictionary),
+    metrics_(metrics),
+    callback_(callback),
+    maxBatchSize_(maxBatchSize),
+    since_(since),
+    continue_(false)
+  {
+    if (callback == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    if (maxBatchSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The size of the batches of changes must be positive");
+    }
+  }
+
+
+  ChangesBatchCallback::~ChangesBatchCallback()
+  {
+    Stop();
+  }
+
+
+  void ChangesBatchCallback::Start(ServerContext& context)
+  {
+    if (continue_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    continue_ = true;
+    thread_ = boost::thread(Worker, this, &context);
+  }
+
+
+  void ChangesBatchCallback::Stop()
+  {
+    continue_ = false;
+
+    if (thread_.joinable())
+    {
+      thread_.join();
+    }
+  }
+}
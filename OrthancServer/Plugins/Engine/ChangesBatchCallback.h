@@ -0,0 +1,83 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#if ORTHANC_ENABLE_PLUGINS != 1
+#  error The plugin support is disabled
+#endif
+
+#include "../Include/orthanc/OrthancCPlugin.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <list>
+
+namespace Orthanc
+{
+  class PluginsCallbacksMetrics;
+  class PluginsErrorDictionary;
+  class ServerContext;
+  struct ServerIndexChange;
+
+  /**
+   * Consumes the changes log of the database on behalf of a callback
+   * that was registered by "OrthancPluginRegisterChangesBatchCallback()".
+   * A dedicated thread reads the log by batches, starting after the
+   * sequence number "since" (the cursor), and sleeps on the changes
+   * feed of the server context when the end of the log is reached.
+   * The cursor only moves forward once the callback succeeds.
+   **/
+  class ChangesBatchCallback : public boost::noncopyable
+  {
+  private:
+    PluginsErrorDictionary&            dictionary_;
+    PluginsCallbacksMetrics&           metrics_;
+    OrthancPluginChangesBatchCallback  callback_;
+    unsigned int                       maxBatchSize_;
+    int64_t                            since_;
+    bool                               continue_;
+    boost::thread                      thread_;
+
+    bool Invoke(const std::list<ServerIndexChange>& changes);
+
+    void Sleep(unsigned int milliseconds);
+
+    static void Worker(ChangesBatchCallback* that,
+                       ServerContext* context);
+
+  public:
+    ChangesBatchCallback(PluginsErrorDictionary& dictionary,
+                         PluginsCallbacksMetrics& metrics,
+                         OrthancPluginChangesBatchCallback callback,
+                         unsigned int maxBatchSize,
+                         int64_t since);
+
+    ~ChangesBatchCallback();
+
+    void Start(ServerContext& context);
+
+    void Stop();
+  };
+}
@@ -0,0 +1,219 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../../Sources/PrecompiledHeadersServer.h"
+#include "CoalescedChangeCallback.h"
+
+#include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/OrthancException.h"
+#include "PluginsCallbacksMetrics.h"
+#include "PluginsErrorDictionary.h"
+
+
+namespace Orthanc
+{
+  void CoalescedChangeCallback::Notify(const std::string& resourceId,
+                                       const Pending& pending)
+  {
+    OrthancPluginErrorCode error;
+
+    {
+      PluginsCallbacksMetrics::Timer timer(metrics_, callback_, "coalesced_change");
+      error = callback_(resourceType_, resourceId.c_str(), pending.lastChangeType_, pending.countChanges_);
+      timer.SetResult(error);
+    }
+
+    if (error != OrthancPluginErrorCode_Success)
+    {
+      // There is no caller to report the error to
+      dictionary_.LogError(error, true);
+      CLOG(ERROR, PLUGINS) << "Error in a coalesced OnChange callback, the notification about "
+                           << resourceId << " is lost";
+    }
+  }
+
+
+  void CoalescedChangeCallback::Worker(CoalescedChangeCallback* that)
+  {
+    for (;;)
+    {
+      std::string resourceId;
+      Pending pending;
+
+      {
+        boost::mutex::scoped_lock lock(that->mutex_);
+
+        for (;;)
+        {
+          if (that->deadlines_.empty())
+          {
+            if (!that->continue_)
+            {
+              return;  // All the notifications have been sent, and a stop was requested
+            }
+
+            that->condition_.wait(lock);
+          }
+          else if (!that->continue_ ||
+                   that->deadlines_.front().first <= boost::posix_time::microsec_clock::universal_time())
+          {
+            break;
+          }
+          else
+          {
+            // Sleep exactly until the end of the oldest window
+            that->condition_.timed_wait(lock, that->deadlines_.front().first);
+          }
+        }
+
+        resourceId = that->deadlines_.front().second;
+        that->deadlines_.pop_front();
+
+        PendingResources::iterator found = that->pending_.find(resourceId);
+        assert(found != that->pending_.end());
+        pending = found->second;
+        that->pending_.erase(found);
+      }
+
+      try
+      {
+        that->Notify(resourceId, pending);
+      }
+      catch (OrthancException& e)
+      {
+        CLOG(ERROR, PLUGINS) << "Exception in a coalesced OnChange callback: " << e.What();
+      }
+      catch (...)
+      {
+        CLOG(ERROR, PLUGINS) << "Native exception in a coalesced OnChange callback";
+      }
+    }
+  }
+
+
+  CoalescedChangeCallback::CoalescedChangeCallback(PluginsErrorDictionary& dictionary,
+                                                   PluginsCallbacksMetrics& metrics,
+                                                   OrthancPluginCoalescedChangeCallback callback,
+                                                   OrthancPluginResourceType resourceType,
+                                                   unsigned int windowMilliseconds) :
+    dictionary_(dictionary),
+    metrics_(metrics),
+    callback_(callback),
+    resourceType_(resourceType),
+    window_(boost::posix_time::milliseconds(windowMilliseconds)),
+    continue_(true)
+  {
+    if (callback == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    if (resourceType != OrthancPluginResourceType_Patient &&
+        resourceType != OrthancPluginResourceType_Study &&
+        resourceType != OrthancPluginResourceType_Series)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "The changes can only be coalesced at the patient, study or series level");
+    }
+
+    if (windowMilliseconds == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The window of the coalesced changes must be positive");
+    }
+
+    thread_ = boost::thread(Worker, this);
+  }
+
+
+  CoalescedChangeCallback::~CoalescedChangeCallback()
+  {
+    Stop();
+  }
+
+
+  void CoalescedChangeCallback::Enqueue(OrthancPluginChangeType changeType,
+                                        OrthancPluginResourceType resourceType,
+                                        const char* resource)
+  {
+    if (resourceType != resourceType_ ||
+        resource == NULL)
+    {
+      return;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!continue_)
+    {
+      return;
+    }
+
+    PendingResources::iterator found = pending_.find(resource);
+    if (found == pending_.end())
+    {
+      // Open a new window for this resource
+      Pending pending;
+      pending.lastChangeType_ = changeType;
+      pending.countChanges_ = 1;
+      pending_[resource] = pending;
+
+      const bool wasEmpty = deadlines_.empty();
+      deadlines_.push_back(std::make_pair(boost::posix_time::microsec_clock::universal_time() + window_,
+                                          std::string(resource)));
+
+      if (wasEmpty)
+      {
+        condition_.notify_one();
+      }
+    }
+    else
+    {
+      found->second.lastChangeType_ = changeType;
+      found->second.countChanges_++;
+    }
+  }
+
+
+  void CoalescedChangeCallback::Stop()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      continue_ = false;
+    }
+
+    condition_.notify_one();
+
+    if (thread_.joinable())
+    {
+      thread_.join();
+    }
+  }
+
+
+  size_t CoalescedChangeCallback::GetPendingCount()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return pending_.size();
+  }
+}
@@ -0,0 +1,103 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#if ORTHANC_ENABLE_PLUGINS != 1
+#  error The plugin support is disabled
+#endif
+
+#include "../Include/orthanc/OrthancCPlugin.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <deque>
+#include <map>
+
+namespace Orthanc
+{
+  class PluginsCallbacksMetrics;
+  class PluginsErrorDictionary;
+
+  /**
+   * Invokes a callback that was registered by
+   * "OrthancPluginRegisterCoalescedChangeCallback()". The changes
+   * about the resources of one level are coalesced by time windows:
+   * The first change about a resource opens its window, and one
+   * single notification is sent by a dedicated thread once the
+   * window has expired. As all the windows have the same duration,
+   * the resources are notified in the order they were opened.
+   **/
+  class CoalescedChangeCallback : public boost::noncopyable
+  {
+  private:
+    struct Pending
+    {
+      OrthancPluginChangeType  lastChangeType_;
+      uint32_t                 countChanges_;
+    };
+
+    typedef std::map<std::string, Pending>  PendingResources;
+    typedef std::pair<boost::posix_time::ptime, std::string>  Deadline;
+
+    PluginsErrorDictionary&               dictionary_;
+    PluginsCallbacksMetrics&              metrics_;
+    OrthancPluginCoalescedChangeCallback  callback_;
+    OrthancPluginResourceType             resourceType_;
+    boost::posix_time::time_duration      window_;
+    boost::mutex                          mutex_;
+    boost::condition_variable             condition_;
+    PendingResources                      pending_;
+    std::deque<Deadline>                  deadlines_;
+    bool                                  continue_;
+    boost::thread                         thread_;
+
+    void Notify(const std::string& resourceId,
+                const Pending& pending);
+
+    static void Worker(CoalescedChangeCallback* that);
+
+  public:
+    CoalescedChangeCallback(PluginsErrorDictionary& dictionary,
+                            PluginsCallbacksMetrics& metrics,
+                            OrthancPluginCoalescedChangeCallback callback,
+                            OrthancPluginResourceType resourceType,
+                            unsigned int windowMilliseconds);
+
+    ~CoalescedChangeCallback();
+
+    // The changes about other levels are ignored
+    void Enqueue(OrthancPluginChangeType changeType,
+                 OrthancPluginResourceType resourceType,
+                 const char* resource);
+
+    // Sends the pending notifications without waiting for the end of
+    // their windows, then stops the thread. The changes that are
+    // enqueued afterward are discarded.
+    void Stop();
+
+    size_t GetPendingCount();
+  };
+}
@@ -1691,6 +1691,14 @@ namespace Orthanc
   }
 
 
+  IDatabaseWrapper::ITransaction* OrthancPluginDatabase::StartReplicaTransaction(IDatabaseListener& listener,
+                                                                                         unsigned int maxStaleness)
+  {
+    // Not supported: "HasReadReplicasSupport()" is always "false"
+    THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+  }
+
+
   unsigned int OrthancPluginDatabase::GetDatabaseVersion()
   {
     if (extensions_.getDatabaseVersion != NULL)
@@ -1300,6 +1300,14 @@ namespace Orthanc
     }
   }
 
+
+  IDatabaseWrapper::ITransaction* OrthancPluginDatabaseV3::StartReplicaTransaction(IDatabaseListener& listener,
+                                                                                           unsigned int maxStaleness)
+  {
+    // Not supported: "HasReadReplicasSupport()" is always "false"
+    THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+  }
+
   
   unsigned int OrthancPluginDatabaseV3::GetDatabaseVersion()
   {
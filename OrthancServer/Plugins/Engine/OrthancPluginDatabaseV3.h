@@ -73,6 +73,9 @@ namespace Orthanc
                                                              IDatabaseListener& listener)
       ORTHANC_OVERRIDE;
 
+    virtual IDatabaseWrapper::ITransaction* StartReplicaTransaction(IDatabaseListener& listener,
+                                                                    unsigned int maxStaleness) ORTHANC_OVERRIDE;
+
     virtual unsigned int GetDatabaseVersion() ORTHANC_OVERRIDE;
 
     virtual void Upgrade(unsigned int targetVersion,
@@ -85,6 +88,10 @@ namespace Orthanc
 
     uint64_t MeasureLatency() ORTHANC_OVERRIDE;
 
+    void PublishMetrics(MetricsRegistry& registry) ORTHANC_OVERRIDE
+    {
+    }
+
     bool HasIntegratedFind() const ORTHANC_OVERRIDE
     {
       return false;
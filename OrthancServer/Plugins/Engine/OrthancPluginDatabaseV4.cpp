@@ -427,10 +427,11 @@ namespace Orthanc
     OrthancPluginDatabaseV4&  database_;
     IDatabaseListener&        listener_;
     void*                     transaction_;
-    
-    void ExecuteTransaction(DatabasePluginMessages::TransactionResponse& response,
-                            DatabasePluginMessages::TransactionOperation operation,
-                            const DatabasePluginMessages::TransactionRequest& request)
+    DatabasePluginMessages::Batch::Request  pending_;  // Write operations that are not sent yet
+
+    void ExecuteTransactionNow(DatabasePluginMessages::TransactionResponse& response,
+                               DatabasePluginMessages::TransactionOperation operation,
+                               const DatabasePluginMessages::TransactionRequest& request)
     {
       DatabasePluginMessages::Request fullRequest;
       fullRequest.set_type(DatabasePluginMessages::REQUEST_TRANSACTION);
@@ -443,6 +444,72 @@ namespace Orthanc
     
       response.CopyFrom(fullResponse.transaction_response());
     }
+
+
+    // Sends the queued write operations in one single round-trip
+    void FlushPendingOperations()
+    {
+      if (pending_.operations().empty())
+      {
+        return;
+      }
+
+      DatabasePluginMessages::TransactionRequest request;
+      request.mutable_batch()->Swap(&pending_);
+
+      DatabasePluginMessages::TransactionResponse response;  // Ignored
+
+      if (request.batch().operations().size() == 1)
+      {
+        const DatabasePluginMessages::TransactionRequest& single = request.batch().operations(0);
+        ExecuteTransactionNow(response, single.operation(), single);
+      }
+      else
+      {
+        ExecuteTransactionNow(response, DatabasePluginMessages::OPERATION_BATCH, request);
+      }
+    }
+
+
+    /**
+     * The write operations that don't return a value are not sent
+     * immediately if the plugin supports batches: They are sent
+     * together before the next operation, which reduces the number of
+     * round-trips to the database (new in Orthanc 1.12.12). As a
+     * consequence, their errors are reported by this next operation,
+     * which aborts the transaction anyway.
+     **/
+    void QueueTransaction(DatabasePluginMessages::TransactionOperation operation,
+                          DatabasePluginMessages::TransactionRequest& request /* will be modified */)
+    {
+      static const int MAX_BATCH_SIZE = 256;
+
+      if (database_.HasBatchSupport())
+      {
+        DatabasePluginMessages::TransactionRequest* queued = pending_.add_operations();
+        queued->Swap(&request);
+        queued->set_operation(operation);
+
+        if (pending_.operations().size() >= MAX_BATCH_SIZE)
+        {
+          FlushPendingOperations();
+        }
+      }
+      else
+      {
+        DatabasePluginMessages::TransactionResponse response;  // Ignored
+        ExecuteTransactionNow(response, operation, request);
+      }
+    }
+
+
+    void ExecuteTransaction(DatabasePluginMessages::TransactionResponse& response,
+                            DatabasePluginMessages::TransactionOperation operation,
+                            const DatabasePluginMessages::TransactionRequest& request)
+    {
+      FlushPendingOperations();
+      ExecuteTransactionNow(response, operation, request);
+    }
     
     
     void ExecuteTransaction(DatabasePluginMessages::TransactionResponse& response,
@@ -497,9 +564,12 @@ namespace Orthanc
     
 
   public:
+    // "replicaMaxStaleness" is only used by read-only transactions
+    // (new in Orthanc 1.12.12). Zero means the primary database.
     Transaction(OrthancPluginDatabaseV4& database,
                 IDatabaseListener& listener,
-                TransactionType type) :
+                TransactionType type,
+                unsigned int replicaMaxStaleness) :
       database_(database),
       listener_(listener),
       transaction_(NULL)
@@ -510,9 +580,15 @@ namespace Orthanc
       {
         case TransactionType_ReadOnly:
           request.mutable_start_transaction()->set_type(DatabasePluginMessages::TRANSACTION_READ_ONLY);
+          request.mutable_start_transaction()->set_replica_max_staleness(replicaMaxStaleness);
           break;
 
         case TransactionType_ReadWrite:
+          if (replicaMaxStaleness != 0)
+          {
+            throw OrthancException(ErrorCode_InternalError);
+          }
+
           request.mutable_start_transaction()->set_type(DatabasePluginMessages::TRANSACTION_READ_WRITE);
           break;
 
@@ -557,6 +633,7 @@ namespace Orthanc
 
     virtual void Rollback() ORTHANC_OVERRIDE
     {
+      pending_.Clear();  // The queued operations are cancelled anyway
       ExecuteTransaction(DatabasePluginMessages::OPERATION_ROLLBACK);
     }
     
@@ -586,7 +663,7 @@ namespace Orthanc
       request.mutable_add_attachment()->mutable_attachment()->set_custom_data(attachment.GetCustomData());  // New in 1.12.8
       request.mutable_add_attachment()->set_revision(revision);
 
-      ExecuteTransaction(DatabasePluginMessages::OPERATION_ADD_ATTACHMENT, request);
+      QueueTransaction(DatabasePluginMessages::OPERATION_ADD_ATTACHMENT, request);
     }
 
 
@@ -625,7 +702,7 @@ namespace Orthanc
       request.mutable_delete_metadata()->set_id(id);
       request.mutable_delete_metadata()->set_type(type);
 
-      ExecuteTransaction(DatabasePluginMessages::OPERATION_DELETE_METADATA, request);
+      QueueTransaction(DatabasePluginMessages::OPERATION_DELETE_METADATA, request);
     }
 
     
@@ -982,7 +1059,7 @@ namespace Orthanc
       request.mutable_log_change()->set_resource_id(internalId);
       request.mutable_log_change()->set_date(date);
 
-      ExecuteTransaction(DatabasePluginMessages::OPERATION_LOG_CHANGE, request);
+      QueueTransaction(DatabasePluginMessages::OPERATION_LOG_CHANGE, request);
     }
 
     
@@ -1000,7 +1077,7 @@ namespace Orthanc
       request.mutable_log_exported_resource()->set_series_instance_uid(resource.GetSeriesInstanceUid());
       request.mutable_log_exported_resource()->set_sop_instance_uid(resource.GetSopInstanceUid());
 
-      ExecuteTransaction(DatabasePluginMessages::OPERATION_LOG_EXPORTED_RESOURCE, request);
+      QueueTransaction(DatabasePluginMessages::OPERATION_LOG_EXPORTED_RESOURCE, request);
     }
 
     
@@ -1242,7 +1319,7 @@ namespace Orthanc
       request.mutable_set_global_property()->set_property(property);
       request.mutable_set_global_property()->set_value(value);
 
-      ExecuteTransaction(DatabasePluginMessages::OPERATION_SET_GLOBAL_PROPERTY, request);
+      QueueTransaction(DatabasePluginMessages::OPERATION_SET_GLOBAL_PROPERTY, request);
     }
 
     
@@ -1251,7 +1328,7 @@ namespace Orthanc
       DatabasePluginMessages::TransactionRequest request;
       request.mutable_clear_main_dicom_tags()->set_id(id);
 
-      ExecuteTransaction(DatabasePluginMessages::OPERATION_CLEAR_MAIN_DICOM_TAGS, request);
+      QueueTransaction(DatabasePluginMessages::OPERATION_CLEAR_MAIN_DICOM_TAGS, request);
     }
 
     
@@ -1266,7 +1343,7 @@ namespace Orthanc
       request.mutable_set_metadata()->set_value(value);
       request.mutable_set_metadata()->set_revision(revision);
 
-      ExecuteTransaction(DatabasePluginMessages::OPERATION_SET_METADATA, request);
+      QueueTransaction(DatabasePluginMessages::OPERATION_SET_METADATA, request);
     }
 
     
@@ -1277,7 +1354,7 @@ namespace Orthanc
       request.mutable_set_protected_patient()->set_patient_id(internalId);
       request.mutable_set_protected_patient()->set_protected_patient(isProtected);
 
-      ExecuteTransaction(DatabasePluginMessages::OPERATION_SET_PROTECTED_PATIENT, request);
+      QueueTransaction(DatabasePluginMessages::OPERATION_SET_PROTECTED_PATIENT, request);
     }
 
 
@@ -1412,7 +1489,7 @@ namespace Orthanc
         metadata->set_value(it->GetValue());
       }
 
-      ExecuteTransaction(DatabasePluginMessages::OPERATION_SET_RESOURCES_CONTENT, request);
+      QueueTransaction(DatabasePluginMessages::OPERATION_SET_RESOURCES_CONTENT, request);
     }
 
     
@@ -1502,7 +1579,7 @@ namespace Orthanc
         request.mutable_add_label()->set_id(resource);
         request.mutable_add_label()->set_label(label);
 
-        ExecuteTransaction(DatabasePluginMessages::OPERATION_ADD_LABEL, request);
+        QueueTransaction(DatabasePluginMessages::OPERATION_ADD_LABEL, request);
       }
       else
       {
@@ -1521,7 +1598,7 @@ namespace Orthanc
         request.mutable_remove_label()->set_id(resource);
         request.mutable_remove_label()->set_label(label);
 
-        ExecuteTransaction(DatabasePluginMessages::OPERATION_REMOVE_LABEL, request);
+        QueueTransaction(DatabasePluginMessages::OPERATION_REMOVE_LABEL, request);
       }
       else
       {
@@ -2123,6 +2200,53 @@ namespace Orthanc
       }
     }
 
+
+    virtual void GetResourceStatistics(uint64_t& countStudies,
+                                       uint64_t& countSeries,
+                                       uint64_t& countInstances,
+                                       uint64_t& compressedSize,
+                                       uint64_t& uncompressedSize,
+                                       uint64_t& dicomCompressedSize,
+                                       uint64_t& dicomUncompressedSize,
+                                       int64_t id) ORTHANC_OVERRIDE
+    {
+      // Not part of the database SDK: "HasResourceStatisticsSupport()" is always "false"
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
+
+    virtual uint64_t DeleteChangesBefore(const std::string& date,
+                                         uint32_t limit) ORTHANC_OVERRIDE
+    {
+      // Not part of the database SDK: "HasChangesPruningSupport()" is always "false"
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
+
+    virtual uint64_t DeleteExportedResourcesBefore(const std::string& date,
+                                                   uint32_t limit) ORTHANC_OVERRIDE
+    {
+      // Not part of the database SDK: "HasChangesPruningSupport()" is always "false"
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
+
+    virtual uint64_t DeleteChangesUpTo(int64_t seq,
+                                       uint32_t limit) ORTHANC_OVERRIDE
+    {
+      // Not part of the database SDK: "HasChangesPruningSupport()" is always "false"
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
+
+    virtual void ExplainFind(Json::Value& target,
+                             const FindRequest& request,
+                             const Capabilities& capabilities) ORTHANC_OVERRIDE
+    {
+      // Not part of the database SDK: "HasFindExplainSupport()" is always "false"
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
   };
 
 
@@ -2135,7 +2259,8 @@ namespace Orthanc
     definition_(database),
     serverIdentifier_(serverIdentifier),
     open_(false),
-    databaseVersion_(0)
+    databaseVersion_(0),
+    supportsBatch_(false)
   {
     CLOG(INFO, PLUGINS) << "Identifier of this Orthanc server for the global properties "
                         << "of the custom database: \"" << serverIdentifier << "\"";
@@ -2217,6 +2342,8 @@ namespace Orthanc
       dbCapabilities_.SetQueuesSupport(systemInfo.supports_queues());
       dbCapabilities_.SetReserveQueueValueSupport(systemInfo.supports_reserve_queue_value());
       dbCapabilities_.SetAttachmentCustomDataSupport(systemInfo.has_attachment_custom_data());
+      supportsBatch_ = systemInfo.supports_batch();
+      dbCapabilities_.SetReadReplicasSupport(systemInfo.supports_read_replicas());
     }
 
     open_ = true;
@@ -2264,7 +2391,26 @@ namespace Orthanc
     }
     else
     {
-      return new Transaction(*this, listener, type);
+      return new Transaction(*this, listener, type, 0 /* primary database */);
+    }
+  }
+
+
+  IDatabaseWrapper::ITransaction* OrthancPluginDatabaseV4::StartReplicaTransaction(IDatabaseListener& listener,
+                                                                                   unsigned int maxStaleness)
+  {
+    if (!open_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else if (!dbCapabilities_.HasReadReplicasSupport() ||
+             maxStaleness == 0)
+    {
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+    else
+    {
+      return new Transaction(*this, listener, TransactionType_ReadOnly, maxStaleness);
     }
   }
 
@@ -2292,7 +2438,7 @@ namespace Orthanc
     else
     {
       VoidDatabaseListener listener;
-      Transaction transaction(*this, listener, TransactionType_ReadWrite);
+      Transaction transaction(*this, listener, TransactionType_ReadWrite, 0);
 
       try
       {
@@ -44,6 +44,7 @@ namespace Orthanc
     bool                                    open_;
     unsigned int                            databaseVersion_;
     IDatabaseWrapper::Capabilities          dbCapabilities_;
+    bool                                    supportsBatch_;
 
     void CheckSuccess(OrthancPluginErrorCode code) const;
 
@@ -69,6 +70,12 @@ namespace Orthanc
     {
       return serverIdentifier_;
     }
+
+    // Whether the plugin accepts "OPERATION_BATCH" (new in Orthanc 1.12.12)
+    bool HasBatchSupport() const
+    {
+      return supportsBatch_;
+    }
     
     virtual void Open() ORTHANC_OVERRIDE;
 
@@ -85,6 +92,9 @@ namespace Orthanc
                                                              IDatabaseListener& listener)
       ORTHANC_OVERRIDE;
 
+    virtual IDatabaseWrapper::ITransaction* StartReplicaTransaction(IDatabaseListener& listener,
+                                                                    unsigned int maxStaleness) ORTHANC_OVERRIDE;
+
     virtual unsigned int GetDatabaseVersion() ORTHANC_OVERRIDE;
 
     virtual void Upgrade(unsigned int targetVersion,
@@ -92,6 +102,10 @@ namespace Orthanc
 
     virtual uint64_t MeasureLatency() ORTHANC_OVERRIDE;
 
+    virtual void PublishMetrics(MetricsRegistry& registry) ORTHANC_OVERRIDE
+    {
+    }
+
     virtual const Capabilities GetDatabaseCapabilities() const ORTHANC_OVERRIDE;
 
     virtual bool HasIntegratedFind() const ORTHANC_OVERRIDE;
@@ -54,6 +54,7 @@
 #include "../../../OrthancFramework/Sources/Lua/LuaFunctionCall.h"
 #include "../../../OrthancFramework/Sources/MallocMemoryBuffer.h"
 #include "../../../OrthancFramework/Sources/MetricsRegistry.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/Semaphore.h"
 #include "../../../OrthancFramework/Sources/OrthancException.h"
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
 #include "../../../OrthancFramework/Sources/Toolbox.h"
@@ -62,17 +63,24 @@
 #include "../../Sources/OrthancConfiguration.h"
 #include "../../Sources/OrthancFindRequestHandler.h"
 #include "../../Sources/OutgoingDicomInstance.h"
+#include "../../Sources/ResourceFinder.h"
 #include "../../Sources/Search/HierarchicalMatcher.h"
 #include "../../Sources/ServerContext.h"
 #include "../../Sources/ServerToolbox.h"
+#include "AsynchronousChangeCallback.h"
+#include "CoalescedChangeCallback.h"
+#include "ChangesBatchCallback.h"
 #include "OrthancPluginDatabase.h"
 #include "OrthancPluginDatabaseV3.h"
 #include "OrthancPluginDatabaseV4.h"
 #include "PluginMemoryBuffer32.h"
+#include "PluginsCallbacksMetrics.h"
 #include "PluginsEnumerations.h"
 #include "PluginsJob.h"
+#include "PluginsParallelJob.h"
 
 #include <boost/regex.hpp>
+#include <boost/thread/tss.hpp>
 #include <dcmtk/dcmdata/dcdicent.h>
 #include <dcmtk/dcmnet/dimse.h>
 
@@ -81,6 +89,51 @@
 
 namespace Orthanc
 {
+  namespace
+  {
+    /**
+     * Marks the threads that are running a REST callback registered
+     * by "OrthancPluginRegisterRestCallback2()". Such callbacks are
+     * only allowed to use the services of the SDK that don't lock
+     * "invokeServiceMutex_". The scopes can be nested, as a callback
+     * can invoke another REST callback through "RestApiGet()".
+     **/
+    class RestrictedServicesScope : public boost::noncopyable
+    {
+    private:
+      RestrictedServicesScope*  previous_;
+
+      static void NoCleanup(RestrictedServicesScope* scope)
+      {
+        // The scopes are owned by their creator, not by the thread
+      }
+
+      static boost::thread_specific_ptr<RestrictedServicesScope>& GetCurrent()
+      {
+        static boost::thread_specific_ptr<RestrictedServicesScope> current(NoCleanup);
+        return current;
+      }
+
+    public:
+      RestrictedServicesScope() :
+        previous_(GetCurrent().get())
+      {
+        GetCurrent().reset(this);
+      }
+
+      ~RestrictedServicesScope()
+      {
+        GetCurrent().reset(previous_);
+      }
+
+      static bool IsActive()
+      {
+        return GetCurrent().get() != NULL;
+      }
+    };
+  }
+
+
   class OrthancPlugins::IDicomInstance : public boost::noncopyable
   {
   public:
@@ -597,6 +650,9 @@ namespace Orthanc
 
   namespace
   {
+    // Label of the metrics of the storage areas that are provided by plugins
+    static const std::string PLUGIN_STORAGE_BACKEND = "plugin";
+
     static IMemoryBuffer* GetRangeFromWhole(std::unique_ptr<IMemoryBuffer>& whole,
                                             uint64_t start /* inclusive */,
                                             uint64_t end /* exclusive */)
@@ -639,6 +695,7 @@ namespace Orthanc
       OrthancPluginStorageCreate create_;
       OrthancPluginStorageRemove remove_;
       PluginsErrorDictionary&    errorDictionary_;
+      PluginsCallbacksMetrics&   metrics_;
 
     protected:
       PluginsErrorDictionary& GetErrorDictionary() const
@@ -646,13 +703,20 @@ namespace Orthanc
         return errorDictionary_;
       }
 
+      PluginsCallbacksMetrics& GetMetrics() const
+      {
+        return metrics_;
+      }
+
     public:
       StorageAreaWithoutCustomData(OrthancPluginStorageCreate create,
                                    OrthancPluginStorageRemove remove,
-                                   PluginsErrorDictionary&  errorDictionary) :
+                                   PluginsErrorDictionary&  errorDictionary,
+                                   PluginsCallbacksMetrics& metrics) :
         create_(create),
         remove_(remove),
-        errorDictionary_(errorDictionary)
+        errorDictionary_(errorDictionary),
+        metrics_(metrics)
       {
         if (create == NULL ||
             remove == NULL)
@@ -666,8 +730,13 @@ namespace Orthanc
                           size_t size,
                           FileContentType type) ORTHANC_OVERRIDE
       {
-        OrthancPluginErrorCode error = create_
-          (uuid.c_str(), content, static_cast<int64_t>(size), Plugins::Convert(type));
+        OrthancPluginErrorCode error;
+
+        {
+          PluginsCallbacksMetrics::Timer timer(metrics_, create_, "storage");
+          error = create_(uuid.c_str(), content, static_cast<int64_t>(size), Plugins::Convert(type));
+          timer.SetResult(error);
+        }
 
         if (error != OrthancPluginErrorCode_Success)
         {
@@ -679,8 +748,13 @@ namespace Orthanc
       virtual void Remove(const std::string& uuid,
                           FileContentType type) ORTHANC_OVERRIDE
       {
-        OrthancPluginErrorCode error = remove_
-          (uuid.c_str(), Plugins::Convert(type));
+        OrthancPluginErrorCode error;
+
+        {
+          PluginsCallbacksMetrics::Timer timer(metrics_, remove_, "storage");
+          error = remove_(uuid.c_str(), Plugins::Convert(type));
+          timer.SetResult(error);
+        }
 
         if (error != OrthancPluginErrorCode_Success)
         {
@@ -688,6 +762,13 @@ namespace Orthanc
           throw OrthancException(static_cast<ErrorCode>(error));
         }
       }
+
+      virtual bool LookupLocalPath(std::string& path,
+                                   const std::string& uuid,
+                                   FileContentType type) const ORTHANC_OVERRIDE
+      {
+        return false;
+      }
     };
 
 
@@ -699,8 +780,9 @@ namespace Orthanc
       
     public:
       PluginStorageAreaV1(const _OrthancPluginRegisterStorageArea& callbacks,
-                          PluginsErrorDictionary&  errorDictionary) :
-        StorageAreaWithoutCustomData(callbacks.create, callbacks.remove, errorDictionary),
+                          PluginsErrorDictionary&  errorDictionary,
+                          PluginsCallbacksMetrics& metrics) :
+        StorageAreaWithoutCustomData(callbacks.create, callbacks.remove, errorDictionary, metrics),
         read_(callbacks.read),
         free_(callbacks.free)
       {
@@ -720,7 +802,13 @@ namespace Orthanc
         void* buffer = NULL;
         int64_t size = 0;
 
-        OrthancPluginErrorCode error = read_(&buffer, &size, uuid.c_str(), Plugins::Convert(type));
+        OrthancPluginErrorCode error;
+
+        {
+          PluginsCallbacksMetrics::Timer timer(GetMetrics(), read_, "storage");
+          error = read_(&buffer, &size, uuid.c_str(), Plugins::Convert(type));
+          timer.SetResult(error);
+        }
 
         if (error == OrthancPluginErrorCode_Success)
         {
@@ -753,8 +841,9 @@ namespace Orthanc
 
     public:
       PluginStorageAreaV2(const _OrthancPluginRegisterStorageArea2& callbacks,
-                          PluginsErrorDictionary&  errorDictionary) :
-        StorageAreaWithoutCustomData(callbacks.create, callbacks.remove, errorDictionary),
+                          PluginsErrorDictionary&  errorDictionary,
+                          PluginsCallbacksMetrics& metrics) :
+        StorageAreaWithoutCustomData(callbacks.create, callbacks.remove, errorDictionary, metrics),
         readWhole_(callbacks.readWhole),
         readRange_(callbacks.readRange)
       {
@@ -773,8 +862,14 @@ namespace Orthanc
         {
           std::unique_ptr<IMemoryBuffer> whole(new PluginMemoryBuffer64);
 
-          OrthancPluginErrorCode error = readWhole_(dynamic_cast<PluginMemoryBuffer64&>(*whole).GetObject(),
-                                                    uuid.c_str(), Plugins::Convert(type));
+          OrthancPluginErrorCode error;
+
+          {
+            PluginsCallbacksMetrics::Timer timer(GetMetrics(), readWhole_, "storage");
+            error = readWhole_(dynamic_cast<PluginMemoryBuffer64&>(*whole).GetObject(),
+                               uuid.c_str(), Plugins::Convert(type));
+            timer.SetResult(error);
+          }
 
           if (error == OrthancPluginErrorCode_Success)
           {
@@ -788,23 +883,29 @@ namespace Orthanc
         }
         else
         {
-          std::unique_ptr<PluginMemoryBuffer64> buffer(new PluginMemoryBuffer64);
-
           if (start > end)
           {
             throw OrthancException(ErrorCode_BadRange);
           }
           else if (start == end)
           {
-            return buffer.release();
+            return new PluginMemoryBuffer64;
           }
           else
           {
-            buffer->Resize(end - start);
+            // The destination buffer is owned by Orthanc, which avoids
+            // copying its content once the plugin has filled it
+            std::unique_ptr<PreallocatedMemoryBuffer64> buffer(
+              new PreallocatedMemoryBuffer64(static_cast<size_t>(end - start)));
             assert(buffer->GetSize() > 0);
 
-            OrthancPluginErrorCode error =
-              readRange_(buffer->GetObject(), uuid.c_str(), Plugins::Convert(type), start);
+            OrthancPluginErrorCode error;
+
+            {
+              PluginsCallbacksMetrics::Timer timer(GetMetrics(), readRange_, "storage");
+              error = readRange_(buffer->GetObject(), uuid.c_str(), Plugins::Convert(type), start);
+              timer.SetResult(error);
+            }
 
             if (error == OrthancPluginErrorCode_Success)
             {
@@ -826,6 +927,129 @@ namespace Orthanc
     };
 
 
+    // New in Orthanc 1.12.12
+    class PluginStorageAreaWriter : public IStorageAreaWriter
+    {
+    private:
+      _OrthancPluginRegisterStorageAreaStreaming  callbacks_;
+      PluginsErrorDictionary&                     errorDictionary_;
+      void*                                       writer_;
+
+      void CheckError(OrthancPluginErrorCode error)
+      {
+        if (error != OrthancPluginErrorCode_Success)
+        {
+          errorDictionary_.LogError(error, true);
+          throw OrthancException(static_cast<ErrorCode>(error));
+        }
+      }
+
+    public:
+      PluginStorageAreaWriter(const _OrthancPluginRegisterStorageAreaStreaming& callbacks,
+                              PluginsErrorDictionary& errorDictionary,
+                              const std::string& uuid,
+                              FileContentType type,
+                              CompressionType compression,
+                              uint64_t size,
+                              const DicomInstanceToStore* dicomInstance) :
+        callbacks_(callbacks),
+        errorDictionary_(errorDictionary),
+        writer_(NULL)
+      {
+        OrthancPluginErrorCode error;
+
+        if (dicomInstance != NULL)
+        {
+          Orthanc::OrthancPlugins::DicomInstanceFromCallback wrapped(*dicomInstance);
+          error = callbacks_.startWrite(&writer_, uuid.c_str(), Plugins::Convert(type), Plugins::Convert(compression), size,
+                                        reinterpret_cast<OrthancPluginDicomInstance*>(&wrapped));
+        }
+        else
+        {
+          error = callbacks_.startWrite(&writer_, uuid.c_str(), Plugins::Convert(type), Plugins::Convert(compression), size, NULL);
+        }
+
+        CheckError(error);
+      }
+
+      virtual ~PluginStorageAreaWriter()
+      {
+        // The plugin discards the file if it was not committed
+        callbacks_.finalizeWrite(writer_);
+      }
+
+      virtual void AppendChunk(const void* chunk,
+                               size_t size) ORTHANC_OVERRIDE
+      {
+        CheckError(callbacks_.writeChunk(writer_, chunk, size));
+      }
+
+      virtual void Commit(std::string& customData) ORTHANC_OVERRIDE
+      {
+        PluginMemoryBuffer32 customDataBuffer;
+        CheckError(callbacks_.commitWrite(writer_, customDataBuffer.GetObject()));
+        customDataBuffer.MoveToString(customData);
+      }
+    };
+
+
+    // New in Orthanc 1.12.12
+    class PluginStorageAreaReader : public IStorageAreaReader
+    {
+    private:
+      _OrthancPluginRegisterStorageAreaStreaming  callbacks_;
+      PluginsErrorDictionary&                     errorDictionary_;
+      void*                                       reader_;
+
+    public:
+      PluginStorageAreaReader(const _OrthancPluginRegisterStorageAreaStreaming& callbacks,
+                              PluginsErrorDictionary& errorDictionary,
+                              const std::string& uuid,
+                              FileContentType type,
+                              const std::string& customData) :
+        callbacks_(callbacks),
+        errorDictionary_(errorDictionary),
+        reader_(NULL)
+      {
+        OrthancPluginErrorCode error = callbacks_.startRead(
+          &reader_, uuid.c_str(), Plugins::Convert(type),
+          customData.empty() ? NULL : customData.c_str(), customData.size());
+
+        if (error != OrthancPluginErrorCode_Success)
+        {
+          errorDictionary_.LogError(error, true);
+          throw OrthancException(static_cast<ErrorCode>(error));
+        }
+      }
+
+      virtual ~PluginStorageAreaReader()
+      {
+        callbacks_.finalizeRead(reader_);
+      }
+
+      virtual size_t ReadChunk(void* target,
+                               size_t size) ORTHANC_OVERRIDE
+      {
+        uint64_t readSize = 0;
+        OrthancPluginErrorCode error = callbacks_.readChunk(&readSize, reader_, target, size);
+
+        if (error != OrthancPluginErrorCode_Success)
+        {
+          errorDictionary_.LogError(error, true);
+          throw OrthancException(static_cast<ErrorCode>(error));
+        }
+        else if (readSize > size)
+        {
+          throw OrthancException(ErrorCode_Plugin, "Storage area plugin has read a chunk that is larger than the target buffer");
+        }
+        else
+        {
+          return static_cast<size_t>(readSize);
+        }
+      }
+    };
+
+
     // New in Orthanc 1.12.8
     class PluginStorageAreaV3 : public IPluginStorageArea
     {
@@ -834,6 +1058,9 @@ namespace Orthanc
       OrthancPluginStorageReadRange2  readRange_;
       OrthancPluginStorageRemove2     remove_;
       PluginsErrorDictionary&         errorDictionary_;
+      PluginsCallbacksMetrics&        metrics_;
+      bool                            hasStreaming_;
+      _OrthancPluginRegisterStorageAreaStreaming  streaming_;
 
     protected:
       PluginsErrorDictionary& GetErrorDictionary() const
@@ -843,11 +1070,15 @@ namespace Orthanc
 
     public:
       PluginStorageAreaV3(const _OrthancPluginRegisterStorageArea3& callbacks,
-                          PluginsErrorDictionary&  errorDictionary) :
+                          const _OrthancPluginRegisterStorageAreaStreaming* streaming /* can be NULL */,
+                          PluginsErrorDictionary&  errorDictionary,
+                          PluginsCallbacksMetrics& metrics) :
         create_(callbacks.create),
         readRange_(callbacks.readRange),
         remove_(callbacks.remove),
-        errorDictionary_(errorDictionary)
+        errorDictionary_(errorDictionary),
+        metrics_(metrics),
+        hasStreaming_(streaming != NULL)
       {
         if (callbacks.create == NULL ||
             callbacks.readRange == NULL ||
@@ -855,6 +1086,11 @@ namespace Orthanc
         {
           throw OrthancException(ErrorCode_Plugin, "Storage area plugin does not implement all the required primitives (create, remove, and readRange)");
         }
+
+        if (streaming != NULL)
+        {
+          streaming_ = *streaming;
+        }
       }
 
       virtual void Create(std::string& customData /* out */,
@@ -868,15 +1104,21 @@ namespace Orthanc
         PluginMemoryBuffer32 customDataBuffer;
         OrthancPluginErrorCode error;
 
-        if (dicomInstance != NULL)
-        {
-          Orthanc::OrthancPlugins::DicomInstanceFromCallback wrapped(*dicomInstance);
-          error = create_(customDataBuffer.GetObject(), uuid.c_str(), content, size, Plugins::Convert(type), Plugins::Convert(compression),
-                          reinterpret_cast<OrthancPluginDicomInstance*>(&wrapped));
-        }
-        else
         {
-          error = create_(customDataBuffer.GetObject(), uuid.c_str(), content, size, Plugins::Convert(type), Plugins::Convert(compression), NULL);
+          PluginsCallbacksMetrics::Timer timer(metrics_, create_, "storage");
+
+          if (dicomInstance != NULL)
+          {
+            Orthanc::OrthancPlugins::DicomInstanceFromCallback wrapped(*dicomInstance);
+            error = create_(customDataBuffer.GetObject(), uuid.c_str(), content, size, Plugins::Convert(type), Plugins::Convert(compression),
+                            reinterpret_cast<OrthancPluginDicomInstance*>(&wrapped));
+          }
+          else
+          {
+            error = create_(customDataBuffer.GetObject(), uuid.c_str(), content, size, Plugins::Convert(type), Plugins::Convert(compression), NULL);
+          }
+
+          timer.SetResult(error);
         }
 
         if (error != OrthancPluginErrorCode_Success)
@@ -894,8 +1136,14 @@ namespace Orthanc
                           FileContentType type,
                           const std::string& customData) ORTHANC_OVERRIDE
       {
-        OrthancPluginErrorCode error = remove_(uuid.c_str(), Plugins::Convert(type),
-                                                customData.empty() ? NULL : customData.c_str(), customData.size());
+        OrthancPluginErrorCode error;
+
+        {
+          PluginsCallbacksMetrics::Timer timer(metrics_, remove_, "storage");
+          error = remove_(uuid.c_str(), Plugins::Convert(type),
+                          customData.empty() ? NULL : customData.c_str(), customData.size());
+          timer.SetResult(error);
+        }
 
         if (error != OrthancPluginErrorCode_Success)
         {
@@ -920,12 +1168,18 @@ namespace Orthanc
         }
         else
         {
-          std::unique_ptr<PluginMemoryBuffer64> buffer(new PluginMemoryBuffer64);
-          buffer->Resize(end - start);
+          std::unique_ptr<PreallocatedMemoryBuffer64> buffer(
+            new PreallocatedMemoryBuffer64(static_cast<size_t>(end - start)));
           assert(buffer->GetSize() > 0);
 
-          OrthancPluginErrorCode error =
-            readRange_(buffer->GetObject(), uuid.c_str(), Plugins::Convert(type), start, customData.empty() ? NULL : customData.c_str(), customData.size());
+          OrthancPluginErrorCode error;
+
+          {
+            PluginsCallbacksMetrics::Timer timer(metrics_, readRange_, "storage");
+            error = readRange_(buffer->GetObject(), uuid.c_str(), Plugins::Convert(type), start,
+                               customData.empty() ? NULL : customData.c_str(), customData.size());
+            timer.SetResult(error);
+          }
 
           if (error == OrthancPluginErrorCode_Success)
           {
@@ -943,6 +1197,54 @@ namespace Orthanc
       {
         return true;
       }
+
+      virtual bool LookupLocalPath(std::string& path,
+                                   const std::string& uuid,
+                                   FileContentType type,
+                                   const std::string& customData) const ORTHANC_OVERRIDE
+      {
+        return false;
+      }
+
+      virtual bool HasStreamingAccess() const ORTHANC_OVERRIDE
+      {
+        return hasStreaming_;
+      }
+
+      virtual const std::string& GetBackendName() const ORTHANC_OVERRIDE
+      {
+        return PLUGIN_STORAGE_BACKEND;
+      }
+
+      virtual IStorageAreaWriter* OpenWrite(const std::string& uuid,
+                                            FileContentType type,
+                                            CompressionType compression,
+                                            uint64_t size,
+                                            const DicomInstanceToStore* dicomInstance) ORTHANC_OVERRIDE
+      {
+        if (hasStreaming_)
+        {
+          return new PluginStorageAreaWriter(streaming_, errorDictionary_, uuid, type, compression, size, dicomInstance);
+        }
+        else
+        {
+          throw OrthancException(ErrorCode_NotImplemented, "The storage area plugin has no streaming access");
+        }
+      }
+
+      virtual IStorageAreaReader* OpenRead(const std::string& uuid,
+                                           FileContentType type,
+                                           const std::string& customData) ORTHANC_OVERRIDE
+      {
+        if (hasStreaming_)
+        {
+          return new PluginStorageAreaReader(streaming_, errorDictionary_, uuid, type, customData);
+        }
+        else
+        {
+          throw OrthancException(ErrorCode_NotImplemented, "The storage area plugin has no streaming access");
+        }
+      }
     };
 
 
@@ -961,7 +1263,9 @@ namespace Orthanc
       _OrthancPluginRegisterStorageArea   callbacks1_;
       _OrthancPluginRegisterStorageArea2  callbacks2_;
       _OrthancPluginRegisterStorageArea3  callbacks3_;
+      std::unique_ptr<_OrthancPluginRegisterStorageAreaStreaming>  streaming_;
       PluginsErrorDictionary&             errorDictionary_;
+      PluginsCallbacksMetrics&            metrics_;
 
       static void WarnNoReadRange()
       {
@@ -971,22 +1275,26 @@ namespace Orthanc
     public:
       StorageAreaFactory(SharedLibrary& sharedLibrary,
                          const _OrthancPluginRegisterStorageArea& callbacks,
-                         PluginsErrorDictionary&  errorDictionary) :
+                         PluginsErrorDictionary&  errorDictionary,
+                         PluginsCallbacksMetrics& metrics) :
         sharedLibrary_(sharedLibrary),
         version_(Version1),
         callbacks1_(callbacks),
-        errorDictionary_(errorDictionary)
+        errorDictionary_(errorDictionary),
+        metrics_(metrics)
       {
         WarnNoReadRange();
       }
 
       StorageAreaFactory(SharedLibrary& sharedLibrary,
                          const _OrthancPluginRegisterStorageArea2& callbacks,
-                         PluginsErrorDictionary&  errorDictionary) :
+                         PluginsErrorDictionary&  errorDictionary,
+                         PluginsCallbacksMetrics& metrics) :
         sharedLibrary_(sharedLibrary),
         version_(Version2),
         callbacks2_(callbacks),
-        errorDictionary_(errorDictionary)
+        errorDictionary_(errorDictionary),
+        metrics_(metrics)
       {
         if (callbacks.readRange == NULL)
         {
@@ -996,11 +1304,13 @@ namespace Orthanc
 
       StorageAreaFactory(SharedLibrary& sharedLibrary,
                          const _OrthancPluginRegisterStorageArea3& callbacks,
-                         PluginsErrorDictionary&  errorDictionary) :
+                         PluginsErrorDictionary&  errorDictionary,
+                         PluginsCallbacksMetrics& metrics) :
         sharedLibrary_(sharedLibrary),
         version_(Version3),
         callbacks3_(callbacks),
-        errorDictionary_(errorDictionary)
+        errorDictionary_(errorDictionary),
+        metrics_(metrics)
       {
         if (callbacks.readRange == NULL)
         {
@@ -1013,18 +1323,45 @@ namespace Orthanc
         return sharedLibrary_;
       }
 
+      void SetStreaming(const _OrthancPluginRegisterStorageAreaStreaming& callbacks)
+      {
+        if (version_ != Version3)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls, "The streaming access requires a storage area "
+                                 "that is registered using OrthancPluginRegisterStorageArea3()");
+        }
+        else if (streaming_.get() != NULL)
+        {
+          throw OrthancException(ErrorCode_StorageAreaAlreadyRegistered);
+        }
+        else if (callbacks.startWrite == NULL ||
+                 callbacks.writeChunk == NULL ||
+                 callbacks.commitWrite == NULL ||
+                 callbacks.finalizeWrite == NULL ||
+                 callbacks.startRead == NULL ||
+                 callbacks.readChunk == NULL ||
+                 callbacks.finalizeRead == NULL)
+        {
+          throw OrthancException(ErrorCode_Plugin, "Storage area plugin does not implement all the streaming primitives");
+        }
+        else
+        {
+          streaming_.reset(new _OrthancPluginRegisterStorageAreaStreaming(callbacks));
+        }
+      }
+
       IPluginStorageArea* Create() const
       {
         switch (version_)
         {
           case Version1:
-            return new PluginStorageAreaAdapter(new PluginStorageAreaV1(callbacks1_, errorDictionary_));
+            return new PluginStorageAreaAdapter(new PluginStorageAreaV1(callbacks1_, errorDictionary_, metrics_), PLUGIN_STORAGE_BACKEND);
 
           case Version2:
-            return new PluginStorageAreaAdapter(new PluginStorageAreaV2(callbacks2_, errorDictionary_));
+            return new PluginStorageAreaAdapter(new PluginStorageAreaV2(callbacks2_, errorDictionary_, metrics_), PLUGIN_STORAGE_BACKEND);
 
           case Version3:
-            return new PluginStorageAreaV3(callbacks3_, errorDictionary_);
+            return new PluginStorageAreaV3(callbacks3_, streaming_.get(), errorDictionary_, metrics_);
 
           default:
             THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
@@ -1090,6 +1427,24 @@ namespace Orthanc
     };
 
 
+    class StringStreamWriter : public DicomWebJsonVisitor::IStreamWriter
+    {
+    private:
+      std::string&  target_;
+
+    public:
+      explicit StringStreamWriter(std::string& target) :
+        target_(target)
+      {
+      }
+
+      virtual void Write(const std::string& chunk) ORTHANC_OVERRIDE
+      {
+        target_.append(chunk);
+      }
+    };
+
+
     class DicomWebBinaryFormatter : public DicomWebJsonVisitor::IBinaryFormatter
     {
     private:
@@ -1219,16 +1574,20 @@ namespace Orthanc
         DicomWebJsonVisitor visitor;
         visitor.SetFormatter(*this);
 
-        dicom.Apply(visitor);
-
         std::string s;
 
         if (isJson)
         {
-          s = visitor.GetResult().toStyledString();
+          // Write the JSON text while visiting the dataset, without
+          // building the full tree of the "Json::Value" nodes
+          StringStreamWriter writer(s);
+          visitor.SetStreamWriter(writer);
+          dicom.Apply(visitor);
+          visitor.FinalizeStream();
         }
         else
         {
+          dicom.Apply(visitor);
           visitor.FormatXml(s);
         }
 
@@ -1267,7 +1626,8 @@ namespace Orthanc
         State_MultipartFirstPart,
         State_MultipartSecondPart,
         State_MultipartNextParts,
-        State_WritingStream
+        State_WritingStream,
+        State_WritingBody
       };
 
       HttpOutput&                 output_;
@@ -1357,16 +1717,35 @@ namespace Orthanc
         }
       }
 
-      void SendStreamItem(const void* data,
-                          size_t size)
+      void StartBody(const char* contentType,
+                     uint64_t contentLength)
       {
-        if (state_ != State_WritingStream)
+        if (state_ != State_None)
         {
           throw OrthancException(ErrorCode_BadSequenceOfCalls);
         }
         else
         {
-          output_.SendStreamItem(data, size);
+          output_.StartBody(contentType == NULL ? "" : contentType, contentLength);
+          state_ = State_WritingBody;
+        }
+      }
+
+      void SendStreamItem(const void* data,
+                          size_t size)
+      {
+        switch (state_)
+        {
+          case State_WritingStream:
+            output_.SendStreamItem(data, size);
+            break;
+
+          case State_WritingBody:
+            output_.SendBodyChunk(data, size);
+            break;
+
+          default:
+            throw OrthancException(ErrorCode_BadSequenceOfCalls);
         }
       }
 
@@ -1454,6 +1833,10 @@ namespace Orthanc
               output_.CloseStream();
               break;
 
+            case State_WritingBody:
+              output_.CloseBody();
+              break;
+
             default:
               THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
           }
@@ -1478,9 +1861,11 @@ namespace Orthanc
     class RestCallback : public boost::noncopyable
     {
     private:
-      boost::regex              regex_;
-      OrthancPluginRestCallback callback_;
-      bool                      mutualExclusion_;
+      boost::regex               regex_;
+      OrthancPluginRestCallback  callback_;
+      bool                       mutualExclusion_;
+      bool                       restricted_;
+      std::unique_ptr<Semaphore> concurrency_;
 
       OrthancPluginErrorCode InvokeInternal(PluginHttpOutput& output,
                                             const std::string& flatUri,
@@ -1497,8 +1882,24 @@ namespace Orthanc
                    bool mutualExclusion) :
         regex_(regex),
         callback_(callback),
-        mutualExclusion_(mutualExclusion)
+        mutualExclusion_(mutualExclusion),
+        restricted_(false)
+      {
+      }
+
+      // New in Orthanc 1.12.12, for "OrthancPluginRegisterRestCallback2()"
+      RestCallback(const char* regex,
+                   OrthancPluginRestCallback callback,
+                   unsigned int maxConcurrency) :
+        regex_(regex),
+        callback_(callback),
+        mutualExclusion_(false),
+        restricted_(true)
       {
+        if (maxConcurrency != 0)
+        {
+          concurrency_.reset(new Semaphore(maxConcurrency));
+        }
       }
 
       const boost::regex& GetRegularExpression() const
@@ -1506,6 +1907,11 @@ namespace Orthanc
         return regex_;
       }
 
+      OrthancPluginRestCallback GetCallback() const
+      {
+        return callback_;
+      }
+
       OrthancPluginErrorCode Invoke(boost::recursive_mutex& invokationMutex,
                                     PluginHttpOutput& output,
                                     const std::string& flatUri,
@@ -1516,6 +1922,17 @@ namespace Orthanc
           boost::recursive_mutex::scoped_lock lock(invokationMutex);
           return InvokeInternal(output, flatUri, request);
         }
+        else if (restricted_)
+        {
+          std::unique_ptr<Semaphore::Locker> locker;
+          if (concurrency_.get() != NULL)
+          {
+            locker.reset(new Semaphore::Locker(*concurrency_));
+          }
+
+          RestrictedServicesScope scope;
+          return InvokeInternal(output, flatUri, request);
+        }
         else
         {
           return InvokeInternal(output, flatUri, request);
@@ -1779,12 +2196,17 @@ namespace Orthanc
     typedef std::list<ChunkedRestCallback*>  ChunkedRestCallbacks;
     typedef std::list<OrthancPluginOnStoredInstanceCallback>  OnStoredCallbacks;
     typedef std::list<OrthancPluginOnChangeCallback>  OnChangeCallbacks;
+    typedef std::list<AsynchronousChangeCallback*>  AsynchronousChangeCallbacks;
+    typedef std::list<ChangesBatchCallback*>  ChangesBatchCallbacks;
+    typedef std::list<CoalescedChangeCallback*>  CoalescedChangeCallbacks;
     typedef std::list<OrthancPluginIncomingHttpRequestFilter>  IncomingHttpRequestFilters;
     typedef std::list<OrthancPluginIncomingHttpRequestFilter2>  IncomingHttpRequestFilters2;
     typedef std::list<OrthancPluginIncomingDicomInstanceFilter>  IncomingDicomInstanceFilters;
     typedef std::list<OrthancPluginIncomingCStoreInstanceFilter>  IncomingCStoreInstanceFilters;
     typedef std::list<OrthancPluginDecodeImageCallback>  DecodeImageCallbacks;
+    typedef std::list<OrthancPluginDecodeFramesCallback>  DecodeFramesCallbacks;
     typedef std::list<OrthancPluginTranscoderCallback>  TranscoderCallbacks;
+    typedef std::list<OrthancPluginBatchTranscoderCallback>  BatchTranscoderCallbacks;
     typedef std::list<OrthancPluginJobsUnserializer>  JobsUnserializers;
     typedef std::list<OrthancPluginRefreshMetricsCallback>  RefreshMetricsCallbacks;
     typedef std::list<StorageCommitmentScp*>  StorageCommitmentScpCallbacks;
@@ -1798,12 +2220,18 @@ namespace Orthanc
     ChunkedRestCallbacks chunkedRestCallbacks_;
     OnStoredCallbacks  onStoredCallbacks_;
     OnChangeCallbacks  onChangeCallbacks_;
+    AsynchronousChangeCallbacks  asynchronousChangeCallbacks_;  // New in Orthanc 1.12.12
+    ChangesBatchCallbacks  changesBatchCallbacks_;  // New in Orthanc 1.12.12
+    CoalescedChangeCallbacks  coalescedChangeCallbacks_;  // New in Orthanc 1.12.12
+    PluginsCallbacksMetrics  callbacksMetrics_;  // New in Orthanc 1.12.12
     OrthancPluginFindCallback  findCallback_;
     OrthancPluginFindCallback2  findCallback2_; // New in Orthanc 1.12.10
     OrthancPluginWorklistCallback  worklistCallback_;
     OrthancPluginWorklistCallback2  worklistCallback2_; // New in Orthanc 1.12.10
     DecodeImageCallbacks  decodeImageCallbacks_;
+    DecodeFramesCallbacks  decodeFramesCallbacks_;  // New in Orthanc 1.12.12
     TranscoderCallbacks  transcoderCallbacks_;
+    BatchTranscoderCallbacks  batchTranscoderCallbacks_;  // New in Orthanc 1.12.12
     JobsUnserializers  jobsUnserializers_;
     std::unique_ptr<_OrthancPluginMoveCallback> moveCallbacks_;
     std::unique_ptr<_OrthancPluginMoveCallback2> moveCallbacks2_; // New in Orthanc 1.12.10
@@ -2043,18 +2471,22 @@ namespace Orthanc
 
         if (that_.pimpl_->findCallback2_)
         {
+          PluginsCallbacksMetrics::Timer timer(that_.pimpl_->callbacksMetrics_, that_.pimpl_->findCallback2_, "find");
           error = that_.pimpl_->findCallback2_
             (reinterpret_cast<OrthancPluginFindAnswers*>(&answers),
              reinterpret_cast<const OrthancPluginFindQuery*>(this),
              reinterpret_cast<const OrthancPluginDicomConnection*>(&connection));
+          timer.SetResult(error);
         }
         else if (that_.pimpl_->findCallback_)
         {
+          PluginsCallbacksMetrics::Timer timer(that_.pimpl_->callbacksMetrics_, that_.pimpl_->findCallback_, "find");
           error = that_.pimpl_->findCallback_
             (reinterpret_cast<OrthancPluginFindAnswers*>(&answers),
              reinterpret_cast<const OrthancPluginFindQuery*>(this),
              connection.GetRemoteAet().c_str(),
              connection.GetCalledAet().c_str());
+          timer.SetResult(error);
         }
         else
         {
@@ -2468,31 +2900,85 @@ namespace Orthanc
   void OrthancPlugins::SetServerContext(ServerContext& context)
   {
     pimpl_->SetServerContext(&context);
+    pimpl_->callbacksMetrics_.SetRegistry(context.GetMetricsRegistry());
+
+    for (PImpl::ChangesBatchCallbacks::iterator it = pimpl_->changesBatchCallbacks_.begin();
+         it != pimpl_->changesBatchCallbacks_.end(); ++it)
+    {
+      assert(*it != NULL);
+      (*it)->Start(context);
+    }
   }
 
 
   void OrthancPlugins::ResetServerContext()
   {
+    {
+      // The pending changes are processed while the context is still available
+      boost::recursive_mutex::scoped_lock lock(pimpl_->changeCallbackMutex_);
+
+      for (PImpl::AsynchronousChangeCallbacks::iterator it = pimpl_->asynchronousChangeCallbacks_.begin();
+           it != pimpl_->asynchronousChangeCallbacks_.end(); ++it)
+      {
+        assert(*it != NULL);
+        (*it)->Stop();
+      }
+
+      for (PImpl::CoalescedChangeCallbacks::iterator it = pimpl_->coalescedChangeCallbacks_.begin();
+           it != pimpl_->coalescedChangeCallbacks_.end(); ++it)
+      {
+        assert(*it != NULL);
+        (*it)->Stop();
+      }
+    }
+
+    for (PImpl::ChangesBatchCallbacks::iterator it = pimpl_->changesBatchCallbacks_.begin();
+         it != pimpl_->changesBatchCallbacks_.end(); ++it)
+    {
+      assert(*it != NULL);
+      (*it)->Stop();
+    }
+
+    pimpl_->callbacksMetrics_.ResetRegistry();
     pimpl_->SetServerContext(NULL);
   }
 
   
   OrthancPlugins::~OrthancPlugins()
   {
-    for (PImpl::RestCallbacks::iterator it = pimpl_->restCallbacks_.begin(); 
-         it != pimpl_->restCallbacks_.end(); ++it)
+    // The threads of the asynchronous callbacks must be stopped before the plugins are finalized
+    for (PImpl::AsynchronousChangeCallbacks::iterator it = pimpl_->asynchronousChangeCallbacks_.begin();
+         it != pimpl_->asynchronousChangeCallbacks_.end(); ++it)
     {
       delete *it;
     }
 
-    for (PImpl::ChunkedRestCallbacks::iterator it = pimpl_->chunkedRestCallbacks_.begin(); 
-         it != pimpl_->chunkedRestCallbacks_.end(); ++it)
+    for (PImpl::CoalescedChangeCallbacks::iterator it = pimpl_->coalescedChangeCallbacks_.begin();
+         it != pimpl_->coalescedChangeCallbacks_.end(); ++it)
     {
       delete *it;
     }
 
-    for (PImpl::StorageCommitmentScpCallbacks::iterator
-           it = pimpl_->storageCommitmentScpCallbacks_.begin(); 
+    for (PImpl::ChangesBatchCallbacks::iterator it = pimpl_->changesBatchCallbacks_.begin();
+         it != pimpl_->changesBatchCallbacks_.end(); ++it)
+    {
+      delete *it;
+    }
+
+    for (PImpl::RestCallbacks::iterator it = pimpl_->restCallbacks_.begin(); 
+         it != pimpl_->restCallbacks_.end(); ++it)
+    {
+      delete *it;
+    }
+
+    for (PImpl::ChunkedRestCallbacks::iterator it = pimpl_->chunkedRestCallbacks_.begin(); 
+         it != pimpl_->chunkedRestCallbacks_.end(); ++it)
+    {
+      delete *it;
+    }
+
+    for (PImpl::StorageCommitmentScpCallbacks::iterator
+           it = pimpl_->storageCommitmentScpCallbacks_.begin(); 
          it != pimpl_->storageCommitmentScpCallbacks_.end(); ++it)
     {
       delete *it;
@@ -2803,10 +3289,15 @@ namespace Orthanc
         converter.SetGetArguments(getArguments);
       
         PImpl::PluginHttpOutput pluginOutput(output);
-        
-        OrthancPluginErrorCode error = handler(
-          reinterpret_cast<OrthancPluginRestOutput*>(&pluginOutput), 
-          matcher.GetFlatUri().c_str(), &converter.GetRequest());
+
+        OrthancPluginErrorCode error;
+
+        {
+          PluginsCallbacksMetrics::Timer timer(pimpl_->callbacksMetrics_, handler, "rest");
+          error = handler(reinterpret_cast<OrthancPluginRestOutput*>(&pluginOutput), 
+                          matcher.GetFlatUri().c_str(), &converter.GetRequest());
+          timer.SetResult(error);
+        }
         
         pluginOutput.Close(error, GetErrorDictionary());
       }
@@ -2860,8 +3351,14 @@ namespace Orthanc
     PImpl::PluginHttpOutput pluginOutput(output);
 
     assert(callback != NULL);
-    OrthancPluginErrorCode error = callback->Invoke
-      (pimpl_->restCallbackInvokationMutex_, pluginOutput, matcher.GetFlatUri(), converter.GetRequest());
+    OrthancPluginErrorCode error;
+
+    {
+      PluginsCallbacksMetrics::Timer timer(pimpl_->callbacksMetrics_, callback->GetCallback(), "rest");
+      error = callback->Invoke
+        (pimpl_->restCallbackInvokationMutex_, pluginOutput, matcher.GetFlatUri(), converter.GetRequest());
+      timer.SetResult(error);
+    }
 
     pluginOutput.Close(error, GetErrorDictionary());
     return true;
@@ -2880,9 +3377,13 @@ namespace Orthanc
            callback = pimpl_->onStoredCallbacks_.begin(); 
          callback != pimpl_->onStoredCallbacks_.end(); ++callback)
     {
-      OrthancPluginErrorCode error = (*callback) (
-        reinterpret_cast<OrthancPluginDicomInstance*>(&wrapped),
-        instanceId.c_str());
+      OrthancPluginErrorCode error;
+
+      {
+        PluginsCallbacksMetrics::Timer timer(pimpl_->callbacksMetrics_, *callback, "stored_instance");
+        error = (*callback) (reinterpret_cast<OrthancPluginDicomInstance*>(&wrapped), instanceId.c_str());
+        timer.SetResult(error);
+      }
 
       if (error != OrthancPluginErrorCode_Success)
       {
@@ -2904,7 +3405,16 @@ namespace Orthanc
            filter = pimpl_->incomingDicomInstanceFilters_.begin();
          filter != pimpl_->incomingDicomInstanceFilters_.end(); ++filter)
     {
-      int32_t allowed = (*filter) (reinterpret_cast<const OrthancPluginDicomInstance*>(&wrapped));
+      int32_t allowed;
+
+      {
+        PluginsCallbacksMetrics::Timer timer(pimpl_->callbacksMetrics_, *filter, "filter");
+        allowed = (*filter) (reinterpret_cast<const OrthancPluginDicomInstance*>(&wrapped));
+        if (allowed == 0 || allowed == 1)
+        {
+          timer.SetSuccess();
+        }
+      }
 
       if (allowed == 0)
       {
@@ -2934,7 +3444,16 @@ namespace Orthanc
            filter = pimpl_->incomingCStoreInstanceFilters_.begin();
          filter != pimpl_->incomingCStoreInstanceFilters_.end(); ++filter)
     {
-      int32_t result = (*filter) (&dimseStatus, reinterpret_cast<const OrthancPluginDicomInstance*>(&wrapped));
+      int32_t result;
+
+      {
+        PluginsCallbacksMetrics::Timer timer(pimpl_->callbacksMetrics_, *filter, "filter");
+        result = (*filter) (&dimseStatus, reinterpret_cast<const OrthancPluginDicomInstance*>(&wrapped));
+        if (result == 0 || result == 1)
+        {
+          timer.SetSuccess();
+        }
+      }
 
       if (result == 0)
       {
@@ -2983,17 +3502,95 @@ namespace Orthanc
     }
   }
 
+  std::string OrthancPlugins::GetStudyOrderingKey(OrthancPluginResourceType resourceType,
+                                                  const char* resource)
+  {
+    assert(resource != NULL);
+    std::string key = resource;
+
+    if (resourceType == OrthancPluginResourceType_Series ||
+        resourceType == OrthancPluginResourceType_Instance)
+    {
+      try
+      {
+        PImpl::ServerContextReference lock(*pimpl_);
+        ServerIndex& index = lock.GetContext().GetIndex();
+
+        std::string series = resource;
+        if (resourceType == OrthancPluginResourceType_Series ||
+            index.LookupParent(series, resource, ResourceType_Series))
+        {
+          std::string study;
+          if (index.LookupParent(study, series, ResourceType_Study))
+          {
+            key = study;
+          }
+        }
+      }
+      catch (OrthancException&)
+      {
+        // The resource has been deleted in the meantime, fall back
+        // to the ordering per resource
+      }
+    }
+
+    return key;
+  }
+
+
   void OrthancPlugins::SignalChangeInternal(OrthancPluginChangeType changeType,
                                             OrthancPluginResourceType resourceType,
                                             const char* resource)
   {
     boost::recursive_mutex::scoped_lock lock(pimpl_->changeCallbackMutex_);
 
+    if (!pimpl_->asynchronousChangeCallbacks_.empty())
+    {
+      std::string resourceKey = (resource == NULL ? "" : resource);
+      std::string studyKey;
+      bool hasStudyKey = false;
+
+      for (PImpl::AsynchronousChangeCallbacks::iterator it = pimpl_->asynchronousChangeCallbacks_.begin();
+           it != pimpl_->asynchronousChangeCallbacks_.end(); ++it)
+      {
+        assert(*it != NULL);
+
+        if ((*it)->GetOrdering() == OrthancPluginChangeOrdering_Study &&
+            resource != NULL)
+        {
+          if (!hasStudyKey)
+          {
+            studyKey = GetStudyOrderingKey(resourceType, resource);
+            hasStudyKey = true;
+          }
+
+          (*it)->Enqueue(studyKey, changeType, resourceType, resource);
+        }
+        else
+        {
+          (*it)->Enqueue(resourceKey, changeType, resourceType, resource);
+        }
+      }
+    }
+
+    for (PImpl::CoalescedChangeCallbacks::iterator it = pimpl_->coalescedChangeCallbacks_.begin();
+         it != pimpl_->coalescedChangeCallbacks_.end(); ++it)
+    {
+      assert(*it != NULL);
+      (*it)->Enqueue(changeType, resourceType, resource);
+    }
+
     for (std::list<OrthancPluginOnChangeCallback>::const_iterator 
            callback = pimpl_->onChangeCallbacks_.begin(); 
          callback != pimpl_->onChangeCallbacks_.end(); ++callback)
     {
-      OrthancPluginErrorCode error = (*callback) (changeType, resourceType, resource);
+      OrthancPluginErrorCode error;
+
+      {
+        PluginsCallbacksMetrics::Timer timer(pimpl_->callbacksMetrics_, *callback, "change");
+        error = (*callback) (changeType, resourceType, resource);
+        timer.SetResult(error);
+      }
 
       if (error != OrthancPluginErrorCode_Success)
       {
@@ -3051,6 +3648,30 @@ namespace Orthanc
   }
 
 
+  void OrthancPlugins::RegisterRestCallback2(const void* parameters)
+  {
+    const _OrthancPluginRestCallback2& p = 
+      *reinterpret_cast<const _OrthancPluginRestCallback2*>(parameters);
+
+    if (p.pathRegularExpression == NULL ||
+        p.callback == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    CLOG(INFO, PLUGINS) << "Plugin has registered a REST callback without mutual exclusion, with "
+                        << (p.maxConcurrency == 0 ? std::string("unbounded concurrency") :
+                            "at most " + boost::lexical_cast<std::string>(p.maxConcurrency) + " simultaneous calls")
+                        << ", on: " << p.pathRegularExpression;
+
+    {
+      boost::unique_lock<boost::shared_mutex> lock(pimpl_->restCallbackRegistrationMutex_);
+      pimpl_->restCallbacks_.push_back(new PImpl::RestCallback(p.pathRegularExpression, p.callback,
+                                                               static_cast<unsigned int>(p.maxConcurrency)));
+    }
+  }
+
+
   void OrthancPlugins::RegisterChunkedRestCallback(const void* parameters)
   {
     const _OrthancPluginChunkedRestCallback& p = 
@@ -3088,6 +3709,80 @@ namespace Orthanc
   }
 
 
+  void OrthancPlugins::RegisterOnChangeCallback2(const void* parameters)
+  {
+    const _OrthancPluginOnChangeCallback2& p = 
+      *reinterpret_cast<const _OrthancPluginOnChangeCallback2*>(parameters);
+
+    std::string policy;
+
+    {
+      OrthancConfiguration::ReaderLock lock;
+      policy = lock.GetConfiguration().GetStringParameter(ORTHANC_CONFIG_PLUGINS_CHANGES_OVERFLOW_POLICY);
+    }
+
+    bool discardOnOverflow;
+    if (policy == "Block")
+    {
+      discardOnOverflow = false;
+    }
+    else if (policy == "Discard")
+    {
+      discardOnOverflow = true;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "Configuration option \"" + std::string(ORTHANC_CONFIG_PLUGINS_CHANGES_OVERFLOW_POLICY) +
+                             "\" must be \"Block\" or \"Discard\", found: " + policy);
+    }
+
+    std::unique_ptr<AsynchronousChangeCallback> callback(
+      new AsynchronousChangeCallback(pimpl_->dictionary_, pimpl_->callbacksMetrics_, p.callback, p.threadsCount,
+                                     p.queueSize, p.ordering, discardOnOverflow));
+
+    CLOG(INFO, PLUGINS) << "Plugin has registered an asynchronous OnChange callback with "
+                        << p.threadsCount << " thread(s) and a queue of " << p.queueSize << " change(s) per thread";
+
+    boost::recursive_mutex::scoped_lock lock(pimpl_->changeCallbackMutex_);
+    pimpl_->asynchronousChangeCallbacks_.push_back(callback.release());
+  }
+
+
+  void OrthancPlugins::RegisterCoalescedChangeCallback(const void* parameters)
+  {
+    const _OrthancPluginCoalescedChangeCallback& p = 
+      *reinterpret_cast<const _OrthancPluginCoalescedChangeCallback*>(parameters);
+
+    std::unique_ptr<CoalescedChangeCallback> callback(
+      new CoalescedChangeCallback(pimpl_->dictionary_, pimpl_->callbacksMetrics_, p.callback,
+                                  p.resourceType, p.windowMilliseconds));
+
+    CLOG(INFO, PLUGINS) << "Plugin has registered a callback for the changes coalesced over windows of "
+                        << p.windowMilliseconds << "ms";
+
+    boost::recursive_mutex::scoped_lock lock(pimpl_->changeCallbackMutex_);
+    pimpl_->coalescedChangeCallbacks_.push_back(callback.release());
+  }
+
+
+  void OrthancPlugins::RegisterChangesBatchCallback(const void* parameters)
+  {
+    const _OrthancPluginChangesBatchCallback& p = 
+      *reinterpret_cast<const _OrthancPluginChangesBatchCallback*>(parameters);
+
+    std::unique_ptr<ChangesBatchCallback> callback(
+      new ChangesBatchCallback(pimpl_->dictionary_, pimpl_->callbacksMetrics_, p.callback, p.maxBatchSize, p.since));
+
+    CLOG(INFO, PLUGINS) << "Plugin has registered a callback for batches of at most "
+                        << p.maxBatchSize << " change(s), starting after change " << p.since;
+
+    // The thread is started by "SetServerContext()", which happens
+    // after the initialization of the plugins
+    pimpl_->changesBatchCallbacks_.push_back(callback.release());
+  }
+
+
   void OrthancPlugins::RegisterWorklistCallback(const void* parameters)
   {
     const _OrthancPluginWorklistCallback& p = 
@@ -3227,6 +3922,19 @@ namespace Orthanc
   }
 
 
+  void OrthancPlugins::RegisterDecodeFramesCallback(const void* parameters)
+  {
+    const _OrthancPluginDecodeFramesCallback& p = 
+      *reinterpret_cast<const _OrthancPluginDecodeFramesCallback*>(parameters);
+
+    boost::unique_lock<boost::shared_mutex> lock(pimpl_->decoderTranscoderMutex_);
+
+    pimpl_->decodeFramesCallbacks_.push_back(p.callback);
+    CLOG(INFO, PLUGINS) << "Plugin has registered a callback to decode batches of DICOM frames (" 
+                        << pimpl_->decodeFramesCallbacks_.size() << " decoder(s) now active)";
+  }
+
+
   void OrthancPlugins::RegisterTranscoderCallback(const void* parameters)
   {
     const _OrthancPluginTranscoderCallback& p = 
@@ -3240,6 +3948,19 @@ namespace Orthanc
   }
 
 
+  void OrthancPlugins::RegisterBatchTranscoderCallback(const void* parameters)
+  {
+    const _OrthancPluginBatchTranscoderCallback& p = 
+      *reinterpret_cast<const _OrthancPluginBatchTranscoderCallback*>(parameters);
+
+    boost::unique_lock<boost::shared_mutex> lock(pimpl_->decoderTranscoderMutex_);
+
+    pimpl_->batchTranscoderCallbacks_.push_back(p.callback);
+    CLOG(INFO, PLUGINS) << "Plugin has registered a callback to transcode batches of DICOM images (" 
+                        << pimpl_->batchTranscoderCallbacks_.size() << " batch transcoder(s) now active)";
+  }
+
+
   void OrthancPlugins::RegisterJobsUnserializer(const void* parameters)
   {
     const _OrthancPluginJobsUnserializer& p = 
@@ -3556,6 +4277,60 @@ namespace Orthanc
     CopyToMemoryBuffer(p.target, dicom);
   }
 
+
+  void OrthancPlugins::GetDicomHeaderForInstance(const void* parameters)
+  {
+    const _OrthancPluginGetDicomForInstance& p = 
+      *reinterpret_cast<const _OrthancPluginGetDicomForInstance*>(parameters);
+
+    std::string header;
+
+    {
+      PImpl::ServerContextReference lock(*pimpl_);
+      lock.GetContext().ReadDicomForHeader(header, p.instanceId);
+    }
+
+    CopyToMemoryBuffer(p.target, header);
+  }
+
+
+  void OrthancPlugins::GetInstanceTags(const void* parameters)
+  {
+    const _OrthancPluginGetInstanceTags& p = 
+      *reinterpret_cast<const _OrthancPluginGetInstanceTags*>(parameters);
+
+    std::set<DicomTag> requestedTags;
+    if (p.requestedTags != NULL &&
+        strlen(p.requestedTags) > 0)
+    {
+      FromDcmtkBridge::ParseListOfTags(requestedTags, p.requestedTags);
+    }
+
+    Json::Value json;
+
+    {
+      PImpl::ServerContextReference lock(*pimpl_);
+      ServerContext& context = lock.GetContext();
+
+      // Same as "GET /instances/{id}?requested-tags=..."
+      ResourceFinder finder(ResourceType_Instance,
+                            ResponseContentFlags_ExpandTrue,
+                            context.GetFindStorageAccessMode(),
+                            context.GetIndex().HasFindSupport());
+      finder.AddRequestedTags(requestedTags);
+      finder.SetOrthancId(ResourceType_Instance, p.instanceId);
+
+      if (!finder.ExecuteOneResource(json, context, Plugins::Convert(p.format), false /* no "Metadata" field */))
+      {
+        throw OrthancException(ErrorCode_UnknownResource);
+      }
+    }
+
+    std::string s;
+    Toolbox::WriteFastJson(s, json);
+    *p.result = CopyString(s);
+  }
+
   static void ThrowOnHttpError(HttpStatus httpStatus)
   {
     int intHttpStatus = static_cast<int>(httpStatus);
@@ -3913,35 +4688,46 @@ namespace Orthanc
     std::string result;
 
     {
-      std::unique_ptr<DeflateBaseCompressor> compressor;
+      std::unique_ptr<IBufferCompressor> compressor;
 
       switch (p.compression)
       {
         case OrthancPluginCompressionType_Zlib:
         {
-          compressor.reset(new ZlibCompressor);
-          compressor->SetPrefixWithUncompressedSize(false);
+          std::unique_ptr<ZlibCompressor> zlib(new ZlibCompressor);
+          zlib->SetPrefixWithUncompressedSize(false);
+          compressor.reset(zlib.release());
           break;
         }
 
         case OrthancPluginCompressionType_ZlibWithSize:
         {
-          compressor.reset(new ZlibCompressor);
-          compressor->SetPrefixWithUncompressedSize(true);
+          std::unique_ptr<ZlibCompressor> zlib(new ZlibCompressor);
+          zlib->SetPrefixWithUncompressedSize(true);
+          compressor.reset(zlib.release());
           break;
         }
 
         case OrthancPluginCompressionType_Gzip:
         {
-          compressor.reset(new GzipCompressor);
-          compressor->SetPrefixWithUncompressedSize(false);
+          std::unique_ptr<GzipCompressor> gzip(new GzipCompressor);
+          gzip->SetPrefixWithUncompressedSize(false);
+          compressor.reset(gzip.release());
           break;
         }
 
         case OrthancPluginCompressionType_GzipWithSize:
         {
-          compressor.reset(new GzipCompressor);
-          compressor->SetPrefixWithUncompressedSize(true);
+          std::unique_ptr<GzipCompressor> gzip(new GzipCompressor);
+          gzip->SetPrefixWithUncompressedSize(true);
+          compressor.reset(gzip.release());
+          break;
+        }
+
+        case OrthancPluginCompressionType_ZstdWithSize:
+        case OrthancPluginCompressionType_Lz4WithSize:
+        {
+          compressor.reset(IBufferCompressor::Create(Plugins::Convert(p.compression)));
           break;
         }
 
@@ -4984,6 +5770,115 @@ namespace Orthanc
     }
   }
 
+  void OrthancPlugins::ApplyUpdateKeysValues(const _OrthancPluginUpdateKeysValues& parameters)
+  {
+    PImpl::ServerContextReference lock(*pimpl_);
+
+    CheckKeyValueStoresSupport(lock.GetContext());
+
+    if ((parameters.storedCount != 0 &&
+         (parameters.storedKeys == NULL ||
+          parameters.storedValues == NULL ||
+          parameters.storedValuesSizes == NULL)) ||
+        (parameters.deletedCount != 0 &&
+         parameters.deletedKeys == NULL))
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    std::map<std::string, std::string> stored;
+    for (uint32_t i = 0; i < parameters.storedCount; i++)
+    {
+      if (parameters.storedKeys[i] == NULL ||
+          parameters.storedValuesSizes[i] == 0 ||
+          parameters.storedValues[i] == NULL)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "You must provide a non-null and non-empty value when adding a value in a Key-Value store.");
+      }
+
+      stored[parameters.storedKeys[i]].assign(reinterpret_cast<const char*>(parameters.storedValues[i]),
+                                              parameters.storedValuesSizes[i]);
+    }
+
+    std::set<std::string> deleted;
+    for (uint32_t i = 0; i < parameters.deletedCount; i++)
+    {
+      if (parameters.deletedKeys[i] == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+
+      if (stored.find(parameters.deletedKeys[i]) != stored.end())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "The same key cannot be both stored and deleted: " +
+                               std::string(parameters.deletedKeys[i]));
+      }
+
+      deleted.insert(parameters.deletedKeys[i]);
+    }
+
+    lock.GetContext().GetIndex().UpdateKeysValues(parameters.storeId, stored, deleted);
+  }
+
+  void OrthancPlugins::ApplyGetKeysValues(const _OrthancPluginGetKeysValues& parameters)
+  {
+    PImpl::ServerContextReference lock(*pimpl_);
+
+    CheckKeyValueStoresSupport(lock.GetContext());
+
+    if (parameters.count != 0 &&
+        (parameters.found == NULL ||
+         parameters.values == NULL ||
+         parameters.keys == NULL))
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    std::set<std::string> keys;
+    for (uint32_t i = 0; i < parameters.count; i++)
+    {
+      if (parameters.keys[i] == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+
+      keys.insert(parameters.keys[i]);
+    }
+
+    std::map<std::string, std::string> values;
+    lock.GetContext().GetIndex().GetKeysValues(values, parameters.storeId, keys);
+
+    for (uint32_t i = 0; i < parameters.count; i++)
+    {
+      std::map<std::string, std::string>::const_iterator found = values.find(parameters.keys[i]);
+      if (found == values.end())
+      {
+        parameters.values[i].data = NULL;
+        parameters.values[i].size = 0;
+        parameters.found[i] = false;
+      }
+      else
+      {
+        CopyToMemoryBuffer(&parameters.values[i], found->second);
+        parameters.found[i] = true;
+      }
+    }
+  }
+
+  void OrthancPlugins::ApplySetKeyValueStoreCacheSize(const _OrthancPluginSetKeyValueStoreCacheSize& parameters)
+  {
+    PImpl::ServerContextReference lock(*pimpl_);
+
+    CheckKeyValueStoresSupport(lock.GetContext());
+
+    if (static_cast<uint64_t>(static_cast<size_t>(parameters.maximumSize)) != parameters.maximumSize)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    lock.GetContext().GetIndex().SetKeyValueStoreCacheSize(parameters.storeId, static_cast<size_t>(parameters.maximumSize));
+  }
+
   void OrthancPlugins::ApplyCreateKeysValuesIterator(const _OrthancPluginCreateKeysValuesIterator& parameters)
   {
     PImpl::ServerContextReference lock(*pimpl_);
@@ -5359,6 +6254,14 @@ namespace Orthanc
         GetDicomForInstance(parameters);
         return true;
 
+      case _OrthancPluginService_GetDicomHeaderForInstance:
+        GetDicomHeaderForInstance(parameters);
+        return true;
+
+      case _OrthancPluginService_GetInstanceTags:
+        GetInstanceTags(parameters);
+        return true;
+
       case _OrthancPluginService_RestApiGet:
         RestApiGet(parameters, false);
         return true;
@@ -5534,6 +6437,14 @@ namespace Orthanc
         return true;
       }
 
+      case _OrthancPluginService_StartStreamAnswer2:
+      {
+        const _OrthancPluginStartStreamAnswer2& p =
+          *reinterpret_cast<const _OrthancPluginStartStreamAnswer2*>(parameters);
+        reinterpret_cast<PImpl::PluginHttpOutput*>(p.output)->StartBody(p.contentType, p.contentLength);
+        return true;
+      }
+
       case _OrthancPluginService_SendStreamChunk:
       {
         const _OrthancPluginAnswerBuffer& p =
@@ -5924,7 +6835,7 @@ namespace Orthanc
       {
         const _OrthancPluginCreateJob& p =
           *reinterpret_cast<const _OrthancPluginCreateJob*>(parameters);
-        *(p.target) = reinterpret_cast<OrthancPluginJob*>(new PluginsJob(p));
+        *(p.target) = reinterpret_cast<OrthancPluginJob*>(static_cast<IJob*>(new PluginsJob(p)));
         return true;
       }
 
@@ -5932,18 +6843,31 @@ namespace Orthanc
       {
         const _OrthancPluginCreateJob2& p =
           *reinterpret_cast<const _OrthancPluginCreateJob2*>(parameters);
-        *(p.target) = reinterpret_cast<OrthancPluginJob*>(new PluginsJob(p));
+        *(p.target) = reinterpret_cast<OrthancPluginJob*>(static_cast<IJob*>(new PluginsJob(p)));
         return true;
       }
 
-      case _OrthancPluginService_FreeJob:
+      case _OrthancPluginService_CreateParallelJob:
       {
-        const _OrthancPluginFreeJob& p =
-          *reinterpret_cast<const _OrthancPluginFreeJob*>(parameters);
+        const _OrthancPluginCreateParallelJob& p =
+          *reinterpret_cast<const _OrthancPluginCreateParallelJob*>(parameters);
+
+        PImpl::ServerContextReference lock(*pimpl_);
+
+        // The jobs are exchanged with the plugins as pointers to "IJob"
+        IJob* job = new PluginsParallelJob(p, lock.GetContext().GetJobsEngine().GetTasksExecutor());
+        *(p.target) = reinterpret_cast<OrthancPluginJob*>(job);
+        return true;
+      }
+
+      case _OrthancPluginService_FreeJob:
+      {
+        const _OrthancPluginFreeJob& p =
+          *reinterpret_cast<const _OrthancPluginFreeJob*>(parameters);
 
         if (p.job != NULL)
         {
-          delete reinterpret_cast<PluginsJob*>(p.job);
+          delete reinterpret_cast<IJob*>(p.job);
         }
 
         return true;
@@ -5958,7 +6882,7 @@ namespace Orthanc
 
         PImpl::ServerContextReference lock(*pimpl_);
         lock.GetContext().GetJobsEngine().GetRegistry().Submit
-          (uuid, reinterpret_cast<PluginsJob*>(p.job), p.priority);
+          (uuid, reinterpret_cast<IJob*>(p.job), p.priority);
         
         *p.resultId = CopyString(uuid);
 
@@ -6195,6 +7119,27 @@ namespace Orthanc
         return true;
       }
 
+      case _OrthancPluginService_UpdateKeysValues:
+      {
+        const _OrthancPluginUpdateKeysValues& p = *reinterpret_cast<const _OrthancPluginUpdateKeysValues*>(parameters);
+        ApplyUpdateKeysValues(p);
+        return true;
+      }
+
+      case _OrthancPluginService_GetKeysValues:
+      {
+        const _OrthancPluginGetKeysValues& p = *reinterpret_cast<const _OrthancPluginGetKeysValues*>(parameters);
+        ApplyGetKeysValues(p);
+        return true;
+      }
+
+      case _OrthancPluginService_SetKeyValueStoreCacheSize:
+      {
+        const _OrthancPluginSetKeyValueStoreCacheSize& p = *reinterpret_cast<const _OrthancPluginSetKeyValueStoreCacheSize*>(parameters);
+        ApplySetKeyValueStoreCacheSize(p);
+        return true;
+      }
+
       case _OrthancPluginService_CreateKeysValuesIterator:
       {
         const _OrthancPluginCreateKeysValuesIterator& p = *reinterpret_cast<const _OrthancPluginCreateKeysValuesIterator*>(parameters);
@@ -6307,6 +7252,10 @@ namespace Orthanc
         RegisterRestCallback(parameters, false);
         return true;
 
+      case _OrthancPluginService_RegisterRestCallback2:
+        RegisterRestCallback2(parameters);
+        return true;
+
       case _OrthancPluginService_RegisterChunkedRestCallback:
         RegisterChunkedRestCallback(parameters);
         return true;
@@ -6319,6 +7268,18 @@ namespace Orthanc
         RegisterOnChangeCallback(parameters);
         return true;
 
+      case _OrthancPluginService_RegisterOnChangeCallback2:
+        RegisterOnChangeCallback2(parameters);
+        return true;
+
+      case _OrthancPluginService_RegisterChangesBatchCallback:
+        RegisterChangesBatchCallback(parameters);
+        return true;
+
+      case _OrthancPluginService_RegisterCoalescedChangeCallback:
+        RegisterCoalescedChangeCallback(parameters);
+        return true;
+
       case _OrthancPluginService_RegisterWorklistCallback:
         RegisterWorklistCallback(parameters);
         return true;
@@ -6347,10 +7308,18 @@ namespace Orthanc
         RegisterDecodeImageCallback(parameters);
         return true;
 
+      case _OrthancPluginService_RegisterDecodeFramesCallback:
+        RegisterDecodeFramesCallback(parameters);
+        return true;
+
       case _OrthancPluginService_RegisterTranscoderCallback:
         RegisterTranscoderCallback(parameters);
         return true;
 
+      case _OrthancPluginService_RegisterBatchTranscoderCallback:
+        RegisterBatchTranscoderCallback(parameters);
+        return true;
+
       case _OrthancPluginService_RegisterJobsUnserializer:
         RegisterJobsUnserializer(parameters);
         return true;
@@ -6399,7 +7368,7 @@ namespace Orthanc
     
             const _OrthancPluginRegisterStorageArea& p = 
               *reinterpret_cast<const _OrthancPluginRegisterStorageArea*>(parameters);
-            pimpl_->storageArea_.reset(new StorageAreaFactory(plugin, p, GetErrorDictionary()));
+            pimpl_->storageArea_.reset(new StorageAreaFactory(plugin, p, GetErrorDictionary(), pimpl_->callbacksMetrics_));
           }
           else if (service == _OrthancPluginService_RegisterStorageArea2)
           {
@@ -6407,7 +7376,7 @@ namespace Orthanc
 
             const _OrthancPluginRegisterStorageArea2& p = 
               *reinterpret_cast<const _OrthancPluginRegisterStorageArea2*>(parameters);
-            pimpl_->storageArea_.reset(new StorageAreaFactory(plugin, p, GetErrorDictionary()));
+            pimpl_->storageArea_.reset(new StorageAreaFactory(plugin, p, GetErrorDictionary(), pimpl_->callbacksMetrics_));
           }
           else if (service == _OrthancPluginService_RegisterStorageArea3)
           {
@@ -6415,7 +7384,7 @@ namespace Orthanc
 
             const _OrthancPluginRegisterStorageArea3& p = 
               *reinterpret_cast<const _OrthancPluginRegisterStorageArea3*>(parameters);
-            pimpl_->storageArea_.reset(new StorageAreaFactory(plugin, p, GetErrorDictionary()));
+            pimpl_->storageArea_.reset(new StorageAreaFactory(plugin, p, GetErrorDictionary(), pimpl_->callbacksMetrics_));
             pimpl_->hasStorageAreaCustomData_ = true;
           }
           else
@@ -6431,6 +7400,24 @@ namespace Orthanc
         return true;
       }
 
+      case _OrthancPluginService_RegisterStorageAreaStreaming:
+      {
+        CLOG(INFO, PLUGINS) << "Plugin has registered a streaming access to its storage area";
+
+        const _OrthancPluginRegisterStorageAreaStreaming& p =
+          *reinterpret_cast<const _OrthancPluginRegisterStorageAreaStreaming*>(parameters);
+
+        if (pimpl_->storageArea_.get() == NULL ||
+            &pimpl_->storageArea_->GetSharedLibrary() != &plugin)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls, "OrthancPluginRegisterStorageAreaStreaming() must be "
+                                 "called after OrthancPluginRegisterStorageArea3() by the same plugin");
+        }
+
+        pimpl_->storageArea_->SetStreaming(p);
+        return true;
+      }
+
       case _OrthancPluginService_SetPluginProperty:
       {
         const _OrthancPluginSetPluginProperty& p = 
@@ -6656,6 +7643,26 @@ namespace Orthanc
 
 
 
+  static bool IsAllowedInRestrictedScope(_OrthancPluginService service)
+  {
+    // These protected services only read the state of the plugin
+    // engine: They are allowed from within the REST callbacks
+    // registered by "OrthancPluginRegisterRestCallback2()", even if
+    // they briefly lock "invokeServiceMutex_"
+    switch (service)
+    {
+      case _OrthancPluginService_GetCommandLineArgumentsCount:
+      case _OrthancPluginService_GetCommandLineArgument:
+      case _OrthancPluginService_GenerateRestApiAuthorizationToken:
+      case _OrthancPluginService_GetDatabaseServerIdentifier:
+        return true;
+
+      default:
+        return false;
+    }
+  }
+
+
   bool OrthancPlugins::InvokeService(SharedLibrary& plugin,
                                      _OrthancPluginService service,
                                      const void* parameters)
@@ -6674,16 +7681,146 @@ namespace Orthanc
       return true;
     }
 
+    bool success;
+
     if (InvokeSafeService(plugin, service, parameters))
     {
       // The invoked service does not require locking
-      return true;
+      success = true;
+    }
+    else if (RestrictedServicesScope::IsActive() &&
+             !IsAllowedInRestrictedScope(service))
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                             "This service of the plugin SDK cannot be called from a REST callback "
+                             "registered by OrthancPluginRegisterRestCallback2(): " +
+                             boost::lexical_cast<std::string>(service));
     }
     else
     {
       // The invoked service requires locking
       boost::recursive_mutex::scoped_lock lock(pimpl_->invokeServiceMutex_);   // (*)
-      return InvokeProtectedService(plugin, service, parameters);
+      success = InvokeProtectedService(plugin, service, parameters);
+    }
+
+    if (success)
+    {
+      RegisterCallbacksOwner(plugin, service, parameters);
+    }
+
+    return success;
+  }
+
+
+  void OrthancPlugins::RegisterCallbacksOwner(SharedLibrary& plugin,
+                                              _OrthancPluginService service,
+                                              const void* parameters)
+  {
+    // Remember which plugin has registered the callbacks that are
+    // instrumented by "PluginsCallbacksMetrics"
+    PluginsCallbacksMetrics& metrics = pimpl_->callbacksMetrics_;
+
+    switch (service)
+    {
+      case _OrthancPluginService_RegisterRestCallback:
+      case _OrthancPluginService_RegisterRestCallbackNoLock:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginRestCallback*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterRestCallback2:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginRestCallback2*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterChunkedRestCallback:
+      {
+        const _OrthancPluginChunkedRestCallback& p = *reinterpret_cast<const _OrthancPluginChunkedRestCallback*>(parameters);
+        metrics.RegisterOwner(p.getHandler, plugin);
+        metrics.RegisterOwner(p.deleteHandler, plugin);
+        break;
+      }
+
+      case _OrthancPluginService_RegisterOnStoredInstanceCallback:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginOnStoredInstanceCallback*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterOnChangeCallback:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginOnChangeCallback*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterOnChangeCallback2:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginOnChangeCallback2*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterChangesBatchCallback:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginChangesBatchCallback*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterCoalescedChangeCallback:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginCoalescedChangeCallback*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterFindCallback:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginFindCallback*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterFindCallback2:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginFindCallback2*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterDecodeImageCallback:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginDecodeImageCallback*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterDecodeFramesCallback:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginDecodeFramesCallback*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterIncomingHttpRequestFilter:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginIncomingHttpRequestFilter*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterIncomingHttpRequestFilter2:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginIncomingHttpRequestFilter2*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterIncomingDicomInstanceFilter:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginIncomingDicomInstanceFilter*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterIncomingCStoreInstanceFilter:
+        metrics.RegisterOwner(reinterpret_cast<const _OrthancPluginIncomingCStoreInstanceFilter*>(parameters)->callback, plugin);
+        break;
+
+      case _OrthancPluginService_RegisterStorageArea:
+      {
+        const _OrthancPluginRegisterStorageArea& p = *reinterpret_cast<const _OrthancPluginRegisterStorageArea*>(parameters);
+        metrics.RegisterOwner(p.create, plugin);
+        metrics.RegisterOwner(p.read, plugin);
+        metrics.RegisterOwner(p.remove, plugin);
+        break;
+      }
+
+      case _OrthancPluginService_RegisterStorageArea2:
+      {
+        const _OrthancPluginRegisterStorageArea2& p = *reinterpret_cast<const _OrthancPluginRegisterStorageArea2*>(parameters);
+        metrics.RegisterOwner(p.create, plugin);
+        metrics.RegisterOwner(p.readWhole, plugin);
+        metrics.RegisterOwner(p.readRange, plugin);
+        metrics.RegisterOwner(p.remove, plugin);
+        break;
+      }
+
+      case _OrthancPluginService_RegisterStorageArea3:
+      {
+        const _OrthancPluginRegisterStorageArea3& p = *reinterpret_cast<const _OrthancPluginRegisterStorageArea3*>(parameters);
+        metrics.RegisterOwner(p.create, plugin);
+        metrics.RegisterOwner(p.readRange, plugin);
+        metrics.RegisterOwner(p.remove, plugin);
+        break;
+      }
+
+      default:
+        break;
     }
   }
 
@@ -6887,7 +8024,8 @@ namespace Orthanc
   bool OrthancPlugins::HasCustomTranscoder()
   {
     boost::shared_lock<boost::shared_mutex> lock(pimpl_->decoderTranscoderMutex_);
-    return !pimpl_->transcoderCallbacks_.empty();
+    return (!pimpl_->transcoderCallbacks_.empty() ||
+            !pimpl_->batchTranscoderCallbacks_.empty());
   }
 
 
@@ -6907,7 +8045,15 @@ namespace Orthanc
          decoder != pimpl_->decodeImageCallbacks_.end(); ++decoder)
     {
       OrthancPluginImage* pluginImage = NULL;
-      if ((*decoder) (&pluginImage, dicom, size, frame) == OrthancPluginErrorCode_Success &&
+      OrthancPluginErrorCode error;
+
+      {
+        PluginsCallbacksMetrics::Timer timer(pimpl_->callbacksMetrics_, *decoder, "decoder");
+        error = (*decoder) (&pluginImage, dicom, size, frame);
+        timer.SetResult(error);
+      }
+
+      if (error == OrthancPluginErrorCode_Success &&
           pluginImage != NULL)
       {
         return reinterpret_cast<ImageAccessor*>(pluginImage);
@@ -6917,6 +8063,85 @@ namespace Orthanc
     return NULL;
   }
 
+
+  bool OrthancPlugins::HasFramesDecoder()
+  {
+    boost::shared_lock<boost::shared_mutex> lock(pimpl_->decoderTranscoderMutex_);
+    return !pimpl_->decodeFramesCallbacks_.empty();
+  }
+
+
+  bool OrthancPlugins::DecodeFrames(DecodedFrames& target,
+                                    const std::string& header,
+                                    const std::string& transferSyntax,
+                                    const std::vector<unsigned int>& frameIndexes,
+                                    const std::vector<std::string>& frames)
+  {
+    if (frameIndexes.size() != frames.size() ||
+        frames.empty())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    target.Clear();
+
+    std::vector<uint32_t> indexes(frames.size());
+    std::vector<const void*> buffers(frames.size());
+    std::vector<uint64_t> sizes(frames.size());
+
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+      indexes[i] = frameIndexes[i];
+      buffers[i] = (frames[i].empty() ? NULL : frames[i].c_str());
+      sizes[i] = frames[i].size();
+    }
+
+    boost::shared_lock<boost::shared_mutex> lock(pimpl_->decoderTranscoderMutex_);
+
+    for (PImpl::DecodeFramesCallbacks::const_iterator
+           decoder = pimpl_->decodeFramesCallbacks_.begin();
+         decoder != pimpl_->decodeFramesCallbacks_.end(); ++decoder)
+    {
+      std::vector<OrthancPluginImage*> images(frames.size(), NULL);
+      OrthancPluginErrorCode error;
+
+      {
+        PluginsCallbacksMetrics::Timer timer(pimpl_->callbacksMetrics_, *decoder, "decoder");
+        error = (*decoder) (&images[0], header.empty() ? NULL : header.c_str(), header.size(),
+                            transferSyntax.c_str(), static_cast<uint32_t>(frames.size()),
+                            &indexes[0], &buffers[0], &sizes[0]);
+        timer.SetResult(error);
+      }
+
+      // Take the ownership of the images, even on error
+      bool complete = true;
+
+      for (size_t i = 0; i < images.size(); i++)
+      {
+        if (images[i] == NULL)
+        {
+          complete = false;
+        }
+        else
+        {
+          target.Add(reinterpret_cast<ImageAccessor*>(images[i]));
+        }
+      }
+
+      if (error == OrthancPluginErrorCode_Success &&
+          complete)
+      {
+        return true;
+      }
+      else
+      {
+        target.Clear();
+      }
+    }
+
+    return false;
+  }
+
   
   bool OrthancPlugins::IsAllowed(HttpMethod method,
                                  const char* uri,
@@ -6955,13 +8180,22 @@ namespace Orthanc
              filter = pimpl_->incomingHttpRequestFilters2_.begin();
            filter != pimpl_->incomingHttpRequestFilters2_.end(); ++filter)
       {
-        int32_t allowed = (*filter) (cMethod, uri, ip,
-                                     httpKeys.size(),
-                                     httpKeys.empty() ? NULL : &httpKeys[0],
-                                     httpValues.empty() ? NULL : &httpValues[0],
-                                     getKeys.size(),
-                                     getKeys.empty() ? NULL : &getKeys[0],
-                                     getValues.empty() ? NULL : &getValues[0]);
+        int32_t allowed;
+
+        {
+          PluginsCallbacksMetrics::Timer timer(pimpl_->callbacksMetrics_, *filter, "filter");
+          allowed = (*filter) (cMethod, uri, ip,
+                               httpKeys.size(),
+                               httpKeys.empty() ? NULL : &httpKeys[0],
+                               httpValues.empty() ? NULL : &httpValues[0],
+                               getKeys.size(),
+                               getKeys.empty() ? NULL : &getKeys[0],
+                               getValues.empty() ? NULL : &getValues[0]);
+          if (allowed == 0 || allowed == 1)
+          {
+            timer.SetSuccess();
+          }
+        }
 
         if (allowed == 0)
         {
@@ -6978,9 +8212,18 @@ namespace Orthanc
              filter = pimpl_->incomingHttpRequestFilters_.begin();
            filter != pimpl_->incomingHttpRequestFilters_.end(); ++filter)
       {
-        int32_t allowed = (*filter) (cMethod, uri, ip, httpKeys.size(),
-                                     httpKeys.empty() ? NULL : &httpKeys[0],
-                                     httpValues.empty() ? NULL : &httpValues[0]);
+        int32_t allowed;
+
+        {
+          PluginsCallbacksMetrics::Timer timer(pimpl_->callbacksMetrics_, *filter, "filter");
+          allowed = (*filter) (cMethod, uri, ip, httpKeys.size(),
+                               httpKeys.empty() ? NULL : &httpKeys[0],
+                               httpValues.empty() ? NULL : &httpValues[0]);
+          if (allowed == 0 || allowed == 1)
+          {
+            timer.SetSuccess();
+          }
+        }
 
         if (allowed == 0)
         {
@@ -7012,7 +8255,7 @@ namespace Orthanc
       OrthancPluginJob* job = (*unserializer) (type.c_str(), serialized.c_str());
       if (job != NULL)
       {
-        return reinterpret_cast<PluginsJob*>(job);
+        return reinterpret_cast<IJob*>(job);
       }
     }
 
@@ -7022,6 +8265,49 @@ namespace Orthanc
 
   void OrthancPlugins::RefreshMetrics()
   {
+    {
+      /**
+       * No lock on "changeCallbackMutex_", as it might be held by the
+       * thread of the changes waiting for room in a full queue. The
+       * list is only modified during the initialization of the plugins.
+       **/
+      if (!pimpl_->asynchronousChangeCallbacks_.empty())
+      {
+        size_t depth = 0;
+        uint64_t dropped = 0;
+
+        for (PImpl::AsynchronousChangeCallbacks::iterator it = pimpl_->asynchronousChangeCallbacks_.begin();
+             it != pimpl_->asynchronousChangeCallbacks_.end(); ++it)
+        {
+          assert(*it != NULL);
+          depth += (*it)->GetQueueDepth();
+          dropped += (*it)->GetDroppedCount();
+        }
+
+        PImpl::ServerContextReference context(*pimpl_);
+        context.GetContext().GetMetricsRegistry().SetIntegerValue(
+          "orthanc_plugins_changes_queue_depth", static_cast<int64_t>(depth));
+        context.GetContext().GetMetricsRegistry().SetIntegerValue(
+          "orthanc_plugins_changes_discarded_count", static_cast<int64_t>(dropped));
+      }
+
+      if (!pimpl_->coalescedChangeCallbacks_.empty())
+      {
+        size_t pending = 0;
+
+        for (PImpl::CoalescedChangeCallbacks::iterator it = pimpl_->coalescedChangeCallbacks_.begin();
+             it != pimpl_->coalescedChangeCallbacks_.end(); ++it)
+        {
+          assert(*it != NULL);
+          pending += (*it)->GetPendingCount();
+        }
+
+        PImpl::ServerContextReference context(*pimpl_);
+        context.GetContext().GetMetricsRegistry().SetIntegerValue(
+          "orthanc_plugins_coalesced_changes_pending", static_cast<int64_t>(pending));
+      }
+    }
+
     boost::mutex::scoped_lock lock(pimpl_->refreshMetricsMutex_);
 
     for (PImpl::RefreshMetricsCallbacks::iterator 
@@ -7204,6 +8490,77 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    // Set of memory buffers that are filled by the batch transcoder
+    // callbacks, and that are released by Orthanc
+    class BatchMemoryBuffers : public boost::noncopyable
+    {
+    private:
+      std::vector<OrthancPluginMemoryBuffer>  buffers_;
+
+    public:
+      explicit BatchMemoryBuffers(size_t count) :
+        buffers_(count)
+      {
+        Clear();
+      }
+
+      ~BatchMemoryBuffers()
+      {
+        Clear();
+      }
+
+      void Clear()
+      {
+        for (size_t i = 0; i < buffers_.size(); i++)
+        {
+          if (buffers_[i].size != 0)
+          {
+            ::free(buffers_[i].data);
+          }
+
+          buffers_[i].data = NULL;
+          buffers_[i].size = 0;
+        }
+      }
+
+      OrthancPluginMemoryBuffer* GetObject()
+      {
+        return buffers_.empty() ? NULL : &buffers_[0];
+      }
+
+      void MoveToString(std::string& target,
+                        size_t index)
+      {
+        OrthancPluginMemoryBuffer& buffer = buffers_.at(index);
+        target.assign(reinterpret_cast<const char*>(buffer.data), buffer.size);
+
+        if (buffer.size != 0)
+        {
+          ::free(buffer.data);
+        }
+
+        buffer.data = NULL;
+        buffer.size = 0;
+      }
+    };
+  }
+
+
+  static void GetTransferSyntaxUids(std::vector<const char*>& uids,
+                                    const std::set<DicomTransferSyntax>& allowedSyntaxes)
+  {
+    uids.clear();
+    uids.reserve(allowedSyntaxes.size());
+    for (std::set<DicomTransferSyntax>::const_iterator
+           it = allowedSyntaxes.begin(); it != allowedSyntaxes.end(); ++it)
+    {
+      uids.push_back(GetTransferSyntaxUid(*it));
+    }
+  }
+
+
   bool OrthancPlugins::TranscodeBuffer(std::string& target,
                                        const void* buffer,
                                        size_t size,
@@ -7212,18 +8569,14 @@ namespace Orthanc
   {
     boost::shared_lock<boost::shared_mutex> lock(pimpl_->decoderTranscoderMutex_);
 
-    if (pimpl_->transcoderCallbacks_.empty())
+    if (pimpl_->transcoderCallbacks_.empty() &&
+        pimpl_->batchTranscoderCallbacks_.empty())
     {
       return false;
     }
 
     std::vector<const char*> uids;
-    uids.reserve(allowedSyntaxes.size());
-    for (std::set<DicomTransferSyntax>::const_iterator
-           it = allowedSyntaxes.begin(); it != allowedSyntaxes.end(); ++it)
-    {
-      uids.push_back(GetTransferSyntaxUid(*it));
-    }
+    GetTransferSyntaxUids(uids, allowedSyntaxes);
     
     for (PImpl::TranscoderCallbacks::const_iterator
            transcoder = pimpl_->transcoderCallbacks_.begin();
@@ -7240,10 +8593,139 @@ namespace Orthanc
       }
     }
 
+    // Submit the instance to the batch transcoders, as a batch of size 1
+    const uint64_t size64 = static_cast<uint64_t>(size);
+
+    for (PImpl::BatchTranscoderCallbacks::const_iterator
+           transcoder = pimpl_->batchTranscoderCallbacks_.begin();
+         transcoder != pimpl_->batchTranscoderCallbacks_.end(); ++transcoder)
+    {
+      BatchMemoryBuffers a(1);
+      uint8_t success = 0;
+
+      if ((*transcoder) (a.GetObject(), &success, 1, &buffer, &size64, uids.empty() ? NULL : &uids[0],
+                         static_cast<uint32_t>(uids.size()), allowNewSopInstanceUid) ==
+          OrthancPluginErrorCode_Success &&
+          success != 0)
+      {
+        a.MoveToString(target, 0);
+        return true;
+      }
+    }
+
     return false;
   }
 
 
+  void OrthancPlugins::TranscodeBufferBatch(std::vector<bool>& success,
+                                            std::vector<std::string>& targets,
+                                            const std::vector<const void*>& buffers,
+                                            const std::vector<size_t>& sizes,
+                                            const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                                            bool allowNewSopInstanceUid)
+  {
+    if (buffers.size() != sizes.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    success.assign(buffers.size(), false);
+    targets.resize(buffers.size());
+
+    if (buffers.empty())
+    {
+      return;
+    }
+
+    {
+      boost::shared_lock<boost::shared_mutex> lock(pimpl_->decoderTranscoderMutex_);
+
+      if (!pimpl_->batchTranscoderCallbacks_.empty())
+      {
+        std::vector<const char*> uids;
+        GetTransferSyntaxUids(uids, allowedSyntaxes);
+
+        for (PImpl::BatchTranscoderCallbacks::const_iterator
+               transcoder = pimpl_->batchTranscoderCallbacks_.begin();
+             transcoder != pimpl_->batchTranscoderCallbacks_.end(); ++transcoder)
+        {
+          // Only submit the instances that have not been transcoded yet
+          std::vector<size_t> indices;
+          std::vector<const void*> pending;
+          std::vector<uint64_t> pendingSizes;
+
+          for (size_t i = 0; i < buffers.size(); i++)
+          {
+            if (!success[i])
+            {
+              indices.push_back(i);
+              pending.push_back(buffers[i]);
+              pendingSizes.push_back(static_cast<uint64_t>(sizes[i]));
+            }
+          }
+
+          if (indices.empty())
+          {
+            return;
+          }
+
+          BatchMemoryBuffers a(indices.size());
+          std::vector<uint8_t> flags(indices.size(), 0);
+
+          if ((*transcoder) (a.GetObject(), &flags[0], static_cast<uint32_t>(indices.size()),
+                             &pending[0], &pendingSizes[0], uids.empty() ? NULL : &uids[0],
+                             static_cast<uint32_t>(uids.size()), allowNewSopInstanceUid) ==
+              OrthancPluginErrorCode_Success)
+          {
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+              if (flags[i] != 0)
+              {
+                a.MoveToString(targets[indices[i]], i);
+                success[indices[i]] = true;
+              }
+            }
+          }
+        }
+      }
+    }
+
+    // The remaining instances are submitted one by one to the
+    // single-instance transcoders
+    std::list<OrthancPluginTranscoderCallback> transcoders;
+
+    {
+      boost::shared_lock<boost::shared_mutex> lock(pimpl_->decoderTranscoderMutex_);
+      transcoders = pimpl_->transcoderCallbacks_;
+    }
+
+    if (transcoders.empty())
+    {
+      return;
+    }
+
+    std::vector<const char*> uids;
+    GetTransferSyntaxUids(uids, allowedSyntaxes);
+
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+      for (PImpl::TranscoderCallbacks::const_iterator
+             transcoder = transcoders.begin(); !success[i] && transcoder != transcoders.end(); ++transcoder)
+      {
+        PluginMemoryBuffer32 a;
+
+        if ((*transcoder) (a.GetObject(), buffers[i], sizes[i], uids.empty() ? NULL : &uids[0],
+                           static_cast<uint32_t>(uids.size()), allowNewSopInstanceUid) ==
+            OrthancPluginErrorCode_Success)
+        {
+          a.MoveToString(targets[i]);
+          success[i] = true;
+        }
+      }
+    }
+  }
+
+
   bool OrthancPlugins::IsValidAuthorizationToken(const std::string& token) const
   {
     boost::recursive_mutex::scoped_lock lock(pimpl_->invokeServiceMutex_);
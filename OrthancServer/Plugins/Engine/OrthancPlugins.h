@@ -101,6 +101,8 @@ private:
     void RegisterRestCallback(const void* parameters,
                               bool lock);
 
+    void RegisterRestCallback2(const void* parameters);
+
     void RegisterChunkedRestCallback(const void* parameters);
 
     bool HandleChunkedGetDelete(HttpOutput& output,
@@ -114,6 +116,12 @@ private:
 
     void RegisterOnChangeCallback(const void* parameters);
 
+    void RegisterOnChangeCallback2(const void* parameters);
+
+    void RegisterChangesBatchCallback(const void* parameters);
+
+    void RegisterCoalescedChangeCallback(const void* parameters);
+
     void RegisterWorklistCallback(const void* parameters);
 
     void RegisterWorklistCallback2(const void* parameters);
@@ -128,8 +136,12 @@ private:
 
     void RegisterDecodeImageCallback(const void* parameters);
 
+    void RegisterDecodeFramesCallback(const void* parameters);
+
     void RegisterTranscoderCallback(const void* parameters);
 
+    void RegisterBatchTranscoderCallback(const void* parameters);
+
     void RegisterJobsUnserializer(const void* parameters);
 
     void RegisterIncomingHttpRequestFilter(const void* parameters);
@@ -162,6 +174,10 @@ private:
 
     void GetDicomForInstance(const void* parameters);
 
+    void GetDicomHeaderForInstance(const void* parameters);
+
+    void GetInstanceTags(const void* parameters);
+
     void RestApiGet(const void* parameters,
                     bool afterPlugins);
 
@@ -253,6 +269,12 @@ private:
 
     void ApplyGetKeyValue(const _OrthancPluginGetKeyValue& parameters);
 
+    void ApplyUpdateKeysValues(const _OrthancPluginUpdateKeysValues& parameters);
+
+    void ApplyGetKeysValues(const _OrthancPluginGetKeysValues& parameters);
+
+    void ApplySetKeyValueStoreCacheSize(const _OrthancPluginSetKeyValueStoreCacheSize& parameters);
+
     void ApplyCreateKeysValuesIterator(const _OrthancPluginCreateKeysValuesIterator& parameters);
 
     void ApplyEnqueueValue(const _OrthancPluginEnqueueValue& parameters);
@@ -274,10 +296,17 @@ private:
 
     static void GetTagName(const void* parameters);
 
+    std::string GetStudyOrderingKey(OrthancPluginResourceType resourceType,
+                                    const char* resource);
+
     void SignalChangeInternal(OrthancPluginChangeType changeType,
                               OrthancPluginResourceType resourceType,
                               const char* resource);
 
+    void RegisterCallbacksOwner(SharedLibrary& plugin,
+                                _OrthancPluginService service,
+                                const void* parameters);
+
     bool InvokeSafeService(SharedLibrary& plugin,
                            _OrthancPluginService service,
                            const void* parameters);
@@ -293,6 +322,13 @@ private:
                                  size_t size,
                                  const std::set<DicomTransferSyntax>& allowedSyntaxes,
                                  bool allowNewSopInstanceUid) ORTHANC_OVERRIDE;
+
+    virtual void TranscodeBufferBatch(std::vector<bool>& success,
+                                      std::vector<std::string>& targets,
+                                      const std::vector<const void*>& buffers,
+                                      const std::vector<size_t>& sizes,
+                                      const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                                      bool allowNewSopInstanceUid) ORTHANC_OVERRIDE;
     
   public:
     explicit OrthancPlugins(const std::string& databaseServerIdentifier);
@@ -330,6 +366,11 @@ private:
     virtual bool FilterIncomingInstance(const DicomInstanceToStore& instance,
                                         const Json::Value& simplified) ORTHANC_OVERRIDE;
 
+    virtual bool IsSimplifiedTagsOfIncomingInstanceNeeded() ORTHANC_OVERRIDE
+    {
+      return false;  // The plugins access the DICOM instance itself
+    }
+
     virtual bool FilterIncomingCStoreInstance(uint16_t& dimseStatus,
                                               const DicomInstanceToStore& instance,
                                               const Json::Value& simplified) ORTHANC_OVERRIDE;
@@ -398,6 +439,19 @@ private:
                                   size_t size,
                                   unsigned int frame) ORTHANC_OVERRIDE;
 
+    bool HasFramesDecoder();
+
+    /**
+     * Decodes a batch of encapsulated frames, given the header of the
+     * DICOM file (up to the pixel data) and the concatenated fragments
+     * of each frame. Returns "false" if no plugin could decode them.
+     **/
+    bool DecodeFrames(DecodedFrames& target,
+                      const std::string& header,
+                      const std::string& transferSyntax,
+                      const std::vector<unsigned int>& frameIndexes,
+                      const std::vector<std::string>& frames);
+
     bool IsAllowed(HttpMethod method,
                    const char* uri,
                    const char* ip,
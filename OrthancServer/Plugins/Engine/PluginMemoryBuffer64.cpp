@@ -160,4 +160,50 @@ namespace Orthanc
       Assign(data.c_str(), data.size());
     }
   }
+
+
+  void PreallocatedMemoryBuffer64::SanityCheck() const
+  {
+    // Detect plugins that would have reallocated the buffer
+    if (buffer_.size != content_.size() ||
+        (content_.empty() && buffer_.data != NULL) ||
+        (!content_.empty() && buffer_.data != &content_[0]))
+    {
+      throw OrthancException(ErrorCode_Plugin, "A plugin has modified a memory buffer that is owned by the Orthanc core");
+    }
+  }
+
+
+  PreallocatedMemoryBuffer64::PreallocatedMemoryBuffer64(size_t size)
+  {
+    content_.resize(size);
+    buffer_.data = (size == 0 ? NULL : &content_[0]);
+    buffer_.size = size;
+  }
+
+
+  void PreallocatedMemoryBuffer64::MoveToString(std::string& target)
+  {
+    SanityCheck();
+
+    target.swap(content_);
+    content_.clear();
+
+    buffer_.data = NULL;
+    buffer_.size = 0;
+  }
+
+
+  const void* PreallocatedMemoryBuffer64::GetData() const
+  {
+    SanityCheck();
+    return (content_.empty() ? NULL : content_.c_str());
+  }
+
+
+  size_t PreallocatedMemoryBuffer64::GetSize() const
+  {
+    SanityCheck();
+    return content_.size();
+  }
 }
@@ -71,4 +71,37 @@ namespace Orthanc
 
     void Assign(const std::string& data);
   };
+
+
+  /**
+   * Memory buffer that is allocated by the Orthanc core and filled by
+   * a plugin (e.g. the "readRange" callbacks of the storage area).
+   * The underlying storage is a "std::string", which makes it
+   * possible to move the content to the rest of the read path
+   * without any copy. New in Orthanc 1.12.12.
+   **/
+  class PreallocatedMemoryBuffer64 : public IMemoryBuffer
+  {
+  private:
+    std::string                  content_;
+    OrthancPluginMemoryBuffer64  buffer_;
+
+    void SanityCheck() const;
+
+  public:
+    explicit PreallocatedMemoryBuffer64(size_t size);
+
+    virtual void MoveToString(std::string& target) ORTHANC_OVERRIDE;
+
+    virtual const void* GetData() const ORTHANC_OVERRIDE;
+
+    virtual size_t GetSize() const ORTHANC_OVERRIDE;
+
+    // The plugin must only write into the buffer, it must never
+    // reallocate nor free it
+    OrthancPluginMemoryBuffer64* GetObject()
+    {
+      return &buffer_;
+    }
+  };
 }
@@ -0,0 +1,150 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../../Sources/PrecompiledHeadersServer.h"
+#include "PluginsCallbacksMetrics.h"
+
+#include "PluginsManager.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+
+namespace Orthanc
+{
+  // Upper bounds of the buckets of the histograms, in milliseconds
+  static const size_t  BUCKETS_COUNT = 14;
+  static const double  BUCKETS[BUCKETS_COUNT] = {
+    1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000
+  };
+
+
+  void PluginsCallbacksMetrics::Timer::Start()
+  {
+    active_ = that_.IsEnabled();
+
+    if (active_)
+    {
+      start_ = boost::posix_time::microsec_clock::universal_time();
+    }
+
+    if (Tracing::IsEnabled())
+    {
+      span_.reset(new Tracing::Span(std::string("plugin.") + kind_, Tracing::SpanKind_Internal));
+
+      if (span_->IsRecording())
+      {
+        span_->SetAttribute("orthanc.plugin", that_.GetOwner(callback_));
+      }
+    }
+  }
+
+
+  PluginsCallbacksMetrics::Timer::~Timer()
+  {
+    if (span_.get() != NULL &&
+        !success_)
+    {
+      span_->SetError("The callback of the plugin has failed");
+    }
+
+    if (active_)
+    {
+      boost::posix_time::time_duration diff = boost::posix_time::microsec_clock::universal_time() - start_;
+      that_.AddInvocation(callback_, kind_, success_, static_cast<double>(diff.total_microseconds()) / 1000.0);
+    }
+  }
+
+
+  void PluginsCallbacksMetrics::RegisterOwnerInternal(AnyCallback callback,
+                                                      SharedLibrary& plugin)
+  {
+    const std::string name = PluginsManager::GetPluginName(plugin);
+
+    boost::unique_lock<boost::shared_mutex> lock(ownersMutex_);
+    owners_[callback] = name;
+  }
+
+
+  std::string PluginsCallbacksMetrics::GetOwner(AnyCallback callback)
+  {
+    boost::shared_lock<boost::shared_mutex> lock(ownersMutex_);
+
+    Owners::const_iterator found = owners_.find(callback);
+    if (found == owners_.end())
+    {
+      return "unknown";
+    }
+    else
+    {
+      return found->second;
+    }
+  }
+
+
+  bool PluginsCallbacksMetrics::IsEnabled()
+  {
+    boost::mutex::scoped_lock lock(registryMutex_);
+    return (registry_ != NULL &&
+            registry_->IsEnabled());
+  }
+
+
+  void PluginsCallbacksMetrics::AddInvocation(AnyCallback callback,
+                                              const char* kind,
+                                              bool success,
+                                              double milliseconds)
+  {
+    const std::string labels = (MetricsRegistry::FormatPrometheusLabel("plugin", GetOwner(callback)) + "," +
+                                MetricsRegistry::FormatPrometheusLabel("callback", kind));
+
+    boost::mutex::scoped_lock lock(registryMutex_);
+
+    if (registry_ != NULL &&
+        registry_->IsEnabled())
+    {
+      registry_->IncrementIntegerValue("orthanc_plugins_callbacks_total{" + labels + "}", 1);
+
+      if (!success)
+      {
+        registry_->IncrementIntegerValue("orthanc_plugins_callbacks_errors_total{" + labels + "}", 1);
+      }
+
+      registry_->AddHistogramSample("orthanc_plugins_callbacks_duration_ms", labels, BUCKETS, BUCKETS_COUNT, milliseconds);
+    }
+  }
+
+
+  void PluginsCallbacksMetrics::SetRegistry(MetricsRegistry& registry)
+  {
+    boost::mutex::scoped_lock lock(registryMutex_);
+    registry_ = &registry;
+  }
+
+
+  void PluginsCallbacksMetrics::ResetRegistry()
+  {
+    boost::mutex::scoped_lock lock(registryMutex_);
+    registry_ = NULL;
+  }
+}
@@ -0,0 +1,143 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#if ORTHANC_ENABLE_PLUGINS != 1
+#  error The plugin support is disabled
+#endif
+
+#include "../../../OrthancFramework/Sources/MetricsRegistry.h"
+#include "../../../OrthancFramework/Sources/RequestTimings.h"
+#include "../../../OrthancFramework/Sources/SharedLibrary.h"
+#include "../../../OrthancFramework/Sources/Tracing.h"
+#include "../Include/orthanc/OrthancCPlugin.h"
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <map>
+
+namespace Orthanc
+{
+  /**
+   * Metrics about the invocations of the callbacks of the plugins,
+   * labeled by the name of the plugin that registered the callback
+   * and by the kind of callback ("rest", "filter", "storage"...):
+   * number of calls, number of errors, and histogram of the
+   * durations (in milliseconds). The callbacks are identified by
+   * their address, and their owner is recorded at registration.
+   * If tracing is enabled, each invocation is also a span. The time
+   * spent in the callbacks is also part of the accounting of the
+   * request that is being served, if any.
+   **/
+  class PluginsCallbacksMetrics : public boost::noncopyable
+  {
+  public:
+    typedef void (*AnyCallback) ();
+
+    class Timer : public boost::noncopyable
+    {
+    private:
+      PluginsCallbacksMetrics&        that_;
+      AnyCallback                     callback_;
+      const char*                     kind_;
+      bool                            active_;
+      bool                            success_;
+      boost::posix_time::ptime        start_;
+      std::unique_ptr<Tracing::Span>  span_;
+      RequestTimings::Timer           timings_;
+
+      void Start();
+
+    public:
+      // The "kind" must be a string literal
+      template <typename Callback>
+      Timer(PluginsCallbacksMetrics& that,
+            Callback callback,
+            const char* kind) :
+        that_(that),
+        callback_(reinterpret_cast<AnyCallback>(callback)),
+        kind_(kind),
+        success_(false),
+        timings_(RequestTimings::Category_Plugins)
+      {
+        Start();
+      }
+
+      ~Timer();
+
+      // If not called, the invocation is counted as an error (which
+      // is notably the case if an exception is thrown)
+      void SetSuccess()
+      {
+        success_ = true;
+      }
+
+      void SetResult(OrthancPluginErrorCode code)
+      {
+        success_ = (code == OrthancPluginErrorCode_Success);
+      }
+    };
+
+  private:
+    typedef std::map<AnyCallback, std::string>  Owners;
+
+    boost::mutex         registryMutex_;
+    MetricsRegistry*     registry_;
+    boost::shared_mutex  ownersMutex_;
+    Owners               owners_;
+
+    void RegisterOwnerInternal(AnyCallback callback,
+                               SharedLibrary& plugin);
+
+    std::string GetOwner(AnyCallback callback);
+
+    bool IsEnabled();
+
+    void AddInvocation(AnyCallback callback,
+                       const char* kind,
+                       bool success,
+                       double milliseconds);
+
+  public:
+    PluginsCallbacksMetrics() :
+      registry_(NULL)
+    {
+    }
+
+    void SetRegistry(MetricsRegistry& registry);
+
+    void ResetRegistry();
+
+    template <typename Callback>
+    void RegisterOwner(Callback callback,
+                       SharedLibrary& plugin)
+    {
+      if (callback != NULL)
+      {
+        RegisterOwnerInternal(reinterpret_cast<AnyCallback>(callback), plugin);
+      }
+    }
+  };
+}
@@ -702,6 +702,12 @@ namespace Orthanc
         case CompressionType_ZlibWithSize:
           return OrthancPluginCompressionType_ZlibWithSize;
 
+        case CompressionType_ZstdWithSize:
+          return OrthancPluginCompressionType_ZstdWithSize;
+
+        case CompressionType_Lz4WithSize:
+          return OrthancPluginCompressionType_Lz4WithSize;
+
         default:
           throw OrthancException(ErrorCode_ParameterOutOfRange);
       }
@@ -717,6 +723,12 @@ namespace Orthanc
         case OrthancPluginCompressionType_ZlibWithSize:
           return CompressionType_ZlibWithSize;
 
+        case OrthancPluginCompressionType_ZstdWithSize:
+          return CompressionType_ZstdWithSize;
+
+        case OrthancPluginCompressionType_Lz4WithSize:
+          return CompressionType_Lz4WithSize;
+
         default:
           throw OrthancException(ErrorCode_ParameterOutOfRange);
       }
@@ -0,0 +1,333 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../../Sources/PrecompiledHeadersServer.h"
+#include "PluginsParallelJob.h"
+
+#if ORTHANC_ENABLE_PLUGINS != 1
+#error The plugin support is disabled
+#endif
+
+
+#include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/IRunnable.h"
+#include "PluginMemoryBuffer32.h"
+
+#include <cassert>
+
+namespace Orthanc
+{
+  class PluginsParallelJob::ItemTask : public IRunnable
+  {
+  private:
+    PluginsParallelJob&  that_;
+    uint32_t             item_;
+
+  public:
+    ItemTask(PluginsParallelJob& that,
+             uint32_t item) :
+      that_(that),
+      item_(item)
+    {
+    }
+
+    virtual void Run() ORTHANC_OVERRIDE
+    {
+      that_.ProcessItem(item_);
+    }
+  };
+
+
+  void PluginsParallelJob::ProcessItem(uint32_t item)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (stopRequested_)
+      {
+        return;
+      }
+    }
+
+    OrthancPluginErrorCode code;
+
+    try
+    {
+      code = parameters_.processItem(parameters_.job, item);
+    }
+    catch (...)
+    {
+      LOG(ERROR) << "Native exception while processing an item of a parallel job from a plugin";
+      code = OrthancPluginErrorCode_Plugin;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (code == OrthancPluginErrorCode_Success)
+    {
+      assert(item < processed_.size());
+      if (!processed_[item])
+      {
+        processed_[item] = true;
+        countProcessed_++;
+      }
+    }
+    else
+    {
+      if (error_ == OrthancPluginErrorCode_Success)
+      {
+        LOG(ERROR) << "Error while processing item " << item << " of a parallel job of type \""
+                   << type_ << "\": " << EnumerationToString(static_cast<ErrorCode>(code));
+        error_ = code;
+      }
+
+      // Discard the items that have not started yet
+      stopRequested_ = true;
+
+      if (items_.get() != NULL)
+      {
+        items_->Cancel();
+      }
+    }
+  }
+
+
+  void PluginsParallelJob::SubmitPendingItems()
+  {
+    assert(items_.get() == NULL);
+
+    std::unique_ptr<JobTasksExecutor::Group> items(new JobTasksExecutor::Group(executor_, parameters_.maxParallelism));
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stopRequested_ = false;
+      items_.reset(items.release());
+
+      for (uint32_t i = 0; i < parameters_.countItems; i++)
+      {
+        if (!processed_[i])
+        {
+          items_->Submit(new ItemTask(*this, i));
+        }
+      }
+    }
+  }
+
+
+  void PluginsParallelJob::CancelItems()
+  {
+    std::unique_ptr<JobTasksExecutor::Group> items;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stopRequested_ = true;
+
+      if (items_.get() != NULL)
+      {
+        items_->Cancel();
+        items.reset(items_.release());
+      }
+    }
+
+    // The destructor of the group waits for the running items, which
+    // must be done without locking "mutex_"
+    items.reset();
+  }
+
+
+  PluginsParallelJob::PluginsParallelJob(const _OrthancPluginCreateParallelJob& parameters,
+                                         JobTasksExecutor& executor) :
+    parameters_(parameters),
+    executor_(executor),
+    countProcessed_(0),
+    error_(OrthancPluginErrorCode_Success),
+    stopRequested_(false)
+  {
+    if (parameters_.job == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    if (parameters_.target == NULL ||
+        parameters_.finalize == NULL ||
+        parameters_.type == NULL ||
+        parameters_.processItem == NULL)
+    {
+      if (parameters_.finalize != NULL)
+      {
+        parameters_.finalize(parameters_.job);
+      }
+
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    type_.assign(parameters_.type);
+    processed_.resize(parameters_.countItems, false);
+  }
+
+
+  PluginsParallelJob::~PluginsParallelJob()
+  {
+    CancelItems();
+
+    assert(parameters_.job != NULL);
+    parameters_.finalize(parameters_.job);
+  }
+
+
+  JobStepResult PluginsParallelJob::Step(const std::string& jobId)
+  {
+    if (items_.get() == NULL)
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (error_ != OrthancPluginErrorCode_Success)
+        {
+          return JobStepResult::Failure(static_cast<ErrorCode>(error_), NULL);
+        }
+        else if (countProcessed_ == parameters_.countItems)
+        {
+          return JobStepResult::Success();
+        }
+      }
+
+      SubmitPendingItems();
+      return JobStepResult::Continue();
+    }
+
+    // Help processing the items, and regularly give the hand back to
+    // the jobs engine to handle pause/cancel
+    if (!items_->Wait(100))
+    {
+      return JobStepResult::Continue();
+    }
+
+    CancelItems();
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (error_ != OrthancPluginErrorCode_Success)
+    {
+      return JobStepResult::Failure(static_cast<ErrorCode>(error_), NULL);
+    }
+    else if (countProcessed_ == parameters_.countItems)
+    {
+      return JobStepResult::Success();
+    }
+    else
+    {
+      return JobStepResult::Continue();
+    }
+  }
+
+
+  void PluginsParallelJob::Reset()
+  {
+    CancelItems();
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      std::fill(processed_.begin(), processed_.end(), false);
+      countProcessed_ = 0;
+      error_ = OrthancPluginErrorCode_Success;
+    }
+
+    if (parameters_.reset != NULL)
+    {
+      parameters_.reset(parameters_.job);
+    }
+  }
+
+
+  void PluginsParallelJob::Stop(JobStopReason reason)
+  {
+    // If paused, the processed items are kept, and the pending items
+    // are submitted again by the next call to "Step()"
+    CancelItems();
+
+    if (parameters_.stop != NULL)
+    {
+      switch (reason)
+      {
+        case JobStopReason_Success:
+          parameters_.stop(parameters_.job, OrthancPluginJobStopReason_Success);
+          break;
+
+        case JobStopReason_Failure:
+        case JobStopReason_Retry:
+          parameters_.stop(parameters_.job, OrthancPluginJobStopReason_Failure);
+          break;
+
+        case JobStopReason_Canceled:
+          parameters_.stop(parameters_.job, OrthancPluginJobStopReason_Canceled);
+          break;
+
+        case JobStopReason_Paused:
+          parameters_.stop(parameters_.job, OrthancPluginJobStopReason_Paused);
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+    }
+  }
+
+
+  float PluginsParallelJob::GetProgress() const
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (parameters_.countItems == 0)
+    {
+      return 1.0f;
+    }
+    else
+    {
+      return (static_cast<float>(countProcessed_) /
+              static_cast<float>(parameters_.countItems));
+    }
+  }
+
+
+  void PluginsParallelJob::GetPublicContent(Json::Value& value) const
+  {
+    if (parameters_.getContent != NULL)
+    {
+      PluginMemoryBuffer32 target;
+
+      OrthancPluginErrorCode code = parameters_.getContent(target.GetObject(), parameters_.job);
+
+      if (code != OrthancPluginErrorCode_Success)
+      {
+        throw OrthancException(static_cast<ErrorCode>(code));
+      }
+      else
+      {
+        target.ToJsonObject(value);
+      }
+    }
+    else
+    {
+      value = Json::objectValue;
+    }
+  }
+}
@@ -0,0 +1,134 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+#pragma once
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+
+#include "../../../OrthancFramework/Sources/Compatibility.h"  // For ORTHANC_OVERRIDE
+#include "../../../OrthancFramework/Sources/OrthancException.h"
+#include "../../../OrthancFramework/Sources/JobsEngine/IJob.h"
+#include "../../../OrthancFramework/Sources/JobsEngine/JobTasksExecutor.h"
+#include "../Include/orthanc/OrthancCPlugin.h"
+
+#include <boost/thread/mutex.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Job created by "OrthancPluginCreateParallelJob()", whose work
+   * items are independent. The items are submitted as sub-tasks to
+   * the executor that is shared by all the jobs, in the same way as
+   * "ThreadedSetOfInstancesJob" (new in Orthanc 1.12.12).
+   **/
+  class PluginsParallelJob : public IJob
+  {
+  private:
+    class ItemTask;
+
+    _OrthancPluginCreateParallelJob  parameters_;
+    std::string                      type_;
+    JobTasksExecutor&                executor_;
+
+    // Only accessed by the thread of the jobs engine that runs the job
+    std::unique_ptr<JobTasksExecutor::Group>  items_;
+
+    mutable boost::mutex       mutex_;
+    std::vector<bool>          processed_;        // Protected by "mutex_"
+    uint32_t                   countProcessed_;   // Protected by "mutex_"
+    OrthancPluginErrorCode     error_;            // Protected by "mutex_"
+    bool                       stopRequested_;    // Protected by "mutex_"
+
+    void ProcessItem(uint32_t item);
+
+    void SubmitPendingItems();
+
+    void CancelItems();
+
+  public:
+    PluginsParallelJob(const _OrthancPluginCreateParallelJob& parameters,
+                       JobTasksExecutor& executor);
+
+    virtual ~PluginsParallelJob() ORTHANC_OVERRIDE;
+
+    virtual void Start() ORTHANC_OVERRIDE
+    {
+    }
+
+    virtual JobStepResult Step(const std::string& jobId) ORTHANC_OVERRIDE;
+
+    virtual void Reset() ORTHANC_OVERRIDE;
+
+    virtual void Stop(JobStopReason reason) ORTHANC_OVERRIDE;
+
+    virtual float GetProgress() const ORTHANC_OVERRIDE;
+
+    // The progress is updated by the threads that process the items
+    virtual bool NeedsProgressUpdateBetweenSteps() const ORTHANC_OVERRIDE
+    {
+      return true;
+    }
+
+    virtual void GetJobType(std::string& target) const ORTHANC_OVERRIDE
+    {
+      target = type_;
+    }
+
+    virtual void GetPublicContent(Json::Value& value) const ORTHANC_OVERRIDE;
+
+    virtual bool Serialize(Json::Value& value) const ORTHANC_OVERRIDE
+    {
+      return false;
+    }
+
+    virtual bool GetOutput(std::string& output,
+                           MimeType& mime,
+                           std::string& filename,
+                           const std::string& key) ORTHANC_OVERRIDE
+    {
+      return false;
+    }
+
+    virtual bool DeleteOutput(const std::string& key) ORTHANC_OVERRIDE
+    {
+      return false;
+    }
+
+    virtual void SetUserData(const Json::Value& userData) ORTHANC_OVERRIDE
+    {
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_NotImplemented);
+    }
+
+    virtual bool GetUserData(Json::Value& userData) const ORTHANC_OVERRIDE
+    {
+      return false;
+    }
+
+    virtual void LookupErrorPayload(ErrorPayload& payload) const ORTHANC_OVERRIDE
+    {
+    }
+  };
+}
+
+#endif
@@ -49,7 +49,20 @@
  * guaranteed to be executed in mutual exclusion since Orthanc
  * 0.8.5. If this feature is undesired (notably when developing
  * high-performance plugins handling simultaneous requests), use
- * ::OrthancPluginRegisterRestCallbackNoLock().
+ * ::OrthancPluginRegisterRestCallbackNoLock() or
+ * ::OrthancPluginRegisterRestCallback2().
+ *
+ * The functions of the SDK that answer REST requests (group "REST"),
+ * that access the content of Orthanc (groups "Orthanc",
+ * "DicomInstance", "Images"...), or that manipulate memory buffers
+ * can be called concurrently from several threads. On the contrary,
+ * the functions that register callbacks, that register custom error
+ * codes or dictionary tags, that set the plugin properties, or that
+ * answer database requests modify the global state of the plugin
+ * engine, and are executed behind a global mutex. They are only
+ * meant to be called from OrthancPluginInitialize(). Since Orthanc
+ * 1.12.12, Orthanc refuses to execute them from within the REST
+ * callbacks that are registered by OrthancPluginRegisterRestCallback2().
  **/
 
 
@@ -529,6 +542,9 @@ extern "C"
     _OrthancPluginService_ReserveQueueValue = 62,                   /* New in Orthanc 1.12.10 */
     _OrthancPluginService_AcknowledgeQueueValue = 63,               /* New in Orthanc 1.12.10 */
     _OrthancPluginService_ClearCurrentThreadName = 64,              /* New in Orthanc 1.12.12 */
+    _OrthancPluginService_UpdateKeysValues = 65,                    /* New in Orthanc 1.12.12 */
+    _OrthancPluginService_GetKeysValues = 66,                       /* New in Orthanc 1.12.12 */
+    _OrthancPluginService_SetKeyValueStoreCacheSize = 67,           /* New in Orthanc 1.12.12 */
 
     /* Registration of callbacks */
     _OrthancPluginService_RegisterRestCallback = 1000,
@@ -558,6 +574,13 @@ extern "C"
     _OrthancPluginService_RegisterMoveCallback2 = 1024,        /* New in Orthanc 1.12.10 */
     _OrthancPluginService_RegisterWorklistCallback2 = 1025,    /* New in Orthanc 1.12.10 */
     _OrthancPluginService_RegisterStorageCommitmentScpCallback2 = 1026, /* New in Orthanc 1.12.10 */
+    _OrthancPluginService_RegisterBatchTranscoderCallback = 1027,  /* New in Orthanc 1.12.12 */
+    _OrthancPluginService_RegisterStorageAreaStreaming = 1028,  /* New in Orthanc 1.12.12 */
+    _OrthancPluginService_RegisterOnChangeCallback2 = 1029,  /* New in Orthanc 1.12.12 */
+    _OrthancPluginService_RegisterChangesBatchCallback = 1030,  /* New in Orthanc 1.12.12 */
+    _OrthancPluginService_RegisterDecodeFramesCallback = 1031,  /* New in Orthanc 1.12.12 */
+    _OrthancPluginService_RegisterRestCallback2 = 1032,  /* New in Orthanc 1.12.12 */
+    _OrthancPluginService_RegisterCoalescedChangeCallback = 1033,  /* New in Orthanc 1.12.12 */
 
     /* Sending answers to REST calls */
     _OrthancPluginService_AnswerBuffer = 2000,
@@ -576,6 +599,7 @@ extern "C"
     _OrthancPluginService_SetHttpErrorDetails = 2013,
     _OrthancPluginService_StartStreamAnswer = 2014,
     _OrthancPluginService_SendStreamChunk = 2015,
+    _OrthancPluginService_StartStreamAnswer2 = 2016,  /* New in Orthanc 1.12.12 */
 
     /* Access to the Orthanc database and API */
     _OrthancPluginService_GetDicomForInstance = 3000,
@@ -595,6 +619,8 @@ extern "C"
     _OrthancPluginService_ReconstructMainDicomTags = 3014,
     _OrthancPluginService_RestApiGet2 = 3015,
     _OrthancPluginService_CallRestApi = 3016,              /* New in Orthanc 1.9.2 */
+    _OrthancPluginService_GetDicomHeaderForInstance = 3017,  /* New in Orthanc 1.12.12 */
+    _OrthancPluginService_GetInstanceTags = 3018,            /* New in Orthanc 1.12.12 */
 
     /* Access to DICOM instances */
     _OrthancPluginService_GetInstanceRemoteAet = 4000,
@@ -676,6 +702,7 @@ extern "C"
     _OrthancPluginService_SubmitJob = 9002,
     _OrthancPluginService_RegisterJobsUnserializer = 9003,
     _OrthancPluginService_CreateJob2 = 9004,  /* New in SDK 1.11.3 */
+    _OrthancPluginService_CreateParallelJob = 9005,  /* New in SDK 1.12.12 */
 
     /* Access to DICOM connection */
     _OrthancPluginService_GetConnectionRemoteAet = 10000,  /* New in SDK 1.12.10 */
@@ -863,6 +890,8 @@ extern "C"
     OrthancPluginCompressionType_Gzip = 2,          /*!< Standard gzip compression */
     OrthancPluginCompressionType_GzipWithSize = 3,  /*!< gzip, prefixed with uncompressed size (uint64_t) */
     OrthancPluginCompressionType_None ORTHANC_PLUGIN_SINCE_SDK("1.12.8") = 4,  /*!< No compression (new in Orthanc 1.12.8) */
+    OrthancPluginCompressionType_ZstdWithSize ORTHANC_PLUGIN_SINCE_SDK("1.12.12") = 5,  /*!< zstd, prefixed with uncompressed size (uint64_t), only available if Orthanc is built with zstd support (new in Orthanc 1.12.12) */
+    OrthancPluginCompressionType_Lz4WithSize ORTHANC_PLUGIN_SINCE_SDK("1.12.12") = 6,   /*!< LZ4, prefixed with uncompressed size (uint64_t), only available if Orthanc is built with LZ4 support (new in Orthanc 1.12.12) */
 
     _OrthancPluginCompressionType_INTERNAL = 0x7fffffff
   } OrthancPluginCompressionType;
@@ -1263,6 +1292,21 @@ extern "C"
   } OrthancPluginHttpAuthenticationStatus;
 
 
+  /**
+   * The ordering guarantee of the changes that are signaled to an
+   * asynchronous OnChange callback.
+   * @see OrthancPluginRegisterOnChangeCallback2()
+   **/
+  typedef enum ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  {
+    OrthancPluginChangeOrdering_None = 0,      /*!< No ordering, the changes are spread over all the threads */
+    OrthancPluginChangeOrdering_Resource = 1,  /*!< The changes about one resource are signaled in order */
+    OrthancPluginChangeOrdering_Study = 2,     /*!< The changes about one study and its child resources are signaled in order */
+
+    _OrthancPluginChangeOrdering_INTERNAL = 0x7fffffff
+  } OrthancPluginChangeOrdering;
+
+
   /**
    * @brief A 32-bit memory buffer allocated by the core system of Orthanc.
    *
@@ -1450,6 +1494,51 @@ extern "C"
 
 
 
+  /**
+   * @brief One entry of the changes log, as provided to a batched callback.
+   * @see OrthancPluginRegisterChangesBatchCallback()
+   * @ingroup Callbacks
+   **/
+  typedef struct
+  {
+    int64_t                    seq;           /*!< Sequence number of the change in the log */
+    OrthancPluginChangeType    changeType;    /*!< Type of the change */
+    OrthancPluginResourceType  resourceType;  /*!< Level of the resource */
+    const char*                resourceId;    /*!< Orthanc identifier of the resource */
+    const char*                date;          /*!< Date of the change, in the ISO format */
+  } OrthancPluginChangeEntry;
+
+
+
+  /**
+   * @brief Signature of a callback function that receives a batch of entries of the changes log.
+   * @ingroup Callbacks
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginChangesBatchCallback) (
+    const OrthancPluginChangeEntry* changes,
+    uint32_t count);
+
+
+
+  /**
+   * @brief Signature of a callback function that is notified of the coalesced changes of a resource.
+   *
+   * @param resourceType The level of the resource.
+   * @param resourceId The Orthanc identifier of the resource.
+   * @param lastChangeType The type of the most recent change in the window.
+   * @param countChanges The number of changes that were coalesced into this notification.
+   * @return 0 if success, other value if error.
+   * @see OrthancPluginRegisterCoalescedChangeCallback()
+   * @ingroup Callbacks
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginCoalescedChangeCallback) (
+    OrthancPluginResourceType resourceType,
+    const char* resourceId,
+    OrthancPluginChangeType lastChangeType,
+    uint32_t countChanges);
+
+
+
   /**
    * @brief Signature of a callback function to decode a DICOM instance as an image.
    * @ingroup Callbacks
@@ -1462,6 +1551,23 @@ extern "C"
 
 
 
+  /**
+   * @brief Signature of a callback function to decode a batch of compressed frames of a DICOM instance.
+   * @see OrthancPluginRegisterDecodeFramesCallback()
+   * @ingroup Callbacks
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginDecodeFramesCallback) (
+    OrthancPluginImage**  target,
+    const void*           header,
+    uint64_t              headerSize,
+    const char*           transferSyntax,
+    uint32_t              countFrames,
+    const uint32_t*       frameIndexes,
+    const void* const*    frames,
+    const uint64_t*       framesSizes);
+
+
+
   /**
    * @brief Signature of a function to free dynamic memory.
    * @ingroup Callbacks
@@ -2114,6 +2220,24 @@ extern "C"
   typedef OrthancPluginErrorCode (*OrthancPluginJobReset) (void* job);
 
 
+  /**
+   * @brief Callback to process one work item of a parallel job.
+   *
+   * Signature of a callback function that processes one of the
+   * independent work items of a job that was created by
+   * OrthancPluginCreateParallelJob(). This callback is invoked
+   * concurrently from several threads, on different items: It must
+   * be thread-safe.
+   *
+   * @param job The job of interest.
+   * @param item The index of the work item, between 0 and "countItems - 1".
+   * @return 0 if success, or the error code if failure.
+   * @ingroup Toolbox
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginJobProcessItem) (void* job,
+                                                                 uint32_t item);
+
+
   /**
    * @brief Callback executed to unserialize a custom job.
    * 
@@ -2332,7 +2456,8 @@ extern "C"
         sizeof(int32_t) != sizeof(OrthancPluginStoreStatus) ||
         sizeof(int32_t) != sizeof(OrthancPluginQueueOrigin) ||
         sizeof(int32_t) != sizeof(OrthancPluginStableStatus) ||
-        sizeof(int32_t) != sizeof(OrthancPluginHttpAuthenticationStatus))
+        sizeof(int32_t) != sizeof(OrthancPluginHttpAuthenticationStatus) ||
+        sizeof(int32_t) != sizeof(OrthancPluginChangeOrdering))
     {
       /* Mismatch in the size of the enumerations */
       return 0;
@@ -2729,7 +2854,10 @@ extern "C"
    * @brief Retrieve a DICOM instance using its Orthanc identifier.
    * 
    * Retrieve a DICOM instance using its Orthanc identifier. The DICOM
-   * file is stored into a newly allocated memory buffer.
+   * file is stored into a newly allocated memory buffer. The file is
+   * read through the storage cache of the Orthanc core. Use
+   * OrthancPluginGetDicomHeaderForInstance() if the pixel data is
+   * not needed.
    * 
    * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
    * @param target The target memory buffer. It must be freed with OrthancPluginFreeMemoryBuffer().
@@ -10092,7 +10220,8 @@ extern "C"
    * @brief Send a chunk as a part of an HTTP stream answer.
    *
    * This function sends a chunk as part of an HTTP stream
-   * answer that was initiated by OrthancPluginStartStreamAnswer().
+   * answer that was initiated by OrthancPluginStartStreamAnswer() or
+   * OrthancPluginStartStreamAnswer2().
    * 
    * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
    * @param output The HTTP connection to the client application.
@@ -10360,6 +10489,145 @@ extern "C"
   }
 
 
+  typedef struct
+  {
+    const char*                   storeId;
+    uint32_t                      storedCount;
+    const char* const*            storedKeys;
+    const void* const*            storedValues;
+    const uint32_t*               storedValuesSizes;
+    uint32_t                      deletedCount;
+    const char* const*            deletedKeys;
+  } _OrthancPluginUpdateKeysValues;
+
+  /**
+   * @brief Store and delete several key-value pairs at once.
+   *
+   * This function stores and deletes several key-value pairs of one
+   * key-value store within one single transaction of the Orthanc
+   * database, which is much faster than successive calls to
+   * OrthancPluginStoreKeyValue() and OrthancPluginDeleteKeyValue().
+   * Either all the changes are applied, or none of them.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param storeId A unique identifier identifying both the plugin and the key-value store.
+   * @param storedCount The number of key-value pairs to store.
+   * @param storedKeys A C array of "storedCount" keys to store.
+   * @param storedValues A C array of "storedCount" values to store.
+   * @param storedValuesSizes A C array of "storedCount" lengths of the values.
+   * @param deletedCount The number of keys to delete.
+   * @param deletedKeys A C array of "deletedCount" keys to delete.
+   * @return 0 if success, other value if error.
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginUpdateKeysValues(
+    OrthancPluginContext*         context,
+    const char*                   storeId,            /* in */
+    uint32_t                      storedCount,        /* in */
+    const char* const*            storedKeys,         /* in */
+    const void* const*            storedValues,       /* in */
+    const uint32_t*               storedValuesSizes,  /* in */
+    uint32_t                      deletedCount,       /* in */
+    const char* const*            deletedKeys         /* in */)
+  {
+    _OrthancPluginUpdateKeysValues params;
+    params.storeId = storeId;
+    params.storedCount = storedCount;
+    params.storedKeys = storedKeys;
+    params.storedValues = storedValues;
+    params.storedValuesSizes = storedValuesSizes;
+    params.deletedCount = deletedCount;
+    params.deletedKeys = deletedKeys;
+
+    return context->InvokeService(context, _OrthancPluginService_UpdateKeysValues, &params);
+  }
+
+
+  typedef struct
+  {
+    uint8_t*                      found;
+    OrthancPluginMemoryBuffer*    values;
+    const char*                   storeId;
+    uint32_t                      count;
+    const char* const*            keys;
+  } _OrthancPluginGetKeysValues;
+
+  /**
+   * @brief Get the values associated with several keys of a key-value store.
+   *
+   * This function reads several keys of one key-value store within
+   * one single transaction of the Orthanc database.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param found A C array of "count" Booleans. Each of them is set to "true"
+   * iff. the key with the same index exists in the key-value store.
+   * @param values A C array of "count" memory buffers, where to store the
+   * retrieved values. The buffers whose key is found must be freed
+   * by the plugin by calling OrthancPluginFreeMemoryBuffer().
+   * @param storeId A unique identifier identifying both the plugin and the key-value store.
+   * @param count The number of keys to retrieve.
+   * @param keys A C array of "count" keys to retrieve.
+   * @return 0 if success, other value if error.
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginGetKeysValues(
+    OrthancPluginContext*         context,
+    uint8_t*                      found,    /* out */
+    OrthancPluginMemoryBuffer*    values,   /* out */
+    const char*                   storeId,  /* in */
+    uint32_t                      count,    /* in */
+    const char* const*            keys      /* in */)
+  {
+    _OrthancPluginGetKeysValues params;
+    params.found = found;
+    params.values = values;
+    params.storeId = storeId;
+    params.count = count;
+    params.keys = keys;
+
+    return context->InvokeService(context, _OrthancPluginService_GetKeysValues, &params);
+  }
+
+
+  typedef struct
+  {
+    const char*                   storeId;
+    uint64_t                      maximumSize;
+  } _OrthancPluginSetKeyValueStoreCacheSize;
+
+  /**
+   * @brief Enable a cache in memory for the values of a key-value store.
+   *
+   * This function enables a write-through cache in the memory of the
+   * Orthanc server for the values of one key-value store, which
+   * avoids accessing the database when reading the values that were
+   * recently read or written. The least recently used values are
+   * evicted once the total size of the cached keys and values
+   * exceeds "maximumSize".
+   *
+   * WARNING: The cache is local to this Orthanc server. It must only
+   * be enabled on stores that are not written by other Orthanc
+   * servers connected to the same database.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param storeId A unique identifier identifying both the plugin and the key-value store.
+   * @param maximumSize The maximum size of the cache, in bytes. "0" disables the cache.
+   * @return 0 if success, other value if error.
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginSetKeyValueStoreCacheSize(
+    OrthancPluginContext*         context,
+    const char*                   storeId,     /* in */
+    uint64_t                      maximumSize  /* in */)
+  {
+    _OrthancPluginSetKeyValueStoreCacheSize params;
+    params.storeId = storeId;
+    params.maximumSize = maximumSize;
+
+    return context->InvokeService(context, _OrthancPluginService_SetKeyValueStoreCacheSize, &params);
+  }
+
+
   /**
    * @brief Opaque structure that represents an iterator over the keys and values of
    * a key-value store.
@@ -11216,6 +11484,772 @@ extern "C"
     return context->InvokeService(context, _OrthancPluginService_ClearCurrentThreadName, NULL);
   }
 
+
+
+  /**
+   * @brief Signature of a callback function to transcode a batch of DICOM instances.
+   *
+   * This callback receives several DICOM instances at once, which
+   * allows hardware-accelerated transcoders to amortize their setup
+   * and to keep their device busy. The instances of the batch are
+   * independent from each other.
+   *
+   * @param transcoded Array of "count" target memory buffers. Each
+   * successfully transcoded instance must be stored in the buffer with
+   * the same index, that must be allocated by the plugin using
+   * OrthancPluginCreateMemoryBuffer(). The buffers are initially empty.
+   * @param success Array of "count" flags. The plugin must set the flag
+   * with the same index to a non-zero value for each instance that it
+   * has successfully transcoded. The flags are initially zero.
+   * @param count The number of DICOM instances in the batch.
+   * @param buffers A C array of "count" memory buffers containing the
+   * source DICOM instances.
+   * @param sizes A C array of "count" sizes of the source memory buffers.
+   * @param allowedSyntaxes A C array of possible transfer syntaxes UIDs for the
+   * result of the transcoding. The plugin must choose by itself the
+   * transfer syntax that will be used for each resulting DICOM image.
+   * @param countSyntaxes The number of transfer syntaxes that are contained
+   * in the "allowedSyntaxes" array.
+   * @param allowNewSopInstanceUid Whether the transcoding plugin can select
+   * a transfer syntax that will change the SOP instance UID (or, in other
+   * terms, whether the plugin can transcode using lossy compression).
+   * @return 0 if success (even if some instances could not be
+   * transcoded, as reported by "success"), or the error code if the
+   * whole batch has failed.
+   * @ingroup Callbacks
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginBatchTranscoderCallback) (
+    OrthancPluginMemoryBuffer* transcoded /* out */,
+    uint8_t*                   success /* out */,
+    uint32_t                   count,
+    const void* const*         buffers,
+    const uint64_t*            sizes,
+    const char* const*         allowedSyntaxes,
+    uint32_t                   countSyntaxes,
+    uint8_t                    allowNewSopInstanceUid);
+
+
+  typedef struct
+  {
+    OrthancPluginBatchTranscoderCallback callback;
+  } _OrthancPluginBatchTranscoderCallback;
+
+  /**
+   * @brief Register a callback to handle the transcoding of batches of DICOM images.
+   *
+   * This function registers a custom callback to transcode several
+   * DICOM images at once, extending the built-in transcoder of
+   * Orthanc that uses DCMTK. The batches are first submitted to these
+   * callbacks, then the remaining instances are submitted one by one
+   * to the callbacks registered by
+   * OrthancPluginRegisterTranscoderCallback(). Conversely, an
+   * individual instance that is not accepted by the latter callbacks
+   * is submitted to these callbacks as a batch of size 1. The exact
+   * behavior is affected by the configuration option
+   * "BuiltinDecoderTranscoderOrder" of Orthanc.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param callback The callback.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginRegisterBatchTranscoderCallback(
+    OrthancPluginContext*                 context,
+    OrthancPluginBatchTranscoderCallback  callback)
+  {
+    _OrthancPluginBatchTranscoderCallback params;
+    params.callback = callback;
+
+    return context->InvokeService(context, _OrthancPluginService_RegisterBatchTranscoderCallback, &params);
+  }
+
+
+
+  /**
+   * @brief Callback for starting a streamed write to the storage area.
+   *
+   * Signature of a callback function that is triggered when Orthanc
+   * starts writing a file to the storage area by chunks. The content
+   * of the file is subsequently provided by one or more calls to the
+   * OrthancPluginStorageWriteChunk() callback.
+   *
+   * @param writer The plugin-specific state of this write operation (out).
+   * @param uuid The UUID of the file.
+   * @param type The content type corresponding to this file.
+   * @param compressionType The compression algorithm that was used to encode the content.
+   * @param size The total size of the file (i.e. the sum of the sizes of the chunks).
+   * @param dicomInstance The DICOM instance being stored. Equals `NULL` if not storing a DICOM
+   * instance. It is only valid during the call to this callback.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginStorageStartWrite) (
+    void** writer,
+    const char* uuid,
+    OrthancPluginContentType type,
+    OrthancPluginCompressionType compressionType,
+    uint64_t size,
+    const OrthancPluginDicomInstance* dicomInstance);
+
+
+  /**
+   * @brief Callback for writing a chunk of a file to the storage area.
+   *
+   * @param writer The state of the write operation, as created by OrthancPluginStorageStartWrite().
+   * @param chunk The content of the chunk.
+   * @param size The size of the chunk.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginStorageWriteChunk) (
+    void* writer,
+    const void* chunk,
+    uint64_t size);
+
+
+  /**
+   * @brief Callback for committing a streamed write to the storage area.
+   *
+   * Signature of a callback function that is triggered once all the
+   * chunks of a file have been written. If this callback succeeds,
+   * the file must be durably stored.
+   *
+   * @param writer The state of the write operation, as created by OrthancPluginStorageStartWrite().
+   * @param customData Custom, plugin-specific data associated with the attachment (out),
+   * with the same semantics as in OrthancPluginStorageCreate2().
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginStorageCommitWrite) (
+    void* writer,
+    OrthancPluginMemoryBuffer* customData);
+
+
+  /**
+   * @brief Callback for releasing the state of a streamed write.
+   *
+   * This callback is invoked at the end of each write operation that
+   * was successfully started, whatever its outcome. If the write has
+   * not been committed, the plugin must discard the chunks that were
+   * already written.
+   *
+   * @param writer The state of the write operation, as created by OrthancPluginStorageStartWrite().
+   * @ingroup Callbacks
+   **/
+  typedef void (*OrthancPluginStorageFinalizeWrite) (
+    void* writer);
+
+
+  /**
+   * @brief Callback for starting a streamed read from the storage area.
+   *
+   * @param reader The plugin-specific state of this read operation (out).
+   * @param uuid The UUID of the file of interest.
+   * @param type The content type corresponding to this file.
+   * @param customData The custom data of the file of interest.
+   * @param customDataSize The size of the custom data.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginStorageStartRead) (
+    void** reader,
+    const char* uuid,
+    OrthancPluginContentType type,
+    const void* customData,
+    uint32_t customDataSize);
+
+
+  /**
+   * @brief Callback for reading the next chunk of a file from the storage area.
+   *
+   * @param readSize The number of bytes that were written into "target" (out).
+   * It must only be zero if the end of the file is reached.
+   * @param reader The state of the read operation, as created by OrthancPluginStorageStartRead().
+   * @param target The buffer where to store the chunk. It is allocated and freed by Orthanc.
+   * @param targetSize The size of the target buffer, i.e. the maximum size of the chunk.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginStorageReadChunk) (
+    uint64_t* readSize,
+    void* reader,
+    void* target,
+    uint64_t targetSize);
+
+
+  /**
+   * @brief Callback for releasing the state of a streamed read.
+   *
+   * @param reader The state of the read operation, as created by OrthancPluginStorageStartRead().
+   * @ingroup Callbacks
+   **/
+  typedef void (*OrthancPluginStorageFinalizeRead) (
+    void* reader);
+
+
+  typedef struct
+  {
+    OrthancPluginStorageStartWrite     startWrite;
+    OrthancPluginStorageWriteChunk     writeChunk;
+    OrthancPluginStorageCommitWrite    commitWrite;
+    OrthancPluginStorageFinalizeWrite  finalizeWrite;
+    OrthancPluginStorageStartRead      startRead;
+    OrthancPluginStorageReadChunk      readChunk;
+    OrthancPluginStorageFinalizeRead   finalizeRead;
+  } _OrthancPluginRegisterStorageAreaStreaming;
+
+  /**
+   * @brief Add streaming access to the custom storage area.
+   *
+   * This function complements the custom storage area that was
+   * registered by OrthancPluginRegisterStorageArea3() with callbacks
+   * that transfer the files by chunks, which allows for instance to
+   * use the multipart uploads and the streamed downloads of object
+   * stores. The large uncompressed files are then written and
+   * downloaded over HTTP without being entirely held in memory by the
+   * plugin. The callbacks of OrthancPluginRegisterStorageArea3() are
+   * still used for the small files and for the reads of ranges.
+   *
+   * This function must be called during the initialization of the
+   * plugin, after OrthancPluginRegisterStorageArea3().
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param startWrite The callback to start writing a file.
+   * @param writeChunk The callback to write one chunk of a file.
+   * @param commitWrite The callback to commit a file whose chunks were all written.
+   * @param finalizeWrite The callback to release the state of a write operation.
+   * @param startRead The callback to start reading a file.
+   * @param readChunk The callback to read the next chunk of a file.
+   * @param finalizeRead The callback to release the state of a read operation.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginRegisterStorageAreaStreaming(
+    OrthancPluginContext*              context,
+    OrthancPluginStorageStartWrite     startWrite,
+    OrthancPluginStorageWriteChunk     writeChunk,
+    OrthancPluginStorageCommitWrite    commitWrite,
+    OrthancPluginStorageFinalizeWrite  finalizeWrite,
+    OrthancPluginStorageStartRead      startRead,
+    OrthancPluginStorageReadChunk      readChunk,
+    OrthancPluginStorageFinalizeRead   finalizeRead)
+  {
+    _OrthancPluginRegisterStorageAreaStreaming params;
+    params.startWrite = startWrite;
+    params.writeChunk = writeChunk;
+    params.commitWrite = commitWrite;
+    params.finalizeWrite = finalizeWrite;
+    params.startRead = startRead;
+    params.readChunk = readChunk;
+    params.finalizeRead = finalizeRead;
+
+    return context->InvokeService(context, _OrthancPluginService_RegisterStorageAreaStreaming, &params);
+  }
+
+
+
+  typedef struct
+  {
+    OrthancPluginOnChangeCallback  callback;
+    uint32_t                       threadsCount;
+    uint32_t                       queueSize;
+    OrthancPluginChangeOrdering    ordering;
+  } _OrthancPluginOnChangeCallback2;
+
+  /**
+   * @brief Register a callback to monitor changes, in separate threads.
+   *
+   * This function registers a callback function that is called
+   * whenever a change happens to some DICOM resource. Contrarily to
+   * OrthancPluginRegisterOnChangeCallback(), the callback is not
+   * invoked by the thread of the Orthanc core that processes the
+   * changes, but by a pool of threads that is dedicated to this
+   * callback. Each of these threads has its own queue of pending
+   * changes, which prevents a slow callback from delaying the other
+   * plugins and the Lua scripts.
+   *
+   * The "ordering" argument specifies which changes are guaranteed to
+   * be signaled in the order they occurred: All the changes sharing
+   * the same resource (or the same parent study) are handled by the
+   * same thread. The behavior once a queue is full is set by the
+   * "PluginsChangesOverflowPolicy" configuration option: Either the
+   * core waits for room in the queue, or the change is discarded.
+   *
+   * As the callback is invoked from several threads, it must be
+   * thread-safe if "threadsCount" is above 1. The errors returned by
+   * the callback are logged, but they are not reported to the core.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param callback The callback function.
+   * @param threadsCount The number of threads invoking the callback.
+   * @param queueSize The maximum number of pending changes in the queue of each thread.
+   * @param ordering The ordering guarantee of the changes.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginRegisterOnChangeCallback2(
+    OrthancPluginContext*          context,
+    OrthancPluginOnChangeCallback  callback,
+    uint32_t                       threadsCount,
+    uint32_t                       queueSize,
+    OrthancPluginChangeOrdering    ordering)
+  {
+    _OrthancPluginOnChangeCallback2 params;
+    params.callback = callback;
+    params.threadsCount = threadsCount;
+    params.queueSize = queueSize;
+    params.ordering = ordering;
+
+    return context->InvokeService(context, _OrthancPluginService_RegisterOnChangeCallback2, &params);
+  }
+
+
+
+  typedef struct
+  {
+    OrthancPluginChangesBatchCallback  callback;
+    uint32_t                           maxBatchSize;
+    int64_t                            since;
+  } _OrthancPluginChangesBatchCallback;
+
+  /**
+   * @brief Register a callback that consumes the changes log by batches.
+   *
+   * This function registers a callback function that receives the
+   * entries of the changes log of Orthanc (the same entries as the
+   * "/changes" route of the REST API) by batches of at most
+   * "maxBatchSize" changes, sorted by increasing sequence number. The
+   * callback is invoked by a thread that is dedicated to it, as soon
+   * as new changes are committed to the database, which avoids any
+   * polling from the plugin.
+   *
+   * The log is read with cursor semantics: Orthanc remembers the
+   * sequence number of the last change of the last batch that was
+   * successfully processed. If the callback returns an error, the
+   * same batch is submitted again one second later, hence the changes
+   * are delivered at least once. Note that the "Deleted" changes are
+   * not stored in the changes log, and are thus not reported.
+   *
+   * The plugin can persist the last sequence number it has processed,
+   * and provide it as the "since" argument after a restart of Orthanc
+   * to resume without missing any change. A negative value for
+   * "since" starts from the end of the log, i.e. only the changes
+   * that happen after the start of Orthanc are reported.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param callback The callback function.
+   * @param maxBatchSize The maximum number of changes in one batch.
+   * @param since Sequence number of the change after which to start (excluded), or -1.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginRegisterChangesBatchCallback(
+    OrthancPluginContext*              context,
+    OrthancPluginChangesBatchCallback  callback,
+    uint32_t                           maxBatchSize,
+    int64_t                            since)
+  {
+    _OrthancPluginChangesBatchCallback params;
+    params.callback = callback;
+    params.maxBatchSize = maxBatchSize;
+    params.since = since;
+
+    return context->InvokeService(context, _OrthancPluginService_RegisterChangesBatchCallback, &params);
+  }
+
+
+
+  /**
+   * @brief Retrieve the header of a DICOM instance using its Orthanc identifier.
+   *
+   * Retrieve the beginning of a DICOM instance, up to its pixel data
+   * (excluded), using its Orthanc identifier. The header is read by a
+   * range request to the storage area if possible, and it is kept in
+   * the cache of the DICOM headers of the Orthanc core. If the
+   * instance has no pixel data, the full DICOM file is returned.
+   *
+   * This function is much faster than OrthancPluginGetDicomForInstance()
+   * for plugins that only need the tags of large instances.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param target The target memory buffer. It must be freed with OrthancPluginFreeMemoryBuffer().
+   * @param instanceId The Orthanc identifier of the DICOM instance of interest.
+   * @return 0 if success, or the error code if failure.
+   * @ingroup Orthanc
+   * @see OrthancPluginGetDicomForInstance()
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode  OrthancPluginGetDicomHeaderForInstance(
+    OrthancPluginContext*       context,
+    OrthancPluginMemoryBuffer*  target,
+    const char*                 instanceId)
+  {
+    _OrthancPluginGetDicomForInstance params;
+    params.target = target;
+    params.instanceId = instanceId;
+    return context->InvokeService(context, _OrthancPluginService_GetDicomHeaderForInstance, &params);
+  }
+
+
+  typedef struct
+  {
+    char**                          result;
+    const char*                     instanceId;
+    const char*                     requestedTags;
+    OrthancPluginDicomToJsonFormat  format;
+  } _OrthancPluginGetInstanceTags;
+
+  /**
+   * @brief Get the main DICOM tags and some requested tags of an instance.
+   *
+   * This function returns the same JSON as a call to the REST API
+   * "/instances/{id}?requested-tags=...", without the overhead of the
+   * REST API. The "MainDicomTags" are read from the database, as
+   * well as the requested tags that are stored in the database. The
+   * other requested tags are read from the DICOM file, whose header is
+   * retrieved from the caches of the Orthanc core if possible: Only
+   * the requested tags are converted, instead of the full dataset.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param instanceId The Orthanc identifier of the DICOM instance of interest.
+   * @param requestedTags The list of the requested tags, separated by semicolons
+   * (e.g. "0008,0020;PatientName"). Can be NULL or empty.
+   * @param format The format of the tags.
+   * @return The NULL value if the case of an error (notably if the instance 
+   * doesn't exist), or the JSON string. This string must be freed by 
+   * OrthancPluginFreeString().
+   * @ingroup Orthanc
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE char* OrthancPluginGetInstanceTags(
+    OrthancPluginContext*           context,
+    const char*                     instanceId,
+    const char*                     requestedTags,
+    OrthancPluginDicomToJsonFormat  format)
+  {
+    char* result = NULL;
+
+    _OrthancPluginGetInstanceTags params;
+    params.result = &result;
+    params.instanceId = instanceId;
+    params.requestedTags = requestedTags;
+    params.format = format;
+
+    if (context->InvokeService(context, _OrthancPluginService_GetInstanceTags, &params) != OrthancPluginErrorCode_Success)
+    {
+      /* Error */
+      return NULL;
+    }
+    else
+    {
+      return result;
+    }
+  }
+
+
+
+  typedef struct
+  {
+    OrthancPluginDecodeFramesCallback  callback;
+  } _OrthancPluginDecodeFramesCallback;
+
+  /**
+   * @brief Register a callback to decode the compressed frames of DICOM instances by batches.
+   *
+   * This function registers a custom callback to decode the frames of
+   * the DICOM instances whose pixel data is encapsulated (i.e. using a
+   * compressed transfer syntax). Contrarily to the callbacks that are
+   * registered by OrthancPluginRegisterDecodeImageCallback(), this
+   * callback doesn't receive the full DICOM file, but only:
+   *
+   * - the "header", i.e. the DICOM file up to (and excluding) the
+   *   pixel data element, from which the attributes of the image
+   *   (size, photometric interpretation...) can be parsed,
+   * - the UID of the transfer syntax,
+   * - the compressed bitstream of each of the requested frames, which
+   *   is the concatenation of the fragments of the frame as read
+   *   from the file.
+   *
+   * Several frames can be requested at once, e.g. for batched
+   * decoding on a GPU. On success, the callback must store one image
+   * per frame in "target", which is an array of "countFrames"
+   * elements. The images are then owned by Orthanc. If the callback
+   * returns an error, the images that are already stored in "target"
+   * are freed, and Orthanc falls back to the other decoders.
+   *
+   * This callback is only invoked if the index of the frames is
+   * available for the instance, which requires the configuration
+   * option "FrameOffsetsIndexThreshold" to be enabled, and the DICOM
+   * file to be stored uncompressed in the storage area. Only the
+   * frames that are needed are read from the storage area.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param callback The callback.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginRegisterDecodeFramesCallback(
+    OrthancPluginContext*              context,
+    OrthancPluginDecodeFramesCallback  callback)
+  {
+    _OrthancPluginDecodeFramesCallback params;
+    params.callback = callback;
+
+    return context->InvokeService(context, _OrthancPluginService_RegisterDecodeFramesCallback, &params);
+  }
+
+
+
+  typedef struct
+  {
+    const char*                pathRegularExpression;
+    OrthancPluginRestCallback  callback;
+    uint32_t                   maxConcurrency;
+  } _OrthancPluginRestCallback2;
+
+  /**
+   * @brief Register a REST callback, with a maximum concurrency.
+   *
+   * This function registers a REST callback against a regular
+   * expression for a URI. This function must be called during the
+   * initialization of the plugin, i.e. inside the
+   * OrthancPluginInitialize() public function.
+   *
+   * Similarly to OrthancPluginRegisterRestCallbackNoLock(), the
+   * callback is NOT invoked in mutual exclusion with the other REST
+   * callbacks, and it is up to the plugin to implement the required
+   * locking mechanisms. In addition, the number of simultaneous
+   * invocations of the callback can be bounded: If "maxConcurrency"
+   * is not zero, the HTTP requests that exceed this limit wait for
+   * one of the running invocations to complete.
+   *
+   * To guarantee that no global lock is taken while such a callback
+   * is running, the callback can only use the thread-safe subset of
+   * the SDK (cf. the main page of this documentation): Calling one of
+   * the functions that modify the global state of the plugin engine
+   * (such as the registration of callbacks) from within the callback
+   * results in error ::OrthancPluginErrorCode_BadSequenceOfCalls.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param pathRegularExpression Regular expression for the URI. May contain groups.
+   * @param callback The callback function to handle the REST call.
+   * @param maxConcurrency The maximum number of simultaneous invocations
+   * of the callback (0 means no limit).
+   * @return 0 if success, other value if error.
+   * @see OrthancPluginRegisterRestCallbackNoLock()
+   *
+   * @note
+   * The regular expression is case sensitive and must follow the
+   * [Perl syntax](https://www.boost.org/doc/libs/1_67_0/libs/regex/doc/html/boost_regex/syntax/perl_syntax.html).
+   *
+   * @ingroup Callbacks
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginRegisterRestCallback2(
+    OrthancPluginContext*      context,
+    const char*                pathRegularExpression,
+    OrthancPluginRestCallback  callback,
+    uint32_t                   maxConcurrency)
+  {
+    _OrthancPluginRestCallback2 params;
+    params.pathRegularExpression = pathRegularExpression;
+    params.callback = callback;
+    params.maxConcurrency = maxConcurrency;
+    return context->InvokeService(context, _OrthancPluginService_RegisterRestCallback2, &params);
+  }
+
+
+  typedef struct
+  {
+    OrthancPluginRestOutput* output;
+    const char*              contentType;
+    uint64_t                 contentLength;
+  } _OrthancPluginStartStreamAnswer2;
+
+  /**
+   * @brief Start an HTTP stream answer whose size is known.
+   *
+   * Initiates an HTTP answer whose body is sent by successive calls
+   * to OrthancPluginSendStreamChunk(). Contrarily to
+   * OrthancPluginStartStreamAnswer(), the size of the body must be
+   * known in advance: The answer is sent with a "Content-Length" HTTP
+   * header instead of using chunked transfer encoding. This allows
+   * to forward large answers (e.g. the content of a file) without
+   * keeping them in memory. The plugin must send exactly
+   * "contentLength" bytes before its REST callback returns.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param output The HTTP connection to the client application.
+   * @param contentType The MIME type of the answer.
+   * @param contentLength The size of the body, in bytes.
+   * @return 0 if success, or the error code if failure.
+   * @see OrthancPluginSendStreamChunk()
+   * @ingroup REST
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginStartStreamAnswer2(
+    OrthancPluginContext*    context,
+    OrthancPluginRestOutput* output,
+    const char*              contentType,
+    uint64_t                 contentLength)
+  {
+    _OrthancPluginStartStreamAnswer2 params;
+    params.output = output;
+    params.contentType = contentType;
+    params.contentLength = contentLength;
+    return context->InvokeService(context, _OrthancPluginService_StartStreamAnswer2, &params);
+  }
+
+
+
+  typedef struct
+  {
+    OrthancPluginJob**              target;
+    void                           *job;
+    OrthancPluginJobFinalize        finalize;
+    const char                     *type;
+    uint32_t                        countItems;
+    uint32_t                        maxParallelism;
+    OrthancPluginJobProcessItem     processItem;
+    OrthancPluginJobGetContent2     getContent;
+    OrthancPluginJobStop            stop;
+    OrthancPluginJobReset           reset;
+  } _OrthancPluginCreateParallelJob;
+
+  /**
+   * @brief Create a custom job made of independent work items.
+   *
+   * This function creates a custom job whose work is split into
+   * "countItems" independent work items. Contrarily to
+   * OrthancPluginCreateJob2(), the job has no "step()" callback: The
+   * jobs engine of Orthanc invokes the "processItem()" callback once
+   * for each item, concurrently, using the threads that are shared by
+   * all the jobs (cf. configuration option "JobsEngineTasksThreads").
+   * The progress of the job is the fraction of the processed items.
+   *
+   * The job fails as soon as one item fails: The items that have not
+   * started yet are discarded. If the job is paused, the items that
+   * have not started yet are discarded as well, and the remaining
+   * items are submitted again once the job is resumed. If a failed or
+   * canceled job is resubmitted, all the items are processed again.
+   *
+   * Such a job cannot be serialized.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param job The job to be executed.
+   * @param finalize The finalization callback.
+   * @param type The type of the job.
+   * @param countItems The number of work items.
+   * @param maxParallelism The maximum number of items that are processed
+   * at the same time (0 means no limit, besides the number of threads).
+   * @param processItem The callback to process one work item. It must be thread-safe.
+   * @param getContent The content callback. Can be NULL.
+   * @param stop The callback that is invoked once the job leaves the "running" state. Can be NULL.
+   * @param reset The callback that is invoked if a stopped job is started again. Can be NULL.
+   * @return The newly allocated job. It must be freed with OrthancPluginFreeJob(),
+   * as long as it is not submitted with OrthancPluginSubmitJob().
+   * @ingroup Toolbox
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginJob *OrthancPluginCreateParallelJob(
+    OrthancPluginContext           *context,
+    void                           *job,
+    OrthancPluginJobFinalize        finalize,
+    const char                     *type,
+    uint32_t                        countItems,
+    uint32_t                        maxParallelism,
+    OrthancPluginJobProcessItem     processItem,
+    OrthancPluginJobGetContent2     getContent,
+    OrthancPluginJobStop            stop,
+    OrthancPluginJobReset           reset)
+  {
+    OrthancPluginJob* target = NULL;
+
+    _OrthancPluginCreateParallelJob params;
+    memset(&params, 0, sizeof(params));
+
+    params.target = &target;
+    params.job = job;
+    params.finalize = finalize;
+    params.type = type;
+    params.countItems = countItems;
+    params.maxParallelism = maxParallelism;
+    params.processItem = processItem;
+    params.getContent = getContent;
+    params.stop = stop;
+    params.reset = reset;
+
+    if (context->InvokeService(context, _OrthancPluginService_CreateParallelJob, &params) != OrthancPluginErrorCode_Success ||
+        target == NULL)
+    {
+      /* Error */
+      return NULL;
+    }
+    else
+    {
+      return target;
+    }
+  }
+
+
+
+  typedef struct
+  {
+    OrthancPluginCoalescedChangeCallback  callback;
+    OrthancPluginResourceType             resourceType;
+    uint32_t                              windowMilliseconds;
+  } _OrthancPluginCoalescedChangeCallback;
+
+  /**
+   * @brief Register a callback to be notified of the coalesced changes of the resources.
+   *
+   * This function registers a callback function that is notified at
+   * most once per resource of the given level ("resourceType") and
+   * per time window, whereas the callbacks registered by
+   * OrthancPluginRegisterOnChangeCallback() receive every single
+   * change. This is typically useful for plugins that only need to
+   * know that "this study has changed", e.g. during the reception of
+   * a study with thousands of instances.
+   *
+   * The window of a resource starts with its first change. All the
+   * changes about this resource itself (including the
+   * "NewChildInstance" change that is signaled for each new instance
+   * of the resource) that happen until the end of the window are
+   * coalesced into one single notification, which is sent at the end
+   * of the window. The next change about the resource opens a new
+   * window.
+   *
+   * The callback is invoked by a thread that is dedicated to it. The
+   * errors returned by the callback are logged, but they are not
+   * reported to the core.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param callback The callback function.
+   * @param resourceType The level of the resources, which must be patient, study or series.
+   * @param windowMilliseconds The duration of the time window, in milliseconds.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  ORTHANC_PLUGIN_SINCE_SDK("1.12.12")
+  ORTHANC_PLUGIN_INLINE OrthancPluginErrorCode OrthancPluginRegisterCoalescedChangeCallback(
+    OrthancPluginContext*                 context,
+    OrthancPluginCoalescedChangeCallback  callback,
+    OrthancPluginResourceType             resourceType,
+    uint32_t                              windowMilliseconds)
+  {
+    _OrthancPluginCoalescedChangeCallback params;
+    params.callback = callback;
+    params.resourceType = resourceType;
+    params.windowMilliseconds = windowMilliseconds;
+
+    return context->InvokeService(context, _OrthancPluginService_RegisterCoalescedChangeCallback, &params);
+  }
+
 #ifdef  __cplusplus
 }
 #endif
@@ -4684,6 +4684,118 @@ namespace OrthancPlugins
 #endif
 
 
+#if HAS_ORTHANC_PLUGIN_KEY_VALUE_STORES_BATCH == 1
+  void KeyValueStore::Update(const std::map<std::string, std::string>& stored,
+                             const std::set<std::string>& deleted)
+  {
+    if (static_cast<size_t>(static_cast<uint32_t>(stored.size())) != stored.size() ||
+        static_cast<size_t>(static_cast<uint32_t>(deleted.size())) != deleted.size())
+    {
+      ORTHANC_PLUGINS_THROW_EXCEPTION(NotEnoughMemory);
+    }
+
+    std::vector<const char*> storedKeys;
+    std::vector<const void*> storedValues;
+    std::vector<uint32_t> storedValuesSizes;
+    storedKeys.reserve(stored.size());
+    storedValues.reserve(stored.size());
+    storedValuesSizes.reserve(stored.size());
+
+    for (std::map<std::string, std::string>::const_iterator it = stored.begin(); it != stored.end(); ++it)
+    {
+      if (static_cast<size_t>(static_cast<uint32_t>(it->second.size())) != it->second.size())
+      {
+        ORTHANC_PLUGINS_THROW_EXCEPTION(NotEnoughMemory);
+      }
+
+      storedKeys.push_back(it->first.c_str());
+      storedValues.push_back(it->second.empty() ? NULL : it->second.c_str());
+      storedValuesSizes.push_back(static_cast<uint32_t>(it->second.size()));
+    }
+
+    std::vector<const char*> deletedKeys;
+    deletedKeys.reserve(deleted.size());
+
+    for (std::set<std::string>::const_iterator it = deleted.begin(); it != deleted.end(); ++it)
+    {
+      deletedKeys.push_back(it->c_str());
+    }
+
+    OrthancPluginErrorCode code = OrthancPluginUpdateKeysValues(
+      OrthancPlugins::GetGlobalContext(), storeId_.c_str(),
+      static_cast<uint32_t>(stored.size()), storedKeys.empty() ? NULL : &storedKeys[0],
+      storedValues.empty() ? NULL : &storedValues[0], storedValuesSizes.empty() ? NULL : &storedValuesSizes[0],
+      static_cast<uint32_t>(deleted.size()), deletedKeys.empty() ? NULL : &deletedKeys[0]);
+
+    if (code != OrthancPluginErrorCode_Success)
+    {
+      ORTHANC_PLUGINS_THROW_PLUGIN_ERROR_CODE(code);
+    }
+  }
+#endif
+
+
+#if HAS_ORTHANC_PLUGIN_KEY_VALUE_STORES_BATCH == 1
+  void KeyValueStore::GetValues(std::map<std::string, std::string>& values,
+                                const std::set<std::string>& keys)
+  {
+    values.clear();
+
+    if (keys.empty())
+    {
+      return;
+    }
+
+    if (static_cast<size_t>(static_cast<uint32_t>(keys.size())) != keys.size())
+    {
+      ORTHANC_PLUGINS_THROW_EXCEPTION(NotEnoughMemory);
+    }
+
+    std::vector<const char*> cKeys;
+    cKeys.reserve(keys.size());
+
+    for (std::set<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+    {
+      cKeys.push_back(it->c_str());
+    }
+
+    std::vector<uint8_t> found(keys.size(), 0);
+    std::vector<OrthancPluginMemoryBuffer> buffers(keys.size());
+
+    OrthancPluginErrorCode code = OrthancPluginGetKeysValues(OrthancPlugins::GetGlobalContext(), &found[0], &buffers[0],
+                                                             storeId_.c_str(), static_cast<uint32_t>(keys.size()), &cKeys[0]);
+
+    if (code != OrthancPluginErrorCode_Success)
+    {
+      ORTHANC_PLUGINS_THROW_PLUGIN_ERROR_CODE(code);
+    }
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+      if (found[i])
+      {
+        values[cKeys[i]].assign(reinterpret_cast<const char*>(buffers[i].data), buffers[i].size);
+        OrthancPluginFreeMemoryBuffer(OrthancPlugins::GetGlobalContext(), &buffers[i]);
+      }
+    }
+  }
+#endif
+
+
+#if HAS_ORTHANC_PLUGIN_KEY_VALUE_STORES_BATCH == 1
+  void KeyValueStore::SetCacheSize(uint64_t maximumSize)
+  {
+    OrthancPluginErrorCode code = OrthancPluginSetKeyValueStoreCacheSize(OrthancPlugins::GetGlobalContext(),
+                                                                         storeId_.c_str(), maximumSize);
+
+    if (code != OrthancPluginErrorCode_Success)
+    {
+      ORTHANC_PLUGINS_THROW_PLUGIN_ERROR_CODE(code);
+    }
+  }
+#endif
+
+
 #if HAS_ORTHANC_PLUGIN_QUEUES == 1
   void Queue::Enqueue(const void* value,
                       size_t valueSize)
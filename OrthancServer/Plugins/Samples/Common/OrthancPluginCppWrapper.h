@@ -148,6 +148,12 @@
 #  define HAS_ORTHANC_PLUGIN_RESERVE_QUEUE_VALUE   0
 #endif
 
+#if ORTHANC_PLUGINS_VERSION_IS_ABOVE(1, 12, 12)
+#  define HAS_ORTHANC_PLUGIN_KEY_VALUE_STORES_BATCH  1
+#else
+#  define HAS_ORTHANC_PLUGIN_KEY_VALUE_STORES_BATCH  0
+#endif
+
 
 // Macro to tag a function as having been deprecated
 #if (__cplusplus >= 201402L)  // C++14
@@ -1730,6 +1736,20 @@ void GetGetArguments(GetArguments& result, const OrthancPluginHttpRequest* reque
     void DeleteKey(const std::string& key);
 
     Iterator* CreateIterator();
+
+#if HAS_ORTHANC_PLUGIN_KEY_VALUE_STORES_BATCH == 1
+    // Store and delete several keys in one single transaction
+    void Update(const std::map<std::string, std::string>& stored,
+                const std::set<std::string>& deleted);
+
+    // The keys that are absent from the store are not added to "values"
+    void GetValues(std::map<std::string, std::string>& values,
+                   const std::set<std::string>& keys);
+
+    // Enable the cache of this store in the memory of the Orthanc
+    // server ("0" disables the cache)
+    void SetCacheSize(uint64_t maximumSize);
+#endif
   };
 #endif
 
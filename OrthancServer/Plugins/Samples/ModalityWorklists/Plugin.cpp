@@ -27,6 +27,7 @@
 #include "../Common/OrthancPluginCppWrapper.h"
 
 #include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
 #include <json/value.h>
 #include <string.h>
 #include <iostream>
@@ -36,22 +37,118 @@ static std::string folder_;
 static bool filterIssuerAet_ = false;
 static unsigned int limitAnswers_ = 0;
 
+
+/**
+ * Cache of the content of the worklist files, so that the files that
+ * are unchanged since the previous query are not read again from the
+ * disk. An entry is invalidated if the modification time or the size
+ * of its file changes.
+ **/
+class WorklistsCache : public boost::noncopyable
+{
+private:
+  struct Entry
+  {
+    std::time_t  lastWriteTime_;
+    uintmax_t    size_;
+    std::string  content_;
+  };
+
+  typedef std::map<std::string, Entry>  Content;
+
+  boost::mutex  mutex_;
+  bool          enabled_;
+  Content       content_;
+
+public:
+  WorklistsCache() :
+    enabled_(false)
+  {
+  }
+
+  void SetEnabled(bool enabled)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    enabled_ = enabled;
+    content_.clear();
+  }
+
+  void Read(std::string& content,
+            const boost::filesystem::path& path)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!enabled_)
+    {
+      OrthancPlugins::MemoryBuffer dicom;
+      dicom.ReadFile(path.string());
+      dicom.ToString(content);
+      return;
+    }
+
+    const std::time_t lastWriteTime = boost::filesystem::last_write_time(path);
+    const uintmax_t size = boost::filesystem::file_size(path);
+
+    Content::iterator found = content_.find(path.string());
+    if (found == content_.end() ||
+        found->second.lastWriteTime_ != lastWriteTime ||
+        found->second.size_ != size)
+    {
+      OrthancPlugins::MemoryBuffer dicom;
+      dicom.ReadFile(path.string());
+
+      Entry& entry = content_[path.string()];
+      entry.lastWriteTime_ = lastWriteTime;
+      entry.size_ = size;
+      dicom.ToString(entry.content_);
+
+      content = entry.content_;
+    }
+    else
+    {
+      content = found->second.content_;
+    }
+  }
+
+  // Forget about the files that have been removed from the folder
+  void Prune(const std::set<std::string>& existingPaths)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Content::iterator it = content_.begin();
+    while (it != content_.end())
+    {
+      if (existingPaths.find(it->first) == existingPaths.end())
+      {
+        content_.erase(it++);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+};
+
+static WorklistsCache cache_;
+
+
 /**
  * This is the main function for matching a DICOM worklist against a query.
  **/
 static bool MatchWorklist(OrthancPluginWorklistAnswers*      answers,
                            const OrthancPluginWorklistQuery*  query,
                            const OrthancPlugins::FindMatcher& matcher,
-                           const std::string& path)
+                           const boost::filesystem::path& path)
 {
-  OrthancPlugins::MemoryBuffer dicom;
-  dicom.ReadFile(path);
+  std::string dicom;
+  cache_.Read(dicom, path);
 
-  if (matcher.IsMatch(dicom))
+  if (matcher.IsMatch(dicom.c_str(), dicom.size()))
   {
     // This DICOM file matches the worklist query, add it to the answers
     OrthancPluginErrorCode code = OrthancPluginWorklistAddAnswer
-      (OrthancPlugins::GetGlobalContext(), answers, query, dicom.GetData(), dicom.GetSize());
+      (OrthancPlugins::GetGlobalContext(), answers, query, dicom.c_str(), dicom.size());
 
     if (code != OrthancPluginErrorCode_Success)
     {
@@ -159,6 +256,7 @@ OrthancPluginErrorCode Callback(OrthancPluginWorklistAnswers*     answers,
     {
       unsigned int parsedFilesCount = 0;
       unsigned int matchedWorklistCount = 0;
+      std::set<std::string> existingPaths;
       
       for (fs::directory_iterator it(source); it != end; ++it)
       {
@@ -173,8 +271,10 @@ OrthancPluginErrorCode Callback(OrthancPluginWorklistAnswers*     answers,
           if (extension == ".wl")
           {
             parsedFilesCount++;
+            existingPaths.insert(it->path().string());
+
             // We found a worklist (i.e. a DICOM find with extension ".wl"), match it against the query
-            if (MatchWorklist(answers, query, *matcher, it->path().string()))
+            if (MatchWorklist(answers, query, *matcher, it->path()))
             {
               if (limitAnswers_ != 0 &&
                   matchedWorklistCount >= limitAnswers_)
@@ -195,6 +295,9 @@ OrthancPluginErrorCode Callback(OrthancPluginWorklistAnswers*     answers,
 
       ORTHANC_PLUGINS_LOG_INFO("Worklist C-Find: parsed " + boost::lexical_cast<std::string>(parsedFilesCount) +
                                " files, found " + boost::lexical_cast<std::string>(matchedWorklistCount) + " match(es)");
+
+      // The folder has been fully scanned
+      cache_.Prune(existingPaths);
     }
     catch (fs::filesystem_error&)
     {
@@ -250,6 +353,10 @@ extern "C"
 
       filterIssuerAet_ = worklists.GetBooleanValue("FilterIssuerAet", false);
       limitAnswers_ = worklists.GetUnsignedIntegerValue("LimitAnswers", 0);
+
+      // Keep the content of the worklist files in RAM, in order to
+      // avoid reading the unchanged files at each query
+      cache_.SetEnabled(worklists.GetBooleanValue("CacheFiles", false));
     }
     else
     {
@@ -0,0 +1,87 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "ChangesFeed.h"
+
+
+namespace Orthanc
+{
+  ChangesFeed::ChangesFeed() :
+    generation_(0),
+    stopped_(false)
+  {
+  }
+
+
+  uint64_t ChangesFeed::GetGeneration()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return generation_;
+  }
+
+
+  void ChangesFeed::SignalChange()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    generation_++;
+    changed_.notify_all();
+  }
+
+
+  bool ChangesFeed::WaitChange(uint64_t generation,
+                               unsigned int timeout)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    const boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout);
+
+    while (!stopped_ &&
+           generation_ == generation)
+    {
+      if (!changed_.timed_wait(lock, deadline))
+      {
+        break;
+      }
+    }
+
+    return (!stopped_ &&
+            generation_ != generation);
+  }
+
+
+  void ChangesFeed::Stop()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stopped_ = true;
+    changed_.notify_all();
+  }
+
+
+  bool ChangesFeed::IsStopped()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return stopped_;
+  }
+}
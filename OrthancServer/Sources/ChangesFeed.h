@@ -0,0 +1,70 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <stdint.h>
+
+namespace Orthanc
+{
+  /**
+   * Wakes up the consumers of the changes log (long-polling HTTP
+   * clients of "/changes" and the batched callbacks of the plugins)
+   * as soon as a change is committed, so that they don't have to
+   * poll the database in a loop. Only a generation counter is kept:
+   * the changes themselves are read from the database, which gives
+   * the "since" cursor semantics. New in Orthanc 1.12.12.
+   **/
+  class ChangesFeed : public boost::noncopyable
+  {
+  private:
+    boost::mutex               mutex_;
+    boost::condition_variable  changed_;
+    uint64_t                   generation_;
+    bool                       stopped_;
+
+  public:
+    ChangesFeed();
+
+    // To be read *before* reading the database, so that a change
+    // that is committed in-between is not missed by "WaitChange()"
+    uint64_t GetGeneration();
+
+    void SignalChange();
+
+    // Waits for at most "timeout" milliseconds for the generation to
+    // differ from "generation". Returns "false" on timeout, or if
+    // the feed is stopped.
+    bool WaitChange(uint64_t generation,
+                    unsigned int timeout);
+
+    // Releases all the waiting consumers
+    void Stop();
+
+    bool IsStopped();
+  };
+}
@@ -55,6 +55,43 @@ namespace Orthanc
     throw OrthancException(ErrorCode_NotImplemented, "BaseCompatibilityTransaction::GetChangesExtended");  // Not supported
   }
 
+  void BaseCompatibilityTransaction::GetResourceStatistics(uint64_t& countStudies,
+                                                           uint64_t& countSeries,
+                                                           uint64_t& countInstances,
+                                                           uint64_t& compressedSize,
+                                                           uint64_t& uncompressedSize,
+                                                           uint64_t& dicomCompressedSize,
+                                                           uint64_t& dicomUncompressedSize,
+                                                           int64_t id)
+  {
+    throw OrthancException(ErrorCode_NotImplemented, "BaseCompatibilityTransaction::GetResourceStatistics");  // Not supported
+  }
+
+  uint64_t BaseCompatibilityTransaction::DeleteChangesBefore(const std::string& date,
+                                                             uint32_t limit)
+  {
+    throw OrthancException(ErrorCode_NotImplemented, "BaseCompatibilityTransaction::DeleteChangesBefore");  // Not supported
+  }
+
+  uint64_t BaseCompatibilityTransaction::DeleteExportedResourcesBefore(const std::string& date,
+                                                                       uint32_t limit)
+  {
+    throw OrthancException(ErrorCode_NotImplemented, "BaseCompatibilityTransaction::DeleteExportedResourcesBefore");  // Not supported
+  }
+
+  uint64_t BaseCompatibilityTransaction::DeleteChangesUpTo(int64_t seq,
+                                                           uint32_t limit)
+  {
+    throw OrthancException(ErrorCode_NotImplemented, "BaseCompatibilityTransaction::DeleteChangesUpTo");  // Not supported
+  }
+
+  void BaseCompatibilityTransaction::ExplainFind(Json::Value& target,
+                                                 const FindRequest& request,
+                                                 const IDatabaseWrapper::Capabilities& capabilities)
+  {
+    throw OrthancException(ErrorCode_NotImplemented, "BaseCompatibilityTransaction::ExplainFind");  // Not supported
+  }
+
   void BaseCompatibilityTransaction::ExecuteCount(uint64_t& count,
                                                   const FindRequest& request,
                                                   const IDatabaseWrapper::Capabilities& capabilities)
@@ -71,6 +71,28 @@ namespace Orthanc
                                     int64_t to,
                                     uint32_t limit,
                                     const std::set<ChangeType>& filterType) ORTHANC_OVERRIDE;
+
+    virtual void GetResourceStatistics(uint64_t& countStudies,
+                                       uint64_t& countSeries,
+                                       uint64_t& countInstances,
+                                       uint64_t& compressedSize,
+                                       uint64_t& uncompressedSize,
+                                       uint64_t& dicomCompressedSize,
+                                       uint64_t& dicomUncompressedSize,
+                                       int64_t id) ORTHANC_OVERRIDE;
+
+    virtual uint64_t DeleteChangesBefore(const std::string& date,
+                                         uint32_t limit) ORTHANC_OVERRIDE;
+
+    virtual uint64_t DeleteExportedResourcesBefore(const std::string& date,
+                                                   uint32_t limit) ORTHANC_OVERRIDE;
+
+    virtual uint64_t DeleteChangesUpTo(int64_t seq,
+                                       uint32_t limit) ORTHANC_OVERRIDE;
+
+    virtual void ExplainFind(Json::Value& target,
+                             const FindRequest& request,
+                             const IDatabaseWrapper::Capabilities& capabilities) ORTHANC_OVERRIDE;
   };
 
 }
@@ -0,0 +1,287 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "ContentReferences.h"
+
+#include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/OrthancException.h"
+#include "StatelessDatabaseOperations.h"
+
+#include <boost/lexical_cast.hpp>
+
+
+// The value of each content is its number of references, followed by
+// a newline and by its custom data in the storage area. A count of
+// zero means that the content is being deleted.
+static const char* const STORE_ID = "orthanc-content-references";
+
+
+namespace Orthanc
+{
+  static void ParseValue(unsigned int& count,
+                         std::string& customData,
+                         const std::string& value)
+  {
+    const size_t separator = value.find('\n');
+
+    try
+    {
+      count = boost::lexical_cast<unsigned int>(value.substr(0, separator));
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      throw OrthancException(ErrorCode_CorruptedFile, "Bad reference count of a content-addressed attachment");
+    }
+
+    if (separator == std::string::npos)
+    {
+      customData.clear();
+    }
+    else
+    {
+      customData = value.substr(separator + 1);
+    }
+  }
+
+
+  static std::string FormatValue(unsigned int count,
+                                 const std::string& customData)
+  {
+    return boost::lexical_cast<std::string>(count) + "\n" + customData;
+  }
+
+
+  namespace
+  {
+    class AddReferenceUpdater : public StatelessDatabaseOperations::IKeyValueUpdater
+    {
+    private:
+      ContentAddressedStorageArea::ReferenceStatus  status_;
+      std::string                                   customData_;
+
+    public:
+      AddReferenceUpdater() :
+        status_(ContentAddressedStorageArea::ReferenceStatus_Missing)
+      {
+      }
+
+      virtual Action Update(std::string& value,
+                            bool exists) ORTHANC_OVERRIDE
+      {
+        if (!exists)
+        {
+          status_ = ContentAddressedStorageArea::ReferenceStatus_Missing;
+          return Action_Keep;
+        }
+
+        unsigned int count;
+        ParseValue(count, customData_, value);
+
+        if (count == 0)
+        {
+          status_ = ContentAddressedStorageArea::ReferenceStatus_Deleting;
+          return Action_Keep;
+        }
+        else
+        {
+          status_ = ContentAddressedStorageArea::ReferenceStatus_Added;
+          value = FormatValue(count + 1, customData_);
+          return Action_Store;
+        }
+      }
+
+      ContentAddressedStorageArea::ReferenceStatus GetStatus() const
+      {
+        return status_;
+      }
+
+      const std::string& GetCustomData() const
+      {
+        return customData_;
+      }
+    };
+
+
+    class RegisterUpdater : public StatelessDatabaseOperations::IKeyValueUpdater
+    {
+    private:
+      const std::string&  customData_;
+      bool                isFirst_;
+      std::string         existingCustomData_;
+
+    public:
+      explicit RegisterUpdater(const std::string& customData) :
+        customData_(customData),
+        isFirst_(true)
+      {
+      }
+
+      virtual Action Update(std::string& value,
+                            bool exists) ORTHANC_OVERRIDE
+      {
+        if (!exists)
+        {
+          isFirst_ = true;
+          value = FormatValue(1, customData_);
+          return Action_Store;
+        }
+
+        unsigned int count;
+        ParseValue(count, existingCustomData_, value);
+
+        if (count == 0)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls, "This content is being deleted");
+        }
+        else
+        {
+          isFirst_ = false;
+          value = FormatValue(count + 1, existingCustomData_);
+          return Action_Store;
+        }
+      }
+
+      bool IsFirst() const
+      {
+        return isFirst_;
+      }
+
+      const std::string& GetExistingCustomData() const
+      {
+        return existingCustomData_;
+      }
+    };
+
+
+    class RemoveReferenceUpdater : public StatelessDatabaseOperations::IKeyValueUpdater
+    {
+    private:
+      bool  isLast_;
+
+    public:
+      RemoveReferenceUpdater() :
+        isLast_(false)
+      {
+      }
+
+      virtual Action Update(std::string& value,
+                            bool exists) ORTHANC_OVERRIDE
+      {
+        isLast_ = false;
+
+        if (!exists)
+        {
+          return Action_Keep;
+        }
+
+        unsigned int count;
+        std::string customData;
+        ParseValue(count, customData, value);
+
+        if (count == 0)
+        {
+          return Action_Keep;  // Already being deleted
+        }
+        else
+        {
+          isLast_ = (count == 1);
+          value = FormatValue(count - 1, customData);
+          return Action_Store;
+        }
+      }
+
+      bool IsLast() const
+      {
+        return isLast_;
+      }
+    };
+
+
+    class ForgetUpdater : public StatelessDatabaseOperations::IKeyValueUpdater
+    {
+    public:
+      virtual Action Update(std::string& value,
+                            bool exists) ORTHANC_OVERRIDE
+      {
+        return Action_Delete;
+      }
+    };
+  }
+
+
+  ContentReferences::ContentReferences(StatelessDatabaseOperations& index) :
+    index_(index)
+  {
+  }
+
+
+  ContentAddressedStorageArea::ReferenceStatus ContentReferences::AddReference(std::string& customData,
+                                                                               const std::string& key)
+  {
+    AddReferenceUpdater updater;
+    index_.UpdateKeyValue(STORE_ID, key, updater);
+
+    if (updater.GetStatus() == ContentAddressedStorageArea::ReferenceStatus_Added)
+    {
+      customData = updater.GetCustomData();
+    }
+
+    return updater.GetStatus();
+  }
+
+
+  bool ContentReferences::Register(std::string& customData,
+                                   const std::string& key)
+  {
+    RegisterUpdater updater(customData);
+    index_.UpdateKeyValue(STORE_ID, key, updater);
+
+    if (updater.IsFirst())
+    {
+      return true;
+    }
+    else
+    {
+      customData = updater.GetExistingCustomData();
+      return false;
+    }
+  }
+
+
+  bool ContentReferences::RemoveReference(const std::string& key)
+  {
+    RemoveReferenceUpdater updater;
+    index_.UpdateKeyValue(STORE_ID, key, updater);
+    return updater.IsLast();
+  }
+
+
+  void ContentReferences::Forget(const std::string& key)
+  {
+    ForgetUpdater updater;
+    index_.UpdateKeyValue(STORE_ID, key, updater);
+  }
+}
@@ -0,0 +1,58 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include "../../../OrthancFramework/Sources/FileStorage/ContentAddressedStorageArea.h"
+
+namespace Orthanc
+{
+  class StatelessDatabaseOperations;
+
+  /**
+   * Reference counting of the content-addressed attachments, stored
+   * in a key-value store of the database index, which makes it
+   * shared by all the Orthanc servers that use the same database (new
+   * in Orthanc 1.12.12).
+   **/
+  class ContentReferences : public ContentAddressedStorageArea::IReferences
+  {
+  private:
+    StatelessDatabaseOperations&  index_;
+
+  public:
+    explicit ContentReferences(StatelessDatabaseOperations& index);
+
+    virtual ContentAddressedStorageArea::ReferenceStatus AddReference(std::string& customData,
+                                                                      const std::string& key) ORTHANC_OVERRIDE;
+
+    virtual bool Register(std::string& customData,
+                          const std::string& key) ORTHANC_OVERRIDE;
+
+    virtual bool RemoveReference(const std::string& key) ORTHANC_OVERRIDE;
+
+    virtual void Forget(const std::string& key) ORTHANC_OVERRIDE;
+  };
+}
@@ -0,0 +1,197 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "DatabaseOperationsStatistics.h"
+
+#include "../../../OrthancFramework/Sources/MetricsRegistry.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cassert>
+
+
+namespace Orthanc
+{
+  // Upper bounds of the buckets of the histograms, in milliseconds
+  static const uint64_t BUCKETS[] = { 1, 5, 10, 50, 100, 500, 1000, 5000 };
+  static const size_t BUCKETS_COUNT = sizeof(BUCKETS) / sizeof(uint64_t);
+
+
+  class DatabaseOperationsStatistics::Histogram
+  {
+  private:
+    uint64_t  buckets_[BUCKETS_COUNT];  // Non-cumulative
+    uint64_t  count_;
+    uint64_t  sumMicroseconds_;
+
+  public:
+    Histogram() :
+      count_(0),
+      sumMicroseconds_(0)
+    {
+      for (size_t i = 0; i < BUCKETS_COUNT; i++)
+      {
+        buckets_[i] = 0;
+      }
+    }
+
+    void Add(uint64_t microseconds)
+    {
+      for (size_t i = 0; i < BUCKETS_COUNT; i++)
+      {
+        if (microseconds <= BUCKETS[i] * 1000)
+        {
+          buckets_[i]++;
+          break;
+        }
+      }
+
+      count_++;
+      sumMicroseconds_ += microseconds;
+    }
+
+    uint64_t GetCount() const
+    {
+      return count_;
+    }
+
+    void Publish(MetricsRegistry& registry,
+                 const std::string& name,
+                 const std::string& operation) const
+    {
+      const std::string label = "operation=\"" + operation + "\"";
+
+      // The buckets of the Prometheus histograms are cumulative
+      uint64_t cumulative = 0;
+      for (size_t i = 0; i < BUCKETS_COUNT; i++)
+      {
+        cumulative += buckets_[i];
+        registry.SetIntegerValue(name + "_bucket{" + label + ",le=\"" + boost::lexical_cast<std::string>(BUCKETS[i]) + "\"}",
+                                 static_cast<int64_t>(cumulative));
+      }
+
+      registry.SetIntegerValue(name + "_bucket{" + label + ",le=\"+Inf\"}", static_cast<int64_t>(count_));
+      registry.SetIntegerValue(name + "_sum{" + label + "}", static_cast<int64_t>(sumMicroseconds_ / 1000));
+      registry.SetIntegerValue(name + "_count{" + label + "}", static_cast<int64_t>(count_));
+    }
+  };
+
+
+  class DatabaseOperationsStatistics::Operation : public boost::noncopyable
+  {
+  public:
+    Histogram  duration_;
+    Histogram  wait_;
+    uint64_t   retries_;
+    uint64_t   serializationFailures_;
+
+    Operation() :
+      retries_(0),
+      serializationFailures_(0)
+    {
+    }
+  };
+
+
+  DatabaseOperationsStatistics::~DatabaseOperationsStatistics()
+  {
+    for (Operations::iterator it = operations_.begin(); it != operations_.end(); ++it)
+    {
+      assert(it->second != NULL);
+      delete it->second;
+    }
+  }
+
+
+  void DatabaseOperationsStatistics::AddTransaction(const std::string& operation,
+                                                    uint64_t durationMicroseconds,
+                                                    uint64_t waitMicroseconds,
+                                                    unsigned int retries,
+                                                    unsigned int serializationFailures)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Operations::iterator found = operations_.find(operation);
+
+    Operation* item;
+    if (found == operations_.end())
+    {
+      item = new Operation;
+      operations_[operation] = item;
+    }
+    else
+    {
+      assert(found->second != NULL);
+      item = found->second;
+    }
+
+    item->duration_.Add(durationMicroseconds);
+    item->wait_.Add(waitMicroseconds);
+    item->retries_ += retries;
+    item->serializationFailures_ += serializationFailures;
+  }
+
+
+  bool DatabaseOperationsStatistics::LookupOperation(uint64_t& countTransactions,
+                                                     uint64_t& countRetries,
+                                                     uint64_t& countSerializationFailures,
+                                                     const std::string& operation)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Operations::const_iterator found = operations_.find(operation);
+
+    if (found == operations_.end())
+    {
+      return false;
+    }
+    else
+    {
+      assert(found->second != NULL);
+      countTransactions = found->second->duration_.GetCount();
+      countRetries = found->second->retries_;
+      countSerializationFailures = found->second->serializationFailures_;
+      return true;
+    }
+  }
+
+
+  void DatabaseOperationsStatistics::Publish(MetricsRegistry& registry)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    for (Operations::const_iterator it = operations_.begin(); it != operations_.end(); ++it)
+    {
+      assert(it->second != NULL);
+      const Operation& item = *it->second;
+      const std::string label = "{operation=\"" + it->first + "\"}";
+
+      item.duration_.Publish(registry, "orthanc_database_transaction_duration_ms", it->first);
+      item.wait_.Publish(registry, "orthanc_database_wait_ms", it->first);
+      registry.SetIntegerValue("orthanc_database_retries_total" + label, static_cast<int64_t>(item.retries_));
+      registry.SetIntegerValue("orthanc_database_serialization_failures_total" + label,
+                               static_cast<int64_t>(item.serializationFailures_));
+    }
+  }
+}
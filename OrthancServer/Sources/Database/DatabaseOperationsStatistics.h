@@ -0,0 +1,74 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <stdint.h>
+#include <string>
+
+
+namespace Orthanc
+{
+  class MetricsRegistry;
+
+  /**
+   * Statistics about the transactions that are run by
+   * "StatelessDatabaseOperations", grouped by the name of the
+   * operation (new in Orthanc 1.12.12). "Publish()" exports them as
+   * Prometheus histograms (duration of the transactions, and time
+   * spent waiting for the database before the transactions start)
+   * and counters (retries and serialization failures), labeled by the
+   * name of the operation.
+   **/
+  class DatabaseOperationsStatistics : public boost::noncopyable
+  {
+  private:
+    class Histogram;
+    class Operation;
+
+    typedef std::map<std::string, Operation*>  Operations;
+
+    boost::mutex  mutex_;
+    Operations    operations_;
+
+  public:
+    ~DatabaseOperationsStatistics();
+
+    void AddTransaction(const std::string& operation,
+                        uint64_t durationMicroseconds,
+                        uint64_t waitMicroseconds,
+                        unsigned int retries,
+                        unsigned int serializationFailures);
+
+    bool LookupOperation(uint64_t& countTransactions /* out */,
+                         uint64_t& countRetries /* out */,
+                         uint64_t& countSerializationFailures /* out */,
+                         const std::string& operation);
+
+    void Publish(MetricsRegistry& registry);
+  };
+}
@@ -87,6 +87,8 @@ namespace Orthanc
     hasLimits_(false),
     limitsSince_(0),
     limitsCount_(0),
+    hasKeysetPagination_(false),
+    keysetLastInternalId_(0),
     labelsConstraint_(LabelsConstraint_All),
     retrieveMainDicomTags_(false),
     retrieveMetadata_(false),
@@ -225,6 +227,33 @@ namespace Orthanc
   }
 
 
+  void FindRequest::SetKeysetPagination(int64_t lastInternalId)
+  {
+    if (lastInternalId < 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      hasKeysetPagination_ = true;
+      keysetLastInternalId_ = lastInternalId;
+    }
+  }
+
+
+  int64_t FindRequest::GetKeysetLastInternalId() const
+  {
+    if (hasKeysetPagination_)
+    {
+      return keysetLastInternalId_;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+  }
+
+
   void FindRequest::AddOrdering(const DicomTag& tag,
                                 OrderingCast cast,
                                 OrderingDirection direction)
@@ -263,6 +263,8 @@ namespace Orthanc
     bool                                 hasLimits_;
     uint64_t                             limitsSince_;
     uint64_t                             limitsCount_;
+    bool                                 hasKeysetPagination_;  // New in Orthanc 1.12.12
+    int64_t                              keysetLastInternalId_;
     std::set<std::string>                labels_;
     LabelsConstraint                     labelsConstraint_;
 
@@ -343,6 +345,23 @@ namespace Orthanc
 
     uint64_t GetLimitsCount() const;
 
+    /**
+     * Keyset pagination (new in Orthanc 1.12.12, only if
+     * "HasKeysetPaginationSupport()"): the resources are sorted by
+     * their internal ID, and only those whose internal ID is greater
+     * than "lastInternalId" are reported. Use "0" to get the first
+     * page. The "since" of the limits must be zero, and no ordering
+     * can be specified.
+     **/
+    void SetKeysetPagination(int64_t lastInternalId);
+
+    bool HasKeysetPagination() const
+    {
+      return hasKeysetPagination_;
+    }
+
+    int64_t GetKeysetLastInternalId() const;
+
     void AddOrdering(const DicomTag& tag,
                      OrderingCast cast,
                      OrderingDirection direction);
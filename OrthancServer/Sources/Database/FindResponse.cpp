@@ -33,71 +33,18 @@
 
 namespace Orthanc
 {
-  class FindResponse::MainDicomTagsAtLevel::DicomValue : public boost::noncopyable
-  {
-  public:
-    enum ValueType
-    {
-      ValueType_String,
-      ValueType_Null
-    };
-
-  private:
-    ValueType     type_;
-    std::string   value_;
-
-  public:
-    DicomValue(ValueType type,
-               const std::string& value) :
-      type_(type),
-      value_(value)
-    {
-    }
-
-    ValueType GetType() const
-    {
-      return type_;
-    }
-
-    const std::string& GetValue() const
-    {
-      switch (type_)
-      {
-        case ValueType_Null:
-          throw OrthancException(ErrorCode_BadSequenceOfCalls);
-
-        case ValueType_String:
-          return value_;
-
-        default:
-          throw OrthancException(ErrorCode_ParameterOutOfRange);
-      }
-    }
-  };
-
-
-  FindResponse::MainDicomTagsAtLevel::~MainDicomTagsAtLevel()
-  {
-    for (MainDicomTags::iterator it = mainDicomTags_.begin(); it != mainDicomTags_.end(); ++it)
-    {
-      assert(it->second != NULL);
-      delete it->second;
-    }
-  }
-
-
   void FindResponse::MainDicomTagsAtLevel::AddNullDicomTag(uint16_t group,
                                                            uint16_t element)
   {
     const DicomTag tag(group, element);
 
-    if (mainDicomTags_.find(tag) == mainDicomTags_.end())
+    if (mainDicomTags_.HasTag(tag))
     {
-      mainDicomTags_[tag] = new DicomValue(DicomValue::ValueType_Null, "");
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
     else
     {
-      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      mainDicomTags_.SetNullValue(tag);
     }
   }
 
@@ -108,37 +55,20 @@ namespace Orthanc
   {
     const DicomTag tag(group, element);
 
-    if (mainDicomTags_.find(tag) == mainDicomTags_.end())
+    if (mainDicomTags_.HasTag(tag))
     {
-      mainDicomTags_[tag] = new DicomValue(DicomValue::ValueType_String, value);
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
     else
     {
-      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      mainDicomTags_.SetValue(tag, value, false /* not binary */);
     }
   }
 
 
   void FindResponse::MainDicomTagsAtLevel::Export(DicomMap& target) const
   {
-    for (MainDicomTags::const_iterator it = mainDicomTags_.begin(); it != mainDicomTags_.end(); ++it)
-    {
-      assert(it->second != NULL);
-
-      switch (it->second->GetType())
-      {
-        case DicomValue::ValueType_String:
-          target.SetValue(it->first, it->second->GetValue(), false /* not binary */);
-          break;
-
-        case DicomValue::ValueType_Null:
-          target.SetNullValue(it->first);
-          break;
-
-        default:
-          THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
-      }
-    }
+    mainDicomTags_.Export(target);
   }
 
 
@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include "../../../OrthancFramework/Sources/DicomFormat/CompactDicomMap.h"
 #include "../../../OrthancFramework/Sources/DicomFormat/DicomMap.h"
 #include "../../../OrthancFramework/Sources/Enumerations.h"
 #include "../../../OrthancFramework/Sources/FileStorage/FileInfo.h"
@@ -45,15 +46,11 @@ namespace Orthanc
     class MainDicomTagsAtLevel : public boost::noncopyable
     {
     private:
-      class DicomValue;
-
-      typedef std::map<DicomTag, DicomValue*>  MainDicomTags;
-
-      MainDicomTags  mainDicomTags_;
+      // Compact storage, as the tags of all the resources of the
+      // response are kept in memory (new in Orthanc 1.12.12)
+      CompactDicomMap  mainDicomTags_;
 
     public:
-      ~MainDicomTagsAtLevel();
-
       void AddStringDicomTag(uint16_t group,
                              uint16_t element,
                              const std::string& value);
@@ -64,6 +61,12 @@ namespace Orthanc
                            uint16_t element);
 
       void Export(DicomMap& target) const;
+
+      bool CopyTagIfExists(DicomMap& target,
+                           const DicomTag& tag) const
+      {
+        return mainDicomTags_.CopyTagIfExists(target, tag);
+      }
     };
 
     class ChildrenInformation : public boost::noncopyable
@@ -261,6 +264,15 @@ namespace Orthanc
 
       void GetAllMainDicomTags(DicomMap& target) const;
 
+      // Copies one main DICOM tag, without exporting all the main
+      // DICOM tags of the level (new in Orthanc 1.12.12)
+      bool CopyMainDicomTagIfExists(DicomMap& target,
+                                    ResourceType level,
+                                    const DicomTag& tag) const
+      {
+        return GetMainDicomTagsAtLevel(level).CopyTagIfExists(target, tag);
+      }
+
       void AddMetadata(ResourceType level,
                        MetadataType metadata,
                        const std::string& value,
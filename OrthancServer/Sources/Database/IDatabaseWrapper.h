@@ -40,6 +40,7 @@
 namespace Orthanc
 {
   class DatabaseDicomTagConstraints;
+  class MetricsRegistry;
   class ResourcesContent;
 
   class IDatabaseWrapper : public boost::noncopyable
@@ -60,6 +61,11 @@ namespace Orthanc
       bool hasKeyValueStoresSupport_;
       bool hasQueuesSupport_;
       bool hasReserveQueueValueSupport_;
+      bool hasResourceStatisticsSupport_;
+      bool hasKeysetPaginationSupport_;
+      bool hasChangesPruningSupport_;
+      bool hasFindExplainSupport_;
+      bool hasReadReplicasSupport_;
 
     public:
       Capabilities() :
@@ -74,7 +80,12 @@ namespace Orthanc
         hasAttachmentCustomDataSupport_(false),
         hasKeyValueStoresSupport_(false),
         hasQueuesSupport_(false),
-        hasReserveQueueValueSupport_(false)
+        hasReserveQueueValueSupport_(false),
+        hasResourceStatisticsSupport_(false),
+        hasKeysetPaginationSupport_(false),
+        hasChangesPruningSupport_(false),
+        hasFindExplainSupport_(false),
+        hasReadReplicasSupport_(false)
       {
       }
 
@@ -198,6 +209,56 @@ namespace Orthanc
         return hasReserveQueueValueSupport_;
       }
 
+      void SetResourceStatisticsSupport(bool value)
+      {
+        hasResourceStatisticsSupport_ = value;
+      }
+
+      bool HasResourceStatisticsSupport() const
+      {
+        return hasResourceStatisticsSupport_;
+      }
+
+      void SetKeysetPaginationSupport(bool value)
+      {
+        hasKeysetPaginationSupport_ = value;
+      }
+
+      bool HasKeysetPaginationSupport() const
+      {
+        return hasKeysetPaginationSupport_;
+      }
+
+      void SetChangesPruningSupport(bool value)
+      {
+        hasChangesPruningSupport_ = value;
+      }
+
+      bool HasChangesPruningSupport() const
+      {
+        return hasChangesPruningSupport_;
+      }
+
+      void SetFindExplainSupport(bool value)
+      {
+        hasFindExplainSupport_ = value;
+      }
+
+      bool HasFindExplainSupport() const
+      {
+        return hasFindExplainSupport_;
+      }
+
+      void SetReadReplicasSupport(bool value)
+      {
+        hasReadReplicasSupport_ = value;
+      }
+
+      bool HasReadReplicasSupport() const
+      {
+        return hasReadReplicasSupport_;
+      }
+
     };
 
 
@@ -494,6 +555,46 @@ namespace Orthanc
       virtual void AcknowledgeQueueValue(const std::string& queueId,
                                          uint64_t valueId) = 0;
 
+      // New in Orthanc 1.12.12, only if "HasResourceStatisticsSupport()".
+      // The counts and sizes cover the whole subtree of the resource,
+      // including the resource itself.
+      virtual void GetResourceStatistics(uint64_t& countStudies /* out */,
+                                         uint64_t& countSeries /* out */,
+                                         uint64_t& countInstances /* out */,
+                                         uint64_t& compressedSize /* out */,
+                                         uint64_t& uncompressedSize /* out */,
+                                         uint64_t& dicomCompressedSize /* out */,
+                                         uint64_t& dicomUncompressedSize /* out */,
+                                         int64_t id) = 0;
+
+      // New in Orthanc 1.12.12, only if "HasChangesPruningSupport()".
+      // Deletes at most "limit" of the oldest changes whose date is
+      // before "date" (in the ISO format of "ServerIndexChange"), and
+      // returns the number of deleted changes.
+      virtual uint64_t DeleteChangesBefore(const std::string& date,
+                                           uint32_t limit) = 0;
+
+      // New in Orthanc 1.12.12, only if "HasChangesPruningSupport()".
+      // Same as "DeleteChangesBefore()", for the exported resources.
+      virtual uint64_t DeleteExportedResourcesBefore(const std::string& date,
+                                                     uint32_t limit) = 0;
+
+      // New in Orthanc 1.12.12, only if "HasChangesPruningSupport()".
+      // Deletes at most "limit" of the oldest changes whose sequence
+      // number is below or equal to "seq", and returns the number of
+      // deleted changes.
+      virtual uint64_t DeleteChangesUpTo(int64_t seq,
+                                         uint32_t limit) = 0;
+
+      // New in Orthanc 1.12.12, only if "HasFindExplainSupport()".
+      // Describes how the database engine evaluates the lookup of
+      // "ExecuteFind()", without running it. The "target" object
+      // contains the generated "SQL" and its "Plan", in the format
+      // of the database engine.
+      virtual void ExplainFind(Json::Value& target,
+                               const FindRequest& request,
+                               const Capabilities& capabilities) = 0;
+
     };
 
 
@@ -557,6 +658,15 @@ namespace Orthanc
     virtual ITransaction* StartTransaction(TransactionType type,
                                            IDatabaseListener& listener) = 0;
 
+    /**
+     * Starts a read-only transaction that can be served by a replica
+     * of the database, whose replication lag must be below
+     * "maxStaleness" milliseconds. Only called if
+     * "HasReadReplicasSupport()" (new in Orthanc 1.12.12).
+     **/
+    virtual ITransaction* StartReplicaTransaction(IDatabaseListener& listener,
+                                                  unsigned int maxStaleness) = 0;
+
     virtual unsigned int GetDatabaseVersion() = 0;
 
     virtual void Upgrade(unsigned int targetVersion,
@@ -566,6 +676,10 @@ namespace Orthanc
 
     virtual uint64_t MeasureLatency() = 0;
 
+    // Publishes the metrics that are specific to the database engine
+    // (new in Orthanc 1.12.12)
+    virtual void PublishMetrics(MetricsRegistry& registry) = 0;
+
     // Returns "true" iff. the database engine supports the
     // simultaneous find and expansion of resources.
     virtual bool HasIntegratedFind() const = 0;
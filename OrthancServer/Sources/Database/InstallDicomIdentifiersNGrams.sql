@@ -0,0 +1,40 @@
+-- Orthanc - A Lightweight, RESTful DICOM Store
+-- Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+-- Department, University Hospital of Liege, Belgium
+-- Copyright (C) 2017-2023 Osimis S.A., Belgium
+-- Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+-- Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+--
+-- This program is free software: you can redistribute it and/or
+-- modify it under the terms of the GNU General Public License as
+-- published by the Free Software Foundation, either version 3 of the
+-- License, or (at your option) any later version.
+-- 
+-- This program is distributed in the hope that it will be useful, but
+-- WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+-- General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+-- New in Orthanc 1.12.12, only installed if "SQLiteNGramIndex" is enabled.
+--
+-- This table contains the distinct 3-grams of the values of some of
+-- the "DicomIdentifiers" (cf. "IsNGramIndexedTag()" in the C++ code),
+-- so that the wildcard lookups such as "*SMITH*" first select the
+-- resources that contain all the 3-grams of the pattern, before
+-- evaluating the "LIKE" predicate. This table is populated by the
+-- C++ code, as SQLite cannot split strings in a trigger.
+
+CREATE TABLE DicomIdentifiersNGrams(
+       id INTEGER REFERENCES Resources(internalId) ON DELETE CASCADE,
+       tagGroup INTEGER,
+       tagElement INTEGER,
+       ngram TEXT,
+       PRIMARY KEY(tagGroup, tagElement, ngram, id)
+       );
+
+-- Needed by the "ON DELETE CASCADE" clause
+CREATE INDEX DicomIdentifiersNGramsIndex ON DicomIdentifiersNGrams(id);
@@ -0,0 +1,165 @@
+-- Orthanc - A Lightweight, RESTful DICOM Store
+-- Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+-- Department, University Hospital of Liege, Belgium
+-- Copyright (C) 2017-2023 Osimis S.A., Belgium
+-- Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+-- Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+--
+-- This program is free software: you can redistribute it and/or
+-- modify it under the terms of the GNU General Public License as
+-- published by the Free Software Foundation, either version 3 of the
+-- License, or (at your option) any later version.
+-- 
+-- This program is distributed in the hope that it will be useful, but
+-- WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+-- General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+-- New in Orthanc 1.12.12
+--
+-- This table maintains, for each resource, the number of studies,
+-- series and instances in its subtree (the resource itself being
+-- included), together with the size of the attachments of this
+-- subtree. This makes the children counts and the "/statistics"
+-- routes O(1), instead of walking the hierarchy.
+--
+-- The triggers below never rely on the order of the cascading
+-- deletions: When a resource is deleted, only its ancestors that
+-- still exist in "Resources" are updated. The descendants that are
+-- removed by the "ON DELETE CASCADE" clause (as well as their
+-- attachments) cannot reach any surviving ancestor, as the resource
+-- that was deleted in the first place is already gone from
+-- "Resources": This resource propagates the totals of its whole
+-- subtree by itself.
+
+CREATE TABLE ResourcesStatistics(
+       id INTEGER PRIMARY KEY,
+       countStudies INTEGER,
+       countSeries INTEGER,
+       countInstances INTEGER,
+       compressedSize INTEGER,
+       uncompressedSize INTEGER,
+       dicomCompressedSize INTEGER,
+       dicomUncompressedSize INTEGER
+       );
+
+
+-- Populate the table for the resources that already exist, starting
+-- with the own attachments of each resource, then summing the levels
+-- from the bottom to the top of the hierarchy. The "1/2/3/4" values
+-- correspond to the "ResourceType" enumeration in C++, and "1" to
+-- "FileContentType_Dicom".
+
+INSERT INTO ResourcesStatistics
+  SELECT internalId, resourceType = 2, resourceType = 3, resourceType = 4,
+         IFNULL((SELECT SUM(compressedSize) FROM AttachedFiles WHERE AttachedFiles.id = internalId), 0),
+         IFNULL((SELECT SUM(uncompressedSize) FROM AttachedFiles WHERE AttachedFiles.id = internalId), 0),
+         IFNULL((SELECT SUM(compressedSize) FROM AttachedFiles WHERE AttachedFiles.id = internalId AND fileType = 1), 0),
+         IFNULL((SELECT SUM(uncompressedSize) FROM AttachedFiles WHERE AttachedFiles.id = internalId AND fileType = 1), 0)
+  FROM Resources;
+
+-- Series, then studies, then patients
+UPDATE ResourcesStatistics SET
+  countInstances = countInstances + IFNULL((SELECT SUM(child.countInstances) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  compressedSize = compressedSize + IFNULL((SELECT SUM(child.compressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  uncompressedSize = uncompressedSize + IFNULL((SELECT SUM(child.uncompressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  dicomCompressedSize = dicomCompressedSize + IFNULL((SELECT SUM(child.dicomCompressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  dicomUncompressedSize = dicomUncompressedSize + IFNULL((SELECT SUM(child.dicomUncompressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0)
+  WHERE id IN (SELECT internalId FROM Resources WHERE resourceType = 3);
+
+UPDATE ResourcesStatistics SET
+  countSeries = countSeries + IFNULL((SELECT SUM(child.countSeries) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  countInstances = countInstances + IFNULL((SELECT SUM(child.countInstances) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  compressedSize = compressedSize + IFNULL((SELECT SUM(child.compressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  uncompressedSize = uncompressedSize + IFNULL((SELECT SUM(child.uncompressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  dicomCompressedSize = dicomCompressedSize + IFNULL((SELECT SUM(child.dicomCompressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  dicomUncompressedSize = dicomUncompressedSize + IFNULL((SELECT SUM(child.dicomUncompressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0)
+  WHERE id IN (SELECT internalId FROM Resources WHERE resourceType = 2);
+
+UPDATE ResourcesStatistics SET
+  countStudies = countStudies + IFNULL((SELECT SUM(child.countStudies) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  countSeries = countSeries + IFNULL((SELECT SUM(child.countSeries) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  countInstances = countInstances + IFNULL((SELECT SUM(child.countInstances) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  compressedSize = compressedSize + IFNULL((SELECT SUM(child.compressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  uncompressedSize = uncompressedSize + IFNULL((SELECT SUM(child.uncompressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  dicomCompressedSize = dicomCompressedSize + IFNULL((SELECT SUM(child.dicomCompressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0),
+  dicomUncompressedSize = dicomUncompressedSize + IFNULL((SELECT SUM(child.dicomUncompressedSize) FROM ResourcesStatistics AS child INNER JOIN Resources ON Resources.internalId = child.id WHERE Resources.parentId = ResourcesStatistics.id), 0)
+  WHERE id IN (SELECT internalId FROM Resources WHERE resourceType = 1);
+
+
+CREATE TRIGGER ResourceStatisticsAdded
+AFTER INSERT ON Resources
+BEGIN
+  INSERT INTO ResourcesStatistics VALUES(new.internalId, new.resourceType = 2, new.resourceType = 3,
+                                         new.resourceType = 4, 0, 0, 0, 0);
+END;
+
+-- A resource is created without a parent, then attached to its
+-- parent once its own subtree is complete (cf. "ICreateInstance")
+CREATE TRIGGER ResourceStatisticsAttached
+AFTER UPDATE OF parentId ON Resources
+FOR EACH ROW WHEN old.parentId IS NULL AND new.parentId IS NOT NULL
+BEGIN
+  UPDATE ResourcesStatistics SET
+    countStudies = countStudies + (SELECT countStudies FROM ResourcesStatistics WHERE id = new.internalId),
+    countSeries = countSeries + (SELECT countSeries FROM ResourcesStatistics WHERE id = new.internalId),
+    countInstances = countInstances + (SELECT countInstances FROM ResourcesStatistics WHERE id = new.internalId),
+    compressedSize = compressedSize + (SELECT compressedSize FROM ResourcesStatistics WHERE id = new.internalId),
+    uncompressedSize = uncompressedSize + (SELECT uncompressedSize FROM ResourcesStatistics WHERE id = new.internalId),
+    dicomCompressedSize = dicomCompressedSize + (SELECT dicomCompressedSize FROM ResourcesStatistics WHERE id = new.internalId),
+    dicomUncompressedSize = dicomUncompressedSize + (SELECT dicomUncompressedSize FROM ResourcesStatistics WHERE id = new.internalId)
+  WHERE id IN (SELECT internalId FROM Resources WHERE internalId = new.parentId
+               UNION SELECT parentId FROM Resources WHERE internalId = new.parentId
+               UNION SELECT parentId FROM Resources WHERE internalId = (SELECT parentId FROM Resources WHERE internalId = new.parentId));
+END;
+
+CREATE TRIGGER ResourceStatisticsDeleted
+AFTER DELETE ON Resources
+BEGIN
+  UPDATE ResourcesStatistics SET
+    countStudies = countStudies - (SELECT countStudies FROM ResourcesStatistics WHERE id = old.internalId),
+    countSeries = countSeries - (SELECT countSeries FROM ResourcesStatistics WHERE id = old.internalId),
+    countInstances = countInstances - (SELECT countInstances FROM ResourcesStatistics WHERE id = old.internalId),
+    compressedSize = compressedSize - (SELECT compressedSize FROM ResourcesStatistics WHERE id = old.internalId),
+    uncompressedSize = uncompressedSize - (SELECT uncompressedSize FROM ResourcesStatistics WHERE id = old.internalId),
+    dicomCompressedSize = dicomCompressedSize - (SELECT dicomCompressedSize FROM ResourcesStatistics WHERE id = old.internalId),
+    dicomUncompressedSize = dicomUncompressedSize - (SELECT dicomUncompressedSize FROM ResourcesStatistics WHERE id = old.internalId)
+  WHERE id IN (SELECT internalId FROM Resources WHERE internalId = old.parentId
+               UNION SELECT parentId FROM Resources WHERE internalId = old.parentId
+               UNION SELECT parentId FROM Resources WHERE internalId = (SELECT parentId FROM Resources WHERE internalId = old.parentId));
+  DELETE FROM ResourcesStatistics WHERE id = old.internalId;
+END;
+
+CREATE TRIGGER AttachedFileStatisticsAdded
+AFTER INSERT ON AttachedFiles
+BEGIN
+  UPDATE ResourcesStatistics SET
+    compressedSize = compressedSize + new.compressedSize,
+    uncompressedSize = uncompressedSize + new.uncompressedSize,
+    dicomCompressedSize = dicomCompressedSize + (CASE WHEN new.fileType = 1 THEN new.compressedSize ELSE 0 END),
+    dicomUncompressedSize = dicomUncompressedSize + (CASE WHEN new.fileType = 1 THEN new.uncompressedSize ELSE 0 END)
+  WHERE id IN (SELECT internalId FROM Resources WHERE internalId = new.id
+               UNION SELECT parentId FROM Resources WHERE internalId = new.id
+               UNION SELECT parentId FROM Resources WHERE internalId = (SELECT parentId FROM Resources WHERE internalId = new.id)
+               UNION SELECT parentId FROM Resources WHERE internalId = (SELECT parentId FROM Resources WHERE internalId =
+                                                                        (SELECT parentId FROM Resources WHERE internalId = new.id)));
+END;
+
+CREATE TRIGGER AttachedFileStatisticsDeleted
+AFTER DELETE ON AttachedFiles
+BEGIN
+  UPDATE ResourcesStatistics SET
+    compressedSize = compressedSize - old.compressedSize,
+    uncompressedSize = uncompressedSize - old.uncompressedSize,
+    dicomCompressedSize = dicomCompressedSize - (CASE WHEN old.fileType = 1 THEN old.compressedSize ELSE 0 END),
+    dicomUncompressedSize = dicomUncompressedSize - (CASE WHEN old.fileType = 1 THEN old.uncompressedSize ELSE 0 END)
+  WHERE id IN (SELECT internalId FROM Resources WHERE internalId = old.id
+               UNION SELECT parentId FROM Resources WHERE internalId = old.id
+               UNION SELECT parentId FROM Resources WHERE internalId = (SELECT parentId FROM Resources WHERE internalId = old.id)
+               UNION SELECT parentId FROM Resources WHERE internalId = (SELECT parentId FROM Resources WHERE internalId =
+                                                                        (SELECT parentId FROM Resources WHERE internalId = old.id)));
+END;
@@ -0,0 +1,46 @@
+-- Orthanc - A Lightweight, RESTful DICOM Store
+-- Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+-- Department, University Hospital of Liege, Belgium
+-- Copyright (C) 2017-2023 Osimis S.A., Belgium
+-- Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+-- Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+--
+-- This program is free software: you can redistribute it and/or
+-- modify it under the terms of the GNU General Public License as
+-- published by the Free Software Foundation, either version 3 of the
+-- License, or (at your option) any later version.
+-- 
+-- This program is distributed in the hope that it will be useful, but
+-- WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+-- General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+-- New in Orthanc 1.12.12
+--
+-- Track the number of resources of each level in the keys 2 to 5 of
+-- the "GlobalIntegers" table (i.e. "1 + resourceType"), next to the
+-- total size of the attachments, which makes "/statistics" O(1).
+
+INSERT INTO GlobalProperties VALUES (8, 1);  -- GlobalProperty_SQLiteHasResourcesCount
+
+INSERT OR REPLACE INTO GlobalIntegers SELECT 2, COUNT(*) FROM Resources WHERE resourceType = 1;
+INSERT OR REPLACE INTO GlobalIntegers SELECT 3, COUNT(*) FROM Resources WHERE resourceType = 2;
+INSERT OR REPLACE INTO GlobalIntegers SELECT 4, COUNT(*) FROM Resources WHERE resourceType = 3;
+INSERT OR REPLACE INTO GlobalIntegers SELECT 5, COUNT(*) FROM Resources WHERE resourceType = 4;
+
+CREATE TRIGGER ResourceIncrementCount
+AFTER INSERT ON Resources
+BEGIN
+  UPDATE GlobalIntegers SET value = value + 1 WHERE key = 1 + new.resourceType;
+END;
+
+CREATE TRIGGER ResourceDecrementCount
+AFTER DELETE ON Resources
+BEGIN
+  UPDATE GlobalIntegers SET value = value - 1 WHERE key = 1 + old.resourceType;
+END;
@@ -0,0 +1,380 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "KeyValueStoresCache.h"
+
+#include "../../../OrthancFramework/Sources/Cache/LeastRecentlyUsedIndex.h"
+#include "../../../OrthancFramework/Sources/OrthancException.h"
+
+#include <cassert>
+
+
+namespace Orthanc
+{
+  class KeyValueStoresCache::Store : public boost::noncopyable
+  {
+  private:
+    struct Entry
+    {
+      bool         exists_;
+      std::string  value_;
+    };
+
+    typedef std::map<std::string, Entry>  Content;
+
+    size_t                                 maximumSize_;
+    size_t                                 currentSize_;
+    uint64_t                               generation_;
+    unsigned int                           pendingWrites_;
+    Content                                content_;
+    LeastRecentlyUsedIndex<std::string>    lru_;
+
+    static size_t GetEntrySize(const std::string& key,
+                               const Entry& entry)
+    {
+      return key.size() + entry.value_.size();
+    }
+
+    void RemoveOldest()
+    {
+      const std::string oldest = lru_.RemoveOldest();
+
+      Content::iterator found = content_.find(oldest);
+      assert(found != content_.end());
+      assert(currentSize_ >= GetEntrySize(oldest, found->second));
+
+      currentSize_ -= GetEntrySize(oldest, found->second);
+      content_.erase(found);
+    }
+
+  public:
+    Store() :
+      maximumSize_(0),
+      currentSize_(0),
+      generation_(0),
+      pendingWrites_(0)
+    {
+    }
+
+    bool IsEnabled() const
+    {
+      return maximumSize_ != 0;
+    }
+
+    void SetMaximumSize(size_t maximumSize)
+    {
+      maximumSize_ = maximumSize;
+
+      while (currentSize_ > maximumSize_)
+      {
+        RemoveOldest();
+      }
+    }
+
+    size_t GetCurrentSize() const
+    {
+      return currentSize_;
+    }
+
+    uint64_t GetGeneration() const
+    {
+      return generation_;
+    }
+
+    unsigned int GetPendingWrites() const
+    {
+      return pendingWrites_;
+    }
+
+    uint64_t StartWrite()
+    {
+      pendingWrites_++;
+      generation_++;
+      return generation_;
+    }
+
+    void EndWrite()
+    {
+      assert(pendingWrites_ > 0);
+      pendingWrites_--;
+      generation_++;
+    }
+
+    void Remove(const std::string& key)
+    {
+      Content::iterator found = content_.find(key);
+      if (found != content_.end())
+      {
+        assert(currentSize_ >= GetEntrySize(key, found->second));
+        currentSize_ -= GetEntrySize(key, found->second);
+        content_.erase(found);
+        lru_.Invalidate(key);
+      }
+    }
+
+    void Insert(const std::string& key,
+                bool exists,
+                const std::string& value)
+    {
+      Remove(key);
+
+      Entry entry;
+      entry.exists_ = exists;
+      entry.value_ = value;
+
+      const size_t size = GetEntrySize(key, entry);
+      if (size > maximumSize_)
+      {
+        return;  // Too large to be cached
+      }
+
+      while (currentSize_ + size > maximumSize_)
+      {
+        RemoveOldest();
+      }
+
+      content_[key] = entry;
+      lru_.Add(key);
+      currentSize_ += size;
+    }
+
+    bool Lookup(bool& exists,
+                std::string& value,
+                const std::string& key)
+    {
+      Content::const_iterator found = content_.find(key);
+      if (found == content_.end())
+      {
+        return false;
+      }
+      else
+      {
+        lru_.MakeMostRecent(key);
+        exists = found->second.exists_;
+        value = found->second.value_;
+        return true;
+      }
+    }
+  };
+
+
+  KeyValueStoresCache::Transaction::Transaction(KeyValueStoresCache& cache,
+                                                const std::string& storeId) :
+    cache_(cache),
+    storeId_(storeId),
+    isCommitted_(false)
+  {
+    boost::mutex::scoped_lock lock(cache_.mutex_);
+
+    Stores::iterator found = cache_.stores_.find(storeId);
+    if (found == cache_.stores_.end())
+    {
+      // Also track the writes to the stores that are not cached yet,
+      // in the case the cache would be enabled during this transaction
+      found = cache_.stores_.insert(std::make_pair(storeId, new KeyValueStoresCache::Store)).first;
+    }
+
+    generation_ = found->second->StartWrite();
+  }
+
+
+  KeyValueStoresCache::Transaction::~Transaction()
+  {
+    try
+    {
+      boost::mutex::scoped_lock lock(cache_.mutex_);
+
+      Stores::iterator found = cache_.stores_.find(storeId_);
+      assert(found != cache_.stores_.end());
+
+      KeyValueStoresCache::Store& store = *found->second;
+
+      if (isCommitted_ &&
+          store.IsEnabled() &&
+          store.GetGeneration() == generation_ &&
+          store.GetPendingWrites() == 1)
+      {
+        // No concurrent write on this store: The cache can be updated
+        for (Values::const_iterator it = values_.begin(); it != values_.end(); ++it)
+        {
+          store.Insert(it->first, it->second.exists_, it->second.value_);
+        }
+      }
+      else
+      {
+        for (Values::const_iterator it = values_.begin(); it != values_.end(); ++it)
+        {
+          store.Remove(it->first);
+        }
+      }
+
+      for (std::set<std::string>::const_iterator it = invalidated_.begin(); it != invalidated_.end(); ++it)
+      {
+        store.Remove(*it);
+      }
+
+      store.EndWrite();
+    }
+    catch (...)
+    {
+      // Don't throw exceptions in destructors
+    }
+  }
+
+
+  void KeyValueStoresCache::Transaction::Store(const std::string& key,
+                                               const void* value,
+                                               size_t valueSize)
+  {
+    {
+      boost::mutex::scoped_lock lock(cache_.mutex_);
+      cache_.stores_[storeId_]->Remove(key);
+    }
+
+    Value& item = values_[key];
+    item.exists_ = true;
+
+    if (valueSize == 0)
+    {
+      item.value_.clear();
+    }
+    else
+    {
+      item.value_.assign(reinterpret_cast<const char*>(value), valueSize);
+    }
+
+    invalidated_.erase(key);
+  }
+
+
+  void KeyValueStoresCache::Transaction::Delete(const std::string& key)
+  {
+    {
+      boost::mutex::scoped_lock lock(cache_.mutex_);
+      cache_.stores_[storeId_]->Remove(key);
+    }
+
+    Value& item = values_[key];
+    item.exists_ = false;
+    item.value_.clear();
+    invalidated_.erase(key);
+  }
+
+
+  void KeyValueStoresCache::Transaction::Invalidate(const std::string& key)
+  {
+    {
+      boost::mutex::scoped_lock lock(cache_.mutex_);
+      cache_.stores_[storeId_]->Remove(key);
+    }
+
+    values_.erase(key);
+    invalidated_.insert(key);
+  }
+
+
+  KeyValueStoresCache::~KeyValueStoresCache()
+  {
+    for (Stores::iterator it = stores_.begin(); it != stores_.end(); ++it)
+    {
+      assert(it->second != NULL);
+      delete it->second;
+    }
+  }
+
+
+  void KeyValueStoresCache::SetMaximumSize(const std::string& storeId,
+                                           size_t maximumSize)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Stores::iterator found = stores_.find(storeId);
+    if (found == stores_.end())
+    {
+      found = stores_.insert(std::make_pair(storeId, new Store)).first;
+    }
+
+    found->second->SetMaximumSize(maximumSize);
+  }
+
+
+  bool KeyValueStoresCache::Lookup(bool& exists,
+                                   std::string& value,
+                                   uint64_t& generation,
+                                   const std::string& storeId,
+                                   const std::string& key)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Stores::iterator found = stores_.find(storeId);
+    if (found == stores_.end() ||
+        !found->second->IsEnabled())
+    {
+      generation = 0;
+      return false;
+    }
+    else
+    {
+      generation = found->second->GetGeneration();
+      return found->second->Lookup(exists, value, key);
+    }
+  }
+
+
+  void KeyValueStoresCache::Add(const std::string& storeId,
+                                const std::string& key,
+                                bool exists,
+                                const std::string& value,
+                                uint64_t generation)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Stores::iterator found = stores_.find(storeId);
+    if (found != stores_.end() &&
+        found->second->IsEnabled() &&
+        found->second->GetGeneration() == generation &&
+        found->second->GetPendingWrites() == 0)
+    {
+      found->second->Insert(key, exists, (exists ? value : std::string()));
+    }
+  }
+
+
+  size_t KeyValueStoresCache::GetCurrentSize(const std::string& storeId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Stores::const_iterator found = stores_.find(storeId);
+    if (found == stores_.end())
+    {
+      return 0;
+    }
+    else
+    {
+      return found->second->GetCurrentSize();
+    }
+  }
+}
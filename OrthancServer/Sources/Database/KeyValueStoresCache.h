@@ -0,0 +1,127 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <string>
+
+namespace Orthanc
+{
+  /**
+   * Write-through cache of the values of the key-value stores (new in
+   * Orthanc 1.12.12). The cache is only enabled for the stores that
+   * are explicitly configured with "SetMaximumSize()", and it is only
+   * coherent if such a store is not written by another Orthanc server
+   * sharing the same database.
+   *
+   * Each write to a store is enclosed in a "Transaction" object. Its
+   * values are only put into the cache if no other transaction on
+   * the same store has started or completed in the meantime;
+   * otherwise, the touched keys are simply evicted. Similarly, a
+   * value that is read from the database is only added to the cache
+   * if no write has happened since the lookup ("generation" counter).
+   **/
+  class KeyValueStoresCache : public boost::noncopyable
+  {
+  private:
+    class Store;
+
+    typedef std::map<std::string, Store*>  Stores;
+
+    boost::mutex  mutex_;
+    Stores        stores_;
+
+  public:
+    class Transaction : public boost::noncopyable
+    {
+    private:
+      struct Value
+      {
+        bool         exists_;
+        std::string  value_;
+      };
+
+      typedef std::map<std::string, Value>  Values;
+
+      KeyValueStoresCache&  cache_;
+      std::string           storeId_;
+      bool                  isCommitted_;
+      uint64_t              generation_;
+      Values                values_;
+      std::set<std::string> invalidated_;
+
+    public:
+      Transaction(KeyValueStoresCache& cache,
+                  const std::string& storeId);
+
+      ~Transaction();
+
+      void Store(const std::string& key,
+                 const void* value,
+                 size_t valueSize);
+
+      void Delete(const std::string& key);
+
+      // The new value of the key is unknown
+      void Invalidate(const std::string& key);
+
+      // To be called once the database transaction is committed
+      void Commit()
+      {
+        isCommitted_ = true;
+      }
+    };
+
+    ~KeyValueStoresCache();
+
+    // "maximumSize == 0" disables the cache of this store
+    void SetMaximumSize(const std::string& storeId,
+                        size_t maximumSize);
+
+    // Returns "false" if the key is not in the cache, in which case
+    // "generation" must be provided to "Add()" once the value is read
+    // from the database. Otherwise, "exists" tells whether the key is
+    // present in the store.
+    bool Lookup(bool& exists /* out */,
+                std::string& value /* out */,
+                uint64_t& generation /* out */,
+                const std::string& storeId,
+                const std::string& key);
+
+    void Add(const std::string& storeId,
+             const std::string& key,
+             bool exists,
+             const std::string& value,
+             uint64_t generation);
+
+    // For statistics and unit tests
+    size_t GetCurrentSize(const std::string& storeId);
+  };
+}
@@ -157,6 +157,26 @@ ${ADD_TIMEOUT_TO_QUEUES}              -- equivalent to AddTimeoutToQueues.sql
 ${INSTALL_DICOM_IDENTIFIERS_INDEX_3}  -- equivalent to InstallDicomIdentifiersIndex3.sql
 
 
+-- new in Orthanc 1.12.12 ------------------------ equivalent to InstallResourcesStatistics.sql
+${INSTALL_RESOURCES_STATISTICS}
+
+
+-- new in Orthanc 1.12.12 ------------------------ equivalent to InstallTrackResourcesCount.sql
+${INSTALL_TRACK_RESOURCES_COUNT}
+
+
+-- new in Orthanc 1.12.12 ------------------------ equivalent to InstallMetadataValuesIndex.sql
+${INSTALL_METADATA_VALUES_INDEX}
+
+
+-- new in Orthanc 1.12.12 ------------------------ equivalent to InstallLabelsIndex3.sql
+${INSTALL_LABELS_INDEX_3}
+
+
+-- new in Orthanc 1.12.12 ------------------------ equivalent to InstallChangesTypeIndex.sql
+${INSTALL_CHANGES_TYPE_INDEX}
+
+
 -- Track the fact that the "revision" column exists in the "Metadata" and "AttachedFiles"
 -- tables, and that the "customData" column exists in the "AttachedFiles" table
 INSERT INTO GlobalProperties VALUES (7, 1);  -- GlobalProperty_SQLiteHasCustomDataAndRevision
@@ -26,6 +26,7 @@
 
 #include "../../../OrthancFramework/Sources/DicomFormat/DicomArray.h"
 #include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/MetricsRegistry.h"
 #include "../../../OrthancFramework/Sources/SQLite/Transaction.h"
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
 #include "../Search/ISqlLookupFormatter.h"
@@ -42,6 +43,7 @@
 #include <stdio.h>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
 
 
 /**
@@ -89,6 +91,26 @@ namespace Orthanc
     return sql;
   }
 
+  // Column of the "ResourcesStatistics" table that counts the
+  // descendants of a resource at the given level (new in Orthanc 1.12.12)
+  static std::string GetStatisticsCountColumn(ResourceType level)
+  {
+    switch (level)
+    {
+      case ResourceType_Study:
+        return "countStudies";
+
+      case ResourceType_Series:
+        return "countSeries";
+
+      case ResourceType_Instance:
+        return "countInstances";
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
   static std::string JoinChanges(const std::set<ChangeType>& changeTypes)
   {
     std::set<std::string> changeTypesString;
@@ -103,15 +125,129 @@ namespace Orthanc
     return joinedChangesTypes;
   }
 
+  // The identifiers that hold free text and are commonly searched
+  // with wildcards, and whose n-grams are indexed if the
+  // "DicomIdentifiersNGrams" table is enabled. The UIDs and the dates
+  // are left out, as they would make the table much larger for no
+  // benefit. New in Orthanc 1.12.12.
+  static const DicomTag NGRAM_INDEXED_TAGS[] =
+  {
+    DICOM_TAG_PATIENT_NAME,
+    DICOM_TAG_PATIENT_ID,
+    DICOM_TAG_ACCESSION_NUMBER,
+    DICOM_TAG_STUDY_DESCRIPTION
+  };
+
+  static const size_t NGRAM_INDEXED_TAGS_COUNT = sizeof(NGRAM_INDEXED_TAGS) / sizeof(DicomTag);
+
+  static bool IsNGramIndexedTag(const DicomTag& tag)
+  {
+    for (size_t i = 0; i < NGRAM_INDEXED_TAGS_COUNT; i++)
+    {
+      if (tag == NGRAM_INDEXED_TAGS[i])
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  static void InsertIdentifierNGrams(SQLite::Connection& db,
+                                     int64_t id,
+                                     const DicomTag& tag,
+                                     const std::string& value)
+  {
+    std::set<std::string> ngrams;
+    ISqlLookupFormatter::ExtractNGrams(ngrams, value, false);
+
+    for (std::set<std::string>::const_iterator it = ngrams.begin(); it != ngrams.end(); ++it)
+    {
+      SQLite::Statement s(db, SQLITE_FROM_HERE, "INSERT INTO DicomIdentifiersNGrams (id, tagGroup, tagElement, ngram) VALUES(?, ?, ?, ?)");
+      s.BindInt64(0, id);
+      s.BindInt(1, tag.GetGroup());
+      s.BindInt(2, tag.GetElement());
+      s.BindString(3, *it);
+      s.Run();
+    }
+  }
+
+
   class SQLiteDatabaseWrapper::LookupFormatter : public ISqlLookupFormatter
   {
   private:
-    std::list<std::string>  values_;
+    /**
+     * All the values, including the limits, are bound as parameters,
+     * so that the generated SQL only depends on the shape of the
+     * query and its prepared statement is reused from the cache of
+     * the SQLite connection.
+     **/
+    class Parameter
+    {
+    private:
+      bool         isInteger_;
+      std::string  string_;
+      int64_t      integer_;
+
+    public:
+      explicit Parameter(const std::string& value) :
+        isInteger_(false),
+        string_(value),
+        integer_(0)
+      {
+      }
+
+      explicit Parameter(int64_t value) :
+        isInteger_(true),
+        integer_(value)
+      {
+      }
+
+      void Bind(SQLite::Statement& statement,
+                int pos) const
+      {
+        if (isInteger_)
+        {
+          statement.BindInt64(pos, integer_);
+        }
+        else
+        {
+          statement.BindString(pos, string_);
+        }
+      }
+
+      void Format(Json::Value& target) const
+      {
+        if (isInteger_)
+        {
+          target.append(static_cast<Json::Int64>(integer_));
+        }
+        else
+        {
+          target.append(string_);
+        }
+      }
+    };
+
+    std::list<Parameter>  parameters_;
+    bool                  hasNGramIndex_;
 
   public:
+    explicit LookupFormatter(bool hasNGramIndex) :
+      hasNGramIndex_(hasNGramIndex)
+    {
+    }
+
     virtual std::string GenerateParameter(const std::string& value) ORTHANC_OVERRIDE
     {
-      values_.push_back(value);
+      parameters_.push_back(Parameter(value));
+      return "?";
+    }
+
+    virtual std::string GenerateIntegerParameter(int64_t value) ORTHANC_OVERRIDE
+    {
+      parameters_.push_back(Parameter(value));
       return "?";
     }
     
@@ -131,7 +267,8 @@ namespace Orthanc
 
       if (count > 0)
       {
-        sql += " LIMIT " + boost::lexical_cast<std::string>(count);
+        sql += " LIMIT ?";
+        parameters_.push_back(Parameter(static_cast<int64_t>(count)));
       }
 
       if (since > 0)
@@ -141,7 +278,8 @@ namespace Orthanc
           sql += " LIMIT -1";  // In SQLite, "OFFSET" cannot appear without "LIMIT"
         }
 
-        sql += " OFFSET " + boost::lexical_cast<std::string>(since);
+        sql += " OFFSET ?";
+        parameters_.push_back(Parameter(static_cast<int64_t>(since)));
       }
       
       return sql;
@@ -152,14 +290,35 @@ namespace Orthanc
       return false;
     }
 
+    virtual bool HasNGramIndex(const DicomTag& tag) const ORTHANC_OVERRIDE
+    {
+      return hasNGramIndex_ && IsNGramIndexedTag(tag);
+    }
+
+    virtual bool HasMetadataValuesIndex() const ORTHANC_OVERRIDE
+    {
+      return true;  // The "value" column uses the default "BINARY" collation
+    }
+
     void Bind(SQLite::Statement& statement) const
     {
       int pos = 0;
       
-      for (std::list<std::string>::const_iterator
-             it = values_.begin(); it != values_.end(); ++it, pos++)
+      for (std::list<Parameter>::const_iterator
+             it = parameters_.begin(); it != parameters_.end(); ++it, pos++)
+      {
+        it->Bind(statement, pos);
+      }
+    }
+
+    void FormatParameters(Json::Value& target) const
+    {
+      target = Json::arrayValue;
+
+      for (std::list<Parameter>::const_iterator
+             it = parameters_.begin(); it != parameters_.end(); ++it)
       {
-        statement.BindString(pos, *it);
+        it->Format(target);
       }
     }
   };
@@ -314,6 +473,41 @@ namespace Orthanc
     }
 
 
+    uint64_t DeleteRowsBefore(const std::string& tableName,
+                              const std::string& date,
+                              uint32_t limit)
+    {
+      /**
+       * The dates grow together with the "seq" primary key, so the
+       * oldest rows are found by walking the primary key, which
+       * avoids an index on the "date" column.
+       **/
+      int64_t lastSeq = 0;
+      uint64_t count = 0;
+
+      {
+        SQLite::Statement s(db_, "SELECT seq, date FROM " + tableName + " ORDER BY seq LIMIT ?");
+        s.BindInt64(0, limit);
+
+        while (s.Step() &&
+               s.ColumnString(1) < date)
+        {
+          lastSeq = s.ColumnInt64(0);
+          count++;
+        }
+      }
+
+      if (count > 0)
+      {
+        SQLite::Statement s(db_, "DELETE FROM " + tableName + " WHERE seq <= ?");
+        s.BindInt64(0, lastSeq);
+        s.Run();
+      }
+
+      return count;
+    }
+
+
     void GetChangesInternal(std::list<ServerIndexChange>& target,
                             bool& done,
                             SQLite::Statement& s,
@@ -401,18 +595,22 @@ namespace Orthanc
     IDatabaseListener&         listener_;
     SignalRemainingAncestor&   signalRemainingAncestor_;
     bool                       hasFastTotalSize_;
+    bool                       coalesceChanges_;
 
   public:
     TransactionBase(boost::recursive_mutex& mutex,
                     SQLite::Connection& db,
                     IDatabaseListener& listener,
                     SignalRemainingAncestor& signalRemainingAncestor,
-                    bool hasFastTotalSize) :
-      UnitTestsTransaction(db),
+                    bool hasFastTotalSize,
+                    bool hasNGramIndex,
+                    bool coalesceChanges) :
+      UnitTestsTransaction(db, hasNGramIndex),
       lock_(mutex),
       listener_(listener),
       signalRemainingAncestor_(signalRemainingAncestor),
-      hasFastTotalSize_(hasFastTotalSize)
+      hasFastTotalSize_(hasFastTotalSize),
+      coalesceChanges_(coalesceChanges)
     {
     }
 
@@ -450,7 +648,7 @@ namespace Orthanc
                                       LabelsConstraint labelsConstraint,
                                       uint32_t limit) ORTHANC_OVERRIDE
     {
-      LookupFormatter formatter;
+      LookupFormatter formatter(hasNGramIndex_);
 
       std::string sql;
       LookupFormatter::Apply(sql, formatter, lookup, queryLevel, labels, labelsConstraint, limit);
@@ -529,7 +727,7 @@ namespace Orthanc
                               const FindRequest& request,
                               const Capabilities& capabilities) ORTHANC_OVERRIDE
     {
-      LookupFormatter formatter;
+      LookupFormatter formatter(hasNGramIndex_);
       std::string sql;
 
       std::string lookupSql;
@@ -545,6 +743,47 @@ namespace Orthanc
     }
 
 
+    virtual void ExplainFind(Json::Value& target,
+                             const FindRequest& request,
+                             const Capabilities& capabilities) ORTHANC_OVERRIDE
+    {
+      LookupFormatter formatter(hasNGramIndex_);
+
+      std::string sql;
+      LookupFormatter::Apply(sql, formatter, request);
+
+      target = Json::objectValue;
+      target["SQL"] = sql;
+      formatter.FormatParameters(target["Parameters"]);
+
+      // The columns of "EXPLAIN QUERY PLAN" are "id", "parent",
+      // "notused" and "detail", the parents being listed before
+      // their children
+      const std::string explain = "EXPLAIN QUERY PLAN " + sql;
+      SQLite::Statement s(db_, explain);
+      formatter.Bind(s);
+
+      std::map<int, unsigned int> depths;
+      Json::Value plan = Json::arrayValue;
+
+      while (s.Step())
+      {
+        unsigned int depth = 0;
+
+        std::map<int, unsigned int>::const_iterator parent = depths.find(s.ColumnInt(1));
+        if (parent != depths.end())
+        {
+          depth = parent->second + 1;
+        }
+
+        depths[s.ColumnInt(0)] = depth;
+        plan.append(std::string(2 * depth, ' ') + s.ColumnString(3));
+      }
+
+      target["Plan"] = plan;
+    }
+
+
     static void ReadCustomData(FileInfo& info,
                                SQLite::Statement& statement,
                                int column)
@@ -562,7 +801,7 @@ namespace Orthanc
                              const FindRequest& request,
                              const Capabilities& capabilities) ORTHANC_OVERRIDE
     {
-      LookupFormatter formatter;
+      LookupFormatter formatter(hasNGramIndex_);
       std::string sql;
       const ResourceType requestLevel = request.GetLevel();
 
@@ -996,13 +1235,13 @@ namespace Orthanc
                "  NULL AS c4_string2, "
                "  NULL AS c5_string3, "
                "  NULL AS c6_string4, "
-               "  COUNT(*) AS c7_int1, "
+               "  statistics." + GetStatisticsCountColumn(static_cast<ResourceType>(requestLevel + 1)) + " AS c7_int1, "
                "  NULL AS c8_int2, "
                "  NULL AS c9_int3, "
                "  NULL AS c10_big_int1, "
                "  NULL AS c11_big_int2 "
                "FROM Lookup "
-               "  INNER JOIN Resources childLevel ON Lookup.internalId = childLevel.parentId GROUP BY Lookup.internalId ";
+               "  INNER JOIN ResourcesStatistics statistics ON Lookup.internalId = statistics.id ";
       }
 
       // need grandchildren identifiers ?
@@ -1038,14 +1277,13 @@ namespace Orthanc
               "  NULL AS c4_string2, "
               "  NULL AS c5_string3, "
               "  NULL AS c6_string4, "
-              "  COUNT(*) AS c7_int1, "
+              "  statistics." + GetStatisticsCountColumn(static_cast<ResourceType>(requestLevel + 2)) + " AS c7_int1, "
               "  NULL AS c8_int2, "
               "  NULL AS c9_int3, "
               "  NULL AS c10_big_int1, "
               "  NULL AS c11_big_int2 "
               "FROM Lookup "
-              "INNER JOIN Resources childLevel ON Lookup.internalId = childLevel.parentId "
-              "INNER JOIN Resources grandChildLevel ON childLevel.internalId = grandChildLevel.parentId GROUP BY Lookup.internalId ";
+              "INNER JOIN ResourcesStatistics statistics ON Lookup.internalId = statistics.id ";
       }
 
       // need grandgrandchildren identifiers ?
@@ -1080,15 +1318,13 @@ namespace Orthanc
               "  NULL AS c4_string2, "
               "  NULL AS c5_string3, "
               "  NULL AS c6_string4, "
-              "  COUNT(*) AS c7_int1, "
+              "  statistics.countInstances AS c7_int1, "
               "  NULL AS c8_int2, "
               "  NULL AS c9_int3, "
               "  NULL AS c10_big_int1, "
               "  NULL AS c11_big_int2 "
               "FROM Lookup "
-              "INNER JOIN Resources childLevel ON Lookup.internalId = childLevel.parentId "
-              "INNER JOIN Resources grandChildLevel ON childLevel.internalId = grandChildLevel.parentId "
-              "INNER JOIN Resources grandGrandChildLevel ON grandChildLevel.internalId = grandGrandChildLevel.parentId GROUP BY Lookup.internalId ";
+              "INNER JOIN ResourcesStatistics statistics ON Lookup.internalId = statistics.id ";
       }
 
 
@@ -1328,6 +1564,13 @@ namespace Orthanc
         s.Run();
       }
 
+      if (hasNGramIndex_)
+      {
+        SQLite::Statement s(db_, SQLITE_FROM_HERE, "DELETE FROM DicomIdentifiersNGrams WHERE id=?");
+        s.BindInt64(0, id);
+        s.Run();
+      }
+
       {
         SQLite::Statement s(db_, SQLITE_FROM_HERE, "DELETE FROM MainDicomTags WHERE id=?");
         s.BindInt64(0, id);
@@ -1670,6 +1913,19 @@ namespace Orthanc
 
     virtual uint64_t GetResourcesCount(ResourceType resourceType) ORTHANC_OVERRIDE
     {
+      if (hasFastTotalSize_)
+      {
+        // New in Orthanc 1.12.12: The number of resources is tracked
+        // by triggers, next to the total size of the attachments
+        SQLite::Statement s(db_, SQLITE_FROM_HERE, "SELECT value FROM GlobalIntegers WHERE key=?");
+        s.BindInt(0, 1 + static_cast<int>(resourceType));
+
+        if (s.Step())
+        {
+          return static_cast<uint64_t>(s.ColumnInt64(0));
+        }
+      }
+
       SQLite::Statement s(db_, SQLITE_FROM_HERE, 
                           "SELECT COUNT(*) FROM Resources WHERE resourceType=?");
       s.BindInt(0, resourceType);
@@ -1742,6 +1998,82 @@ namespace Orthanc
     }
 
 
+    virtual void GetResourceStatistics(uint64_t& countStudies,
+                                       uint64_t& countSeries,
+                                       uint64_t& countInstances,
+                                       uint64_t& compressedSize,
+                                       uint64_t& uncompressedSize,
+                                       uint64_t& dicomCompressedSize,
+                                       uint64_t& dicomUncompressedSize,
+                                       int64_t id) ORTHANC_OVERRIDE
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE,
+                          "SELECT countStudies, countSeries, countInstances, compressedSize, uncompressedSize, "
+                          "dicomCompressedSize, dicomUncompressedSize FROM ResourcesStatistics WHERE id=?");
+      s.BindInt64(0, id);
+
+      if (s.Step())
+      {
+        countStudies = static_cast<uint64_t>(s.ColumnInt64(0));
+        countSeries = static_cast<uint64_t>(s.ColumnInt64(1));
+        countInstances = static_cast<uint64_t>(s.ColumnInt64(2));
+        compressedSize = static_cast<uint64_t>(s.ColumnInt64(3));
+        uncompressedSize = static_cast<uint64_t>(s.ColumnInt64(4));
+        dicomCompressedSize = static_cast<uint64_t>(s.ColumnInt64(5));
+        dicomUncompressedSize = static_cast<uint64_t>(s.ColumnInt64(6));
+      }
+      else
+      {
+        throw OrthancException(ErrorCode_UnknownResource);
+      }
+    }
+
+
+    virtual uint64_t DeleteChangesBefore(const std::string& date,
+                                         uint32_t limit) ORTHANC_OVERRIDE
+    {
+      return DeleteRowsBefore("Changes", date, limit);
+    }
+
+
+    virtual uint64_t DeleteExportedResourcesBefore(const std::string& date,
+                                                   uint32_t limit) ORTHANC_OVERRIDE
+    {
+      return DeleteRowsBefore("ExportedResources", date, limit);
+    }
+
+
+    virtual uint64_t DeleteChangesUpTo(int64_t seq,
+                                       uint32_t limit) ORTHANC_OVERRIDE
+    {
+      // Range delete along the primary key, as in "DeleteRowsBefore()"
+      int64_t lastSeq = 0;
+      uint64_t count = 0;
+
+      {
+        SQLite::Statement s(db_, SQLITE_FROM_HERE,
+                            "SELECT COUNT(*), MAX(seq) FROM (SELECT seq FROM Changes WHERE seq<=? ORDER BY seq LIMIT ?)");
+        s.BindInt64(0, seq);
+        s.BindInt64(1, limit);
+
+        if (s.Step())
+        {
+          count = static_cast<uint64_t>(s.ColumnInt64(0));
+          lastSeq = (count > 0 ? s.ColumnInt64(1) : 0);
+        }
+      }
+
+      if (count > 0)
+      {
+        SQLite::Statement s(db_, SQLITE_FROM_HERE, "DELETE FROM Changes WHERE seq<=?");
+        s.BindInt64(0, lastSeq);
+        s.Run();
+      }
+
+      return count;
+    }
+
+
     virtual bool IsDiskSizeAbove(uint64_t threshold) ORTHANC_OVERRIDE
     {
       return GetTotalCompressedSize() > threshold;
@@ -1779,6 +2111,21 @@ namespace Orthanc
                            const std::string& /* publicId - unused */,
                            const std::string& date) ORTHANC_OVERRIDE
     {
+      if (coalesceChanges_ &&
+          changeType != ChangeType_NewInstance &&
+          changeType != ChangeType_NewSeries &&
+          changeType != ChangeType_NewStudy &&
+          changeType != ChangeType_NewPatient)
+      {
+        // Only keep the most recent occurrence of a change that can
+        // be repeated on the same resource (e.g. "UpdatedMetadata"
+        // or "StableSeries"), which is cheap thanks to "ChangesIndex"
+        SQLite::Statement s(db_, SQLITE_FROM_HERE, "DELETE FROM Changes WHERE internalId=? AND changeType=?");
+        s.BindInt64(0, internalId);
+        s.BindInt(1, changeType);
+        s.Run();
+      }
+
       SQLite::Statement s(db_, SQLITE_FROM_HERE, "INSERT INTO Changes (seq, changeType, internalId, resourceType, date) VALUES(NULL, ?, ?, ?, ?)");
       s.BindInt(0, changeType);
       s.BindInt64(1, internalId);
@@ -2032,12 +2379,7 @@ namespace Orthanc
                                   const DicomTag& tag,
                                   const std::string& value) ORTHANC_OVERRIDE
     {
-      SQLite::Statement s(db_, SQLITE_FROM_HERE, "INSERT INTO DicomIdentifiers (id, tagGroup, tagElement, value) VALUES(?, ?, ?, ?)");
-      s.BindInt64(0, id);
-      s.BindInt(1, tag.GetGroup());
-      s.BindInt(2, tag.GetElement());
-      s.BindString(3, value);
-      s.Run();
+      UnitTestsTransaction::SetIdentifierTag(id, tag, value);
     }
 
 
@@ -2576,7 +2918,8 @@ namespace Orthanc
     ReadWriteTransaction(SQLiteDatabaseWrapper& that,
                          IDatabaseListener& listener,
                          bool hasFastTotalSize) :
-      TransactionBase(that.mutex_, that.db_, listener, *that.signalRemainingAncestor_, hasFastTotalSize),
+      TransactionBase(that.mutex_, that.db_, listener, *that.signalRemainingAncestor_, hasFastTotalSize,
+                      that.hasNGramIndex_, that.coalesceChanges_),
       that_(that),
       transaction_(new SQLite::Transaction(that_.db_)),
       isNested_(false)
@@ -2638,6 +2981,7 @@ namespace Orthanc
       if (!isNested_)
       {
         transaction_->Commit();
+        that_.writeTransactionsCount_++;
 
         assert(initialDiskSize_ + fileSizeDelta >= 0 &&
               initialDiskSize_ + fileSizeDelta == static_cast<int64_t>(GetTotalCompressedSize()));
@@ -2656,7 +3000,8 @@ namespace Orthanc
     ReadOnlyTransaction(SQLiteDatabaseWrapper& that,
                         IDatabaseListener& listener,
                         bool hasFastTotalSize) :
-      TransactionBase(that.mutex_, that.db_, listener, *that.signalRemainingAncestor_, hasFastTotalSize),
+      TransactionBase(that.mutex_, that.db_, listener, *that.signalRemainingAncestor_, hasFastTotalSize,
+                      that.hasNGramIndex_, that.coalesceChanges_),
       that_(that),
       isNested_(false)
     {
@@ -2694,10 +3039,216 @@ namespace Orthanc
   };
   
 
+  class SQLiteDatabaseWrapper::ReadOnlyConnection : public boost::noncopyable
+  {
+  private:
+    boost::recursive_mutex    mutex_;  // Only used to construct "TransactionBase"
+    SQLite::Connection        db_;
+    SignalRemainingAncestor*  signalRemainingAncestor_;
+    boost::thread::id         owner_;
+    unsigned int              nesting_;
+
+  public:
+    explicit ReadOnlyConnection(const std::string& path) :
+      signalRemainingAncestor_(NULL),
+      nesting_(0)
+    {
+      db_.Open(path);
+      signalRemainingAncestor_ = dynamic_cast<SignalRemainingAncestor*>(db_.Register(new SignalRemainingAncestor));
+
+      db_.Execute("PRAGMA case_sensitive_like = true;");
+
+      // Wait for the main connection if it is checkpointing the WAL
+      db_.Execute("PRAGMA busy_timeout = 5000;");
+    }
+
+    ~ReadOnlyConnection()
+    {
+      db_.Close();
+    }
+
+    boost::recursive_mutex& GetMutex()
+    {
+      return mutex_;
+    }
+
+    SQLite::Connection& GetDatabase()
+    {
+      return db_;
+    }
+
+    SignalRemainingAncestor& GetSignalRemainingAncestor()
+    {
+      assert(signalRemainingAncestor_ != NULL);
+      return *signalRemainingAncestor_;
+    }
+
+    bool IsOwnedBy(const boost::thread::id& thread) const
+    {
+      return (nesting_ > 0 && owner_ == thread);
+    }
+
+    void Enter(const boost::thread::id& thread)
+    {
+      assert(nesting_ == 0 || owner_ == thread);
+      owner_ = thread;
+      nesting_++;
+    }
+
+    bool Leave()  // Returns "true" iff the connection is available again
+    {
+      assert(nesting_ > 0);
+      nesting_--;
+      return (nesting_ == 0);
+    }
+  };
+
+
+  /**
+   * Read-only transaction that runs on one of the connections of the
+   * pool. The SQLite transaction makes all the reads see the same
+   * snapshot of the WAL, even if the main connection commits in the
+   * meantime.
+   **/
+  class SQLiteDatabaseWrapper::PooledReadOnlyTransaction : public SQLiteDatabaseWrapper::TransactionBase
+  {
+  private:
+    SQLiteDatabaseWrapper&                that_;
+    ReadOnlyConnection&                   connection_;
+    std::unique_ptr<SQLite::Transaction>  transaction_;  // NULL if nested in another transaction of the same thread
+
+  public:
+    PooledReadOnlyTransaction(SQLiteDatabaseWrapper& that,
+                              ReadOnlyConnection& connection,
+                              IDatabaseListener& listener,
+                              bool hasFastTotalSize,
+                              bool isNested) :
+      TransactionBase(connection.GetMutex(), connection.GetDatabase(), listener,
+                      connection.GetSignalRemainingAncestor(), hasFastTotalSize, that.hasNGramIndex_, that.coalesceChanges_),
+      that_(that),
+      connection_(connection)
+    {
+      if (!isNested)
+      {
+        transaction_.reset(new SQLite::Transaction(connection.GetDatabase()));
+        transaction_->Begin();
+      }
+    }
+
+    virtual ~PooledReadOnlyTransaction()
+    {
+      transaction_.reset(NULL);  // Rollback if not committed, before giving the connection back
+      that_.ReleaseReadOnlyConnection(connection_);
+    }
+
+    virtual void Rollback() ORTHANC_OVERRIDE
+    {
+      if (transaction_.get() != NULL &&
+          transaction_->IsOpen())
+      {
+        transaction_->Rollback();
+      }
+    }
+
+    virtual void Commit(int64_t fileSizeDelta /* only used in debug */) ORTHANC_OVERRIDE
+    {
+      if (fileSizeDelta != 0)
+      {
+        THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+      }
+
+      if (transaction_.get() != NULL &&
+          transaction_->IsOpen())
+      {
+        transaction_->Commit();
+      }
+    }
+  };
+
+
+  SQLiteDatabaseWrapper::ReadOnlyConnection& SQLiteDatabaseWrapper::AcquireReadOnlyConnection(bool& isNested)
+  {
+    const boost::thread::id self = boost::this_thread::get_id();
+
+    boost::mutex::scoped_lock lock(poolMutex_);
+
+    // Reuse the connection of a read-only transaction of the same
+    // thread that is still active, otherwise this would deadlock
+    // once the pool is exhausted
+    for (size_t i = 0; i < readOnlyConnections_.size(); i++)
+    {
+      if (readOnlyConnections_[i]->IsOwnedBy(self))
+      {
+        readOnlyConnections_[i]->Enter(self);
+        isNested = true;
+        return *readOnlyConnections_[i];
+      }
+    }
+
+    while (availableReadOnlyConnections_.empty())
+    {
+      poolAvailable_.wait(lock);
+    }
+
+    ReadOnlyConnection* connection = availableReadOnlyConnections_.front();
+    availableReadOnlyConnections_.pop_front();
+
+    connection->Enter(self);
+    isNested = false;
+    return *connection;
+  }
+
+
+  void SQLiteDatabaseWrapper::ReleaseReadOnlyConnection(ReadOnlyConnection& connection)
+  {
+    boost::mutex::scoped_lock lock(poolMutex_);
+
+    if (connection.Leave())
+    {
+      availableReadOnlyConnections_.push_back(&connection);
+      poolAvailable_.notify_one();
+    }
+  }
+
+
+  void SQLiteDatabaseWrapper::CloseReadOnlyConnections()
+  {
+    boost::mutex::scoped_lock lock(poolMutex_);
+
+    if (availableReadOnlyConnections_.size() != readOnlyConnections_.size())
+    {
+      LOG(ERROR) << "Some read-only SQLite transactions are still active while closing the database: Expect a crash";
+    }
+
+    for (size_t i = 0; i < readOnlyConnections_.size(); i++)
+    {
+      assert(readOnlyConnections_[i] != NULL);
+      delete readOnlyConnections_[i];
+    }
+
+    readOnlyConnections_.clear();
+    availableReadOnlyConnections_.clear();
+  }
+
+
   SQLiteDatabaseWrapper::SQLiteDatabaseWrapper(const std::string& path) : 
+    path_(path),
     activeTransaction_(NULL), 
     signalRemainingAncestor_(NULL),
-    version_(0)
+    version_(0),
+    readOnlyConnectionsCount_(0),
+    enableNGramIndex_(false),
+    hasNGramIndex_(false),
+    coalesceChanges_(false),
+    globalStatisticsCheckInterval_(0),
+    incrementalVacuum_(false),
+    incrementalVacuumPages_(0),
+    writeTransactionsCount_(0),
+    lastFlushWriteTransactionsCount_(0),
+    walFrames_(0),
+    checkpointedFrames_(0),
+    freePages_(0),
+    vacuumedPages_(0)
   {
     dbCapabilities_.SetRevisionsSupport(true);
     dbCapabilities_.SetFlushToDisk(true);
@@ -2708,6 +3259,10 @@ namespace Orthanc
     dbCapabilities_.SetQueuesSupport(true);
     dbCapabilities_.SetAttachmentCustomDataSupport(true);
     dbCapabilities_.SetReserveQueueValueSupport(true);
+    dbCapabilities_.SetResourceStatisticsSupport(true);
+    dbCapabilities_.SetKeysetPaginationSupport(SQLiteDatabaseWrapper::HasIntegratedFind());
+    dbCapabilities_.SetChangesPruningSupport(true);
+    dbCapabilities_.SetFindExplainSupport(SQLiteDatabaseWrapper::HasIntegratedFind());
     db_.Open(path);
   }
 
@@ -2715,7 +3270,20 @@ namespace Orthanc
   SQLiteDatabaseWrapper::SQLiteDatabaseWrapper() : 
     activeTransaction_(NULL), 
     signalRemainingAncestor_(NULL),
-    version_(0)
+    version_(0),
+    readOnlyConnectionsCount_(0),
+    enableNGramIndex_(false),
+    hasNGramIndex_(false),
+    coalesceChanges_(false),
+    globalStatisticsCheckInterval_(0),
+    incrementalVacuum_(false),
+    incrementalVacuumPages_(0),
+    writeTransactionsCount_(0),
+    lastFlushWriteTransactionsCount_(0),
+    walFrames_(0),
+    checkpointedFrames_(0),
+    freePages_(0),
+    vacuumedPages_(0)
   {
     dbCapabilities_.SetRevisionsSupport(true);
     dbCapabilities_.SetFlushToDisk(true);
@@ -2726,6 +3294,10 @@ namespace Orthanc
     dbCapabilities_.SetQueuesSupport(true);
     dbCapabilities_.SetAttachmentCustomDataSupport(true);
     dbCapabilities_.SetReserveQueueValueSupport(true);
+    dbCapabilities_.SetResourceStatisticsSupport(true);
+    dbCapabilities_.SetKeysetPaginationSupport(SQLiteDatabaseWrapper::HasIntegratedFind());
+    dbCapabilities_.SetChangesPruningSupport(true);
+    dbCapabilities_.SetFindExplainSupport(SQLiteDatabaseWrapper::HasIntegratedFind());
     db_.OpenInMemory();
   }
 
@@ -2735,6 +3307,68 @@ namespace Orthanc
     {
       LOG(ERROR) << "A SQLite transaction is still active in the SQLiteDatabaseWrapper destructor: Expect a crash";
     }
+
+    CloseReadOnlyConnections();
+  }
+
+
+  void SQLiteDatabaseWrapper::SetReadOnlyConnectionsCount(unsigned int count)
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    if (signalRemainingAncestor_ != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "The pool of read-only connections must be configured before opening the database");
+    }
+
+    readOnlyConnectionsCount_ = count;
+  }
+
+
+  void SQLiteDatabaseWrapper::SetNGramIndex(bool enabled)
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    if (signalRemainingAncestor_ != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "The index of n-grams must be configured before opening the database");
+    }
+
+    enableNGramIndex_ = enabled;
+  }
+
+
+  void SQLiteDatabaseWrapper::SetCoalesceChanges(bool enabled)
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    if (signalRemainingAncestor_ != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "The coalescing of the changes must be configured before opening the database");
+    }
+
+    coalesceChanges_ = enabled;
+  }
+
+
+  void SQLiteDatabaseWrapper::SetIncrementalVacuum(bool enabled,
+                                                   unsigned int pagesPerSlice)
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    if (signalRemainingAncestor_ != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "The incremental vacuum must be configured before opening the database");
+    }
+
+    if (enabled &&
+        pagesPerSlice == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The number of pages per slice of incremental vacuum must be strictly positive");
+    }
+
+    incrementalVacuum_ = enabled;
+    incrementalVacuumPages_ = pagesPerSlice;
   }
 
 
@@ -2747,6 +3381,31 @@ namespace Orthanc
   }
 
 
+  static void PopulateNGramIndex(SQLite::Connection& db)
+  {
+    std::string sql = "SELECT id, tagGroup, tagElement, value FROM DicomIdentifiers WHERE ";
+
+    for (size_t i = 0; i < NGRAM_INDEXED_TAGS_COUNT; i++)
+    {
+      if (i > 0)
+      {
+        sql += " OR ";
+      }
+
+      sql += ("(tagGroup = " + boost::lexical_cast<std::string>(NGRAM_INDEXED_TAGS[i].GetGroup()) +
+              " AND tagElement = " + boost::lexical_cast<std::string>(NGRAM_INDEXED_TAGS[i].GetElement()) + ")");
+    }
+
+    SQLite::Statement s(db, sql);
+
+    while (s.Step())
+    {
+      DicomTag tag(static_cast<uint16_t>(s.ColumnInt(1)), static_cast<uint16_t>(s.ColumnInt(2)));
+      InsertIdentifierNGrams(db, s.ColumnInt64(0), tag, s.ColumnString(3));
+    }
+  }
+
+
   static void InjectEmbeddedScript(std::string& sql,
                                    const std::string& name,
                                    ServerResources::FileResourceId resourceId)
@@ -2773,16 +3432,50 @@ namespace Orthanc
     
       db_.Execute("PRAGMA ENCODING=\"UTF-8\";");
 
+      if (incrementalVacuum_)
+      {
+        // This only has an immediate effect on a new database, and
+        // must be done before switching to the WAL journal mode
+        db_.Execute("PRAGMA auto_vacuum=INCREMENTAL;");
+      }
+
       // Performance tuning of SQLite with PRAGMAs
       // http://www.sqlite.org/pragma.html
       db_.Execute("PRAGMA SYNCHRONOUS=NORMAL;");
       db_.Execute("PRAGMA JOURNAL_MODE=WAL;");
-      db_.Execute("PRAGMA LOCKING_MODE=EXCLUSIVE;");
+
+      if (readOnlyConnectionsCount_ > 0 &&
+          !path_.empty())
+      {
+        // The read-only connections need access to the shared memory
+        // of the WAL, which is not available in exclusive mode
+        db_.Execute("PRAGMA LOCKING_MODE=NORMAL;");
+        db_.Execute("PRAGMA busy_timeout = 5000;");
+      }
+      else
+      {
+        db_.Execute("PRAGMA LOCKING_MODE=EXCLUSIVE;");
+      }
+
       db_.Execute("PRAGMA WAL_AUTOCHECKPOINT=1000;");
       //db_.Execute("PRAGMA TEMP_STORE=memory");
 
       // Make "LIKE" case-sensitive in SQLite 
       db_.Execute("PRAGMA case_sensitive_like = true;");
+
+      if (incrementalVacuum_)
+      {
+        SQLite::Statement s(db_, SQLITE_FROM_HERE, "PRAGMA auto_vacuum");
+        if (s.Step() &&
+            s.ColumnInt(0) != 2 /* INCREMENTAL */)
+        {
+          // The "auto_vacuum" mode of an existing database can only
+          // be changed by rebuilding the whole file
+          LOG(WARNING) << "Converting the SQLite database to the incremental vacuum mode, "
+                       << "this might take some time on large databases";
+          db_.Execute("VACUUM;");
+        }
+      }
     }
 
     VoidDatabaseListener listener;
@@ -2802,6 +3495,11 @@ namespace Orthanc
         InjectEmbeddedScript(query, "${INSTALL_KEY_VALUE_STORES_AND_QUEUES}", ServerResources::INSTALL_KEY_VALUE_STORES_AND_QUEUES);
         InjectEmbeddedScript(query, "${ADD_TIMEOUT_TO_QUEUES}", ServerResources::ADD_TIMEOUT_TO_QUEUES);
         InjectEmbeddedScript(query, "${INSTALL_DICOM_IDENTIFIERS_INDEX_3}", ServerResources::INSTALL_DICOM_IDENTIFIERS_INDEX_3);
+        InjectEmbeddedScript(query, "${INSTALL_RESOURCES_STATISTICS}", ServerResources::INSTALL_RESOURCES_STATISTICS);
+        InjectEmbeddedScript(query, "${INSTALL_TRACK_RESOURCES_COUNT}", ServerResources::INSTALL_TRACK_RESOURCES_COUNT);
+        InjectEmbeddedScript(query, "${INSTALL_METADATA_VALUES_INDEX}", ServerResources::INSTALL_METADATA_VALUES_INDEX);
+        InjectEmbeddedScript(query, "${INSTALL_LABELS_INDEX_3}", ServerResources::INSTALL_LABELS_INDEX_3);
+        InjectEmbeddedScript(query, "${INSTALL_CHANGES_TYPE_INDEX}", ServerResources::INSTALL_CHANGES_TYPE_INDEX);
 
         db_.Execute(query);
       }
@@ -2832,6 +3530,14 @@ namespace Orthanc
           ExecuteEmbeddedScript(db_, ServerResources::INSTALL_TRACK_ATTACHMENTS_SIZE);
         }
 
+        // New in Orthanc 1.12.12, must be installed after the "GlobalIntegers" table
+        if (!transaction->LookupGlobalProperty(tmp, GlobalProperty_SQLiteHasResourcesCount, true /* unused in SQLite */) ||
+            tmp != "1")
+        {
+          LOG(INFO) << "Installing the SQLite triggers to track the number of resources";
+          ExecuteEmbeddedScript(db_, ServerResources::INSTALL_TRACK_RESOURCES_COUNT);
+        }
+
         // New in Orthanc 1.12.0
         if (!db_.DoesTableExist("Labels"))
         {
@@ -2873,15 +3579,87 @@ namespace Orthanc
           LOG(INFO) << "Adding timeout column to the \"Queues\" table";
           ExecuteEmbeddedScript(db_, ServerResources::ADD_TIMEOUT_TO_QUEUES);
         }
+
+        // New in Orthanc 1.12.12
+        if (!db_.DoesTableExist("ResourcesStatistics"))
+        {
+          LOG(WARNING) << "Installing the \"ResourcesStatistics\" table, this might take some time on large databases";
+          ExecuteEmbeddedScript(db_, ServerResources::INSTALL_RESOURCES_STATISTICS);
+        }
+
+        // New in Orthanc 1.12.12
+        if (!db_.DoesIndexExist("MetadataValuesIndex"))
+        {
+          LOG(WARNING) << "Installing the \"MetadataValuesIndex\" index, this might take some time on large databases";
+          ExecuteEmbeddedScript(db_, ServerResources::INSTALL_METADATA_VALUES_INDEX);
+        }
+
+        // New in Orthanc 1.12.12
+        if (!db_.DoesIndexExist("LabelsIndex3"))
+        {
+          LOG(INFO) << "Installing the \"LabelsIndex3\" index";
+          ExecuteEmbeddedScript(db_, ServerResources::INSTALL_LABELS_INDEX_3);
+        }
+
+        // New in Orthanc 1.12.12
+        if (!db_.DoesIndexExist("ChangesTypeIndex"))
+        {
+          LOG(WARNING) << "Installing the \"ChangesTypeIndex\" index, this might take some time on large databases";
+          ExecuteEmbeddedScript(db_, ServerResources::INSTALL_CHANGES_TYPE_INDEX);
+        }
+
+        // New in Orthanc 1.12.12
+        if (enableNGramIndex_)
+        {
+          if (!db_.DoesTableExist("DicomIdentifiersNGrams"))
+          {
+            LOG(WARNING) << "Indexing the n-grams of the identifiers, this might take some time on large databases";
+            ExecuteEmbeddedScript(db_, ServerResources::INSTALL_DICOM_IDENTIFIERS_NGRAMS);
+            PopulateNGramIndex(db_);
+          }
+
+          hasNGramIndex_ = true;
+        }
+        else if (db_.DoesTableExist("DicomIdentifiersNGrams"))
+        {
+          // The table would not be kept up-to-date
+          LOG(WARNING) << "Removing the index of the n-grams of the identifiers";
+          db_.Execute("DROP TABLE DicomIdentifiersNGrams");
+        }
       }
 
       transaction->Commit(0);
     }
+
+    if (readOnlyConnectionsCount_ > 0)
+    {
+      if (path_.empty())
+      {
+        LOG(WARNING) << "The SQLite database is stored in memory, ignoring the pool of read-only connections";
+      }
+      else
+      {
+        boost::mutex::scoped_lock lock(poolMutex_);
+
+        for (unsigned int i = 0; i < readOnlyConnectionsCount_; i++)
+        {
+          std::unique_ptr<ReadOnlyConnection> connection(new ReadOnlyConnection(path_));
+          readOnlyConnections_.push_back(connection.get());
+          availableReadOnlyConnections_.push_back(connection.release());
+        }
+
+        LOG(INFO) << "Opened a pool of " << readOnlyConnectionsCount_ << " read-only SQLite connection(s)";
+      }
+    }
   }
 
 
   void SQLiteDatabaseWrapper::Close()
   {
+    // The read-only connections must be closed first, as switching
+    // back to the DELETE journal mode requires an exclusive access
+    CloseReadOnlyConnections();
+
     boost::recursive_mutex::scoped_lock lock(mutex_);
     // close and delete the WAL when exiting properly -> the DB is stored in a single file (no more -wal and -shm files)
     db_.Execute("PRAGMA JOURNAL_MODE=DELETE;");
@@ -2958,6 +3736,14 @@ namespace Orthanc
         ServerToolbox::ReconstructMainDicomTags(transaction, storageArea, ResourceType_Study);
         ServerToolbox::ReconstructMainDicomTags(transaction, storageArea, ResourceType_Series);
         ServerToolbox::ReconstructMainDicomTags(transaction, storageArea, ResourceType_Instance);
+
+        // The children counts of "ExecuteFind()" need this table, that is otherwise
+        // only installed by "Open()" on databases whose schema is already version 6
+        if (!db_.DoesTableExist("ResourcesStatistics"))
+        {
+          ExecuteEmbeddedScript(db_, ServerResources::INSTALL_RESOURCES_STATISTICS);
+        }
+
         db_.Execute("UPDATE GlobalProperties SET value=\"6\" WHERE property=" +
                     boost::lexical_cast<std::string>(GlobalProperty_DatabaseSchemaVersion) + ";");
         transaction.Commit(0);
@@ -2991,7 +3777,57 @@ namespace Orthanc
     switch (type)
     {
       case TransactionType_ReadOnly:
-        return new ReadOnlyTransaction(*this, listener, true);  // This is a no-op transaction in SQLite (thanks to mutex)
+        if (readOnlyConnections_.empty())
+        {
+          return new ReadOnlyTransaction(*this, listener, true);  // This is a no-op transaction in SQLite (thanks to mutex)
+        }
+        else
+        {
+          /**
+           * If the current thread is already running a transaction on
+           * the main connection (the recursive mutex can be locked
+           * while "activeTransaction_" is set), nest the read-only
+           * transaction into it, so that it sees the uncommitted
+           * changes. Otherwise, use one connection from the pool.
+           **/
+          if (mutex_.try_lock())
+          {
+            std::unique_ptr<ITransaction> nested;
+
+            try
+            {
+              if (activeTransaction_ != NULL)
+              {
+                nested.reset(new ReadOnlyTransaction(*this, listener, true));
+              }
+            }
+            catch (...)
+            {
+              mutex_.unlock();
+              throw;
+            }
+
+            mutex_.unlock();
+
+            if (nested.get() != NULL)
+            {
+              return nested.release();
+            }
+          }
+
+          bool isNested;
+          ReadOnlyConnection& connection = AcquireReadOnlyConnection(isNested);
+
+          try
+          {
+            return new PooledReadOnlyTransaction(*this, connection, listener, true, isNested);
+          }
+          catch (...)
+          {
+            ReleaseReadOnlyConnection(connection);
+            throw;
+          }
+        }
 
       case TransactionType_ReadWrite:
       {
@@ -3010,7 +3846,167 @@ namespace Orthanc
   void SQLiteDatabaseWrapper::FlushToDisk()
   {
     boost::recursive_mutex::scoped_lock lock(mutex_);
-    db_.FlushToDisk();
+
+    // The database is considered as idle if no read-write transaction
+    // was committed since the previous flush
+    const bool isIdle = (activeTransaction_ == NULL &&
+                         writeTransactionsCount_ == lastFlushWriteTransactionsCount_);
+    lastFlushWriteTransactionsCount_ = writeTransactionsCount_;
+
+    RunMaintenance(isIdle);
+
+    if (globalStatisticsCheckInterval_ != 0 &&
+        activeTransaction_ == NULL)
+    {
+      const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+      if (lastGlobalStatisticsCheck_.is_not_a_date_time())
+      {
+        // Don't slow down the startup
+        lastGlobalStatisticsCheck_ = now;
+      }
+      else if ((now - lastGlobalStatisticsCheck_).total_seconds() >= static_cast<int64_t>(globalStatisticsCheckInterval_))
+      {
+        CheckGlobalStatistics();
+        lastGlobalStatisticsCheck_ = now;
+      }
+    }
+  }
+
+
+  static int64_t GetFreePagesCount(SQLite::Connection& db)
+  {
+    SQLite::Statement s(db, SQLITE_FROM_HERE, "PRAGMA freelist_count");
+    if (s.Step())
+    {
+      return s.ColumnInt64(0);
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+  }
+
+
+  void SQLiteDatabaseWrapper::RunMaintenance(bool isIdle)
+  {
+    // This is called with "mutex_" locked, cf. "FlushToDisk()"
+    int64_t walFrames, checkpointedFrames;
+
+    {
+      // Same as "sqlite3_wal_checkpoint()", but reports the progress
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, "PRAGMA wal_checkpoint(PASSIVE)");
+      if (!s.Step())
+      {
+        throw OrthancException(ErrorCode_SQLiteFlush);
+      }
+
+      walFrames = s.ColumnInt64(1);
+      checkpointedFrames = s.ColumnInt64(2);
+    }
+
+    int64_t freePages = GetFreePagesCount(db_);
+    uint64_t vacuumedPages = 0;
+
+    if (incrementalVacuum_ &&
+        isIdle &&
+        freePages > 0)
+    {
+      // Rate-limited slice of vacuum, the remaining free pages will
+      // be handled by the next calls to "FlushToDisk()"
+      db_.Execute("PRAGMA incremental_vacuum(" + boost::lexical_cast<std::string>(incrementalVacuumPages_) + ");");
+
+      const int64_t remainingPages = GetFreePagesCount(db_);
+      if (remainingPages < freePages)
+      {
+        vacuumedPages = static_cast<uint64_t>(freePages - remainingPages);
+        LOG(INFO) << "Incremental vacuum of the SQLite database: " << vacuumedPages
+                  << " page(s) given back to the filesystem, " << remainingPages << " free page(s) remaining";
+      }
+
+      freePages = remainingPages;
+    }
+
+    boost::mutex::scoped_lock lock(maintenanceMutex_);
+    walFrames_ = walFrames;
+    checkpointedFrames_ = checkpointedFrames;
+    freePages_ = freePages;
+    vacuumedPages_ += vacuumedPages;
+  }
+
+
+  void SQLiteDatabaseWrapper::GetMaintenanceStatistics(int64_t& freePages,
+                                                       uint64_t& vacuumedPages)
+  {
+    boost::mutex::scoped_lock lock(maintenanceMutex_);
+    freePages = freePages_;
+    vacuumedPages = vacuumedPages_;
+  }
+
+
+  void SQLiteDatabaseWrapper::PublishMetrics(MetricsRegistry& registry)
+  {
+    boost::mutex::scoped_lock lock(maintenanceMutex_);
+    registry.SetIntegerValue("orthanc_sqlite_wal_frames", walFrames_);
+    registry.SetIntegerValue("orthanc_sqlite_checkpointed_frames", checkpointedFrames_);
+    registry.SetIntegerValue("orthanc_sqlite_free_pages", freePages_);
+    registry.SetIntegerValue("orthanc_sqlite_vacuumed_pages", static_cast<int64_t>(vacuumedPages_));
+  }
+
+
+  void SQLiteDatabaseWrapper::SetGlobalStatisticsCheckInterval(unsigned int seconds)
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+    globalStatisticsCheckInterval_ = seconds;
+  }
+
+
+  bool SQLiteDatabaseWrapper::CheckGlobalStatistics()
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    if (activeTransaction_ != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    SQLite::Transaction transaction(db_);
+    transaction.Begin();
+
+    std::map<int64_t, int64_t> drifts;
+
+    {
+      // The keys of "GlobalIntegers" are those of "InstallTrackAttachmentsSize.sql"
+      // and "InstallTrackResourcesCount.sql"
+      SQLite::Statement s(db_, SQLITE_FROM_HERE,
+                          "SELECT GlobalIntegers.key, GlobalIntegers.value, IFNULL(expected.value, 0) FROM GlobalIntegers "
+                          "LEFT JOIN (SELECT 0 AS key, IFNULL(SUM(compressedSize), 0) AS value FROM AttachedFiles UNION ALL "
+                          "           SELECT 1 AS key, IFNULL(SUM(uncompressedSize), 0) AS value FROM AttachedFiles UNION ALL "
+                          "           SELECT 1 + resourceType AS key, COUNT(*) AS value FROM Resources GROUP BY resourceType) AS expected "
+                          "ON expected.key = GlobalIntegers.key WHERE GlobalIntegers.key <= 5");
+
+      while (s.Step())
+      {
+        if (s.ColumnInt64(1) != s.ColumnInt64(2))
+        {
+          LOG(WARNING) << "Fixing the drift of the global counter " << s.ColumnInt64(0) << " of the SQLite index: "
+                       << s.ColumnInt64(1) << " instead of " << s.ColumnInt64(2);
+          drifts[s.ColumnInt64(0)] = s.ColumnInt64(2);
+        }
+      }
+    }
+
+    for (std::map<int64_t, int64_t>::const_iterator it = drifts.begin(); it != drifts.end(); ++it)
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, "UPDATE GlobalIntegers SET value=? WHERE key=?");
+      s.BindInt64(0, it->second);
+      s.BindInt64(1, it->first);
+      s.Run();
+    }
+
+    transaction.Commit();
+
+    return drifts.empty();
   }
 
 
@@ -3039,12 +4035,20 @@ namespace Orthanc
                                                                      const DicomTag& tag,
                                                                      const std::string& value)
   {
-    SQLite::Statement s(db_, SQLITE_FROM_HERE, "INSERT INTO DicomIdentifiers (id, tagGroup, tagElement, value) VALUES(?, ?, ?, ?)");
-    s.BindInt64(0, id);
-    s.BindInt(1, tag.GetGroup());
-    s.BindInt(2, tag.GetElement());
-    s.BindString(3, value);
-    s.Run();
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, "INSERT INTO DicomIdentifiers (id, tagGroup, tagElement, value) VALUES(?, ?, ?, ?)");
+      s.BindInt64(0, id);
+      s.BindInt(1, tag.GetGroup());
+      s.BindInt(2, tag.GetElement());
+      s.BindString(3, value);
+      s.Run();
+    }
+
+    if (hasNGramIndex_ &&
+        IsNGramIndexedTag(tag))
+    {
+      InsertIdentifierNGrams(db_, id, tag, value);
+    }
   }
 
 
@@ -27,7 +27,12 @@
 
 #include "../../../OrthancFramework/Sources/SQLite/Connection.h"
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
+#include <list>
+#include <vector>
 
 namespace Orthanc
 {
@@ -45,15 +50,60 @@ namespace Orthanc
     class SignalRemainingAncestor;
     class ReadOnlyTransaction;
     class ReadWriteTransaction;
+    class ReadOnlyConnection;
+    class PooledReadOnlyTransaction;
     class LookupFormatter;
 
     boost::recursive_mutex    mutex_;
     SQLite::Connection        db_;
+    std::string               path_;  // Empty if the database is stored in memory
     TransactionBase*          activeTransaction_;
     SignalRemainingAncestor*  signalRemainingAncestor_;
     unsigned int              version_;
     IDatabaseWrapper::Capabilities  dbCapabilities_;
 
+    // Pool of additional connections that are dedicated to read-only
+    // transactions (new in Orthanc 1.12.12)
+    unsigned int                      readOnlyConnectionsCount_;
+    boost::mutex                      poolMutex_;
+    boost::condition_variable         poolAvailable_;
+    std::vector<ReadOnlyConnection*>  readOnlyConnections_;
+    std::list<ReadOnlyConnection*>    availableReadOnlyConnections_;
+
+    // Index of the n-grams of the identifiers, to speed up the
+    // wildcard lookups (new in Orthanc 1.12.12)
+    bool  enableNGramIndex_;
+    bool  hasNGramIndex_;
+
+    // Only keep the most recent occurrence of the changes that are
+    // repeated on the same resource (new in Orthanc 1.12.12)
+    bool  coalesceChanges_;
+
+    // Periodic consistency check of the global counters, from
+    // "FlushToDisk()" (new in Orthanc 1.12.12)
+    unsigned int              globalStatisticsCheckInterval_;
+    boost::posix_time::ptime  lastGlobalStatisticsCheck_;
+
+    // Maintenance of the SQLite file while the database is idle, from
+    // "FlushToDisk()" (new in Orthanc 1.12.12)
+    bool          incrementalVacuum_;
+    unsigned int  incrementalVacuumPages_;
+    uint64_t      writeTransactionsCount_;
+    uint64_t      lastFlushWriteTransactionsCount_;
+    boost::mutex  maintenanceMutex_;  // Protects the statistics below
+    int64_t       walFrames_;
+    int64_t       checkpointedFrames_;
+    int64_t       freePages_;
+    uint64_t      vacuumedPages_;
+
+    ReadOnlyConnection& AcquireReadOnlyConnection(bool& isNested);
+
+    void ReleaseReadOnlyConnection(ReadOnlyConnection& connection);
+
+    void CloseReadOnlyConnections();
+
+    void RunMaintenance(bool isIdle);
+
     void GetChangesInternal(std::list<ServerIndexChange>& target,
                             bool& done,
                             SQLite::Statement& s,
@@ -72,6 +122,66 @@ namespace Orthanc
 
     virtual ~SQLiteDatabaseWrapper();
 
+    /**
+     * Sets the number of additional SQLite connections that serve the
+     * read-only transactions in parallel with the main connection,
+     * thanks to the WAL journal mode. A value of zero (the default)
+     * serializes all the transactions onto the main connection. This
+     * must be called before "Open()", and is ignored for the
+     * databases that are stored in memory.
+     **/
+    void SetReadOnlyConnectionsCount(unsigned int count);
+
+    /**
+     * Enables the "DicomIdentifiersNGrams" table that indexes the
+     * n-grams of the free-text identifiers (such as "PatientName"),
+     * so that the wildcard lookups like "*SMITH*" don't scan all the
+     * identifiers. The table is populated by "Open()" if needed, and
+     * removed by "Open()" if the index is disabled, as it would
+     * otherwise become outdated. This must be called before "Open()".
+     **/
+    void SetNGramIndex(bool enabled);
+
+    /**
+     * Only keep the most recent row of the "Changes" table for the
+     * changes that can be repeated on the same resource (such as
+     * "UpdatedMetadata" or "StableSeries"): The older row is removed
+     * when the same change is logged again for the same resource. The
+     * "New*" changes are never coalesced. This must be called before
+     * "Open()".
+     **/
+    void SetCoalesceChanges(bool enabled);
+
+    /**
+     * Sets the interval (in seconds) between two consistency checks
+     * of the global counters by "FlushToDisk()", cf.
+     * "CheckGlobalStatistics()". A value of zero disables the checks.
+     **/
+    void SetGlobalStatisticsCheckInterval(unsigned int seconds);
+
+    /**
+     * Recomputes the global counters of the "GlobalIntegers" table
+     * (the number of resources at each level, and the total size of
+     * the attachments) from scratch, and fixes them if they have
+     * drifted. Returns "true" iff they were consistent. This is O(n),
+     * and blocks the other transactions while running.
+     **/
+    bool CheckGlobalStatistics();
+
+    /**
+     * Enables the "auto_vacuum=INCREMENTAL" mode of SQLite. The free
+     * pages that are left by the deletions are then given back to the
+     * filesystem by "FlushToDisk()", while the database is idle, in
+     * slices of at most "pagesPerSlice" pages so as not to block the
+     * other transactions. Converting an existing database requires a
+     * full "VACUUM" by "Open()". This must be called before "Open()".
+     **/
+    void SetIncrementalVacuum(bool enabled,
+                              unsigned int pagesPerSlice);
+
+    void GetMaintenanceStatistics(int64_t& freePages /* out */,
+                                  uint64_t& vacuumedPages /* out */);
+
     virtual void Open() ORTHANC_OVERRIDE;
 
     virtual void Close() ORTHANC_OVERRIDE;
@@ -80,6 +190,13 @@ namespace Orthanc
                                                              IDatabaseListener& listener)
       ORTHANC_OVERRIDE;
 
+    virtual IDatabaseWrapper::ITransaction* StartReplicaTransaction(IDatabaseListener& listener,
+                                                                    unsigned int maxStaleness) ORTHANC_OVERRIDE
+    {
+      // Not supported: "HasReadReplicasSupport()" is always "false"
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
     virtual void FlushToDisk() ORTHANC_OVERRIDE;
 
     virtual unsigned int GetDatabaseVersion() ORTHANC_OVERRIDE
@@ -100,6 +217,8 @@ namespace Orthanc
       THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_NotImplemented);
     }
 
+    virtual void PublishMetrics(MetricsRegistry& registry) ORTHANC_OVERRIDE;
+
     virtual bool HasIntegratedFind() const ORTHANC_OVERRIDE
     {
       return true;   // => This uses specialized SQL commands
@@ -117,10 +236,13 @@ namespace Orthanc
     {
     protected:
       SQLite::Connection& db_;
+      bool                hasNGramIndex_;
       
     public:
-      UnitTestsTransaction(SQLite::Connection& db) :
-        db_(db)
+      UnitTestsTransaction(SQLite::Connection& db,
+                           bool hasNGramIndex) :
+        db_(db),
+        hasNGramIndex_(hasNGramIndex)
       {
       }
       
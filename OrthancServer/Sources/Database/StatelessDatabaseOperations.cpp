@@ -31,8 +31,11 @@
 #include "../../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
 #include "../../../OrthancFramework/Sources/DicomParsing/ParsedDicomFile.h"
 #include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/LockProfiler.h"
 #include "../../../OrthancFramework/Sources/OrthancException.h"
+#include "../../../OrthancFramework/Sources/RequestTimings.h"
 #include "../../../OrthancFramework/Sources/SystemToolbox.h"
+#include "../../../OrthancFramework/Sources/Tracing.h"
 #include "../OrthancConfiguration.h"
 #include "../Search/DatabaseLookup.h"
 #include "../ServerIndexChange.h"
@@ -47,6 +50,10 @@
 
 namespace Orthanc
 {
+#if ORTHANC_ENABLE_LOCK_PROFILING == 1
+  static LockProfiler  databaseLockProfiler_("StatelessDatabaseOperations");
+#endif
+
   namespace
   {
     /**
@@ -91,11 +98,12 @@ namespace Orthanc
                               const Tuple& tuple) = 0;
 
       void Apply(StatelessDatabaseOperations& index,
+                 const char* name,
                  T1 t1)
       {
         const Tuple tuple(t1);
         TupleOperationsWrapper<ReadOnlyOperationsT1, Tuple> wrapper(*this, tuple);
-        index.Apply(wrapper);
+        index.Apply(wrapper, name);
       }
     };
 
@@ -115,12 +123,13 @@ namespace Orthanc
                               const Tuple& tuple) = 0;
 
       void Apply(StatelessDatabaseOperations& index,
+                 const char* name,
                  T1 t1,
                  T2 t2)
       {
         const Tuple tuple(t1, t2);
         TupleOperationsWrapper<ReadOnlyOperationsT2, Tuple> wrapper(*this, tuple);
-        index.Apply(wrapper);
+        index.Apply(wrapper, name);
       }
     };
 
@@ -141,13 +150,14 @@ namespace Orthanc
                               const Tuple& tuple) = 0;
 
       void Apply(StatelessDatabaseOperations& index,
+                 const char* name,
                  T1 t1,
                  T2 t2,
                  T3 t3)
       {
         const Tuple tuple(t1, t2, t3);
         TupleOperationsWrapper<ReadOnlyOperationsT3, Tuple> wrapper(*this, tuple);
-        index.Apply(wrapper);
+        index.Apply(wrapper, name);
       }
     };
 
@@ -169,6 +179,7 @@ namespace Orthanc
                               const Tuple& tuple) = 0;
 
       void Apply(StatelessDatabaseOperations& index,
+                 const char* name,
                  T1 t1,
                  T2 t2,
                  T3 t3,
@@ -176,7 +187,7 @@ namespace Orthanc
       {
         const Tuple tuple(t1, t2, t3, t4);
         TupleOperationsWrapper<ReadOnlyOperationsT4, Tuple> wrapper(*this, tuple);
-        index.Apply(wrapper);
+        index.Apply(wrapper, name);
       }
     };
 
@@ -199,6 +210,7 @@ namespace Orthanc
                               const Tuple& tuple) = 0;
 
       void Apply(StatelessDatabaseOperations& index,
+                 const char* name,
                  T1 t1,
                  T2 t2,
                  T3 t3,
@@ -207,7 +219,7 @@ namespace Orthanc
       {
         const Tuple tuple(t1, t2, t3, t4, t5);
         TupleOperationsWrapper<ReadOnlyOperationsT5, Tuple> wrapper(*this, tuple);
-        index.Apply(wrapper);
+        index.Apply(wrapper, name);
       }
     };
 
@@ -231,6 +243,7 @@ namespace Orthanc
                               const Tuple& tuple) = 0;
 
       void Apply(StatelessDatabaseOperations& index,
+                 const char* name,
                  T1 t1,
                  T2 t2,
                  T3 t3,
@@ -240,7 +253,7 @@ namespace Orthanc
       {
         const Tuple tuple(t1, t2, t3, t4, t5, t6);
         TupleOperationsWrapper<ReadOnlyOperationsT6, Tuple> wrapper(*this, tuple);
-        index.Apply(wrapper);
+        index.Apply(wrapper, name);
       }
     };
   }
@@ -362,9 +375,12 @@ namespace Orthanc
     bool                                             isCommitted_;
     
   public:
+    // If "replicaMaxStaleness" is not zero, the read-only transaction
+    // can be served by a replica of the database (new in Orthanc 1.12.12)
     Transaction(IDatabaseWrapper& db,
                 ITransactionContextFactory& factory,
-                TransactionType type) :
+                TransactionType type,
+                unsigned int replicaMaxStaleness) :
       db_(db),
       isCommitted_(false)
     {
@@ -373,8 +389,20 @@ namespace Orthanc
       {
         throw OrthancException(ErrorCode_NullPointer);
       }      
-      
-      transaction_.reset(db_.StartTransaction(type, *context_));
+
+      if (replicaMaxStaleness == 0)
+      {
+        transaction_.reset(db_.StartTransaction(type, *context_));
+      }
+      else if (type == TransactionType_ReadOnly)
+      {
+        transaction_.reset(db_.StartReplicaTransaction(*context_, replicaMaxStaleness));
+      }
+      else
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
       if (transaction_.get() == NULL)
       {
         throw OrthancException(ErrorCode_NullPointer);
@@ -410,6 +438,8 @@ namespace Orthanc
       }
       else
       {
+        context_->PrepareCommit(*transaction_);
+
         int64_t delta = context_->GetCompressedSizeDelta();
 
         transaction_->Commit(delta);
@@ -426,10 +456,103 @@ namespace Orthanc
   };
   
 
+  namespace
+  {
+    /**
+     * Measures the duration of one call to "ApplyInternal()", including
+     * the retries, and reports it to the statistics, even if an
+     * exception is thrown.
+     **/
+    class TransactionMonitor : public boost::noncopyable
+    {
+    private:
+      DatabaseOperationsStatistics&  statistics_;
+      const char*                    name_;
+      boost::posix_time::ptime       start_;
+      unsigned int                   slowThreshold_;
+      uint64_t                       waitMicroseconds_;
+      unsigned int                   retries_;
+      unsigned int                   serializationFailures_;
+
+      static boost::posix_time::ptime Now()
+      {
+        return boost::posix_time::microsec_clock::universal_time();
+      }
+
+    public:
+      TransactionMonitor(DatabaseOperationsStatistics& statistics,
+                         const char* name) :
+        statistics_(statistics),
+        name_(name),
+        start_(Now()),
+        slowThreshold_(0),
+        waitMicroseconds_(0),
+        retries_(0),
+        serializationFailures_(0)
+      {
+      }
+
+      ~TransactionMonitor()
+      {
+        const uint64_t duration = static_cast<uint64_t>((Now() - start_).total_microseconds());
+        statistics_.AddTransaction(name_, duration, waitMicroseconds_, retries_, serializationFailures_);
+
+        if (slowThreshold_ != 0 &&
+            duration >= static_cast<uint64_t>(slowThreshold_) * 1000)
+        {
+          LOG(WARNING) << "Slow database transaction \"" << name_ << "\": " << (duration / 1000) << "ms (waiting for the database: "
+                       << (waitMicroseconds_ / 1000) << "ms, retries: " << retries_ << ")";
+        }
+      }
+
+      void SetSlowThreshold(unsigned int milliseconds)
+      {
+        slowThreshold_ = milliseconds;
+      }
+
+      // Time spent since the beginning of the operation, before the
+      // start of a database transaction
+      void AddWait(const boost::posix_time::ptime& start)
+      {
+        waitMicroseconds_ += static_cast<uint64_t>((Now() - start).total_microseconds());
+      }
+
+      void AddWaitSinceStart()
+      {
+        AddWait(start_);
+      }
+
+      void AddSerializationFailure(bool retry)
+      {
+        serializationFailures_++;
+
+        if (retry)
+        {
+          retries_++;
+        }
+      }
+    };
+  }
+
+
   void StatelessDatabaseOperations::ApplyInternal(IReadOnlyOperations* readOperations,
-                                                  IReadWriteOperations* writeOperations)
+                                                  IReadWriteOperations* writeOperations,
+                                                  const char* name)
   {
-    boost::shared_lock<boost::shared_mutex> lock(mutex_);  // To protect "factory_" and "maxRetries_"
+    TransactionMonitor monitor(statistics_, name);
+    RequestTimings::Timer timings(RequestTimings::Category_Database);
+    RequestTimings::AddToCounter(RequestTimings::Counter_DatabaseTransactions, 1);
+    Tracing::Span span("database.transaction", Tracing::SpanKind_Internal);
+
+    if (span.IsRecording())
+    {
+      span.SetAttribute("db.operation.name", (name == NULL ? "" : name));
+      span.SetAttribute("orthanc.transaction.type", (readOperations != NULL ? "read-only" : "read-write"));
+    }
+
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);  // To protect "factory_" and "maxRetries_"
+    monitor.AddWaitSinceStart();
+    monitor.SetSlowThreshold(slowTransactionThreshold_);
 
     if ((readOperations == NULL && writeOperations == NULL) ||
         (readOperations != NULL && writeOperations != NULL))
@@ -456,7 +579,17 @@ namespace Orthanc
            * global mutex that was protecting the database.
            **/
           
-          Transaction transaction(db_, *factory_, TransactionType_ReadOnly);  // TODO - Only if not "TransactionType_Implicit"
+          const unsigned int replicaMaxStaleness = (IsReplicaAllowed() ? replicaMaxStaleness_ : 0);
+
+          if (replicaMaxStaleness != 0 &&
+              span.IsRecording())
+          {
+            span.SetAttribute("orthanc.transaction.replica", static_cast<int64_t>(replicaMaxStaleness));
+          }
+
+          const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+          Transaction transaction(db_, *factory_, TransactionType_ReadOnly, replicaMaxStaleness);  // TODO - Only if not "TransactionType_Implicit"
+          monitor.AddWait(start);
           {
             ReadOnlyTransaction t(transaction.GetDatabaseTransaction(), transaction.GetContext());
             readOperations->Apply(t);
@@ -471,12 +604,20 @@ namespace Orthanc
             throw OrthancException(ErrorCode_ReadOnly, "The DB is trying to execute a ReadWrite transaction while Orthanc has been started in ReadOnly mode.");
           }
           
-          Transaction transaction(db_, *factory_, TransactionType_ReadWrite);
+          const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+          Transaction transaction(db_, *factory_, TransactionType_ReadWrite, 0 /* primary database */);
+          monitor.AddWait(start);
           {
             ReadWriteTransaction t(transaction.GetDatabaseTransaction(), transaction.GetContext());
             writeOperations->Apply(t);
           }
           transaction.Commit();
+
+          {
+            boost::mutex::scoped_lock writesLock(committedWritesMutex_);
+            committedWrites_++;
+            lastCommittedWrite_ = boost::posix_time::microsec_clock::universal_time();
+          }
         }
         
         return;  // Success
@@ -487,12 +628,17 @@ namespace Orthanc
         {
           if (attempt >= maxRetries_)
           {
+            monitor.AddSerializationFailure(false);
             LOG(ERROR) << "Maximum transactions retries reached " << e.GetDetails();
+            span.SetError(e.What());
             throw;
           }
           else
           {
+            monitor.AddSerializationFailure(true);
+            RequestTimings::AddToCounter(RequestTimings::Counter_DatabaseRetries, 1);
             attempt++;
+            span.SetAttribute("orthanc.transaction.retries", static_cast<int64_t>(attempt));
 
             // The "rand()" adds some jitter to de-synchronize writers
             boost::this_thread::sleep(boost::posix_time::milliseconds(100 * attempt + 5 * (rand() % 10)));
@@ -500,6 +646,7 @@ namespace Orthanc
         }
         else
         {
+          span.SetError(e.What());
           throw;
         }
       }
@@ -511,8 +658,32 @@ namespace Orthanc
     db_(db),
     mainDicomTagsRegistry_(new MainDicomTagsRegistry),
     maxRetries_(0),
-    readOnly_(readOnly)
+    slowTransactionThreshold_(0),
+    readOnly_(readOnly),
+    replicaMaxStaleness_(0),
+    replicaPinDuration_(0),
+    committedWrites_(0),
+    lastCommittedWrite_(boost::posix_time::neg_infin)
+  {
+  }
+
+
+  bool StatelessDatabaseOperations::IsReplicaAllowed()
   {
+    // WARNING: "mutex_" must be locked (shared) by the caller
+    if (replicaMaxStaleness_ == 0)
+    {
+      return false;
+    }
+    else
+    {
+      // Read-your-writes consistency: The reads are pinned to the
+      // primary database for some time after each write
+      boost::mutex::scoped_lock lock(committedWritesMutex_);
+      return (lastCommittedWrite_.is_neg_infinity() ||
+              (boost::posix_time::microsec_clock::universal_time() - lastCommittedWrite_).total_milliseconds() >=
+              static_cast<int64_t>(replicaPinDuration_) * 1000);
+    }
   }
 
 
@@ -531,7 +702,7 @@ namespace Orthanc
 
   void StatelessDatabaseOperations::SetTransactionContextFactory(ITransactionContextFactory* factory)
   {
-    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::unique_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
 
     if (factory == NULL)
     {
@@ -550,20 +721,52 @@ namespace Orthanc
 
   void StatelessDatabaseOperations::SetMaxDatabaseRetries(unsigned int maxRetries)
   {
-    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::unique_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
     maxRetries_ = maxRetries;
   }
   
 
-  void StatelessDatabaseOperations::Apply(IReadOnlyOperations& operations)
+  void StatelessDatabaseOperations::SetSlowTransactionThreshold(unsigned int milliseconds)
+  {
+    ORTHANC_PROFILED_LOCK(boost::unique_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
+    slowTransactionThreshold_ = milliseconds;
+  }
+
+
+  void StatelessDatabaseOperations::SetReadReplicas(unsigned int maxStaleness,
+                                                    unsigned int pinDuration)
+  {
+    if (maxStaleness != 0 &&
+        !db_.GetDatabaseCapabilities().HasReadReplicasSupport())
+    {
+      throw OrthancException(ErrorCode_NotImplemented,
+                             "The database backend cannot route the read-only transactions to replicas");
+    }
+
+    ORTHANC_PROFILED_LOCK(boost::unique_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
+    replicaMaxStaleness_ = maxStaleness;
+    replicaPinDuration_ = pinDuration;
+  }
+
+
+  void StatelessDatabaseOperations::PublishMetrics(MetricsRegistry& registry)
+  {
+    db_.PublishMetrics(registry);
+    statistics_.Publish(registry);
+  }
+  
+
+  void StatelessDatabaseOperations::Apply(IReadOnlyOperations& operations,
+                                          const char* name)
   {
-    ApplyInternal(&operations, NULL);
+    ApplyInternal(&operations, NULL, name);
   }
   
 
-  void StatelessDatabaseOperations::Apply(IReadWriteOperations& operations)
+  void StatelessDatabaseOperations::Apply(IReadWriteOperations& operations,
+                                          const char* name)
   {
-    ApplyInternal(NULL, &operations);
+    ApplyInternal(NULL, &operations, name);
   }
 
 
@@ -750,14 +953,14 @@ namespace Orthanc
     if (GetDatabaseCapabilities().HasUpdateAndGetStatistics() && !IsReadOnly())
     {
       Operations operations;
-      Apply(operations);
+      Apply(operations, "GetGlobalStatistics");
 
       operations.GetValues(diskSize, uncompressedSize, countPatients, countStudies, countSeries, countInstances);
     } 
     else
     {   
       LegacyOperations operations;
-      operations.Apply(*this, diskSize, uncompressedSize, countPatients,
+      operations.Apply(*this, "GetGlobalStatistics", diskSize, uncompressedSize, countPatients,
                        countStudies, countSeries, countInstances);
     }
   }
@@ -793,7 +996,7 @@ namespace Orthanc
     };
     
     Operations operations;
-    operations.Apply(*this, target, since, maxResults);
+    operations.Apply(*this, "GetChanges", target, since, maxResults);
   }
 
 
@@ -826,7 +1029,7 @@ namespace Orthanc
     };
     
     Operations operations;
-    operations.Apply(*this, target, since, to, maxResults, changeType);
+    operations.Apply(*this, "GetChangesExtended", target, since, to, maxResults, changeType);
   }
 
 
@@ -857,7 +1060,58 @@ namespace Orthanc
     };
     
     Operations operations;
-    operations.Apply(*this, target);
+    operations.Apply(*this, "GetLastChange", target);
+  }
+
+
+  bool StatelessDatabaseOperations::GetChanges(std::list<ServerIndexChange>& target,
+                                               int64_t since,
+                                               uint32_t limit)
+  {
+    class Operations : public ReadOnlyOperationsT4<std::list<ServerIndexChange>&, bool&, int64_t, uint32_t>
+    {
+    public:
+      virtual void ApplyTuple(ReadOnlyTransaction& transaction,
+                              const Tuple& tuple) ORTHANC_OVERRIDE
+      {
+        transaction.GetChanges(tuple.get<0>(), tuple.get<1>(), tuple.get<2>(), tuple.get<3>());
+      }
+    };
+
+    bool done = false;
+
+    Operations operations;
+    operations.Apply(*this, "GetChanges", target, done, since, limit);
+
+    return done;
+  }
+
+
+  void StatelessDatabaseOperations::GetContentStamp(int64_t& lastChangeIndex,
+                                                    uint64_t& committedWrites)
+  {
+    class Operations : public ReadOnlyOperationsT1<int64_t&>
+    {
+    public:
+      virtual void ApplyTuple(ReadOnlyTransaction& transaction,
+                              const Tuple& tuple) ORTHANC_OVERRIDE
+      {
+        tuple.get<0>() = transaction.GetLastChangeIndex();
+      }
+    };
+
+    /**
+     * The counter of the writes is read before the last change, so
+     * that a write that would be committed in-between results in a
+     * different stamp at the next call.
+     **/
+    {
+      boost::mutex::scoped_lock lock(committedWritesMutex_);
+      committedWrites = committedWrites_;
+    }
+
+    Operations operations;
+    operations.Apply(*this, "GetContentStamp", lastChangeIndex);
   }
 
 
@@ -881,7 +1135,7 @@ namespace Orthanc
     };
     
     Operations operations;
-    operations.Apply(*this, target, since, maxResults);
+    operations.Apply(*this, "GetExportedResources", target, since, maxResults);
   }
 
 
@@ -902,7 +1156,7 @@ namespace Orthanc
     };
     
     Operations operations;
-    operations.Apply(*this, target);
+    operations.Apply(*this, "GetLastExportedResource", target);
   }
 
 
@@ -931,7 +1185,7 @@ namespace Orthanc
 
     bool isProtected;
     Operations operations;
-    operations.Apply(*this, isProtected, publicId);
+    operations.Apply(*this, "IsProtectedPatient", isProtected, publicId);
     return isProtected;
   }
 
@@ -1081,7 +1335,7 @@ namespace Orthanc
 
     bool found;
     Operations operations;
-    operations.Apply(*this, found, target, publicId);
+    operations.Apply(*this, "LookupParent", found, target, publicId);
     return found;
   }
 
@@ -1243,8 +1497,33 @@ namespace Orthanc
         }
       }
 
+      void ApplyWithStatistics(ReadOnlyTransaction& transaction)
+      {
+        int64_t id;
+        ResourceType type;
+        if (!transaction.LookupResource(id, type, publicId_) ||
+            type != type_)
+        {
+          throw OrthancException(ErrorCode_UnknownResource);
+        }
+
+        uint64_t countStudies, countSeries, countInstances;
+        transaction.GetResourceStatistics(countStudies, countSeries, countInstances, diskSize_, uncompressedSize_,
+                                          dicomDiskSize_, dicomUncompressedSize_, id);
+
+        countStudies_ = static_cast<unsigned int>(countStudies);
+        countSeries_ = static_cast<unsigned int>(countSeries);
+        countInstances_ = static_cast<unsigned int>(countInstances);
+      }
+
       virtual void Apply(ReadOnlyTransaction& transaction) ORTHANC_OVERRIDE
       {
+        if (dbCapabilities_.HasResourceStatisticsSupport())
+        {
+          ApplyWithStatistics(transaction);  // O(1), new in Orthanc 1.12.12
+          return;
+        }
+
         if (!dbCapabilities_.HasFindSupport())
         {
           ApplyWithoutFind(transaction);  // use legacy code
@@ -1308,7 +1587,7 @@ namespace Orthanc
 
     Operations operations(diskSize, uncompressedSize, countStudies, countSeries,
                           countInstances, dicomDiskSize, dicomUncompressedSize, type, publicId, db_.GetDatabaseCapabilities());
-    Apply(operations);
+    Apply(operations, "GetResourceStatistics");
   }
 
 
@@ -1369,7 +1648,7 @@ namespace Orthanc
 
     bool found;
     Operations operations;
-    operations.Apply(*this, found, value, property, shared);
+    operations.Apply(*this, "LookupGlobalProperty", found, value, property, shared);
     return found;
   }
   
@@ -1535,7 +1814,7 @@ namespace Orthanc
 
     bool found;
     Operations operations;
-    operations.Apply(*this, found, internalId, type, publicId);
+    operations.Apply(*this, "LookupResource", found, internalId, type, publicId);
     return found;
   }
 
@@ -1655,7 +1934,7 @@ namespace Orthanc
     };
 
     Operations operations(remainingAncestor, uuid, expectedType);
-    Apply(operations);
+    Apply(operations, "DeleteResource");
     return operations.IsFound();
   }
 
@@ -1764,7 +2043,7 @@ namespace Orthanc
     };
 
     Operations operations(publicId, remoteModality);
-    Apply(operations);
+    Apply(operations, "LogExportedResource");
   }
 
 
@@ -1803,7 +2082,7 @@ namespace Orthanc
     };
 
     Operations operations(publicId, isProtected);
-    Apply(operations);
+    Apply(operations, "SetProtectedPatient");
 
     if (isProtected)
     {
@@ -1899,7 +2178,7 @@ namespace Orthanc
     };
 
     Operations operations(newRevision, publicId, type, value, hasOldRevision, oldRevision, oldMD5);
-    Apply(operations);
+    Apply(operations, "SetMetadata");
   }
 
 
@@ -1991,7 +2270,7 @@ namespace Orthanc
     };
 
     Operations operations(publicId, type, hasRevision, revision, md5);
-    Apply(operations);
+    Apply(operations, "DeleteMetadata");
     return operations.HasFound();
   }
 
@@ -2062,7 +2341,7 @@ namespace Orthanc
     };
 
     Operations operations(sequence, shared, GetDatabaseCapabilities().HasAtomicIncrementGlobalProperty());
-    Apply(operations);
+    Apply(operations, "IncrementGlobalSequence");
     assert(operations.GetNewValue() != 0);
     return operations.GetNewValue();
   }
@@ -2080,7 +2359,7 @@ namespace Orthanc
     };
 
     Operations operations;
-    Apply(operations);
+    Apply(operations, "DeleteChanges");
   }
 
   
@@ -2096,7 +2375,108 @@ namespace Orthanc
     };
 
     Operations operations;
-    Apply(operations);
+    Apply(operations, "DeleteExportedResources");
+  }
+
+
+  bool StatelessDatabaseOperations::DeleteChangesAndExportedResourcesBefore(const std::string& date,
+                                                                           uint32_t limit)
+  {
+    class Operations : public IReadWriteOperations
+    {
+    private:
+      const std::string&  date_;
+      uint32_t            limit_;
+      bool                hasRemaining_;
+
+    public:
+      Operations(const std::string& date,
+                 uint32_t limit) :
+        date_(date),
+        limit_(limit),
+        hasRemaining_(false)
+      {
+      }
+
+      bool HasRemaining() const
+      {
+        return hasRemaining_;
+      }
+
+      virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
+      {
+        const uint64_t changes = transaction.DeleteChangesBefore(date_, limit_);
+        const uint64_t exports = transaction.DeleteExportedResourcesBefore(date_, limit_);
+        hasRemaining_ = (changes == limit_ || exports == limit_);
+      }
+    };
+
+    if (limit == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (!HasChangesPruningSupport())
+    {
+      throw OrthancException(ErrorCode_NotImplemented, "The database engine does not support the pruning of the changes");
+    }
+
+    Operations operations(date, limit);
+    Apply(operations, "DeleteChangesAndExportedResourcesBefore");
+    return operations.HasRemaining();
+  }
+
+
+  bool StatelessDatabaseOperations::DeleteOldestChanges(uint64_t keep,
+                                                        uint32_t limit)
+  {
+    class Operations : public IReadWriteOperations
+    {
+    private:
+      uint64_t  keep_;
+      uint32_t  limit_;
+      bool      hasRemaining_;
+
+    public:
+      Operations(uint64_t keep,
+                 uint32_t limit) :
+        keep_(keep),
+        limit_(limit),
+        hasRemaining_(false)
+      {
+      }
+
+      bool HasRemaining() const
+      {
+        return hasRemaining_;
+      }
+
+      virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
+      {
+        const int64_t last = transaction.GetLastChangeIndex();
+
+        if (last > 0 &&
+            static_cast<uint64_t>(last) > keep_)
+        {
+          const uint64_t count = transaction.DeleteChangesUpTo(last - static_cast<int64_t>(keep_), limit_);
+          hasRemaining_ = (count == limit_);
+        }
+      }
+    };
+
+    if (limit == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (!HasChangesPruningSupport())
+    {
+      throw OrthancException(ErrorCode_NotImplemented, "The database engine does not support the pruning of the changes");
+    }
+
+    Operations operations(keep, limit);
+    Apply(operations, "DeleteOldestChanges");
+    return operations.HasRemaining();
   }
 
 
@@ -2128,7 +2508,7 @@ namespace Orthanc
     };
 
     Operations operations(property, shared, value);
-    Apply(operations);
+    Apply(operations, "SetGlobalProperty");
   }
 
 
@@ -2206,7 +2586,7 @@ namespace Orthanc
     };
 
     Operations operations(publicId, type, hasRevision, revision, md5);
-    Apply(operations);
+    Apply(operations, "DeleteAttachment");
     return operations.HasFound();
   }
 
@@ -2266,7 +2646,7 @@ namespace Orthanc
     };
 
     Operations operations(internalId, changeType, publicId, level);
-    Apply(operations);
+    Apply(operations, "LogChange");
   }
 
 
@@ -2292,17 +2672,32 @@ namespace Orthanc
   }
 
 
-  void StatelessDatabaseOperations::ReconstructInstance(const ParsedDicomFile& dicom, bool limitToThisLevelDicomTags, ResourceType limitToLevel)
+  namespace
   {
-    class Operations : public IReadWriteOperations
+    class ReconstructOperations : public StatelessDatabaseOperations::IReadWriteOperations
     {
     private:
-      DicomMap                              summary_;
-      std::unique_ptr<DicomInstanceHasher>  hasher_;
-      bool                                  limitToThisLevelDicomTags_;
-      ResourceType                          limitToLevel_;
-      bool                                  hasTransferSyntax_;
-      DicomTransferSyntax                   transferSyntax_;
+      typedef StatelessDatabaseOperations::ReadWriteTransaction  ReadWriteTransaction;
+
+      class Instance : public boost::noncopyable
+      {
+      public:
+        DicomMap                              summary_;
+        std::unique_ptr<DicomInstanceHasher>  hasher_;
+        bool                                  hasTransferSyntax_;
+        DicomTransferSyntax                   transferSyntax_;
+
+        explicit Instance(const ParsedDicomFile& dicom)
+        {
+          OrthancConfiguration::DefaultExtractDicomSummary(summary_, dicom);
+          hasher_.reset(new DicomInstanceHasher(summary_));
+          hasTransferSyntax_ = dicom.LookupTransferSyntax(transferSyntax_);
+        }
+      };
+
+      std::vector<Instance*>  instances_;
+      bool                    limitToThisLevelDicomTags_;
+      ResourceType            limitToLevel_;
 
       static void ReplaceMetadata(ReadWriteTransaction& transaction,
                                   int64_t instance,
@@ -2341,25 +2736,16 @@ namespace Orthanc
         
       }
 
-    public:
-      explicit Operations(const ParsedDicomFile& dicom, bool limitToThisLevelDicomTags, ResourceType limitToLevel)
-        : limitToThisLevelDicomTags_(limitToThisLevelDicomTags),
-          limitToLevel_(limitToLevel)
-      {
-        OrthancConfiguration::DefaultExtractDicomSummary(summary_, dicom);
-        hasher_.reset(new DicomInstanceHasher(summary_));
-        hasTransferSyntax_ = dicom.LookupTransferSyntax(transferSyntax_);
-      }
-        
-      virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
+      void ApplyInstance(ReadWriteTransaction& transaction,
+                         const Instance& item) const
       {
         int64_t patient = -1, study = -1, series = -1, instance = -1;
 
         ResourceType type1, type2, type3, type4;      
-        if (!transaction.LookupResource(patient, type1, hasher_->HashPatient()) ||
-            !transaction.LookupResource(study, type2, hasher_->HashStudy()) ||
-            !transaction.LookupResource(series, type3, hasher_->HashSeries()) ||
-            !transaction.LookupResource(instance, type4, hasher_->HashInstance()) ||
+        if (!transaction.LookupResource(patient, type1, item.hasher_->HashPatient()) ||
+            !transaction.LookupResource(study, type2, item.hasher_->HashStudy()) ||
+            !transaction.LookupResource(series, type3, item.hasher_->HashSeries()) ||
+            !transaction.LookupResource(instance, type4, item.hasher_->HashInstance()) ||
             type1 != ResourceType_Patient ||
             type2 != ResourceType_Study ||
             type3 != ResourceType_Series ||
@@ -2394,7 +2780,7 @@ namespace Orthanc
           }
 
           transaction.ClearMainDicomTags(resource);
-          content.AddResource(resource, limitToLevel_, summary_);
+          content.AddResource(resource, limitToLevel_, item.summary_);
           transaction.SetResourcesContent(content);
           ReplaceMetadata(transaction, resource, MetadataType_MainDicomTagsSignature, DicomMap::GetMainDicomTagsSignature(limitToLevel_));
         }
@@ -2407,10 +2793,10 @@ namespace Orthanc
 
           {
             ResourcesContent content(false /* prevent the setting of metadata */);
-            content.AddResource(patient, ResourceType_Patient, summary_);
-            content.AddResource(study, ResourceType_Study, summary_);
-            content.AddResource(series, ResourceType_Series, summary_);
-            content.AddResource(instance, ResourceType_Instance, summary_);
+            content.AddResource(patient, ResourceType_Patient, item.summary_);
+            content.AddResource(study, ResourceType_Study, item.summary_);
+            content.AddResource(series, ResourceType_Series, item.summary_);
+            content.AddResource(instance, ResourceType_Instance, item.summary_);
 
             transaction.SetResourcesContent(content);
 
@@ -2419,19 +2805,19 @@ namespace Orthanc
             ReplaceMetadata(transaction, series, MetadataType_MainDicomTagsSignature, DicomMap::GetMainDicomTagsSignature(ResourceType_Series));      // New in Orthanc 1.11.0
             ReplaceMetadata(transaction, instance, MetadataType_MainDicomTagsSignature, DicomMap::GetMainDicomTagsSignature(ResourceType_Instance));  // New in Orthanc 1.11.0
           
-            SetMainDicomSequenceMetadata(transaction, patient, summary_, ResourceType_Patient);
-            SetMainDicomSequenceMetadata(transaction, study, summary_, ResourceType_Study);
-            SetMainDicomSequenceMetadata(transaction, series, summary_, ResourceType_Series);
-            SetMainDicomSequenceMetadata(transaction, instance, summary_, ResourceType_Instance);
+            SetMainDicomSequenceMetadata(transaction, patient, item.summary_, ResourceType_Patient);
+            SetMainDicomSequenceMetadata(transaction, study, item.summary_, ResourceType_Study);
+            SetMainDicomSequenceMetadata(transaction, series, item.summary_, ResourceType_Series);
+            SetMainDicomSequenceMetadata(transaction, instance, item.summary_, ResourceType_Instance);
           }
 
-          if (hasTransferSyntax_)
+          if (item.hasTransferSyntax_)
           {
-            ReplaceMetadata(transaction, instance, MetadataType_Instance_TransferSyntax, GetTransferSyntaxUid(transferSyntax_));
+            ReplaceMetadata(transaction, instance, MetadataType_Instance_TransferSyntax, GetTransferSyntaxUid(item.transferSyntax_));
           }
 
           const DicomValue* value;
-          if ((value = summary_.TestAndGetValue(DICOM_TAG_SOP_CLASS_UID)) != NULL &&   // NOLINT(bugprone-assignment-in-if-condition)
+          if ((value = item.summary_.TestAndGetValue(DICOM_TAG_SOP_CLASS_UID)) != NULL &&   // NOLINT(bugprone-assignment-in-if-condition)
               !value->IsNull() &&
               !value->IsBinary())
           {
@@ -2439,43 +2825,250 @@ namespace Orthanc
           }
         }
       }
+
+    public:
+      ReconstructOperations(bool limitToThisLevelDicomTags,
+                            ResourceType limitToLevel) :
+        limitToThisLevelDicomTags_(limitToThisLevelDicomTags),
+        limitToLevel_(limitToLevel)
+      {
+      }
+
+      virtual ~ReconstructOperations()
+      {
+        for (size_t i = 0; i < instances_.size(); i++)
+        {
+          assert(instances_[i] != NULL);
+          delete instances_[i];
+        }
+      }
+
+      void AddInstance(const ParsedDicomFile& dicom)
+      {
+        instances_.push_back(new Instance(dicom));
+      }
+
+      virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
+      {
+        for (size_t i = 0; i < instances_.size(); i++)
+        {
+          assert(instances_[i] != NULL);
+          ApplyInstance(transaction, *instances_[i]);
+        }
+      }
     };
+  }
+
 
-    Operations operations(dicom, limitToThisLevelDicomTags, limitToLevel);
-    Apply(operations);
+  void StatelessDatabaseOperations::ReconstructInstance(const ParsedDicomFile& dicom, bool limitToThisLevelDicomTags, ResourceType limitToLevel)
+  {
+    ReconstructOperations operations(limitToThisLevelDicomTags, limitToLevel);
+    operations.AddInstance(dicom);
+    Apply(operations, "ReconstructInstance");
   }
 
 
-  bool StatelessDatabaseOperations::ReadOnlyTransaction::HasReachedMaxStorageSize(uint64_t maximumStorageSize,
-                                                                                  uint64_t addedInstanceSize)
+  void StatelessDatabaseOperations::ReconstructInstances(const std::list<const ParsedDicomFile*>& instances)
   {
-    if (maximumStorageSize != 0)
+    if (!instances.empty())
     {
-      if (maximumStorageSize < addedInstanceSize)
-      {
-        throw OrthancException(ErrorCode_FullStorage, "Cannot store an instance of size " +
-                               boost::lexical_cast<std::string>(addedInstanceSize) +
-                               " bytes in a storage area limited to " +
-                               boost::lexical_cast<std::string>(maximumStorageSize));
-      }
-      
-      if (transaction_.IsDiskSizeAbove(maximumStorageSize - addedInstanceSize))
+      ReconstructOperations operations(false, ResourceType_Instance /* dummy */);
+
+      for (std::list<const ParsedDicomFile*>::const_iterator it = instances.begin(); it != instances.end(); ++it)
       {
-        return true;
+        if (*it == NULL)
+        {
+          throw OrthancException(ErrorCode_NullPointer);
+        }
+
+        operations.AddInstance(**it);
       }
+
+      Apply(operations, "ReconstructInstances");
     }
+  }
 
-    return false;
-  }                                                                           
 
-  bool StatelessDatabaseOperations::ReadOnlyTransaction::HasReachedMaxPatientCount(unsigned int maximumPatientCount,
-                                                                                   const std::string& patientId)
+  void StatelessDatabaseOperations::ReplaceInstanceEncoding(const std::string& instancePublicId,
+                                                            const std::string& expectedDicomUuid,
+                                                            const Attachments& attachments,
+                                                            DicomTransferSyntax transferSyntax,
+                                                            bool hasPixelDataOffset,
+                                                            uint64_t pixelDataOffset,
+                                                            bool hasPixelDataVR,
+                                                            ValueRepresentation pixelDataVR)
   {
-    if (maximumPatientCount != 0)
+    class Operations : public IReadWriteOperations
     {
-      uint64_t patientCount = transaction_.GetResourcesCount(ResourceType_Patient);  // at this time, the new patient has already been added (as part of the transaction)
-      return patientCount > maximumPatientCount;
-    }
+    private:
+      const std::string&   instancePublicId_;
+      const std::string&   expectedDicomUuid_;
+      const Attachments&   attachments_;
+      DicomTransferSyntax  transferSyntax_;
+      bool                 hasPixelDataOffset_;
+      uint64_t             pixelDataOffset_;
+      bool                 hasPixelDataVR_;
+      ValueRepresentation  pixelDataVR_;
+
+      static void ReplaceMetadata(ReadWriteTransaction& transaction,
+                                  int64_t instance,
+                                  MetadataType metadata,
+                                  bool hasValue,
+                                  const std::string& value)
+      {
+        std::string oldValue;
+        int64_t oldRevision;
+
+        if (transaction.LookupMetadata(oldValue, oldRevision, instance, metadata))
+        {
+          if (!hasValue)
+          {
+            transaction.DeleteMetadata(instance, metadata);
+          }
+          else if (oldValue != value)
+          {
+            transaction.SetMetadata(instance, metadata, value, oldRevision + 1);
+          }
+        }
+        else if (hasValue)
+        {
+          transaction.SetMetadata(instance, metadata, value, 0);
+        }
+      }
+
+    public:
+      Operations(const std::string& instancePublicId,
+                 const std::string& expectedDicomUuid,
+                 const Attachments& attachments,
+                 DicomTransferSyntax transferSyntax,
+                 bool hasPixelDataOffset,
+                 uint64_t pixelDataOffset,
+                 bool hasPixelDataVR,
+                 ValueRepresentation pixelDataVR) :
+        instancePublicId_(instancePublicId),
+        expectedDicomUuid_(expectedDicomUuid),
+        attachments_(attachments),
+        transferSyntax_(transferSyntax),
+        hasPixelDataOffset_(hasPixelDataOffset),
+        pixelDataOffset_(pixelDataOffset),
+        hasPixelDataVR_(hasPixelDataVR),
+        pixelDataVR_(pixelDataVR)
+      {
+      }
+
+      virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
+      {
+        ResourceType type;
+        int64_t instance;
+        if (!transaction.LookupResource(instance, type, instancePublicId_) ||
+            type != ResourceType_Instance)
+        {
+          throw OrthancException(ErrorCode_InexistentItem).SetHttpStatus(HttpStatus_404_NotFound);
+        }
+
+        {
+          FileInfo current;
+          int64_t revision;
+          if (!transaction.LookupAttachment(current, revision, instance, FileContentType_Dicom) ||
+              current.GetUuid() != expectedDicomUuid_)
+          {
+            throw OrthancException(ErrorCode_Revision, "The DICOM file of instance " +
+                                   instancePublicId_ + " has been replaced in the meantime");
+          }
+        }
+
+        // Remove the attachments that depend on the previous encoding,
+        // while remembering their revisions
+        static const FileContentType DERIVED[] = {
+          FileContentType_Dicom,
+          FileContentType_DicomUntilPixelData,
+          FileContentType_DicomFrameOffsets,
+          FileContentType_DicomAsJson
+        };
+
+        std::map<FileContentType, int64_t> revisions;
+
+        for (size_t i = 0; i < sizeof(DERIVED) / sizeof(FileContentType); i++)
+        {
+          FileInfo previous;
+          int64_t revision;
+          if (transaction.LookupAttachment(previous, revision, instance, DERIVED[i]))
+          {
+            revisions[DERIVED[i]] = revision;
+            transaction.DeleteAttachment(instance, DERIVED[i]);
+          }
+        }
+
+        uint64_t addedSize = 0;
+
+        for (Attachments::const_iterator it = attachments_.begin(); it != attachments_.end(); ++it)
+        {
+          std::map<FileContentType, int64_t>::const_iterator found = revisions.find(it->GetContentType());
+          transaction.AddAttachment(instance, *it, (found == revisions.end() ? 0 : found->second + 1));
+          addedSize += it->GetCompressedSize();
+        }
+
+        ReplaceMetadata(transaction, instance, MetadataType_Instance_TransferSyntax,
+                        true, GetTransferSyntaxUid(transferSyntax_));
+        ReplaceMetadata(transaction, instance, MetadataType_Instance_PixelDataOffset,
+                        hasPixelDataOffset_, boost::lexical_cast<std::string>(pixelDataOffset_));
+        ReplaceMetadata(transaction, instance, MetadataType_Instance_PixelDataVR,
+                        hasPixelDataOffset_ && hasPixelDataVR_, EnumerationToString(pixelDataVR_));
+
+        transaction.GetTransactionContext().SignalAttachmentsAdded(addedSize);
+      }
+    };
+
+    bool hasDicom = false;
+    for (Attachments::const_iterator it = attachments.begin(); it != attachments.end(); ++it)
+    {
+      if (it->GetContentType() == FileContentType_Dicom)
+      {
+        hasDicom = true;
+      }
+    }
+
+    if (!hasDicom)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The DICOM file of the instance is missing");
+    }
+
+    Operations operations(instancePublicId, expectedDicomUuid, attachments, transferSyntax,
+                          hasPixelDataOffset, pixelDataOffset, hasPixelDataVR, pixelDataVR);
+    Apply(operations, "ReplaceInstanceEncoding");
+  }
+
+
+  bool StatelessDatabaseOperations::ReadOnlyTransaction::HasReachedMaxStorageSize(uint64_t maximumStorageSize,
+                                                                                  uint64_t addedInstanceSize)
+  {
+    if (maximumStorageSize != 0)
+    {
+      if (maximumStorageSize < addedInstanceSize)
+      {
+        throw OrthancException(ErrorCode_FullStorage, "Cannot store an instance of size " +
+                               boost::lexical_cast<std::string>(addedInstanceSize) +
+                               " bytes in a storage area limited to " +
+                               boost::lexical_cast<std::string>(maximumStorageSize));
+      }
+      
+      if (transaction_.IsDiskSizeAbove(maximumStorageSize - addedInstanceSize))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }                                                                           
+
+  bool StatelessDatabaseOperations::ReadOnlyTransaction::HasReachedMaxPatientCount(unsigned int maximumPatientCount,
+                                                                                   const std::string& patientId)
+  {
+    if (maximumPatientCount != 0)
+    {
+      uint64_t patientCount = transaction_.GetResourcesCount(ResourceType_Patient);  // at this time, the new patient has already been added (as part of the transaction)
+      return patientCount > maximumPatientCount;
+    }
 
     return false;
   }
@@ -2574,502 +3167,597 @@ namespace Orthanc
         && (maximumStorageSize != 0 || maximumPatientCount != 0))
     {
       Operations operations(maximumStorageSize, maximumPatientCount);
-      Apply(operations);
+      Apply(operations, "StandaloneRecycling");
     }
   }
 
 
-  StoreStatus StatelessDatabaseOperations::Store(std::map<MetadataType, std::string>& instanceMetadata,
-                                                 const DicomMap& dicomSummary,
-                                                 const Attachments& attachments,
-                                                 const MetadataMap& metadata,
-                                                 const DicomInstanceOrigin& origin,
-                                                 bool overwrite,
-                                                 bool hasTransferSyntax,
-                                                 DicomTransferSyntax transferSyntax,
-                                                 bool hasPixelDataOffset,
-                                                 uint64_t pixelDataOffset,
-                                                 ValueRepresentation pixelDataVR,
-                                                 MaxStorageMode maximumStorageMode,
-                                                 uint64_t maximumStorageSize,
-                                                 unsigned int maximumPatients,
-                                                 bool isReconstruct)
+  bool StatelessDatabaseOperations::ReadWriteTransaction::RecycleBatch(uint64_t maximumStorageSize,
+                                                                       unsigned int maximumPatients,
+                                                                       unsigned int maximumBatchSize)
   {
-    class Operations : public IReadWriteOperations
+    for (unsigned int i = 0; i < maximumBatchSize; i++)
     {
-    private:
-      StoreStatus                          storeStatus_;
-      std::map<MetadataType, std::string>& instanceMetadata_;
-      const DicomMap&                      dicomSummary_;
-      const Attachments&                   attachments_;
-      const MetadataMap&                   metadata_;
-      const DicomInstanceOrigin&           origin_;
-      bool                                 overwrite_;
-      bool                                 hasTransferSyntax_;
-      DicomTransferSyntax                  transferSyntax_;
-      bool                                 hasPixelDataOffset_;
-      uint64_t                             pixelDataOffset_;
-      ValueRepresentation                  pixelDataVR_;
-      MaxStorageMode                       maximumStorageMode_;
-      uint64_t                             maximumStorageSize_;
-      unsigned int                         maximumPatientCount_;
-      bool                                 isReconstruct_;
-
-      // Auto-computed fields
-      bool          hasExpectedInstances_;
-      int64_t       expectedInstances_;
-      std::string   hashPatient_;
-      std::string   hashStudy_;
-      std::string   hashSeries_;
-      std::string   hashInstance_;
-
-      
-      static void SetInstanceMetadata(ResourcesContent& content,
-                                      std::map<MetadataType, std::string>& instanceMetadata,
-                                      int64_t instance,
-                                      MetadataType metadata,
-                                      const std::string& value)
+      if (!IsRecyclingNeeded(maximumStorageSize, maximumPatients, 0, ""))
       {
-        content.AddMetadata(instance, metadata, value);
-        instanceMetadata[metadata] = value;
+        return false;
       }
 
-      static void SetMainDicomSequenceMetadata(ResourcesContent& content,
-                                               int64_t resource,
-                                               const DicomMap& dicomSummary,
-                                               ResourceType level)
+      int64_t patientToRecycle;
+      if (!transaction_.SelectPatientToRecycle(patientToRecycle))
       {
-        std::string serialized;
-        GetMainDicomSequenceMetadataContent(serialized, dicomSummary, level);
-
-        if (!serialized.empty())
-        {
-          content.AddMetadata(resource, MetadataType_MainDicomSequences, serialized);
-        }
+        LOG(WARNING) << "Cannot recycle more patients, all the remaining patients are protected";
+        return false;
       }
-      
-      static bool ComputeExpectedNumberOfInstances(int64_t& target,
-                                                   const DicomMap& dicomSummary)
-      {
-        try
-        {
-          const DicomValue* value;
-          const DicomValue* value2;
-          
-          if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_IMAGES_IN_ACQUISITION)) != NULL &&              // NOLINT(bugprone-assignment-in-if-condition)
-              !value->IsNull() &&
-              !value->IsBinary() &&
-              (value2 = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_TEMPORAL_POSITIONS)) != NULL &&      // NOLINT(bugprone-assignment-in-if-condition)
-              !value2->IsNull() &&
-              !value2->IsBinary())
-          {
-            // Patch for series with temporal positions thanks to Will Ryder
-            int64_t imagesInAcquisition = boost::lexical_cast<int64_t>(value->GetContent());
-            int64_t countTemporalPositions = boost::lexical_cast<int64_t>(value2->GetContent());
-            target = imagesInAcquisition * countTemporalPositions;
-            return (target > 0);
-          }
 
-          else if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_SLICES)) != NULL &&            // NOLINT(bugprone-assignment-in-if-condition)
-                   !value->IsNull() &&
-                   !value->IsBinary() &&
-                   (value2 = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_TIME_SLICES)) != NULL &&      // NOLINT(bugprone-assignment-in-if-condition)
-                   !value2->IsBinary() &&
-                   !value2->IsNull())
-          {
-            // Support of Cardio-PET images
-            int64_t numberOfSlices = boost::lexical_cast<int64_t>(value->GetContent());
-            int64_t numberOfTimeSlices = boost::lexical_cast<int64_t>(value2->GetContent());
-            target = numberOfSlices * numberOfTimeSlices;
-            return (target > 0);
-          }
+      LOG(TRACE) << "Recycling one patient";
+      transaction_.DeleteResource(patientToRecycle);
+    }
 
-          else if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_CARDIAC_NUMBER_OF_IMAGES)) != NULL &&    // NOLINT(bugprone-assignment-in-if-condition)
-                   !value->IsNull() &&
-                   !value->IsBinary())
-          {
-            target = boost::lexical_cast<int64_t>(value->GetContent());
-            return (target > 0);
-          }
-        }
-        catch (OrthancException&)           // NOLINT(bugprone-empty-catch)
-        {
-        }
-        catch (boost::bad_lexical_cast&)    // NOLINT(bugprone-empty-catch)
-        {
-        }
+    return IsRecyclingNeeded(maximumStorageSize, maximumPatients, 0, "");
+  }
 
-        return false;
+
+  bool StatelessDatabaseOperations::IsAboveRecyclingLimits(uint64_t maximumStorageSize,
+                                                           unsigned int maximumPatientCount)
+  {
+    class Operations : public ReadOnlyOperationsT3<bool&, uint64_t, unsigned int>
+    {
+    public:
+      virtual void ApplyTuple(ReadOnlyTransaction& transaction,
+                              const Tuple& tuple) ORTHANC_OVERRIDE
+      {
+        tuple.get<0>() = (transaction.HasReachedMaxStorageSize(tuple.get<1>(), 0) ||
+                          transaction.HasReachedMaxPatientCount(tuple.get<2>(), ""));
       }
+    };
+
+    bool above;
+    Operations operations;
+    operations.Apply(*this, "IsAboveRecyclingLimits", above, maximumStorageSize, maximumPatientCount);
+    return above;
+  }
+
+
+  bool StatelessDatabaseOperations::RecycleBatch(uint64_t maximumStorageSize,
+                                                 unsigned int maximumPatientCount,
+                                                 unsigned int maximumBatchSize)
+  {
+    class Operations : public IReadWriteOperations
+    {
+    private:
+      uint64_t        maximumStorageSize_;
+      unsigned int    maximumPatientCount_;
+      unsigned int    maximumBatchSize_;
+      bool            more_;
 
     public:
-      Operations(std::map<MetadataType, std::string>& instanceMetadata,
-                 const DicomMap& dicomSummary,
-                 const Attachments& attachments,
-                 const MetadataMap& metadata,
-                 const DicomInstanceOrigin& origin,
-                 bool overwrite,
-                 bool hasTransferSyntax,
-                 DicomTransferSyntax transferSyntax,
-                 bool hasPixelDataOffset,
-                 uint64_t pixelDataOffset,
-                 ValueRepresentation pixelDataVR,
-                 MaxStorageMode maximumStorageMode,
-                 uint64_t maximumStorageSize,
+      Operations(uint64_t maximumStorageSize,
                  unsigned int maximumPatientCount,
-                 bool isReconstruct) :
-        storeStatus_(StoreStatus_Failure),
-        instanceMetadata_(instanceMetadata),
-        dicomSummary_(dicomSummary),
-        attachments_(attachments),
-        metadata_(metadata),
-        origin_(origin),
-        overwrite_(overwrite),
-        hasTransferSyntax_(hasTransferSyntax),
-        transferSyntax_(transferSyntax),
-        hasPixelDataOffset_(hasPixelDataOffset),
-        pixelDataOffset_(pixelDataOffset),
-        pixelDataVR_(pixelDataVR),
-        maximumStorageMode_(maximumStorageMode),
+                 unsigned int maximumBatchSize) :
         maximumStorageSize_(maximumStorageSize),
         maximumPatientCount_(maximumPatientCount),
-        isReconstruct_(isReconstruct)
+        maximumBatchSize_(maximumBatchSize),
+        more_(false)
       {
-        hasExpectedInstances_ = ComputeExpectedNumberOfInstances(expectedInstances_, dicomSummary);
-    
-        instanceMetadata_.clear();
-
-        DicomInstanceHasher hasher(dicomSummary);
-        hashPatient_ = hasher.HashPatient();
-        hashStudy_ = hasher.HashStudy();
-        hashSeries_ = hasher.HashSeries();
-        hashInstance_ = hasher.HashInstance();
       }
 
-      StoreStatus GetStoreStatus() const
+      bool HasMore() const
       {
-        return storeStatus_;
+        return more_;
       }
-        
+
       virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
       {
-        IDatabaseWrapper::CreateInstanceResult status;
-        int64_t instanceId;
-        
-        bool isNewInstance = transaction.CreateInstance(status, instanceId, hashPatient_,
-                                                        hashStudy_, hashSeries_, hashInstance_);
+        more_ = transaction.RecycleBatch(maximumStorageSize_, maximumPatientCount_, maximumBatchSize_);
+      }
+    };
+
+    if (maximumStorageSize == 0 &&
+        maximumPatientCount == 0)
+    {
+      return false;
+    }
+    else
+    {
+      Operations operations(maximumStorageSize, maximumPatientCount, maximumBatchSize);
+      Apply(operations, "RecycleBatch");
+      return operations.HasMore();
+    }
+  }
+
 
-        if (isReconstruct_ && isNewInstance)
+  class StatelessDatabaseOperations::StoreOperations : public StatelessDatabaseOperations::IReadWriteOperations
+  {
+  private:
+    StoreStatus                          storeStatus_;
+    std::map<MetadataType, std::string>& instanceMetadata_;
+    const DicomMap&                      dicomSummary_;
+    const Attachments&                   attachments_;
+    const MetadataMap&                   metadata_;
+    const DicomInstanceOrigin&           origin_;
+    bool                                 overwrite_;
+    bool                                 hasTransferSyntax_;
+    DicomTransferSyntax                  transferSyntax_;
+    bool                                 hasPixelDataOffset_;
+    uint64_t                             pixelDataOffset_;
+    ValueRepresentation                  pixelDataVR_;
+    MaxStorageMode                       maximumStorageMode_;
+    uint64_t                             maximumStorageSize_;
+    unsigned int                         maximumPatientCount_;
+    bool                                 isReconstruct_;
+
+    // Auto-computed fields
+    bool          hasExpectedInstances_;
+    int64_t       expectedInstances_;
+    std::string   hashPatient_;
+    std::string   hashStudy_;
+    std::string   hashSeries_;
+    std::string   hashInstance_;
+
+    
+    static void SetInstanceMetadata(ResourcesContent& content,
+                                    std::map<MetadataType, std::string>& instanceMetadata,
+                                    int64_t instance,
+                                    MetadataType metadata,
+                                    const std::string& value)
+    {
+      content.AddMetadata(instance, metadata, value);
+      instanceMetadata[metadata] = value;
+    }
+
+    static void SetMainDicomSequenceMetadata(ResourcesContent& content,
+                                             int64_t resource,
+                                             const DicomMap& dicomSummary,
+                                             ResourceType level)
+    {
+      std::string serialized;
+      GetMainDicomSequenceMetadataContent(serialized, dicomSummary, level);
+
+      if (!serialized.empty())
+      {
+        content.AddMetadata(resource, MetadataType_MainDicomSequences, serialized);
+      }
+    }
+    
+    static bool ComputeExpectedNumberOfInstances(int64_t& target,
+                                                 const DicomMap& dicomSummary)
+    {
+      try
+      {
+        const DicomValue* value;
+        const DicomValue* value2;
+        
+        if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_IMAGES_IN_ACQUISITION)) != NULL &&              // NOLINT(bugprone-assignment-in-if-condition)
+            !value->IsNull() &&
+            !value->IsBinary() &&
+            (value2 = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_TEMPORAL_POSITIONS)) != NULL &&      // NOLINT(bugprone-assignment-in-if-condition)
+            !value2->IsNull() &&
+            !value2->IsBinary())
         {
-          // In case of reconstruct, we just want to modify the attachments and some metadata like the TransferSyntex
-          // The DicomTags and many metadata have already been updated before we get here in ReconstructInstance
-          throw OrthancException(ErrorCode_InternalError, "New instance while reconstructing; this should not happen.");
+          // Patch for series with temporal positions thanks to Will Ryder
+          int64_t imagesInAcquisition = boost::lexical_cast<int64_t>(value->GetContent());
+          int64_t countTemporalPositions = boost::lexical_cast<int64_t>(value2->GetContent());
+          target = imagesInAcquisition * countTemporalPositions;
+          return (target > 0);
         }
 
-        // Check whether this instance is already stored
-        if (!isNewInstance && !isReconstruct_)
+        else if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_SLICES)) != NULL &&            // NOLINT(bugprone-assignment-in-if-condition)
+                 !value->IsNull() &&
+                 !value->IsBinary() &&
+                 (value2 = dicomSummary.TestAndGetValue(DICOM_TAG_NUMBER_OF_TIME_SLICES)) != NULL &&      // NOLINT(bugprone-assignment-in-if-condition)
+                 !value2->IsBinary() &&
+                 !value2->IsNull())
         {
-          // The instance already exists
-          if (overwrite_)
-          {
-            // Overwrite the old instance
-            LOG(INFO) << "Overwriting instance: " << hashInstance_;
-            transaction.DeleteResource(instanceId);
-
-            // Re-create the instance, now that the old one is removed
-            if (!transaction.CreateInstance(status, instanceId, hashPatient_,
-                                            hashStudy_, hashSeries_, hashInstance_))
-            {
-              // Note that, sometime, it does not create a new instance, 
-              // in very rare occasions in READ COMMITTED mode when multiple clients are pushing the same instance at the same time,
-              // this thread will not create the instance because another thread has created it in the meantime.
-              // At the end, there is always a thread that creates the instance and this is what we expect.
+          // Support of Cardio-PET images
+          int64_t numberOfSlices = boost::lexical_cast<int64_t>(value->GetContent());
+          int64_t numberOfTimeSlices = boost::lexical_cast<int64_t>(value2->GetContent());
+          target = numberOfSlices * numberOfTimeSlices;
+          return (target > 0);
+        }
 
-              // Note, we must delete the attachments that have already been stored from this failed insertion (they have not yet been added into the DB)
-              throw OrthancException(ErrorCode_DuplicateResource, "No new instance while overwriting; this might happen if another client has pushed the same instance at the same time.");
-            }
-          }
-          else
-          {
-            // Do nothing if the instance already exists and overwriting is disabled
-            transaction.GetAllMetadata(instanceMetadata_, instanceId);
-            storeStatus_ = StoreStatus_AlreadyStored;
-            return;
-          }
+        else if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_CARDIAC_NUMBER_OF_IMAGES)) != NULL &&    // NOLINT(bugprone-assignment-in-if-condition)
+                 !value->IsNull() &&
+                 !value->IsBinary())
+        {
+          target = boost::lexical_cast<int64_t>(value->GetContent());
+          return (target > 0);
         }
+      }
+      catch (OrthancException&)           // NOLINT(bugprone-empty-catch)
+      {
+      }
+      catch (boost::bad_lexical_cast&)    // NOLINT(bugprone-empty-catch)
+      {
+      }
 
+      return false;
+    }
 
-        if (!isReconstruct_)  // don't signal new resources if this is a reconstruction
-        {
-          // Warn about the creation of new resources. The order must be
-          // from instance to patient.
+  public:
+    StoreOperations(std::map<MetadataType, std::string>& instanceMetadata,
+                    const DicomMap& dicomSummary,
+                    const Attachments& attachments,
+                    const MetadataMap& metadata,
+                    const DicomInstanceOrigin& origin,
+                    bool overwrite,
+                    bool hasTransferSyntax,
+                    DicomTransferSyntax transferSyntax,
+                    bool hasPixelDataOffset,
+                    uint64_t pixelDataOffset,
+                    ValueRepresentation pixelDataVR,
+                    MaxStorageMode maximumStorageMode,
+                    uint64_t maximumStorageSize,
+                    unsigned int maximumPatientCount,
+                    bool isReconstruct) :
+      storeStatus_(StoreStatus_Failure),
+      instanceMetadata_(instanceMetadata),
+      dicomSummary_(dicomSummary),
+      attachments_(attachments),
+      metadata_(metadata),
+      origin_(origin),
+      overwrite_(overwrite),
+      hasTransferSyntax_(hasTransferSyntax),
+      transferSyntax_(transferSyntax),
+      hasPixelDataOffset_(hasPixelDataOffset),
+      pixelDataOffset_(pixelDataOffset),
+      pixelDataVR_(pixelDataVR),
+      maximumStorageMode_(maximumStorageMode),
+      maximumStorageSize_(maximumStorageSize),
+      maximumPatientCount_(maximumPatientCount),
+      isReconstruct_(isReconstruct)
+    {
+      hasExpectedInstances_ = ComputeExpectedNumberOfInstances(expectedInstances_, dicomSummary);
+  
+      instanceMetadata_.clear();
 
-          // NB: In theory, could be sped up by grouping the underlying
-          // calls to "transaction.LogChange()". However, this would only have an
-          // impact when new patient/study/series get created, which
-          // occurs far less often that creating new instances. The
-          // positive impact looks marginal in practice.
-          transaction.LogChange(instanceId, ChangeType_NewInstance, ResourceType_Instance, hashInstance_);
+      DicomInstanceHasher hasher(dicomSummary);
+      hashPatient_ = hasher.HashPatient();
+      hashStudy_ = hasher.HashStudy();
+      hashSeries_ = hasher.HashSeries();
+      hashInstance_ = hasher.HashInstance();
+    }
 
-          if (status.isNewSeries_)
-          {
-            transaction.LogChange(status.seriesId_, ChangeType_NewSeries, ResourceType_Series, hashSeries_);
-          }
+    StoreStatus GetStoreStatus() const
+    {
+      return storeStatus_;
+    }
       
-          if (status.isNewStudy_)
-          {
-            transaction.LogChange(status.studyId_, ChangeType_NewStudy, ResourceType_Study, hashStudy_);
-          }
+    virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
+    {
+      IDatabaseWrapper::CreateInstanceResult status;
+      int64_t instanceId;
       
-          if (status.isNewPatient_)
+      bool isNewInstance = transaction.CreateInstance(status, instanceId, hashPatient_,
+                                                      hashStudy_, hashSeries_, hashInstance_);
+
+      if (isReconstruct_ && isNewInstance)
+      {
+        // In case of reconstruct, we just want to modify the attachments and some metadata like the TransferSyntex
+        // The DicomTags and many metadata have already been updated before we get here in ReconstructInstance
+        throw OrthancException(ErrorCode_InternalError, "New instance while reconstructing; this should not happen.");
+      }
+
+      // Check whether this instance is already stored
+      if (!isNewInstance && !isReconstruct_)
+      {
+        // The instance already exists
+        if (overwrite_)
+        {
+          // Overwrite the old instance
+          LOG(INFO) << "Overwriting instance: " << hashInstance_;
+          transaction.DeleteResource(instanceId);
+
+          // Re-create the instance, now that the old one is removed
+          if (!transaction.CreateInstance(status, instanceId, hashPatient_,
+                                          hashStudy_, hashSeries_, hashInstance_))
           {
-            transaction.LogChange(status.patientId_, ChangeType_NewPatient, ResourceType_Patient, hashPatient_);
+            // Note that, sometime, it does not create a new instance, 
+            // in very rare occasions in READ COMMITTED mode when multiple clients are pushing the same instance at the same time,
+            // this thread will not create the instance because another thread has created it in the meantime.
+            // At the end, there is always a thread that creates the instance and this is what we expect.
+
+            // Note, we must delete the attachments that have already been stored from this failed insertion (they have not yet been added into the DB)
+            throw OrthancException(ErrorCode_DuplicateResource, "No new instance while overwriting; this might happen if another client has pushed the same instance at the same time.");
           }
-        }      
+        }
+        else
+        {
+          // Do nothing if the instance already exists and overwriting is disabled
+          transaction.GetAllMetadata(instanceMetadata_, instanceId);
+          storeStatus_ = StoreStatus_AlreadyStored;
+          return;
+        }
+      }
+
+
+      if (!isReconstruct_)  // don't signal new resources if this is a reconstruction
+      {
+        // Warn about the creation of new resources. The order must be
+        // from instance to patient.
+
+        // NB: In theory, could be sped up by grouping the underlying
+        // calls to "transaction.LogChange()". However, this would only have an
+        // impact when new patient/study/series get created, which
+        // occurs far less often that creating new instances. The
+        // positive impact looks marginal in practice.
+        transaction.LogChange(instanceId, ChangeType_NewInstance, ResourceType_Instance, hashInstance_);
+
+        if (status.isNewSeries_)
+        {
+          transaction.LogChange(status.seriesId_, ChangeType_NewSeries, ResourceType_Series, hashSeries_);
+        }
     
-        // Ensure there is enough room in the storage for the new instance
-        uint64_t instanceSize = 0;
-        for (Attachments::const_iterator it = attachments_.begin();
-             it != attachments_.end(); ++it)
+        if (status.isNewStudy_)
         {
-          instanceSize += it->GetCompressedSize();
+          transaction.LogChange(status.studyId_, ChangeType_NewStudy, ResourceType_Study, hashStudy_);
         }
+    
+        if (status.isNewPatient_)
+        {
+          transaction.LogChange(status.patientId_, ChangeType_NewPatient, ResourceType_Patient, hashPatient_);
+        }
+      }      
+  
+      // Ensure there is enough room in the storage for the new instance
+      uint64_t instanceSize = 0;
+      for (Attachments::const_iterator it = attachments_.begin();
+           it != attachments_.end(); ++it)
+      {
+        instanceSize += it->GetCompressedSize();
+      }
 
-        if (!isReconstruct_)  // reconstruction should not affect recycling
+      if (!isReconstruct_)  // reconstruction should not affect recycling
+      {
+        if (maximumStorageMode_ == MaxStorageMode_Reject)
         {
-          if (maximumStorageMode_ == MaxStorageMode_Reject)
+          if (transaction.HasReachedMaxStorageSize(maximumStorageSize_, instanceSize))
           {
-            if (transaction.HasReachedMaxStorageSize(maximumStorageSize_, instanceSize))
-            {
-              storeStatus_ = StoreStatus_StorageFull;
-              throw OrthancException(ErrorCode_FullStorage, "Maximum storage size reached") // throw to cancel the transaction
-                .SetHttpStatus(HttpStatus_507_InsufficientStorage);
-            }
-            if (transaction.HasReachedMaxPatientCount(maximumPatientCount_, hashPatient_))
-            {
-              storeStatus_ = StoreStatus_StorageFull;
-              throw OrthancException(ErrorCode_FullStorage, "Maximum patient count reached")  // throw to cancel the transaction
-                .SetHttpStatus(HttpStatus_507_InsufficientStorage);
-            }
+            storeStatus_ = StoreStatus_StorageFull;
+            throw OrthancException(ErrorCode_FullStorage, "Maximum storage size reached") // throw to cancel the transaction
+              .SetHttpStatus(HttpStatus_507_InsufficientStorage);
           }
-          else
+          if (transaction.HasReachedMaxPatientCount(maximumPatientCount_, hashPatient_))
           {
-            transaction.Recycle(maximumStorageSize_, maximumPatientCount_,
-                                instanceSize, hashPatient_ /* don't consider the current patient for recycling */);
+            storeStatus_ = StoreStatus_StorageFull;
+            throw OrthancException(ErrorCode_FullStorage, "Maximum patient count reached")  // throw to cancel the transaction
+              .SetHttpStatus(HttpStatus_507_InsufficientStorage);
           }
-        }  
-    
-        // Attach the files to the newly created instance
-        for (Attachments::const_iterator it = attachments_.begin();
-             it != attachments_.end(); ++it)
+        }
+        else
         {
-          if (isReconstruct_)
-          {
-            // we are replacing attachments during a reconstruction
-            transaction.DeleteAttachment(instanceId, it->GetContentType());
-          }
-
-          transaction.AddAttachment(instanceId, *it, 0 /* this is the first revision */);
+          transaction.Recycle(maximumStorageSize_, maximumPatientCount_,
+                              instanceSize, hashPatient_ /* don't consider the current patient for recycling */);
         }
-
-        ResourcesContent content(true /* new resource, metadata can be set */);
-
-        // Attach the user-specified metadata (in case of reconstruction, metadata_ contains all past metadata, including the system ones we want to keep)
-        for (MetadataMap::const_iterator 
-                it = metadata_.begin(); it != metadata_.end(); ++it)
+      }  
+  
+      // Attach the files to the newly created instance
+      for (Attachments::const_iterator it = attachments_.begin();
+           it != attachments_.end(); ++it)
+      {
+        if (isReconstruct_)
         {
-          switch (it->first.first)
-          {
-            case ResourceType_Patient:
-              content.AddMetadata(status.patientId_, it->first.second, it->second);
-              break;
-
-            case ResourceType_Study:
-              content.AddMetadata(status.studyId_, it->first.second, it->second);
-              break;
+          // we are replacing attachments during a reconstruction
+          transaction.DeleteAttachment(instanceId, it->GetContentType());
+        }
 
-            case ResourceType_Series:
-              content.AddMetadata(status.seriesId_, it->first.second, it->second);
-              break;
+        transaction.AddAttachment(instanceId, *it, 0 /* this is the first revision */);
+      }
 
-            case ResourceType_Instance:
-              SetInstanceMetadata(content, instanceMetadata_, instanceId,
-                                  it->first.second, it->second);
-              break;
+      ResourcesContent content(true /* new resource, metadata can be set */);
 
-            default:
-              throw OrthancException(ErrorCode_ParameterOutOfRange);
-          }
-        }
-
-        if (!isReconstruct_)
+      // Attach the user-specified metadata (in case of reconstruction, metadata_ contains all past metadata, including the system ones we want to keep)
+      for (MetadataMap::const_iterator 
+              it = metadata_.begin(); it != metadata_.end(); ++it)
+      {
+        switch (it->first.first)
         {
-          // Populate the tags of the newly-created resources
-          content.AddResource(instanceId, ResourceType_Instance, dicomSummary_);
-          SetInstanceMetadata(content, instanceMetadata_, instanceId, MetadataType_MainDicomTagsSignature, DicomMap::GetMainDicomTagsSignature(ResourceType_Instance));  // New in Orthanc 1.11.0
-          SetMainDicomSequenceMetadata(content, instanceId, dicomSummary_, ResourceType_Instance);   // new in Orthanc 1.11.1
+          case ResourceType_Patient:
+            content.AddMetadata(status.patientId_, it->first.second, it->second);
+            break;
 
-          if (status.isNewSeries_)
-          {
-            content.AddResource(status.seriesId_, ResourceType_Series, dicomSummary_);
-            content.AddMetadata(status.seriesId_, MetadataType_MainDicomTagsSignature, DicomMap::GetMainDicomTagsSignature(ResourceType_Series));  // New in Orthanc 1.11.0
-            SetMainDicomSequenceMetadata(content, status.seriesId_, dicomSummary_, ResourceType_Series);   // new in Orthanc 1.11.1
-          }
+          case ResourceType_Study:
+            content.AddMetadata(status.studyId_, it->first.second, it->second);
+            break;
 
-          if (status.isNewStudy_)
-          {
-            content.AddResource(status.studyId_, ResourceType_Study, dicomSummary_);
-            content.AddMetadata(status.studyId_, MetadataType_MainDicomTagsSignature, DicomMap::GetMainDicomTagsSignature(ResourceType_Study));  // New in Orthanc 1.11.0
-            SetMainDicomSequenceMetadata(content, status.studyId_, dicomSummary_, ResourceType_Study);   // new in Orthanc 1.11.1
-          }
+          case ResourceType_Series:
+            content.AddMetadata(status.seriesId_, it->first.second, it->second);
+            break;
 
-          if (status.isNewPatient_)
-          {
-            content.AddResource(status.patientId_, ResourceType_Patient, dicomSummary_);
-            content.AddMetadata(status.patientId_, MetadataType_MainDicomTagsSignature, DicomMap::GetMainDicomTagsSignature(ResourceType_Patient));  // New in Orthanc 1.11.0
-            SetMainDicomSequenceMetadata(content, status.patientId_, dicomSummary_, ResourceType_Patient);   // new in Orthanc 1.11.1
-          }
+          case ResourceType_Instance:
+            SetInstanceMetadata(content, instanceMetadata_, instanceId,
+                                it->first.second, it->second);
+            break;
 
-          // Attach the auto-computed metadata for the patient/study/series levels
-          std::string now = SystemToolbox::GetNowIsoString(true /* use UTC time (not local time) */);
-          content.AddMetadata(status.seriesId_, MetadataType_LastUpdate, now);
-          content.AddMetadata(status.studyId_, MetadataType_LastUpdate, now);
-          content.AddMetadata(status.patientId_, MetadataType_LastUpdate, now);
+          default:
+            throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+      }
 
-          if (status.isNewSeries_)
-          {
-            if (hasExpectedInstances_)
-            {
-              content.AddMetadata(status.seriesId_, MetadataType_Series_ExpectedNumberOfInstances,
-                                  boost::lexical_cast<std::string>(expectedInstances_));
-            }
+      if (!isReconstruct_)
+      {
+        // Populate the tags of the newly-created resources
+        content.AddResource(instanceId, ResourceType_Instance, dicomSummary_);
+        SetInstanceMetadata(content, instanceMetadata_, instanceId, MetadataType_MainDicomTagsSignature, DicomMap::GetMainDicomTagsSignature(ResourceType_Instance));  // New in Orthanc 1.11.0
+        SetMainDicomSequenceMetadata(content, instanceId, dicomSummary_, ResourceType_Instance);   // new in Orthanc 1.11.1
 
-            // New in Orthanc 1.9.0
-            content.AddMetadata(status.seriesId_, MetadataType_RemoteAet,
-                                origin_.GetRemoteAetC());
-          }
-          // Attach the auto-computed metadata for the instance level,
-          // reflecting these additions into the input metadata map
-          SetInstanceMetadata(content, instanceMetadata_, instanceId,
-                              MetadataType_Instance_ReceptionDate, now);
-          SetInstanceMetadata(content, instanceMetadata_, instanceId, MetadataType_RemoteAet,
-                              origin_.GetRemoteAetC());
-          SetInstanceMetadata(content, instanceMetadata_, instanceId, MetadataType_Instance_Origin, 
-                              EnumerationToString(origin_.GetRequestOrigin()));
+        if (status.isNewSeries_)
+        {
+          content.AddResource(status.seriesId_, ResourceType_Series, dicomSummary_);
+          content.AddMetadata(status.seriesId_, MetadataType_MainDicomTagsSignature, DicomMap::GetMainDicomTagsSignature(ResourceType_Series));  // New in Orthanc 1.11.0
+          SetMainDicomSequenceMetadata(content, status.seriesId_, dicomSummary_, ResourceType_Series);   // new in Orthanc 1.11.1
+        }
 
-          std::string s;
+        if (status.isNewStudy_)
+        {
+          content.AddResource(status.studyId_, ResourceType_Study, dicomSummary_);
+          content.AddMetadata(status.studyId_, MetadataType_MainDicomTagsSignature, DicomMap::GetMainDicomTagsSignature(ResourceType_Study));  // New in Orthanc 1.11.0
+          SetMainDicomSequenceMetadata(content, status.studyId_, dicomSummary_, ResourceType_Study);   // new in Orthanc 1.11.1
+        }
 
-          if (origin_.LookupRemoteIp(s))
-          {
-            // New in Orthanc 1.4.0
-            SetInstanceMetadata(content, instanceMetadata_, instanceId,
-                                MetadataType_Instance_RemoteIp, s);
-          }
+        if (status.isNewPatient_)
+        {
+          content.AddResource(status.patientId_, ResourceType_Patient, dicomSummary_);
+          content.AddMetadata(status.patientId_, MetadataType_MainDicomTagsSignature, DicomMap::GetMainDicomTagsSignature(ResourceType_Patient));  // New in Orthanc 1.11.0
+          SetMainDicomSequenceMetadata(content, status.patientId_, dicomSummary_, ResourceType_Patient);   // new in Orthanc 1.11.1
+        }
 
-          if (origin_.LookupCalledAet(s))
-          {
-            // New in Orthanc 1.4.0
-            SetInstanceMetadata(content, instanceMetadata_, instanceId,
-                                MetadataType_Instance_CalledAet, s);
-          }
+        // Attach the auto-computed metadata for the patient/study/series levels
+        std::string now = SystemToolbox::GetNowIsoString(true /* use UTC time (not local time) */);
+        content.AddMetadata(status.seriesId_, MetadataType_LastUpdate, now);
+        content.AddMetadata(status.studyId_, MetadataType_LastUpdate, now);
+        content.AddMetadata(status.patientId_, MetadataType_LastUpdate, now);
 
-          if (origin_.LookupHttpUsername(s))
+        if (status.isNewSeries_)
+        {
+          if (hasExpectedInstances_)
           {
-            // New in Orthanc 1.4.0
-            SetInstanceMetadata(content, instanceMetadata_, instanceId,
-                                MetadataType_Instance_HttpUsername, s);
+            content.AddMetadata(status.seriesId_, MetadataType_Series_ExpectedNumberOfInstances,
+                                boost::lexical_cast<std::string>(expectedInstances_));
           }
-        }
-
-        // Following metadatas are also updated if reconstructing the instance.
-        // They might be missing since they have been introduced along Orthanc versions.
 
-        if (hasTransferSyntax_)
+          // New in Orthanc 1.9.0
+          content.AddMetadata(status.seriesId_, MetadataType_RemoteAet,
+                              origin_.GetRemoteAetC());
+        }
+        // Attach the auto-computed metadata for the instance level,
+        // reflecting these additions into the input metadata map
+        SetInstanceMetadata(content, instanceMetadata_, instanceId,
+                            MetadataType_Instance_ReceptionDate, now);
+        SetInstanceMetadata(content, instanceMetadata_, instanceId, MetadataType_RemoteAet,
+                            origin_.GetRemoteAetC());
+        SetInstanceMetadata(content, instanceMetadata_, instanceId, MetadataType_Instance_Origin, 
+                            EnumerationToString(origin_.GetRequestOrigin()));
+
+        std::string s;
+
+        if (origin_.LookupRemoteIp(s))
         {
-          // New in Orthanc 1.2.0
+          // New in Orthanc 1.4.0
           SetInstanceMetadata(content, instanceMetadata_, instanceId,
-                              MetadataType_Instance_TransferSyntax,
-                              GetTransferSyntaxUid(transferSyntax_));
+                              MetadataType_Instance_RemoteIp, s);
         }
 
-        if (hasPixelDataOffset_)
+        if (origin_.LookupCalledAet(s))
         {
-          // New in Orthanc 1.9.1
+          // New in Orthanc 1.4.0
           SetInstanceMetadata(content, instanceMetadata_, instanceId,
-                              MetadataType_Instance_PixelDataOffset,
-                              boost::lexical_cast<std::string>(pixelDataOffset_));
+                              MetadataType_Instance_CalledAet, s);
+        }
 
-          // New in Orthanc 1.12.1
-          if (dicomSummary_.GuessPixelDataValueRepresentation(transferSyntax_) != pixelDataVR_)
-          {
-            // Store the VR of pixel data if it doesn't comply with the standard
-            SetInstanceMetadata(content, instanceMetadata_, instanceId,
-                                MetadataType_Instance_PixelDataVR,
-                                EnumerationToString(pixelDataVR_));
-          }
+        if (origin_.LookupHttpUsername(s))
+        {
+          // New in Orthanc 1.4.0
+          SetInstanceMetadata(content, instanceMetadata_, instanceId,
+                              MetadataType_Instance_HttpUsername, s);
         }
-    
-        const DicomValue* value;
-        if ((value = dicomSummary_.TestAndGetValue(DICOM_TAG_SOP_CLASS_UID)) != NULL &&              // NOLINT(bugprone-assignment-in-if-condition)
-            !value->IsNull() &&
-            !value->IsBinary())
+      }
+
+      // Following metadatas are also updated if reconstructing the instance.
+      // They might be missing since they have been introduced along Orthanc versions.
+
+      if (hasTransferSyntax_)
+      {
+        // New in Orthanc 1.2.0
+        SetInstanceMetadata(content, instanceMetadata_, instanceId,
+                            MetadataType_Instance_TransferSyntax,
+                            GetTransferSyntaxUid(transferSyntax_));
+      }
+
+      if (hasPixelDataOffset_)
+      {
+        // New in Orthanc 1.9.1
+        SetInstanceMetadata(content, instanceMetadata_, instanceId,
+                            MetadataType_Instance_PixelDataOffset,
+                            boost::lexical_cast<std::string>(pixelDataOffset_));
+
+        // New in Orthanc 1.12.1
+        if (dicomSummary_.GuessPixelDataValueRepresentation(transferSyntax_) != pixelDataVR_)
         {
+          // Store the VR of pixel data if it doesn't comply with the standard
           SetInstanceMetadata(content, instanceMetadata_, instanceId,
-                              MetadataType_Instance_SopClassUid, value->GetContent());
+                              MetadataType_Instance_PixelDataVR,
+                              EnumerationToString(pixelDataVR_));
         }
+      }
+  
+      const DicomValue* value;
+      if ((value = dicomSummary_.TestAndGetValue(DICOM_TAG_SOP_CLASS_UID)) != NULL &&              // NOLINT(bugprone-assignment-in-if-condition)
+          !value->IsNull() &&
+          !value->IsBinary())
+      {
+        SetInstanceMetadata(content, instanceMetadata_, instanceId,
+                            MetadataType_Instance_SopClassUid, value->GetContent());
+      }
 
 
-        if ((value = dicomSummary_.TestAndGetValue(DICOM_TAG_INSTANCE_NUMBER)) != NULL ||           // NOLINT(bugprone-assignment-in-if-condition)
-            (value = dicomSummary_.TestAndGetValue(DICOM_TAG_IMAGE_INDEX)) != NULL)                 // NOLINT(bugprone-assignment-in-if-condition)
+      if ((value = dicomSummary_.TestAndGetValue(DICOM_TAG_INSTANCE_NUMBER)) != NULL ||           // NOLINT(bugprone-assignment-in-if-condition)
+          (value = dicomSummary_.TestAndGetValue(DICOM_TAG_IMAGE_INDEX)) != NULL)                 // NOLINT(bugprone-assignment-in-if-condition)
+      {
+        if (!value->IsNull() && 
+            !value->IsBinary())
         {
-          if (!value->IsNull() && 
-              !value->IsBinary())
-          {
-            SetInstanceMetadata(content, instanceMetadata_, instanceId,
-                                MetadataType_Instance_IndexInSeries, Toolbox::StripSpaces(value->GetContent()));
-          }
+          SetInstanceMetadata(content, instanceMetadata_, instanceId,
+                              MetadataType_Instance_IndexInSeries, Toolbox::StripSpaces(value->GetContent()));
         }
+      }
 
-    
-        transaction.SetResourcesContent(content);
+  
+      transaction.SetResourcesContent(content);
 
 
-        if (!isReconstruct_)  // a reconstruct shall not trigger any events
+      if (!isReconstruct_)  // a reconstruct shall not trigger any events
+      {
+        // Check whether the series of this new instance is now completed
+        int64_t expectedNumberOfInstances;
+        if (ComputeExpectedNumberOfInstances(expectedNumberOfInstances, dicomSummary_))
         {
-          // Check whether the series of this new instance is now completed
-          int64_t expectedNumberOfInstances;
-          if (ComputeExpectedNumberOfInstances(expectedNumberOfInstances, dicomSummary_))
+          SeriesStatus seriesStatus = transaction.GetSeriesStatus(status.seriesId_, expectedNumberOfInstances);
+          if (seriesStatus == SeriesStatus_Complete)
           {
-            SeriesStatus seriesStatus = transaction.GetSeriesStatus(status.seriesId_, expectedNumberOfInstances);
-            if (seriesStatus == SeriesStatus_Complete)
-            {
-              transaction.LogChange(status.seriesId_, ChangeType_CompletedSeries, ResourceType_Series, hashSeries_);
-            }
+            transaction.LogChange(status.seriesId_, ChangeType_CompletedSeries, ResourceType_Series, hashSeries_);
           }
-          
-          transaction.LogChange(status.seriesId_, ChangeType_NewChildInstance, ResourceType_Series, hashSeries_);
-          transaction.LogChange(status.studyId_, ChangeType_NewChildInstance, ResourceType_Study, hashStudy_);
-          transaction.LogChange(status.patientId_, ChangeType_NewChildInstance, ResourceType_Patient, hashPatient_);
-          
-          // Mark the parent resources of this instance as unstable
-          transaction.GetTransactionContext().MarkAsUnstable(ResourceType_Series, status.seriesId_, hashSeries_);
-          transaction.GetTransactionContext().MarkAsUnstable(ResourceType_Study, status.studyId_, hashStudy_);
-          transaction.GetTransactionContext().MarkAsUnstable(ResourceType_Patient, status.patientId_, hashPatient_);
         }
-
-        transaction.GetTransactionContext().SignalAttachmentsAdded(instanceSize);
-        storeStatus_ = StoreStatus_Success;
+        
+        transaction.LogChange(status.seriesId_, ChangeType_NewChildInstance, ResourceType_Series, hashSeries_);
+        transaction.LogChange(status.studyId_, ChangeType_NewChildInstance, ResourceType_Study, hashStudy_);
+        transaction.LogChange(status.patientId_, ChangeType_NewChildInstance, ResourceType_Patient, hashPatient_);
+        
+        // Mark the parent resources of this instance as unstable
+        transaction.GetTransactionContext().MarkAsUnstable(ResourceType_Series, status.seriesId_, hashSeries_);
+        transaction.GetTransactionContext().MarkAsUnstable(ResourceType_Study, status.studyId_, hashStudy_);
+        transaction.GetTransactionContext().MarkAsUnstable(ResourceType_Patient, status.patientId_, hashPatient_);
       }
-    };
+
+      transaction.GetTransactionContext().SignalAttachmentsAdded(instanceSize);
+      storeStatus_ = StoreStatus_Success;
+    }
+  };
 
 
-    Operations operations(instanceMetadata, dicomSummary, attachments, metadata, origin, overwrite,
-                          hasTransferSyntax, transferSyntax, hasPixelDataOffset, pixelDataOffset,
-                          pixelDataVR, maximumStorageMode, maximumStorageSize, maximumPatients, isReconstruct);
+  StoreStatus StatelessDatabaseOperations::Store(std::map<MetadataType, std::string>& instanceMetadata,
+                                                 const DicomMap& dicomSummary,
+                                                 const Attachments& attachments,
+                                                 const MetadataMap& metadata,
+                                                 const DicomInstanceOrigin& origin,
+                                                 bool overwrite,
+                                                 bool hasTransferSyntax,
+                                                 DicomTransferSyntax transferSyntax,
+                                                 bool hasPixelDataOffset,
+                                                 uint64_t pixelDataOffset,
+                                                 ValueRepresentation pixelDataVR,
+                                                 MaxStorageMode maximumStorageMode,
+                                                 uint64_t maximumStorageSize,
+                                                 unsigned int maximumPatients,
+                                                 bool isReconstruct)
+  {
+    StoreOperations operations(instanceMetadata, dicomSummary, attachments, metadata, origin, overwrite,
+                               hasTransferSyntax, transferSyntax, hasPixelDataOffset, pixelDataOffset,
+                               pixelDataVR, maximumStorageMode, maximumStorageSize, maximumPatients, isReconstruct);
 
     try
     {
-      Apply(operations);
+      Apply(operations, "Store");
       return operations.GetStoreStatus();
     }
     catch (OrthancException& e)
@@ -3087,6 +3775,47 @@ namespace Orthanc
   }
 
 
+  void StatelessDatabaseOperations::StoreBatch(const std::vector<StoreRequest*>& requests)
+  {
+    class Operations : public IReadWriteOperations
+    {
+    private:
+      const std::vector<StoreRequest*>&  requests_;
+
+    public:
+      explicit Operations(const std::vector<StoreRequest*>& requests) :
+        requests_(requests)
+      {
+      }
+
+      virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
+      {
+        for (size_t i = 0; i < requests_.size(); i++)
+        {
+          assert(requests_[i] != NULL);
+          StoreRequest& request = *requests_[i];
+
+          // Re-created at each attempt, as it resets the instance metadata
+          StoreOperations operations(request.GetInstanceMetadata(), request.GetDicomSummary(), request.GetAttachments(),
+                                     request.GetMetadata(), request.GetOrigin(), request.IsOverwrite(),
+                                     request.HasTransferSyntax(), request.GetTransferSyntax(),
+                                     request.HasPixelDataOffset(), request.GetPixelDataOffset(), request.GetPixelDataVR(),
+                                     request.GetMaximumStorageMode(), request.GetMaximumStorageSize(),
+                                     request.GetMaximumPatients(), false /* not a reconstruction */);
+          operations.Apply(transaction);
+          request.SetStatus(operations.GetStoreStatus());
+        }
+      }
+    };
+
+    if (!requests.empty())
+    {
+      Operations operations(requests);
+      Apply(operations, "StoreBatch");
+    }
+  }
+
+
   StoreStatus StatelessDatabaseOperations::AddAttachment(int64_t& newRevision,
                                                          const FileInfo& attachment,
                                                          const std::string& publicId,
@@ -3210,7 +3939,7 @@ namespace Orthanc
 
     Operations operations(newRevision, attachment, publicId, maximumStorageSize, maximumPatients,
                           hasOldRevision, oldRevision, oldMD5);
-    Apply(operations);
+    Apply(operations, "AddAttachment");
     return operations.GetStatus();
   }
 
@@ -3241,7 +3970,7 @@ namespace Orthanc
     };
 
     Operations operations;
-    operations.Apply(*this, target);
+    operations.Apply(*this, "ListAllLabels", target);
   }
   
 
@@ -3312,49 +4041,67 @@ namespace Orthanc
     ServerToolbox::CheckValidLabel(label);
     
     Operations operations(publicId, level, label, operation);
-    Apply(operations);
+    Apply(operations, "ModifyLabel");
   }
 
 
   bool StatelessDatabaseOperations::HasLabelsSupport()
   {
-    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
     return db_.GetDatabaseCapabilities().HasLabelsSupport();
   }
 
   bool StatelessDatabaseOperations::HasExtendedChanges()
   {
-    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
     return db_.GetDatabaseCapabilities().HasExtendedChanges();
   }
 
   bool StatelessDatabaseOperations::HasFindSupport()
   {
-    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
     return db_.GetDatabaseCapabilities().HasFindSupport();
   }
 
+  bool StatelessDatabaseOperations::HasKeysetPaginationSupport()
+  {
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
+    return db_.GetDatabaseCapabilities().HasKeysetPaginationSupport();
+  }
+
+  bool StatelessDatabaseOperations::HasChangesPruningSupport()
+  {
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
+    return db_.GetDatabaseCapabilities().HasChangesPruningSupport();
+  }
+
+  bool StatelessDatabaseOperations::HasFindExplainSupport()
+  {
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
+    return db_.GetDatabaseCapabilities().HasFindExplainSupport();
+  }
+
   bool StatelessDatabaseOperations::HasAttachmentCustomDataSupport()
   {
-    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
     return db_.GetDatabaseCapabilities().HasAttachmentCustomDataSupport();
   }
 
   bool StatelessDatabaseOperations::HasKeyValueStoresSupport()
   {
-    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
     return db_.GetDatabaseCapabilities().HasKeyValueStoresSupport();
   }
 
   bool StatelessDatabaseOperations::HasQueuesSupport()
   {
-    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
     return db_.GetDatabaseCapabilities().HasQueuesSupport();
   }
 
   bool StatelessDatabaseOperations::HasReserveQueueValueSupport()
   {
-    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::shared_lock<FairSharedMutex>, lock, mutex_, databaseLockProfiler_);
     return db_.GetDatabaseCapabilities().HasReserveQueueValueSupport();
   }
 
@@ -3389,13 +4136,38 @@ namespace Orthanc
     if (db_.HasIntegratedFind())
     {
       IntegratedCount operations;
-      operations.Apply(*this, count, request, capabilities);
+      operations.Apply(*this, "ExecuteCount", count, request, capabilities);
     }
     else
     {
       Compatibility operations;
-      operations.Apply(*this, count, request, capabilities);
+      operations.Apply(*this, "ExecuteCount", count, request, capabilities);
+    }
+  }
+
+  void StatelessDatabaseOperations::ExplainFind(Json::Value& target,
+                                                const FindRequest& request)
+  {
+    class Operations : public ReadOnlyOperationsT3<Json::Value&, const FindRequest&,
+                                                   const IDatabaseWrapper::Capabilities&>
+    {
+    public:
+      virtual void ApplyTuple(ReadOnlyTransaction& transaction,
+                              const Tuple& tuple) ORTHANC_OVERRIDE
+      {
+        transaction.ExplainFind(tuple.get<0>(), tuple.get<1>(), tuple.get<2>());
+      }
+    };
+
+    IDatabaseWrapper::Capabilities capabilities = db_.GetDatabaseCapabilities();
+
+    if (!capabilities.HasFindExplainSupport())
+    {
+      throw OrthancException(ErrorCode_NotImplemented, "The database engine cannot explain its lookups");
     }
+
+    Operations operations;
+    operations.Apply(*this, "ExplainFind", target, request, capabilities);
   }
 
   void StatelessDatabaseOperations::ExecuteFind(FindResponse& response,
@@ -3441,7 +4213,7 @@ namespace Orthanc
        * executed in one single transaction.
        **/
       IntegratedFind operations;
-      operations.Apply(*this, response, request, capabilities);
+      operations.Apply(*this, "ExecuteFind", response, request, capabilities);
     }
     else
     {
@@ -3462,7 +4234,7 @@ namespace Orthanc
       {
         // Non-trival case, a transaction is needed
         FindStage find;
-        find.Apply(*this, identifiers, capabilities, request);
+        find.Apply(*this, "ExecuteFind", identifiers, capabilities, request);
       }
 
       ExpandStage expand;
@@ -3474,7 +4246,7 @@ namespace Orthanc
          * another transaction). The database engine must ignore such
          * error cases.
          **/
-        expand.Apply(*this, response, capabilities, request, *it);
+        expand.Apply(*this, "ExecuteFind", response, capabilities, request, *it);
       }
     }
   }
@@ -3521,8 +4293,13 @@ namespace Orthanc
       }
     };
 
+    KeyValueStoresCache::Transaction cached(keyValueStoresCache_, storeId);
+    cached.Store(key, value, valueSize);
+
     Operations operations(storeId, key, value, valueSize);
-    Apply(operations);
+    Apply(operations, "StoreKeyValue");
+
+    cached.Commit();
   }
 
   void StatelessDatabaseOperations::DeleteKeyValue(const std::string& storeId,
@@ -3553,10 +4330,172 @@ namespace Orthanc
       }
     };
 
+    KeyValueStoresCache::Transaction cached(keyValueStoresCache_, storeId);
+    cached.Delete(key);
+
     Operations operations(storeId, key);
-    Apply(operations);
+    Apply(operations, "DeleteKeyValue");
+
+    cached.Commit();
+  }
+
+  void StatelessDatabaseOperations::UpdateKeysValues(const std::string& storeId,
+                                                     const std::map<std::string, std::string>& stored,
+                                                     const std::set<std::string>& deleted)
+  {
+    if (storeId.empty())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    class Operations : public IReadWriteOperations
+    {
+    private:
+      const std::string&                         storeId_;
+      const std::map<std::string, std::string>&  stored_;
+      const std::set<std::string>&               deleted_;
+
+    public:
+      Operations(const std::string& storeId,
+                 const std::map<std::string, std::string>& stored,
+                 const std::set<std::string>& deleted) :
+        storeId_(storeId),
+        stored_(stored),
+        deleted_(deleted)
+      {
+      }
+
+      virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
+      {
+        for (std::map<std::string, std::string>::const_iterator it = stored_.begin(); it != stored_.end(); ++it)
+        {
+          transaction.StoreKeyValue(storeId_, it->first, it->second.empty() ? NULL : it->second.c_str(), it->second.size());
+        }
+
+        for (std::set<std::string>::const_iterator it = deleted_.begin(); it != deleted_.end(); ++it)
+        {
+          transaction.DeleteKeyValue(storeId_, *it);
+        }
+      }
+    };
+
+    if (!stored.empty() ||
+        !deleted.empty())
+    {
+      KeyValueStoresCache::Transaction cached(keyValueStoresCache_, storeId);
+
+      for (std::map<std::string, std::string>::const_iterator it = stored.begin(); it != stored.end(); ++it)
+      {
+        cached.Store(it->first, it->second.empty() ? NULL : it->second.c_str(), it->second.size());
+      }
+
+      for (std::set<std::string>::const_iterator it = deleted.begin(); it != deleted.end(); ++it)
+      {
+        cached.Delete(*it);
+      }
+
+      Operations operations(storeId, stored, deleted);
+      Apply(operations, "UpdateKeysValues");
+
+      cached.Commit();
+    }
+  }
+
+  void StatelessDatabaseOperations::UpdateKeyValue(const std::string& storeId,
+                                                   const std::string& key,
+                                                   IKeyValueUpdater& updater)
+  {
+    if (storeId.empty())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    class Operations : public IReadWriteOperations
+    {
+    private:
+      const std::string&  storeId_;
+      const std::string&  key_;
+      IKeyValueUpdater&   updater_;
+      bool                exists_;
+      std::string         value_;
+
+    public:
+      Operations(const std::string& storeId,
+                 const std::string& key,
+                 IKeyValueUpdater& updater) :
+        storeId_(storeId),
+        key_(key),
+        updater_(updater),
+        exists_(false)
+      {
+      }
+
+      // Value of the key after the last execution of the transaction
+      bool GetNewValue(std::string& value) const
+      {
+        value = value_;
+        return exists_;
+      }
+
+      virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
+      {
+        std::string value;
+        const bool exists = transaction.GetKeyValue(value, storeId_, key_);
+
+        if (!exists)
+        {
+          value.clear();
+        }
+
+        exists_ = exists;
+        value_ = value;
+
+        switch (updater_.Update(value, exists))
+        {
+          case IKeyValueUpdater::Action_Keep:
+            break;
+
+          case IKeyValueUpdater::Action_Store:
+            transaction.StoreKeyValue(storeId_, key_, value.empty() ? NULL : value.c_str(), value.size());
+            exists_ = true;
+            value_.swap(value);
+            break;
+
+          case IKeyValueUpdater::Action_Delete:
+            if (exists)
+            {
+              transaction.DeleteKeyValue(storeId_, key_);
+            }
+            exists_ = false;
+            value_.clear();
+            break;
+
+          default:
+            throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+      }
+    };
+
+    KeyValueStoresCache::Transaction cached(keyValueStoresCache_, storeId);
+    cached.Invalidate(key);
+
+    Operations operations(storeId, key, updater);
+    Apply(operations, "UpdateKeyValue");
+
+    std::string value;
+    if (operations.GetNewValue(value))
+    {
+      cached.Store(key, value.empty() ? NULL : value.c_str(), value.size());
+    }
+    else
+    {
+      cached.Delete(key);
+    }
+
+    cached.Commit();
   }
 
+
   bool StatelessDatabaseOperations::GetKeyValue(std::string& value,
                                                 const std::string& storeId,
                                                 const std::string& key)
@@ -3586,12 +4525,119 @@ namespace Orthanc
       }
     };
 
+    bool exists;
+    uint64_t generation;
+    if (keyValueStoresCache_.Lookup(exists, value, generation, storeId, key))
+    {
+      return exists;
+    }
+
     Operations operations;
-    operations.Apply(*this, value, storeId, key);
+    operations.Apply(*this, "GetKeyValue", value, storeId, key);
+
+    keyValueStoresCache_.Add(storeId, key, operations.HasFound(), value, generation);
 
     return operations.HasFound();
   }
 
+
+  void StatelessDatabaseOperations::GetKeysValues(std::map<std::string, std::string>& values,
+                                                  const std::string& storeId,
+                                                  const std::set<std::string>& keys)
+  {
+    if (storeId.empty())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    class Operations : public ReadOnlyOperationsT3<std::map<std::string, std::string>&,
+                                                   const std::string&,
+                                                   const std::set<std::string>& >
+    {
+    public:
+      virtual void ApplyTuple(ReadOnlyTransaction& transaction,
+                              const Tuple& tuple) ORTHANC_OVERRIDE
+      {
+        std::map<std::string, std::string>& values = tuple.get<0>();
+
+        for (std::set<std::string>::const_iterator it = tuple.get<2>().begin(); it != tuple.get<2>().end(); ++it)
+        {
+          std::string value;
+          if (transaction.GetKeyValue(value, tuple.get<1>(), *it))
+          {
+            values[*it].swap(value);
+          }
+        }
+      }
+    };
+
+    values.clear();
+
+    // The generation of the first lookup is the oldest one, which
+    // makes "Add()" reject the values if any write has occurred since
+    std::set<std::string> missing;
+    bool isFirst = true;
+    uint64_t generation = 0;
+
+    for (std::set<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+    {
+      bool exists;
+      std::string value;
+      uint64_t g;
+      if (keyValueStoresCache_.Lookup(exists, value, g, storeId, *it))
+      {
+        if (exists)
+        {
+          values[*it].swap(value);
+        }
+      }
+      else
+      {
+        missing.insert(*it);
+      }
+
+      if (isFirst)
+      {
+        generation = g;
+        isFirst = false;
+      }
+    }
+
+    if (!missing.empty())
+    {
+      std::map<std::string, std::string> read;
+
+      Operations operations;
+      operations.Apply(*this, "GetKeysValues", read, storeId, missing);
+
+      for (std::set<std::string>::const_iterator it = missing.begin(); it != missing.end(); ++it)
+      {
+        std::map<std::string, std::string>::iterator found = read.find(*it);
+        if (found == read.end())
+        {
+          keyValueStoresCache_.Add(storeId, *it, false, "", generation);
+        }
+        else
+        {
+          keyValueStoresCache_.Add(storeId, *it, true, found->second, generation);
+          values[*it].swap(found->second);
+        }
+      }
+    }
+  }
+
+
+  void StatelessDatabaseOperations::SetKeyValueStoreCacheSize(const std::string& storeId,
+                                                              size_t maximumSize)
+  {
+    if (storeId.empty())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    keyValueStoresCache_.SetMaximumSize(storeId, maximumSize);
+  }
+
   void StatelessDatabaseOperations::EnqueueValue(const std::string& queueId,
                                                  const void* value,
                                                  size_t valueSize)
@@ -3631,7 +4677,7 @@ namespace Orthanc
     };
 
     Operations operations(queueId, value, valueSize);
-    Apply(operations);
+    Apply(operations, "EnqueueValue");
   }
 
   bool StatelessDatabaseOperations::DequeueValue(std::string& value,
@@ -3674,7 +4720,7 @@ namespace Orthanc
     };
 
     Operations operations(value, queueId, origin);
-    Apply(operations);
+    Apply(operations, "DequeueValue");
 
     return operations.HasFound();
   }
@@ -3699,7 +4745,7 @@ namespace Orthanc
     uint64_t size;
 
     Operations operations;
-    operations.Apply(*this, size, queueId);
+    operations.Apply(*this, "GetQueueSize", size, queueId);
 
     return size;
   }
@@ -3753,7 +4799,7 @@ namespace Orthanc
     };
 
     Operations operations(value, valueId, queueId, origin, releaseTimeout);
-    Apply(operations);
+    Apply(operations, "ReserveQueueValue");
 
     return operations.HasFound();
   }
@@ -3788,7 +4834,66 @@ namespace Orthanc
     };
 
     Operations operations(queueId, valueId);
-    Apply(operations);
+    Apply(operations, "AcknowledgeQueueValue");
+  }
+
+
+  void StatelessDatabaseOperations::RenewQueueValueReservation(uint64_t& newValueId,
+                                                               const std::string& queueId,
+                                                               uint64_t valueId,
+                                                               const std::string& value,
+                                                               uint32_t releaseTimeout)
+  {
+    if (queueId.empty() ||
+        releaseTimeout == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    class Operations : public IReadWriteOperations
+    {
+    private:
+      uint64_t&           newValueId_;
+      const std::string&  queueId_;
+      uint64_t            valueId_;
+      const std::string&  value_;
+      uint32_t            releaseTimeout_;
+
+    public:
+      Operations(uint64_t& newValueId,
+                 const std::string& queueId,
+                 uint64_t valueId,
+                 const std::string& value,
+                 uint32_t releaseTimeout) :
+        newValueId_(newValueId),
+        queueId_(queueId),
+        valueId_(valueId),
+        value_(value),
+        releaseTimeout_(releaseTimeout)
+      {
+      }
+
+      virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
+      {
+        // Throws if the reservation has expired
+        transaction.AcknowledgeQueueValue(queueId_, valueId_);
+
+        transaction.EnqueueValue(queueId_, value_.empty() ? NULL : value_.c_str(), value_.size());
+
+        // The value that was just enqueued is the last one of the
+        // queue, unless another transaction has concurrently enqueued
+        // a value: Rollback in such a case
+        std::string reserved;
+        if (!transaction.ReserveQueueValue(reserved, newValueId_, queueId_, QueueOrigin_Back, releaseTimeout_) ||
+            reserved != value_)
+        {
+          throw OrthancException(ErrorCode_DatabaseCannotSerialize);
+        }
+      }
+    };
+
+    Operations operations(newValueId, queueId, valueId, value, releaseTimeout);
+    Apply(operations, "RenewQueueValueReservation");
   }
 
 
@@ -3806,7 +4911,7 @@ namespace Orthanc
     };
 
     Operations operations;
-    operations.Apply(*this, customData, attachmentUuid);
+    operations.Apply(*this, "GetAttachmentCustomData", customData, attachmentUuid);
   }
 
 
@@ -3838,7 +4943,7 @@ namespace Orthanc
     };
 
     Operations operations(attachmentUuid, customData, customDataSize);
-    Apply(operations);
+    Apply(operations, "SetAttachmentCustomData");
   }
 
 
@@ -3900,7 +5005,7 @@ namespace Orthanc
       values_.clear();
 
       Operations operations;
-      operations.Apply(db_, keys_, values_, storeId_, true, "", limit_);
+      operations.Apply(db_, "ListKeysValues", keys_, values_, storeId_, true, "", limit_);
     }
     else
     {
@@ -3917,7 +5022,7 @@ namespace Orthanc
         values_.clear();
 
         Operations operations;
-        operations.Apply(db_, keys_, values_, storeId_, false, lastKey, limit_);
+        operations.Apply(db_, "ListKeysValues", keys_, values_, storeId_, false, lastKey, limit_);
       }
     }
 
@@ -24,13 +24,19 @@
 #pragma once
 
 #include "../../../OrthancFramework/Sources/DicomFormat/DicomMap.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/FairSharedMutex.h"
 
 #include "../DicomInstanceOrigin.h"
+#include "DatabaseOperationsStatistics.h"
 #include "IDatabaseWrapper.h"
+#include "KeyValueStoresCache.h"
 #include "MainDicomTagsRegistry.h"
 
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/shared_ptr.hpp>
-#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_types.hpp>
+#include <vector>
 
 
 namespace Orthanc
@@ -58,6 +64,11 @@ namespace Orthanc
       {
       }
 
+      // Invoked just before the database transaction is committed,
+      // which allows to write into the database atomically with the
+      // transaction (new in Orthanc 1.12.12)
+      virtual void PrepareCommit(IDatabaseWrapper::ITransaction& transaction) = 0;
+
       virtual void Commit() = 0;
 
       virtual int64_t GetCompressedSizeDelta() = 0;
@@ -207,6 +218,19 @@ namespace Orthanc
         return transaction_.GetTotalUncompressedSize();
       }
       
+      void GetResourceStatistics(uint64_t& countStudies,
+                                 uint64_t& countSeries,
+                                 uint64_t& countInstances,
+                                 uint64_t& compressedSize,
+                                 uint64_t& uncompressedSize,
+                                 uint64_t& dicomCompressedSize,
+                                 uint64_t& dicomUncompressedSize,
+                                 int64_t id)
+      {
+        transaction_.GetResourceStatistics(countStudies, countSeries, countInstances, compressedSize,
+                                           uncompressedSize, dicomCompressedSize, dicomUncompressedSize, id);
+      }
+
       bool IsProtectedPatient(int64_t internalId)
       {
         return transaction_.IsProtectedPatient(internalId);
@@ -285,6 +309,13 @@ namespace Orthanc
         transaction_.ExecuteFind(response, request, capabilities);
       }
 
+      void ExplainFind(Json::Value& target,
+                       const FindRequest& request,
+                       const IDatabaseWrapper::Capabilities& capabilities)
+      {
+        transaction_.ExplainFind(target, request, capabilities);
+      }
+
       void ExecuteFind(std::list<std::string>& identifiers,
                        const IDatabaseWrapper::Capabilities& capabilities,
                        const FindRequest& request)
@@ -350,6 +381,24 @@ namespace Orthanc
         transaction_.ClearExportedResources();
       }
 
+      uint64_t DeleteChangesBefore(const std::string& date,
+                                   uint32_t limit)
+      {
+        return transaction_.DeleteChangesBefore(date, limit);
+      }
+
+      uint64_t DeleteExportedResourcesBefore(const std::string& date,
+                                             uint32_t limit)
+      {
+        return transaction_.DeleteExportedResourcesBefore(date, limit);
+      }
+
+      uint64_t DeleteChangesUpTo(int64_t seq,
+                                 uint32_t limit)
+      {
+        return transaction_.DeleteChangesUpTo(seq, limit);
+      }
+
       void ClearMainDicomTags(int64_t id)
       {
         return transaction_.ClearMainDicomTags(id);
@@ -445,6 +494,13 @@ namespace Orthanc
                              uint64_t addedInstanceSize,
                              const std::string& newPatientId);
 
+      // Recycles at most "maximumBatchSize" patients, until the
+      // storage is below the given limits. Returns "true" iff. the
+      // limits are still exceeded (new in Orthanc 1.12.12).
+      bool RecycleBatch(uint64_t maximumStorageSize,
+                        unsigned int maximumPatients,
+                        unsigned int maximumBatchSize);
+
       void AddLabel(int64_t id,
                     const std::string& label)
       {
@@ -532,20 +588,177 @@ namespace Orthanc
     };
     
 
+
+    /**
+     * Arguments and result of one call to "Store()", to be used with
+     * "StoreBatch()" (new in Orthanc 1.12.12). The referenced objects
+     * must outlive the request.
+     **/
+    class StoreRequest : public boost::noncopyable
+    {
+    private:
+      std::map<MetadataType, std::string>&  instanceMetadata_;
+      const DicomMap&                       dicomSummary_;
+      const Attachments&                    attachments_;
+      const MetadataMap&                    metadata_;
+      const DicomInstanceOrigin&            origin_;
+      bool                                  overwrite_;
+      bool                                  hasTransferSyntax_;
+      DicomTransferSyntax                   transferSyntax_;
+      bool                                  hasPixelDataOffset_;
+      uint64_t                              pixelDataOffset_;
+      ValueRepresentation                   pixelDataVR_;
+      MaxStorageMode                        maximumStorageMode_;
+      uint64_t                              maximumStorageSize_;
+      unsigned int                          maximumPatients_;
+      StoreStatus                           status_;
+
+    public:
+      StoreRequest(std::map<MetadataType, std::string>& instanceMetadata,
+                   const DicomMap& dicomSummary,
+                   const Attachments& attachments,
+                   const MetadataMap& metadata,
+                   const DicomInstanceOrigin& origin,
+                   bool overwrite,
+                   bool hasTransferSyntax,
+                   DicomTransferSyntax transferSyntax,
+                   bool hasPixelDataOffset,
+                   uint64_t pixelDataOffset,
+                   ValueRepresentation pixelDataVR,
+                   MaxStorageMode maximumStorageMode,
+                   uint64_t maximumStorageSize,
+                   unsigned int maximumPatients) :
+        instanceMetadata_(instanceMetadata),
+        dicomSummary_(dicomSummary),
+        attachments_(attachments),
+        metadata_(metadata),
+        origin_(origin),
+        overwrite_(overwrite),
+        hasTransferSyntax_(hasTransferSyntax),
+        transferSyntax_(transferSyntax),
+        hasPixelDataOffset_(hasPixelDataOffset),
+        pixelDataOffset_(pixelDataOffset),
+        pixelDataVR_(pixelDataVR),
+        maximumStorageMode_(maximumStorageMode),
+        maximumStorageSize_(maximumStorageSize),
+        maximumPatients_(maximumPatients),
+        status_(StoreStatus_Failure)
+      {
+      }
+
+      std::map<MetadataType, std::string>& GetInstanceMetadata() const
+      {
+        return instanceMetadata_;
+      }
+
+      const DicomMap& GetDicomSummary() const
+      {
+        return dicomSummary_;
+      }
+
+      const Attachments& GetAttachments() const
+      {
+        return attachments_;
+      }
+
+      const MetadataMap& GetMetadata() const
+      {
+        return metadata_;
+      }
+
+      const DicomInstanceOrigin& GetOrigin() const
+      {
+        return origin_;
+      }
+
+      bool IsOverwrite() const
+      {
+        return overwrite_;
+      }
+
+      bool HasTransferSyntax() const
+      {
+        return hasTransferSyntax_;
+      }
+
+      DicomTransferSyntax GetTransferSyntax() const
+      {
+        return transferSyntax_;
+      }
+
+      bool HasPixelDataOffset() const
+      {
+        return hasPixelDataOffset_;
+      }
+
+      uint64_t GetPixelDataOffset() const
+      {
+        return pixelDataOffset_;
+      }
+
+      ValueRepresentation GetPixelDataVR() const
+      {
+        return pixelDataVR_;
+      }
+
+      MaxStorageMode GetMaximumStorageMode() const
+      {
+        return maximumStorageMode_;
+      }
+
+      uint64_t GetMaximumStorageSize() const
+      {
+        return maximumStorageSize_;
+      }
+
+      unsigned int GetMaximumPatients() const
+      {
+        return maximumPatients_;
+      }
+
+      StoreStatus GetStatus() const
+      {
+        return status_;
+      }
+
+      void SetStatus(StoreStatus status)
+      {
+        status_ = status;
+      }
+    };
+
+
   private:
+    class StoreOperations;
     class Transaction;
 
     IDatabaseWrapper&                            db_;
     boost::shared_ptr<MainDicomTagsRegistry>     mainDicomTagsRegistry_;  // "shared_ptr" because of PImpl
 
     // Mutex to protect the configuration options
-    boost::shared_mutex                          mutex_;
+    FairSharedMutex                              mutex_;
     std::unique_ptr<ITransactionContextFactory>  factory_;
     unsigned int                                 maxRetries_;
+    unsigned int                                 slowTransactionThreshold_;
     bool                                         readOnly_;
+    unsigned int                                 replicaMaxStaleness_;   // In milliseconds
+    unsigned int                                 replicaPinDuration_;    // In seconds
+    DatabaseOperationsStatistics                 statistics_;
+
+    // Count of the read-write transactions that were committed since
+    // the startup, as deletions are not logged into the changes
+    boost::mutex                                 committedWritesMutex_;
+    uint64_t                                     committedWrites_;
+    boost::posix_time::ptime                     lastCommittedWrite_;
+
+    // Write-through cache of the key-value stores (new in Orthanc 1.12.12)
+    KeyValueStoresCache                          keyValueStoresCache_;
+
+    bool IsReplicaAllowed();
 
     void ApplyInternal(IReadOnlyOperations* readOperations,
-                       IReadWriteOperations* writeOperations);
+                       IReadWriteOperations* writeOperations,
+                       const char* name);
 
     const FindResponse::Resource &ExecuteSingleResource(FindResponse &response,
                                                         const FindRequest &request);
@@ -555,6 +768,17 @@ namespace Orthanc
                              uint64_t maximumStorageSize,
                              unsigned int maximumPatientCount);
 
+    // New in Orthanc 1.12.12
+    bool IsAboveRecyclingLimits(uint64_t maximumStorageSize,
+                                unsigned int maximumPatientCount);
+
+    // New in Orthanc 1.12.12. Recycles at most "maximumBatchSize"
+    // patients in one single transaction. Returns "true" iff. the
+    // limits are still exceeded afterwards.
+    bool RecycleBatch(uint64_t maximumStorageSize,
+                      unsigned int maximumPatientCount,
+                      unsigned int maximumBatchSize);
+
     bool IsReadOnly()
     {
       return readOnly_;
@@ -568,6 +792,23 @@ namespace Orthanc
     // Only used to handle "ErrorCode_DatabaseCannotSerialize" in the
     // case of collision between multiple writers
     void SetMaxDatabaseRetries(unsigned int maxRetries);
+
+    // Log a warning for each transaction that lasts longer than the
+    // given duration, including its retries. A value of zero (the
+    // default) disables the warnings.
+    void SetSlowTransactionThreshold(unsigned int milliseconds);
+
+    /**
+     * Routes the read-only transactions to the replicas of the
+     * database, if their replication lag is below "maxStaleness"
+     * milliseconds (zero disables the replicas, which is the
+     * default). After each write by this Orthanc server, the reads
+     * are served by the primary database during "pinDuration"
+     * seconds, so that the clients read their own writes. New in
+     * Orthanc 1.12.12, only if "HasReadReplicasSupport()".
+     **/
+    void SetReadReplicas(unsigned int maxStaleness,
+                         unsigned int pinDuration);
     
     // It is assumed that "GetDatabaseVersion()" can run out of a
     // database transaction
@@ -583,10 +824,19 @@ namespace Orthanc
 
     void FlushToDisk();
 
+    void PublishMetrics(MetricsRegistry& registry);
+
+    DatabaseOperationsStatistics& GetStatistics()
+    {
+      return statistics_;
+    }
 
-    void Apply(IReadOnlyOperations& operations);
+    // The "name" of the operations labels their statistics
+    void Apply(IReadOnlyOperations& operations,
+               const char* name);
   
-    void Apply(IReadWriteOperations& operations);
+    void Apply(IReadWriteOperations& operations,
+               const char* name);
 
     void GetAllMetadata(std::map<MetadataType, std::string>& target,
                         const std::string& publicId,
@@ -633,10 +883,34 @@ namespace Orthanc
 
     void GetLastChange(Json::Value& target);
 
+    // Typed version of "GetChanges()" for the consumers of the
+    // changes feed, returns "true" iff the end of the log is reached
+    // (new in Orthanc 1.12.12)
+    bool GetChanges(std::list<ServerIndexChange>& target /* out */,
+                    int64_t since,
+                    uint32_t limit);
+
+    /**
+     * Get a stamp of the content of the database index. If two stamps
+     * are equal, no write has been committed in-between by this
+     * instance of Orthanc. This is used to invalidate the cache of
+     * the lookups. Note that the writes of other Orthanc instances
+     * that share the same database are only detected if they log a
+     * change.
+     **/
+    void GetContentStamp(int64_t& lastChangeIndex /* out */,
+                         uint64_t& committedWrites /* out */);
+
     bool HasExtendedChanges();
 
     bool HasFindSupport();
 
+    bool HasKeysetPaginationSupport();
+
+    bool HasChangesPruningSupport();
+
+    bool HasFindExplainSupport();
+
     bool HasAttachmentCustomDataSupport();
 
     bool HasKeyValueStoresSupport();
@@ -762,6 +1036,26 @@ namespace Orthanc
 
     void DeleteExportedResources();
 
+    /**
+     * Deletes at most "limit" of the oldest changes, and at most
+     * "limit" of the oldest exported resources, whose date is before
+     * "date". Returns "true" if older rows might remain. Only
+     * available if "HasChangesPruningSupport()".
+     **/
+    bool DeleteChangesAndExportedResourcesBefore(const std::string& date,
+                                                 uint32_t limit);
+
+    /**
+     * Deletes at most "limit" of the oldest changes, so that at most
+     * the "keep" most recent changes remain (more precisely, the
+     * changes whose sequence number is below or equal to the last
+     * sequence number minus "keep" are deleted). Returns "true" if
+     * older changes might remain. Only available if
+     * "HasChangesPruningSupport()" (new in Orthanc 1.12.12).
+     **/
+    bool DeleteOldestChanges(uint64_t keep,
+                             uint32_t limit);
+
     void SetGlobalProperty(GlobalProperty property,
                            bool shared,
                            const std::string& value);
@@ -781,6 +1075,25 @@ namespace Orthanc
                              bool limitToThisLevelDicomTags, 
                              ResourceType limitToLevel_);
 
+    // Reconstructs the main DICOM tags of several instances in one
+    // single transaction (new in Orthanc 1.12.12)
+    void ReconstructInstances(const std::list<const ParsedDicomFile*>& instances);
+
+    // Atomically replaces the DICOM file of one instance by another
+    // encoding of the same instance (e.g. after its transcoding in the
+    // background), together with the attachments and the metadata
+    // that depend on this encoding. Throws "ErrorCode_Revision" if the
+    // DICOM file of the instance is not "expectedDicomUuid" anymore
+    // (new in Orthanc 1.12.12).
+    void ReplaceInstanceEncoding(const std::string& instancePublicId,
+                                 const std::string& expectedDicomUuid,
+                                 const Attachments& attachments,
+                                 DicomTransferSyntax transferSyntax,
+                                 bool hasPixelDataOffset,
+                                 uint64_t pixelDataOffset,
+                                 bool hasPixelDataVR,
+                                 ValueRepresentation pixelDataVR);
+
     StoreStatus Store(std::map<MetadataType, std::string>& instanceMetadata,
                       const DicomMap& dicomSummary,
                       const Attachments& attachments,
@@ -797,6 +1110,15 @@ namespace Orthanc
                       unsigned int maximumPatients,
                       bool isReconstruct);
 
+    /**
+     * Stores all the instances of the batch within one single
+     * database transaction, and sets the status of each request. If
+     * an exception is thrown, nothing has been stored, and the caller
+     * should fall back to "Store()" for each instance in order to get
+     * the individual errors.
+     **/
+    void StoreBatch(const std::vector<StoreRequest*>& requests);
+
     StoreStatus AddAttachment(int64_t& newRevision /*out*/,
                               const FileInfo& attachment,
                               const std::string& publicId,
@@ -829,6 +1151,10 @@ namespace Orthanc
     void ExecuteCount(uint64_t& count,
                       const FindRequest& request);
 
+    // Only if "HasFindExplainSupport()" (new in Orthanc 1.12.12)
+    void ExplainFind(Json::Value& target,
+                     const FindRequest& request);
+
     void StoreKeyValue(const std::string& storeId,
                        const std::string& key,
                        const void* value,
@@ -844,10 +1170,61 @@ namespace Orthanc
     void DeleteKeyValue(const std::string& storeId,
                         const std::string& key);
 
+    // Store and delete several keys within one single transaction
+    // (new in Orthanc 1.12.12)
+    void UpdateKeysValues(const std::string& storeId,
+                          const std::map<std::string, std::string>& stored,
+                          const std::set<std::string>& deleted);
+
     bool GetKeyValue(std::string& value,
                      const std::string& storeId,
                      const std::string& key);
 
+    // Read several keys within one single transaction (new in Orthanc
+    // 1.12.12). The keys that are absent from the store are not
+    // present in "values".
+    void GetKeysValues(std::map<std::string, std::string>& values /* out */,
+                       const std::string& storeId,
+                       const std::set<std::string>& keys);
+
+    /**
+     * Enable a write-through cache in the memory of this process for
+     * the values of one key-value store, whose total size is bounded
+     * by "maximumSize" bytes ("0" disables the cache). New in Orthanc
+     * 1.12.12. The cache is only coherent if the store is exclusively
+     * written by this Orthanc server: It must not be used on stores
+     * that are shared by several Orthanc servers.
+     **/
+    void SetKeyValueStoreCacheSize(const std::string& storeId,
+                                   size_t maximumSize);
+
+    // Read-modify-write of one key within one single transaction
+    // (new in Orthanc 1.12.12). "Update()" might be invoked several
+    // times if the transaction is retried.
+    class IKeyValueUpdater : public boost::noncopyable
+    {
+    public:
+      enum Action
+      {
+        Action_Keep,
+        Action_Store,
+        Action_Delete
+      };
+
+      virtual ~IKeyValueUpdater()
+      {
+      }
+
+      // "value" is empty if "exists" is "false". If "Action_Store" is
+      // returned, "value" is the new value of the key.
+      virtual Action Update(std::string& value /* in-out */,
+                            bool exists) = 0;
+    };
+
+    void UpdateKeyValue(const std::string& storeId,
+                        const std::string& key,
+                        IKeyValueUpdater& updater);
+
     void EnqueueValue(const std::string& queueId,
                       const void* value,
                       size_t valueSize);
@@ -873,6 +1250,20 @@ namespace Orthanc
     void AcknowledgeQueueValue(const std::string& queueId,
                                uint64_t valueId);
 
+    /**
+     * Extends the reservation of a value of a queue, that must still
+     * be valid (new in Orthanc 1.12.12). As the database SDK has no
+     * such primitive, this is done in one single transaction by
+     * acknowledging the value, then by enqueuing and reserving it
+     * again, which gives a new identifier to the value. Throws
+     * "ErrorCode_UnknownResource" if the reservation has expired.
+     **/
+    void RenewQueueValueReservation(uint64_t& newValueId /* out */,
+                                    const std::string& queueId,
+                                    uint64_t valueId,
+                                    const std::string& value,
+                                    uint32_t releaseTimeout);
+
     class KeysValuesIterator : public boost::noncopyable
     {
     private:
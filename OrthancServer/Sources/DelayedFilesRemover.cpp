@@ -0,0 +1,331 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "DelayedFilesRemover.h"
+
+#include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/MetricsRegistry.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+#include "../../OrthancFramework/Sources/Toolbox.h"
+#include "ServerContext.h"
+
+#include <boost/lexical_cast.hpp>
+
+
+static const char* const QUEUE_ID = "orthanc-files-to-remove";
+static const char* const UUID = "Uuid";
+static const char* const TYPE = "Type";
+static const char* const CUSTOM_DATA = "CustomData";  // Encoded in base64, as it can be binary
+
+// Duration of the reservation of a file to be removed, in seconds
+static const uint32_t LEASE_DURATION = 60;
+
+
+namespace Orthanc
+{
+  void DelayedFilesRemover::Worker(DelayedFilesRemover* that,
+                                   size_t index)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("FILES-REMOVER-" + boost::lexical_cast<std::string>(index));
+
+    boost::posix_time::ptime lastMetrics = boost::posix_time::neg_infin;
+
+    while (!that->done_)
+    {
+      bool removed = false;
+
+      try
+      {
+        const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+        if (index == 0 &&
+            (now - lastMetrics).total_milliseconds() >= 1000)
+        {
+          // The backlog is only monitored by the first thread
+          lastMetrics = now;
+          that->context_.GetMetricsRegistry().SetIntegerValue(
+            "orthanc_delayed_removals_queue_size", that->context_.GetIndex().GetQueueSize(QUEUE_ID));
+        }
+
+        removed = that->RemoveNextFile();
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Error while processing the queue of the files to be removed: " << e.What();
+      }
+
+      if (!removed)
+      {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+      }
+    }
+  }
+
+
+  void DelayedFilesRemover::Throttle()
+  {
+    if (maximumRate_ != 0)
+    {
+      boost::posix_time::ptime slot;
+
+      {
+        // The removals are evenly spread over time, whatever the
+        // number of threads
+        boost::mutex::scoped_lock lock(throttleMutex_);
+
+        const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        if (nextRemoval_.is_special() ||
+            nextRemoval_ < now)
+        {
+          nextRemoval_ = now;
+        }
+
+        slot = nextRemoval_;
+        nextRemoval_ += boost::posix_time::microseconds(1000000 / maximumRate_);
+      }
+
+      const boost::posix_time::time_duration wait = slot - boost::posix_time::microsec_clock::universal_time();
+      if (wait.is_positive())
+      {
+        boost::this_thread::sleep(wait);
+      }
+    }
+  }
+
+
+  bool DelayedFilesRemover::RemoveNextFile()
+  {
+    std::string value;
+    uint64_t valueId = 0;
+
+    if (hasReservation_)
+    {
+      if (!context_.GetIndex().ReserveQueueValue(value, valueId, QUEUE_ID, QueueOrigin_Front, LEASE_DURATION))
+      {
+        return false;  // The queue is empty
+      }
+    }
+    else if (!context_.GetIndex().DequeueValue(value, QUEUE_ID, QueueOrigin_Front))
+    {
+      return false;  // The queue is empty
+    }
+
+    Throttle();
+
+    bool done = true;
+
+    std::string uuid, customData;
+    FileContentType type;
+
+    try
+    {
+      UnserializeFile(uuid, type, customData, value);
+    }
+    catch (OrthancException&)
+    {
+      LOG(ERROR) << "Discarding a badly formatted value from the queue of the files to be removed";
+      uuid.clear();
+    }
+
+    if (!uuid.empty())
+    {
+      try
+      {
+        context_.RemoveFile(uuid, type, customData);
+        context_.GetMetricsRegistry().IncrementIntegerValue("orthanc_delayed_removals_count", 1);
+      }
+      catch (OrthancException& e)
+      {
+        context_.GetMetricsRegistry().IncrementIntegerValue("orthanc_delayed_removals_failures_count", 1);
+
+        if (e.GetErrorCode() == ErrorCode_InexistentFile ||
+            e.GetErrorCode() == ErrorCode_UnknownResource)
+        {
+          LOG(WARNING) << "The file to be removed has already disappeared from the storage area: " << uuid;
+        }
+        else if (hasReservation_)
+        {
+          // Don't acknowledge the value: The removal will be retried
+          // once the reservation has expired
+          LOG(ERROR) << "Cannot remove file " << uuid << " from the storage area, will retry in "
+                     << LEASE_DURATION << " seconds: " << e.What();
+          done = false;
+        }
+        else
+        {
+          LOG(ERROR) << "Cannot remove file " << uuid << " from the storage area: " << e.What();
+        }
+      }
+    }
+
+    if (hasReservation_ &&
+        done)
+    {
+      context_.GetIndex().AcknowledgeQueueValue(QUEUE_ID, valueId);
+    }
+
+    return true;
+  }
+
+
+  DelayedFilesRemover::DelayedFilesRemover(ServerContext& context,
+                                           unsigned int maximumRate) :
+    context_(context),
+    maximumRate_(maximumRate),
+    hasReservation_(context.GetIndex().HasReserveQueueValueSupport()),
+    done_(true)
+  {
+    if (!context.GetIndex().GetDatabaseCapabilities().HasQueuesSupport())
+    {
+      throw OrthancException(ErrorCode_NotImplemented,
+                             "The database backend has no support for the queues, "
+                             "which is required by the delayed removal of the files");
+    }
+
+    if (maximumRate > 1000000)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (!hasReservation_)
+    {
+      LOG(WARNING) << "The database backend cannot reserve the values of the queues, the files "
+                   << "whose delayed removal is interrupted will remain in the storage area";
+    }
+  }
+
+
+  DelayedFilesRemover::~DelayedFilesRemover()
+  {
+    if (!done_)
+    {
+      LOG(ERROR) << "DelayedFilesRemover::Stop() should have been manually called";
+      Stop();
+    }
+  }
+
+
+  void DelayedFilesRemover::Start(unsigned int threadsCount)
+  {
+    if (!done_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (threadsCount == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    done_ = false;
+
+    threads_.resize(threadsCount);
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+      threads_[i] = new boost::thread(Worker, this, i);
+    }
+  }
+
+
+  void DelayedFilesRemover::Stop()
+  {
+    done_ = true;
+
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+      if (threads_[i] != NULL)
+      {
+        if (threads_[i]->joinable())
+        {
+          threads_[i]->join();
+        }
+
+        delete threads_[i];
+      }
+    }
+
+    threads_.clear();
+  }
+
+
+  const char* DelayedFilesRemover::GetQueueId()
+  {
+    return QUEUE_ID;
+  }
+
+
+  void DelayedFilesRemover::SerializeFile(std::string& target,
+                                          const std::string& uuid,
+                                          FileContentType type,
+                                          const std::string& customData)
+  {
+    Json::Value value = Json::objectValue;
+    value[UUID] = uuid;
+    value[TYPE] = static_cast<int>(type);
+
+    if (!customData.empty())
+    {
+      std::string encoded;
+      Toolbox::EncodeBase64(encoded, customData);
+      value[CUSTOM_DATA] = encoded;
+    }
+
+    Toolbox::WriteFastJson(target, value);
+  }
+
+
+  void DelayedFilesRemover::UnserializeFile(std::string& uuid,
+                                            FileContentType& type,
+                                            std::string& customData,
+                                            const std::string& source)
+  {
+    Json::Value value;
+
+    if (!Toolbox::ReadJson(value, source) ||
+        value.type() != Json::objectValue ||
+        !value.isMember(UUID) ||
+        !value.isMember(TYPE) ||
+        value[UUID].type() != Json::stringValue ||
+        !value[TYPE].isInt() ||
+        (value.isMember(CUSTOM_DATA) &&
+         value[CUSTOM_DATA].type() != Json::stringValue))
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    uuid = value[UUID].asString();
+    type = static_cast<FileContentType>(value[TYPE].asInt());
+
+    if (value.isMember(CUSTOM_DATA))
+    {
+      Toolbox::DecodeBase64(customData, value[CUSTOM_DATA].asString());
+    }
+    else
+    {
+      customData.clear();
+    }
+  }
+}
@@ -0,0 +1,92 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include "../../OrthancFramework/Sources/Enumerations.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <stdint.h>
+#include <vector>
+
+namespace Orthanc
+{
+  class ServerContext;
+
+  /**
+   * Background removal of the files of the deleted attachments (new
+   * in Orthanc 1.12.12). The files are enqueued into a queue of the
+   * database, in the same transaction as the deletion of the
+   * resources, which makes the deletions return as soon as the index
+   * is updated. A pool of threads then removes the files from the
+   * storage area, with an optional limit on the number of removals
+   * per second. If the database can reserve the values of its
+   * queues, a file whose removal was interrupted (e.g. by a crash) is
+   * removed again once its reservation has expired.
+   **/
+  class DelayedFilesRemover : public boost::noncopyable
+  {
+  private:
+    ServerContext&              context_;
+    unsigned int                maximumRate_;  // Removals per second, "0" means no limit
+    bool                        hasReservation_;
+    bool                        done_;
+    std::vector<boost::thread*> threads_;
+
+    boost::mutex              throttleMutex_;
+    boost::posix_time::ptime  nextRemoval_;
+
+    static void Worker(DelayedFilesRemover* that,
+                       size_t index);
+
+    void Throttle();
+
+    bool RemoveNextFile();
+
+  public:
+    DelayedFilesRemover(ServerContext& context,
+                        unsigned int maximumRate);
+
+    ~DelayedFilesRemover();
+
+    void Start(unsigned int threadsCount);
+
+    void Stop();
+
+    static const char* GetQueueId();
+
+    static void SerializeFile(std::string& target,
+                              const std::string& uuid,
+                              FileContentType type,
+                              const std::string& customData);
+
+    static void UnserializeFile(std::string& uuid,
+                                FileContentType& type,
+                                std::string& customData,
+                                const std::string& source);
+  };
+}
@@ -24,8 +24,10 @@
 #pragma once
 
 #include "../../OrthancFramework/Sources/Images/ImageAccessor.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
 
 #include <boost/noncopyable.hpp>
+#include <vector>
 
 namespace Orthanc
 {
@@ -40,4 +42,62 @@ namespace Orthanc
                                   size_t size,
                                   unsigned int frame) = 0;
   };
+
+
+  // Owns the frames that are decoded by one call to a batch decoder
+  // (new in Orthanc 1.12.12)
+  class DecodedFrames : public boost::noncopyable
+  {
+  private:
+    std::vector<ImageAccessor*>  frames_;
+
+  public:
+    ~DecodedFrames()
+    {
+      Clear();
+    }
+
+    void Clear()
+    {
+      for (size_t i = 0; i < frames_.size(); i++)
+      {
+        delete frames_[i];
+      }
+
+      frames_.clear();
+    }
+
+    // Takes the ownership of "frame"
+    void Add(ImageAccessor* frame)
+    {
+      if (frame == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+      else
+      {
+        frames_.push_back(frame);
+      }
+    }
+
+    size_t GetSize() const
+    {
+      return frames_.size();
+    }
+
+    ImageAccessor* Release(size_t index)
+    {
+      if (index >= frames_.size() ||
+          frames_[index] == NULL)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+      else
+      {
+        ImageAccessor* frame = frames_[index];
+        frames_[index] = NULL;
+        return frame;
+      }
+    }
+  };
 }
@@ -51,6 +51,13 @@ namespace Orthanc
     virtual bool FilterIncomingInstance(const DicomInstanceToStore& instance,
                                         const Json::Value& simplified) = 0;
 
+    /**
+     * Returns "false" iff this listener does not read the simplified
+     * tags of the incoming instances, which are then not extracted
+     * from the dataset (new in Orthanc 1.12.12).
+     **/
+    virtual bool IsSimplifiedTagsOfIncomingInstanceNeeded() = 0;
+
     /**
      * Returns "true" iff some DICOM instance received by the DICOM
      * SCP is to be accepted. If the instance is discarded,
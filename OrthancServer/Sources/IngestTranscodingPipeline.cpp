@@ -0,0 +1,191 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "IngestTranscodingPipeline.h"
+
+#include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+#include "ServerContext.h"
+
+
+// Maximum number of instances waiting for a thread. If more instances
+// are received, they are synchronously transcoded, which slows down
+// the ingest down to the pace of the codecs.
+static const unsigned int MAX_PENDING_INSTANCES_PER_THREAD = 64;
+
+
+namespace Orthanc
+{
+  class IngestTranscodingPipeline::InstanceRunnable : public IRunnable
+  {
+  private:
+    IngestTranscodingPipeline&  that_;
+    std::string                 instanceId_;
+
+  public:
+    InstanceRunnable(IngestTranscodingPipeline& that,
+                     const std::string& instanceId) :
+      that_(that),
+      instanceId_(instanceId)
+    {
+    }
+
+    virtual ~InstanceRunnable()
+    {
+      // Also invoked if the task is canceled by "ThreadPool::Stop()"
+      that_.SignalInstanceDone();
+    }
+
+    virtual void Run() ORTHANC_OVERRIDE
+    {
+      try
+      {
+        that_.context_.TranscodeStoredInstance(instanceId_);
+      }
+      catch (OrthancException& e)
+      {
+        // The instance keeps its original transfer syntax
+        LOG(WARNING) << "Cannot transcode instance " << instanceId_
+                     << " in the background: " << e.What();
+      }
+    }
+  };
+
+
+  void IngestTranscodingPipeline::SignalInstanceDone()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    assert(pendingInstances_ > 0);
+    pendingInstances_--;
+  }
+
+
+  IngestTranscodingPipeline::IngestTranscodingPipeline(ServerContext& context) :
+    context_(context),
+    countThreads_(0),
+    pendingInstances_(0),
+    running_(false)
+  {
+    pool_.SetLoggingThreadName("TRANSCODING");
+  }
+
+
+  IngestTranscodingPipeline::~IngestTranscodingPipeline()
+  {
+    if (running_)
+    {
+      LOG(ERROR) << "INTERNAL ERROR: IngestTranscodingPipeline::Stop() should be invoked manually";
+      Stop();
+    }
+  }
+
+
+  void IngestTranscodingPipeline::Start(unsigned int countThreads)
+  {
+    if (countThreads == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (running_)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      countThreads_ = countThreads;
+      running_ = true;
+    }
+
+    pool_.SetCountThreads(countThreads);
+    pool_.Start();
+  }
+
+
+  void IngestTranscodingPipeline::Stop()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!running_)
+      {
+        return;
+      }
+
+      running_ = false;
+
+      if (pendingInstances_ > 0)
+      {
+        // The instances that are still in the queue keep their
+        // original transfer syntax
+        LOG(WARNING) << "Stopping the background ingest transcoding, up to " << pendingInstances_
+                     << " instance(s) will keep their original transfer syntax";
+      }
+    }
+
+    pool_.Stop();
+  }
+
+
+  bool IngestTranscodingPipeline::Reserve()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!running_ ||
+        pendingInstances_ >= countThreads_ * MAX_PENDING_INSTANCES_PER_THREAD)
+    {
+      return false;
+    }
+    else
+    {
+      pendingInstances_++;
+      return true;
+    }
+  }
+
+
+  void IngestTranscodingPipeline::CancelReservation()
+  {
+    SignalInstanceDone();
+  }
+
+
+  void IngestTranscodingPipeline::Submit(const std::string& instanceId)
+  {
+    try
+    {
+      // The runnable releases the reservation once it is destroyed
+      pool_.Submit(new InstanceRunnable(*this, instanceId));
+    }
+    catch (OrthancException&)
+    {
+      // The pipeline is being stopped
+      LOG(WARNING) << "Instance " << instanceId << " keeps its original transfer syntax, "
+                   << "as the background ingest transcoding is stopping";
+    }
+  }
+}
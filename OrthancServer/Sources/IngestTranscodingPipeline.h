@@ -0,0 +1,81 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include "../../OrthancFramework/Sources/MultiThreading/ThreadPool.h"
+
+#include <boost/thread/mutex.hpp>
+
+namespace Orthanc
+{
+  class ServerContext;
+
+  /**
+   * Background transcoding of the incoming DICOM instances to the
+   * "IngestTranscoding" transfer syntax. The instances are first
+   * stored with their original transfer syntax, which allows to
+   * acknowledge them without waiting for the codecs. Then, the DICOM
+   * file of each instance is transcoded by a pool of threads, and
+   * atomically swapped in the database. New in Orthanc 1.12.12.
+   **/
+  class IngestTranscodingPipeline : public boost::noncopyable
+  {
+  private:
+    class InstanceRunnable;
+
+    ServerContext&  context_;
+    ThreadPool      pool_;
+    boost::mutex    mutex_;
+    unsigned int    countThreads_;
+    unsigned int    pendingInstances_;
+    bool            running_;
+
+    void SignalInstanceDone();
+
+  public:
+    explicit IngestTranscodingPipeline(ServerContext& context);
+
+    ~IngestTranscodingPipeline();
+
+    void Start(unsigned int countThreads);
+
+    void Stop();
+
+    // Reserves a place in the queue of the pipeline, before storing
+    // an instance with its original transfer syntax. Returns "false"
+    // if the pipeline is saturated, in which case the instance must
+    // be transcoded synchronously.
+    bool Reserve();
+
+    // Cancels a place that was reserved by "Reserve()", if the
+    // instance could not be stored
+    void CancelReservation();
+
+    // Schedules the transcoding of an instance that was just stored,
+    // using a place that was reserved by "Reserve()"
+    void Submit(const std::string& instanceId);
+  };
+}
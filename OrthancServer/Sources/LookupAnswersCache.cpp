@@ -0,0 +1,195 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "LookupAnswersCache.h"
+
+#include "../../OrthancFramework/Sources/OrthancException.h"
+#include "Database/StatelessDatabaseOperations.h"
+
+#include <cassert>
+
+
+namespace Orthanc
+{
+  struct LookupAnswersCache::Entry : public boost::noncopyable
+  {
+    Stamp                              stamp_;
+    boost::posix_time::ptime           time_;
+    boost::shared_ptr<IDynamicObject>  answer_;
+
+    Entry(const Stamp& stamp,
+          const boost::shared_ptr<IDynamicObject>& answer) :
+      stamp_(stamp),
+      time_(boost::posix_time::microsec_clock::universal_time()),
+      answer_(answer)
+    {
+    }
+  };
+
+
+  LookupAnswersCache::Stamp::Stamp(StatelessDatabaseOperations& database)
+  {
+    database.GetContentStamp(lastChangeIndex_, committedWrites_);
+  }
+
+
+  void LookupAnswersCache::RemoveOldest()
+  {
+    Entry* entry = NULL;
+    index_.RemoveOldest(entry);
+
+    assert(entry != NULL);
+    delete entry;
+  }
+
+
+  void LookupAnswersCache::MakeRoom(size_t maxSize)
+  {
+    while (index_.GetSize() > maxSize)
+    {
+      RemoveOldest();
+      statistics_.AddEviction();
+    }
+  }
+
+
+  LookupAnswersCache::LookupAnswersCache(size_t maxSize,
+                                         unsigned int staleness) :
+    maxSize_(maxSize),
+    staleness_(staleness)
+  {
+    if (maxSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The cache of the lookups must contain at least one answer");
+    }
+  }
+
+
+  LookupAnswersCache::~LookupAnswersCache()
+  {
+    Clear();
+  }
+
+
+  boost::shared_ptr<IDynamicObject> LookupAnswersCache::Lookup(const std::string& key,
+                                                               const Stamp& stamp)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Entry* entry = NULL;
+    if (index_.Contains(key, entry))
+    {
+      assert(entry != NULL);
+
+      if (entry->stamp_ == stamp ||
+          (staleness_ != 0 &&
+           boost::posix_time::microsec_clock::universal_time() - entry->time_ <= boost::posix_time::seconds(staleness_)))
+      {
+        statistics_.AddHit();
+        index_.MakeMostRecent(key);
+        return entry->answer_;
+      }
+      else
+      {
+        // The database index has changed since the answer was computed
+        delete index_.Invalidate(key);
+      }
+    }
+
+    statistics_.AddMiss();
+    return boost::shared_ptr<IDynamicObject>();
+  }
+
+
+  void LookupAnswersCache::Store(const std::string& key,
+                                 const Stamp& stamp,
+                                 const boost::shared_ptr<IDynamicObject>& answer)
+  {
+    if (answer.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    std::unique_ptr<Entry> entry(new Entry(stamp, answer));
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Entry* previous = NULL;
+    if (index_.Contains(key, previous))
+    {
+      // Another thread has computed the same answer in the meantime
+      delete index_.Invalidate(key);
+    }
+
+    MakeRoom(maxSize_ - 1);
+    index_.Add(key, entry.release());
+  }
+
+
+  void LookupAnswersCache::Clear()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    while (!index_.IsEmpty())
+    {
+      RemoveOldest();
+    }
+  }
+
+
+  size_t LookupAnswersCache::GetNumberOfItems()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return index_.GetSize();
+  }
+
+
+  size_t LookupAnswersCache::GetMaximumSize()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return maxSize_;
+  }
+
+
+  void LookupAnswersCache::SetMaximumSize(size_t maxSize)
+  {
+    if (maxSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The cache of the lookups must contain at least one answer");
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    maxSize_ = maxSize;
+    MakeRoom(maxSize_);
+  }
+
+
+  void LookupAnswersCache::GetStatistics(CacheStatistics& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    target = statistics_;
+  }
+}
@@ -0,0 +1,125 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include "../../OrthancFramework/Sources/Cache/CacheStatistics.h"
+#include "../../OrthancFramework/Sources/Cache/LeastRecentlyUsedIndex.h"
+#include "../../OrthancFramework/Sources/IDynamicObject.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Orthanc
+{
+  class StatelessDatabaseOperations;
+
+  /**
+   * Cache of the answers to the lookups (C-FIND and "/tools/find"),
+   * indexed by a normalized version of the query. Each answer is
+   * stamped with the content of the database index at the time it
+   * was computed, and is reused as long as this content has not
+   * changed, or as long as the answer is younger than the staleness
+   * window. New in Orthanc 1.12.12.
+   **/
+  class LookupAnswersCache : public boost::noncopyable
+  {
+  public:
+    class Stamp
+    {
+    private:
+      int64_t   lastChangeIndex_;
+      uint64_t  committedWrites_;
+
+    public:
+      Stamp() :
+        lastChangeIndex_(0),
+        committedWrites_(0)
+      {
+      }
+
+      Stamp(int64_t lastChangeIndex,
+            uint64_t committedWrites) :
+        lastChangeIndex_(lastChangeIndex),
+        committedWrites_(committedWrites)
+      {
+      }
+
+      // WARNING: The stamp must be read *before* running the lookup,
+      // so that a write that is concurrent with the lookup
+      // invalidates its answer
+      explicit Stamp(StatelessDatabaseOperations& database);
+
+      bool operator== (const Stamp& other) const
+      {
+        return (lastChangeIndex_ == other.lastChangeIndex_ &&
+                committedWrites_ == other.committedWrites_);
+      }
+    };
+
+  private:
+    struct Entry;
+
+    typedef LeastRecentlyUsedIndex<std::string, Entry*>  Index;
+
+    boost::mutex     mutex_;
+    Index            index_;
+    size_t           maxSize_;
+    unsigned int     staleness_;
+    CacheStatistics  statistics_;
+
+    void RemoveOldest();
+
+    void MakeRoom(size_t maxSize);
+
+  public:
+    // "staleness" is the number of seconds during which an answer
+    // is reused even if the database index has changed (0 means
+    // that the answers are reused only if the index is unchanged)
+    LookupAnswersCache(size_t maxSize,
+                       unsigned int staleness);
+
+    ~LookupAnswersCache();
+
+    // Returns an empty pointer if no valid answer is cached
+    boost::shared_ptr<IDynamicObject> Lookup(const std::string& key,
+                                             const Stamp& stamp);
+
+    void Store(const std::string& key,
+               const Stamp& stamp,
+               const boost::shared_ptr<IDynamicObject>& answer);
+
+    void Clear();
+
+    size_t GetNumberOfItems();
+
+    size_t GetMaximumSize();
+
+    void SetMaximumSize(size_t maxSize);
+
+    void GetStatistics(CacheStatistics& target);
+  };
+}
@@ -35,8 +35,10 @@
 #include "../../OrthancFramework/Sources/HttpServer/StringHttpOutput.h"
 #include "../../OrthancFramework/Sources/Logging.h"
 #include "../../OrthancFramework/Sources/Lua/LuaFunctionCall.h"
+#include "../../OrthancFramework/Sources/MultiThreading/LockProfiler.h"
 
 #include <OrthancServerResources.h>
+#include <boost/thread/tss.hpp>
 
 static const char* ON_HEART_BEAT = "OnHeartBeat";
 
@@ -45,10 +47,121 @@ namespace Orthanc
 {
   struct LuaScripting::PImpl
   {
+    struct Timer
+    {
+      std::string               function_;
+      unsigned int              period_;  // In seconds
+      boost::posix_time::ptime  next_;
+    };
+
+    typedef std::map<std::string, Timer>  Timers;
+
     LuaJobManager  jobManager_;
+
+    // Scheduled and background work (new in Orthanc 1.12.12). The
+    // timers are indexed by their name, so that the "SetTimer()" that
+    // is run by each of the Lua contexts creates only one timer.
+    boost::mutex                 schedulerMutex_;
+    Timers                       timers_;  // Protected by "schedulerMutex_"
+    SharedMessageQueue           backgroundTasks_;
+    std::unique_ptr<LuaContext>  schedulerContext_;  // Only used by the scheduler thread, can be NULL
+
+    // Independent Lua contexts dedicated to the synchronous filters
+    // (new in Orthanc 1.12.12)
+    boost::mutex               filtersMutex_;
+    boost::condition_variable  filtersAvailable_;
+    std::vector<LuaContext*>   filtersContexts_;
+    std::vector<LuaContext*>   availableFiltersContexts_;  // Protected by "filtersMutex_"
+
+    ~PImpl()
+    {
+      for (size_t i = 0; i < filtersContexts_.size(); i++)
+      {
+        assert(filtersContexts_[i] != NULL);
+        delete filtersContexts_[i];
+      }
+    }
   };
 
 
+  static void NoCleanup(LuaContext* lua)
+  {
+    // The Lua contexts are owned by "LuaScripting", not by the thread
+  }
+
+  // The filter context that is in use by the current thread, if any,
+  // to allow reentrant calls (e.g. if a filter calls the REST API,
+  // which in turn invokes another filter)
+  static boost::thread_specific_ptr<LuaContext>  currentFilterContext_(NoCleanup);
+
+
+#if ORTHANC_ENABLE_LOCK_PROFILING == 1
+  static LockProfiler  luaLockProfiler_("LuaScripting");
+#endif
+
+
+  LuaScripting::Lock::Lock(LuaScripting& that) :
+    that_(that),
+#if ORTHANC_ENABLE_LOCK_PROFILING == 1
+    lock_(that.mutex_, luaLockProfiler_, "LuaScripting::Lock")
+#else
+    lock_(that.mutex_)
+#endif
+  {
+  }
+
+
+  LuaScripting::FilterLock::FilterLock(LuaScripting& that) :
+    that_(that),
+    lua_(NULL),
+    acquired_(false)
+  {
+    PImpl& pimpl = *that_.pimpl_;
+
+    if (pimpl.filtersContexts_.empty())
+    {
+      lock_.reset(new Lock(that_));
+      lua_ = &lock_->GetLua();
+    }
+    else if (currentFilterContext_.get() != NULL)
+    {
+      lua_ = currentFilterContext_.get();
+    }
+    else
+    {
+      boost::mutex::scoped_lock lock(pimpl.filtersMutex_);
+
+      while (pimpl.availableFiltersContexts_.empty())
+      {
+        pimpl.filtersAvailable_.wait(lock);
+      }
+
+      lua_ = pimpl.availableFiltersContexts_.back();
+      pimpl.availableFiltersContexts_.pop_back();
+
+      acquired_ = true;
+      currentFilterContext_.reset(lua_);
+    }
+
+    assert(lua_ != NULL);
+  }
+
+
+  LuaScripting::FilterLock::~FilterLock()
+  {
+    if (acquired_)
+    {
+      PImpl& pimpl = *that_.pimpl_;
+
+      currentFilterContext_.reset(NULL);
+
+      boost::mutex::scoped_lock lock(pimpl.filtersMutex_);
+      pimpl.availableFiltersContexts_.push_back(lua_);
+      pimpl.filtersAvailable_.notify_one();
+    }
+  }
+
+
   class LuaScripting::IEvent : public IDynamicObject
   {
   public:
@@ -56,6 +169,40 @@ namespace Orthanc
   };
 
 
+  namespace
+  {
+    class BackgroundTask : public IDynamicObject
+    {
+    private:
+      std::string  function_;
+      bool         hasArgument_;
+      std::string  argument_;
+
+    public:
+      BackgroundTask(const std::string& function,
+                     const char* argument) :
+        function_(function),
+        hasArgument_(argument != NULL)
+      {
+        if (argument != NULL)
+        {
+          argument_ = argument;
+        }
+      }
+
+      const std::string& GetFunction() const
+      {
+        return function_;
+      }
+
+      const std::string* GetArgument() const
+      {
+        return (hasArgument_ ? &argument_ : NULL);
+      }
+    };
+  }
+
+
   class LuaScripting::OnStoredInstanceEvent : public LuaScripting::IEvent
   {
   private:
@@ -243,7 +390,7 @@ namespace Orthanc
       }
       
       GetInfoOperations operations(change_);
-      that.context_.GetIndex().Apply(operations);
+      that.context_.GetIndex().Apply(operations, "LuaGetInfo");
       operations.CallLua(that, name);
     }
   };
@@ -799,6 +946,314 @@ namespace Orthanc
   }
 
 
+  bool LuaScripting::LookupResourceArgument(ServerContext*& serverContext,
+                                           std::string& publicId,
+                                           ResourceType& level,
+                                           lua_State* state,
+                                           int countArguments,
+                                           const char* functionName)
+  {
+    serverContext = GetServerContext(state);
+    if (serverContext == NULL)
+    {
+      LOG(ERROR) << "Lua: The Orthanc API is unavailable";
+      return false;
+    }
+
+    // Check the types of the arguments
+    int nArgs = lua_gettop(state);
+    if (nArgs != countArguments ||
+        !lua_isstring(state, 1))                   // resourceId
+    {
+      LOG(ERROR) << "Lua: Bad parameters to " << functionName << "()";
+      return false;
+    }
+
+    publicId = lua_tostring(state, 1);
+
+    if (serverContext->GetIndex().LookupResourceType(level, publicId))
+    {
+      return true;
+    }
+    else
+    {
+      // Not an error, the resource might have been deleted in the meantime
+      LOG(INFO) << "Lua: Unknown resource in " << functionName << "(): " << publicId;
+      return false;
+    }
+  }
+
+
+  // Syntax in Lua: tags = GetMainDicomTags(resourceId)
+  // For an instance, also contains the main DICOM tags of its parents
+  int LuaScripting::GetMainDicomTags(lua_State* state)
+  {
+    ServerContext* serverContext = NULL;
+    std::string publicId;
+    ResourceType level;
+
+    try
+    {
+      if (LookupResourceArgument(serverContext, publicId, level, state, 1, "GetMainDicomTags"))
+      {
+        DicomMap tags;
+
+        if (level == ResourceType_Instance ?
+            serverContext->GetIndex().GetAllMainDicomTags(tags, publicId) :
+            serverContext->GetIndex().GetMainDicomTags(tags, publicId, level, level))
+        {
+          std::set<DicomTag> content;
+          tags.GetTags(content);
+
+          lua_createtable(state, 0, static_cast<int>(content.size()));
+
+          for (std::set<DicomTag>::const_iterator it = content.begin(); it != content.end(); ++it)
+          {
+            const DicomValue& value = tags.GetValue(*it);
+            if (value.IsString())
+            {
+              const std::string name = FromDcmtkBridge::GetTagName(*it, "");
+              lua_pushlstring(state, name.c_str(), name.size());
+              lua_pushlstring(state, value.GetContent().c_str(), value.GetContent().size());
+              lua_rawset(state, -3);
+            }
+          }
+
+          return 1;
+        }
+      }
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "Lua: " << e.What();
+    }
+
+    lua_pushnil(state);
+    return 1;
+  }
+
+
+  // Syntax in Lua: metadata = GetMetadata(resourceId)
+  int LuaScripting::GetMetadata(lua_State* state)
+  {
+    ServerContext* serverContext = NULL;
+    std::string publicId;
+    ResourceType level;
+
+    try
+    {
+      if (LookupResourceArgument(serverContext, publicId, level, state, 1, "GetMetadata"))
+      {
+        typedef std::map<MetadataType, std::string>  Metadata;
+
+        Metadata metadata;
+        serverContext->GetIndex().GetAllMetadata(metadata, publicId, level);
+
+        lua_createtable(state, 0, static_cast<int>(metadata.size()));
+
+        for (Metadata::const_iterator it = metadata.begin(); it != metadata.end(); ++it)
+        {
+          const std::string name = EnumerationToString(it->first);
+          lua_pushlstring(state, name.c_str(), name.size());
+          lua_pushlstring(state, it->second.c_str(), it->second.size());
+          lua_rawset(state, -3);
+        }
+
+        return 1;
+      }
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "Lua: " << e.What();
+    }
+
+    lua_pushnil(state);
+    return 1;
+  }
+
+
+  // Syntax in Lua: parentId = GetParentId(resourceId)
+  int LuaScripting::GetParentId(lua_State* state)
+  {
+    ServerContext* serverContext = NULL;
+    std::string publicId;
+    ResourceType level;
+
+    try
+    {
+      std::string parent;
+      if (LookupResourceArgument(serverContext, publicId, level, state, 1, "GetParentId") &&
+          level != ResourceType_Patient &&
+          serverContext->GetIndex().LookupParent(parent, publicId))
+      {
+        lua_pushlstring(state, parent.c_str(), parent.size());
+        return 1;
+      }
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "Lua: " << e.What();
+    }
+
+    lua_pushnil(state);
+    return 1;
+  }
+
+
+  // Syntax in Lua: info = GetAttachmentInfo(resourceId, attachmentName)
+  int LuaScripting::GetAttachmentInfo(lua_State* state)
+  {
+    ServerContext* serverContext = NULL;
+    std::string publicId;
+    ResourceType level;
+
+    try
+    {
+      if (LookupResourceArgument(serverContext, publicId, level, state, 2, "GetAttachmentInfo"))
+      {
+        if (!lua_isstring(state, 2))
+        {
+          LOG(ERROR) << "Lua: Bad parameters to GetAttachmentInfo()";
+          lua_pushnil(state);
+          return 1;
+        }
+
+        const FileContentType contentType = StringToContentType(lua_tostring(state, 2));
+
+        FileInfo info;
+        int64_t revision;
+        if (serverContext->GetIndex().LookupAttachment(info, revision, level, publicId, contentType))
+        {
+          lua_createtable(state, 0, 7);
+
+          lua_pushstring(state, "Uuid");
+          lua_pushlstring(state, info.GetUuid().c_str(), info.GetUuid().size());
+          lua_rawset(state, -3);
+
+          lua_pushstring(state, "ContentType");
+          lua_pushinteger(state, static_cast<lua_Integer>(info.GetContentType()));
+          lua_rawset(state, -3);
+
+          lua_pushstring(state, "UncompressedSize");
+          lua_pushnumber(state, static_cast<lua_Number>(info.GetUncompressedSize()));
+          lua_rawset(state, -3);
+
+          lua_pushstring(state, "CompressedSize");
+          lua_pushnumber(state, static_cast<lua_Number>(info.GetCompressedSize()));
+          lua_rawset(state, -3);
+
+          lua_pushstring(state, "UncompressedMD5");
+          lua_pushlstring(state, info.GetUncompressedMD5().c_str(), info.GetUncompressedMD5().size());
+          lua_rawset(state, -3);
+
+          lua_pushstring(state, "CompressedMD5");
+          lua_pushlstring(state, info.GetCompressedMD5().c_str(), info.GetCompressedMD5().size());
+          lua_rawset(state, -3);
+
+          lua_pushstring(state, "Revision");
+          lua_pushnumber(state, static_cast<lua_Number>(revision));
+          lua_rawset(state, -3);
+
+          return 1;
+        }
+      }
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "Lua: " << e.What();
+    }
+
+    lua_pushnil(state);
+    return 1;
+  }
+
+
+  LuaScripting* LuaScripting::GetLuaScripting(lua_State* state)
+  {
+    const void* value = LuaContext::GetGlobalVariable(state, "_LuaScripting");
+    return const_cast<LuaScripting*>(reinterpret_cast<const LuaScripting*>(value));
+  }
+
+
+  // Syntax in Lua: SetTimer(name, periodInSeconds, [functionName])
+  // The function defaults to the name of the timer. A period of 0 removes the timer.
+  int LuaScripting::SetTimer(lua_State* state)
+  {
+    LuaScripting* scripting = GetLuaScripting(state);
+    if (scripting == NULL)
+    {
+      LOG(ERROR) << "Lua: The Orthanc API is unavailable";
+      lua_pushnil(state);
+      return 1;
+    }
+
+    // Check the types of the arguments
+    int nArgs = lua_gettop(state);
+    if (nArgs < 2 || nArgs > 3 ||
+        !lua_isstring(state, 1) ||                 // name
+        !lua_isnumber(state, 2) ||                 // period
+        (nArgs == 3 && !lua_isstring(state, 3)) || // function
+        lua_tonumber(state, 2) < 0)
+    {
+      LOG(ERROR) << "Lua: Bad parameters to SetTimer()";
+      lua_pushnil(state);
+      return 1;
+    }
+
+    const std::string name = lua_tostring(state, 1);
+    const unsigned int period = static_cast<unsigned int>(lua_tonumber(state, 2));
+
+    {
+      boost::mutex::scoped_lock lock(scripting->pimpl_->schedulerMutex_);
+
+      if (period == 0)
+      {
+        scripting->pimpl_->timers_.erase(name);
+      }
+      else
+      {
+        PImpl::Timer& timer = scripting->pimpl_->timers_[name];
+        timer.function_ = (nArgs == 3 ? lua_tostring(state, 3) : name);
+        timer.period_ = period;
+        timer.next_ = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(period);
+      }
+    }
+
+    lua_pushboolean(state, 1);
+    return 1;
+  }
+
+
+  // Syntax in Lua: RunInBackground(functionName, [argument])
+  int LuaScripting::RunInBackground(lua_State* state)
+  {
+    LuaScripting* scripting = GetLuaScripting(state);
+    if (scripting == NULL)
+    {
+      LOG(ERROR) << "Lua: The Orthanc API is unavailable";
+      lua_pushnil(state);
+      return 1;
+    }
+
+    // Check the types of the arguments
+    int nArgs = lua_gettop(state);
+    if (nArgs < 1 || nArgs > 2 ||
+        !lua_isstring(state, 1) ||                 // function
+        (nArgs == 2 && !lua_isstring(state, 2)))   // argument
+    {
+      LOG(ERROR) << "Lua: Bad parameters to RunInBackground()";
+      lua_pushnil(state);
+      return 1;
+    }
+
+    scripting->pimpl_->backgroundTasks_.Enqueue(
+      new BackgroundTask(lua_tostring(state, 1), nArgs == 2 ? lua_tostring(state, 2) : NULL));
+
+    lua_pushboolean(state, 1);
+    return 1;
+  }
+
+
   // Syntax in Lua: GetOrthancConfiguration()
   int LuaScripting::GetOrthancConfiguration(lua_State *state)
   {
@@ -984,22 +1439,37 @@ namespace Orthanc
     state_(State_Setup),
     heartBeatPeriod_(0)
   {
-    lua_.SetGlobalVariable("_ServerContext", &context);
-    lua_.RegisterFunction("RestApiGet", RestApiGet);
-    lua_.RegisterFunction("RestApiPost", RestApiPost);
-    lua_.RegisterFunction("RestApiPut", RestApiPut);
-    lua_.RegisterFunction("RestApiDelete", RestApiDelete);
-    lua_.RegisterFunction("GetOrthancConfiguration", GetOrthancConfiguration);
-    lua_.RegisterFunction("SetStableStatus", SetStableStatus);
-    lua_.RegisterFunction("StoreKeyValue", StoreKeyValue);
-    lua_.RegisterFunction("GetKeyValue", GetKeyValue);
-    lua_.RegisterFunction("DeleteKeyValue", DeleteKeyValue);
+    RegisterFunctions(lua_, context, *this);
 
     LOG(INFO) << "Initializing Lua for the event handler";
     LoadGlobalConfiguration();
   }
 
 
+  void LuaScripting::RegisterFunctions(LuaContext& lua,
+                                       ServerContext& context,
+                                       LuaScripting& scripting)
+  {
+    lua.SetGlobalVariable("_ServerContext", &context);
+    lua.SetGlobalVariable("_LuaScripting", &scripting);
+    lua.RegisterFunction("RestApiGet", RestApiGet);
+    lua.RegisterFunction("RestApiPost", RestApiPost);
+    lua.RegisterFunction("RestApiPut", RestApiPut);
+    lua.RegisterFunction("RestApiDelete", RestApiDelete);
+    lua.RegisterFunction("GetOrthancConfiguration", GetOrthancConfiguration);
+    lua.RegisterFunction("SetStableStatus", SetStableStatus);
+    lua.RegisterFunction("StoreKeyValue", StoreKeyValue);
+    lua.RegisterFunction("GetKeyValue", GetKeyValue);
+    lua.RegisterFunction("DeleteKeyValue", DeleteKeyValue);
+    lua.RegisterFunction("GetMainDicomTags", GetMainDicomTags);
+    lua.RegisterFunction("GetMetadata", GetMetadata);
+    lua.RegisterFunction("GetParentId", GetParentId);
+    lua.RegisterFunction("GetAttachmentInfo", GetAttachmentInfo);
+    lua.RegisterFunction("SetTimer", SetTimer);
+    lua.RegisterFunction("RunInBackground", RunInBackground);
+  }
+
+
   LuaScripting::~LuaScripting()
   {
     if (state_ == State_Running)
@@ -1021,40 +1491,126 @@ namespace Orthanc
     delete pimpl_;
   }
 
-  void LuaScripting::HeartBeatThread(LuaScripting* that)
+  static void CallScheduledFunction(LuaContext& lua,
+                                    const std::string& function,
+                                    const std::string* argument)
   {
-    Logging::ScopedCurrentThreadNameSetter setter("LUA-HEARTBEAT");
+    if (lua.IsExistingFunction(function.c_str()))
+    {
+      LuaFunctionCall call(lua, function.c_str());
+
+      if (argument != NULL)
+      {
+        call.PushString(*argument);
+      }
+
+      call.Execute();
+    }
+    else
+    {
+      LOG(WARNING) << "Lua: Unknown function for scheduled work: " << function;
+    }
+  }
+
+
+  void LuaScripting::ExecuteScheduled(const std::string& function,
+                                      const std::string* argument)
+  {
+    try
+    {
+      if (pimpl_->schedulerContext_.get() != NULL)
+      {
+        // No lock is needed, as this context is only used by the scheduler thread
+        CallScheduledFunction(*pimpl_->schedulerContext_, function, argument);
+      }
+      else
+      {
+        LuaScripting::Lock lock(*this);
+        CallScheduledFunction(lock.GetLua(), function, argument);
+      }
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "Lua: Error in scheduled function " << function << "(): " << e.What();
+    }
+  }
+
+
+  void LuaScripting::SchedulerThread(LuaScripting* that)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("LUA-SCHEDULER");
 
     static const unsigned int GRANULARITY = 100;  // In milliseconds
-    
+
+    bool hasHeartBeat;
+
+    {
+      LuaScripting::Lock lock(*that);
+      hasHeartBeat = (that->heartBeatPeriod_ > 0 &&
+                      lock.GetLua().IsExistingFunction(ON_HEART_BEAT));
+    }
+
+    if (hasHeartBeat)
+    {
+      LOG(INFO) << "Starting the Lua HeartBeat with a period of " << that->heartBeatPeriod_ << " seconds";
+    }
+
     const boost::posix_time::time_duration PERIODICITY =
       boost::posix_time::seconds(that->heartBeatPeriod_);
     
     boost::posix_time::ptime next =
       boost::posix_time::microsec_clock::universal_time() + PERIODICITY;
     
-    bool shouldStop = false;
-
-    while (!shouldStop)
+    for (;;)
     {
-      boost::this_thread::sleep(boost::posix_time::milliseconds(GRANULARITY));
+      // The background tasks are run as soon as they are queued
+      std::unique_ptr<IDynamicObject> task(that->pimpl_->backgroundTasks_.Dequeue(GRANULARITY));
 
-      if (boost::posix_time::microsec_clock::universal_time() >= next)
+      if (task.get() != NULL)
       {
-        LuaScripting::Lock lock(*that);
+        const BackgroundTask& t = dynamic_cast<const BackgroundTask&>(*task);
+        that->ExecuteScheduled(t.GetFunction(), t.GetArgument());
+      }
 
-        if (lock.GetLua().IsExistingFunction(ON_HEART_BEAT))
+      if (hasHeartBeat &&
+          boost::posix_time::microsec_clock::universal_time() >= next)
+      {
+        that->ExecuteScheduled(ON_HEART_BEAT, NULL);
+        next = boost::posix_time::microsec_clock::universal_time() + PERIODICITY;
+      }
+
+      std::list<std::string> expired;
+
+      {
+        boost::mutex::scoped_lock lock(that->pimpl_->schedulerMutex_);
+
+        const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+        for (PImpl::Timers::iterator it = that->pimpl_->timers_.begin(); it != that->pimpl_->timers_.end(); ++it)
         {
-          LuaFunctionCall call(lock.GetLua(), ON_HEART_BEAT);
-          call.Execute();
+          if (now >= it->second.next_)
+          {
+            expired.push_back(it->second.function_);
+
+            // As for the heart beat, the period is not the delay
+            // between the end of an execution and the next one
+            it->second.next_ = now + boost::posix_time::seconds(it->second.period_);
+          }
         }
+      }
 
-        next = boost::posix_time::microsec_clock::universal_time() + PERIODICITY;
+      for (std::list<std::string>::const_iterator it = expired.begin(); it != expired.end(); ++it)
+      {
+        that->ExecuteScheduled(*it, NULL);
       }
 
       {
-        boost::recursive_mutex::scoped_lock lock(that->mutex_);
-        shouldStop = (that->state_ == State_Done);
+        ORTHANC_PROFILED_LOCK(boost::recursive_mutex::scoped_lock, lock, that->mutex_, luaLockProfiler_);
+
+        if (that->state_ == State_Done)
+        {
+          return;
+        }
       }
     }
   }
@@ -1070,7 +1626,7 @@ namespace Orthanc
       if (event.get() == NULL)
       {
         // The event queue is empty, check whether we should stop
-        boost::recursive_mutex::scoped_lock lock(that->mutex_);
+        ORTHANC_PROFILED_LOCK(boost::recursive_mutex::scoped_lock, lock, that->mutex_, luaLockProfiler_);
 
         if (that->state_ != State_Running)
         {
@@ -1096,7 +1652,7 @@ namespace Orthanc
 
   void LuaScripting::Start()
   {
-    boost::recursive_mutex::scoped_lock lock(mutex_);
+    ORTHANC_PROFILED_LOCK(boost::recursive_mutex::scoped_lock, lock, mutex_, luaLockProfiler_);
 
     if (state_ != State_Setup ||
         eventThread_.joinable()  /* already started */)
@@ -1108,13 +1664,7 @@ namespace Orthanc
       LOG(INFO) << "Starting the Lua engine";
       eventThread_ = boost::thread(EventThread, this);
       
-      LuaScripting::Lock luaLock(*this);
-
-      if (heartBeatPeriod_ > 0 && luaLock.GetLua().IsExistingFunction(ON_HEART_BEAT))
-      {
-        LOG(INFO) << "Starting the Lua HeartBeat thread with a period of " << heartBeatPeriod_ << " seconds";
-        heartBeatThread_ = boost::thread(HeartBeatThread, this);
-      }
+      schedulerThread_ = boost::thread(SchedulerThread, this);
       state_ = State_Running;
     }
   }
@@ -1123,7 +1673,7 @@ namespace Orthanc
   void LuaScripting::Stop()
   {
     {
-      boost::recursive_mutex::scoped_lock lock(mutex_);
+      ORTHANC_PROFILED_LOCK(boost::recursive_mutex::scoped_lock, lock, mutex_, luaLockProfiler_);
 
       if (state_ != State_Running)
       {
@@ -1139,9 +1689,9 @@ namespace Orthanc
     {
       LOG(INFO) << "Stopping the Lua engine";
       eventThread_.join();
-      if (heartBeatThread_.joinable())
+      if (schedulerThread_.joinable())
       {
-        heartBeatThread_.join();
+        schedulerThread_.join();
       }
       LOG(INFO) << "The Lua engine has stopped";
     }
@@ -1188,16 +1738,26 @@ namespace Orthanc
   }
 
 
+  bool LuaScripting::HasIncomingInstanceCallbacks()
+  {
+    ORTHANC_PROFILED_LOCK(boost::recursive_mutex::scoped_lock, lock, mutex_, luaLockProfiler_);
+
+    return (lua_.IsExistingFunction("OnStoredInstance") ||
+            lua_.IsExistingFunction("ReceivedInstanceFilter") ||
+            lua_.IsExistingFunction("ReceivedCStoreInstanceFilter"));
+  }
+
+
   bool LuaScripting::FilterIncomingInstance(const DicomInstanceToStore& instance,
                                             const Json::Value& simplified)
   {
     static const char* NAME = "ReceivedInstanceFilter";
 
-    boost::recursive_mutex::scoped_lock lock(mutex_);
+    FilterLock lock(*this);
 
-    if (lua_.IsExistingFunction(NAME))
+    if (lock.GetLua().IsExistingFunction(NAME))
     {
-      LuaFunctionCall call(lua_, NAME);
+      LuaFunctionCall call(lock.GetLua(), NAME);
       call.PushJson(simplified);
 
       Json::Value origin;
@@ -1230,11 +1790,11 @@ namespace Orthanc
   {
     static const char* NAME = "ReceivedCStoreInstanceFilter";
 
-    boost::recursive_mutex::scoped_lock lock(mutex_);
+    FilterLock lock(*this);
 
-    if (lua_.IsExistingFunction(NAME))
+    if (lock.GetLua().IsExistingFunction(NAME))
     {
-      LuaFunctionCall call(lua_, NAME);
+      LuaFunctionCall call(lock.GetLua(), NAME);
       call.PushJson(simplified);
 
       Json::Value origin;
@@ -1272,11 +1832,11 @@ namespace Orthanc
   {
     static const char* NAME = "OutgoingCStoreInstanceFilter";
 
-    boost::recursive_mutex::scoped_lock lock(mutex_);
+    FilterLock lock(*this);
 
-    if (lua_.IsExistingFunction(NAME))
+    if (lock.GetLua().IsExistingFunction(NAME))
     {
-      LuaFunctionCall call(lua_, NAME);
+      LuaFunctionCall call(lock.GetLua(), NAME);
       call.PushJson(simplified);
 
       Json::Value destination;
@@ -1299,31 +1859,111 @@ namespace Orthanc
   }
 
 
+  static void GetCompiledChunk(std::string& target,
+                               LuaContext& lua,
+                               const std::string& source)
+  {
+    // The compiled chunks are shared by all the Lua contexts of the
+    // process, so that each script is only parsed once (new in
+    // Orthanc 1.12.12)
+    static boost::mutex mutex;
+    static std::map<std::string, std::string> cache;  // Source => compiled chunk
+
+    boost::mutex::scoped_lock lock(mutex);
+
+    std::map<std::string, std::string>::const_iterator found = cache.find(source);
+    if (found == cache.end())
+    {
+      lua.Compile(target, source);
+      cache[source] = target;
+    }
+    else
+    {
+      target = found->second;
+    }
+  }
+
+
   void LuaScripting::LoadGlobalConfiguration()
   {
     OrthancConfiguration::ReaderLock configLock;
 
+    std::string toolbox;
+
     {
-      std::string command;
-      Orthanc::ServerResources::GetFileResource(command, Orthanc::ServerResources::LUA_TOOLBOX);
-      lua_.Execute(command);
-    }    
+      std::string source;
+      Orthanc::ServerResources::GetFileResource(source, Orthanc::ServerResources::LUA_TOOLBOX);
+      GetCompiledChunk(toolbox, lua_, source);
+    }
+
+    lua_.ExecuteCompiled(toolbox);
 
     std::list<std::string> luaScripts;
     configLock.GetConfiguration().GetListOfStringsParameter(luaScripts, "LuaScripts");
     heartBeatPeriod_ = configLock.GetConfiguration().GetUnsignedIntegerParameter("LuaHeartBeatPeriod");
 
-    LuaScripting::Lock lock(*this);
+    const unsigned int filtersContexts = configLock.GetConfiguration().GetLuaFiltersContexts();
+    const bool schedulerContext = configLock.GetConfiguration().IsLuaSchedulerContext();
+
+    std::list<std::string> scripts;
 
-    for (std::list<std::string>::const_iterator
-           it = luaScripts.begin(); it != luaScripts.end(); ++it)
     {
-      boost::filesystem::path path = configLock.GetConfiguration().InterpretStringParameterAsPath(*it);
-      LOG(INFO) << "Installing the Lua scripts from: " << SystemToolbox::PathToUtf8(path);
-      std::string script;
-      SystemToolbox::ReadFile(script, path);
+      LuaScripting::Lock lock(*this);
+
+      for (std::list<std::string>::const_iterator
+             it = luaScripts.begin(); it != luaScripts.end(); ++it)
+      {
+        boost::filesystem::path path = configLock.GetConfiguration().InterpretStringParameterAsPath(*it);
+        LOG(INFO) << "Installing the Lua scripts from: " << SystemToolbox::PathToUtf8(path);
+        std::string source;
+        SystemToolbox::ReadFile(source, path);
+
+        scripts.push_back(std::string());
+        GetCompiledChunk(scripts.back(), lock.GetLua(), source);
+
+        lock.GetLua().ExecuteCompiled(scripts.back());
+      }
+    }
+
+    if (filtersContexts > 0 &&
+        !luaScripts.empty())
+    {
+      LOG(WARNING) << "Running the Lua filters in " << filtersContexts << " independent Lua contexts, "
+                   << "whose global variables are not shared";
+
+      for (unsigned int i = 0; i < filtersContexts; i++)
+      {
+        std::unique_ptr<LuaContext> lua(new LuaContext);
+        RegisterFunctions(*lua, context_, *this);
+        lua->ExecuteCompiled(toolbox);
+
+        for (std::list<std::string>::const_iterator it = scripts.begin(); it != scripts.end(); ++it)
+        {
+          lua->ExecuteCompiled(*it);
+        }
+
+        pimpl_->filtersContexts_.push_back(lua.release());
+      }
+
+      pimpl_->availableFiltersContexts_ = pimpl_->filtersContexts_;
+    }
+
+    if (schedulerContext &&
+        !luaScripts.empty())
+    {
+      LOG(WARNING) << "Running the scheduled Lua work in a dedicated Lua context, "
+                   << "whose global variables are not shared";
+
+      std::unique_ptr<LuaContext> lua(new LuaContext);
+      RegisterFunctions(*lua, context_, *this);
+      lua->ExecuteCompiled(toolbox);
+
+      for (std::list<std::string>::const_iterator it = scripts.begin(); it != scripts.end(); ++it)
+      {
+        lua->ExecuteCompiled(*it);
+      }
 
-      lock.GetLua().Execute(script);
+      pimpl_->schedulerContext_.reset(lua.release());
     }
   }
 
@@ -26,6 +26,7 @@
 #include "ServerIndexChange.h"
 #include "JobEvent.h"
 
+#include "../../OrthancFramework/Sources/MultiThreading/LockProfiler.h"
 #include "../../OrthancFramework/Sources/MultiThreading/SharedMessageQueue.h"
 #include "../../OrthancFramework/Sources/Lua/LuaContext.h"
 
@@ -69,6 +70,28 @@ namespace Orthanc
     static int GetKeyValue(lua_State* state);
     static int DeleteKeyValue(lua_State* state);
 
+    // Direct access to the index, without going through the REST API
+    // (new in Orthanc 1.12.12)
+    static bool LookupResourceArgument(ServerContext*& serverContext,
+                                       std::string& publicId,
+                                       ResourceType& level,
+                                       lua_State* state,
+                                       int countArguments,
+                                       const char* functionName);
+    static int GetMainDicomTags(lua_State* state);
+    static int GetMetadata(lua_State* state);
+    static int GetParentId(lua_State* state);
+    static int GetAttachmentInfo(lua_State* state);
+
+    // Scheduled and background work (new in Orthanc 1.12.12)
+    static LuaScripting* GetLuaScripting(lua_State* state);
+    static int SetTimer(lua_State* state);
+    static int RunInBackground(lua_State* state);
+
+    static void RegisterFunctions(LuaContext& lua,
+                                  ServerContext& context,
+                                  LuaScripting& scripting);
+
     void InitializeJob();
 
     void SubmitJob();
@@ -81,13 +104,19 @@ namespace Orthanc
     ServerContext&           context_;
     State                    state_;
     boost::thread            eventThread_;
-    boost::thread            heartBeatThread_;
+    boost::thread            schedulerThread_;  // Replaces "heartBeatThread_" since Orthanc 1.12.12
     unsigned int             heartBeatPeriod_;
     SharedMessageQueue       pendingEvents_;
 
     static void EventThread(LuaScripting* that);
 
-    static void HeartBeatThread(LuaScripting* that);
+    static void SchedulerThread(LuaScripting* that);
+
+    // Runs one scheduled or background function, either in the Lua
+    // context that is dedicated to the scheduler, or in the main
+    // context if "LuaSchedulerContext" is disabled
+    void ExecuteScheduled(const std::string& function,
+                          const std::string* argument);
 
     void LoadGlobalConfiguration();
 
@@ -96,18 +125,43 @@ namespace Orthanc
     {
     private:
       LuaScripting&                        that_;
+#if ORTHANC_ENABLE_LOCK_PROFILING == 1
+      ProfiledLock<boost::recursive_mutex::scoped_lock>  lock_;
+#else
       boost::recursive_mutex::scoped_lock  lock_;
+#endif
 
     public:
-      explicit Lock(LuaScripting& that) : 
-        that_(that), 
-        lock_(that.mutex_)
+      explicit Lock(LuaScripting& that);
+
+      LuaContext& GetLua()
       {
+        return that_.lua_;
       }
+    };
+
+    /**
+     * Gives access to a Lua context to run one of the synchronous
+     * filters. If "LuaFiltersContexts" is not zero, this is one of
+     * the independent contexts dedicated to the filters, otherwise
+     * this is the same as "Lock" (new in Orthanc 1.12.12).
+     **/
+    class FilterLock : public boost::noncopyable
+    {
+    private:
+      LuaScripting&          that_;
+      std::unique_ptr<Lock>  lock_;
+      LuaContext*            lua_;
+      bool                   acquired_;
+
+    public:
+      explicit FilterLock(LuaScripting& that);
+
+      ~FilterLock();
 
       LuaContext& GetLua()
       {
-        return that_.lua_;
+        return *lua_;
       }
     };
 
@@ -125,6 +179,10 @@ namespace Orthanc
 
     void SignalChange(const ServerIndexChange& change);
 
+    // Whether some Lua callback receives the simplified tags of the
+    // incoming instances (new in Orthanc 1.12.12)
+    bool HasIncomingInstanceCallbacks();
+
     bool FilterIncomingInstance(const DicomInstanceToStore& instance,
                                 const Json::Value& simplifiedTags);
 
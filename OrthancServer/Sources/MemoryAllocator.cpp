@@ -0,0 +1,283 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersServer.h"
+#include "MemoryAllocator.h"
+
+#include "../../OrthancFramework/Sources/MetricsRegistry.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+
+#include <boost/lexical_cast.hpp>
+
+#if !defined(HAVE_MALLOC_TRIM)
+#  error Macro HAVE_MALLOC_TRIM must be defined
+#endif
+
+#if !defined(HAVE_MALLINFO2)
+#  error Macro HAVE_MALLINFO2 must be defined
+#endif
+
+#if !defined(HAVE_MALLOC_INFO)
+#  error Macro HAVE_MALLOC_INFO must be defined
+#endif
+
+#if ORTHANC_USE_JEMALLOC == 1
+#  include <jemalloc/jemalloc.h>
+#elif ORTHANC_USE_MIMALLOC == 1
+#  include <mimalloc.h>
+#elif HAVE_MALLOC_TRIM == 1 || HAVE_MALLINFO2 == 1 || HAVE_MALLOC_INFO == 1
+#  include <malloc.h>
+#  include <stdio.h>
+#  include <stdlib.h>
+#endif
+
+
+namespace Orthanc
+{
+#if ORTHANC_USE_JEMALLOC == 1
+  template <typename T>
+  static bool ReadJemallocValue(T& target,
+                                const char* name)
+  {
+    size_t size = sizeof(T);
+    return mallctl(name, &target, &size, NULL, 0) == 0;
+  }
+#endif
+
+
+#if ORTHANC_USE_JEMALLOC != 1 && ORTHANC_USE_MIMALLOC != 1 && HAVE_MALLOC_INFO == 1
+  // glibc has no function to get the number of arenas, so count the
+  // "<heap>" elements of the XML report of "malloc_info()"
+  static int64_t CountGlibcArenas()
+  {
+    char* buffer = NULL;
+    size_t size = 0;
+
+    FILE* stream = open_memstream(&buffer, &size);
+    if (stream == NULL)
+    {
+      return -1;
+    }
+
+    const bool success = (malloc_info(0, stream) == 0);
+    fclose(stream);
+
+    int64_t count = -1;
+
+    if (success &&
+        buffer != NULL)
+    {
+      const std::string xml(buffer, size);
+
+      count = 0;
+      for (size_t pos = xml.find("<heap nr="); pos != std::string::npos; pos = xml.find("<heap nr=", pos + 1))
+      {
+        count++;
+      }
+    }
+
+    free(buffer);
+    return count;
+  }
+#endif
+
+
+  MemoryAllocator::Statistics::Statistics() :
+    allocatedBytes_(-1),
+    residentBytes_(-1),
+    fragmentedBytes_(-1),
+    arenas_(-1)
+  {
+  }
+
+
+  uint64_t MemoryAllocator::Statistics::GetFragmentedBytes() const
+  {
+    if (HasFragmentedBytes())
+    {
+      return static_cast<uint64_t>(fragmentedBytes_);
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+  }
+
+
+  void MemoryAllocator::Statistics::Format(Json::Value& target) const
+  {
+    target = Json::objectValue;
+    target["Allocator"] = GetName();
+
+    if (allocatedBytes_ >= 0)
+    {
+      target["AllocatedBytes"] = Json::Value::Int64(allocatedBytes_);
+    }
+
+    if (residentBytes_ >= 0)
+    {
+      target["ResidentBytes"] = Json::Value::Int64(residentBytes_);
+    }
+
+    if (fragmentedBytes_ >= 0)
+    {
+      target["FragmentedBytes"] = Json::Value::Int64(fragmentedBytes_);
+    }
+
+    if (arenas_ >= 0)
+    {
+      target["Arenas"] = Json::Value::Int64(arenas_);
+    }
+
+    target["TrimmingSupported"] = IsTrimmingSupported();
+  }
+
+
+  void MemoryAllocator::Statistics::PublishMetrics(MetricsRegistry& registry) const
+  {
+    if (allocatedBytes_ >= 0)
+    {
+      registry.SetIntegerValue("orthanc_memory_allocated_bytes", allocatedBytes_);
+    }
+
+    if (residentBytes_ >= 0)
+    {
+      registry.SetIntegerValue("orthanc_memory_resident_bytes", residentBytes_);
+    }
+
+    if (fragmentedBytes_ >= 0)
+    {
+      registry.SetIntegerValue("orthanc_memory_fragmented_bytes", fragmentedBytes_);
+    }
+
+    if (arenas_ >= 0)
+    {
+      registry.SetIntegerValue("orthanc_memory_arenas_count", arenas_);
+    }
+  }
+
+
+  const char* MemoryAllocator::GetName()
+  {
+#if ORTHANC_USE_JEMALLOC == 1
+    return "jemalloc";
+#elif ORTHANC_USE_MIMALLOC == 1
+    return "mimalloc";
+#else
+    return "system";
+#endif
+  }
+
+
+  void MemoryAllocator::GetStatistics(Statistics& target,
+                                      bool countArenas)
+  {
+    target = Statistics();
+
+#if ORTHANC_USE_JEMALLOC == 1
+    {
+      // Refresh the statistics that are cached by jemalloc
+      uint64_t epoch = 1;
+      size_t size = sizeof(epoch);
+      mallctl("epoch", &epoch, &size, &epoch, size);
+
+      size_t allocated, resident;
+      if (ReadJemallocValue(allocated, "stats.allocated") &&
+          ReadJemallocValue(resident, "stats.resident"))
+      {
+        target.SetAllocatedBytes(static_cast<int64_t>(allocated));
+        target.SetResidentBytes(static_cast<int64_t>(resident));
+        target.SetFragmentedBytes(resident > allocated ? static_cast<int64_t>(resident - allocated) : 0);
+      }
+
+      unsigned int arenas;
+      if (countArenas &&
+          ReadJemallocValue(arenas, "arenas.narenas"))
+      {
+        target.SetArenas(arenas);
+      }
+    }
+
+#elif ORTHANC_USE_MIMALLOC == 1
+    {
+      // mimalloc only reports the memory of the process as a whole
+      size_t elapsed, user, system, rss, peakRss, commit, peakCommit, pageFaults;
+      mi_process_info(&elapsed, &user, &system, &rss, &peakRss, &commit, &peakCommit, &pageFaults);
+      target.SetResidentBytes(static_cast<int64_t>(rss));
+    }
+
+#elif HAVE_MALLINFO2 == 1
+    {
+      const struct mallinfo2 info = mallinfo2();
+      target.SetAllocatedBytes(static_cast<int64_t>(info.uordblks + info.hblkhd));
+      target.SetResidentBytes(static_cast<int64_t>(info.arena + info.hblkhd));
+      target.SetFragmentedBytes(static_cast<int64_t>(info.fordblks));
+    }
+#endif
+
+#if ORTHANC_USE_JEMALLOC != 1 && ORTHANC_USE_MIMALLOC != 1 && HAVE_MALLOC_INFO == 1
+    if (countArenas)
+    {
+      target.SetArenas(CountGlibcArenas());
+    }
+#else
+    (void) countArenas;  // Unused
+#endif
+  }
+
+
+  bool MemoryAllocator::IsTrimmingSupported()
+  {
+#if ORTHANC_USE_JEMALLOC == 1 || ORTHANC_USE_MIMALLOC == 1 || HAVE_MALLOC_TRIM == 1
+    return true;
+#else
+    return false;
+#endif
+  }
+
+
+  void MemoryAllocator::Trim()
+  {
+#if ORTHANC_USE_JEMALLOC == 1
+#  if defined(MALLCTL_ARENAS_ALL)
+    static const std::string PURGE = "arena." + boost::lexical_cast<std::string>(MALLCTL_ARENAS_ALL) + ".purge";
+#  else
+    // Before jemalloc 5.0, the index "narenas" designates all the arenas
+    unsigned int arenas = 0;
+    ReadJemallocValue(arenas, "arenas.narenas");
+    const std::string PURGE = "arena." + boost::lexical_cast<std::string>(arenas) + ".purge";
+#  endif
+    mallctl(PURGE.c_str(), NULL, NULL, NULL, 0);
+
+#elif ORTHANC_USE_MIMALLOC == 1
+    mi_collect(true /* force */);
+
+#elif HAVE_MALLOC_TRIM == 1
+    // See OrthancServer/Resources/ImplementationNotes/memory_consumption.txt
+    malloc_trim(static_cast<size_t>(128) * 1024);
+
+#else
+    throw OrthancException(ErrorCode_NotImplemented, "Memory trimming is not supported on this platform");
+#endif
+  }
+}
@@ -0,0 +1,109 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../../OrthancFramework/Sources/Compatibility.h"
+
+#include <boost/noncopyable.hpp>
+#include <json/value.h>
+#include <stdint.h>
+
+#if !defined(ORTHANC_USE_JEMALLOC)
+#  error Macro ORTHANC_USE_JEMALLOC must be defined
+#endif
+
+#if !defined(ORTHANC_USE_MIMALLOC)
+#  error Macro ORTHANC_USE_MIMALLOC must be defined
+#endif
+
+
+namespace Orthanc
+{
+  class MetricsRegistry;
+
+  /**
+   * Access to the memory allocator that is linked with Orthanc, as
+   * selected by the "MEMORY_ALLOCATOR" CMake option: The system
+   * allocator (glibc), jemalloc or mimalloc (new in Orthanc 1.12.12).
+   **/
+  class MemoryAllocator : public boost::noncopyable
+  {
+  public:
+    // The values that the allocator does not report are negative
+    class Statistics
+    {
+    private:
+      int64_t  allocatedBytes_;   // Bytes in use by Orthanc
+      int64_t  residentBytes_;    // Bytes that the allocator has obtained from the system
+      int64_t  fragmentedBytes_;  // Bytes that the allocator retains, but that are not in use
+      int64_t  arenas_;
+
+    public:
+      Statistics();
+
+      void SetAllocatedBytes(int64_t value)
+      {
+        allocatedBytes_ = value;
+      }
+
+      void SetResidentBytes(int64_t value)
+      {
+        residentBytes_ = value;
+      }
+
+      void SetFragmentedBytes(int64_t value)
+      {
+        fragmentedBytes_ = value;
+      }
+
+      void SetArenas(int64_t value)
+      {
+        arenas_ = value;
+      }
+
+      bool HasFragmentedBytes() const
+      {
+        return fragmentedBytes_ >= 0;
+      }
+
+      uint64_t GetFragmentedBytes() const;
+
+      void Format(Json::Value& target) const;
+
+      void PublishMetrics(MetricsRegistry& registry) const;
+    };
+
+    static const char* GetName();
+
+    // Counting the arenas might be expensive with glibc, as it
+    // serializes the full state of the allocator
+    static void GetStatistics(Statistics& target,
+                              bool countArenas);
+
+    static bool IsTrimmingSupported();
+
+    // Gives the unused memory back to the system
+    static void Trim();
+  };
+}
@@ -37,6 +37,7 @@
 
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
+#include <boost/thread/tss.hpp>
 
 
 static const char* const DICOM_MODALITIES = "DicomModalities";
@@ -46,6 +47,8 @@ static const char* const ORTHANC_PEERS_IN_DB = "OrthancPeersInDatabase";
 static const char* const TEMPORARY_DIRECTORY = "TemporaryDirectory";
 static const char* const WARNINGS = "Warnings";
 static const char* const JOBS_ENGINE_THREADS_COUNT = "JobsEngineThreadsCount";
+static const char* const CONCURRENT_JOBS_PER_TYPE = "ConcurrentJobsPerType";
+static const char* const THREADS_AFFINITY = "ThreadsAffinity";
 static const char* const DICOM_LOSSY_TRANSCODING_QUALITY = "DicomLossyTranscodingQuality";
 static const char* const CONFIG_LOADER_THREADS = "LoaderThreads";
 static const char* const CONFIG_ZIP_LOADER_THREADS = "ZipLoaderThreads"; // for backward compatibility only
@@ -300,6 +303,8 @@ namespace Orthanc
   {
     // default values
     jobsEngineThreadsCount_["ResourceModification"] = 1;
+    jobsEngineThreadsCount_["SplitStudy"] = 4;  // New in Orthanc 1.12.12
+    jobsEngineThreadsCount_["MergeStudy"] = 4;  // New in Orthanc 1.12.12
 
     if (json_.isMember(JOBS_ENGINE_THREADS_COUNT))
     {
@@ -327,6 +332,100 @@ namespace Orthanc
     }
   }
 
+  void OrthancConfiguration::GetConcurrentJobsPerType(std::map<std::string, unsigned int>& target) const
+  {
+    target.clear();
+
+    if (json_.isMember(CONCURRENT_JOBS_PER_TYPE))
+    {
+      const Json::Value& source = json_[CONCURRENT_JOBS_PER_TYPE];
+      if (source.type() != Json::objectValue)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat,
+                               "Bad format of the \"" + std::string(CONCURRENT_JOBS_PER_TYPE) +
+                               "\" configuration section");
+      }
+
+      Json::Value::Members members = source.getMemberNames();
+
+      for (size_t i = 0; i < members.size(); i++)
+      {
+        const std::string& name = members[i];
+        if (!source[name].isUInt())
+        {
+          throw OrthancException(ErrorCode_BadFileFormat,
+                                 "Bad format for \"" + std::string(CONCURRENT_JOBS_PER_TYPE) + "." + name +
+                                 "\".  It should be an unsigned integer");
+        }
+
+        target[name] = source[name].asUInt();
+      }
+    }
+  }
+
+  void OrthancConfiguration::GetThreadsAffinity(std::set<unsigned int>& target,
+                                                const std::string& pool) const
+  {
+    target.clear();
+
+    if (!json_.isMember(THREADS_AFFINITY))
+    {
+      return;
+    }
+
+    const Json::Value& source = json_[THREADS_AFFINITY];
+    if (source.type() != Json::objectValue)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat,
+                             "Bad format of the \"" + std::string(THREADS_AFFINITY) +
+                             "\" configuration section");
+    }
+
+    if (!source.isMember(pool))
+    {
+      return;
+    }
+
+    if (source[pool].type() != Json::stringValue)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat,
+                             "Bad format for \"" + std::string(THREADS_AFFINITY) + "." + pool +
+                             "\".  It should be a string");
+    }
+
+    const std::string value = Toolbox::StripSpaces(source[pool].asString());
+
+    try
+    {
+      if (value.compare(0, 5, "numa:") == 0)
+      {
+        const unsigned int node = boost::lexical_cast<unsigned int>(value.substr(5));
+
+        std::vector<std::set<unsigned int> > nodes;
+        SystemToolbox::GetNumaNodes(nodes);
+
+        if (node >= nodes.size())
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange,
+                                 "Unknown NUMA node in \"" + std::string(THREADS_AFFINITY) + "." + pool +
+                                 "\": " + value);
+        }
+
+        target = nodes[node];
+      }
+      else
+      {
+        SystemToolbox::ParseCpuList(target, value);
+      }
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat,
+                             "Bad format for \"" + std::string(THREADS_AFFINITY) + "." + pool +
+                             "\": " + value);
+    }
+  }
+
   unsigned int OrthancConfiguration::GetJobsEngineWorkersThread(const std::string& jobType) const
   {
     unsigned int workersThread = 1;
@@ -486,6 +585,60 @@ namespace Orthanc
   }
 
 
+  OrthancConfiguration::Snapshot::Snapshot(const OrthancConfiguration& configuration) :
+    caseSensitivePN_(configuration.GetBooleanParameter("CaseSensitivePN")),
+    checkRevisions_(configuration.HasCheckRevisions()),
+    storeDicom_(configuration.GetBooleanParameter("StoreDicom")),
+    dicomLossyTranscodingQuality_(configuration.GetDicomLossyTranscodingQuality()),
+    instancesCacheControl_(configuration.GetStringParameter("InstancesCacheControl")),
+    disabledWarnings_(configuration.disabledWarnings_)
+  {
+  }
+
+
+  namespace
+  {
+    struct ThreadSnapshot
+    {
+      uint64_t                                                  generation_;
+      boost::shared_ptr<const OrthancConfiguration::Snapshot>  snapshot_;
+    };
+  }
+
+  static boost::thread_specific_ptr<ThreadSnapshot>  threadSnapshot_;
+
+
+  boost::shared_ptr<const OrthancConfiguration::Snapshot> OrthancConfiguration::GetSnapshot()
+  {
+    OrthancConfiguration& configuration = GetInstance();
+
+    // The generation must be read before taking the lock: If a writer
+    // modifies the configuration in the meantime, the snapshot will
+    // be rebuilt by the next call
+    const uint64_t generation = configuration.generation_.load();
+
+    ThreadSnapshot* cached = threadSnapshot_.get();
+    if (cached == NULL)
+    {
+      cached = new ThreadSnapshot;
+      threadSnapshot_.reset(cached);
+    }
+    else if (cached->snapshot_.get() != NULL &&
+             cached->generation_ == generation)
+    {
+      return cached->snapshot_;
+    }
+
+    {
+      ReaderLock lock;
+      cached->snapshot_.reset(new Snapshot(lock.GetConfiguration()));
+    }
+
+    cached->generation_ = generation;
+    return cached->snapshot_;
+  }
+
+
   bool OrthancConfiguration::LookupStringParameter(std::string& target,
                                                    const std::string& parameter) const
   {
@@ -1070,6 +1223,22 @@ namespace Orthanc
   }
 
 
+  std::string OrthancConfiguration::GetJobsOutputsDirectory() const
+  {
+    std::string directory;
+
+    if (LookupStringParameter(directory, "JobsOutputsDirectory") ||
+        LookupStringParameter(directory, TEMPORARY_DIRECTORY))
+    {
+      return SystemToolbox::PathToUtf8(InterpretStringParameterAsPath(directory));
+    }
+    else
+    {
+      return "";
+    }
+  }
+
+
   std::string OrthancConfiguration::GetDefaultPrivateCreator() const
   {
     // New configuration option in Orthanc 1.6.0
@@ -1310,6 +1479,17 @@ namespace Orthanc
     dicom.DatasetToJson(target, DicomToJsonFormat_Full, DicomToJsonFlags_Default, 
                         ORTHANC_MAXIMUM_TAG_LENGTH, ignoreTagLength);
   }
+
+  
+
+  void OrthancConfiguration::DefaultDicomDatasetToJson(Json::Value& target,
+                                                       const ParsedDicomFile& dicom,
+                                                       const std::set<DicomTag>& ignoreTagLength,
+                                                       const std::set<DicomTag>& whitelist)
+  {
+    dicom.DatasetToJson(target, DicomToJsonFormat_Full, DicomToJsonFlags_Default, 
+                        ORTHANC_MAXIMUM_TAG_LENGTH, ignoreTagLength, whitelist);
+  }
   
 
   void OrthancConfiguration::DefaultDicomHeaderToJson(Json::Value& target,
@@ -26,12 +26,14 @@
 #include "../../OrthancFramework/Sources/Images/FontRegistry.h"
 #include "../../OrthancFramework/Sources/WebServiceParameters.h"
 #include "../../OrthancFramework/Sources/DicomNetworking/RemoteModalityParameters.h"
+#include "../../OrthancFramework/Sources/MultiThreading/FairSharedMutex.h"
 
 #include <OrthancServerResources.h>
 #include "ServerEnumerations.h"
 
 #include <boost/filesystem.hpp>
-#include <boost/thread/shared_mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread/lock_types.hpp>
 #include <set>
 
@@ -42,19 +44,101 @@ class DcmDataset;
 #define ORTHANC_CONFIG_DICOM_PORT "DicomPort"
 #define ORTHANC_CONFIG_HTTP_PORT "HttpPort"
 #define ORTHANC_CONFIG_MAXIMUM_STORAGE_CACHE_SIZE "MaximumStorageCacheSize"
+#define ORTHANC_CONFIG_STORAGE_CACHE_SHARDS "StorageCacheShards"
+#define ORTHANC_CONFIG_STORAGE_CACHE_NUMA_AWARE "StorageCacheNumaAware"
+#define ORTHANC_CONFIG_STORAGE_CACHE_POLICY "StorageCachePolicy"
+#define ORTHANC_CONFIG_MAXIMUM_DICOM_HEADER_CACHE_SIZE "MaximumDicomHeaderCacheSize"
+#define ORTHANC_CONFIG_STORAGE_DISK_CACHE_DIRECTORY "StorageDiskCacheDirectory"
+#define ORTHANC_CONFIG_MAXIMUM_STORAGE_DISK_CACHE_SIZE "MaximumStorageDiskCacheSize"
+#define ORTHANC_CONFIG_SERIES_PREFETCH_THREADS "SeriesPrefetchThreads"
+#define ORTHANC_CONFIG_SERIES_PREFETCH_ON_READ "SeriesPrefetchOnRead"
+#define ORTHANC_CONFIG_SERIES_THUMBNAILS_SIZE "SeriesThumbnailsSize"
+#define ORTHANC_CONFIG_SERIES_THUMBNAILS_THREADS "SeriesThumbnailsThreads"
+#define ORTHANC_CONFIG_STORAGE_ACCESS_ON_FIND_THREADS "StorageAccessOnFindThreads"
+#define ORTHANC_CONFIG_STORAGE_ACCESS_ON_FIND_THREADS_PER_REQUEST "StorageAccessOnFindThreadsPerRequest"
 #define ORTHANC_CONFIG_MAXIMUM_STORAGE_SIZE "MaximumStorageSize"
 #define ORTHANC_CONFIG_MAXIMUM_STORAGE_MODE "MaximumStorageMode"
+#define ORTHANC_CONFIG_RECYCLING_HIGH_WATER_MARK "RecyclingHighWaterMark"
+#define ORTHANC_CONFIG_RECYCLING_LOW_WATER_MARK "RecyclingLowWaterMark"
+#define ORTHANC_CONFIG_DELAYED_FILES_REMOVAL "DelayedFilesRemoval"
+#define ORTHANC_CONFIG_DELAYED_FILES_REMOVAL_THREADS "DelayedFilesRemovalThreads"
+#define ORTHANC_CONFIG_DELAYED_FILES_REMOVAL_MAXIMUM_RATE "DelayedFilesRemovalMaximumRate"
+#define ORTHANC_CONFIG_INGEST_BATCHING_DELAY "IngestBatchingDelay"
+#define ORTHANC_CONFIG_INGEST_BATCHING_MAXIMUM_SIZE "IngestBatchingMaximumSize"
 #define ORTHANC_CONFIG_MAXIMUM_PATIENT_COUNT "MaximumPatientCount"
 #define ORTHANC_CONFIG_CHECK_REVISIONS "CheckRevisions"
 #define ORTHANC_CONFIG_STORE_MD5_FOR_ATTACHMENTS "StoreMD5ForAttachments"
 #define ORTHANC_CONFIG_STORAGE_COMPRESSION "StorageCompression"
+#define ORTHANC_CONFIG_STORAGE_COMPRESSION_TYPE "StorageCompressionType"
 #define ORTHANC_CONFIG_OVERWRITE_INSTANCES "OverwriteInstances"
 #define ORTHANC_CONFIG_INGEST_TRANSCODING "IngestTranscoding"
+#define ORTHANC_CONFIG_INGEST_TRANSCODING_THREADS "IngestTranscodingThreads"
 #define ORTHANC_CONFIG_DATABASE_SERVER_IDENTIFIER "DatabaseServerIdentifier"
 #define ORTHANC_CONFIG_DICOM_DEFAULT_RETRIEVE_METHOD "DicomDefaultRetrieveMethod"
 #define ORTHANC_CONFIG_PATIENT_LEVEL_ENABLED "PatientLevelEnabled"
 #define ORTHANC_CONFIG_READ_ONLY "ReadOnly"
 #define ORTHANC_CONFIG_STORAGE_DIRECTORY "StorageDirectory"
+#define ORTHANC_CONFIG_STORAGE_ROOTS "StorageRoots"
+#define ORTHANC_CONFIG_STORAGE_ROOTS_PLACEMENT "StorageRootsPlacement"
+#define ORTHANC_CONFIG_STORAGE_DEDUPLICATION "StorageDeduplication"
+#define ORTHANC_CONFIG_SQLITE_READ_ONLY_CONNECTIONS "SQLiteReadOnlyConnections"
+#define ORTHANC_CONFIG_SQLITE_NGRAM_INDEX "SQLiteNGramIndex"
+#define ORTHANC_CONFIG_SQLITE_STATISTICS_CHECK_INTERVAL "SQLiteStatisticsCheckInterval"
+#define ORTHANC_CONFIG_SQLITE_INCREMENTAL_VACUUM "SQLiteIncrementalVacuum"
+#define ORTHANC_CONFIG_SQLITE_INCREMENTAL_VACUUM_PAGES "SQLiteIncrementalVacuumPages"
+#define ORTHANC_CONFIG_SLOW_DATABASE_TRANSACTION_THRESHOLD "SlowDatabaseTransactionThreshold"
+#define ORTHANC_CONFIG_SQLITE_COALESCE_CHANGES "SQLiteCoalesceChanges"
+#define ORTHANC_CONFIG_CHANGES_RETENTION_DAYS "ChangesRetentionDays"
+#define ORTHANC_CONFIG_CHANGES_RETENTION_COUNT "ChangesRetentionCount"
+#define ORTHANC_CONFIG_FIND_STREAMING_PAGE_SIZE "FindStreamingPageSize"
+#define ORTHANC_CONFIG_FIND_ANSWERS_CACHE_SIZE "FindAnswersCacheSize"
+#define ORTHANC_CONFIG_FIND_ANSWERS_CACHE_STALENESS "FindAnswersCacheStaleness"
+#define ORTHANC_CONFIG_RENDERED_FRAMES_CACHE_SIZE "RenderedFramesCacheSize"
+#define ORTHANC_CONFIG_RENDERED_FRAMES_DISK_CACHE_DIRECTORY "RenderedFramesDiskCacheDirectory"
+#define ORTHANC_CONFIG_MAXIMUM_RENDERED_FRAMES_DISK_CACHE_SIZE "MaximumRenderedFramesDiskCacheSize"
+#define ORTHANC_CONFIG_IMAGE_BUFFERS_POOL_SIZE "ImageBuffersPoolSize"
+#define ORTHANC_CONFIG_JPEG_CHROMA_SUBSAMPLING "JpegChromaSubsampling"
+#define ORTHANC_CONFIG_JPEG_FAST_DCT "JpegFastDct"
+#define ORTHANC_CONFIG_JPEG_OPTIMIZED_HUFFMAN "JpegOptimizedHuffman"
+#define ORTHANC_CONFIG_PNG_COMPRESSION_LEVEL "PngCompressionLevel"
+#define ORTHANC_CONFIG_PNG_FILTER_STRATEGY "PngFilterStrategy"
+#define ORTHANC_CONFIG_FRAME_OFFSETS_INDEX_THRESHOLD "FrameOffsetsIndexThreshold"
+#define ORTHANC_CONFIG_MAXIMUM_TRANSCODED_ATTACHMENTS_SIZE "MaximumTranscodedAttachmentsSize"
+#define ORTHANC_CONFIG_LIGHTWEIGHT_INGEST "LightweightIngest"
+#define ORTHANC_CONFIG_FRAMES_TRANSCODING_THREADS "FramesTranscodingThreads"
+#define ORTHANC_CONFIG_DICOM_SCU_ASSOCIATION_POOL_SIZE "DicomScuAssociationPoolSize"
+#define ORTHANC_CONFIG_DICOM_SCU_ASSOCIATION_POOL_TIMEOUT "DicomScuAssociationPoolTimeout"
+#define ORTHANC_CONFIG_LOADER_MEMORY_BUDGET "LoaderMemoryBudget"
+#define ORTHANC_CONFIG_LOADER_POOL_THREADS "LoaderPoolThreads"
+#define ORTHANC_CONFIG_LOADER_MAX_BANDWIDTH "LoaderMaxBandwidth"
+#define ORTHANC_CONFIG_PLUGINS_CHANGES_OVERFLOW_POLICY "PluginsChangesOverflowPolicy"
+#define ORTHANC_CONFIG_LUA_FILTERS_CONTEXTS "LuaFiltersContexts"
+#define ORTHANC_CONFIG_LUA_SCHEDULER_CONTEXT "LuaSchedulerContext"
+#define ORTHANC_CONFIG_CHANGES_THREADS "ChangesThreads"
+#define ORTHANC_CONFIG_PERSIST_UNSTABLE_RESOURCES "PersistUnstableResources"
+#define ORTHANC_CONFIG_PENDING_CHANGES_QUEUE_SIZE "PendingChangesQueueSize"
+#define ORTHANC_CONFIG_PENDING_CHANGES_OVERFLOW_POLICY "PendingChangesOverflowPolicy"
+#define ORTHANC_CONFIG_PENDING_CHANGES_OVERFLOW_TIMEOUT "PendingChangesOverflowTimeout"
+#define ORTHANC_CONFIG_MEMORY_TRIMMING_THRESHOLD "MemoryTrimmingThreshold"
+#define ORTHANC_CONFIG_TRACING_ENABLED "TracingEnabled"
+#define ORTHANC_CONFIG_TRACING_EXPORTER "TracingExporter"
+#define ORTHANC_CONFIG_TRACING_ENDPOINT "TracingEndpoint"
+#define ORTHANC_CONFIG_TRACING_FILE "TracingFile"
+#define ORTHANC_CONFIG_TRACING_SERVICE_NAME "TracingServiceName"
+#define ORTHANC_CONFIG_TRACING_SAMPLING_PERCENTAGE "TracingSamplingPercentage"
+#define ORTHANC_CONFIG_ASYNCHRONOUS_JOBS_LOADING "AsynchronousJobsLoading"
+#define ORTHANC_CONFIG_CPU_PROFILING_ENABLED "CpuProfilingEnabled"
+#define ORTHANC_CONFIG_HTTP_SERVER_TIMING_HEADER "HttpServerTimingHeader"
+#define ORTHANC_CONFIG_ACCESS_LOG_ENABLED "AccessLogEnabled"
+#define ORTHANC_CONFIG_VALIDATE_CACHED_INSTANCES "ValidateCachedInstances"
+#define ORTHANC_CONFIG_CACHE_INVALIDATION_INTERVAL "CacheInvalidationInterval"
+#define ORTHANC_CONFIG_SHARED_JOBS_QUEUE "SharedJobsQueue"
+#define ORTHANC_CONFIG_SHARED_JOBS_LEASE_DURATION "SharedJobsLeaseDuration"
+#define ORTHANC_CONFIG_SHARED_JOBS_CONCURRENCY "SharedJobsConcurrency"
+#define ORTHANC_CONFIG_DATABASE_REPLICA_MAX_STALENESS "DatabaseReplicaMaxStaleness"
+#define ORTHANC_CONFIG_DATABASE_REPLICA_PIN_DURATION "DatabaseReplicaPinDuration"
+#define ORTHANC_CONFIG_WEBDAV_LISTINGS_CACHE_SIZE "WebDavListingsCacheSize"
+#define ORTHANC_CONFIG_RESOURCES_LOOKUP_CACHE_SIZE "ResourcesLookupCacheSize"
 
 
 namespace Orthanc
@@ -82,7 +166,8 @@ namespace Orthanc
     typedef std::map<std::string, WebServiceParameters>       Peers;
     typedef std::map<std::string, unsigned int>               JobsEngineThreadsCount;
 
-    boost::shared_mutex      mutex_;
+    FairSharedMutex          mutex_;
+    boost::atomic<uint64_t>  generation_;  // Incremented by each "WriterLock"
     Json::Value              json_;
     boost::filesystem::path  defaultDirectory_;
     std::string              configurationAbsolutePath_;
@@ -95,6 +180,7 @@ namespace Orthanc
     std::set<Warnings>       disabledWarnings_;
 
     OrthancConfiguration() :
+      generation_(0),
       serverIndex_(NULL)
     {
     }
@@ -121,8 +207,8 @@ namespace Orthanc
     class ReaderLock : public boost::noncopyable
     {
     private:
-      OrthancConfiguration&                    configuration_;
-      boost::shared_lock<boost::shared_mutex>  lock_;
+      OrthancConfiguration&                configuration_;
+      boost::shared_lock<FairSharedMutex>  lock_;
 
     public:
       ReaderLock() :
@@ -146,8 +232,8 @@ namespace Orthanc
     class WriterLock : public boost::noncopyable
     {
     private:
-      OrthancConfiguration&                    configuration_;
-      boost::unique_lock<boost::shared_mutex>  lock_;
+      OrthancConfiguration&                configuration_;
+      boost::unique_lock<FairSharedMutex>  lock_;
 
     public:
       WriterLock() :
@@ -156,6 +242,12 @@ namespace Orthanc
       {
       }
 
+      ~WriterLock()
+      {
+        // Invalidate the snapshots, while still holding the lock
+        configuration_.generation_++;
+      }
+
       OrthancConfiguration& GetConfiguration()
       {
         return configuration_;
@@ -173,6 +265,64 @@ namespace Orthanc
     };
 
 
+    /**
+     * Immutable copy of the configuration options that are read on
+     * the hot paths (C-FIND, REST API, decoding of the frames...).
+     * Each thread keeps its own reference to the latest snapshot,
+     * which is only rebuilt after the configuration has been
+     * modified by a "WriterLock": The hot paths thus avoid taking
+     * the "ReaderLock" (new in Orthanc 1.12.12).
+     **/
+    class Snapshot : public boost::noncopyable
+    {
+    private:
+      bool                caseSensitivePN_;
+      bool                checkRevisions_;
+      bool                storeDicom_;
+      unsigned int        dicomLossyTranscodingQuality_;
+      std::string         instancesCacheControl_;
+      std::set<Warnings>  disabledWarnings_;
+
+    public:
+      explicit Snapshot(const OrthancConfiguration& configuration);
+
+      bool IsCaseSensitivePN() const
+      {
+        return caseSensitivePN_;
+      }
+
+      bool HasCheckRevisions() const
+      {
+        return checkRevisions_;
+      }
+
+      bool IsStoreDicom() const
+      {
+        return storeDicom_;
+      }
+
+      unsigned int GetDicomLossyTranscodingQuality() const
+      {
+        return dicomLossyTranscodingQuality_;
+      }
+
+      const std::string& GetInstancesCacheControl() const
+      {
+        return instancesCacheControl_;
+      }
+
+      bool IsWarningEnabled(Warnings warning) const
+      {
+        return disabledWarnings_.count(warning) == 0;
+      }
+    };
+
+
+    // Returns the snapshot of the current thread, only taking the
+    // "ReaderLock" if the configuration has changed since the last call
+    static boost::shared_ptr<const Snapshot> GetSnapshot();
+
+
     const std::string& GetConfigurationAbsolutePath() const
     {
       return configurationAbsolutePath_;
@@ -194,6 +344,14 @@ namespace Orthanc
 
     unsigned int GetJobsEngineWorkersThread(const std::string& jobType) const;
 
+    // Maximum number of running jobs, indexed by job type
+    void GetConcurrentJobsPerType(std::map<std::string, unsigned int>& target) const;
+
+    // CPUs to which the threads of the given pool ("Http", "Dicom",
+    // "Jobs" or "Loaders") are pinned, empty if no affinity
+    void GetThreadsAffinity(std::set<unsigned int>& target,
+                            const std::string& pool) const;
+
     void RegisterFont(ServerResources::FileResourceId resource);
 
     bool LookupStringParameter(std::string& target,
@@ -276,6 +434,10 @@ namespace Orthanc
 
     TemporaryFile* CreateTemporaryFile() const;
 
+    // Directory where the outputs of the jobs are spooled, empty for
+    // the temporary directory of the system (new in Orthanc 1.12.12)
+    std::string GetJobsOutputsDirectory() const;
+
     std::string GetDefaultPrivateCreator() const;
 
     void GetAcceptedTransferSyntaxes(std::set<DicomTransferSyntax>& target) const;
@@ -302,6 +464,26 @@ namespace Orthanc
       return GetStringParameter(ORTHANC_CONFIG_MAXIMUM_STORAGE_MODE);
     }
 
+    unsigned int GetRecyclingHighWaterMark() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_RECYCLING_HIGH_WATER_MARK);
+    }
+
+    unsigned int GetRecyclingLowWaterMark() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_RECYCLING_LOW_WATER_MARK);
+    }
+
+    unsigned int GetIngestBatchingDelay() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_INGEST_BATCHING_DELAY);
+    }
+
+    unsigned int GetIngestBatchingMaximumSize() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_INGEST_BATCHING_MAXIMUM_SIZE);
+    }
+
     std::string GetDicomDefaultRetrieveMethod() const
     {
       return GetStringParameter(ORTHANC_CONFIG_DICOM_DEFAULT_RETRIEVE_METHOD);
@@ -311,6 +493,181 @@ namespace Orthanc
       return GetUnsignedIntegerParameter(ORTHANC_CONFIG_MAXIMUM_STORAGE_CACHE_SIZE);
     }
 
+    unsigned int GetStorageCacheShards() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_STORAGE_CACHE_SHARDS);
+    }
+
+    bool IsStorageCacheNumaAware() const
+    {
+      return GetBooleanParameter(ORTHANC_CONFIG_STORAGE_CACHE_NUMA_AWARE);
+    }
+
+    std::string GetStorageCachePolicy() const
+    {
+      return GetStringParameter(ORTHANC_CONFIG_STORAGE_CACHE_POLICY);
+    }
+
+    unsigned int GetMaximumDicomHeaderCacheSize() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_MAXIMUM_DICOM_HEADER_CACHE_SIZE);
+    }
+
+    std::string GetStorageDiskCacheDirectory() const
+    {
+      return GetStringParameter(ORTHANC_CONFIG_STORAGE_DISK_CACHE_DIRECTORY);
+    }
+
+    unsigned int GetMaximumStorageDiskCacheSize() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_MAXIMUM_STORAGE_DISK_CACHE_SIZE);
+    }
+
+    unsigned int GetSeriesPrefetchThreads() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_SERIES_PREFETCH_THREADS);
+    }
+
+    unsigned int GetSQLiteReadOnlyConnections() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_SQLITE_READ_ONLY_CONNECTIONS);
+    }
+
+    bool IsSQLiteNGramIndex() const
+    {
+      return GetBooleanParameter(ORTHANC_CONFIG_SQLITE_NGRAM_INDEX);
+    }
+
+    unsigned int GetSQLiteStatisticsCheckInterval() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_SQLITE_STATISTICS_CHECK_INTERVAL);
+    }
+
+    bool IsSQLiteIncrementalVacuum() const
+    {
+      return GetBooleanParameter(ORTHANC_CONFIG_SQLITE_INCREMENTAL_VACUUM);
+    }
+
+    unsigned int GetSQLiteIncrementalVacuumPages() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_SQLITE_INCREMENTAL_VACUUM_PAGES);
+    }
+
+    bool IsSQLiteCoalesceChanges() const
+    {
+      return GetBooleanParameter(ORTHANC_CONFIG_SQLITE_COALESCE_CHANGES);
+    }
+
+    unsigned int GetChangesRetentionDays() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_CHANGES_RETENTION_DAYS);
+    }
+
+    unsigned int GetChangesRetentionCount() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_CHANGES_RETENTION_COUNT);
+    }
+
+    bool IsSeriesPrefetchOnRead() const
+    {
+      return GetBooleanParameter(ORTHANC_CONFIG_SERIES_PREFETCH_ON_READ);
+    }
+
+    unsigned int GetSeriesThumbnailsSize() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_SERIES_THUMBNAILS_SIZE);
+    }
+
+    unsigned int GetSeriesThumbnailsThreads() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_SERIES_THUMBNAILS_THREADS);
+    }
+
+    unsigned int GetIngestTranscodingThreads() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_INGEST_TRANSCODING_THREADS);
+    }
+
+    unsigned int GetStorageAccessOnFindThreads() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_STORAGE_ACCESS_ON_FIND_THREADS);
+    }
+
+    unsigned int GetStorageAccessOnFindThreadsPerRequest() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_STORAGE_ACCESS_ON_FIND_THREADS_PER_REQUEST);
+    }
+
+    unsigned int GetLoaderPoolThreads() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_LOADER_POOL_THREADS);
+    }
+
+    unsigned int GetLuaFiltersContexts() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_LUA_FILTERS_CONTEXTS);
+    }
+
+    bool IsLuaSchedulerContext() const
+    {
+      return GetBooleanParameter(ORTHANC_CONFIG_LUA_SCHEDULER_CONTEXT);
+    }
+
+    unsigned int GetChangesThreads() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_CHANGES_THREADS);
+    }
+
+    bool IsPersistUnstableResources() const
+    {
+      return GetBooleanParameter(ORTHANC_CONFIG_PERSIST_UNSTABLE_RESOURCES);
+    }
+
+    unsigned int GetPendingChangesQueueSize() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_PENDING_CHANGES_QUEUE_SIZE);
+    }
+
+    unsigned int GetPendingChangesOverflowTimeout() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_PENDING_CHANGES_OVERFLOW_TIMEOUT);
+    }
+
+    unsigned int GetMemoryTrimmingThreshold() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_MEMORY_TRIMMING_THRESHOLD);
+    }
+
+    bool IsTracingEnabled() const
+    {
+      return GetBooleanParameter(ORTHANC_CONFIG_TRACING_ENABLED);
+    }
+
+    std::string GetTracingExporter() const
+    {
+      return GetStringParameter(ORTHANC_CONFIG_TRACING_EXPORTER);
+    }
+
+    std::string GetTracingEndpoint() const
+    {
+      return GetStringParameter(ORTHANC_CONFIG_TRACING_ENDPOINT);
+    }
+
+    std::string GetTracingFile() const
+    {
+      return GetStringParameter(ORTHANC_CONFIG_TRACING_FILE);
+    }
+
+    std::string GetTracingServiceName() const
+    {
+      return GetStringParameter(ORTHANC_CONFIG_TRACING_SERVICE_NAME);
+    }
+
+    unsigned int GetTracingSamplingPercentage() const
+    {
+      return GetUnsignedIntegerParameter(ORTHANC_CONFIG_TRACING_SAMPLING_PERCENTAGE);
+    }
+
     unsigned int GetMaximumStorageSize() const
     {
       return GetUnsignedIntegerParameter(ORTHANC_CONFIG_MAXIMUM_STORAGE_SIZE);
@@ -346,6 +703,11 @@ namespace Orthanc
       return GetBooleanParameter(ORTHANC_CONFIG_STORAGE_COMPRESSION);
     }
 
+    std::string GetStorageCompressionType() const
+    {
+      return GetStringParameter(ORTHANC_CONFIG_STORAGE_COMPRESSION_TYPE);
+    }
+
     bool HasPatientLevelEnabled() const
     {
       return GetBooleanParameter(ORTHANC_CONFIG_PATIENT_LEVEL_ENABLED);
@@ -367,6 +729,13 @@ namespace Orthanc
     static void DefaultDicomDatasetToJson(Json::Value& target,
                                           const ParsedDicomFile& dicom,
                                           const std::set<DicomTag>& ignoreTagLength);
+
+    // Only converts the first-level tags listed in "whitelist" (new
+    // in Orthanc 1.12.12)
+    static void DefaultDicomDatasetToJson(Json::Value& target,
+                                          const ParsedDicomFile& dicom,
+                                          const std::set<DicomTag>& ignoreTagLength,
+                                          const std::set<DicomTag>& whitelist);
     
     static void DefaultDicomHeaderToJson(Json::Value& target,
                                          const ParsedDicomFile& dicom);
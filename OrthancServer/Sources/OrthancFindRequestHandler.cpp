@@ -117,7 +117,7 @@ namespace Orthanc
   {
     static const char* LUA_CALLBACK = "IncomingFindRequestFilter";
     
-    LuaScripting::Lock lock(context_.GetLuaScripting());
+    LuaScripting::FilterLock lock(context_.GetLuaScripting());
 
     if (!lock.GetLua().IsExistingFunction(LUA_CALLBACK))
     {
@@ -152,6 +152,7 @@ namespace Orthanc
     {
     private:
       DicomFindAnswers&           answers_;
+      IFindRequestHandler::IAnswersStream*  stream_;  // If not NULL, each answer is immediately streamed
       DicomArray                  queryAsArray_;
       const std::list<DicomTag>&  sequencesToReturn_;
       std::string                 defaultPrivateCreator_;       // the private creator to use if the group is not defined in the query itself
@@ -160,10 +161,12 @@ namespace Orthanc
 
     public:
       LookupVisitorV2(DicomFindAnswers& answers,
+                      IFindRequestHandler::IAnswersStream* stream,
                       const DicomMap& query,
                       const std::list<DicomTag>& sequencesToReturn,
                       const std::map<uint16_t, std::string>& privateCreators) :
         answers_(answers),
+        stream_(stream),
         queryAsArray_(query),
         sequencesToReturn_(sequencesToReturn),
         privateCreators_(privateCreators)
@@ -254,6 +257,11 @@ namespace Orthanc
 
           answers_.Add(dicom);
         }
+
+        if (stream_ != NULL)
+        {
+          stream_->Push(answers_);
+        }
       }
 
       virtual void MarkAsComplete() ORTHANC_OVERRIDE
@@ -264,12 +272,45 @@ namespace Orthanc
   }
 
 
-  void OrthancFindRequestHandler::Handle(DicomFindAnswers& answers,
-                                         const DicomMap& input,
-                                         const std::list<DicomTag>& sequencesToReturn,
-                                         const DicomConnectionInfo& connection)
+  namespace
+  {
+    // Copy of the answers to a C-FIND query, to be stored in the
+    // cache of the lookups
+    class CachedAnswers : public IDynamicObject
+    {
+    private:
+      DicomFindAnswers  answers_;
+
+    public:
+      explicit CachedAnswers(const DicomFindAnswers& answers) :
+        answers_(answers.IsWorklist())
+      {
+        answers_.SetEncoding(answers.GetEncoding());
+        answers_.Reserve(answers.GetSize());
+
+        for (size_t i = 0; i < answers.GetSize(); i++)
+        {
+          answers_.Add(answers.GetAnswer(i));
+        }
+
+        answers_.SetComplete(answers.IsComplete());
+      }
+
+      const DicomFindAnswers& GetAnswers() const
+      {
+        return answers_;
+      }
+    };
+  }
+
+
+  void OrthancFindRequestHandler::HandleInternal(DicomFindAnswers& answers,
+                                                 IAnswersStream* stream,
+                                                 const DicomMap& input,
+                                                 const std::list<DicomTag>& sequencesToReturn,
+                                                 const DicomConnectionInfo& connection)
   {
-    MetricsRegistry::Timer timer(context_.GetMetricsRegistry(), "orthanc_find_scp_duration_ms");
+    MetricsRegistry::HistogramTimer timer(context_.GetMetricsRegistry(), "orthanc_find_scp_duration_ms", "");
 
 
     /**
@@ -436,6 +477,54 @@ namespace Orthanc
     }
 
 
+    /**
+     * Possibly reuse the cached answers to the same query (new in
+     * Orthanc 1.12.12). The stamp of the database index must be read
+     * before running the query.
+     **/
+
+    std::string cacheKey;
+    LookupAnswersCache::Stamp stamp;
+
+    if (stream == NULL &&
+        context_.HasFindAnswersCache())
+    {
+      Json::Value key = Json::objectValue;
+      key["Type"] = "C-FIND";
+      key["Manufacturer"] = EnumerationToString(connection.GetModalityManufacturer());
+      key["Encoding"] = EnumerationToString(answers.GetEncoding());
+      key["CaseSensitivePN"] = caseSensitivePN;
+      filteredInput->Serialize(key["Query"]);
+
+      key["Sequences"] = Json::arrayValue;
+      for (std::list<DicomTag>::const_iterator it = sequencesToReturn.begin();
+           it != sequencesToReturn.end(); ++it)
+      {
+        key["Sequences"].append(it->Format());
+      }
+
+      Toolbox::WriteFastJson(cacheKey, key);
+
+      stamp = LookupAnswersCache::Stamp(context_.GetIndex());
+
+      boost::shared_ptr<IDynamicObject> cached = context_.GetFindAnswersCache().Lookup(cacheKey, stamp);
+      if (cached.get() != NULL)
+      {
+        const DicomFindAnswers& source = dynamic_cast<const CachedAnswers&>(*cached).GetAnswers();
+
+        for (size_t i = 0; i < source.GetSize(); i++)
+        {
+          answers.Add(source.GetAnswer(i));
+        }
+
+        answers.SetComplete(source.IsComplete());
+
+        CLOG(INFO, DICOM) << "C-FIND: Reusing " << source.GetSize() << " cached answer(s)";
+        return;
+      }
+    }
+
+
     /**
      * Run the query.
      **/
@@ -445,8 +534,71 @@ namespace Orthanc
     finder.AddRequestedTags(requestedTags);
     finder.SetDatabaseLimits(context_.GetDatabaseLimits(level));
 
-    LookupVisitorV2 visitor(answers, *filteredInput, sequencesToReturn, privateCreators);
-    finder.Execute(visitor, context_);
+    LookupVisitorV2 visitor(answers, stream, *filteredInput, sequencesToReturn, privateCreators);
+
+    if (stream == NULL)
+    {
+      finder.Execute(visitor, context_);
+    }
+    else
+    {
+      // Read the database index by pages, while the answers are sent
+      // by the C-FIND SCP (new in Orthanc 1.12.12)
+      finder.ExecuteByPages(visitor, context_, context_.GetFindStreamingPageSize());
+
+      // Report whether the answers are complete
+      stream->Push(answers);
+    }
+
+    /**
+     * Monitor the DICOM files that were read from the storage area to
+     * answer the tags that are not stored in the database index. These
+     * files are read by the pool of loaders if
+     * "StorageAccessOnFindThreads" is not zero (new in Orthanc 1.12.12).
+     **/
+    if (finder.GetStorageReadsCount() > 0)
+    {
+      CLOG(INFO, DICOM) << "C-FIND: " << finder.GetStorageReadsCount()
+                        << " DICOM file(s) were read from the storage area";
+    }
+
+    context_.GetMetricsRegistry().SetIntegerValue("orthanc_find_scp_storage_reads",
+                                                  static_cast<int64_t>(finder.GetStorageReadsCount()),
+                                                  MetricsUpdatePolicy_MaxOver1Minute);
+    context_.GetMetricsRegistry().IncrementIntegerValue("orthanc_find_scp_storage_reads_total",
+                                                        static_cast<int64_t>(finder.GetStorageReadsCount()));
+
+    if (!cacheKey.empty())
+    {
+      boost::shared_ptr<IDynamicObject> cached(new CachedAnswers(answers));
+      context_.GetFindAnswersCache().Store(cacheKey, stamp, cached);
+    }
+  }
+
+
+  void OrthancFindRequestHandler::Handle(DicomFindAnswers& answers,
+                                         const DicomMap& input,
+                                         const std::list<DicomTag>& sequencesToReturn,
+                                         const DicomConnectionInfo& connection)
+  {
+    HandleInternal(answers, NULL, input, sequencesToReturn, connection);
+  }
+
+
+  bool OrthancFindRequestHandler::HasStreamingSupport() const
+  {
+    return (context_.GetFindStreamingPageSize() != 0);
+  }
+
+
+  void OrthancFindRequestHandler::HandleStreaming(IAnswersStream& stream,
+                                                  const DicomMap& input,
+                                                  const std::list<DicomTag>& sequencesToReturn,
+                                                  const DicomConnectionInfo& connection)
+  {
+    // Only holds the answer that is being formatted
+    DicomFindAnswers answers(false);
+    HandleInternal(answers, &stream, input, sequencesToReturn, connection);
   }
 
 
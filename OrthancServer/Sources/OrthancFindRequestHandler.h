@@ -48,6 +48,13 @@ namespace Orthanc
                         const DicomMap& source,
                         const DicomConnectionInfo& connection);
 
+    // If "stream" is not NULL, the answers are streamed (new in Orthanc 1.12.12)
+    void HandleInternal(DicomFindAnswers& answers,
+                        IAnswersStream* stream,
+                        const DicomMap& input,
+                        const std::list<DicomTag>& sequencesToReturn,
+                        const DicomConnectionInfo& connection);
+
   public:
     explicit OrthancFindRequestHandler(ServerContext& context);
 
@@ -56,6 +63,14 @@ namespace Orthanc
                         const std::list<DicomTag>& sequencesToReturn,
                         const DicomConnectionInfo& connection) ORTHANC_OVERRIDE;
 
+    // The answers are streamed if "FindStreamingPageSize" is not zero
+    virtual bool HasStreamingSupport() const ORTHANC_OVERRIDE;
+
+    virtual void HandleStreaming(IAnswersStream& stream,
+                                 const DicomMap& input,
+                                 const std::list<DicomTag>& sequencesToReturn,
+                                 const DicomConnectionInfo& connection) ORTHANC_OVERRIDE;
+
     unsigned int GetMaxResults() const
     {
       return maxResults_;
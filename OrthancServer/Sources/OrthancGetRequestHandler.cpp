@@ -502,7 +502,7 @@ namespace Orthanc
                                         const std::string& calledAet,
                                         uint32_t timeout)
   {
-    MetricsRegistry::Timer timer(context_.GetMetricsRegistry(), "orthanc_get_scp_duration_ms");
+    MetricsRegistry::HistogramTimer timer(context_.GetMetricsRegistry(), "orthanc_get_scp_duration_ms", "");
 
     CLOG(INFO, DICOM) << "C-GET-SCU request received from AET \"" << originatorAet << "\"";
 
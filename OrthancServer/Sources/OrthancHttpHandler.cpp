@@ -24,11 +24,45 @@
 #include "PrecompiledHeadersServer.h"
 #include "OrthancHttpHandler.h"
 
+#include "../../OrthancFramework/Sources/ElapsedTimer.h"
+#include "../../OrthancFramework/Sources/Logging.h"
 #include "../../OrthancFramework/Sources/OrthancException.h"
+#include "../../OrthancFramework/Sources/RequestTimings.h"
+#include "../../OrthancFramework/Sources/Toolbox.h"
+#include "../../OrthancFramework/Sources/Tracing.h"
 
 
 namespace Orthanc
 {
+  // Structured access log, with one JSON object per HTTP request
+  // (new in Orthanc 1.12.12)
+  static void LogAccess(const RequestTimings::Scope& timings,
+                        ElapsedTimer& timer,
+                        HttpMethod method,
+                        const UriComponents& uri,
+                        const char* remoteIp,
+                        const char* username,
+                        HttpStatus status,
+                        uint64_t sentBodySize)
+  {
+    Json::Value entry;
+    timings.Format(entry);
+    entry["Protocol"] = "HTTP";
+    entry["Method"] = EnumerationToString(method);
+    entry["Uri"] = Toolbox::FlattenUri(uri);
+    entry["RemoteIp"] = (remoteIp == NULL ? "" : remoteIp);
+    entry["Username"] = (username == NULL ? "" : username);
+    entry["Status"] = static_cast<int>(status);
+    entry["SentBytes"] = static_cast<Json::UInt64>(sentBodySize);
+    entry["DurationMs"] = static_cast<double>(timer.GetElapsedMicroseconds()) / 1000.0;
+
+    std::string s;
+    Toolbox::WriteFastJson(s, entry);
+
+    CLOG(WARNING, HTTP) << "Access log: " << Toolbox::StripSpaces(s);
+  }
+
+
   bool OrthancHttpHandler::CreateChunkedRequestReader(
     std::unique_ptr<IHttpHandler::IChunkedRequestReader>& target,
     RequestOrigin origin,
@@ -75,16 +109,61 @@ namespace Orthanc
                                   size_t bodySize,
                                   const std::string& authenticationPayload)
   {
-    for (Handlers::const_iterator it = handlers_.begin(); it != handlers_.end(); ++it) 
+    // The keys of the HTTP headers are in lower case
+    HttpToolbox::Arguments::const_iterator traceparent = headers.find("traceparent");
+
+    Tracing::Span span("HTTP " + std::string(EnumerationToString(method)), Tracing::SpanKind_Server,
+                       traceparent == headers.end() ? "" : traceparent->second);
+
+    if (span.IsRecording())
     {
-      if ((*it)->Handle(output, origin, remoteIp, username, method, uri, 
-                        headers, getArguments, bodyData, bodySize, authenticationPayload))
+      span.SetAttribute("url.path", Toolbox::FlattenUri(uri));
+
+      if (remoteIp != NULL)
       {
-        return true;
+        span.SetAttribute("client.address", remoteIp);
       }
     }
 
-    return false;
+    // The per-request accounting is installed here, so that it
+    // covers both the built-in REST API and the routes of the plugins
+    RequestTimings::Scope timings;
+    timings.SetServerTimingExposed(serverTimingHeader_);
+
+    ElapsedTimer timer;
+    bool handled = false;
+
+    try
+    {
+      for (Handlers::const_iterator it = handlers_.begin(); it != handlers_.end(); ++it) 
+      {
+        if ((*it)->Handle(output, origin, remoteIp, username, method, uri, 
+                          headers, getArguments, bodyData, bodySize, authenticationPayload))
+        {
+          handled = true;
+          break;
+        }
+      }
+    }
+    catch (OrthancException& e)
+    {
+      span.SetError(e.What());
+
+      if (accessLog_)
+      {
+        LogAccess(timings, timer, method, uri, remoteIp, username, e.GetHttpStatus(), output.GetSentBodySize());
+      }
+
+      throw;
+    }
+
+    if (accessLog_)
+    {
+      LogAccess(timings, timer, method, uri, remoteIp, username,
+                handled ? output.GetHttpStatus() : HttpStatus_404_NotFound, output.GetSentBodySize());
+    }
+
+    return handled;
   }
 
 
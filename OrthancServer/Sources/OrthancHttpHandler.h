@@ -34,12 +34,29 @@ namespace Orthanc
 
     Handlers      handlers_;
     IHttpHandler *orthancRestApi_;
+    bool          serverTimingHeader_;  // New in Orthanc 1.12.12
+    bool          accessLog_;           // New in Orthanc 1.12.12
 
   public:
-    OrthancHttpHandler() : orthancRestApi_(NULL)
+    OrthancHttpHandler() :
+      orthancRestApi_(NULL),
+      serverTimingHeader_(false),
+      accessLog_(false)
     {
     }
 
+    // Must be called before the HTTP server is started
+    void SetServerTimingHeaderEnabled(bool enabled)
+    {
+      serverTimingHeader_ = enabled;
+    }
+
+    // Must be called before the HTTP server is started
+    void SetAccessLogEnabled(bool enabled)
+    {
+      accessLog_ = enabled;
+    }
+
     virtual bool CreateChunkedRequestReader(std::unique_ptr<IChunkedRequestReader>& target,
                                             RequestOrigin origin,
                                             const char* remoteIp,
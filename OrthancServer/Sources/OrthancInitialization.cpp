@@ -56,6 +56,7 @@
 
 #include "../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
 #include "../../OrthancFramework/Sources/FileStorage/FilesystemStorage.h"
+#include "../../OrthancFramework/Sources/FileStorage/MultiRootStorageArea.h"
 #include "../../OrthancFramework/Sources/FileStorage/PluginStorageAreaAdapter.h"
 #include "../../OrthancFramework/Sources/HttpClient.h"
 #include "../../OrthancFramework/Sources/Logging.h"
@@ -445,7 +446,37 @@ namespace Orthanc
       LOG(WARNING) << "Error encountered while creating IndexDirectory: " << e.what(); // the exception was ignored before 1.12.12; let's log it
     }
 
-    return new SQLiteDatabaseWrapper(Orthanc::SystemToolbox::PathToUtf8(indexDirectory) + "/index");
+    std::unique_ptr<SQLiteDatabaseWrapper> database(
+      new SQLiteDatabaseWrapper(Orthanc::SystemToolbox::PathToUtf8(indexDirectory) + "/index"));
+
+    const unsigned int readOnlyConnections = lock.GetConfiguration().GetSQLiteReadOnlyConnections();
+    if (readOnlyConnections > 0)
+    {
+      LOG(WARNING) << "Using " << readOnlyConnections << " read-only connection(s) to the SQLite index";
+      database->SetReadOnlyConnectionsCount(readOnlyConnections);
+    }
+
+    if (lock.GetConfiguration().IsSQLiteNGramIndex())
+    {
+      LOG(WARNING) << "Using an n-gram index to speed up the wildcard lookups in the SQLite index";
+      database->SetNGramIndex(true);
+    }
+
+    database->SetGlobalStatisticsCheckInterval(lock.GetConfiguration().GetSQLiteStatisticsCheckInterval());
+
+    if (lock.GetConfiguration().IsSQLiteIncrementalVacuum())
+    {
+      LOG(WARNING) << "Using the incremental vacuum mode of the SQLite index";
+      database->SetIncrementalVacuum(true, lock.GetConfiguration().GetSQLiteIncrementalVacuumPages());
+    }
+
+    if (lock.GetConfiguration().IsSQLiteCoalesceChanges())
+    {
+      LOG(WARNING) << "Coalescing the repeated changes in the SQLite index";
+      database->SetCoalesceChanges(true);
+    }
+
+    return database.release();
   }
 
 
@@ -465,6 +496,16 @@ namespace Orthanc
       {
       }
 
+      void SetMemoryMappingThreshold(uint64_t threshold)
+      {
+        storage_.SetMemoryMappingThreshold(threshold);
+      }
+
+      void SetGroupCommitWindow(unsigned int window)
+      {
+        storage_.SetGroupCommitWindow(window);
+      }
+
       virtual void Create(const std::string& uuid,
                           const void* content, 
                           size_t size,
@@ -504,14 +545,71 @@ namespace Orthanc
           storage_.Remove(uuid, type);
         }
       }
+
+      virtual bool LookupLocalPath(std::string& path,
+                                   const std::string& uuid,
+                                   FileContentType type) const ORTHANC_OVERRIDE
+      {
+        return (type != FileContentType_Dicom &&
+                storage_.LookupLocalPath(path, uuid, type));
+      }
     };
   }
 
 
+  static IPluginStorageArea* CreateMultiRootStorage(const OrthancConfiguration& configuration,
+                                                    const Json::Value& roots,
+                                                    bool fsyncOnWrite,
+                                                    uint64_t memoryMappingThreshold,
+                                                    unsigned int groupCommitWindow)
+  {
+    static const char* const PATH = "Path";
+    static const char* const WEIGHT = "Weight";
+    static const char* const THREADS = "Threads";
+
+    if (roots.type() != Json::objectValue)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "The configuration option \"" +
+                             std::string(ORTHANC_CONFIG_STORAGE_ROOTS) + "\" must be an object");
+    }
+
+    const MultiRootStorageArea::Placement placement = MultiRootStorageArea::StringToPlacement(
+      configuration.GetStringParameter(ORTHANC_CONFIG_STORAGE_ROOTS_PLACEMENT));
+
+    std::unique_ptr<MultiRootStorageArea> storage(new MultiRootStorageArea(placement));
+
+    Json::Value::Members names = roots.getMemberNames();
+    for (size_t i = 0; i < names.size(); i++)
+    {
+      const Json::Value& root = roots[names[i]];
+      if (root.type() != Json::objectValue)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "The storage root \"" + names[i] + "\" must be an object");
+      }
+
+      const boost::filesystem::path path =
+        configuration.InterpretStringParameterAsPath(SerializationToolbox::ReadString(root, PATH));
+      const unsigned int weight = SerializationToolbox::ReadUnsignedInteger(root, WEIGHT, 1);
+      const unsigned int threads = SerializationToolbox::ReadUnsignedInteger(root, THREADS, 4);
+
+      LOG(WARNING) << "Storage root \"" << names[i] << "\": " << SystemToolbox::PathToUtf8(path)
+                   << " (weight " << weight << ", " << threads << " I/O threads)";
+
+      FilesystemStorage& area = storage->AddRoot(names[i], path, fsyncOnWrite, weight, threads);
+      area.SetMemoryMappingThreshold(memoryMappingThreshold);
+      area.SetGroupCommitWindow(groupCommitWindow);
+    }
+
+    return storage.release();
+  }
+
+
   static IPluginStorageArea* CreateFilesystemStorage()
   {
     static const char* const SYNC_STORAGE_AREA = "SyncStorageArea";
     static const char* const STORE_DICOM = "StoreDicom";
+    static const char* const MEMORY_MAPPING_THRESHOLD = "StorageMemoryMappingThreshold";
+    static const char* const GROUP_COMMIT_WINDOW = "SyncStorageAreaGroupCommitWindow";
     
     OrthancConfiguration::ReaderLock lock;
 
@@ -526,14 +624,54 @@ namespace Orthanc
     // New in Orthanc 1.7.4
     bool fsyncOnWrite = lock.GetConfiguration().GetBooleanParameter(SYNC_STORAGE_AREA);
 
+    // New in Orthanc 1.12.12
+    const uint64_t memoryMappingThreshold =
+      static_cast<uint64_t>(lock.GetConfiguration().GetUnsignedIntegerParameter(MEMORY_MAPPING_THRESHOLD)) * 1024 * 1024;
+
+    // New in Orthanc 1.12.12
+    const unsigned int groupCommitWindow = lock.GetConfiguration().GetUnsignedIntegerParameter(GROUP_COMMIT_WINDOW);
+
+    if (fsyncOnWrite &&
+        groupCommitWindow != 0)
+    {
+      LOG(WARNING) << "The writes to the storage area are flushed to disk by batches of "
+                   << groupCommitWindow << " ms";
+    }
+
+    if (memoryMappingThreshold != 0)
+    {
+      LOG(WARNING) << "Files of the storage area larger than "
+                   << (memoryMappingThreshold / (1024 * 1024)) << " MB are read using memory mapping";
+    }
+
+    // New in Orthanc 1.12.12
+    if (lock.GetJson().isMember(ORTHANC_CONFIG_STORAGE_ROOTS) &&
+        !lock.GetJson()[ORTHANC_CONFIG_STORAGE_ROOTS].empty())
+    {
+      if (!lock.GetConfiguration().GetBooleanParameter(STORE_DICOM))
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "The option \"" + std::string(ORTHANC_CONFIG_STORAGE_ROOTS) +
+                               "\" cannot be used if \"" + std::string(STORE_DICOM) + "\" is false");
+      }
+
+      return CreateMultiRootStorage(lock.GetConfiguration(), lock.GetJson()[ORTHANC_CONFIG_STORAGE_ROOTS],
+                                    fsyncOnWrite, memoryMappingThreshold, groupCommitWindow);
+    }
+
     if (lock.GetConfiguration().GetBooleanParameter(STORE_DICOM))
     {
-      return new PluginStorageAreaAdapter(new FilesystemStorage(storageDirectory, fsyncOnWrite));
+      std::unique_ptr<FilesystemStorage> storage(new FilesystemStorage(storageDirectory, fsyncOnWrite));
+      storage->SetMemoryMappingThreshold(memoryMappingThreshold);
+      storage->SetGroupCommitWindow(groupCommitWindow);
+      return new PluginStorageAreaAdapter(storage.release(), "filesystem");
     }
     else
     {
       LOG(WARNING) << "The DICOM files will not be stored, Orthanc running in index-only mode";
-      return new PluginStorageAreaAdapter(new FilesystemStorageWithoutDicom(storageDirectory, fsyncOnWrite));
+      std::unique_ptr<FilesystemStorageWithoutDicom> storage(new FilesystemStorageWithoutDicom(storageDirectory, fsyncOnWrite));
+      storage->SetMemoryMappingThreshold(memoryMappingThreshold);
+      storage->SetGroupCommitWindow(groupCommitWindow);
+      return new PluginStorageAreaAdapter(storage.release(), "filesystem");
     }
   }
 
@@ -33,6 +33,7 @@
 #include "OrthancConfiguration.h"
 #include "ServerContext.h"
 #include "ServerJobs/DicomModalityStoreJob.h"
+#include "ServerJobs/ParallelStoreSender.h"
 #include "ServerJobs/ThreadedInstancesLoader.h"
 
 
@@ -55,6 +56,29 @@ namespace Orthanc
       std::string originatorAet_;
       uint16_t originatorId_;
       std::unique_ptr<DicomStoreUserConnection> connection_;
+      std::unique_ptr<ParallelStoreSender> sender_;  // If "MaxParallelAssociations" > 1, destroyed before the loader
+
+      void SendInParallel(size_t position)
+      {
+        if (sender_.get() == NULL)
+        {
+          DicomAssociationParameters params(localAet_, remote_);
+          sender_.reset(new ParallelStoreSender(context_, params, *instancesLoader_, true,
+                                                originatorAet_, originatorId_, position));
+        }
+
+        // Keep one sub-operation in flight for each association: The
+        // outcomes are still collected in order, one per call to
+        // "DoNext()", which keeps the pending C-MOVE responses accurate
+        sender_->Submit(instancesIds_, position + remote_.GetMaxParallelAssociations());
+
+        std::string sopClassUid, sopInstanceUid;  // Unused
+        if (!sender_->WaitOutcome(sopClassUid, sopInstanceUid, position))
+        {
+          throw OrthancException(ErrorCode_UnknownResource, "An instance was removed during the C-MOVE: " +
+                                 instancesIds_[position]);
+        }
+      }
 
     public:
       SynchronousMove(ServerContext& context,
@@ -101,6 +125,16 @@ namespace Orthanc
         }
       }
 
+      virtual ~SynchronousMove()
+      {
+        sender_.reset(NULL);
+
+        if (connection_.get() != NULL)
+        {
+          context_.GetStoreConnectionPool().Release(connection_.release());
+        }
+      }
+
       virtual unsigned int GetSubOperationCount() const ORTHANC_OVERRIDE
       {
         return instancesIds_.size();
@@ -113,6 +147,12 @@ namespace Orthanc
           return Status_Failure;
         }
 
+        if (remote_.GetMaxParallelAssociations() > 1)
+        {
+          SendInParallel(position_++);
+          return Status_Success;
+        }
+
         const std::string& id = instancesIds_[position_++];
 
         std::string dicom;
@@ -121,12 +161,20 @@ namespace Orthanc
         if (connection_.get() == NULL)
         {
           DicomAssociationParameters params(localAet_, remote_);
-          connection_.reset(new DicomStoreUserConnection(params));
+          connection_.reset(context_.GetStoreConnectionPool().Acquire(params));
         }
 
-        std::string sopClassUid, sopInstanceUid;  // Unused
-        context_.PerformCStoreWithTranscoding(sopClassUid, sopInstanceUid, *connection_, dicom,
-                                              true, originatorAet_, originatorId_);
+        try
+        {
+          std::string sopClassUid, sopInstanceUid;  // Unused
+          context_.PerformCStoreWithTranscoding(sopClassUid, sopInstanceUid, *connection_, dicom,
+                                                true, originatorAet_, originatorId_);
+        }
+        catch (OrthancException&)
+        {
+          connection_.reset(NULL);  // Don't give a possibly broken association back to the pool
+          throw;
+        }
 
         return Status_Success;
       }
@@ -346,7 +394,7 @@ namespace Orthanc
                                                           const DicomConnectionInfo& connection,
                                                           uint16_t originatorId)
   {
-    MetricsRegistry::Timer timer(context_.GetMetricsRegistry(), "orthanc_move_scp_duration_ms");
+    MetricsRegistry::HistogramTimer timer(context_.GetMetricsRegistry(), "orthanc_move_scp_duration_ms", "");
 
     CLOG(INFO, DICOM) << "Move-SCU request received for AET \"" << targetAet << "\"";
 
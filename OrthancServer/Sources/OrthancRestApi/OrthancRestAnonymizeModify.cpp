@@ -375,15 +375,6 @@ namespace Orthanc
   }
 
 
-  static void SetKeepSource(CleaningInstancesJob& job,
-                            const Json::Value& body)
-  {
-    if (body.isMember(KEEP_SOURCE))
-    {
-      job.SetKeepSource(SerializationToolbox::ReadBoolean(body, KEEP_SOURCE));
-    }
-  }
-
   static void SetKeepSource(ThreadedSetOfInstancesJob& job,
                             const Json::Value& body)
   {
@@ -1167,7 +1158,14 @@ namespace Orthanc
 
     const std::string study = call.GetUriComponent("id", "");
 
-    std::unique_ptr<SplitStudyJob> job(new SplitStudyJob(context, study));    
+    unsigned int workersCount = 0;
+
+    {
+      OrthancConfiguration::ReaderLock lock;
+      workersCount = lock.GetConfiguration().GetJobsEngineWorkersThread("SplitStudy");
+    }
+
+    std::unique_ptr<SplitStudyJob> job(new SplitStudyJob(context, study, workersCount));
     job->SetOrigin(call);
 
     bool ok = false;
@@ -1200,8 +1198,6 @@ namespace Orthanc
       throw OrthancException(ErrorCode_BadRequest, "Both the \"Series\" and the \"Instances\" fields are missing");
     }    
     
-    job->AddTrailingStep();
-
     SetKeepSource(*job, request);
 
     if (request.isMember(REMOVE))
@@ -1248,7 +1244,7 @@ namespace Orthanc
       }
     }
 
-    OrthancRestApi::GetApi(call).SubmitCommandsJob
+    OrthancRestApi::GetApi(call).SubmitThreadedInstancesJob
       (call, job.release(), true /* synchronous by default */, request);
   }
 
@@ -1284,7 +1280,14 @@ namespace Orthanc
 
     const std::string study = call.GetUriComponent("id", "");
 
-    std::unique_ptr<MergeStudyJob> job(new MergeStudyJob(context, study));    
+    unsigned int workersCount = 0;
+
+    {
+      OrthancConfiguration::ReaderLock lock;
+      workersCount = lock.GetConfiguration().GetJobsEngineWorkersThread("MergeStudy");
+    }
+
+    std::unique_ptr<MergeStudyJob> job(new MergeStudyJob(context, study, workersCount));
     job->SetOrigin(call);
 
     std::vector<std::string> resources;
@@ -1295,11 +1298,9 @@ namespace Orthanc
       job->AddSource(resources[i]);
     }
 
-    job->AddTrailingStep();
-
     SetKeepSource(*job, request);
 
-    OrthancRestApi::GetApi(call).SubmitCommandsJob
+    OrthancRestApi::GetApi(call).SubmitThreadedInstancesJob
       (call, job.release(), true /* synchronous by default */, request);
   }
   
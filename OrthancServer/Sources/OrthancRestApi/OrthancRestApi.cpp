@@ -26,16 +26,25 @@
 
 #include "../../../OrthancFramework/Sources/Compression/GzipCompressor.h"
 #include "../../../OrthancFramework/Sources/Compression/ZipReader.h"
+#include "../../../OrthancFramework/Sources/Compression/ZipStreamReader.h"
 #include "../../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
+#include "../../../OrthancFramework/Sources/ElapsedTimer.h"
 #include "../../../OrthancFramework/Sources/Logging.h"
 #include "../../../OrthancFramework/Sources/MetricsRegistry.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/IExecutorService.h"
+#include "../../../OrthancFramework/Sources/RequestTimings.h"
+#include "../../../OrthancFramework/Sources/Tracing.h"
+#include "../../../OrthancFramework/Sources/RestApi/RestApiOutput.h"
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
+#include "../../../OrthancFramework/Sources/Toolbox.h"
 #include "../DicomInstanceToStore.h"
 #include "../OrthancConfiguration.h"
 #include "../ServerContext.h"
 #include "../ServerJobs/ThreadedSetOfInstancesJob.h"
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace Orthanc
 {
@@ -132,6 +141,314 @@ namespace Orthanc
 
   // Upload of DICOM files through HTTP ---------------------------------------
 
+  static void StoreFileFromZipArchive(Json::Value& answer,
+                                      ServerContext& context,
+                                      const DicomInstanceOrigin& origin,
+                                      const std::string& filename,
+                                      const void* content,
+                                      size_t size)
+  {
+    if (size != 0)
+    {
+      LOG(INFO) << "Uploading DICOM file from ZIP archive: " << filename;
+
+      std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromBuffer(content, size));
+      toStore->SetOrigin(origin);
+
+      try
+      {
+        std::string publicId;
+
+        ServerContext::StoreResult result = context.Store(publicId, *toStore);
+
+        Json::Value info;
+        SetupResourceAnswer(info, *toStore, result.GetStatus(), publicId);
+        answer.append(info);
+      }
+      catch (OrthancException& e)
+      {
+        if (e.GetErrorCode() == ErrorCode_BadFileFormat)
+        {
+          LOG(ERROR) << "Cannot import non-DICOM file from ZIP archive: " << filename;
+        }
+        else if (e.GetErrorCode() == ErrorCode_InexistentTag)
+        {
+          /**
+           * Allow upload of ZIP archives containing a DICOMDIR
+           * file (new in Orthanc 1.9.7):
+           * https://groups.google.com/g/orthanc-users/c/sgBU89o4nhU/m/kbRAYiQUAAAJ
+           **/
+          LOG(ERROR) << "Ignoring what is probably a DICOMDIR file within a ZIP archive: \"" << filename << "\"";
+        }
+        else
+        {
+          throw;
+        }
+      }
+    }
+  }
+
+
+  /**
+   * Stores the DICOM files of one ZIP archive, possibly on the pool
+   * of the "ZipUploadThreads" workers (new in Orthanc 1.12.12). At
+   * most "GetZipUploadWindow()" files are pending at once, and the
+   * statuses are appended to the answer in the order of the archive.
+   **/
+  class ZipArchiveStorer : public boost::noncopyable
+  {
+  private:
+    typedef SingleValueObject<Json::Value>  StoreAnswer;
+
+    class StoreCallable : public ICallable
+    {
+    private:
+      ServerContext&       context_;
+      DicomInstanceOrigin  origin_;
+      std::string          filename_;
+      std::string          content_;
+
+    public:
+      StoreCallable(ServerContext& context,
+                    const DicomInstanceOrigin& origin,
+                    const std::string& filename,
+                    std::string& content /* will be swapped */) :
+        context_(context),
+        origin_(origin),
+        filename_(filename)
+      {
+        content_.swap(content);
+      }
+
+      virtual IDynamicObject* Call() ORTHANC_OVERRIDE
+      {
+        std::unique_ptr<StoreAnswer> answer(new StoreAnswer(Json::arrayValue));
+
+        Json::Value info = Json::arrayValue;
+        StoreFileFromZipArchive(info, context_, origin_, filename_,
+                                content_.empty() ? NULL : content_.c_str(), content_.size());
+        answer->SetValue(info);
+
+        return answer.release();
+      }
+    };
+
+    Json::Value&                         answer_;
+    ServerContext&                       context_;
+    DicomInstanceOrigin                  origin_;
+    boost::shared_ptr<IExecutorService>  workers_;
+    size_t                               window_;
+    std::list<Future*>                   pending_;
+
+    void CollectOldest()
+    {
+      assert(!pending_.empty());
+
+      std::unique_ptr<Future> future(pending_.front());
+      pending_.pop_front();
+
+      std::unique_ptr<IDynamicObject> result(future->ReleaseResult());
+      const Json::Value& info = dynamic_cast<const StoreAnswer&>(*result).GetValue();
+
+      for (Json::Value::ArrayIndex i = 0; i < info.size(); i++)
+      {
+        answer_.append(info[i]);
+      }
+    }
+
+  public:
+    ZipArchiveStorer(Json::Value& answer,
+                     ServerContext& context,
+                     const DicomInstanceOrigin& origin) :
+      answer_(answer),
+      context_(context),
+      origin_(origin),
+      workers_(context.GetZipUploadWorkers()),
+      window_(std::max(1u, context.GetZipUploadWindow()))
+    {
+    }
+
+    ~ZipArchiveStorer()
+    {
+      // Only reached with pending files if some error has occurred
+      for (std::list<Future*>::iterator it = pending_.begin(); it != pending_.end(); ++it)
+      {
+        delete *it;
+      }
+    }
+
+    void Store(const std::string& filename,
+               std::string& content /* will be swapped */)
+    {
+      if (workers_.get() == NULL)
+      {
+        StoreFileFromZipArchive(answer_, context_, origin_, filename,
+                                content.empty() ? NULL : content.c_str(), content.size());
+      }
+      else
+      {
+        while (pending_.size() >= window_)
+        {
+          CollectOldest();
+        }
+
+        pending_.push_back(workers_->Submit(new StoreCallable(context_, origin_, filename, content)));
+      }
+    }
+
+    void Store(const std::string& filename,
+               const void* content,
+               size_t size)
+    {
+      if (workers_.get() == NULL)
+      {
+        StoreFileFromZipArchive(answer_, context_, origin_, filename, content, size);
+      }
+      else
+      {
+        std::string copy(reinterpret_cast<const char*>(content), size);
+        Store(filename, copy);
+      }
+    }
+
+    void Finish()
+    {
+      while (!pending_.empty())
+      {
+        CollectOldest();
+      }
+    }
+  };
+
+
+  /**
+   * Streaming version of "POST /instances" (new in Orthanc
+   * 1.12.12). If the body of the request is a ZIP archive, each
+   * DICOM file is stored as soon as it has been received, which
+   * bounds the memory consumption by the size of the largest DICOM
+   * file (instead of the size of the full archive). Any other body
+   * is collected in memory, then forwarded to "UploadDicomFile()".
+   **/
+  class OrthancRestApi::UploadDicomFileReader :
+    public IHttpHandler::IChunkedRequestReader,
+    private ZipStreamReader::IHandler
+  {
+  private:
+    OrthancRestApi&                   api_;
+    std::string                       remoteIp_;
+    std::string                       username_;
+    UriComponents                     uri_;
+    HttpToolbox::Arguments            headers_;
+    std::string                       authenticationPayload_;
+    std::string                       body_;
+    std::unique_ptr<ZipStreamReader>  zip_;
+    Json::Value                       answer_;
+    std::unique_ptr<ZipArchiveStorer>  storer_;
+
+    virtual void HandleFile(const std::string& filename,
+                            const void* content,
+                            size_t size) ORTHANC_OVERRIDE
+    {
+      assert(storer_.get() != NULL);
+      storer_->Store(filename, content, size);
+    }
+
+  public:
+    UploadDicomFileReader(OrthancRestApi& api,
+                          const char* remoteIp,
+                          const char* username,
+                          const UriComponents& uri,
+                          const HttpToolbox::Arguments& headers,
+                          const std::string& authenticationPayload) :
+      api_(api),
+      remoteIp_(remoteIp),
+      username_(username),
+      uri_(uri),
+      headers_(headers),
+      authenticationPayload_(authenticationPayload),
+      answer_(Json::arrayValue)
+    {
+    }
+
+    virtual void AddBodyChunk(const void* data,
+                              size_t size) ORTHANC_OVERRIDE
+    {
+      if (zip_.get() != NULL)
+      {
+        zip_->AddChunk(data, size);
+        return;
+      }
+
+      body_.append(reinterpret_cast<const char*>(data), size);
+
+      // Look for the signature of a ZIP archive at the beginning of the body
+      if (body_.size() >= 4 &&
+          body_.size() - size < 4 &&
+          ZipReader::IsZipMemoryBuffer(body_.c_str(), 4))
+      {
+        HttpToolbox::Arguments::const_iterator encoding = headers_.find("content-encoding");
+        if (encoding == headers_.end() ||
+            !boost::iequals(encoding->second, "gzip"))
+        {
+          CLOG(INFO, HTTP) << "Streaming the content of a ZIP archive received through HTTP";
+          storer_.reset(new ZipArchiveStorer(answer_, api_.context_,
+                                             DicomInstanceOrigin::FromHttp(remoteIp_.c_str(), username_.c_str())));
+          zip_.reset(new ZipStreamReader(*this));
+
+          std::string received;
+          received.swap(body_);
+          zip_->AddChunk(received);
+        }
+      }
+    }
+
+    virtual void Execute(HttpOutput& output) ORTHANC_OVERRIDE
+    {
+      if (zip_.get() != NULL)
+      {
+        zip_->CloseStream();
+
+        assert(storer_.get() != NULL);
+        storer_->Finish();
+
+        RestApiOutput restOutput(output, HttpMethod_Post);
+        restOutput.AnswerJson(answer_);
+      }
+      else if (!api_.Handle(output, RequestOrigin_RestApi, remoteIp_.c_str(), username_.c_str(), HttpMethod_Post, uri_,
+                            headers_, HttpToolbox::GetArguments(), body_.empty() ? NULL : body_.c_str(), body_.size(),
+                            authenticationPayload_))
+      {
+        throw OrthancException(ErrorCode_UnknownResource);
+      }
+    }
+  };
+
+
+  bool OrthancRestApi::CreateChunkedRequestReader(std::unique_ptr<IChunkedRequestReader>& target,
+                                                  RequestOrigin origin,
+                                                  const char* remoteIp,
+                                                  const char* username,
+                                                  HttpMethod method,
+                                                  const UriComponents& uri,
+                                                  const HttpToolbox::Arguments& headers,
+                                                  const std::string& authenticationPayload)
+  {
+    if (origin == RequestOrigin_RestApi &&
+        method == HttpMethod_Post &&
+        uri.size() == 1 &&
+        uri[0] == "instances" &&
+        !context_.IsReadOnly())
+    {
+      target.reset(new UploadDicomFileReader(*this, remoteIp, username, uri, headers, authenticationPayload));
+      return true;
+    }
+    else
+    {
+      return RestApi::CreateChunkedRequestReader(target, origin, remoteIp, username, method, uri, headers, authenticationPayload);
+    }
+  }
+
+
   static void UploadDicomFile(RestApiPostCall& call)
   {
     if (call.GetRequestOrigin() == RequestOrigin_Documentation)
@@ -177,49 +494,18 @@ namespace Orthanc
       std::unique_ptr<ZipReader> reader(ZipReader::CreateFromMemory(call.GetBodyData(), call.GetBodySize()));
 
       Json::Value answer = Json::arrayValue;
-      
-      std::string filename, content;
-      while (reader->ReadNextFile(filename, content))
-      {
-        if (!content.empty())
-        {
-          LOG(INFO) << "Uploading DICOM file from ZIP archive: " << filename;
-
-          std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromBuffer(content));
-          toStore->SetOrigin(DicomInstanceOrigin::FromRest(call));
 
-          try
-          {
-            std::string publicId;
-
-            ServerContext::StoreResult result = context.Store(publicId, *toStore);
+      {
+        ZipArchiveStorer storer(answer, context, DicomInstanceOrigin::FromRest(call));
 
-            Json::Value info;
-            SetupResourceAnswer(info, *toStore, result.GetStatus(), publicId);
-            answer.append(info);
-          }
-          catch (OrthancException& e)
-          {
-            if (e.GetErrorCode() == ErrorCode_BadFileFormat)
-            {
-              LOG(ERROR) << "Cannot import non-DICOM file from ZIP archive: " << filename;
-            }
-            else if (e.GetErrorCode() == ErrorCode_InexistentTag)
-            {
-              /**
-               * Allow upload of ZIP archives containing a DICOMDIR
-               * file (new in Orthanc 1.9.7):
-               * https://groups.google.com/g/orthanc-users/c/sgBU89o4nhU/m/kbRAYiQUAAAJ
-               **/
-              LOG(ERROR) << "Ignoring what is probably a DICOMDIR file within a ZIP archive: \"" << filename << "\"";
-            }
-            else
-            {
-              throw;
-            }
-          }
+        std::string filename, content;
+        while (reader->ReadNextFile(filename, content))
+        {
+          storer.Store(filename, content);
         }
-      }      
+
+        storer.Finish();
+      }
 
       call.GetOutput().AnswerJson(answer);
     }
@@ -253,6 +539,258 @@ namespace Orthanc
 
 
 
+  // Lanes of HTTP threads (new in Orthanc 1.12.12) -----------------------------
+
+  class OrthancRestApi::HttpLanes : public boost::noncopyable
+  {
+  private:
+    boost::mutex                    mutex_;
+    boost::condition_variable       available_;
+    unsigned int                    maxConcurrent_;
+    unsigned int                    maxQueueSize_;
+    unsigned int                    running_;
+    unsigned int                    waiting_;
+    MetricsRegistry::SharedMetrics  availableInteractive_;
+    MetricsRegistry::SharedMetrics  availableHeavy_;
+
+  public:
+    HttpLanes(MetricsRegistry& registry,
+              unsigned int httpThreadsCount,
+              unsigned int maxConcurrent,
+              unsigned int maxQueueSize) :
+      maxConcurrent_(maxConcurrent),
+      maxQueueSize_(maxQueueSize),
+      running_(0),
+      waiting_(0),
+      availableInteractive_(registry, "orthanc_available_http_threads_count{lane=\"interactive\"}",
+                            MetricsUpdatePolicy_MinOver10Seconds),
+      availableHeavy_(registry, "orthanc_available_http_threads_count{lane=\"heavy\"}",
+                      MetricsUpdatePolicy_MinOver10Seconds)
+    {
+      availableInteractive_.SetInitialValue(httpThreadsCount);
+      availableHeavy_.SetInitialValue(maxConcurrent == 0 ? httpThreadsCount : maxConcurrent);
+    }
+
+    MetricsRegistry::SharedMetrics& GetAvailableInteractiveMetrics()
+    {
+      return availableInteractive_;
+    }
+
+    class HeavyLocker : public boost::noncopyable
+    {
+    private:
+      HttpLanes&  that_;
+      std::unique_ptr<MetricsRegistry::AvailableResourcesDecounter>  decounter_;
+
+    public:
+      explicit HeavyLocker(HttpLanes& that) :
+        that_(that)
+      {
+        if (that_.maxConcurrent_ != 0)
+        {
+          boost::mutex::scoped_lock lock(that_.mutex_);
+
+          if (that_.running_ >= that_.maxConcurrent_)
+          {
+            if (that_.waiting_ >= that_.maxQueueSize_)
+            {
+              // Bounded queue: Reject the request instead of blocking one more HTTP thread
+              throw OrthancException(ErrorCode_Timeout, "Too many concurrent requests to heavy routes, retry later")
+                .SetHttpStatus(HttpStatus_503_ServiceUnavailable);
+            }
+
+            that_.waiting_++;
+
+            while (that_.running_ >= that_.maxConcurrent_)
+            {
+              that_.available_.wait(lock);
+            }
+
+            that_.waiting_--;
+          }
+
+          that_.running_++;
+        }
+
+        decounter_.reset(new MetricsRegistry::AvailableResourcesDecounter(that_.availableHeavy_));
+      }
+
+      ~HeavyLocker()
+      {
+        decounter_.reset();
+
+        if (that_.maxConcurrent_ != 0)
+        {
+          boost::mutex::scoped_lock lock(that_.mutex_);
+          assert(that_.running_ > 0);
+          that_.running_--;
+          that_.available_.notify_one();
+        }
+      }
+    };
+  };
+
+
+  bool OrthancRestApi::IsHeavyRoute(HttpMethod method,
+                                    const UriComponents& uri)
+  {
+    if (method == HttpMethod_Get &&
+        uri.size() == 3 &&
+        (uri[0] == "patients" ||
+         uri[0] == "studies" ||
+         uri[0] == "series") &&
+        (uri[2] == "archive" ||
+         uri[2] == "media"))
+    {
+      return true;  // Synchronous download of ZIP archives
+    }
+    else if (method == HttpMethod_Get &&
+             uri.size() == 3 &&
+             (uri[0] == "series" ||
+              uri[0] == "instances") &&
+             uri[2] == "numpy")
+    {
+      return true;
+    }
+    else if (method == HttpMethod_Post &&
+             uri.size() == 2 &&
+             uri[0] == "tools" &&
+             (uri[1] == "create-archive" ||
+              uri[1] == "create-media" ||
+              uri[1] == "create-media-extended"))
+    {
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  void OrthancRestApi::SetHeavyRoutesLimits(unsigned int httpThreadsCount,
+                                            unsigned int maxConcurrent,
+                                            unsigned int maxQueueSize)
+  {
+    if (maxConcurrent != 0 &&
+        maxConcurrent + maxQueueSize >= httpThreadsCount)
+    {
+      LOG(WARNING) << "The heavy HTTP routes can use all the " << httpThreadsCount << " HTTP threads, "
+                   << "consider decreasing \"HttpHeavyRoutesThreadsCount\" or \"HttpHeavyRoutesQueueSize\"";
+    }
+
+    lanes_.reset(new HttpLanes(context_.GetMetricsRegistry(), httpThreadsCount, maxConcurrent, maxQueueSize));
+  }
+
+
+
+  // Per-route metrics and slow requests (new in Orthanc 1.12.12) ---------------
+
+  // Upper bounds of the buckets of the histogram of the sizes (the
+  // durations use "MetricsRegistry::GetDefaultDurationBuckets()")
+  static const size_t  SIZE_BUCKETS_COUNT = 8;
+  static const double  SIZE_BUCKETS[SIZE_BUCKETS_COUNT] = {  // In bytes
+    1024, 10240, 102400, 1048576, 10485760, 104857600, 1073741824, 10737418240.0
+  };
+
+  class OrthancRestApi::RequestMonitor : public boost::noncopyable
+  {
+  private:
+    MetricsRegistry&       registry_;
+    const HttpOutput&      output_;
+    HttpMethod             method_;
+    const UriComponents&   uri_;
+    unsigned int           slowThreshold_;
+    ElapsedTimer           timer_;
+    std::string            route_;
+
+    // The accounting is shared with the enclosing HTTP request, if
+    // any (cf. "OrthancHttpHandler"). Otherwise, e.g. for the calls
+    // from Lua, the monitor installs its own accounting.
+    std::unique_ptr<RequestTimings::Scope>  ownTimings_;
+
+    void Record()
+    {
+      const double milliseconds = static_cast<double>(timer_.GetElapsedMicroseconds()) / 1000.0;
+      const uint64_t size = output_.GetSentBodySize();
+
+      // The URIs that are not served by a route are not recorded, in
+      // order to bound the cardinality of the labels
+      if (!route_.empty())
+      {
+        const std::string labels = (MetricsRegistry::FormatPrometheusLabel("method", EnumerationToString(method_)) + "," +
+                                    MetricsRegistry::FormatPrometheusLabel("route", route_));
+
+        registry_.AddHistogramSample("orthanc_http_request_duration_ms", labels,
+                                     MetricsRegistry::GetDefaultDurationBuckets(), milliseconds);
+        registry_.AddHistogramSample("orthanc_http_response_size_bytes", labels,
+                                     SIZE_BUCKETS, SIZE_BUCKETS_COUNT, static_cast<double>(size));
+
+        Tracing::SetCurrentAttribute("http.route", route_);
+      }
+
+      const RequestTimings::Scope* timings = RequestTimings::GetCurrentScope();
+
+      if (slowThreshold_ != 0 &&
+          milliseconds >= static_cast<double>(slowThreshold_) &&
+          timings != NULL)
+      {
+        LOG(WARNING) << "Slow HTTP request (" << static_cast<uint64_t>(milliseconds) << "ms): "
+                     << EnumerationToString(method_) << " " << Toolbox::FlattenUri(uri_)
+                     << (route_.empty() ? "" : " (route " + route_ + ")")
+                     << ", " << timings->Format() << ", " << size << " bytes sent";
+      }
+    }
+
+  public:
+    RequestMonitor(MetricsRegistry& registry,
+                   const HttpOutput& output,
+                   HttpMethod method,
+                   const UriComponents& uri,
+                   unsigned int slowThreshold) :
+      registry_(registry),
+      output_(output),
+      method_(method),
+      uri_(uri),
+      slowThreshold_(slowThreshold)
+    {
+      if (RequestTimings::GetCurrentScope() == NULL)
+      {
+        ownTimings_.reset(new RequestTimings::Scope);
+      }
+    }
+
+    ~RequestMonitor()
+    {
+      try
+      {
+        Record();
+      }
+      catch (OrthancException&)  //NOLINT(bugprone-empty-catch)
+      {
+        // Never throw from a destructor
+      }
+    }
+
+    std::string& GetRoute()
+    {
+      return route_;
+    }
+  };
+
+
+  void OrthancRestApi::SetSlowRequestsThreshold(unsigned int milliseconds)
+  {
+    slowRequestsThreshold_ = milliseconds;
+
+    if (milliseconds != 0)
+    {
+      LOG(INFO) << "The HTTP requests lasting more than " << milliseconds << "ms will be logged";
+    }
+  }
+
+
+
   // Registration of the various REST handlers --------------------------------
 
   OrthancRestApi::OrthancRestApi(ServerContext& context, 
@@ -262,7 +800,8 @@ namespace Orthanc
     resetRequestReceived_(false),
     activeRequests_(context.GetMetricsRegistry(), 
                     "orthanc_rest_api_active_requests", 
-                    MetricsUpdatePolicy_MaxOver10Seconds)
+                    MetricsUpdatePolicy_MaxOver10Seconds),
+    slowRequestsThreshold_(0)
   {
     RegisterSystem(orthancExplorerEnabled);
 
@@ -302,11 +841,33 @@ namespace Orthanc
                               size_t bodySize,
                               const std::string& authenticationPayload)
   {
+    // The monitor is created first, so that the waiting time in the
+    // lanes is part of the recorded duration
+    RequestMonitor monitor(context_.GetMetricsRegistry(), output, method, uri, slowRequestsThreshold_);
+
     MetricsRegistry::Timer timer(context_.GetMetricsRegistry(), "orthanc_rest_api_duration_ms");
     MetricsRegistry::ActiveCounter counter(activeRequests_);
 
-    return RestApi::Handle(output, origin, remoteIp, username, method,
-                           uri, headers, getArguments, bodyData, bodySize, authenticationPayload);
+    // Only the requests coming from the HTTP server are dispatched
+    // between the lanes, as they are the ones holding HTTP threads
+    std::unique_ptr<HttpLanes::HeavyLocker> heavy;
+    std::unique_ptr<MetricsRegistry::AvailableResourcesDecounter> interactive;
+
+    if (lanes_.get() != NULL &&
+        origin == RequestOrigin_RestApi)
+    {
+      if (IsHeavyRoute(method, uri))
+      {
+        heavy.reset(new HttpLanes::HeavyLocker(*lanes_));
+      }
+      else
+      {
+        interactive.reset(new MetricsRegistry::AvailableResourcesDecounter(lanes_->GetAvailableInteractiveMetrics()));
+      }
+    }
+
+    return HandleAndGetRoute(monitor.GetRoute(), output, origin, remoteIp, username, method,
+                             uri, headers, getArguments, bodyData, bodySize, authenticationPayload);
   }
 
 
@@ -323,6 +884,131 @@ namespace Orthanc
 
 
 
+  // Synchronous jobs (new in Orthanc 1.12.12) ---------------------------------
+
+  /**
+   * Bounds the number of HTTP threads that wait for the completion of
+   * synchronous jobs, and the duration of this wait. Past these
+   * limits, the job runs in the background and the client gets "202
+   * Accepted" with the path to the job, as if it had been submitted
+   * in asynchronous mode. Slow remote modalities or peers can thus
+   * not exhaust the HTTP threads.
+   **/
+  class OrthancRestApi::SynchronousJobs : public boost::noncopyable
+  {
+  private:
+    boost::mutex  mutex_;
+    unsigned int  timeout_;
+    unsigned int  maxWaiting_;
+    unsigned int  waiting_;
+
+    static void AnswerAccepted(RestApiOutput& output,
+                               const std::string& id)
+    {
+      Json::Value v;
+      v["ID"] = id;
+      v["Path"] = "/jobs/" + id;
+      output.AnswerJson(v, HttpStatus_202_Accepted);
+    }
+
+    class Waiter : public boost::noncopyable
+    {
+    private:
+      SynchronousJobs&  that_;
+      bool              isAccepted_;
+
+    public:
+      explicit Waiter(SynchronousJobs& that) :
+        that_(that)
+      {
+        boost::mutex::scoped_lock lock(that_.mutex_);
+
+        isAccepted_ = (that_.maxWaiting_ == 0 ||
+                       that_.waiting_ < that_.maxWaiting_);
+
+        if (isAccepted_)
+        {
+          that_.waiting_++;
+        }
+      }
+
+      ~Waiter()
+      {
+        if (isAccepted_)
+        {
+          boost::mutex::scoped_lock lock(that_.mutex_);
+          assert(that_.waiting_ > 0);
+          that_.waiting_--;
+        }
+      }
+
+      bool IsAccepted() const
+      {
+        return isAccepted_;
+      }
+    };
+
+  public:
+    SynchronousJobs(unsigned int timeout,
+                    unsigned int maxWaiting) :
+      timeout_(timeout),
+      maxWaiting_(maxWaiting),
+      waiting_(0)
+    {
+    }
+
+    void Submit(RestApiOutput& output,
+                ServerContext& context,
+                IJob* job,
+                int priority)
+    {
+      std::unique_ptr<IJob> raii(job);
+
+      Waiter waiter(*this);
+
+      std::string id;
+
+      if (!waiter.IsAccepted())
+      {
+        context.GetJobsEngine().GetRegistry().Submit(id, raii.release(), priority);
+        LOG(INFO) << "Too many HTTP threads are waiting for synchronous jobs, running job " << id << " in the background";
+        AnswerAccepted(output, id);
+      }
+      else
+      {
+        Json::Value successContent;
+        if (context.GetJobsEngine().GetRegistry().SubmitAndWait(successContent, id, raii.release(),
+                                                                 priority, timeout_ * 1000))
+        {
+          output.AnswerJson(successContent);
+        }
+        else
+        {
+          LOG(INFO) << "Synchronous job " << id << " has not completed after " << timeout_
+                    << " seconds, it keeps running in the background";
+          AnswerAccepted(output, id);
+        }
+      }
+    }
+  };
+
+
+  void OrthancRestApi::SetSynchronousJobsLimits(unsigned int timeout,
+                                                unsigned int maxWaiting)
+  {
+    if (timeout == 0 &&
+        maxWaiting == 0)
+    {
+      synchronousJobs_.reset();
+    }
+    else
+    {
+      synchronousJobs_.reset(new SynchronousJobs(timeout, maxWaiting));
+    }
+  }
+
+
+
   static const char* KEY_PERMISSIVE = "Permissive";
   static const char* KEY_PRIORITY = "Priority";
   static const char* KEY_SYNCHRONOUS = "Synchronous";
@@ -392,8 +1078,11 @@ namespace Orthanc
     {
       // Asynchronous mode: Submit the job, but don't wait for its completion
       std::string id;
-      context.GetJobsEngine().GetRegistry().Submit
-        (id, raii.release(), priority);
+      if (!context.SubmitSharedJob(id, *raii, priority))
+      {
+        context.GetJobsEngine().GetRegistry().Submit
+          (id, raii.release(), priority);
+      }
 
       Json::Value v;
       v["ID"] = id;
@@ -418,7 +1107,16 @@ namespace Orthanc
     bool synchronous = IsSynchronousJobRequest(isDefaultSynchronous, body);
     int priority = GetJobRequestPriority(body);
 
-    SubmitGenericJob(call.GetOutput(), context_, raii.release(), synchronous, priority);
+    if (synchronous &&
+        synchronousJobs_.get() != NULL &&
+        call.GetRequestOrigin() == RequestOrigin_RestApi)
+    {
+      synchronousJobs_->Submit(call.GetOutput(), context_, raii.release(), priority);
+    }
+    else
+    {
+      SubmitGenericJob(call.GetOutput(), context_, raii.release(), synchronous, priority);
+    }
   }
 
   
@@ -28,6 +28,7 @@
 #include "../../../OrthancFramework/Sources/RestApi/RestApi.h"
 #include "../ServerEnumerations.h"
 
+#include <boost/shared_ptr.hpp>
 #include <set>
 
 namespace Orthanc
@@ -43,10 +44,18 @@ namespace Orthanc
     typedef std::set<std::string> SetOfStrings;
 
   private:
+    class UploadDicomFileReader;
+    class HttpLanes;
+    class RequestMonitor;
+    class SynchronousJobs;
+
     ServerContext&                  context_;
     bool                            leaveBarrier_;
     bool                            resetRequestReceived_;
     MetricsRegistry::SharedMetrics  activeRequests_;
+    boost::shared_ptr<HttpLanes>    lanes_;  // New in Orthanc 1.12.12
+    unsigned int                    slowRequestsThreshold_;  // New in Orthanc 1.12.12
+    boost::shared_ptr<SynchronousJobs>  synchronousJobs_;    // New in Orthanc 1.12.12
 
     void RegisterSystem(bool orthancExplorerEnabled);
 
@@ -68,6 +77,15 @@ namespace Orthanc
     explicit OrthancRestApi(ServerContext& context,
                             bool orthancExplorerEnabled);
 
+    virtual bool CreateChunkedRequestReader(std::unique_ptr<IChunkedRequestReader>& target,
+                                            RequestOrigin origin,
+                                            const char* remoteIp,
+                                            const char* username,
+                                            HttpMethod method,
+                                            const UriComponents& uri,
+                                            const HttpToolbox::Arguments& headers,
+                                            const std::string& authenticationPayload) ORTHANC_OVERRIDE;
+
     virtual bool Handle(HttpOutput& output,
                         RequestOrigin origin,
                         const char* remoteIp,
@@ -80,6 +98,34 @@ namespace Orthanc
                         size_t bodySize,
                         const std::string& authenticationPayload) ORTHANC_OVERRIDE;
 
+    /**
+     * Limit the number of HTTP threads that can be used by the heavy
+     * routes (archives, media, numpy exports), so that they cannot
+     * delay the interactive routes. "maxConcurrent == 0" means no
+     * limit. Must be called before the HTTP server is started.
+     **/
+    void SetHeavyRoutesLimits(unsigned int httpThreadsCount,
+                              unsigned int maxConcurrent,
+                              unsigned int maxQueueSize);
+
+    static bool IsHeavyRoute(HttpMethod method,
+                             const UriComponents& uri);
+
+    // Log a warning with the breakdown of the time spent in the
+    // database, storage and codecs for each REST call lasting more
+    // than the given duration ("0" means disabled)
+    void SetSlowRequestsThreshold(unsigned int milliseconds);
+
+    /**
+     * Answer "202 Accepted" with the path to the job, instead of the
+     * result of the job, if a synchronous job has not completed after
+     * "timeout" seconds, or if "maxWaiting" HTTP threads are already
+     * waiting for synchronous jobs ("0" means no limit). The job
+     * keeps running in the background.
+     **/
+    void SetSynchronousJobsLimits(unsigned int timeout,
+                                  unsigned int maxWaiting);
+
     const bool& LeaveBarrierFlag() const
     {
       return leaveBarrier_;
@@ -24,7 +24,9 @@
 #include "../PrecompiledHeadersServer.h"
 #include "OrthancRestApi.h"
 
+#include "../../../OrthancFramework/Sources/Compression/StoredZipLayout.h"
 #include "../../../OrthancFramework/Sources/Compression/ZipWriter.h"
+#include "../../../OrthancFramework/Sources/HttpServer/HttpToolbox.h"
 #include "../../../OrthancFramework/Sources/HttpServer/FilesystemHttpSender.h"
 #include "../../../OrthancFramework/Sources/Logging.h"
 #include "../../../OrthancFramework/Sources/OrthancException.h"
@@ -46,13 +48,78 @@ namespace Orthanc
   static const char* const KEY_FILENAME = "Filename";
   static const char* const KEY_USER_DATA = "UserData";
   static const char* const KEY_ALLOW_UTF8 = "Utf8";
+  static const char* const KEY_COMPRESSION_THREADS = "CompressionThreads";
+  static const char* const KEY_FORMAT = "Format";
 
   static const char* const GET_TRANSCODE = "transcode";
   static const char* const GET_LOSSY_QUALITY = "lossy-quality";
   static const char* const GET_FILENAME = "filename";
   static const char* const GET_RESOURCES = "resources";
+  static const char* const GET_RESUMABLE = "resumable";
+  static const char* const GET_FORMAT = "format";
 
   static const char* const CONFIG_ALLOW_UTF8 = "ZipUseUtf8";
+  static const char* const CONFIG_COMPRESSION_THREADS = "ZipCompressionThreads";
+  static const char* const CONFIG_DICOMDIR_FROM_INDEX = "MediaDicomDirFromIndex";
+  static const char* const CONFIG_LOCALITY_WINDOW = "ZipLoaderLocalityWindow";
+  static const char* const CONFIG_LOADER_MEMORY_BUDGET = "ZipLoaderMemoryBudget";
+
+  // Pseudo job identifier under which the archives are stored in the
+  // "JobOutputsStore" that caches the synchronous archives
+  static const char* const ARCHIVES_CACHE_ID = "archives-cache";
+
+
+  // New in Orthanc 1.12.12
+  static unsigned int GetCompressionThreads(const Json::Value& body)
+  {
+    unsigned int threads;
+
+    if (body.type() == Json::objectValue &&
+        body.isMember(KEY_COMPRESSION_THREADS))
+    {
+      threads = SerializationToolbox::ReadUnsignedInteger(body, KEY_COMPRESSION_THREADS);
+    }
+    else
+    {
+      OrthancConfiguration::ReaderLock lock;
+      threads = lock.GetConfiguration().GetUnsignedIntegerParameter(CONFIG_COMPRESSION_THREADS);
+    }
+
+    return std::max(1u, threads);
+  }
+
+
+  // New in Orthanc 1.12.12
+  static bool IsTarFormat(const std::string& format)
+  {
+    if (format == "zip")
+    {
+      return false;
+    }
+    else if (format == "tar")
+    {
+      return true;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "Unknown format for an archive (must be \"zip\" or \"tar\"): " + format);
+    }
+  }
+
+
+  static bool IsTarFormat(const Json::Value& body)
+  {
+    if (body.type() == Json::objectValue &&
+        body.isMember(KEY_FORMAT))
+    {
+      return IsTarFormat(SerializationToolbox::ReadString(body, KEY_FORMAT));
+    }
+    else
+    {
+      return false;
+    }
+  }
 
 
   static void AddResourcesOfInterestFromString(ArchiveJob& job,
@@ -294,6 +361,7 @@ namespace Orthanc
       std::string                            jobId_;
       boost::shared_ptr<SharedMessageQueue>  queue_;
       std::string                            filename_;
+      MimeType                               mime_;
       bool                                   done_;
       std::string                            chunk_;
 
@@ -301,11 +369,13 @@ namespace Orthanc
       SynchronousZipSender(ServerContext& context,
                            const std::string& jobId,
                            const boost::shared_ptr<SharedMessageQueue>& queue,
-                           const std::string& filename) :
+                           const std::string& filename,
+                           MimeType mime) :
         context_(context),
         jobId_(jobId),
         queue_(queue),
         filename_(filename),
+        mime_(mime),
         done_(false)
       {
       }
@@ -325,7 +395,7 @@ namespace Orthanc
 
       virtual std::string GetContentType() ORTHANC_OVERRIDE
       {
-        return EnumerationToString(MimeType_Zip);
+        return EnumerationToString(mime_);
       }
 
       virtual uint64_t GetContentLength() ORTHANC_OVERRIDE
@@ -333,6 +403,11 @@ namespace Orthanc
         THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
       }
 
+      virtual bool LookupLocalFile(std::string& path) ORTHANC_OVERRIDE
+      {
+        return false;
+      }
+
       virtual bool ReadNextChunk() ORTHANC_OVERRIDE
       {
         for (;;)
@@ -418,6 +493,17 @@ namespace Orthanc
           throw OrthancException(ErrorCode_CannotWriteFile);
         }
       }
+
+      // The caller is responsible for keeping the file alive
+      explicit SynchronousTemporaryStream(const boost::filesystem::path& path) :
+        archiveSize_(0)
+      {
+        file_.open(path, std::ofstream::out | std::ofstream::binary);
+        if (!file_.good())
+        {
+          throw OrthancException(ErrorCode_CannotWriteFile);
+        }
+      }
       
       virtual uint64_t GetArchiveSize() const ORTHANC_OVERRIDE
       {
@@ -474,6 +560,195 @@ namespace Orthanc
     };
   }
 
+
+  namespace
+  {
+    // New in Orthanc 1.12.12
+    class ResumableArchiveSender : public IHttpStreamAnswer, private StoredZipLayout::IEntrySource
+    {
+    private:
+      ServerContext&                context_;
+      StoredZipLayout&              layout_;
+      const std::vector<FileInfo>&  attachments_;
+      std::string                   filename_;
+      uint64_t                      start_;
+      uint64_t                      position_;
+      uint64_t                      end_;   // Exclusive
+      std::string                   chunk_;
+
+      virtual void ReadEntry(std::string& content,
+                             size_t index) ORTHANC_OVERRIDE
+      {
+        context_.ReadAttachmentWithoutCacheAdmission(content, attachments_[index]);
+      }
+
+      virtual void HandleCrc32(size_t index,
+                               uint32_t crc32) ORTHANC_OVERRIDE
+      {
+        context_.StoreArchiveCrc32(attachments_[index].GetUuid(), crc32);
+      }
+
+    public:
+      ResumableArchiveSender(ServerContext& context,
+                             StoredZipLayout& layout,
+                             const std::vector<FileInfo>& attachments,
+                             const std::string& filename) :
+        context_(context),
+        layout_(layout),
+        attachments_(attachments),
+        filename_(filename),
+        start_(0),
+        position_(0),
+        end_(layout.GetArchiveSize())
+      {
+        assert(attachments.size() == layout.GetEntriesCount());
+      }
+
+      // "end" is inclusive, as in "HttpToolbox::ParseByteRange()"
+      void SetRange(uint64_t start,
+                    uint64_t end)
+      {
+        if (start > end ||
+            end >= layout_.GetArchiveSize())
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        start_ = start;
+        position_ = start;
+        end_ = end + 1;
+      }
+
+      virtual HttpCompression SetupHttpCompression(bool gzipAllowed,
+                                                   bool deflateAllowed) ORTHANC_OVERRIDE
+      {
+        return HttpCompression_None;
+      }
+
+      virtual bool HasContentFilename(std::string& filename) ORTHANC_OVERRIDE
+      {
+        filename = filename_;
+        return true;
+      }
+
+      virtual std::string GetContentType() ORTHANC_OVERRIDE
+      {
+        return EnumerationToString(MimeType_Zip);
+      }
+
+      virtual uint64_t GetContentLength() ORTHANC_OVERRIDE
+      {
+        return end_ - start_;
+      }
+
+      virtual bool ReadNextChunk() ORTHANC_OVERRIDE
+      {
+        if (position_ >= end_)
+        {
+          return false;
+        }
+        else
+        {
+          layout_.ReadChunk(chunk_, position_, end_, *this);
+          position_ += chunk_.size();
+          return true;
+        }
+      }
+
+      virtual const char* GetChunkContent() ORTHANC_OVERRIDE
+      {
+        return chunk_.c_str();
+      }
+
+      virtual size_t GetChunkSize() ORTHANC_OVERRIDE
+      {
+        return chunk_.size();
+      }
+
+      virtual bool LookupLocalFile(std::string& path) ORTHANC_OVERRIDE
+      {
+        return false;
+      }
+    };
+  }
+
+
+  /**
+   * Serves an archive whose files are stored uncompressed, and whose
+   * layout is computed from the index before sending any byte. This
+   * allows to advertise the "Content-Length" and to serve the "Range"
+   * requests, in order to resume the interrupted downloads. The bytes
+   * of the archive only depend on the content of the resource
+   * (including its last update time), which is summarized in the
+   * "ETag" HTTP header (new in Orthanc 1.12.12).
+   **/
+  static void ServeResumableArchive(RestApiGetCall& call,
+                                    ArchiveJob& job,
+                                    ResourceType level,
+                                    const std::string& publicId,
+                                    const std::string& filename)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    StoredZipLayout layout;
+    std::vector<FileInfo> attachments;
+    job.ComputeStoredLayout(layout, attachments);
+
+    std::string time;
+    if (context.GetIndex().LookupMetadata(time, publicId, level, (level == ResourceType_Instance ?
+                                                                  MetadataType_Instance_ReceptionDate :
+                                                                  MetadataType_LastUpdate)))
+    {
+      try
+      {
+        layout.SetTimestamp(boost::posix_time::from_iso_string(time));
+      }
+      catch (std::exception&)
+      {
+        // Keep the default timestamp
+      }
+    }
+
+    std::string summary = time;
+
+    for (size_t i = 0; i < attachments.size(); i++)
+    {
+      uint32_t crc32;
+      if (context.LookupArchiveCrc32(crc32, attachments[i].GetUuid()))
+      {
+        layout.SetCrc32(i, crc32);
+      }
+
+      summary += "|" + layout.GetEntryFilename(i) + "|" + attachments[i].GetUuid();
+    }
+
+    std::string etag;
+    Toolbox::ComputeMD5(etag, summary);
+    etag = "\"" + etag + "\"";
+
+    ResumableArchiveSender sender(context, layout, attachments, filename);
+
+    HttpOutput& output = call.GetOutput().GetLowLevelOutput();
+    output.AddHeader("Accept-Ranges", "bytes");
+    output.AddHeader("ETag", etag);
+
+    const std::string ifRange = call.GetHttpHeader("if-range", "");
+
+    uint64_t start, end;
+    if ((ifRange.empty() || ifRange == etag) &&
+        HttpToolbox::ParseByteRange(start, end, call.GetHttpHeader("range", ""), layout.GetArchiveSize()))
+    {
+      LOG(INFO) << "Serving bytes " << start << "-" << end << " of a resumable ZIP archive";
+      sender.SetRange(start, end);
+      call.GetOutput().AnswerPartialContent(sender, start, layout.GetArchiveSize());
+    }
+    else
+    {
+      LOG(INFO) << "Serving a resumable ZIP archive of " << layout.GetArchiveSize() << " bytes";
+      call.GetOutput().AnswerStream(sender);
+    }
+  }
+
   
   static void SubmitJob(RestApiOutput& output,
                         ServerContext& context,
@@ -489,8 +764,55 @@ namespace Orthanc
 
     job->SetDescription("REST API");
 
+    {
+      OrthancConfiguration::ReaderLock lock;
+      job->SetDicomDirFromIndex(lock.GetConfiguration().GetBooleanParameter(CONFIG_DICOMDIR_FROM_INDEX));  // New in Orthanc 1.12.12
+      job->SetLocalityWindow(lock.GetConfiguration().GetUnsignedIntegerParameter(CONFIG_LOCALITY_WINDOW));  // New in Orthanc 1.12.12
+      job->SetLoaderMemoryBudget(static_cast<uint64_t>(lock.GetConfiguration().GetUnsignedIntegerParameter(CONFIG_LOADER_MEMORY_BUDGET)) * 1024 * 1024);  // New in Orthanc 1.12.12
+    }
+
+    const MimeType mime = job->GetMimeType();
+
     if (synchronous)
     {
+      JobOutputsStore* cache = context.GetArchivesCache();
+
+      if (cache != NULL)
+      {
+        std::string key;
+        job->ComputeCacheKey(key);
+
+        {
+          JobOutputsStore::Accessor accessor(*cache, ARCHIVES_CACHE_ID, key);
+          if (accessor.IsValid())
+          {
+            LOG(INFO) << "Serving a ZIP archive from the cache of the archives";
+            FilesystemHttpSender sender(accessor.GetFile().GetPath(), mime);
+            sender.SetContentFilename(filename);
+            output.AnswerStream(sender);
+            return;
+          }
+        }
+
+        LOG(INFO) << "Generating a ZIP archive into the cache of the archives";
+        std::unique_ptr<TemporaryFile> tmp(cache->CreateSpoolFile());
+
+        job->AcquireSynchronousTarget(new SynchronousTemporaryStream(tmp->GetPath()));
+
+        Json::Value publicContent;
+        context.GetJobsEngine().GetRegistry().SubmitAndWait
+          (publicContent, job.release(), priority);
+
+        {
+          FilesystemHttpSender sender(tmp->GetPath(), mime);
+          sender.SetContentFilename(filename);
+          output.AnswerStream(sender);
+        }
+
+        cache->Add(ARCHIVES_CACHE_ID, key, tmp.release(), mime, filename);
+        return;
+      }
+
       bool streaming;
       
       {
@@ -508,7 +830,7 @@ namespace Orthanc
         std::string jobId;
         context.GetJobsEngine().GetRegistry().Submit(jobId, job.release(), priority);
 
-        SynchronousZipSender sender(context, jobId, queue, filename);
+        SynchronousZipSender sender(context, jobId, queue, filename, mime);
         output.AnswerWithoutBuffering(sender);
 
         // If we reach this line, this means that
@@ -533,7 +855,7 @@ namespace Orthanc
       
         {
           // The archive is now created: Prepare the sending of the ZIP file
-          FilesystemHttpSender sender(tmp->GetPath(), MimeType_Zip);
+          FilesystemHttpSender sender(tmp->GetPath(), mime);
           sender.SetContentFilename(filename);
 
           // Send the ZIP
@@ -581,7 +903,16 @@ namespace Orthanc
                        "ZIP uncompression software. If `false`, filenames will be encoded using plain ASCII, which was "
                        "the default in Orthanc <= 1.12.10. Default value is defined by the \"" +
                        std::string(CONFIG_ALLOW_UTF8) + "\" configuration option. (new in 1.12.11)", false)
+      .SetRequestField(KEY_COMPRESSION_THREADS, RestApiCallDocumentation::Type_Number,
+                       "Number of threads that compress the files of the ZIP archive in parallel. Default value is "
+                       "defined by the \"" + std::string(CONFIG_COMPRESSION_THREADS) + "\" configuration option. "
+                       "(new in 1.12.12)", false)
+      .SetRequestField(KEY_FORMAT, RestApiCallDocumentation::Type_String,
+                       "Format of the archive: `zip` (default) or `tar`. A TAR archive is uncompressed and has "
+                       "no central directory, which makes it faster to generate and to stream to another "
+                       "computer. (new in 1.12.12)", false)
       .AddAnswerType(MimeType_Zip, "In synchronous mode, the ZIP file containing the archive")
+      .AddAnswerType(MimeType_Tar, "In synchronous mode, the TAR file containing the archive, if `Format` is `tar`")
       .AddAnswerType(MimeType_Json, "In asynchronous mode, information about the job that has been submitted to "
                      "generate the archive: https://orthanc.uclouvain.be/book/users/advanced-rest.html#jobs")
       .SetAnswerField("ID", RestApiCallDocumentation::Type_String, "Identifier of the job")
@@ -636,12 +967,15 @@ namespace Orthanc
       Json::Value userData;
       bool allowUtf8;
 
+      const bool tar = IsTarFormat(body);  // New in Orthanc 1.12.12
+
       GetJobParameters(synchronous, extended, transcode, transferSyntax, lossyQuality,
                        priority, loaderThreads, filename, userData, allowUtf8,
-                       body, DEFAULT_IS_EXTENDED, "Archive.zip", defaultUtf8);
+                       body, DEFAULT_IS_EXTENDED, (tar ? "Archive.tar" : "Archive.zip"), defaultUtf8);
       
       std::unique_ptr<ArchiveJob> job(new ArchiveJob(context, IS_MEDIA, extended, ResourceType_Patient));
       AddResourcesOfInterest(*job, body);
+      job->SetTarFormat(tar);
 
       if (transcode)
       {
@@ -651,6 +985,7 @@ namespace Orthanc
       
       job->SetLoaderThreads(loaderThreads);
       job->SetAllowUtf8(allowUtf8);
+      job->SetCompressionThreads(GetCompressionThreads(body));
       job->SetUserData(userData);
 
       SubmitJob(call.GetOutput(), context, job, priority, synchronous, filename);
@@ -697,7 +1032,9 @@ namespace Orthanc
                             "as an integer between 1 and 100.  If not provided, the value is defined "
                             "by the \"DicomLossyTranscodingQuality\" configuration. (new in v1.12.7)", false)
         .SetHttpGetArgument(GET_RESOURCES, RestApiCallDocumentation::Type_String,
-                            "A comma separated list of Orthanc resource identifiers to include in the " + m + ".", true);
+                            "A comma separated list of Orthanc resource identifiers to include in the " + m + ".", true)
+        .SetHttpGetArgument(GET_FORMAT, RestApiCallDocumentation::Type_String,
+                            "Format of the archive: `zip` (default) or `tar` (new in v1.12.12)", false);
       return;
     }
 
@@ -717,7 +1054,12 @@ namespace Orthanc
       job->SetLossyQuality(GetLossyQuality(call));
     }
 
-    const std::string filename = call.GetArgument(GET_FILENAME, "Archive.zip");  // New in Orthanc 1.12.7
+    job->SetCompressionThreads(GetCompressionThreads(Json::nullValue));
+
+    const bool tar = IsTarFormat(call.GetArgument(GET_FORMAT, "zip"));  // New in Orthanc 1.12.12
+    job->SetTarFormat(tar);
+
+    const std::string filename = call.GetArgument(GET_FILENAME, tar ? "Archive.tar" : "Archive.zip");  // New in Orthanc 1.12.7
 
     SubmitJob(call.GetOutput(), context, job, 0, true, filename);
   }
@@ -751,7 +1093,18 @@ namespace Orthanc
                             "If transcoding to a lossy transfer syntax, this entry defines the quality "
                             "as an integer between 1 and 100.  If not provided, the value is defined "
                             "by the \"DicomLossyTranscodingQuality\" configuration. (new in v1.12.7)", false)
-        .AddAnswerType(MimeType_Zip, "ZIP file containing the archive");
+        .SetHttpGetArgument(GET_FORMAT, RestApiCallDocumentation::Type_String,
+                            "Format of the archive: `zip` (default) or `tar` (new in v1.12.12)", false)
+        .AddAnswerType(MimeType_Zip, "ZIP file containing the archive")
+        .AddAnswerType(MimeType_Tar, "TAR file containing the archive, if `format` is `tar`");
+      if (!IS_MEDIA)
+      {
+        call.GetDocumentation().SetHttpGetArgument(
+          GET_RESUMABLE, RestApiCallDocumentation::Type_Boolean,
+          "If `true`, the files are stored uncompressed in the archive, whose layout is computed in advance. "
+          "The `Content-Length` is then known, and the `Range` HTTP header can be used to resume an interrupted "
+          "download. Incompatible with transcoding. (new in v1.12.12)", false);
+      }
       if (IS_MEDIA)
       {
         call.GetDocumentation().SetHttpGetArgument(
@@ -764,7 +1117,8 @@ namespace Orthanc
     ServerContext& context = OrthancRestApi::GetContext(call);
 
     const std::string id = call.GetUriComponent("id", "");
-    const std::string filename = call.GetArgument(GET_FILENAME, id + ".zip");  // New in Orthanc 1.11.0
+    const bool tar = IsTarFormat(call.GetArgument(GET_FORMAT, "zip"));  // New in Orthanc 1.12.12
+    const std::string filename = call.GetArgument(GET_FILENAME, id + (tar ? ".tar" : ".zip"));  // New in Orthanc 1.11.0
 
     bool extended;
     if (IS_MEDIA)
@@ -778,6 +1132,7 @@ namespace Orthanc
 
     std::unique_ptr<ArchiveJob> job(new ArchiveJob(context, IS_MEDIA, extended, (LEVEL == ResourceType_Patient ? ResourceType_Patient : ResourceType_Study))); // use patient info from study except when exporting a patient
     job->AddResource(id, true, LEVEL);
+    job->SetTarFormat(tar);
 
     if (call.HasArgument(GET_TRANSCODE))
     {
@@ -791,8 +1146,18 @@ namespace Orthanc
       job->SetLoaderThreads(loaderThreads);
     }
 
-    SubmitJob(call.GetOutput(), context, job, 0 /* priority */,
-              true /* synchronous */, filename);
+    job->SetCompressionThreads(GetCompressionThreads(Json::nullValue));
+
+    if (!IS_MEDIA &&
+        call.GetBooleanArgument(GET_RESUMABLE, false))
+    {
+      ServeResumableArchive(call, *job, LEVEL, id, filename);
+    }
+    else
+    {
+      SubmitJob(call.GetOutput(), context, job, 0 /* priority */,
+                true /* synchronous */, filename);
+    }
   }
 
 
@@ -838,12 +1203,15 @@ namespace Orthanc
       Json::Value userData;
       bool allowUtf8;
 
+      const bool tar = IsTarFormat(body);  // New in Orthanc 1.12.12
+
       GetJobParameters(synchronous, extended, transcode, transferSyntax, lossyQuality,
                        priority, loaderThreads, filename, userData, allowUtf8,
-                       body, false /* by default, not extented */, id + ".zip", defaultUtf8);
+                       body, false /* by default, not extented */, id + (tar ? ".tar" : ".zip"), defaultUtf8);
       
       std::unique_ptr<ArchiveJob> job(new ArchiveJob(context, IS_MEDIA, extended, LEVEL));
       job->AddResource(id, true, LEVEL);
+      job->SetTarFormat(tar);
 
       if (transcode)
       {
@@ -853,6 +1221,7 @@ namespace Orthanc
 
       job->SetLoaderThreads(loaderThreads);
       job->SetAllowUtf8(allowUtf8);
+      job->SetCompressionThreads(GetCompressionThreads(body));
       job->SetUserData(userData);
 
       SubmitJob(call.GetOutput(), context, job, priority, synchronous, filename);
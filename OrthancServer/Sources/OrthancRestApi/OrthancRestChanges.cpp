@@ -31,6 +31,7 @@ namespace Orthanc
   // Changes API --------------------------------------------------------------
   static const unsigned int DEFAULT_LIMIT = 100;
   static const int64_t DEFAULT_TO = -1;
+  static const unsigned int MAX_WAIT = 60;  // In seconds, for long polling
  
   static void GetSinceToAndLimit(int64_t& since,
                                  int64_t& to,
@@ -74,6 +75,7 @@ namespace Orthanc
         .SetHttpGetArgument("since", RestApiCallDocumentation::Type_Number, "Show only the resources since the provided index excluded", false)
         .SetHttpGetArgument("to", RestApiCallDocumentation::Type_Number, "Show only the resources till the provided index included (only available if your DB backend supports ExtendedChanges)", false)
         .SetHttpGetArgument("type", RestApiCallDocumentation::Type_String, "Show only the changes of the provided type (only available if your DB backend supports ExtendedChanges).  Multiple values can be provided and must be separated by a ';'.", false)
+        .SetHttpGetArgument("wait", RestApiCallDocumentation::Type_Number, "If no change is available since the provided index, wait for at most this number of seconds for a new change to be committed before answering (long polling, defaults to 0, at most 60). Each waiting client holds one HTTP thread of Orthanc. (new in Orthanc 1.12.12)", false)
         .AddAnswerType(MimeType_Json, "The list of changes")
         .SetAnswerField("Changes", RestApiCallDocumentation::Type_JsonListOfObjects, "The individual changes")
         .SetAnswerField("Done", RestApiCallDocumentation::Type_Boolean,
@@ -107,16 +109,8 @@ namespace Orthanc
       }
     }
 
-    Json::Value result;
-    if (last)
-    {
-      context.GetIndex().GetLastChange(result);
-    }
-    else if (context.GetIndex().HasExtendedChanges())
-    {
-      context.GetIndex().GetChangesExtended(result, since, to, limit, filterType);
-    }
-    else
+    if (!last &&
+        !context.GetIndex().HasExtendedChanges())
     {
       if (filterType.size() > 0)
       {
@@ -127,8 +121,47 @@ namespace Orthanc
       {
         throw OrthancException(ErrorCode_ParameterOutOfRange, "CAPABILITIES: Trying to use the 'to' parameter in /changes while the Database backend does not support it (requires a DB backend with support for ExtendedChanges)");
       }
+    }
+
+    const unsigned int wait = (last ? 0 : std::min(MAX_WAIT, call.GetUnsignedInteger32Argument("wait", 0)));
+    const boost::posix_time::ptime deadline = (boost::posix_time::microsec_clock::universal_time() +
+                                               boost::posix_time::seconds(wait));
+
+    Json::Value result;
+
+    for (;;)
+    {
+      // Read before the database, so that no commit is missed while waiting
+      const uint64_t generation = context.GetChangesFeed().GetGeneration();
+
+      if (last)
+      {
+        context.GetIndex().GetLastChange(result);
+      }
+      else if (context.GetIndex().HasExtendedChanges())
+      {
+        context.GetIndex().GetChangesExtended(result, since, to, limit, filterType);
+      }
+      else
+      {
+        context.GetIndex().GetChanges(result, since, limit);
+      }
+
+      if (wait == 0 ||
+          result["Changes"].size() > 0)
+      {
+        break;
+      }
+
+      const boost::posix_time::time_duration remaining = deadline - boost::posix_time::microsec_clock::universal_time();
+      if (remaining.total_milliseconds() <= 0 ||
+          !context.GetChangesFeed().WaitChange(generation, static_cast<unsigned int>(remaining.total_milliseconds())))
+      {
+        break;
+      }
 
-      context.GetIndex().GetChanges(result, since, limit);
+      // Some change was committed, but possibly not one that is
+      // reported by this call (e.g. filtered out by "type"): loop
     }
 
     call.GetOutput().AnswerJson(result);
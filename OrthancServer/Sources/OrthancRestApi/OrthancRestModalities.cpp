@@ -41,6 +41,8 @@
 #include "../ServerToolbox.h"
 #include "../StorageCommitmentReports.h"
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 
 namespace Orthanc
 {
@@ -55,6 +57,8 @@ namespace Orthanc
   static const char* const KEY_TARGET_AET = "TargetAet";
   static const char* const KEY_TIMEOUT = "Timeout";
   static const char* const KEY_CHECK_FIND = "CheckFind";
+  static const char* const KEY_BENCHMARK = "Benchmark";
+  static const char* const KEY_MAXIMUM_PDU_LENGTH = "MaximumPduLength";
   static const char* const SOP_CLASS_UID = "SOPClassUID";
   static const char* const SOP_INSTANCE_UID = "SOPInstanceUID";
   static const char* const KEY_RETRIEVE_METHOD = "RetrieveMethod";
@@ -153,10 +157,94 @@ namespace Orthanc
    * DICOM C-Echo SCU
    ***************************************************************************/
 
+  static void ExecuteEchoBenchmark(RestApiOutput& output,
+                                   const DicomAssociationParameters& source,
+                                   const Json::Value& body)
+  {
+    const unsigned int count = SerializationToolbox::ReadUnsignedInteger(body, KEY_BENCHMARK);
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The number of C-ECHO of a benchmark must be at least 1");
+    }
+
+    DicomAssociationParameters parameters(source);
+
+    if (body.isMember(KEY_MAXIMUM_PDU_LENGTH))
+    {
+      // Allows one to compare different PDU lengths without changing the configuration
+      const unsigned int pdu = SerializationToolbox::ReadUnsignedInteger(body, KEY_MAXIMUM_PDU_LENGTH);
+      parameters.SetMaximumPduLength(pdu);
+    }
+
+    DicomControlUserConnection connection(parameters, ScuOperationFlags_Echo);
+
+    // The first C-ECHO includes the negotiation of the association
+    const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    if (!connection.Echo())
+    {
+      output.SignalError(HttpStatus_500_InternalServerError);
+      return;
+    }
+
+    const boost::posix_time::ptime associated = boost::posix_time::microsec_clock::universal_time();
+
+    double minimum = 0, maximum = 0;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+      const boost::posix_time::ptime before = boost::posix_time::microsec_clock::universal_time();
+
+      if (!connection.Echo())
+      {
+        output.SignalError(HttpStatus_500_InternalServerError);
+        return;
+      }
+
+      const double latency = static_cast<double>(
+        (boost::posix_time::microsec_clock::universal_time() - before).total_microseconds()) / 1000.0;
+
+      if (i == 0 || latency < minimum)
+      {
+        minimum = latency;
+      }
+
+      if (i == 0 || latency > maximum)
+      {
+        maximum = latency;
+      }
+    }
+
+    const double total = static_cast<double>(
+      (boost::posix_time::microsec_clock::universal_time() - associated).total_microseconds()) / 1000.0;
+
+    Json::Value answer = Json::objectValue;
+    answer["Count"] = count;
+    answer["AssociationTime"] = static_cast<double>((associated - start).total_microseconds()) / 1000.0;
+    answer["AverageLatency"] = total / static_cast<double>(count);
+    answer["MinimumLatency"] = minimum;
+    answer["MaximumLatency"] = maximum;
+    answer["EchoesPerSecond"] = (total > 0 ? static_cast<double>(count) * 1000.0 / total : 0.0);
+    answer["MaximumPduLength"] = parameters.GetMaximumPduLength();
+    answer["SocketBufferSize"] = DicomAssociationParameters::GetSocketBufferSize();
+    answer["TcpNoDelay"] = DicomAssociationParameters::IsTcpNoDelay();
+
+    output.AnswerJson(answer);
+  }
+
+
   static void ExecuteEcho(RestApiOutput& output,
                           const DicomAssociationParameters& parameters,
                           const Json::Value& body)
   {
+    if (body.type() == Json::objectValue &&
+        body.isMember(KEY_BENCHMARK))
+    {
+      // New in Orthanc 1.12.12
+      ExecuteEchoBenchmark(output, parameters, body);
+      return;
+    }
+
     bool checkFind = false;
     
     if (body.type() == Json::objectValue &&
@@ -212,7 +300,16 @@ namespace Orthanc
       .SetRequestField(KEY_CHECK_FIND, RestApiCallDocumentation::Type_Boolean,
                        "Issue a dummy C-FIND command after the C-GET SCU, in order to check whether the remote "
                        "modality knows about Orthanc. This field defaults to the value of the `DicomEchoChecksFind` "
-                       "configuration option. New in Orthanc 1.8.1.", false);
+                       "configuration option. New in Orthanc 1.8.1.", false)
+      .SetRequestField(KEY_BENCHMARK, RestApiCallDocumentation::Type_Number,
+                       "If present, issue this number of C-ECHO commands over one single association, and "
+                       "answer the time to set up the association and the round-trip latencies (in milliseconds), "
+                       "together with the effective socket settings. `CheckFind` is ignored in this mode. "
+                       "New in Orthanc 1.12.12.", false)
+      .SetRequestField(KEY_MAXIMUM_PDU_LENGTH, RestApiCallDocumentation::Type_Number,
+                       "Maximum PDU length to be used by the benchmark, which allows one to compare several values "
+                       "without changing the configuration (only used together with `Benchmark`). "
+                       "New in Orthanc 1.12.12.", false);
   }
   
   
@@ -1583,13 +1680,15 @@ namespace Orthanc
     }
 
     Json::Value body = Json::objectValue;  // No body
-    DicomStoreUserConnection connection(GetAssociationParameters(call, body));
+    DicomStoreConnectionPool::Accessor accessor(OrthancRestApi::GetContext(call).GetStoreConnectionPool(),
+                                                GetAssociationParameters(call, body));
 
     std::string sopClassUid, sopInstanceUid;
-    connection.Store(sopClassUid, sopInstanceUid, call.GetBodyData(),
-                     call.GetBodySize(), 
-                     false /* Not a C-MOVE */, 
-                     "", 0);
+    accessor.GetConnection().Store(sopClassUid, sopInstanceUid, call.GetBodyData(),
+                                   call.GetBodySize(), 
+                                   false /* Not a C-MOVE */, 
+                                   "", 0);
+    accessor.SetSuccess();
 
     Json::Value answer = Json::objectValue;
     answer[SOP_CLASS_UID] = sopClassUid;
@@ -1829,6 +1928,7 @@ namespace Orthanc
   {
     static const char* KEY_TRANSCODE = "Transcode";
     static const char* KEY_COMPRESS = "Compress";
+    static const char* KEY_BUNDLE_SIZE = "BundleSize";
 
     if (call.IsDocumentation())
     {
@@ -1845,6 +1945,10 @@ namespace Orthanc
                          "Transcode to the provided DICOM transfer syntax before the actual sending", false)
         .SetRequestField(KEY_COMPRESS, RestApiCallDocumentation::Type_Boolean,
                          "Whether to compress the DICOM instances using gzip before the actual sending", false)
+        .SetRequestField(KEY_BUNDLE_SIZE, RestApiCallDocumentation::Type_Number,
+                         "Number of DICOM instances to be packed into each HTTP request, as a ZIP archive "
+                         "(new in Orthanc 1.12.12). Zero (the default) sends one instance per request. "
+                         "The remote Orthanc server must be >= 1.8.2.", false)
         .SetUriArgument("id", "Identifier of the modality of interest");
       return;
     }
@@ -1869,6 +1973,12 @@ namespace Orthanc
     {
       job->SetCompress(SerializationToolbox::ReadBoolean(request, KEY_COMPRESS));
     }
+
+    if (request.type() == Json::objectValue &&
+        request.isMember(KEY_BUNDLE_SIZE))
+    {
+      job->SetBundleSize(SerializationToolbox::ReadUnsignedInteger(request, KEY_BUNDLE_SIZE));
+    }
     
     {
       OrthancConfiguration::ReaderLock lock;
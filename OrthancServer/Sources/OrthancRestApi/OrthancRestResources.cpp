@@ -36,18 +36,26 @@
 #include "../../../OrthancFramework/Sources/HttpServer/HttpContentNegociation.h"
 #include "../../../OrthancFramework/Sources/Images/Image.h"
 #include "../../../OrthancFramework/Sources/Images/ImageProcessing.h"
+#include "../../../OrthancFramework/Sources/Images/JpegWriter.h"
 #include "../../../OrthancFramework/Sources/Images/NumpyWriter.h"
+#include "../../../OrthancFramework/Sources/Images/PngWriter.h"
 #include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/CallableGroup.h"
 #include "../../../OrthancFramework/Sources/MultiThreading/Semaphore.h"
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
 
+#include "../IDicomImageDecoder.h"
 #include "../OrthancConfiguration.h"
 #include "../Search/DatabaseLookup.h"
 #include "../Search/DatabaseMetadataConstraint.h"
 #include "../ServerContext.h"
+#include "../ServerJobs/ReindexingJob.h"
 #include "../ServerToolbox.h"
 #include "../SliceOrdering.h"
 
+#include <boost/algorithm/string/predicate.hpp>
+#include <limits>
+
 // This "include" is mandatory for Release builds using Linux Standard Base
 #include <boost/shared_ptr.hpp>
 
@@ -65,6 +73,9 @@ static const char* const IGNORE_LENGTH = "ignore-length";
 static const char* const RECONSTRUCT_FILES = "ReconstructFiles";
 static const char* const LIMIT_TO_THIS_LEVEL_MAIN_DICOM_TAGS = "LimitToThisLevelMainDicomTags";
 static const char* const ARG_WHOLE = "whole";
+static const char* const ARG_CONTINUATION_TOKEN = "continuation-token";          // New in Orthanc 1.12.12
+static const char* const ARG_NDJSON = "ndjson";                                   // New in Orthanc 1.12.12
+static const char* const HEADER_CONTINUATION_TOKEN = "Orthanc-Continuation-Token";  // New in Orthanc 1.12.12
 
 
 namespace Orthanc
@@ -177,8 +188,15 @@ namespace Orthanc
         .SetDescription("List the Orthanc identifiers of all the available DICOM " + resources)
         .SetHttpGetArgument("limit", RestApiCallDocumentation::Type_Number, "Limit the number of results", false)
         .SetHttpGetArgument("since", RestApiCallDocumentation::Type_Number, "Show only the resources since the provided index", false)
+        .SetHttpGetArgument(ARG_CONTINUATION_TOKEN, RestApiCallDocumentation::Type_String,
+                            "Use keyset pagination, in conjunction with `limit`: provide an empty value to get the first page, "
+                            "then the `" + std::string(HEADER_CONTINUATION_TOKEN) + "` HTTP header of the previous answer. "
+                            "Each page then takes the same time, whatever its position in the listing. "
+                            "Cannot be combined with `since`. (new in Orthanc 1.12.12)", false)
         .AddAnswerType(MimeType_Json, "JSON array containing either the Orthanc identifiers, or detailed information "
                        "about the reported " + resources + " (if `expand` argument is provided)")
+        .SetAnswerHeader(HEADER_CONTINUATION_TOKEN, "Token to get the next page, if `" + std::string(ARG_CONTINUATION_TOKEN) +
+                         "` is provided and if more " + resources + " might be available (new in Orthanc 1.12.12)")
         .SetHttpGetSample("https://orthanc.uclouvain.be/demo/" + resources + "?since=0&limit=2", true);
       OrthancRestApi::DocumentResponseContentAndExpand(call);
       return;
@@ -198,8 +216,27 @@ namespace Orthanc
                           OrthancRestApi::GetContext(call).GetIndex().HasFindSupport());
     finder.AddRequestedTags(requestedTags);
 
-    if (call.HasArgument("limit") ||
-        call.HasArgument("since"))
+    if (call.HasArgument(ARG_CONTINUATION_TOKEN))  // New in Orthanc 1.12.12
+    {
+      if (!call.HasArgument("limit"))
+      {
+        throw OrthancException(ErrorCode_BadRequest,
+                               "Missing \"limit\" argument for GET request against: " +
+                               call.FlattenUri());
+      }
+
+      if (call.HasArgument("since"))
+      {
+        throw OrthancException(ErrorCode_BadRequest,
+                               "The \"since\" and \"" + std::string(ARG_CONTINUATION_TOKEN) +
+                               "\" arguments cannot be combined in GET request against: " + call.FlattenUri());
+      }
+
+      finder.SetContinuationToken(call.GetArgument(ARG_CONTINUATION_TOKEN, ""));
+      finder.SetLimitsCount(boost::lexical_cast<uint64_t>(call.GetArgument("limit", "")));
+    }
+    else if (call.HasArgument("limit") ||
+             call.HasArgument("since"))
     {
       if (!call.HasArgument("limit"))
       {
@@ -221,9 +258,16 @@ namespace Orthanc
       finder.SetLimitsCount(limit);
     }
 
-    Json::Value answer;
+    RestApiJsonWriter answer(Json::arrayValue);
     finder.Execute(answer, OrthancRestApi::GetContext(call),
                    OrthancRestApi::GetDicomFormat(call, DicomToJsonFormat_Human), false /* no "Metadata" field */);
+
+    std::string token;
+    if (finder.LookupContinuationToken(token))
+    {
+      call.GetOutput().GetLowLevelOutput().AddHeader(HEADER_CONTINUATION_TOKEN, token);
+    }
+
     call.GetOutput().AnswerJson(answer);
   }
 
@@ -333,6 +377,102 @@ namespace Orthanc
 
 
   // Get information about a single instance ----------------------------------
+
+  static bool MatchETag(const std::string& ifNoneMatch,
+                        const std::string& etag)
+  {
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, ifNoneMatch, ',');
+
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+      std::string token = Toolbox::StripSpaces(tokens[i]);
+
+      if (boost::starts_with(token, "W/"))
+      {
+        // "If-None-Match" uses the weak comparison (RFC 9110)
+        token = token.substr(2);
+      }
+
+      if (token == "*" ||
+          token == etag)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  /**
+   * The DICOM file of an instance is never modified in place: If the
+   * instance is overwritten, a new attachment with a new UUID is
+   * created. The answers that are computed from the DICOM file can
+   * thus be identified by this UUID, together with the HTTP headers
+   * that select their representation. This allows to answer
+   * "If-None-Match" without accessing the storage area. Returns
+   * "true" iff the "304 Not Modified" answer was sent. New in Orthanc
+   * 1.12.12.
+   **/
+  static bool AnswerIfInstanceNotModified(std::string& dicomUuid /* out, empty if unknown instance */,
+                                          RestApiGetCall& call)
+  {
+    dicomUuid.clear();
+
+    FileInfo info;
+    int64_t revision;
+    if (!OrthancRestApi::GetIndex(call).LookupAttachment(info, revision, ResourceType_Instance,
+                                                         call.GetUriComponent("id", ""), FileContentType_Dicom))
+    {
+      return false;  // The error is reported by the route itself
+    }
+
+    dicomUuid = info.GetUuid();
+
+    std::string key = info.GetUuid();
+
+    static const char* const HEADERS[] = { "accept", "accept-encoding" };
+    for (size_t i = 0; i < sizeof(HEADERS) / sizeof(HEADERS[0]); i++)
+    {
+      HttpToolbox::Arguments::const_iterator found = call.GetHttpHeaders().find(HEADERS[i]);
+      key += "|" + (found == call.GetHttpHeaders().end() ? std::string() : found->second);
+    }
+
+    std::string md5;
+    Toolbox::ComputeMD5(md5, key);
+    const std::string etag = "\"" + md5 + "\"";
+
+    const std::string cacheControl = OrthancConfiguration::GetSnapshot()->GetInstancesCacheControl();
+
+    HttpOutput& output = call.GetOutput().GetLowLevelOutput();
+    output.AddHeader("ETag", etag);
+
+    if (!cacheControl.empty())
+    {
+      output.AddHeader("Cache-Control", cacheControl);
+    }
+
+    HttpToolbox::Arguments::const_iterator ifNoneMatch = call.GetHttpHeaders().find("if-none-match");
+    if (ifNoneMatch != call.GetHttpHeaders().end() &&
+        MatchETag(ifNoneMatch->second, etag))
+    {
+      output.SendStatus(HttpStatus_304_NotModified);
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  static bool AnswerIfInstanceNotModified(RestApiGetCall& call)
+  {
+    std::string dicomUuid;
+    return AnswerIfInstanceNotModified(dicomUuid, call);
+  }
+
  
   static void GetInstanceFile(RestApiGetCall& call)
   {
@@ -368,6 +508,13 @@ namespace Orthanc
 
     std::string publicId = call.GetUriComponent("id", "");
 
+    // Lossy transcoding might generate new SOP Instance UIDs
+    if (!call.HasArgument(GET_TRANSCODE) &&
+        AnswerIfInstanceNotModified(call))
+    {
+      return;
+    }
+
     HttpToolbox::Arguments::const_iterator accept = call.GetHttpHeaders().find("accept");
     if (accept != call.GetHttpHeaders().end())
     {
@@ -411,13 +558,8 @@ namespace Orthanc
 
     if (call.HasArgument(GET_TRANSCODE))
     {
-      unsigned int lossyQuality;
-      unsigned int defaultLossyQuality;
-      {
-        OrthancConfiguration::ReaderLock lock;
-        defaultLossyQuality = lock.GetConfiguration().GetDicomLossyTranscodingQuality();
-      }
-      lossyQuality = call.GetUnsignedInteger32Argument(GET_LOSSY_QUALITY, defaultLossyQuality);
+      const unsigned int defaultLossyQuality = OrthancConfiguration::GetSnapshot()->GetDicomLossyTranscodingQuality();
+      const unsigned int lossyQuality = call.GetUnsignedInteger32Argument(GET_LOSSY_QUALITY, defaultLossyQuality);
 
       std::string source;
       std::string attachmentId;
@@ -580,6 +722,11 @@ namespace Orthanc
       return;
     }
 
+    if (AnswerIfInstanceNotModified(call))
+    {
+      return;
+    }
+
     const bool whole = call.GetBooleanArgument(ARG_WHOLE, false);
 
     switch (OrthancRestApi::GetDicomFormat(call, DicomToJsonFormat_Full))
@@ -613,7 +760,7 @@ namespace Orthanc
         .SetTruncatedJsonHttpGetSample("https://orthanc.uclouvain.be/demo/instances/7c92ce8e-bbf67ed2-ffa3b8c1-a3b35d94-7ff3ae26/simplified-tags", 10);
       return;
     }
-    else
+    else if (!AnswerIfInstanceNotModified(call))
     {
       GetInstanceTagsInternal<DicomToJsonFormat_Human>(call, call.GetBooleanArgument(ARG_WHOLE, false));
     }
@@ -680,10 +827,20 @@ namespace Orthanc
         output.AnswerBuffer(answer_, format_);
       }
 
-      void EncodeUsingPng()
+      MimeType GetFormat() const
+      {
+        return format_;
+      }
+
+      const std::string& GetAnswer() const
+      {
+        return answer_;
+      }
+
+      void EncodeUsingPng(PngWriter& writer)
       {
         format_ = MimeType_Png;
-        DicomImageDecoder::ExtractPngImage(answer_, image_, mode_, invert_);
+        DicomImageDecoder::ExtractPngImage(answer_, image_, mode_, invert_, writer);
       }
 
       void EncodeUsingPam()
@@ -692,10 +849,10 @@ namespace Orthanc
         DicomImageDecoder::ExtractPamImage(answer_, image_, mode_, invert_);
       }
 
-      void EncodeUsingJpeg(uint8_t quality)
+      void EncodeUsingJpeg(JpegWriter& writer)
       {
         format_ = MimeType_Jpeg;
-        DicomImageDecoder::ExtractJpegImage(answer_, image_, mode_, invert_, quality);
+        DicomImageDecoder::ExtractJpegImage(answer_, image_, mode_, invert_, writer);
       }
     };
 
@@ -703,10 +860,35 @@ namespace Orthanc
     {
     private:
       ImageToEncode&  image_;
+      PngWriter       writer_;
 
     public:
-      explicit EncodePng(ImageToEncode& image) : image_(image)
+      EncodePng(ImageToEncode& image,
+                RestApiGetCall& call) :
+        image_(image)
       {
+        OrthancRestApi::GetContext(call).ConfigurePngWriter(writer_);
+
+        if (call.HasArgument("png-compression"))
+        {
+          const std::string v = call.GetArgument("png-compression", "");
+
+          unsigned int level;
+          if (!SerializationToolbox::ParseUnsignedInteger(level, v) ||
+              level > 9)
+          {
+            throw OrthancException(
+              ErrorCode_BadRequest,
+              "Bad level for a PNG compression (must be a number between 0 and 9): " + v);
+          }
+
+          writer_.SetCompressionLevel(level);
+        }
+
+        if (call.HasArgument("png-filter"))
+        {
+          writer_.SetFilterStrategy(PngWriter::StringToFilterStrategy(call.GetArgument("png-filter", "")));
+        }
       }
 
       virtual void Handle(const std::string& type,
@@ -715,7 +897,7 @@ namespace Orthanc
       {
         assert(type == "image");
         assert(subtype == "png");
-        image_.EncodeUsingPng();
+        image_.EncodeUsingPng(writer_);
       }
     };
 
@@ -742,13 +924,15 @@ namespace Orthanc
     class EncodeJpeg : public HttpContentNegociation::IHandler
     {
     private:
-      ImageToEncode&  image_;
-      unsigned int    quality_;
+      ImageToEncode&        image_;
+      const ServerContext&  context_;
+      unsigned int          quality_;
 
     public:
       EncodeJpeg(ImageToEncode& image,
-                 const RestApiGetCall& call) :
-        image_(image)
+                 RestApiGetCall& call) :
+        image_(image),
+        context_(OrthancRestApi::GetContext(call))
       {
         std::string v = call.GetArgument("quality", "90" /* default JPEG quality */);
         bool ok = false;
@@ -772,7 +956,11 @@ namespace Orthanc
       {
         assert(type == "image");
         assert(subtype == "jpeg");
-        image_.EncodeUsingJpeg(quality_);
+
+        JpegWriter writer;
+        writer.SetQuality(static_cast<uint8_t>(quality_));
+        context_.ConfigureJpegWriter(writer);
+        image_.EncodeUsingJpeg(writer);
       }
     };
   }
@@ -782,11 +970,21 @@ namespace Orthanc
   {
     class IDecodedFrameHandler : public boost::noncopyable
     {
+    private:
+      std::string  renderedFramesCacheKey_;
+
     public:
       virtual ~IDecodedFrameHandler()
       {
       }
 
+      // The answers are stored in the cache of the rendered frames
+      // iff. the key is not empty
+      void SetRenderedFramesCacheKey(const std::string& key)
+      {
+        renderedFramesCacheKey_ = key;
+      }
+
       // "dicom" is non-NULL iff. "RequiresDicomTags() == true"
       virtual void Handle(RestApiGetCall& call,
                           std::unique_ptr<ImageAccessor>& decoded,
@@ -879,6 +1077,10 @@ namespace Orthanc
             .SetTag("Instances")
             .SetUriArgument("id", "Orthanc identifier of the DICOM instance of interest")
             .SetHttpGetArgument("quality", RestApiCallDocumentation::Type_Number, "Quality for JPEG images (between 1 and 100, defaults to 90)", false)
+            .SetHttpGetArgument("png-compression", RestApiCallDocumentation::Type_Number, "Level of the zlib compression for PNG images "
+                                "(between 0 and 9, defaults to the `PngCompressionLevel` configuration option)", false)
+            .SetHttpGetArgument("png-filter", RestApiCallDocumentation::Type_String, "Filter strategy for PNG images (`adaptive`, `none`, "
+                                "`sub`, `up` or `paeth`, defaults to the `PngFilterStrategy` configuration option)", false)
             .SetHttpGetArgument("returnUnsupportedImage", RestApiCallDocumentation::Type_Boolean, "Returns an unsupported.png placeholder image if unable to provide the image instead of returning a 415 HTTP error (value is true if option is present)", false)
             .SetHttpHeader("Accept", "Format of the resulting image. Can be `image/png` (default), `image/jpeg` or `image/x-portable-arbitrarymap`")
             .AddAnswerType(MimeType_Png, "PNG image")
@@ -909,7 +1111,10 @@ namespace Orthanc
         {
           std::string publicId = call.GetUriComponent("id", "");
 
-          decoded.reset(context.DecodeDicomFrame(publicId, frame));
+          // "header" is only set if the frame was read using the
+          // index of the offsets of the frames
+          std::unique_ptr<ParsedDicomFile> header;
+          decoded.reset(context.DecodeDicomFrame(header, publicId, frame));
 
           if (decoded.get() == NULL)
           {
@@ -917,7 +1122,13 @@ namespace Orthanc
                                    "Cannot decode DICOM instance with ID: " + publicId);
           }
           
-          if (handler.RequiresDicomTags())
+          if (handler.RequiresDicomTags() &&
+              header.get() != NULL)
+          {
+            // The DICOM tags are available without loading the full file
+            handler.Handle(call, decoded, header.get(), frame);
+          }
+          else if (handler.RequiresDicomTags())
           {
             /**
              * Retrieve a summary of the DICOM tags, which is
@@ -964,17 +1175,17 @@ namespace Orthanc
       }
 
 
-      static void DefaultHandler(RestApiGetCall& call,
-                                 std::unique_ptr<ImageAccessor>& decoded,
-                                 ImageExtractionMode mode,
-                                 bool invert)
+      void DefaultHandler(RestApiGetCall& call,
+                          std::unique_ptr<ImageAccessor>& decoded,
+                          ImageExtractionMode mode,
+                          bool invert)
       {
         ImageToEncode image(decoded, mode, invert);
 
         HttpContentNegociation negociation;
 
         // The first call to "Register()" indicates the default content type (here, PNG)
-        EncodePng png(image);
+        EncodePng png(image, call);
         negociation.Register(MIME_PNG, png);
 
         EncodeJpeg jpeg(image, call);
@@ -986,6 +1197,12 @@ namespace Orthanc
         if (negociation.Apply(call.GetHttpHeaders()))
         {
           image.Answer(call.GetOutput());
+
+          if (!renderedFramesCacheKey_.empty())
+          {
+            OrthancRestApi::GetContext(call).GetRenderedFramesCache().Store(
+              renderedFramesCacheKey_, call.GetUriComponent("id", ""), image.GetFormat(), image.GetAnswer());
+          }
         }
       }
     };
@@ -1249,21 +1466,91 @@ namespace Orthanc
   }
 
 
+  /**
+   * Answers from the cache of the rendered frames, if enabled. The
+   * key is made of the UUID of the DICOM attachment (which changes if
+   * the instance is overwritten), of the route, and of all the
+   * arguments of the rendering. The "Accept" HTTP header is part of
+   * the key, as it selects the MIME type of the answer. If the image
+   * is not cached, "key" is set to the value that must be used to
+   * store it once rendered. New in Orthanc 1.12.12.
+   **/
+  static bool AnswerFromRenderedFramesCache(std::string& key /* out */,
+                                            RestApiGetCall& call,
+                                            const std::string& dicomUuid,
+                                            const std::string& route)
+  {
+    key.clear();
+
+    ServerContext& context = OrthancRestApi::GetContext(call);
+    if (dicomUuid.empty() ||
+        !context.HasRenderedFramesCache())
+    {
+      return false;
+    }
+
+    std::string s = dicomUuid + "|" + route + "|" + call.GetUriComponent("frame", "0");
+
+    static const char* const ARGUMENTS[] = { "quality", "png-compression", "png-filter", "window-center", "window-width", "width", "height", "smooth" };
+    for (size_t i = 0; i < sizeof(ARGUMENTS) / sizeof(ARGUMENTS[0]); i++)
+    {
+      // Distinguish between a missing argument and an empty argument
+      s += (call.HasArgument(ARGUMENTS[i]) ? "|=" + call.GetArgument(ARGUMENTS[i], "") : "|");
+    }
+
+    HttpToolbox::Arguments::const_iterator accept = call.GetHttpHeaders().find("accept");
+    s += "|" + (accept == call.GetHttpHeaders().end() ? std::string() : accept->second);
+
+    std::string content;
+    MimeType mime;
+    if (context.GetRenderedFramesCache().Lookup(content, mime, s))
+    {
+      call.GetOutput().AnswerBuffer(content, mime);
+      return true;
+    }
+    else
+    {
+      key.swap(s);
+      return false;
+    }
+  }
+
+
   template <enum ImageExtractionMode mode>
   static void GetImage(RestApiGetCall& call)
   {
+    std::string dicomUuid, cacheKey;
+
+    if (!call.IsDocumentation() &&
+        (AnswerIfInstanceNotModified(dicomUuid, call) ||
+         AnswerFromRenderedFramesCache(cacheKey, call, dicomUuid, "image-" + boost::lexical_cast<std::string>(static_cast<int>(mode)))))
+    {
+      return;
+    }
+
     Semaphore::Locker locker(throttlingSemaphore_);
         
     GetImageHandler handler(mode);
+    handler.SetRenderedFramesCacheKey(cacheKey);
     IDecodedFrameHandler::Apply(call, handler, mode, false /* not rendered */);
   }
 
 
   static void GetRenderedFrame(RestApiGetCall& call)
   {
+    std::string dicomUuid, cacheKey;
+
+    if (!call.IsDocumentation() &&
+        (AnswerIfInstanceNotModified(dicomUuid, call) ||
+         AnswerFromRenderedFramesCache(cacheKey, call, dicomUuid, "rendered")))
+    {
+      return;
+    }
+
     Semaphore::Locker locker(throttlingSemaphore_);
         
     RenderedFrameHandler handler;
+    handler.SetRenderedFramesCacheKey(cacheKey);
     IDecodedFrameHandler::Apply(call, handler, ImageExtractionMode_Preview /* arbitrary value */, true);
   }
 
@@ -1281,32 +1568,48 @@ namespace Orthanc
 
   namespace
   {
-    class NumpyVisitor : public boost::noncopyable
+    /**
+     * Block of consecutive frames of a numpy array. The frames are
+     * decoded into their slots of an image that is preallocated once
+     * the size of the first decoded frame is known. One block is
+     * filled by one single thread, possibly from the pool of the
+     * "FramesDecodingThreads" workers (new in Orthanc 1.12.12).
+     **/
+    class NumpyFrames : public IDynamicObject
     {
     private:
-      bool           rescale_;
-      unsigned int   depth_;
-      unsigned int   currentDepth_;
-      unsigned int   width_;
-      unsigned int   height_;
-      PixelFormat    format_;
-      ChunkedBuffer  buffer_;
+      bool                    rescale_;
+      unsigned int            countFrames_;
+      unsigned int            countWritten_;
+      unsigned int            frameHeight_;
+      PixelFormat             sourceFormat_;
+      std::unique_ptr<Image>  frames_;
 
     public:
-      NumpyVisitor(unsigned int depth /* can be zero if 2D frame */,
-                   bool rescale) :
+      NumpyFrames(unsigned int countFrames,
+                  bool rescale) :
         rescale_(rescale),
-        depth_(depth),
-        currentDepth_(0),
-        width_(0),  // dummy initialization
-        height_(0),  // dummy initialization
-        format_(PixelFormat_Grayscale8)  // dummy initialization
+        countFrames_(countFrames),
+        countWritten_(0),
+        frameHeight_(0),  // dummy initialization
+        sourceFormat_(PixelFormat_Grayscale8)  // dummy initialization
       {
       }
 
+      unsigned int GetCountFrames() const
+      {
+        return countFrames_;
+      }
+
+      // Decodes the next frame of the block
       void WriteFrame(const ParsedDicomFile& dicom,
                       unsigned int frame)
       {
+        if (countWritten_ >= countFrames_)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+
         std::unique_ptr<ImageAccessor> decoded(dicom.DecodeFrame(frame));
 
         if (decoded.get() == NULL)
@@ -1314,161 +1617,430 @@ namespace Orthanc
           throw OrthancException(ErrorCode_NotImplemented, "Cannot decode DICOM instance");
         }
 
-        if (currentDepth_ == 0)
+        WriteDecodedFrame(dicom, frame, *decoded);
+      }
+
+      // Writes the next frame of the block, that was decoded
+      // elsewhere. The "dicom" file only provides the rescale
+      // parameters, and may have no pixel data.
+      void WriteDecodedFrame(const ParsedDicomFile& dicom,
+                             unsigned int frame,
+                             const ImageAccessor& decoded)
+      {
+        if (countWritten_ >= countFrames_)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+
+        if (frames_.get() == NULL)
         {
-          width_ = decoded->GetWidth();
-          height_ = decoded->GetHeight();
-          format_ = decoded->GetFormat();
+          frameHeight_ = decoded.GetHeight();
+          sourceFormat_ = decoded.GetFormat();
+
+          if (frameHeight_ != 0 &&
+              countFrames_ > std::numeric_limits<unsigned int>::max() / frameHeight_)
+          {
+            throw OrthancException(ErrorCode_NotEnoughMemory, "Too many frames to be exported at once");
+          }
+
+          const PixelFormat target = (rescale_ && sourceFormat_ != PixelFormat_RGB24 ? PixelFormat_Float32 : sourceFormat_);
+          frames_.reset(new Image(target, decoded.GetWidth(), frameHeight_ * countFrames_, false));
         }
-        else if (width_ != decoded->GetWidth() ||
-                 height_ != decoded->GetHeight())
+        else if (frames_->GetWidth() != decoded.GetWidth() ||
+                 frameHeight_ != decoded.GetHeight())
         {
           throw OrthancException(ErrorCode_IncompatibleImageSize, "The size of the frames varies across the instance(s)");
         }
-        else if (format_ != decoded->GetFormat())
+        else if (sourceFormat_ != decoded.GetFormat())
         {
           throw OrthancException(ErrorCode_IncompatibleImageFormat, "The pixel format of the frames varies across the instance(s)");
         }
 
+        ImageAccessor slot;
+        frames_->GetRegion(slot, 0, countWritten_ * frameHeight_, frames_->GetWidth(), frameHeight_);
+
         if (rescale_ &&
-            decoded->GetFormat() != PixelFormat_RGB24)
+            decoded.GetFormat() != PixelFormat_RGB24)
         {
-          if (currentDepth_ == 0)
-          {
-            NumpyWriter::WriteHeader(buffer_, depth_, width_, height_, PixelFormat_Float32);
-          }
-          
           double rescaleIntercept, rescaleSlope;
           dicom.GetRescale(rescaleIntercept, rescaleSlope, frame);
 
-          Image converted(PixelFormat_Float32, decoded->GetWidth(), decoded->GetHeight(), false);
-          ImageProcessing::Convert(converted, *decoded);
-          ImageProcessing::ShiftScale2(converted, static_cast<float>(rescaleIntercept), static_cast<float>(rescaleSlope), false);
-
-          NumpyWriter::WritePixels(buffer_, converted);
+          ImageProcessing::Convert(slot, decoded);
+          ImageProcessing::ShiftScale2(slot, static_cast<float>(rescaleIntercept), static_cast<float>(rescaleSlope), false);
         }
         else
         {
-          if (currentDepth_ == 0)
-          {
-            NumpyWriter::WriteHeader(buffer_, depth_, width_, height_, format_);
-          }
-
-          NumpyWriter::WritePixels(buffer_, *decoded);
+          ImageProcessing::Copy(slot, decoded);
         }
 
-        currentDepth_ ++;
+        countWritten_++;
       }
 
-      void Answer(RestApiOutput& output,
-                  bool compress)
+      // The frames are stacked vertically in one single image
+      const ImageAccessor& GetFrames() const
       {
-        if ((depth_ == 0 && currentDepth_ != 1) ||
-            (depth_ != 0 && currentDepth_ != depth_))
+        if (frames_.get() == NULL ||
+            countWritten_ != countFrames_)
         {
           throw OrthancException(ErrorCode_BadSequenceOfCalls);
         }
         else
         {
-          std::string answer;
-          NumpyWriter::Finalize(answer, buffer_, compress);
-          output.AnswerBuffer(answer, MimeType_Binary);
+          return *frames_;
         }
       }
+
+      unsigned int GetFrameHeight() const
+      {
+        return frameHeight_;
+      }
     };
-  }
 
 
-  static void GetNumpyFrame(RestApiGetCall& call)
-  {
-    if (call.IsDocumentation())
-    {
-      DocumentSharedNumpy(call);
-      call.GetDocumentation()
-        .SetTag("Instances")
-        .SetSummary("Decode frame for numpy")
-        .SetDescription("Decode one frame of interest from the given DICOM instance, for use with numpy in Python. "
-                        "The numpy array has 3 dimensions: (height, width, color channel).")
-        .SetUriArgument("frame", RestApiCallDocumentation::Type_Number, "Index of the frame (starts at `0`)");
-    }
-    else
+    /**
+     * Streams the numpy array to the HTTP client, in the order of the
+     * blocks of frames (new in Orthanc 1.12.12). The numpy header is
+     * sent together with the first block, so that the memory is
+     * bounded by the size of the blocks, not by the size of the array.
+     **/
+    class NumpyStreamAnswer : public NumpyStreamWriter::IOutput
     {
-      const std::string instanceId = call.GetUriComponent("id", "");
-      const bool compress = call.GetBooleanArgument("compress", false);
-      const bool rescale = call.GetBooleanArgument("rescale", true);
+    private:
+      RestApiOutput&                      output_;
+      unsigned int                        depth_;
+      bool                                compress_;
+      std::unique_ptr<NumpyStreamWriter>  writer_;
+      unsigned int                        width_;
+      unsigned int                        height_;
 
-      uint32_t frame;
-      if (!SerializationToolbox::ParseUnsignedInteger32(frame, call.GetUriComponent("frame", "0")))
+    public:
+      NumpyStreamAnswer(RestApiOutput& output,
+                        unsigned int depth,
+                        bool compress) :
+        output_(output),
+        depth_(depth),
+        compress_(compress),
+        width_(0),  // dummy initialization
+        height_(0)  // dummy initialization
       {
-        throw OrthancException(ErrorCode_ParameterOutOfRange, "Expected an unsigned integer for the \"frame\" argument");
       }
 
-      NumpyVisitor visitor(0 /* no depth, 2D frame */, rescale);
-
+      virtual void Write(const void* data,
+                         size_t size) ORTHANC_OVERRIDE
       {
-        Semaphore::Locker throttling(throttlingSemaphore_);
-        ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), instanceId);
-        
-        visitor.WriteFrame(locker.GetDicom(), frame);
+        output_.SendStreamItem(data, size);
       }
 
-      visitor.Answer(call.GetOutput(), compress);
-    }
-  }
-
-
-  static void GetNumpyInstance(RestApiGetCall& call)
-  {
-    if (call.IsDocumentation())
-    {
-      DocumentSharedNumpy(call);
-      call.GetDocumentation()
-        .SetTag("Instances")
-        .SetSummary("Decode instance for numpy")
-        .SetDescription("Decode the given DICOM instance, for use with numpy in Python. "
-                        "The numpy array has 4 dimensions: (frame, height, width, color channel).");
-    }
-    else
-    {
-      const std::string instanceId = call.GetUriComponent("id", "");
-      const bool compress = call.GetBooleanArgument("compress", false);
-      const bool rescale = call.GetBooleanArgument("rescale", true);
-
+      void AddFrames(const NumpyFrames& frames)
       {
-        Semaphore::Locker throttling(throttlingSemaphore_);
-        ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), instanceId);
-
-        const unsigned int depth = locker.GetDicom().GetFramesCount();
-        if (depth == 0)
+        if (frames.GetCountFrames() == 0)
         {
-          throw OrthancException(ErrorCode_BadFileFormat, "Empty DICOM instance");
+          return;
         }
 
-        NumpyVisitor visitor(depth, rescale);
+        const ImageAccessor& image = frames.GetFrames();
 
-        for (unsigned int frame = 0; frame < depth; frame++)
+        if (writer_.get() == NULL)
+        {
+          writer_.reset(new NumpyStreamWriter(*this, compress_));
+          width_ = image.GetWidth();
+          height_ = frames.GetFrameHeight();
+
+          // The HTTP headers are only sent once the first frame has
+          // been decoded, so that the errors in the request or in the
+          // first frame can still be reported with a proper HTTP status
+          output_.StartStream(EnumerationToString(MimeType_Binary));
+          writer_->WriteHeader(depth_, width_, height_, image.GetFormat());
+        }
+        else if (width_ != image.GetWidth() ||
+                 height_ != frames.GetFrameHeight())
         {
-          visitor.WriteFrame(locker.GetDicom(), frame);
+          throw OrthancException(ErrorCode_IncompatibleImageSize, "The size of the frames varies across the instance(s)");
         }
 
-        visitor.Answer(call.GetOutput(), compress);
+        writer_->WritePixels(image);
       }
-    }
-  }
+
+      void Close()
+      {
+        if (writer_.get() == NULL)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);  // No frame
+        }
+        else
+        {
+          writer_->Close();
+          output_.CloseStream();
+        }
+      }
+    };
 
 
-  static void GetNumpySeries(RestApiGetCall& call)
-  {
-    if (call.IsDocumentation())
+    // Decodes the frames of one instance of a series, on a thread of
+    // the "FramesDecodingThreads" pool
+    class NumpySeriesInstanceDecoder : public ICallable
     {
-      DocumentSharedNumpy(call);
-      call.GetDocumentation()
-        .SetTag("Series")
-        .SetSummary("Decode series for numpy")
-        .SetDescription("Decode the given DICOM series, for use with numpy in Python. "
-                        "The numpy array has 4 dimensions: (frame, height, width, color channel).");
-    }
-    else
+    private:
+      ServerContext&  context_;
+      std::string     instanceId_;
+      unsigned int    framesCount_;
+      bool            rescale_;
+
+    public:
+      NumpySeriesInstanceDecoder(ServerContext& context,
+                                 const std::string& instanceId,
+                                 unsigned int framesCount,
+                                 bool rescale) :
+        context_(context),
+        instanceId_(instanceId),
+        framesCount_(framesCount),
+        rescale_(rescale)
+      {
+      }
+
+      virtual IDynamicObject* Call() ORTHANC_OVERRIDE
+      {
+        // Number of frames that are submitted at once to the frames
+        // decoders of the plugins (new in Orthanc 1.12.12)
+        static const unsigned int FRAMES_PER_BATCH = 32;
+
+        std::unique_ptr<NumpyFrames> frames(new NumpyFrames(framesCount_, rescale_));
+        std::unique_ptr<ParsedDicomFile> header;
+
+        // First try to decode the frames by batches in the plugins,
+        // which only reads the required frames from the storage area
+        unsigned int frame = 0;
+        while (frame < framesCount_)
+        {
+          const unsigned int count = std::min(FRAMES_PER_BATCH, framesCount_ - frame);
+
+          DecodedFrames decoded;
+          if (!context_.DecodeDicomFrames(decoded, instanceId_, frame, count))
+          {
+            break;
+          }
+
+          if (header.get() == NULL)
+          {
+            std::string s;
+            if (!context_.ReadDicomUntilPixelData(s, instanceId_))
+            {
+              break;
+            }
+
+            header.reset(new ParsedDicomFile(s));
+          }
+
+          for (unsigned int i = 0; i < count; i++, frame++)
+          {
+            std::unique_ptr<ImageAccessor> image(decoded.Release(i));
+            frames->WriteDecodedFrame(*header, frame, *image);
+          }
+        }
+
+        if (frame < framesCount_)
+        {
+          ServerContext::DicomCacheLocker locker(context_, instanceId_);
+
+          for (; frame < framesCount_; frame++)
+          {
+            frames->WriteFrame(locker.GetDicom(), frame);
+          }
+        }
+
+        return frames.release();
+      }
+    };
+
+
+    // Decodes one range of the frames of a multi-frame instance, on a
+    // thread of the "FramesDecodingThreads" pool. As DCMTK cannot
+    // decode the frames of one parsed file concurrently, each range
+    // parses its own copy of the DICOM file.
+    class NumpyFramesRangeDecoder : public ICallable
+    {
+    private:
+      boost::shared_ptr<std::string>  dicom_;
+      unsigned int                    firstFrame_;
+      unsigned int                    endFrame_;
+      bool                            rescale_;
+
+    public:
+      NumpyFramesRangeDecoder(const boost::shared_ptr<std::string>& dicom,
+                              unsigned int firstFrame,
+                              unsigned int endFrame,
+                              bool rescale) :
+        dicom_(dicom),
+        firstFrame_(firstFrame),
+        endFrame_(endFrame),
+        rescale_(rescale)
+      {
+      }
+
+      virtual IDynamicObject* Call() ORTHANC_OVERRIDE
+      {
+        std::unique_ptr<NumpyFrames> frames(new NumpyFrames(endFrame_ - firstFrame_, rescale_));
+
+        ParsedDicomFile parsed(*dicom_);
+
+        for (unsigned int frame = firstFrame_; frame < endFrame_; frame++)
+        {
+          frames->WriteFrame(parsed, frame);
+        }
+
+        return frames.release();
+      }
+    };
+
+
+    // The decoded blocks are collected in the order of their
+    // submission, which is the order of the numpy array
+    void StreamNumpyFrames(NumpyStreamAnswer& answer,
+                           CallableGroup& decoders)
+    {
+      CallableGroup::Iterator iterator(decoders);
+
+      while (iterator.HasNext())
+      {
+        std::unique_ptr<IDynamicObject> frames(iterator.Next());
+        answer.AddFrames(dynamic_cast<const NumpyFrames&>(*frames));
+      }
+    }
+  }
+
+
+  static void GetNumpyFrame(RestApiGetCall& call)
+  {
+    if (call.IsDocumentation())
+    {
+      DocumentSharedNumpy(call);
+      call.GetDocumentation()
+        .SetTag("Instances")
+        .SetSummary("Decode frame for numpy")
+        .SetDescription("Decode one frame of interest from the given DICOM instance, for use with numpy in Python. "
+                        "The numpy array has 3 dimensions: (height, width, color channel).")
+        .SetUriArgument("frame", RestApiCallDocumentation::Type_Number, "Index of the frame (starts at `0`)");
+    }
+    else if (!AnswerIfInstanceNotModified(call))
+    {
+      const std::string instanceId = call.GetUriComponent("id", "");
+      const bool compress = call.GetBooleanArgument("compress", false);
+      const bool rescale = call.GetBooleanArgument("rescale", true);
+
+      uint32_t frame;
+      if (!SerializationToolbox::ParseUnsignedInteger32(frame, call.GetUriComponent("frame", "0")))
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "Expected an unsigned integer for the \"frame\" argument");
+      }
+
+      NumpyFrames frames(1, rescale);
+
+      {
+        Semaphore::Locker throttling(throttlingSemaphore_);
+        ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), instanceId);
+        
+        frames.WriteFrame(locker.GetDicom(), frame);
+      }
+
+      // A single frame is small enough to be answered at once
+      const ImageAccessor& image = frames.GetFrames();
+
+      ChunkedBuffer buffer;
+      NumpyWriter::WriteHeader(buffer, 0 /* no depth, 2D frame */, image.GetWidth(), image.GetHeight(), image.GetFormat());
+      NumpyWriter::WritePixels(buffer, image);
+
+      std::string answer;
+      NumpyWriter::Finalize(answer, buffer, compress);
+      call.GetOutput().AnswerBuffer(answer, MimeType_Binary);
+    }
+  }
+
+
+  static void GetNumpyInstance(RestApiGetCall& call)
+  {
+    if (call.IsDocumentation())
+    {
+      DocumentSharedNumpy(call);
+      call.GetDocumentation()
+        .SetTag("Instances")
+        .SetSummary("Decode instance for numpy")
+        .SetDescription("Decode the given DICOM instance, for use with numpy in Python. "
+                        "The numpy array has 4 dimensions: (frame, height, width, color channel).");
+    }
+    else if (!AnswerIfInstanceNotModified(call))
+    {
+      const std::string instanceId = call.GetUriComponent("id", "");
+      const bool compress = call.GetBooleanArgument("compress", false);
+      const bool rescale = call.GetBooleanArgument("rescale", true);
+
+      ServerContext& context = OrthancRestApi::GetContext(call);
+      boost::shared_ptr<IExecutorService> workers = context.GetFramesDecodingWorkers();
+
+      {
+        Semaphore::Locker throttling(throttlingSemaphore_);
+        ServerContext::DicomCacheLocker locker(context, instanceId);
+
+        const unsigned int depth = locker.GetDicom().GetFramesCount();
+        if (depth == 0)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat, "Empty DICOM instance");
+        }
+
+        NumpyStreamAnswer answer(call.GetOutput(), depth, compress);
+
+        if (workers.get() == NULL ||
+            depth == 1)
+        {
+          for (unsigned int frame = 0; frame < depth; frame++)
+          {
+            NumpyFrames frames(1, rescale);
+            frames.WriteFrame(locker.GetDicom(), frame);
+            answer.AddFrames(frames);
+          }
+        }
+        else
+        {
+          /**
+           * Four ranges of consecutive frames per thread, at most two
+           * ranges per thread being pending at once. This bounds both
+           * the number of copies of the parsed DICOM file, and the
+           * memory that is used by the decoded frames.
+           **/
+          const unsigned int threads = std::max(1u, context.GetFramesDecodingThreads());
+          const unsigned int countRanges = std::min(depth, 4 * threads);
+
+          boost::shared_ptr<std::string> dicom(new std::string(locker.GetBuffer()));
+
+          CallableGroup decoders(workers, 2 * threads);
+
+          for (unsigned int i = 0; i < countRanges; i++)
+          {
+            const unsigned int firstFrame = static_cast<unsigned int>(static_cast<uint64_t>(depth) * i / countRanges);
+            const unsigned int endFrame = static_cast<unsigned int>(static_cast<uint64_t>(depth) * (i + 1) / countRanges);
+            decoders.Submit(new NumpyFramesRangeDecoder(dicom, firstFrame, endFrame, rescale));
+          }
+
+          StreamNumpyFrames(answer, decoders);
+        }
+
+        answer.Close();
+      }
+    }
+  }
+
+
+  static void GetNumpySeries(RestApiGetCall& call)
+  {
+    if (call.IsDocumentation())
+    {
+      DocumentSharedNumpy(call);
+      call.GetDocumentation()
+        .SetTag("Series")
+        .SetSummary("Decode series for numpy")
+        .SetDescription("Decode the given DICOM series, for use with numpy in Python. "
+                        "The numpy array has 4 dimensions: (frame, height, width, color channel).");
+    }
+    else
     {
       const std::string seriesId = call.GetUriComponent("id", "");
       const bool compress = call.GetBooleanArgument("compress", false);
@@ -1486,25 +2058,44 @@ namespace Orthanc
       }
 
       ServerContext& context = OrthancRestApi::GetContext(call);
+      boost::shared_ptr<IExecutorService> workers = context.GetFramesDecodingWorkers();
 
-      NumpyVisitor visitor(depth, rescale);
+      // The shape of the array is known from the ordering of the
+      // slices, so the frames are streamed as soon as they are decoded
+      NumpyStreamAnswer answer(call.GetOutput(), depth, compress);
 
-      for (size_t i = 0; i < ordering.GetInstancesCount(); i++)
+      if (workers.get() == NULL)
       {
-        const std::string& instanceId = ordering.GetInstanceId(i);
-        unsigned int framesCount = ordering.GetFramesCount(i);
-
+        for (size_t i = 0; i < ordering.GetInstancesCount(); i++)
         {
-          ServerContext::DicomCacheLocker locker(context, instanceId);
+          const unsigned int framesCount = ordering.GetFramesCount(i);
+          NumpyFrames frames(framesCount, rescale);
 
-          for (unsigned int frame = 0; frame < framesCount; frame++)
           {
-            visitor.WriteFrame(locker.GetDicom(), frame);
+            ServerContext::DicomCacheLocker locker(context, ordering.GetInstanceId(i));
+
+            for (unsigned int frame = 0; frame < framesCount; frame++)
+            {
+              frames.WriteFrame(locker.GetDicom(), frame);
+            }
           }
+
+          answer.AddFrames(frames);
         }
       }
+      else
+      {
+        CallableGroup decoders(workers, 2 * context.GetFramesDecodingThreads());
+
+        for (size_t i = 0; i < ordering.GetInstancesCount(); i++)
+        {
+          decoders.Submit(new NumpySeriesInstanceDecoder(context, ordering.GetInstanceId(i), ordering.GetFramesCount(i), rescale));
+        }
+
+        StreamNumpyFrames(answer, decoders);
+      }
 
-      visitor.Answer(call.GetOutput(), compress);
+      answer.Close();
     }
   }
 
@@ -1536,6 +2127,11 @@ namespace Orthanc
       return;
     }
 
+    if (AnswerIfInstanceNotModified(call))
+    {
+      return;
+    }
+
     Semaphore::Locker locker(throttlingSemaphore_);
         
     ServerContext& context = OrthancRestApi::GetContext(call);
@@ -1594,6 +2190,11 @@ namespace Orthanc
       }
       return;
     }
+
+    if (AnswerIfInstanceNotModified(call))
+    {
+      return;
+    }
     
     std::string frameId = call.GetUriComponent("frame", "0");
 
@@ -1630,6 +2231,138 @@ namespace Orthanc
   }
 
 
+  // Parses a list of frames such as "0,3,5-9" (the ranges are
+  // inclusive), in the order of the list
+  static void ParseListOfFrames(std::vector<unsigned int>& frames,
+                                const std::string& source,
+                                unsigned int framesCount)
+  {
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, source, ',');
+
+    frames.clear();
+
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+      const std::string token = Toolbox::StripSpaces(tokens[i]);
+      const size_t dash = token.find('-');
+
+      unsigned int first, last;
+
+      try
+      {
+        if (dash == std::string::npos)
+        {
+          first = boost::lexical_cast<unsigned int>(token);
+          last = first;
+        }
+        else
+        {
+          first = boost::lexical_cast<unsigned int>(Toolbox::StripSpaces(token.substr(0, dash)));
+          last = boost::lexical_cast<unsigned int>(Toolbox::StripSpaces(token.substr(dash + 1)));
+        }
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "Badly formatted list of frames: " + source);
+      }
+
+      if (first > last ||
+          last >= framesCount)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "Frame index out of range: " + token);
+      }
+
+      for (unsigned int frame = first; frame <= last; frame++)
+      {
+        frames.push_back(frame);
+      }
+    }
+  }
+
+
+  static void GetRawFrames(RestApiGetCall& call)
+  {
+    if (call.IsDocumentation())
+    {
+      call.GetDocumentation()
+        .SetTag("Instances")
+        .SetSummary("Access raw frames")
+        .SetDescription("Access the raw content of several frames of the DICOM instance of interest, "
+                        "bypassing image decoding, in one single `multipart/related` answer whose parts "
+                        "follow the order of the requested frames. The DICOM instance is only loaded once, "
+                        "which is faster than multiple calls to `/instances/{id}/frames/{frame}/raw`.")
+        .SetUriArgument("id", "Orthanc identifier of the instance of interest")
+        .SetHttpGetArgument("frames", RestApiCallDocumentation::Type_String,
+                            "Comma-separated list of the indices of the frames (starting at `0`), possibly with "
+                            "inclusive ranges (e.g. `0,3,5-9`). By default, all the frames are returned.", false)
+        .AddAnswerType(MimeType_Binary, "The raw frames, as the parts of a `multipart/related` answer");
+      return;
+    }
+
+    if (AnswerIfInstanceNotModified(call))
+    {
+      return;
+    }
+
+    std::string publicId = call.GetUriComponent("id", "");
+
+    ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), publicId);
+    const ParsedDicomFile& dicom = locker.GetDicom();
+
+    const unsigned int framesCount = dicom.GetFramesCount();
+
+    std::vector<unsigned int> frames;
+
+    if (call.HasArgument("frames"))
+    {
+      ParseListOfFrames(frames, call.GetArgument("frames", ""), framesCount);
+    }
+    else
+    {
+      frames.resize(framesCount);
+      for (unsigned int i = 0; i < framesCount; i++)
+      {
+        frames[i] = i;
+      }
+    }
+
+    if (frames.empty())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "No frame to be returned");
+    }
+
+    const std::map<std::string, std::string> noHeader;
+
+    // The frames are written directly from the parsed DICOM file,
+    // which remains locked until the answer is sent. A copy is
+    // only made if the frame is split into several fragments.
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+      const void* buffer = NULL;
+      size_t size = 0;
+      MimeType mime;
+      std::string copy;
+
+      if (!dicom.LookupRawFrameBuffer(buffer, size, mime, frames[i]))
+      {
+        dicom.GetRawFrame(copy, mime, frames[i]);
+        buffer = copy.empty() ? NULL : copy.c_str();
+        size = copy.size();
+      }
+
+      if (i == 0)
+      {
+        call.GetOutput().StartMultipart("related", EnumerationToString(mime));
+      }
+
+      call.GetOutput().SendMultipartItem(buffer, size, noHeader);
+    }
+
+    call.GetOutput().CloseMultipart();
+  }
+
+
   template <enum ResourceType resourceType>
   static void GetResourceStatistics(RestApiGetCall& call)
   {
@@ -1960,8 +2693,7 @@ namespace Orthanc
       }
       else
       {
-        OrthancConfiguration::ReaderLock lock;
-        if (lock.GetConfiguration().HasCheckRevisions())
+        if (OrthancConfiguration::GetSnapshot()->HasCheckRevisions())
         {
           throw OrthancException(ErrorCode_Revision,
                                  "HTTP header \"If-Match\" is missing, as \"" + std::string(ORTHANC_CONFIG_CHECK_REVISIONS) + "\" is \"true\"");
@@ -2023,8 +2755,7 @@ namespace Orthanc
 
       if (!hasOldRevision)
       {
-        OrthancConfiguration::ReaderLock lock;
-        if (lock.GetConfiguration().HasCheckRevisions())
+        if (OrthancConfiguration::GetSnapshot()->HasCheckRevisions())
         {
           // "StatelessDatabaseOperations::SetMetadata()" will ignore
           // the actual value of "oldRevision" if the metadata is
@@ -2643,8 +3374,7 @@ namespace Orthanc
 
       if (!hasOldRevision)
       {
-        OrthancConfiguration::ReaderLock lock;
-        if (lock.GetConfiguration().HasCheckRevisions())
+        if (OrthancConfiguration::GetSnapshot()->HasCheckRevisions())
         {
           // "StatelessDatabaseOperations::AddAttachment()" will ignore
           // the actual value of "oldRevision" if the metadata is
@@ -2700,9 +3430,7 @@ namespace Orthanc
     }
     else
     {
-      OrthancConfiguration::ReaderLock lock;
-
-      if (lock.GetConfiguration().GetBooleanParameter("StoreDicom") &&
+      if (OrthancConfiguration::GetSnapshot()->IsStoreDicom() &&
           contentType == FileContentType_DicomAsJson)
       {
         allowed = true;
@@ -2727,8 +3455,7 @@ namespace Orthanc
       }
       else
       {
-        OrthancConfiguration::ReaderLock lock;
-        if (lock.GetConfiguration().HasCheckRevisions())
+        if (OrthancConfiguration::GetSnapshot()->HasCheckRevisions())
         {
           throw OrthancException(ErrorCode_Revision,
                                  "HTTP header \"If-Match\" is missing, as \"" + std::string(ORTHANC_CONFIG_CHECK_REVISIONS) + "\" is \"true\"");
@@ -2756,7 +3483,7 @@ namespace Orthanc
   }
 
 
-  template <enum CompressionType compression>
+  template <bool compress>
   static void ChangeAttachmentCompression(RestApiPostCall& call)
   {
     const ResourceType level = GetResourceTypeFromUri(call);
@@ -2766,10 +3493,18 @@ namespace Orthanc
       std::string r = GetResourceTypeText(level, false /* plural */, false /* upper case */);
       call.GetDocumentation()
         .SetTag(GetResourceTypeText(level, true /* plural */, true /* upper case */))
-        .SetSummary(compression == CompressionType_None ? "Uncompress attachment" : "Compress attachment")
+        .SetSummary(compress ? "Compress attachment" : "Uncompress attachment")
         .SetDescription("Change the compression scheme that is used to store an attachment.")
         .SetUriArgument("id", "Orthanc identifier of the " + r + " of interest")
         .SetUriArgument("name", "The name of the attachment, or its index (cf. `UserContentType` configuration option)");
+
+      if (compress)
+      {
+        call.GetDocumentation()
+          .AddRequestType(MimeType_PlainText, "Compression algorithm: \"Zlib\", \"Zstd\" or \"Lz4\" "
+                          "(new in Orthanc 1.12.12). If empty, the `StorageCompressionType` configuration option is used.");
+      }
+
       return;
     }
 
@@ -2777,13 +3512,37 @@ namespace Orthanc
     std::string name = call.GetUriComponent("name", "");
     FileContentType contentType = StringToContentType(name);
 
-    OrthancRestApi::GetContext(call).ChangeAttachmentCompression(level, publicId, contentType, compression);
-    call.GetOutput().AnswerBuffer("{}", MimeType_Json);
-  }
+    ServerContext& context = OrthancRestApi::GetContext(call);
 
+    CompressionType compression = CompressionType_None;
 
-  static void IsAttachmentCompressed(RestApiGetCall& call)
-  {
+    if (compress)
+    {
+      std::string body;
+      call.BodyToString(body);
+      body = Toolbox::StripSpaces(body);
+
+      if (body.empty())
+      {
+        compression = context.GetCompressionType();
+      }
+      else
+      {
+        compression = StringToCompressionType(body);
+        if (compression == CompressionType_None)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange, "Use the \"uncompress\" route to uncompress an attachment");
+        }
+      }
+    }
+
+    context.ChangeAttachmentCompression(level, publicId, contentType, compression);
+    call.GetOutput().AnswerBuffer("{}", MimeType_Json);
+  }
+
+
+  static void IsAttachmentCompressed(RestApiGetCall& call)
+  {
     const ResourceType level = GetResourceTypeFromUri(call);
 
     if (call.IsDocumentation())
@@ -2835,6 +3594,44 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    // Answer to "/tools/find", "/{resource}/shared-tags" or
+    // "/series/{id}/ordered-slices", to be stored in the cache of
+    // the lookups (new in Orthanc 1.12.12)
+    class CachedFindAnswer : public IDynamicObject
+    {
+    private:
+      Json::Value  answer_;
+      bool         hasToken_;
+      std::string  token_;
+
+    public:
+      explicit CachedFindAnswer(const Json::Value& answer) :
+        answer_(answer),
+        hasToken_(false)
+      {
+      }
+
+      void SetContinuationToken(const std::string& token)
+      {
+        hasToken_ = true;
+        token_ = token;
+      }
+
+      const Json::Value& GetAnswer() const
+      {
+        return answer_;
+      }
+
+      bool LookupContinuationToken(std::string& token) const
+      {
+        token = token_;
+        return hasToken_;
+      }
+    };
+  }
+
 
   static bool ExtractSharedTags(Json::Value& shared,
                                 ServerContext& context,
@@ -2935,11 +3732,37 @@ namespace Orthanc
     ServerContext& context = OrthancRestApi::GetContext(call);
     std::string publicId = call.GetUriComponent("id", "");
 
-    Json::Value sharedTags;
-    if (ExtractSharedTags(sharedTags, context, publicId, level))
+    if (context.HasFindAnswersCache())
+    {
+      // The shared tags are only extracted again from the DICOM
+      // files if the database index has changed (new in Orthanc 1.12.12)
+      const std::string key = "shared-tags|" + std::string(EnumerationToString(level)) + "|" + publicId;
+      const LookupAnswersCache::Stamp stamp(context.GetIndex());
+
+      boost::shared_ptr<IDynamicObject> cached = context.GetFindAnswersCache().Lookup(key, stamp);
+      if (cached.get() == NULL)
+      {
+        Json::Value sharedTags;
+        if (!ExtractSharedTags(sharedTags, context, publicId, level))
+        {
+          return;
+        }
+
+        cached.reset(new CachedFindAnswer(sharedTags));
+        context.GetFindAnswersCache().Store(key, stamp, cached);
+      }
+
+      AnswerDicomAsJson(call, dynamic_cast<const CachedFindAnswer&>(*cached).GetAnswer(),
+                        OrthancRestApi::GetDicomFormat(call, DicomToJsonFormat_Full));
+    }
+    else
     {
-      // Success: Send the value of the shared tags
-      AnswerDicomAsJson(call, sharedTags, OrthancRestApi::GetDicomFormat(call, DicomToJsonFormat_Full));
+      Json::Value sharedTags;
+      if (ExtractSharedTags(sharedTags, context, publicId, level))
+      {
+        // Success: Send the value of the shared tags
+        AnswerDicomAsJson(call, sharedTags, OrthancRestApi::GetDicomFormat(call, DicomToJsonFormat_Full));
+      }
     }
   }
 
@@ -3106,6 +3929,96 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    // Writes the JSON array of the answer to "/tools/find" as soon as
+    // the resources are expanded (new in Orthanc 1.12.12)
+    class FindStreamWriter : public ResourceFinder::IVisitor
+    {
+    private:
+      static const size_t FLUSH_SIZE = 64 * 1024;
+
+      RestApiOutput&         output_;
+      const ResourceFinder&  finder_;
+      ServerIndex&           index_;
+      DicomToJsonFormat      format_;
+      bool                   isStarted_;
+      std::string            buffer_;
+
+      void Flush()
+      {
+        if (!buffer_.empty())
+        {
+          output_.SendStreamItem(buffer_.c_str(), buffer_.size());
+          buffer_.clear();
+        }
+      }
+
+    public:
+      FindStreamWriter(RestApiOutput& output,
+                       const ResourceFinder& finder,
+                       ServerIndex& index,
+                       DicomToJsonFormat format) :
+        output_(output),
+        finder_(finder),
+        index_(index),
+        format_(format),
+        isStarted_(false)
+      {
+      }
+
+      virtual void Apply(const FindResponse::Resource& resource,
+                         const DicomMap& requestedTags) ORTHANC_OVERRIDE
+      {
+        Json::Value item;
+        finder_.Format(item, resource, requestedTags, index_, format_);
+
+        std::string s;
+        Toolbox::WriteStyledJson(s, item);
+
+        if (isStarted_)
+        {
+          buffer_ += ",\n";
+        }
+        else
+        {
+          // The HTTP headers are only sent once the first resource is
+          // available, so that the errors in the request can still be
+          // reported with a proper HTTP status
+          output_.StartStream(MIME_JSON_UTF8);
+          isStarted_ = true;
+          buffer_ = "[\n";
+        }
+
+        buffer_ += s;
+
+        if (buffer_.size() >= FLUSH_SIZE)
+        {
+          Flush();
+        }
+      }
+
+      virtual void MarkAsComplete() ORTHANC_OVERRIDE
+      {
+      }
+
+      void Close()
+      {
+        if (isStarted_)
+        {
+          buffer_ += "\n]\n";
+          Flush();
+          output_.CloseStream();
+        }
+        else
+        {
+          output_.AnswerJson(Json::arrayValue);
+        }
+      }
+    };
+  }
+
+
   enum FindType
   {
     FindType_Find,
@@ -3134,6 +4047,12 @@ namespace Orthanc
     static const char* const KEY_PARENT_SERIES = "ParentSeries";          // New in Orthanc 1.12.5
     static const char* const KEY_METADATA_QUERY = "MetadataQuery";        // New in Orthanc 1.12.5
     static const char* const KEY_RESPONSE_CONTENT = "ResponseContent";    // New in Orthanc 1.12.5
+    static const char* const KEY_CONTINUATION_TOKEN = "ContinuationToken";  // New in Orthanc 1.12.12
+    static const char* const KEY_ESTIMATE = "Estimate";                   // New in Orthanc 1.12.12
+    static const char* const KEY_EXACT_COUNT_THRESHOLD = "ExactCountThreshold";  // New in Orthanc 1.12.12
+    static const char* const KEY_EXPLAIN = "Explain";                     // New in Orthanc 1.12.12
+
+    static const uint64_t DEFAULT_EXACT_COUNT_THRESHOLD = 1000;
 
     if (call.IsDocumentation())
     {
@@ -3176,8 +4095,24 @@ namespace Orthanc
                           "Show only the resources since the provided index (in conjunction with `Limit`)", false)
           .SetRequestField(KEY_ORDER_BY, RestApiCallDocumentation::Type_JsonListOfObjects,
                           "Array of associative arrays containing the requested ordering (new in Orthanc 1.12.5)", true)
+          .SetRequestField(KEY_CONTINUATION_TOKEN, RestApiCallDocumentation::Type_String,
+                          "Use keyset pagination, in conjunction with `Limit`: provide an empty string to get the first page, "
+                          "then the `" + std::string(HEADER_CONTINUATION_TOKEN) + "` HTTP header of the previous answer. "
+                          "Each page then takes the same time, whatever its position in the results. "
+                          "Cannot be combined with `Since` or `OrderBy` (new in Orthanc 1.12.12)", false)
           .AddAnswerType(MimeType_Json, "JSON array containing either the Orthanc identifiers, or detailed information "
-                        "about the reported resources (if `Expand` argument is `true`)");
+                        "about the reported resources (if `Expand` argument is `true`)")
+          .SetAnswerHeader(HEADER_CONTINUATION_TOKEN, "Token to get the next page, if `" + std::string(KEY_CONTINUATION_TOKEN) +
+                           "` is provided and if more resources might be available (new in Orthanc 1.12.12)")
+          .SetRequestField(KEY_EXPLAIN, RestApiCallDocumentation::Type_Boolean,
+                           "If `true`, the resources are not reported. The answer rather describes how the query "
+                           "is evaluated: The number of candidate resources returned by the database (`CandidatesCount`), "
+                           "of candidates rejected afterwards by the constraints on the DICOM tags (`FilteredOutCount`), "
+                           "of matching resources (`AnswersCount`), of DICOM files read from the storage area "
+                           "(`StorageReadsCount`), the time spent in the database, in collecting the requested tags, and "
+                           "in the post-filtering that includes the reads from the storage area (`DurationsMs`), and, if "
+                           "the database engine supports it, the SQL of the lookup with its query plan (`Database`) "
+                           "(new in Orthanc 1.12.12)", false);
 
           OrthancRestApi::DocumentRequestedTags(call);
           OrthancRestApi::DocumentResponseContentAndExpand(call);
@@ -3186,7 +4121,17 @@ namespace Orthanc
           doc.SetSummary("Count local resources")
           .SetDescription("This URI can be used to count the resources that are matching criteria on the content of the local Orthanc server, "
                           "in a way that is similar to tools/find")
-          .AddAnswerType(MimeType_Json, "A JSON object with the `Count` of matching resources");
+          .SetRequestField(KEY_ESTIMATE, RestApiCallDocumentation::Type_Boolean,
+                           "If `true`, the resources are only counted exactly if there are not more matches than `" +
+                           std::string(KEY_EXACT_COUNT_THRESHOLD) + "`. Otherwise, the `Count` is a fast upper bound that "
+                           "is read from the statistics of the database (new in Orthanc 1.12.12)", false)
+          .SetRequestField(KEY_EXACT_COUNT_THRESHOLD, RestApiCallDocumentation::Type_Number,
+                           "Maximum number of matches that are exactly counted if `" + std::string(KEY_ESTIMATE) +
+                           "` is `true` (defaults to " + boost::lexical_cast<std::string>(DEFAULT_EXACT_COUNT_THRESHOLD) +
+                           ", new in Orthanc 1.12.12)", false)
+          .AddAnswerType(MimeType_Json, "A JSON object with the `Count` of matching resources. If `" + std::string(KEY_ESTIMATE) +
+                         "` is `true`, the `IsExact` field tells whether `Count` is exact, and if not, `LowerBound` "
+                         "contains a lower bound on the number of matches");
           break;
         default:
           THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_NotImplemented);
@@ -3288,6 +4233,31 @@ namespace Orthanc
       throw OrthancException(ErrorCode_BadRequest, 
                              "Field \"" + std::string(KEY_ORDER_BY) + "\" must be an array");
     }
+    else if (requestType == FindType_Count && request.isMember(KEY_ESTIMATE) &&
+             request[KEY_ESTIMATE].type() != Json::booleanValue)
+    {
+      throw OrthancException(ErrorCode_BadRequest, 
+                             "Field \"" + std::string(KEY_ESTIMATE) + "\" must be a Boolean");
+    }
+    else if (requestType == FindType_Count && request.isMember(KEY_EXACT_COUNT_THRESHOLD) &&
+             (request[KEY_EXACT_COUNT_THRESHOLD].type() != Json::intValue ||
+              request[KEY_EXACT_COUNT_THRESHOLD].asInt64() < 0))
+    {
+      throw OrthancException(ErrorCode_BadRequest, 
+                             "Field \"" + std::string(KEY_EXACT_COUNT_THRESHOLD) + "\" must be a positive integer");
+    }
+    else if (requestType == FindType_Find && request.isMember(KEY_EXPLAIN) &&
+             request[KEY_EXPLAIN].type() != Json::booleanValue)
+    {
+      throw OrthancException(ErrorCode_BadRequest, 
+                             "Field \"" + std::string(KEY_EXPLAIN) + "\" must be a Boolean");
+    }
+    else if (requestType == FindType_Find && request.isMember(KEY_CONTINUATION_TOKEN) &&
+             request[KEY_CONTINUATION_TOKEN].type() != Json::stringValue)
+    {
+      throw OrthancException(ErrorCode_BadRequest, 
+                             "Field \"" + std::string(KEY_CONTINUATION_TOKEN) + "\" must be a string");
+    }
     else if (true)
     {
       ResponseContentFlags responseContent = ResponseContentFlags_ID;
@@ -3590,15 +4560,114 @@ namespace Orthanc
           }
         }
 
-        Json::Value answer;
-        finder.Execute(answer, context, format, false /* no "Metadata" field */);
-        call.GetOutput().AnswerJson(answer);
+        if (request.isMember(KEY_CONTINUATION_TOKEN))  // New in Orthanc 1.12.12
+        {
+          if (!request.isMember(KEY_LIMIT) ||
+              request[KEY_LIMIT].asInt64() == 0)
+          {
+            throw OrthancException(ErrorCode_BadRequest,
+                                   "Field \"" + std::string(KEY_CONTINUATION_TOKEN) + "\" requires a non-zero \"" + std::string(KEY_LIMIT) + "\"");
+          }
+
+          finder.SetContinuationToken(request[KEY_CONTINUATION_TOKEN].asString());
+        }
+
+        if (request.isMember(KEY_EXPLAIN) &&
+            request[KEY_EXPLAIN].asBool())
+        {
+          // Profile the query, without the caches (new in Orthanc 1.12.12)
+          Json::Value explanation;
+          finder.Explain(explanation, context);
+          call.GetOutput().AnswerJson(explanation);
+        }
+        else if (context.GetFindStreamingPageSize() != 0 &&
+                 !request.isMember(KEY_CONTINUATION_TOKEN) &&
+                 !call.GetOutput().IsConvertJsonToXml())
+        {
+          // Stream the answer, without keeping all the resources in memory (new in Orthanc 1.12.12)
+          FindStreamWriter writer(call.GetOutput(), finder, context.GetIndex(), format);
+          finder.ExecuteByPages(writer, context, context.GetFindStreamingPageSize());
+          writer.Close();
+        }
+        else if (context.HasFindAnswersCache())
+        {
+          // The stamp of the database index must be read before
+          // running the query (new in Orthanc 1.12.12)
+          std::string key;
+          Toolbox::WriteFastJson(key, request);
+          key = "tools/find|" + key;
+
+          const LookupAnswersCache::Stamp stamp(context.GetIndex());
+
+          boost::shared_ptr<IDynamicObject> cached = context.GetFindAnswersCache().Lookup(key, stamp);
+          if (cached.get() == NULL)
+          {
+            Json::Value answer;
+            finder.Execute(answer, context, format, false /* no "Metadata" field */);
+
+            std::unique_ptr<CachedFindAnswer> computed(new CachedFindAnswer(answer));
+
+            std::string token;
+            if (finder.LookupContinuationToken(token))
+            {
+              computed->SetContinuationToken(token);
+            }
+
+            cached.reset(computed.release());
+            context.GetFindAnswersCache().Store(key, stamp, cached);
+          }
+
+          const CachedFindAnswer& answer = dynamic_cast<const CachedFindAnswer&>(*cached);
+
+          std::string token;
+          if (answer.LookupContinuationToken(token))
+          {
+            call.GetOutput().GetLowLevelOutput().AddHeader(HEADER_CONTINUATION_TOKEN, token);
+          }
+
+          call.GetOutput().AnswerJson(answer.GetAnswer());
+        }
+        else
+        {
+          RestApiJsonWriter answer(Json::arrayValue);
+          finder.Execute(answer, context, format, false /* no "Metadata" field */);
+
+          std::string token;
+          if (finder.LookupContinuationToken(token))
+          {
+            call.GetOutput().GetLowLevelOutput().AddHeader(HEADER_CONTINUATION_TOKEN, token);
+          }
+
+          call.GetOutput().AnswerJson(answer);
+        }
       }
       else if (requestType == FindType_Count)
       {
-        uint64_t count = finder.Count(context);
         Json::Value answer;
-        answer["Count"] = Json::Value::UInt64(count);
+
+        if (request.isMember(KEY_ESTIMATE) &&
+            request[KEY_ESTIMATE].asBool())
+        {
+          const uint64_t threshold = (request.isMember(KEY_EXACT_COUNT_THRESHOLD) ?
+                                      static_cast<uint64_t>(request[KEY_EXACT_COUNT_THRESHOLD].asInt64()) :
+                                      DEFAULT_EXACT_COUNT_THRESHOLD);
+
+          bool isExact;
+          uint64_t count = finder.EstimateCount(isExact, context, threshold);
+          answer["Count"] = Json::Value::UInt64(count);
+          answer["IsExact"] = isExact;
+
+          if (!isExact)
+          {
+            answer["LowerBound"] = Json::Value::UInt64(threshold + 1);
+          }
+        }
+        else
+        {
+          uint64_t count = finder.Count(context);
+          answer["Count"] = Json::Value::UInt64(count);
+        }
+
         call.GetOutput().AnswerJson(answer);
       }
       else
@@ -3662,6 +4731,250 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    /**
+     * Sends a JSON array, a JSON object, or newline-delimited JSON
+     * (NDJSON) whose items are pushed as soon as they are available,
+     * instead of building the whole JSON document in memory. In the
+     * NDJSON format, each member of an object is written as a JSON
+     * object with one single member. If XML is requested, the answer
+     * is built in memory in order to be converted. (new in Orthanc
+     * 1.12.12)
+     **/
+    class JsonItemsStreamWriter : public boost::noncopyable
+    {
+    private:
+      static const size_t FLUSH_SIZE = 64 * 1024;
+
+      RestApiOutput&  output_;
+      bool            isObject_;
+      bool            isNdJson_;
+      bool            isBuffered_;
+      Json::Value     buffered_;
+      bool            isStarted_;
+      std::string     buffer_;
+
+      void Flush()
+      {
+        if (!buffer_.empty())
+        {
+          output_.SendStreamItem(buffer_.c_str(), buffer_.size());
+          buffer_.clear();
+        }
+      }
+
+      static void Serialize(std::string& target,
+                            const Json::Value& value)
+      {
+        Toolbox::WriteFastJson(target, value);
+
+        // "Json::FastWriter" ends the serialization with a newline
+        if (!target.empty() &&
+            target[target.size() - 1] == '\n')
+        {
+          target.resize(target.size() - 1);
+        }
+      }
+
+      void Append(const std::string& item)
+      {
+        if (isNdJson_)
+        {
+          if (!isStarted_)
+          {
+            output_.StartStream(MIME_NDJSON);
+            isStarted_ = true;
+          }
+
+          buffer_ += item;
+          buffer_ += "\n";
+        }
+        else
+        {
+          if (isStarted_)
+          {
+            buffer_ += ",\n";
+          }
+          else
+          {
+            // The HTTP headers are only sent once the first item is
+            // available, so that the errors can still be reported
+            // with a proper HTTP status
+            output_.StartStream(MIME_JSON_UTF8);
+            isStarted_ = true;
+            buffer_ = (isObject_ ? "{\n" : "[\n");
+          }
+
+          buffer_ += item;
+        }
+
+        if (buffer_.size() >= FLUSH_SIZE)
+        {
+          Flush();
+        }
+      }
+
+    public:
+      static const char* const MIME_NDJSON;
+
+      JsonItemsStreamWriter(RestApiOutput& output,
+                            bool isObject,
+                            bool isNdJson) :
+        output_(output),
+        isObject_(isObject),
+        isNdJson_(isNdJson),
+        isBuffered_(!isNdJson && output.IsConvertJsonToXml()),
+        buffered_(isObject ? Json::objectValue : Json::arrayValue),
+        isStarted_(false)
+      {
+      }
+
+      void AddItem(const Json::Value& item)
+      {
+        if (isObject_)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+        else if (isBuffered_)
+        {
+          buffered_.append(item);
+        }
+        else
+        {
+          std::string s;
+          Serialize(s, item);
+          Append(s);
+        }
+      }
+
+      void AddMember(const std::string& key,
+                     const Json::Value& value)
+      {
+        if (!isObject_)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+        else if (isBuffered_)
+        {
+          buffered_[key] = value;
+        }
+        else
+        {
+          std::string s;
+
+          if (isNdJson_)
+          {
+            Json::Value item = Json::objectValue;
+            item[key] = value;
+            Serialize(s, item);
+          }
+          else
+          {
+            std::string v;
+            Serialize(s, Json::Value(key));
+            Serialize(v, value);
+            s += ": " + v;
+          }
+
+          Append(s);
+        }
+      }
+
+      void Close()
+      {
+        if (isBuffered_)
+        {
+          output_.AnswerJson(buffered_);
+        }
+        else if (isStarted_)
+        {
+          if (!isNdJson_)
+          {
+            buffer_ += (isObject_ ? "\n}\n" : "\n]\n");
+          }
+
+          Flush();
+          output_.CloseStream();
+        }
+        else if (isNdJson_)
+        {
+          output_.AnswerBuffer("", 0, MIME_NDJSON);
+        }
+        else
+        {
+          output_.AnswerJson(buffered_);
+        }
+      }
+    };
+
+    const char* const JsonItemsStreamWriter::MIME_NDJSON = "application/x-ndjson";
+
+
+    // Reads the tags of one child instance, possibly from a thread of
+    // the pool of the loaders of the lookups (new in Orthanc 1.12.12)
+    class InstanceTagsLoader : public ICallable
+    {
+    private:
+      ServerContext&                   context_;
+      boost::shared_ptr<FindResponse>  response_;
+      size_t                           index_;
+      std::set<DicomTag>               ignoreTagLength_;
+      DicomToJsonFormat                format_;
+
+    public:
+      InstanceTagsLoader(ServerContext& context,
+                         const boost::shared_ptr<FindResponse>& response,
+                         size_t index,
+                         const std::set<DicomTag>& ignoreTagLength,
+                         DicomToJsonFormat format) :
+        context_(context),
+        response_(response),
+        index_(index),
+        ignoreTagLength_(ignoreTagLength),
+        format_(format)
+      {
+      }
+
+      void Read(Json::Value& target)
+      {
+        const FindResponse::Resource& resource = response_->GetResourceByIndex(index_);
+
+        std::map<MetadataType, std::string> metadata;
+
+        const std::map<MetadataType, FindResponse::MetadataContent>& content = resource.GetMetadata(ResourceType_Instance);
+        for (std::map<MetadataType, FindResponse::MetadataContent>::const_iterator
+               it = content.begin(); it != content.end(); ++it)
+        {
+          metadata[it->first] = it->second.GetValue();
+        }
+
+        // The attachments and the metadata are taken from the single
+        // lookup of the instances, which avoids 4 more lookups per
+        // instance in the database
+        Json::Value full;
+        context_.ReadDicomAsJson(full, resource.GetIdentifier(), metadata, resource.GetAttachments(), ignoreTagLength_);
+
+        if (format_ != DicomToJsonFormat_Full)
+        {
+          Toolbox::SimplifyDicomAsJson(target, full, format_);
+        }
+        else
+        {
+          target.swap(full);
+        }
+      }
+
+      virtual IDynamicObject* Call() ORTHANC_OVERRIDE
+      {
+        Json::Value tags;
+        Read(tags);
+        return new SingleValueObject<Json::Value>(tags);
+      }
+    };
+  }
+
+
   static void GetChildInstancesTags(RestApiGetCall& call)
   {
     const ResourceType level = GetResourceTypeFromUri(call);
@@ -3679,6 +4992,8 @@ namespace Orthanc
         .SetUriArgument("id", "Orthanc identifier of the " + r + " of interest")
         .SetHttpGetArgument(IGNORE_LENGTH, RestApiCallDocumentation::Type_JsonListOfStrings,
                             "Also include the DICOM tags that are provided in this list, even if their associated value is long", false)
+        .SetHttpGetArgument(ARG_NDJSON, RestApiCallDocumentation::Type_Boolean,
+                            "If `true`, answer with newline-delimited JSON, one line per instance (new in Orthanc 1.12.12)", false)
         .AddAnswerType(MimeType_Json, "JSON object associating the Orthanc identifiers of the instances, with the values of their DICOM tags")
         .SetTruncatedJsonHttpGetSample(GetDocumentationSampleResource(level) + "/instances-tags", 5);
       return;
@@ -3691,33 +5006,65 @@ namespace Orthanc
     std::set<DicomTag> ignoreTagLength;
     ParseSetOfTags(ignoreTagLength, call, IGNORE_LENGTH);
 
-    // Retrieve all the instances of this patient/study/series
-    typedef std::list<std::string> Instances;
-    Instances instances;
+    // Retrieve all the instances of this patient/study/series, together
+    // with their metadata and attachments, in one single lookup
+    FindRequest request(ResourceType_Instance);
+    request.SetOrthancId(level, publicId);
+    request.SetRetrieveMetadata(true);
+    request.SetRetrieveAttachments(true);
 
-    context.GetIndex().GetChildInstances(instances, publicId, level);  // (*)
+    boost::shared_ptr<FindResponse> response(new FindResponse);
+    context.GetIndex().ExecuteFind(*response, request);
 
-    Json::Value result = Json::objectValue;
+    if (response->GetSize() == 0)
+    {
+      ResourceType type;
+      if (!context.GetIndex().LookupResourceType(type, publicId) ||
+          type != level)
+      {
+        throw OrthancException(ErrorCode_UnknownResource);
+      }
+    }
 
-    for (Instances::const_iterator it = instances.begin();
-         it != instances.end(); ++it)
+    // The tags of each instance are sent, then freed, before reading
+    // the next instances
+    JsonItemsStreamWriter writer(call.GetOutput(), true /* object */, call.GetBooleanArgument(ARG_NDJSON, false));
+
+    boost::shared_ptr<IExecutorService> loaders = context.GetFindLoaders();
+
+    if (loaders.get() == NULL ||
+        response->GetSize() <= 1)
+    {
+      for (size_t i = 0; i < response->GetSize(); i++)
+      {
+        Json::Value tags;
+        InstanceTagsLoader(context, response, i, ignoreTagLength, format).Read(tags);
+        writer.AddMember(response->GetResourceByIndex(i).GetIdentifier(), tags);
+      }
+    }
+    else
     {
-      Json::Value full;
-      context.ReadDicomAsJson(full, *it, ignoreTagLength);
+      // The DICOM files are read and parsed by the pool of the
+      // loaders of the lookups, with at most
+      // "GetFindLoadersPerRequest()" instances being read at once,
+      // and the answers are sent in the order of the instances
+      CallableGroup loading(loaders, context.GetFindLoadersPerRequest());
 
-      if (format != DicomToJsonFormat_Full)
+      for (size_t i = 0; i < response->GetSize(); i++)
       {
-        Json::Value simplified;
-        Toolbox::SimplifyDicomAsJson(simplified, full, format);
-        result[*it] = simplified;
+        loading.Submit(new InstanceTagsLoader(context, response, i, ignoreTagLength, format));
       }
-      else
+
+      CallableGroup::Iterator results(loading);
+      for (size_t i = 0; results.HasNext(); i++)
       {
-        result[*it] = full;
+        std::unique_ptr<IDynamicObject> tags(results.Next());
+        writer.AddMember(response->GetResourceByIndex(i).GetIdentifier(),
+                         dynamic_cast<const SingleValueObject<Json::Value>&>(*tags).GetValue());
       }
     }
-    
-    call.GetOutput().AnswerJson(result);
+
+    writer.Close();
   }
 
 
@@ -3794,6 +5141,11 @@ namespace Orthanc
       return;
     }
 
+    if (AnswerIfInstanceNotModified(call))
+    {
+      return;
+    }
+
     const std::string id = call.GetUriComponent("id", "");
     std::string pdf;
     ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), id);
@@ -3832,12 +5184,37 @@ namespace Orthanc
 
     const std::string id = call.GetUriComponent("id", "");
 
-    ServerIndex& index = OrthancRestApi::GetIndex(call);
-    SliceOrdering ordering(index, id);
+    ServerContext& context = OrthancRestApi::GetContext(call);
 
-    Json::Value result;
-    ordering.Format(result);
-    call.GetOutput().AnswerJson(result);
+    if (context.HasFindAnswersCache())
+    {
+      // The slices are only sorted again if the database index has
+      // changed (new in Orthanc 1.12.12)
+      const std::string key = "ordered-slices|" + id;
+      const LookupAnswersCache::Stamp stamp(context.GetIndex());
+
+      boost::shared_ptr<IDynamicObject> cached = context.GetFindAnswersCache().Lookup(key, stamp);
+      if (cached.get() == NULL)
+      {
+        SliceOrdering ordering(context.GetIndex(), id);
+
+        Json::Value result;
+        ordering.Format(result);
+
+        cached.reset(new CachedFindAnswer(result));
+        context.GetFindAnswersCache().Store(key, stamp, cached);
+      }
+
+      call.GetOutput().AnswerJson(dynamic_cast<const CachedFindAnswer&>(*cached).GetAnswer());
+    }
+    else
+    {
+      SliceOrdering ordering(context.GetIndex(), id);
+
+      Json::Value result;
+      ordering.Format(result);
+      call.GetOutput().AnswerJson(result);
+    }
   }
 
 
@@ -3857,6 +5234,11 @@ namespace Orthanc
       return;
     }
 
+    if (AnswerIfInstanceNotModified(call))
+    {
+      return;
+    }
+
     ServerContext& context = OrthancRestApi::GetContext(call);
 
     std::string publicId = call.GetUriComponent("id", "");
@@ -3996,6 +5378,73 @@ namespace Orthanc
   }
 
 
+  static void PrefetchSeries(RestApiPostCall& call)
+  {
+    if (call.IsDocumentation())
+    {
+      call.GetDocumentation()
+        .SetTag("Series")
+        .SetSummary("Prefetch series")
+        .SetDescription("Asynchronously load the DICOM instances of the series whose Orthanc identifier is provided "
+                        "in the URL into the storage cache, in the order of the instances in the series. This speeds "
+                        "up the subsequent accesses to the series, e.g. by viewers. The amount of data that is "
+                        "prefetched is limited to half of the storage cache. This route requires the configuration "
+                        "option \"SeriesPrefetchThreads\" to be non-zero.")
+        .SetUriArgument("id", "Orthanc identifier of the series of interest")
+        .SetAnswerField("Scheduled", RestApiCallDocumentation::Type_Boolean,
+                        "Whether the prefetching was scheduled (false if too many series are already being prefetched)");
+      return;
+    }
+
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    const std::string id = call.GetUriComponent("id", "");
+
+    ResourceType type;
+    if (!context.GetIndex().LookupResourceType(type, id) ||
+        type != ResourceType_Series)
+    {
+      throw OrthancException(ErrorCode_UnknownResource, "Unknown series: " + id);
+    }
+
+    Json::Value answer = Json::objectValue;
+    answer["Scheduled"] = context.PrefetchSeries(id);
+    call.GetOutput().AnswerJson(answer);
+  }
+
+
+  static void GetSeriesThumbnail(RestApiGetCall& call)
+  {
+    if (call.IsDocumentation())
+    {
+      call.GetDocumentation()
+        .SetTag("Series")
+        .SetSummary("Get thumbnail of series")
+        .SetDescription("Download the JPEG thumbnail of the series whose Orthanc identifier is provided in the URL. "
+                        "The thumbnail is rendered in the background once the first instances of the series are "
+                        "received, so that no pixel data is decoded by this route. This route requires the "
+                        "configuration option \"SeriesThumbnailsSize\" to be non-zero. An error 404 is returned "
+                        "if the thumbnail is not available (yet).")
+        .SetUriArgument("id", "Orthanc identifier of the series of interest")
+        .AddAnswerType(MimeType_Jpeg, "JPEG image");
+      return;
+    }
+
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    const std::string id = call.GetUriComponent("id", "");
+
+    FileInfo attachment;
+    int64_t revision;
+    if (!context.GetIndex().LookupAttachment(attachment, revision, ResourceType_Series, id, FileContentType_SeriesThumbnail))
+    {
+      throw OrthancException(ErrorCode_UnknownResource, "No thumbnail is available for series: " + id);
+    }
+
+    context.AnswerAttachment(call.GetOutput(), attachment, "");
+  }
+
+
   static void ReconstructAllResources(RestApiPostCall& call)
   {
     if (call.IsDocumentation())
@@ -4007,8 +5456,8 @@ namespace Orthanc
                         "This is notably useful after the deletion of resources whose children resources have inconsistent "
                         "values with their sibling resources. Beware that this is a highly time-consuming operation, "
                         "as all the DICOM instances will be parsed again, and as all the Orthanc index will be regenerated. "
-                        "If you have a large database to process, it is advised to use the Housekeeper plugin to perform "
-                        "this action resource by resource");
+                        "If you have a large database to process, it is advised to use `/tools/reindex`, which runs "
+                        "this action in a background job");
         DocumentReconstructFilesField(call, false);
 
       return;
@@ -4030,6 +5479,84 @@ namespace Orthanc
   }
 
 
+  static void ReindexAllResources(RestApiPostCall& call)
+  {
+    static const char* const KEY_THREADS = "Threads";
+    static const char* const KEY_BATCH_SIZE = "BatchSize";
+    static const char* const KEY_MAX_READ_RATE = "MaxReadRate";
+    static const char* const KEY_USER_DATA = "UserData";
+
+    if (call.IsDocumentation())
+    {
+      OrthancRestApi::DocumentSubmitGenericJob(call);
+      call.GetDocumentation()
+        .SetTag("System")
+        .SetSummary("Re-index all the main DICOM tags in the background")
+        .SetDescription("Start a job that reconstructs the main DICOM tags of all the DICOM instances that are stored "
+                        "in Orthanc, e.g. after a change in `ExtraMainDicomTags`. Contrarily to `/tools/reconstruct`, "
+                        "only the DICOM headers are read, the index is updated by batches of instances, and the reads "
+                        "are throttled as long as the ingest of new DICOM instances gets slower. The job resumes after "
+                        "the last processed study if Orthanc is restarted. The job is asynchronous by default.")
+        .SetRequestField(KEY_THREADS, RestApiCallDocumentation::Type_Number,
+                         "Number of threads that read the DICOM headers. Default value is `ReindexingThreads`.", false)
+        .SetRequestField(KEY_BATCH_SIZE, RestApiCallDocumentation::Type_Number,
+                         "Number of instances that are updated by one database transaction. "
+                         "Default value is `ReindexingBatchSize`.", false)
+        .SetRequestField(KEY_MAX_READ_RATE, RestApiCallDocumentation::Type_Number,
+                         "Maximum rate in MB/s at which the DICOM headers are read, `0` means no limit. "
+                         "Default value is `ReindexingMaxReadRate`.", false)
+        .SetRequestField(KEY_USER_DATA, RestApiCallDocumentation::Type_JsonObject,
+                         "User data that will travel along with the job.", false);
+      return;
+    }
+
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    Json::Value request = Json::objectValue;
+    if (call.GetBodySize() > 0 &&
+        (!call.ParseJsonRequest(request) ||
+         request.type() != Json::objectValue))
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "The body must be empty or contain a JSON object");
+    }
+
+    unsigned int threads, batchSize, maxReadRate;
+
+    {
+      OrthancConfiguration::ReaderLock lock;
+      threads = lock.GetConfiguration().GetUnsignedIntegerParameter("ReindexingThreads");
+      batchSize = lock.GetConfiguration().GetUnsignedIntegerParameter("ReindexingBatchSize");
+      maxReadRate = lock.GetConfiguration().GetUnsignedIntegerParameter("ReindexingMaxReadRate");
+    }
+
+    if (request.isMember(KEY_THREADS))
+    {
+      threads = SerializationToolbox::ReadUnsignedInteger(request, KEY_THREADS);
+    }
+
+    if (request.isMember(KEY_BATCH_SIZE))
+    {
+      batchSize = SerializationToolbox::ReadUnsignedInteger(request, KEY_BATCH_SIZE);
+    }
+
+    if (request.isMember(KEY_MAX_READ_RATE))
+    {
+      maxReadRate = SerializationToolbox::ReadUnsignedInteger(request, KEY_MAX_READ_RATE);
+    }
+
+    std::unique_ptr<ReindexingJob> job(new ReindexingJob(context, std::max(1u, threads), std::max(1u, batchSize),
+                                                         static_cast<uint64_t>(maxReadRate) * 1024 * 1024));
+    job->SetDescription("REST API");
+
+    if (request.isMember(KEY_USER_DATA))
+    {
+      job->SetUserData(request[KEY_USER_DATA]);
+    }
+
+    OrthancRestApi::GetApi(call).SubmitGenericJob(call, job.release(), false /* asynchronous by default */, request);
+  }
+
+
   static void GetBulkChildren(std::set<std::string>& target,
                               ServerIndex& index,
                               ResourceType level,
@@ -4052,10 +5579,117 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    // Expands one resource of "/tools/bulk-content", possibly from a
+    // thread of the pool of the loaders of the lookups (new in Orthanc
+    // 1.12.12). The result is a null JSON value if the resource was
+    // deleted in the meantime.
+    class BulkContentLoader : public ICallable
+    {
+    private:
+      ServerContext&     context_;
+      ResourceType       level_;
+      std::string        identifier_;
+      DicomToJsonFormat  format_;
+      bool               metadata_;
+
+    public:
+      BulkContentLoader(ServerContext& context,
+                        ResourceType level,
+                        const std::string& identifier,
+                        DicomToJsonFormat format,
+                        bool metadata) :
+        context_(context),
+        level_(level),
+        identifier_(identifier),
+        format_(format),
+        metadata_(metadata)
+      {
+      }
+
+      void Expand(Json::Value& target)
+      {
+        if (!ExpandResource(target, context_, level_, identifier_, format_, metadata_))
+        {
+          CLOG(INFO, HTTP) << "Unknown resource during a bulk content retrieval: " << identifier_;
+          target = Json::nullValue;
+        }
+      }
+
+      virtual IDynamicObject* Call() ORTHANC_OVERRIDE
+      {
+        Json::Value item;
+        Expand(item);
+        return new SingleValueObject<Json::Value>(item);
+      }
+    };
+  }
+
+
+  typedef std::list< std::pair<ResourceType, std::string> >  BulkResources;
+
+  static void SendBulkContent(RestApiOutput& output,
+                              ServerContext& context,
+                              const BulkResources& resources,
+                              DicomToJsonFormat format,
+                              bool metadata,
+                              bool isNdJson)
+  {
+    JsonItemsStreamWriter writer(output, false /* array */, isNdJson);
+
+    boost::shared_ptr<IExecutorService> loaders = context.GetFindLoaders();
+
+    if (loaders.get() == NULL ||
+        resources.size() <= 1)
+    {
+      for (BulkResources::const_iterator it = resources.begin(); it != resources.end(); ++it)
+      {
+        Json::Value item;
+        BulkContentLoader(context, it->first, it->second, format, metadata).Expand(item);
+
+        if (item.type() != Json::nullValue)
+        {
+          writer.AddItem(item);
+        }
+      }
+    }
+    else
+    {
+      // The resources are expanded by the pool of the loaders of the
+      // lookups, with at most "GetFindLoadersPerRequest()" resources
+      // being expanded at once, and sent in the order of the request.
+      // No deadlock can occur, as "ExpandResource()" requests no tag,
+      // hence never submits a loader to this pool by itself.
+      CallableGroup loading(loaders, context.GetFindLoadersPerRequest());
+
+      for (BulkResources::const_iterator it = resources.begin(); it != resources.end(); ++it)
+      {
+        loading.Submit(new BulkContentLoader(context, it->first, it->second, format, metadata));
+      }
+
+      CallableGroup::Iterator results(loading);
+      while (results.HasNext())
+      {
+        std::unique_ptr<IDynamicObject> item(results.Next());
+
+        const Json::Value& value = dynamic_cast<const SingleValueObject<Json::Value>&>(*item).GetValue();
+        if (value.type() != Json::nullValue)
+        {
+          writer.AddItem(value);
+        }
+      }
+    }
+
+    writer.Close();
+  }
+
+
   static void BulkContent(RestApiPostCall& call)
   {
     static const char* const LEVEL = "Level";
     static const char* const METADATA = "Metadata";
+    static const char* const NDJSON = "NDJSON";
 
     if (call.IsDocumentation())
     {
@@ -4072,6 +5706,9 @@ namespace Orthanc
                          "downward in the DICOM hierarchy in order to find the level of interest.", false)
         .SetRequestField(METADATA, RestApiCallDocumentation::Type_Boolean,
                          "If set to `true` (default value), the metadata associated with the resources will also be retrieved.", false)
+        .SetRequestField(NDJSON, RestApiCallDocumentation::Type_Boolean,
+                         "If set to `true`, answer with newline-delimited JSON, one line per resource "
+                         "(new in Orthanc 1.12.12)", false)
         .SetDescription("Get the content all the DICOM patients, studies, series or instances "
                         "whose identifiers are provided in the `Resources` field, in one single call.");
       return;
@@ -4094,9 +5731,15 @@ namespace Orthanc
         metadata = SerializationToolbox::ReadBoolean(request, METADATA);
       }
 
+      bool isNdJson = false;
+      if (request.isMember(NDJSON))
+      {
+        isNdJson = SerializationToolbox::ReadBoolean(request, NDJSON);
+      }
+
       ServerIndex& index = OrthancRestApi::GetIndex(call);
       
-      Json::Value answer = Json::arrayValue;
+      BulkResources toExpand;
 
       if (request.isMember(LEVEL))
       {
@@ -4188,11 +5831,7 @@ namespace Orthanc
         for (std::set<std::string>::const_iterator
                it = interest.begin(); it != interest.end(); ++it)
         {
-          Json::Value item;
-          if (ExpandResource(item, OrthancRestApi::GetContext(call), level, *it, format, metadata))
-          {
-            answer.append(item);
-          }
+          toExpand.push_back(std::make_pair(level, *it));
         }
       }
       else
@@ -4205,12 +5844,10 @@ namespace Orthanc
                it = resources.begin(); it != resources.end(); ++it)
         {
           ResourceType level;
-          Json::Value item;
 
-          if (index.LookupResourceType(level, *it) &&
-              ExpandResource(item, OrthancRestApi::GetContext(call), level, *it, format, metadata))
+          if (index.LookupResourceType(level, *it))
           {
-            answer.append(item);
+            toExpand.push_back(std::make_pair(level, *it));
           }
           else
           {
@@ -4219,7 +5856,9 @@ namespace Orthanc
         }
       }
 
-      call.GetOutput().AnswerJson(answer);
+      // The resources are expanded, then streamed, by the pool of the
+      // loaders of the lookups (new in Orthanc 1.12.12)
+      SendBulkContent(call.GetOutput(), OrthancRestApi::GetContext(call), toExpand, format, metadata, isNdJson);
     }
   }
 
@@ -4357,6 +5996,8 @@ namespace Orthanc
       Register("/patients/{id}/module", GetModule<ResourceType_Patient, DicomModule_Patient>);
     }
     Register("/series/{id}/module", GetModule<ResourceType_Series, DicomModule_Series>);
+    Register("/series/{id}/prefetch", PrefetchSeries);
+    Register("/series/{id}/thumbnail", GetSeriesThumbnail);
     Register("/studies/{id}/module", GetModule<ResourceType_Study, DicomModule_Study>);
     Register("/studies/{id}/module-patient", GetModule<ResourceType_Study, DicomModule_Patient>);
 
@@ -4375,6 +6016,7 @@ namespace Orthanc
     Register("/instances/{id}/frames/{frame}/matlab", GetMatlabImage);
     Register("/instances/{id}/frames/{frame}/raw", GetRawFrame<false>);
     Register("/instances/{id}/frames/{frame}/raw.gz", GetRawFrame<true>);
+    Register("/instances/{id}/raw-frames", GetRawFrames);  // New in Orthanc 1.12.12
     Register("/instances/{id}/frames/{frame}/numpy", GetNumpyFrame);  // New in Orthanc 1.10.0
     Register("/instances/{id}/pdf", ExtractPdf);
     Register("/instances/{id}/preview", GetImage<ImageExtractionMode_Preview>);
@@ -4448,8 +6090,8 @@ namespace Orthanc
       {
         Register("/" + resourceTypes[i] + "/{id}/attachments/{name}", DeleteAttachment);
         Register("/" + resourceTypes[i] + "/{id}/attachments/{name}", UploadAttachment);
-        Register("/" + resourceTypes[i] + "/{id}/attachments/{name}/compress", ChangeAttachmentCompression<CompressionType_ZlibWithSize>);
-        Register("/" + resourceTypes[i] + "/{id}/attachments/{name}/uncompress", ChangeAttachmentCompression<CompressionType_None>);
+        Register("/" + resourceTypes[i] + "/{id}/attachments/{name}/compress", ChangeAttachmentCompression<true>);
+        Register("/" + resourceTypes[i] + "/{id}/attachments/{name}/uncompress", ChangeAttachmentCompression<false>);
       }
     }
 
@@ -4507,6 +6149,7 @@ namespace Orthanc
       Register("/series/{id}/reconstruct", ReconstructResource<ResourceType_Series>);
       Register("/instances/{id}/reconstruct", ReconstructResource<ResourceType_Instance>);
       Register("/tools/reconstruct", ReconstructAllResources);
+      Register("/tools/reindex", ReindexAllResources);  // New in Orthanc 1.12.12
     }
     else
     {
@@ -25,13 +25,20 @@
 #include "OrthancRestApi.h"
 
 #include "../../../OrthancFramework/Sources/Constants.h"
+#include "../../../OrthancFramework/Sources/CpuProfiler.h"
 #include "../../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
+#include "../../../OrthancFramework/Sources/ElapsedTimer.h"
+#include "../../../OrthancFramework/Sources/HttpServer/FilesystemHttpSender.h"
 #include "../../../OrthancFramework/Sources/MetricsRegistry.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/LockProfiler.h"
+#include "../../../OrthancFramework/Sources/SerializationToolbox.h"
 #include "../../Plugins/Engine/OrthancPlugins.h"
 #include "../../Plugins/Engine/PluginsManager.h"
+#include "../MemoryAllocator.h"
 #include "../OrthancConfiguration.h"
 #include "../OrthancInitialization.h"
 #include "../ServerContext.h"
+#include "../ServerJobs/ThreadedInstancesLoader.h"
 
 #include <boost/algorithm/string/predicate.hpp>
 
@@ -88,6 +95,7 @@ namespace Orthanc
     static const char* const HAS_QUEUES = "HasQueues";
     static const char* const HAS_EXTENDED_FIND = "HasExtendedFind";
     static const char* const HAS_RESERVE_QUEUE_VALUE = "HasReserveQueueValue";
+    static const char* const HAS_READ_REPLICAS = "HasReadReplicas";
 
     if (call.IsDocumentation())
     {
@@ -121,6 +129,8 @@ namespace Orthanc
                         "The list of MainDicomTags saved in DB for each resource level (new in Orthanc 1.11.0)")
         .SetAnswerField(ORTHANC_CONFIG_STORAGE_COMPRESSION, RestApiCallDocumentation::Type_Boolean,
                         "Whether storage compression is enabled (new in Orthanc 1.11.0)")
+        .SetAnswerField(ORTHANC_CONFIG_STORAGE_COMPRESSION_TYPE, RestApiCallDocumentation::Type_String,
+                        "The compression algorithm used for new attachments if storage compression is enabled (new in Orthanc 1.12.12)")
         .SetAnswerField(ORTHANC_CONFIG_OVERWRITE_INSTANCES, RestApiCallDocumentation::Type_Boolean,
                         "Whether instances are overwritten when re-ingested (new in Orthanc 1.11.0 and kept as a bool for backward compatibility)")
         .SetAnswerField(OVERWRITE_INSTANCES_MODE, RestApiCallDocumentation::Type_String,
@@ -144,7 +154,7 @@ namespace Orthanc
         .SetAnswerField(CAPABILITIES, RestApiCallDocumentation::Type_JsonObject,
                         "Whether the database back-end supports optional features like 'HasExtendedChanges', 'HasExtendedFind' "
                         "(new in Orthanc 1.12.5), 'HasKeyValueStores', 'HasQueues' (new in Orthanc 1.12.8), "
-                        "and 'HasReserveQueueValue' (new in Orthanc 1.12.10)")
+                        "'HasReserveQueueValue' (new in Orthanc 1.12.10), and 'HasReadReplicas' (new in Orthanc 1.12.12)")
         .SetAnswerField(ORTHANC_CONFIG_READ_ONLY, RestApiCallDocumentation::Type_Boolean,
                         "Whether Orthanc is running in read only mode (new in Orthanc 1.12.5)")
         .SetAnswerField(ORTHANC_CONFIG_PATIENT_LEVEL_ENABLED, RestApiCallDocumentation::Type_Boolean,
@@ -170,6 +180,10 @@ namespace Orthanc
       result[ORTHANC_CONFIG_HTTP_PORT] = lock.GetConfiguration().GetHttpPort();
       result[ORTHANC_CONFIG_CHECK_REVISIONS] = lock.GetConfiguration().HasCheckRevisions();  // New in Orthanc 1.9.2
       result[ORTHANC_CONFIG_MAXIMUM_STORAGE_CACHE_SIZE] = lock.GetConfiguration().GetMaximumStorageCacheSize(); // New in Orthanc 1.12.12
+      result[ORTHANC_CONFIG_STORAGE_CACHE_SHARDS] = lock.GetConfiguration().GetStorageCacheShards(); // New in Orthanc 1.12.12
+      result[ORTHANC_CONFIG_STORAGE_CACHE_POLICY] = lock.GetConfiguration().GetStorageCachePolicy(); // New in Orthanc 1.12.12
+      result[ORTHANC_CONFIG_MAXIMUM_DICOM_HEADER_CACHE_SIZE] = lock.GetConfiguration().GetMaximumDicomHeaderCacheSize(); // New in Orthanc 1.12.12
+      result[ORTHANC_CONFIG_MAXIMUM_STORAGE_DISK_CACHE_SIZE] = lock.GetConfiguration().GetMaximumStorageDiskCacheSize(); // New in Orthanc 1.12.12
       result[ORTHANC_CONFIG_STORE_MD5_FOR_ATTACHMENTS] = lock.GetConfiguration().HasStoreMD5ForAttachments(); // New in Orthanc 1.12.12
       result[ORTHANC_CONFIG_STORAGE_COMPRESSION] = lock.GetConfiguration().HasStorageCompression(); // New in Orthanc 1.11.0
       result[ORTHANC_CONFIG_DATABASE_SERVER_IDENTIFIER] = lock.GetConfiguration().GetDatabaseServerIdentifier();
@@ -192,6 +206,7 @@ namespace Orthanc
     result[ORTHANC_CONFIG_OVERWRITE_INSTANCES] = context.IsOverwriteInstances(); // New in Orthanc 1.11.0
     result[OVERWRITE_INSTANCES_MODE] = EnumerationToString(context.GetOverwriteInstances()); // New in Orthanc 1.12.12
     result[ORTHANC_CONFIG_PATIENT_LEVEL_ENABLED] = context.IsPatientLevelEnabled(); // New in Orthanc 1.12.11
+    result[ORTHANC_CONFIG_STORAGE_COMPRESSION_TYPE] = EnumerationToString(context.GetCompressionType()); // New in Orthanc 1.12.12
 
     result[STORAGE_AREA_PLUGIN] = Json::nullValue;
     result[DATABASE_BACKEND_PLUGIN] = Json::nullValue;
@@ -227,6 +242,7 @@ namespace Orthanc
     result[CAPABILITIES][HAS_KEY_VALUE_STORES] = OrthancRestApi::GetIndex(call).HasKeyValueStoresSupport();
     result[CAPABILITIES][HAS_QUEUES] = OrthancRestApi::GetIndex(call).HasQueuesSupport();
     result[CAPABILITIES][HAS_RESERVE_QUEUE_VALUE] = OrthancRestApi::GetIndex(call).HasReserveQueueValueSupport();
+    result[CAPABILITIES][HAS_READ_REPLICAS] = OrthancRestApi::GetIndex(call).GetDatabaseCapabilities().HasReadReplicasSupport();
     
     call.GetOutput().AnswerJson(result);
   }
@@ -712,6 +728,14 @@ namespace Orthanc
         .SetDescription("List all the available jobs")
         .SetHttpGetArgument("expand", RestApiCallDocumentation::Type_String,
                             "If present, retrieve detailed information about the individual jobs", false)
+        .SetHttpGetArgument("state", RestApiCallDocumentation::Type_String,
+                            "Only list the jobs in this state (`Pending`, `Running`, `Success`, `Failure`, "
+                            "`Paused` or `Retry`). The pending jobs are sorted by decreasing priority, and "
+                            "the completed jobs by completion time. (new in Orthanc 1.12.12)", false)
+        .SetHttpGetArgument("since", RestApiCallDocumentation::Type_Number,
+                            "Show only the jobs since the provided index, requires `state` (new in Orthanc 1.12.12)", false)
+        .SetHttpGetArgument("limit", RestApiCallDocumentation::Type_Number,
+                            "Limit the number of results, requires `state` (new in Orthanc 1.12.12)", false)
         .AddAnswerType(MimeType_Json, "JSON array containing either the jobs identifiers, or detailed information "
                        "about the reported jobs (if `expand` argument is provided)")
         .SetTruncatedJsonHttpGetSample("https://orthanc.uclouvain.be/demo/jobs", 3);
@@ -722,10 +746,42 @@ namespace Orthanc
 
     Json::Value v = Json::arrayValue;
 
-    std::set<std::string> jobs;
-    OrthancRestApi::GetContext(call).GetJobsEngine().GetRegistry().ListJobs(jobs);
+    std::list<std::string> jobs;
 
-    for (std::set<std::string>::const_iterator it = jobs.begin();
+    if (call.HasArgument("state"))
+    {
+      const JobState state = StringToJobState(call.GetArgument("state", ""));
+
+      size_t since = 0;
+      size_t limit = 0;
+
+      try
+      {
+        since = boost::lexical_cast<size_t>(call.GetArgument("since", "0"));
+        limit = boost::lexical_cast<size_t>(call.GetArgument("limit", "0"));
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange,
+                               "Bad value for the \"since\" or \"limit\" argument in: " + call.FlattenUri());
+      }
+
+      OrthancRestApi::GetContext(call).GetJobsEngine().GetRegistry().ListJobs(jobs, state, since, limit);
+    }
+    else if (call.HasArgument("since") ||
+             call.HasArgument("limit"))
+    {
+      throw OrthancException(ErrorCode_BadRequest,
+                             "Missing \"state\" argument for GET request against: " + call.FlattenUri());
+    }
+    else
+    {
+      std::set<std::string> tmp;
+      OrthancRestApi::GetContext(call).GetJobsEngine().GetRegistry().ListJobs(tmp);
+      jobs.assign(tmp.begin(), tmp.end());
+    }
+
+    for (std::list<std::string>::const_iterator it = jobs.begin();
          it != jobs.end(); ++it)
     {
       if (expand)
@@ -747,6 +803,120 @@ namespace Orthanc
     call.GetOutput().AnswerJson(v);
   }
 
+  static void StreamJobsEvents(RestApiGetCall& call)
+  {
+    if (call.IsDocumentation())
+    {
+      call.GetDocumentation()
+        .SetTag("Jobs")
+        .SetSummary("Stream the changes of the jobs")
+        .SetDescription("Stream the changes in the state, the progress and the priority of the jobs, using "
+                        "server-sent events (SSE). Each `job` event contains the same JSON object as "
+                        "`/jobs/{id}`, and a `removed` event is sent once a job is removed from the history. "
+                        "The changes of one job are coalesced, so that at most one event per job is sent per "
+                        "interval. Each listener holds one HTTP thread of Orthanc. (new in Orthanc 1.12.12)")
+        .SetHttpGetArgument("interval", RestApiCallDocumentation::Type_Number,
+                            "Minimum delay between two events about the same job, in milliseconds (defaults to 500)", false)
+        .SetHttpGetArgument("timeout", RestApiCallDocumentation::Type_Number,
+                            "Close the stream after this number of seconds, the client can reconnect afterward "
+                            "(defaults to 0, meaning no timeout)", false)
+        .SetHttpGetArgument("expand", RestApiCallDocumentation::Type_String,
+                            "If present, include the `Content` of the jobs in the events", false)
+        .AddAnswerType(MimeType_PlainText, "Stream of server-sent events (`text/event-stream`)");
+      return;
+    }
+
+    // Comment lines are sent while nothing happens, to detect the
+    // clients that have disconnected
+    static const unsigned int KEEP_ALIVE = 15000;  // In milliseconds
+
+    const unsigned int interval = std::min(60000u, call.GetUnsignedInteger32Argument("interval", 500));
+    const unsigned int timeout = call.GetUnsignedInteger32Argument("timeout", 0);
+    const bool expand = call.HasArgument("expand") && call.GetBooleanArgument("expand", true);
+
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    // The listener is registered before the stream starts, so that no
+    // change is missed by clients that list "/jobs" once connected
+    JobsEventsHub::Listener listener(context.GetJobsEventsHub());
+
+    RestApiOutput& output = call.GetOutput();
+    output.StartStream("text/event-stream");
+
+    try
+    {
+      const std::string hello = ": connected\n\n";
+      output.SendStreamItem(hello.c_str(), hello.size());
+
+      ElapsedTimer timer;
+      std::set<std::string> changedJobs;
+
+      while (listener.WaitChanges(changedJobs, KEEP_ALIVE))
+      {
+        std::string events;
+
+        if (changedJobs.empty())
+        {
+          events = ": keep-alive\n\n";
+        }
+
+        for (std::set<std::string>::const_iterator it = changedJobs.begin(); it != changedJobs.end(); ++it)
+        {
+          JobInfo info;
+          Json::Value json;
+          std::string s;
+
+          if (context.GetJobsEngine().GetRegistry().GetJobInfo(info, *it))
+          {
+            info.Format(json);
+
+            if (!expand)
+            {
+              json.removeMember("Content");
+            }
+
+            Toolbox::WriteFastJson(s, json);
+            events += "event: job\ndata: " + Toolbox::StripSpaces(s) + "\n\n";
+          }
+          else
+          {
+            json["ID"] = *it;
+            Toolbox::WriteFastJson(s, json);
+            events += "event: removed\ndata: " + Toolbox::StripSpaces(s) + "\n\n";
+          }
+        }
+
+        output.SendStreamItem(events.c_str(), events.size());
+
+        if (timeout != 0 &&
+            timer.GetElapsedMilliseconds() >= static_cast<uint64_t>(timeout) * 1000)
+        {
+          break;
+        }
+
+        if (!changedJobs.empty())
+        {
+          // Coalesce the next changes of the jobs
+          boost::this_thread::sleep(boost::posix_time::milliseconds(interval));
+        }
+      }
+    }
+    catch (OrthancException& e)
+    {
+      if (e.GetErrorCode() == ErrorCode_NetworkProtocol)
+      {
+        LOG(INFO) << "A client listening to the events of the jobs has disconnected";
+      }
+      else
+      {
+        LOG(ERROR) << "Error while streaming the events of the jobs: " << e.What();
+      }
+    }
+
+    output.CloseStream();
+  }
+
+
   static void GetJobInfo(RestApiGetCall& call)
   {
     if (call.IsDocumentation())
@@ -827,9 +997,12 @@ namespace Orthanc
         .SetTag("Jobs")
         .SetSummary("Get job output")
         .SetDescription("Retrieve some output produced by a job. As of Orthanc 1.8.2, only the jobs that generate a "
-                        "DICOMDIR media or a ZIP archive provide such an output (with `key` equals to `archive`).")
+                        "DICOMDIR media or a ZIP archive provide such an output (with `key` equals to `archive`). "
+                        "Since Orthanc 1.12.12, the archives are streamed from the disk, and the `Range` HTTP header "
+                        "can be used to resume an interrupted download.")
         .SetUriArgument("id", "Identifier of the job of interest")
         .SetUriArgument("key", "Name of the output of interest")
+        .SetHttpHeader("Range", "Single range of bytes to be downloaded, e.g. `bytes=1000-` (new in Orthanc 1.12.12)")
         .AddAnswerType(MimeType_Binary, "Content of the output of the job");
       return;
     }
@@ -837,6 +1010,32 @@ namespace Orthanc
     std::string job = call.GetUriComponent("id", "");
     std::string key = call.GetUriComponent("key", "");
 
+    {
+      // New in Orthanc 1.12.12: The outputs that are spooled on the
+      // disk are streamed, without reading them into memory
+      JobOutputsStore::Accessor accessor(OrthancRestApi::GetContext(call).GetJobOutputs(), job, key);
+
+      if (accessor.IsValid())
+      {
+        FilesystemHttpSender sender(accessor.GetFile().GetPath(), accessor.GetMimeType());
+        sender.SetContentFilename(accessor.GetFilename());
+
+        uint64_t start, end;
+        if (HttpToolbox::ParseByteRange(start, end, call.GetHttpHeader("range", ""), sender.GetFileSize()))
+        {
+          sender.SetRange(start, end);
+          call.GetOutput().AnswerPartialContent(sender, start, sender.GetFileSize());
+        }
+        else
+        {
+          call.GetOutput().GetLowLevelOutput().AddHeader("Accept-Ranges", "bytes");
+          call.GetOutput().AnswerStream(sender);
+        }
+
+        return;
+      }
+    }
+
     std::string value;
     MimeType mime;
     std::string filename;
@@ -995,6 +1194,9 @@ namespace Orthanc
     unsigned int jobsPending, jobsRunning;
     context.GetJobsEngine().GetRegistry().GetStatistics(jobsPending, jobsRunning);
 
+    uint64_t loaders, loaderQueuedInstances, loaderLoadingInstances;
+    ThreadedInstancesLoader::GetGlobalStatistics(loaders, loaderQueuedInstances, loaderLoadingInstances);
+
     int64_t serverUpTime = context.GetServerUpTime();
     Json::Value lastChange;
     context.GetIndex().GetLastChange(lastChange);
@@ -1008,10 +1210,22 @@ namespace Orthanc
     registry.SetIntegerValue("orthanc_count_instances", static_cast<int64_t>(countInstances));
     registry.SetIntegerValue("orthanc_jobs_pending", jobsPending);
     registry.SetIntegerValue("orthanc_jobs_running", jobsRunning);
+    registry.SetIntegerValue("orthanc_loaders_count", static_cast<int64_t>(loaders));
+    registry.SetIntegerValue("orthanc_loaders_queued_instances", static_cast<int64_t>(loaderQueuedInstances));
+    registry.SetIntegerValue("orthanc_loaders_loading_instances", static_cast<int64_t>(loaderLoadingInstances));
+    registry.SetIntegerValue("orthanc_loaders_memory_bytes", static_cast<int64_t>(ThreadedInstancesLoader::GetGlobalMemoryUsage()));
     registry.SetIntegerValue("orthanc_up_time_s", serverUpTime);
     registry.SetIntegerValue("orthanc_last_change", lastChange["Last"].asInt64());
 
+    {
+      MemoryAllocator::Statistics memory;
+      MemoryAllocator::GetStatistics(memory, true);
+      memory.PublishMetrics(registry);
+    }
+
     context.PublishCacheMetrics();
+    context.GetIndex().PublishMetrics(registry);
+    LockProfiler::PublishMetrics(registry);  // No-op if "ENABLE_LOCK_PROFILING" is OFF
 
     std::string s;
     registry.ExportPrometheusText(s);
@@ -1058,6 +1272,172 @@ namespace Orthanc
   }
 
 
+  static void GetCaches(RestApiGetCall& call)
+  {
+    if (call.IsDocumentation())
+    {
+      call.GetDocumentation()
+        .SetTag("System")
+        .SetSummary("Get statistics about the caches")
+        .SetDescription("Get the statistics about the caches of Orthanc: `storage`, `dicom-headers`, "
+                        "`storage-disk` (if enabled), `parsed-dicom`, `query-retrieve`, `media`, "
+                        "`transcoding`, `find-answers` (if enabled), `rendered-frames` and `rendered-frames-disk` "
+                        "(if enabled). For each cache, the answer contains "
+                        "the number of `Entries`, the `Size` and `MaximumSize` in bytes (the archives and the "
+                        "`find-answers` cache report `MaximumEntries` instead), "
+                        "the number of `Hits`, `Misses` and `Evictions`, and the `AverageLoadTime` in "
+                        "milliseconds of the items after a miss. The transcoded instances are stored in "
+                        "the `storage` cache. New in Orthanc 1.12.12.")
+        .AddAnswerType(MimeType_Json, "JSON object mapping the name of each cache to its statistics");
+      return;
+    }
+
+    Json::Value answer;
+    OrthancRestApi::GetContext(call).GetCachesStatistics(answer);
+    call.GetOutput().AnswerJson(answer);
+  }
+
+
+  static void GetMemory(RestApiGetCall& call)
+  {
+    if (call.IsDocumentation())
+    {
+      call.GetDocumentation()
+        .SetTag("System")
+        .SetSummary("Get statistics about the memory allocator")
+        .SetDescription("Get the statistics reported by the memory allocator that is linked with Orthanc "
+                        "(`system`, `jemalloc`, or `mimalloc`): the `AllocatedBytes` that are in use, the "
+                        "`ResidentBytes` that were obtained from the system, the `FragmentedBytes` that are "
+                        "retained by the allocator without being used, and the number of `Arenas`. The "
+                        "`TrimmingThreshold` is the value of the `MemoryTrimmingThreshold` option in MB. The "
+                        "statistics that are not reported by the allocator are omitted. "
+                        "New in Orthanc 1.12.12.")
+        .AddAnswerType(MimeType_Json, "JSON object containing the statistics");
+      return;
+    }
+
+    MemoryAllocator::Statistics statistics;
+    MemoryAllocator::GetStatistics(statistics, true);
+
+    Json::Value answer;
+    statistics.Format(answer);
+
+    {
+      OrthancConfiguration::ReaderLock lock;
+      answer["TrimmingThreshold"] = lock.GetConfiguration().GetMemoryTrimmingThreshold();
+    }
+
+    call.GetOutput().AnswerJson(answer);
+  }
+
+
+  static void RecordCpuProfile(RestApiPostCall& call)
+  {
+    static const char* const KEY_DURATION = "Duration";
+    static const char* const KEY_FREQUENCY = "Frequency";
+
+    if (call.IsDocumentation())
+    {
+      call.GetDocumentation()
+        .SetTag("System")
+        .SetSummary("Record a CPU profile")
+        .SetDescription("Sample the call stacks of all the threads of Orthanc that consume CPU time, during "
+                        "the given duration, then answer the profile as collapsed stacks: Each line contains "
+                        "the name of the thread and the functions from the root of the stack, separated by "
+                        "semicolons, followed by the number of samples. This format can be turned into a "
+                        "flame graph. This route is disabled by default, and can be enabled thanks to the "
+                        "`CpuProfilingEnabled` configuration option. It is only available on Linux, if Orthanc "
+                        "is built with the `ENABLE_CPU_PROFILER` CMake option. New in Orthanc 1.12.12.")
+        .SetRequestField(KEY_DURATION, RestApiCallDocumentation::Type_Number,
+                         "Duration of the recording, in seconds (defaults to 30, at most " +
+                         boost::lexical_cast<std::string>(CpuProfiler::MAX_DURATION) + ")", false)
+        .SetRequestField(KEY_FREQUENCY, RestApiCallDocumentation::Type_Number,
+                         "Sampling frequency, in Hz (defaults to 99, at most " +
+                         boost::lexical_cast<std::string>(CpuProfiler::MAX_FREQUENCY) + ")", false)
+        .AddAnswerType(MimeType_PlainText, "The collapsed stacks");
+      return;
+    }
+
+    bool enabled;
+
+    {
+      OrthancConfiguration::ReaderLock lock;
+      enabled = lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_CPU_PROFILING_ENABLED);
+    }
+
+    if (!enabled)
+    {
+      LOG(ERROR) << "The URI /tools/profile is disallowed for security, "
+                 << "check your configuration option `" << ORTHANC_CONFIG_CPU_PROFILING_ENABLED << "`";
+      call.GetOutput().SignalError(HttpStatus_403_Forbidden);
+      return;
+    }
+
+    unsigned int duration = 30;
+    unsigned int frequency = 99;
+
+    if (call.GetBodySize() > 0)
+    {
+      Json::Value request;
+      if (!call.ParseJsonRequest(request) ||
+          request.type() != Json::objectValue)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Must provide a JSON object");
+      }
+
+      if (request.isMember(KEY_DURATION))
+      {
+        duration = SerializationToolbox::ReadUnsignedInteger(request, KEY_DURATION);
+      }
+
+      if (request.isMember(KEY_FREQUENCY))
+      {
+        frequency = SerializationToolbox::ReadUnsignedInteger(request, KEY_FREQUENCY);
+      }
+    }
+
+    std::string profile;
+    CpuProfiler::Profile(profile, duration, frequency);
+
+    call.GetOutput().AnswerBuffer(profile, MimeType_PlainText);
+  }
+
+
+  static void PutCacheMaximumSize(RestApiPutCall& call)
+  {
+    if (call.IsDocumentation())
+    {
+      call.GetDocumentation()
+        .SetTag("System")
+        .SetSummary("Resize a cache")
+        .SetDescription("Change the maximum size of one cache at runtime, without restarting Orthanc. "
+                        "The change is not persisted in the configuration. New in Orthanc 1.12.12.")
+        .SetUriArgument("name", "Name of the cache, as listed by `/tools/caches`")
+        .AddRequestType(MimeType_PlainText, "The new maximum size, in MB, or in number of entries for "
+                        "the `query-retrieve`, `media` and `archives` stores, and for the `find-answers` cache")
+        .AddAnswerType(MimeType_Json, "The statistics about the resized cache");
+      return;
+    }
+
+    std::string body;
+    call.BodyToString(body);
+
+    uint64_t value;
+    if (!SerializationToolbox::ParseUnsignedInteger64(value, Toolbox::StripSpaces(body)))
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "The body must contain a non-negative integer");
+    }
+
+    ServerContext& context = OrthancRestApi::GetContext(call);
+    const std::string name = call.GetUriComponent("name", "");
+    context.SetCacheMaximumSize(name, value);
+
+    Json::Value caches;
+    context.GetCachesStatistics(caches);
+    call.GetOutput().AnswerJson(caches[name]);
+  }
+
+
   static void GetLogLevel(RestApiGetCall& call)
   {
     if (call.IsDocumentation())
@@ -1208,6 +1588,10 @@ namespace Orthanc
     Register("/tools/metrics", GetMetricsEnabled);
     Register("/tools/metrics", PutMetricsEnabled);
     Register("/tools/metrics-prometheus", GetMetricsPrometheus);
+    Register("/tools/caches", GetCaches);  // New in Orthanc 1.12.12
+    Register("/tools/memory", GetMemory);  // New in Orthanc 1.12.12
+    Register("/tools/profile", RecordCpuProfile);  // New in Orthanc 1.12.12
+    Register("/tools/caches/{name}", PutCacheMaximumSize);  // New in Orthanc 1.12.12
     Register("/tools/log-level", GetLogLevel);
     Register("/tools/log-level", PutLogLevel);
 
@@ -1223,6 +1607,7 @@ namespace Orthanc
     Register("/plugins/explorer.js", GetOrthancExplorerPlugins);
 
     Register("/jobs", ListJobs);
+    Register("/jobs/events", StreamJobsEvents);
     Register("/jobs/{id}", GetJobInfo);
     Register("/jobs/{id}", DeleteJobInfo);
     Register("/jobs/{id}/cancel", ApplyJobAction<JobAction_Cancel>);
@@ -233,6 +233,153 @@ namespace Orthanc
   };
 
 
+  class OrthancWebDav::DicomFileInfoVisitor : public ResourceFinder::IVisitor
+  {
+  private:
+    bool                       success_;
+    uint64_t&                  contentLength_;
+    boost::posix_time::ptime&  time_;
+
+  public:
+    DicomFileInfoVisitor(uint64_t& contentLength,
+                         boost::posix_time::ptime& time) :
+      success_(false),
+      contentLength_(contentLength),
+      time_(time)
+    {
+    }
+
+    bool IsSuccess() const
+    {
+      return success_;
+    }
+
+    virtual void MarkAsComplete() ORTHANC_OVERRIDE
+    {
+    }
+
+    virtual void Apply(const FindResponse::Resource& resource,
+                       const DicomMap& requestedTags) ORTHANC_OVERRIDE
+    {
+      FileInfo info;
+      int64_t revision;
+
+      if (success_)
+      {
+        success_ = false;  // Two matches => Error
+      }
+      else if (resource.LookupAttachment(info, revision, FileContentType_Dicom))
+      {
+        std::string s;
+        if (resource.LookupMetadata(s, ResourceType_Instance, MetadataType_Instance_ReceptionDate))
+        {
+          ParseTime(time_, s);
+        }
+        else
+        {
+          time_ = GetNow();
+        }
+
+        // The size is read from the index, without loading the file
+        contentLength_ = info.GetUncompressedSize();
+        success_ = true;
+      }
+    }
+  };
+
+
+  struct OrthancWebDav::ListingsCache::Entry
+  {
+    LookupAnswersCache::Stamp  stamp_;
+    bool                       isExisting_;
+    Collection                 collection_;
+  };
+
+
+  OrthancWebDav::ListingsCache::ListingsCache(size_t maxSize) :
+    maxSize_(maxSize)
+  {
+    if (maxSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  OrthancWebDav::ListingsCache::~ListingsCache()
+  {
+    while (!index_.IsEmpty())
+    {
+      Entry* entry = NULL;
+      index_.RemoveOldest(entry);
+      assert(entry != NULL);
+      delete entry;
+    }
+  }
+
+
+  bool OrthancWebDav::ListingsCache::Lookup(bool& isExisting,
+                                            Collection& target,
+                                            const std::string& path,
+                                            const LookupAnswersCache::Stamp& stamp)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Entry* entry = NULL;
+    if (index_.Contains(path, entry))
+    {
+      assert(entry != NULL);
+
+      if (entry->stamp_ == stamp)
+      {
+        index_.MakeMostRecent(path);
+        isExisting = entry->isExisting_;
+        entry->collection_.CopyTo(target);
+        return true;
+      }
+      else
+      {
+        // The content of the database has changed since the listing
+        index_.Invalidate(path);
+        delete entry;
+      }
+    }
+
+    return false;
+  }
+
+
+  void OrthancWebDav::ListingsCache::Store(const std::string& path,
+                                           const LookupAnswersCache::Stamp& stamp,
+                                           bool isExisting,
+                                           const Collection& collection)
+  {
+    std::unique_ptr<Entry> entry(new Entry);
+    entry->stamp_ = stamp;
+    entry->isExisting_ = isExisting;
+    collection.CopyTo(entry->collection_);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Entry* previous = NULL;
+    if (index_.Contains(path, previous))
+    {
+      index_.Invalidate(path);
+      delete previous;
+    }
+
+    while (index_.GetSize() >= maxSize_)
+    {
+      Entry* oldest = NULL;
+      index_.RemoveOldest(oldest);
+      assert(oldest != NULL);
+      delete oldest;
+    }
+
+    index_.Add(path, entry.release());
+  }
+
+
   class OrthancWebDav::ResourcesIndex : public boost::noncopyable
   {
   public:
@@ -498,6 +645,29 @@ namespace Orthanc
       }
     }
 
+    virtual bool GetFileInfo(MimeType& mime,
+                             uint64_t& contentLength,
+                             boost::posix_time::ptime& time,
+                             const UriComponents& path) ORTHANC_OVERRIDE
+    {
+      std::string instanceId;
+      FileInfo info;
+      int64_t revision;  // Ignored
+
+      if (LookupInstanceId(instanceId, path) &&
+          context_.GetIndex().LookupAttachment(info, revision, ResourceType_Instance, instanceId, FileContentType_Dicom))
+      {
+        mime = MimeType_Dicom;
+        contentLength = info.GetUncompressedSize();
+        LookupTime(time, context_, instanceId, ResourceType_Instance, MetadataType_Instance_ReceptionDate);
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
     virtual bool DeleteItem(const UriComponents& path) ORTHANC_OVERRIDE
     {
       if (path.empty())
@@ -663,6 +833,34 @@ namespace Orthanc
       }
     }
 
+    virtual bool GetFileInfo(MimeType& mime,
+                             uint64_t& contentLength,
+                             boost::posix_time::ptime& time,
+                             const UriComponents& path)
+      ORTHANC_OVERRIDE ORTHANC_FINAL
+    {
+      if (path.empty())
+      {
+        return false;  // An internal node doesn't correspond to a file
+      }
+      else
+      {
+        // Recursivity
+        Refresh();
+
+        INode* child = GetChild(path[0]);
+        if (child == NULL)
+        {
+          return false;
+        }
+        else
+        {
+          UriComponents subpath(path.begin() + 1, path.end());
+          return child->GetFileInfo(mime, contentLength, time, subpath);
+        }
+      }
+    }
+
 
     virtual bool DeleteItem(const UriComponents& path) ORTHANC_OVERRIDE ORTHANC_FINAL
     {
@@ -1300,7 +1498,8 @@ namespace Orthanc
     allowDicomDelete_(allowDicomDelete),
     allowUpload_(allowUpload),
     uploads_(false /* store uploads as temporary files */),
-    uploadRunning_(false)
+    uploadRunning_(false),
+    listingsCache_(new ListingsCache(256))
   {
     patientsTemplates_[ResourceType_Patient] = "{{PatientID}} - {{PatientName}}";
     patientsTemplates_[ResourceType_Study] = "{{StudyDate}} - {{StudyDescription}}";
@@ -1315,6 +1514,19 @@ namespace Orthanc
   }
 
 
+  void OrthancWebDav::SetListingsCacheSize(size_t maxSize)
+  {
+    if (maxSize == 0)
+    {
+      listingsCache_.reset(NULL);
+    }
+    else
+    {
+      listingsCache_.reset(new ListingsCache(maxSize));
+    }
+  }
+
+
   bool OrthancWebDav::IsExistingFolder(const UriComponents& path) 
   {
     if (path.empty())
@@ -1330,8 +1542,10 @@ namespace Orthanc
              path[0] == BY_STUDIES ||
              path[0] == BY_DATES)
     {
+      // The listing is kept in the cache, as it is most probably
+      // requested right after this call by the WebDAV client
       IWebDavBucket::Collection collection;
-      return GetRootNode(path[0]).ListCollection(collection, UriComponents(path.begin() + 1, path.end()));
+      return ListCachedCollection(collection, path);
     }
     else if (allowUpload_ &&
              path[0] == UPLOADS)
@@ -1345,24 +1559,12 @@ namespace Orthanc
   }
 
   
-  bool OrthancWebDav::ListCollection(Collection& collection,
-                                     const UriComponents& path) 
+  bool OrthancWebDav::ListDicomCollection(Collection& collection,
+                                          const UriComponents& path)
   {
-    if (path.empty())
-    {
-      collection.AddResource(new Folder(BY_DATES));
-      collection.AddResource(new Folder(BY_PATIENTS));
-      collection.AddResource(new Folder(BY_STUDIES));
-      collection.AddResource(new Folder(BY_UIDS));
+    assert(!path.empty());
 
-      if (allowUpload_)
-      {
-        collection.AddResource(new Folder(UPLOADS));
-      }
-      
-      return true;
-    }   
-    else if (path[0] == BY_UIDS)
+    if (path[0] == BY_UIDS)
     {
       DatabaseLookup query;
       ResourceType level;
@@ -1429,6 +1631,65 @@ namespace Orthanc
     {
       return GetRootNode(path[0]).ListCollection(collection, UriComponents(path.begin() + 1, path.end()));
     }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  bool OrthancWebDav::ListCachedCollection(Collection& collection,
+                                           const UriComponents& path)
+  {
+    if (listingsCache_.get() == NULL)
+    {
+      return ListDicomCollection(collection, path);
+    }
+
+    // The stamp must be read before listing the folder
+    const LookupAnswersCache::Stamp stamp(context_.GetIndex());
+    const std::string key = Toolbox::FlattenUri(path);
+
+    bool isExisting;
+    if (listingsCache_->Lookup(isExisting, collection, key, stamp))
+    {
+      return isExisting;
+    }
+    else
+    {
+      Collection listing;
+      isExisting = ListDicomCollection(listing, path);
+      listingsCache_->Store(key, stamp, isExisting, listing);
+      listing.CopyTo(collection);
+      return isExisting;
+    }
+  }
+
+
+  bool OrthancWebDav::ListCollection(Collection& collection,
+                                     const UriComponents& path) 
+  {
+    if (path.empty())
+    {
+      collection.AddResource(new Folder(BY_DATES));
+      collection.AddResource(new Folder(BY_PATIENTS));
+      collection.AddResource(new Folder(BY_STUDIES));
+      collection.AddResource(new Folder(BY_UIDS));
+
+      if (allowUpload_)
+      {
+        collection.AddResource(new Folder(UPLOADS));
+      }
+      
+      return true;
+    }   
+    else if (path[0] == BY_UIDS ||
+             path[0] == BY_PATIENTS ||
+             path[0] == BY_STUDIES ||
+             path[0] == BY_DATES)
+    {
+      return ListCachedCollection(collection, path);
+    }
     else if (allowUpload_ &&
              path[0] == UPLOADS)
     {
@@ -1549,6 +1810,66 @@ namespace Orthanc
   }
 
   
+  bool OrthancWebDav::GetFileInfo(MimeType& mime,
+                                  uint64_t& contentLength,
+                                  boost::posix_time::ptime& modificationTime,
+                                  const UriComponents& path)
+  {
+    if (path.empty())
+    {
+      return false;
+    }
+    else if (path[0] == BY_UIDS)
+    {
+      if (path.size() == 4 &&
+          boost::ends_with(path[3], ".dcm"))
+      {
+        const std::string sopInstanceUid = path[3].substr(0, path[3].size() - 4);
+        
+        DatabaseLookup query;
+        query.AddRestConstraint(DICOM_TAG_STUDY_INSTANCE_UID, path[1],
+                                true /* case sensitive */, true /* mandatory tag */);
+        query.AddRestConstraint(DICOM_TAG_SERIES_INSTANCE_UID, path[2],
+                                true /* case sensitive */, true /* mandatory tag */);
+        query.AddRestConstraint(DICOM_TAG_SOP_INSTANCE_UID, sopInstanceUid,
+                                true /* case sensitive */, true /* mandatory tag */);
+      
+        mime = MimeType_Dicom;
+
+        ResourceFinder finder(ResourceType_Instance, ResponseContentFlags_ID, context_.GetFindStorageAccessMode(), context_.GetIndex().HasFindSupport());
+        finder.SetDatabaseLookup(query);
+        finder.SetRetrieveMetadata(true);
+        finder.SetRetrieveAttachments(true);
+
+        DicomFileInfoVisitor visitor(contentLength, modificationTime);
+        finder.Execute(visitor, context_);
+
+        return visitor.IsSuccess();
+      }
+      else
+      {
+        // The JSON summaries are small, generate them
+        return IWebDavBucket::GetFileInfo(mime, contentLength, modificationTime, path);
+      }
+    }
+    else if (path[0] == BY_PATIENTS ||
+             path[0] == BY_STUDIES ||
+             path[0] == BY_DATES)
+    {
+      return GetRootNode(path[0]).GetFileInfo(mime, contentLength, modificationTime, UriComponents(path.begin() + 1, path.end()));
+    }
+    else if (allowUpload_ &&
+             path[0] == UPLOADS)
+    {
+      return uploads_.GetFileInfo(mime, contentLength, modificationTime, UriComponents(path.begin() + 1, path.end()));
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  
   bool OrthancWebDav::StoreFile(const std::string& content,
                                 const UriComponents& path) 
   {
@@ -23,9 +23,11 @@
 
 #pragma once
 
+#include "../../OrthancFramework/Sources/Cache/LeastRecentlyUsedIndex.h"
 #include "../../OrthancFramework/Sources/HttpServer/WebDavStorage.h"
 #include "../../OrthancFramework/Sources/MultiThreading/SharedMessageQueue.h"
 #include "../../OrthancFramework/Sources/Toolbox.h"
+#include "LookupAnswersCache.h"
 
 
 namespace Orthanc
@@ -38,6 +40,7 @@ namespace Orthanc
     typedef std::map<ResourceType, std::string>  Templates;
 
     class DicomDeleteVisitor;
+    class DicomFileInfoVisitor;
     class DicomFileVisitorV2;
     class DicomIdentifiersVisitorV2;
     class InstancesOfSeries;
@@ -67,10 +70,49 @@ namespace Orthanc
                                   boost::posix_time::ptime& time, 
                                   const UriComponents& path) = 0;
 
+      virtual bool GetFileInfo(MimeType& mime,
+                               uint64_t& contentLength,
+                               boost::posix_time::ptime& time,
+                               const UriComponents& path) = 0;
+
       virtual bool DeleteItem(const UriComponents& path) = 0;
     };
 
 
+    /**
+     * Cache of the listings of the folders, indexed by their path.
+     * Each listing is stamped with the content of the database index
+     * at the time it was computed, and is only reused as long as
+     * this content is unchanged. New in Orthanc 1.12.12.
+     **/
+    class ListingsCache : public boost::noncopyable
+    {
+    private:
+      struct Entry;
+
+      typedef LeastRecentlyUsedIndex<std::string, Entry*>  Index;
+
+      boost::mutex  mutex_;
+      Index         index_;
+      size_t        maxSize_;
+
+    public:
+      explicit ListingsCache(size_t maxSize);
+
+      ~ListingsCache();
+
+      bool Lookup(bool& isExisting /* out */,
+                  Collection& target /* out */,
+                  const std::string& path,
+                  const LookupAnswersCache::Stamp& stamp);
+
+      void Store(const std::string& path,
+                 const LookupAnswersCache::Stamp& stamp,
+                 bool isExisting,
+                 const Collection& collection);
+    };
+
+
     void AddVirtualFile(Collection& collection,
                         const UriComponents& path,
                         const std::string& filename);
@@ -80,19 +122,26 @@ namespace Orthanc
     void Upload(const std::string& path);
 
     INode& GetRootNode(const std::string& rootPath);
+
+    bool ListDicomCollection(Collection& collection,
+                             const UriComponents& path);
+
+    bool ListCachedCollection(Collection& collection,
+                              const UriComponents& path);
   
-    ServerContext&          context_;
-    bool                    allowDicomDelete_;
-    bool                    allowUpload_;
-    std::unique_ptr<INode>  patients_;
-    std::unique_ptr<INode>  studies_;
-    std::unique_ptr<INode>  dates_;
-    Templates               patientsTemplates_;
-    Templates               studiesTemplates_;
-    WebDavStorage           uploads_;
-    SharedMessageQueue      uploadQueue_;
-    boost::thread           uploadThread_;
-    bool                    uploadRunning_;
+    ServerContext&                  context_;
+    bool                            allowDicomDelete_;
+    bool                            allowUpload_;
+    std::unique_ptr<INode>          patients_;
+    std::unique_ptr<INode>          studies_;
+    std::unique_ptr<INode>          dates_;
+    Templates                       patientsTemplates_;
+    Templates                       studiesTemplates_;
+    WebDavStorage                   uploads_;
+    SharedMessageQueue              uploadQueue_;
+    boost::thread                   uploadThread_;
+    bool                            uploadRunning_;
+    std::unique_ptr<ListingsCache>  listingsCache_;
   
   public:
     OrthancWebDav(ServerContext& context,
@@ -104,6 +153,9 @@ namespace Orthanc
       OrthancWebDav::Stop();
     }
 
+    // "0" disables the cache of the listings (new in Orthanc 1.12.12)
+    void SetListingsCacheSize(size_t maxSize);
+
     virtual bool IsExistingFolder(const UriComponents& path) ORTHANC_OVERRIDE;
 
     virtual bool ListCollection(Collection& collection,
@@ -113,6 +165,11 @@ namespace Orthanc
                                 std::string& content,
                                 boost::posix_time::ptime& modificationTime, 
                                 const UriComponents& path) ORTHANC_OVERRIDE;
+
+    virtual bool GetFileInfo(MimeType& mime,
+                             uint64_t& contentLength,
+                             boost::posix_time::ptime& modificationTime,
+                             const UriComponents& path) ORTHANC_OVERRIDE;
   
     virtual bool StoreFile(const std::string& content,
                            const UriComponents& path) ORTHANC_OVERRIDE;
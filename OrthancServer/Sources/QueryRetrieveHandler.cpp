@@ -41,7 +41,7 @@ namespace Orthanc
   {
     static const char* LUA_CALLBACK = "OutgoingFindRequestFilter";
 
-    LuaScripting::Lock lock(context.GetLuaScripting());
+    LuaScripting::FilterLock lock(context.GetLuaScripting());
 
     if (lock.GetLua().IsExistingFunction(LUA_CALLBACK))
     {
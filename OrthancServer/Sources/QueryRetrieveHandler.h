@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include "../../OrthancFramework/Sources/Cache/ICacheable.h"
 #include "../../OrthancFramework/Sources/DicomNetworking/DicomFindAnswers.h"
 #include "../../OrthancFramework/Sources/DicomNetworking/RemoteModalityParameters.h"
 
@@ -30,7 +31,7 @@ namespace Orthanc
 {
   class ServerContext;
   
-  class QueryRetrieveHandler : public IDynamicObject
+  class QueryRetrieveHandler : public IDynamicObject, public ICacheable
   {
   private:
     ServerContext&             context_;
@@ -114,5 +115,11 @@ namespace Orthanc
     {
       return timeout_ != 0;
     }
+
+    // Size hint for the "SharedArchive" (new in Orthanc 1.12.12)
+    virtual size_t GetMemoryUsage() const ORTHANC_OVERRIDE
+    {
+      return sizeof(QueryRetrieveHandler) + answers_.GetMemoryUsage();
+    }
   };
 }
@@ -0,0 +1,436 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "RenderedFramesCache.h"
+
+#include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+#include "../../OrthancFramework/Sources/Toolbox.h"
+
+#include <cassert>
+
+
+namespace Orthanc
+{
+  struct RenderedFramesCache::Entry : public boost::noncopyable
+  {
+    std::string  key_;
+    std::string  instanceId_;
+    MimeType     mime_;
+    std::string  content_;
+
+    Entry(const std::string& key,
+          const std::string& instanceId,
+          MimeType mime,
+          const std::string& content) :
+      key_(key),
+      instanceId_(instanceId),
+      mime_(mime),
+      content_(content)
+    {
+    }
+  };
+
+
+  std::string RenderedFramesCache::GetDiskUuid(const std::string& key)
+  {
+    // The disk cache expects the files to be named after UUIDs
+    std::string md5;
+    Toolbox::ComputeMD5(md5, key);
+    assert(md5.size() == 32);
+
+    return (md5.substr(0, 8) + "-" + md5.substr(8, 4) + "-" + md5.substr(12, 4) + "-" +
+            md5.substr(16, 4) + "-" + md5.substr(20, 12));
+  }
+
+
+  void RenderedFramesCache::Unregister(const std::string& instanceId,
+                                       const std::string& key)
+  {
+    // WARNING: "mutex_" must be locked
+    Instances::iterator found = instances_.find(instanceId);
+    if (found != instances_.end())
+    {
+      found->second.erase(key);
+
+      if (found->second.empty())
+      {
+        instances_.erase(found);
+      }
+    }
+  }
+
+
+  void RenderedFramesCache::RemoveOldest(std::vector<Entry*>& toSpill)
+  {
+    // WARNING: "mutex_" must be locked
+    Entry* entry = NULL;
+    index_.RemoveOldest(entry);
+
+    assert(entry != NULL &&
+           currentSize_ >= entry->content_.size());
+    currentSize_ -= entry->content_.size();
+
+    if (diskCache_.get() == NULL)
+    {
+      Unregister(entry->instanceId_, entry->key_);
+      delete entry;
+    }
+    else if (spilled_.find(entry->key_) != spilled_.end())
+    {
+      // This image was read back from the disk cache, where it is still stored
+      delete entry;
+    }
+    else
+    {
+      spilled_[entry->key_] = entry->instanceId_;
+      toSpill.push_back(entry);
+    }
+  }
+
+
+  void RenderedFramesCache::MakeRoom(std::vector<Entry*>& toSpill,
+                                     size_t maxSize)
+  {
+    // WARNING: "mutex_" must be locked
+    while (currentSize_ > maxSize)
+    {
+      RemoveOldest(toSpill);
+      statistics_.AddEviction();
+    }
+  }
+
+
+  void RenderedFramesCache::Spill(std::vector<Entry*>& toSpill)
+  {
+    // WARNING: "mutex_" must *not* be locked, to avoid blocking the
+    // other threads while writing to the disk
+    for (size_t i = 0; i < toSpill.size(); i++)
+    {
+      std::unique_ptr<Entry> entry(toSpill[i]);
+      toSpill[i] = NULL;
+
+      assert(diskCache_.get() != NULL);
+
+      // The MIME type is stored on the first line of the file
+      const std::string content = std::string(EnumerationToString(entry->mime_)) + "\n" + entry->content_;
+      diskCache_->Add(GetDiskUuid(entry->key_), FileContentType_Unknown, content.c_str(), content.size());
+    }
+
+    toSpill.clear();
+  }
+
+
+  RenderedFramesCache::RenderedFramesCache(size_t maxSize) :
+    maxSize_(maxSize),
+    currentSize_(0)
+  {
+    if (maxSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The cache of the rendered frames must not be empty");
+    }
+  }
+
+
+  RenderedFramesCache::~RenderedFramesCache()
+  {
+    Clear();
+  }
+
+
+  void RenderedFramesCache::SetDiskCache(StorageDiskCache* diskCache)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!index_.IsEmpty() ||
+        !spilled_.empty())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "The disk cache must be set before the cache is used");
+    }
+    else
+    {
+      diskCache_.reset(diskCache);
+    }
+  }
+
+
+  bool RenderedFramesCache::Lookup(std::string& content,
+                                   MimeType& mime,
+                                   const std::string& key)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      Entry* entry = NULL;
+      if (index_.Contains(key, entry))
+      {
+        assert(entry != NULL);
+        index_.MakeMostRecent(key);
+        content = entry->content_;
+        mime = entry->mime_;
+        statistics_.AddHit();
+        return true;
+      }
+      else if (diskCache_.get() == NULL ||
+               spilled_.find(key) == spilled_.end())
+      {
+        statistics_.AddMiss();
+        return false;
+      }
+    }
+
+    std::string raw;
+    bool parsed = false;
+
+    if (diskCache_->Read(raw, GetDiskUuid(key), FileContentType_Unknown))
+    {
+      // The MIME type is stored on the first line of the file
+      const size_t separator = raw.find('\n');
+      if (separator != std::string::npos)
+      {
+        try
+        {
+          mime = StringToMimeType(raw.substr(0, separator));
+          content = raw.substr(separator + 1);
+          parsed = true;
+        }
+        catch (OrthancException&)
+        {
+        }
+      }
+
+      if (!parsed)
+      {
+        LOG(WARNING) << "Corrupted file in the disk cache of the rendered frames";
+      }
+    }
+
+    std::vector<Entry*> toSpill;
+    bool success;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      Spilled::iterator spilled = spilled_.find(key);
+
+      if (spilled == spilled_.end())
+      {
+        // The instance has been invalidated in the meantime
+        success = false;
+      }
+      else if (!parsed)
+      {
+        // The file was evicted from the disk cache
+        Unregister(spilled->second, key);
+        spilled_.erase(spilled);
+        success = false;
+      }
+      else
+      {
+        if (!index_.Contains(key) &&
+            content.size() <= maxSize_)
+        {
+          // Move the image back to RAM, while keeping it on the disk
+          MakeRoom(toSpill, maxSize_ - content.size());
+          index_.Add(key, new Entry(key, spilled->second, mime, content));
+          currentSize_ += content.size();
+        }
+
+        success = true;
+      }
+
+      if (success)
+      {
+        statistics_.AddHit();
+      }
+      else
+      {
+        statistics_.AddMiss();
+      }
+    }
+
+    Spill(toSpill);
+    return success;
+  }
+
+
+  void RenderedFramesCache::Store(const std::string& key,
+                                  const std::string& instanceId,
+                                  MimeType mime,
+                                  const std::string& content)
+  {
+    std::unique_ptr<Entry> entry(new Entry(key, instanceId, mime, content));
+    std::vector<Entry*> toSpill;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (content.size() > maxSize_)
+      {
+        return;  // Too large to be cached
+      }
+
+      Entry* previous = NULL;
+      if (index_.Contains(key, previous))
+      {
+        // Another thread has rendered the same image in the meantime
+        assert(previous != NULL &&
+               currentSize_ >= previous->content_.size());
+        currentSize_ -= previous->content_.size();
+        delete index_.Invalidate(key);
+      }
+
+      MakeRoom(toSpill, maxSize_ - content.size());
+      index_.Add(key, entry.release());
+      instances_[instanceId].insert(key);
+      currentSize_ += content.size();
+    }
+
+    Spill(toSpill);
+  }
+
+
+  void RenderedFramesCache::InvalidateInstance(const std::string& instanceId)
+  {
+    std::set<std::string> keys;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      Instances::iterator found = instances_.find(instanceId);
+      if (found == instances_.end())
+      {
+        return;
+      }
+
+      for (std::set<std::string>::const_iterator it = found->second.begin(); it != found->second.end(); ++it)
+      {
+        Entry* entry = NULL;
+        if (index_.Contains(*it, entry))
+        {
+          assert(entry != NULL &&
+                 currentSize_ >= entry->content_.size());
+          currentSize_ -= entry->content_.size();
+          delete index_.Invalidate(*it);
+        }
+
+        Spilled::iterator spilled = spilled_.find(*it);
+        if (spilled != spilled_.end())
+        {
+          spilled_.erase(spilled);
+          keys.insert(*it);
+        }
+      }
+
+      instances_.erase(found);
+    }
+
+    for (std::set<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+    {
+      assert(diskCache_.get() != NULL);
+      diskCache_->Invalidate(GetDiskUuid(*it), FileContentType_Unknown);
+    }
+  }
+
+
+  void RenderedFramesCache::Clear()
+  {
+    std::set<std::string> keys;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      while (!index_.IsEmpty())
+      {
+        Entry* entry = NULL;
+        index_.RemoveOldest(entry);
+        delete entry;
+      }
+
+      for (Spilled::const_iterator it = spilled_.begin(); it != spilled_.end(); ++it)
+      {
+        keys.insert(it->first);
+      }
+
+      spilled_.clear();
+      instances_.clear();
+      currentSize_ = 0;
+    }
+
+    for (std::set<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+    {
+      assert(diskCache_.get() != NULL);
+      diskCache_->Invalidate(GetDiskUuid(*it), FileContentType_Unknown);
+    }
+  }
+
+
+  size_t RenderedFramesCache::GetNumberOfItems()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return index_.GetSize();
+  }
+
+
+  size_t RenderedFramesCache::GetCurrentSize()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return currentSize_;
+  }
+
+
+  size_t RenderedFramesCache::GetMaximumSize()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return maxSize_;
+  }
+
+
+  void RenderedFramesCache::SetMaximumSize(size_t maxSize)
+  {
+    if (maxSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The cache of the rendered frames must not be empty");
+    }
+
+    std::vector<Entry*> toSpill;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      maxSize_ = maxSize;
+      MakeRoom(toSpill, maxSize_);
+    }
+
+    Spill(toSpill);
+  }
+
+
+  void RenderedFramesCache::GetStatistics(CacheStatistics& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    target = statistics_;
+  }
+}
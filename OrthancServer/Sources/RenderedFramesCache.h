@@ -0,0 +1,121 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include "../../OrthancFramework/Sources/Cache/CacheStatistics.h"
+#include "../../OrthancFramework/Sources/Cache/LeastRecentlyUsedIndex.h"
+#include "../../OrthancFramework/Sources/Enumerations.h"
+#include "../../OrthancFramework/Sources/FileStorage/StorageDiskCache.h"
+
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <memory>
+#include <set>
+
+namespace Orthanc
+{
+  /**
+   * Cache of the encoded images that are answered by the routes
+   * that decode or render the frames of an instance ("/preview",
+   * "/image-uint8", "/rendered"...). The key must identify both the
+   * DICOM attachment and all the parameters of the rendering, the
+   * latter including the "Accept" HTTP header that selects the MIME
+   * type. The size of the cache is bounded by the total number of
+   * bytes of the encoded images. The entries that are evicted from
+   * RAM can be spilled into a disk cache. New in Orthanc 1.12.12.
+   *
+   * Note: this class is thread safe
+   **/
+  class RenderedFramesCache : public boost::noncopyable
+  {
+  private:
+    struct Entry;
+
+    typedef LeastRecentlyUsedIndex<std::string, Entry*>      Index;
+    typedef std::map<std::string, std::string>               Spilled;    // Key => Orthanc ID of instance
+    typedef std::map<std::string, std::set<std::string> >    Instances;  // Orthanc ID of instance => keys
+
+    boost::mutex                       mutex_;
+    Index                              index_;
+    Spilled                            spilled_;
+    Instances                          instances_;
+    size_t                             maxSize_;
+    size_t                             currentSize_;
+    std::unique_ptr<StorageDiskCache>  diskCache_;
+    CacheStatistics                    statistics_;
+
+    static std::string GetDiskUuid(const std::string& key);
+
+    void Unregister(const std::string& instanceId,
+                    const std::string& key);
+
+    void RemoveOldest(std::vector<Entry*>& toSpill);
+
+    void MakeRoom(std::vector<Entry*>& toSpill,
+                  size_t maxSize);
+
+    void Spill(std::vector<Entry*>& toSpill);
+
+  public:
+    explicit RenderedFramesCache(size_t maxSize);
+
+    ~RenderedFramesCache();
+
+    // Takes ownership. The files of the disk cache must be stored
+    // in a directory that is not shared with another disk cache.
+    void SetDiskCache(StorageDiskCache* diskCache);
+
+    StorageDiskCache* GetDiskCache() const
+    {
+      return diskCache_.get();
+    }
+
+    bool Lookup(std::string& content,
+                MimeType& mime,
+                const std::string& key);
+
+    void Store(const std::string& key,
+               const std::string& instanceId,
+               MimeType mime,
+               const std::string& content);
+
+    // Removes all the images that were rendered from the given
+    // instance, to be called if the instance is deleted or modified
+    void InvalidateInstance(const std::string& instanceId);
+
+    void Clear();
+
+    size_t GetNumberOfItems();
+
+    size_t GetCurrentSize();
+
+    size_t GetMaximumSize();
+
+    void SetMaximumSize(size_t maxSize);
+
+    void GetStatistics(CacheStatistics& target);
+  };
+}
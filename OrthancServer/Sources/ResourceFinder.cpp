@@ -26,16 +26,28 @@
 
 #include "../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
 #include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/MultiThreading/CallableGroup.h"
 #include "../../OrthancFramework/Sources/OrthancException.h"
+#include "../../OrthancFramework/Sources/RestApi/RestApiJsonWriter.h"
 #include "../../OrthancFramework/Sources/SerializationToolbox.h"
 #include "OrthancConfiguration.h"
 #include "Search/DatabaseLookup.h"
 #include "ServerContext.h"
 #include "ServerIndex.h"
 
+#include <algorithm>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <limits>
+
 
 namespace Orthanc
 {
+  static uint64_t GetElapsedMicroseconds(const boost::posix_time::ptime& start)
+  {
+    return static_cast<uint64_t>((boost::posix_time::microsec_clock::universal_time() - start).total_microseconds());
+  }
+
+
   static bool IsComputedTag(const DicomTag& tag)
   {
     return (tag == DICOM_TAG_NUMBER_OF_PATIENT_RELATED_STUDIES ||
@@ -563,18 +575,26 @@ namespace Orthanc
     hasLimitsCount_(false),
     limitsSince_(0),
     limitsCount_(0),
+    hasNextKeyset_(false),
+    nextKeysetLastInternalId_(0),
     responseContent_(responseContent),
     storageAccessMode_(storageAccessMode),
     supportsChildExistQueries_(supportsChildExistQueries),
+    storageReads_(0),
+    candidatesCount_(0),
+    filteredOutCount_(0),
+    databaseDuration_(0),
+    requestedTagsDuration_(0),
+    postFilteringDuration_(0),
     isWarning002Enabled_(false),
     isWarning004Enabled_(false),
     isWarning005Enabled_(false)
   {
     {
-      OrthancConfiguration::ReaderLock lock;
-      isWarning002Enabled_ = lock.GetConfiguration().IsWarningEnabled(Warnings_002_InconsistentDicomTagsInDb);
-      isWarning004Enabled_ = lock.GetConfiguration().IsWarningEnabled(Warnings_004_NoMainDicomTagsSignature);
-      isWarning005Enabled_ = lock.GetConfiguration().IsWarningEnabled(Warnings_005_RequestingTagFromLowerResourceLevel);
+      boost::shared_ptr<const OrthancConfiguration::Snapshot> configuration = OrthancConfiguration::GetSnapshot();
+      isWarning002Enabled_ = configuration->IsWarningEnabled(Warnings_002_InconsistentDicomTagsInDb);
+      isWarning004Enabled_ = configuration->IsWarningEnabled(Warnings_004_NoMainDicomTagsSignature);
+      isWarning005Enabled_ = configuration->IsWarningEnabled(Warnings_005_RequestingTagFromLowerResourceLevel);
     }
 
     request_.SetRetrieveMainDicomTags(responseContent_ & ResponseContentFlags_MainDicomTags);
@@ -650,6 +670,55 @@ namespace Orthanc
   }
 
 
+  void ResourceFinder::SetContinuationToken(const std::string& token)
+  {
+    if (request_.HasKeysetPagination())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else if (token.empty())
+    {
+      request_.SetKeysetPagination(0);
+    }
+    else
+    {
+      // The token is opaque to the clients, it currently contains the
+      // internal ID of the last resource of the previous page
+      int64_t lastInternalId;
+
+      try
+      {
+        lastInternalId = boost::lexical_cast<int64_t>(token);
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        throw OrthancException(ErrorCode_BadRequest, "Invalid continuation token: " + token);
+      }
+
+      if (lastInternalId <= 0)
+      {
+        throw OrthancException(ErrorCode_BadRequest, "Invalid continuation token: " + token);
+      }
+
+      request_.SetKeysetPagination(lastInternalId);
+    }
+  }
+
+
+  bool ResourceFinder::LookupContinuationToken(std::string& token) const
+  {
+    if (hasNextKeyset_)
+    {
+      token = boost::lexical_cast<std::string>(nextKeysetLastInternalId_);
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
   void ResourceFinder::SetDatabaseLookup(const DatabaseLookup& lookup)
   {
     MainDicomTagsRegistry registry;
@@ -883,8 +952,7 @@ namespace Orthanc
     {
       std::set<DicomTag> savedMainDicomTags;
 
-      DicomMap m;
-      resource.GetMainDicomTags(m, level);                          // read DicomTags from DB
+      DicomMap m;  // The main DICOM tags from DB are directly copied from the compact storage of "resource"
 
       if (resource.GetMetadata(level).size() > 0)
       {
@@ -907,7 +975,8 @@ namespace Orthanc
       std::set<DicomTag> copiedTags;
       for (std::set<DicomTag>::const_iterator it = remainingRequestedTags.begin(); it != remainingRequestedTags.end(); ++it)
       {
-        if (target.CopyTagIfExists(m, *it))
+        if (resource.CopyMainDicomTagIfExists(target, level, *it) ||  // read DicomTags from DB
+            target.CopyTagIfExists(m, *it))
         {
           copiedTags.insert(*it);
         }
@@ -941,8 +1010,7 @@ namespace Orthanc
                                              const FindResponse::Resource& resource,
                                              const std::set<DicomTag>& missingTags)
   {
-    OrthancConfiguration::ReaderLock lock;
-    if (lock.GetConfiguration().IsWarningEnabled(Warnings_001_TagsBeingReadFromStorage))
+    if (OrthancConfiguration::GetSnapshot()->IsWarningEnabled(Warnings_001_TagsBeingReadFromStorage))
     {
       std::string missings;
       FromDcmtkBridge::FormatListOfTags(missings, missingTags);
@@ -967,16 +1035,16 @@ namespace Orthanc
       std::map<MetadataType, std::string> converted;
       ConvertMetadata(converted, resource);
 
-      context.ReadDicomAsJson(tmpDicomAsJson, resource.GetIdentifier(), converted,
-                              resource.GetAttachments(), missingTags /* ignoreTagLength */);
+      context.ReadDicomTagsAsJson(tmpDicomAsJson, resource.GetIdentifier(), converted,
+                                  resource.GetAttachments(), missingTags);
     }
     else if (request.GetLevel() != ResourceType_Instance &&
              request.IsRetrieveOneInstanceMetadataAndAttachments())
     {
       LOG(INFO) << "Will retrieve missing DICOM tags from instance: " << resource.GetOneInstancePublicId();
 
-      context.ReadDicomAsJson(tmpDicomAsJson, resource.GetOneInstancePublicId(), resource.GetOneInstanceMetadata(),
-                              resource.GetOneInstanceAttachments(), missingTags /* ignoreTagLength */);
+      context.ReadDicomTagsAsJson(tmpDicomAsJson, resource.GetOneInstancePublicId(), resource.GetOneInstanceMetadata(),
+                                  resource.GetOneInstanceAttachments(), missingTags);
     }
     else
     {
@@ -1011,13 +1079,13 @@ namespace Orthanc
           std::map<MetadataType, std::string> converted;
           ConvertMetadata(converted, resource);
 
-          context.ReadDicomAsJson(tmpDicomAsJson, response.GetIdentifier(), converted,
-                                  response.GetAttachments(), missingTags /* ignoreTagLength */);
+          context.ReadDicomTagsAsJson(tmpDicomAsJson, response.GetIdentifier(), converted,
+                                      response.GetAttachments(), missingTags);
         }
         else
         {
-          context.ReadDicomAsJson(tmpDicomAsJson, response.GetOneInstancePublicId(), response.GetOneInstanceMetadata(),
-                                  response.GetOneInstanceAttachments(), missingTags /* ignoreTagLength */);
+          context.ReadDicomTagsAsJson(tmpDicomAsJson, response.GetOneInstancePublicId(), response.GetOneInstanceMetadata(),
+                                      response.GetOneInstanceAttachments(), missingTags);
         }
       }
     }
@@ -1039,6 +1107,138 @@ namespace Orthanc
     }
   }
 
+  namespace
+  {
+    // Reads the missing tags of one resource, from a thread of the
+    // pool of loaders of the server context (new in Orthanc 1.12.12)
+    class MissingTagsLoader : public ICallable
+    {
+    public:
+      class Result : public IDynamicObject
+      {
+      private:
+        DicomMap  tags_;
+
+      public:
+        DicomMap& GetTags()
+        {
+          return tags_;
+        }
+      };
+
+    private:
+      ServerContext&                   context_;
+      FindRequest                      request_;
+      boost::shared_ptr<FindResponse>  response_;
+      size_t                           index_;
+      std::set<DicomTag>               missingTags_;
+
+    public:
+      MissingTagsLoader(ServerContext& context,
+                        const FindRequest& request,
+                        const boost::shared_ptr<FindResponse>& response,
+                        size_t index,
+                        const std::set<DicomTag>& missingTags) :
+        context_(context),
+        request_(request.GetLevel()),
+        response_(response),
+        index_(index),
+        missingTags_(missingTags)
+      {
+        // Copy the fields that are used by "ReadMissingTagsFromStorageArea()",
+        // as the original request might be destroyed before this loader runs
+        request_.SetRetrieveMetadata(request.IsRetrieveMetadata());
+        request_.SetRetrieveAttachments(request.IsRetrieveAttachments());
+
+        if (request.GetLevel() != ResourceType_Instance)
+        {
+          request_.SetRetrieveOneInstanceMetadataAndAttachments(request.IsRetrieveOneInstanceMetadataAndAttachments());
+        }
+      }
+
+      virtual IDynamicObject* Call() ORTHANC_OVERRIDE
+      {
+        std::unique_ptr<Result> result(new Result);
+        ReadMissingTagsFromStorageArea(result->GetTags(), context_, request_, response_->GetResourceByIndex(index_), missingTags_);
+        return result.release();
+      }
+    };
+  }
+
+
+  void ResourceFinder::Explain(Json::Value& target,
+                               ServerContext& context)
+  {
+    class Visitor : public IVisitor
+    {
+    private:
+      uint64_t  count_;
+      bool      isComplete_;
+
+    public:
+      Visitor() :
+        count_(0),
+        isComplete_(false)
+      {
+      }
+
+      uint64_t GetCount() const
+      {
+        return count_;
+      }
+
+      bool IsComplete() const
+      {
+        return isComplete_;
+      }
+
+      virtual void Apply(const FindResponse::Resource& resource,
+                         const DicomMap& requestedTags) ORTHANC_OVERRIDE
+      {
+        count_++;
+      }
+
+      virtual void MarkAsComplete() ORTHANC_OVERRIDE
+      {
+        isComplete_ = true;
+      }
+    };
+
+    storageReads_ = 0;
+    candidatesCount_ = 0;
+    filteredOutCount_ = 0;
+    databaseDuration_ = 0;
+    requestedTagsDuration_ = 0;
+    postFilteringDuration_ = 0;
+
+    Visitor visitor;
+    Execute(visitor, context);
+
+    target = Json::objectValue;
+    target["Level"] = EnumerationToString(request_.GetLevel());
+    target["CandidatesCount"] = static_cast<Json::UInt64>(candidatesCount_);
+    target["FilteredOutCount"] = static_cast<Json::UInt64>(filteredOutCount_);
+    target["AnswersCount"] = static_cast<Json::UInt64>(visitor.GetCount());
+    target["IsComplete"] = visitor.IsComplete();
+    target["StorageReadsCount"] = static_cast<Json::UInt64>(storageReads_);
+
+    Json::Value& durations = target["DurationsMs"];
+    durations["Database"] = static_cast<double>(databaseDuration_) / 1000.0;
+    durations["RequestedTags"] = static_cast<double>(requestedTagsDuration_) / 1000.0;
+    durations["PostFiltering"] = static_cast<double>(postFilteringDuration_) / 1000.0;
+
+    if (context.GetIndex().HasFindExplainSupport())
+    {
+      // "request_" now contains the limits that were actually sent to the database
+      context.GetIndex().ExplainFind(target["Database"], request_);
+    }
+    else
+    {
+      target["Database"] = Json::nullValue;
+    }
+  }
+
+
   uint64_t ResourceFinder::Count(ServerContext& context) const
   {
     if (!canBeFullyPerformedInDb_)
@@ -1053,6 +1253,85 @@ namespace Orthanc
   }
 
 
+  uint64_t ResourceFinder::EstimateCount(bool& isExact,
+                                         ServerContext& context,
+                                         uint64_t exactThreshold)
+  {
+    if (!canBeFullyPerformedInDb_)
+    {
+      throw OrthancException(ErrorCode_BadRequest,
+                            "Unable to count resources when querying tags that are not stored as MainDicomTags in the Database or when using case sensitive queries.");
+    }
+
+    if (request_.HasLimits())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "Cannot estimate the count of a lookup with limits");
+    }
+
+    if (exactThreshold == std::numeric_limits<uint64_t>::max())
+    {
+      isExact = true;
+      return Count(context);
+    }
+
+    // The "LIMIT" clause stops the lookup in the database as soon as
+    // more resources than the threshold are matching
+    uint64_t count = 0;
+    request_.SetLimits(0, exactThreshold + 1);
+
+    try
+    {
+      context.GetIndex().ExecuteCount(count, request_);
+    }
+    catch (OrthancException&)
+    {
+      request_.ClearLimits();
+      throw;
+    }
+
+    request_.ClearLimits();
+
+    if (count <= exactThreshold)
+    {
+      isExact = true;
+      return count;
+    }
+    else
+    {
+      uint64_t diskSize, uncompressedSize, countPatients, countStudies, countSeries, countInstances;
+      context.GetIndex().GetGlobalStatistics(diskSize, uncompressedSize, countPatients,
+                                             countStudies, countSeries, countInstances);
+
+      uint64_t upperBound;
+
+      switch (request_.GetLevel())
+      {
+        case ResourceType_Patient:
+          upperBound = countPatients;
+          break;
+
+        case ResourceType_Study:
+          upperBound = countStudies;
+          break;
+
+        case ResourceType_Series:
+          upperBound = countSeries;
+          break;
+
+        case ResourceType_Instance:
+          upperBound = countInstances;
+          break;
+
+        default:
+          THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_ParameterOutOfRange);
+      }
+
+      isExact = false;
+      return std::max(upperBound, count);
+    }
+  }
+
+
   void ResourceFinder::Execute(IVisitor& visitor,
                                ServerContext& context)
   {
@@ -1065,21 +1344,54 @@ namespace Orthanc
                              "Unable to use 'Since' when finding resources when querying against Dicom Tags that are not in the MainDicomTags or when using CaseSenstive queries.");
     }
 
+    if (request_.HasKeysetPagination())
+    {
+      if (!context.GetIndex().HasKeysetPaginationSupport())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "CAPABILITIES: Trying to use a continuation token while the Database backend does not support keyset pagination");
+      }
+      else if ((hasLimitsSince_ && limitsSince_ > 0) ||
+               !request_.GetOrdering().empty())
+      {
+        throw OrthancException(ErrorCode_BadRequest, "A continuation token cannot be combined with 'Since' or with an ordering");
+      }
+    }
+
+    hasNextKeyset_ = false;
+
     bool isWarning002Enabled = false;
     bool isWarning004Enabled = false;
     bool isWarning006Enabled = false;
     bool isWarning007Enabled = false;
 
     {
-      OrthancConfiguration::ReaderLock lock;
-      isWarning002Enabled = lock.GetConfiguration().IsWarningEnabled(Warnings_002_InconsistentDicomTagsInDb);
-      isWarning004Enabled = lock.GetConfiguration().IsWarningEnabled(Warnings_004_NoMainDicomTagsSignature);
-      isWarning006Enabled = lock.GetConfiguration().IsWarningEnabled(Warnings_006_RequestingTagFromMetaHeader);
-      isWarning007Enabled = lock.GetConfiguration().IsWarningEnabled(Warnings_007_MissingRequestedTagsNotReadFromDisk);
+      boost::shared_ptr<const OrthancConfiguration::Snapshot> configuration = OrthancConfiguration::GetSnapshot();
+      isWarning002Enabled = configuration->IsWarningEnabled(Warnings_002_InconsistentDicomTagsInDb);
+      isWarning004Enabled = configuration->IsWarningEnabled(Warnings_004_NoMainDicomTagsSignature);
+      isWarning006Enabled = configuration->IsWarningEnabled(Warnings_006_RequestingTagFromMetaHeader);
+      isWarning007Enabled = configuration->IsWarningEnabled(Warnings_007_MissingRequestedTagsNotReadFromDisk);
     }
 
-    FindResponse response;
-    context.GetIndex().ExecuteFind(response, request_);
+    // Shared with the loaders of the missing tags, that might still
+    // be running if this method exits because of an error
+    boost::shared_ptr<FindResponse> response(new FindResponse);
+
+    boost::posix_time::ptime phaseStart = boost::posix_time::microsec_clock::universal_time();
+    context.GetIndex().ExecuteFind(*response, request_);
+    databaseDuration_ += GetElapsedMicroseconds(phaseStart);
+    candidatesCount_ += response->GetSize();
+
+    if (request_.HasKeysetPagination() &&
+        request_.HasLimits() &&
+        request_.GetLimitsCount() > 0 &&
+        response->GetSize() >= request_.GetLimitsCount())
+    {
+      // The page is full, so there might be more resources. The
+      // continuation token is computed from the last resource of the
+      // database page, even if it is discarded by the "lookup_" below.
+      hasNextKeyset_ = true;
+      nextKeysetLastInternalId_ = response->GetResourceByIndex(response->GetSize() - 1).GetInternalId();
+    }
 
     bool complete;
 
@@ -1092,7 +1404,7 @@ namespace Orthanc
 
       case PagingMode_FullManual:
         complete = (databaseLimits_ == 0 ||
-                    response.GetSize() <= databaseLimits_);
+                    response->GetSize() <= databaseLimits_);
         break;
 
       default:
@@ -1101,15 +1413,34 @@ namespace Orthanc
 
     if (lookup_.get() != NULL)
     {
-      LOG(INFO) << "Number of candidate resources after fast DB filtering on main DICOM tags: " << response.GetSize();
+      LOG(INFO) << "Number of candidate resources after fast DB filtering on main DICOM tags: " << response->GetSize();
     }
 
-    size_t countResults = 0;
-    size_t skipped = 0;
+    /**
+     * First pass: Collect the requested tags that are available from
+     * the database. If a pool of loaders is available, the reading of
+     * the missing tags from the storage area is scheduled, with at
+     * most "GetFindLoadersPerRequest()" DICOM files being read at
+     * once. Otherwise, the missing tags are read one resource after
+     * the other during the second pass, which avoids reading the
+     * resources that are beyond the limits.
+     **/
+    phaseStart = boost::posix_time::microsec_clock::universal_time();
 
-    for (size_t i = 0; i < response.GetSize(); i++)
+    boost::shared_ptr<IExecutorService> loaders = context.GetFindLoaders();
+
+    std::unique_ptr<CallableGroup> loading;
+    if (loaders.get() != NULL)
     {
-      const FindResponse::Resource& resource = response.GetResourceByIndex(i);
+      loading.reset(new CallableGroup(loaders, context.GetFindLoadersPerRequest()));
+    }
+
+    std::vector< boost::shared_ptr<DicomMap> > allRequestedTags(response->GetSize());
+    std::vector< std::set<DicomTag> > allMissingTags(response->GetSize());
+
+    for (size_t i = 0; i < response->GetSize(); i++)
+    {
+      const FindResponse::Resource& resource = response->GetResourceByIndex(i);
 
 #if 0
       {
@@ -1119,7 +1450,8 @@ namespace Orthanc
       }
 #endif
 
-      DicomMap outRequestedTags;
+      allRequestedTags[i].reset(new DicomMap);
+      DicomMap& outRequestedTags = *allRequestedTags[i];
 
       if (HasRequestedTags())
       {
@@ -1171,7 +1503,13 @@ namespace Orthanc
           // -> from 1.12.5, "StorageAccessOnFind": "Always" is actually equivalent to "StorageAccessOnFind": "Answers"
           if (IsStorageAccessAllowed())
           {
-            ReadMissingTagsFromStorageArea(outRequestedTags, context, request_, resource, remainingRequestedTags);
+            allMissingTags[i] = remainingRequestedTags;
+
+            if (loading.get() != NULL)
+            {
+              loading->Submit(new MissingTagsLoader(context, request_, response, i, remainingRequestedTags));
+              storageReads_++;
+            }
           }
           else if (isWarning007Enabled)
           {
@@ -1204,6 +1542,42 @@ namespace Orthanc
         }
 
       }
+    }
+
+    /**
+     * Second pass: Apply the post-filtering and the paging, in the
+     * order of the database response.
+     **/
+    requestedTagsDuration_ += GetElapsedMicroseconds(phaseStart);
+    phaseStart = boost::posix_time::microsec_clock::universal_time();
+
+    std::unique_ptr<CallableGroup::Iterator> loaded;
+    if (loading.get() != NULL)
+    {
+      loaded.reset(new CallableGroup::Iterator(*loading));
+    }
+
+    size_t countResults = 0;
+    size_t skipped = 0;
+
+    for (size_t i = 0; i < response->GetSize(); i++)
+    {
+      const FindResponse::Resource& resource = response->GetResourceByIndex(i);
+      DicomMap& outRequestedTags = *allRequestedTags[i];
+
+      if (!allMissingTags[i].empty())
+      {
+        if (loaded.get() == NULL)
+        {
+          ReadMissingTagsFromStorageArea(outRequestedTags, context, request_, resource, allMissingTags[i]);
+          storageReads_++;
+        }
+        else
+        {
+          std::unique_ptr<IDynamicObject> tags(loaded->Next());
+          outRequestedTags.Merge(dynamic_cast<MissingTagsLoader::Result&>(*tags).GetTags());
+        }
+      }
 
       bool match = true;
 
@@ -1215,7 +1589,11 @@ namespace Orthanc
         match = lookup_->IsMatch(tags);
       }
 
-      if (match)
+      if (!match)
+      {
+        filteredOutCount_++;
+      }
+      else
       {
         if (pagingMode_ == PagingMode_FullDatabase)
         {
@@ -1244,6 +1622,8 @@ namespace Orthanc
       }
     }
 
+    postFilteringDuration_ += GetElapsedMicroseconds(phaseStart);
+
     if (complete)
     {
       visitor.MarkAsComplete();
@@ -1264,57 +1644,172 @@ namespace Orthanc
     }
   }
 
-  void ResourceFinder::Execute(Json::Value& target,
-                               ServerContext& context,
-                               DicomToJsonFormat format,
-                               bool includeAllMetadata)
+  void ResourceFinder::ExecuteByPages(IVisitor& visitor,
+                                      ServerContext& context,
+                                      uint64_t pageSize)
   {
-    class Visitor : public IVisitor
+    class PageVisitor : public IVisitor
+    {
+    private:
+      IVisitor&  visitor_;
+
+    public:
+      explicit PageVisitor(IVisitor& visitor) :
+        visitor_(visitor)
+      {
+      }
+
+      virtual void Apply(const FindResponse::Resource& resource,
+                         const DicomMap& requestedTags) ORTHANC_OVERRIDE
+      {
+        visitor_.Apply(resource, requestedTags);
+      }
+
+      virtual void MarkAsComplete() ORTHANC_OVERRIDE
+      {
+        // Only the last page can complete the answer
+      }
+    };
+
+    if (pageSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (!context.GetIndex().HasFindSupport() ||
+        !context.GetIndex().HasKeysetPaginationSupport() ||
+        request_.HasKeysetPagination() ||
+        (hasLimitsSince_ && limitsSince_ > 0) ||
+        !request_.GetOrdering().empty())
+    {
+      // Keyset pagination cannot be used, read all the resources at once
+      Execute(visitor, context);
+      return;
+    }
+
+    // Overall number of resources to be read from the database, "0" means no limit
+    uint64_t remaining = (hasLimitsCount_ ? limitsCount_ : 0);
+
+    if (databaseLimits_ != 0 &&
+        (remaining == 0 || remaining > databaseLimits_))
+    {
+      remaining = databaseLimits_;
+    }
+
+    PageVisitor pageVisitor(visitor);
+    int64_t lastInternalId = 0;
+    bool complete = true;
+
+    for (;;)
+    {
+      uint64_t count = pageSize;
+      if (remaining != 0 &&
+          remaining < count)
+      {
+        count = remaining;
+      }
+
+      // "Execute()" derives the limits of the database request from these members
+      hasLimitsCount_ = true;
+      limitsCount_ = count;
+      request_.SetKeysetPagination(lastInternalId);
+
+      Execute(pageVisitor, context);
+
+      if (!hasNextKeyset_)
+      {
+        break;  // This was the last page
+      }
+
+      if (remaining != 0)
+      {
+        remaining -= count;
+        if (remaining == 0)
+        {
+          // The limits are reached, but more resources are available
+          complete = false;
+          break;
+        }
+      }
+
+      lastInternalId = nextKeysetLastInternalId_;
+    }
+
+    // No continuation token is reported, as all the pages have been read
+    hasNextKeyset_ = false;
+
+    if (complete)
+    {
+      visitor.MarkAsComplete();
+    }
+  }
+
+
+  void ResourceFinder::Format(Json::Value& target,
+                              const FindResponse::Resource& resource,
+                              const DicomMap& requestedTags,
+                              ServerIndex& index,
+                              DicomToJsonFormat format) const
+  {
+    if (responseContent_ != ResponseContentFlags_ID)
+    {
+      Expand(target, resource, index, format);
+
+      if (HasRequestedTags())
+      {
+        static const char* const REQUESTED_TAGS = "RequestedTags";
+        target[REQUESTED_TAGS] = Json::objectValue;
+        FromDcmtkBridge::ToJson(target[REQUESTED_TAGS], requestedTags, format);
+      }
+    }
+    else
+    {
+      target = resource.GetIdentifier();
+    }
+  }
+
+
+  namespace
+  {
+    // Formats the resources of the answer, and stores them either in
+    // a JSON array or in a serialized JSON array
+    class FormatVisitor : public ResourceFinder::IVisitor
     {
     private:
-      const ResourceFinder&  that_;
+      const ResourceFinder&  finder_;
       ServerIndex&           index_;
-      Json::Value&           target_;
       DicomToJsonFormat      format_;
-      bool                   hasRequestedTags_;
-      bool                   includeAllMetadata_;
+      Json::Value*           target_;
+      RestApiJsonWriter*     writer_;
 
     public:
-      Visitor(const ResourceFinder& that,
-              ServerIndex& index,
-              Json::Value& target,
-              DicomToJsonFormat format,
-              bool hasRequestedTags,
-              bool includeAllMetadata) :
-        that_(that),
+      FormatVisitor(const ResourceFinder& finder,
+                    ServerIndex& index,
+                    DicomToJsonFormat format,
+                    Json::Value* target,
+                    RestApiJsonWriter* writer) :
+        finder_(finder),
         index_(index),
-        target_(target),
         format_(format),
-        hasRequestedTags_(hasRequestedTags),
-        includeAllMetadata_(includeAllMetadata)
+        target_(target),
+        writer_(writer)
       {
+        assert((target == NULL) != (writer == NULL));
       }
 
       virtual void Apply(const FindResponse::Resource& resource,
                          const DicomMap& requestedTags) ORTHANC_OVERRIDE
       {
-        if (that_.responseContent_ != ResponseContentFlags_ID)
-        {
-          Json::Value item;
-          that_.Expand(item, resource, index_, format_);
-
-          if (hasRequestedTags_)
-          {
-            static const char* const REQUESTED_TAGS = "RequestedTags";
-            item[REQUESTED_TAGS] = Json::objectValue;
-            FromDcmtkBridge::ToJson(item[REQUESTED_TAGS], requestedTags, format_);
-          }
+        Json::Value item;
+        finder_.Format(item, resource, requestedTags, index_, format_);
 
-          target_.append(item);
+        if (target_ != NULL)
+        {
+          target_->append(Json::nullValue).swap(item);
         }
         else
         {
-          target_.append(resource.GetIdentifier());
+          writer_->Append(item);
         }
       }
 
@@ -1322,12 +1817,31 @@ namespace Orthanc
       {
       }
     };
+  }
+
 
+  void ResourceFinder::Execute(Json::Value& target,
+                               ServerContext& context,
+                               DicomToJsonFormat format,
+                               bool includeAllMetadata)
+  {
     UpdateRequestLimits(context);
 
     target = Json::arrayValue;
 
-    Visitor visitor(*this, context.GetIndex(), target, format, HasRequestedTags(), includeAllMetadata);
+    FormatVisitor visitor(*this, context.GetIndex(), format, &target, NULL);
+    Execute(visitor, context);
+  }
+
+
+  void ResourceFinder::Execute(RestApiJsonWriter& target,
+                               ServerContext& context,
+                               DicomToJsonFormat format,
+                               bool includeAllMetadata)
+  {
+    UpdateRequestLimits(context);
+
+    FormatVisitor visitor(*this, context.GetIndex(), format, NULL, &target);
     Execute(visitor, context);
   }
 
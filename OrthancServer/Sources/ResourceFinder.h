@@ -29,6 +29,7 @@
 namespace Orthanc
 {
   class DatabaseLookup;
+  class RestApiJsonWriter;
   class ServerContext;
   class ServerIndex;
 
@@ -66,11 +67,19 @@ namespace Orthanc
     bool                             hasLimitsCount_;
     uint64_t                         limitsSince_;
     uint64_t                         limitsCount_;
+    bool                             hasNextKeyset_;         // New in Orthanc 1.12.12
+    int64_t                          nextKeysetLastInternalId_;
     ResponseContentFlags             responseContent_;
     FindStorageAccessMode            storageAccessMode_;
     bool                             supportsChildExistQueries_;
     std::set<DicomTag>               requestedTags_;
     std::set<DicomTag>               requestedComputedTags_;
+    uint64_t                         storageReads_;          // New in Orthanc 1.12.12
+    uint64_t                         candidatesCount_;       // New in Orthanc 1.12.12
+    uint64_t                         filteredOutCount_;
+    uint64_t                         databaseDuration_;      // In microseconds
+    uint64_t                         requestedTagsDuration_;
+    uint64_t                         postFilteringDuration_;
 
     bool                             isWarning002Enabled_;
     bool                             isWarning004Enabled_;
@@ -123,6 +132,29 @@ namespace Orthanc
 
     void SetLimitsCount(uint64_t count);
 
+    /**
+     * Enables keyset pagination (new in Orthanc 1.12.12): the
+     * resources are listed in the order of their insertion, and each
+     * page resumes after the last resource of the previous page,
+     * whatever the position of the page in the listing. "token" is
+     * the continuation token of the previous page, or an empty string
+     * for the first page. Cannot be combined with "since" or with an
+     * ordering.
+     **/
+    void SetContinuationToken(const std::string& token);
+
+    // Only valid after "Execute()", returns "false" if keyset
+    // pagination is disabled or if this was the last page
+    bool LookupContinuationToken(std::string& token) const;
+
+    // Number of resources whose missing requested tags have been read
+    // from the storage area by the previous calls to "Execute()" (new
+    // in Orthanc 1.12.12)
+    uint64_t GetStorageReadsCount() const
+    {
+      return storageReads_;
+    }
+
     void SetDatabaseLookup(const DatabaseLookup& lookup);
 
     void AddRequestedTag(const DicomTag& tag);
@@ -192,13 +224,67 @@ namespace Orthanc
                  DicomToJsonFormat format,
                  bool includeAllMetadata);
 
+    // Same as above, but each resource is serialized as soon as it is
+    // formatted (new in Orthanc 1.12.12)
+    void Execute(RestApiJsonWriter& target,
+                 ServerContext& context,
+                 DicomToJsonFormat format,
+                 bool includeAllMetadata);
+
+    /**
+     * Same as "Execute()", but the database is read by successive
+     * pages of at most "pageSize" resources using keyset pagination
+     * (new in Orthanc 1.12.12), which bounds the memory that is
+     * needed to answer large queries. The resources that are
+     * inserted while the pages are read might be reported. Falls
+     * back to "Execute()" if the database does not support keyset
+     * pagination, or if "since", an ordering, or a continuation
+     * token is used.
+     **/
+    void ExecuteByPages(IVisitor& visitor,
+                        ServerContext& context,
+                        uint64_t pageSize);
+
+    // Formats one resource of the answer, either as its Orthanc
+    // identifier or as its expanded description, depending on the
+    // response content (new in Orthanc 1.12.12)
+    void Format(Json::Value& target,
+                const FindResponse::Resource& resource,
+                const DicomMap& requestedTags,
+                ServerIndex& index,
+                DicomToJsonFormat format) const;
+
     bool ExecuteOneResource(Json::Value& target,
                             ServerContext& context,
                             DicomToJsonFormat format,
                             bool includeAllMetadata);
 
+    /**
+     * Runs the lookup like "Execute()", but only counts the answers,
+     * and describes how the lookup was evaluated (new in Orthanc
+     * 1.12.12): The number of candidate resources returned by the
+     * database, of candidates that were rejected by the DICOM tag
+     * constraints after the database, of DICOM files read from the
+     * storage area, the time spent in each phase and, if the database
+     * engine supports it, the SQL of the lookup and its query plan.
+     **/
+    void Explain(Json::Value& target,
+                 ServerContext& context);
+
     uint64_t Count(ServerContext& context) const;
 
+    /**
+     * Fast approximate count (new in Orthanc 1.12.12). The database
+     * only counts up to "exactThreshold + 1" matching resources. If
+     * there are not more than "exactThreshold" matches, the returned
+     * count is exact. Otherwise, the returned count is an upper bound
+     * that is read from the statistics of the database index, and
+     * "isExact" is set to "false".
+     **/
+    uint64_t EstimateCount(bool& isExact /* out */,
+                           ServerContext& context,
+                           uint64_t exactThreshold);
+
     bool CanBeFullyPerformedInDb() const
     {
       return canBeFullyPerformedInDb_;
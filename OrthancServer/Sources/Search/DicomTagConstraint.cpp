@@ -31,8 +31,7 @@
 #include "../../../OrthancFramework/Sources/OrthancException.h"
 #include "../../../OrthancFramework/Sources/Toolbox.h"
 #include "DatabaseDicomTagConstraint.h"
-
-#include <boost/regex.hpp>
+#include "WildcardMatcher.h"
 
 namespace Orthanc
 {
@@ -69,26 +68,6 @@ namespace Orthanc
   };
 
 
-  class DicomTagConstraint::RegularExpression : public boost::noncopyable
-  {
-  private:
-    boost::regex  regex_;
-
-  public:
-    RegularExpression(const std::string& source,
-                      bool caseSensitive)
-    {
-      NormalizedString normalized(source, caseSensitive);
-      regex_ = boost::regex(Toolbox::WildcardToRegularExpression(normalized.GetValue()));
-    }
-
-    const boost::regex& GetValue() const
-    {
-      return regex_;
-    }
-  };
-
-
   void DicomTagConstraint::AssignSingleValue(const std::string& value)
   {
     if (constraintType_ != ConstraintType_Wildcard &&
@@ -281,12 +260,13 @@ namespace Orthanc
 
       case ConstraintType_Wildcard:
       {
-        if (regex_.get() == NULL)
+        if (wildcard_.get() == NULL)
         {
-          regex_.reset(new RegularExpression(GetValue(), caseSensitive_));
+          NormalizedString pattern(GetValue(), caseSensitive_);
+          wildcard_.reset(new WildcardMatcher(pattern.GetValue()));
         }
 
-        return boost::regex_match(source.GetValue(), regex_->GetValue());
+        return wildcard_->IsMatch(source.GetValue());
       }
 
       case ConstraintType_List:
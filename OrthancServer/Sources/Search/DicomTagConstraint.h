@@ -31,11 +31,12 @@
 
 namespace Orthanc
 {
+  class WildcardMatcher;
+
   class DicomTagConstraint : public boost::noncopyable
   {
   private:
     class NormalizedString;
-    class RegularExpression;
 
     DicomTag                tag_;
     ConstraintType          constraintType_;
@@ -43,7 +44,7 @@ namespace Orthanc
     bool                    caseSensitive_;
     bool                    mandatory_;
 
-    mutable boost::shared_ptr<RegularExpression>  regex_;  // mutable because the regex is an internal object created only when required (in IsMatch const method)
+    mutable boost::shared_ptr<WildcardMatcher>  wildcard_;  // mutable because the matcher is an internal object created only when required (in IsMatch const method)
 
     void AssignSingleValue(const std::string& value);
 
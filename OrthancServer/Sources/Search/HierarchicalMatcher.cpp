@@ -36,12 +36,7 @@ namespace Orthanc
 {
   HierarchicalMatcher::HierarchicalMatcher(ParsedDicomFile& query)
   {
-    bool caseSensitivePN;
-
-    {
-      OrthancConfiguration::ReaderLock lock;
-      caseSensitivePN = lock.GetConfiguration().GetBooleanParameter("CaseSensitivePN");
-    }
+    const bool caseSensitivePN = OrthancConfiguration::GetSnapshot()->IsCaseSensitivePN();
 
     bool hasCodeExtensions;
     Encoding encoding = query.DetectEncoding(hasCodeExtensions);
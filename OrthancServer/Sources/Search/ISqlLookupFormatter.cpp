@@ -80,6 +80,98 @@ namespace Orthanc
   }      
 
 
+  static const size_t NGRAM_LENGTH = 3;
+
+  // Don't generate too many parameters for long patterns, as a few
+  // n-grams are already very selective
+  static const size_t MAX_NGRAMS_PER_CONSTRAINT = 8;
+
+
+  // Must be called after "FormatComparison()" on the same
+  // constraint, as the parameters are bound in the order of their
+  // generation
+  static bool FormatNGramFilter(std::string& target,
+                                ISqlLookupFormatter& formatter,
+                                const DatabaseDicomTagConstraint& constraint,
+                                size_t index)
+  {
+    if (constraint.GetConstraintType() != ConstraintType_Wildcard ||
+        !constraint.IsIdentifier() ||
+        !constraint.IsMandatory() ||  // Optional constraints also match the missing values
+        !formatter.HasNGramIndex(constraint.GetTag()))
+    {
+      return false;
+    }
+
+    std::string pattern = constraint.GetSingleValue();
+
+    if (!constraint.IsCaseSensitive())
+    {
+      // The identifiers are stored in uppercase (cf. "ServerToolbox::NormalizeIdentifier()")
+      Toolbox::ToUpperCase(pattern);
+    }
+
+    std::set<std::string> ngrams;
+    ISqlLookupFormatter::ExtractNGrams(ngrams, pattern, true);
+
+    if (ngrams.empty())
+    {
+      return false;  // The literal parts of the pattern are too short
+    }
+
+    std::vector<std::string> parameters;
+    for (std::set<std::string>::const_iterator it = ngrams.begin();
+         it != ngrams.end() && parameters.size() < MAX_NGRAMS_PER_CONSTRAINT; ++it)
+    {
+      parameters.push_back(formatter.GenerateParameter(*it));
+    }
+
+    std::string joined;
+    Toolbox::JoinStrings(joined, parameters, ", ");
+
+    std::string tag = "t" + boost::lexical_cast<std::string>(index);
+
+    target = (tag + ".id IN (SELECT id FROM DicomIdentifiersNGrams WHERE tagGroup = " +
+              boost::lexical_cast<std::string>(constraint.GetTag().GetGroup()) +
+              " AND tagElement = " + boost::lexical_cast<std::string>(constraint.GetTag().GetElement()) +
+              " AND ngram IN (" + joined + ") GROUP BY id HAVING COUNT(*) = " +
+              boost::lexical_cast<std::string>(parameters.size()) + ")");
+    return true;
+  }
+
+
+  // Must be called after "FormatComparison()" on the same
+  // constraint, as the parameters are bound in the order of their
+  // generation. The "LIKE" predicate cannot be evaluated using an
+  // index, contrarily to this range on the literal prefix.
+  static bool FormatMetadataRangeFilter(std::string& target,
+                                        ISqlLookupFormatter& formatter,
+                                        const DatabaseMetadataConstraint& constraint,
+                                        size_t index)
+  {
+    std::string lowerBound, upperBound;
+
+    if (constraint.GetConstraintType() != ConstraintType_Wildcard ||
+        !constraint.IsCaseSensitive() ||
+        !formatter.HasMetadataValuesIndex() ||
+        !ISqlLookupFormatter::GetWildcardPrefixRange(lowerBound, upperBound, constraint.GetSingleValue()))
+    {
+      return false;
+    }
+
+    std::string tag = "t" + boost::lexical_cast<std::string>(index);
+
+    target = tag + ".value >= " + formatter.GenerateParameter(lowerBound);
+
+    if (!upperBound.empty())
+    {
+      target += " AND " + tag + ".value < " + formatter.GenerateParameter(upperBound);
+    }
+
+    return true;
+  }
+
+
   static bool FormatComparison(std::string& target,
                                ISqlLookupFormatter& formatter,
                                const IDatabaseConstraint& constraint,
@@ -409,6 +501,69 @@ namespace Orthanc
     }
   }
 
+  /**
+   * The resources are selected from the "Labels" table, so that the
+   * database can enumerate the resources with the given labels using
+   * the index on "(label, id)", instead of counting the labels of
+   * each candidate resource (new in Orthanc 1.12.12). The cost of the
+   * lookup is thus proportional to the number of labelled resources.
+   *
+   * "In SQL Server, NOT EXISTS and NOT IN predicates are the best
+   * way to search for missing values, as long as both columns in
+   * question are NOT NULL."
+   * https://explainextended.com/2009/09/15/not-in-vs-not-exists-vs-left-join-is-null-sql-server/
+   **/
+  static std::string FormatLabelsFilter(ISqlLookupFormatter& formatter,
+                                        const std::string& internalId,
+                                        const std::set<std::string>& labels,
+                                        LabelsConstraint constraint)
+  {
+    if (labels.empty())
+    {
+      if (constraint == LabelsConstraint_None)
+      {
+        // from 1.12.11, 'None' with an empty labels list means "list all resources without any labels"
+        return internalId + " NOT IN (SELECT id FROM Labels)";
+      }
+      else
+      {
+        return "";
+      }
+    }
+
+    std::list<std::string> formattedLabels;
+    for (std::set<std::string>::const_iterator it = labels.begin(); it != labels.end(); ++it)
+    {
+      formattedLabels.push_back(formatter.GenerateParameter(*it));
+    }
+
+    const std::string selectedLabels = "SELECT id FROM Labels WHERE label IN (" + Join(formattedLabels, "", ", ") + ")";
+
+    switch (constraint)
+    {
+      case LabelsConstraint_Any:
+        return internalId + " IN (" + selectedLabels + ")";
+
+      case LabelsConstraint_All:
+        if (labels.size() == 1)
+        {
+          return internalId + " IN (" + selectedLabels + ")";
+        }
+        else
+        {
+          return (internalId + " IN (" + selectedLabels + " GROUP BY id HAVING COUNT(1) = " +
+                  boost::lexical_cast<std::string>(labels.size()) + ")");
+        }
+
+      case LabelsConstraint_None:
+        return internalId + " NOT IN (" + selectedLabels + ")";
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
   static bool FormatComparison2(std::string& target,
                                 ISqlLookupFormatter& formatter,
                                 const DatabaseDicomTagConstraint& constraint,
@@ -578,6 +733,71 @@ namespace Orthanc
   }
 
 
+  void ISqlLookupFormatter::ExtractNGrams(std::set<std::string>& target,
+                                          const std::string& value,
+                                          bool isWildcard)
+  {
+    target.clear();
+
+    size_t start = 0;
+    while (start < value.size())
+    {
+      size_t end = start;
+      while (end < value.size() &&
+             !(isWildcard && (value[end] == '*' || value[end] == '?')))
+      {
+        end++;
+      }
+
+      // Extract the n-grams of the literal part "value[start:end]"
+      for (size_t i = start; i + NGRAM_LENGTH <= end; i++)
+      {
+        target.insert(value.substr(i, NGRAM_LENGTH));
+      }
+
+      start = end + 1;
+    }
+  }
+
+
+  bool ISqlLookupFormatter::GetWildcardPrefixRange(std::string& lowerBound,
+                                                   std::string& upperBound,
+                                                   const std::string& pattern)
+  {
+    size_t length = 0;
+    while (length < pattern.size() &&
+           pattern[length] != '*' &&
+           pattern[length] != '?')
+    {
+      length++;
+    }
+
+    if (length == 0)
+    {
+      return false;
+    }
+
+    lowerBound = pattern.substr(0, length);
+
+    // The smallest string that is greater than all the strings with
+    // this prefix: Drop the trailing 0xff bytes, then increment the
+    // last byte
+    upperBound = lowerBound;
+    while (!upperBound.empty() &&
+           static_cast<uint8_t>(upperBound[upperBound.size() - 1]) == 0xff)
+    {
+      upperBound.resize(upperBound.size() - 1);
+    }
+
+    if (!upperBound.empty())
+    {
+      upperBound[upperBound.size() - 1] = static_cast<char>(static_cast<uint8_t>(upperBound[upperBound.size() - 1]) + 1);
+    }
+
+    return true;
+  }
+
+
   void ISqlLookupFormatter::GetLookupLevels(ResourceType& lowerLevel,
                                             ResourceType& upperLevel,
                                             const ResourceType& queryLevel,
@@ -675,46 +895,10 @@ namespace Orthanc
     where.push_back(FormatLevel(queryLevel) + ".resourceType = " +
                     formatter.FormatResourceType(queryLevel) + comparisons);
 
-    if (!labels.empty())
+    std::string labelsFilter = FormatLabelsFilter(formatter, FormatLevel(queryLevel) + ".internalId", labels, labelsConstraint);
+    if (!labelsFilter.empty())
     {
-      /**
-       * "In SQL Server, NOT EXISTS and NOT IN predicates are the best
-       * way to search for missing values, as long as both columns in
-       * question are NOT NULL."
-       * https://explainextended.com/2009/09/15/not-in-vs-not-exists-vs-left-join-is-null-sql-server/
-       **/
-
-      std::list<std::string> formattedLabels;
-      for (std::set<std::string>::const_iterator it = labels.begin(); it != labels.end(); ++it)
-      {
-        formattedLabels.push_back(formatter.GenerateParameter(*it));
-      }
-
-      std::string condition;
-      switch (labelsConstraint)
-      {
-        case LabelsConstraint_Any:
-          condition = "> 0";
-          break;
-          
-        case LabelsConstraint_All:
-          condition = "= " + boost::lexical_cast<std::string>(labels.size());
-          break;
-          
-        case LabelsConstraint_None:
-          condition = "= 0";
-          break;
-          
-        default:
-          throw OrthancException(ErrorCode_ParameterOutOfRange);
-      }
-      
-      where.push_back("(SELECT COUNT(1) FROM Labels AS selectedLabels WHERE selectedLabels.id = " + FormatLevel(queryLevel) +
-                      ".internalId AND selectedLabels.label IN (" + Join(formattedLabels, "", ", ") + ")) " + condition);
-    }
-    else if (labelsConstraint == LabelsConstraint_None) // from 1.12.11, 'None' with an empty labels list means "list all resources without any labels"
-    {
-      where.push_back("(SELECT COUNT(1) FROM Labels WHERE id = " + FormatLevel(queryLevel) + ".internalId) = 0");
+      where.push_back(labelsFilter);
     }
 
     sql += joins + Join(where, " WHERE ", " AND ");
@@ -743,6 +927,14 @@ namespace Orthanc
     std::string ordering;
     std::string orderingJoins;
 
+    if (request.HasKeysetPagination() &&
+        (request.GetOrdering().size() > 0 ||
+         (request.HasLimits() && request.GetLimitsSince() > 0)))
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "Keyset pagination cannot be combined with an ordering or with an offset");
+    }
+
     if (request.GetOrdering().size() > 0)
     {
       int counter = 0;
@@ -804,6 +996,11 @@ namespace Orthanc
 #endif
       ordering += ") AS rowNumber";
     }
+    else if (request.HasKeysetPagination())
+    {
+      // new in 1.12.12: the seek on the internal ID below can use the index on the resource type
+      ordering = "ROW_NUMBER() OVER (ORDER BY " + strQueryLevel + ".internalId) AS rowNumber";
+    }
     else
     {
       ordering = "ROW_NUMBER() OVER (ORDER BY " + strQueryLevel + ".publicId) AS rowNumber";  // we need a default ordering in order to make default queries repeatable when using since&limit
@@ -859,6 +1056,12 @@ namespace Orthanc
       
       if (FormatComparison(comparison, formatter, constraint, count, escapeBrackets))
       {
+        std::string ngramFilter;
+        if (FormatNGramFilter(ngramFilter, formatter, constraint, count))
+        {
+          comparison += " AND " + ngramFilter;
+        }
+
         std::string join;
         FormatJoin(join, constraint, count);
 
@@ -890,6 +1093,12 @@ namespace Orthanc
       
       if (FormatComparison(comparison, formatter, *(*it), count, escapeBrackets))
       {
+        std::string rangeFilter;
+        if (FormatMetadataRangeFilter(rangeFilter, formatter, *(*it), count))
+        {
+          comparison += " AND " + rangeFilter;
+        }
+
         std::string join;
         FormatJoin(join, *(*it), request.GetLevel(), count);
         joins += join;
@@ -925,47 +1134,16 @@ namespace Orthanc
                     formatter.FormatResourceType(queryLevel) + comparisons);
 
 
-    if (!request.GetLabels().empty())
+    std::string labelsFilter = FormatLabelsFilter(formatter, strQueryLevel + ".internalId", request.GetLabels(), request.GetLabelsConstraint());
+    if (!labelsFilter.empty())
     {
-      /**
-       * "In SQL Server, NOT EXISTS and NOT IN predicates are the best
-       * way to search for missing values, as long as both columns in
-       * question are NOT NULL."
-       * https://explainextended.com/2009/09/15/not-in-vs-not-exists-vs-left-join-is-null-sql-server/
-       **/
-
-      const std::set<std::string>& labels = request.GetLabels();
-      std::list<std::string> formattedLabels;
-      for (std::set<std::string>::const_iterator it = labels.begin(); it != labels.end(); ++it)
-      {
-        formattedLabels.push_back(formatter.GenerateParameter(*it));
-      }
-
-      std::string condition;
-      switch (request.GetLabelsConstraint())
-      {
-        case LabelsConstraint_Any:
-          condition = "> 0";
-          break;
-          
-        case LabelsConstraint_All:
-          condition = "= " + boost::lexical_cast<std::string>(labels.size());
-          break;
-          
-        case LabelsConstraint_None:
-          condition = "= 0";
-          break;
-          
-        default:
-          throw OrthancException(ErrorCode_ParameterOutOfRange);
-      }
-      
-      where.push_back("(SELECT COUNT(1) FROM Labels AS selectedLabels WHERE selectedLabels.id = " + strQueryLevel +
-                      ".internalId AND selectedLabels.label IN (" + Join(formattedLabels, "", ", ") + ")) " + condition);
+      where.push_back(labelsFilter);
     }
-    else if (request.GetLabelsConstraint() == LabelsConstraint_None) // from 1.12.11, 'None' with an empty labels list means "list all resources without any labels"
+
+    if (request.HasKeysetPagination())
     {
-      where.push_back("(SELECT COUNT(1) FROM Labels WHERE id = " + strQueryLevel + ".internalId) = 0");
+      // must be the last parameter before the limits, as the parameters are bound in the order of their generation
+      where.push_back(strQueryLevel + ".internalId > " + formatter.GenerateIntegerParameter(request.GetKeysetLastInternalId()));
     }
 
     sql += joins + orderingJoins + Join(where, " WHERE ", " AND ");
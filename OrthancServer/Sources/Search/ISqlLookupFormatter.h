@@ -26,12 +26,14 @@
 #include "../../../OrthancFramework/Sources/Enumerations.h"
 
 #include <boost/noncopyable.hpp>
+#include <set>
 #include <stdint.h>
 #include <vector>
 
 namespace Orthanc
 {
   class DatabaseDicomTagConstraints;
+  class DicomTag;
   class FindRequest;
 
   enum LabelsConstraint
@@ -50,6 +52,12 @@ namespace Orthanc
 
     virtual std::string GenerateParameter(const std::string& value) = 0;
 
+    /**
+     * Generates a parameter holding an integer, such as the internal
+     * ID of a resource. New in Orthanc 1.12.12.
+     **/
+    virtual std::string GenerateIntegerParameter(int64_t value) = 0;
+
     virtual std::string FormatResourceType(ResourceType level) = 0;
 
     virtual std::string FormatWildcardEscape() = 0;
@@ -63,6 +71,45 @@ namespace Orthanc
      **/
     virtual bool IsEscapeBrackets() const = 0;
 
+    /**
+     * Whether the database maintains the n-grams of the values of
+     * this identifier tag in the "DicomIdentifiersNGrams" table, that
+     * can be used to narrow the wildcard lookups before evaluating the
+     * "LIKE" predicate. New in Orthanc 1.12.12.
+     **/
+    virtual bool HasNGramIndex(const DicomTag& tag) const = 0;
+
+    /**
+     * Whether the database indexes the "Metadata" table on its
+     * "(type, value)" columns and compares the text values bytewise,
+     * so that the case-sensitive wildcard constraints on metadata can
+     * be narrowed by a range predicate on their literal prefix. New
+     * in Orthanc 1.12.12.
+     **/
+    virtual bool HasMetadataValuesIndex() const = 0;
+
+    /**
+     * Extracts the distinct n-grams of a normalized identifier. If
+     * "isWildcard" is true, the value is a pattern and only the
+     * n-grams of its literal parts (i.e. between the '*' and '?'
+     * wildcards) are reported, so that they are found in any value
+     * that matches the pattern.
+     **/
+    static void ExtractNGrams(std::set<std::string>& target,
+                              const std::string& value,
+                              bool isWildcard);
+
+    /**
+     * Computes the range "[lowerBound, upperBound)" of the values
+     * that start with the literal prefix of a wildcard pattern, in
+     * the bytewise order. Returns "false" if the pattern starts with
+     * a wildcard. "upperBound" is empty if there is no such bound
+     * (i.e. if the prefix only contains bytes 0xff).
+     **/
+    static bool GetWildcardPrefixRange(std::string& lowerBound,
+                                       std::string& upperBound,
+                                       const std::string& pattern);
+
     static void GetLookupLevels(ResourceType& lowerLevel,
                                 ResourceType& upperLevel,
                                 const ResourceType& queryLevel,
@@ -0,0 +1,188 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "WildcardMatcher.h"
+
+#include "../../../OrthancFramework/Sources/Toolbox.h"
+
+#include <cassert>
+
+
+namespace Orthanc
+{
+  WildcardMatcher::Segment::Segment(const std::string& text) :
+    text_(text),
+    hasQuestionMark_(text.find('?') != std::string::npos)
+  {
+  }
+
+
+  bool WildcardMatcher::Segment::IsMatchAt(const std::string& value,
+                                           size_t position) const
+  {
+    assert(position + text_.size() <= value.size());
+
+    if (!hasQuestionMark_)
+    {
+      return value.compare(position, text_.size(), text_) == 0;
+    }
+
+    for (size_t i = 0; i < text_.size(); i++)
+    {
+      if (text_[i] != '?' &&
+          text_[i] != value[position + i])
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  size_t WildcardMatcher::Segment::Find(const std::string& value,
+                                        size_t from,
+                                        size_t to) const
+  {
+    assert(from <= to && to <= value.size());
+
+    if (to - from < text_.size())
+    {
+      return std::string::npos;
+    }
+    else if (!hasQuestionMark_)
+    {
+      size_t position = value.find(text_, from);
+      if (position != std::string::npos &&
+          position + text_.size() <= to)
+      {
+        return position;
+      }
+      else
+      {
+        return std::string::npos;
+      }
+    }
+    else
+    {
+      for (size_t position = from; position + text_.size() <= to; position++)
+      {
+        if (IsMatchAt(value, position))
+        {
+          return position;
+        }
+      }
+
+      return std::string::npos;
+    }
+  }
+
+
+  static std::string GetFirstSegment(const std::string& pattern)
+  {
+    return pattern.substr(0, pattern.find('*'));
+  }
+
+
+  static std::string GetLastSegment(const std::string& pattern)
+  {
+    size_t star = pattern.rfind('*');
+    if (star == std::string::npos)
+    {
+      return "";  // The first segment already covers the whole pattern
+    }
+    else
+    {
+      return pattern.substr(star + 1);
+    }
+  }
+
+
+  WildcardMatcher::WildcardMatcher(const std::string& pattern) :
+    prefix_(GetFirstSegment(pattern)),
+    suffix_(GetLastSegment(pattern)),
+    hasStar_(pattern.find('*') != std::string::npos),
+    minimumLength_(0)
+  {
+    minimumLength_ = prefix_.GetLength() + suffix_.GetLength();
+
+    if (hasStar_)
+    {
+      std::vector<std::string> tokens;
+      Toolbox::TokenizeString(tokens, pattern, '*');
+
+      // Skip the first and the last tokens, and the empty tokens
+      // that correspond to consecutive stars
+      for (size_t i = 1; i + 1 < tokens.size(); i++)
+      {
+        if (!tokens[i].empty())
+        {
+          inner_.push_back(Segment(tokens[i]));
+          minimumLength_ += tokens[i].size();
+        }
+      }
+    }
+  }
+
+
+  bool WildcardMatcher::IsMatch(const std::string& value) const
+  {
+    if (!hasStar_)
+    {
+      return (value.size() == prefix_.GetLength() &&
+              prefix_.IsMatchAt(value, 0));
+    }
+
+    if (value.size() < minimumLength_)
+    {
+      return false;
+    }
+
+    const size_t end = value.size() - suffix_.GetLength();
+
+    if (!prefix_.IsMatchAt(value, 0) ||
+        !suffix_.IsMatchAt(value, end))
+    {
+      return false;
+    }
+
+    // The leftmost occurrence of each inner segment leaves the most
+    // room to the next segments
+    size_t position = prefix_.GetLength();
+
+    for (size_t i = 0; i < inner_.size(); i++)
+    {
+      position = inner_[i].Find(value, position, end);
+
+      if (position == std::string::npos)
+      {
+        return false;
+      }
+
+      position += inner_[i].GetLength();
+    }
+
+    return true;
+  }
+}
@@ -0,0 +1,79 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <string>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * Matcher for the DICOM wildcards "*" and "?", that is compiled
+   * once from the pattern. The pattern is split at the "*" into
+   * segments: The first and the last segments are anchored at the
+   * beginning and at the end of the value, and the inner segments
+   * are searched from left to right, which requires no
+   * backtracking. As with the regular expressions that were used
+   * before Orthanc 1.12.12, "?" matches exactly one byte.
+   **/
+  class WildcardMatcher : public boost::noncopyable
+  {
+  private:
+    class Segment
+    {
+    private:
+      std::string  text_;
+      bool         hasQuestionMark_;
+
+    public:
+      explicit Segment(const std::string& text);
+
+      size_t GetLength() const
+      {
+        return text_.size();
+      }
+
+      bool IsMatchAt(const std::string& value,
+                     size_t position) const;
+
+      // Returns "std::string::npos" if the segment is not found
+      // within "value[from, to)"
+      size_t Find(const std::string& value,
+                  size_t from,
+                  size_t to) const;
+    };
+
+    Segment               prefix_;
+    Segment               suffix_;
+    std::vector<Segment>  inner_;
+    bool                  hasStar_;
+    size_t                minimumLength_;
+
+  public:
+    explicit WildcardMatcher(const std::string& pattern);
+
+    bool IsMatch(const std::string& value) const;
+  };
+}
@@ -0,0 +1,291 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "SeriesPrefetcher.h"
+
+#include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+#include "ServerContext.h"
+
+
+// Number of series that are remembered as already prefetched, so
+// that reading the next instances of a series doesn't trigger the
+// same read-ahead again
+static const size_t MAX_RECENT_SERIES = 64;
+
+// Maximum number of series waiting for a prefetching thread
+static const unsigned int MAX_PENDING_SERIES_PER_THREAD = 4;
+
+
+namespace Orthanc
+{
+  class SeriesPrefetcher::SeriesRunnable : public IRunnable
+  {
+  private:
+    SeriesPrefetcher&  that_;
+    std::string        seriesId_;
+    std::string        firstInstanceId_;
+
+  public:
+    SeriesRunnable(SeriesPrefetcher& that,
+                   const std::string& seriesId,
+                   const std::string& firstInstanceId) :
+      that_(that),
+      seriesId_(seriesId),
+      firstInstanceId_(firstInstanceId)
+    {
+    }
+
+    virtual ~SeriesRunnable()
+    {
+      // Also invoked if the task is canceled by "ThreadPool::Stop()"
+      that_.SignalSeriesDone();
+    }
+
+    virtual void Run() ORTHANC_OVERRIDE
+    {
+      that_.PrefetchSeries(seriesId_, firstInstanceId_);
+    }
+  };
+
+
+  void SeriesPrefetcher::PrefetchSeries(const std::string& seriesId,
+                                        const std::string& firstInstanceId)
+  {
+    std::vector<std::string> instancesIds;
+    std::vector<FileInfo> filesInfo;
+    context_.GetOrderedChildInstances(instancesIds, filesInfo, seriesId, ResourceType_Series);
+    assert(instancesIds.size() == filesInfo.size());
+
+    size_t start = 0;
+    if (!firstInstanceId.empty())
+    {
+      for (size_t i = 0; i < instancesIds.size(); i++)
+      {
+        if (instancesIds[i] == firstInstanceId)
+        {
+          start = i + 1;  // The first instance has just been read by the caller
+          break;
+        }
+      }
+    }
+
+    // Don't prefetch more than half of the storage cache, otherwise
+    // the last instances would evict the first ones before they are
+    // requested by the viewer
+    const uint64_t budget = context_.GetStorageCacheMaximumSize() / 2;
+
+    uint64_t loaded = 0;
+    unsigned int count = 0;
+
+    for (size_t i = start; i < filesInfo.size(); i++)
+    {
+      if (!IsRunning() ||
+          loaded + filesInfo[i].GetUncompressedSize() > budget)
+      {
+        break;
+      }
+
+      try
+      {
+        if (context_.PrefetchAttachment(filesInfo[i]))
+        {
+          count++;
+        }
+
+        loaded += filesInfo[i].GetUncompressedSize();
+      }
+      catch (OrthancException& e)
+      {
+        // The instance might have been deleted in the meantime
+        LOG(INFO) << "Cannot prefetch instance " << instancesIds[i] << ": " << e.What();
+      }
+    }
+
+    LOG(INFO) << "Prefetched " << count << " instance(s) of series " << seriesId;
+  }
+
+
+  void SeriesPrefetcher::SignalSeriesDone()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    assert(pendingSeries_ > 0);
+    pendingSeries_--;
+  }
+
+
+  bool SeriesPrefetcher::IsRunning()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return running_;
+  }
+
+
+  SeriesPrefetcher::SeriesPrefetcher(ServerContext& context) :
+    context_(context),
+    countThreads_(0),
+    pendingSeries_(0),
+    prefetchOnRead_(false),
+    running_(false)
+  {
+    pool_.SetLoggingThreadName("PREFETCH");
+  }
+
+
+  SeriesPrefetcher::~SeriesPrefetcher()
+  {
+    if (running_)
+    {
+      LOG(ERROR) << "INTERNAL ERROR: SeriesPrefetcher::Stop() should be invoked manually";
+      Stop();
+    }
+  }
+
+
+  void SeriesPrefetcher::SetPrefetchOnRead(bool enabled)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    prefetchOnRead_ = enabled;
+  }
+
+
+  void SeriesPrefetcher::Start(unsigned int countThreads)
+  {
+    if (countThreads == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (running_)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      countThreads_ = countThreads;
+      running_ = true;
+    }
+
+    pool_.SetCountThreads(countThreads);
+    pool_.Start();
+  }
+
+
+  void SeriesPrefetcher::Stop()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!running_)
+      {
+        return;
+      }
+
+      running_ = false;
+    }
+
+    pool_.Stop();
+  }
+
+
+  bool SeriesPrefetcher::Schedule(const std::string& seriesId)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!running_)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls, "Prefetching of series is disabled");
+      }
+
+      if (pendingSeries_ >= countThreads_ * MAX_PENDING_SERIES_PER_THREAD)
+      {
+        return false;
+      }
+
+      pendingSeries_++;
+
+      recentSeries_.AddOrMakeMostRecent(seriesId);
+      if (recentSeries_.GetSize() > MAX_RECENT_SERIES)
+      {
+        recentSeries_.RemoveOldest();
+      }
+    }
+
+    pool_.Submit(new SeriesRunnable(*this, seriesId, ""));
+    return true;
+  }
+
+
+  void SeriesPrefetcher::SignalInstanceRead(const std::string& instanceId)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!running_ ||
+          !prefetchOnRead_ ||
+          pendingSeries_ >= countThreads_ * MAX_PENDING_SERIES_PER_THREAD)
+      {
+        return;
+      }
+    }
+
+    std::string seriesId;
+    if (!context_.GetIndex().LookupParent(seriesId, instanceId, ResourceType_Series))
+    {
+      return;
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!running_ ||
+          recentSeries_.Contains(seriesId) ||
+          pendingSeries_ >= countThreads_ * MAX_PENDING_SERIES_PER_THREAD)
+      {
+        return;
+      }
+
+      pendingSeries_++;
+
+      recentSeries_.Add(seriesId);
+      if (recentSeries_.GetSize() > MAX_RECENT_SERIES)
+      {
+        recentSeries_.RemoveOldest();
+      }
+    }
+
+    try
+    {
+      pool_.Submit(new SeriesRunnable(*this, seriesId, instanceId));
+    }
+    catch (OrthancException&)
+    {
+      // The prefetcher is being stopped, the read-ahead is only a hint
+    }
+  }
+}
@@ -0,0 +1,84 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../../OrthancFramework/Sources/Cache/LeastRecentlyUsedIndex.h"
+#include "../../OrthancFramework/Sources/MultiThreading/ThreadPool.h"
+
+#include <boost/thread/mutex.hpp>
+
+namespace Orthanc
+{
+  class ServerContext;
+
+  /**
+   * Read-ahead of the DICOM instances of a series into the storage
+   * cache, in the order of "ServerContext::GetOrderedChildInstances()",
+   * so that viewers scrolling through a series are served from
+   * RAM. New in Orthanc 1.12.12.
+   **/
+  class SeriesPrefetcher : public boost::noncopyable
+  {
+  private:
+    class SeriesRunnable;
+
+    ServerContext&                       context_;
+    ThreadPool                           pool_;
+    boost::mutex                         mutex_;
+    LeastRecentlyUsedIndex<std::string>  recentSeries_;
+    unsigned int                         countThreads_;
+    unsigned int                         pendingSeries_;
+    bool                                 prefetchOnRead_;
+    bool                                 running_;
+
+    void PrefetchSeries(const std::string& seriesId,
+                        const std::string& firstInstanceId);
+
+    void SignalSeriesDone();
+
+    bool IsRunning();
+
+  public:
+    explicit SeriesPrefetcher(ServerContext& context);
+
+    ~SeriesPrefetcher();
+
+    void SetPrefetchOnRead(bool enabled);
+
+    void Start(unsigned int countThreads);
+
+    void Stop();
+
+    // Asynchronously loads all the instances of the series into the
+    // storage cache. Returns "false" if too many series are already
+    // waiting to be prefetched.
+    bool Schedule(const std::string& seriesId);
+
+    // To be called when an instance is read. If its parent series
+    // has not been recently prefetched, the instances that follow it
+    // in the series are asynchronously loaded into the storage cache.
+    void SignalInstanceRead(const std::string& instanceId);
+  };
+}
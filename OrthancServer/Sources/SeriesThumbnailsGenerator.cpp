@@ -0,0 +1,326 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "SeriesThumbnailsGenerator.h"
+
+#include "../../OrthancFramework/Sources/CompatibilityMath.h"
+#include "../../OrthancFramework/Sources/DicomParsing/Internals/DicomImageDecoder.h"
+#include "../../OrthancFramework/Sources/Images/Image.h"
+#include "../../OrthancFramework/Sources/Images/ImageProcessing.h"
+#include "../../OrthancFramework/Sources/Images/JpegWriter.h"
+#include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/OrthancException.h"
+#include "ServerContext.h"
+
+
+// Number of series that are remembered as already processed, so
+// that receiving the next instances of a series doesn't look for the
+// thumbnail in the database again
+static const size_t MAX_RECENT_SERIES = 256;
+
+// Maximum number of series waiting for a thread. If more series are
+// received, their thumbnail will be generated once the next
+// instance of the series is received.
+static const unsigned int MAX_PENDING_SERIES_PER_THREAD = 16;
+
+
+namespace Orthanc
+{
+  class SeriesThumbnailsGenerator::SeriesRunnable : public IRunnable
+  {
+  private:
+    SeriesThumbnailsGenerator&  that_;
+    std::string                 seriesId_;
+
+  public:
+    SeriesRunnable(SeriesThumbnailsGenerator& that,
+                   const std::string& seriesId) :
+      that_(that),
+      seriesId_(seriesId)
+    {
+    }
+
+    virtual ~SeriesRunnable()
+    {
+      // Also invoked if the task is canceled by "ThreadPool::Stop()"
+      that_.SignalSeriesDone();
+    }
+
+    virtual void Run() ORTHANC_OVERRIDE
+    {
+      try
+      {
+        that_.GenerateThumbnail(seriesId_);
+      }
+      catch (OrthancException& e)
+      {
+        // The series might have been deleted in the meantime, or its
+        // instances might not be decodable
+        LOG(INFO) << "Cannot generate the thumbnail of series " << seriesId_ << ": " << e.What();
+      }
+    }
+  };
+
+
+  void SeriesThumbnailsGenerator::GenerateThumbnail(const std::string& seriesId)
+  {
+    FileInfo attachment;
+    int64_t revision;
+    if (context_.GetIndex().LookupAttachmentNoThrowIfResourceNotFound(
+          attachment, revision, ResourceType_Series, seriesId, FileContentType_SeriesThumbnail))
+    {
+      return;  // Already generated
+    }
+
+    std::vector<std::string> instancesIds;
+    std::vector<FileInfo> filesInfo;
+    context_.GetOrderedChildInstances(instancesIds, filesInfo, seriesId, ResourceType_Series);
+
+    if (instancesIds.empty())
+    {
+      return;
+    }
+
+    // The representative instance is the one in the middle of the
+    // instances that have been received so far
+    const std::string& instanceId = instancesIds[instancesIds.size() / 2];
+
+    std::string jpeg;
+    RenderThumbnail(jpeg, context_, instanceId, size_);
+
+    int64_t newRevision;
+    context_.AddAttachment(newRevision, seriesId, ResourceType_Series, FileContentType_SeriesThumbnail,
+                           jpeg.empty() ? NULL : jpeg.c_str(), jpeg.size(), false, -1, "");
+
+    LOG(INFO) << "Generated the thumbnail of series " << seriesId << " from instance " << instanceId;
+  }
+
+
+  void SeriesThumbnailsGenerator::SignalSeriesDone()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    assert(pendingSeries_ > 0);
+    pendingSeries_--;
+  }
+
+
+  SeriesThumbnailsGenerator::SeriesThumbnailsGenerator(ServerContext& context,
+                                                       unsigned int size) :
+    context_(context),
+    size_(size),
+    countThreads_(0),
+    pendingSeries_(0),
+    running_(false)
+  {
+    if (size == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    pool_.SetLoggingThreadName("THUMBNAILS");
+  }
+
+
+  SeriesThumbnailsGenerator::~SeriesThumbnailsGenerator()
+  {
+    if (running_)
+    {
+      LOG(ERROR) << "INTERNAL ERROR: SeriesThumbnailsGenerator::Stop() should be invoked manually";
+      Stop();
+    }
+  }
+
+
+  void SeriesThumbnailsGenerator::Start(unsigned int countThreads)
+  {
+    if (countThreads == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (running_)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      countThreads_ = countThreads;
+      running_ = true;
+    }
+
+    pool_.SetCountThreads(countThreads);
+    pool_.Start();
+  }
+
+
+  void SeriesThumbnailsGenerator::Stop()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!running_)
+      {
+        return;
+      }
+
+      running_ = false;
+    }
+
+    pool_.Stop();
+  }
+
+
+  void SeriesThumbnailsGenerator::SignalInstanceStored(const std::string& seriesId)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!running_ ||
+          recentSeries_.Contains(seriesId) ||
+          pendingSeries_ >= countThreads_ * MAX_PENDING_SERIES_PER_THREAD)
+      {
+        return;
+      }
+
+      pendingSeries_++;
+
+      recentSeries_.Add(seriesId);
+      if (recentSeries_.GetSize() > MAX_RECENT_SERIES)
+      {
+        recentSeries_.RemoveOldest();
+      }
+    }
+
+    try
+    {
+      pool_.Submit(new SeriesRunnable(*this, seriesId));
+    }
+    catch (OrthancException&)
+    {
+      // The generator is being stopped, the thumbnail will be
+      // generated once the next instance of the series is received
+      boost::mutex::scoped_lock lock(mutex_);
+      if (recentSeries_.Contains(seriesId))
+      {
+        recentSeries_.Invalidate(seriesId);
+      }
+    }
+  }
+
+
+  void SeriesThumbnailsGenerator::RenderThumbnail(std::string& jpeg,
+                                                  ServerContext& context,
+                                                  const std::string& instanceId,
+                                                  unsigned int size)
+  {
+    if (size == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    std::unique_ptr<ParsedDicomFile> header;
+    std::unique_ptr<ImageAccessor> decoded(context.DecodeDicomFrame(header, instanceId, 0));
+    if (decoded.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_NotImplemented, "Cannot decode the first frame of instance " + instanceId);
+    }
+
+    bool invert;
+    double rescaleIntercept, rescaleSlope, windowCenter, windowWidth;
+
+    {
+      std::unique_ptr<ServerContext::DicomCacheLocker> locker;
+      if (header.get() == NULL)
+      {
+        locker.reset(new ServerContext::DicomCacheLocker(context, instanceId));
+      }
+
+      const ParsedDicomFile& dicom = (header.get() != NULL ? *header : locker->GetDicom());
+
+      PhotometricInterpretation photometric;
+      invert = (dicom.LookupPhotometricInterpretation(photometric) &&
+                photometric == PhotometricInterpretation_Monochrome1);
+
+      dicom.GetRescale(rescaleIntercept, rescaleSlope, 0);
+      dicom.GetDefaultWindowing(windowCenter, windowWidth, 0);
+    }
+
+    std::unique_ptr<ImageAccessor> rendered;
+    ImageExtractionMode mode;
+
+    if (decoded->GetFormat() == PixelFormat_RGB24 ||
+        decoded->GetFormat() == PixelFormat_RGB48)
+    {
+      rendered.reset(decoded.release());
+      mode = ImageExtractionMode_Preview;
+      invert = false;
+    }
+    else
+    {
+      // Same windowing as in "/instances/{id}/frames/{frame}/rendered"
+      Image converted(PixelFormat_Float32, decoded->GetWidth(), decoded->GetHeight(), false);
+      ImageProcessing::Convert(converted, *decoded);
+
+      if (windowWidth <= 1.0f)
+      {
+        windowWidth = 1;
+      }
+
+      if (std::abs(rescaleSlope) <= 0.0001)
+      {
+        rescaleSlope = 0.0001;
+      }
+
+      const double scaling = 255.0 * rescaleSlope / windowWidth;
+      const double offset = (rescaleIntercept - windowCenter + windowWidth / 2.0) / rescaleSlope;
+
+      rendered.reset(new Image(PixelFormat_Grayscale8, decoded->GetWidth(), decoded->GetHeight(), false));
+      ImageProcessing::ShiftScale(*rendered, converted, static_cast<float>(offset), static_cast<float>(scaling), false);
+      mode = ImageExtractionMode_UInt8;
+    }
+
+    if (rendered->GetWidth() > size ||
+        rendered->GetHeight() > size)
+    {
+      // Downscale while keeping the aspect ratio, never upscale
+      const float ratio = std::min(static_cast<float>(size) / static_cast<float>(rendered->GetWidth()),
+                                   static_cast<float>(size) / static_cast<float>(rendered->GetHeight()));
+
+      const unsigned int width = static_cast<unsigned int>(std::max(1, Math::iround(ratio * static_cast<float>(rendered->GetWidth()))));
+      const unsigned int height = static_cast<unsigned int>(std::max(1, Math::iround(ratio * static_cast<float>(rendered->GetHeight()))));
+
+      std::unique_ptr<ImageAccessor> resized(new Image(rendered->GetFormat(), width, height, false));
+      ImageProcessing::SmoothGaussian5x5(*rendered, false /* be fast, don't round */);
+      ImageProcessing::Resize(*resized, *rendered);
+      rendered.reset(resized.release());
+    }
+
+    JpegWriter writer;
+    context.ConfigureJpegWriter(writer);
+    DicomImageDecoder::ExtractJpegImage(jpeg, rendered, mode, invert, writer);
+  }
+}
@@ -0,0 +1,90 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include "../../OrthancFramework/Sources/Cache/LeastRecentlyUsedIndex.h"
+#include "../../OrthancFramework/Sources/MultiThreading/ThreadPool.h"
+
+#include <boost/thread/mutex.hpp>
+
+namespace Orthanc
+{
+  class ServerContext;
+
+  /**
+   * Background rendering of one JPEG thumbnail per series, stored as
+   * the "series-thumbnail" attachment of the series as soon as its
+   * first instances are received. This way, the study browsers can
+   * show the series without decoding any pixel data. New in Orthanc
+   * 1.12.12.
+   **/
+  class SeriesThumbnailsGenerator : public boost::noncopyable
+  {
+  private:
+    class SeriesRunnable;
+
+    ServerContext&                       context_;
+    ThreadPool                           pool_;
+    boost::mutex                         mutex_;
+    LeastRecentlyUsedIndex<std::string>  recentSeries_;
+    unsigned int                         size_;
+    unsigned int                         countThreads_;
+    unsigned int                         pendingSeries_;
+    bool                                 running_;
+
+    void GenerateThumbnail(const std::string& seriesId);
+
+    void SignalSeriesDone();
+
+  public:
+    // "size" is the maximum width and height of the thumbnails, in pixels
+    SeriesThumbnailsGenerator(ServerContext& context,
+                              unsigned int size);
+
+    ~SeriesThumbnailsGenerator();
+
+    unsigned int GetSize() const
+    {
+      return size_;
+    }
+
+    void Start(unsigned int countThreads);
+
+    void Stop();
+
+    // To be called once a new instance is stored. If its parent
+    // series has not been recently seen, the thumbnail of the series
+    // is asynchronously generated, unless it already exists.
+    void SignalInstanceStored(const std::string& seriesId);
+
+    // Renders the thumbnail of one instance, as a JPEG image whose
+    // width and height are at most "size" pixels
+    static void RenderThumbnail(std::string& jpeg,
+                                ServerContext& context,
+                                const std::string& instanceId,
+                                unsigned int size);
+  };
+}
@@ -25,28 +25,42 @@
 #include "ServerContext.h"
 
 #include "../../OrthancFramework/Sources/Cache/SharedArchive.h"
+#include "../../OrthancFramework/Sources/Compression/GzipCompressor.h"
 #include "../../OrthancFramework/Sources/DicomFormat/DicomElement.h"
+#include "../../OrthancFramework/Sources/DicomFormat/DicomFrameOffsets.h"
 #include "../../OrthancFramework/Sources/DicomFormat/DicomImageInformation.h"
 #include "../../OrthancFramework/Sources/DicomFormat/DicomStreamReader.h"
 #include "../../OrthancFramework/Sources/DicomNetworking/DicomStoreUserConnection.h"
 #include "../../OrthancFramework/Sources/DicomParsing/DicomModification.h"
 #include "../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
+#include "../../OrthancFramework/Sources/ElapsedTimer.h"
 #include "../../OrthancFramework/Sources/FileStorage/StorageAccessor.h"
 #include "../../OrthancFramework/Sources/HttpServer/FilesystemHttpSender.h"
 #include "../../OrthancFramework/Sources/HttpServer/HttpStreamTranscoder.h"
+#include "../../OrthancFramework/Sources/Images/ImageBufferPool.h"
+#include "../../OrthancFramework/Sources/Images/ImageProcessing.h"
 #include "../../OrthancFramework/Sources/JobsEngine/SetOfInstancesJob.h"
 #include "../../OrthancFramework/Sources/Logging.h"
 #include "../../OrthancFramework/Sources/MallocMemoryBuffer.h"
 #include "../../OrthancFramework/Sources/MetricsRegistry.h"
+#include "../../OrthancFramework/Sources/MultiThreading/ThreadPool.h"
 #include "../../OrthancFramework/Sources/SerializationToolbox.h"
+#include "../../OrthancFramework/Sources/SystemToolbox.h"
+#include "../../OrthancFramework/Sources/Tracing.h"
 #include "../Plugins/Engine/OrthancPlugins.h"
 
 #include "DicomInstanceToStore.h"
+#include "IDicomImageDecoder.h"
+#include "IngestTranscodingPipeline.h"
+#include "MemoryAllocator.h"
 #include "OrthancConfiguration.h"
 #include "OrthancRestApi/OrthancRestApi.h"
 #include "ResourceFinder.h"
 #include "Search/DatabaseLookup.h"
+#include "SeriesPrefetcher.h"
+#include "SeriesThumbnailsGenerator.h"
 #include "ServerJobs/OrthancJobUnserializer.h"
+#include "ServerJobs/ThreadedInstancesLoader.h"
 #include "ServerToolbox.h"
 #include "StorageCommitmentReports.h"
 #include "OutgoingDicomInstance.h"
@@ -58,10 +72,8 @@
 #include <dcmtk/dcmdata/dcuid.h>        /* for variable dcmAllStorageSOPClassUIDs */
 
 #include <boost/regex.hpp>
+#include <limits>
 
-#if HAVE_MALLOC_TRIM == 1
-#  include <malloc.h>
-#endif
 
 static size_t DICOM_CACHE_SIZE = static_cast<size_t>(128) * 1024 * 1024;  // 128 MB
 
@@ -105,6 +117,59 @@ namespace Orthanc
   }
 
 
+  /**
+   * Index of the offsets of the frames of a multi-frame instance (new
+   * in Orthanc 1.12.12). Returns "false" if the DICOM file is not a
+   * multi-frame image, or if its pixel data cannot be indexed without
+   * DCMTK (big endian, deflated or video transfer syntaxes, 1-bit
+   * images, extended offset table...).
+   **/
+  static bool ComputeFrameOffsets(std::string& serialized,
+                                  const void* dicom,
+                                  size_t size,
+                                  uint64_t pixelDataOffset,
+                                  DicomTransferSyntax transferSyntax,
+                                  const DicomMap& summary)
+  {
+    if (!IsTranscodableTransferSyntax(transferSyntax) ||
+        transferSyntax == DicomTransferSyntax_BigEndianExplicit ||
+        transferSyntax == DicomTransferSyntax_DeflatedLittleEndianExplicit)
+    {
+      return false;
+    }
+
+    std::unique_ptr<DicomImageInformation> information;
+
+    try
+    {
+      information.reset(new DicomImageInformation(summary));
+    }
+    catch (OrthancException&)
+    {
+      return false;  // Not an image
+    }
+
+    if (information->GetNumberOfFrames() <= 1 ||
+        information->GetBitsAllocated() % 8 != 0)
+    {
+      return false;
+    }
+
+    DicomFrameOffsets offsets;
+    if (offsets.Parse(dicom, size, pixelDataOffset,
+                      transferSyntax != DicomTransferSyntax_LittleEndianImplicit,
+                      information->GetNumberOfFrames(), information->GetFrameSize()))
+    {
+      offsets.Serialize(serialized);
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
   ServerContext::StoreResult::StoreResult() :
     status_(StoreStatus_Failure),
     cstoreStatusCode_(0)
@@ -112,265 +177,1435 @@ namespace Orthanc
   }
 
 
-#if HAVE_MALLOC_TRIM == 1
-  void ServerContext::MemoryTrimmingThread(ServerContext* that,
-                                           unsigned int intervalInSeconds)
+  void ServerContext::CacheInvalidationThread(ServerContext* that,
+                                              unsigned int intervalInSeconds)
   {
-    Logging::ScopedCurrentThreadNameSetter setter("MEMORY-TRIM");
-
-    boost::posix_time::ptime lastExecution = boost::posix_time::second_clock::universal_time();
+    Logging::ScopedCurrentThreadNameSetter setter("CACHE-SYNC");
 
-    // This thread is started only if malloc_trim is defined
-    while (!that->done_)
-    {
-      boost::posix_time::ptime now = boost::posix_time::second_clock::universal_time();
-      boost::posix_time::time_duration elapsed = now - lastExecution;
+    static const uint32_t BATCH_SIZE = 100;
 
-      if (elapsed.total_seconds() > intervalInSeconds)
-      {
-        // If possible, gives memory back to the system 
-        // (see OrthancServer/Resources/ImplementationNotes/memory_consumption.txt)
-        {
-          MetricsRegistry::Timer timer(that->GetMetricsRegistry(), "orthanc_memory_trimming_duration_ms");
-          malloc_trim(static_cast<size_t>(128) * 1024);
-        }
-        lastExecution = boost::posix_time::second_clock::universal_time();
-      }
+    /**
+     * Follow the changes that are logged in the database by all the
+     * Orthanc servers that share it, and drop the instances that were
+     * stored again or whose attachments were modified. Only the
+     * changes that occur after the startup are of interest, as the
+     * caches are initially empty.
+     **/
+    int64_t since;
 
-      boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    {
+      uint64_t committedWrites;  // Unused
+      that->index_.GetContentStamp(since, committedWrites);
     }
-  }
-#endif
 
-  
-  void ServerContext::ChangeThread(ServerContext* that,
-                                   unsigned int sleepDelay)
-  {
-    Logging::ScopedCurrentThreadNameSetter setter("CHANGES");
+    boost::posix_time::ptime lastExecution = boost::posix_time::second_clock::universal_time();
 
     while (!that->done_)
     {
-      std::unique_ptr<IDynamicObject> obj(that->pendingChanges_.Dequeue(sleepDelay));
-        
-      if (obj.get() != NULL)
+      boost::posix_time::ptime now = boost::posix_time::second_clock::universal_time();
+
+      if ((now - lastExecution).total_seconds() >= static_cast<int64_t>(intervalInSeconds))
       {
-        const ServerIndexChange& change = dynamic_cast<const ServerIndexChange&>(*obj.get());
+        lastExecution = now;
 
-        boost::shared_lock<boost::shared_mutex> lock(that->listenersMutex_);
-        for (ServerListeners::iterator it = that->listeners_.begin(); 
-             it != that->listeners_.end(); ++it)
+        try
         {
-          try
+          bool done = false;
+
+          while (!done &&
+                 !that->done_)
           {
-            try
-            {
-              it->GetListener().SignalChange(change);
-            }
-            catch (std::bad_alloc&)
+            std::list<ServerIndexChange> changes;
+            done = that->index_.GetChanges(changes, since, BATCH_SIZE);
+
+            for (std::list<ServerIndexChange>::const_iterator it = changes.begin(); it != changes.end(); ++it)
             {
-              LOG(ERROR) << "Not enough memory while signaling a change";
+              if (it->GetResourceType() == ResourceType_Instance &&
+                  (it->GetChangeType() == ChangeType_NewInstance ||
+                   it->GetChangeType() == ChangeType_UpdatedAttachment))
+              {
+                that->InvalidateCachedInstance(it->GetPublicId());
+              }
+
+              since = std::max(since, it->GetSeq());
             }
-            catch (...)
+
+            if (changes.empty())
             {
-              throw OrthancException(ErrorCode_InternalError, "Error while signaling a change");
+              done = true;
             }
           }
-          catch (OrthancException& e)
-          {
-            LOG(ERROR) << "Error in the " << it->GetDescription()
-                       << " callback while signaling a change: " << e.What()
-                       << " (code " << e.GetErrorCode() << ")";
-          }
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Cannot read the changes to invalidate the caches: " << e.What();
         }
       }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(100));
     }
   }
 
 
-  void ServerContext::JobEventsThread(ServerContext* that,
-                                      unsigned int sleepDelay)
+  void ServerContext::MemoryTrimmingThread(ServerContext* that,
+                                           unsigned int intervalInSeconds,
+                                           uint64_t threshold)
   {
-    Logging::ScopedCurrentThreadNameSetter setter("JOB-EVENTS");
+    Logging::ScopedCurrentThreadNameSetter setter("MEMORY-TRIM");
+
+    // The statistics of the allocator are refreshed every 5 seconds
+    static const unsigned int STATISTICS_INTERVAL = 5;
 
+    boost::posix_time::ptime lastExecution = boost::posix_time::second_clock::universal_time();
+    boost::posix_time::ptime lastStatistics = lastExecution;
+
+    // Amount of memory that was retained by the allocator after the
+    // last trimming, which cannot be given back to the system
+    uint64_t baseline = 0;
+
+    // This thread is started only if the allocator supports trimming
     while (!that->done_)
     {
-      std::unique_ptr<IDynamicObject> obj(that->pendingJobEvents_.Dequeue(sleepDelay));
-        
-      if (obj.get() != NULL)
+      boost::posix_time::ptime now = boost::posix_time::second_clock::universal_time();
+
+      if ((now - lastStatistics).total_seconds() >= STATISTICS_INTERVAL)
       {
-        const JobEvent& event = dynamic_cast<const JobEvent&>(*obj.get());
+        lastStatistics = now;
 
-        boost::shared_lock<boost::shared_mutex> lock(that->listenersMutex_);
-        for (ServerListeners::iterator it = that->listeners_.begin(); 
-             it != that->listeners_.end(); ++it)
+        MemoryAllocator::Statistics statistics;
+        MemoryAllocator::GetStatistics(statistics, false /* counting arenas is expensive */);
+        statistics.PublishMetrics(that->GetMetricsRegistry());
+
+        bool trim;
+
+        if (threshold != 0 &&
+            statistics.HasFragmentedBytes())
         {
-          try
+          // Adaptive trimming: Only give memory back to the system
+          // after large deallocations
+          const uint64_t fragmented = statistics.GetFragmentedBytes();
+          baseline = std::min(baseline, fragmented);
+          trim = (fragmented >= baseline + threshold);
+        }
+        else
+        {
+          trim = ((now - lastExecution).total_seconds() > intervalInSeconds);
+        }
+
+        if (trim)
+        {
+          // If possible, gives memory back to the system 
+          // (see OrthancServer/Resources/ImplementationNotes/memory_consumption.txt)
           {
-            try
-            {
-              it->GetListener().SignalJobEvent(event);
-            }
-            catch (std::bad_alloc&)
-            {
-              LOG(ERROR) << "Not enough memory while signaling a job event";
-            }
-            catch (...)
-            {
-              throw OrthancException(ErrorCode_InternalError, "Error while signaling a job event");
-            }
+            MetricsRegistry::Timer timer(that->GetMetricsRegistry(), "orthanc_memory_trimming_duration_ms");
+            MemoryAllocator::Trim();
           }
-          catch (OrthancException& e)
+
+          lastExecution = boost::posix_time::second_clock::universal_time();
+
+          if (threshold != 0)
           {
-            LOG(ERROR) << "Error in the " << it->GetDescription()
-                       << " callback while signaling a job event: " << e.What()
-                       << " (code " << e.GetErrorCode() << ")";
+            MemoryAllocator::GetStatistics(statistics, false);
+            if (statistics.HasFragmentedBytes())
+            {
+              baseline = statistics.GetFragmentedBytes();
+            }
           }
         }
       }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(100));
     }
   }
 
-
-  void ServerContext::SaveJobsThread(ServerContext* that,
-                                     unsigned int sleepDelay)
+  
+  void ServerContext::StoreConnectionPoolThread(ServerContext* that,
+                                                unsigned int sleepDelay)
   {
-    Logging::ScopedCurrentThreadNameSetter setter("SAVE-JOBS");
+    Logging::ScopedCurrentThreadNameSetter setter("SCU-POOL");
 
-    static const boost::posix_time::time_duration PERIODICITY =
-      boost::posix_time::seconds(10);
-    
-    boost::posix_time::ptime next =
-      boost::posix_time::microsec_clock::universal_time() + PERIODICITY;
-    
     while (!that->done_)
     {
       boost::this_thread::sleep(boost::posix_time::milliseconds(sleepDelay));
-
-      if (that->haveJobsChanged_ ||
-          boost::posix_time::microsec_clock::universal_time() >= next)
-      {
-        that->haveJobsChanged_ = false;
-        that->SaveJobsEngine();
-        next = boost::posix_time::microsec_clock::universal_time() + PERIODICITY;
-      }
+      that->storeConnectionPool_.CloseIfInactive();
     }
-  }
-  
 
-  void ServerContext::SignalJobSubmitted(const std::string& jobId)
-  {
-    haveJobsChanged_ = true;
-    pendingJobEvents_.Enqueue(new JobEvent(JobEventType_Submitted, jobId));
+    that->storeConnectionPool_.Clear();
   }
+
   
+  // Number of resources whose ordering key is remembered, so that the
+  // deletion of a resource is dispatched to the same partition as the
+  // previous changes of this resource
+  static const size_t MAX_CHANGES_ORDERING_KEYS = 10000;
 
-  void ServerContext::SignalJobSuccess(const std::string& jobId)
-  {
-    metricsRegistry_->IncrementIntegerValue("orthanc_jobs_total_completed", 1);
-    metricsRegistry_->IncrementIntegerValue("orthanc_jobs_total_success", 1);
-    haveJobsChanged_ = true;
-    pendingJobEvents_.Enqueue(new JobEvent(JobEventType_Success, jobId));
-  }
 
-  
-  void ServerContext::SignalJobFailure(const std::string& jobId)
+  class ServerContext::PendingChange : public IDynamicObject
   {
-    metricsRegistry_->IncrementIntegerValue("orthanc_jobs_total_completed", 1);
-    metricsRegistry_->IncrementIntegerValue("orthanc_jobs_total_failed", 1);
-    haveJobsChanged_ = true;
-    pendingJobEvents_.Enqueue(new JobEvent(JobEventType_Failure, jobId));
-  }
+  private:
+    ServerIndexChange          change_;
+    boost::posix_time::ptime   signaled_;
+
+  public:
+    explicit PendingChange(const ServerIndexChange& change) :
+      change_(change),
+      signaled_(boost::posix_time::microsec_clock::universal_time())
+    {
+    }
 
+    const ServerIndexChange& GetChange() const
+    {
+      return change_;
+    }
 
-  void ServerContext::SetupJobsEngine(bool unitTesting,
-                                      bool loadJobsFromDatabase)
+    int64_t GetLagMilliseconds() const
+    {
+      return (boost::posix_time::microsec_clock::universal_time() - signaled_).total_milliseconds();
+    }
+  };
+
+
+  class ServerContext::ChangesPartition : public boost::noncopyable
   {
-    if (loadJobsFromDatabase)
+  private:
+    std::string                           labels_;
+    BlockingSharedMessageQueue            unboundedQueue_;
+    std::unique_ptr<BoundedMessageQueue>  boundedQueue_;  // Lock-free ring buffer, if the queue is bounded
+    boost::thread                         thread_;
+
+  public:
+    ChangesPartition(size_t index,
+                     unsigned int queueSize) :
+      labels_(MetricsRegistry::FormatPrometheusLabel("partition", boost::lexical_cast<std::string>(index)))
     {
-      std::string serialized;
-      if (index_.LookupGlobalProperty(serialized, GlobalProperty_JobsRegistry, false /* not shared */))
+      if (queueSize != 0)
       {
-        LOG(WARNING) << "Reloading the jobs from the last execution of Orthanc";
+        boundedQueue_.reset(new BoundedMessageQueue(queueSize));
+      }
+    }
+
+    ~ChangesPartition()
+    {
+      Join();
+    }
+
+    const std::string& GetLabels() const
+    {
+      return labels_;
+    }
+
+    bool Enqueue(std::unique_ptr<IDynamicObject>& message,
+                 int32_t millisecondsTimeout)
+    {
+      if (boundedQueue_.get() != NULL)
+      {
+        return boundedQueue_->Enqueue(message, millisecondsTimeout);
+      }
+      else
+      {
+        return unboundedQueue_.Enqueue(message, millisecondsTimeout);
+      }
+    }
+
+    IDynamicObject* Dequeue(int32_t millisecondsTimeout)
+    {
+      if (boundedQueue_.get() != NULL)
+      {
+        return boundedQueue_->Dequeue(millisecondsTimeout);
+      }
+      else
+      {
+        return unboundedQueue_.Dequeue(millisecondsTimeout);
+      }
+    }
+
+    size_t GetQueueSize()
+    {
+      if (boundedQueue_.get() != NULL)
+      {
+        return boundedQueue_->GetSize();
+      }
+      else
+      {
+        return unboundedQueue_.GetSize();
+      }
+    }
+
+    void Start(ServerContext& context,
+               unsigned int sleepDelay)
+    {
+      thread_ = boost::thread(ChangesPartitionThread, &context, this, sleepDelay);
+    }
+
+    void Join()
+    {
+      if (thread_.joinable())
+      {
+        thread_.join();
+      }
+    }
+  };
+
+
+  void ServerContext::DispatchChange(const PendingChange& pending,
+                                     const std::string& partitionLabels)
+  {
+    metricsRegistry_->SetIntegerValue("orthanc_changes_lag_ms{" + partitionLabels + "}",
+                                      pending.GetLagMilliseconds(), MetricsUpdatePolicy_MaxOver10Seconds);
+
+    const ServerIndexChange& change = pending.GetChange();
 
+    boost::shared_lock<boost::shared_mutex> lock(listenersMutex_);
+    for (ServerListeners::iterator it = listeners_.begin(); 
+         it != listeners_.end(); ++it)
+    {
+      try
+      {
         try
         {
-          OrthancJobUnserializer unserializer(*this);
-          jobsEngine_.LoadRegistryFromString(unserializer, serialized);
-        }
-        catch (OrthancException& e)
-        {
-          LOG(WARNING) << "Cannot unserialize the jobs engine, starting anyway: " << e.What();
+          it->GetListener().SignalChange(change);
         }
-        catch (const std::string& s) 
+        catch (std::bad_alloc&)
         {
-          LOG(WARNING) << "Cannot unserialize the jobs engine, starting anyway: \"" << s << "\"";
+          LOG(ERROR) << "Not enough memory while signaling a change";
         }
         catch (...)
         {
-          LOG(WARNING) << "Cannot unserialize the jobs engine, starting anyway";
+          throw OrthancException(ErrorCode_InternalError, "Error while signaling a change");
         }
       }
-      else
+      catch (OrthancException& e)
       {
-        LOG(INFO) << "The last execution of Orthanc has archived no job";
+        LOG(ERROR) << "Error in the " << it->GetDescription()
+                   << " callback while signaling a change: " << e.What()
+                   << " (code " << e.GetErrorCode() << ")";
       }
     }
-    else
-    {
-      LOG(INFO) << "Not reloading the jobs from the last execution of Orthanc";
-    }
-
-    jobsEngine_.GetRegistry().SetObserver(*this);
-    jobsEngine_.Start();
-    isJobsEngineUnserialized_ = true;
-
-    saveJobsThread_ = boost::thread(SaveJobsThread, this, (unitTesting ? 20 : 100));
   }
 
 
-  void ServerContext::SaveJobsEngine()
+  std::string ServerContext::GetChangeOrderingKey(const ServerIndexChange& change)
   {
-    if (saveJobs_)
+    /**
+     * The changes are partitioned by study, so that the changes of
+     * the instances and series of one study are signaled in the order
+     * of the database. The patients are their own key. The key is
+     * looked up in the index once, then remembered, which notably
+     * allows the deletion of a resource to be ordered after its
+     * previous changes, even if the parents cannot be looked up
+     * anymore.
+     **/
+
+    const std::string& publicId = change.GetPublicId();
+
+    std::string key;
+    if (changesOrderingKeys_.Contains(publicId, key))
     {
-      static boost::posix_time::ptime lastSerializedModification = boost::posix_time::neg_infin;
-      boost::posix_time::ptime lastModification = boost::posix_time::neg_infin;
+      changesOrderingKeys_.MakeMostRecent(publicId);
+    }
+    else
+    {
+      key = publicId;
 
-      jobsEngine_.GetRegistry().GetLastModificationTime(lastModification);
+      if (change.GetChangeType() != ChangeType_Deleted &&
+          (change.GetResourceType() == ResourceType_Series ||
+           change.GetResourceType() == ResourceType_Instance))
+      {
+        try
+        {
+          std::string series = publicId;
+          std::string study;
+          if ((change.GetResourceType() == ResourceType_Series ||
+               index_.LookupParent(series, publicId, ResourceType_Series)) &&
+              index_.LookupParent(study, series, ResourceType_Study))
+          {
+            key = study;
+          }
+        }
+        catch (OrthancException&)
+        {
+          // The resource has been deleted in the meantime, fall back
+          // to the ordering per resource
+        }
+      }
+
+      changesOrderingKeys_.Add(publicId, key);
+
+      while (changesOrderingKeys_.GetSize() > MAX_CHANGES_ORDERING_KEYS)
+      {
+        changesOrderingKeys_.RemoveOldest();
+      }
+    }
+
+    if (change.GetChangeType() == ChangeType_Deleted)
+    {
+      changesOrderingKeys_.Invalidate(publicId);
+    }
+
+    return key;
+  }
+
+
+  void ServerContext::ChangeThread(ServerContext* that,
+                                   unsigned int sleepDelay)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("CHANGES");
+
+    static const char* const SINGLE_PARTITION = "partition=\"0\"";
+
+    while (!that->done_)
+    {
+      std::unique_ptr<IDynamicObject> obj(that->pendingChanges_.Dequeue(sleepDelay));
+      that->metricsRegistry_->SetIntegerValue("orthanc_changes_pending_count", that->pendingChanges_.GetSize());
+
+      if (obj.get() != NULL)
+      {
+        const PendingChange& pending = dynamic_cast<const PendingChange&>(*obj.get());
+
+        if (that->changesPartitions_.empty())
+        {
+          that->DispatchChange(pending, SINGLE_PARTITION);
+        }
+        else
+        {
+          const std::string key = that->GetChangeOrderingKey(pending.GetChange());
+
+          // 32-bit FNV-1a hash of the key, as in "MemoryStringCache"
+          uint32_t hash = 2166136261u;
+          for (size_t i = 0; i < key.size(); i++)
+          {
+            hash = (hash ^ static_cast<uint8_t>(key[i])) * 16777619u;
+          }
+
+          ChangesPartition& partition = *that->changesPartitions_[hash % that->changesPartitions_.size()];
+
+          // If the queue of the partition is full, wait for room, so
+          // that the limit of "pendingChanges_" applies to the
+          // producers of the changes
+          while (!partition.Enqueue(obj, sleepDelay) &&
+                 !that->done_)
+          {
+          }
+
+          that->metricsRegistry_->SetIntegerValue("orthanc_changes_partition_queue_size{" + partition.GetLabels() + "}",
+                                                  partition.GetQueueSize());
+        }
+      }
+    }
+  }
+
+
+  void ServerContext::ChangesPartitionThread(ServerContext* that,
+                                             ChangesPartition* partition,
+                                             unsigned int sleepDelay)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("CHANGES");
+
+    assert(partition != NULL);
+
+    while (!that->done_)
+    {
+      std::unique_ptr<IDynamicObject> obj(partition->Dequeue(sleepDelay));
+
+      if (obj.get() != NULL)
+      {
+        that->metricsRegistry_->SetIntegerValue("orthanc_changes_partition_queue_size{" + partition->GetLabels() + "}",
+                                                partition->GetQueueSize());
+        that->DispatchChange(dynamic_cast<const PendingChange&>(*obj.get()), partition->GetLabels());
+      }
+    }
+  }
+
+
+  static void PublishJobDuration(ServerContext& context,
+                                 const JobEvent& event)
+  {
+    // Exponential buckets from 100ms to about 7 hours, in milliseconds
+    // (only accessed by the "JOB-EVENTS" thread)
+    static std::vector<double> buckets;
+    if (buckets.empty())
+    {
+      MetricsRegistry::GetExponentialBuckets(buckets, 100, 4, 10);
+    }
+
+    JobInfo info;
+    if (context.GetMetricsRegistry().IsEnabled() &&
+        context.GetJobsEngine().GetRegistry().GetJobInfo(info, event.GetJobId()) /* the job might already be forgotten */)
+    {
+      const std::string labels = (
+        MetricsRegistry::FormatPrometheusLabel("type", info.GetStatus().GetJobType()) + "," +
+        MetricsRegistry::FormatPrometheusLabel("status", event.GetEventType() == JobEventType_Success ? "success" : "failure"));
+
+      context.GetMetricsRegistry().AddHistogramSample("orthanc_jobs_duration_ms", labels, buckets,
+                                                      static_cast<double>(info.GetRuntime().total_milliseconds()));
+    }
+  }
+
+
+  void ServerContext::JobEventsThread(ServerContext* that,
+                                      unsigned int sleepDelay)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("JOB-EVENTS");
+
+    while (!that->done_)
+    {
+      std::unique_ptr<IDynamicObject> obj(that->pendingJobEvents_.Dequeue(sleepDelay));
+        
+      if (obj.get() != NULL)
+      {
+        const JobEvent& event = dynamic_cast<const JobEvent&>(*obj.get());
+
+        if (event.GetEventType() != JobEventType_Submitted)
+        {
+          try
+          {
+            PublishJobDuration(*that, event);
+          }
+          catch (OrthancException& e)
+          {
+            LOG(ERROR) << "Cannot publish the duration of job " << event.GetJobId() << ": " << e.What();
+          }
+        }
+
+        boost::shared_lock<boost::shared_mutex> lock(that->listenersMutex_);
+        for (ServerListeners::iterator it = that->listeners_.begin(); 
+             it != that->listeners_.end(); ++it)
+        {
+          try
+          {
+            try
+            {
+              it->GetListener().SignalJobEvent(event);
+            }
+            catch (std::bad_alloc&)
+            {
+              LOG(ERROR) << "Not enough memory while signaling a job event";
+            }
+            catch (...)
+            {
+              throw OrthancException(ErrorCode_InternalError, "Error while signaling a job event");
+            }
+          }
+          catch (OrthancException& e)
+          {
+            LOG(ERROR) << "Error in the " << it->GetDescription()
+                       << " callback while signaling a job event: " << e.What()
+                       << " (code " << e.GetErrorCode() << ")";
+          }
+        }
+      }
+    }
+  }
+
+
+  void ServerContext::SaveJobsThread(ServerContext* that,
+                                     unsigned int sleepDelay)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("SAVE-JOBS");
+
+    static const boost::posix_time::time_duration PERIODICITY =
+      boost::posix_time::seconds(10);
+    
+    boost::posix_time::ptime next =
+      boost::posix_time::microsec_clock::universal_time() + PERIODICITY;
+    
+    while (!that->done_)
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(sleepDelay));
+
+      if (that->haveJobsChanged_ ||
+          boost::posix_time::microsec_clock::universal_time() >= next)
+      {
+        that->haveJobsChanged_ = false;
+
+        if (that->isJobsEngineUnserialized_)
+        {
+          // Saving a partially reloaded registry would lose jobs
+          that->SaveJobsEngine();
+        }
+
+        // Remove the expired outputs of the jobs, even if nobody
+        // accesses the store (new in Orthanc 1.12.12)
+        that->jobOutputs_->Purge();
+
+        if (that->archivesCache_.get() != NULL)
+        {
+          that->archivesCache_->Purge();
+        }
+
+        next = boost::posix_time::microsec_clock::universal_time() + PERIODICITY;
+      }
+    }
+  }
+  
+
+  void ServerContext::SignalJobSubmitted(const std::string& jobId)
+  {
+    haveJobsChanged_ = true;
+    pendingJobEvents_.Enqueue(new JobEvent(JobEventType_Submitted, jobId));
+  }
+  
+
+  void ServerContext::SignalJobSuccess(const std::string& jobId)
+  {
+    metricsRegistry_->IncrementIntegerValue("orthanc_jobs_total_completed", 1);
+    metricsRegistry_->IncrementIntegerValue("orthanc_jobs_total_success", 1);
+    haveJobsChanged_ = true;
+    pendingJobEvents_.Enqueue(new JobEvent(JobEventType_Success, jobId));
+  }
+
+  
+  void ServerContext::SignalJobFailure(const std::string& jobId)
+  {
+    metricsRegistry_->IncrementIntegerValue("orthanc_jobs_total_completed", 1);
+    metricsRegistry_->IncrementIntegerValue("orthanc_jobs_total_failed", 1);
+    haveJobsChanged_ = true;
+    pendingJobEvents_.Enqueue(new JobEvent(JobEventType_Failure, jobId));
+  }
+
+
+  void ServerContext::SignalJobUpdated(const std::string& jobId)
+  {
+    jobsEventsHub_.SignalJobUpdated(jobId);
+  }
+
+
+  // Serialized jobs above this size are stored with gzip compression
+  static const size_t JOBS_COMPRESSION_THRESHOLD = 4096;
+
+  static void ParseStoredJob(Json::Value& target,
+                             const std::string& value)
+  {
+    bool success;
+
+    if (!value.empty() &&
+        value[0] != '{')
+    {
+      std::string uncompressed;
+      GzipCompressor compressor;
+      compressor.Uncompress(uncompressed, value.c_str(), value.size());
+      success = Toolbox::ReadJson(target, uncompressed);
+    }
+    else
+    {
+      success = Toolbox::ReadJson(target, value);
+    }
+
+    if (!success)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+  }
+
+
+  bool ServerContext::LoadJobsFromStore(bool& interrupted)
+  {
+    assert(!jobsStoreId_.empty());
+
+    interrupted = false;
+
+    OrthancJobUnserializer unserializer(*this);
+    std::set<std::string> invalid;
+    size_t count = 0;
+
+    // Load the jobs by pages, so that the full registry is never
+    // held in memory as one block
+    StatelessDatabaseOperations::KeysValuesIterator it(index_, jobsStoreId_);
+    it.SetLimit(100);
+
+    while (it.Next())
+    {
+      if (done_)
+      {
+        // Orthanc is stopping while the jobs are reloaded in the background
+        interrupted = true;
+        break;
+      }
+
+      if (count == 0)
+      {
+        LOG(WARNING) << "Reloading the jobs from the last execution of Orthanc";
+      }
+
+      count++;
+
+      try
+      {
+        Json::Value job;
+        ParseStoredJob(job, it.GetValue());
+
+        if (!jobsEngine_.GetRegistry().AddSerializedJob(unserializer, it.GetKey(), job))
+        {
+          invalid.insert(it.GetKey());
+        }
+      }
+      catch (OrthancException& e)
+      {
+        LOG(WARNING) << "Cannot unserialize job " << it.GetKey() << ", skipping it: " << e.What();
+        invalid.insert(it.GetKey());
+      }
+    }
+
+    // Remove the jobs that cannot be reloaded at the next save
+    jobsEngine_.GetRegistry().MarkModifiedJobs(invalid);
+
+    return (count > 0 || interrupted);
+  }
+
+
+  void ServerContext::SaveModifiedJobs()
+  {
+    assert(!jobsStoreId_.empty());
+
+    std::map<std::string, Json::Value> modified;
+    std::set<std::string> removed;
+    jobsEngine_.GetRegistry().SerializeModifiedJobs(modified, removed);
+
+    if (modified.empty() &&
+        removed.empty() &&
+        isLegacyJobsRegistryCleared_)
+    {
+      return;
+    }
+
+    LOG(TRACE) << "Saving " << modified.size() << " modified jobs, and removing " << removed.size() << " jobs";
+
+    std::map<std::string, std::string> stored;
+
+    for (std::map<std::string, Json::Value>::const_iterator it = modified.begin(); it != modified.end(); ++it)
+    {
+      std::string serialized;
+      Toolbox::WriteFastJson(serialized, it->second);
+
+      if (serialized.size() >= JOBS_COMPRESSION_THRESHOLD)
+      {
+        GzipCompressor compressor;
+        IBufferCompressor::Compress(stored[it->first], compressor, serialized);
+      }
+      else
+      {
+        stored[it->first].swap(serialized);
+      }
+    }
+
+    try
+    {
+      index_.UpdateKeysValues(jobsStoreId_, stored, removed);
+
+      if (!isLegacyJobsRegistryCleared_)
+      {
+        // The registry that was saved as a whole by the previous
+        // versions of Orthanc must not be reloaded anymore
+        index_.SetGlobalProperty(GlobalProperty_JobsRegistry, false /* not shared */, "");
+        isLegacyJobsRegistryCleared_ = true;
+      }
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "Cannot save the jobs engine: " << e.What();
+
+      // Retry at the next save
+      for (std::map<std::string, Json::Value>::const_iterator it = modified.begin(); it != modified.end(); ++it)
+      {
+        removed.insert(it->first);
+      }
+
+      jobsEngine_.GetRegistry().MarkModifiedJobs(removed);
+    }
+  }
+
+
+  bool ServerContext::LoadJobs(bool isEngineRunning)
+  {
+    bool interrupted;
+    if (!jobsStoreId_.empty() &&
+        LoadJobsFromStore(interrupted))
+    {
+      // The jobs were saved one by one (new in Orthanc 1.12.12)
+      return !interrupted;
+    }
+
+    std::string serialized;
+    if (index_.LookupGlobalProperty(serialized, GlobalProperty_JobsRegistry, false /* not shared */) &&
+        !serialized.empty())
+    {
+      LOG(WARNING) << "Reloading the jobs from the last execution of Orthanc";
+
+      try
+      {
+        OrthancJobUnserializer unserializer(*this);
+
+        if (isEngineRunning)
+        {
+          Json::Value value;
+          if (!Toolbox::ReadJson(value, serialized))
+          {
+            throw OrthancException(ErrorCode_BadFileFormat);
+          }
+
+          jobsEngine_.GetRegistry().AddSerializedJobs(unserializer, value);
+        }
+        else
+        {
+          jobsEngine_.LoadRegistryFromString(unserializer, serialized);
+        }
+      }
+      catch (OrthancException& e)
+      {
+        LOG(WARNING) << "Cannot unserialize the jobs engine, starting anyway: " << e.What();
+      }
+      catch (const std::string& s) 
+      {
+        LOG(WARNING) << "Cannot unserialize the jobs engine, starting anyway: \"" << s << "\"";
+      }
+      catch (...)
+      {
+        LOG(WARNING) << "Cannot unserialize the jobs engine, starting anyway";
+      }
+    }
+    else
+    {
+      LOG(INFO) << "The last execution of Orthanc has archived no job";
+    }
+
+    return true;
+  }
+
+
+  void ServerContext::LoadJobsThread(ServerContext* that)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("LOAD-JOBS");
+
+    ElapsedTimer timer;
+    bool complete;
+
+    try
+    {
+      complete = that->LoadJobs(true /* engine is running */);
+    }
+    catch (OrthancException& e)
+    {
+      // Do not save the jobs engine, in order not to lose the jobs
+      // that could not be reloaded
+      LOG(ERROR) << "Cannot reload the jobs from the last execution of Orthanc: " << e.What();
+      return;
+    }
+
+    if (!complete)
+    {
+      LOG(WARNING) << "Orthanc was stopped before the jobs from its last execution were all reloaded";
+    }
+    else
+    {
+      LOG(WARNING) << "The jobs from the last execution of Orthanc have been reloaded in the background in "
+                   << timer.GetHumanElapsedDuration();
+      that->isJobsEngineUnserialized_ = true;
+      that->haveJobsChanged_ = true;
+    }
+  }
+
+
+  void ServerContext::SetupJobsEngine(bool unitTesting,
+                                      bool loadJobsFromDatabase)
+  {
+    if (index_.HasKeyValueStoresSupport())
+    {
+      // Save each job as a separate row of a key-value store, which
+      // is private to this Orthanc server (as the global property)
+      OrthancConfiguration::ReaderLock lock;
+      jobsStoreId_ = "orthanc-jobs-" + lock.GetConfiguration().GetDatabaseServerIdentifier();
+    }
+
+    if (!loadJobsFromDatabase)
+    {
+      LOG(INFO) << "Not reloading the jobs from the last execution of Orthanc";
+      jobsEngine_.GetRegistry().SetObserver(*this);
+      jobsEngine_.Start();
+      isJobsEngineUnserialized_ = true;
+    }
+    else if (asynchronousJobsLoading_)
+    {
+      // New in Orthanc 1.12.12: The jobs are added to the running
+      // engine by a background thread, so as not to delay the startup
+      jobsEngine_.GetRegistry().SetObserver(*this);
+      jobsEngine_.Start();
+      loadJobsThread_ = boost::thread(LoadJobsThread, this);
+    }
+    else
+    {
+      LoadJobs(false /* engine not running yet */);
+      jobsEngine_.GetRegistry().SetObserver(*this);
+      jobsEngine_.Start();
+      isJobsEngineUnserialized_ = true;
+    }
+
+    saveJobsThread_ = boost::thread(SaveJobsThread, this, (unitTesting ? 20 : 100));
+
+    {
+      bool shared;
+      unsigned int leaseDuration, concurrency;
+
+      {
+        OrthancConfiguration::ReaderLock lock;
+        shared = lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_SHARED_JOBS_QUEUE);
+        leaseDuration = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_SHARED_JOBS_LEASE_DURATION);
+        concurrency = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_SHARED_JOBS_CONCURRENCY);
+      }
+
+      if (shared)
+      {
+        if (leaseDuration < 2 ||
+            concurrency == 0)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange,
+                                 "The configuration options \"" ORTHANC_CONFIG_SHARED_JOBS_LEASE_DURATION "\" and \""
+                                 ORTHANC_CONFIG_SHARED_JOBS_CONCURRENCY "\" must respectively be >= 2 and >= 1");
+        }
+
+        LOG(WARNING) << "The asynchronous jobs are shared with the other Orthanc servers using the same database, "
+                     << "this server runs at most " << concurrency << " of them with a lease of " << leaseDuration << " seconds";
+
+        sharedJobsQueue_.reset(new SharedJobsQueue(*this, leaseDuration, concurrency));
+        sharedJobsQueue_->Start();
+      }
+    }
+  }
+
+
+  bool ServerContext::SubmitSharedJob(std::string& id,
+                                      const IJob& job,
+                                      int priority)
+  {
+    if (sharedJobsQueue_.get() == NULL)
+    {
+      return false;
+    }
+    else
+    {
+      return sharedJobsQueue_->Submit(id, job, priority);
+    }
+  }
+
+
+  void ServerContext::SaveJobsEngine()
+  {
+    if (saveJobs_ &&
+        !jobsStoreId_.empty())
+    {
+      SaveModifiedJobs();
+    }
+    else if (saveJobs_)
+    {
+      static boost::posix_time::ptime lastSerializedModification = boost::posix_time::neg_infin;
+      boost::posix_time::ptime lastModification = boost::posix_time::neg_infin;
+
+      jobsEngine_.GetRegistry().GetLastModificationTime(lastModification);
+
+      if (lastModification > lastSerializedModification)
+      {
+        LOG(TRACE) << "Serializing the content of the jobs engine";
+      
+        try
+        {
+          Json::Value value;
+          jobsEngine_.GetRegistry().Serialize(value);
+
+          std::string serialized;
+          Toolbox::WriteFastJson(serialized, value);
+
+          index_.SetGlobalProperty(GlobalProperty_JobsRegistry, false /* not shared */, serialized);
+          lastSerializedModification = lastModification;
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Cannot serialize the jobs engine: " << e.What();
+        }
+      }
+    }
+  }
+
+
+  static const char* const CACHE_STORAGE = "storage";
+  static const char* const CACHE_DICOM_HEADERS = "dicom-headers";
+  static const char* const CACHE_STORAGE_DISK = "storage-disk";
+  static const char* const CACHE_PARSED_DICOM = "parsed-dicom";
+  static const char* const CACHE_QUERY_RETRIEVE = "query-retrieve";
+  static const char* const CACHE_MEDIA = "media";
+  static const char* const CACHE_ARCHIVES = "archives";
+  static const char* const CACHE_TRANSCODING = "transcoding";
+  static const char* const CACHE_FIND_ANSWERS = "find-answers";
+  static const char* const CACHE_RENDERED_FRAMES = "rendered-frames";
+  static const char* const CACHE_RENDERED_FRAMES_DISK = "rendered-frames-disk";
+  static const char* const CACHE_IMAGE_BUFFERS = "image-buffers";
+
+
+  static void PublishCacheStatistics(MetricsRegistry& registry,
+                                     const std::string& prefix,
+                                     const CacheStatistics& statistics)
+  {
+    registry.SetIntegerValue(prefix + "_hits", static_cast<int64_t>(statistics.GetHits()));
+    registry.SetIntegerValue(prefix + "_misses", static_cast<int64_t>(statistics.GetMisses()));
+    registry.SetIntegerValue(prefix + "_evictions", static_cast<int64_t>(statistics.GetEvictions()));
+    registry.SetFloatValue(prefix + "_load_time_ms", statistics.GetAverageLoadTimeMilliseconds());
+  }
+
+
+  static void FormatCacheStatistics(Json::Value& target,
+                                    const CacheStatistics& statistics,
+                                    bool resizable)
+  {
+    target["Hits"] = static_cast<Json::UInt64>(statistics.GetHits());
+    target["Misses"] = static_cast<Json::UInt64>(statistics.GetMisses());
+    target["Evictions"] = static_cast<Json::UInt64>(statistics.GetEvictions());
+    target["AverageLoadTime"] = statistics.GetAverageLoadTimeMilliseconds();
+    target["Resizable"] = resizable;
+  }
+
+
+  static void FormatMemoryCache(Json::Value& target,
+                                size_t countEntries,
+                                uint64_t size,
+                                uint64_t maximumSize,
+                                const CacheStatistics& statistics)
+  {
+    target = Json::objectValue;
+    target["Entries"] = static_cast<Json::UInt64>(countEntries);
+    target["Size"] = static_cast<Json::UInt64>(size);
+    target["MaximumSize"] = static_cast<Json::UInt64>(maximumSize);
+    FormatCacheStatistics(target, statistics, true);
+  }
+
+
+  static void FormatArchive(Json::Value& target,
+                            SharedArchive& archive)
+  {
+    CacheStatistics statistics;
+    archive.GetStatistics(statistics);
+
+    target = Json::objectValue;
+    target["Entries"] = static_cast<Json::UInt64>(archive.GetNumberOfItems());
+    target["MaximumEntries"] = static_cast<Json::UInt64>(archive.GetMaximumSize());
+    target["Size"] = static_cast<Json::UInt64>(archive.GetMemoryUsage());
+    target["MaximumSize"] = static_cast<Json::UInt64>(archive.GetMaximumMemoryUsage());
+    FormatCacheStatistics(target, statistics, true);
+  }
+
+
+  static void FormatJobOutputs(Json::Value& target,
+                               JobOutputsStore& store)
+  {
+    CacheStatistics statistics;
+    store.GetStatistics(statistics);
+
+    target = Json::objectValue;
+    target["Entries"] = static_cast<Json::UInt64>(store.GetNumberOfItems());
+    target["MaximumEntries"] = static_cast<Json::UInt64>(store.GetMaximumSize());
+    target["Size"] = static_cast<Json::UInt64>(store.GetTotalSize());
+    FormatCacheStatistics(target, statistics, true);
+  }
+
+
+  void ServerContext::GetTranscodingCacheStatistics(CacheStatistics& target)
+  {
+    boost::mutex::scoped_lock lock(transcodingStatisticsMutex_);
+    target = transcodingStatistics_;
+  }
+
+
+  bool ServerContext::LookupArchiveCrc32(uint32_t& crc32,
+                                         const std::string& attachmentUuid)
+  {
+    boost::mutex::scoped_lock lock(archiveCrc32Mutex_);
+
+    if (archiveCrc32_.Contains(attachmentUuid, crc32))
+    {
+      archiveCrc32_.MakeMostRecent(attachmentUuid);
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  void ServerContext::StoreArchiveCrc32(const std::string& attachmentUuid,
+                                        uint32_t crc32)
+  {
+    // About 10MB of memory
+    static const size_t MAX_ARCHIVE_CRC32 = 100000;
+
+    boost::mutex::scoped_lock lock(archiveCrc32Mutex_);
+
+    archiveCrc32_.AddOrMakeMostRecent(attachmentUuid, crc32);
+
+    while (archiveCrc32_.GetSize() > MAX_ARCHIVE_CRC32)
+    {
+      archiveCrc32_.RemoveOldest();
+    }
+  }
+
+
+  void ServerContext::TouchTranscodedAttachment(const std::string& instanceId,
+                                                FileContentType type,
+                                                uint64_t size)
+  {
+    std::list<TranscodedAttachment> evicted;
+
+    {
+      boost::mutex::scoped_lock lock(transcodedAttachmentsMutex_);
+
+      const TranscodedAttachment attachment(instanceId, type);
+
+      uint64_t previousSize;
+      if (transcodedAttachments_.Contains(attachment, previousSize))
+      {
+        assert(transcodedAttachmentsSize_ >= previousSize);
+        transcodedAttachmentsSize_ -= previousSize;
+      }
+
+      transcodedAttachments_.AddOrMakeMostRecent(attachment, size);
+      transcodedAttachmentsSize_ += size;
+
+      // Never evict the attachment that has just been touched
+      while (transcodedAttachmentsSize_ > maximumTranscodedAttachmentsSize_ &&
+             transcodedAttachments_.GetSize() > 1)
+      {
+        uint64_t oldestSize;
+        evicted.push_back(transcodedAttachments_.RemoveOldest(oldestSize));
+        assert(transcodedAttachmentsSize_ >= oldestSize);
+        transcodedAttachmentsSize_ -= oldestSize;
+      }
+    }
+
+    // The database is not accessed while holding the mutex
+    for (std::list<TranscodedAttachment>::const_iterator it = evicted.begin(); it != evicted.end(); ++it)
+    {
+      try
+      {
+        index_.DeleteAttachment(it->first, it->second, false, -1, "");
+      }
+      catch (OrthancException& e)
+      {
+        LOG(WARNING) << "Cannot remove the transcoded attachment of instance " << it->first << ": " << e.What();
+      }
+    }
+  }
+
+
+  void ServerContext::PublishCacheMetrics()
+  {
+    CacheStatistics statistics;
+
+    metricsRegistry_->SetFloatValue("orthanc_dicom_cache_size_mb",
+                                    static_cast<float>(dicomCache_.GetCurrentSize()) / static_cast<float>(1024 * 1024));
+    metricsRegistry_->SetIntegerValue("orthanc_dicom_cache_count", 
+                                    static_cast<int64_t>(dicomCache_.GetNumberOfItems()));
+    dicomCache_.GetStatistics(statistics);
+    PublishCacheStatistics(*metricsRegistry_, "orthanc_dicom_cache", statistics);
+
+    metricsRegistry_->SetFloatValue("orthanc_storage_cache_size_mb",
+                                    static_cast<float>(storageCache_.GetCurrentSize()) / static_cast<float>(1024 * 1024));
+    metricsRegistry_->SetIntegerValue("orthanc_storage_cache_count", 
+                                    static_cast<int64_t>(storageCache_.GetNumberOfItems()));
+    storageCache_.GetStatistics(statistics);
+    PublishCacheStatistics(*metricsRegistry_, "orthanc_storage_cache", statistics);
+
+    metricsRegistry_->SetFloatValue("orthanc_dicom_header_cache_size_mb",
+                                    static_cast<float>(storageCache_.GetHeadersCurrentSize()) / static_cast<float>(1024 * 1024));
+    metricsRegistry_->SetIntegerValue("orthanc_dicom_header_cache_count",
+                                      static_cast<int64_t>(storageCache_.GetHeadersNumberOfItems()));
+    storageCache_.GetHeadersStatistics(statistics);
+    PublishCacheStatistics(*metricsRegistry_, "orthanc_dicom_header_cache", statistics);
+
+    StorageDiskCache* diskCache = storageCache_.GetDiskCache();
+    if (diskCache != NULL)
+    {
+      metricsRegistry_->SetFloatValue("orthanc_storage_disk_cache_size_mb",
+                                      static_cast<float>(diskCache->GetCurrentSize()) / static_cast<float>(1024 * 1024));
+      metricsRegistry_->SetIntegerValue("orthanc_storage_disk_cache_count",
+                                        static_cast<int64_t>(diskCache->GetNumberOfItems()));
+      diskCache->GetStatistics(statistics);
+      PublishCacheStatistics(*metricsRegistry_, "orthanc_storage_disk_cache", statistics);
+    }
+
+    queryRetrieveArchive_->RemoveExpired();
+    metricsRegistry_->SetIntegerValue("orthanc_query_retrieve_archive_count",
+                                      static_cast<int64_t>(queryRetrieveArchive_->GetNumberOfItems()));
+    metricsRegistry_->SetFloatValue("orthanc_query_retrieve_archive_size_mb",
+                                    static_cast<float>(queryRetrieveArchive_->GetMemoryUsage()) / static_cast<float>(1024 * 1024));
+    queryRetrieveArchive_->GetStatistics(statistics);
+    PublishCacheStatistics(*metricsRegistry_, "orthanc_query_retrieve_archive", statistics);
+
+    metricsRegistry_->SetIntegerValue("orthanc_media_archive_count",
+                                      static_cast<int64_t>(jobOutputs_->GetNumberOfItems()));
+    metricsRegistry_->SetFloatValue("orthanc_media_archive_size_mb",
+                                    static_cast<float>(jobOutputs_->GetTotalSize()) / static_cast<float>(1024 * 1024));
+    jobOutputs_->GetStatistics(statistics);
+    PublishCacheStatistics(*metricsRegistry_, "orthanc_media_archive", statistics);
+
+    if (archivesCache_.get() != NULL)
+    {
+      metricsRegistry_->SetIntegerValue("orthanc_archives_cache_count",
+                                        static_cast<int64_t>(archivesCache_->GetNumberOfItems()));
+      metricsRegistry_->SetFloatValue("orthanc_archives_cache_size_mb",
+                                      static_cast<float>(archivesCache_->GetTotalSize()) / static_cast<float>(1024 * 1024));
+      archivesCache_->GetStatistics(statistics);
+      PublishCacheStatistics(*metricsRegistry_, "orthanc_archives_cache", statistics);
+    }
+
+    GetTranscodingCacheStatistics(statistics);
+    PublishCacheStatistics(*metricsRegistry_, "orthanc_transcoding_cache", statistics);
+
+    if (findAnswersCache_.get() != NULL)
+    {
+      metricsRegistry_->SetIntegerValue("orthanc_find_answers_cache_count",
+                                        static_cast<int64_t>(findAnswersCache_->GetNumberOfItems()));
+      findAnswersCache_->GetStatistics(statistics);
+      PublishCacheStatistics(*metricsRegistry_, "orthanc_find_answers_cache", statistics);
+    }
+
+    if (renderedFramesCache_.get() != NULL)
+    {
+      metricsRegistry_->SetFloatValue("orthanc_rendered_frames_cache_size_mb",
+                                      static_cast<float>(renderedFramesCache_->GetCurrentSize()) / static_cast<float>(1024 * 1024));
+      metricsRegistry_->SetIntegerValue("orthanc_rendered_frames_cache_count",
+                                        static_cast<int64_t>(renderedFramesCache_->GetNumberOfItems()));
+      renderedFramesCache_->GetStatistics(statistics);
+      PublishCacheStatistics(*metricsRegistry_, "orthanc_rendered_frames_cache", statistics);
+
+      StorageDiskCache* renderedDiskCache = renderedFramesCache_->GetDiskCache();
+      if (renderedDiskCache != NULL)
+      {
+        metricsRegistry_->SetFloatValue("orthanc_rendered_frames_disk_cache_size_mb",
+                                        static_cast<float>(renderedDiskCache->GetCurrentSize()) / static_cast<float>(1024 * 1024));
+        metricsRegistry_->SetIntegerValue("orthanc_rendered_frames_disk_cache_count",
+                                          static_cast<int64_t>(renderedDiskCache->GetNumberOfItems()));
+        renderedDiskCache->GetStatistics(statistics);
+        PublishCacheStatistics(*metricsRegistry_, "orthanc_rendered_frames_disk_cache", statistics);
+      }
+    }
+
+    if (ImageBufferPool::GetMaximumSize() != 0)
+    {
+      size_t countUnused;
+      uint64_t unusedSize;
+      ImageBufferPool::GetStatistics(statistics, countUnused, unusedSize);
+      metricsRegistry_->SetFloatValue("orthanc_image_buffers_pool_size_mb",
+                                      static_cast<float>(unusedSize) / static_cast<float>(1024 * 1024));
+      metricsRegistry_->SetIntegerValue("orthanc_image_buffers_pool_count",
+                                        static_cast<int64_t>(countUnused));
+      PublishCacheStatistics(*metricsRegistry_, "orthanc_image_buffers_pool", statistics);
+    }
+  }
+
+
+  void ServerContext::GetCachesStatistics(Json::Value& target)
+  {
+    CacheStatistics statistics;
+
+    target = Json::objectValue;
+
+    storageCache_.GetStatistics(statistics);
+    FormatMemoryCache(target[CACHE_STORAGE], storageCache_.GetNumberOfItems(),
+                      storageCache_.GetCurrentSize(), storageCache_.GetMaximumSize(), statistics);
+
+    storageCache_.GetHeadersStatistics(statistics);
+    FormatMemoryCache(target[CACHE_DICOM_HEADERS], storageCache_.GetHeadersNumberOfItems(),
+                      storageCache_.GetHeadersCurrentSize(), storageCache_.GetHeadersMaximumSize(), statistics);
+
+    StorageDiskCache* diskCache = storageCache_.GetDiskCache();
+    if (diskCache != NULL)
+    {
+      diskCache->GetStatistics(statistics);
+      FormatMemoryCache(target[CACHE_STORAGE_DISK], diskCache->GetNumberOfItems(),
+                        diskCache->GetCurrentSize(), diskCache->GetMaximumSize(), statistics);
+    }
+
+    dicomCache_.GetStatistics(statistics);
+    FormatMemoryCache(target[CACHE_PARSED_DICOM], dicomCache_.GetNumberOfItems(),
+                      dicomCache_.GetCurrentSize(), dicomCache_.GetMaximumSize(), statistics);
+
+    FormatArchive(target[CACHE_QUERY_RETRIEVE], *queryRetrieveArchive_);
+    FormatJobOutputs(target[CACHE_MEDIA], *jobOutputs_);
+
+    if (archivesCache_.get() != NULL)
+    {
+      FormatJobOutputs(target[CACHE_ARCHIVES], *archivesCache_);
+    }
+
+    // The transcoded instances are stored in the storage cache, whose
+    // entries and size include them
+    GetTranscodingCacheStatistics(statistics);
+    target[CACHE_TRANSCODING] = Json::objectValue;
+    FormatCacheStatistics(target[CACHE_TRANSCODING], statistics, false);
+
+    if (findAnswersCache_.get() != NULL)
+    {
+      findAnswersCache_->GetStatistics(statistics);
+      target[CACHE_FIND_ANSWERS] = Json::objectValue;
+      target[CACHE_FIND_ANSWERS]["Entries"] = static_cast<Json::UInt64>(findAnswersCache_->GetNumberOfItems());
+      target[CACHE_FIND_ANSWERS]["MaximumEntries"] = static_cast<Json::UInt64>(findAnswersCache_->GetMaximumSize());
+      FormatCacheStatistics(target[CACHE_FIND_ANSWERS], statistics, true);
+    }
+
+    if (renderedFramesCache_.get() != NULL)
+    {
+      renderedFramesCache_->GetStatistics(statistics);
+      FormatMemoryCache(target[CACHE_RENDERED_FRAMES], renderedFramesCache_->GetNumberOfItems(),
+                        renderedFramesCache_->GetCurrentSize(), renderedFramesCache_->GetMaximumSize(), statistics);
+
+      StorageDiskCache* renderedDiskCache = renderedFramesCache_->GetDiskCache();
+      if (renderedDiskCache != NULL)
+      {
+        renderedDiskCache->GetStatistics(statistics);
+        FormatMemoryCache(target[CACHE_RENDERED_FRAMES_DISK], renderedDiskCache->GetNumberOfItems(),
+                          renderedDiskCache->GetCurrentSize(), renderedDiskCache->GetMaximumSize(), statistics);
+      }
+    }
+
+    {
+      // The entries are the unused pixel buffers, waiting for an image
+      size_t countUnused;
+      uint64_t unusedSize;
+      ImageBufferPool::GetStatistics(statistics, countUnused, unusedSize);
+      FormatMemoryCache(target[CACHE_IMAGE_BUFFERS], countUnused, unusedSize,
+                        ImageBufferPool::GetMaximumSize(), statistics);
+    }
+  }
+
+
+  void ServerContext::SetCacheMaximumSize(const std::string& name,
+                                          uint64_t value)
+  {
+    static const uint64_t MEGABYTE = 1024 * 1024;
+
+    if (name == CACHE_QUERY_RETRIEVE ||
+        name == CACHE_MEDIA ||
+        name == CACHE_ARCHIVES)
+    {
+      if (value == 0 ||
+          value > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "An archive must contain at least one entry");
+      }
+
+      if (name == CACHE_MEDIA)
+      {
+        jobOutputs_->SetMaximumSize(static_cast<size_t>(value));
+      }
+      else if (name == CACHE_ARCHIVES)
+      {
+        if (archivesCache_.get() == NULL)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                                 "The cache of the archives is disabled, check \"ArchivesCacheSize\"");
+        }
+
+        archivesCache_->SetMaximumSize(static_cast<size_t>(value));
+      }
+      else
+      {
+        queryRetrieveArchive_->SetMaximumSize(static_cast<size_t>(value));
+      }
+    }
+    else if (name == CACHE_FIND_ANSWERS)
+    {
+      if (value > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+      else if (findAnswersCache_.get() == NULL)
+      {
+        throw OrthancException(ErrorCode_InexistentItem, "The cache of the answers to the lookups is disabled");
+      }
+      else
+      {
+        findAnswersCache_->SetMaximumSize(static_cast<size_t>(value));  // Throws if "value == 0"
+      }
+    }
+    else if (name == CACHE_TRANSCODING)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "The transcoded instances are stored in the \"" + std::string(CACHE_STORAGE) +
+                             "\" cache, which must be resized instead");
+    }
+    else if (name == CACHE_RENDERED_FRAMES ||
+             name == CACHE_RENDERED_FRAMES_DISK)
+    {
+      if (value > static_cast<uint64_t>(std::numeric_limits<size_t>::max()) / MEGABYTE)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+      else if (renderedFramesCache_.get() == NULL)
+      {
+        throw OrthancException(ErrorCode_InexistentItem, "The cache of the rendered frames is disabled");
+      }
+
+      const size_t size = static_cast<size_t>(value * MEGABYTE);
+      LOG(WARNING) << "Resizing the \"" << name << "\" cache to " << value << " MB";
+
+      if (name == CACHE_RENDERED_FRAMES)
+      {
+        renderedFramesCache_->SetMaximumSize(size);  // Throws if "size == 0"
+      }
+      else if (renderedFramesCache_->GetDiskCache() != NULL)
+      {
+        renderedFramesCache_->GetDiskCache()->SetMaximumSize(size);
+      }
+      else
+      {
+        throw OrthancException(ErrorCode_InexistentItem, "The disk cache of the rendered frames is disabled");
+      }
+    }
+    else if (name == CACHE_IMAGE_BUFFERS)
+    {
+      if (value > std::numeric_limits<uint64_t>::max() / MEGABYTE)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
 
-      if (lastModification > lastSerializedModification)
+      LOG(WARNING) << "Resizing the \"" << name << "\" cache to " << value << " MB";
+      ImageBufferPool::SetMaximumSize(value * MEGABYTE);  // "0" disables the pool
+    }
+    else if (name == CACHE_STORAGE ||
+             name == CACHE_DICOM_HEADERS ||
+             name == CACHE_STORAGE_DISK ||
+             name == CACHE_PARSED_DICOM)
+    {
+      if (value > static_cast<uint64_t>(std::numeric_limits<size_t>::max()) / MEGABYTE)
       {
-        LOG(TRACE) << "Serializing the content of the jobs engine";
-      
-        try
-        {
-          Json::Value value;
-          jobsEngine_.GetRegistry().Serialize(value);
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
 
-          std::string serialized;
-          Toolbox::WriteFastJson(serialized, value);
+      const size_t size = static_cast<size_t>(value * MEGABYTE);
+      LOG(WARNING) << "Resizing the \"" << name << "\" cache to " << value << " MB";
 
-          index_.SetGlobalProperty(GlobalProperty_JobsRegistry, false /* not shared */, serialized);
-          lastSerializedModification = lastModification;
-        }
-        catch (OrthancException& e)
-        {
-          LOG(ERROR) << "Cannot serialize the jobs engine: " << e.What();
-        }
+      if (name == CACHE_STORAGE)
+      {
+        storageCache_.SetMaximumSize(size);
+      }
+      else if (name == CACHE_DICOM_HEADERS)
+      {
+        storageCache_.SetMaximumHeadersSize(size);
+      }
+      else if (name == CACHE_PARSED_DICOM)
+      {
+        dicomCache_.SetMaximumSize(size);  // Throws if "size == 0"
+      }
+      else if (storageCache_.GetDiskCache() != NULL)
+      {
+        storageCache_.GetDiskCache()->SetMaximumSize(size);
+      }
+      else
+      {
+        throw OrthancException(ErrorCode_InexistentItem, "The storage disk cache is disabled");
       }
     }
-  }
-
-
-  void ServerContext::PublishCacheMetrics()
-  {
-    metricsRegistry_->SetFloatValue("orthanc_dicom_cache_size_mb",
-                                    static_cast<float>(dicomCache_.GetCurrentSize()) / static_cast<float>(1024 * 1024));
-    metricsRegistry_->SetIntegerValue("orthanc_dicom_cache_count", 
-                                    static_cast<int64_t>(dicomCache_.GetNumberOfItems()));
-    metricsRegistry_->SetFloatValue("orthanc_storage_cache_size_mb",
-                                    static_cast<float>(storageCache_.GetCurrentSize()) / static_cast<float>(1024 * 1024));
-    metricsRegistry_->SetIntegerValue("orthanc_storage_cache_count", 
-                                    static_cast<int64_t>(storageCache_.GetNumberOfItems()));
+    else
+    {
+      throw OrthancException(ErrorCode_InexistentItem, "Unknown cache: " + name);
+    }
   }
 
 
@@ -382,6 +1617,7 @@ namespace Orthanc
     index_(*this, database, (unitTesting ? 20 : 500), readOnly),
     area_(area),
     compressionEnabled_(false),
+    compressionType_(CompressionType_ZlibWithSize),
     storeMD5_(true),
     largeDicomThrottler_(1),
     dicomCache_(DICOM_CACHE_SIZE),
@@ -395,6 +1631,25 @@ namespace Orthanc
     done_(false),
     haveJobsChanged_(false),
     isJobsEngineUnserialized_(false),
+    asynchronousJobsLoading_(false),
+    isLegacyJobsRegistryCleared_(false),
+    coalesceChangesOnOverflow_(false),
+    pendingChangesOverflowTimeout_(0),
+    isDelayedFilesRemoval_(false),
+    findLoadersPerRequest_(0),
+    zipUploadWindow_(0),
+    archiveTranscodingBatchSize_(1),
+    framesDecodingThreads_(0),
+    jpegChromaSubsampling_(JpegWriter::ChromaSubsampling_420),
+    jpegFastDct_(false),
+    jpegOptimizedHuffman_(false),
+    pngCompressionLevel_(6),
+    pngFilterStrategy_(PngWriter::FilterStrategy_Adaptive),
+    frameOffsetsThreshold_(0),
+    maximumTranscodedAttachmentsSize_(0),
+    transcodedAttachmentsSize_(0),
+    lightweightIngest_(true),
+    validateCachedInstances_(false),
     metricsRegistry_(new MetricsRegistry),
     isHttpServerSecure_(true),
     isExecuteLuaEnabled_(false),
@@ -404,6 +1659,8 @@ namespace Orthanc
     ingestTranscodingOfUncompressed_(true),
     ingestTranscodingOfCompressed_(true),
     preferredTransferSyntax_(DicomTransferSyntax_LittleEndianExplicit),
+    ingestLatencyShort_(0),
+    ingestLatencyLong_(0),
     readOnly_(readOnly),
     patientLevelEnabled_(true),
     deidentifyLogs_(false),
@@ -416,11 +1673,57 @@ namespace Orthanc
 
         queryRetrieveArchive_.reset(
           new SharedArchive(lock.GetConfiguration().GetUnsignedIntegerParameter("QueryRetrieveSize")));
-        mediaArchive_.reset(
-          new SharedArchive(lock.GetConfiguration().GetUnsignedIntegerParameter("MediaArchiveSize")));
+        queryRetrieveArchive_->SetMaximumMemoryUsage(static_cast<size_t>(
+          lock.GetConfiguration().GetUnsignedIntegerParameter("QueryRetrieveMaxMemorySize")) * 1024 * 1024);
+        queryRetrieveArchive_->SetTimeToLive(lock.GetConfiguration().GetUnsignedIntegerParameter("QueryRetrieveTimeToLive"));
+        jobOutputs_.reset(
+          new JobOutputsStore(lock.GetConfiguration().GetUnsignedIntegerParameter("MediaArchiveSize")));
+        jobOutputs_->SetDirectory(lock.GetConfiguration().GetJobsOutputsDirectory());
+        jobOutputs_->SetMaximumTotalSize(static_cast<uint64_t>(
+          lock.GetConfiguration().GetUnsignedIntegerParameter("JobsOutputsMaxSize")) * 1024 * 1024);
+        jobOutputs_->SetTimeToLive(lock.GetConfiguration().GetUnsignedIntegerParameter("JobsOutputsTimeToLive"));
+
+        {
+          const unsigned int archivesCacheSize = lock.GetConfiguration().GetUnsignedIntegerParameter("ArchivesCacheSize");
+          if (archivesCacheSize != 0)
+          {
+            archivesCache_.reset(new JobOutputsStore(archivesCacheSize));
+            archivesCache_->SetDirectory(lock.GetConfiguration().GetJobsOutputsDirectory());
+            archivesCache_->SetMaximumTotalSize(static_cast<uint64_t>(
+              lock.GetConfiguration().GetUnsignedIntegerParameter("ArchivesCacheMaxSize")) * 1024 * 1024);
+          }
+        }
+
         defaultLocalAet_ = lock.GetConfiguration().GetOrthancAET();
         jobsEngine_.SetWorkersCount(lock.GetConfiguration().GetUnsignedIntegerParameter("ConcurrentJobs"));
 
+        {
+          std::set<unsigned int> affinity;
+          lock.GetConfiguration().GetThreadsAffinity(affinity, "Jobs");
+          jobsEngine_.SetThreadsAffinity(affinity);
+        }
+
+        {
+          std::map<std::string, unsigned int> concurrentJobsPerType;
+          lock.GetConfiguration().GetConcurrentJobsPerType(concurrentJobsPerType);
+
+          for (std::map<std::string, unsigned int>::const_iterator
+                 it = concurrentJobsPerType.begin(); it != concurrentJobsPerType.end(); ++it)
+          {
+            jobsEngine_.GetRegistry().SetMaxRunningJobs(it->first, it->second);
+          }
+        }
+
+        unsigned int tasksThreads = lock.GetConfiguration().GetUnsignedIntegerParameter("JobsEngineTasksThreads");
+        if (tasksThreads == 0)
+        {
+          tasksThreads = SystemToolbox::GetHardwareConcurrency();
+        }
+
+        jobsEngine_.SetTasksThreadsCount(tasksThreads);
+
+        SetOfCommandsJob::SetDefaultStepDuration(lock.GetConfiguration().GetUnsignedIntegerParameter("JobsStepDuration"));
+
         saveJobs_ = lock.GetConfiguration().GetBooleanParameter("SaveJobs");
         if (readOnly_ && saveJobs_)
         {
@@ -428,13 +1731,138 @@ namespace Orthanc
           saveJobs_ = false;
         }
 
+        asynchronousJobsLoading_ = lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_ASYNCHRONOUS_JOBS_LOADING);
+
         metricsRegistry_->SetEnabled(lock.GetConfiguration().GetBooleanParameter("MetricsEnabled"));
 
+        // New in Orthanc 1.12.12
+        index_.SetSlowTransactionThreshold(lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_SLOW_DATABASE_TRANSACTION_THRESHOLD));
+        index_.SetChangesRetention(lock.GetConfiguration().GetChangesRetentionDays());
+        index_.SetChangesRetentionCount(lock.GetConfiguration().GetChangesRetentionCount());
+        index_.SetPersistUnstableResources(lock.GetConfiguration().IsPersistUnstableResources());
+
+        {
+          const unsigned int staleness = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_DATABASE_REPLICA_MAX_STALENESS);
+          if (staleness == 0)
+          {
+            // Always use the primary database
+          }
+          else if (index_.GetDatabaseCapabilities().HasReadReplicasSupport())
+          {
+            const unsigned int pin = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_DATABASE_REPLICA_PIN_DURATION);
+            LOG(WARNING) << "The read-only database transactions can be served by replicas with a lag below "
+                         << staleness << "ms, except during " << pin << " seconds after a write";
+            index_.SetReadReplicas(staleness, pin);
+          }
+          else
+          {
+            LOG(WARNING) << "The database backend cannot route the read-only transactions to replicas, "
+                         << "ignoring the configuration option \"" ORTHANC_CONFIG_DATABASE_REPLICA_MAX_STALENESS "\"";
+          }
+        }
+        findStreamingPageSize_ = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_FIND_STREAMING_PAGE_SIZE);
+
+        const unsigned int findAnswersCacheSize = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_FIND_ANSWERS_CACHE_SIZE);
+        if (findAnswersCacheSize != 0)
+        {
+          findAnswersCache_.reset(new LookupAnswersCache(
+            findAnswersCacheSize, lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_FIND_ANSWERS_CACHE_STALENESS)));
+        }
+
+        index_.SetResourcesCacheSize(lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_RESOURCES_LOOKUP_CACHE_SIZE));
+
+        const unsigned int renderedFramesCacheSize = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_RENDERED_FRAMES_CACHE_SIZE);
+        if (renderedFramesCacheSize != 0)
+        {
+          renderedFramesCache_.reset(new RenderedFramesCache(static_cast<size_t>(renderedFramesCacheSize) * 1024 * 1024));
+
+          const std::string directory = lock.GetConfiguration().GetStringParameter(ORTHANC_CONFIG_RENDERED_FRAMES_DISK_CACHE_DIRECTORY);
+          if (!directory.empty())
+          {
+            const unsigned int diskSize = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_MAXIMUM_RENDERED_FRAMES_DISK_CACHE_SIZE);
+            if (diskSize == 0)
+            {
+              throw OrthancException(ErrorCode_ParameterOutOfRange,
+                                     "The configuration option \"" ORTHANC_CONFIG_MAXIMUM_RENDERED_FRAMES_DISK_CACHE_SIZE "\" must be >= 1");
+            }
+
+            LOG(WARNING) << "The rendered frames are spilled into the disk cache in directory \"" << directory
+                         << "\" with a maximum size of " << diskSize << " MB";
+            renderedFramesCache_->SetDiskCache(new StorageDiskCache(lock.GetConfiguration().InterpretStringParameterAsPath(directory),
+                                                                    static_cast<uint64_t>(diskSize) * 1024 * 1024));
+          }
+        }
+
+        {
+          // The pool is shared by all the images of the process
+          const unsigned int poolSize = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_IMAGE_BUFFERS_POOL_SIZE);
+          ImageBufferPool::SetMaximumSize(static_cast<uint64_t>(poolSize) * 1024 * 1024);
+        }
+
+        {
+          const std::string subsampling = lock.GetConfiguration().GetStringParameter(ORTHANC_CONFIG_JPEG_CHROMA_SUBSAMPLING);
+          if (subsampling == "4:2:0")
+          {
+            jpegChromaSubsampling_ = JpegWriter::ChromaSubsampling_420;
+          }
+          else if (subsampling == "4:2:2")
+          {
+            jpegChromaSubsampling_ = JpegWriter::ChromaSubsampling_422;
+          }
+          else if (subsampling == "4:4:4")
+          {
+            jpegChromaSubsampling_ = JpegWriter::ChromaSubsampling_444;
+          }
+          else
+          {
+            throw OrthancException(ErrorCode_ParameterOutOfRange,
+                                   "Bad value for the configuration option \"" ORTHANC_CONFIG_JPEG_CHROMA_SUBSAMPLING
+                                   "\" (must be \"4:2:0\", \"4:2:2\" or \"4:4:4\"): " + subsampling);
+          }
+
+          jpegFastDct_ = lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_JPEG_FAST_DCT);
+          jpegOptimizedHuffman_ = lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_JPEG_OPTIMIZED_HUFFMAN);
+        }
+
+        pngCompressionLevel_ = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_PNG_COMPRESSION_LEVEL);
+        if (pngCompressionLevel_ > 9)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange,
+                                 "The configuration option \"" ORTHANC_CONFIG_PNG_COMPRESSION_LEVEL "\" must be between 0 and 9");
+        }
+
+        pngFilterStrategy_ = PngWriter::StringToFilterStrategy(
+          lock.GetConfiguration().GetStringParameter(ORTHANC_CONFIG_PNG_FILTER_STRATEGY));
+
+        frameOffsetsThreshold_ = static_cast<uint64_t>(lock.GetConfiguration().GetUnsignedIntegerParameter(
+                                                         ORTHANC_CONFIG_FRAME_OFFSETS_INDEX_THRESHOLD)) * 1024 * 1024;
+
+        maximumTranscodedAttachmentsSize_ = static_cast<uint64_t>(lock.GetConfiguration().GetUnsignedIntegerParameter(
+                                                                    ORTHANC_CONFIG_MAXIMUM_TRANSCODED_ATTACHMENTS_SIZE)) * 1024 * 1024;
+
+        lightweightIngest_ = lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_LIGHTWEIGHT_INGEST);
+
+        validateCachedInstances_ = lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_VALIDATE_CACHED_INSTANCES);
+        if (validateCachedInstances_)
+        {
+          LOG(WARNING) << "The revision of the cached DICOM instances is validated against the database before each use";
+        }
+
         // New configuration options in Orthanc 1.5.1
         findStorageAccessMode_ = StringToFindStorageAccessMode(lock.GetConfiguration().GetStringParameter("StorageAccessOnFind"));
         limitFindInstances_ = lock.GetConfiguration().GetUnsignedIntegerParameter("LimitFindInstances");
         limitFindResults_ = lock.GetConfiguration().GetUnsignedIntegerParameter("LimitFindResults");
 
+        storeConnectionPool_.SetMaxIdlePerModality(
+          lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_DICOM_SCU_ASSOCIATION_POOL_SIZE));
+        storeConnectionPool_.SetIdleTimeout(
+          1000 * lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_DICOM_SCU_ASSOCIATION_POOL_TIMEOUT));
+
+        ThreadedInstancesLoader::SetGlobalMemoryBudget(
+          static_cast<uint64_t>(lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_LOADER_MEMORY_BUDGET)) * 1024 * 1024);
+        ThreadedInstancesLoader::SetGlobalMaxBandwidth(
+          static_cast<uint64_t>(lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_LOADER_MAX_BANDWIDTH)) * 1024 * 1024);
+
         // New configuration option in Orthanc 1.6.0
         storageCommitmentReports_.reset(new StorageCommitmentReports(lock.GetConfiguration().GetUnsignedIntegerParameter("StorageCommitmentReportsSize")));
 
@@ -541,15 +1969,158 @@ namespace Orthanc
       jobsEngine_.SetThreadSleep(unitTesting ? 20 : 200);
 
       listeners_.push_back(ServerListener(luaListener_, "Lua"));
+
+      {
+        unsigned int changesThreads;
+        unsigned int queueSize;
+        std::string policy;
+
+        {
+          OrthancConfiguration::ReaderLock lock;
+          changesThreads = lock.GetConfiguration().GetChangesThreads();
+          queueSize = lock.GetConfiguration().GetPendingChangesQueueSize();
+          policy = lock.GetConfiguration().GetStringParameter(ORTHANC_CONFIG_PENDING_CHANGES_OVERFLOW_POLICY);
+          pendingChangesOverflowTimeout_ = lock.GetConfiguration().GetPendingChangesOverflowTimeout();
+        }
+
+        if (policy == "Block")
+        {
+          coalesceChangesOnOverflow_ = false;
+        }
+        else if (policy == "Coalesce")
+        {
+          coalesceChangesOnOverflow_ = true;
+        }
+        else
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange,
+                                 "Configuration option \"" + std::string(ORTHANC_CONFIG_PENDING_CHANGES_OVERFLOW_POLICY) +
+                                 "\" must be \"Block\" or \"Coalesce\", found: " + policy);
+        }
+
+        if (queueSize != 0)
+        {
+          LOG(WARNING) << "At most " << queueSize << " changes are waiting to be signaled, overflow policy: " << policy;
+        }
+
+        pendingChanges_.SetMaxSize(queueSize);
+
+        if (changesThreads == 0)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange,
+                                 "The configuration option \"" ORTHANC_CONFIG_CHANGES_THREADS "\" must be >= 1");
+        }
+        else if (changesThreads > 1)
+        {
+          LOG(WARNING) << "The changes are dispatched by " << changesThreads << " threads, ordered by study";
+
+          changesPartitions_.resize(changesThreads);
+          for (size_t i = 0; i < changesPartitions_.size(); i++)
+          {
+            changesPartitions_[i] = new ChangesPartition(i, queueSize);
+            changesPartitions_[i]->Start(*this, (unitTesting ? 20 : 100));
+          }
+        }
+      }
+
       changeThread_ = boost::thread(ChangeThread, this, (unitTesting ? 20 : 100));
       jobEventsThread_ = boost::thread(JobEventsThread, this, (unitTesting ? 20 : 100));
+
+      if (storeConnectionPool_.GetMaxIdlePerModality() != 0)
+      {
+        storeConnectionPoolThread_ = boost::thread(StoreConnectionPoolThread, this, (unitTesting ? 20 : 500));
+      }
       
-#if HAVE_MALLOC_TRIM == 1
-      LOG(INFO) << "Starting memory trimming thread at 30 seconds interval";
-      memoryTrimmingThread_ = boost::thread(MemoryTrimmingThread, this, 30);
-#else
-      LOG(INFO) << "Your platform does not support malloc_trim(), not starting the memory trimming thread";
-#endif
+      {
+        unsigned int interval;
+
+        {
+          OrthancConfiguration::ReaderLock lock;
+          interval = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_CACHE_INVALIDATION_INTERVAL);
+        }
+
+        if (interval != 0)
+        {
+          LOG(WARNING) << "Starting the thread that invalidates the caches from the changes log, at " << interval << " seconds interval";
+          cacheInvalidationThread_ = boost::thread(CacheInvalidationThread, this, interval);
+        }
+      }
+
+      if (!readOnly_)
+      {
+        bool delayed;
+        unsigned int threads, rate;
+
+        {
+          OrthancConfiguration::ReaderLock lock;
+          delayed = lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_DELAYED_FILES_REMOVAL);
+          threads = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_DELAYED_FILES_REMOVAL_THREADS);
+          rate = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_DELAYED_FILES_REMOVAL_MAXIMUM_RATE);
+        }
+
+        const bool hasQueues = index_.GetDatabaseCapabilities().HasQueuesSupport();
+
+        if (delayed &&
+            !hasQueues)
+        {
+          LOG(WARNING) << "The database backend has no support for the queues, ignoring the configuration option \""
+                       << ORTHANC_CONFIG_DELAYED_FILES_REMOVAL << "\"";
+          delayed = false;
+        }
+
+        // The remover is also started if files were left in the queue
+        // by a previous execution, so that they eventually get removed
+        if (hasQueues &&
+            (delayed || index_.GetQueueSize(DelayedFilesRemover::GetQueueId()) > 0))
+        {
+          if (threads == 0)
+          {
+            throw OrthancException(ErrorCode_ParameterOutOfRange,
+                                   "The configuration option \"" ORTHANC_CONFIG_DELAYED_FILES_REMOVAL_THREADS "\" must be >= 1");
+          }
+
+          if (delayed)
+          {
+            LOG(WARNING) << "The files of the deleted resources are removed in the background by " << threads << " thread(s)"
+                         << (rate == 0 ? std::string() : ", at most " + boost::lexical_cast<std::string>(rate) + " files per second");
+          }
+          else
+          {
+            LOG(WARNING) << "Removing the files that were left in the queue of the delayed removals by a previous execution";
+          }
+
+          delayedFilesRemover_.reset(new DelayedFilesRemover(*this, rate));
+          delayedFilesRemover_->Start(threads);
+          isDelayedFilesRemoval_ = delayed;
+        }
+      }
+
+      if (MemoryAllocator::IsTrimmingSupported())
+      {
+        unsigned int threshold;
+
+        {
+          OrthancConfiguration::ReaderLock lock;
+          threshold = lock.GetConfiguration().GetMemoryTrimmingThreshold();
+        }
+
+        if (threshold == 0)
+        {
+          LOG(INFO) << "Starting memory trimming thread at 30 seconds interval (allocator: " << MemoryAllocator::GetName() << ")";
+        }
+        else
+        {
+          LOG(INFO) << "Starting memory trimming thread, once " << threshold << "MB are retained by the allocator (allocator: "
+                    << MemoryAllocator::GetName() << ")";
+        }
+
+        memoryTrimmingThread_ = boost::thread(MemoryTrimmingThread, this, 30,
+                                              static_cast<uint64_t>(threshold) * 1024 * 1024);
+      }
+      else
+      {
+        LOG(INFO) << "Your platform does not support malloc_trim(), not starting the memory trimming thread";
+      }
     }
     catch (OrthancException&)
     {
@@ -559,46 +2130,115 @@ namespace Orthanc
   }
 
 
-  
-  ServerContext::~ServerContext()
-  {
-    if (!done_)
-    {
-      LOG(ERROR) << "INTERNAL ERROR: ServerContext::Stop() should be invoked manually to avoid mess in the destruction order!";
-      Stop();
-    }
-  }
+  
+  ServerContext::~ServerContext()
+  {
+    if (!done_)
+    {
+      LOG(ERROR) << "INTERNAL ERROR: ServerContext::Stop() should be invoked manually to avoid mess in the destruction order!";
+      Stop();
+    }
+  }
+
+
+  void ServerContext::Stop()
+  {
+    if (!done_)
+    {
+      {
+        boost::unique_lock<boost::shared_mutex> lock(listenersMutex_);
+        listeners_.clear();
+      }
+
+      done_ = true;
+
+      if (changeThread_.joinable())
+      {
+        changeThread_.join();
+      }
+
+      for (size_t i = 0; i < changesPartitions_.size(); i++)
+      {
+        if (changesPartitions_[i] != NULL)
+        {
+          changesPartitions_[i]->Join();
+          delete changesPartitions_[i];
+        }
+      }
+
+      changesPartitions_.clear();
+
+      if (jobEventsThread_.joinable())
+      {
+        jobEventsThread_.join();
+      }
+
+      if (saveJobsThread_.joinable())
+      {
+        saveJobsThread_.join();
+      }
+
+      if (memoryTrimmingThread_.joinable())
+      {
+        memoryTrimmingThread_.join();
+      }
+
+      if (cacheInvalidationThread_.joinable())
+      {
+        cacheInvalidationThread_.join();
+      }
+
+      if (storeConnectionPoolThread_.joinable())
+      {
+        storeConnectionPoolThread_.join();
+      }
+
+      if (seriesPrefetcher_.get() != NULL)
+      {
+        seriesPrefetcher_->Stop();
+      }
+
+      if (ingestTranscodingPipeline_.get() != NULL)
+      {
+        ingestTranscodingPipeline_->Stop();
+      }
 
+      if (seriesThumbnailsGenerator_.get() != NULL)
+      {
+        seriesThumbnailsGenerator_->Stop();
+      }
 
-  void ServerContext::Stop()
-  {
-    if (!done_)
-    {
+      if (findLoaders_.get() != NULL)
       {
-        boost::unique_lock<boost::shared_mutex> lock(listenersMutex_);
-        listeners_.clear();
+        findLoaders_->Stop();
       }
 
-      done_ = true;
+      if (zipUploadWorkers_.get() != NULL)
+      {
+        zipUploadWorkers_->Stop();
+      }
 
-      if (changeThread_.joinable())
+      if (framesDecodingWorkers_.get() != NULL)
       {
-        changeThread_.join();
+        framesDecodingWorkers_->Stop();
       }
 
-      if (jobEventsThread_.joinable())
+      if (imageProcessingWorkers_.get() != NULL)
       {
-        jobEventsThread_.join();
+        ImageProcessing::SetParallelExecutor(boost::shared_ptr<IExecutorService>(), 0);
+        imageProcessingWorkers_->Stop();
       }
 
-      if (saveJobsThread_.joinable())
+      if (sharedJobsQueue_.get() != NULL)
       {
-        saveJobsThread_.join();
+        // Must be stopped before the jobs engine
+        sharedJobsQueue_->Stop();
       }
 
-      if (memoryTrimmingThread_.joinable())
+      if (loadJobsThread_.joinable())
       {
-        memoryTrimmingThread_.join();
+        // "done_" makes the reloading of the jobs stop early
+        loadJobsThread_.join();
       }
 
       jobsEngine_.GetRegistry().ResetObserver();
@@ -611,6 +2251,28 @@ namespace Orthanc
 
       // Do not change the order below!
       jobsEngine_.Stop();
+
+      if (instancesLoaderService_.get() != NULL)
+      {
+        // The loaders of the jobs are waiting for these threads
+        instancesLoaderService_->Stop();
+      }
+
+      if (archiveTranscodingWorkers_.get() != NULL)
+      {
+        // Likewise, the loaders of the archive jobs wait for the
+        // DICOM files that are transcoded by these threads
+        archiveTranscodingWorkers_->Stop();
+      }
+
+      if (delayedFilesRemover_.get() != NULL)
+      {
+        // The files that are still in the queue are removed at the
+        // next start of Orthanc
+        isDelayedFilesRemoval_ = false;
+        delayedFilesRemover_->Stop();
+      }
+
       index_.Stop();
     }
   }
@@ -641,6 +2303,29 @@ namespace Orthanc
   }
 
 
+  void ServerContext::SetCompressionType(CompressionType compression)
+  {
+    if (compression == CompressionType_None)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else if (!IsCompressionTypeSupported(compression))
+    {
+      throw OrthancException(ErrorCode_NotImplemented, "This version of Orthanc was built without support for the \"" +
+                             std::string(EnumerationToString(compression)) + "\" compression");
+    }
+    else
+    {
+      if (compression != CompressionType_ZlibWithSize)
+      {
+        LOG(WARNING) << "Disk compression uses the \"" << EnumerationToString(compression) << "\" algorithm";
+      }
+
+      compressionType_ = compression;
+    }
+  }
+
+
   void ServerContext::SetPatientLevelEnabled(bool enabled)
   {
     if (enabled)
@@ -686,12 +2371,71 @@ namespace Orthanc
   }
 
 
+  class ServerContext::IngestLatencyRecorder : public boost::noncopyable
+  {
+  private:
+    ServerContext&  context_;
+    bool            active_;
+    ElapsedTimer    timer_;
+
+  public:
+    IngestLatencyRecorder(ServerContext& context,
+                          bool active) :
+      context_(context),
+      active_(active)
+    {
+    }
+
+    ~IngestLatencyRecorder()
+    {
+      if (active_)
+      {
+        const double duration = static_cast<double>(timer_.GetElapsedMicroseconds()) / 1000.0;
+
+        boost::mutex::scoped_lock lock(context_.ingestLatencyMutex_);
+
+        if (context_.lastIngest_.is_not_a_date_time())
+        {
+          context_.ingestLatencyShort_ = duration;
+          context_.ingestLatencyLong_ = duration;
+        }
+        else
+        {
+          context_.ingestLatencyShort_ = 0.8 * context_.ingestLatencyShort_ + 0.2 * duration;
+          context_.ingestLatencyLong_ = 0.99 * context_.ingestLatencyLong_ + 0.01 * duration;
+        }
+
+        context_.lastIngest_ = boost::posix_time::microsec_clock::universal_time();
+      }
+    }
+  };
+
+
+  bool ServerContext::IsIngestLatencyRising()
+  {
+    static const double MINIMUM_LATENCY = 10;  // Below 10ms per instance, the ingest is not considered as slow
+    static const double RISE_FACTOR = 1.5;
+    static const int IDLE_SECONDS = 5;         // No ingest since 5 seconds: No need to slow down
+
+    const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+    boost::mutex::scoped_lock lock(ingestLatencyMutex_);
+
+    return (!lastIngest_.is_not_a_date_time() &&
+            (now - lastIngest_).total_seconds() < IDLE_SECONDS &&
+            ingestLatencyShort_ >= MINIMUM_LATENCY &&
+            ingestLatencyShort_ > RISE_FACTOR * ingestLatencyLong_);
+  }
+
+
   ServerContext::StoreResult ServerContext::StoreAfterTranscoding(std::string& resultPublicId,
                                                                   DicomInstanceToStore& dicom,
                                                                   bool isReconstruct,
                                                                   bool isAdoption,
                                                                   const FileInfo& adoptedFile)
   {
+    IngestLatencyRecorder latency(*this, !isReconstruct);
+
     OverwriteInstancesMode overwriteMode = overwriteInstances_;
     bool overwriteInDb = IsOverwriteInstances();
 
@@ -710,18 +2454,26 @@ namespace Orthanc
     bool hasTransferSyntax = dicom.LookupTransferSyntax(transferSyntax);
     
     DicomMap summary;
-    dicom.GetSummary(summary);   // -> from Orthanc 1.11.1, this includes the leaf nodes and sequences
 
-    std::set<DicomTag> allMainDicomTags;
-    DicomMap::GetAllMainDicomTags(allMainDicomTags);
+    // Most instances only need the tags that are read by the index:
+    // Extract them by walking the header without DCMTK, and only
+    // fallback to the full DCMTK summary if this is not possible (new
+    // in Orthanc 1.12.12)
+    if (!lightweightIngest_ ||
+        !ServerToolbox::ExtractIndexingSummary(summary, dicom.GetBufferData(), dicom.GetBufferSize()))
+    {
+      dicom.GetSummary(summary);   // -> from Orthanc 1.11.1, this includes the leaf nodes and sequences
+    }
 
     try
     {
-      MetricsRegistry::Timer timer(GetMetricsRegistry(), "orthanc_store_dicom_duration_ms");
+      MetricsRegistry::HistogramTimer timer(GetMetricsRegistry(), "orthanc_store_dicom_duration_ms", "");
+      Tracing::Span span("store", Tracing::SpanKind_Internal);
       StorageAccessor accessor(area_, storageCache_, GetMetricsRegistry());
 
       DicomInstanceHasher hasher(summary);
       resultPublicId = hasher.HashInstance();
+      span.SetAttribute("orthanc.instance", resultPublicId);
 
       StoreResult result;
       std::string dicomMd5;
@@ -757,11 +2509,38 @@ namespace Orthanc
         }
       }
 
-      Json::Value dicomAsJson;
-      dicom.GetDicomAsJson(dicomAsJson, allMainDicomTags);  // don't crop any main dicom tags
+      // The conversion of the dataset to JSON is a second full pass
+      // over the dataset, in addition to the extraction of the
+      // summary: Only do it if some listener reads the simplified tags
+      // of the instance (new in Orthanc 1.12.12)
+      bool isSimplifiedTagsNeeded = false;
 
-      Json::Value simplifiedTags;
-      Toolbox::SimplifyDicomAsJson(simplifiedTags, dicomAsJson, DicomToJsonFormat_Human);
+      if (!isReconstruct)
+      {
+        boost::shared_lock<boost::shared_mutex> lock(listenersMutex_);
+
+        for (ServerListeners::iterator it = listeners_.begin(); it != listeners_.end(); ++it)
+        {
+          if (it->GetListener().IsSimplifiedTagsOfIncomingInstanceNeeded())
+          {
+            isSimplifiedTagsNeeded = true;
+            break;
+          }
+        }
+      }
+
+      Json::Value simplifiedTags = Json::objectValue;
+
+      if (isSimplifiedTagsNeeded)
+      {
+        std::set<DicomTag> allMainDicomTags;
+        DicomMap::GetAllMainDicomTags(allMainDicomTags);
+
+        Json::Value dicomAsJson;
+        dicom.GetDicomAsJson(dicomAsJson, allMainDicomTags);  // don't crop any main dicom tags
+
+        Toolbox::SimplifyDicomAsJson(simplifiedTags, dicomAsJson, DicomToJsonFormat_Human);
+      }
 
       // Test if the instance must be filtered out
 
@@ -815,8 +2594,13 @@ namespace Orthanc
       // If overwriteMode == OverwriteInstancesMode_Always, then, let's always invalidate even if it is meaningful only if the file has changed (note: there is a TODO about cache and MD5)
       dicomCache_.Invalidate(resultPublicId);
 
+      if (renderedFramesCache_.get() != NULL)
+      {
+        renderedFramesCache_->InvalidateInstance(resultPublicId);
+      }
+
       // TODO Should we use "gzip" instead?
-      CompressionType compression = (compressionEnabled_ ? CompressionType_ZlibWithSize : CompressionType_None);
+      CompressionType compression = (compressionEnabled_ ? compressionType_ : CompressionType_None);
 
       StatelessDatabaseOperations::Attachments attachments;
       FileInfo dicomInfo;
@@ -840,6 +2624,25 @@ namespace Orthanc
         attachments.push_back(dicomUntilPixelData);
       }
 
+      FileInfo frameOffsets;
+      if (hasPixelDataOffset &&
+          hasTransferSyntax &&
+          frameOffsetsThreshold_ > 0 &&
+          static_cast<uint64_t>(dicom.GetBufferSize()) >= frameOffsetsThreshold_ &&
+          area_.HasEfficientReadRange() &&
+          attachments.front().GetCompressionType() == CompressionType_None)
+      {
+        // New in Orthanc 1.12.12
+        std::string serialized;
+        if (ComputeFrameOffsets(serialized, dicom.GetBufferData(), dicom.GetBufferSize(),
+                                pixelDataOffset, transferSyntax, summary))
+        {
+          accessor.Write(frameOffsets, serialized.c_str(), serialized.size(), FileContentType_DicomFrameOffsets,
+                         CompressionType_None, storeMD5_, NULL);
+          attachments.push_back(frameOffsets);
+        }
+      }
+
       typedef std::map<MetadataType, std::string>  InstanceMetadata;
       InstanceMetadata  instanceMetadata;
 
@@ -866,6 +2669,11 @@ namespace Orthanc
         {
           accessor.Remove(dicomUntilPixelData);
         }
+
+        if (frameOffsets.IsValid())
+        {
+          accessor.Remove(frameOffsets);
+        }
         
         throw;
       }
@@ -890,6 +2698,11 @@ namespace Orthanc
         {
           accessor.Remove(dicomUntilPixelData);
         }
+
+        if (frameOffsets.IsValid())
+        {
+          accessor.Remove(frameOffsets);
+        }
       }
 
       if (!isReconstruct) 
@@ -925,6 +2738,12 @@ namespace Orthanc
             break;
         }
 
+        if (result.GetStatus() == StoreStatus_Success &&
+            seriesThumbnailsGenerator_.get() != NULL)
+        {
+          seriesThumbnailsGenerator_->SignalInstanceStored(hasher.HashSeries());
+        }
+
         // skip all signals if this is a reconstruction
         if (result.GetStatus() == StoreStatus_Success ||
             result.GetStatus() == StoreStatus_AlreadyStored)
@@ -1017,6 +2836,46 @@ namespace Orthanc
     return TranscodeAndStore(resultPublicId, dicom);
   }
 
+  bool ServerContext::IsIngestTranscodingNeeded(const DicomInstanceToStore& dicom) const
+  {
+    DicomTransferSyntax sourceSyntax;
+    if (!dicom.LookupTransferSyntax(sourceSyntax) ||
+        sourceSyntax == ingestTransferSyntax_)
+    {
+      // Don't transcode if the incoming DICOM is already in the proper transfer syntax
+      return false;
+    }
+    else if (!IsTranscodableTransferSyntax(sourceSyntax))
+    {
+      // Don't try to transcode video files, this is useless (new in
+      // Orthanc 1.8.2). This could be accepted in the future if
+      // video transcoding gets implemented.
+      return false;
+    }
+    else if (IsUncompressedTransferSyntax(sourceSyntax))
+    {
+      // This is an uncompressed transfer syntax (new in Orthanc 1.8.2)
+      bool transcode = ingestTranscodingOfUncompressed_;
+        
+      // If the DICOM does not have any pixel data (e.g. a DICOM SR, an ECG, a PDF, RTSTRUCT, ...), it makes no sense
+      // to transcode it to a compressed Transfer Syntax and it might actually be considered invalid or poorly handled
+      // by some softwares receiving the data.  Therefore, we skip transcoding in this case unless
+      // the ingestTransferSyntax is uncompressed in which case, we might just want to change e.g. from Implicit to Explicit.
+      if (transcode && !dicom.HasPixelData() && !IsUncompressedTransferSyntax(ingestTransferSyntax_))
+      {
+        transcode = false;
+      }
+
+      return transcode;
+    }
+    else
+    {
+      // This is an compressed transfer syntax (new in Orthanc 1.8.2)
+      return ingestTranscodingOfCompressed_;
+    }
+  }
+
+
   ServerContext::StoreResult ServerContext::TranscodeAndStore(std::string& resultPublicId,
                                                               DicomInstanceToStore* dicom,
                                                               bool isReconstruct)
@@ -1031,40 +2890,37 @@ namespace Orthanc
     {
       // Automated transcoding of incoming DICOM instance
 
-      bool transcode = false;
+      const bool transcode = IsIngestTranscodingNeeded(*dicom);
 
-      DicomTransferSyntax sourceSyntax;
-      if (!dicom->LookupTransferSyntax(sourceSyntax) ||
-          sourceSyntax == ingestTransferSyntax_)
-      {
-        // Don't transcode if the incoming DICOM is already in the proper transfer syntax
-        transcode = false;
-      }
-      else if (!IsTranscodableTransferSyntax(sourceSyntax))
-      {
-        // Don't try to transcode video files, this is useless (new in
-        // Orthanc 1.8.2). This could be accepted in the future if
-        // video transcoding gets implemented.
-        transcode = false;
-      }
-      else if (IsUncompressedTransferSyntax(sourceSyntax))
+      if (transcode &&
+          !isReconstruct &&
+          ingestTranscodingPipeline_.get() != NULL &&
+          ingestTranscodingPipeline_->Reserve())
       {
-        // This is an uncompressed transfer syntax (new in Orthanc 1.8.2)
-        transcode = ingestTranscodingOfUncompressed_;
-        
-        // If the DICOM does not have any pixel data (e.g. a DICOM SR, an ECG, a PDF, RTSTRUCT, ...), it makes no sense
-        // to transcode it to a compressed Transfer Syntax and it might actually be considered invalid or poorly handled
-        // by some softwares receiving the data.  Therefore, we skip transcoding in this case unless
-        // the ingestTransferSyntax is uncompressed in which case, we might just want to change e.g. from Implicit to Explicit.
-        if (transcode && !dicom->HasPixelData() && !IsUncompressedTransferSyntax(ingestTransferSyntax_))
+        // Store the original file, and transcode it in the background
+        // (new in Orthanc 1.12.12)
+        StoreResult result;
+
+        try
         {
-          transcode = false;
+          result = StoreAfterTranscoding(resultPublicId, *dicom, isReconstruct);
         }
-      }
-      else
-      {
-        // This is an compressed transfer syntax (new in Orthanc 1.8.2)
-        transcode = ingestTranscodingOfCompressed_;
+        catch (OrthancException&)
+        {
+          ingestTranscodingPipeline_->CancelReservation();
+          throw;
+        }
+
+        if (result.GetStatus() == StoreStatus_Success)
+        {
+          ingestTranscodingPipeline_->Submit(resultPublicId);
+        }
+        else
+        {
+          ingestTranscodingPipeline_->CancelReservation();
+        }
+
+        return result;
       }
 
       if (!transcode)
@@ -1092,35 +2948,200 @@ namespace Orthanc
           imageInfo.ThrowIfInvalidFrameSize();
         }
 
-        if (GetTranscoder().Transcode(transcoded, source, syntaxes, TranscodingSopInstanceUidMode_AllowNew /* allow new SOP instance UID */))
-        {
-          std::unique_ptr<ParsedDicomFile> tmp(transcoded.ReleaseAsParsedDicomFile());
+        if (GetTranscoder().Transcode(transcoded, source, syntaxes, TranscodingSopInstanceUidMode_AllowNew /* allow new SOP instance UID */))
+        {
+          if (!isReconstruct &&
+              !transcoded.HasParsed())
+          {
+            // The transcoder (typically a plugin) has only produced a
+            // buffer: Store this buffer as such, instead of parsing it
+            // here and serializing it again (new in Orthanc 1.12.12)
+            std::unique_ptr<DicomInstanceToStore> toStore(
+              DicomInstanceToStore::CreateFromBuffer(transcoded.GetBufferData(), transcoded.GetBufferSize()));
+            toStore->SetOrigin(dicom->GetOrigin());
+            toStore->CopyMetadata(dicom->GetMetadata());
+
+            return StoreAfterTranscoding(resultPublicId, *toStore, isReconstruct);
+          }
+
+          std::unique_ptr<ParsedDicomFile> tmp(transcoded.ReleaseAsParsedDicomFile());
+
+          if (isReconstruct)
+          {
+            // when reconstructing, we always want to keep the DICOM IDs untouched even if the transcoding has generated a new SOPInstanceUID.
+            const Orthanc::ParsedDicomFile& sourceDicom = dicom->GetParsedDicomFile();
+            std::string sopInstanceUid;
+            sourceDicom.GetTagValue(sopInstanceUid, DICOM_TAG_SOP_INSTANCE_UID);
+            tmp->ReplacePlainString(DICOM_TAG_SOP_INSTANCE_UID, sopInstanceUid);
+          }
+
+          std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromParsedDicomFile(*tmp));
+          toStore->SetOrigin(dicom->GetOrigin());
+          toStore->CopyMetadata(dicom->GetMetadata());
+
+          StoreResult result = StoreAfterTranscoding(resultPublicId, *toStore, isReconstruct);
+          assert(resultPublicId == tmp->GetHasher().HashInstance());
+
+          return result;
+        }
+        else
+        {
+          // Cannot transcode => store the original file
+          return StoreAfterTranscoding(resultPublicId, *dicom, isReconstruct);
+        }
+      }
+    }
+  }
+
+
+  void ServerContext::TranscodeStoredInstance(const std::string& instanceId)
+  {
+    FileInfo attachment;
+    int64_t revision;
+    if (!index_.LookupAttachmentNoThrowIfResourceNotFound(attachment, revision, ResourceType_Instance,
+                                                          instanceId, FileContentType_Dicom))
+    {
+      return;  // The instance has been deleted in the meantime
+    }
+
+    StorageAccessor accessor(area_, storageCache_, GetMetricsRegistry());
+
+    std::string source;
+    accessor.Read(source, attachment);
+
+    std::unique_ptr<DicomInstanceToStore> original(DicomInstanceToStore::CreateFromBuffer(source));
+    if (!IsIngestTranscodingNeeded(*original))
+    {
+      return;  // Already transcoded, or replaced in the meantime
+    }
+
+    DicomMap summary;
+    original->GetSummary(summary);
+
+    if (original->HasPixelData())
+    {
+      DicomImageInformation imageInfo(summary);
+      imageInfo.ThrowIfInvalidFrameSize();
+    }
+
+    std::set<DicomTransferSyntax> syntaxes;
+    syntaxes.insert(ingestTransferSyntax_);
+
+    IDicomTranscoder::DicomImage sourceImage;
+    sourceImage.SetExternalBuffer(source);
+
+    // The DICOM identifiers must be kept untouched, as the instance
+    // has already been acknowledged and indexed with them
+    IDicomTranscoder::DicomImage transcoded;
+    if (!GetTranscoder().Transcode(transcoded, sourceImage, syntaxes, TranscodingSopInstanceUidMode_Preserve))
+    {
+      LOG(INFO) << "Cannot transcode instance " << instanceId << ", keeping its original transfer syntax";
+      return;
+    }
+
+    std::unique_ptr<DicomInstanceToStore> dicom(
+      DicomInstanceToStore::CreateFromBuffer(transcoded.GetBufferData(), transcoded.GetBufferSize()));
+
+    DicomMap transcodedSummary;
+    dicom->GetSummary(transcodedSummary);
+
+    DicomTransferSyntax transferSyntax;
+    if (!dicom->LookupTransferSyntax(transferSyntax) ||
+        DicomInstanceHasher(transcodedSummary).HashInstance() != instanceId)
+    {
+      throw OrthancException(ErrorCode_InternalError, "The transcoder has changed the DICOM identifiers");
+    }
+
+    uint64_t pixelDataOffset;
+    ValueRepresentation pixelDataVR;
+    const bool hasPixelDataOffset = DicomStreamReader::LookupPixelDataOffset(
+      pixelDataOffset, pixelDataVR, dicom->GetBufferData(), dicom->GetBufferSize());
+
+    const bool hasPixelDataVR = (hasPixelDataOffset &&
+                                 transcodedSummary.GuessPixelDataValueRepresentation(transferSyntax) != pixelDataVR);
+
+    // Same attachments as in "StoreAfterTranscoding()"
+    CompressionType compression = (compressionEnabled_ ? compressionType_ : CompressionType_None);
+
+    StatelessDatabaseOperations::Attachments attachments;
+
+    FileInfo dicomInfo;
+    accessor.Write(dicomInfo, dicom->GetBufferData(), dicom->GetBufferSize(), FileContentType_Dicom, compression, storeMD5_, dicom.get());
+    attachments.push_back(dicomInfo);
+
+    try
+    {
+      if (hasPixelDataOffset &&
+          (!area_.HasEfficientReadRange() ||
+           compressionEnabled_))
+      {
+        FileInfo dicomUntilPixelData;
+        accessor.Write(dicomUntilPixelData, dicom->GetBufferData(), pixelDataOffset, FileContentType_DicomUntilPixelData, compression, storeMD5_, NULL);
+        attachments.push_back(dicomUntilPixelData);
+      }
+
+      std::string serialized;
+      if (hasPixelDataOffset &&
+          frameOffsetsThreshold_ > 0 &&
+          static_cast<uint64_t>(dicom->GetBufferSize()) >= frameOffsetsThreshold_ &&
+          area_.HasEfficientReadRange() &&
+          compression == CompressionType_None &&
+          ComputeFrameOffsets(serialized, dicom->GetBufferData(), dicom->GetBufferSize(),
+                              pixelDataOffset, transferSyntax, transcodedSummary))
+      {
+        FileInfo frameOffsets;
+        accessor.Write(frameOffsets, serialized.c_str(), serialized.size(), FileContentType_DicomFrameOffsets,
+                       CompressionType_None, storeMD5_, NULL);
+        attachments.push_back(frameOffsets);
+      }
+
+      index_.ReplaceInstanceEncoding(instanceId, attachment.GetUuid(), attachments, transferSyntax,
+                                     hasPixelDataOffset, pixelDataOffset, hasPixelDataVR, pixelDataVR);
+    }
+    catch (OrthancException& e)
+    {
+      for (StatelessDatabaseOperations::Attachments::const_iterator
+             it = attachments.begin(); it != attachments.end(); ++it)
+      {
+        accessor.Remove(*it);
+      }
+
+      if (e.GetErrorCode() == ErrorCode_Revision ||
+          e.GetErrorCode() == ErrorCode_InexistentItem)
+      {
+        // The instance has been modified or deleted in the meantime
+        LOG(INFO) << "Instance " << instanceId << " has changed during its transcoding, discarding it";
+        return;
+      }
+      else
+      {
+        throw;
+      }
+    }
 
-          if (isReconstruct)
-          {
-            // when reconstructing, we always want to keep the DICOM IDs untouched even if the transcoding has generated a new SOPInstanceUID.
-            const Orthanc::ParsedDicomFile& sourceDicom = dicom->GetParsedDicomFile();
-            std::string sopInstanceUid;
-            sourceDicom.GetTagValue(sopInstanceUid, DICOM_TAG_SOP_INSTANCE_UID);
-            tmp->ReplacePlainString(DICOM_TAG_SOP_INSTANCE_UID, sopInstanceUid);
-          }
+    InvalidateCachedInstance(instanceId);
 
-          std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromParsedDicomFile(*tmp));
-          toStore->SetOrigin(dicom->GetOrigin());
-          toStore->CopyMetadata(dicom->GetMetadata());
+    LOG(INFO) << "Instance " << instanceId << " transcoded in the background to "
+              << GetTransferSyntaxUid(transferSyntax);
+  }
 
-          StoreResult result = StoreAfterTranscoding(resultPublicId, *toStore, isReconstruct);
-          assert(resultPublicId == tmp->GetHasher().HashInstance());
 
-          return result;
-        }
-        else
-        {
-          // Cannot transcode => store the original file
-          return StoreAfterTranscoding(resultPublicId, *dicom, isReconstruct);
-        }
-      }
+  void ServerContext::StartIngestTranscodingPipeline(unsigned int countThreads)
+  {
+    if (ingestTranscodingPipeline_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (!isIngestTranscoding_)
+    {
+      LOG(WARNING) << "The \"" << ORTHANC_CONFIG_INGEST_TRANSCODING_THREADS << "\" option is ignored, "
+                   << "as \"" << ORTHANC_CONFIG_INGEST_TRANSCODING << "\" is not set";
+      return;
     }
+
+    ingestTranscodingPipeline_.reset(new IngestTranscodingPipeline(*this));
+    ingestTranscodingPipeline_->Start(countThreads);
   }
 
   
@@ -1141,7 +3162,13 @@ namespace Orthanc
     LOG(INFO) << "Changing compression type for attachment "
               << EnumerationToString(attachmentType) 
               << " of resource " << resourceId << " to " 
-              << compression; 
+              << EnumerationToString(compression);
+
+    if (!IsCompressionTypeSupported(compression))
+    {
+      throw OrthancException(ErrorCode_NotImplemented, "This version of Orthanc was built without support for the \"" +
+                             std::string(EnumerationToString(compression)) + "\" compression");
+    }
 
     FileInfo attachment;
     int64_t revision;
@@ -1273,11 +3300,49 @@ namespace Orthanc
   }
 
 
+  static void DicomDatasetToJson(Json::Value& result,
+                                 const ParsedDicomFile& parsed,
+                                 const std::set<DicomTag>& ignoreTagLength,
+                                 const std::set<DicomTag>* whitelist)
+  {
+    if (whitelist == NULL)
+    {
+      OrthancConfiguration::DefaultDicomDatasetToJson(result, parsed, ignoreTagLength);
+    }
+    else
+    {
+      OrthancConfiguration::DefaultDicomDatasetToJson(result, parsed, ignoreTagLength, *whitelist);
+    }
+  }
+
+
   void ServerContext::ReadDicomAsJson(Json::Value& result,
                                       const std::string& instancePublicId,
                                       const std::map<MetadataType, std::string>& instanceMetadata,
                                       const std::map<FileContentType, FileInfo>& instanceAttachments,
                                       const std::set<DicomTag>& ignoreTagLength)
+  {
+    ReadDicomAsJsonInternal(result, instancePublicId, instanceMetadata, instanceAttachments, ignoreTagLength, NULL);
+  }
+
+
+  void ServerContext::ReadDicomTagsAsJson(Json::Value& result,
+                                          const std::string& instancePublicId,
+                                          const std::map<MetadataType, std::string>& instanceMetadata,
+                                          const std::map<FileContentType, FileInfo>& instanceAttachments,
+                                          const std::set<DicomTag>& tags)
+  {
+    ReadDicomAsJsonInternal(result, instancePublicId, instanceMetadata, instanceAttachments,
+                            tags /* ignoreTagLength */, &tags /* whitelist */);
+  }
+
+
+  void ServerContext::ReadDicomAsJsonInternal(Json::Value& result,
+                                              const std::string& instancePublicId,
+                                              const std::map<MetadataType, std::string>& instanceMetadata,
+                                              const std::map<FileContentType, FileInfo>& instanceAttachments,
+                                              const std::set<DicomTag>& ignoreTagLength,
+                                              const std::set<DicomTag>* whitelist)
   {
     /**
      * CASE 1: The DICOM file, truncated at pixel data, is available
@@ -1298,7 +3363,7 @@ namespace Orthanc
       }
 
       ParsedDicomFile parsed(dicom);
-      OrthancConfiguration::DefaultDicomDatasetToJson(result, parsed, ignoreTagLength);
+      DicomDatasetToJson(result, parsed, ignoreTagLength, whitelist);
       InjectEmptyPixelData(result);
     }
     else
@@ -1343,13 +3408,16 @@ namespace Orthanc
         std::string dicom;
         
         {
-          StorageAccessor accessor(area_, storageCache_, GetMetricsRegistry());
-          accessor.ReadStartRange(dicom, attachment, pixelDataOffset);
+          StorageCache::HeaderAccessor headers(storageCache_);
+          if (!headers.FetchDicomHeader(dicom, attachment.GetUuid()))
+          {
+            ReadDicomHeaderFromStorage(dicom, headers, attachment, pixelDataOffset);
+          }
         }
         
         assert(dicom.size() == pixelDataOffset);
         ParsedDicomFile parsed(dicom);
-        OrthancConfiguration::DefaultDicomDatasetToJson(result, parsed, ignoreTagLength);
+        DicomDatasetToJson(result, parsed, ignoreTagLength, whitelist);
         InjectEmptyPixelData(result);
       }
       else if (ignoreTagLength.empty() &&
@@ -1388,7 +3456,7 @@ namespace Orthanc
         ReadDicom(dicom, instancePublicId);
 
         ParsedDicomFile parsed(dicom);
-        OrthancConfiguration::DefaultDicomDatasetToJson(result, parsed, ignoreTagLength);
+        DicomDatasetToJson(result, parsed, ignoreTagLength, whitelist);
 
         if (!hasPixelDataOffset)
         {
@@ -1482,12 +3550,46 @@ namespace Orthanc
     ReadDicomInternal(dicom, attachmentId, instancePublicId, largeDicomLocker, largeDicomThreshold);
   }
 
+  void ServerContext::ReadDicomHeaderFromStorage(std::string& header,
+                                                 StorageCache::HeaderAccessor& headers,
+                                                 const FileInfo& attachment,
+                                                 uint64_t pixelDataOffset)
+  {
+    {
+      StorageAccessor accessor(area_, storageCache_, GetMetricsRegistry());
+
+      // The header is kept in its dedicated cache, don't store a
+      // second copy as a start range in the cache of the full files
+      accessor.SetCacheAdmission(false);
+      accessor.ReadStartRange(header, attachment, pixelDataOffset);
+    }
+
+    headers.AddDicomHeader(attachment.GetUuid(), header);
+  }
+
+
   void ServerContext::ReadDicomForHeader(std::string& dicom,
                                          const std::string& instancePublicId)
   {
     if (!ReadDicomUntilPixelData(dicom, instancePublicId))
     {
-      ReadDicom(dicom, instancePublicId);
+      std::string attachmentId;
+      ReadDicom(dicom, attachmentId, instancePublicId);
+
+      /**
+       * The header could not be read using a range request (either
+       * because the storage area does not support efficient range
+       * reads, or because the attachment is compressed, or because
+       * the pixel data offset is unknown). Keep the header in the
+       * cache, so that the next requests don't read the full file.
+       **/
+      uint64_t pixelDataOffset;
+      ValueRepresentation pixelDataVR;
+      if (DicomStreamReader::LookupPixelDataOffset(pixelDataOffset, pixelDataVR, dicom))
+      {
+        StorageCache::HeaderAccessor headers(storageCache_);
+        headers.AddDicomHeader(attachmentId, dicom.substr(0, static_cast<size_t>(pixelDataOffset)));
+      }
     }
   }
 
@@ -1506,17 +3608,23 @@ namespace Orthanc
       return true;
     }
 
-    if (!area_.HasEfficientReadRange())
-    {
-      return false;
-    }
-    
     if (!index_.LookupAttachment(attachment, revision, ResourceType_Instance, instancePublicId, FileContentType_Dicom))
     {
       throw OrthancException(ErrorCode_InternalError,
                              "Unable to read the DICOM file of instance " + instancePublicId);
     }
 
+    StorageCache::HeaderAccessor headers(storageCache_);
+    if (headers.FetchDicomHeader(dicom, attachment.GetUuid()))
+    {
+      return true;
+    }
+
+    if (!area_.HasEfficientReadRange())
+    {
+      return false;
+    }
+
     std::string s;
 
     if (attachment.GetCompressionType() == CompressionType_None &&
@@ -1528,58 +3636,319 @@ namespace Orthanc
 
       if (SerializationToolbox::ParseUnsignedInteger64(pixelDataOffset, s))
       {
-        StorageAccessor accessor(area_, storageCache_, GetMetricsRegistry());
+        ReadDicomHeaderFromStorage(dicom, headers, attachment, pixelDataOffset);
+        assert(dicom.size() == pixelDataOffset);
+        
+        return true;   // Success
+      }
+      else
+      {
+        LOG(ERROR) << "Metadata \"PixelDataOffset\" is corrupted for instance: " << instancePublicId;
+      }
+    }
+
+    return false;
+  }
+  
+
+  void ServerContext::ReadAttachment(std::string& result,
+                                     const FileInfo& attachment,
+                                     bool uncompressIfNeeded,
+                                     bool skipCache)
+  {
+    std::unique_ptr<StorageAccessor> accessor;
+      
+    if (skipCache)
+    {
+      accessor.reset(new StorageAccessor(area_, GetMetricsRegistry()));
+    }
+    else
+    {
+      accessor.reset(new StorageAccessor(area_, storageCache_, GetMetricsRegistry()));
+    }
+
+    if (uncompressIfNeeded)
+    {
+      accessor->Read(result, attachment);
+    }
+    else
+    {
+      // Do not uncompress the content of the storage area, return the
+      // raw data
+      accessor->ReadRaw(result, attachment);
+    }
+  }
+
+  void ServerContext::ReadAttachmentRange(std::string &result,
+                                          const FileInfo &attachment,
+                                          const StorageRange &range,
+                                          bool uncompressIfNeeded)
+  {
+    StorageAccessor accessor(area_, storageCache_, GetMetricsRegistry());
+    accessor.ReadRange(result, attachment, range, uncompressIfNeeded);
+  }
+
+  void ServerContext::ReadAttachmentWithoutCacheAdmission(std::string& result,
+                                                          const FileInfo& attachment)
+  {
+    StorageAccessor accessor(area_, storageCache_, GetMetricsRegistry());
+    accessor.SetCacheAdmission(false);
+    accessor.Read(result, attachment);
+  }
+
+
+  bool ServerContext::PrefetchAttachment(const FileInfo& attachment)
+  {
+    StorageAccessor accessor(area_, storageCache_, GetMetricsRegistry());
+    return accessor.Prefetch(attachment);
+  }
+
+
+  void ServerContext::StartSeriesPrefetcher(unsigned int countThreads,
+                                            bool prefetchOnRead)
+  {
+    if (seriesPrefetcher_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    seriesPrefetcher_.reset(new SeriesPrefetcher(*this));
+    seriesPrefetcher_->SetPrefetchOnRead(prefetchOnRead);
+    seriesPrefetcher_->Start(countThreads);
+  }
+
+
+  void ServerContext::StartSeriesThumbnailsGenerator(unsigned int countThreads,
+                                                     unsigned int size)
+  {
+    if (seriesThumbnailsGenerator_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    seriesThumbnailsGenerator_.reset(new SeriesThumbnailsGenerator(*this, size));
+    seriesThumbnailsGenerator_->Start(countThreads);
+  }
+
+
+  void ServerContext::StartFindLoaders(unsigned int countThreads,
+                                      unsigned int countPerRequest)
+  {
+    if (findLoaders_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (countThreads == 0 ||
+        countPerRequest == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    findLoaders_.reset(new ThreadPool);
+    findLoaders_->SetLoggingThreadName("FIND-LOADER");
+    findLoaders_->SetCountThreads(countThreads);
+    findLoaders_->Start();
+
+    findLoadersPerRequest_ = countPerRequest;
+  }
+
+
+  boost::shared_ptr<IExecutorService> ServerContext::GetFindLoaders() const
+  {
+    return findLoaders_;
+  }
+
+
+  void ServerContext::StartZipUploadWorkers(unsigned int countThreads)
+  {
+    if (zipUploadWorkers_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (countThreads == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    zipUploadWorkers_.reset(new ThreadPool);
+    zipUploadWorkers_->SetLoggingThreadName("ZIP-UPLOAD");
+    zipUploadWorkers_->SetCountThreads(countThreads);
+    zipUploadWorkers_->Start();
+
+    // Keep the workers busy while the next files are decompressed
+    zipUploadWindow_ = 2 * countThreads;
+  }
+
+
+  boost::shared_ptr<IExecutorService> ServerContext::GetZipUploadWorkers() const
+  {
+    return zipUploadWorkers_;
+  }
+
+
+  void ServerContext::StartArchiveTranscodingWorkers(unsigned int countThreads)
+  {
+    if (archiveTranscodingWorkers_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (countThreads == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    archiveTranscodingWorkers_.reset(new ThreadPool);
+    archiveTranscodingWorkers_->SetLoggingThreadName("ARCH-CODEC");
+    archiveTranscodingWorkers_->SetCountThreads(countThreads);
+    archiveTranscodingWorkers_->Start();
+  }
+
+
+  boost::shared_ptr<IExecutorService> ServerContext::GetArchiveTranscodingWorkers() const
+  {
+    return archiveTranscodingWorkers_;
+  }
+
+
+  void ServerContext::SetArchiveTranscodingBatchSize(unsigned int size)
+  {
+    if (size == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    archiveTranscodingBatchSize_ = size;
+  }
+
+
+  void ServerContext::StartImageProcessingWorkers(unsigned int countThreads)
+  {
+    if (imageProcessingWorkers_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (countThreads == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    imageProcessingWorkers_.reset(new ThreadPool);
+    imageProcessingWorkers_->SetLoggingThreadName("IMAGES");
+    imageProcessingWorkers_->SetCountThreads(countThreads);
+    imageProcessingWorkers_->Start();
+
+    ImageProcessing::SetParallelExecutor(imageProcessingWorkers_, countThreads);
+  }
+
+
+  void ServerContext::StartFramesDecodingWorkers(unsigned int countThreads)
+  {
+    if (framesDecodingWorkers_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (countThreads == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    framesDecodingWorkers_.reset(new ThreadPool);
+    framesDecodingWorkers_->SetLoggingThreadName("DECODING");
+    framesDecodingWorkers_->SetCountThreads(countThreads);
+    framesDecodingWorkers_->Start();
+
+    framesDecodingThreads_ = countThreads;
+  }
+
+
+  boost::shared_ptr<IExecutorService> ServerContext::GetFramesDecodingWorkers() const
+  {
+    return framesDecodingWorkers_;
+  }
+
+
+  void ServerContext::StartInstancesLoaderService(unsigned int countThreads,
+                                                  const std::set<unsigned int>& threadsAffinity)
+  {
+    if (instancesLoaderService_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
 
-        accessor.ReadStartRange(dicom, attachment, pixelDataOffset);
-        assert(dicom.size() == pixelDataOffset);
-        
-        return true;   // Success
-      }
-      else
-      {
-        LOG(ERROR) << "Metadata \"PixelDataOffset\" is corrupted for instance: " << instancePublicId;
-      }
+    if (countThreads == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
 
-    return false;
+    instancesLoaderService_.reset(new InstancesLoaderService);
+    instancesLoaderService_->SetThreadsAffinity(threadsAffinity);
+    instancesLoaderService_->Start(countThreads, "POOL");
   }
-  
 
-  void ServerContext::ReadAttachment(std::string& result,
-                                     const FileInfo& attachment,
-                                     bool uncompressIfNeeded,
-                                     bool skipCache)
+
+  boost::shared_ptr<InstancesLoaderService> ServerContext::GetInstancesLoaderService() const
   {
-    std::unique_ptr<StorageAccessor> accessor;
-      
-    if (skipCache)
+    return instancesLoaderService_;
+  }
+
+
+  LookupAnswersCache& ServerContext::GetFindAnswersCache()
+  {
+    if (findAnswersCache_.get() == NULL)
     {
-      accessor.reset(new StorageAccessor(area_, GetMetricsRegistry()));
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "The cache of the answers to the lookups is disabled");
     }
     else
     {
-      accessor.reset(new StorageAccessor(area_, storageCache_, GetMetricsRegistry()));
+      return *findAnswersCache_;
     }
+  }
 
-    if (uncompressIfNeeded)
+
+  RenderedFramesCache& ServerContext::GetRenderedFramesCache()
+  {
+    if (renderedFramesCache_.get() == NULL)
     {
-      accessor->Read(result, attachment);
+      throw OrthancException(ErrorCode_BadSequenceOfCalls, "The cache of the rendered frames is disabled");
     }
     else
     {
-      // Do not uncompress the content of the storage area, return the
-      // raw data
-      accessor->ReadRaw(result, attachment);
+      return *renderedFramesCache_;
     }
   }
 
-  void ServerContext::ReadAttachmentRange(std::string &result,
-                                          const FileInfo &attachment,
-                                          const StorageRange &range,
-                                          bool uncompressIfNeeded)
+
+  void ServerContext::ConfigureJpegWriter(JpegWriter& writer) const
   {
-    StorageAccessor accessor(area_, storageCache_, GetMetricsRegistry());
-    accessor.ReadRange(result, attachment, range, uncompressIfNeeded);
+    writer.SetChromaSubsampling(jpegChromaSubsampling_);
+    writer.SetFastDct(jpegFastDct_);
+    writer.SetOptimizedHuffman(jpegOptimizedHuffman_);
+  }
+
+
+  void ServerContext::ConfigurePngWriter(PngWriter& writer) const
+  {
+    writer.SetCompressionLevel(pngCompressionLevel_);
+    writer.SetFilterStrategy(pngFilterStrategy_);
+  }
+
+
+  bool ServerContext::PrefetchSeries(const std::string& seriesId)
+  {
+    if (seriesPrefetcher_.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                             "Prefetching of series is disabled, check option \"SeriesPrefetchThreads\"");
+    }
+    else
+    {
+      return seriesPrefetcher_->Schedule(seriesId);
+    }
   }
 
 
@@ -1588,21 +3957,53 @@ namespace Orthanc
     context_(context),
     instancePublicId_(instancePublicId)
   {
-    accessor_.reset(new ParsedDicomCache::Accessor(context_.dicomCache_, instancePublicId));
-    
-    if (!accessor_->IsValid())
+    if (context_.validateCachedInstances_)
+    {
+      /**
+       * Another Orthanc server sharing the same database might have
+       * replaced the instance since it was cached: Only use the cache
+       * if it was filled from the current DICOM attachment.
+       **/
+      FileInfo attachment;
+      int64_t revision;
+      if (context_.index_.LookupAttachment(attachment, revision, ResourceType_Instance, instancePublicId, FileContentType_Dicom))
+      {
+        accessor_.reset(new ParsedDicomCache::Accessor(context_.dicomCache_, instancePublicId, attachment.GetUuid()));
+      }
+      else
+      {
+        context_.dicomCache_.Invalidate(instancePublicId);
+      }
+    }
+    else
+    {
+      accessor_.reset(new ParsedDicomCache::Accessor(context_.dicomCache_, instancePublicId));
+    }
+
+    if (accessor_.get() == NULL ||
+        !accessor_->IsValid())
     {
       accessor_.reset(NULL);
 
       // Throttle to avoid loading several large DICOM files simultaneously (since the ParsedDicomCache is 128MB, loading multiple 50MB files would throw them out directly after loading)
       largeDicomLocker_.reset(new Semaphore::Locker(context.largeDicomThrottler_));
+
+      ElapsedTimer timer;
       
       // Release the throttle if loading "small" DICOM files (under
       // 50MB, which is an arbitrary value)
-      context_.ReadDicomInternal(buffer_, instancePublicId_, largeDicomLocker_, static_cast<size_t>(50) * 1024 * 1024);
+      context_.ReadDicomInternal(buffer_, revision_, instancePublicId_, largeDicomLocker_, static_cast<size_t>(50) * 1024 * 1024);
       
       dicom_.reset(new ParsedDicomFile(buffer_));
       dicomSize_ = buffer_.size();
+
+      context_.dicomCache_.AddLoad(timer.GetElapsedMicroseconds());
+
+      if (context_.seriesPrefetcher_.get() != NULL)
+      {
+        // Read-ahead of the next instances of the series (new in Orthanc 1.12.12)
+        context_.seriesPrefetcher_->SignalInstanceRead(instancePublicId_);
+      }
     }
 
     assert(accessor_.get() != NULL ||
@@ -1616,7 +4017,7 @@ namespace Orthanc
     {
       try
       {
-        context_.dicomCache_.Acquire(instancePublicId_, dicom_.release(), dicomSize_);
+        context_.dicomCache_.Acquire(instancePublicId_, dicom_.release(), dicomSize_, revision_);
       }
       catch (OrthancException&) // NOLINT(bugprone-empty-catch)
       {
@@ -1671,7 +4072,7 @@ namespace Orthanc
     LOG(INFO) << "Adding attachment " << EnumerationToString(attachmentType) << " to resource " << resourceId;
     
     // TODO Should we use "gzip" instead?
-    CompressionType compression = (compressionEnabled_ ? CompressionType_ZlibWithSize : CompressionType_None);
+    CompressionType compression = (compressionEnabled_ ? compressionType_ : CompressionType_None);
 
     StorageAccessor accessor(area_, storageCache_, GetMetricsRegistry());
 
@@ -1703,6 +4104,17 @@ namespace Orthanc
   }
 
 
+  void ServerContext::InvalidateCachedInstance(const std::string& instancePublicId)
+  {
+    dicomCache_.Invalidate(instancePublicId);
+
+    if (renderedFramesCache_.get() != NULL)
+    {
+      renderedFramesCache_->InvalidateInstance(instancePublicId);
+    }
+  }
+
+
   bool ServerContext::DeleteResource(Json::Value& remainingAncestor,
                                      const std::string& uuid,
                                      ResourceType expectedType)
@@ -1710,7 +4122,7 @@ namespace Orthanc
     if (expectedType == ResourceType_Instance)
     {
       // remove the file from the DicomCache
-      dicomCache_.Invalidate(uuid);
+      InvalidateCachedInstance(uuid);
     }
 
     return index_.DeleteResource(remainingAncestor, uuid, expectedType);
@@ -1722,10 +4134,29 @@ namespace Orthanc
     if (change.GetResourceType() == ResourceType_Instance &&
         change.GetChangeType() == ChangeType_Deleted)
     {
-      dicomCache_.Invalidate(change.GetPublicId());
+      InvalidateCachedInstance(change.GetPublicId());
     }
     
-    pendingChanges_.Enqueue(change.Clone());
+    std::unique_ptr<IDynamicObject> pending(new PendingChange(change));
+
+    // The "NewChildInstance" changes are signaled for each instance,
+    // in addition to "NewInstance": They can be dropped first
+    const bool coalescible = (coalesceChangesOnOverflow_ &&
+                              change.GetChangeType() == ChangeType_NewChildInstance);
+
+    if (!pendingChanges_.Enqueue(pending, coalescible ? 0 : static_cast<int32_t>(pendingChangesOverflowTimeout_)))
+    {
+      metricsRegistry_->IncrementIntegerValue("orthanc_changes_discarded_count", 1);
+
+      if (!coalescible)
+      {
+        LOG(WARNING) << "The queue of the pending changes is full, discarding change \""
+                     << EnumerationToString(change.GetChangeType()) << "\" about: " << change.GetPublicId();
+      }
+    }
+
+    // The change is already committed to the database at this point
+    changesFeed_.SignalChange();
   }
 
 
@@ -1958,16 +4389,260 @@ namespace Orthanc
 
 
 
+  bool ServerContext::ReadFramesFromOffsets(std::string& header,
+                                            DicomFrameOffsets& offsets,
+                                            std::vector<std::string>& frames,
+                                            const std::string& publicId,
+                                            unsigned int firstFrame,
+                                            unsigned int countFrames)
+  {
+    FileInfo offsetsAttachment, dicomAttachment;
+    int64_t revision;  // Ignored
+    if (!index_.LookupAttachment(offsetsAttachment, revision, ResourceType_Instance, publicId, FileContentType_DicomFrameOffsets) ||
+        !index_.LookupAttachment(dicomAttachment, revision, ResourceType_Instance, publicId, FileContentType_Dicom) ||
+        dicomAttachment.GetCompressionType() != CompressionType_None)
+    {
+      return false;
+    }
+
+    {
+      std::string serialized;
+      ReadAttachment(serialized, offsetsAttachment, true /* uncompress if needed */);
+      offsets.Unserialize(serialized);
+    }
+
+    if (countFrames == 0 ||
+        firstFrame >= offsets.GetFramesCount() ||
+        countFrames > offsets.GetFramesCount() - firstFrame)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (!ReadDicomUntilPixelData(header, publicId))
+    {
+      return false;
+    }
+
+    // The fragments of consecutive frames are contiguous in the DICOM
+    // file, separated by the headers of the items: Read them all at once
+    const unsigned int lastFrame = firstFrame + countFrames - 1;
+    const size_t countLastFragments = offsets.GetFragmentsCount(lastFrame);
+    const uint64_t start = offsets.GetFragmentOffset(firstFrame, 0);
+    const uint64_t end = (offsets.GetFragmentOffset(lastFrame, countLastFragments - 1) +
+                          offsets.GetFragmentSize(lastFrame, countLastFragments - 1));
+
+    frames.clear();
+    frames.resize(countFrames);
+
+    if (end > start)
+    {
+      StorageRange range;
+      range.SetStartInclusive(start);
+      range.SetEndInclusive(end - 1);
+
+      std::string fragments;
+      ReadAttachmentRange(fragments, dicomAttachment, range, false /* no need to uncompress */);
+
+      if (static_cast<uint64_t>(fragments.size()) != end - start)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile, "Cannot read frame " + boost::lexical_cast<std::string>(firstFrame) +
+                               " of instance " + publicId);
+      }
+
+      if (countFrames == 1 &&
+          countLastFragments == 1)
+      {
+        frames[0].swap(fragments);
+      }
+      else
+      {
+        for (unsigned int i = 0; i < countFrames; i++)
+        {
+          const unsigned int frame = firstFrame + i;
+          frames[i].reserve(static_cast<size_t>(offsets.GetFrameSize(frame)));
+
+          for (size_t j = 0; j < offsets.GetFragmentsCount(frame); j++)
+          {
+            frames[i].append(fragments, static_cast<size_t>(offsets.GetFragmentOffset(frame, j) - start),
+                             offsets.GetFragmentSize(frame, j));
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+  bool ServerContext::DecodeFramesWithPlugins(DecodedFrames& target,
+                                              const ParsedDicomFile& parsedHeader,
+                                              const std::string& header,
+                                              const DicomFrameOffsets& offsets,
+                                              unsigned int firstFrame,
+                                              const std::vector<std::string>& frames)
+  {
+    DicomTransferSyntax transferSyntax;
+
+    if (!offsets.IsEncapsulated() ||
+        !HasPlugins() ||
+        !GetPlugins().HasFramesDecoder() ||
+        !parsedHeader.LookupTransferSyntax(transferSyntax))
+    {
+      return false;
+    }
+
+    std::vector<unsigned int> frameIndexes(frames.size());
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+      frameIndexes[i] = firstFrame + static_cast<unsigned int>(i);
+    }
+
+    return GetPlugins().DecodeFrames(target, header, GetTransferSyntaxUid(transferSyntax), frameIndexes, frames);
+  }
+#endif
+
+
+  ImageAccessor* ServerContext::DecodeDicomFrameFromOffsets(std::unique_ptr<ParsedDicomFile>& header,
+                                                            const std::string& publicId,
+                                                            unsigned int frameIndex)
+  {
+    DicomFrameOffsets offsets;
+    std::string dicom;
+    std::vector<std::string> frames;
+
+    if (!ReadFramesFromOffsets(dicom, offsets, frames, publicId, frameIndex, 1))
+    {
+      return NULL;
+    }
+
+    assert(frames.size() == 1);
+
+    std::unique_ptr<ParsedDicomFile> parsedHeader(new ParsedDicomFile(dicom));
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+    {
+      // Give the plugins a chance to decode the frame without building a DICOM file
+      DecodedFrames decoded;
+      if (DecodeFramesWithPlugins(decoded, *parsedHeader, dicom, offsets, frameIndex, frames))
+      {
+        header.reset(parsedHeader.release());
+        return decoded.Release(0);
+      }
+    }
+#endif
+
+    // Create a single-frame instance from the header and the frame
+    std::string pixelData;
+    offsets.FormatSingleFramePixelData(pixelData, frames[0]);
+    frames.clear();
+
+    dicom.append(pixelData);
+    pixelData.clear();
+
+    std::unique_ptr<ParsedDicomFile> singleFrame(new ParsedDicomFile(dicom));
+    singleFrame->ReplacePlainString(DICOM_TAG_NUMBER_OF_FRAMES, "1");
+    singleFrame->SaveToMemoryBuffer(dicom);
+
+    std::unique_ptr<ImageAccessor> decoded(GetTranscoder().DecodeFrame(*singleFrame, dicom.c_str(), dicom.size(), 0));
+
+    if (decoded.get() != NULL)
+    {
+      header.reset(parsedHeader.release());
+    }
+
+    return decoded.release();
+  }
+
+
+  bool ServerContext::DecodeDicomFrames(DecodedFrames& target,
+                                        const std::string& publicId,
+                                        unsigned int firstFrame,
+                                        unsigned int countFrames)
+  {
+    target.Clear();
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+    if (frameOffsetsThreshold_ > 0 &&
+        HasPlugins() &&
+        GetPlugins().HasFramesDecoder())
+    {
+      try
+      {
+        DicomFrameOffsets offsets;
+        std::string header;
+        std::vector<std::string> frames;
+
+        if (ReadFramesFromOffsets(header, offsets, frames, publicId, firstFrame, countFrames))
+        {
+          ParsedDicomFile parsedHeader(header);
+          return DecodeFramesWithPlugins(target, parsedHeader, header, offsets, firstFrame, frames);
+        }
+      }
+      catch (OrthancException& e)
+      {
+        if (e.GetErrorCode() == ErrorCode_ParameterOutOfRange)
+        {
+          throw;  // Bad frame index
+        }
+        else
+        {
+          LOG(WARNING) << "Cannot decode frames of instance " << publicId
+                       << " using the index of the frames: " << e.What();
+        }
+      }
+    }
+#endif
+
+    return false;
+  }
+
+
   ImageAccessor* ServerContext::DecodeDicomFrame(const std::string& publicId,
                                                  unsigned int frameIndex)
   {
+    std::unique_ptr<ParsedDicomFile> header;
+    return DecodeDicomFrame(header, publicId, frameIndex);
+  }
+
+
+  ImageAccessor* ServerContext::DecodeDicomFrame(std::unique_ptr<ParsedDicomFile>& header,
+                                                 const std::string& publicId,
+                                                 unsigned int frameIndex)
+  {
+    header.reset(NULL);
+
+    if (frameOffsetsThreshold_ > 0)
+    {
+      try
+      {
+        std::unique_ptr<ImageAccessor> decoded(DecodeDicomFrameFromOffsets(header, publicId, frameIndex));
+        if (decoded.get() != NULL)
+        {
+          return decoded.release();
+        }
+      }
+      catch (OrthancException& e)
+      {
+        if (e.GetErrorCode() == ErrorCode_ParameterOutOfRange)
+        {
+          throw;  // Bad frame index
+        }
+        else
+        {
+          LOG(WARNING) << "Cannot decode frame " << frameIndex << " of instance " << publicId
+                       << " using the index of the frames, loading the full file: " << e.What();
+          header.reset(NULL);
+        }
+      }
+    }
+
     ServerContext::DicomCacheLocker locker(*this, publicId);
     std::unique_ptr<ImageAccessor> decoded(GetTranscoder().DecodeFrame(locker.GetDicom(), locker.GetBuffer().c_str(), locker.GetBuffer().size(), frameIndex));
 
     if (decoded.get() == NULL)
     {
-      OrthancConfiguration::ReaderLock configLock;
-      if (configLock.GetConfiguration().IsWarningEnabled(Warnings_003_DecoderFailure))
+      if (OrthancConfiguration::GetSnapshot()->IsWarningEnabled(Warnings_003_DecoderFailure))
       {
         LOG(WARNING) << "W003: Unable to decode frame " << frameIndex << " from instance " << publicId;
       }
@@ -2063,6 +4738,40 @@ namespace Orthanc
 
     if (!cacheAccessor.FetchTranscodedInstance(target, attachmentId, targetSyntax))
     {
+      {
+        boost::mutex::scoped_lock lock(transcodingStatisticsMutex_);
+        transcodingStatistics_.AddMiss();
+      }
+
+      const bool persistent = (maximumTranscodedAttachmentsSize_ > 0);
+      const FileContentType attachmentType = GetTranscodedInstanceContentType(targetSyntax);
+
+      if (persistent)
+      {
+        // The transcoded instance might have been stored as an
+        // attachment by a previous run, or by another Orthanc server
+        // sharing the same database
+        FileInfo attachment;
+        int64_t revision;
+        if (index_.LookupAttachment(attachment, revision, ResourceType_Instance, sourceInstanceId, attachmentType))
+        {
+          try
+          {
+            ReadAttachment(target, attachment, true /* uncompress */, true /* skip cache */);
+            cacheAccessor.AddTranscodedInstance(attachmentId, targetSyntax, target.c_str(), target.size());
+            TouchTranscodedAttachment(sourceInstanceId, attachmentType, attachment.GetCompressedSize());
+            return true;
+          }
+          catch (OrthancException& e)
+          {
+            LOG(WARNING) << "Cannot read the transcoded attachment of instance " << sourceInstanceId
+                         << ", transcoding again: " << e.What();
+          }
+        }
+      }
+
+      ElapsedTimer timer;
+
       IDicomTranscoder::DicomImage sourceDicom;
       sourceDicom.SetExternalBuffer(source);
 
@@ -2072,15 +4781,49 @@ namespace Orthanc
 
       if (GetTranscoder().Transcode(targetDicom, sourceDicom, syntaxes, TranscodingSopInstanceUidMode_AllowNew))
       {
+        {
+          boost::mutex::scoped_lock lock(transcodingStatisticsMutex_);
+          transcodingStatistics_.AddLoad(timer.GetElapsedMicroseconds());
+        }
+
         cacheAccessor.AddTranscodedInstance(attachmentId, targetSyntax, reinterpret_cast<const char*>(targetDicom.GetBufferData()), targetDicom.GetBufferSize());
         target = std::string(reinterpret_cast<const char*>(targetDicom.GetBufferData()), targetDicom.GetBufferSize());
+
+        if (persistent &&
+            !readOnly_)
+        {
+          try
+          {
+            int64_t newRevision;
+            if (AddAttachment(newRevision, sourceInstanceId, ResourceType_Instance, attachmentType,
+                              target.empty() ? NULL : target.c_str(), target.size(), false, -1, ""))
+            {
+              FileInfo attachment;
+              int64_t revision;
+              if (index_.LookupAttachment(attachment, revision, ResourceType_Instance, sourceInstanceId, attachmentType))
+              {
+                TouchTranscodedAttachment(sourceInstanceId, attachmentType, attachment.GetCompressedSize());
+              }
+            }
+          }
+          catch (OrthancException& e)
+          {
+            // The transcoded instance is still answered
+            LOG(WARNING) << "Cannot store the transcoded attachment of instance " << sourceInstanceId << ": " << e.What();
+          }
+        }
+
         return true;
       }
 
       return false;
     }
-
-    return true;
+    else
+    {
+      boost::mutex::scoped_lock lock(transcodingStatisticsMutex_);
+      transcodingStatistics_.AddHit();
+      return true;
+    }
   }
 
 
@@ -23,26 +23,47 @@
 
 #pragma once
 
+#include "DelayedFilesRemover.h"
 #include "IServerListener.h"
+#include "LookupAnswersCache.h"
 #include "LuaScripting.h"
 #include "OrthancHttpHandler.h"
+#include "RenderedFramesCache.h"
 #include "ServerIndex.h"
 #include "ServerJobs/IStorageCommitmentFactory.h"
+#include "ServerJobs/JobOutputsStore.h"
+#include "ChangesFeed.h"
+#include "ServerJobs/JobsEventsHub.h"
+#include "ServerJobs/SharedJobsQueue.h"
 #include "ServerTranscoder.h"
 
+#include "../../OrthancFramework/Sources/Cache/LeastRecentlyUsedIndex.h"
+#include "../../OrthancFramework/Sources/DicomNetworking/DicomStoreConnectionPool.h"
 #include "../../OrthancFramework/Sources/DicomParsing/DicomModification.h"
 #include "../../OrthancFramework/Sources/DicomParsing/ParsedDicomCache.h"
 #include "../../OrthancFramework/Sources/FileStorage/StorageAccessor.h"
 #include "../../OrthancFramework/Sources/FileStorage/StorageCache.h"
+#include "../../OrthancFramework/Sources/Images/JpegWriter.h"
+#include "../../OrthancFramework/Sources/Images/PngWriter.h"
 #include "../../OrthancFramework/Sources/JobsEngine/JobsEngine.h"
+#include "../../OrthancFramework/Sources/MultiThreading/BlockingSharedMessageQueue.h"
+#include "../../OrthancFramework/Sources/MultiThreading/BoundedMessageQueue.h"
 #include "../../OrthancFramework/Sources/MultiThreading/Semaphore.h"
 
 
 namespace Orthanc
 {
+  class DecodedFrames;
   class DicomElement;
+  class DicomFrameOffsets;
   class DicomStoreUserConnection;
   class OrthancPlugins;
+  class IExecutorService;
+  class IngestTranscodingPipeline;
+  class InstancesLoaderService;
+  class SeriesPrefetcher;
+  class SeriesThumbnailsGenerator;
+  class ThreadPool;
   class SharedArchive;
   class StorageCommitmentReports;
   
@@ -57,6 +78,7 @@ namespace Orthanc
     private JobsRegistry::IObserver
   {
     friend class ServerIndex;  // To access "RemoveFile()"
+    friend class DelayedFilesRemover;  // To access "RemoveFile()"
     
   public:
     struct StoreResult
@@ -125,6 +147,12 @@ namespace Orthanc
         return context_.filterLua_.FilterIncomingInstance(instance, simplified);
       }
 
+      virtual bool IsSimplifiedTagsOfIncomingInstanceNeeded() ORTHANC_OVERRIDE
+      {
+        return (context_.mainLua_.HasIncomingInstanceCallbacks() ||
+                context_.filterLua_.HasIncomingInstanceCallbacks());
+      }
+
       virtual bool FilterIncomingCStoreInstance(uint16_t& dimseStatus,
                                                 const DicomInstanceToStore& instance,
                                                 const Json::Value& simplified) ORTHANC_OVERRIDE
@@ -168,33 +196,66 @@ namespace Orthanc
     typedef std::list<ServerListener>  ServerListeners;
 
 
+    class PendingChange;
+    class ChangesPartition;
+
     static void ChangeThread(ServerContext* that,
                              unsigned int sleepDelay);
 
+    static void ChangesPartitionThread(ServerContext* that,
+                                       ChangesPartition* partition,
+                                       unsigned int sleepDelay);
+
+    void DispatchChange(const PendingChange& change,
+                        const std::string& partitionLabels);
+
+    std::string GetChangeOrderingKey(const ServerIndexChange& change);
+
     static void JobEventsThread(ServerContext* that,
                                 unsigned int sleepDelay);
 
     static void SaveJobsThread(ServerContext* that,
                                unsigned int sleepDelay);
 
-#if HAVE_MALLOC_TRIM == 1
+    static void StoreConnectionPoolThread(ServerContext* that,
+                                          unsigned int sleepDelay);
+
+    static void CacheInvalidationThread(ServerContext* that,
+                                        unsigned int intervalInSeconds);
+
+    // Drops one instance from the caches of parsed DICOM files and of
+    // rendered frames (new in Orthanc 1.12.12)
+    void InvalidateCachedInstance(const std::string& instancePublicId);
+
     static void MemoryTrimmingThread(ServerContext* that,
-                                     unsigned int intervalInSeconds);
-#endif
+                                     unsigned int intervalInSeconds,
+                                     uint64_t threshold);
 
     void SaveJobsEngine();
 
+    static void LoadJobsThread(ServerContext* that);
+
+    bool LoadJobsFromStore(bool& interrupted);
+
+    // Returns "false" iff Orthanc was stopped during the reloading
+    bool LoadJobs(bool isEngineRunning);
+
+    void SaveModifiedJobs();
+
     virtual void SignalJobSubmitted(const std::string& jobId) ORTHANC_OVERRIDE;
 
     virtual void SignalJobSuccess(const std::string& jobId) ORTHANC_OVERRIDE;
 
     virtual void SignalJobFailure(const std::string& jobId) ORTHANC_OVERRIDE;
 
+    virtual void SignalJobUpdated(const std::string& jobId) ORTHANC_OVERRIDE;
+
     ServerIndex index_;
     IPluginStorageArea& area_;
     StorageCache storageCache_;
 
     bool compressionEnabled_;
+    CompressionType compressionType_;  // New in Orthanc 1.12.12
     bool storeMD5_;
 
     Semaphore largeDicomThrottler_;  // New in Orthanc 1.9.0 (notably for very large DICOM files in WSI)
@@ -203,13 +264,19 @@ namespace Orthanc
     LuaScripting mainLua_;
     LuaScripting filterLua_;
     LuaServerListener  luaListener_;
-    std::unique_ptr<SharedArchive>  mediaArchive_;
+    std::unique_ptr<JobOutputsStore>  jobOutputs_;  // Replaces "mediaArchive_" since Orthanc 1.12.12
+    std::unique_ptr<JobOutputsStore>  archivesCache_;  // New in Orthanc 1.12.12
+
+    // Must be before "jobsEngine_", whose registry signals the
+    // changes of the jobs (new in Orthanc 1.12.12)
+    JobsEventsHub  jobsEventsHub_;
+    ChangesFeed    changesFeed_;    // New in Orthanc 1.12.12
     
     // The "JobsEngine" must be *after* "LuaScripting", as
     // "LuaScripting" embeds "LuaJobManager" that registers as an
     // observer to "SequenceOfOperationsJob", whose lifetime
     // corresponds to that of "JobsEngine". It must also be after
-    // "mediaArchive_", as jobs might access this archive.
+    // "jobOutputs_", as jobs might access this store.
     JobsEngine jobsEngine_;
     
 #if ORTHANC_ENABLE_PLUGINS == 1
@@ -222,12 +289,38 @@ namespace Orthanc
     bool done_;
     bool haveJobsChanged_;
     bool isJobsEngineUnserialized_;
-    SharedMessageQueue  pendingChanges_;
+    bool asynchronousJobsLoading_;        // New in Orthanc 1.12.12
+    std::string jobsStoreId_;             // New in Orthanc 1.12.12, empty if the jobs are saved as a whole
+    bool isLegacyJobsRegistryCleared_;    // New in Orthanc 1.12.12
+    BlockingSharedMessageQueue  pendingChanges_;  // Bounded since Orthanc 1.12.12
+    bool          coalesceChangesOnOverflow_;      // New in Orthanc 1.12.12
+    unsigned int  pendingChangesOverflowTimeout_;  // New in Orthanc 1.12.12
     SharedMessageQueue  pendingJobEvents_;
     boost::thread  changeThread_;
+    std::vector<ChangesPartition*>  changesPartitions_;  // New in Orthanc 1.12.12, empty if a single thread dispatches the changes
+    LeastRecentlyUsedIndex<std::string, std::string>  changesOrderingKeys_;  // Only accessed by "changeThread_"
     boost::thread  jobEventsThread_;
     boost::thread  saveJobsThread_;
+    boost::thread  loadJobsThread_;       // New in Orthanc 1.12.12
     boost::thread  memoryTrimmingThread_;
+    boost::thread  cacheInvalidationThread_;  // New in Orthanc 1.12.12
+    boost::thread  storeConnectionPoolThread_;
+    std::unique_ptr<SeriesPrefetcher>  seriesPrefetcher_;  // New in Orthanc 1.12.12
+    std::unique_ptr<SharedJobsQueue>   sharedJobsQueue_;   // New in Orthanc 1.12.12
+    std::unique_ptr<DelayedFilesRemover>  delayedFilesRemover_;  // New in Orthanc 1.12.12
+    bool                               isDelayedFilesRemoval_;
+    std::unique_ptr<SeriesThumbnailsGenerator>  seriesThumbnailsGenerator_;  // New in Orthanc 1.12.12
+    std::unique_ptr<IngestTranscodingPipeline>  ingestTranscodingPipeline_;  // New in Orthanc 1.12.12
+    boost::shared_ptr<ThreadPool>      findLoaders_;       // New in Orthanc 1.12.12
+    boost::shared_ptr<InstancesLoaderService>  instancesLoaderService_;  // New in Orthanc 1.12.12
+    unsigned int                       findLoadersPerRequest_;
+    boost::shared_ptr<ThreadPool>      zipUploadWorkers_;  // New in Orthanc 1.12.12
+    unsigned int                       zipUploadWindow_;
+    boost::shared_ptr<ThreadPool>      archiveTranscodingWorkers_;  // New in Orthanc 1.12.12
+    unsigned int                       archiveTranscodingBatchSize_;
+    boost::shared_ptr<ThreadPool>      imageProcessingWorkers_;     // New in Orthanc 1.12.12
+    boost::shared_ptr<ThreadPool>      framesDecodingWorkers_;      // New in Orthanc 1.12.12
+    unsigned int                       framesDecodingThreads_;
         
     std::unique_ptr<SharedArchive>  queryRetrieveArchive_;
     std::string defaultLocalAet_;
@@ -237,6 +330,19 @@ namespace Orthanc
     FindStorageAccessMode findStorageAccessMode_;
     unsigned int limitFindInstances_;
     unsigned int limitFindResults_;
+    unsigned int findStreamingPageSize_;  // New in Orthanc 1.12.12
+    std::unique_ptr<LookupAnswersCache>  findAnswersCache_;  // New in Orthanc 1.12.12
+    std::unique_ptr<RenderedFramesCache>  renderedFramesCache_;  // New in Orthanc 1.12.12
+    JpegWriter::ChromaSubsampling  jpegChromaSubsampling_;  // New in Orthanc 1.12.12
+    bool                           jpegFastDct_;
+    bool                           jpegOptimizedHuffman_;
+    unsigned int                   pngCompressionLevel_;    // New in Orthanc 1.12.12
+    PngWriter::FilterStrategy      pngFilterStrategy_;
+    uint64_t                       frameOffsetsThreshold_;  // New in Orthanc 1.12.12
+    uint64_t                       maximumTranscodedAttachmentsSize_;  // New in Orthanc 1.12.12
+    uint64_t                       transcodedAttachmentsSize_;         // New in Orthanc 1.12.12
+    bool                           lightweightIngest_;                 // New in Orthanc 1.12.12
+    bool                           validateCachedInstances_;           // New in Orthanc 1.12.12
 
     std::unique_ptr<MetricsRegistry>  metricsRegistry_;
     bool isHttpServerSecure_;
@@ -245,6 +351,7 @@ namespace Orthanc
     OverwriteInstancesMode overwriteInstances_;
 
     std::unique_ptr<StorageCommitmentReports>  storageCommitmentReports_;
+    DicomStoreConnectionPool                   storeConnectionPool_;  // New in Orthanc 1.12.12
 
     std::unique_ptr<ServerTranscoder> transcoder_;
     bool transcodeDicomProtocol_;
@@ -255,6 +362,33 @@ namespace Orthanc
 
     // New in Orthanc 1.9.0
     DicomTransferSyntax preferredTransferSyntax_;
+
+    // New in Orthanc 1.12.12
+    boost::mutex     transcodingStatisticsMutex_;
+    CacheStatistics  transcodingStatistics_;
+
+    // Short-term and long-term moving averages of the duration of the
+    // ingest of one DICOM instance, in milliseconds, that are used to
+    // pace the background jobs (new in Orthanc 1.12.12)
+    class IngestLatencyRecorder;
+
+    boost::mutex              ingestLatencyMutex_;
+    double                    ingestLatencyShort_;
+    double                    ingestLatencyLong_;
+    boost::posix_time::ptime  lastIngest_;
+
+    // CRC-32 of the DICOM files of the resumable ZIP archives, indexed
+    // by the UUID of their attachment (new in Orthanc 1.12.12)
+    boost::mutex                                   archiveCrc32Mutex_;
+    LeastRecentlyUsedIndex<std::string, uint32_t>  archiveCrc32_;
+
+    // Transcoded instances that are persisted as attachments, with
+    // their size, for the size-bounded retention (new in Orthanc 1.12.12)
+    typedef std::pair<std::string, FileContentType>  TranscodedAttachment;
+
+    boost::mutex                                              transcodedAttachmentsMutex_;
+    LeastRecentlyUsedIndex<TranscodedAttachment, uint64_t>   transcodedAttachments_;
+
     mutable boost::mutex dynamicOptionsMutex_;
     bool isUnknownSopClassAccepted_;
     std::set<DicomTransferSyntax>  acceptedTransferSyntaxes_;
@@ -262,21 +396,36 @@ namespace Orthanc
     bool readOnly_;
     bool patientLevelEnabled_;
     
+    void TouchTranscodedAttachment(const std::string& instanceId,
+                                   FileContentType type,
+                                   uint64_t size);
+
     StoreResult StoreAfterTranscoding(std::string& resultPublicId,
                                       DicomInstanceToStore& dicom,
                                       bool isReconstruct);
 
+    bool IsIngestTranscodingNeeded(const DicomInstanceToStore& dicom) const;
+
     StoreResult StoreAfterTranscoding(std::string& resultPublicId,
                                       DicomInstanceToStore& dicom,
                                       bool isReconstruct,
                                       bool isAdoption,
                                       const FileInfo& adoptedFile);
 
-    // This method must only be called from "ServerIndex"!
+    // This method must only be called from "ServerIndex" and
+    // "DelayedFilesRemover"!
     void RemoveFile(const std::string& fileUuid,
                     FileContentType type,
                     const std::string& customData);
 
+    // New in Orthanc 1.12.12. If "true", the files of the deleted
+    // attachments must be enqueued for "DelayedFilesRemover" in the
+    // transaction that deletes them from the index.
+    bool IsDelayedFilesRemoval() const
+    {
+      return isDelayedFilesRemoval_;
+    }
+
     // This DicomModification object is intended to be used as a
     // "rules engine" when de-identifying logs for C-Find, C-Get, and
     // C-Move queries (new in Orthanc 1.8.2)
@@ -296,6 +445,7 @@ namespace Orthanc
       size_t                                       dicomSize_;
       std::unique_ptr<Semaphore::Locker>           largeDicomLocker_;
       std::string                                  buffer_;
+      std::string                                  revision_;  // UUID of the DICOM attachment that was read
 
     public:
       DicomCacheLocker(ServerContext& context,
@@ -329,6 +479,32 @@ namespace Orthanc
       return storageCache_.SetMaximumSize(size);
     }
 
+    void SetStorageCacheShards(size_t count)
+    {
+      return storageCache_.SetNumberOfShards(count);
+    }
+
+    void SetStorageCacheNumaAware(bool numaAware)
+    {
+      return storageCache_.SetNumaAware(numaAware);
+    }
+
+    void SetStorageCachePolicy(CachePolicy policy)
+    {
+      return storageCache_.SetPolicy(policy);
+    }
+
+    void SetMaximumDicomHeaderCacheSize(size_t size)
+    {
+      return storageCache_.SetMaximumHeadersSize(size);
+    }
+
+    // Takes ownership
+    void SetStorageDiskCache(StorageDiskCache* diskCache)
+    {
+      return storageCache_.SetDiskCache(diskCache);
+    }
+
     void SetPatientLevelEnabled(bool enabled);
 
     bool IsPatientLevelEnabled() const
@@ -344,16 +520,41 @@ namespace Orthanc
     {
       return compressionEnabled_;
     }
+
+    // Compression algorithm of the new attachments, if compression
+    // is enabled (new in Orthanc 1.12.12)
+    void SetCompressionType(CompressionType compression);
+
+    CompressionType GetCompressionType() const
+    {
+      return compressionType_;
+    }
     bool IsReadOnly() const
     {
       return readOnly_;
     }
 
+    // Whether the ingest of the DICOM instances has recently become
+    // slower than usual, in which case the background jobs should
+    // slow down (new in Orthanc 1.12.12)
+    bool IsIngestLatencyRising();
+
     bool IsSaveJobs() const
     {
       return saveJobs_;
     }
 
+    /**
+     * Submits an asynchronous job to the queue that is shared by all
+     * the Orthanc servers using the same database (new in Orthanc
+     * 1.12.12). Returns "false" if this queue is disabled or if the
+     * job cannot be serialized: The job must then be submitted to the
+     * local jobs engine.
+     **/
+    bool SubmitSharedJob(std::string& id /* out */,
+                         const IJob& job,
+                         int priority);
+
     bool AddAttachment(int64_t& newRevision,
                        const std::string& resourceId,
                        ResourceType resourceType,
@@ -397,7 +598,23 @@ namespace Orthanc
     void ReadDicomAsJson(Json::Value& result,
                          const std::string& instancePublicId);  // TODO-FIND: Can this be removed?
 
+    // Only converts the first-level DICOM tags listed in "tags", that
+    // are never truncated: The other elements of the file are skipped
+    // without being converted (new in Orthanc 1.12.12)
+    void ReadDicomTagsAsJson(Json::Value& result,
+                             const std::string& instancePublicId,
+                             const std::map<MetadataType, std::string>& instanceMetadata,
+                             const std::map<FileContentType, FileInfo>& instanceAttachments,
+                             const std::set<DicomTag>& tags);
+
 private:
+    void ReadDicomAsJsonInternal(Json::Value& result,
+                                 const std::string& instancePublicId,
+                                 const std::map<MetadataType, std::string>& instanceMetadata,
+                                 const std::map<FileContentType, FileInfo>& instanceAttachments,
+                                 const std::set<DicomTag>& ignoreTagLength,
+                                 const std::set<DicomTag>* whitelist);
+
     void ReadDicomInternal(std::string& dicom,
                            const std::string& instancePublicId,
                            std::unique_ptr<Semaphore::Locker>& largeDicomLocker,
@@ -409,6 +626,39 @@ private:
                            std::unique_ptr<Semaphore::Locker>& largeDicomLocker,
                            std::size_t largeDicomThreshold);
 
+    // Reads the DICOM header from the storage area, after "headers"
+    // has failed to find it in the cache of the DICOM headers
+    void ReadDicomHeaderFromStorage(std::string& header,
+                                    StorageCache::HeaderAccessor& headers,
+                                    const FileInfo& attachment,
+                                    uint64_t pixelDataOffset);
+
+    // Reads the header and the concatenated fragments of a range of
+    // frames. Returns "false" if the instance has no index of the
+    // offsets of its frames, or if its header cannot be read by a
+    // range request.
+    bool ReadFramesFromOffsets(std::string& header,
+                               DicomFrameOffsets& offsets,
+                               std::vector<std::string>& frames,
+                               const std::string& publicId,
+                               unsigned int firstFrame,
+                               unsigned int countFrames);
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+    bool DecodeFramesWithPlugins(DecodedFrames& target,
+                                 const ParsedDicomFile& parsedHeader,
+                                 const std::string& header,
+                                 const DicomFrameOffsets& offsets,
+                                 unsigned int firstFrame,
+                                 const std::vector<std::string>& frames);
+#endif
+
+    // Returns "NULL" if the instance has no index of the offsets of
+    // its frames, or if its header cannot be read by a range request
+    ImageAccessor* DecodeDicomFrameFromOffsets(std::unique_ptr<ParsedDicomFile>& header,
+                                               const std::string& publicId,
+                                               unsigned int frameIndex);
+
 public:
     void ReadDicom(std::string& dicom,
                    const std::string& instancePublicId);
@@ -434,6 +684,130 @@ public:
                              const StorageRange& range,
                              bool uncompressIfNeeded);
 
+    // For bulk readers (such as archives): The storage cache is used
+    // if the attachment is already there, but the attachment is not
+    // inserted into the cache, which would evict the hot files
+    void ReadAttachmentWithoutCacheAdmission(std::string& result,
+                                             const FileInfo& attachment);
+
+    // Loads the attachment into the storage cache, without returning
+    // it. Returns "false" if the attachment was already cached.
+    bool PrefetchAttachment(const FileInfo& attachment);
+
+    size_t GetStorageCacheMaximumSize()
+    {
+      return storageCache_.GetMaximumSize();
+    }
+
+    // Must be called before the HTTP server is started. If
+    // "prefetchOnRead" is "true", reading a frame of an instance
+    // triggers the read-ahead of the following instances in its
+    // series.
+    void StartSeriesPrefetcher(unsigned int countThreads,
+                               bool prefetchOnRead);
+
+    // Returns "false" if the prefetcher is saturated
+    bool PrefetchSeries(const std::string& seriesId);
+
+    // Must be called before the HTTP and DICOM servers are
+    // started. Once a new instance is stored, the JPEG thumbnail of
+    // its series is rendered in the background with at most "size"
+    // pixels in width and height, and stored as the
+    // "series-thumbnail" attachment of the series.
+    void StartSeriesThumbnailsGenerator(unsigned int countThreads,
+                                        unsigned int size);
+
+    bool HasSeriesThumbnailsGenerator() const
+    {
+      return seriesThumbnailsGenerator_.get() != NULL;
+    }
+
+    // Must be called before the HTTP and DICOM servers are
+    // started. The incoming instances that must be transcoded because
+    // of "IngestTranscoding" are stored with their original transfer
+    // syntax, then transcoded in the background by "countThreads"
+    // threads. Ignored if "IngestTranscoding" is not set.
+    void StartIngestTranscodingPipeline(unsigned int countThreads);
+
+    // Transcodes one stored instance to the "IngestTranscoding"
+    // transfer syntax, and atomically replaces its DICOM file. Only
+    // invoked by the threads of "IngestTranscodingPipeline".
+    void TranscodeStoredInstance(const std::string& instanceId);
+
+    // Must be called before the HTTP server is started. The threads
+    // read the DICOM files to get the requested tags of the lookups
+    // that are not stored in the database, with at most
+    // "countPerRequest" files being read at once by one lookup.
+    void StartFindLoaders(unsigned int countThreads,
+                          unsigned int countPerRequest);
+
+    // Returns NULL if the DICOM files are read by the calling thread
+    boost::shared_ptr<IExecutorService> GetFindLoaders() const;
+
+    unsigned int GetFindLoadersPerRequest() const
+    {
+      return findLoadersPerRequest_;
+    }
+
+    // Must be called before the HTTP server is started. The threads
+    // store the DICOM files of the ZIP archives that are uploaded
+    // through "POST /instances".
+    void StartZipUploadWorkers(unsigned int countThreads);
+
+    // Returns NULL if the DICOM files are stored by the HTTP thread
+    boost::shared_ptr<IExecutorService> GetZipUploadWorkers() const;
+
+    // Maximum number of DICOM files of one ZIP archive that are
+    // pending in the workers, which bounds the memory usage
+    unsigned int GetZipUploadWindow() const
+    {
+      return zipUploadWindow_;
+    }
+
+    // Must be called before the jobs engine is started. The threads
+    // transcode the DICOM files of the ZIP archives, once they are
+    // read by the instances loaders, so that the CPU-bound work is
+    // not bounded by the number of loader threads.
+    void StartArchiveTranscodingWorkers(unsigned int countThreads);
+
+    // Returns NULL if the DICOM files are transcoded by the loader threads
+    boost::shared_ptr<IExecutorService> GetArchiveTranscodingWorkers() const;
+
+    // Maximum number of DICOM files that are submitted at once to the
+    // transcoders by the workers above
+    void SetArchiveTranscodingBatchSize(unsigned int size);
+
+    unsigned int GetArchiveTranscodingBatchSize() const
+    {
+      return archiveTranscodingBatchSize_;
+    }
+
+    // The threads process the large images by bands of rows (resizing,
+    // conversions and convolutions), e.g. in the previews of the images
+    void StartImageProcessingWorkers(unsigned int countThreads);
+
+    // Must be called before the HTTP server is started. The threads
+    // decode the frames of the volumes that are exported through the
+    // "/numpy" routes of the series and of the multi-frame instances.
+    void StartFramesDecodingWorkers(unsigned int countThreads);
+
+    // Returns NULL if the frames are decoded by the HTTP thread
+    boost::shared_ptr<IExecutorService> GetFramesDecodingWorkers() const;
+
+    unsigned int GetFramesDecodingThreads() const
+    {
+      return framesDecodingThreads_;
+    }
+
+    // Must be called before the jobs engine is started. The threads
+    // load the DICOM files on behalf of all the instances loaders of
+    // the jobs and of the C-GET/C-MOVE handlers.
+    void StartInstancesLoaderService(unsigned int countThreads,
+                                     const std::set<unsigned int>& threadsAffinity);
+
+    // Returns NULL if each instances loader has its own threads
+    boost::shared_ptr<InstancesLoaderService> GetInstancesLoaderService() const;
+
     void SetStoreMD5ForAttachments(bool storeMD5);
 
     bool IsStoreMD5ForAttachments() const
@@ -446,6 +820,16 @@ public:
       return jobsEngine_;
     }
 
+    JobsEventsHub& GetJobsEventsHub()
+    {
+      return jobsEventsHub_;
+    }
+
+    ChangesFeed& GetChangesFeed()
+    {
+      return changesFeed_;
+    }
+
     bool DeleteResource(Json::Value& remainingAncestor,
                         const std::string& uuid,
                         ResourceType expectedType);
@@ -457,11 +841,24 @@ public:
       return *queryRetrieveArchive_;
     }
 
-    SharedArchive& GetMediaArchive()
+    JobOutputsStore& GetJobOutputs()
+    {
+      return *jobOutputs_;
+    }
+
+    // Returns "NULL" if the cache of the synchronous archives is
+    // disabled (new in Orthanc 1.12.12)
+    JobOutputsStore* GetArchivesCache()
     {
-      return *mediaArchive_;
+      return archivesCache_.get();
     }
 
+    bool LookupArchiveCrc32(uint32_t& crc32,
+                            const std::string& attachmentUuid);
+
+    void StoreArchiveCrc32(const std::string& attachmentUuid,
+                           uint32_t crc32);
+
     const std::string& GetDefaultLocalApplicationEntityTitle() const
     {
       return defaultLocalAet_;
@@ -489,6 +886,57 @@ public:
       return (level == ResourceType_Instance ? limitFindInstances_ : limitFindResults_);
     }
 
+    // "0" means that the answers to "/tools/find" are not streamed
+    unsigned int GetFindStreamingPageSize() const
+    {
+      return findStreamingPageSize_;
+    }
+
+    bool HasFindAnswersCache() const
+    {
+      return findAnswersCache_.get() != NULL;
+    }
+
+    LookupAnswersCache& GetFindAnswersCache();
+
+    bool HasRenderedFramesCache() const
+    {
+      return renderedFramesCache_.get() != NULL;
+    }
+
+    RenderedFramesCache& GetRenderedFramesCache();
+
+    // Applies the encoder settings of the configuration to the JPEG
+    // images that are answered by the REST API (new in Orthanc 1.12.12)
+    void ConfigureJpegWriter(JpegWriter& writer) const;
+
+    // Same as "ConfigureJpegWriter()", for the PNG images (new in Orthanc 1.12.12)
+    void ConfigurePngWriter(PngWriter& writer) const;
+
+    // Minimum size of the multi-frame instances whose frames are
+    // indexed at ingest time, "0" to disable (new in Orthanc 1.12.12)
+    void SetFrameOffsetsThreshold(uint64_t size)
+    {
+      frameOffsetsThreshold_ = size;
+    }
+
+    uint64_t GetFrameOffsetsThreshold() const
+    {
+      return frameOffsetsThreshold_;
+    }
+
+    // Maximum total size of the transcoded instances that are stored
+    // as attachments, "0" to disable (new in Orthanc 1.12.12)
+    void SetMaximumTranscodedAttachmentsSize(uint64_t size)
+    {
+      maximumTranscodedAttachmentsSize_ = size;
+    }
+
+    uint64_t GetMaximumTranscodedAttachmentsSize() const
+    {
+      return maximumTranscodedAttachmentsSize_;
+    }
+
     bool LookupOrReconstructMetadata(std::string& target,
                                      const std::string& publicId,
                                      ResourceType level,
@@ -582,9 +1030,34 @@ public:
       return *storageCommitmentReports_;
     }
 
+    DicomStoreConnectionPool& GetStoreConnectionPool()
+    {
+      return storeConnectionPool_;
+    }
+
     ImageAccessor* DecodeDicomFrame(const std::string& publicId,
                                     unsigned int frameIndex);
 
+    // Same as above, but if the frame could be read using the index
+    // of the offsets of the frames, "header" is set to the DICOM file
+    // without its pixel data. This gives access to the DICOM tags
+    // without loading the full file (new in Orthanc 1.12.12).
+    ImageAccessor* DecodeDicomFrame(std::unique_ptr<ParsedDicomFile>& header,
+                                    const std::string& publicId,
+                                    unsigned int frameIndex);
+
+    /**
+     * Decodes a range of frames of one instance in one single call to
+     * the frames decoders of the plugins, reading only these frames
+     * thanks to the index of the offsets of the frames. Returns
+     * "false" if not possible, in which case the frames must be
+     * decoded one by one (new in Orthanc 1.12.12).
+     **/
+    bool DecodeDicomFrames(DecodedFrames& target,
+                           const std::string& publicId,
+                           unsigned int firstFrame,
+                           unsigned int countFrames);
+
     ImageAccessor* DecodeDicomFrame(const DicomInstanceToStore& dicom,
                                     unsigned int frameIndex);
 
@@ -637,6 +1110,17 @@ public:
 
     void PublishCacheMetrics();
 
+    void GetTranscodingCacheStatistics(CacheStatistics& target);
+
+    // Describes the caches for "GET /tools/caches" (new in Orthanc 1.12.12)
+    void GetCachesStatistics(Json::Value& target);
+
+    // The value is a number of entries for the "query-retrieve" and
+    // "media" archives, and a size in MB for the other caches. The
+    // new size is not persisted in the configuration.
+    void SetCacheMaximumSize(const std::string& name,
+                             uint64_t value);
+
     void SetTranscoder(ServerTranscoder* transcoder /* takes ownership */);
 
     ServerTranscoder& GetTranscoder() const;
@@ -70,6 +70,17 @@ namespace Orthanc
     dictContentType_.Add(FileContentType_Dicom, "dicom");
     dictContentType_.Add(FileContentType_DicomAsJson, "dicom-as-json");
     dictContentType_.Add(FileContentType_DicomUntilPixelData, "dicom-until-pixel-data");
+    dictContentType_.Add(FileContentType_SeriesThumbnail, "series-thumbnail");
+    dictContentType_.Add(FileContentType_DicomFrameOffsets, "dicom-frame-offsets");
+
+    std::set<DicomTransferSyntax> syntaxes;
+    GetAllDicomTransferSyntaxes(syntaxes);
+
+    for (std::set<DicomTransferSyntax>::const_iterator it = syntaxes.begin(); it != syntaxes.end(); ++it)
+    {
+      dictContentType_.Add(GetTranscodedInstanceContentType(*it),
+                           "transcoded-" + std::string(GetTransferSyntaxUid(*it)));
+    }
   }
 
   void RegisterUserMetadata(int metadata,
@@ -195,8 +206,51 @@ namespace Orthanc
       case FileContentType_DicomAsJson:
         return MIME_JSON_UTF8;
 
+      case FileContentType_SeriesThumbnail:
+        return EnumerationToString(MimeType_Jpeg);
+
       default:
-        return EnumerationToString(MimeType_Binary);
+        if (type >= FileContentType_TranscodedInstanceFirst &&
+            type <= FileContentType_TranscodedInstanceLast)
+        {
+          return EnumerationToString(MimeType_Dicom);
+        }
+        else
+        {
+          return EnumerationToString(MimeType_Binary);
+        }
+    }
+  }
+
+  FileContentType GetTranscodedInstanceContentType(DicomTransferSyntax syntax)
+  {
+    const int type = static_cast<int>(FileContentType_TranscodedInstanceFirst) + static_cast<int>(syntax);
+
+    if (type > static_cast<int>(FileContentType_TranscodedInstanceLast))
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      return static_cast<FileContentType>(type);
+    }
+  }
+
+  bool LookupTranscodedInstanceSyntax(DicomTransferSyntax& syntax,
+                                      FileContentType type)
+  {
+    if (type >= FileContentType_TranscodedInstanceFirst &&
+        type <= FileContentType_TranscodedInstanceLast)
+    {
+      syntax = static_cast<DicomTransferSyntax>(type - FileContentType_TranscodedInstanceFirst);
+
+      std::set<DicomTransferSyntax> syntaxes;
+      GetAllDicomTransferSyntaxes(syntaxes);
+      return syntaxes.find(syntax) != syntaxes.end();
+    }
+    else
+    {
+      return false;
     }
   }
 
@@ -175,6 +175,7 @@ namespace Orthanc
     GlobalProperty_JobsRegistry = 5,
     GlobalProperty_GetTotalSizeIsFast = 6,      // New in Orthanc 1.5.2
     GlobalProperty_SQLiteHasRevisionAndCustomData = 7,     // New in Orthanc 1.12.8
+    GlobalProperty_SQLiteHasResourcesCount = 8,            // New in Orthanc 1.12.12
     GlobalProperty_Modalities = 20,             // New in Orthanc 1.5.0
     GlobalProperty_Peers = 21,                  // New in Orthanc 1.5.0
 
@@ -305,6 +306,11 @@ namespace Orthanc
 
   std::string GetFileContentMime(FileContentType type);
 
+  FileContentType GetTranscodedInstanceContentType(DicomTransferSyntax syntax);
+
+  bool LookupTranscodedInstanceSyntax(DicomTransferSyntax& syntax,
+                                      FileContentType type);
+
   std::string GetBasePath(ResourceType type,
                           const std::string& publicId);
 
@@ -29,6 +29,7 @@
 #endif
 
 #include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/SerializationToolbox.h"
 #include "../../OrthancFramework/Sources/Toolbox.h"
 
 #include "OrthancConfiguration.h"
@@ -36,6 +37,8 @@
 #include "ServerIndexChange.h"
 #include "ServerToolbox.h"
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 
 namespace Orthanc
 {
@@ -79,6 +82,7 @@ namespace Orthanc
     std::string remainingPublicId_;
     std::list<FileToRemove> pendingFilesToRemove_;
     std::list<ServerIndexChange> pendingChanges_;
+    std::list<std::string> deletedResources_;
     uint64_t sizeOfFilesToRemove_;
     uint64_t sizeOfAddedAttachments_;
 
@@ -89,6 +93,7 @@ namespace Orthanc
       remainingType_ = ResourceType_Instance;  // dummy initialization
       pendingFilesToRemove_.clear();
       pendingChanges_.clear();
+      deletedResources_.clear();
       sizeOfAddedAttachments_ = 0;
     }
 
@@ -162,6 +167,12 @@ namespace Orthanc
                                        const std::string& publicId) ORTHANC_OVERRIDE
     {
       SignalChange(ServerIndexChange(ChangeType_Deleted, type, publicId));
+
+      // The cached lookup is invalidated both before and after the
+      // commit, so that a concurrent reader cannot cache the resource
+      // while it is being deleted (new in Orthanc 1.12.12)
+      context_.GetIndex().InvalidateCachedResource(publicId);
+      deletedResources_.push_back(publicId);
     }
 
     virtual void SignalChange(const ServerIndexChange& change) ORTHANC_OVERRIDE
@@ -206,8 +217,34 @@ namespace Orthanc
       return context_.GetIndex().IsUnstableResource(type, id);
     }
 
+    virtual void PrepareCommit(IDatabaseWrapper::ITransaction& transaction) ORTHANC_OVERRIDE
+    {
+      if (context_.IsDelayedFilesRemoval())
+      {
+        // The files are enqueued in the same transaction as the
+        // deletion of their attachments, which guarantees that they
+        // will eventually be removed by "DelayedFilesRemover"
+        for (std::list<FileToRemove>::const_iterator
+               it = pendingFilesToRemove_.begin();
+             it != pendingFilesToRemove_.end(); ++it)
+        {
+          std::string value;
+          DelayedFilesRemover::SerializeFile(value, it->GetUuid(), it->GetContentType(), it->GetCustomData());
+          transaction.EnqueueValue(DelayedFilesRemover::GetQueueId(), value.c_str(), value.size());
+        }
+
+        pendingFilesToRemove_.clear();
+      }
+    }
+
     virtual void Commit() ORTHANC_OVERRIDE
     {
+      for (std::list<std::string>::const_iterator
+             it = deletedResources_.begin(); it != deletedResources_.end(); ++it)
+      {
+        context_.GetIndex().InvalidateCachedResource(*it);
+      }
+
       // We can remove the files once the SQLite transaction has
       // been successfully committed. Some files might have to be
       // deleted because of recycling.
@@ -225,6 +262,119 @@ namespace Orthanc
   };
 
 
+  /**
+   * Cache of the lookups of the resources by their public identifier
+   * (new in Orthanc 1.12.12). Only the existing resources are cached,
+   * as their internal identifier, their type and their parent never
+   * change until they are deleted. The "generation" prevents a lookup
+   * that runs concurrently with a deletion from caching the deleted
+   * resource.
+   **/
+  class ServerIndex::ResourcesCache : public boost::noncopyable
+  {
+  public:
+    struct Entry
+    {
+      int64_t       internalId_;
+      ResourceType  type_;
+      bool          hasParent_;
+      std::string   parent_;
+    };
+
+  private:
+    typedef LeastRecentlyUsedIndex<std::string, Entry>  Index;
+
+    boost::mutex  mutex_;
+    Index         index_;
+    size_t        maxSize_;
+    uint64_t      generation_;
+
+    void MakeRoom(size_t maxSize)
+    {
+      while (index_.GetSize() > maxSize)
+      {
+        index_.RemoveOldest();
+      }
+    }
+
+  public:
+    ResourcesCache() :
+      maxSize_(0),
+      generation_(0)
+    {
+    }
+
+    void SetMaximumSize(size_t maxSize)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      maxSize_ = maxSize;
+      MakeRoom(maxSize);
+    }
+
+    bool IsEnabled()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return maxSize_ != 0;
+    }
+
+    // The generation must be read *before* looking up the database
+    uint64_t GetGeneration()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return generation_;
+    }
+
+    bool Lookup(Entry& entry,
+                const std::string& publicId)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (index_.Contains(publicId, entry))
+      {
+        index_.MakeMostRecent(publicId);
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    void Store(const std::string& publicId,
+               const Entry& entry,
+               uint64_t generation)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (maxSize_ != 0 &&
+          generation == generation_)
+      {
+        if (index_.Contains(publicId))
+        {
+          index_.MakeMostRecent(publicId, entry);
+        }
+        else
+        {
+          MakeRoom(maxSize_ - 1);
+          index_.Add(publicId, entry);
+        }
+      }
+    }
+
+    void Invalidate(const std::string& publicId)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      generation_++;
+
+      if (index_.Contains(publicId))
+      {
+        index_.Invalidate(publicId);
+      }
+    }
+  };
+
+
   class ServerIndex::TransactionContextFactory : public ITransactionContextFactory
   {
   private:
@@ -258,13 +408,13 @@ namespace Orthanc
 
     explicit UnstableResourcePayload(const std::string& publicId) : 
       publicId_(publicId),
-      time_(boost::posix_time::second_clock::local_time())
+      time_(boost::posix_time::microsec_clock::universal_time())
     {
     }
 
-    unsigned int GetAge() const
+    boost::posix_time::ptime GetDeadline(unsigned int stableAge) const
     {
-      return (boost::posix_time::second_clock::local_time() - time_).total_seconds();
+      return time_ + boost::posix_time::seconds(stableAge);
     }
     
     const std::string& GetPublicId() const
@@ -273,6 +423,66 @@ namespace Orthanc
     }
   };
 
+
+
+  // Key-value store that is shared by all the Orthanc servers that
+  // are connected to the same database (new in Orthanc 1.12.12)
+  static const char* const UNSTABLE_RESOURCES_STORE = "orthanc-unstable-resources";
+
+
+  static uint64_t GetSecondsSinceEpoch()
+  {
+    static const boost::posix_time::ptime EPOCH(boost::gregorian::date(1970, 1, 1));
+    return (boost::posix_time::second_clock::universal_time() - EPOCH).total_seconds();
+  }
+
+
+  static std::string GetUnstableResourceKey(ResourceType type,
+                                            const std::string& publicId)
+  {
+    return std::string(EnumerationToString(type)) + "|" + publicId;
+  }
+
+
+  class ServerIndex::PendingStore : public boost::noncopyable
+  {
+  public:
+    enum State
+    {
+      State_Queued,
+      State_Running,
+      State_Success,
+      State_Failure
+    };
+
+  private:
+    StoreRequest&  request_;
+    State          state_;
+
+  public:
+    explicit PendingStore(StoreRequest& request) :
+      request_(request),
+      state_(State_Queued)
+    {
+    }
+
+    StoreRequest& GetRequest() const
+    {
+      return request_;
+    }
+
+    State GetState() const
+    {
+      return state_;
+    }
+
+    void SetState(State state)
+    {
+      state_ = state;
+    }
+  };
+
+
   void ServerIndex::FlushThread(ServerIndex* that,
                                 unsigned int threadSleepGranularityMilliseconds)
   {
@@ -309,6 +519,177 @@ namespace Orthanc
   }
 
 
+  void ServerIndex::ChangesPruningThread(ServerIndex* that,
+                                         unsigned int threadSleepGranularityMilliseconds)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("DB-PRUNING");
+
+    // Check for outdated changes every minute, and delete them by
+    // slices, so as not to block the other writers for too long. The
+    // short pause between two slices leaves room for the other
+    // writers if a large backlog of changes is pruned.
+    static const unsigned int SLEEP_SECONDS = 60;
+    static const uint32_t SLICE_SIZE = 1000;
+    static const unsigned int SLICE_PAUSE_MILLISECONDS = 10;
+
+    LOG(INFO) << "Starting the thread that prunes the changes (sleep = " << SLEEP_SECONDS << " seconds)";
+
+    unsigned int count = 0;
+    unsigned int countThreshold = (1000 * SLEEP_SECONDS) / threadSleepGranularityMilliseconds;
+
+    while (!that->done_)
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(threadSleepGranularityMilliseconds));
+      count++;
+
+      if (count >= countThreshold)
+      {
+        count = 0;
+
+        unsigned int retention;
+        uint64_t retentionCount;
+
+        {
+          boost::recursive_mutex::scoped_lock lock(that->monitoringMutex_);
+          retention = that->changesRetention_;
+          retentionCount = that->changesRetentionCount_;
+        }
+
+        if (retention != 0)
+        {
+          // Same format as the dates of "ServerIndexChange" and "ExportedResource"
+          const std::string date = boost::posix_time::to_iso_string(
+            boost::posix_time::second_clock::universal_time() - boost::posix_time::hours(24 * retention));
+
+          try
+          {
+            while (!that->done_ &&
+                   that->DeleteChangesAndExportedResourcesBefore(date, SLICE_SIZE))
+            {
+              boost::this_thread::sleep(boost::posix_time::milliseconds(SLICE_PAUSE_MILLISECONDS));
+            }
+          }
+          catch (OrthancException& e)
+          {
+            LOG(ERROR) << "Cannot prune the changes: " << e.What();
+          }
+        }
+
+        if (retentionCount != 0)
+        {
+          try
+          {
+            while (!that->done_ &&
+                   that->DeleteOldestChanges(retentionCount, SLICE_SIZE))
+            {
+              boost::this_thread::sleep(boost::posix_time::milliseconds(SLICE_PAUSE_MILLISECONDS));
+            }
+          }
+          catch (OrthancException& e)
+          {
+            LOG(ERROR) << "Cannot prune the changes: " << e.What();
+          }
+        }
+      }
+    }
+
+    LOG(INFO) << "Stopping the thread that prunes the changes";
+  }
+
+
+  template <typename T>
+  static T ApplyWaterMark(T limit,
+                          unsigned int percent)
+  {
+    if (limit == 0)
+    {
+      return 0;  // No limit
+    }
+    else
+    {
+      // Never round down to "0", which would mean "no limit"
+      return std::max(static_cast<T>(1), static_cast<T>(static_cast<uint64_t>(limit) * percent / 100));
+    }
+  }
+
+
+  void ServerIndex::RecyclingThread(ServerIndex* that)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("RECYCLING");
+
+    // The limits are checked every second, which only reads the
+    // global statistics. Once the high-water mark is exceeded, the
+    // patients are deleted by batches in separate transactions, so
+    // as not to block the concurrent stores for too long.
+    static const unsigned int CHECK_MILLISECONDS = 1000;
+    static const unsigned int BATCH_SIZE = 16;
+    static const unsigned int BATCH_PAUSE_MILLISECONDS = 10;
+
+    LOG(INFO) << "Starting the thread that recycles the patients in the background";
+
+    for (;;)
+    {
+      MaxStorageMode mode;
+      uint64_t maximumStorageSize;
+      unsigned int maximumPatients;
+      unsigned int highWaterMark;
+      unsigned int lowWaterMark;
+
+      {
+        boost::recursive_mutex::scoped_lock lock(that->monitoringMutex_);
+
+        if (!that->done_)
+        {
+          that->recyclingCondition_.timed_wait(
+            lock, boost::get_system_time() + boost::posix_time::milliseconds(CHECK_MILLISECONDS));
+        }
+
+        if (that->done_)
+        {
+          break;
+        }
+
+        mode = that->maximumStorageMode_;
+        maximumStorageSize = that->maximumStorageSize_;
+        maximumPatients = that->maximumPatients_;
+        highWaterMark = that->recyclingHighWaterMark_;
+        lowWaterMark = that->recyclingLowWaterMark_;
+      }
+
+      if (highWaterMark == 0 ||
+          mode != MaxStorageMode_Recycle ||
+          (maximumStorageSize == 0 && maximumPatients == 0))
+      {
+        continue;
+      }
+
+      try
+      {
+        if (that->IsAboveRecyclingLimits(ApplyWaterMark(maximumStorageSize, highWaterMark),
+                                         ApplyWaterMark(maximumPatients, highWaterMark)))
+        {
+          LOG(INFO) << "The storage is above the high-water mark of recycling, recycling patients in the background";
+
+          const uint64_t lowStorageSize = ApplyWaterMark(maximumStorageSize, lowWaterMark);
+          const unsigned int lowPatients = ApplyWaterMark(maximumPatients, lowWaterMark);
+
+          while (!that->done_ &&
+                 that->RecycleBatch(lowStorageSize, lowPatients, BATCH_SIZE))
+          {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(BATCH_PAUSE_MILLISECONDS));
+          }
+        }
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Cannot recycle the patients in the background: " << e.What();
+      }
+    }
+
+    LOG(INFO) << "Stopping the thread that recycles the patients in the background";
+  }
+
+
   bool ServerIndex::IsUnstableResource(ResourceType type,
                                        int64_t id)
   {
@@ -323,13 +704,33 @@ namespace Orthanc
                            bool readOnly) :
     StatelessDatabaseOperations(db, readOnly),
     done_(false),
+    stableAge_(60),
+    persistUnstableResources_(false),
     maximumStorageMode_(MaxStorageMode_Recycle),
     maximumStorageSize_(0),
     maximumPatients_(0),
-    readOnly_(readOnly)
+    recyclingHighWaterMark_(0),
+    recyclingLowWaterMark_(0),
+    readOnly_(readOnly),
+    changesRetention_(0),
+    changesRetentionCount_(0),
+    hasBatchLeader_(false),
+    batchDelay_(0),
+    batchMaximumSize_(1),
+    resourcesCache_(new ResourcesCache)
   {
     SetTransactionContextFactory(new TransactionContextFactory(context));
 
+    {
+      OrthancConfiguration::ReaderLock lock;
+      stableAge_ = lock.GetConfiguration().GetUnsignedIntegerParameter("StableAge");
+    }
+
+    if (stableAge_ < 1)
+    {
+      stableAge_ = 60;
+    }
+
     // Initial recycling if the parameters have changed since the last
     // execution of Orthanc
     if (!readOnly)
@@ -359,6 +760,17 @@ namespace Orthanc
       unstableResourcesMonitorThread_ = boost::thread
         (UnstableResourcesMonitorThread, this, threadSleepGranularityMilliseconds);
     }
+
+    if (!readOnly &&
+        HasChangesPruningSupport())
+    {
+      changesPruningThread_ = boost::thread(ChangesPruningThread, this, threadSleepGranularityMilliseconds);
+    }
+
+    if (!readOnly)
+    {
+      recyclingThread_ = boost::thread(RecyclingThread, this);
+    }
   }
 
 
@@ -376,7 +788,13 @@ namespace Orthanc
   {
     if (!done_)
     {
-      done_ = true;
+      {
+        boost::recursive_mutex::scoped_lock lock(monitoringMutex_);
+        done_ = true;
+      }
+
+      monitoringCondition_.notify_all();
+      recyclingCondition_.notify_all();
 
       if (flushThread_.joinable())
       {
@@ -387,6 +805,54 @@ namespace Orthanc
       {
         unstableResourcesMonitorThread_.join();
       }
+
+      if (changesPruningThread_.joinable())
+      {
+        changesPruningThread_.join();
+      }
+
+      if (recyclingThread_.joinable())
+      {
+        recyclingThread_.join();
+      }
+    }
+  }
+
+
+  void ServerIndex::SetChangesRetention(unsigned int days)
+  {
+    if (days != 0 &&
+        !HasChangesPruningSupport())
+    {
+      LOG(WARNING) << "The database engine does not support the pruning of the changes, ignoring the retention period";
+      return;
+    }
+
+    boost::recursive_mutex::scoped_lock lock(monitoringMutex_);
+    changesRetention_ = days;
+
+    if (days != 0)
+    {
+      LOG(WARNING) << "The changes and the exported resources will be kept for " << days << " day(s)";
+    }
+  }
+
+
+  void ServerIndex::SetChangesRetentionCount(uint64_t count)
+  {
+    if (count != 0 &&
+        !HasChangesPruningSupport())
+    {
+      LOG(WARNING) << "The database engine does not support the pruning of the changes, ignoring the maximum number of changes";
+      return;
+    }
+
+    boost::recursive_mutex::scoped_lock lock(monitoringMutex_);
+    changesRetentionCount_ = count;
+
+    if (count != 0)
+    {
+      LOG(WARNING) << "At most the " << count << " most recent changes will be kept";
     }
   }
 
@@ -455,29 +921,94 @@ namespace Orthanc
     StandaloneRecycling(maximumStorageMode_, maximumStorageSize_, maximumPatients_);
   }
 
-  void ServerIndex::UnstableResourcesMonitorThread(ServerIndex* that,
-                                                   unsigned int threadSleepGranularityMilliseconds)
+  void ServerIndex::SetBackgroundRecycling(unsigned int highWaterMark,
+                                           unsigned int lowWaterMark)
   {
-    Logging::ScopedCurrentThreadNameSetter setter("UNSTABLE-MON");
-
-    unsigned int stableAge = 0;
-    
+    if (highWaterMark != 0 &&
+        (highWaterMark > 100 ||
+         lowWaterMark == 0 ||
+         lowWaterMark >= highWaterMark))
     {
-      OrthancConfiguration::ReaderLock lock;
-      stableAge = lock.GetConfiguration().GetUnsignedIntegerParameter("StableAge");
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "The water marks of the background recycling must satisfy 0 < low < high <= 100");
     }
 
-    if (stableAge < 1)
+    boost::recursive_mutex::scoped_lock lock(monitoringMutex_);
+    recyclingHighWaterMark_ = highWaterMark;
+    recyclingLowWaterMark_ = lowWaterMark;
+
+    if (highWaterMark != 0)
     {
-      stableAge = 60;
+      LOG(WARNING) << "Background recycling: Starting at " << highWaterMark
+                   << "% of the maximum storage, stopping at " << lowWaterMark << "%";
     }
 
-    LOG(INFO) << "Starting the monitor for stable resources (stable age = " << stableAge << ")";
+    recyclingCondition_.notify_all();
+  }
+
+
+  void ServerIndex::UnstableResourcesMonitorThread(ServerIndex* that,
+                                                   unsigned int threadSleepGranularityMilliseconds)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("UNSTABLE-MON");
+
+    LOG(INFO) << "Starting the monitor for stable resources (stable age = " << that->stableAge_ << ")";
+
+    uint64_t lastClaim = 0;
 
     while (!that->done_)
     {
-      // Check for stable resources each few seconds
-      boost::this_thread::sleep(boost::posix_time::milliseconds(threadSleepGranularityMilliseconds));
+      {
+        /**
+         * As all the resources share the same stable age, the oldest
+         * entry of the LRU index is also the one with the nearest
+         * deadline: Sleep exactly until this deadline, or until the
+         * first resource is marked as unstable if there is none. The
+         * refreshes of the resources only postpone their deadline,
+         * which never requires to wake up this thread (new in Orthanc
+         * 1.12.12, replaces the polling).
+         **/
+        boost::recursive_mutex::scoped_lock lock(that->monitoringMutex_);
+
+        const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+        bool hasWakeUp = false;
+        boost::posix_time::ptime wakeUp;
+
+        if (!that->unstableResources_.IsEmpty())
+        {
+          hasWakeUp = true;
+          wakeUp = that->unstableResources_.GetOldestPayload().GetDeadline(that->stableAge_);
+        }
+
+        if (that->persistUnstableResources_)
+        {
+          boost::posix_time::ptime limit = now + boost::posix_time::seconds(
+            static_cast<long>(lastClaim + that->stableAge_) - static_cast<long>(GetSecondsSinceEpoch()));
+
+          if (!that->unstableResourcesToStore_.empty() ||
+              !that->unstableResourcesToDelete_.empty())
+          {
+            limit = std::min(limit, now + boost::posix_time::milliseconds(threadSleepGranularityMilliseconds));
+          }
+
+          wakeUp = (hasWakeUp ? std::min(wakeUp, limit) : limit);
+          hasWakeUp = true;
+        }
+
+        if (that->done_)
+        {
+          break;
+        }
+        else if (!hasWakeUp)
+        {
+          that->monitoringCondition_.wait(lock);
+        }
+        else if (wakeUp > now)
+        {
+          that->monitoringCondition_.timed_wait(lock, wakeUp);
+        }
+      }
 
       for (;;)
       {
@@ -489,13 +1020,15 @@ namespace Orthanc
           boost::recursive_mutex::scoped_lock lock(that->monitoringMutex_);
 
           if (!that->unstableResources_.IsEmpty() &&
-              that->unstableResources_.GetOldestPayload().GetAge() > static_cast<unsigned int>(stableAge))
+              that->unstableResources_.GetOldestPayload().GetDeadline(that->stableAge_) <=
+              boost::posix_time::microsec_clock::universal_time())
           {
             // This DICOM resource has not received any new instance for
             // some time. It can be considered as stable.
             std::pair<ResourceType, int64_t> stableResource = that->unstableResources_.RemoveOldest(stablePayload);
             stableLevel = stableResource.first;
             stableId = stableResource.second;
+            that->ForgetPersistedUnstableResource(stableLevel, stablePayload.GetPublicId());
             //LOG(TRACE) << "Stable resource: " << EnumerationToString(stablePayload.GetResourceType()) << " " << stableId;
           }
           else
@@ -508,8 +1041,31 @@ namespace Orthanc
         // must not be protected by monitoringMutex_
         that->LogStableChange(stableLevel, stableId, stablePayload.GetPublicId());
       }
+
+      that->FlushPersistedUnstableResources();
+
+      bool persist;
+
+      {
+        boost::recursive_mutex::scoped_lock lock(that->monitoringMutex_);
+        persist = that->persistUnstableResources_;
+      }
+
+      if (persist)
+      {
+        // Look for the unstable resources that were left by a previous
+        // execution or by another server once per stable age
+        const uint64_t now = GetSecondsSinceEpoch();
+        if (now >= lastClaim + that->stableAge_)
+        {
+          lastClaim = now;
+          that->ClaimExpiredUnstableResources();
+        }
+      }
     }
 
+    that->FlushPersistedUnstableResources();
+
     LOG(INFO) << "Closing the monitor thread for stable resources";
   }
   
@@ -552,6 +1108,199 @@ namespace Orthanc
 
 
 
+  void ServerIndex::ForgetPersistedUnstableResource(ResourceType type,
+                                                    const std::string& publicId)
+  {
+    // "monitoringMutex_" must be locked by the caller
+    if (persistUnstableResources_)
+    {
+      const std::string key = GetUnstableResourceKey(type, publicId);
+      if (persistedUnstableResources_.erase(key) != 0)
+      {
+        unstableResourcesToStore_.erase(key);
+        unstableResourcesToDelete_.insert(key);
+      }
+    }
+  }
+
+
+  void ServerIndex::FlushPersistedUnstableResources()
+  {
+    std::map<std::string, std::string> stored;
+    std::set<std::string> deleted;
+
+    {
+      boost::recursive_mutex::scoped_lock lock(monitoringMutex_);
+      stored.swap(unstableResourcesToStore_);
+      deleted.swap(unstableResourcesToDelete_);
+    }
+
+    if (!stored.empty() ||
+        !deleted.empty())
+    {
+      try
+      {
+        UpdateKeysValues(UNSTABLE_RESOURCES_STORE, stored, deleted);
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Cannot persist the unstable resources into the database: " << e.What();
+      }
+    }
+  }
+
+
+  void ServerIndex::ClaimExpiredUnstableResources()
+  {
+    class Operations : public IReadWriteOperations
+    {
+    private:
+      const std::string&  key_;
+      const std::string&  deadline_;
+      ResourceType        level_;
+      const std::string&  publicId_;
+
+    public:
+      Operations(const std::string& key,
+                 const std::string& deadline,
+                 ResourceType level,
+                 const std::string& publicId) :
+        key_(key),
+        deadline_(deadline),
+        level_(level),
+        publicId_(publicId)
+      {
+      }
+
+      virtual void Apply(ReadWriteTransaction& transaction) ORTHANC_OVERRIDE
+      {
+        /**
+         * The entry is only claimed if it has not been refreshed or
+         * claimed by another server in the meantime. As this is done
+         * in the same transaction as the logging of the change, the
+         * stable event is emitted by one single server.
+         **/
+        std::string deadline;
+        if (transaction.GetKeyValue(deadline, UNSTABLE_RESOURCES_STORE, key_) &&
+            deadline == deadline_)
+        {
+          transaction.DeleteKeyValue(UNSTABLE_RESOURCES_STORE, key_);
+
+          int64_t id;
+          ResourceType type;
+          if (transaction.LookupResource(id, type, publicId_) &&
+              type == level_)
+          {
+            switch (level_)
+            {
+              case ResourceType_Patient:
+                transaction.LogChange(id, ChangeType_StablePatient, type, publicId_);
+                break;
+
+              case ResourceType_Study:
+                transaction.LogChange(id, ChangeType_StableStudy, type, publicId_);
+                break;
+
+              case ResourceType_Series:
+                transaction.LogChange(id, ChangeType_StableSeries, type, publicId_);
+                break;
+
+              default:
+                break;
+            }
+          }
+        }
+      }
+    };
+
+    // The grace period of one stable age after the deadline leaves
+    // time to the server that owns the entry to refresh it
+    const uint64_t now = GetSecondsSinceEpoch();
+
+    std::map<std::string, std::string> expired;
+
+    try
+    {
+      KeysValuesIterator it(*this, UNSTABLE_RESOURCES_STORE);
+      while (it.Next())
+      {
+        uint64_t deadline;
+        if (!SerializationToolbox::ParseUnsignedInteger64(deadline, it.GetValue()) ||
+            deadline + stableAge_ < now)
+        {
+          expired[it.GetKey()] = it.GetValue();
+        }
+      }
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "Cannot list the persisted unstable resources: " << e.What();
+      return;
+    }
+
+    for (std::map<std::string, std::string>::const_iterator it = expired.begin(); it != expired.end(); ++it)
+    {
+      {
+        boost::recursive_mutex::scoped_lock lock(monitoringMutex_);
+        if (persistedUnstableResources_.find(it->first) != persistedUnstableResources_.end())
+        {
+          continue;  // This resource is monitored by this server
+        }
+      }
+
+      try
+      {
+        const size_t separator = it->first.find('|');
+        if (separator == std::string::npos)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        const ResourceType level = StringToResourceType(it->first.substr(0, separator).c_str());
+        const std::string publicId = it->first.substr(separator + 1);
+
+        LOG(INFO) << "Claiming the expired unstable resource: " << it->first;
+
+        Operations operations(it->first, it->second, level, publicId);
+        Apply(operations, "ClaimExpiredUnstableResources");
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Cannot claim the unstable resource \"" << it->first << "\": " << e.What();
+      }
+    }
+  }
+
+
+  void ServerIndex::SetPersistUnstableResources(bool persist)
+  {
+    if (persist &&
+        !HasKeyValueStoresSupport())
+    {
+      LOG(WARNING) << "The database engine does not support key-value stores, the unstable resources will not be persisted";
+      return;
+    }
+
+    if (persist &&
+        readOnly_)
+    {
+      LOG(WARNING) << "READ-ONLY SYSTEM: the unstable resources will not be persisted";
+      return;
+    }
+
+    boost::recursive_mutex::scoped_lock lock(monitoringMutex_);
+    persistUnstableResources_ = persist;
+    monitoringCondition_.notify_one();  // Claim the expired entries without waiting
+
+    if (!persist)
+    {
+      persistedUnstableResources_.clear();
+      unstableResourcesToStore_.clear();
+      unstableResourcesToDelete_.clear();
+    }
+  }
+
+
   void ServerIndex::MarkAsUnstable(ResourceType type,
                                    int64_t id,
                                    const std::string& publicId)
@@ -562,9 +1311,37 @@ namespace Orthanc
 
     {
       boost::recursive_mutex::scoped_lock lock(monitoringMutex_);
+
+      if (unstableResources_.IsEmpty())
+      {
+        // The monitor thread is waiting for the first unstable resource
+        monitoringCondition_.notify_one();
+      }
+
       UnstableResourcePayload payload(publicId);
       unstableResources_.AddOrMakeMostRecent(std::make_pair(type, id), payload);
       //LOG(INFO) << "Unstable resource: " << EnumerationToString(type) << " " << id;
+
+      if (persistUnstableResources_)
+      {
+        /**
+         * The deadline in the database is only refreshed every half
+         * stable age, which avoids writing to the database on each
+         * received instance. The writes are grouped by
+         * "FlushPersistedUnstableResources()".
+         **/
+        const std::string key = GetUnstableResourceKey(type, publicId);
+        const uint64_t now = GetSecondsSinceEpoch();
+
+        std::map<std::string, uint64_t>::iterator found = persistedUnstableResources_.find(key);
+        if (found == persistedUnstableResources_.end() ||
+            now >= found->second + stableAge_ / 2)
+        {
+          persistedUnstableResources_[key] = now;
+          unstableResourcesToStore_[key] = boost::lexical_cast<std::string>(now + stableAge_);
+          unstableResourcesToDelete_.erase(key);
+        }
+      }
     }
   }
 
@@ -585,6 +1362,7 @@ namespace Orthanc
           if (IsUnstableResource(type, id))
           {
             unstableResources_.Invalidate(std::pair<ResourceType, int64_t>(type, id));
+            ForgetPersistedUnstableResource(type, resourceId);
             statusHasChanged = true;
           }
         }
@@ -615,6 +1393,226 @@ namespace Orthanc
   }
 
 
+  void ServerIndex::SetIngestBatching(unsigned int delayMilliseconds,
+                                      unsigned int maximumSize)
+  {
+    if (delayMilliseconds > 0 &&
+        maximumSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "The maximum size of the ingest batches must be positive");
+    }
+
+    boost::mutex::scoped_lock lock(batchMutex_);
+    batchDelay_ = delayMilliseconds;
+    batchMaximumSize_ = maximumSize;
+
+    if (delayMilliseconds > 0)
+    {
+      LOG(WARNING) << "Ingest batching: Grouping up to " << maximumSize << " instances received within "
+                   << delayMilliseconds << "ms into one database transaction";
+    }
+  }
+
+
+  bool ServerIndex::StoreInBatch(StoreRequest& request)
+  {
+    PendingStore pending(request);
+
+    boost::mutex::scoped_lock lock(batchMutex_);
+    pendingStores_.push_back(&pending);
+    batchCondition_.notify_all();
+
+    for (;;)
+    {
+      switch (pending.GetState())
+      {
+        case PendingStore::State_Success:
+          return true;
+
+        case PendingStore::State_Failure:
+          return false;
+
+        case PendingStore::State_Running:
+          batchCondition_.wait(lock);
+          break;
+
+        case PendingStore::State_Queued:
+          if (hasBatchLeader_)
+          {
+            batchCondition_.wait(lock);
+          }
+          else
+          {
+            // This thread becomes the leader of the next batch: Wait
+            // for other instances to join it
+            hasBatchLeader_ = true;
+
+            const boost::system_time deadline = (boost::get_system_time() +
+                                                 boost::posix_time::milliseconds(batchDelay_));
+            while (pendingStores_.size() < batchMaximumSize_ &&
+                   batchCondition_.timed_wait(lock, deadline))
+            {
+            }
+
+            std::vector<PendingStore*> batch;
+            std::vector<StoreRequest*> requests;
+
+            while (!pendingStores_.empty() &&
+                   batch.size() < batchMaximumSize_)
+            {
+              PendingStore* item = pendingStores_.front();
+              pendingStores_.pop_front();
+
+              assert(item != NULL);
+              item->SetState(PendingStore::State_Running);
+              batch.push_back(item);
+              requests.push_back(&item->GetRequest());
+            }
+
+            // Another thread can collect the next batch while this one is written
+            hasBatchLeader_ = false;
+            batchCondition_.notify_all();
+
+            lock.unlock();
+
+            bool success = false;
+
+            try
+            {
+              StoreBatch(requests);
+              success = true;
+            }
+            catch (OrthancException& e)
+            {
+              LOG(INFO) << "Cannot store a batch of " << requests.size()
+                        << " instance(s), falling back to one transaction per instance: " << e.What();
+            }
+            catch (...)
+            {
+              LOG(INFO) << "Cannot store a batch of " << requests.size()
+                        << " instance(s), falling back to one transaction per instance";
+            }
+
+            lock.lock();
+
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+              batch[i]->SetState(success ? PendingStore::State_Success : PendingStore::State_Failure);
+            }
+
+            batchCondition_.notify_all();
+          }
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+  }
+
+
+  void ServerIndex::SetResourcesCacheSize(size_t size)
+  {
+    resourcesCache_->SetMaximumSize(size);
+  }
+
+
+  void ServerIndex::InvalidateCachedResource(const std::string& publicId)
+  {
+    resourcesCache_->Invalidate(publicId);
+  }
+
+
+  bool ServerIndex::LookupResource(int64_t& id,
+                                   ResourceType& type,
+                                   const std::string& publicId)
+  {
+    ResourcesCache::Entry entry;
+    if (resourcesCache_->Lookup(entry, publicId))
+    {
+      id = entry.internalId_;
+      type = entry.type_;
+      return true;
+    }
+    else if (resourcesCache_->IsEnabled())
+    {
+      const uint64_t generation = resourcesCache_->GetGeneration();
+
+      if (StatelessDatabaseOperations::LookupResource(id, type, publicId))
+      {
+        entry.internalId_ = id;
+        entry.type_ = type;
+        entry.hasParent_ = false;
+        resourcesCache_->Store(publicId, entry, generation);
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else
+    {
+      return StatelessDatabaseOperations::LookupResource(id, type, publicId);
+    }
+  }
+
+
+  bool ServerIndex::LookupResourceType(ResourceType& type,
+                                       const std::string& publicId)
+  {
+    int64_t internalId;
+    return LookupResource(internalId, type, publicId);
+  }
+
+
+  bool ServerIndex::LookupParent(std::string& target,
+                                 const std::string& publicId)
+  {
+    if (!resourcesCache_->IsEnabled())
+    {
+      return StatelessDatabaseOperations::LookupParent(target, publicId);
+    }
+
+    const uint64_t generation = resourcesCache_->GetGeneration();
+
+    ResourcesCache::Entry entry;
+    if (!resourcesCache_->Lookup(entry, publicId))
+    {
+      if (StatelessDatabaseOperations::LookupResource(entry.internalId_, entry.type_, publicId))
+      {
+        entry.hasParent_ = false;
+      }
+      else
+      {
+        throw OrthancException(ErrorCode_UnknownResource);
+      }
+    }
+
+    if (entry.type_ == ResourceType_Patient)
+    {
+      resourcesCache_->Store(publicId, entry, generation);
+      return false;
+    }
+    else if (entry.hasParent_)
+    {
+      target = entry.parent_;
+      return true;
+    }
+    else if (StatelessDatabaseOperations::LookupParent(entry.parent_, publicId, GetParentResourceType(entry.type_)))
+    {
+      entry.hasParent_ = true;
+      resourcesCache_->Store(publicId, entry, generation);
+      target = entry.parent_;
+      return true;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_UnknownResource);  // Deleted in the meantime
+    }
+  }
+
+
   StoreStatus ServerIndex::Store(std::map<MetadataType, std::string>& instanceMetadata,
                                  const DicomMap& dicomSummary,
                                  const ServerIndex::Attachments& attachments,
@@ -639,6 +1637,29 @@ namespace Orthanc
       maximumStorageMode = maximumStorageMode_;
     }
 
+    bool batching;
+
+    {
+      boost::mutex::scoped_lock lock(batchMutex_);
+      batching = (batchDelay_ > 0);
+    }
+
+    if (batching &&
+        !isReconstruct)
+    {
+      StoreRequest request(instanceMetadata, dicomSummary, attachments, metadata, origin, overwrite, hasTransferSyntax,
+                           transferSyntax, hasPixelDataOffset, pixelDataOffset, pixelDataVR, maximumStorageMode,
+                           maximumStorageSize, maximumPatients);
+
+      if (StoreInBatch(request))
+      {
+        return request.GetStatus();
+      }
+
+      // The batch has been rolled back, store this instance alone
+      // to get its own status or exception
+    }
+
     return StatelessDatabaseOperations::Store(
       instanceMetadata, dicomSummary, attachments, metadata, origin, overwrite, hasTransferSyntax,
       transferSyntax, hasPixelDataOffset, pixelDataOffset, pixelDataVR, maximumStorageMode,
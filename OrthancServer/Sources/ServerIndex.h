@@ -38,18 +38,48 @@ namespace Orthanc
     class TransactionContext;
     class TransactionContextFactory;
     class UnstableResourcePayload;
+    class PendingStore;
+    class ResourcesCache;
 
     bool done_;
     boost::recursive_mutex monitoringMutex_;
+    boost::condition_variable_any monitoringCondition_;  // New in Orthanc 1.12.12
     boost::thread flushThread_;
     boost::thread unstableResourcesMonitorThread_;
+    boost::thread changesPruningThread_;
+    boost::thread recyclingThread_;  // New in Orthanc 1.12.12
+    boost::condition_variable_any recyclingCondition_;
 
     LeastRecentlyUsedIndex<std::pair<ResourceType, int64_t>, UnstableResourcePayload>  unstableResources_;
+    unsigned int  stableAge_;  // In seconds
+
+    // Persistence of the unstable resources in a key-value store of
+    // the database (new in Orthanc 1.12.12). These members are
+    // protected by "monitoringMutex_".
+    bool                                 persistUnstableResources_;
+    std::map<std::string, uint64_t>      persistedUnstableResources_;  // Key => time of the last refresh
+    std::map<std::string, std::string>   unstableResourcesToStore_;    // Key => deadline
+    std::set<std::string>                unstableResourcesToDelete_;
 
     MaxStorageMode  maximumStorageMode_;
     uint64_t        maximumStorageSize_;
     unsigned int    maximumPatients_;
+    unsigned int    recyclingHighWaterMark_;  // In percents of the limits, "0" means no background recycling
+    unsigned int    recyclingLowWaterMark_;
     bool            readOnly_;
+    unsigned int    changesRetention_;  // In days, "0" means no pruning
+    uint64_t        changesRetentionCount_;  // "0" means no pruning (new in Orthanc 1.12.12)
+
+    // Group commit of the instances that are received concurrently
+    // (new in Orthanc 1.12.12)
+    boost::mutex               batchMutex_;
+    boost::condition_variable  batchCondition_;
+    std::list<PendingStore*>   pendingStores_;
+    bool                       hasBatchLeader_;
+    unsigned int               batchDelay_;    // In milliseconds, "0" means no batching
+    unsigned int               batchMaximumSize_;
+
+    std::unique_ptr<ResourcesCache>  resourcesCache_;  // New in Orthanc 1.12.12
 
     static void FlushThread(ServerIndex* that,
                             unsigned int threadSleep);
@@ -57,6 +87,11 @@ namespace Orthanc
     static void UnstableResourcesMonitorThread(ServerIndex* that,
                                                unsigned int threadSleep);
 
+    static void ChangesPruningThread(ServerIndex* that,
+                                     unsigned int threadSleep);
+
+    static void RecyclingThread(ServerIndex* that);
+
     void MarkAsUnstable(ResourceType type,
                         int64_t id,
                         const std::string& publicId);
@@ -65,6 +100,17 @@ namespace Orthanc
                          int64_t id,
                          const std::string& publicId);
 
+    void ForgetPersistedUnstableResource(ResourceType type,
+                                         const std::string& publicId);
+
+    void FlushPersistedUnstableResources();
+
+    void ClaimExpiredUnstableResources();
+
+    bool StoreInBatch(StoreRequest& request);
+
+    void InvalidateCachedResource(const std::string& publicId);
+
   public:
     ServerIndex(ServerContext& context,
                 IDatabaseWrapper& database,
@@ -83,6 +129,51 @@ namespace Orthanc
 
     void SetMaximumStorageMode(MaxStorageMode mode);
 
+    // Recycle the patients in the background as soon as the storage
+    // exceeds "highWaterMark" percents of the limits, until it is
+    // below "lowWaterMark" percents. The stores only have to recycle
+    // by themselves if the limits are reached nonetheless. The value
+    // "highWaterMark == 0" disables the background recycling (new in
+    // Orthanc 1.12.12).
+    void SetBackgroundRecycling(unsigned int highWaterMark,
+                                unsigned int lowWaterMark);
+
+    // "days == 0" disables the pruning of the changes and of the
+    // exported resources
+    void SetChangesRetention(unsigned int days);
+
+    // Only keep the "count" most recent changes, "count == 0"
+    // disables this pruning (new in Orthanc 1.12.12)
+    void SetChangesRetentionCount(uint64_t count);
+
+    // Persist the unstable resources in the database, so that their
+    // stable events survive a restart, and can be emitted by another
+    // node of the cluster (new in Orthanc 1.12.12)
+    void SetPersistUnstableResources(bool persist);
+
+    // "delay == 0" disables the batching of the ingest
+    void SetIngestBatching(unsigned int delayMilliseconds,
+                           unsigned int maximumSize);
+
+    // Maximum number of resources whose lookup by public identifier
+    // is cached, "0" disables the cache (new in Orthanc 1.12.12)
+    void SetResourcesCacheSize(size_t size);
+
+    // The following methods hide the ones of
+    // "StatelessDatabaseOperations", in order to use the cache of the
+    // resources (new in Orthanc 1.12.12)
+    bool LookupResource(int64_t& id,
+                        ResourceType& type,
+                        const std::string& publicId);
+
+    bool LookupResourceType(ResourceType& type,
+                            const std::string& publicId);
+
+    using StatelessDatabaseOperations::LookupParent;
+
+    bool LookupParent(std::string& target,
+                      const std::string& publicId);
+
     StoreStatus Store(std::map<MetadataType, std::string>& instanceMetadata,
                       const DicomMap& dicomSummary,
                       const Attachments& attachments,
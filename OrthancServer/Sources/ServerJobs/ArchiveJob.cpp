@@ -24,8 +24,8 @@
 #include "../PrecompiledHeadersServer.h"
 #include "ArchiveJob.h"
 
-#include "../../../OrthancFramework/Sources/Cache/SharedArchive.h"
 #include "../../../OrthancFramework/Sources/Compression/HierarchicalZipWriter.h"
+#include "../../../OrthancFramework/Sources/Compression/StoredZipLayout.h"
 #include "../../../OrthancFramework/Sources/Constants.h"
 #include "../../../OrthancFramework/Sources/DicomParsing/DicomDirWriter.h"
 #include "../../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
@@ -34,7 +34,6 @@
 #include "../../../OrthancFramework/Sources/MultiThreading/Semaphore.h"
 #include "../../../OrthancFramework/Sources/OrthancException.h"
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
-#include "../OrthancConfiguration.h"
 #include "../ServerContext.h"
 #include "../SimpleInstanceOrdering.h"
 #include "ThreadedInstancesLoader.h"
@@ -57,6 +56,8 @@ static const char* const KEY_ARCHIVE_SIZE = "ArchiveSize";
 static const char* const KEY_TRANSCODE = "Transcode";
 static const char* const KEY_ALLOW_UTF8 = "Utf8";
 static const char* const KEY_LOSSY_QUALITY = "LossyQuality";
+static const char* const KEY_FORMAT = "Format";
+static const char* const OUTPUT_KEY = "archive";
 
 
 namespace Orthanc
@@ -85,6 +86,28 @@ namespace Orthanc
   }
 
 
+  // New in Orthanc 1.12.12
+  static bool IsCompressedTransferSyntax(DicomTransferSyntax syntax)
+  {
+    /**
+     * Deflating the DICOM files whose pixel data is already compressed
+     * (JPEG, JPEG 2000, JPEG-LS, RLE, video...) spends a lot of CPU
+     * time for a negligible gain: Such files are stored as such in
+     * the ZIP archive.
+     **/
+    switch (syntax)
+    {
+      case DicomTransferSyntax_LittleEndianImplicit:
+      case DicomTransferSyntax_LittleEndianExplicit:
+      case DicomTransferSyntax_BigEndianExplicit:
+        return false;
+
+      default:
+        return true;
+    }
+  }
+
+
 
   // This enum defines specific resource types to be used when exporting the archive.
   // It defines if we should use the PatientInfo from the Patient or from the Study.
@@ -282,7 +305,8 @@ namespace Orthanc
 
     virtual void AddInstance(const std::string& instanceId,
                              uint32_t index,
-                             const FileInfo& fileInfo) = 0;
+                             const FileInfo& fileInfo,
+                             const std::string& transferSyntax) = 0;
   };
 
 
@@ -294,13 +318,16 @@ namespace Orthanc
       std::string  id_;
       uint32_t     index_;
       FileInfo     fileInfo_;
+      std::string  transferSyntax_;  // Empty if unknown
 
       Instance(const std::string& id,
                uint32_t index,
-               const FileInfo& fileInfo) :
+               const FileInfo& fileInfo,
+               const std::string& transferSyntax) :
         id_(id),
         index_(index),
-        fileInfo_(fileInfo)
+        fileInfo_(fileInfo),
+        transferSyntax_(transferSyntax)
       {
       }
     };
@@ -321,10 +348,11 @@ namespace Orthanc
 
     void AddInstance(const std::string& id,
                      uint32_t indexInSeries,
-                     const FileInfo& fileInfo)
+                     const FileInfo& fileInfo,
+                     const std::string& transferSyntax)
     {
       assert(level_ == ArchiveResourceType_Instance);
-      instances_.push_back(Instance(id, indexInSeries, fileInfo));
+      instances_.push_back(Instance(id, indexInSeries, fileInfo, transferSyntax));
     }
 
 
@@ -364,7 +392,13 @@ namespace Orthanc
 
         if (index.LookupAttachment(fileInfo, revisionNotUsed, ResourceType_Instance, id, FileContentType_Dicom))
         {
-          AddInstance(id, indexInSeries, fileInfo);
+          std::string transferSyntax;
+          if (!index.LookupMetadata(transferSyntax, id, ResourceType_Instance, MetadataType_Instance_TransferSyntax))
+          {
+            transferSyntax.clear();
+          }
+
+          AddInstance(id, indexInSeries, fileInfo, transferSyntax);
         }
       }
       else if (resource.GetLevel() == GetResourceLevel(level_))
@@ -420,7 +454,8 @@ namespace Orthanc
 
             for (size_t i = 0; i < orderedInstances.GetInstancesCount(); ++i)
             {
-              child->AddInstance(orderedInstances.GetInstanceId(i), orderedInstances.GetInstanceIndexInSeries(i), orderedInstances.GetInstanceFileInfo(i));
+              child->AddInstance(orderedInstances.GetInstanceId(i), orderedInstances.GetInstanceIndexInSeries(i), orderedInstances.GetInstanceFileInfo(i),
+                                 orderedInstances.GetInstanceTransferSyntax(i));
             }
           }
           else
@@ -451,7 +486,7 @@ namespace Orthanc
         for (std::list<Instance>::const_iterator 
                it = instances_.begin(); it != instances_.end(); ++it)
         {
-          visitor.AddInstance(it->id_,  it->index_, it->fileInfo_);
+          visitor.AddInstance(it->id_,  it->index_, it->fileInfo_, it->transferSyntax_);
         }          
       }
       else
@@ -479,10 +514,20 @@ namespace Orthanc
     virtual void Preload(ThreadedInstancesLoader& instancesLoader) const = 0;
 
     // In the "archive" flavor (without DICOMDIR), dicomDir is NULL
-    // In the "media" flavor (with DICOMDIR), dicomDir is not NULL
+    // In the "media" flavor (with DICOMDIR), dicomDir is not NULL.
+    // If "dicomDirIndex" is not NULL, the records of the DICOMDIR are
+    // built from the main DICOM tags of this index, if available,
+    // instead of parsing the DICOM files (new in Orthanc 1.12.12)
     virtual void Execute(HierarchicalZipWriter& writer,
                          ThreadedInstancesLoader& instancesLoader,
-                         DicomDirWriter* dicomDir) const = 0;
+                         DicomDirWriter* dicomDir,
+                         ServerIndex* dicomDirIndex) const = 0;
+
+    // New in Orthanc 1.12.12
+    virtual void AddToLayout(StoredZipLayout& layout,
+                             std::vector<FileInfo>& attachments,
+                             HierarchicalZipWriter::Index& index,
+                             bool allowUtf8) const = 0;
   };
 
 
@@ -506,10 +551,19 @@ namespace Orthanc
 
       virtual void Execute(HierarchicalZipWriter& writer,
                            ThreadedInstancesLoader& instancesLoader,
-                           DicomDirWriter* dicomDir) const ORTHANC_OVERRIDE
+                           DicomDirWriter* dicomDir,
+                           ServerIndex* dicomDirIndex) const ORTHANC_OVERRIDE
       {
         writer.OpenDirectory(filename_);
       }
+
+      virtual void AddToLayout(StoredZipLayout& layout,
+                               std::vector<FileInfo>& attachments,
+                               HierarchicalZipWriter::Index& index,
+                               bool allowUtf8) const ORTHANC_OVERRIDE
+      {
+        index.OpenDirectory(filename_, allowUtf8);
+      }
     };
 
 
@@ -522,10 +576,19 @@ namespace Orthanc
 
       virtual void Execute(HierarchicalZipWriter& writer,
                            ThreadedInstancesLoader& instancesLoader,
-                           DicomDirWriter* dicomDir) const ORTHANC_OVERRIDE
+                           DicomDirWriter* dicomDir,
+                           ServerIndex* dicomDirIndex) const ORTHANC_OVERRIDE
       {
         writer.CloseDirectory();
       }
+
+      virtual void AddToLayout(StoredZipLayout& layout,
+                               std::vector<FileInfo>& attachments,
+                               HierarchicalZipWriter::Index& index,
+                               bool allowUtf8) const ORTHANC_OVERRIDE
+      {
+        index.CloseDirectory();
+      }
     };
 
 
@@ -536,16 +599,93 @@ namespace Orthanc
       std::string   instanceId_;
       FileInfo      fileInfo_;
       std::string   dicomDirFolder_;
+      std::string   transferSyntax_;  // Source transfer syntax, empty if unknown
+
+      bool LookupDicomDirTags(DicomMap& tags,
+                              ServerIndex& index) const
+      {
+        std::string sopClassUid;
+
+        if (transferSyntax_.empty() ||
+            !index.GetAllMainDicomTags(tags, instanceId_) ||
+            !index.LookupMetadata(sopClassUid, instanceId_, ResourceType_Instance, MetadataType_Instance_SopClassUid))
+        {
+          return false;  // Missing information, which happens with old databases
+        }
+        else
+        {
+          tags.SetValue(DICOM_TAG_SOP_CLASS_UID, sopClassUid, false);
+          tags.SetValue(DICOM_TAG_TRANSFER_SYNTAX_UID, transferSyntax_, false);
+          return true;
+        }
+      }
+
+      bool IsCompressionUseful(const ThreadedInstancesLoader& instancesLoader) const
+      {
+        DicomTransferSyntax syntax;
+
+        if (instancesLoader.IsTranscoding())
+        {
+          syntax = instancesLoader.GetTargetTransferSyntax();
+        }
+        else if (!LookupTransferSyntax(syntax, transferSyntax_))
+        {
+          return true;  // Unknown transfer syntax, compress by default
+        }
+
+        return !IsCompressedTransferSyntax(syntax);
+      }
+
+      bool WriteStreamedInstance(HierarchicalZipWriter& writer,
+                                 ThreadedInstancesLoader& instancesLoader) const
+      {
+        // The instance is larger than the memory budget of the
+        // loader: Copy it by chunks from the storage area into the ZIP
+        static const uint64_t CHUNK_SIZE = 16 * 1024 * 1024;
+
+        const uint64_t size = fileInfo_.GetUncompressedSize();
+        uint64_t offset = 0;
+
+        std::string chunk;
+
+        try
+        {
+          LOG(INFO) << "Streaming instance " << instanceId_ << " in zip";
+          instancesLoader.ReadStreamedChunk(chunk, fileInfo_, 0, static_cast<size_t>(std::min(size, CHUNK_SIZE)));
+        }
+        catch (OrthancException& e)
+        {
+          LOG(WARNING) << "An instance was removed after the job was issued: " << instanceId_;
+          return false;
+        }
+
+        writer.OpenStreamedFile(filename_, IsCompressionUseful(instancesLoader), size);
+
+        for (;;)
+        {
+          writer.Write(chunk);
+          offset += chunk.size();
+
+          if (offset >= size)
+          {
+            return true;
+          }
+
+          instancesLoader.ReadStreamedChunk(chunk, fileInfo_, offset, static_cast<size_t>(std::min(size - offset, CHUNK_SIZE)));
+        }
+      }
 
     public:
       WriteInstanceCommand(const std::string& filename,
                            const std::string& instanceId,
                            const FileInfo& fileInfo,
-                           const std::string& dicomDirFolder /* in practice, this is the constant "IMAGES" */) :
+                           const std::string& dicomDirFolder /* in practice, this is the constant "IMAGES" */,
+                           const std::string& transferSyntax) :
         filename_(filename),
         instanceId_(instanceId),
         fileInfo_(fileInfo),
-        dicomDirFolder_(dicomDirFolder)
+        dicomDirFolder_(dicomDirFolder),
+        transferSyntax_(transferSyntax)
       {
         assert(dicomDirFolder.empty() ||
                dicomDirFolder == MEDIA_IMAGES_FOLDER);
@@ -558,31 +698,75 @@ namespace Orthanc
 
       virtual void Execute(HierarchicalZipWriter& writer,
                            ThreadedInstancesLoader& instancesLoader,
-                           DicomDirWriter* dicomDir) const ORTHANC_OVERRIDE
+                           DicomDirWriter* dicomDir,
+                           ServerIndex* dicomDirIndex) const ORTHANC_OVERRIDE
       {
+        const bool streamed = instancesLoader.IsStreamed(fileInfo_);
+
         std::string content;
 
-        try
+        if (streamed)
         {
-          LOG(INFO) << "Adding instance " << instanceId_ << " in zip";
-          instancesLoader.WaitDicomInstance(content, instanceId_);
+          if (!WriteStreamedInstance(writer, instancesLoader))
+          {
+            return;
+          }
         }
-        catch (OrthancException& e)
+        else
         {
-          LOG(WARNING) << "An instance was removed after the job was issued: " << instanceId_;
-          return;
-        }
+          try
+          {
+            LOG(INFO) << "Adding instance " << instanceId_ << " in zip";
+            instancesLoader.WaitDicomInstance(content, instanceId_);
+          }
+          catch (OrthancException& e)
+          {
+            LOG(WARNING) << "An instance was removed after the job was issued: " << instanceId_;
+            return;
+          }
 
-        writer.OpenFile(filename_);
+          writer.OpenFile(filename_, IsCompressionUseful(instancesLoader));
 
-        writer.Write(content);
+          writer.Write(content);
+        }
 
         if (dicomDir != NULL)
         {
-          std::unique_ptr<ParsedDicomFile> parsed(new ParsedDicomFile(content));
-          dicomDir->Add(dicomDirFolder_, filename_, *parsed);
+          DicomMap tags;
+
+          // Transcoding might change the transfer syntax and the SOP
+          // instance UID, which are only known from the file
+          if (dicomDirIndex != NULL &&
+              !instancesLoader.IsTranscoding() &&
+              LookupDicomDirTags(tags, *dicomDirIndex))
+          {
+            dicomDir->Add(dicomDirFolder_, filename_, tags);
+          }
+          else
+          {
+            if (streamed)
+            {
+              // The pixel data is not needed by the DICOMDIR
+              instancesLoader.ReadStreamedHeader(content, instanceId_);
+            }
+
+            std::unique_ptr<ParsedDicomFile> parsed(new ParsedDicomFile(content));
+            dicomDir->Add(dicomDirFolder_, filename_, *parsed);
+          }
         }
       }
+
+      virtual void AddToLayout(StoredZipLayout& layout,
+                               std::vector<FileInfo>& attachments,
+                               HierarchicalZipWriter::Index& index,
+                               bool allowUtf8) const ORTHANC_OVERRIDE
+      {
+        // Same naming as in "HierarchicalZipWriter::OpenFile()" and "ZipWriter::OpenFile()"
+        const std::string path = index.OpenFile(filename_, allowUtf8);
+        layout.AddEntry(Toolbox::NormalizePath(path, allowUtf8, true /* allow slashes */),
+                        fileInfo_.GetUncompressedSize());
+        attachments.push_back(fileInfo_);
+      }
     };
       
     std::deque<IZipCommand*>  commands_;
@@ -634,9 +818,10 @@ namespace Orthanc
     void AddWriteInstance(const std::string& filename,
                           const std::string& instanceId,
                           const FileInfo& fileInfo,
-                          const std::string& dicomDirFolder)
+                          const std::string& dicomDirFolder,
+                          const std::string& transferSyntax)
     {
-      commands_.push_back(new WriteInstanceCommand(filename, instanceId, fileInfo, dicomDirFolder));
+      commands_.push_back(new WriteInstanceCommand(filename, instanceId, fileInfo, dicomDirFolder, transferSyntax));
       instancesCount_ ++;
       uncompressedSize_ += fileInfo.GetUncompressedSize();
     }
@@ -800,12 +985,13 @@ namespace Orthanc
 
     virtual void AddInstance(const std::string& instanceId,
                              uint32_t index,
-                             const FileInfo& fileInfo) ORTHANC_OVERRIDE
+                             const FileInfo& fileInfo,
+                             const std::string& transferSyntax) ORTHANC_OVERRIDE
     {
       char filename[24];
       snprintf(filename, sizeof(filename) - 1, instanceFormat_, index);
 
-      commands_.AddWriteInstance(filename, instanceId, fileInfo, "" /* no DICOMDIR */);
+      commands_.AddWriteInstance(filename, instanceId, fileInfo, "" /* no DICOMDIR */, transferSyntax);
     }
   };
 
@@ -834,13 +1020,14 @@ namespace Orthanc
 
     virtual void AddInstance(const std::string& instanceId,
                              uint32_t indexNotUsed,
-                             const FileInfo& fileInfo) ORTHANC_OVERRIDE
+                             const FileInfo& fileInfo,
+                             const std::string& transferSyntax) ORTHANC_OVERRIDE
     {
       // "DICOM restricts the filenames on DICOM media to 8
       // characters (some systems wrongly use 8.3, but this does not
       // conform to the standard)."
       std::string filename = "IM" + boost::lexical_cast<std::string>(counter_);
-      commands_.AddWriteInstance(filename, instanceId, fileInfo, MEDIA_IMAGES_FOLDER);
+      commands_.AddWriteInstance(filename, instanceId, fileInfo, MEDIA_IMAGES_FOLDER, transferSyntax);
 
       counter_ ++;
     }
@@ -855,19 +1042,28 @@ namespace Orthanc
     std::unique_ptr<HierarchicalZipWriter>  zip_;
     std::unique_ptr<DicomDirWriter>         dicomDir_;
     bool                                    isMedia_;
+    bool                                    dicomDirFromIndex_;
     bool                                    isStream_;
     bool                                    allowUtf8_;
+    unsigned int                            compressionThreads_;
+    bool                                    tarFormat_;
 
   public:
     ZipWriterIterator(ServerContext& context,
                       ArchiveIndex& archive,
                       bool isMedia,
                       bool enableExtendedSopClass,
-                      bool allowUtf8) :
+                      bool dicomDirFromIndex,
+                      bool allowUtf8,
+                      unsigned int compressionThreads,
+                      bool tarFormat) :
       context_(context),
       isMedia_(isMedia),
+      dicomDirFromIndex_(dicomDirFromIndex),
       isStream_(false),
-      allowUtf8_(allowUtf8)
+      allowUtf8_(allowUtf8),
+      compressionThreads_(compressionThreads),
+      tarFormat_(tarFormat)
     {
       if (isMedia)
       {
@@ -893,8 +1089,17 @@ namespace Orthanc
     {
       if (zip_.get() == NULL)
       {
-        zip_.reset(new HierarchicalZipWriter(path));
-        zip_->SetZip64(commands_.IsZip64());
+        if (tarFormat_)
+        {
+          zip_.reset(new HierarchicalZipWriter(new TarWriter(path)));
+        }
+        else
+        {
+          zip_.reset(new HierarchicalZipWriter(path));
+          zip_->SetZip64(commands_.IsZip64());
+          zip_->SetCompressionThreads(compressionThreads_);
+        }
+
         zip_->SetAllowUtf8(allowUtf8_);
         isStream_ = false;
       }
@@ -910,7 +1115,16 @@ namespace Orthanc
 
       if (zip_.get() == NULL)
       {
-        zip_.reset(new HierarchicalZipWriter(protection.release(), commands_.IsZip64()));
+        if (tarFormat_)
+        {
+          zip_.reset(new HierarchicalZipWriter(new TarWriter(protection.release())));
+        }
+        else
+        {
+          zip_.reset(new HierarchicalZipWriter(protection.release(), commands_.IsZip64()));
+          zip_->SetCompressionThreads(compressionThreads_);
+        }
+
         zip_->SetAllowUtf8(allowUtf8_);
         isStream_ = true;
       }
@@ -998,12 +1212,13 @@ namespace Orthanc
         if (isMedia_)
         {
           assert(dicomDir_.get() != NULL);
-          commands_.GetCommand(index).Execute(*zip_, instancesLoader, dicomDir_.get());
+          commands_.GetCommand(index).Execute(*zip_, instancesLoader, dicomDir_.get(),
+                                              dicomDirFromIndex_ ? &context_.GetIndex() : NULL);
         }
         else
         {
           assert(dicomDir_.get() == NULL);
-          commands_.GetCommand(index).Execute(*zip_, instancesLoader, NULL);
+          commands_.GetCommand(index).Execute(*zip_, instancesLoader, NULL, NULL);
         }
       }
     }
@@ -1038,16 +1253,21 @@ namespace Orthanc
     hasLossyQuality_(false),
     lossyQuality_(100),
     loaderThreads_(1),
-    allowUtf8_(false)
+    allowUtf8_(false),
+    compressionThreads_(1),
+    dicomDirFromIndex_(false),
+    localityWindow_(0),
+    loaderMemoryBudget_(0),
+    tarFormat_(false)
   {
   }
 
   
   ArchiveJob::~ArchiveJob()
   {
-    if (!mediaArchiveId_.empty())
+    if (!outputJobId_.empty())
     {
-      context_.GetMediaArchive().Remove(mediaArchiveId_);
+      context_.GetJobOutputs().Remove(outputJobId_, OUTPUT_KEY);
     }
   }
 
@@ -1178,6 +1398,175 @@ namespace Orthanc
   }
 
 
+  void ArchiveJob::SetCompressionThreads(unsigned int threads)
+  {
+    if (writer_.get() != NULL)   // Already started
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      compressionThreads_ = std::max(1u, threads);
+    }
+  }
+
+
+  void ArchiveJob::SetLocalityWindow(unsigned int count)
+  {
+    if (writer_.get() != NULL)   // Already started
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      localityWindow_ = count;
+    }
+  }
+
+
+  void ArchiveJob::SetLoaderMemoryBudget(uint64_t bytes)
+  {
+    if (writer_.get() != NULL)   // Already started
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      loaderMemoryBudget_ = bytes;
+    }
+  }
+
+
+  void ArchiveJob::SetTarFormat(bool tar)
+  {
+    if (writer_.get() != NULL)   // Already started
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      tarFormat_ = tar;
+    }
+  }
+
+
+  void ArchiveJob::SetDicomDirFromIndex(bool fromIndex)
+  {
+    if (writer_.get() != NULL)   // Already started
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      dicomDirFromIndex_ = fromIndex;
+    }
+  }
+
+
+  void ArchiveJob::ComputeStoredLayout(StoredZipLayout& layout,
+                                       std::vector<FileInfo>& attachments)
+  {
+    if (writer_.get() != NULL)   // Already started
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else if (isMedia_ ||
+             transcode_ ||
+             tarFormat_)
+    {
+      throw OrthancException(ErrorCode_NotImplemented,
+                             "The layout of the archive cannot be computed in advance for media, "
+                             "for transcoding, and for TAR archives");
+    }
+
+    ZipCommands commands;
+
+    {
+      ArchiveIndexVisitor visitor(commands, context_);
+      archive_->Expand(context_.GetIndex());
+      archive_->Apply(visitor);
+    }
+
+    layout.SetAllowUtf8(allowUtf8_);
+    attachments.clear();
+    attachments.reserve(commands.GetInstancesCount());
+
+    HierarchicalZipWriter::Index index;
+
+    for (size_t i = 0; i < commands.GetSize(); i++)
+    {
+      commands.GetCommand(i).AddToLayout(layout, attachments, index, allowUtf8_);
+    }
+
+    assert(attachments.size() == layout.GetEntriesCount());
+  }
+
+
+  void ArchiveJob::ComputeCacheKey(std::string& key)
+  {
+    if (writer_.get() != NULL)   // Already started
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    ZipCommands commands;
+    archive_->Expand(context_.GetIndex());
+
+    if (isMedia_)
+    {
+      MediaIndexVisitor visitor(commands);
+      archive_->Apply(visitor);
+    }
+    else
+    {
+      ArchiveIndexVisitor visitor(commands, context_);
+      archive_->Apply(visitor);
+    }
+
+    StoredZipLayout layout;
+    std::vector<FileInfo> attachments;
+    HierarchicalZipWriter::Index index;
+
+    for (size_t i = 0; i < commands.GetSize(); i++)
+    {
+      commands.GetCommand(i).AddToLayout(layout, attachments, index, allowUtf8_);
+    }
+
+    assert(attachments.size() == layout.GetEntriesCount());
+
+    /**
+     * The parameters of the archive, then the path of each file
+     * together with the UUID of its attachment. As the storage area
+     * assigns a new UUID to each new revision of a DICOM file, this
+     * fingerprint changes whenever one of the archived instances is
+     * added, removed or modified, and whenever the names of the
+     * folders change.
+     **/
+    std::string summary = (std::string(isMedia_ ? "media" : "archive") +
+                           (enableExtendedSopClass_ ? "|extended" : "|") +
+                           (isMedia_ && dicomDirFromIndex_ ? "|index" : "|") +
+                           (allowUtf8_ ? "|utf8" : "|") +
+                           (tarFormat_ ? "|tar" : "|") + "|");
+
+    if (transcode_)
+    {
+      summary += GetTransferSyntaxUid(transferSyntax_);
+
+      if (hasLossyQuality_)
+      {
+        summary += "/" + boost::lexical_cast<std::string>(lossyQuality_);
+      }
+    }
+
+    for (size_t i = 0; i < attachments.size(); i++)
+    {
+      summary += "\n" + layout.GetEntryFilename(i) + "\t" + attachments[i].GetUuid();
+    }
+
+    Toolbox::ComputeSHA1(key, summary);
+  }
+
+
   void ArchiveJob::Reset()
   {
     throw OrthancException(ErrorCode_BadSequenceOfCalls,
@@ -1202,13 +1591,15 @@ namespace Orthanc
         }
         else
         {
-          OrthancConfiguration::ReaderLock lock;
-          asynchronousTarget_.reset(lock.GetConfiguration().CreateTemporaryFile());
+          // New in Orthanc 1.12.12: The archive is directly spooled
+          // in the directory of the outputs of the jobs
+          asynchronousTarget_.reset(context_.GetJobOutputs().CreateSpoolFile());
           
           assert(asynchronousTarget_.get() != NULL);
           asynchronousTarget_->Touch();  // Make sure we can write to the temporary file
           
-          writer_.reset(new ZipWriterIterator(context_, *archive_, isMedia_, enableExtendedSopClass_, allowUtf8_));
+          writer_.reset(new ZipWriterIterator(context_, *archive_, isMedia_, enableExtendedSopClass_,
+                                              dicomDirFromIndex_, allowUtf8_, compressionThreads_, tarFormat_));
           writer_->SetOutputFile(asynchronousTarget_->GetPath());
         }
       }
@@ -1216,7 +1607,8 @@ namespace Orthanc
       {
         assert(synchronousTarget_.get() != NULL);
     
-        writer_.reset(new ZipWriterIterator(context_, *archive_, isMedia_, enableExtendedSopClass_, allowUtf8_));
+        writer_.reset(new ZipWriterIterator(context_, *archive_, isMedia_, enableExtendedSopClass_,
+                                              dicomDirFromIndex_, allowUtf8_, compressionThreads_, tarFormat_));
         writer_->AcquireOutputStream(synchronousTarget_.release());
       }
 
@@ -1224,38 +1616,15 @@ namespace Orthanc
       uncompressedSize_ = writer_->GetUncompressedSize();
 
       instancesLoader_.reset(new ThreadedInstancesLoader(context_, loaderThreads_, transcode_, transferSyntax_, lossyQuality_, "ARCH"));
+      instancesLoader_->SetLocalityWindow(localityWindow_);
+      instancesLoader_->SetMemoryBudget(loaderMemoryBudget_);
       writer_->PreloadAllCommands(*instancesLoader_);
     }
   }
 
 
 
-  namespace
-  {
-    class DynamicTemporaryFile : public IDynamicObject
-    {
-    private:
-      std::unique_ptr<TemporaryFile>   file_;
-
-    public:
-      explicit DynamicTemporaryFile(TemporaryFile* f) : file_(f)
-      {
-        if (f == NULL)
-        {
-          throw OrthancException(ErrorCode_NullPointer);
-        }
-      }
-
-      const TemporaryFile& GetFile() const
-      {
-        assert(file_.get() != NULL);
-        return *file_;
-      }
-    };
-  }
-  
-
-  void ArchiveJob::FinalizeTarget()
+  void ArchiveJob::FinalizeTarget(const std::string& jobId)
   {
     if (writer_.get() != NULL)
     {
@@ -1271,9 +1640,10 @@ namespace Orthanc
 
     if (asynchronousTarget_.get() != NULL)
     {
-      // Asynchronous behavior: Move the resulting file into the media archive
-      mediaArchiveId_ = context_.GetMediaArchive().Add(
-        new DynamicTemporaryFile(asynchronousTarget_.release()));
+      // Asynchronous behavior: Move the resulting file into the store
+      // of the outputs of the jobs
+      context_.GetJobOutputs().Add(jobId, OUTPUT_KEY, asynchronousTarget_.release(), GetMimeType(), filename_);
+      outputJobId_ = jobId;
     }
   }
     
@@ -1284,7 +1654,7 @@ namespace Orthanc
 
     if (writer_->GetStepsCount() == 0)
     {
-      FinalizeTarget();
+      FinalizeTarget(jobId);
       return JobStepResult::Success();
     }
     else
@@ -1304,7 +1674,7 @@ namespace Orthanc
 
       if (currentStep_ == writer_->GetStepsCount())
       {
-        FinalizeTarget();
+        FinalizeTarget(jobId);
         return JobStepResult::Success();
       }
       else
@@ -1397,6 +1767,8 @@ namespace Orthanc
     {
       value[KEY_LOSSY_QUALITY] = lossyQuality_;
     }
+
+    value[KEY_FORMAT] = (tarFormat_ ? "tar" : "zip");
   }
 
 
@@ -1405,17 +1777,21 @@ namespace Orthanc
                              std::string& filename,
                              const std::string& key)
   {   
-    if (key == "archive" &&
-        !mediaArchiveId_.empty())
+    if (key == OUTPUT_KEY &&
+        !outputJobId_.empty())
     {
-      SharedArchive::Accessor accessor(context_.GetMediaArchive(), mediaArchiveId_);
+      /**
+       * This reads the whole archive into memory. The REST API
+       * directly streams the file from the "JobOutputsStore" instead
+       * (new in Orthanc 1.12.12).
+       **/
+      JobOutputsStore::Accessor accessor(context_.GetJobOutputs(), outputJobId_, key);
 
       if (accessor.IsValid())
       {
-        const DynamicTemporaryFile& f = dynamic_cast<DynamicTemporaryFile&>(accessor.GetItem());
-        f.GetFile().Read(output);
-        mime = MimeType_Zip;
-        filename = filename_;
+        accessor.GetFile().Read(output);
+        mime = accessor.GetMimeType();
+        filename = accessor.GetFilename();
         return true;
       }
       else
@@ -1431,18 +1807,10 @@ namespace Orthanc
 
   bool ArchiveJob::DeleteOutput(const std::string& key)
   {   
-    if (key == "archive" &&
-        !mediaArchiveId_.empty())
+    if (key == OUTPUT_KEY &&
+        !outputJobId_.empty())
     {
-      bool found;
-
-      {
-        SharedArchive::Accessor accessor(context_.GetMediaArchive(), mediaArchiveId_);
-        found = accessor.IsValid();
-      }
-
-      context_.GetMediaArchive().Remove(mediaArchiveId_);
-      return found;
+      return context_.GetJobOutputs().Remove(outputJobId_, key);
     }
     else
     {
@@ -1452,6 +1820,6 @@ namespace Orthanc
 
   void ArchiveJob::DeleteAllOutputs()
   {
-    DeleteOutput("archive");
+    DeleteOutput(OUTPUT_KEY);
   }
 }
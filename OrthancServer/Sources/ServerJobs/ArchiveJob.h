@@ -25,15 +25,18 @@
 
 #include "../../../OrthancFramework/Sources/Compatibility.h"
 #include "../../../OrthancFramework/Sources/Compression/ZipWriter.h"
+#include "../../../OrthancFramework/Sources/FileStorage/FileInfo.h"
 #include "../../../OrthancFramework/Sources/JobsEngine/IJob.h"
 #include "../../../OrthancFramework/Sources/TemporaryFile.h"
 
 #include <boost/shared_ptr.hpp>
 #include <stdint.h>
+#include <vector>
 
 namespace Orthanc
 {
   class ServerContext;
+  class StoredZipLayout;
   class ThreadedInstancesLoader;
   
   class ArchiveJob : public IJob
@@ -64,7 +67,7 @@ namespace Orthanc
     unsigned int                          instancesCount_;
     uint64_t                              uncompressedSize_;
     uint64_t                              archiveSize_;
-    std::string                           mediaArchiveId_;
+    std::string                           outputJobId_;  // Key in the "JobOutputsStore" (new in Orthanc 1.12.12)
 
     // New in Orthanc 1.7.0
     bool                 transcode_;
@@ -78,7 +81,14 @@ namespace Orthanc
     // New in Orthanc 1.12.11
     bool                 allowUtf8_;
 
-    void FinalizeTarget();
+    // New in Orthanc 1.12.12
+    unsigned int         compressionThreads_;
+    bool                 dicomDirFromIndex_;
+    unsigned int         localityWindow_;
+    uint64_t             loaderMemoryBudget_;
+    bool                 tarFormat_;
+
+    void FinalizeTarget(const std::string& jobId);
     
   public:
     ArchiveJob(ServerContext& context,
@@ -116,6 +126,61 @@ namespace Orthanc
 
     void SetAllowUtf8(bool allowUtf8);
 
+    void SetCompressionThreads(unsigned int threads);
+
+    // Build the DICOMDIR of the media from the main DICOM tags in the
+    // index, instead of parsing each DICOM file (new in Orthanc 1.12.12)
+    void SetDicomDirFromIndex(bool fromIndex);
+
+    // Number of consecutive instances whose reads are sorted by
+    // attachment UUID, cf. "ThreadedInstancesLoader::SetLocalityWindow()"
+    // (new in Orthanc 1.12.12)
+    void SetLocalityWindow(unsigned int count);
+
+    // Maximum size of the DICOM files that are loaded ahead of the
+    // ZIP writer, cf. "ThreadedInstancesLoader::SetMemoryBudget()"
+    // (new in Orthanc 1.12.12)
+    void SetLoaderMemoryBudget(uint64_t bytes);
+
+    bool IsDicomDirFromIndex() const
+    {
+      return dicomDirFromIndex_;
+    }
+
+    // Write an uncompressed TAR archive instead of a ZIP archive,
+    // for the fast machine-to-machine transfers: There is neither
+    // compression, nor CRC-32, nor central directory (new in Orthanc
+    // 1.12.12)
+    void SetTarFormat(bool tar);
+
+    bool IsTarFormat() const
+    {
+      return tarFormat_;
+    }
+
+    MimeType GetMimeType() const
+    {
+      return (tarFormat_ ? MimeType_Tar : MimeType_Zip);
+    }
+
+    /**
+     * Computes from the index, without reading the DICOM files, the
+     * layout of an archive whose files are stored uncompressed. The
+     * n-th entry of the layout corresponds to the n-th attachment.
+     * Not available for DICOMDIR media and for transcoding (new in
+     * Orthanc 1.12.12).
+     **/
+    void ComputeStoredLayout(StoredZipLayout& layout,
+                             std::vector<FileInfo>& attachments);
+
+    /**
+     * Computes a key that identifies the content of the archive, from
+     * its parameters and from the attachments of the archived
+     * instances. Used to reuse the archives that have already been
+     * generated (new in Orthanc 1.12.12).
+     **/
+    void ComputeCacheKey(std::string& key);
+
     virtual void Reset() ORTHANC_OVERRIDE;
 
     virtual void Start() ORTHANC_OVERRIDE;
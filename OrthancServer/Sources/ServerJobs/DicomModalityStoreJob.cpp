@@ -30,6 +30,9 @@
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
 #include "../ServerContext.h"
 #include "../StorageCommitmentReports.h"
+#include "ParallelStoreSender.h"
+
+#include <boost/lexical_cast.hpp>
 
 
 namespace Orthanc
@@ -38,15 +41,75 @@ namespace Orthanc
   {
     if (connection_.get() == NULL)
     {
-      connection_.reset(new DicomStoreUserConnection(parameters_));
+      connection_.reset(context_.GetStoreConnectionPool().Acquire(parameters_));
+
+      // Pipeline the C-STORE requests if the modality accepts several
+      // outstanding operations ("MaxOperationsInvoked")
+      connection_->SetAsynchronousStore(true);
+    }
+  }
+
+
+  bool DicomModalityStoreJob::SendInParallel(std::string& sopClassUid,
+                                             std::string& sopInstanceUid,
+                                             const std::string& instance)
+  {
+    const size_t position = GetPosition();
+
+    if (position >= instancesIds_.size() ||
+        instancesIds_[position] != instance)
+    {
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
+    if (sender_.get() == NULL)
+    {
+      sender_.reset(new ParallelStoreSender(context_, parameters_, *instancesLoader_, HasMoveOriginator(),
+                                       moveOriginatorAet_, moveOriginatorId_, position));
+    }
+
+    // Keep one instance in flight for each association, the job
+    // still advancing one instance (i.e. one step) at a time
+    sender_->Submit(instancesIds_, position + parameters_.GetRemoteModality().GetMaxParallelAssociations());
+
+    return sender_->WaitOutcome(sopClassUid, sopInstanceUid, position);
+  }
+
+
+  void DicomModalityStoreJob::ReleaseConnection()
+  {
+    if (connection_.get() != NULL)
+    {
+      context_.GetStoreConnectionPool().Release(connection_.release());
     }
   }
 
 
+  void DicomModalityStoreJob::RequestStorageCommitment()
+  {
+    assert(IsStarted());
+    ReleaseConnection();
+    sender_.reset(NULL);
+
+    const std::string& remoteAet = parameters_.GetRemoteModality().GetApplicationEntityTitle();
+
+    LOG(INFO) << "Sending storage commitment request to modality: " << remoteAet;
+
+    // Create a "pending" storage commitment report BEFORE the
+    // actual SCU call in order to avoid race conditions
+    context_.GetStorageCommitmentReports().Store(
+      transactionUid_, new StorageCommitmentReports::Report(remoteAet));
+
+    std::vector<std::string> a(sopClassUids_.begin(), sopClassUids_.end());
+    std::vector<std::string> b(sopInstanceUids_.begin(), sopInstanceUids_.end());
+
+    DicomAssociation::RequestStorageCommitment(parameters_, transactionUid_, a, b);
+  }
+
+
   bool DicomModalityStoreJob::HandleInstance(const std::string& instance)
   {
     assert(IsStarted());
-    OpenConnection();
 
     if (instancesLoader_.get() == NULL)
     {
@@ -56,21 +119,50 @@ namespace Orthanc
     LOG(INFO) << "Sending instance " << instance << " to modality \"" 
               << parameters_.GetRemoteModality().GetApplicationEntityTitle() << "\"";
 
-    std::string dicom;
+    std::string sopClassUid, sopInstanceUid;
 
-    try
+    if (parameters_.GetRemoteModality().GetMaxParallelAssociations() > 1)
     {
-      instancesLoader_->WaitDicomInstance(dicom, instance);
+      if (!SendInParallel(sopClassUid, sopInstanceUid, instance))
+      {
+        LOG(WARNING) << "An instance was removed after the job was issued: " << instance;
+        return false;
+      }
     }
-    catch (OrthancException& e)
+    else
     {
-      LOG(WARNING) << "An instance was removed after the job was issued: " << instance;
-      return false;
-    }
+      OpenConnection();
 
-    std::string sopClassUid, sopInstanceUid;
-    context_.PerformCStoreWithTranscoding(sopClassUid, sopInstanceUid, *connection_, dicom,
-                                          HasMoveOriginator(), moveOriginatorAet_, moveOriginatorId_);
+      std::string dicom;
+
+      try
+      {
+        instancesLoader_->WaitDicomInstance(dicom, instance);
+      }
+      catch (OrthancException& e)
+      {
+        LOG(WARNING) << "An instance was removed after the job was issued: " << instance;
+        return false;
+      }
+
+      try
+      {
+        context_.PerformCStoreWithTranscoding(sopClassUid, sopInstanceUid, *connection_, dicom,
+                                              HasMoveOriginator(), moveOriginatorAet_, moveOriginatorId_);
+
+        if (GetPosition() + 1 == GetInstancesCount())
+        {
+          // Collect the responses to the asynchronous requests before
+          // reporting the job as done
+          connection_->WaitPendingStores();
+        }
+      }
+      catch (OrthancException&)
+      {
+        connection_.reset(NULL);  // Don't give a possibly broken association back to the pool
+        throw;
+      }
+    }
 
     if (storageCommitment_)
     {
@@ -85,22 +177,7 @@ namespace Orthanc
       
       if (sopClassUids_.size() == GetInstancesCount())
       {
-        assert(IsStarted());
-        connection_.reset(NULL);
-        
-        const std::string& remoteAet = parameters_.GetRemoteModality().GetApplicationEntityTitle();
-        
-        LOG(INFO) << "Sending storage commitment request to modality: " << remoteAet;
-
-        // Create a "pending" storage commitment report BEFORE the
-        // actual SCU call in order to avoid race conditions
-        context_.GetStorageCommitmentReports().Store(
-          transactionUid_, new StorageCommitmentReports::Report(remoteAet));
-        
-        std::vector<std::string> a(sopClassUids_.begin(), sopClassUids_.end());
-        std::vector<std::string> b(sopInstanceUids_.begin(), sopInstanceUids_.end());
-
-        DicomAssociation::RequestStorageCommitment(parameters_, transactionUid_, a, b);
+        RequestStorageCommitment();
       }
     }
 
@@ -211,7 +288,8 @@ namespace Orthanc
 
   void DicomModalityStoreJob::Stop(JobStopReason reason)   // For pausing jobs
   {
-    connection_.reset(NULL);
+    ReleaseConnection();
+    sender_.reset(NULL);  // Must be released before the loader threads
 
     StoreJob::Stop(reason);
   }
@@ -286,6 +364,11 @@ namespace Orthanc
   }
 
 
+  DicomModalityStoreJob::~DicomModalityStoreJob()
+  {
+  }
+
+
   bool DicomModalityStoreJob::Serialize(Json::Value& target) const
   {
     if (!SetOfInstancesJob::Serialize(target))
@@ -31,15 +31,18 @@
 
 namespace Orthanc
 {
+  class ParallelStoreSender;
   class ServerContext;
   
   class DicomModalityStoreJob : public StoreJob
   {
   private:
+
     DicomAssociationParameters                 parameters_;
     std::string                                moveOriginatorAet_;
     uint16_t                                   moveOriginatorId_;
     std::unique_ptr<DicomStoreUserConnection>  connection_;
+    std::unique_ptr<ParallelStoreSender>       sender_;   // If "MaxParallelAssociations" > 1
     bool                                       storageCommitment_;
 
     // For storage commitment
@@ -49,8 +52,16 @@ namespace Orthanc
 
     void OpenConnection();
 
+    void ReleaseConnection();
+
     void ResetStorageCommitment();
 
+    void RequestStorageCommitment();
+
+    bool SendInParallel(std::string& sopClassUid,
+                        std::string& sopInstanceUid,
+                        const std::string& instance);
+
   protected:
     virtual bool HandleInstance(const std::string& instance) ORTHANC_OVERRIDE;
     
@@ -67,6 +78,8 @@ namespace Orthanc
     DicomModalityStoreJob(ServerContext& context,
                           const Json::Value& serialized);
 
+    virtual ~DicomModalityStoreJob();
+
     const DicomAssociationParameters& GetParameters() const
     {
       return parameters_;
@@ -0,0 +1,401 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "JobOutputsStore.h"
+
+#include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/OrthancException.h"
+#include "../../../OrthancFramework/Sources/SystemToolbox.h"
+
+
+namespace Orthanc
+{
+  class JobOutputsStore::Item : public boost::noncopyable
+  {
+  private:
+    boost::shared_ptr<TemporaryFile>  file_;
+    uint64_t                          size_;
+    MimeType                          mime_;
+    std::string                       filename_;
+    boost::posix_time::ptime          creation_;
+
+  public:
+    Item(TemporaryFile* file,
+         MimeType mime,
+         const std::string& filename) :
+      file_(file),
+      mime_(mime),
+      filename_(filename),
+      creation_(boost::posix_time::second_clock::universal_time())
+    {
+      if (file == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+
+      size_ = file->GetFileSize();
+    }
+
+    const boost::shared_ptr<TemporaryFile>& GetFile() const
+    {
+      return file_;
+    }
+
+    uint64_t GetSize() const
+    {
+      return size_;
+    }
+
+    MimeType GetMimeType() const
+    {
+      return mime_;
+    }
+
+    const std::string& GetFilename() const
+    {
+      return filename_;
+    }
+
+    bool IsExpired(const boost::posix_time::ptime& now,
+                   unsigned int timeToLive) const
+    {
+      return (timeToLive != 0 &&
+              (now - creation_).total_seconds() >= static_cast<long>(timeToLive));
+    }
+  };
+
+
+  std::string JobOutputsStore::GetIdentifier(const std::string& jobId,
+                                             const std::string& key)
+  {
+    return jobId + "/" + key;
+  }
+
+
+  void JobOutputsStore::RemoveInternal(const std::string& id)
+  {
+    // This function assumes that "mutex_" is locked
+
+    Items::iterator it = items_.find(id);
+
+    if (it != items_.end())
+    {
+      assert(totalSize_ >= it->second->GetSize());
+      totalSize_ -= it->second->GetSize();
+
+      // The file is only removed from the filesystem once the
+      // pending accessors are released
+      delete it->second;
+      items_.erase(it);
+
+      lru_.Invalidate(id);
+    }
+  }
+
+
+  void JobOutputsStore::PurgeInternal(const std::string& keep)
+  {
+    // This function assumes that "mutex_" is locked
+
+    if (timeToLive_ != 0)
+    {
+      const boost::posix_time::ptime now = boost::posix_time::second_clock::universal_time();
+
+      std::vector<std::string> expired;
+      for (Items::const_iterator it = items_.begin(); it != items_.end(); ++it)
+      {
+        if (it->first != keep &&
+            it->second->IsExpired(now, timeToLive_))
+        {
+          expired.push_back(it->first);
+        }
+      }
+
+      for (size_t i = 0; i < expired.size(); i++)
+      {
+        LOG(INFO) << "Job output has expired: " << expired[i];
+        RemoveInternal(expired[i]);
+        statistics_.AddEviction();
+      }
+    }
+
+    // Never evict the output that was just added, nor the last
+    // output, even if it is larger than the quota on its own
+    while (!lru_.IsEmpty() &&
+           lru_.GetOldest() != keep &&
+           (items_.size() > maximumCount_ ||
+            (maximumTotalSize_ != 0 && totalSize_ > maximumTotalSize_ && items_.size() > 1)))
+    {
+      const std::string oldest = lru_.GetOldest();
+      LOG(INFO) << "Evicting job output, as the quota is reached: " << oldest;
+      RemoveInternal(oldest);
+      statistics_.AddEviction();
+    }
+  }
+
+
+  JobOutputsStore::Accessor::Accessor(JobOutputsStore& store,
+                                      const std::string& jobId,
+                                      const std::string& key) :
+    size_(0),
+    mime_(MimeType_Binary)
+  {
+    const std::string id = GetIdentifier(jobId, key);
+
+    boost::mutex::scoped_lock lock(store.mutex_);
+
+    store.PurgeInternal("");
+
+    Items::const_iterator it = store.items_.find(id);
+
+    if (it == store.items_.end())
+    {
+      store.statistics_.AddMiss();
+    }
+    else
+    {
+      store.lru_.MakeMostRecent(id);
+      store.statistics_.AddHit();
+
+      file_ = it->second->GetFile();
+      size_ = it->second->GetSize();
+      mime_ = it->second->GetMimeType();
+      filename_ = it->second->GetFilename();
+    }
+  }
+
+
+  const TemporaryFile& JobOutputsStore::Accessor::GetFile() const
+  {
+    if (IsValid())
+    {
+      return *file_;
+    }
+    else
+    {
+      // "IsValid()" should have been called
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+  }
+
+
+  uint64_t JobOutputsStore::Accessor::GetSize() const
+  {
+    if (IsValid())
+    {
+      return size_;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+  }
+
+
+  MimeType JobOutputsStore::Accessor::GetMimeType() const
+  {
+    if (IsValid())
+    {
+      return mime_;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+  }
+
+
+  const std::string& JobOutputsStore::Accessor::GetFilename() const
+  {
+    if (IsValid())
+    {
+      return filename_;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+  }
+
+
+  JobOutputsStore::JobOutputsStore(size_t maximumCount) :
+    maximumCount_(maximumCount),
+    maximumTotalSize_(0),
+    timeToLive_(0),
+    totalSize_(0)
+  {
+    if (maximumCount == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  JobOutputsStore::~JobOutputsStore()
+  {
+    for (Items::iterator it = items_.begin(); it != items_.end(); ++it)
+    {
+      assert(it->second != NULL);
+      delete it->second;
+    }
+  }
+
+
+  void JobOutputsStore::SetDirectory(const std::string& directory)
+  {
+    if (!directory.empty())
+    {
+      SystemToolbox::MakeDirectory(directory);
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    directory_ = directory;
+  }
+
+
+  TemporaryFile* JobOutputsStore::CreateSpoolFile()
+  {
+    std::string directory;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      directory = directory_;
+    }
+
+    if (directory.empty())
+    {
+      return new TemporaryFile;
+    }
+    else
+    {
+      return new TemporaryFile(SystemToolbox::PathFromUtf8(directory), "");
+    }
+  }
+
+
+  void JobOutputsStore::Add(const std::string& jobId,
+                            const std::string& key,
+                            TemporaryFile* file,
+                            MimeType mime,
+                            const std::string& filename)
+  {
+    std::unique_ptr<Item> item(new Item(file, mime, filename));
+
+    const std::string id = GetIdentifier(jobId, key);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    RemoveInternal(id);
+
+    totalSize_ += item->GetSize();
+    items_[id] = item.release();
+    lru_.Add(id);
+
+    PurgeInternal(id);
+  }
+
+
+  bool JobOutputsStore::Remove(const std::string& jobId,
+                               const std::string& key)
+  {
+    const std::string id = GetIdentifier(jobId, key);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (items_.find(id) == items_.end())
+    {
+      return false;
+    }
+    else
+    {
+      RemoveInternal(id);
+      return true;
+    }
+  }
+
+
+  void JobOutputsStore::Purge()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    PurgeInternal("");
+  }
+
+
+  size_t JobOutputsStore::GetNumberOfItems()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return items_.size();
+  }
+
+
+  uint64_t JobOutputsStore::GetTotalSize()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return totalSize_;
+  }
+
+
+  size_t JobOutputsStore::GetMaximumSize()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return maximumCount_;
+  }
+
+
+  void JobOutputsStore::SetMaximumSize(size_t count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    maximumCount_ = count;
+    PurgeInternal("");
+  }
+
+
+  void JobOutputsStore::SetMaximumTotalSize(uint64_t size)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    maximumTotalSize_ = size;
+    PurgeInternal("");
+  }
+
+
+  void JobOutputsStore::SetTimeToLive(unsigned int seconds)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    timeToLive_ = seconds;
+    PurgeInternal("");
+  }
+
+
+  void JobOutputsStore::GetStatistics(CacheStatistics& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    target = statistics_;
+  }
+}
@@ -0,0 +1,145 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include "../../../OrthancFramework/Sources/Cache/CacheStatistics.h"
+#include "../../../OrthancFramework/Sources/Cache/LeastRecentlyUsedIndex.h"
+#include "../../../OrthancFramework/Sources/Enumerations.h"
+#include "../../../OrthancFramework/Sources/TemporaryFile.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+
+namespace Orthanc
+{
+  /**
+   * Spools the large outputs of the jobs (such as the ZIP archives
+   * and DICOMDIR media created by "ArchiveJob") as files in some
+   * directory, instead of keeping them in RAM. The outputs are
+   * evicted in LRU order if there are more than "maximumCount"
+   * outputs, or if their total size is above "maximumTotalSize". An
+   * output also expires after "timeToLive" seconds. The files are
+   * reference-counted, so that an output that is being downloaded is
+   * only removed from the filesystem once the download is over. New
+   * in Orthanc 1.12.12, replaces the "SharedArchive" of the media.
+   **/
+  class JobOutputsStore : public boost::noncopyable
+  {
+  private:
+    class Item;
+
+    typedef std::map<std::string, Item*>  Items;
+
+    boost::mutex                         mutex_;
+    Items                                items_;
+    LeastRecentlyUsedIndex<std::string>  lru_;
+    CacheStatistics                      statistics_;
+    std::string                          directory_;
+    size_t                               maximumCount_;
+    uint64_t                             maximumTotalSize_;  // 0 means no limit
+    unsigned int                         timeToLive_;        // 0 means no expiration
+    uint64_t                             totalSize_;
+
+    static std::string GetIdentifier(const std::string& jobId,
+                                     const std::string& key);
+
+    void RemoveInternal(const std::string& id);
+
+    void PurgeInternal(const std::string& keep);
+
+  public:
+    class Accessor : public boost::noncopyable
+    {
+    private:
+      boost::shared_ptr<TemporaryFile>  file_;
+      uint64_t                          size_;
+      MimeType                          mime_;
+      std::string                       filename_;
+
+    public:
+      Accessor(JobOutputsStore& store,
+               const std::string& jobId,
+               const std::string& key);
+
+      bool IsValid() const
+      {
+        return file_.get() != NULL;
+      }
+
+      const TemporaryFile& GetFile() const;
+
+      uint64_t GetSize() const;
+
+      MimeType GetMimeType() const;
+
+      const std::string& GetFilename() const;
+    };
+
+    explicit JobOutputsStore(size_t maximumCount);
+
+    ~JobOutputsStore();
+
+    // An empty directory corresponds to the temporary directory of
+    // the system. The directory is created if need be.
+    void SetDirectory(const std::string& directory);
+
+    // Creates an empty file in the directory of the store. This file
+    // is typically filled by a job, then provided to "Add()".
+    TemporaryFile* CreateSpoolFile();
+
+    // Takes the ownership of the file. Replaces the previous output
+    // of the same job with the same key, if any.
+    void Add(const std::string& jobId,
+             const std::string& key,
+             TemporaryFile* file,
+             MimeType mime,
+             const std::string& filename);
+
+    bool Remove(const std::string& jobId,
+                const std::string& key);
+
+    // Removes the expired outputs
+    void Purge();
+
+    size_t GetNumberOfItems();
+
+    uint64_t GetTotalSize();
+
+    // The maximum size is expressed as a number of outputs
+    size_t GetMaximumSize();
+
+    void SetMaximumSize(size_t count);
+
+    void SetMaximumTotalSize(uint64_t size);
+
+    void SetTimeToLive(unsigned int seconds);
+
+    // Only the hits, the misses and the evictions are tracked
+    void GetStatistics(CacheStatistics& target);
+  };
+}
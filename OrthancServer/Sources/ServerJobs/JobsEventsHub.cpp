@@ -0,0 +1,104 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "JobsEventsHub.h"
+
+
+namespace Orthanc
+{
+  JobsEventsHub::Listener::Listener(JobsEventsHub& hub) :
+    hub_(hub)
+  {
+    boost::mutex::scoped_lock lock(hub_.mutex_);
+    hub_.listeners_.insert(this);
+  }
+
+
+  JobsEventsHub::Listener::~Listener()
+  {
+    boost::mutex::scoped_lock lock(hub_.mutex_);
+    hub_.listeners_.erase(this);
+  }
+
+
+  bool JobsEventsHub::Listener::WaitChanges(std::set<std::string>& changedJobs,
+                                            unsigned int timeout)
+  {
+    changedJobs.clear();
+
+    boost::mutex::scoped_lock lock(hub_.mutex_);
+
+    const boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout);
+
+    while (!hub_.stopped_ &&
+           changedJobs_.empty())
+    {
+      if (!hub_.changed_.timed_wait(lock, deadline))
+      {
+        break;
+      }
+    }
+
+    changedJobs.swap(changedJobs_);
+    return !hub_.stopped_;
+  }
+
+
+  JobsEventsHub::JobsEventsHub() :
+    stopped_(false)
+  {
+  }
+
+
+  void JobsEventsHub::SignalJobUpdated(const std::string& jobId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!listeners_.empty())
+    {
+      for (std::set<Listener*>::iterator it = listeners_.begin(); it != listeners_.end(); ++it)
+      {
+        (*it)->changedJobs_.insert(jobId);
+      }
+
+      changed_.notify_all();
+    }
+  }
+
+
+  void JobsEventsHub::Stop()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stopped_ = true;
+    changed_.notify_all();
+  }
+
+
+  size_t JobsEventsHub::GetListenersCount()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return listeners_.size();
+  }
+}
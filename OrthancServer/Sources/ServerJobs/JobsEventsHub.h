@@ -0,0 +1,81 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <set>
+#include <string>
+
+namespace Orthanc
+{
+  /**
+   * Dispatches the identifiers of the jobs that have changed to the
+   * HTTP clients that listen to "/jobs/events". The changes of one
+   * job are coalesced until the listener reads them, so that the cost
+   * of a listener doesn't depend on the number of steps of the
+   * jobs. New in Orthanc 1.12.12.
+   **/
+  class JobsEventsHub : public boost::noncopyable
+  {
+  public:
+    class Listener : public boost::noncopyable
+    {
+      friend class JobsEventsHub;
+
+    private:
+      JobsEventsHub&         hub_;
+      std::set<std::string>  changedJobs_;
+
+    public:
+      explicit Listener(JobsEventsHub& hub);
+
+      ~Listener();
+
+      // Waits for at most "timeout" milliseconds for some job to
+      // change. Returns "false" iff the hub is stopped.
+      bool WaitChanges(std::set<std::string>& changedJobs,
+                       unsigned int timeout);
+    };
+
+  private:
+    boost::mutex               mutex_;
+    boost::condition_variable  changed_;
+    std::set<Listener*>        listeners_;
+    bool                       stopped_;
+
+  public:
+    JobsEventsHub();
+
+    // Can be called with the mutex of the jobs registry locked
+    void SignalJobUpdated(const std::string& jobId);
+
+    // Releases all the listeners
+    void Stop();
+
+    size_t GetListenersCount();
+  };
+}
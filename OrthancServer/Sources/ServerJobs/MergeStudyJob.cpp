@@ -51,12 +51,7 @@ namespace Orthanc
     // Add all the instances of the series as to be processed
     std::list<std::string> instances;
     GetContext().GetIndex().GetChildren(instances, ResourceType_Series, series);
-
-    for (std::list<std::string>::const_iterator
-           it = instances.begin(); it != instances.end(); ++it)
-    {
-      AddInstance(*it);
-    }
+    AddInstances(instances);
   }
 
 
@@ -83,11 +78,11 @@ namespace Orthanc
 
   bool MergeStudyJob::HandleInstance(const std::string& instance)
   {
-    if (!HasTrailingStep())
-    {
-      throw OrthancException(ErrorCode_BadSequenceOfCalls,
-                             "AddTrailingStep() should have been called after AddSourceXXX()");
-    }
+    /**
+     * This method is called concurrently by several threads. The
+     * target UIDs and the modifications are all chosen before the
+     * job is started, so that they are not modified here.
+     **/
     
     /**
      * Retrieve the DICOM instance to be modified
@@ -164,8 +159,10 @@ namespace Orthanc
 
   
   MergeStudyJob::MergeStudyJob(ServerContext& context,
-                               const std::string& targetStudy) :
-    CleaningInstancesJob(context, false /* by default, remove source instances */),
+                               const std::string& targetStudy,
+                               unsigned int workersCount) :
+    ThreadedSetOfInstancesJob(context, false /* no post processing step */,
+                              false /* by default, remove source instances */, workersCount),
     targetStudy_(targetStudy)
   {
     /**
@@ -349,14 +346,17 @@ namespace Orthanc
     else
     {
       RegisterSeries(seriesUidMap_, parentSeries);
-      AddInstance(instance);
+
+      std::list<std::string> instances;
+      instances.push_back(instance);
+      AddInstances(instances);
     }    
   }
   
 
   void MergeStudyJob::GetPublicContent(Json::Value& value) const
   {
-    CleaningInstancesJob::GetPublicContent(value);
+    ThreadedSetOfInstancesJob::GetPublicContent(value);
     value["TargetStudy"] = targetStudy_;
   }
 
@@ -370,15 +370,9 @@ namespace Orthanc
 
   MergeStudyJob::MergeStudyJob(ServerContext& context,
                                const Json::Value& serialized) :
-    CleaningInstancesJob(context, serialized,
-                         false /* by default, remove source instances */)  // (*)
+    ThreadedSetOfInstancesJob(context, serialized, false /* no post processing step */,
+                              false /* by default, remove source instances */)
   {
-    if (!HasTrailingStep())
-    {
-      // Should have been set by (*)
-      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
-    }
-
     targetStudy_ = SerializationToolbox::ReadString(serialized, TARGET_STUDY);
     SerializationToolbox::ReadMapOfTags(replacements_, serialized, REPLACEMENTS);
     SerializationToolbox::ReadSetOfTags(removals_, serialized, REMOVALS);
@@ -389,7 +383,7 @@ namespace Orthanc
   
   bool MergeStudyJob::Serialize(Json::Value& target) const
   {
-    if (!CleaningInstancesJob::Serialize(target))
+    if (!ThreadedSetOfInstancesJob::Serialize(target))
     {
       return false;
     }
@@ -25,13 +25,13 @@
 
 #include "../../../OrthancFramework/Sources/DicomFormat/DicomMap.h"
 #include "../DicomInstanceOrigin.h"
-#include "CleaningInstancesJob.h"
+#include "ThreadedSetOfInstancesJob.h"
 
 namespace Orthanc
 {
   class ServerContext;
   
-  class MergeStudyJob : public CleaningInstancesJob
+  class MergeStudyJob : public ThreadedSetOfInstancesJob
   {
   private:
     typedef std::map<std::string, std::string>  SeriesUidMap;
@@ -50,15 +50,18 @@ namespace Orthanc
     void AddSourceStudyInternal(const std::string& study);
 
     // Make setter methods private to prevent incorrect calls
-    using SetOfInstancesJob::AddParentResource;
-    using SetOfInstancesJob::AddInstance;
+    using ThreadedSetOfInstancesJob::AddParentResource;
+    using ThreadedSetOfInstancesJob::AddInstances;
     
   protected:
     virtual bool HandleInstance(const std::string& instance) ORTHANC_OVERRIDE;
 
   public:
+    // The instances are processed by at most "workersCount" threads
+    // at the same time (new in Orthanc 1.12.12)
     MergeStudyJob(ServerContext& context,
-                  const std::string& targetStudy);
+                  const std::string& targetStudy,
+                  unsigned int workersCount);
 
     MergeStudyJob(ServerContext& context,
                   const Json::Value& serialized);
@@ -85,10 +88,6 @@ namespace Orthanc
       return origin_;
     }
 
-    virtual void Stop(JobStopReason reason) ORTHANC_OVERRIDE
-    {
-    }
-
     virtual void GetJobType(std::string& target) const ORTHANC_OVERRIDE
     {
       target = "MergeStudy";
@@ -42,6 +42,7 @@
 #include "DicomGetScuJob.h"
 #include "MergeStudyJob.h"
 #include "OrthancPeerStoreJob.h"
+#include "ReindexingJob.h"
 #include "ResourceModificationJob.h"
 #include "SplitStudyJob.h"
 #include "StorageCommitmentScpJob.h"
@@ -84,6 +85,10 @@ namespace Orthanc
     {
       return new SplitStudyJob(context_, source);
     }
+    else if (type == "Reindexing")
+    {
+      return new ReindexingJob(context_, source);
+    }
     else if (type == "DicomMoveScu")
     {
       return new DicomMoveScuJob(context_, source);
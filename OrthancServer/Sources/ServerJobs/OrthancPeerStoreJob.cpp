@@ -25,110 +25,668 @@
 #include "OrthancPeerStoreJob.h"
 
 #include "../../../OrthancFramework/Sources/Compression/GzipCompressor.h"
+#include "../../../OrthancFramework/Sources/Compression/ZipWriter.h"
 #include "../../../OrthancFramework/Sources/Constants.h"
 #include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/SharedMessageQueue.h"
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
 #include "../ServerContext.h"
+#include "ThreadedInstancesLoader.h"
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <dcmtk/dcmdata/dcfilefo.h>
 
 
 namespace Orthanc
 {
-  bool OrthancPeerStoreJob::HandleInstance(const std::string& instance)
+  static void ConfigureClient(HttpClient& client,
+                              bool compress)
   {
-    if (instancesLoader_.get() == NULL)
+    client.SetMethod(HttpMethod_Post);
+
+    if (compress)
     {
-      StartLoaderThreads();
+      client.AddHeader("Expect", "");
+      client.AddHeader("Content-Encoding", "gzip");
     }
+  }
 
-    if (client_.get() == NULL)
+
+  // Returns "false" if the instance was removed from Orthanc before
+  // it could be loaded
+  static bool PrepareBody(std::string& body,
+                          ServerContext& context,
+                          ThreadedInstancesLoader& loader,
+                          const std::string& instance,
+                          bool transcode,
+                          DicomTransferSyntax transferSyntax,
+                          bool compress)
+  {
+    std::string dicom;
+
+    try
     {
-      client_.reset(new HttpClient(peer_, "instances"));
-      client_->SetMethod(HttpMethod_Post);
+      loader.WaitDicomInstance(dicom, instance);
 
-      if (compress_)
+      if (transcode)
       {
-        client_->AddHeader("Expect", "");
-        client_->AddHeader("Content-Encoding", "gzip");
+        std::set<DicomTransferSyntax> syntaxes;
+        syntaxes.insert(transferSyntax);
+        
+        IDicomTranscoder::DicomImage source, transcoded;
+        source.SetExternalBuffer(dicom);
+
+        if (context.GetTranscoder().Transcode(transcoded, source, syntaxes, TranscodingSopInstanceUidMode_AllowNew))
+        {
+          std::string tmp(reinterpret_cast<const char*>(transcoded.GetBufferData()),
+                          transcoded.GetBufferSize());
+          dicom.swap(tmp);
+        }
       }
     }
-      
-    LOG(INFO) << "Sending instance " << instance << " to peer \"" 
-              << peer_.GetUrl() << "\"";
+    catch (OrthancException& e)
+    {
+      return false;
+    }
 
-    // Lifetime of "body" must exceed the call to "client_->Apply()" because of "SetExternalBody()"
-    std::string body;
+    if (compress)
+    {
+      GzipCompressor compressor;
+      compressor.SetCompressionLevel(9);  // Max compression level
+      IBufferCompressor::Compress(body, compressor, dicom);
+    }
+    else
+    {
+      body.swap(dicom);
+    }
+
+    return true;
+  }
+
+
+  static void Upload(HttpClient& client,
+                     const std::string& body,
+                     bool compress)
+  {
+    // Lifetime of "body" must exceed the call to "client.Apply()" because of "SetExternalBody()"
+    client.SetExternalBody(body);
+
+    std::string answer;
+    if (!client.Apply(answer))
+    {
+      if (compress)
+      {
+        LOG(ERROR) << "Cannot send DICOM over HTTP using \"gzip\" as "
+                   << "\"Content-Encoding\": Make sure that the version "
+                   << "of the remote Orthanc server is >= 1.6.0";
+      }
+
+      throw OrthancException(ErrorCode_NetworkProtocol);
+    }
+  }
+
+
+  /**
+   * Spreads the uploads of a sequence of instances over several HTTP
+   * connections to the peer. Each worker thread owns its HTTP client,
+   * and prepares (transcodes and compresses) the instances it sends.
+   * The outcomes are collected in the order of the sequence, so that
+   * the progress and the failures are still reported per instance.
+   **/
+  class OrthancPeerStoreJob::ParallelSender : public boost::noncopyable
+  {
+  private:
+    class PendingInstance : public IDynamicObject
+    {
+    private:
+      size_t       position_;
+      std::string  instanceId_;
+
+    public:
+      PendingInstance(size_t position,
+                      const std::string& instanceId) :
+        position_(position),
+        instanceId_(instanceId)
+      {
+      }
+
+      size_t GetPosition() const
+      {
+        return position_;
+      }
+
+      const std::string& GetInstanceId() const
+      {
+        return instanceId_;
+      }
+    };
+
+    struct Outcome : public boost::noncopyable
+    {
+      bool                               isLoaded_;
+      uint64_t                           size_;
+      std::unique_ptr<OrthancException>  error_;
+
+      Outcome() :
+        isLoaded_(false),
+        size_(0)
+      {
+      }
+    };
+
+    typedef std::map<size_t, Outcome*>  Outcomes;
+
+    const OrthancPeerStoreJob&   job_;
+    ThreadedInstancesLoader&     loader_;
+    size_t                       nextPosition_;
+    bool                         done_;
+    SharedMessageQueue           queue_;
+    boost::mutex                 outcomesMutex_;
+    boost::condition_variable    outcomeAvailable_;
+    Outcomes                     outcomes_;
+    std::vector<boost::thread*>  threads_;
+
+    void Process(Outcome& outcome,
+                 HttpClient& client,
+                 const std::string& instanceId)
+    {
+      std::string body;
+      if (!PrepareBody(body, job_.context_, loader_, instanceId,
+                       job_.transcode_, job_.transferSyntax_, job_.compress_))
+      {
+        return;
+      }
+
+      outcome.isLoaded_ = true;
+      outcome.size_ = body.size();
+
+      try
+      {
+        Upload(client, body, job_.compress_);
+      }
+      catch (OrthancException& e)
+      {
+        outcome.error_.reset(new OrthancException(e));
+      }
+      catch (std::exception& e)
+      {
+        outcome.error_.reset(new OrthancException(ErrorCode_InternalError, e.what()));
+      }
+      catch (...)
+      {
+        outcome.error_.reset(new OrthancException(ErrorCode_InternalError));
+      }
+    }
+
+    static void Worker(ParallelSender* that,
+                       unsigned int index)
+    {
+      Logging::ScopedCurrentThreadNameSetter setter("PSTO-SEND-" + boost::lexical_cast<std::string>(index));
+
+      HttpClient client(that->job_.peer_, "instances");
+      ConfigureClient(client, that->job_.compress_);
+
+      while (!that->done_)
+      {
+        std::unique_ptr<IDynamicObject> obj(that->queue_.Dequeue(100));
+
+        if (obj.get() != NULL)
+        {
+          const PendingInstance& pending = dynamic_cast<const PendingInstance&>(*obj);
+
+          std::unique_ptr<Outcome> outcome(new Outcome);
+          that->Process(*outcome, client, pending.GetInstanceId());
+
+          boost::mutex::scoped_lock lock(that->outcomesMutex_);
+          that->outcomes_[pending.GetPosition()] = outcome.release();
+          that->outcomeAvailable_.notify_all();
+        }
+      }
+    }
+
+  public:
+    ParallelSender(const OrthancPeerStoreJob& job,
+                   ThreadedInstancesLoader& loader,
+                   size_t firstPosition) :
+      job_(job),
+      loader_(loader),
+      nextPosition_(firstPosition),
+      done_(false)
+    {
+      const unsigned int count = job.peer_.GetMaxParallelTransfers();
+
+      LOG(INFO) << "Sending the instances to peer \"" << job.peer_.GetUrl()
+                << "\" over " << count << " parallel connections";
+
+      for (unsigned int i = 0; i < count; i++)
+      {
+        threads_.push_back(new boost::thread(Worker, this, i));
+      }
+    }
+
+    ~ParallelSender()
+    {
+      // The uploads in progress are completed, the other ones are dropped
+      done_ = true;
+
+      for (size_t i = 0; i < threads_.size(); i++)
+      {
+        if (threads_[i] != NULL)
+        {
+          if (threads_[i]->joinable())
+          {
+            threads_[i]->join();
+          }
+
+          delete threads_[i];
+        }
+      }
+
+      for (Outcomes::iterator it = outcomes_.begin(); it != outcomes_.end(); ++it)
+      {
+        assert(it->second != NULL);
+        delete it->second;
+      }
+    }
+
+    // Queue the instances of the sequence up to position "end" (excluded)
+    void Submit(const std::vector<std::string>& instancesIds,
+                size_t end)
+    {
+      end = std::min(end, instancesIds.size());
+
+      while (nextPosition_ < end)
+      {
+        queue_.Enqueue(new PendingInstance(nextPosition_, instancesIds[nextPosition_]));
+        nextPosition_++;
+      }
+    }
+
+    // Returns "false" if the instance was removed from Orthanc before
+    // it could be loaded, throws if its upload failed
+    bool WaitOutcome(uint64_t& size,
+                     size_t position)
+    {
+      if (position >= nextPosition_)
+      {
+        // This instance was never submitted, waiting would never end
+        THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+      }
+
+      std::unique_ptr<Outcome> outcome;
+
+      {
+        boost::mutex::scoped_lock lock(outcomesMutex_);
+
+        Outcomes::iterator found = outcomes_.find(position);
+        while (found == outcomes_.end())
+        {
+          outcomeAvailable_.wait(lock);
+          found = outcomes_.find(position);
+        }
+
+        outcome.reset(found->second);
+        outcomes_.erase(found);
+      }
+
+      if (!outcome->isLoaded_)
+      {
+        return false;
+      }
+      else
+      {
+        size = outcome->size_;
+
+        if (outcome->error_.get() != NULL)
+        {
+          throw OrthancException(*outcome->error_);
+        }
+        else
+        {
+          return true;
+        }
+      }
+    }
+  };
+
+
+  bool OrthancPeerStoreJob::SendInParallel(const std::string& instance)
+  {
+    const size_t position = GetPosition();
+
+    if (position >= instancesIds_.size() ||
+        instancesIds_[position] != instance)
+    {
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
+    if (sender_.get() == NULL)
+    {
+      sender_.reset(new ParallelSender(*this, *instancesLoader_, position));
+    }
+
+    // Keep one upload in flight for each connection, the job still
+    // advancing one instance (i.e. one step) at a time
+    sender_->Submit(instancesIds_, position + peer_.GetMaxParallelTransfers());
+
+    uint64_t size = 0;
+    bool loaded;
 
     try
     {
+      loaded = sender_->WaitOutcome(size, position);
+    }
+    catch (OrthancException&)
+    {
+      size_ += size;
+      throw;
+    }
+
+    size_ += size;
+    return loaded;
+  }
+
+
+  /**
+   * Body of the HTTP request that uploads a bundle of instances to
+   * the peer. The instances are packed into a ZIP archive that is
+   * created on the fly, one instance at a time, as curl asks for more
+   * data. The "POST /instances" route of the peer stores the entries
+   * of the archive in order, and answers with the status of each of
+   * them.
+   **/
+  class OrthancPeerStoreJob::BundleBody : public HttpClient::IRequestBody
+  {
+  private:
+    class OutputStream : public ZipWriter::IOutputStream
+    {
+    private:
+      std::string&  pending_;
+      uint64_t      archiveSize_;
+
+    public:
+      explicit OutputStream(std::string& pending) :
+        pending_(pending),
+        archiveSize_(0)
+      {
+      }
+
+      virtual void Write(const std::string& chunk) ORTHANC_OVERRIDE
+      {
+        pending_.append(chunk);
+        archiveSize_ += chunk.size();
+      }
+
+      virtual void Close() ORTHANC_OVERRIDE
+      {
+      }
+
+      virtual uint64_t GetArchiveSize() const ORTHANC_OVERRIDE
+      {
+        return archiveSize_;
+      }
+    };
+
+    OrthancPeerStoreJob&  job_;
+    size_t                position_;
+    size_t                end_;
+    std::string           pending_;
+    ZipWriter             zip_;
+    bool                  closed_;
+    std::vector<size_t>   sent_;
+    uint64_t              size_;
+
+    void AddNextInstance()
+    {
+      assert(position_ < end_);
+
       std::string dicom;
-      instancesLoader_->WaitDicomInstance(dicom, instance);
+      if (PrepareBody(dicom, job_.context_, *job_.instancesLoader_, job_.instancesIds_[position_],
+                      job_.transcode_, job_.transferSyntax_, false /* compression is done by the ZIP */))
+      {
+        zip_.OpenFile(job_.instancesIds_[position_] + ".dcm");
+        zip_.Write(dicom);
+        sent_.push_back(position_);
+      }
 
-      if (transcode_)
+      position_++;
+    }
+
+  public:
+    BundleBody(OrthancPeerStoreJob& job,
+               size_t position,
+               size_t end) :
+      job_(job),
+      position_(position),
+      end_(end),
+      closed_(false),
+      size_(0)
+    {
+      // Fast deflate if compression is enabled, as the DICOM files
+      // are usually large
+      zip_.SetCompressionLevel(job.compress_ ? 1 : 0);
+      zip_.AcquireOutputStream(new OutputStream(pending_), true /* ZIP64 */);
+      zip_.Open();
+    }
+
+    // Returns "false" if all the instances of the bundle were removed
+    // from Orthanc, in which case there is nothing to send
+    bool Start()
+    {
+      while (sent_.empty() &&
+             position_ < end_)
       {
-        std::set<DicomTransferSyntax> syntaxes;
-        syntaxes.insert(transferSyntax_);
-        
-        IDicomTranscoder::DicomImage source, transcoded;
-        source.SetExternalBuffer(dicom);
+        AddNextInstance();
+      }
+
+      return !sent_.empty();
+    }
 
-        if (context_.GetTranscoder().Transcode(transcoded, source, syntaxes, TranscodingSopInstanceUidMode_AllowNew))
+    virtual bool ReadNextChunk(std::string& chunk) ORTHANC_OVERRIDE
+    {
+      while (pending_.empty() &&
+             !closed_)
+      {
+        if (position_ < end_)
         {
-          body.assign(reinterpret_cast<const char*>(transcoded.GetBufferData()),
-                      transcoded.GetBufferSize());
+          AddNextInstance();
         }
         else
         {
-          body.swap(dicom);
+          zip_.Close();
+          closed_ = true;
         }
       }
+
+      if (pending_.empty())
+      {
+        return false;
+      }
       else
       {
-        body.swap(dicom);
+        chunk.swap(pending_);
+        pending_.clear();
+        size_ += chunk.size();
+        return true;
       }
     }
-    catch (OrthancException& e)
+
+    // Positions of the instances that are part of the archive
+    const std::vector<size_t>& GetSentPositions() const
     {
-      LOG(WARNING) << "An instance was removed after the job was issued: " << instance;
-      return false;
+      return sent_;
+    }
+
+    // Size of the archive that has been sent so far
+    uint64_t GetSize() const
+    {
+      return size_;
     }
+  };
+
+
+  void OrthancPeerStoreJob::SendBundle(size_t position)
+  {
+    const size_t end = std::min(instancesIds_.size(), position + static_cast<size_t>(bundleSize_));
 
-    // Lifetime of "compressedBody" must exceed the call to "client_->Apply()" because of "SetExternalBody()"
-    std::string compressedBody;
+    bundleOutcomes_.clear();
 
-    if (compress_)
+    for (size_t i = position; i < end; i++)
     {
-      GzipCompressor compressor;
-      compressor.SetCompressionLevel(9);  // Max compression level
-      IBufferCompressor::Compress(compressedBody, compressor, body);
+      bundleOutcomes_[i] = BundleOutcome_Removed;
+    }
 
-      client_->SetExternalBody(compressedBody);
-      size_ += compressedBody.size();
+    BundleBody body(*this, position, end);
+
+    if (!body.Start())
+    {
+      return;
     }
-    else
+
+    LOG(INFO) << "Sending a bundle of " << (end - position) << " instances to peer \""
+              << peer_.GetUrl() << "\"";
+
+    HttpClient client(peer_, "instances");
+    client.SetMethod(HttpMethod_Post);
+    client.AddHeader("Content-Type", MIME_ZIP);
+    client.AddHeader("Expect", "");
+    client.AddHeader("Transfer-Encoding", "chunked");
+    client.SetBody(body);
+
+    Json::Value answer;
+    const bool success = client.Apply(answer);
+
+    size_ += body.GetSize();
+
+    if (!success)
     {
-      client_->SetExternalBody(body);
-      size_ += body.size();
+      bundleOutcomes_.clear();
+      throw OrthancException(ErrorCode_NetworkProtocol, "Cannot send a bundle of instances to peer \"" +
+                             peer_.GetUrl() + "\"");
     }
 
-    std::string answer;
-    if (client_->Apply(answer))
+    const std::vector<size_t>& sent = body.GetSentPositions();
+
+    if (answer.type() != Json::arrayValue ||
+        answer.size() != sent.size())
     {
-      return true;
+      bundleOutcomes_.clear();
+      throw OrthancException(ErrorCode_NetworkProtocol, "The peer has not stored all the instances of the bundle, "
+                             "make sure that the version of the remote Orthanc server is >= 1.8.2");
     }
-    else
+
+    for (Json::Value::ArrayIndex i = 0; i < answer.size(); i++)
     {
-      if (compress_)
+      static const char* const STATUS = "Status";
+
+      if (answer[i].type() == Json::objectValue &&
+          answer[i].isMember(STATUS) &&
+          answer[i][STATUS].type() == Json::stringValue &&
+          answer[i][STATUS].asString() == "Failure")
       {
-        LOG(ERROR) << "Cannot send DICOM over HTTP using \"gzip\" as "
-                   << "\"Content-Encoding\": Make sure that the version "
-                   << "of the remote Orthanc server is >= 1.6.0";
+        bundleOutcomes_[sent[i]] = BundleOutcome_Failure;
       }
+      else
+      {
+        bundleOutcomes_[sent[i]] = BundleOutcome_Success;
+      }
+    }
+  }
 
-      throw OrthancException(ErrorCode_NetworkProtocol);
+
+  bool OrthancPeerStoreJob::HandleBundledInstance(const std::string& instance)
+  {
+    const size_t position = GetPosition();
+
+    if (position >= instancesIds_.size() ||
+        instancesIds_[position] != instance)
+    {
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
+    BundleOutcomes::iterator found = bundleOutcomes_.find(position);
+
+    if (found == bundleOutcomes_.end())
+    {
+      SendBundle(position);
+
+      found = bundleOutcomes_.find(position);
+      if (found == bundleOutcomes_.end())
+      {
+        THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+      }
+    }
+
+    // The job still advances one instance (i.e. one step) at a time
+    const BundleOutcome outcome = found->second;
+    bundleOutcomes_.erase(found);
+
+    switch (outcome)
+    {
+      case BundleOutcome_Success:
+        return true;
+
+      case BundleOutcome_Removed:
+        LOG(WARNING) << "An instance was removed after the job was issued: " << instance;
+        return false;
+
+      case BundleOutcome_Failure:
+        throw OrthancException(ErrorCode_NetworkProtocol, "The peer has failed to store instance: " + instance);
+
+      default:
+        throw OrthancException(ErrorCode_InternalError);
     }
   }
+
+
+  bool OrthancPeerStoreJob::HandleInstance(const std::string& instance)
+  {
+    if (instancesLoader_.get() == NULL)
+    {
+      StartLoaderThreads();
+    }
+
+    LOG(INFO) << "Sending instance " << instance << " to peer \"" 
+              << peer_.GetUrl() << "\"";
+
+    if (bundleSize_ > 0)
+    {
+      return HandleBundledInstance(instance);
+    }
+    else if (peer_.GetMaxParallelTransfers() > 1)
+    {
+      if (SendInParallel(instance))
+      {
+        return true;
+      }
+      else
+      {
+        LOG(WARNING) << "An instance was removed after the job was issued: " << instance;
+        return false;
+      }
+    }
+
+    if (client_.get() == NULL)
+    {
+      client_.reset(new HttpClient(peer_, "instances"));
+      ConfigureClient(*client_, compress_);
+    }
+
+    std::string body;
+    if (!PrepareBody(body, context_, *instancesLoader_, instance, transcode_, transferSyntax_, compress_))
+    {
+      LOG(WARNING) << "An instance was removed after the job was issued: " << instance;
+      return false;
+    }
+
+    size_ += body.size();
+
+    Upload(*client_, body, compress_);
+    return true;
+  }
     
 
   bool OrthancPeerStoreJob::HandleTrailingStep()
@@ -218,9 +776,40 @@ namespace Orthanc
   }
 
 
+  void OrthancPeerStoreJob::SetBundleSize(unsigned int size)
+  {
+    if (IsStarted())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      bundleSize_ = size;
+    }
+  }
+
+
+  OrthancPeerStoreJob::OrthancPeerStoreJob(ServerContext& context) :
+    StoreJob(context),
+    transcode_(false),
+    transferSyntax_(DicomTransferSyntax_LittleEndianExplicit),  // Dummy value
+    compress_(false),
+    size_(0),
+    bundleSize_(0)
+  {
+  }
+
+
+  OrthancPeerStoreJob::~OrthancPeerStoreJob()
+  {
+  }
+
+
   void OrthancPeerStoreJob::Stop(JobStopReason reason)   // For pausing jobs
   {
     client_.reset(NULL);
+    sender_.reset(NULL);  // Must be released before the loader threads
+    bundleOutcomes_.clear();
 
     StoreJob::Stop(reason);
   }
@@ -236,6 +825,11 @@ namespace Orthanc
                     false /* don't include passwords */);
     value["Peer"] = v;
     value["Compress"] = compress_;
+
+    if (bundleSize_ > 0)
+    {
+      value["BundleSize"] = bundleSize_;
+    }
     
     if (transcode_)
     {
@@ -251,6 +845,7 @@ namespace Orthanc
   static const char* TRANSCODE = "Transcode";
   static const char* COMPRESS = "Compress";
   static const char* SIZE = "Size";
+  static const char* BUNDLE_SIZE = "BundleSize";
 
   OrthancPeerStoreJob::OrthancPeerStoreJob(ServerContext& context,
                                            const Json::Value& serialized) :
@@ -286,6 +881,15 @@ namespace Orthanc
     {
       size_ = 0;
     }
+
+    if (serialized.isMember(BUNDLE_SIZE))
+    {
+      SetBundleSize(SerializationToolbox::ReadUnsignedInteger(serialized, BUNDLE_SIZE));
+    }
+    else
+    {
+      bundleSize_ = 0;
+    }
   }
 
 
@@ -309,6 +913,7 @@ namespace Orthanc
 
       target[COMPRESS] = compress_;
       target[SIZE] = boost::lexical_cast<std::string>(size_);
+      target[BUNDLE_SIZE] = bundleSize_;
       
       return true;
     }
@@ -27,6 +27,7 @@
 #include "StoreJob.h"
 #include "../../../OrthancFramework/Sources/HttpClient.h"
 
+#include <map>
 #include <stdint.h>
 
 
@@ -37,12 +38,33 @@ namespace Orthanc
   class OrthancPeerStoreJob : public StoreJob
   {
   private:
-    WebServiceParameters         peer_;
-    std::unique_ptr<HttpClient>  client_;
-    bool                         transcode_;
-    DicomTransferSyntax          transferSyntax_;
-    bool                         compress_;
-    uint64_t                     size_;
+    class ParallelSender;
+    class BundleBody;
+
+    enum BundleOutcome
+    {
+      BundleOutcome_Success,
+      BundleOutcome_Failure,
+      BundleOutcome_Removed
+    };
+
+    typedef std::map<size_t, BundleOutcome>  BundleOutcomes;
+
+    WebServiceParameters             peer_;
+    std::unique_ptr<HttpClient>      client_;
+    std::unique_ptr<ParallelSender>  sender_;   // If "MaxParallelTransfers" > 1
+    bool                             transcode_;
+    DicomTransferSyntax              transferSyntax_;
+    bool                             compress_;
+    uint64_t                         size_;
+    unsigned int                     bundleSize_;
+    BundleOutcomes                   bundleOutcomes_;  // Positions of the last bundle that was sent
+
+    bool SendInParallel(const std::string& instance);
+
+    void SendBundle(size_t position);
+
+    bool HandleBundledInstance(const std::string& instance);
 
   protected:
     virtual bool HandleInstance(const std::string& instance) ORTHANC_OVERRIDE;
@@ -55,18 +77,13 @@ namespace Orthanc
     }
 
   public:
-    explicit OrthancPeerStoreJob(ServerContext& context) :
-      StoreJob(context),
-      transcode_(false),
-      transferSyntax_(DicomTransferSyntax_LittleEndianExplicit),  // Dummy value
-      compress_(false),
-      size_(0)
-    {
-    }
+    explicit OrthancPeerStoreJob(ServerContext& context);
 
     OrthancPeerStoreJob(ServerContext& context,
                         const Json::Value& serialize);
 
+    virtual ~OrthancPeerStoreJob();
+
     void SetPeer(const WebServiceParameters& peer);
 
     const WebServiceParameters& GetPeer() const
@@ -94,6 +111,15 @@ namespace Orthanc
 
     void SetCompress(bool compress);
 
+    unsigned int GetBundleSize() const
+    {
+      return bundleSize_;
+    }
+
+    // Pack up to "size" instances into each HTTP request, as a ZIP
+    // archive (new in Orthanc 1.12.12). Zero means no bundling.
+    void SetBundleSize(unsigned int size);
+
     virtual void Stop(JobStopReason reason) ORTHANC_OVERRIDE;   // For pausing jobs
 
     virtual void GetJobType(std::string& target) const ORTHANC_OVERRIDE
@@ -0,0 +1,268 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "ParallelStoreSender.h"
+
+#include "../../../OrthancFramework/Sources/Logging.h"
+#include "../ServerContext.h"
+#include "ThreadedInstancesLoader.h"
+
+#include <boost/lexical_cast.hpp>
+
+
+namespace Orthanc
+{
+  class ParallelStoreSender::PendingInstance : public IDynamicObject
+  {
+  private:
+    size_t       position_;
+    std::string  instanceId_;
+
+  public:
+    PendingInstance(size_t position,
+                    const std::string& instanceId) :
+      position_(position),
+      instanceId_(instanceId)
+    {
+    }
+
+    size_t GetPosition() const
+    {
+      return position_;
+    }
+
+    const std::string& GetInstanceId() const
+    {
+      return instanceId_;
+    }
+  };
+
+
+  struct ParallelStoreSender::Outcome : public boost::noncopyable
+  {
+    bool                               isLoaded_;
+    std::string                        sopClassUid_;
+    std::string                        sopInstanceUid_;
+    std::unique_ptr<OrthancException>  error_;
+
+    Outcome() :
+      isLoaded_(false)
+    {
+    }
+  };
+
+
+  void ParallelStoreSender::Process(Outcome& outcome,
+                                    std::unique_ptr<DicomStoreUserConnection>& connection,
+                                    const std::string& instanceId)
+  {
+    std::string dicom;
+
+    try
+    {
+      loader_.WaitDicomInstance(dicom, instanceId);
+    }
+    catch (OrthancException&)
+    {
+      return;
+    }
+
+    outcome.isLoaded_ = true;
+
+    try
+    {
+      if (connection.get() == NULL)
+      {
+        connection.reset(context_.GetStoreConnectionPool().Acquire(parameters_));
+      }
+
+      context_.PerformCStoreWithTranscoding(outcome.sopClassUid_, outcome.sopInstanceUid_, *connection, dicom,
+                                            hasMoveOriginator_, moveOriginatorAet_, moveOriginatorId_);
+    }
+    catch (OrthancException& e)
+    {
+      outcome.error_.reset(new OrthancException(e));
+    }
+    catch (std::exception& e)
+    {
+      outcome.error_.reset(new OrthancException(ErrorCode_InternalError, e.what()));
+    }
+    catch (...)
+    {
+      outcome.error_.reset(new OrthancException(ErrorCode_InternalError));
+    }
+
+    if (outcome.error_.get() != NULL)
+    {
+      connection.reset(NULL);  // Don't give a possibly broken association back to the pool
+    }
+  }
+
+
+  void ParallelStoreSender::Worker(ParallelStoreSender* that,
+                                   unsigned int index)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("CSTO-SEND-" + boost::lexical_cast<std::string>(index));
+
+    // The association is opened on the first instance, and is kept
+    // open until the sender is released
+    std::unique_ptr<DicomStoreUserConnection> connection;
+
+    while (!that->done_)
+    {
+      std::unique_ptr<IDynamicObject> obj(that->queue_.Dequeue(100));
+
+      if (obj.get() != NULL)
+      {
+        const PendingInstance& pending = dynamic_cast<const PendingInstance&>(*obj);
+
+        std::unique_ptr<Outcome> outcome(new Outcome);
+        that->Process(*outcome, connection, pending.GetInstanceId());
+
+        boost::mutex::scoped_lock lock(that->outcomesMutex_);
+        that->outcomes_[pending.GetPosition()] = outcome.release();
+        that->outcomeAvailable_.notify_all();
+      }
+    }
+
+    if (connection.get() != NULL)
+    {
+      that->context_.GetStoreConnectionPool().Release(connection.release());
+    }
+  }
+
+
+  ParallelStoreSender::ParallelStoreSender(ServerContext& context,
+                                           const DicomAssociationParameters& parameters,
+                                           ThreadedInstancesLoader& loader,
+                                           bool hasMoveOriginator,
+                                           const std::string& moveOriginatorAet,
+                                           uint16_t moveOriginatorId,
+                                           size_t firstPosition) :
+    context_(context),
+    parameters_(parameters),
+    loader_(loader),
+    hasMoveOriginator_(hasMoveOriginator),
+    moveOriginatorAet_(moveOriginatorAet),
+    moveOriginatorId_(moveOriginatorId),
+    nextPosition_(firstPosition),
+    done_(false)
+  {
+    const unsigned int count = parameters.GetRemoteModality().GetMaxParallelAssociations();
+
+    LOG(INFO) << "Sending the instances to modality \""
+              << parameters.GetRemoteModality().GetApplicationEntityTitle()
+              << "\" over " << count << " parallel associations";
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+      threads_.push_back(new boost::thread(Worker, this, i));
+    }
+  }
+
+
+  ParallelStoreSender::~ParallelStoreSender()
+  {
+    // The instances that are being sent are completed (their DICOM
+    // file is still delivered by the loader), the other ones are
+    // dropped
+    done_ = true;
+
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+      if (threads_[i] != NULL)
+      {
+        if (threads_[i]->joinable())
+        {
+          threads_[i]->join();
+        }
+
+        delete threads_[i];
+      }
+    }
+
+    for (Outcomes::iterator it = outcomes_.begin(); it != outcomes_.end(); ++it)
+    {
+      assert(it->second != NULL);
+      delete it->second;
+    }
+  }
+
+
+  void ParallelStoreSender::Submit(const std::vector<std::string>& instancesIds,
+                                   size_t end)
+  {
+    end = std::min(end, instancesIds.size());
+
+    while (nextPosition_ < end)
+    {
+      queue_.Enqueue(new PendingInstance(nextPosition_, instancesIds[nextPosition_]));
+      nextPosition_++;
+    }
+  }
+
+
+  bool ParallelStoreSender::WaitOutcome(std::string& sopClassUid,
+                                        std::string& sopInstanceUid,
+                                        size_t position)
+  {
+    if (position >= nextPosition_)
+    {
+      // This instance was never submitted, waiting would never end
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
+    std::unique_ptr<Outcome> outcome;
+
+    {
+      boost::mutex::scoped_lock lock(outcomesMutex_);
+
+      Outcomes::iterator found = outcomes_.find(position);
+      while (found == outcomes_.end())
+      {
+        outcomeAvailable_.wait(lock);
+        found = outcomes_.find(position);
+      }
+
+      outcome.reset(found->second);
+      outcomes_.erase(found);
+    }
+
+    if (!outcome->isLoaded_)
+    {
+      return false;
+    }
+    else if (outcome->error_.get() != NULL)
+    {
+      throw OrthancException(*outcome->error_);
+    }
+    else
+    {
+      sopClassUid.swap(outcome->sopClassUid_);
+      sopInstanceUid.swap(outcome->sopInstanceUid_);
+      return true;
+    }
+  }
+}
@@ -0,0 +1,104 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../../../OrthancFramework/Sources/Compatibility.h"
+#include "../../../OrthancFramework/Sources/DicomNetworking/DicomAssociationParameters.h"
+#include "../../../OrthancFramework/Sources/DicomNetworking/DicomStoreUserConnection.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/SharedMessageQueue.h"
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <map>
+#include <vector>
+
+namespace Orthanc
+{
+  class ServerContext;
+  class ThreadedInstancesLoader;
+
+  /**
+   * Spreads the C-STORE of a sequence of instances over several
+   * associations. Each worker thread owns its association and is fed
+   * from the shared "ThreadedInstancesLoader". The outcomes are
+   * collected one instance at a time, in the order of the sequence,
+   * so that the progress and the failures are still reported per
+   * instance (by "SetOfCommandsJob" or by the C-MOVE SCP). The sender
+   * must be destroyed before the loader.
+   **/
+  class ParallelStoreSender : public boost::noncopyable
+  {
+  private:
+    class PendingInstance;
+    struct Outcome;
+
+    typedef std::map<size_t, Outcome*>  Outcomes;
+
+    ServerContext&               context_;
+    DicomAssociationParameters   parameters_;
+    ThreadedInstancesLoader&     loader_;
+    bool                         hasMoveOriginator_;
+    std::string                  moveOriginatorAet_;
+    uint16_t                     moveOriginatorId_;
+    size_t                       nextPosition_;
+    bool                         done_;
+    SharedMessageQueue           queue_;
+    boost::mutex                 outcomesMutex_;
+    boost::condition_variable    outcomeAvailable_;
+    Outcomes                     outcomes_;
+    std::vector<boost::thread*>  threads_;
+
+    void Process(Outcome& outcome,
+                 std::unique_ptr<DicomStoreUserConnection>& connection,
+                 const std::string& instanceId);
+
+    static void Worker(ParallelStoreSender* that,
+                       unsigned int index);
+
+  public:
+    // The number of associations is given by the
+    // "MaxParallelAssociations" option of the remote modality
+    ParallelStoreSender(ServerContext& context,
+                        const DicomAssociationParameters& parameters,
+                        ThreadedInstancesLoader& loader,
+                        bool hasMoveOriginator,
+                        const std::string& moveOriginatorAet,
+                        uint16_t moveOriginatorId,
+                        size_t firstPosition);
+
+    ~ParallelStoreSender();
+
+    // Queue the instances of the sequence up to position "end" (excluded)
+    void Submit(const std::vector<std::string>& instancesIds,
+                size_t end);
+
+    // Returns "false" if the instance was removed from Orthanc before
+    // it could be loaded, throws if its C-STORE failed
+    bool WaitOutcome(std::string& sopClassUid,
+                     std::string& sopInstanceUid,
+                     size_t position);
+  };
+}
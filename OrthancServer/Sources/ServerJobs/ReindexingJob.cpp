@@ -0,0 +1,586 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "ReindexingJob.h"
+
+#include "../../../OrthancFramework/Sources/DicomParsing/ParsedDicomFile.h"
+#include "../../../OrthancFramework/Sources/ElapsedTimer.h"
+#include "../../../OrthancFramework/Sources/JobsEngine/JobTasksExecutor.h"
+#include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/SerializationToolbox.h"
+#include "../ServerContext.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cassert>
+#include <set>
+
+
+namespace Orthanc
+{
+  // The pace is never reduced below 256KB/s, so that the job always progresses
+  static const uint64_t MINIMUM_READ_RATE = 256 * 1024;
+
+
+  class ReindexingJob::Header : public boost::noncopyable
+  {
+  public:
+    std::unique_ptr<ParsedDicomFile>  dicom_;
+    uint64_t                          readBytes_;
+
+    Header() :
+      readBytes_(0)
+    {
+    }
+  };
+
+
+  class ReindexingJob::HeaderTask : public IRunnable
+  {
+  private:
+    ServerContext&  context_;
+    std::string     instance_;
+    Header&         target_;
+
+  public:
+    HeaderTask(ServerContext& context,
+               const std::string& instance,
+               Header& target) :
+      context_(context),
+      instance_(instance),
+      target_(target)
+    {
+    }
+
+    virtual void Run() ORTHANC_OVERRIDE
+    {
+      try
+      {
+        std::string dicom;
+        context_.ReadDicomForHeader(dicom, instance_);
+        target_.readBytes_ = dicom.size();
+        target_.dicom_.reset(new ParsedDicomFile(dicom));
+      }
+      catch (OrthancException& e)
+      {
+        // For instance, the instance was deleted after the job was started
+        LOG(WARNING) << "Cannot read the DICOM header of instance " << instance_ << " while re-indexing: " << e.What();
+        target_.dicom_.reset();
+      }
+      catch (...)
+      {
+        LOG(ERROR) << "Native exception while reading the DICOM header of instance " << instance_;
+        target_.dicom_.reset();
+      }
+    }
+  };
+
+
+  void ReindexingJob::LoadStudies()
+  {
+    std::list<std::string> studies;
+    context_.GetIndex().GetAllUuids(studies, ResourceType_Study);
+
+    // Process the studies in a deterministic order, which allows to
+    // resume the job after the last processed study
+    std::set<std::string> sorted(studies.begin(), studies.end());
+
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    pendingStudies_.clear();
+    currentStudy_.clear();
+    currentInstances_.clear();
+    processedStudies_ = 0;
+
+    for (std::set<std::string>::const_iterator it = sorted.begin(); it != sorted.end(); ++it)
+    {
+      if (!lastStudy_.empty() &&
+          *it <= lastStudy_)
+      {
+        processedStudies_++;
+      }
+      else
+      {
+        pendingStudies_.push_back(*it);
+      }
+    }
+
+    totalStudies_ = sorted.size();
+    isLoaded_ = true;
+  }
+
+
+  void ReindexingJob::FillBatch(std::vector<Item>& batch)
+  {
+    batch.clear();
+    batch.reserve(batchSize_);
+
+    while (batch.size() < batchSize_)
+    {
+      if (currentInstances_.empty())
+      {
+        if (pendingStudies_.empty())
+        {
+          return;
+        }
+
+        currentStudy_ = pendingStudies_.front();
+        pendingStudies_.pop_front();
+
+        context_.GetIndex().GetChildInstances(currentInstances_, currentStudy_);
+
+        if (currentInstances_.empty())
+        {
+          // The study was deleted after the job was started
+          boost::recursive_mutex::scoped_lock lock(mutex_);
+          processedStudies_++;
+          continue;
+        }
+      }
+
+      Item item;
+      item.study_ = currentStudy_;
+      item.instance_ = currentInstances_.front();
+      currentInstances_.pop_front();
+      item.isLastOfStudy_ = currentInstances_.empty();
+
+      batch.push_back(item);
+    }
+  }
+
+
+  void ReindexingJob::ReadHeaders(std::vector<Header*>& headers,
+                                  const std::vector<Item>& batch)
+  {
+    assert(headers.size() == batch.size());
+
+    // The headers are read by at most "threadsCount_" sub-tasks at
+    // the same time, in the executor that is shared by all the jobs
+    JobTasksExecutor::Group group(context_.GetJobsEngine().GetTasksExecutor(), threadsCount_);
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+      assert(headers[i] != NULL);
+      group.Submit(new HeaderTask(context_, batch[i].instance_, *headers[i]));
+    }
+
+    group.Wait(0);
+  }
+
+
+  void ReindexingJob::ReconstructInstances(const std::vector<Item>& batch,
+                                           const std::vector<Header*>& headers)
+  {
+    assert(headers.size() == batch.size());
+
+    std::list<const ParsedDicomFile*> instances;
+    uint64_t failed = 0;
+
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+      if (headers[i]->dicom_.get() == NULL)
+      {
+        failed++;
+      }
+      else
+      {
+        instances.push_back(headers[i]->dicom_.get());
+      }
+    }
+
+    try
+    {
+      context_.GetIndex().ReconstructInstances(instances);
+    }
+    catch (OrthancException& e)
+    {
+      // For instance, one of the instances was deleted in the
+      // meantime: Fallback to one transaction per instance
+      LOG(WARNING) << "Cannot re-index a batch of " << instances.size() << " instances in one transaction, "
+                   << "re-indexing them one by one: " << e.What();
+
+      for (std::list<const ParsedDicomFile*>::const_iterator it = instances.begin(); it != instances.end(); ++it)
+      {
+        try
+        {
+          context_.GetIndex().ReconstructInstance(**it, false, ResourceType_Instance /* dummy */);
+        }
+        catch (OrthancException& e2)
+        {
+          LOG(WARNING) << "Cannot re-index an instance: " << e2.What();
+          failed++;
+        }
+      }
+    }
+
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    processedInstances_ += batch.size() - failed;
+    failedInstances_ += failed;
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+      if (batch[i].isLastOfStudy_)
+      {
+        // All the instances of this study are now re-indexed
+        lastStudy_ = batch[i].study_;
+        processedStudies_++;
+      }
+    }
+  }
+
+
+  void ReindexingJob::UpdatePace(uint64_t readBytes,
+                                 uint64_t elapsedMicroseconds)
+  {
+    const bool isIngestSlower = context_.IsIngestLatencyRising();
+    const uint64_t observedRate = (elapsedMicroseconds == 0 ? 0 : readBytes * 1000000 / elapsedMicroseconds);
+
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    if (isIngestSlower)
+    {
+      // Multiplicative decrease as long as the ingest gets slower
+      const uint64_t base = (currentRate_ == 0 ? observedRate : currentRate_);
+      currentRate_ = std::max(MINIMUM_READ_RATE, base / 2);
+      LOG(INFO) << "The ingest is getting slower, pacing the re-indexing job at "
+                << (currentRate_ / 1024) << "KB/s";
+    }
+    else if (currentRate_ != 0)
+    {
+      // Additive increase, up to the I/O budget
+      if (maxReadRate_ == 0)
+      {
+        currentRate_ += currentRate_ / 4;
+
+        if (currentRate_ >= observedRate)
+        {
+          currentRate_ = 0;  // The pacing is not the bottleneck anymore
+        }
+      }
+      else
+      {
+        currentRate_ = std::min(maxReadRate_, currentRate_ + std::max(MINIMUM_READ_RATE, maxReadRate_ / 8));
+      }
+    }
+  }
+
+
+  ReindexingJob::ReindexingJob(ServerContext& context,
+                               unsigned int threadsCount,
+                               unsigned int batchSize,
+                               uint64_t maxReadRate) :
+    context_(context),
+    threadsCount_(threadsCount),
+    batchSize_(batchSize),
+    maxReadRate_(maxReadRate),
+    currentRate_(maxReadRate),
+    processedInstances_(0),
+    failedInstances_(0),
+    processedStudies_(0),
+    totalStudies_(0),
+    isLoaded_(false)
+  {
+    if (threadsCount == 0 ||
+        batchSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  void ReindexingJob::SetDescription(const std::string& description)
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+    description_ = description;
+  }
+
+
+  std::string ReindexingJob::GetLastStudy() const
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+    return lastStudy_;
+  }
+
+
+  size_t ReindexingJob::GetProcessedStudies() const
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+    return processedStudies_;
+  }
+
+
+  uint64_t ReindexingJob::GetProcessedInstances() const
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+    return processedInstances_;
+  }
+
+
+  void ReindexingJob::Start()
+  {
+  }
+
+
+  JobStepResult ReindexingJob::Step(const std::string& jobId)
+  {
+    if (!nextStep_.is_not_a_date_time())
+    {
+      const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+      if (now < nextStep_)
+      {
+        // Pace the reads according to the I/O budget, while regularly
+        // giving the hand back to the jobs engine to handle pause/cancel
+        const int64_t remaining = (nextStep_ - now).total_milliseconds();
+        boost::this_thread::sleep(boost::posix_time::milliseconds(std::min<int64_t>(remaining, 100)));
+        return JobStepResult::Continue();
+      }
+    }
+
+    if (!isLoaded_)
+    {
+      LoadStudies();
+      return JobStepResult::Continue();
+    }
+
+    std::vector<Item> batch;
+    FillBatch(batch);
+
+    if (batch.empty())
+    {
+      LOG(WARNING) << "The re-indexing job has completed";
+      return JobStepResult::Success();
+    }
+
+    const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    ElapsedTimer timer;
+
+    std::vector<Header*> headers;
+    headers.reserve(batch.size());
+
+    uint64_t readBytes = 0;
+
+    try
+    {
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+        headers.push_back(new Header);
+      }
+
+      ReadHeaders(headers, batch);
+
+      for (size_t i = 0; i < headers.size(); i++)
+      {
+        readBytes += headers[i]->readBytes_;
+      }
+
+      ReconstructInstances(batch, headers);
+    }
+    catch (...)
+    {
+      for (size_t i = 0; i < headers.size(); i++)
+      {
+        delete headers[i];
+      }
+
+      throw;
+    }
+
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+      delete headers[i];
+    }
+
+    UpdatePace(readBytes, timer.GetElapsedMicroseconds());
+
+    {
+      boost::recursive_mutex::scoped_lock lock(mutex_);
+
+      if (currentRate_ == 0)
+      {
+        nextStep_ = boost::posix_time::not_a_date_time;
+      }
+      else
+      {
+        nextStep_ = start + boost::posix_time::microseconds(static_cast<int64_t>(readBytes * 1000000 / currentRate_));
+      }
+    }
+
+    return JobStepResult::Continue();
+  }
+
+
+  void ReindexingJob::Reset()
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    lastStudy_.clear();
+    processedInstances_ = 0;
+    failedInstances_ = 0;
+    processedStudies_ = 0;
+    totalStudies_ = 0;
+    isLoaded_ = false;
+    pendingStudies_.clear();
+    currentStudy_.clear();
+    currentInstances_.clear();
+    currentRate_ = maxReadRate_;
+    nextStep_ = boost::posix_time::not_a_date_time;
+  }
+
+
+  float ReindexingJob::GetProgress() const
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    if (!isLoaded_)
+    {
+      return 0;
+    }
+    else if (totalStudies_ == 0 ||
+             processedStudies_ >= totalStudies_)
+    {
+      return 1;
+    }
+    else
+    {
+      return (static_cast<float>(processedStudies_) /
+              static_cast<float>(totalStudies_));
+    }
+  }
+
+
+  static const char* const KEY_TYPE = "Type";
+  static const char* const KEY_DESCRIPTION = "Description";
+  static const char* const KEY_USER_DATA = "UserData";
+  static const char* const KEY_THREADS_COUNT = "ThreadsCount";
+  static const char* const KEY_BATCH_SIZE = "BatchSize";
+  static const char* const KEY_MAX_READ_RATE = "MaxReadRate";
+  static const char* const KEY_CURRENT_READ_RATE = "CurrentReadRate";
+  static const char* const KEY_LAST_STUDY = "LastStudy";
+  static const char* const KEY_PROCESSED_INSTANCES = "ProcessedInstances";
+  static const char* const KEY_FAILED_INSTANCES = "FailedInstances";
+  static const char* const KEY_PROCESSED_STUDIES = "ProcessedStudies";
+  static const char* const KEY_TOTAL_STUDIES = "TotalStudies";
+
+
+  void ReindexingJob::GetPublicContent(Json::Value& value) const
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    value = Json::objectValue;
+    value[KEY_DESCRIPTION] = description_;
+    value[KEY_THREADS_COUNT] = threadsCount_;
+    value[KEY_BATCH_SIZE] = batchSize_;
+    value[KEY_MAX_READ_RATE] = static_cast<Json::UInt64>(maxReadRate_);
+    value[KEY_CURRENT_READ_RATE] = static_cast<Json::UInt64>(currentRate_);
+    value[KEY_PROCESSED_INSTANCES] = static_cast<Json::UInt64>(processedInstances_);
+    value[KEY_FAILED_INSTANCES] = static_cast<Json::UInt64>(failedInstances_);
+
+    if (isLoaded_)
+    {
+      value[KEY_PROCESSED_STUDIES] = static_cast<Json::UInt64>(processedStudies_);
+      value[KEY_TOTAL_STUDIES] = static_cast<Json::UInt64>(totalStudies_);
+    }
+
+    if (!lastStudy_.empty())
+    {
+      value[KEY_LAST_STUDY] = lastStudy_;
+    }
+  }
+
+
+  bool ReindexingJob::Serialize(Json::Value& value) const
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    value = Json::objectValue;
+
+    std::string type;
+    GetJobType(type);
+    value[KEY_TYPE] = type;
+
+    value[KEY_DESCRIPTION] = description_;
+    value[KEY_USER_DATA] = userData_;
+    value[KEY_THREADS_COUNT] = threadsCount_;
+    value[KEY_BATCH_SIZE] = batchSize_;
+    value[KEY_MAX_READ_RATE] = boost::lexical_cast<std::string>(maxReadRate_);
+    value[KEY_LAST_STUDY] = lastStudy_;
+    value[KEY_PROCESSED_INSTANCES] = boost::lexical_cast<std::string>(processedInstances_);
+    value[KEY_FAILED_INSTANCES] = boost::lexical_cast<std::string>(failedInstances_);
+
+    return true;
+  }
+
+
+  ReindexingJob::ReindexingJob(ServerContext& context,
+                               const Json::Value& serialized) :
+    context_(context),
+    processedStudies_(0),
+    totalStudies_(0),
+    isLoaded_(false)
+  {
+    description_ = SerializationToolbox::ReadString(serialized, KEY_DESCRIPTION);
+    threadsCount_ = SerializationToolbox::ReadUnsignedInteger(serialized, KEY_THREADS_COUNT);
+    batchSize_ = SerializationToolbox::ReadUnsignedInteger(serialized, KEY_BATCH_SIZE);
+    maxReadRate_ = boost::lexical_cast<uint64_t>(SerializationToolbox::ReadString(serialized, KEY_MAX_READ_RATE));
+    lastStudy_ = SerializationToolbox::ReadString(serialized, KEY_LAST_STUDY);
+    processedInstances_ = boost::lexical_cast<uint64_t>(SerializationToolbox::ReadString(serialized, KEY_PROCESSED_INSTANCES));
+    failedInstances_ = boost::lexical_cast<uint64_t>(SerializationToolbox::ReadString(serialized, KEY_FAILED_INSTANCES));
+    currentRate_ = maxReadRate_;
+
+    if (serialized.isMember(KEY_USER_DATA))
+    {
+      userData_ = serialized[KEY_USER_DATA];
+    }
+
+    if (threadsCount_ == 0 ||
+        batchSize_ == 0)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+  }
+
+
+  bool ReindexingJob::GetUserData(Json::Value& userData) const
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    if (userData_.isNull())
+    {
+      return false;
+    }
+    else
+    {
+      userData = userData_;
+      return true;
+    }
+  }
+
+
+  void ReindexingJob::SetUserData(const Json::Value& userData)
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+    userData_ = userData;
+  }
+}
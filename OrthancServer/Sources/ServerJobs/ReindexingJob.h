@@ -0,0 +1,157 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../../../OrthancFramework/Sources/Compatibility.h"  // For ORTHANC_OVERRIDE
+#include "../../../OrthancFramework/Sources/JobsEngine/IJob.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace Orthanc
+{
+  class ServerContext;
+
+  /**
+   * Job that reconstructs the main DICOM tags of all the studies in
+   * the index, e.g. after a change in "ExtraMainDicomTags". Only the
+   * DICOM headers are read, by several sub-tasks, and the index is
+   * updated by one transaction per batch of instances. The reads are
+   * paced by an I/O budget that is halved as long as the latency of
+   * the ingest rises, then slowly restored. The studies are processed
+   * in the order of their Orthanc identifiers, and the last processed
+   * study is serialized, so that the job resumes where it stopped
+   * after a restart of Orthanc. New in Orthanc 1.12.12.
+   **/
+  class ReindexingJob : public IJob
+  {
+  private:
+    class Header;
+    class HeaderTask;
+
+    struct Item
+    {
+      std::string  study_;
+      std::string  instance_;
+      bool         isLastOfStudy_;
+    };
+
+    ServerContext&          context_;
+    unsigned int            threadsCount_;
+    unsigned int            batchSize_;
+    uint64_t                maxReadRate_;    // In bytes per second, 0 means no limit
+    uint64_t                currentRate_;    // Current pace in bytes per second, 0 means no limit
+    std::string             lastStudy_;      // Last study whose instances are all re-indexed
+    uint64_t                processedInstances_;
+    uint64_t                failedInstances_;
+    size_t                  processedStudies_;
+    size_t                  totalStudies_;
+    std::string             description_;
+    Json::Value             userData_;
+
+    bool                    isLoaded_;       // Whether the studies to process have been listed
+    std::list<std::string>  pendingStudies_;
+    std::string             currentStudy_;
+    std::list<std::string>  currentInstances_;
+    boost::posix_time::ptime  nextStep_;
+
+    mutable boost::recursive_mutex  mutex_;
+
+    void LoadStudies();
+
+    void FillBatch(std::vector<Item>& batch);
+
+    void ReadHeaders(std::vector<Header*>& headers,
+                     const std::vector<Item>& batch);
+
+    void ReconstructInstances(const std::vector<Item>& batch,
+                              const std::vector<Header*>& headers);
+
+    void UpdatePace(uint64_t readBytes,
+                    uint64_t elapsedMicroseconds);
+
+  public:
+    // "maxReadRate" is in bytes per second
+    ReindexingJob(ServerContext& context,
+                  unsigned int threadsCount,
+                  unsigned int batchSize,
+                  uint64_t maxReadRate);
+
+    ReindexingJob(ServerContext& context,
+                  const Json::Value& serialized);
+
+    void SetDescription(const std::string& description);
+
+    std::string GetLastStudy() const;
+
+    size_t GetProcessedStudies() const;
+
+    uint64_t GetProcessedInstances() const;
+
+    virtual void Start() ORTHANC_OVERRIDE;
+
+    virtual JobStepResult Step(const std::string& jobId) ORTHANC_OVERRIDE;
+
+    virtual void Reset() ORTHANC_OVERRIDE;
+
+    virtual void Stop(JobStopReason reason) ORTHANC_OVERRIDE
+    {
+    }
+
+    virtual float GetProgress() const ORTHANC_OVERRIDE;
+
+    virtual void GetJobType(std::string& target) const ORTHANC_OVERRIDE
+    {
+      target = "Reindexing";
+    }
+
+    virtual void GetPublicContent(Json::Value& value) const ORTHANC_OVERRIDE;
+
+    virtual bool Serialize(Json::Value& value) const ORTHANC_OVERRIDE;
+
+    virtual bool GetOutput(std::string& output,
+                           MimeType& mime,
+                           std::string& filename,
+                           const std::string& key) ORTHANC_OVERRIDE
+    {
+      return false;
+    }
+
+    virtual bool DeleteOutput(const std::string& key) ORTHANC_OVERRIDE
+    {
+      return false;
+    }
+
+    virtual bool GetUserData(Json::Value& userData) const ORTHANC_OVERRIDE;
+
+    virtual void SetUserData(const Json::Value& userData) ORTHANC_OVERRIDE;
+
+    virtual void LookupErrorPayload(ErrorPayload& payload) const ORTHANC_OVERRIDE
+    {
+    }
+  };
+}
@@ -237,18 +237,28 @@ namespace Orthanc
      **/
 
     {
-      boost::recursive_mutex::scoped_lock lock(mutex_);  // DicomModification object is not thread safe, we must protect it from here
+      /**
+       * Unless a custom identifier generator or a custom modifier is
+       * installed, the DicomModification object protects its map of
+       * UIDs by itself, which allows the worker threads to modify
+       * several instances at once (new in Orthanc 1.12.12).
+       **/
+      std::unique_ptr<boost::recursive_mutex::scoped_lock> lock;
+      if (!modification_->IsApplyThreadSafe())
+      {
+        lock.reset(new boost::recursive_mutex::scoped_lock(mutex_));  // DicomModification object is not thread safe, we must protect it from here
+      }
 
       modification_->Apply(modified);
+    }
 
-      if (modification_->AreLabelsKept())
-      {
-        GetContext().GetIndex().ListLabels(instanceLabels, instance, ResourceType_Instance);
-        // we must also save the parent labels.  This instance might currently be the only one in the hierarchy and therefore it might be in charge of restoring all labels of the hierarchy
-        GetContext().GetIndex().ListLabels(seriesLabels, originalHasher->HashSeries(), ResourceType_Series);
-        GetContext().GetIndex().ListLabels(studyLabels, originalHasher->HashStudy(), ResourceType_Study);
-        GetContext().GetIndex().ListLabels(patientLabels, originalHasher->HashPatient(), ResourceType_Patient);
-      }
+    if (modification_->AreLabelsKept())
+    {
+      GetContext().GetIndex().ListLabels(instanceLabels, instance, ResourceType_Instance);
+      // we must also save the parent labels.  This instance might currently be the only one in the hierarchy and therefore it might be in charge of restoring all labels of the hierarchy
+      GetContext().GetIndex().ListLabels(seriesLabels, originalHasher->HashSeries(), ResourceType_Series);
+      GetContext().GetIndex().ListLabels(studyLabels, originalHasher->HashStudy(), ResourceType_Study);
+      GetContext().GetIndex().ListLabels(patientLabels, originalHasher->HashPatient(), ResourceType_Patient);
     }
 
     const std::string modifiedUid = IDicomTranscoder::GetSopInstanceUid(modified->GetDcmtkObject());
@@ -0,0 +1,296 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "SharedJobsQueue.h"
+
+#include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/MetricsRegistry.h"
+#include "../../../OrthancFramework/Sources/OrthancException.h"
+#include "../../../OrthancFramework/Sources/Toolbox.h"
+#include "../ServerContext.h"
+#include "OrthancJobUnserializer.h"
+
+
+// The values of the queue have the same format as the jobs in the
+// serialized "JobsRegistry", which allows to directly add them to
+// the local jobs engine
+static const char* const ID = "ID";
+static const char* const STATE = "State";
+static const char* const PRIORITY = "Priority";
+static const char* const JOB = "Job";
+static const char* const CREATION_TIME = "CreationTime";
+static const char* const LAST_CHANGE_TIME = "LastChangeTime";
+static const char* const RUNTIME = "Runtime";
+static const char* const USER_DATA = "UserData";
+
+static const char* const QUEUE_ID = "orthanc-shared-jobs";
+
+
+namespace Orthanc
+{
+  void SharedJobsQueue::Worker(SharedJobsQueue* that)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter("SHARED-JOBS");
+
+    boost::posix_time::ptime lastExecution = boost::posix_time::neg_infin;
+
+    while (!that->done_)
+    {
+      const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+      if ((now - lastExecution).total_milliseconds() >= 1000)
+      {
+        lastExecution = now;
+
+        try
+        {
+          that->MonitorReservedJobs();
+
+          while (!that->done_ &&
+                 that->reserved_.size() < that->maxJobs_ &&
+                 that->ReserveNextJob())
+          {
+          }
+
+          that->context_.GetMetricsRegistry().SetIntegerValue(
+            "orthanc_shared_jobs_queue_size", that->context_.GetIndex().GetQueueSize(QUEUE_ID));
+          that->context_.GetMetricsRegistry().SetIntegerValue(
+            "orthanc_shared_jobs_reserved_count", that->reserved_.size());
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Error while processing the shared queue of jobs: " << e.What();
+        }
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    }
+  }
+
+
+  void SharedJobsQueue::MonitorReservedJobs()
+  {
+    const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+    ReservedJobs::iterator it = reserved_.begin();
+    while (it != reserved_.end())
+    {
+      JobState state;
+      bool completed = (!context_.GetJobsEngine().GetRegistry().GetState(state, it->first) ||  // Job deleted
+                        state == JobState_Success ||
+                        state == JobState_Failure);
+
+      bool forget = completed;
+
+      try
+      {
+        if (completed)
+        {
+          context_.GetIndex().AcknowledgeQueueValue(QUEUE_ID, it->second.valueId_);
+          LOG(INFO) << "Shared job " << it->first << " has completed";
+        }
+        else if ((now - it->second.lastRenewal_).total_seconds() >= static_cast<int64_t>(leaseDuration_ / 2))
+        {
+          // Renew the lease before it expires, while the job is
+          // pending, running, paused or waiting for a retry
+          uint64_t newValueId;
+          context_.GetIndex().RenewQueueValueReservation(newValueId, QUEUE_ID, it->second.valueId_,
+                                                         it->second.value_, leaseDuration_);
+          it->second.valueId_ = newValueId;
+          it->second.lastRenewal_ = now;
+        }
+      }
+      catch (OrthancException& e)
+      {
+        // The lease has expired: The job might have been picked up
+        // by another Orthanc server
+        LOG(WARNING) << "The lease on shared job " << it->first << " was lost: " << e.What();
+        forget = true;
+      }
+
+      if (forget)
+      {
+        reserved_.erase(it++);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+
+
+  bool SharedJobsQueue::ReserveNextJob()
+  {
+    ReservedJob job;
+    if (!context_.GetIndex().ReserveQueueValue(job.value_, job.valueId_, QUEUE_ID, QueueOrigin_Front, leaseDuration_))
+    {
+      return false;  // The queue is empty
+    }
+
+    job.lastRenewal_ = boost::posix_time::microsec_clock::universal_time();
+
+    Json::Value serialized;
+    std::string id;
+
+    if (Toolbox::ReadJson(serialized, job.value_) &&
+        serialized.type() == Json::objectValue &&
+        serialized.isMember(ID) &&
+        serialized[ID].type() == Json::stringValue)
+    {
+      id = serialized[ID].asString();
+    }
+    else
+    {
+      LOG(ERROR) << "Discarding a badly formatted value from the shared queue of jobs";
+      context_.GetIndex().AcknowledgeQueueValue(QUEUE_ID, job.valueId_);
+      return true;
+    }
+
+    JobState state;
+    if (context_.GetJobsEngine().GetRegistry().GetState(state, id))
+    {
+      // This server has already run this job, but its lease was lost
+      // in the meantime: Don't run it twice
+      LOG(WARNING) << "Reserving again shared job " << id << ", which is already known to this Orthanc server";
+    }
+    else
+    {
+      OrthancJobUnserializer unserializer(context_);
+      if (!context_.GetJobsEngine().GetRegistry().AddSerializedJob(unserializer, id, serialized))
+      {
+        // For instance, the job was submitted by a server with
+        // plugins that are not loaded by this server
+        LOG(ERROR) << "Discarding shared job " << id << ", as it cannot be unserialized by this Orthanc server";
+        context_.GetIndex().AcknowledgeQueueValue(QUEUE_ID, job.valueId_);
+        return true;
+      }
+
+      LOG(INFO) << "Shared job " << id << " is run by this Orthanc server";
+    }
+
+    reserved_[id] = job;
+    return true;
+  }
+
+
+  SharedJobsQueue::SharedJobsQueue(ServerContext& context,
+                                   unsigned int leaseDuration,
+                                   unsigned int maxJobs) :
+    context_(context),
+    leaseDuration_(leaseDuration),
+    maxJobs_(maxJobs),
+    done_(true)
+  {
+    if (leaseDuration < 2 ||
+        maxJobs == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (!context.GetIndex().HasReserveQueueValueSupport())
+    {
+      throw OrthancException(ErrorCode_NotImplemented,
+                             "The database backend has no support for the reservation of the values of the queues, "
+                             "which is required by the shared queue of jobs");
+    }
+  }
+
+
+  SharedJobsQueue::~SharedJobsQueue()
+  {
+    if (!done_)
+    {
+      LOG(ERROR) << "SharedJobsQueue::Stop() should have been manually called";
+      Stop();
+    }
+  }
+
+
+  void SharedJobsQueue::Start()
+  {
+    if (!done_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    done_ = false;
+    thread_ = boost::thread(Worker, this);
+  }
+
+
+  void SharedJobsQueue::Stop()
+  {
+    done_ = true;
+
+    if (thread_.joinable())
+    {
+      thread_.join();
+    }
+
+    // The reservations of the jobs that are not completed are left
+    // to expire, so that the other Orthanc servers take them over
+    if (!reserved_.empty())
+    {
+      LOG(WARNING) << "Stopping the shared queue of jobs while " << reserved_.size()
+                   << " shared job(s) are not completed, they will be run by another Orthanc server";
+      reserved_.clear();
+    }
+  }
+
+
+  bool SharedJobsQueue::Submit(std::string& id,
+                               const IJob& job,
+                               int priority)
+  {
+    Json::Value serialized = Json::objectValue;
+    if (!job.Serialize(serialized[JOB]))
+    {
+      return false;
+    }
+
+    const std::string now = boost::posix_time::to_iso_string(boost::posix_time::microsec_clock::universal_time());
+
+    id = Toolbox::GenerateUuid();
+    serialized[ID] = id;
+    serialized[STATE] = EnumerationToString(JobState_Pending);
+    serialized[PRIORITY] = priority;
+    serialized[CREATION_TIME] = now;
+    serialized[LAST_CHANGE_TIME] = now;
+    serialized[RUNTIME] = 0;
+
+    Json::Value userData;
+    if (job.GetUserData(userData))
+    {
+      serialized[USER_DATA] = userData;
+    }
+
+    std::string value;
+    Toolbox::WriteFastJson(value, serialized);
+    context_.GetIndex().EnqueueValue(QUEUE_ID, value);
+
+    LOG(INFO) << "Job " << id << " was submitted to the shared queue of jobs";
+    return true;
+  }
+}
@@ -0,0 +1,90 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2023 Osimis S.A., Belgium
+ * Copyright (C) 2024-2026 Orthanc Team SRL, Belgium
+ * Copyright (C) 2021-2026 Sebastien Jodogne, ICTEAM UCLouvain, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../../../OrthancFramework/Sources/JobsEngine/IJob.h"
+
+#include <boost/thread.hpp>
+#include <map>
+
+namespace Orthanc
+{
+  class ServerContext;
+
+  /**
+   * Queue of jobs that is shared by all the Orthanc servers that use
+   * the same database, on top of the queues of the database index
+   * ("ReserveQueueValue()" and "AcknowledgeQueueValue()"). A job that
+   * is submitted by one server is serialized into the queue, then
+   * reserved for a limited lease by any server, which runs it in its
+   * own jobs engine and renews the lease until the job completes. If
+   * a server stops before the completion, the lease expires and the
+   * job is picked up by another server. The jobs are thus run at
+   * least once. New in Orthanc 1.12.12.
+   **/
+  class SharedJobsQueue : public boost::noncopyable
+  {
+  private:
+    struct ReservedJob
+    {
+      uint64_t                  valueId_;
+      std::string               value_;
+      boost::posix_time::ptime  lastRenewal_;
+    };
+
+    typedef std::map<std::string, ReservedJob>  ReservedJobs;
+
+    ServerContext&  context_;
+    unsigned int    leaseDuration_;
+    unsigned int    maxJobs_;
+    bool            done_;
+    boost::thread   thread_;
+    ReservedJobs    reserved_;  // Only accessed by "thread_"
+
+    static void Worker(SharedJobsQueue* that);
+
+    void MonitorReservedJobs();
+
+    bool ReserveNextJob();
+
+  public:
+    // "leaseDuration" is in seconds, "maxJobs" is the maximum number
+    // of shared jobs that are simultaneously run by this server
+    SharedJobsQueue(ServerContext& context,
+                    unsigned int leaseDuration,
+                    unsigned int maxJobs);
+
+    ~SharedJobsQueue();
+
+    void Start();
+
+    void Stop();
+
+    // Returns "false" if the job cannot be serialized, in which case
+    // it must be submitted to the local jobs engine
+    bool Submit(std::string& id /* out */,
+                const IJob& job,
+                int priority);
+  };
+}
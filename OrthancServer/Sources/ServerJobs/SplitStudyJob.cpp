@@ -58,11 +58,11 @@ namespace Orthanc
   
   bool SplitStudyJob::HandleInstance(const std::string& instance)
   {
-    if (!HasTrailingStep())
-    {
-      throw OrthancException(ErrorCode_BadSequenceOfCalls,
-                             "AddTrailingStep() should have been called after AddSourceSeries()");
-    }
+    /**
+     * This method is called concurrently by several threads. The
+     * target UIDs and the modifications are all chosen before the
+     * job is started, so that they are not modified here.
+     **/
     
     /**
      * Retrieve the DICOM instance to be modified
@@ -125,9 +125,13 @@ namespace Orthanc
     // Fix since Orthanc 1.5.8: Assign new "SOPInstanceUID", as the instance has been modified
     modified->ReplacePlainString(DICOM_TAG_SOP_INSTANCE_UID, FromDcmtkBridge::GenerateUniqueIdentifier(ResourceType_Instance));
 
-    if (targetStudy_.empty())
     {
-      targetStudy_ = modified->GetHasher().HashStudy();
+      boost::recursive_mutex::scoped_lock lock(mutex_);
+
+      if (targetStudy_.empty())
+      {
+        targetStudy_ = modified->GetHasher().HashStudy();
+      }
     }
     
     std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromParsedDicomFile(*modified));
@@ -146,8 +150,10 @@ namespace Orthanc
 
   
   SplitStudyJob::SplitStudyJob(ServerContext& context,
-                               const std::string& sourceStudy) :
-    CleaningInstancesJob(context, false /* by default, remove source instances */),
+                               const std::string& sourceStudy,
+                               unsigned int workersCount) :
+    ThreadedSetOfInstancesJob(context, false /* no post processing step */,
+                              false /* by default, remove source instances */, workersCount),
     sourceStudy_(sourceStudy),
     targetStudyUid_(FromDcmtkBridge::GenerateUniqueIdentifier(ResourceType_Study))
   {
@@ -215,12 +221,7 @@ namespace Orthanc
       // Add all the instances of the series as to be processed
       std::list<std::string> instances;
       GetContext().GetIndex().GetChildren(instances, ResourceType_Series, series);
-
-      for (std::list<std::string>::const_iterator
-             it = instances.begin(); it != instances.end(); ++it)
-      {
-        AddInstance(*it);
-      }
+      AddInstances(instances);
     }    
   }
 
@@ -243,7 +244,10 @@ namespace Orthanc
     else
     {
       RegisterSeries(seriesUidMap_, series);
-      AddInstance(instance);
+
+      std::list<std::string> instances;
+      instances.push_back(instance);
+      AddInstances(instances);
     }    
   }
 
@@ -307,9 +311,18 @@ namespace Orthanc
   }
   
     
+  std::string SplitStudyJob::GetTargetStudy() const
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+    return targetStudy_;
+  }
+
+
   void SplitStudyJob::GetPublicContent(Json::Value& value) const
   {
-    CleaningInstancesJob::GetPublicContent(value);
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    ThreadedSetOfInstancesJob::GetPublicContent(value);
 
     if (!targetStudy_.empty())
     {
@@ -331,15 +344,9 @@ namespace Orthanc
 
   SplitStudyJob::SplitStudyJob(ServerContext& context,
                                const Json::Value& serialized) :
-    CleaningInstancesJob(context, serialized,
-                         false /* by default, remove source instances */)  // (*)
+    ThreadedSetOfInstancesJob(context, serialized, false /* no post processing step */,
+                              false /* by default, remove source instances */)
   {
-    if (!HasTrailingStep())
-    {
-      // Should have been set by (*)
-      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
-    }
-
     Setup();
 
     sourceStudy_ = SerializationToolbox::ReadString(serialized, SOURCE_STUDY);
@@ -354,7 +361,9 @@ namespace Orthanc
   
   bool SplitStudyJob::Serialize(Json::Value& target) const
   {
-    if (!CleaningInstancesJob::Serialize(target))
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    if (!ThreadedSetOfInstancesJob::Serialize(target))
     {
       return false;
     }
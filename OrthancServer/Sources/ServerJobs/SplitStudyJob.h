@@ -25,13 +25,13 @@
 
 #include "../../../OrthancFramework/Sources/DicomFormat/DicomTag.h"
 #include "../DicomInstanceOrigin.h"
-#include "CleaningInstancesJob.h"
+#include "ThreadedSetOfInstancesJob.h"
 
 namespace Orthanc
 {
   class ServerContext;
   
-  class SplitStudyJob : public CleaningInstancesJob
+  class SplitStudyJob : public ThreadedSetOfInstancesJob
   {
   private:
     typedef std::map<std::string, std::string>  SeriesUidMap;
@@ -40,7 +40,7 @@ namespace Orthanc
     
     std::set<DicomTag>     allowedTags_;
     std::string            sourceStudy_;
-    std::string            targetStudy_;
+    std::string            targetStudy_;  // Protected by "mutex_"
     std::string            targetStudyUid_;
     SeriesUidMap           seriesUidMap_;
     DicomInstanceOrigin    origin_;
@@ -52,15 +52,18 @@ namespace Orthanc
     void Setup();
 
     // Make setter methods private to prevent incorrect calls
-    using SetOfInstancesJob::AddParentResource;
-    using SetOfInstancesJob::AddInstance;
+    using ThreadedSetOfInstancesJob::AddParentResource;
+    using ThreadedSetOfInstancesJob::AddInstances;
     
   protected:
     virtual bool HandleInstance(const std::string& instance) ORTHANC_OVERRIDE;
 
   public:
+    // The instances are processed by at most "workersCount" threads
+    // at the same time (new in Orthanc 1.12.12)
     SplitStudyJob(ServerContext& context,
-                  const std::string& sourceStudy);
+                  const std::string& sourceStudy,
+                  unsigned int workersCount);
 
     SplitStudyJob(ServerContext& context,
                   const Json::Value& serialized);
@@ -70,10 +73,7 @@ namespace Orthanc
       return sourceStudy_;
     }
 
-    const std::string& GetTargetStudy() const
-    {
-      return targetStudy_;
-    }
+    std::string GetTargetStudy() const;
 
     const std::string& GetTargetStudyUid() const
     {
@@ -109,10 +109,6 @@ namespace Orthanc
       return origin_;
     }
 
-    virtual void Stop(JobStopReason reason) ORTHANC_OVERRIDE
-    {
-    }
-
     virtual void GetJobType(std::string& target) const ORTHANC_OVERRIDE
     {
       target = "SplitStudy";
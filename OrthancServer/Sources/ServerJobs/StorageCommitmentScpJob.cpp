@@ -29,12 +29,17 @@
 #include "../../../OrthancFramework/Sources/Logging.h"
 #include "../../../OrthancFramework/Sources/OrthancException.h"
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
+#include "../Database/FindRequest.h"
+#include "../Database/FindResponse.h"
 #include "../OrthancConfiguration.h"
+#include "../Search/DatabaseDicomTagConstraint.h"
+#include "../Search/DicomTagConstraint.h"
 #include "../ServerContext.h"
 
 
 static const char* ANSWER = "Answer";
 static const char* CALLED_AET = "CalledAet";            // obsolete from 1.12.10
+static const char* COUNT = "Count";                     // new in 1.12.12
 static const char* INDEX = "Index";
 static const char* LOOKUP = "Lookup";
 static const char* REMOTE_MODALITY = "RemoteModality";  // obsolete from 1.12.10
@@ -45,6 +50,10 @@ static const char* SOP_INSTANCE_UIDS = "SopInstanceUids";
 static const char* TRANSACTION_UID = "TransactionUid";
 static const char* TYPE = "Type";
 
+// Number of SOP instances that are looked up by one single command,
+// and thus by one single request to the database (new in 1.12.12)
+static const size_t LOOKUP_BATCH_SIZE = 500;
+
 
 
 namespace Orthanc
@@ -86,22 +95,30 @@ namespace Orthanc
   };
 
 
+  // Since Orthanc 1.12.12, one lookup command handles a batch of
+  // "count" consecutive SOP instances, starting at "index"
   class StorageCommitmentScpJob::LookupCommand : public StorageCommitmentCommand
   {
   private:
-    StorageCommitmentScpJob&        that_;
-    size_t                          index_;
-    bool                            hasFailureReason_;
-    StorageCommitmentFailureReason  failureReason_;
+    StorageCommitmentScpJob&                     that_;
+    size_t                                       index_;
+    size_t                                       count_;
+    bool                                         hasFailureReasons_;
+    std::vector<StorageCommitmentFailureReason>  failureReasons_;
 
   public:
     LookupCommand(StorageCommitmentScpJob&  that,
-                  size_t index) :
+                  size_t index,
+                  size_t count) :
       that_(that),
       index_(index),
-      hasFailureReason_(false),
-      failureReason_(StorageCommitmentFailureReason_Success)
+      count_(count),
+      hasFailureReasons_(false)
     {
+      if (count == 0)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
     }
 
     virtual CommandType GetType() const ORTHANC_OVERRIDE
@@ -111,8 +128,8 @@ namespace Orthanc
     
     virtual bool Execute(const std::string& jobId) ORTHANC_OVERRIDE
     {
-      failureReason_ = that_.Lookup(index_);
-      hasFailureReason_ = true;
+      that_.Lookup(failureReasons_, index_, count_);
+      hasFailureReasons_ = true;
       return true;
     }
 
@@ -121,11 +138,16 @@ namespace Orthanc
       return index_;
     }
 
-    StorageCommitmentFailureReason GetFailureReason() const
+    size_t GetCount() const
     {
-      if (hasFailureReason_)
+      return count_;
+    }
+
+    const std::vector<StorageCommitmentFailureReason>& GetFailureReasons() const
+    {
+      if (hasFailureReasons_)
       {
-        return failureReason_;
+        return failureReasons_;
       }
       else
       {
@@ -138,6 +160,7 @@ namespace Orthanc
       target = Json::objectValue;
       target[TYPE] = LOOKUP;
       target[INDEX] = static_cast<unsigned int>(index_);
+      target[COUNT] = static_cast<unsigned int>(count_);
     }
   };
 
@@ -201,7 +224,9 @@ namespace Orthanc
       }
       else if (type == LOOKUP)
       {
-        return new LookupCommand(that_, SerializationToolbox::ReadUnsignedInteger(source, INDEX));
+        // The jobs that were serialized before Orthanc 1.12.12 have one lookup per instance
+        return new LookupCommand(that_, SerializationToolbox::ReadUnsignedInteger(source, INDEX),
+                                 SerializationToolbox::ReadUnsignedInteger(source, COUNT, 1));
       }
       else if (type == ANSWER)
       {
@@ -223,6 +248,8 @@ namespace Orthanc
     {
       THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
     }
+
+    size_t nextIndex = 0;
     
     for (size_t i = 0; i < n; i++)
     {
@@ -238,12 +265,19 @@ namespace Orthanc
       if (type == CommandType_Lookup)
       {
         const LookupCommand& lookup = dynamic_cast<const LookupCommand&>(GetCommand(i));
-        if (lookup.GetIndex() != i - 1)
+        if (lookup.GetIndex() != nextIndex)
         {
           THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
         }
+
+        nextIndex += lookup.GetCount();
       }
     }
+
+    if (nextIndex != sopClassUids_.size())
+    {
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
   }
     
 
@@ -256,46 +290,86 @@ namespace Orthanc
   }
 
 
-  StorageCommitmentFailureReason StorageCommitmentScpJob::Lookup(size_t index)
+  void StorageCommitmentScpJob::LookupInDatabase(std::vector<StorageCommitmentFailureReason>& target,
+                                                 size_t index,
+                                                 size_t count)
   {
-#ifndef NDEBUG
-    CheckInvariants();
-#endif
+    // This is the default implementation of Orthanc (if no storage
+    // commitment plugin is installed). The SOP instance UIDs of the
+    // batch are resolved by one single request to the database.
 
-    if (index >= sopClassUids_.size())
+    std::map<std::string, std::vector<std::string> > orthancIds;
+
+    try
     {
-      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+      DicomTagConstraint c(DICOM_TAG_SOP_INSTANCE_UID, ConstraintType_List, false /* case sensitivity */, true /* mandatory */);
+
+      for (size_t i = index; i < index + count; i++)
+      {
+        c.AddValue(sopInstanceUids_[i]);
+      }
+
+      bool isIdentical;
+      std::unique_ptr<DatabaseDicomTagConstraint> dbConstraint(
+        c.ConvertToDatabaseConstraint(isIdentical, ResourceType_Instance, DicomTagType_Identifier));
+
+      if (!isIdentical)
+      {
+        // Same fallback as in "StatelessDatabaseOperations::LookupIdentifierExact()"
+        dbConstraint.reset(c.ConvertToDatabaseConstraint(isIdentical, ResourceType_Instance, DicomTagType_Main));
+      }
+
+      FindRequest request(ResourceType_Instance);
+      request.GetDicomTagConstraints().AddConstraint(dbConstraint.release());
+      request.SetRetrieveMainDicomTags(true);
+
+      FindResponse response;
+      context_.GetIndex().ExecuteFind(response, request);
+
+      for (size_t i = 0; i < response.GetSize(); i++)
+      {
+        const FindResponse::Resource& resource = response.GetResourceByIndex(i);
+
+        DicomMap tags;
+        resource.GetMainDicomTags(tags, ResourceType_Instance);
+
+        // The identifiers are normalized in the database, so only
+        // keep the exact matches
+        std::string sopInstanceUid;
+        if (tags.LookupStringValue(sopInstanceUid, DICOM_TAG_SOP_INSTANCE_UID, false))
+        {
+          orthancIds[sopInstanceUid].push_back(resource.GetIdentifier());
+        }
+      }
     }
-    else if (lookupHandler_.get() != NULL)
+    catch (OrthancException&)  // NOLINT(bugprone-empty-catch)
     {
-      return lookupHandler_->Lookup(sopClassUids_[index], sopInstanceUids_[index]);
     }
-    else
+
+    for (size_t i = index; i < index + count; i++)
     {
-      // This is the default implementation of Orthanc (if no storage
-      // commitment plugin is installed)
       bool success = false;
       StorageCommitmentFailureReason reason =
         StorageCommitmentFailureReason_NoSuchObjectInstance /* 0x0112 == 274 */;
-      
+
+      std::map<std::string, std::vector<std::string> >::const_iterator found = orthancIds.find(sopInstanceUids_[i]);
+
       try
       {
-        std::vector<std::string> orthancId;
-        context_.GetIndex().LookupIdentifierExact(orthancId, ResourceType_Instance, DICOM_TAG_SOP_INSTANCE_UID, sopInstanceUids_[index]);
-
-        if (orthancId.size() == 1)
+        if (found != orthancIds.end() &&
+            found->second.size() == 1)
         {
           std::string a, b;
 
           // Make sure that the DICOM file can be re-read by DCMTK
           // from the file storage, and that the actual SOP
           // class/instance UIDs do match
-          ServerContext::DicomCacheLocker locker(context_, orthancId[0]);
+          ServerContext::DicomCacheLocker locker(context_, found->second[0]);
           if (locker.GetDicom().GetTagValue(a, DICOM_TAG_SOP_CLASS_UID) &&
               locker.GetDicom().GetTagValue(b, DICOM_TAG_SOP_INSTANCE_UID) &&
-              b == sopInstanceUids_[index])
+              b == sopInstanceUids_[i])
           {
-            if (a == sopClassUids_[index])
+            if (a == sopClassUids_[i])
             {
               success = true;
               reason = StorageCommitmentFailureReason_Success;
@@ -313,9 +387,39 @@ namespace Orthanc
       }
 
       LOG(INFO) << "  Storage commitment SCP job: " << (success ? "Success" : "Failure")
-                << " while looking for " << sopClassUids_[index] << " / " << sopInstanceUids_[index];
+                << " while looking for " << sopClassUids_[i] << " / " << sopInstanceUids_[i];
 
-      return reason;
+      target.push_back(reason);
+    }
+  }
+
+
+  void StorageCommitmentScpJob::Lookup(std::vector<StorageCommitmentFailureReason>& target,
+                                       size_t index,
+                                       size_t count)
+  {
+#ifndef NDEBUG
+    CheckInvariants();
+#endif
+
+    if (index + count > sopClassUids_.size())
+    {
+      THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
+    }
+
+    target.clear();
+    target.reserve(count);
+
+    if (lookupHandler_.get() != NULL)
+    {
+      for (size_t i = index; i < index + count; i++)
+      {
+        target.push_back(lookupHandler_->Lookup(sopClassUids_[i], sopInstanceUids_[i]));
+      }
+    }
+    else
+    {
+      LookupInDatabase(target, index, count);
     }
   }
   
@@ -331,7 +435,7 @@ namespace Orthanc
     for (size_t i = 1; i < GetCommandsCount() - 1; i++)
     {
       const LookupCommand& lookup = dynamic_cast<const LookupCommand&>(GetCommand(i));
-      failureReasons.push_back(lookup.GetFailureReason());
+      failureReasons.insert(failureReasons.end(), lookup.GetFailureReasons().begin(), lookup.GetFailureReasons().end());
     }
 
     if (failureReasons.size() != sopClassUids_.size())
@@ -374,7 +478,8 @@ namespace Orthanc
     }
     else
     {
-      SetOfCommandsJob::Reserve(size);
+      // One setup command, the lookup commands, and one answer command
+      SetOfCommandsJob::Reserve(2 + (size + LOOKUP_BATCH_SIZE - 1) / LOOKUP_BATCH_SIZE);
 
       sopClassUids_.reserve(size);
       sopInstanceUids_.reserve(size);
@@ -391,8 +496,8 @@ namespace Orthanc
     }
     else
     {
+      // The lookup commands are created by "MarkAsReady()"
       assert(sopClassUids_.size() == sopInstanceUids_.size());
-      AddCommand(new LookupCommand(*this, sopClassUids_.size()));
       sopClassUids_.push_back(sopClassUid);
       sopInstanceUids_.push_back(sopInstanceUid);
     }
@@ -401,6 +506,16 @@ namespace Orthanc
 
   void StorageCommitmentScpJob::MarkAsReady()
   {
+    if (ready_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    for (size_t i = 0; i < sopClassUids_.size(); i += LOOKUP_BATCH_SIZE)
+    {
+      AddCommand(new LookupCommand(*this, i, std::min(LOOKUP_BATCH_SIZE, sopClassUids_.size() - i)));
+    }
+
     AddCommand(new AnswerCommand(*this));
   }
 
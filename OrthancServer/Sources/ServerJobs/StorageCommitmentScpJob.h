@@ -66,7 +66,13 @@ namespace Orthanc
     
     void Setup(const std::string& jobId);
     
-    StorageCommitmentFailureReason Lookup(size_t index);
+    void LookupInDatabase(std::vector<StorageCommitmentFailureReason>& target,
+                          size_t index,
+                          size_t count);
+
+    void Lookup(std::vector<StorageCommitmentFailureReason>& target,
+                size_t index,
+                size_t count);
     
     void Answer();
     
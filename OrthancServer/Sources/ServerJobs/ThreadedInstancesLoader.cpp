@@ -26,6 +26,11 @@
 #include "../../../OrthancFramework/Sources/Logging.h"
 #include "../../../OrthancFramework/Sources/DicomParsing/IDicomTranscoder.h"
 #include "../../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
+#include "../../../OrthancFramework/Sources/FileStorage/StorageRange.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/IExecutorService.h"
+#include "../../../OrthancFramework/Sources/SystemToolbox.h"
+
+#include <algorithm>
 
 static boost::mutex loaderThreadsCounterMutex;
 static uint32_t loaderThreadsCounter = 0;
@@ -42,20 +47,227 @@ static std::string GetLoaderThreadName(const std::string& prefix)
 
 namespace Orthanc
 {
-  class InstanceToPreload : public Orthanc::IDynamicObject
+  namespace
+  {
+    // Memory budget shared by all the loaders of the process
+    class MemoryBudget : public boost::noncopyable
+    {
+    private:
+      boost::mutex               mutex_;
+      boost::condition_variable  released_;
+      uint64_t                   limit_;
+      uint64_t                   used_;
+
+    public:
+      MemoryBudget() :
+        limit_(0),
+        used_(0)
+      {
+      }
+
+      void SetLimit(uint64_t limit)
+      {
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          limit_ = limit;
+        }
+
+        released_.notify_all();
+      }
+
+      // Returns "false" iff the loader was stopped while waiting. If
+      // "force" is "true", the budget can be exceeded.
+      bool Reserve(uint64_t size,
+                   const bool& shouldStop,
+                   bool force)
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        // An instance that is larger than the whole budget is
+        // accepted as soon as nothing else is loaded
+        while (!force &&
+               limit_ != 0 &&
+               used_ != 0 &&
+               used_ + size > limit_)
+        {
+          if (shouldStop)
+          {
+            return false;
+          }
+
+          released_.timed_wait(lock, boost::posix_time::milliseconds(100));
+        }
+
+        used_ += size;
+        return true;
+      }
+
+      // After transcoding, the size of the loaded file can differ
+      // from the reserved size: no wait, as the file is already loaded
+      void Adjust(uint64_t oldSize,
+                  uint64_t newSize)
+      {
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          assert(used_ >= oldSize);
+          used_ = used_ - oldSize + newSize;
+        }
+
+        if (newSize < oldSize)
+        {
+          released_.notify_all();
+        }
+      }
+
+      void Release(uint64_t size)
+      {
+        Adjust(size, 0);
+      }
+
+      uint64_t GetUsed()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        return used_;
+      }
+
+      uint64_t GetLimit()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        return limit_;
+      }
+    };
+
+    static MemoryBudget globalMemoryBudget_;
+
+
+    // Throughput limit shared by all the loaders of the process: Each
+    // read is delayed until the previous reads have "consumed" their
+    // share of the bandwidth
+    class BandwidthLimiter : public boost::noncopyable
+    {
+    private:
+      boost::mutex              mutex_;
+      uint64_t                  bytesPerSecond_;
+      boost::posix_time::ptime  next_;
+
+    public:
+      BandwidthLimiter() :
+        bytesPerSecond_(0),
+        next_(boost::posix_time::microsec_clock::universal_time())
+      {
+      }
+
+      void SetLimit(uint64_t bytesPerSecond)
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        bytesPerSecond_ = bytesPerSecond;
+      }
+
+      void Acquire(uint64_t size)
+      {
+        boost::posix_time::time_duration delay;
+
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+
+          if (bytesPerSecond_ == 0)
+          {
+            return;
+          }
+
+          const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+          if (next_ < now)
+          {
+            next_ = now;
+          }
+
+          delay = next_ - now;
+          next_ += boost::posix_time::microseconds(static_cast<int64_t>(size * 1000000 / bytesPerSecond_));
+        }
+
+        if (delay.total_microseconds() > 0)
+        {
+          boost::this_thread::sleep(delay);
+        }
+      }
+    };
+
+    static BandwidthLimiter globalBandwidth_;
+  }
+
+
+  namespace
+  {
+    // Statistics over all the loaders of the process, for the metrics
+    class GlobalStatistics : public boost::noncopyable
+    {
+    private:
+      boost::mutex  mutex_;
+      uint64_t      loaders_;
+      uint64_t      queued_;
+      uint64_t      loading_;
+
+    public:
+      GlobalStatistics() :
+        loaders_(0),
+        queued_(0),
+        loading_(0)
+      {
+      }
+
+      void Update(int64_t loaders,
+                  int64_t queued,
+                  int64_t loading)
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        loaders_ += loaders;
+        queued_ += queued;
+        loading_ += loading;
+      }
+
+      void Get(uint64_t& loaders,
+               uint64_t& queued,
+               uint64_t& loading)
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        loaders = loaders_;
+        queued = queued_;
+        loading = loading_;
+      }
+    };
+
+    static GlobalStatistics globalStatistics_;
+  }
+
+
+  // Stride scheduling: A loader with weight "w" progresses by
+  // "STRIDE / w" each time one of its instances is loaded, and the
+  // loader that is the less advanced is served first
+  static const uint64_t STRIDE = 1 << 20;
+
+
+  class ThreadedInstancesLoader::InstanceToPreload : public boost::noncopyable
   {
   private:
     std::string id_;
     FileInfo    fileInfo_;
+    uint64_t    window_;
 
   public:
     InstanceToPreload(const std::string& id,
-                      const FileInfo& fileInfo) :
+                      const FileInfo& fileInfo,
+                      uint64_t window) :
       id_(id),
-      fileInfo_(fileInfo)
+      fileInfo_(fileInfo),
+      window_(window)
     {
     }
 
+    uint64_t GetWindow() const
+    {
+      return window_;
+    }
+
     const std::string& GetId() const
     {
       return id_;
@@ -68,6 +280,471 @@ namespace Orthanc
   };
 
 
+  // DICOM file that was read by a loader thread, and that waits for
+  // the transcoding workers
+  class ThreadedInstancesLoader::PendingTranscoding : public boost::noncopyable
+  {
+  private:
+    std::string                     instanceId_;
+    boost::shared_ptr<std::string>  source_;
+    uint64_t                        reserved_;
+
+  public:
+    PendingTranscoding(const std::string& instanceId,
+                       const boost::shared_ptr<std::string>& source,
+                       uint64_t reserved) :
+      instanceId_(instanceId),
+      source_(source),
+      reserved_(reserved)
+    {
+    }
+
+    const std::string& GetInstanceId() const
+    {
+      return instanceId_;
+    }
+
+    const boost::shared_ptr<std::string>& GetSource() const
+    {
+      return source_;
+    }
+
+    uint64_t GetReserved() const
+    {
+      return reserved_;
+    }
+  };
+
+
+  // One task is submitted to the transcoding workers for each DICOM
+  // file that is read by a loader thread. A running task transcodes
+  // at once all the pending DICOM files of the loader, up to the
+  // batch size, so that the later tasks possibly find nothing left to
+  // do. The load is completed by the destructor, even if the task was
+  // never run because the pool of the transcoding workers was stopped.
+  class ThreadedInstancesLoader::TranscodingTask : public IRunnable
+  {
+  private:
+    ThreadedInstancesLoader&                   loader_;
+    boost::shared_ptr<InstancesLoaderService>  service_;
+    bool                                       done_;
+
+  public:
+    explicit TranscodingTask(ThreadedInstancesLoader& loader) :
+      loader_(loader),
+      service_(loader.service_),
+      done_(false)
+    {
+    }
+
+    virtual ~TranscodingTask()
+    {
+      if (!done_)
+      {
+        std::vector<PendingTranscoding*> batch;
+        loader_.PopPendingTranscodings(batch, 1);
+
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+          LOG(ERROR) << "The transcoding of instance " << batch[i]->GetInstanceId() << " was cancelled";
+          loader_.PublishFailure(batch[i]->GetInstanceId(), batch[i]->GetReserved());
+          delete batch[i];
+        }
+      }
+
+      // This is the last access to the loader, which can be destroyed
+      // as soon as its last load is completed
+      service_->CompleteLoad(loader_);
+    }
+
+    virtual void Run() ORTHANC_OVERRIDE
+    {
+      done_ = true;
+
+      std::vector<PendingTranscoding*> batch;
+      loader_.PopPendingTranscodings(batch, loader_.transcodingBatchSize_);
+
+      if (loader_.loadersShouldStop_)
+      {
+        // The archive job is being stopped: Don't waste CPU
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+          loader_.PublishFailure(batch[i]->GetInstanceId(), batch[i]->GetReserved());
+        }
+      }
+      else if (!batch.empty())
+      {
+        loader_.TranscodeBatch(batch);
+      }
+
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+        delete batch[i];
+      }
+    }
+  };
+
+
+  void InstancesLoaderService::Register(ThreadedInstancesLoader& loader)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    // A new loader starts at the current virtual time, so that it
+    // doesn't get all the threads to catch up with the older loaders
+    loader.pass_ = virtualTime_;
+    loaders_.push_back(&loader);
+
+    globalStatistics_.Update(1, 0, 0);
+  }
+
+
+  void InstancesLoaderService::Unregister(ThreadedInstancesLoader& loader)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    loader.loadersShouldStop_ = true;
+
+    globalStatistics_.Update(-1, -static_cast<int64_t>(loader.queue_.size()), 0);
+
+    for (std::deque<ThreadedInstancesLoader::InstanceToPreload*>::iterator
+           it = loader.queue_.begin(); it != loader.queue_.end(); ++it)
+    {
+      assert(*it != NULL);
+      delete *it;
+    }
+
+    loader.queue_.clear();
+
+    // Wait for the threads that are loading the instances of this
+    // loader, as they will write into the loader
+    while (loader.inProgress_ > 0)
+    {
+      loadComplete_.wait(lock);
+    }
+
+    loaders_.remove(&loader);
+  }
+
+
+  void InstancesLoaderService::Enqueue(ThreadedInstancesLoader& loader,
+                                       const std::string& instanceId,
+                                       const FileInfo& fileInfo)
+  {
+    std::unique_ptr<ThreadedInstancesLoader::InstanceToPreload> instance(
+      new ThreadedInstancesLoader::InstanceToPreload(instanceId, fileInfo, 0));
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!loader.loadersShouldStop_)
+    {
+      loader.queue_.push_back(instance.release());
+      globalStatistics_.Update(0, 1, 0);
+      workAvailable_.notify_one();
+    }
+  }
+
+
+  void InstancesLoaderService::EnqueueWindow(ThreadedInstancesLoader& loader,
+                                             const std::vector<std::pair<std::string, FileInfo> >& instances)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!loader.loadersShouldStop_ &&
+        !instances.empty())
+    {
+      const uint64_t window = loader.nextWindow_;
+
+      for (size_t i = 0; i < instances.size(); i++)
+      {
+        loader.queue_.push_back(new ThreadedInstancesLoader::InstanceToPreload(
+                                  instances[i].first, instances[i].second, window));
+      }
+
+      loader.nextWindow_++;
+      loader.unconsumed_.push_back(instances.size());
+
+      globalStatistics_.Update(0, static_cast<int64_t>(instances.size()), 0);
+      workAvailable_.notify_all();
+    }
+  }
+
+
+  void InstancesLoaderService::ReleaseBytes(ThreadedInstancesLoader& loader,
+                                            const std::string& instanceId)
+  {
+    // The mutex of the service must be locked by the caller
+    std::map<std::string, uint64_t>::iterator found = loader.slotBytes_.find(instanceId);
+    if (found != loader.slotBytes_.end())
+    {
+      assert(loader.usedBytes_ >= found->second);
+      loader.usedBytes_ -= found->second;
+      loader.slotBytes_.erase(found);
+    }
+  }
+
+
+  void InstancesLoaderService::ReleaseSlot(ThreadedInstancesLoader& loader,
+                                           const std::string& instanceId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    assert(loader.usedSlots_ > 0);
+    loader.usedSlots_--;
+    ReleaseBytes(loader, instanceId);
+
+    if (!loader.unconsumed_.empty())
+    {
+      // The instances are consumed in the order of the windows
+      assert(loader.unconsumed_.front() > 0);
+      loader.unconsumed_.front()--;
+
+      if (loader.unconsumed_.front() == 0)
+      {
+        loader.unconsumed_.pop_front();
+        loader.consumerWindow_++;
+      }
+    }
+
+    workAvailable_.notify_all();
+  }
+
+
+  bool InstancesLoaderService::HasRoomForNext(const ThreadedInstancesLoader& loader)
+  {
+    // The mutex of the service must be locked by the caller
+    assert(!loader.queue_.empty());
+
+    if (loader.maxBytes_ == 0)
+    {
+      return loader.usedSlots_ < loader.maxSlots_;
+    }
+    else
+    {
+      const ThreadedInstancesLoader::InstanceToPreload& next = *loader.queue_.front();
+
+      // As in "MemoryBudget::Reserve()", the next instance of the
+      // consumer is never held back by the budget, which must also
+      // hold all the instances of the locality window of the consumer
+      return (loader.usedBytes_ == 0 ||
+              loader.usedBytes_ + next.GetFileInfo().GetUncompressedSize() <= loader.maxBytes_ ||
+              (loader.localityWindow_ > 1 &&
+               next.GetWindow() == loader.consumerWindow_));
+    }
+  }
+
+
+  ThreadedInstancesLoader* InstancesLoaderService::LookupNextLoader() const
+  {
+    // The mutex must be locked by the caller
+    ThreadedInstancesLoader* best = NULL;
+
+    for (std::list<ThreadedInstancesLoader*>::const_iterator it = loaders_.begin(); it != loaders_.end(); ++it)
+    {
+      // Flow control: A loader cannot get too much ahead of its consumer
+      if (!(*it)->queue_.empty() &&
+          HasRoomForNext(**it) &&
+          (best == NULL || (*it)->pass_ < best->pass_))
+      {
+        best = *it;
+      }
+    }
+
+    return best;
+  }
+
+
+  void InstancesLoaderService::Worker(InstancesLoaderService* that,
+                                      std::string threadName)
+  {
+    Logging::ScopedCurrentThreadNameSetter setter(threadName);
+
+    LOG(INFO) << "Loader thread has started";
+
+    {
+      std::set<unsigned int> affinity;
+
+      {
+        boost::mutex::scoped_lock lock(that->mutex_);
+        affinity = that->threadsAffinity_;
+      }
+
+      if (!affinity.empty())
+      {
+        SystemToolbox::SetCurrentThreadAffinity(affinity);
+      }
+    }
+
+    for (;;)
+    {
+      ThreadedInstancesLoader* loader = NULL;
+      std::unique_ptr<ThreadedInstancesLoader::InstanceToPreload> instance;
+      uint64_t reserved = 0;
+      bool hasMemory;
+      bool force;
+
+      {
+        // The memory budget is reserved in the order of the queues,
+        // which is the order of the consumers: An instance is thus
+        // never waiting for the memory held by the next instances of
+        // the same loader, which would result in a deadlock
+        boost::mutex::scoped_lock dispatchLock(that->dispatchMutex_);
+
+        {
+          boost::mutex::scoped_lock lock(that->mutex_);
+
+          while (!that->stopping_ &&
+                 (loader = that->LookupNextLoader()) == NULL)
+          {
+            that->workAvailable_.wait(lock);
+          }
+
+          if (that->stopping_)
+          {
+            LOG(INFO) << "Loader thread has completed";
+            return;
+          }
+
+          assert(loader != NULL);
+          instance.reset(loader->queue_.front());
+          loader->queue_.pop_front();
+          loader->usedSlots_++;
+          loader->inProgress_++;
+
+          const uint64_t size = instance->GetFileInfo().GetUncompressedSize();
+          loader->usedBytes_ += size;
+          loader->slotBytes_[instance->GetId()] += size;
+
+          // If this is the only instance of the loader that is not
+          // consumed yet, its consumer is possibly waiting for it, and
+          // the memory held by the other loaders might only be released
+          // once their own next instance is loaded: Don't wait
+          force = (loader->usedSlots_ == 1);
+
+          // Likewise, within the locality window of the consumer, the
+          // next instance of the consumer can be queued after the
+          // other instances of the window: The budget can thus be
+          // exceeded by (at most) one window per loader
+          if (loader->localityWindow_ > 1 &&
+              instance->GetWindow() == loader->consumerWindow_)
+          {
+            force = true;
+          }
+
+          that->virtualTime_ = loader->pass_;
+          loader->pass_ += STRIDE / loader->weight_;
+
+          globalStatistics_.Update(0, -1, 1);
+        }
+
+        reserved = instance->GetFileInfo().GetUncompressedSize();
+        hasMemory = globalMemoryBudget_.Reserve(reserved, loader->loadersShouldStop_, force);
+      }
+
+      bool deferred = false;
+
+      if (hasMemory)
+      {
+        deferred = loader->LoadInstance(*instance, reserved);
+      }
+      else
+      {
+        // The loader is being stopped
+        boost::mutex::scoped_lock lock(that->mutex_);
+        assert(loader->usedSlots_ > 0);
+        loader->usedSlots_--;
+        ReleaseBytes(*loader, instance->GetId());
+      }
+
+      if (!deferred)
+      {
+        // Otherwise, the load is completed by the transcoding task
+        that->CompleteLoad(*loader);
+      }
+    }
+  }
+
+
+  void InstancesLoaderService::CompleteLoad(ThreadedInstancesLoader& loader)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    assert(loader.inProgress_ > 0);
+    loader.inProgress_--;
+    globalStatistics_.Update(0, 0, -1);
+    loadComplete_.notify_all();
+  }
+
+
+  InstancesLoaderService::InstancesLoaderService() :
+    stopping_(false),
+    virtualTime_(0)
+  {
+  }
+
+
+  InstancesLoaderService::~InstancesLoaderService()
+  {
+    Stop();
+  }
+
+
+  void InstancesLoaderService::SetThreadsAffinity(const std::set<unsigned int>& cpus)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (!threads_.empty())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    threadsAffinity_ = cpus;
+  }
+
+
+  void InstancesLoaderService::Start(size_t countThreads,
+                                     const std::string& nameForLogs4Char)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (stopping_ ||
+        !threads_.empty())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (countThreads < 1)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    for (size_t i = 0; i < countThreads; i++)
+    {
+      threads_.push_back(new boost::thread(Worker, this, ::GetLoaderThreadName(nameForLogs4Char)));
+    }
+  }
+
+
+  void InstancesLoaderService::Stop()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stopping_ = true;
+      workAvailable_.notify_all();
+    }
+
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+      if (threads_[i]->joinable())
+      {
+        threads_[i]->join();
+      }
+
+      delete threads_[i];
+    }
+
+    threads_.clear();
+  }
+
+
   ThreadedInstancesLoader::ThreadedInstancesLoader(ServerContext& context,
                                                    size_t threadCount,
                                                    bool transcode,
@@ -79,9 +756,23 @@ namespace Orthanc
     transferSyntax_(transferSyntax),
     lossyQuality_(lossyQuality),
     nameForLogs4Char_(nameForLogs4Char),
-    availableInstancesSemaphore_(3 * threadCount),
-    instancesToPreload_(0), // no limit on the message queue, the flow control is performed by the availableInstancesSemaphore_
-    loadersShouldStop_(false)
+    service_(context.GetInstancesLoaderService()),
+    ownService_(false),
+    registered_(false),
+    loadersShouldStop_(false),
+    transcodingWorkers_(context.GetArchiveTranscodingWorkers()),
+    transcodingBatchSize_(std::max(1u, context.GetArchiveTranscodingBatchSize())),
+    weight_(threadCount),
+    maxSlots_(3 * threadCount),
+    usedSlots_(0),
+    inProgress_(0),
+    pass_(0),
+    nextWindow_(0),
+    consumerWindow_(0),
+    maxBytes_(0),
+    usedBytes_(0),
+    localityWindow_(0),
+    stagingSize_(0)
   {
     assert(nameForLogs4Char_.size() <= 4);
 
@@ -90,10 +781,16 @@ namespace Orthanc
       THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_InternalError);
     }
 
-    for (size_t i = 0; i < threadCount; i++)
+    if (service_.get() == NULL)
     {
-      threads_.push_back(new boost::thread(PreloaderWorkerThread, this));
+      // No shared loader service: Use private threads, as in Orthanc <= 1.12.11
+      service_.reset(new InstancesLoaderService);
+      service_->Start(threadCount, nameForLogs4Char_);
+      ownService_ = true;
     }
+
+    service_->Register(*this);
+    registered_ = true;
   }
 
 
@@ -108,135 +805,310 @@ namespace Orthanc
       // Don't throw exceptions in destructors
       LOG(ERROR) << "Exception: " << e.What();
     }
+
+    // Should be empty, as all the transcoding tasks have completed
+    for (std::deque<PendingTranscoding*>::iterator
+           it = pendingTranscodings_.begin(); it != pendingTranscodings_.end(); ++it)
+    {
+      assert(*it != NULL);
+      delete *it;
+    }
   }
 
 
   void ThreadedInstancesLoader::Clear(bool isAbort)
   {
-    if (threads_.size() > 0)
+    if (registered_)
     {
-      loadersShouldStop_ = true; // no need to protect this by a mutex. This is the only "writer" and all loaders are "readers"
-
       if (isAbort)
       {
         LOG(INFO) << "Cancelling the loader threads";
-        instancesToPreload_.Clear();
       }
       else
       {
         LOG(INFO) << "Waiting for loader threads to complete";
       }
 
-      // unlock the loaders if they are waiting on this message queue (this happens when the job completes sucessfully)
-      for (size_t i = 0; i < threads_.size(); i++)
+      // The instances that are not loaded yet are discarded, and the
+      // instances being loaded are waited for
+      service_->Unregister(*this);
+      registered_ = false;
+
+      if (ownService_)
       {
-        instancesToPreload_.Enqueue(NULL);
+        service_->Stop();
       }
 
-      // unlock the loaders if they are waiting for room in the availableInstances (this happens when the job is interrupted)
-      availableInstancesSemaphore_.Release(threads_.size());
+      boost::mutex::scoped_lock lock(availableInstancesMutex_);
+      availableInstances_.clear();
 
-      for (size_t i = 0; i < threads_.size(); i++)
+      for (std::map<std::string, uint64_t>::const_iterator
+             it = reservedBytes_.begin(); it != reservedBytes_.end(); ++it)
       {
-        if (threads_[i]->joinable())
-        {
-          threads_[i]->join();
-        }
-        delete threads_[i];
+        globalMemoryBudget_.Release(it->second);
       }
 
-      threads_.clear();
-      availableInstances_.clear();
+      reservedBytes_.clear();
 
       LOG(INFO) << "Waiting for loader threads to complete - done";
     }
   }
 
 
-  void ThreadedInstancesLoader::PreloaderWorkerThread(ThreadedInstancesLoader* that)
+  bool ThreadedInstancesLoader::LoadInstance(const InstanceToPreload& instance,
+                                             uint64_t reserved)
   {
-    Logging::ScopedCurrentThreadNameSetter setter(::GetLoaderThreadName(that->nameForLogs4Char_));
+    const std::string& instanceId = instance.GetId();
+    LOG(INFO) << "Loader thread is loading instance " << instanceId;
 
-    LOG(INFO) << "Loader thread has started";
+    boost::shared_ptr<std::string> dicomContent(new std::string());
 
-    while (true)
+    try
+    {
+      // bulk read: don't let the preloaded instances evict the hot files from the storage cache
+      globalBandwidth_.Acquire(instance.GetFileInfo().GetCompressedSize());
+      context_.ReadAttachmentWithoutCacheAdmission(*dicomContent, instance.GetFileInfo());
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "Failed to load instance " << instanceId << " error: " << e.GetDetails();
+      PublishFailure(instanceId, reserved);
+      return false;
+    }
+    catch (...)
     {
-      that->availableInstancesSemaphore_.Acquire(1); // reserve the slot early (since the instances are ordered, it is important that a single worker does not push dozens of small instances while we are waiting for a slot for a big instance)
+      LOG(ERROR) << "Failed to load instance " << instanceId << " unknown error";
+      PublishFailure(instanceId, reserved);
+      return false;
+    }
 
-      std::unique_ptr<InstanceToPreload> instanceToPreload(dynamic_cast<InstanceToPreload*>(that->instancesToPreload_.Dequeue(0)));
-      if (instanceToPreload.get() == NULL || that->loadersShouldStop_)  // that's the signal to exit the thread
+    if (transcode_ &&
+        transcodingWorkers_.get() != NULL)
+    {
+      // The loader thread is released for the next read, while the
+      // CPU-bound transcoding is done by the dedicated workers
       {
-        LOG(INFO) << "Loader thread has completed";
-        return;
+        boost::mutex::scoped_lock lock(pendingTranscodingsMutex_);
+        pendingTranscodings_.push_back(new PendingTranscoding(instanceId, dicomContent, reserved));
       }
 
-      const std::string& instanceId = instanceToPreload->GetId();
-      LOG(INFO) << "Loader thread is loading instance " << instanceId;
-
       try
       {
-        boost::shared_ptr<std::string> dicomContent(new std::string());
-        that->context_.ReadAttachment(*dicomContent, instanceToPreload->GetFileInfo(), true);
-
-        if (that->transcode_)
-        {
-          boost::shared_ptr<std::string> transcodedDicom(new std::string());
-          if (that->TranscodeDicom(*transcodedDicom, *dicomContent, instanceId))
-          {
-            dicomContent = transcodedDicom;
-          }
-        }
-
-        {
-          boost::mutex::scoped_lock lock(that->availableInstancesMutex_);
-          that->availableInstances_[instanceId] = dicomContent;
-          that->condInstanceAvailable_.notify_one();
-        }
+        transcodingWorkers_->Submit(new TranscodingTask(*this));
       }
-      catch (OrthancException& e)
+      catch (OrthancException&)
       {
-        LOG(ERROR) << "Failed to load instance " << instanceId << " error: " << e.GetDetails();
-        boost::mutex::scoped_lock lock(that->availableInstancesMutex_);
-        // store a NULL result to notify that we could not read the instance
-        that->availableInstances_[instanceId] = boost::shared_ptr<std::string>();
-        that->condInstanceAvailable_.notify_one();
+        // The workers are stopped: The failure and the completion of
+        // the load are reported by the destructor of the task
       }
-      catch (...)
+
+      return true;
+    }
+
+    try
+    {
+      if (transcode_)
       {
-        LOG(ERROR) << "Failed to load instance " << instanceId << " unknown error";
-        boost::mutex::scoped_lock lock(that->availableInstancesMutex_);
-        // store a NULL result to notify that we could not read the instance
-        that->availableInstances_[instanceId] = boost::shared_ptr<std::string>();
-        that->condInstanceAvailable_.notify_one();
+        boost::shared_ptr<std::string> transcodedDicom(new std::string());
+        if (TranscodeDicom(*transcodedDicom, *dicomContent, instanceId))
+        {
+          dicomContent = transcodedDicom;
+        }
       }
+
+      PublishInstance(instanceId, dicomContent, reserved);
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "Failed to load instance " << instanceId << " error: " << e.GetDetails();
+      PublishFailure(instanceId, reserved);
+    }
+    catch (...)
+    {
+      LOG(ERROR) << "Failed to load instance " << instanceId << " unknown error";
+      PublishFailure(instanceId, reserved);
     }
+
+    return false;
+  }
+
+
+  void ThreadedInstancesLoader::PublishInstance(const std::string& instanceId,
+                                                const boost::shared_ptr<std::string>& dicomContent,
+                                                uint64_t reserved)
+  {
+    globalMemoryBudget_.Adjust(reserved, dicomContent->size());
+
+    boost::mutex::scoped_lock lock(availableInstancesMutex_);
+    availableInstances_[instanceId] = dicomContent;
+    reservedBytes_[instanceId] += dicomContent->size();
+    condInstanceAvailable_.notify_all();
+  }
+
+
+  void ThreadedInstancesLoader::PublishFailure(const std::string& instanceId,
+                                               uint64_t reserved)
+  {
+    globalMemoryBudget_.Release(reserved);
+
+    boost::mutex::scoped_lock lock(availableInstancesMutex_);
+    // store a NULL result to notify that we could not read the instance
+    availableInstances_[instanceId] = boost::shared_ptr<std::string>();
+    condInstanceAvailable_.notify_all();
+  }
+
+
+  static bool IsLessAttachmentUuid(const std::pair<std::string, FileInfo>& a,
+                                   const std::pair<std::string, FileInfo>& b)
+  {
+    return a.second.GetUuid() < b.second.GetUuid();
+  }
+
+
+  void ThreadedInstancesLoader::FlushLocalityWindow()
+  {
+    if (!staging_.empty())
+    {
+      // In "FilesystemStorage", the path of an attachment is derived
+      // from its UUID, so that the sorted files are close together
+      std::sort(staging_.begin(), staging_.end(), IsLessAttachmentUuid);
+      service_->EnqueueWindow(*this, staging_);
+
+      staging_.clear();
+      stagingSize_ = 0;
+    }
+  }
+
+
+  void ThreadedInstancesLoader::SetLocalityWindow(size_t count)
+  {
+    boost::mutex::scoped_lock lock(service_->mutex_);
+
+    if (!queue_.empty() ||
+        !staging_.empty() ||
+        usedSlots_ != 0)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    localityWindow_ = count;
+
+    // All the instances of one window must fit in the slots of the
+    // loader, as the consumer might wait for the last one
+    if (count > maxSlots_)
+    {
+      maxSlots_ = count;
+    }
+  }
+
+
+  void ThreadedInstancesLoader::SetMemoryBudget(uint64_t bytes)
+  {
+    boost::mutex::scoped_lock lock(service_->mutex_);
+
+    if (!queue_.empty() ||
+        !staging_.empty() ||
+        usedSlots_ != 0)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    maxBytes_ = bytes;
+  }
+
+
+  bool ThreadedInstancesLoader::IsStreamed(const FileInfo& fileInfo) const
+  {
+    // Only the raw DICOM files can be read by chunks: The compressed
+    // attachments and the transcoded instances must be fully loaded
+    return (maxBytes_ != 0 &&
+            fileInfo.GetUncompressedSize() > maxBytes_ &&
+            fileInfo.GetCompressionType() == CompressionType_None &&
+            !transcode_);
+  }
+
+
+  void ThreadedInstancesLoader::ReadStreamedChunk(std::string& chunk,
+                                                  const FileInfo& fileInfo,
+                                                  uint64_t offset,
+                                                  size_t size)
+  {
+    if (!IsStreamed(fileInfo) ||
+        size == 0 ||
+        offset + size > fileInfo.GetCompressedSize())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    StorageRange range;
+    range.SetStartInclusive(offset);
+    range.SetEndInclusive(offset + size - 1);
+
+    globalBandwidth_.Acquire(size);
+    context_.ReadAttachmentRange(chunk, fileInfo, range, false /* raw access is sufficient */);
+  }
+
+
+  void ThreadedInstancesLoader::ReadStreamedHeader(std::string& header,
+                                                   const std::string& instanceId)
+  {
+    context_.ReadDicomForHeader(header, instanceId);
   }
 
 
   void ThreadedInstancesLoader::PreloadDicomInstance(const std::string& instanceId,
                                                      const FileInfo& fileInfo)
   {
-    instancesToPreload_.Enqueue(new InstanceToPreload(instanceId, fileInfo));
+    if (IsStreamed(fileInfo))
+    {
+      // Read by chunks in "ReadStreamedChunk()", bypassing the budget
+      return;
+    }
+    else if (localityWindow_ <= 1)
+    {
+      service_->Enqueue(*this, instanceId, fileInfo);
+    }
+    else
+    {
+      staging_.push_back(std::make_pair(instanceId, fileInfo));
+      stagingSize_ += fileInfo.GetUncompressedSize();
+
+      const uint64_t budget = globalMemoryBudget_.GetLimit();
+
+      if (staging_.size() >= localityWindow_ ||
+          (budget != 0 &&
+           stagingSize_ >= budget / 2))
+      {
+        FlushLocalityWindow();
+      }
+    }
   }
 
 
   void ThreadedInstancesLoader::WaitDicomInstance(std::string& dicom,
                                                   const std::string& instanceId)
   {
-    boost::mutex::scoped_lock lock(availableInstancesMutex_);
+    boost::shared_ptr<std::string> dicomContent;
+
+    // The last window is incomplete if the preloading is over
+    FlushLocalityWindow();
 
-    // wait for this instance to be available but this might not be the one we are waiting for !
-    while (availableInstances_.find(instanceId) == availableInstances_.end())
     {
-      condInstanceAvailable_.wait(lock);
-    }
+      boost::mutex::scoped_lock lock(availableInstancesMutex_);
 
-    boost::shared_ptr<std::string> dicomContent;
+      // wait for this instance to be available but this might not be the one we are waiting for !
+      while (availableInstances_.find(instanceId) == availableInstances_.end())
+      {
+        condInstanceAvailable_.wait(lock);
+      }
 
-    // this is the instance we were waiting for
-    dicomContent = availableInstances_[instanceId];
-    availableInstances_.erase(instanceId);
-    availableInstancesSemaphore_.Release(1);
+      // this is the instance we were waiting for
+      dicomContent = availableInstances_[instanceId];
+      availableInstances_.erase(instanceId);
+      ReleaseReservation(instanceId);
+    }
+
+    service_->ReleaseSlot(*this, instanceId);
 
     if (dicomContent.get() == NULL)  // there has been an error while reading the file
     {
@@ -273,4 +1145,133 @@ namespace Orthanc
 
     return false;
   }
+
+
+  void ThreadedInstancesLoader::PopPendingTranscodings(std::vector<PendingTranscoding*>& target,
+                                                       size_t maxCount)
+  {
+    target.clear();
+
+    boost::mutex::scoped_lock lock(pendingTranscodingsMutex_);
+
+    while (target.size() < maxCount &&
+           !pendingTranscodings_.empty())
+    {
+      target.push_back(pendingTranscodings_.front());
+      pendingTranscodings_.pop_front();
+    }
+  }
+
+
+  void ThreadedInstancesLoader::TranscodeBatch(const std::vector<PendingTranscoding*>& batch)
+  {
+    std::set<DicomTransferSyntax> syntaxes;
+    syntaxes.insert(transferSyntax_);
+
+    std::vector<boost::shared_ptr<IDicomTranscoder::DicomImage> > images;
+    std::vector<IDicomTranscoder::DicomImage*> sources, targets;
+    std::vector<bool> success;
+
+    try
+    {
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+        boost::shared_ptr<IDicomTranscoder::DicomImage> source(new IDicomTranscoder::DicomImage);
+        source->SetExternalBuffer(*batch[i]->GetSource());
+        images.push_back(source);
+        sources.push_back(source.get());
+
+        boost::shared_ptr<IDicomTranscoder::DicomImage> target(new IDicomTranscoder::DicomImage);
+        images.push_back(target);
+        targets.push_back(target.get());
+      }
+
+      context_.GetTranscoder().TranscodeBatch(success, targets, sources, syntaxes,
+                                              TranscodingSopInstanceUidMode_AllowNew, lossyQuality_);
+    }
+    catch (OrthancException& e)
+    {
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+        LOG(ERROR) << "Failed to transcode instance " << batch[i]->GetInstanceId() << " error: " << e.GetDetails();
+        PublishFailure(batch[i]->GetInstanceId(), batch[i]->GetReserved());
+      }
+
+      return;
+    }
+    catch (...)
+    {
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+        LOG(ERROR) << "Failed to transcode instance " << batch[i]->GetInstanceId() << " unknown error";
+        PublishFailure(batch[i]->GetInstanceId(), batch[i]->GetReserved());
+      }
+
+      return;
+    }
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+      const std::string& instanceId = batch[i]->GetInstanceId();
+
+      try
+      {
+        if (success[i])
+        {
+          boost::shared_ptr<std::string> transcoded(new std::string());
+          transcoded->assign(reinterpret_cast<const char*>(targets[i]->GetBufferData()), targets[i]->GetBufferSize());
+          PublishInstance(instanceId, transcoded, batch[i]->GetReserved());
+        }
+        else
+        {
+          LOG(INFO) << "Cannot transcode instance " << instanceId
+                    << " to transfer syntax: " << GetTransferSyntaxUid(transferSyntax_);
+          PublishInstance(instanceId, batch[i]->GetSource(), batch[i]->GetReserved());
+        }
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Failed to transcode instance " << instanceId << " error: " << e.GetDetails();
+        PublishFailure(instanceId, batch[i]->GetReserved());
+      }
+    }
+  }
+
+
+  void ThreadedInstancesLoader::ReleaseReservation(const std::string& instanceId)
+  {
+    // The mutex "availableInstancesMutex_" must be locked
+    std::map<std::string, uint64_t>::iterator found = reservedBytes_.find(instanceId);
+    if (found != reservedBytes_.end())
+    {
+      globalMemoryBudget_.Release(found->second);
+      reservedBytes_.erase(found);
+    }
+  }
+
+
+  void ThreadedInstancesLoader::SetGlobalMemoryBudget(uint64_t bytes)
+  {
+    globalMemoryBudget_.SetLimit(bytes);
+  }
+
+
+  uint64_t ThreadedInstancesLoader::GetGlobalMemoryUsage()
+  {
+    return globalMemoryBudget_.GetUsed();
+  }
+
+
+  void ThreadedInstancesLoader::SetGlobalMaxBandwidth(uint64_t bytesPerSecond)
+  {
+    globalBandwidth_.SetLimit(bytesPerSecond);
+  }
+
+
+  void ThreadedInstancesLoader::GetGlobalStatistics(uint64_t& loaders,
+                                                    uint64_t& queuedInstances,
+                                                    uint64_t& loadingInstances)
+  {
+    globalStatistics_.Get(loaders, queuedInstances, loadingInstances);
+  }
 }
@@ -25,20 +25,103 @@
 #include "../../../OrthancFramework/Sources/Compatibility.h"
 #include "../../../OrthancFramework/Sources/Enumerations.h"
 #include "../../../OrthancFramework/Sources/FileStorage/FileInfo.h"
-#include "../../../OrthancFramework/Sources/MultiThreading/BlockingSharedMessageQueue.h"
-#include "../../../OrthancFramework/Sources/MultiThreading/Semaphore.h"
 
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 
 
 namespace Orthanc
 {
+  class IExecutorService;
   class ServerContext;
+  class ThreadedInstancesLoader;
+
+  /**
+   * Pool of threads that load the DICOM files on behalf of several
+   * instances loaders. The loaders are served in a fair way, each
+   * loader getting a share of the threads that is proportional to its
+   * weight (stride scheduling). The total number of loader threads is
+   * thus bounded, whatever the number of running jobs (new in Orthanc
+   * 1.12.12).
+   **/
+  class InstancesLoaderService : public boost::noncopyable
+  {
+    friend class ThreadedInstancesLoader;
+
+  private:
+    boost::mutex                          mutex_;
+    boost::condition_variable             workAvailable_;
+    boost::condition_variable             loadComplete_;
+    boost::mutex                          dispatchMutex_;  // Reserve the memory budget in the order of the instances
+    std::list<ThreadedInstancesLoader*>   loaders_;
+    std::vector<boost::thread*>           threads_;
+    bool                                  stopping_;
+    uint64_t                              virtualTime_;
+    std::set<unsigned int>                threadsAffinity_;
+
+    void Register(ThreadedInstancesLoader& loader);
+
+    void Unregister(ThreadedInstancesLoader& loader);
+
+    void Enqueue(ThreadedInstancesLoader& loader,
+                 const std::string& instanceId,
+                 const FileInfo& fileInfo);
+
+    void EnqueueWindow(ThreadedInstancesLoader& loader,
+                       const std::vector<std::pair<std::string, FileInfo> >& instances);
+
+    void ReleaseSlot(ThreadedInstancesLoader& loader,
+                     const std::string& instanceId);
+
+    void CompleteLoad(ThreadedInstancesLoader& loader);
+
+    static void ReleaseBytes(ThreadedInstancesLoader& loader,
+                             const std::string& instanceId);
+
+    static bool HasRoomForNext(const ThreadedInstancesLoader& loader);
+
+    ThreadedInstancesLoader* LookupNextLoader() const;
+
+    static void Worker(InstancesLoaderService* that,
+                       std::string threadName);
+
+  public:
+    InstancesLoaderService();
+
+    ~InstancesLoaderService();
+
+    // Pins the loader threads to the given CPUs (empty means no
+    // affinity). Must be invoked before "Start()".
+    void SetThreadsAffinity(const std::set<unsigned int>& cpus);
+
+    void Start(size_t countThreads,
+               const std::string& nameForLogs4Char);
+
+    void Stop();
+
+    size_t GetThreadsCount() const
+    {
+      return threads_.size();
+    }
+  };
+
 
   class ThreadedInstancesLoader ORTHANC_FINAL : public boost::noncopyable
   {
+    friend class InstancesLoaderService;
+
   private:
+    class InstanceToPreload;
+    class PendingTranscoding;
+    class TranscodingTask;
+
     // Parameters from the constructor
     ServerContext&                      context_;
     bool                                transcode_;
@@ -50,18 +133,67 @@ namespace Orthanc
     boost::condition_variable           condInstanceAvailable_;
     std::map<std::string, boost::shared_ptr<std::string> >  availableInstances_;
     boost::mutex                        availableInstancesMutex_;
-    Semaphore                           availableInstancesSemaphore_;
-    BlockingSharedMessageQueue          instancesToPreload_;
-    std::vector<boost::thread*>         threads_;
+    std::map<std::string, uint64_t>     reservedBytes_;  // Protected by "availableInstancesMutex_"
+    boost::shared_ptr<InstancesLoaderService>  service_;
+    bool                                ownService_;     // Whether "service_" is private to this loader
+    bool                                registered_;
     bool                                loadersShouldStop_;
+    boost::shared_ptr<IExecutorService> transcodingWorkers_;  // NULL if transcoding by the loader threads
+    size_t                              transcodingBatchSize_;
+    std::deque<PendingTranscoding*>     pendingTranscodings_;   // Protected by "pendingTranscodingsMutex_"
+    boost::mutex                        pendingTranscodingsMutex_;
+
+    // Scheduling state, protected by the mutex of "service_"
+    std::deque<InstanceToPreload*>      queue_;
+    size_t                              weight_;
+    size_t                              maxSlots_;
+    size_t                              usedSlots_;      // Instances being loaded or waiting for the consumer
+    size_t                              inProgress_;     // Instances being loaded
+    uint64_t                            pass_;
+    uint64_t                            nextWindow_;     // Index of the next locality window to be enqueued
+    uint64_t                            consumerWindow_; // Index of the locality window of the consumer
+    std::deque<size_t>                  unconsumed_;     // Number of unconsumed instances in each window
+    uint64_t                            maxBytes_;       // Byte budget of the loader ("0" means bounded by "maxSlots_")
+    uint64_t                            usedBytes_;      // Bytes of the instances being loaded or waiting for the consumer
+    std::map<std::string, uint64_t>     slotBytes_;      // Bytes that are charged to "usedBytes_" by each instance
+
+    // Locality windows, only accessed by the consumer thread
+    size_t                              localityWindow_;
+    std::vector<std::pair<std::string, FileInfo> >  staging_;
+    uint64_t                            stagingSize_;
+
+    void FlushLocalityWindow();
 
-    static void PreloaderWorkerThread(ThreadedInstancesLoader* that);
+    void ReleaseReservation(const std::string& instanceId);
+
+    // Returns "true" iff the DICOM file was handed over to the
+    // transcoding workers, which then complete the load
+    bool LoadInstance(const InstanceToPreload& instance,
+                      uint64_t reserved);
+
+    void PublishInstance(const std::string& instanceId,
+                         const boost::shared_ptr<std::string>& dicomContent,
+                         uint64_t reserved);
+
+    void PublishFailure(const std::string& instanceId,
+                        uint64_t reserved);
 
     bool TranscodeDicom(std::string& transcodedBuffer,
                         const std::string& sourceBuffer,
                         const std::string& instanceId);
 
+    // Pops at most "maxCount" of the DICOM files that wait for the
+    // transcoding workers, which are owned by the caller
+    void PopPendingTranscodings(std::vector<PendingTranscoding*>& target,
+                                size_t maxCount);
+
+    // Transcodes the DICOM files at once, then publishes them
+    void TranscodeBatch(const std::vector<PendingTranscoding*>& batch);
+
   public:
+    // If the context has a shared loader service, "threadCount" is
+    // the weight of this loader in the service. Otherwise, the loader
+    // starts its own "threadCount" threads.
     ThreadedInstancesLoader(ServerContext& context,
                             size_t threadCount,
                             bool transcode,
@@ -73,10 +205,78 @@ namespace Orthanc
 
     void Clear(bool isAbort);
 
+    /**
+     * Read the DICOM files by windows of "count" consecutive
+     * instances, each window being sorted by the UUID of the
+     * attachments, which favors the locality of the reads in the
+     * storage area. The instances are still consumed in the order of
+     * "PreloadDicomInstance()". The size of a window is also bounded
+     * by half the global memory budget. Must be called before the
+     * first preload. A value of "0" or "1" reads the DICOM files in
+     * the order of the consumers (new in Orthanc 1.12.12).
+     **/
+    void SetLocalityWindow(size_t count);
+
+    /**
+     * Bound the total size of the DICOM files that are loaded ahead
+     * of the consumer of this loader, as given by their "FileInfo",
+     * instead of their number. The instances that are larger than
+     * this budget are not preloaded: They must be streamed by chunks
+     * by the consumer, if "IsStreamed()" is "true". Must be called
+     * before the first preload. A value of "0" uses the default
+     * window of instances (new in Orthanc 1.12.12).
+     **/
+    void SetMemoryBudget(uint64_t bytes);
+
+    bool IsStreamed(const FileInfo& fileInfo) const;
+
+    void ReadStreamedChunk(std::string& chunk,
+                           const FileInfo& fileInfo,
+                           uint64_t offset,
+                           size_t size);
+
+    // The DICOM file up to the pixel data, for the DICOMDIR of the
+    // streamed instances
+    void ReadStreamedHeader(std::string& header,
+                            const std::string& instanceId);
+
     void PreloadDicomInstance(const std::string& instanceId,
                               const FileInfo& fileInfo);
 
     void WaitDicomInstance(std::string& dicom,
                            const std::string& instanceId);
+
+    bool IsTranscoding() const
+    {
+      return transcode_;
+    }
+
+    DicomTransferSyntax GetTargetTransferSyntax() const
+    {
+      return transferSyntax_;
+    }
+
+    /**
+     * Bound the total size of the DICOM files that are loaded ahead
+     * of their consumers, summed over all the loaders of the process
+     * ("0" means no limit). An instance that does not fit waits for
+     * the consumers to release some memory.
+     **/
+    static void SetGlobalMemoryBudget(uint64_t bytes);
+
+    static uint64_t GetGlobalMemoryUsage();
+
+    /**
+     * Bound the total read throughput of the loaders, in bytes per
+     * second ("0" means no limit), so that the background jobs don't
+     * starve the ingest of the storage bandwidth (new in Orthanc
+     * 1.12.12).
+     **/
+    static void SetGlobalMaxBandwidth(uint64_t bytesPerSecond);
+
+    // Statistics over all the loaders of the process, for the metrics
+    static void GetGlobalStatistics(uint64_t& loaders,
+                                    uint64_t& queuedInstances,
+                                    uint64_t& loadingInstances);
   };
 }
@@ -28,24 +28,30 @@
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
 #include "../ServerContext.h"
 
-#include <boost/lexical_cast.hpp>
 #include <cassert>
 
-static boost::mutex instanceWorkerThreadsCounterMutex;
-static uint32_t instanceWorkerThreadsCounter = 0;
-
-static std::string GetInstanceWorkerThreadName()
+namespace Orthanc
 {
-  boost::mutex::scoped_lock lock(instanceWorkerThreadsCounterMutex);
-  std::string threadName = std::string("JOB-INS-WORK-") + boost::lexical_cast<std::string>(instanceWorkerThreadsCounter++);
-  instanceWorkerThreadsCounter %= 1000;
+  class ThreadedSetOfInstancesJob::InstanceTask : public IRunnable
+  {
+  private:
+    ThreadedSetOfInstancesJob&  that_;
+    std::string                 instance_;
 
-  return threadName;
-}
+  public:
+    InstanceTask(ThreadedSetOfInstancesJob& that,
+                 const std::string& instance) :
+      that_(that),
+      instance_(instance)
+    {
+    }
+
+    virtual void Run() ORTHANC_OVERRIDE
+    {
+      that_.ProcessInstance(instance_);
+    }
+  };
 
-namespace Orthanc
-{
-  static const char* EXIT_WORKER_MESSAGE = "exit";
 
    ThreadedSetOfInstancesJob::ThreadedSetOfInstancesJob(ServerContext& context,
                                                         bool hasPostProcessing,
@@ -77,9 +83,13 @@ namespace Orthanc
   {
     // no need to lock mutex here since we access variables used only by the "master" thread
 
-    for (size_t i = 0; i < workersCount; i++)
+    // at most "workersCount" instances are processed at the same time, by the threads shared by all the jobs, by the idle
+    // workers of the jobs engine, and by the "master" thread itself while it waits for the sub-tasks
+    instancesTasks_.reset(new JobTasksExecutor::Group(context_.GetJobsEngine().GetTasksExecutor(), workersCount));
+
+    for (std::set<std::string>::const_iterator it = instancesToProcess_.begin(); it != instancesToProcess_.end(); ++it)
     {
-      instancesWorkers_.push_back(boost::shared_ptr<boost::thread>(new boost::thread(InstanceWorkerThread, this)));
+      instancesTasks_->Submit(new InstanceTask(*this, *it));
     }
   }
 
@@ -88,21 +98,11 @@ namespace Orthanc
   {
     // no need to lock mutex here since we access variables used only by the "master" thread
 
-    // send a dummy "exit" message to all workers such that they stop waiting for messages on the queue
-    for (size_t i = 0; i < instancesWorkers_.size(); i++)
+    if (instancesTasks_.get() != NULL)
     {
-      instancesToProcessQueue_.Enqueue(new SingleValueObject<std::string>(EXIT_WORKER_MESSAGE));
-    }
-
-    for (size_t i = 0; i < instancesWorkers_.size(); i++)
-    {
-      if (instancesWorkers_[i]->joinable())
-      {
-        instancesWorkers_[i]->join();
-      }
+      instancesTasks_->Wait(0);
+      instancesTasks_.reset();
     }
-
-    instancesWorkers_.clear();
   }
 
 
@@ -110,8 +110,12 @@ namespace Orthanc
   {
     boost::recursive_mutex::scoped_lock lock(mutex_);
 
-    instancesToProcessQueue_.Clear();
     stopRequested_ = true;
+
+    if (instancesTasks_.get() != NULL)
+    {
+      instancesTasks_->Cancel();
+    }
   }
 
 
@@ -154,23 +158,16 @@ namespace Orthanc
     {
       if (currentStep_ == ThreadedJobStep_NotStarted)
       {
-        // create the workers and enqueue all instances
-        for (std::set<std::string>::const_iterator it = instancesToProcess_.begin(); it != instancesToProcess_.end(); ++it)
-        {
-          instancesToProcessQueue_.Enqueue(new SingleValueObject<std::string>(*it));
-        }
-
+        // submit all instances as sub-tasks
         InitWorkers(workersCount_);
         currentStep_ = ThreadedJobStep_ProcessingInstances;
       }
       else if (currentStep_ == ThreadedJobStep_ProcessingInstances)
       {
-        // wait until all instances are processed by the workers
-        if (instancesToProcessQueue_.GetSize() != 0)
+        // help processing the instances, and regularly give the hand back to the jobs engine to handle pause/cancel
+        if (instancesTasks_.get() != NULL &&
+            !instancesTasks_->Wait(100))
         {
-          // "slow down" the job main thread, to avoid using 100% of a core simply to check that other threads are done
-          boost::this_thread::sleep(boost::posix_time::milliseconds(5));
-
           return JobStepResult::Continue();
         }
         else
@@ -254,58 +251,50 @@ namespace Orthanc
   }
 
 
-  void ThreadedSetOfInstancesJob::InstanceWorkerThread(ThreadedSetOfInstancesJob* that)
+  void ThreadedSetOfInstancesJob::ProcessInstance(const std::string& instance)
   {
-    Logging::ScopedCurrentThreadNameSetter setter(::GetInstanceWorkerThreadName());
-
-    while (true)
+    if (stopRequested_)  // no lock(mutex) to access this variable, this is safe since it's just reading a boolean
     {
-      std::unique_ptr<SingleValueObject<std::string> > instanceId(dynamic_cast<SingleValueObject<std::string>*>(that->instancesToProcessQueue_.Dequeue(0)));
-      if (that->stopRequested_                // no lock(mutex) to access this variable, this is safe since it's just reading a boolean
-        || instanceId->GetValue() == EXIT_WORKER_MESSAGE)
-      {
-        return;
-      }
+      return;
+    }
 
-      bool processed = false;
-      
-      try
-      {
-        processed = that->HandleInstance(instanceId->GetValue());
-      }
-      catch (const Orthanc::OrthancException& e)
+    bool processed = false;
+
+    try
+    {
+      processed = HandleInstance(instance);
+    }
+    catch (const Orthanc::OrthancException& e)
+    {
+      if (IsPermissive())
       {
-        if (that->IsPermissive())
-        {
-          LOG(WARNING) << "Ignoring an error in a permissive job: " << e.What();
-        }
-        else
-        {
-          LOG(ERROR) << "Error in a non-permissive job: " << e.What();
-          that->SetErrorCode(e.GetErrorCode());
-          that->StopWorkers();
-          return;
-        }
+        LOG(WARNING) << "Ignoring an error in a permissive job: " << e.What();
       }
-      catch (...)
+      else
       {
-        LOG(ERROR) << "Native exception while executing a job";
-        that->SetErrorCode(ErrorCode_InternalError);
-        that->StopWorkers();
+        LOG(ERROR) << "Error in a non-permissive job: " << e.What();
+        SetErrorCode(e.GetErrorCode());
+        StopWorkers();
         return;
       }
+    }
+    catch (...)
+    {
+      LOG(ERROR) << "Native exception while executing a job";
+      SetErrorCode(ErrorCode_InternalError);
+      StopWorkers();
+      return;
+    }
 
-      {
-        boost::recursive_mutex::scoped_lock lock(that->mutex_);
-        
-        that->processedInstances_.insert(instanceId->GetValue());
+    {
+      boost::recursive_mutex::scoped_lock lock(mutex_);
 
-        if (!processed)
-        {
-          that->failedInstances_.insert(instanceId->GetValue()); 
-        }
-      }
+      processedInstances_.insert(instance);
 
+      if (!processed)
+      {
+        failedInstances_.insert(instance);
+      }
     }
   }
 
@@ -364,7 +353,6 @@ namespace Orthanc
       stopRequested_ = false;
       processedInstances_.clear();
       failedInstances_.clear();
-      instancesToProcessQueue_.Clear();
     }
     else
     {
@@ -386,6 +374,7 @@ namespace Orthanc
   static const char* KEY_FAILED_INSTANCES_COUNT = "FailedInstancesCount";
   static const char* KEY_KEEP_SOURCE = "KeepSource";
   static const char* KEY_WORKERS_COUNT = "WorkersCount";
+  static const char* KEY_COMMANDS = "Commands";
 
   static void SerializeResources(Json::Value& target, const std::map<std::string, ResourceType>& parentResources, bool includeParentResourcesField)
   {
@@ -500,6 +489,27 @@ namespace Orthanc
     {
       SerializationToolbox::ReadSetOfStrings(instancesToProcess_, source, KEY_INSTANCES);
     }
+    else if (source.isMember(KEY_COMMANDS) &&
+             source[KEY_COMMANDS].type() == Json::arrayValue)
+    {
+      // Backward compatibility with the jobs that were derived from
+      // "SetOfInstancesJob" in Orthanc <= 1.12.11 (split/merge of
+      // studies): The instances are the string commands, and the
+      // trailing step is a null command. Such a job is restarted from
+      // its first instance.
+      const Json::Value& commands = source[KEY_COMMANDS];
+      for (Json::Value::ArrayIndex i = 0; i < commands.size(); i++)
+      {
+        if (commands[i].type() == Json::stringValue)
+        {
+          instancesToProcess_.insert(commands[i].asString());
+        }
+        else if (commands[i].type() != Json::nullValue)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+      }
+    }
 
     if (source.isMember(KEY_CURRENT_STEP))
     {
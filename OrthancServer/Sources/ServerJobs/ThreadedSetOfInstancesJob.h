@@ -25,17 +25,16 @@
 
 #include "../../../OrthancFramework/Sources/Compatibility.h"  // For ORTHANC_OVERRIDE
 #include "../../../OrthancFramework/Sources/JobsEngine/IJob.h"
-#include "../../../OrthancFramework/Sources/MultiThreading/SharedMessageQueue.h"
+#include "../../../OrthancFramework/Sources/JobsEngine/JobTasksExecutor.h"
 
 #include <set>
 #include <boost/thread/recursive_mutex.hpp>
-#include <boost/thread.hpp>
 
 namespace Orthanc
 {
   class ServerContext;
 
-  // This class is a threaded version of SetOfInstancesJob merged with CleaningInstancesJob
+  // This class is a threaded version of SetOfInstancesJob, that also deletes the source instances unless "KeepSource" is set
   class ThreadedSetOfInstancesJob : public IJob
   {
   public:
@@ -49,12 +48,14 @@ namespace Orthanc
     };
 
   private:
+    class InstanceTask;
+
     std::set<std::string>               instancesToProcess_;  // the list of source instances ids to process
     std::set<std::string>               failedInstances_;     // the list of source instances ids that failed processing
     std::set<std::string>               processedInstances_;  // the list of source instances ids that have been processed (including failed ones)
 
-    SharedMessageQueue                  instancesToProcessQueue_;
-    std::vector<boost::shared_ptr<boost::thread> >         instancesWorkers_;
+    // the instances are processed as sub-tasks in the executor shared by all the jobs (new in Orthanc 1.12.12)
+    std::unique_ptr<JobTasksExecutor::Group>  instancesTasks_;
 
     bool                    hasPostProcessing_;  // final step before "KeepSource" cleanup
     bool                    started_;
@@ -97,7 +98,7 @@ namespace Orthanc
 
     void WaitWorkersComplete();
 
-    static void InstanceWorkerThread(ThreadedSetOfInstancesJob* that);
+    void ProcessInstance(const std::string& instance);
 
     const std::string& GetInstance(size_t index) const;
 
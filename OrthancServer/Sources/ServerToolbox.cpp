@@ -24,6 +24,8 @@
 #include "PrecompiledHeadersServer.h"
 #include "ServerToolbox.h"
 
+#include "../../OrthancFramework/Sources/DicomFormat/DicomStreamReader.h"
+#include "../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
 #include "../../OrthancFramework/Sources/DicomParsing/ParsedDicomFile.h"
 #include "../../OrthancFramework/Sources/FileStorage/StorageAccessor.h"
 #include "../../OrthancFramework/Sources/FileStorage/StorageCache.h"
@@ -35,6 +37,9 @@
 #include "OrthancConfiguration.h"
 #include "ServerContext.h"
 
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/lexical_cast.hpp>
 #include <cassert>
 
 namespace Orthanc
@@ -324,6 +329,383 @@ namespace Orthanc
     }
 
     
+    namespace
+    {
+      class IndexingSummaryVisitor : public DicomStreamReader::IVisitor
+      {
+      private:
+        typedef std::map<DicomTag, std::pair<ValueRepresentation, std::string> >  RawValues;
+
+        const uint8_t*             buffer_;
+        size_t                     size_;
+        const std::set<DicomTag>&  tags_;
+        DicomTag                   lastTag_;
+        bool                       isImplicit_;
+        bool                       isSupported_;
+        RawValues                  values_;
+
+        static uint32_t ReadLittleEndian(const uint8_t* p,
+                                         size_t bytes)
+        {
+          uint32_t result = 0;
+          for (size_t i = bytes; i > 0; i--)
+          {
+            result = (result << 8) | p[i - 1];
+          }
+          return result;
+        }
+
+        static bool IsStringValueRepresentation(ValueRepresentation vr)
+        {
+          switch (vr)
+          {
+            case ValueRepresentation_ApplicationEntity:
+            case ValueRepresentation_AgeString:
+            case ValueRepresentation_CodeString:
+            case ValueRepresentation_Date:
+            case ValueRepresentation_DecimalString:
+            case ValueRepresentation_DateTime:
+            case ValueRepresentation_IntegerString:
+            case ValueRepresentation_LongString:
+            case ValueRepresentation_LongText:
+            case ValueRepresentation_PersonName:
+            case ValueRepresentation_ShortString:
+            case ValueRepresentation_ShortText:
+            case ValueRepresentation_Time:
+            case ValueRepresentation_UnlimitedCharacters:
+            case ValueRepresentation_UniqueIdentifier:
+            case ValueRepresentation_UniversalResource:
+            case ValueRepresentation_UnlimitedText:
+              return true;
+
+            default:
+              return false;
+          }
+        }
+
+        static size_t GetIntegerSize(ValueRepresentation vr)
+        {
+          switch (vr)
+          {
+            case ValueRepresentation_SignedShort:
+            case ValueRepresentation_UnsignedShort:
+              return 2;
+
+            case ValueRepresentation_SignedLong:
+            case ValueRepresentation_UnsignedLong:
+              return 4;
+
+            default:
+              return 0;  // Not an integer, or not supported
+          }
+        }
+
+        // Reads the value from the buffer, as "DicomStreamReader"
+        // removes one padding character from the strings
+        bool ReadRawValue(std::string& value,
+                          uint64_t offset,
+                          ValueRepresentation vr) const
+        {
+          uint64_t headerSize;
+          uint32_t length;
+
+          if (isImplicit_)
+          {
+            headerSize = 8;
+            if (offset + headerSize > size_)
+            {
+              return false;
+            }
+
+            length = ReadLittleEndian(buffer_ + offset + 4, 4);
+          }
+          else if (vr == ValueRepresentation_UnlimitedCharacters ||
+                   vr == ValueRepresentation_UniversalResource ||
+                   vr == ValueRepresentation_UnlimitedText)
+          {
+            headerSize = 12;
+            if (offset + headerSize > size_)
+            {
+              return false;
+            }
+
+            length = ReadLittleEndian(buffer_ + offset + 8, 4);
+          }
+          else
+          {
+            headerSize = 8;
+            if (offset + headerSize > size_)
+            {
+              return false;
+            }
+
+            length = ReadLittleEndian(buffer_ + offset + 6, 2);
+          }
+
+          if (length == 0xffffffffu ||
+              offset + headerSize + length > size_)
+          {
+            return false;
+          }
+          else
+          {
+            value.assign(reinterpret_cast<const char*>(buffer_) + offset + headerSize, length);
+            return true;
+          }
+        }
+
+      public:
+        IndexingSummaryVisitor(const void* buffer,
+                               size_t size,
+                               const std::set<DicomTag>& tags) :
+          buffer_(reinterpret_cast<const uint8_t*>(buffer)),
+          size_(size),
+          tags_(tags),
+          lastTag_(tags.empty() ? DicomTag(0, 0) : *tags.rbegin()),
+          isImplicit_(false),
+          isSupported_(true)
+        {
+        }
+
+        virtual void VisitMetaHeaderTag(const DicomTag& tag,
+                                        const ValueRepresentation& vr,
+                                        const std::string& value) ORTHANC_OVERRIDE
+        {
+        }
+
+        virtual void VisitTransferSyntax(DicomTransferSyntax transferSyntax) ORTHANC_OVERRIDE
+        {
+          // The datasets of all the other transfer syntaxes, including
+          // the compressed ones, are encoded as explicit little endian
+          isImplicit_ = (transferSyntax == DicomTransferSyntax_LittleEndianImplicit);
+          isSupported_ = (transferSyntax != DicomTransferSyntax_BigEndianExplicit &&
+                          transferSyntax != DicomTransferSyntax_DeflatedLittleEndianExplicit);
+        }
+
+        virtual bool VisitDatasetTag(const DicomTag& tag,
+                                     const ValueRepresentation& vr,
+                                     const std::string& value,
+                                     bool isLittleEndian,
+                                     uint64_t fileOffset) ORTHANC_OVERRIDE
+        {
+          if (!isSupported_)
+          {
+            return false;
+          }
+
+          if (tags_.find(tag) != tags_.end())
+          {
+            // With implicit VR, DCMTK also relies on its dictionary
+            const ValueRepresentation actualVR = (isImplicit_ ? FromDcmtkBridge::LookupValueRepresentation(tag) : vr);
+
+            std::string raw;
+            if ((!IsStringValueRepresentation(actualVR) && GetIntegerSize(actualVR) == 0) ||
+                !ReadRawValue(raw, fileOffset, actualVR))
+            {
+              isSupported_ = false;
+              return false;
+            }
+
+            values_[tag] = std::make_pair(actualVR, raw);
+          }
+
+          return (tag < lastTag_);
+        }
+
+        bool IsSupported() const
+        {
+          return isSupported_;
+        }
+
+        // Mimics "FromDcmtkBridge::ExtractDicomSummary()"
+        bool Convert(DicomMap& target) const
+        {
+          Encoding encoding = GetDefaultDicomEncoding();
+          bool hasCodeExtensions = false;
+
+          RawValues::const_iterator charset = values_.find(DICOM_TAG_SPECIFIC_CHARACTER_SET);
+          if (charset != values_.end())
+          {
+            std::vector<std::string> tokens;
+            Toolbox::TokenizeString(tokens, charset->second.second, '\\');
+
+            hasCodeExtensions = (tokens.size() > 1);
+
+            for (size_t i = 0; i < tokens.size(); i++)
+            {
+              const std::string characterSet = Toolbox::StripSpaces(tokens[i]);
+
+              if (!characterSet.empty())
+              {
+                if (!GetDicomEncoding(encoding, characterSet.c_str()))
+                {
+                  return false;  // Let DCMTK report the unsupported encoding
+                }
+
+                break;
+              }
+            }
+          }
+
+          target.Clear();
+
+          for (RawValues::const_iterator it = values_.begin(); it != values_.end(); ++it)
+          {
+            const ValueRepresentation vr = it->second.first;
+            const std::string& raw = it->second.second;
+
+            if (IsStringValueRepresentation(vr))
+            {
+              // Like DCMTK, remove the trailing padding characters
+              const char padding = (vr == ValueRepresentation_UniqueIdentifier ? '\0' : ' ');
+
+              size_t length = raw.size();
+              while (length > 0 &&
+                     raw[length - 1] == padding)
+              {
+                length--;
+              }
+
+              std::string s(raw, 0, length);
+              if (s.find('\0') != std::string::npos)
+              {
+                return false;  // Non-standard padding
+              }
+
+              const std::string utf8 = Toolbox::ConvertDicomStringToUtf8(s, encoding, hasCodeExtensions, vr);
+
+              if (utf8.size() > ORTHANC_MAXIMUM_TAG_LENGTH)
+              {
+                target.SetNullValue(it->first);  // Too long
+              }
+              else
+              {
+                target.SetValue(it->first, utf8, false);
+              }
+            }
+            else
+            {
+              const size_t itemSize = GetIntegerSize(vr);
+              assert(itemSize != 0);
+
+              if (raw.size() % itemSize != 0)
+              {
+                return false;
+              }
+              else if (raw.empty())
+              {
+                target.SetNullValue(it->first);
+              }
+              else
+              {
+                std::string s;
+
+                for (size_t i = 0; i < raw.size(); i += itemSize)
+                {
+                  const uint32_t v = ReadLittleEndian(reinterpret_cast<const uint8_t*>(raw.c_str()) + i, itemSize);
+
+                  if (!s.empty())
+                  {
+                    s += '\\';
+                  }
+
+                  switch (vr)
+                  {
+                    case ValueRepresentation_SignedShort:
+                      s += boost::lexical_cast<std::string>(static_cast<int16_t>(v));
+                      break;
+
+                    case ValueRepresentation_UnsignedShort:
+                      s += boost::lexical_cast<std::string>(static_cast<uint16_t>(v));
+                      break;
+
+                    case ValueRepresentation_SignedLong:
+                      s += boost::lexical_cast<std::string>(static_cast<int32_t>(v));
+                      break;
+
+                    case ValueRepresentation_UnsignedLong:
+                      s += boost::lexical_cast<std::string>(v);
+                      break;
+
+                    default:
+                      throw OrthancException(ErrorCode_InternalError);
+                  }
+                }
+
+                target.SetValue(it->first, s, false);
+              }
+            }
+          }
+
+          return true;
+        }
+      };
+    }
+
+
+    bool ExtractIndexingSummary(DicomMap& target,
+                                const void* buffer,
+                                size_t size)
+    {
+      std::set<DicomTag> tags;
+      DicomMap::GetAllMainDicomTags(tags);
+
+      // Tags that are read by "StatelessDatabaseOperations::Store()",
+      // by "DicomInstanceHasher" and by "DicomImageInformation"
+      tags.insert(DICOM_TAG_SPECIFIC_CHARACTER_SET);
+      tags.insert(DICOM_TAG_PATIENT_ID);
+      tags.insert(DICOM_TAG_STUDY_INSTANCE_UID);
+      tags.insert(DICOM_TAG_SERIES_INSTANCE_UID);
+      tags.insert(DICOM_TAG_SOP_INSTANCE_UID);
+      tags.insert(DICOM_TAG_SOP_CLASS_UID);
+      tags.insert(DICOM_TAG_INSTANCE_NUMBER);
+      tags.insert(DICOM_TAG_IMAGE_INDEX);
+      tags.insert(DICOM_TAG_IMAGES_IN_ACQUISITION);
+      tags.insert(DICOM_TAG_NUMBER_OF_TEMPORAL_POSITIONS);
+      tags.insert(DICOM_TAG_NUMBER_OF_SLICES);
+      tags.insert(DICOM_TAG_NUMBER_OF_TIME_SLICES);
+      tags.insert(DICOM_TAG_CARDIAC_NUMBER_OF_IMAGES);
+      tags.insert(DICOM_TAG_ROWS);
+      tags.insert(DICOM_TAG_COLUMNS);
+      tags.insert(DICOM_TAG_BITS_ALLOCATED);
+      tags.insert(DICOM_TAG_BITS_STORED);
+      tags.insert(DICOM_TAG_HIGH_BIT);
+      tags.insert(DICOM_TAG_PIXEL_REPRESENTATION);
+      tags.insert(DICOM_TAG_SAMPLES_PER_PIXEL);
+      tags.insert(DICOM_TAG_PLANAR_CONFIGURATION);
+      tags.insert(DICOM_TAG_PHOTOMETRIC_INTERPRETATION);
+      tags.insert(DICOM_TAG_NUMBER_OF_FRAMES);
+
+      for (std::set<DicomTag>::const_iterator it = tags.begin(); it != tags.end(); ++it)
+      {
+        // The sequences and the private tags are only handled by DCMTK
+        if (it->IsPrivate() ||
+            FromDcmtkBridge::LookupValueRepresentation(*it) == ValueRepresentation_Sequence)
+        {
+          return false;
+        }
+      }
+
+      IndexingSummaryVisitor visitor(buffer, size, tags);
+
+      try
+      {
+        boost::iostreams::array_source source(reinterpret_cast<const char*>(buffer), size);
+        boost::iostreams::stream<boost::iostreams::array_source> stream(source);
+
+        DicomStreamReader reader(stream);
+        reader.Consume(visitor, DICOM_TAG_PIXEL_DATA);
+      }
+      catch (OrthancException&)
+      {
+        return false;
+      }
+
+      return (visitor.IsSupported() &&
+              visitor.Convert(target));
+    }
+
+
     bool IsValidLabel(const std::string& label)
     {
       if (label.empty())
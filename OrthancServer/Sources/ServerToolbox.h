@@ -31,6 +31,7 @@
 
 namespace Orthanc
 {
+  class DicomMap;
   class ServerContext;
   class IPluginStorageArea;
 
@@ -60,6 +61,18 @@ namespace Orthanc
                              bool limitToThisLevelDicomTags,
                              ResourceType limitToLevel);
 
+    // Extracts the tags that are needed to index a DICOM instance (the
+    // main DICOM tags of all the levels, and the tags about the image
+    // and the expected number of instances), by walking its buffer
+    // until the pixel data, without loading the dataset with DCMTK.
+    // The result is the same as the corresponding tags of
+    // "DicomInstanceToStore::GetSummary()". Returns "false" if some of
+    // these tags cannot be extracted this way, in which case DCMTK
+    // must be used (new in Orthanc 1.12.12).
+    bool ExtractIndexingSummary(DicomMap& target,
+                                const void* buffer,
+                                size_t size);
+
     bool IsValidLabel(const std::string& label);
 
     void CheckValidLabel(const std::string& label);
@@ -28,6 +28,8 @@
 #include "../../OrthancFramework/Sources/DicomFormat/DicomImageInformation.h"
 #include "../../OrthancFramework/Sources/Logging.h"
 #include "../../OrthancFramework/Sources/OrthancException.h"
+#include "../../OrthancFramework/Sources/RequestTimings.h"
+#include "../../OrthancFramework/Sources/Tracing.h"
 #include "../Plugins/Engine/OrthancPlugins.h"
 #include "OrthancConfiguration.h"
 
@@ -50,6 +52,13 @@ namespace Orthanc
 
     // New option in Orthanc 1.12.6
     dynamic_cast<DcmtkTranscoder&>(*dcmtkTranscoder_).SetDefaultLossyQuality(lock.GetConfiguration().GetDicomLossyTranscodingQuality());
+
+    // New option in Orthanc 1.12.12
+    const unsigned int framesThreads = lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_FRAMES_TRANSCODING_THREADS);
+    if (framesThreads > 1)
+    {
+      dynamic_cast<DcmtkTranscoder&>(*dcmtkTranscoder_).SetFramesTranscodingThreads(framesThreads);
+    }
   }
 
 
@@ -73,6 +82,9 @@ namespace Orthanc
                                                size_t size,
                                                unsigned int frameIndex)
   {
+    RequestTimings::Timer timings(RequestTimings::Category_Codec);
+    Tracing::Span span("codec.decode", Tracing::SpanKind_Internal);
+
     { // check that the target image has a valid/reasonable size before decoding to avoid possible crash or OOB during transcoding
       DicomMap summary;
       parsedDicom.ExtractDicomSummary(summary, 128);
@@ -170,13 +182,7 @@ namespace Orthanc
                                    const std::set<DicomTransferSyntax>& allowedSyntaxes,
                                    TranscodingSopInstanceUidMode mode)
   {
-    unsigned int lossyQuality;
-
-    {
-      OrthancConfiguration::ReaderLock lock;
-      lossyQuality = lock.GetConfiguration().GetDicomLossyTranscodingQuality();
-    }
-
+    const unsigned int lossyQuality = OrthancConfiguration::GetSnapshot()->GetDicomLossyTranscodingQuality();
     return Transcode(target, source, allowedSyntaxes, mode, lossyQuality);
   }
 
@@ -187,6 +193,9 @@ namespace Orthanc
                                    TranscodingSopInstanceUidMode mode,
                                    unsigned int lossyQuality)
   {
+    RequestTimings::Timer timings(RequestTimings::Category_Codec);
+    Tracing::Span span("codec.transcode", Tracing::SpanKind_Internal);
+
     if (builtinDecoderTranscoderOrder_ == BuiltinDecoderTranscoderOrder_Before)
     {
       if (dcmtkTranscoder_->Transcode(target, source, allowedSyntaxes, mode, lossyQuality))
@@ -220,4 +229,84 @@ namespace Orthanc
       return false;
     }
   }
+
+
+  // Submits to "transcoder" the instances of the batch that have not
+  // been successfully transcoded yet
+  static void TranscodeRemaining(IDicomTranscoder& transcoder,
+                                 std::vector<bool>& success,
+                                 const std::vector<IDicomTranscoder::DicomImage*>& targets,
+                                 const std::vector<IDicomTranscoder::DicomImage*>& sources,
+                                 const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                                 TranscodingSopInstanceUidMode mode,
+                                 unsigned int lossyQuality)
+  {
+    std::vector<size_t> indices;
+    std::vector<IDicomTranscoder::DicomImage*> remainingTargets;
+    std::vector<IDicomTranscoder::DicomImage*> remainingSources;
+
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+      if (!success[i])
+      {
+        indices.push_back(i);
+        remainingTargets.push_back(targets[i]);
+        remainingSources.push_back(sources[i]);
+      }
+    }
+
+    if (!indices.empty())
+    {
+      std::vector<bool> remainingSuccess;
+      transcoder.TranscodeBatch(remainingSuccess, remainingTargets, remainingSources,
+                                allowedSyntaxes, mode, lossyQuality);
+
+      if (remainingSuccess.size() != indices.size())
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      for (size_t i = 0; i < indices.size(); i++)
+      {
+        success[indices[i]] = remainingSuccess[i];
+      }
+    }
+  }
+
+
+  void ServerTranscoder::TranscodeBatch(std::vector<bool>& success,
+                                        const std::vector<DicomImage*>& targets,
+                                        const std::vector<DicomImage*>& sources,
+                                        const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                                        TranscodingSopInstanceUidMode mode,
+                                        unsigned int lossyQuality)
+  {
+    if (targets.size() != sources.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    RequestTimings::Timer timings(RequestTimings::Category_Codec);
+    Tracing::Span span("codec.transcode-batch", Tracing::SpanKind_Internal);
+
+    success.assign(sources.size(), false);
+
+    if (builtinDecoderTranscoderOrder_ == BuiltinDecoderTranscoderOrder_Before)
+    {
+      TranscodeRemaining(*dcmtkTranscoder_, success, targets, sources, allowedSyntaxes, mode, lossyQuality);
+    }
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+    if (plugins_ != NULL &&
+        plugins_->HasCustomTranscoder())
+    {
+      TranscodeRemaining(*plugins_, success, targets, sources, allowedSyntaxes, mode, lossyQuality);
+    }
+#endif
+
+    if (builtinDecoderTranscoderOrder_ == BuiltinDecoderTranscoderOrder_After)
+    {
+      TranscodeRemaining(*dcmtkTranscoder_, success, targets, sources, allowedSyntaxes, mode, lossyQuality);
+    }
+  }
 }
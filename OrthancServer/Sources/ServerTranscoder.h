@@ -68,5 +68,12 @@ namespace Orthanc
                            const std::set<DicomTransferSyntax>& allowedSyntaxes,
                            TranscodingSopInstanceUidMode mode,
                            unsigned int lossyQuality)  ORTHANC_OVERRIDE;
+
+    virtual void TranscodeBatch(std::vector<bool>& success /* out */,
+                                const std::vector<DicomImage*>& targets,
+                                const std::vector<DicomImage*>& sources,
+                                const std::set<DicomTransferSyntax>& allowedSyntaxes,
+                                TranscodingSopInstanceUidMode mode,
+                                unsigned int lossyQuality) ORTHANC_OVERRIDE;
   };
 }
@@ -43,15 +43,18 @@ namespace Orthanc
     std::string   instanceId_;
     uint32_t      indexInSeries_;
     FileInfo      fileInfo_;
+    std::string   transferSyntax_;
 
 
   public:
     Instance(const std::string& instanceId,
              uint32_t indexInSeries,
-             const FileInfo& fileInfo) :
+             const FileInfo& fileInfo,
+             const std::string& transferSyntax) :
       instanceId_(instanceId),
       indexInSeries_(indexInSeries),
-      fileInfo_(fileInfo)
+      fileInfo_(fileInfo),
+      transferSyntax_(transferSyntax)
     {
     }
 
@@ -69,6 +72,11 @@ namespace Orthanc
     {
       return fileInfo_;
     }
+
+    const std::string& GetTransferSyntax() const
+    {
+      return transferSyntax_;
+    }
   };
 
   bool SimpleInstanceOrdering::IndexInSeriesComparator(const SimpleInstanceOrdering::Instance* a,
@@ -109,9 +117,15 @@ namespace Orthanc
       if (resource.LookupAttachment(fileInfo, revisionNotUsed, FileContentType_Dicom))
       {
         std::string instanceId = resource.GetIdentifier();
+
+        std::string transferSyntax;
+        if (!resource.LookupMetadata(transferSyntax, ResourceType_Instance, MetadataType_Instance_TransferSyntax))
+        {
+          transferSyntax.clear();
+        }
         
         allIndexInSeries.insert(indexInSeries);
-        instances_.push_back(new SimpleInstanceOrdering::Instance(instanceId, indexInSeries, fileInfo));
+        instances_.push_back(new SimpleInstanceOrdering::Instance(instanceId, indexInSeries, fileInfo, transferSyntax));
       }
     }
 
@@ -156,4 +170,9 @@ namespace Orthanc
   {
     return instances_[index]->GetFileInfo();
   }
+
+  const std::string& SimpleInstanceOrdering::GetInstanceTransferSyntax(size_t index) const
+  {
+    return instances_[index]->GetTransferSyntax();
+  }
 }
@@ -54,6 +54,9 @@ namespace Orthanc
 
     const FileInfo& GetInstanceFileInfo(size_t index) const;
 
+    // Empty string if the transfer syntax is not stored in the index
+    const std::string& GetInstanceTransferSyntax(size_t index) const;
+
   private:
     static bool IndexInSeriesComparator(const SimpleInstanceOrdering::Instance* a,
                                         const SimpleInstanceOrdering::Instance* b);
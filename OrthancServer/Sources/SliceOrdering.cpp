@@ -27,6 +27,8 @@
 #include "../../OrthancFramework/Sources/Logging.h"
 #include "../../OrthancFramework/Sources/Toolbox.h"
 #include "../../OrthancFramework/Sources/SerializationToolbox.h"
+#include "Database/FindRequest.h"
+#include "Database/FindResponse.h"
 #include "ServerEnumerations.h"
 #include "ServerIndex.h"
 
@@ -156,16 +158,12 @@ namespace Orthanc
     unsigned int  framesCount_;
 
   public:
-    Instance(ServerIndex& index,
-             const std::string& instanceId) :
-      instanceId_(instanceId),
+    explicit Instance(const FindResponse::Resource& resource) :
+      instanceId_(resource.GetIdentifier()),
       framesCount_(1)
     {
       DicomMap instance;
-      if (!index.GetMainDicomTags(instance, instanceId, ResourceType_Instance, ResourceType_Instance))
-      {
-        throw OrthancException(ErrorCode_UnknownResource);
-      }
+      resource.GetMainDicomTags(instance, ResourceType_Instance);
 
       const DicomValue* frames = instance.TestAndGetValue(DICOM_TAG_NUMBER_OF_FRAMES);
       if (frames != NULL &&
@@ -190,7 +188,7 @@ namespace Orthanc
 
       std::string s;
   
-      if (index.LookupMetadata(s, instanceId, ResourceType_Instance, MetadataType_Instance_IndexInSeries))
+      if (resource.LookupMetadata(s, ResourceType_Instance, MetadataType_Instance_IndexInSeries))
       {
         hasIndexInSeries_ = SerializationToolbox::ParseUnsignedInteger(indexInSeries_, Toolbox::StripSpaces(s));
       }
@@ -282,14 +280,21 @@ namespace Orthanc
 
   void SliceOrdering::CreateInstances()
   {
-    std::list<std::string> instancesId;
-    index_.GetChildren(instancesId, ResourceType_Series, seriesId_);
+    // The geometry of the slices is read from the main DICOM tags of
+    // the instances, in one single lookup for the whole series
+    // (instead of one lookup per instance before Orthanc 1.12.12)
+    FindRequest request(ResourceType_Instance);
+    request.SetOrthancSeriesId(seriesId_);
+    request.SetRetrieveMainDicomTags(true);
+    request.SetRetrieveMetadata(true);
+
+    FindResponse response;
+    index_.ExecuteFind(response, request);
 
-    instances_.reserve(instancesId.size());
-    for (std::list<std::string>::const_iterator
-           it = instancesId.begin(); it != instancesId.end(); ++it)
+    instances_.reserve(response.GetSize());
+    for (size_t i = 0; i < response.GetSize(); i++)
     {
-      instances_.push_back(new Instance(index_, *it));
+      instances_.push_back(new Instance(response.GetResourceByIndex(i)));
     }
   }
   
@@ -27,18 +27,26 @@
 #include "../../OrthancFramework/Sources/Compatibility.h"
 #include "../../OrthancFramework/Sources/Compression/GzipCompressor.h"
 #include "../../OrthancFramework/Sources/Compression/ZipReader.h"
+#include "../../OrthancFramework/Sources/Compression/ZipStreamReader.h"
 #include "../../OrthancFramework/Sources/Constants.h"
 #include "../../OrthancFramework/Sources/DicomFormat/DicomArray.h"
 #include "../../OrthancFramework/Sources/DicomNetworking/DicomAssociationParameters.h"
+#include "../../OrthancFramework/Sources/DicomNetworking/DicomAssociationQuotas.h"
+#include "../../OrthancFramework/Sources/DicomNetworking/DicomNetworkMetrics.h"
 #include "../../OrthancFramework/Sources/DicomNetworking/DicomServer.h"
 #include "../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
+#include "../../OrthancFramework/Sources/ElapsedTimer.h"
+#include "../../OrthancFramework/Sources/FileStorage/ContentAddressedStorageArea.h"
 #include "../../OrthancFramework/Sources/FileStorage/MemoryStorageArea.h"
 #include "../../OrthancFramework/Sources/FileStorage/PluginStorageAreaAdapter.h"
 #include "../../OrthancFramework/Sources/HttpServer/FilesystemHttpHandler.h"
 #include "../../OrthancFramework/Sources/HttpServer/HttpServer.h"
 #include "../../OrthancFramework/Sources/Logging.h"
 #include "../../OrthancFramework/Sources/Lua/LuaFunctionCall.h"
+#include "../../OrthancFramework/Sources/SerializationToolbox.h"
+#include "../../OrthancFramework/Sources/Tracing.h"
 #include "../Plugins/Engine/OrthancPlugins.h"
+#include "Database/ContentReferences.h"
 #include "Database/SQLiteDatabaseWrapper.h"
 #include "DicomInstanceToStore.h"
 #include "EmbeddedResourceHttpHandler.h"
@@ -73,19 +81,55 @@ static const char* const KEY_DICOM_TLS_MINIMUM_PROTOCOL_VERSION = "DicomTlsMinim
 static const char* const KEY_DICOM_TLS_ACCEPTED_CIPHERS = "DicomTlsCiphersAccepted";
 static const char* const KEY_MAXIMUM_PDU_LENGTH = "MaximumPduLength";
 static const char* const KEY_MAXIMUM_CONCURRENT_DCMTK_TRANSCODERS = "MaximumConcurrentDcmtkTranscoders";
+static const char* const KEY_DICOM_ASSOCIATION_QUOTAS = "DicomAssociationQuotas";
+static const char* const KEY_DICOM_SOCKET_BUFFER_SIZE = "DicomSocketBufferSize";
+static const char* const KEY_DICOM_TCP_NO_DELAY = "DicomTcpNoDelay";
 
 
 class OrthancStoreRequestHandler : public IStoreRequestHandler
 {
 private:
   ServerContext& context_;
+  bool           spooling_;
+
+  uint16_t StoreInstance(DicomInstanceToStore& toStore,
+                         const std::string& remoteIp,
+                         const std::string& remoteAet,
+                         const std::string& calledAet,
+                         uint16_t originatorMessageId,
+                         const std::string& originatorAet)
+  {
+    if (toStore.GetBufferSize() > 0)
+    {
+      toStore.SetOrigin(DicomInstanceOrigin::FromDicomProtocol
+                        (remoteIp.c_str(), remoteAet.c_str(), calledAet.c_str()));
+
+      std::string id;
+      ServerContext::StoreResult result = context_.Store(id, toStore);
+
+      if (result.GetStatus() == StoreStatus_Success || result.GetStatus() == StoreStatus_AlreadyStored)
+      {
+        // In case this C-Store was triggered from a C-Move job, keep track of the instances that have been received
+        DicomRetrieveScuBaseJob::AddReceivedInstanceFromCStore(originatorMessageId, originatorAet, id);
+      }
+
+      return result.GetCStoreStatusCode();
+    }
+
+    return STATUS_STORE_Error_CannotUnderstand;
+  }
 
 public:
   explicit OrthancStoreRequestHandler(ServerContext& context) :
-    context_(context)
+    context_(context),
+    spooling_(false)
   {
   }
 
+  void SetSpooling(bool spooling)
+  {
+    spooling_ = spooling;
+  }
 
   virtual uint16_t Handle(DcmDataset& dicom,
                           const std::string& remoteIp,
@@ -95,25 +139,39 @@ public:
                           const std::string& originatorAet) ORTHANC_OVERRIDE 
   {
     std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromDcmDataset(dicom));
-    
-    if (toStore->GetBufferSize() > 0)
-    {
-      toStore->SetOrigin(DicomInstanceOrigin::FromDicomProtocol
-                         (remoteIp.c_str(), remoteAet.c_str(), calledAet.c_str()));
-
-      std::string id;
-      ServerContext::StoreResult result = context_.Store(id, *toStore);
-
-      if (result.GetStatus() == StoreStatus_Success || result.GetStatus() == StoreStatus_AlreadyStored)
-      {
-        // In case this C-Store was triggered from a C-Move job, keep track of the instances that have been received
-        DicomRetrieveScuBaseJob::AddReceivedInstanceFromCStore(originatorMessageId, originatorAet, id);
-      }
+    return StoreInstance(*toStore, remoteIp, remoteAet, calledAet, originatorMessageId, originatorAet);
+  }
 
-      return result.GetCStoreStatusCode();
+  virtual TemporaryFile* CreateSpoolFile() ORTHANC_OVERRIDE
+  {
+    if (spooling_)
+    {
+      OrthancConfiguration::ReaderLock lock;
+      return lock.GetConfiguration().CreateTemporaryFile();
     }
+    else
+    {
+      return NULL;
+    }
+  }
 
-    return STATUS_STORE_Error_CannotUnderstand;
+  virtual uint16_t HandleFile(const std::string& path,
+                              const std::string& remoteIp,
+                              const std::string& remoteAet,
+                              const std::string& calledAet,
+                              uint16_t originatorMessageId,
+                              const std::string& originatorAet) ORTHANC_OVERRIDE
+  {
+    /**
+     * The spooled file is already a serialized DICOM file: It is read
+     * as such and handed to the storage area, which avoids both the
+     * DcmDataset built by DCMTK and its re-serialization.
+     **/
+    std::string dicom;
+    SystemToolbox::ReadFile(dicom, path);
+
+    std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromBuffer(dicom));
+    return StoreInstance(*toStore, remoteIp, remoteAet, calledAet, originatorMessageId, originatorAet);
   }
 };
 
@@ -225,7 +283,14 @@ public:
 
   virtual IStoreRequestHandler* ConstructStoreRequestHandler() ORTHANC_OVERRIDE
   {
-    return new OrthancStoreRequestHandler(context_);
+    std::unique_ptr<OrthancStoreRequestHandler> result(new OrthancStoreRequestHandler(context_));
+
+    {
+      OrthancConfiguration::ReaderLock lock;
+      result->SetSpooling(lock.GetConfiguration().GetBooleanParameter("DicomStoreSpooling"));
+    }
+
+    return result.release();
   }
 
   virtual IFindRequestHandler* ConstructFindRequestHandler() ORTHANC_OVERRIDE
@@ -573,7 +638,7 @@ public:
 
     static const char* HTTP_FILTER = "IncomingHttpRequestFilter";
 
-    LuaScripting::Lock lock(context_.GetLuaScripting());
+    LuaScripting::FilterLock lock(context_.GetLuaScripting());
 
     // Test if the instance must be filtered out
     if (lock.GetLua().IsExistingFunction(HTTP_FILTER))
@@ -974,10 +1039,81 @@ static void LoadPlugins(OrthancPlugins& plugins)
 
 
 
+/**
+ * Measures the duration of the successive phases of the startup of
+ * Orthanc, in order to diagnose slow boots on large installations
+ * (new in Orthanc 1.12.12). The phases are reset at each restart.
+ **/
+class StartupPhases : public boost::noncopyable
+{
+private:
+  typedef std::vector< std::pair<std::string, uint64_t> >  Durations;
+
+  static Durations& GetDurations()
+  {
+    static Durations durations;
+    return durations;
+  }
+
+  static ElapsedTimer& GetTotalTimer()
+  {
+    static ElapsedTimer timer;
+    return timer;
+  }
+
+public:
+  class Timer : public boost::noncopyable
+  {
+  private:
+    std::string   phase_;
+    ElapsedTimer  timer_;
+
+  public:
+    explicit Timer(const std::string& phase) :
+      phase_(phase)
+    {
+    }
+
+    ~Timer()
+    {
+      const uint64_t duration = timer_.GetElapsedMilliseconds();
+      LOG(INFO) << "Startup phase \"" << phase_ << "\" took " << duration << "ms";
+      GetDurations().push_back(std::make_pair(phase_, duration));
+    }
+  };
+
+  static void Reset()
+  {
+    GetDurations().clear();
+    GetTotalTimer().Restart();
+  }
+
+  static void Publish(MetricsRegistry& metrics)
+  {
+    const uint64_t total = GetTotalTimer().GetElapsedMilliseconds();
+
+    std::string summary;
+    for (Durations::const_iterator it = GetDurations().begin(); it != GetDurations().end(); ++it)
+    {
+      summary += (summary.empty() ? "" : ", ") + it->first + ": " + boost::lexical_cast<std::string>(it->second) + "ms";
+      metrics.SetIntegerValue("orthanc_startup_phase_duration_ms{" +
+                              MetricsRegistry::FormatPrometheusLabel("phase", it->first) + "}",
+                              static_cast<int64_t>(it->second));
+    }
+
+    metrics.SetIntegerValue("orthanc_startup_duration_ms", static_cast<int64_t>(total));
+
+    LOG(WARNING) << "Startup of Orthanc took " << total << "ms (" << summary << ")";
+  }
+};
+
+
 // Returns "true" if restart is required
 static bool WaitForExit(ServerContext& context,
                         const OrthancRestApi& restApi)
 {
+  StartupPhases::Publish(context.GetMetricsRegistry());
+
   LOG(WARNING) << "Orthanc has started";
 
 #if ORTHANC_ENABLE_PLUGINS == 1
@@ -1027,6 +1163,12 @@ static bool WaitForExit(ServerContext& context,
   context.GetLuaScripting().Execute("Finalize");
   context.GetLuaScripting().Stop();
 
+  // Release the HTTP clients that listen to the events of the jobs
+  // or that long-poll the changes, otherwise the HTTP server could
+  // not be stopped
+  context.GetJobsEventsHub().Stop();
+  context.GetChangesFeed().Stop();
+
 #if ORTHANC_ENABLE_PLUGINS == 1
   if (context.HasPlugins())
   {
@@ -1117,6 +1259,13 @@ static bool StartHttpServer(ServerContext& context,
   
       // HTTP server
       httpServer.SetThreadsCount(lock.GetConfiguration().GetUnsignedIntegerParameter("HttpThreadsCount"));
+
+      {
+        std::set<unsigned int> affinity;
+        lock.GetConfiguration().GetThreadsAffinity(affinity, "Http");
+        httpServer.SetThreadsAffinity(affinity);
+      }
+
       httpServer.SetPortNumber(lock.GetConfiguration().GetHttpPort());
       std::set<std::string> httpBindAddresses;
       lock.GetConfiguration().GetSetOfStringsParameter(httpBindAddresses, "HttpBindAddresses");
@@ -1127,6 +1276,8 @@ static bool StartHttpServer(ServerContext& context,
       httpServer.SetKeepAliveEnabled(keepAlive);
       httpServer.SetKeepAliveTimeout(lock.GetConfiguration().GetUnsignedIntegerParameter("KeepAliveTimeout"));
       httpServer.SetHttpCompressionEnabled(lock.GetConfiguration().GetBooleanParameter("HttpCompressionEnabled"));
+      httpServer.SetHttpCompressionMinimumSize(lock.GetConfiguration().GetUnsignedIntegerParameter("HttpCompressionMinimumSize"));
+      httpServer.SetHttpZstdCompressionLevel(lock.GetConfiguration().GetUnsignedIntegerParameter("HttpZstdCompressionLevel"));
       httpServer.SetTcpNoDelay(lock.GetConfiguration().GetBooleanParameter("TcpNoDelay"));
       httpServer.SetRequestTimeout(lock.GetConfiguration().GetUnsignedIntegerParameter("HttpRequestTimeout"));
 
@@ -1149,6 +1300,7 @@ static bool StartHttpServer(ServerContext& context,
         const uint64_t size = Toolbox::BoundMemorySizeToCurrentArchitecture(maxSizeInArchive * MEGABYTE);
         LOG(WARNING) << "Limiting on the maximum file size uncompressed from ZIP/gzip archives to " << (size / MEGABYTE) << "MB";
         ZipReader::SetMaximumUncompressedFileSize(size);
+        ZipStreamReader::SetMaximumUncompressedFileSize(size);
         GzipCompressor::SetMaximumUncompressedFileSize(size);
       }
       else
@@ -1308,10 +1460,13 @@ static bool StartHttpServer(ServerContext& context,
       {
         const bool allowDelete = lock.GetConfiguration().GetBooleanParameter("WebDavDeleteAllowed");
         const bool allowUpload = lock.GetConfiguration().GetBooleanParameter("WebDavUploadAllowed");
+
+        std::unique_ptr<OrthancWebDav> webDav(new OrthancWebDav(context, allowDelete, allowUpload));
+        webDav->SetListingsCacheSize(lock.GetConfiguration().GetUnsignedIntegerParameter(ORTHANC_CONFIG_WEBDAV_LISTINGS_CACHE_SIZE));
         
         UriComponents root;
         root.push_back("webdav");
-        httpServer.Register(root, new OrthancWebDav(context, allowDelete, allowUpload));
+        httpServer.Register(root, webDav.release());
       }
     }
 
@@ -1335,7 +1490,10 @@ static bool StartHttpServer(ServerContext& context,
                    << "make sure you run Orthanc as root/administrator";
     }
 
-    httpServer.Start();
+    {
+      StartupPhases::Timer timer("http-server");
+      httpServer.Start();
+    }
   
     MetricsLoggingListener loggingMetrics(context.GetMetricsRegistry());
     Logging::AddLoggingListener(&loggingMetrics);
@@ -1352,6 +1510,61 @@ static bool StartHttpServer(ServerContext& context,
 }
 
 
+static void ConfigureAssociationQuotas(DicomAssociationQuotas& quotas,
+                                       const Json::Value& config)
+{
+  static const char* const MAX_ASSOCIATIONS = "MaxAssociations";
+  static const char* const MAX_ASSOCIATIONS_PER_AET = "MaxAssociationsPerAet";
+  static const char* const WAIT_TIMEOUT = "WaitTimeout";
+  static const char* const CLASSES = "Classes";
+  static const char* const CALLING_AETS = "CallingAets";
+  static const char* const HOSTS = "Hosts";
+
+  if (config.type() != Json::objectValue)
+  {
+    throw OrthancException(ErrorCode_BadFileFormat, "The configuration option \"" +
+                           std::string(KEY_DICOM_ASSOCIATION_QUOTAS) + "\" must be an object");
+  }
+
+  const unsigned int defaultMaxPerAet = SerializationToolbox::ReadUnsignedInteger(config, MAX_ASSOCIATIONS_PER_AET, 0);
+
+  quotas.SetDefaultClass(SerializationToolbox::ReadUnsignedInteger(config, MAX_ASSOCIATIONS, 0), defaultMaxPerAet);
+  quotas.SetWaitTimeout(SerializationToolbox::ReadUnsignedInteger(config, WAIT_TIMEOUT, 0));
+
+  if (config.isMember(CLASSES))
+  {
+    const Json::Value& classes = config[CLASSES];
+    if (classes.type() != Json::objectValue)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "The \"" + std::string(CLASSES) + "\" of the \"" +
+                             std::string(KEY_DICOM_ASSOCIATION_QUOTAS) + "\" option must be an object");
+    }
+
+    Json::Value::Members names = classes.getMemberNames();
+    for (size_t i = 0; i < names.size(); i++)
+    {
+      const Json::Value& item = classes[names[i]];
+
+      std::set<std::string> callingAets, hosts;
+      if (item.isMember(CALLING_AETS))
+      {
+        SerializationToolbox::ReadSetOfStrings(callingAets, item, CALLING_AETS);
+      }
+
+      if (item.isMember(HOSTS))
+      {
+        SerializationToolbox::ReadSetOfStrings(hosts, item, HOSTS);
+      }
+
+      quotas.AddClass(names[i],
+                      SerializationToolbox::ReadUnsignedInteger(item, MAX_ASSOCIATIONS, 0),
+                      SerializationToolbox::ReadUnsignedInteger(item, MAX_ASSOCIATIONS_PER_AET, defaultMaxPerAet),
+                      callingAets, hosts);
+    }
+  }
+}
+
+
 static bool StartDicomServer(ServerContext& context,
                              const OrthancRestApi& restApi,
                              OrthancPlugins* plugins)
@@ -1390,6 +1603,13 @@ static bool StartDicomServer(ServerContext& context,
       dicomServer.SetAssociationTimeout(lock.GetConfiguration().GetUnsignedIntegerParameter("DicomScpTimeout"));
       dicomServer.SetPortNumber(lock.GetConfiguration().GetDicomPort());
       dicomServer.SetThreadsCount(lock.GetConfiguration().GetUnsignedIntegerParameter("DicomThreadsCount"));
+      dicomServer.SetAccessLogEnabled(lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_ACCESS_LOG_ENABLED));
+
+      {
+        std::set<unsigned int> affinity;
+        lock.GetConfiguration().GetThreadsAffinity(affinity, "Dicom");
+        dicomServer.SetThreadsAffinity(affinity);
+      }
       dicomServer.SetApplicationEntityTitle(lock.GetConfiguration().GetOrthancAET());
 
       // Configuration of DICOM TLS for Orthanc SCP (since Orthanc 1.9.0)
@@ -1418,6 +1638,12 @@ static bool StartDicomServer(ServerContext& context,
 
       dicomServer.SetMaximumPduLength(lock.GetConfiguration().GetUnsignedIntegerParameter(KEY_MAXIMUM_PDU_LENGTH));
 
+      // New option in Orthanc 1.12.12
+      if (lock.GetJson().isMember(KEY_DICOM_ASSOCIATION_QUOTAS))
+      {
+        ConfigureAssociationQuotas(dicomServer.GetAssociationQuotas(), lock.GetJson()[KEY_DICOM_ASSOCIATION_QUOTAS]);
+      }
+
       // New option in Orthanc 1.9.3
       dicomServer.SetRemoteCertificateRequired(
         lock.GetConfiguration().GetBooleanParameter(KEY_DICOM_TLS_REMOTE_CERTIFICATE_REQUIRED));
@@ -1452,7 +1678,11 @@ static bool StartDicomServer(ServerContext& context,
                    << "make sure you run Orthanc as root/administrator";
     }
 
-    dicomServer.Start();
+    {
+      StartupPhases::Timer timer("dicom-server");
+      dicomServer.Start();
+    }
+
     LOG(WARNING) << "DICOM server listening with AET " << dicomServer.GetApplicationEntityTitle() 
                  << " on port: " << dicomServer.GetPortNumber();
 
@@ -1485,6 +1715,65 @@ static bool StartDicomServer(ServerContext& context,
 }
 
 
+static void StartTracing()
+{
+  std::unique_ptr<Tracing::ISpanExporter> exporter;
+  std::string serviceName;
+  unsigned int percentage;
+
+  {
+    OrthancConfiguration::ReaderLock lock;
+
+    if (!lock.GetConfiguration().IsTracingEnabled())
+    {
+      return;
+    }
+
+    const std::string type = lock.GetConfiguration().GetTracingExporter();
+
+    if (type == "OTLP")
+    {
+      const std::string endpoint = lock.GetConfiguration().GetTracingEndpoint();
+      exporter.reset(new Tracing::OtlpHttpExporter(endpoint, lock.GetConfiguration().GetUnsignedIntegerParameter("HttpTimeout")));
+      LOG(WARNING) << "Tracing is enabled, the spans are sent to: " << endpoint;
+    }
+    else if (type == "File")
+    {
+      const std::string path = lock.GetConfiguration().GetTracingFile();
+      if (path.empty())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange, "Configuration option \"" +
+                               std::string(ORTHANC_CONFIG_TRACING_FILE) + "\" must be provided if using the \"File\" exporter");
+      }
+
+      exporter.reset(new Tracing::FileExporter(path));
+      LOG(WARNING) << "Tracing is enabled, the spans are written to: " << path;
+    }
+    else if (type == "Log")
+    {
+      exporter.reset(new Tracing::FileExporter(""));
+      LOG(WARNING) << "Tracing is enabled, the spans are written to the logs";
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange, "Configuration option \"" +
+                             std::string(ORTHANC_CONFIG_TRACING_EXPORTER) + "\" must be \"OTLP\", \"File\" or \"Log\": " + type);
+    }
+
+    serviceName = lock.GetConfiguration().GetTracingServiceName();
+    percentage = lock.GetConfiguration().GetTracingSamplingPercentage();
+  }
+
+  if (percentage > 100)
+  {
+    throw OrthancException(ErrorCode_ParameterOutOfRange, "Configuration option \"" +
+                           std::string(ORTHANC_CONFIG_TRACING_SAMPLING_PERCENTAGE) + "\" must be between 0 and 100");
+  }
+
+  Tracing::Initialize(exporter.release(), serviceName, static_cast<double>(percentage) / 100.0);
+}
+
+
 static bool ConfigureHttpHandler(ServerContext& context,
                                  OrthancPlugins *plugins,
                                  bool loadJobsFromDatabase)
@@ -1526,12 +1815,38 @@ static bool ConfigureHttpHandler(ServerContext& context,
   OrthancRestApi restApi(context, orthancExplorerEnabled);
   context.GetHttpHandler().Register(restApi, true);
 
-  context.SetupJobsEngine(false /* not running unit tests */, loadJobsFromDatabase);
+  {
+    // New in Orthanc 1.12.12
+    OrthancConfiguration::ReaderLock lock;
+    restApi.SetHeavyRoutesLimits(lock.GetConfiguration().GetUnsignedIntegerParameter("HttpThreadsCount"),
+                                 lock.GetConfiguration().GetUnsignedIntegerParameter("HttpHeavyRoutesThreadsCount"),
+                                 lock.GetConfiguration().GetUnsignedIntegerParameter("HttpHeavyRoutesQueueSize"));
+    restApi.SetSlowRequestsThreshold(lock.GetConfiguration().GetUnsignedIntegerParameter("HttpSlowRequestsThreshold"));
+    context.GetHttpHandler().SetServerTimingHeaderEnabled(
+      lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_HTTP_SERVER_TIMING_HEADER));
+    context.GetHttpHandler().SetAccessLogEnabled(lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_ACCESS_LOG_ENABLED));
+    restApi.SetSynchronousJobsLimits(lock.GetConfiguration().GetUnsignedIntegerParameter("SynchronousJobsTimeout"),
+                                     lock.GetConfiguration().GetUnsignedIntegerParameter("SynchronousJobsMaxWaiting"));
+  }
+
+  // New in Orthanc 1.12.12: Metrics of the DICOM network, for both SCP and SCU
+  DicomNetworkMetrics::SetRegistry(context.GetMetricsRegistry());
+
+  // New in Orthanc 1.12.12
+  StartTracing();
+
+  {
+    StartupPhases::Timer timer("jobs");
+    context.SetupJobsEngine(false /* not running unit tests */, loadJobsFromDatabase);
+  }
 
   bool restart = StartDicomServer(context, restApi, plugins);
 
   context.Stop();
 
+  Tracing::Finalize();
+  DicomNetworkMetrics::ResetRegistry();
+
   return restart;
 }
 
@@ -1655,6 +1970,7 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
   size_t maxCompletedJobs;
   bool readOnly;
   unsigned int maxDcmtkConcurrentTranscoders;
+  bool deduplication;
 
   {
     OrthancConfiguration::ReaderLock lock;
@@ -1679,9 +1995,21 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
     HttpClient::SetDefaultTimeout(lock.GetConfiguration().GetUnsignedIntegerParameter("HttpTimeout"));
     
     HttpClient::SetDefaultProxy(lock.GetConfiguration().GetStringParameter("HttpProxy"));
+    HttpClient::SetConnectionsPoolSize(lock.GetConfiguration().GetUnsignedIntegerParameter("HttpClientConnectionsPoolSize"));
     
     DicomAssociationParameters::SetDefaultTimeout(lock.GetConfiguration().GetUnsignedIntegerParameter("DicomScuTimeout"));
 
+    // New in Orthanc 1.12.12: "MaximumPduLength" is documented to
+    // also affect Orthanc SCU. These options are read by DCMTK from
+    // the environment, so they must be set before the DICOM server
+    // and the jobs engine are started.
+    DicomAssociationParameters::SetDefaultMaximumPduLength(
+      lock.GetConfiguration().GetUnsignedIntegerParameter(KEY_MAXIMUM_PDU_LENGTH));
+    DicomAssociationParameters::SetSocketBufferSize(
+      lock.GetConfiguration().GetUnsignedIntegerParameter(KEY_DICOM_SOCKET_BUFFER_SIZE) * 1024);
+    DicomAssociationParameters::SetTcpNoDelay(
+      lock.GetConfiguration().GetBooleanParameter(KEY_DICOM_TCP_NO_DELAY));
+
     maxCompletedJobs = lock.GetConfiguration().GetUnsignedIntegerParameter("JobsHistorySize");
 
     if (maxCompletedJobs == 0)
@@ -1716,9 +2044,45 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
     // New option in Orthanc 1.9.3
     DicomAssociationParameters::SetDefaultRemoteCertificateRequired(
       lock.GetConfiguration().GetBooleanParameter(KEY_DICOM_TLS_REMOTE_CERTIFICATE_REQUIRED));
+
+    // New option in Orthanc 1.12.12
+    deduplication = lock.GetConfiguration().GetBooleanParameter(ORTHANC_CONFIG_STORAGE_DEDUPLICATION);
+  }
+
+  // New in Orthanc 1.12.12: The content-addressed attachments are
+  // readable even if the deduplication has been disabled since they
+  // were stored, as long as the database backend supports it
+  std::unique_ptr<ContentAddressedStorageArea> contentAddressedArea;
+  std::unique_ptr<ContentReferences> contentReferences;
+
+  if (database.GetDatabaseCapabilities().HasKeyValueStoresSupport() &&
+      database.GetDatabaseCapabilities().HasAttachmentCustomDataSupport())
+  {
+    contentAddressedArea.reset(new ContentAddressedStorageArea(storageArea));
+    contentAddressedArea->SetDeduplication(deduplication);
+
+    if (deduplication)
+    {
+      LOG(WARNING) << "The identical attachments are deduplicated in the storage area";
+    }
+  }
+  else if (deduplication)
+  {
+    LOG(WARNING) << "The database backend has no support for key-value stores or for the custom data of the "
+                 << "attachments, ignoring option \"" << ORTHANC_CONFIG_STORAGE_DEDUPLICATION << "\"";
   }
   
-  ServerContext context(database, storageArea, false /* not running unit tests */, maxCompletedJobs, readOnly);
+  std::unique_ptr<StartupPhases::Timer> phase(new StartupPhases::Timer("context"));
+
+  ServerContext context(database,
+                        (contentAddressedArea.get() == NULL ? storageArea : *contentAddressedArea),
+                        false /* not running unit tests */, maxCompletedJobs, readOnly);
+
+  if (contentAddressedArea.get() != NULL)
+  {
+    contentReferences.reset(new ContentReferences(context.GetIndex()));
+    contentAddressedArea->SetReferences(*contentReferences);
+  }
 
   {
     OrthancConfiguration::ReaderLock lock;
@@ -1727,11 +2091,23 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
 
     if (context.IsReadOnly())
     {
-      LOG(WARNING) << "READ-ONLY SYSTEM: ignoring these configurations: " << ORTHANC_CONFIG_STORAGE_COMPRESSION << ", " << ORTHANC_CONFIG_STORE_MD5_FOR_ATTACHMENTS << ", " << ORTHANC_CONFIG_OVERWRITE_INSTANCES << ", " << ORTHANC_CONFIG_MAXIMUM_PATIENT_COUNT << ", " << ORTHANC_CONFIG_MAXIMUM_STORAGE_SIZE <<", " << ORTHANC_CONFIG_MAXIMUM_STORAGE_MODE << ", SaveJobs"; 
+      LOG(WARNING) << "READ-ONLY SYSTEM: ignoring these configurations: " << ORTHANC_CONFIG_STORAGE_COMPRESSION << ", " << ORTHANC_CONFIG_STORAGE_COMPRESSION_TYPE << ", " << ORTHANC_CONFIG_STORE_MD5_FOR_ATTACHMENTS << ", " << ORTHANC_CONFIG_OVERWRITE_INSTANCES << ", " << ORTHANC_CONFIG_MAXIMUM_PATIENT_COUNT << ", " << ORTHANC_CONFIG_MAXIMUM_STORAGE_SIZE <<", " << ORTHANC_CONFIG_MAXIMUM_STORAGE_MODE << ", SaveJobs"; 
     }
     else
     {
       context.SetCompressionEnabled(lock.GetConfiguration().HasStorageCompression());
+
+      {
+        // New in Orthanc 1.12.12
+        const CompressionType compression = StringToCompressionType(lock.GetConfiguration().GetStorageCompressionType());
+        if (compression == CompressionType_None)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange, "The configuration option \"" ORTHANC_CONFIG_STORAGE_COMPRESSION_TYPE
+                                 "\" cannot be \"None\", set \"" ORTHANC_CONFIG_STORAGE_COMPRESSION "\" to false instead");
+        }
+
+        context.SetCompressionType(compression);
+      }
       context.SetStoreMD5ForAttachments(lock.GetConfiguration().HasStoreMD5ForAttachments());
 
       // New option in Orthanc 1.4.2 (bool), changed to a string in 1.12.12
@@ -1795,6 +2171,159 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
       {
         context.GetIndex().SetMaximumStorageMode(MaxStorageMode_Recycle);
       }
+
+      context.GetIndex().SetBackgroundRecycling(lock.GetConfiguration().GetRecyclingHighWaterMark(),
+                                                lock.GetConfiguration().GetRecyclingLowWaterMark());
+
+      context.GetIndex().SetIngestBatching(lock.GetConfiguration().GetIngestBatchingDelay(),
+                                           lock.GetConfiguration().GetIngestBatchingMaximumSize());
+    }
+
+    // note: this config is valid in ReadOnlyMode
+    {
+      unsigned int shards = lock.GetConfiguration().GetStorageCacheShards();
+      if (shards == 0)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange,
+                               "The configuration option \"" ORTHANC_CONFIG_STORAGE_CACHE_SHARDS "\" must be >= 1");
+      }
+      else if (shards > 1)
+      {
+        LOG(WARNING) << "Storage cache is split into " << shards << " shards";
+      }
+
+      context.SetStorageCacheShards(shards);
+    }
+
+    // note: this config is valid in ReadOnlyMode
+    context.SetStorageCacheNumaAware(lock.GetConfiguration().IsStorageCacheNumaAware());
+
+    // note: this config is valid in ReadOnlyMode
+    context.SetStorageCachePolicy(StringToCachePolicy(lock.GetConfiguration().GetStorageCachePolicy()));
+
+    // note: this config is valid in ReadOnlyMode
+    {
+      const uint64_t size = lock.GetConfiguration().GetMaximumDicomHeaderCacheSize();
+      if (size == 0)
+      {
+        LOG(WARNING) << "DICOM header cache is disabled";
+      }
+
+      context.SetMaximumDicomHeaderCacheSize(size * 1024 * 1024);
+    }
+
+    // note: this config is valid in ReadOnlyMode
+    {
+      const std::string directory = lock.GetConfiguration().GetStorageDiskCacheDirectory();
+      if (!directory.empty())
+      {
+        const uint64_t size = lock.GetConfiguration().GetMaximumStorageDiskCacheSize();
+        if (size == 0)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange,
+                                 "The configuration option \"" ORTHANC_CONFIG_MAXIMUM_STORAGE_DISK_CACHE_SIZE "\" must be >= 1");
+        }
+
+        LOG(WARNING) << "Storage disk cache is enabled in directory \"" << directory
+                     << "\" with a maximum size of " << size << " MB";
+        context.SetStorageDiskCache(new StorageDiskCache(lock.GetConfiguration().InterpretStringParameterAsPath(directory),
+                                                         size * 1024 * 1024));
+      }
+    }
+
+    // note: this config is valid in ReadOnlyMode
+    {
+      const unsigned int threads = lock.GetConfiguration().GetSeriesPrefetchThreads();
+      if (threads > 0)
+      {
+        context.StartSeriesPrefetcher(threads, lock.GetConfiguration().IsSeriesPrefetchOnRead());
+      }
+    }
+
+    if (!context.IsReadOnly())
+    {
+      const unsigned int size = lock.GetConfiguration().GetSeriesThumbnailsSize();
+      const unsigned int threads = lock.GetConfiguration().GetSeriesThumbnailsThreads();
+      if (size > 0 &&
+          threads > 0)
+      {
+        LOG(WARNING) << "The thumbnails of the series are generated at ingest time, with a size of "
+                     << size << " pixels and " << threads << " thread(s)";
+        context.StartSeriesThumbnailsGenerator(threads, size);
+      }
+    }
+
+    if (!context.IsReadOnly())
+    {
+      const unsigned int threads = lock.GetConfiguration().GetIngestTranscodingThreads();
+      if (threads > 0)
+      {
+        LOG(WARNING) << "The ingest transcoding is done in the background by " << threads << " thread(s)";
+        context.StartIngestTranscodingPipeline(threads);
+      }
+    }
+
+    // note: this config is valid in ReadOnlyMode
+    {
+      const unsigned int threads = lock.GetConfiguration().GetStorageAccessOnFindThreads();
+      if (threads > 0)
+      {
+        context.StartFindLoaders(threads, lock.GetConfiguration().GetStorageAccessOnFindThreadsPerRequest());
+      }
+    }
+
+    // note: this config is valid in ReadOnlyMode
+    {
+      const unsigned int threads = lock.GetConfiguration().GetLoaderPoolThreads();
+      if (threads > 0)
+      {
+        std::set<unsigned int> affinity;
+        lock.GetConfiguration().GetThreadsAffinity(affinity, "Loaders");
+        context.StartInstancesLoaderService(threads, affinity);
+      }
+    }
+
+    {
+      const unsigned int threads = lock.GetConfiguration().GetUnsignedIntegerParameter("ZipUploadThreads");
+      if (threads > 1)
+      {
+        context.StartZipUploadWorkers(threads);
+      }
+    }
+
+    {
+      unsigned int threads = lock.GetConfiguration().GetUnsignedIntegerParameter("ZipTranscodingThreads");
+      if (threads == 0)
+      {
+        threads = static_cast<unsigned int>(boost::thread::hardware_concurrency());
+      }
+
+      if (threads == 0)
+      {
+        threads = 1;  // The number of CPU cores is unknown
+      }
+
+      context.StartArchiveTranscodingWorkers(threads);
+
+      const unsigned int batchSize = lock.GetConfiguration().GetUnsignedIntegerParameter("ZipTranscodingBatchSize");
+      context.SetArchiveTranscodingBatchSize(batchSize == 0 ? 1 : batchSize);
+    }
+
+    {
+      const unsigned int threads = lock.GetConfiguration().GetUnsignedIntegerParameter("ImageProcessingThreads");
+      if (threads > 1)
+      {
+        context.StartImageProcessingWorkers(threads);
+      }
+    }
+
+    // note: this config is valid in ReadOnlyMode
+    {
+      const unsigned int threads = lock.GetConfiguration().GetUnsignedIntegerParameter("FramesDecodingThreads");
+      if (threads > 1)
+      {
+        context.StartFramesDecodingWorkers(threads);
+      }
     }
 
     // note: this config is valid in ReadOnlyMode
@@ -1826,6 +2355,8 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
       lock.GetConfiguration().LoadModalitiesAndPeers();
     }
 
+    phase.reset();
+
     // this function exits only when Orthanc stops or resets
     return ConfigureHttpHandler(context, plugins, loadJobsFromDatabase);
   }
@@ -1838,6 +2369,8 @@ static bool ConfigureDatabase(IDatabaseWrapper& database,
                               bool upgradeDatabase,
                               bool loadJobsFromDatabase)
 {
+  std::unique_ptr<StartupPhases::Timer> phase(new StartupPhases::Timer("database"));
+
   database.Open();
 
   unsigned int currentVersion = database.GetDatabaseVersion();
@@ -1893,6 +2426,7 @@ static bool ConfigureDatabase(IDatabaseWrapper& database,
     LOG(WARNING) << "The DB latency is " << latency << " µs";
   }
 
+  phase.reset();
 
   bool success = ConfigureServerContext(database, storageArea, plugins, loadJobsFromDatabase);
 
@@ -1918,7 +2452,11 @@ static bool ConfigurePlugins(const std::vector<std::string> arguments,
   
   OrthancPlugins plugins(databaseServerIdentifier);
   plugins.SetCommandLineArguments(arguments);
-  LoadPlugins(plugins);
+
+  {
+    StartupPhases::Timer timer("plugins");
+    LoadPlugins(plugins);
+  }
 
   IDatabaseWrapper* database = NULL;
   if (plugins.HasDatabaseBackend())
@@ -2329,7 +2867,12 @@ int main(int argc, char* argv[])
   {
     for (;;)
     {
-      OrthancInitialize(configurationFile);
+      StartupPhases::Reset();
+
+      {
+        StartupPhases::Timer timer("configuration");
+        OrthancInitialize(configurationFile);
+      }
 
       bool restart = StartOrthanc(arguments, upgradeDatabase, loadJobsFromDatabase);
       if (restart)
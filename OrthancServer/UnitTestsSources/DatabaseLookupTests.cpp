@@ -25,8 +25,12 @@
 #include <gtest/gtest.h>
 
 #include "../../OrthancFramework/Sources/OrthancException.h"
+#include "../../OrthancFramework/Sources/Toolbox.h"
 
 #include "../Sources/Search/DatabaseLookup.h"
+#include "../Sources/Search/WildcardMatcher.h"
+
+#include <boost/regex.hpp>
 
 using namespace Orthanc;
 
@@ -271,3 +275,54 @@ TEST(DatabaseLookup, FromDicom)
     ASSERT_FALSE(lookup.GetConstraint(1).IsMandatory());
   }
 }
+
+
+TEST(DatabaseLookup, WildcardMatcher)
+{
+  ASSERT_TRUE(WildcardMatcher("").IsMatch(""));
+  ASSERT_FALSE(WildcardMatcher("").IsMatch("a"));
+  ASSERT_TRUE(WildcardMatcher("*").IsMatch(""));
+  ASSERT_TRUE(WildcardMatcher("*").IsMatch("hello"));
+  ASSERT_TRUE(WildcardMatcher("DOE*").IsMatch("DOE^JOHN"));
+  ASSERT_FALSE(WildcardMatcher("DOE*").IsMatch("JOHN^DOE"));
+  ASSERT_TRUE(WildcardMatcher("*DOE").IsMatch("JOHN^DOE"));
+  ASSERT_TRUE(WildcardMatcher("*OH*").IsMatch("JOHN^DOE"));
+  ASSERT_FALSE(WildcardMatcher("*OHX*").IsMatch("JOHN^DOE"));
+  ASSERT_TRUE(WildcardMatcher("J?HN*").IsMatch("JOHN^DOE"));
+  ASSERT_FALSE(WildcardMatcher("a*a").IsMatch("a"));
+  ASSERT_TRUE(WildcardMatcher("a*a").IsMatch("aa"));
+  ASSERT_TRUE(WildcardMatcher("1.2.*.4").IsMatch("1.2.3.4"));
+  ASSERT_FALSE(WildcardMatcher("1.2.*.4").IsMatch("1.2.3x4"));  // "." is not a regex
+
+  // Exhaustive comparison with the regular expressions that were
+  // used before Orthanc 1.12.12, over a small alphabet
+  const char alphabet[] = { 'a', 'b', '*', '?' };
+
+  std::vector<std::string> strings;
+  strings.push_back("");
+
+  for (size_t i = 0; i < strings.size(); i++)
+  {
+    if (strings[i].size() < 5)
+    {
+      for (size_t j = 0; j < sizeof(alphabet); j++)
+      {
+        strings.push_back(strings[i] + alphabet[j]);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < strings.size(); i++)
+  {
+    const WildcardMatcher matcher(strings[i]);
+    const boost::regex regex(Toolbox::WildcardToRegularExpression(strings[i]));
+
+    for (size_t j = 0; j < strings.size(); j++)
+    {
+      if (strings[j].find_first_of("*?") == std::string::npos)
+      {
+        ASSERT_EQ(boost::regex_match(strings[j], regex), matcher.IsMatch(strings[j]));
+      }
+    }
+  }
+}
@@ -26,7 +26,11 @@
 
 #include "../../OrthancFramework/Sources/Compatibility.h"
 #include "../../OrthancFramework/Sources/OrthancException.h"
+#include "../Plugins/Engine/CoalescedChangeCallback.h"
+#include "../Plugins/Engine/PluginsCallbacksMetrics.h"
+#include "../Plugins/Engine/PluginsErrorDictionary.h"
 #include "../Plugins/Engine/PluginsManager.h"
+#include "../Plugins/Engine/PluginsParallelJob.h"
 
 using namespace Orthanc;
 
@@ -148,4 +152,278 @@ TEST(SharedLibrary, Basic)
 #endif
 }
 
+static OrthancPluginErrorCode CallbackForMetrics(OrthancPluginChangeType changeType,
+                                                 OrthancPluginResourceType resourceType,
+                                                 const char* resourceId)
+{
+  return OrthancPluginErrorCode_Success;
+}
+
+
+TEST(PluginsCallbacksMetrics, Basic)
+{
+  PluginsCallbacksMetrics metrics;
+
+  {
+    // No registry, nothing is collected
+    PluginsCallbacksMetrics::Timer timer(metrics, CallbackForMetrics, "change");
+  }
+
+  MetricsRegistry registry;
+  metrics.SetRegistry(registry);
+
+  {
+    PluginsCallbacksMetrics::Timer timer(metrics, CallbackForMetrics, "change");
+    timer.SetResult(OrthancPluginErrorCode_Success);
+  }
+
+  {
+    PluginsCallbacksMetrics::Timer timer(metrics, CallbackForMetrics, "change");
+    timer.SetResult(OrthancPluginErrorCode_Plugin);
+  }
+
+  {
+    // Errors are the default, e.g. in the presence of exceptions
+    PluginsCallbacksMetrics::Timer timer(metrics, CallbackForMetrics, "rest");
+  }
+
+  registry.SetEnabled(false);
+
+  {
+    PluginsCallbacksMetrics::Timer timer(metrics, CallbackForMetrics, "rest");
+  }
+
+  registry.SetEnabled(true);
+
+  std::string s;
+  registry.ExportPrometheusText(s);
+
+  ASSERT_NE(std::string::npos, s.find("orthanc_plugins_callbacks_total{plugin=\"unknown\",callback=\"change\"} 2 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_plugins_callbacks_errors_total{plugin=\"unknown\",callback=\"change\"} 1 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_plugins_callbacks_total{plugin=\"unknown\",callback=\"rest\"} 1 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_plugins_callbacks_duration_ms_count{plugin=\"unknown\",callback=\"change\"} 2 "));
+
+  metrics.ResetRegistry();
+}
+
+
+namespace
+{
+  struct ParallelJobItems
+  {
+    boost::mutex      mutex_;
+    std::vector<int>  processed_;
+    int               failure_;
+    bool              finalized_;
+  };
+
+  static void FinalizeParallelJob(void* job)
+  {
+    reinterpret_cast<ParallelJobItems*>(job)->finalized_ = true;
+  }
+
+  static OrthancPluginErrorCode ProcessParallelJobItem(void* job,
+                                                       uint32_t item)
+  {
+    ParallelJobItems& items = *reinterpret_cast<ParallelJobItems*>(job);
+    boost::mutex::scoped_lock lock(items.mutex_);
+
+    if (static_cast<int>(item) == items.failure_)
+    {
+      return OrthancPluginErrorCode_BadFileFormat;
+    }
+    else
+    {
+      items.processed_[item]++;
+      return OrthancPluginErrorCode_Success;
+    }
+  }
+
+  static JobStepCode RunParallelJob(IJob& job)
+  {
+    for (;;)
+    {
+      JobStepResult result = job.Step("job");
+      if (result.GetCode() != JobStepCode_Continue)
+      {
+        return result.GetCode();
+      }
+    }
+  }
+}
+
+
+TEST(PluginsParallelJob, Basic)
+{
+  JobTasksExecutor executor;
+  executor.Start(3);
+
+  ParallelJobItems items;
+  items.processed_.resize(100, 0);
+  items.failure_ = -1;
+  items.finalized_ = false;
+
+  OrthancPluginJob* target = NULL;
+
+  _OrthancPluginCreateParallelJob parameters;
+  memset(&parameters, 0, sizeof(parameters));
+  parameters.target = &target;
+  parameters.job = &items;
+  parameters.finalize = FinalizeParallelJob;
+  parameters.type = "Test";
+  parameters.countItems = 100;
+  parameters.maxParallelism = 4;
+  parameters.processItem = ProcessParallelJobItem;
+
+  {
+    PluginsParallelJob job(parameters, executor);
+    ASSERT_FLOAT_EQ(0.0f, job.GetProgress());
+    ASSERT_EQ(JobStepCode_Success, RunParallelJob(job));
+    ASSERT_FLOAT_EQ(1.0f, job.GetProgress());
+
+    for (size_t i = 0; i < items.processed_.size(); i++)
+    {
+      ASSERT_EQ(1, items.processed_[i]);
+    }
+
+    // The items that were processed before a pause are not processed again
+    job.Reset();
+    job.Step("job");
+    job.Stop(JobStopReason_Paused);
+    ASSERT_EQ(JobStepCode_Success, RunParallelJob(job));
+
+    for (size_t i = 0; i < items.processed_.size(); i++)
+    {
+      ASSERT_EQ(2, items.processed_[i]);
+    }
+
+    job.Reset();
+    items.failure_ = 50;
+    ASSERT_EQ(JobStepCode_Failure, RunParallelJob(job));
+    ASSERT_LT(job.GetProgress(), 1.0f);
+    job.Stop(JobStopReason_Failure);
+
+    job.Reset();
+    items.failure_ = -1;
+    ASSERT_EQ(JobStepCode_Success, RunParallelJob(job));
+  }
+
+  ASSERT_TRUE(items.finalized_);
+
+  parameters.countItems = 0;
+
+  {
+    PluginsParallelJob job(parameters, executor);
+    ASSERT_EQ(JobStepCode_Success, RunParallelJob(job));
+  }
+
+  executor.Stop();
+}
+
+
+
+namespace
+{
+  struct CoalescedNotification
+  {
+    std::string              resourceId_;
+    OrthancPluginChangeType  lastChangeType_;
+    uint32_t                 countChanges_;
+  };
+
+  static boost::mutex                        coalescedMutex_;
+  static std::vector<CoalescedNotification>  coalescedNotifications_;
+
+  static OrthancPluginErrorCode CoalescedCallback(OrthancPluginResourceType resourceType,
+                                                  const char* resourceId,
+                                                  OrthancPluginChangeType lastChangeType,
+                                                  uint32_t countChanges)
+  {
+    CoalescedNotification notification;
+    notification.resourceId_ = resourceId;
+    notification.lastChangeType_ = lastChangeType;
+    notification.countChanges_ = countChanges;
+
+    boost::mutex::scoped_lock lock(coalescedMutex_);
+    coalescedNotifications_.push_back(notification);
+    return OrthancPluginErrorCode_Success;
+  }
+}
+
+
+TEST(CoalescedChangeCallback, Basic)
+{
+  PluginsErrorDictionary dictionary;
+  PluginsCallbacksMetrics metrics;
+
+  ASSERT_THROW(CoalescedChangeCallback(dictionary, metrics, CoalescedCallback, OrthancPluginResourceType_Instance, 100),
+               OrthancException);
+  ASSERT_THROW(CoalescedChangeCallback(dictionary, metrics, CoalescedCallback, OrthancPluginResourceType_Study, 0),
+               OrthancException);
+
+  coalescedNotifications_.clear();
+
+  {
+    // Long window, so that all the changes are pending when the callback is stopped
+    CoalescedChangeCallback callback(dictionary, metrics, CoalescedCallback, OrthancPluginResourceType_Study, 60000);
+
+    for (unsigned int i = 0; i < 100; i++)
+    {
+      callback.Enqueue(OrthancPluginChangeType_NewChildInstance, OrthancPluginResourceType_Study, "a");
+      callback.Enqueue(OrthancPluginChangeType_NewInstance, OrthancPluginResourceType_Instance, "instance");
+    }
+
+    callback.Enqueue(OrthancPluginChangeType_NewSeries, OrthancPluginResourceType_Series, "series");
+    callback.Enqueue(OrthancPluginChangeType_NewStudy, OrthancPluginResourceType_Study, "b");
+    callback.Enqueue(OrthancPluginChangeType_StableStudy, OrthancPluginResourceType_Study, "a");
+    callback.Enqueue(OrthancPluginChangeType_NewChildInstance, OrthancPluginResourceType_Study, NULL);
+
+    ASSERT_EQ(2u, callback.GetPendingCount());
+    callback.Stop();
+    ASSERT_EQ(0u, callback.GetPendingCount());
+
+    // Discarded after the stop
+    callback.Enqueue(OrthancPluginChangeType_StableStudy, OrthancPluginResourceType_Study, "b");
+    ASSERT_EQ(0u, callback.GetPendingCount());
+  }
+
+  // The resources are notified in the order their windows were opened
+  ASSERT_EQ(2u, coalescedNotifications_.size());
+  ASSERT_EQ("a", coalescedNotifications_[0].resourceId_);
+  ASSERT_EQ(OrthancPluginChangeType_StableStudy, coalescedNotifications_[0].lastChangeType_);
+  ASSERT_EQ(101u, coalescedNotifications_[0].countChanges_);
+  ASSERT_EQ("b", coalescedNotifications_[1].resourceId_);
+  ASSERT_EQ(OrthancPluginChangeType_NewStudy, coalescedNotifications_[1].lastChangeType_);
+  ASSERT_EQ(1u, coalescedNotifications_[1].countChanges_);
+
+  coalescedNotifications_.clear();
+
+  {
+    CoalescedChangeCallback callback(dictionary, metrics, CoalescedCallback, OrthancPluginResourceType_Series, 10);
+    callback.Enqueue(OrthancPluginChangeType_NewSeries, OrthancPluginResourceType_Series, "c");
+    callback.Enqueue(OrthancPluginChangeType_NewChildInstance, OrthancPluginResourceType_Series, "c");
+
+    for (unsigned int i = 0; i < 200; i++)
+    {
+      {
+        boost::mutex::scoped_lock lock(coalescedMutex_);
+        if (!coalescedNotifications_.empty())
+        {
+          break;
+        }
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+
+    // The notification is sent at the end of the window, without waiting for the stop
+    ASSERT_EQ(0u, callback.GetPendingCount());
+  }
+
+  ASSERT_EQ(1u, coalescedNotifications_.size());
+  ASSERT_EQ("c", coalescedNotifications_[0].resourceId_);
+  ASSERT_EQ(OrthancPluginChangeType_NewChildInstance, coalescedNotifications_[0].lastChangeType_);
+  ASSERT_EQ(2u, coalescedNotifications_[0].countChanges_);
+}
+
 #endif
@@ -30,6 +30,7 @@
 #include "../../OrthancFramework/Sources/Logging.h"
 
 #include "../Sources/Database/SQLiteDatabaseWrapper.h"
+#include "../Sources/MemoryAllocator.h"
 #include "../Sources/ServerContext.h"
 
 using namespace Orthanc;
@@ -171,3 +172,26 @@ TEST(ServerConfig, AcceptedSopClasses)
   context.Stop();
   db.Close();
 }
+
+
+TEST(MemoryAllocator, Statistics)
+{
+  MemoryAllocator::Statistics statistics;
+  MemoryAllocator::GetStatistics(statistics, true);
+
+  Json::Value json;
+  statistics.Format(json);
+  ASSERT_EQ(Json::objectValue, json.type());
+  ASSERT_EQ(std::string(MemoryAllocator::GetName()), json["Allocator"].asString());
+  ASSERT_EQ(MemoryAllocator::IsTrimmingSupported(), json["TrimmingSupported"].asBool());
+  ASSERT_EQ(statistics.HasFragmentedBytes(), json.isMember("FragmentedBytes"));
+
+  if (MemoryAllocator::IsTrimmingSupported())
+  {
+    MemoryAllocator::Trim();
+  }
+  else
+  {
+    ASSERT_THROW(MemoryAllocator::Trim(), OrthancException);
+  }
+}
@@ -29,12 +29,22 @@
 #include "../../OrthancFramework/Sources/FileStorage/MemoryStorageArea.h"
 #include "../../OrthancFramework/Sources/FileStorage/PluginStorageAreaAdapter.h"
 #include "../../OrthancFramework/Sources/Images/Image.h"
+#include "../../OrthancFramework/Sources/Images/JpegReader.h"
 #include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/MetricsRegistry.h"
+#include "../../OrthancFramework/Sources/SystemToolbox.h"
+#include "../../OrthancFramework/Sources/TemporaryFile.h"
 
+#include "../Sources/ChangesFeed.h"
+#include "../Sources/Database/ContentReferences.h"
+#include "../Sources/Database/KeyValueStoresCache.h"
 #include "../Sources/Database/SQLiteDatabaseWrapper.h"
+#include "../Sources/DelayedFilesRemover.h"
 #include "../Sources/DicomInstanceToStore.h"
 #include "../Sources/OrthancConfiguration.h"
 #include "../Sources/Search/DatabaseLookup.h"
+#include "../Sources/Search/ISqlLookupFormatter.h"
+#include "../Sources/SeriesThumbnailsGenerator.h"
 #include "../Sources/ServerContext.h"
 #include "../Sources/ServerToolbox.h"
 
@@ -119,6 +129,26 @@ namespace
       ASSERT_EQ(expected, transaction_->GetTableRecordCount(table));
     }
 
+    void CheckStatistics(int64_t id,
+                         uint64_t expectedStudies,
+                         uint64_t expectedSeries,
+                         uint64_t expectedInstances,
+                         uint64_t expectedSize,
+                         uint64_t expectedDicomSize)
+    {
+      uint64_t countStudies, countSeries, countInstances, compressedSize, uncompressedSize,
+        dicomCompressedSize, dicomUncompressedSize;
+      transaction_->GetResourceStatistics(countStudies, countSeries, countInstances, compressedSize,
+                                          uncompressedSize, dicomCompressedSize, dicomUncompressedSize, id);
+      ASSERT_EQ(expectedStudies, countStudies);
+      ASSERT_EQ(expectedSeries, countSeries);
+      ASSERT_EQ(expectedInstances, countInstances);
+      ASSERT_EQ(expectedSize, compressedSize);
+      ASSERT_EQ(expectedSize, uncompressedSize);
+      ASSERT_EQ(expectedDicomSize, dicomCompressedSize);
+      ASSERT_EQ(expectedDicomSize, dicomUncompressedSize);
+    }
+
     void CheckNoParent(int64_t id)
     {
       std::string s;
@@ -245,6 +275,10 @@ namespace
           THROW_WITH_FILE_AND_LINE_INFO(ErrorCode_NotImplemented);
         }
 
+        virtual void PrepareCommit(IDatabaseWrapper::ITransaction& transaction) ORTHANC_OVERRIDE
+        {
+        }
+
         virtual void Commit() ORTHANC_OVERRIDE
         {
         }
@@ -579,6 +613,63 @@ TEST_F(DatabaseWrapperTest, Upward)
 }
 
 
+TEST_F(DatabaseWrapperTest, ResourceStatistics)
+{
+  int64_t a[] = {
+    transaction_->CreateResource("a", ResourceType_Patient),   // 0
+    transaction_->CreateResource("b", ResourceType_Study),     // 1
+    transaction_->CreateResource("c", ResourceType_Series),    // 2
+    transaction_->CreateResource("d", ResourceType_Instance),  // 3
+    transaction_->CreateResource("e", ResourceType_Instance),  // 4
+    transaction_->CreateResource("f", ResourceType_Study),     // 5
+    transaction_->CreateResource("g", ResourceType_Series),    // 6
+    transaction_->CreateResource("h", ResourceType_Instance)   // 7
+  };
+
+  // Bottom-up attachment, as in "ICreateInstance"
+  transaction_->AttachChild(a[2], a[3]);
+  transaction_->AttachChild(a[1], a[2]);
+  transaction_->AttachChild(a[0], a[1]);
+  transaction_->AttachChild(a[2], a[4]);
+
+  // Top-down attachment, as in the "Simple" test
+  transaction_->AttachChild(a[0], a[5]);
+  transaction_->AttachChild(a[5], a[6]);
+  transaction_->AttachChild(a[6], a[7]);
+
+  transaction_->AddAttachment(a[3], FileInfo("d1", FileContentType_Dicom, 10, "md5"), 42);
+  transaction_->AddAttachment(a[3], FileInfo("d2", FileContentType_DicomAsJson, 1, "md5"), 42);
+  transaction_->AddAttachment(a[4], FileInfo("e1", FileContentType_Dicom, 20, "md5"), 42);
+  transaction_->AddAttachment(a[7], FileInfo("h1", FileContentType_Dicom, 300, "md5"), 42);
+  transaction_->AddAttachment(a[1], FileInfo("b1", FileContentType_DicomAsJson, 4000, "md5"), 42);
+
+  CheckStatistics(a[0], 2, 2, 3, 4331, 330);
+  CheckStatistics(a[1], 1, 1, 2, 4031, 30);
+  CheckStatistics(a[2], 0, 1, 2, 31, 30);
+  CheckStatistics(a[3], 0, 0, 1, 11, 10);
+  CheckStatistics(a[5], 1, 1, 1, 300, 300);
+
+  transaction_->DeleteAttachment(a[3], FileContentType_DicomAsJson);
+  CheckStatistics(a[0], 2, 2, 3, 4330, 330);
+  CheckStatistics(a[2], 0, 1, 2, 30, 30);
+
+  transaction_->DeleteResource(a[3]);
+  CheckStatistics(a[0], 2, 2, 2, 4320, 320);
+  CheckStatistics(a[1], 1, 1, 1, 4020, 20);
+  CheckStatistics(a[2], 0, 1, 1, 20, 20);
+
+  // Deleting the last instance of a series also removes the
+  // series and the study through "ResourceDeletedParentCleaning"
+  transaction_->DeleteResource(a[7]);
+  CheckStatistics(a[0], 1, 1, 1, 4020, 20);
+  ASSERT_THROW(CheckStatistics(a[5], 0, 0, 0, 0, 0), OrthancException);
+
+  transaction_->DeleteResource(a[1]);
+  ASSERT_THROW(CheckStatistics(a[0], 0, 0, 0, 0, 0), OrthancException);
+  CheckTableRecordCount(0u, "ResourcesStatistics");
+}
+
+
 TEST_F(DatabaseWrapperTest, PatientRecycling)
 {
   std::vector<int64_t> patients;
@@ -745,6 +836,220 @@ TEST(ServerIndex, Sequence)
 }
 
 
+TEST(ServerIndex, ChangesFeed)
+{
+  {
+    ChangesFeed feed;
+
+    const uint64_t generation = feed.GetGeneration();
+    ASSERT_FALSE(feed.WaitChange(generation, 10));
+
+    feed.SignalChange();
+    ASSERT_TRUE(feed.WaitChange(generation, 1000));
+    ASSERT_FALSE(feed.WaitChange(feed.GetGeneration(), 10));
+
+    feed.Stop();
+    ASSERT_TRUE(feed.IsStopped());
+    ASSERT_FALSE(feed.WaitChange(generation, 1000));
+  }
+
+  const std::string path = "UnitTestsStorage";
+
+  SystemToolbox::RemoveFile(path + "/index");
+  PluginStorageAreaAdapter storage(new FilesystemStorage(path));
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */, 10, false /* readonly */);
+  context.SetupJobsEngine(true, false);
+
+  std::list<ServerIndexChange> changes;
+  ASSERT_TRUE(context.GetIndex().GetChanges(changes, 0, 10));
+  ASSERT_TRUE(changes.empty());
+
+  const uint64_t generation = context.GetChangesFeed().GetGeneration();
+  context.SignalChange(ServerIndexChange(ChangeType_Deleted, ResourceType_Patient, "nope"));
+  ASSERT_TRUE(context.GetChangesFeed().WaitChange(generation, 1000));
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, OperationsStatistics)
+{
+  const std::string path = "UnitTestsStorage";
+
+  SystemToolbox::RemoveFile(path + "/index");
+  PluginStorageAreaAdapter storage(new FilesystemStorage(path));
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */, 10, false /* readonly */);
+  context.SetupJobsEngine(true, false);
+
+  ServerIndex& index = context.GetIndex();
+
+  uint64_t transactions, retries, failures;
+  ASSERT_FALSE(index.GetStatistics().LookupOperation(transactions, retries, failures, "IncrementGlobalSequence"));
+
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    index.IncrementGlobalSequence(GlobalProperty_AnonymizationSequence, true);
+  }
+
+  ASSERT_TRUE(index.GetStatistics().LookupOperation(transactions, retries, failures, "IncrementGlobalSequence"));
+  ASSERT_EQ(3u, transactions);
+  ASSERT_EQ(0u, retries);
+  ASSERT_EQ(0u, failures);
+
+  MetricsRegistry registry;
+  index.PublishMetrics(registry);
+
+  std::string s;
+  registry.ExportPrometheusText(s);
+  ASSERT_NE(std::string::npos, s.find("orthanc_database_transaction_duration_ms_count{operation=\"IncrementGlobalSequence\"} 3 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_database_transaction_duration_ms_bucket{operation=\"IncrementGlobalSequence\",le=\"+Inf\"} 3 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_database_wait_ms_count{operation=\"IncrementGlobalSequence\"} 3 "));
+  ASSERT_NE(std::string::npos, s.find("orthanc_database_retries_total{operation=\"IncrementGlobalSequence\"} 0 "));
+
+  context.Stop();
+  db.Close();
+}
+
+TEST(ServerIndex, LookupAnswersCache)
+{
+  const std::string path = "UnitTestsStorage";
+
+  SystemToolbox::RemoveFile(path + "/index");
+  PluginStorageAreaAdapter storage(new FilesystemStorage(path));
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */, 10, false /* readonly */);
+  context.SetupJobsEngine(true, false);
+
+  ServerIndex& index = context.GetIndex();
+
+  ASSERT_THROW(LookupAnswersCache(0, 0), OrthancException);
+
+  LookupAnswersCache cache(2, 0 /* no staleness */);
+
+  const LookupAnswersCache::Stamp stamp1(index);
+  ASSERT_TRUE(LookupAnswersCache::Stamp(index) == stamp1);
+  ASSERT_TRUE(cache.Lookup("a", stamp1).get() == NULL);
+
+  cache.Store("a", stamp1, boost::shared_ptr<IDynamicObject>(new SingleValueObject<int>(42)));
+  ASSERT_EQ(1u, cache.GetNumberOfItems());
+
+  boost::shared_ptr<IDynamicObject> answer = cache.Lookup("a", stamp1);
+  ASSERT_TRUE(answer.get() != NULL);
+  ASSERT_EQ(42, dynamic_cast<SingleValueObject<int>&>(*answer).GetValue());
+
+  // The writes that log no change (such as deletions) also modify the stamp
+  index.IncrementGlobalSequence(GlobalProperty_AnonymizationSequence, true);
+
+  const LookupAnswersCache::Stamp stamp2(index);
+  ASSERT_FALSE(stamp2 == stamp1);
+  ASSERT_TRUE(cache.Lookup("a", stamp2).get() == NULL);
+  ASSERT_EQ(0u, cache.GetNumberOfItems());
+
+  cache.Store("a", stamp2, boost::shared_ptr<IDynamicObject>(new SingleValueObject<int>(1)));
+  cache.Store("b", stamp2, boost::shared_ptr<IDynamicObject>(new SingleValueObject<int>(2)));
+  ASSERT_TRUE(cache.Lookup("a", stamp2).get() != NULL);  // "b" becomes the oldest
+  cache.Store("c", stamp2, boost::shared_ptr<IDynamicObject>(new SingleValueObject<int>(3)));
+  ASSERT_EQ(2u, cache.GetNumberOfItems());
+  ASSERT_TRUE(cache.Lookup("b", stamp2).get() == NULL);
+  ASSERT_TRUE(cache.Lookup("c", stamp2).get() != NULL);
+
+  CacheStatistics statistics;
+  cache.GetStatistics(statistics);
+  ASSERT_EQ(3u, statistics.GetHits());
+  ASSERT_EQ(3u, statistics.GetMisses());
+  ASSERT_EQ(1u, statistics.GetEvictions());
+
+  cache.SetMaximumSize(1);
+  ASSERT_EQ(1u, cache.GetNumberOfItems());
+
+  {
+    // Within the staleness window, the answers survive the writes
+    LookupAnswersCache stale(10, 3600);
+    stale.Store("a", stamp1, boost::shared_ptr<IDynamicObject>(new SingleValueObject<int>(42)));
+    ASSERT_TRUE(stale.Lookup("a", stamp2).get() != NULL);
+  }
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, RenderedFramesCache)
+{
+  ASSERT_THROW(RenderedFramesCache(0), OrthancException);
+
+  std::string content;
+  MimeType mime;
+
+  {
+    RenderedFramesCache cache(10);
+    ASSERT_FALSE(cache.Lookup(content, mime, "a"));
+
+    cache.Store("a", "i1", MimeType_Png, "hello");
+    cache.Store("b", "i2", MimeType_Jpeg, "world");
+    cache.Store("c", "i1", MimeType_Pam, "too large for the cache");
+    ASSERT_EQ(2u, cache.GetNumberOfItems());
+    ASSERT_EQ(10u, cache.GetCurrentSize());
+
+    ASSERT_TRUE(cache.Lookup(content, mime, "a"));  // "b" becomes the oldest
+    ASSERT_EQ("hello", content);
+    ASSERT_EQ(MimeType_Png, mime);
+
+    cache.Store("d", "i3", MimeType_Png, "!");
+    ASSERT_EQ(2u, cache.GetNumberOfItems());
+    ASSERT_FALSE(cache.Lookup(content, mime, "b"));
+
+    cache.InvalidateInstance("i1");
+    ASSERT_EQ(1u, cache.GetNumberOfItems());
+    ASSERT_EQ(1u, cache.GetCurrentSize());
+    ASSERT_FALSE(cache.Lookup(content, mime, "a"));
+    ASSERT_TRUE(cache.Lookup(content, mime, "d"));
+
+    CacheStatistics statistics;
+    cache.GetStatistics(statistics);
+    ASSERT_EQ(2u, statistics.GetHits());
+    ASSERT_EQ(3u, statistics.GetMisses());
+    ASSERT_EQ(1u, statistics.GetEvictions());
+  }
+
+  {
+    // The images that are evicted from RAM are spilled into the disk cache
+    const boost::filesystem::path root("UnitTestsResults/RenderedFramesCache");
+    boost::filesystem::remove_all(root);
+
+    RenderedFramesCache cache(5);
+    cache.SetDiskCache(new StorageDiskCache(root, 1024));
+
+    cache.Store("a", "i1", MimeType_Png, "hello");
+    cache.Store("b", "i2", MimeType_Jpeg, "world");
+    ASSERT_EQ(1u, cache.GetNumberOfItems());
+    ASSERT_EQ(1u, cache.GetDiskCache()->GetNumberOfItems());
+
+    ASSERT_TRUE(cache.Lookup(content, mime, "a"));  // Read back from the disk
+    ASSERT_EQ("hello", content);
+    ASSERT_EQ(MimeType_Png, mime);
+    ASSERT_EQ(1u, cache.GetNumberOfItems());
+    ASSERT_EQ(2u, cache.GetDiskCache()->GetNumberOfItems());
+
+    ASSERT_TRUE(cache.Lookup(content, mime, "b"));
+    ASSERT_EQ("world", content);
+    ASSERT_EQ(MimeType_Jpeg, mime);
+
+    cache.InvalidateInstance("i1");
+    ASSERT_EQ(1u, cache.GetDiskCache()->GetNumberOfItems());
+    ASSERT_FALSE(cache.Lookup(content, mime, "a"));
+
+    ASSERT_THROW(cache.SetDiskCache(NULL), OrthancException);
+  }
+}
+
+
 TEST_F(DatabaseWrapperTest, LookupIdentifier)
 {
   int64_t a[] = {
@@ -804,6 +1109,79 @@ TEST_F(DatabaseWrapperTest, LookupIdentifier)
 }
 
 
+TEST_F(DatabaseWrapperTest, KeysetPagination)
+{
+  ASSERT_TRUE(index_->GetDatabaseCapabilities().HasKeysetPaginationSupport());
+
+  // The public IDs are not sorted in the order of insertion
+  std::vector<int64_t> a;
+  a.push_back(transaction_->CreateResource("e", ResourceType_Patient));
+  a.push_back(transaction_->CreateResource("d", ResourceType_Patient));
+  a.push_back(transaction_->CreateResource("x", ResourceType_Study));
+  a.push_back(transaction_->CreateResource("c", ResourceType_Patient));
+  a.push_back(transaction_->CreateResource("b", ResourceType_Patient));
+  a.push_back(transaction_->CreateResource("a", ResourceType_Patient));
+
+  std::string s;
+  int64_t last = 0;
+
+  for (unsigned int page = 0; page < 4; page++)
+  {
+    FindRequest request(ResourceType_Patient);
+    request.SetLimits(0, 2);
+    request.SetKeysetPagination(last);
+
+    FindResponse response;
+    transaction_->ExecuteFind(response, request, index_->GetDatabaseCapabilities());
+
+    for (size_t i = 0; i < response.GetSize(); i++)
+    {
+      ASSERT_LT(last, response.GetResourceByIndex(i).GetInternalId());
+      last = response.GetResourceByIndex(i).GetInternalId();
+      s += response.GetResourceByIndex(i).GetIdentifier();
+    }
+
+    switch (page)
+    {
+      case 0:
+      case 1:
+        ASSERT_EQ(2u, response.GetSize());
+        break;
+      case 2:
+        ASSERT_EQ(1u, response.GetSize());
+        ASSERT_EQ(a[5], last);
+        break;
+      default:
+        ASSERT_EQ(0u, response.GetSize());
+    }
+  }
+
+  ASSERT_EQ("edcba", s);
+
+  {
+    FindRequest request(ResourceType_Patient);
+    request.SetLimits(1, 2);
+    request.SetKeysetPagination(0);
+
+    FindResponse response;
+    ASSERT_THROW(transaction_->ExecuteFind(response, request, index_->GetDatabaseCapabilities()), OrthancException);
+  }
+
+  {
+    FindRequest request(ResourceType_Patient);
+    request.AddOrdering(DICOM_TAG_PATIENT_NAME, FindRequest::OrderingCast_String, FindRequest::OrderingDirection_Ascending);
+    request.SetKeysetPagination(0);
+
+    FindResponse response;
+    ASSERT_THROW(transaction_->ExecuteFind(response, request, index_->GetDatabaseCapabilities()), OrthancException);
+  }
+
+  FindRequest request(ResourceType_Patient);
+  ASSERT_THROW(request.SetKeysetPagination(-1), OrthancException);
+  ASSERT_THROW(request.GetKeysetLastInternalId(), OrthancException);
+}
+
+
 TEST(ServerIndex, AttachmentRecycling)
 {
   const std::string path = "UnitTestsStorage";
@@ -1163,83 +1541,453 @@ TEST(ServerIndex, DicomUntilPixelData)
 }
 
 
-TEST(ServerToolbox, ValidLabels)
+TEST(ServerIndex, ReplaceInstanceEncoding)
 {
-  ASSERT_TRUE(ServerToolbox::IsValidLabel("abcdefghijklmnopqrstuvwxyz"
-                                          "ABCDEFGHIJKLMNOPQRSTUVWXYZ"));
-  ASSERT_TRUE(ServerToolbox::IsValidLabel("0123456789-_"));
-  ASSERT_FALSE(ServerToolbox::IsValidLabel(""));
-  ASSERT_FALSE(ServerToolbox::IsValidLabel(" "));
-  ASSERT_FALSE(ServerToolbox::IsValidLabel("&"));
-  ASSERT_FALSE(ServerToolbox::IsValidLabel("."));
+  Image image(PixelFormat_Grayscale8, 1, 1, false);
+  reinterpret_cast<uint8_t*>(image.GetBuffer()) [0] = 128;
+
+  PluginStorageAreaAdapter storage(new MemoryStorageArea);
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */, 10, false /* readonly */);
+  context.SetupJobsEngine(true, false);
+  context.SetCompressionEnabled(false);
+
+  std::string id;
+
+  {
+    ParsedDicomFile dicom(true);
+    dicom.EmbedImage(image);
+
+    std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromParsedDicomFile(dicom));
+    toStore->SetOrigin(DicomInstanceOrigin::FromPlugins());
+    ASSERT_EQ(StoreStatus_Success, context.Store(id, *toStore).GetStatus());
+  }
+
+  FileInfo original;
+  int64_t revision;
+  ASSERT_TRUE(context.GetIndex().LookupAttachment(original, revision, ResourceType_Instance, id, FileContentType_Dicom));
+  ASSERT_EQ(0, revision);
+
+  StatelessDatabaseOperations::Attachments attachments;
+  attachments.push_back(FileInfo(Toolbox::GenerateUuid(), FileContentType_Dicom, 42, "md5"));
+
+  // The expected DICOM file doesn't match
+  ASSERT_THROW(context.GetIndex().ReplaceInstanceEncoding(id, "nope", attachments, DicomTransferSyntax_JPEGProcess1,
+                                                          true, 1234, false, ValueRepresentation_OtherByte),
+               OrthancException);
+  ASSERT_THROW(context.GetIndex().ReplaceInstanceEncoding("nope", original.GetUuid(), attachments, DicomTransferSyntax_JPEGProcess1,
+                                                          true, 1234, false, ValueRepresentation_OtherByte),
+               OrthancException);
+
+  context.GetIndex().ReplaceInstanceEncoding(id, original.GetUuid(), attachments, DicomTransferSyntax_JPEGProcess1,
+                                             true, 1234, false, ValueRepresentation_OtherByte);
+
+  FileInfo replaced;
+  ASSERT_TRUE(context.GetIndex().LookupAttachment(replaced, revision, ResourceType_Instance, id, FileContentType_Dicom));
+  ASSERT_EQ(1, revision);
+  ASSERT_EQ(attachments.front().GetUuid(), replaced.GetUuid());
+  ASSERT_EQ(42u, replaced.GetUncompressedSize());
+
+  std::string s;
+  ASSERT_TRUE(context.GetIndex().LookupMetadata(s, id, ResourceType_Instance, MetadataType_Instance_TransferSyntax));
+  ASSERT_EQ(GetTransferSyntaxUid(DicomTransferSyntax_JPEGProcess1), s);
+  ASSERT_TRUE(context.GetIndex().LookupMetadata(s, revision, id, ResourceType_Instance, MetadataType_Instance_PixelDataOffset));
+  ASSERT_EQ("1234", s);
+  ASSERT_EQ(1, revision);
+  ASSERT_FALSE(context.GetIndex().LookupMetadata(s, id, ResourceType_Instance, MetadataType_Instance_PixelDataVR));
+
+  // A second swap against the original file must fail
+  ASSERT_THROW(context.GetIndex().ReplaceInstanceEncoding(id, original.GetUuid(), attachments, DicomTransferSyntax_JPEGProcess1,
+                                                          true, 1234, false, ValueRepresentation_OtherByte),
+               OrthancException);
+
+  context.Stop();
 }
 
 
-TEST(SQLiteDatabaseWrapper, KeyValueStores)
+static void StoreInThread(ServerContext* context,
+                          const std::string* buffer,
+                          StoreStatus* status)
+{
+  std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromBuffer(*buffer));
+  toStore->SetOrigin(DicomInstanceOrigin::FromPlugins());
+
+  try
+  {
+    std::string id;
+    *status = context->Store(id, *toStore).GetStatus();
+  }
+  catch (OrthancException& e)
+  {
+    *status = (e.GetErrorCode() == ErrorCode_FullStorage ? StoreStatus_StorageFull : StoreStatus_Failure);
+  }
+}
+
+
+TEST(ServerIndex, IngestBatching)
 {
+  PluginStorageAreaAdapter storage(new MemoryStorageArea);
   SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
   db.Open();
+  ServerContext context(db, storage, true /* running unit tests */, 10, false /* readonly */);
+  context.SetupJobsEngine(true, false);
 
-  {
-    StatelessDatabaseOperations op(db, false);
-    op.SetTransactionContextFactory(new DummyTransactionContextFactory);
+  ASSERT_THROW(context.GetIndex().SetIngestBatching(20, 0), OrthancException);
+  context.GetIndex().SetIngestBatching(20 /* ms */, 4);
 
-    for (unsigned int limit = 0; limit < 5; limit++)
+  static const size_t COUNT = 10;
+
+  {
+    // The last instance is a duplicate of the first one
+    std::vector<std::string> buffers(COUNT + 1);
+    for (size_t i = 0; i < COUNT; i++)
     {
-      StatelessDatabaseOperations::KeysValuesIterator it(op, "test");
-      it.SetLimit(limit);
-      ASSERT_THROW(it.GetValue(), OrthancException);
-      ASSERT_THROW(it.GetKey(), OrthancException);
-      ASSERT_FALSE(it.Next());
-      ASSERT_THROW(it.GetValue(), OrthancException);
-      ASSERT_THROW(it.GetKey(), OrthancException);
+      ParsedDicomFile dicom(true);
+      dicom.SaveToMemoryBuffer(buffers[i]);
     }
 
-    op.StoreKeyValue("test", "hello", "world");
+    buffers[COUNT] = buffers[0];
 
-    for (unsigned int limit = 0; limit < 5; limit++)
+    std::vector<StoreStatus> statuses(buffers.size(), StoreStatus_Failure);
+    std::vector<boost::thread*> threads(buffers.size());
+
+    for (size_t i = 0; i < threads.size(); i++)
     {
-      StatelessDatabaseOperations::KeysValuesIterator it(op, "test");
-      it.SetLimit(limit);
-      ASSERT_THROW(it.GetValue(), OrthancException);
-      ASSERT_THROW(it.GetKey(), OrthancException);
-      ASSERT_TRUE(it.Next());
-      ASSERT_EQ("hello", it.GetKey());
-      ASSERT_EQ("world", it.GetValue());
-      ASSERT_FALSE(it.Next());
-      ASSERT_THROW(it.GetValue(), OrthancException);
-      ASSERT_THROW(it.GetKey(), OrthancException);
+      threads[i] = new boost::thread(StoreInThread, &context, &buffers[i], &statuses[i]);
     }
 
-    op.StoreKeyValue("test", "hello2", "world2");
-    op.StoreKeyValue("test", "hello3", "world3");
-
-    for (unsigned int limit = 0; limit < 5; limit++)
+    for (size_t i = 0; i < threads.size(); i++)
     {
-      StatelessDatabaseOperations::KeysValuesIterator it(op, "test");
-      it.SetLimit(limit);
-      ASSERT_THROW(it.GetValue(), OrthancException);
-      ASSERT_THROW(it.GetKey(), OrthancException);
-      ASSERT_TRUE(it.Next());
-      ASSERT_EQ("hello", it.GetKey());
-      ASSERT_EQ("world", it.GetValue());
-      ASSERT_TRUE(it.Next());
-      ASSERT_EQ("hello2", it.GetKey());
-      ASSERT_EQ("world2", it.GetValue());
-      ASSERT_TRUE(it.Next());
-      ASSERT_EQ("hello3", it.GetKey());
-      ASSERT_EQ("world3", it.GetValue());
-      ASSERT_FALSE(it.Next());
-      ASSERT_THROW(it.GetValue(), OrthancException);
-      ASSERT_THROW(it.GetKey(), OrthancException);
+      threads[i]->join();
+      delete threads[i];
     }
 
-    op.DeleteKeyValue("test", "hello2");
+    ASSERT_EQ(COUNT, static_cast<size_t>(std::count(statuses.begin(), statuses.end(), StoreStatus_Success)));
+    ASSERT_EQ(1, std::count(statuses.begin(), statuses.end(), StoreStatus_AlreadyStored));
+  }
+
+  uint64_t diskSize, uncompressedSize, countPatients, countStudies, countSeries, countInstances;
+  context.GetIndex().GetGlobalStatistics(diskSize, uncompressedSize, countPatients,
+                                         countStudies, countSeries, countInstances);
+  ASSERT_EQ(COUNT, countInstances);
+  ASSERT_EQ(COUNT, countPatients);
+
+  {
+    // Only one more patient is accepted: A batch that contains both
+    // instances is rolled back, then each instance gets its own status
+    context.GetIndex().SetMaximumStorageMode(MaxStorageMode_Reject);
+    context.GetIndex().SetMaximumPatientCount(COUNT + 1);
+
+    std::string buffer1, buffer2;
 
-    for (unsigned int limit = 0; limit < 5; limit++)
     {
-      StatelessDatabaseOperations::KeysValuesIterator it(op, "test");
-      it.SetLimit(limit);
+      ParsedDicomFile dicom1(true);
+      ParsedDicomFile dicom2(true);
+      dicom1.SaveToMemoryBuffer(buffer1);
+      dicom2.SaveToMemoryBuffer(buffer2);
+    }
+
+    StoreStatus status1 = StoreStatus_Failure;
+    StoreStatus status2 = StoreStatus_Failure;
+
+    boost::thread thread1(StoreInThread, &context, &buffer1, &status1);
+    boost::thread thread2(StoreInThread, &context, &buffer2, &status2);
+    thread1.join();
+    thread2.join();
+
+    ASSERT_TRUE((status1 == StoreStatus_Success && status2 == StoreStatus_StorageFull) ||
+                (status1 == StoreStatus_StorageFull && status2 == StoreStatus_Success));
+  }
+
+  context.GetIndex().GetGlobalStatistics(diskSize, uncompressedSize, countPatients,
+                                         countStudies, countSeries, countInstances);
+  ASSERT_EQ(COUNT + 1, countInstances);
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, BackgroundRecycling)
+{
+  PluginStorageAreaAdapter storage(new MemoryStorageArea);
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */, 10, false /* readonly */);
+  context.SetupJobsEngine(true, false);
+
+  ASSERT_THROW(context.GetIndex().SetBackgroundRecycling(101, 50), OrthancException);
+  ASSERT_THROW(context.GetIndex().SetBackgroundRecycling(50, 50), OrthancException);
+  ASSERT_THROW(context.GetIndex().SetBackgroundRecycling(50, 0), OrthancException);
+
+  context.GetIndex().SetMaximumPatientCount(10);
+
+  // Below the limit of 10 patients, the stores never recycle by themselves
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    ParsedDicomFile dicom(true);
+    std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromParsedDicomFile(dicom));
+    std::string id;
+    ASSERT_EQ(StoreStatus_Success, context.Store(id, *toStore).GetStatus());
+  }
+
+  // The background thread recycles down to 3 patients (30% of 10)
+  context.GetIndex().SetBackgroundRecycling(60 /* high */, 30 /* low */);
+
+  uint64_t diskSize, uncompressedSize, countPatients, countStudies, countSeries, countInstances;
+
+  for (unsigned int i = 0; i < 100; i++)
+  {
+    context.GetIndex().GetGlobalStatistics(diskSize, uncompressedSize, countPatients,
+                                           countStudies, countSeries, countInstances);
+    if (countPatients <= 3)
+    {
+      break;
+    }
+
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  }
+
+  ASSERT_EQ(3u, countPatients);
+  ASSERT_EQ(3u, countInstances);
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, TranscodedAttachments)
+{
+  const FileContentType jpeg = GetTranscodedInstanceContentType(DicomTransferSyntax_JPEGProcess1);
+  ASSERT_GE(jpeg, FileContentType_TranscodedInstanceFirst);
+  ASSERT_LE(jpeg, FileContentType_TranscodedInstanceLast);
+  ASSERT_FALSE(IsUserContentType(jpeg));
+  ASSERT_EQ("transcoded-1.2.840.10008.1.2.4.50", EnumerationToString(jpeg));
+  ASSERT_EQ(jpeg, StringToContentType("transcoded-1.2.840.10008.1.2.4.50"));
+  ASSERT_EQ("application/dicom", GetFileContentMime(jpeg));
+
+  std::set<DicomTransferSyntax> syntaxes;
+  GetAllDicomTransferSyntaxes(syntaxes);
+
+  std::set<FileContentType> types;
+  for (std::set<DicomTransferSyntax>::const_iterator it = syntaxes.begin(); it != syntaxes.end(); ++it)
+  {
+    const FileContentType type = GetTranscodedInstanceContentType(*it);
+    types.insert(type);
+
+    DicomTransferSyntax syntax;
+    ASSERT_TRUE(LookupTranscodedInstanceSyntax(syntax, type));
+    ASSERT_EQ(*it, syntax);
+  }
+
+  ASSERT_EQ(syntaxes.size(), types.size());
+
+  DicomTransferSyntax syntax;
+  ASSERT_FALSE(LookupTranscodedInstanceSyntax(syntax, FileContentType_Dicom));
+  ASSERT_FALSE(LookupTranscodedInstanceSyntax(syntax, FileContentType_SeriesThumbnail));
+  ASSERT_FALSE(LookupTranscodedInstanceSyntax(syntax, FileContentType_TranscodedInstanceLast));
+  ASSERT_FALSE(LookupTranscodedInstanceSyntax(syntax, FileContentType_StartUser));
+}
+
+
+TEST(ServerIndex, SeriesThumbnails)
+{
+  ASSERT_EQ(FileContentType_SeriesThumbnail, StringToContentType("series-thumbnail"));
+  ASSERT_EQ("series-thumbnail", EnumerationToString(FileContentType_SeriesThumbnail));
+  ASSERT_EQ("image/jpeg", GetFileContentMime(FileContentType_SeriesThumbnail));
+
+  PluginStorageAreaAdapter storage(new MemoryStorageArea);
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */, 10, false /* readonly */);
+  context.SetupJobsEngine(true, false);
+
+  // Create a 64x32 gradient
+  Image image(PixelFormat_Grayscale8, 64, 32, false);
+  for (unsigned int y = 0; y < image.GetHeight(); y++)
+  {
+    uint8_t* row = reinterpret_cast<uint8_t*>(image.GetRow(y));
+    for (unsigned int x = 0; x < image.GetWidth(); x++)
+    {
+      row[x] = static_cast<uint8_t>(4 * x);
+    }
+  }
+
+  std::string id;
+
+  {
+    ParsedDicomFile dicom(true);
+    dicom.EmbedImage(image);
+
+    std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromParsedDicomFile(dicom));
+    toStore->SetOrigin(DicomInstanceOrigin::FromPlugins());
+    ASSERT_EQ(StoreStatus_Success, context.Store(id, *toStore).GetStatus());
+  }
+
+  ASSERT_THROW(SeriesThumbnailsGenerator::RenderThumbnail(id, context, id, 0), OrthancException);
+
+  {
+    // Downscaling, with the aspect ratio being kept
+    std::string jpeg;
+    SeriesThumbnailsGenerator::RenderThumbnail(jpeg, context, id, 16);
+
+    JpegReader reader;
+    reader.ReadFromMemory(jpeg);
+    ASSERT_EQ(PixelFormat_Grayscale8, reader.GetFormat());
+    ASSERT_EQ(16u, reader.GetWidth());
+    ASSERT_EQ(8u, reader.GetHeight());
+  }
+
+  {
+    // No upscaling
+    std::string jpeg;
+    SeriesThumbnailsGenerator::RenderThumbnail(jpeg, context, id, 128);
+
+    JpegReader reader;
+    reader.ReadFromMemory(jpeg);
+    ASSERT_EQ(64u, reader.GetWidth());
+    ASSERT_EQ(32u, reader.GetHeight());
+  }
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, ResourcesCache)
+{
+  PluginStorageAreaAdapter storage(new MemoryStorageArea);
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */, 10, false /* readonly */);
+  context.SetupJobsEngine(true, false);
+  context.GetIndex().SetResourcesCacheSize(2);
+
+  std::string instance;
+
+  {
+    ParsedDicomFile dicom(true);
+    std::unique_ptr<DicomInstanceToStore> toStore(DicomInstanceToStore::CreateFromParsedDicomFile(dicom));
+    toStore->SetOrigin(DicomInstanceOrigin::FromPlugins());
+    ASSERT_EQ(StoreStatus_Success, context.Store(instance, *toStore).GetStatus());
+  }
+
+  // Looking up twice the chain of parents, the second time from the cache
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    std::string series, study, patient, tmp;
+    ResourceType type;
+    ASSERT_TRUE(context.GetIndex().LookupResourceType(type, instance));
+    ASSERT_EQ(ResourceType_Instance, type);
+    ASSERT_TRUE(context.GetIndex().LookupParent(series, instance));
+    ASSERT_TRUE(context.GetIndex().LookupParent(study, series));
+    ASSERT_TRUE(context.GetIndex().LookupParent(patient, study));
+    ASSERT_FALSE(context.GetIndex().LookupParent(tmp, patient));
+    ASSERT_TRUE(context.GetIndex().LookupResourceType(type, patient));
+    ASSERT_EQ(ResourceType_Patient, type);
+  }
+
+  {
+    ResourceType type;
+    std::string tmp;
+    ASSERT_FALSE(context.GetIndex().LookupResourceType(type, "nope"));
+    ASSERT_THROW(context.GetIndex().LookupParent(tmp, "nope"), OrthancException);
+  }
+
+  Json::Value remainingAncestor;
+  ASSERT_TRUE(context.DeleteResource(remainingAncestor, instance, ResourceType_Instance));
+
+  {
+    // The deleted resource must not be served from the cache
+    ResourceType type;
+    std::string tmp;
+    ASSERT_FALSE(context.GetIndex().LookupResourceType(type, instance));
+    ASSERT_THROW(context.GetIndex().LookupParent(tmp, instance), OrthancException);
+  }
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerToolbox, ValidLabels)
+{
+  ASSERT_TRUE(ServerToolbox::IsValidLabel("abcdefghijklmnopqrstuvwxyz"
+                                          "ABCDEFGHIJKLMNOPQRSTUVWXYZ"));
+  ASSERT_TRUE(ServerToolbox::IsValidLabel("0123456789-_"));
+  ASSERT_FALSE(ServerToolbox::IsValidLabel(""));
+  ASSERT_FALSE(ServerToolbox::IsValidLabel(" "));
+  ASSERT_FALSE(ServerToolbox::IsValidLabel("&"));
+  ASSERT_FALSE(ServerToolbox::IsValidLabel("."));
+}
+
+
+TEST(SQLiteDatabaseWrapper, KeyValueStores)
+{
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+
+  {
+    StatelessDatabaseOperations op(db, false);
+    op.SetTransactionContextFactory(new DummyTransactionContextFactory);
+
+    for (unsigned int limit = 0; limit < 5; limit++)
+    {
+      StatelessDatabaseOperations::KeysValuesIterator it(op, "test");
+      it.SetLimit(limit);
+      ASSERT_THROW(it.GetValue(), OrthancException);
+      ASSERT_THROW(it.GetKey(), OrthancException);
+      ASSERT_FALSE(it.Next());
+      ASSERT_THROW(it.GetValue(), OrthancException);
+      ASSERT_THROW(it.GetKey(), OrthancException);
+    }
+
+    op.StoreKeyValue("test", "hello", "world");
+
+    for (unsigned int limit = 0; limit < 5; limit++)
+    {
+      StatelessDatabaseOperations::KeysValuesIterator it(op, "test");
+      it.SetLimit(limit);
+      ASSERT_THROW(it.GetValue(), OrthancException);
+      ASSERT_THROW(it.GetKey(), OrthancException);
+      ASSERT_TRUE(it.Next());
+      ASSERT_EQ("hello", it.GetKey());
+      ASSERT_EQ("world", it.GetValue());
+      ASSERT_FALSE(it.Next());
+      ASSERT_THROW(it.GetValue(), OrthancException);
+      ASSERT_THROW(it.GetKey(), OrthancException);
+    }
+
+    op.StoreKeyValue("test", "hello2", "world2");
+    op.StoreKeyValue("test", "hello3", "world3");
+
+    for (unsigned int limit = 0; limit < 5; limit++)
+    {
+      StatelessDatabaseOperations::KeysValuesIterator it(op, "test");
+      it.SetLimit(limit);
+      ASSERT_THROW(it.GetValue(), OrthancException);
+      ASSERT_THROW(it.GetKey(), OrthancException);
+      ASSERT_TRUE(it.Next());
+      ASSERT_EQ("hello", it.GetKey());
+      ASSERT_EQ("world", it.GetValue());
+      ASSERT_TRUE(it.Next());
+      ASSERT_EQ("hello2", it.GetKey());
+      ASSERT_EQ("world2", it.GetValue());
+      ASSERT_TRUE(it.Next());
+      ASSERT_EQ("hello3", it.GetKey());
+      ASSERT_EQ("world3", it.GetValue());
+      ASSERT_FALSE(it.Next());
+      ASSERT_THROW(it.GetValue(), OrthancException);
+      ASSERT_THROW(it.GetKey(), OrthancException);
+    }
+
+    op.DeleteKeyValue("test", "hello2");
+
+    for (unsigned int limit = 0; limit < 5; limit++)
+    {
+      StatelessDatabaseOperations::KeysValuesIterator it(op, "test");
+      it.SetLimit(limit);
       ASSERT_TRUE(it.Next());
       ASSERT_EQ("hello", it.GetKey());
       ASSERT_EQ("world", it.GetValue());
@@ -1249,49 +1997,906 @@ TEST(SQLiteDatabaseWrapper, KeyValueStores)
       ASSERT_FALSE(it.Next());
     }
 
-    std::string s;
-    ASSERT_TRUE(op.GetKeyValue(s, "test", "hello"));   ASSERT_EQ("world", s);
-    ASSERT_TRUE(op.GetKeyValue(s, "test", "hello3"));  ASSERT_EQ("world3", s);
-    ASSERT_FALSE(op.GetKeyValue(s, "test", "hello2"));
+    std::string s;
+    ASSERT_TRUE(op.GetKeyValue(s, "test", "hello"));   ASSERT_EQ("world", s);
+    ASSERT_TRUE(op.GetKeyValue(s, "test", "hello3"));  ASSERT_EQ("world3", s);
+    ASSERT_FALSE(op.GetKeyValue(s, "test", "hello2"));
+
+    ASSERT_TRUE(op.GetKeyValue(s, "test", "hello"));   ASSERT_EQ("world", s);
+    op.StoreKeyValue("test", "hello", "overwritten");
+    ASSERT_TRUE(op.GetKeyValue(s, "test", "hello"));   ASSERT_EQ("overwritten", s);
+
+    op.DeleteKeyValue("test", "nope");
+
+    op.DeleteKeyValue("test", "hello");
+    op.DeleteKeyValue("test", "hello3");
+
+    for (unsigned int limit = 0; limit < 5; limit++)
+    {
+      StatelessDatabaseOperations::KeysValuesIterator it(op, "test");
+      it.SetLimit(limit);
+      ASSERT_FALSE(it.Next());
+    }
+
+    {
+      std::string blob;
+      blob.push_back(0);
+      blob.push_back(1);
+      blob.push_back(0);
+      blob.push_back(2);
+      op.StoreKeyValue("test", "blob", blob); // Storing binary values
+    }
+
+    ASSERT_TRUE(op.GetKeyValue(s, "test", "blob"));
+    ASSERT_EQ(4u, s.size());
+    ASSERT_EQ(0, static_cast<uint8_t>(s[0]));
+    ASSERT_EQ(1, static_cast<uint8_t>(s[1]));
+    ASSERT_EQ(0, static_cast<uint8_t>(s[2]));
+    ASSERT_EQ(2, static_cast<uint8_t>(s[3]));
+    op.DeleteKeyValue("test", "blob");
+    ASSERT_FALSE(op.GetKeyValue(s, "test", "blob"));
+  }
+
+  db.Close();
+}
+
+
+TEST(KeyValueStoresCache, Basic)
+{
+  KeyValueStoresCache cache;
+
+  bool exists;
+  std::string value;
+  uint64_t generation;
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "a"));
+  cache.Add("test", "a", true, "hello", generation);
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "a"));  // Not enabled
+
+  cache.SetMaximumSize("test", 10);
+
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "a"));
+  cache.Add("test", "a", true, "hello", generation);
+  ASSERT_TRUE(cache.Lookup(exists, value, generation, "test", "a"));
+  ASSERT_TRUE(exists);
+  ASSERT_EQ("hello", value);
+  ASSERT_EQ(6u, cache.GetCurrentSize("test"));
+
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "b"));
+  cache.Add("test", "b", false, "", generation);  // Negative entry
+  ASSERT_TRUE(cache.Lookup(exists, value, generation, "test", "b"));
+  ASSERT_FALSE(exists);
+  ASSERT_EQ(7u, cache.GetCurrentSize("test"));
+
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "c"));
+  cache.Add("test", "c", true, "world", generation);  // Evicts "a", the least recently used
+  ASSERT_EQ(7u, cache.GetCurrentSize("test"));
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "a"));
+  ASSERT_TRUE(cache.Lookup(exists, value, generation, "test", "b"));
+  ASSERT_TRUE(cache.Lookup(exists, value, generation, "test", "c"));
+  ASSERT_EQ("world", value);
+
+  cache.Add("test", "d", true, "too large to be cached", generation);
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "d"));
+
+  // A value that was read before a write must be rejected
+  uint64_t before;
+  ASSERT_FALSE(cache.Lookup(exists, value, before, "test", "e"));
+
+  {
+    KeyValueStoresCache::Transaction transaction(cache, "test");
+    transaction.Store("c", "new", 3);
+    ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "c"));  // Evicted during the write
+    transaction.Commit();
+  }
+
+  cache.Add("test", "e", true, "old", before);
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "e"));
+
+  ASSERT_TRUE(cache.Lookup(exists, value, generation, "test", "c"));  // Write-through
+  ASSERT_TRUE(exists);
+  ASSERT_EQ("new", value);
+
+  {
+    KeyValueStoresCache::Transaction transaction(cache, "test");
+    transaction.Delete("c");
+    // No commit, e.g. because of an exception
+  }
+
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "c"));
+
+  {
+    // Concurrent writes on the same store: Nothing is cached
+    KeyValueStoresCache::Transaction t1(cache, "test");
+    KeyValueStoresCache::Transaction t2(cache, "test");
+    t1.Store("f", "1", 1);
+    t2.Store("g", "2", 1);
+    t1.Commit();
+    t2.Commit();
+  }
+
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "f"));
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "g"));
+
+  cache.SetMaximumSize("test", 0);
+  ASSERT_EQ(0u, cache.GetCurrentSize("test"));
+  ASSERT_FALSE(cache.Lookup(exists, value, generation, "test", "b"));
+}
+
+
+TEST(SQLiteDatabaseWrapper, KeyValueStoresBatch)
+{
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+
+  {
+    StatelessDatabaseOperations op(db, false);
+    op.SetTransactionContextFactory(new DummyTransactionContextFactory);
+
+    for (unsigned int i = 0; i < 2; i++)
+    {
+      if (i == 1)
+      {
+        op.SetKeyValueStoreCacheSize("test", 1024 * 1024);
+      }
+
+      std::map<std::string, std::string> stored;
+      stored["a"] = "hello";
+      stored["b"] = "world";
+      stored["c"] = "nope";
+      op.UpdateKeysValues("test", stored, std::set<std::string>());
+
+      std::set<std::string> deleted;
+      deleted.insert("c");
+      op.UpdateKeysValues("test", std::map<std::string, std::string>(), deleted);
+
+      std::set<std::string> keys;
+      keys.insert("a");
+      keys.insert("b");
+      keys.insert("c");
+
+      for (unsigned int j = 0; j < 2; j++)  // The second time, the values are read from the cache
+      {
+        std::map<std::string, std::string> values;
+        op.GetKeysValues(values, "test", keys);
+        ASSERT_EQ(2u, values.size());
+        ASSERT_EQ("hello", values["a"]);
+        ASSERT_EQ("world", values["b"]);
+      }
+
+      op.StoreKeyValue("test", "c", "back");
+      op.DeleteKeyValue("test", "a");
+
+      std::string s;
+      ASSERT_FALSE(op.GetKeyValue(s, "test", "a"));
+      ASSERT_TRUE(op.GetKeyValue(s, "test", "c"));  ASSERT_EQ("back", s);
+
+      std::map<std::string, std::string> values;
+      op.GetKeysValues(values, "test", keys);
+      ASSERT_EQ(2u, values.size());
+      ASSERT_EQ("world", values["b"]);
+      ASSERT_EQ("back", values["c"]);
+
+      op.DeleteKeyValue("test", "b");
+      op.DeleteKeyValue("test", "c");
+      op.GetKeysValues(values, "test", keys);
+      ASSERT_TRUE(values.empty());
+    }
+  }
+
+  db.Close();
+}
+
+
+TEST(SQLiteDatabaseWrapper, ContentReferences)
+{
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+
+  {
+    StatelessDatabaseOperations op(db, false);
+    op.SetTransactionContextFactory(new DummyTransactionContextFactory);
+
+    ContentReferences references(op);
+
+    std::string s;
+    ASSERT_EQ(ContentAddressedStorageArea::ReferenceStatus_Missing, references.AddReference(s, "a"));
+
+    s = "custom";
+    ASSERT_TRUE(references.Register(s, "a"));
+
+    s = "other";
+    ASSERT_FALSE(references.Register(s, "a"));  // Concurrent writer
+    ASSERT_EQ("custom", s);
+
+    s.clear();
+    ASSERT_EQ(ContentAddressedStorageArea::ReferenceStatus_Added, references.AddReference(s, "a"));
+    ASSERT_EQ("custom", s);
+
+    ASSERT_FALSE(references.RemoveReference("a"));
+    ASSERT_FALSE(references.RemoveReference("a"));
+    ASSERT_TRUE(references.RemoveReference("a"));
+
+    // The content is being deleted
+    ASSERT_EQ(ContentAddressedStorageArea::ReferenceStatus_Deleting, references.AddReference(s, "a"));
+    ASSERT_THROW(references.Register(s, "a"), OrthancException);
+    ASSERT_FALSE(references.RemoveReference("a"));
+
+    references.Forget("a");
+    ASSERT_EQ(ContentAddressedStorageArea::ReferenceStatus_Missing, references.AddReference(s, "a"));
+    ASSERT_FALSE(references.RemoveReference("a"));
+    ASSERT_FALSE(op.GetKeyValue(s, "orthanc-content-references", "a"));
+  }
+
+  db.Close();
+}
+
+
+TEST(SQLiteDatabaseWrapper, ReadOnlyConnections)
+{
+  TemporaryFile tmp;
+
+  {
+    SQLiteDatabaseWrapper db(SystemToolbox::PathToUtf8(tmp.GetPath()));
+    db.SetReadOnlyConnectionsCount(2);
+    db.Open();
+    ASSERT_THROW(db.SetReadOnlyConnectionsCount(1), OrthancException);
+
+    TestDatabaseListener listener;
+
+    {
+      std::unique_ptr<IDatabaseWrapper::ITransaction> rw(db.StartTransaction(TransactionType_ReadWrite, listener));
+      dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*rw).CreateResource("a", ResourceType_Patient);
+
+      {
+        // Nested in the read-write transaction => sees the uncommitted changes
+        std::unique_ptr<IDatabaseWrapper::ITransaction> ro(db.StartTransaction(TransactionType_ReadOnly, listener));
+        ASSERT_EQ(1, dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*ro).GetTableRecordCount("Resources"));
+        ro->Commit(0);
+      }
+
+      rw->Commit(0);
+    }
+
+    {
+      std::unique_ptr<IDatabaseWrapper::ITransaction> ro1(db.StartTransaction(TransactionType_ReadOnly, listener));
+      ASSERT_EQ(1, dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*ro1).GetTableRecordCount("Resources"));
+
+      {
+        // Nested in "ro1", reuses its connection of the pool
+        std::unique_ptr<IDatabaseWrapper::ITransaction> ro2(db.StartTransaction(TransactionType_ReadOnly, listener));
+        ASSERT_EQ(1, dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*ro2).GetTableRecordCount("Resources"));
+        ro2->Commit(0);
+      }
+
+      {
+        // The readers do not block the writer
+        std::unique_ptr<IDatabaseWrapper::ITransaction> rw(db.StartTransaction(TransactionType_ReadWrite, listener));
+        dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*rw).CreateResource("b", ResourceType_Patient);
+        rw->Commit(0);
+      }
+
+      // "ro1" keeps reading the snapshot it started with
+      ASSERT_EQ(1, dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*ro1).GetTableRecordCount("Resources"));
+      ASSERT_THROW(ro1->Commit(10), OrthancException);
+      ro1->Commit(0);
+    }
+
+    {
+      std::unique_ptr<IDatabaseWrapper::ITransaction> ro(db.StartTransaction(TransactionType_ReadOnly, listener));
+      ASSERT_EQ(2, dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*ro).GetTableRecordCount("Resources"));
+      ro->Commit(0);
+    }
 
-    ASSERT_TRUE(op.GetKeyValue(s, "test", "hello"));   ASSERT_EQ("world", s);
-    op.StoreKeyValue("test", "hello", "overwritten");
-    ASSERT_TRUE(op.GetKeyValue(s, "test", "hello"));   ASSERT_EQ("overwritten", s);
+    db.Close();
+  }
+}
 
-    op.DeleteKeyValue("test", "nope");
 
-    op.DeleteKeyValue("test", "hello");
-    op.DeleteKeyValue("test", "hello3");
+TEST(SQLiteDatabaseWrapper, GlobalStatistics)
+{
+  TemporaryFile tmp;
+  TestDatabaseListener listener;
+
+  {
+    SQLiteDatabaseWrapper db(SystemToolbox::PathToUtf8(tmp.GetPath()));
+    db.Open();
+
+    std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadWrite, listener));
+    SQLiteDatabaseWrapper::UnitTestsTransaction& transaction = dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*t);
+
+    int64_t patient = transaction.CreateResource("patient", ResourceType_Patient);
+    int64_t study = transaction.CreateResource("study", ResourceType_Study);
+    int64_t series = transaction.CreateResource("series", ResourceType_Series);
+    int64_t instance1 = transaction.CreateResource("instance1", ResourceType_Instance);
+    int64_t instance2 = transaction.CreateResource("instance2", ResourceType_Instance);
+    transaction.AttachChild(patient, study);
+    transaction.AttachChild(study, series);
+    transaction.AttachChild(series, instance1);
+    transaction.AttachChild(series, instance2);
+    transaction.AddAttachment(instance1, FileInfo("a", FileContentType_Dicom, 10, "md5"), 42);
+
+    ASSERT_EQ(1u, t->GetResourcesCount(ResourceType_Patient));
+    ASSERT_EQ(1u, t->GetResourcesCount(ResourceType_Study));
+    ASSERT_EQ(1u, t->GetResourcesCount(ResourceType_Series));
+    ASSERT_EQ(2u, t->GetResourcesCount(ResourceType_Instance));
+    ASSERT_EQ(10u, t->GetTotalCompressedSize());
+
+    t->DeleteResource(instance2);
+    ASSERT_EQ(1u, t->GetResourcesCount(ResourceType_Instance));
+
+    t->DeleteResource(instance1);  // Recursively deletes the whole patient
+    ASSERT_EQ(0u, t->GetResourcesCount(ResourceType_Patient));
+    ASSERT_EQ(0u, t->GetResourcesCount(ResourceType_Study));
+    ASSERT_EQ(0u, t->GetResourcesCount(ResourceType_Series));
+    ASSERT_EQ(0u, t->GetResourcesCount(ResourceType_Instance));
+    ASSERT_EQ(0u, t->GetTotalCompressedSize());
+
+    transaction.CreateResource("patient2", ResourceType_Patient);
+
+    // The check cannot run while a transaction is active
+    ASSERT_THROW(db.CheckGlobalStatistics(), OrthancException);
+
+    t->Commit(0);
+    t.reset();
+
+    ASSERT_TRUE(db.CheckGlobalStatistics());
+    db.Close();
+  }
+
+  {
+    // Introduce a drift behind the back of Orthanc
+    SQLite::Connection connection;
+    connection.Open(SystemToolbox::PathToUtf8(tmp.GetPath()));
+    connection.Execute("UPDATE GlobalIntegers SET value=42 WHERE key=2");
+    connection.Execute("UPDATE GlobalIntegers SET value=43 WHERE key=0");
+  }
+
+  {
+    SQLiteDatabaseWrapper db(SystemToolbox::PathToUtf8(tmp.GetPath()));
+    db.Open();
 
-    for (unsigned int limit = 0; limit < 5; limit++)
     {
-      StatelessDatabaseOperations::KeysValuesIterator it(op, "test");
-      it.SetLimit(limit);
-      ASSERT_FALSE(it.Next());
+      std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadOnly, listener));
+      ASSERT_EQ(42u, t->GetResourcesCount(ResourceType_Patient));
+      ASSERT_EQ(43u, t->GetTotalCompressedSize());
+      t->Commit(0);
     }
 
+    ASSERT_FALSE(db.CheckGlobalStatistics());
+    ASSERT_TRUE(db.CheckGlobalStatistics());
+
     {
-      std::string blob;
-      blob.push_back(0);
-      blob.push_back(1);
-      blob.push_back(0);
-      blob.push_back(2);
-      op.StoreKeyValue("test", "blob", blob); // Storing binary values
+      std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadOnly, listener));
+      ASSERT_EQ(1u, t->GetResourcesCount(ResourceType_Patient));
+      ASSERT_EQ(0u, t->GetTotalCompressedSize());
+      t->Commit(0);
     }
 
-    ASSERT_TRUE(op.GetKeyValue(s, "test", "blob"));
-    ASSERT_EQ(4u, s.size());
-    ASSERT_EQ(0, static_cast<uint8_t>(s[0]));
-    ASSERT_EQ(1, static_cast<uint8_t>(s[1]));
-    ASSERT_EQ(0, static_cast<uint8_t>(s[2]));
-    ASSERT_EQ(2, static_cast<uint8_t>(s[3]));
-    op.DeleteKeyValue("test", "blob");
-    ASSERT_FALSE(op.GetKeyValue(s, "test", "blob"));
+    db.Close();
+  }
+}
+
+
+TEST(SQLiteDatabaseWrapper, IncrementalVacuum)
+{
+  TemporaryFile tmp;
+  TestDatabaseListener listener;
+
+  {
+    // Database created without the incremental vacuum
+    SQLiteDatabaseWrapper db(SystemToolbox::PathToUtf8(tmp.GetPath()));
+    db.Open();
+    db.Close();
+  }
+
+  {
+    SQLiteDatabaseWrapper db(SystemToolbox::PathToUtf8(tmp.GetPath()));
+    ASSERT_THROW(db.SetIncrementalVacuum(true, 0), OrthancException);
+    db.SetIncrementalVacuum(true, 10);
+    db.Open();  // The database is converted by a full "VACUUM"
+    ASSERT_THROW(db.SetIncrementalVacuum(false, 10), OrthancException);
+
+    std::vector<int64_t> patients;
+
+    {
+      std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadWrite, listener));
+      SQLiteDatabaseWrapper::UnitTestsTransaction& transaction = dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*t);
+
+      for (unsigned int i = 0; i < 100; i++)
+      {
+        patients.push_back(transaction.CreateResource("patient" + boost::lexical_cast<std::string>(i), ResourceType_Patient));
+        transaction.SetMainDicomTag(patients.back(), DICOM_TAG_PATIENT_NAME, std::string(4000, 'a'));
+      }
+
+      t->Commit(0);
+    }
+
+    int64_t freePages;
+    uint64_t vacuumedPages;
+    db.FlushToDisk();
+    db.GetMaintenanceStatistics(freePages, vacuumedPages);
+    ASSERT_EQ(0u, vacuumedPages);
+
+    {
+      std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadWrite, listener));
+      for (size_t i = 0; i < patients.size(); i++)
+      {
+        t->DeleteResource(patients[i]);
+      }
+
+      t->Commit(0);
+    }
+
+    // Not idle, as a read-write transaction has just been committed
+    db.FlushToDisk();
+    db.GetMaintenanceStatistics(freePages, vacuumedPages);
+    ASSERT_EQ(0u, vacuumedPages);
+    ASSERT_GT(freePages, 20);
+
+    // Idle, one slice of at most 10 pages is reclaimed
+    const int64_t initialFreePages = freePages;
+    db.FlushToDisk();
+    db.GetMaintenanceStatistics(freePages, vacuumedPages);
+    ASSERT_EQ(10u, vacuumedPages);
+    ASSERT_EQ(initialFreePages - 10, freePages);
+
+    while (freePages > 0)
+    {
+      db.FlushToDisk();
+      db.GetMaintenanceStatistics(freePages, vacuumedPages);
+    }
+
+    ASSERT_EQ(static_cast<uint64_t>(initialFreePages), vacuumedPages);
+    db.Close();
+  }
+
+  {
+    SQLite::Connection connection;
+    connection.Open(SystemToolbox::PathToUtf8(tmp.GetPath()));
+    SQLite::Statement s(connection, "PRAGMA auto_vacuum");
+    ASSERT_TRUE(s.Step());
+    ASSERT_EQ(2 /* INCREMENTAL */, s.ColumnInt(0));
+  }
+}
+
+
+TEST(SQLiteDatabaseWrapper, ChangesPruningAndCoalescing)
+{
+  TestDatabaseListener listener;
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.SetCoalesceChanges(true);
+  db.Open();
+  ASSERT_THROW(db.SetCoalesceChanges(false), OrthancException);
+  ASSERT_TRUE(db.GetDatabaseCapabilities().HasChangesPruningSupport());
+
+  {
+    std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadWrite, listener));
+    SQLiteDatabaseWrapper::UnitTestsTransaction& transaction = dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*t);
+
+    int64_t a = transaction.CreateResource("a", ResourceType_Study);
+    int64_t b = transaction.CreateResource("b", ResourceType_Study);
+
+    transaction.LogChange(ChangeType_NewStudy, ResourceType_Study, a, "a", "20200101T000000");
+    transaction.LogChange(ChangeType_NewStudy, ResourceType_Study, a, "a", "20200102T000000");
+    transaction.LogChange(ChangeType_UpdatedMetadata, ResourceType_Study, a, "a", "20200103T000000");
+    transaction.LogChange(ChangeType_UpdatedMetadata, ResourceType_Study, a, "a", "20200104T000000");
+    transaction.LogChange(ChangeType_UpdatedMetadata, ResourceType_Study, b, "b", "20200105T000000");
+    transaction.LogChange(ChangeType_StableStudy, ResourceType_Study, a, "a", "20200106T000000");
+    transaction.LogChange(ChangeType_UpdatedMetadata, ResourceType_Study, a, "a", "20200107T000000");
+
+    // The "New*" changes are never coalesced, and only the latest
+    // "UpdatedMetadata" of study "a" is kept
+    ASSERT_EQ(5, transaction.GetTableRecordCount("Changes"));
+
+    std::list<ServerIndexChange> changes;
+    bool done;
+    transaction.GetChanges(changes, done, 0, 100);
+    ASSERT_EQ(5u, changes.size());
+    ASSERT_TRUE(done);
+    ASSERT_EQ(ChangeType_UpdatedMetadata, changes.back().GetChangeType());
+    ASSERT_EQ("a", changes.back().GetPublicId());
+    ASSERT_EQ("20200107T000000", changes.back().GetDate());
+
+    for (unsigned int i = 0; i < 5; i++)
+    {
+      transaction.LogExportedResource(ExportedResource(-1, ResourceType_Study, "a", "modality", "2020010" + boost::lexical_cast<std::string>(i + 1) + "T000000",
+                                                       "patient", "study", "", ""));
+    }
+
+    ASSERT_EQ(5, transaction.GetTableRecordCount("ExportedResources"));
+
+    // Only the entries that are strictly older than the date are deleted, by slices
+    ASSERT_EQ(0u, transaction.DeleteChangesBefore("20200101T000000", 100));
+    ASSERT_EQ(2u, transaction.DeleteChangesBefore("20200105T000000", 2));
+    ASSERT_EQ(3, transaction.GetTableRecordCount("Changes"));
+    ASSERT_EQ(0u, transaction.DeleteChangesBefore("20200105T000000", 2));
+    ASSERT_EQ(1u, transaction.DeleteChangesBefore("20200106T000000", 2));
+    ASSERT_EQ(2, transaction.GetTableRecordCount("Changes"));
+
+    // Range deletes along the sequence numbers, to keep the most recent changes
+    const int64_t last = transaction.GetLastChangeIndex();
+    ASSERT_EQ(7, last);
+    ASSERT_EQ(0u, transaction.DeleteChangesUpTo(0, 100));
+    ASSERT_EQ(1u, transaction.DeleteChangesUpTo(last - 1, 100));
+    ASSERT_EQ(1, transaction.GetTableRecordCount("Changes"));
+    ASSERT_EQ(0u, transaction.DeleteChangesUpTo(last - 1, 100));
+
+    ASSERT_EQ(3u, transaction.DeleteExportedResourcesBefore("20200104T000000", 100));
+    ASSERT_EQ(2, transaction.GetTableRecordCount("ExportedResources"));
+    ASSERT_EQ(2u, transaction.DeleteExportedResourcesBefore("20300101T000000", 100));
+    ASSERT_EQ(0, transaction.GetTableRecordCount("ExportedResources"));
+
+    t->Commit(0);
+  }
+
+  db.Close();
+}
+
+static void LookupPatientName(std::set<std::string>& target,
+                              SQLiteDatabaseWrapper& db,
+                              IDatabaseWrapper::ITransaction& transaction,
+                              const std::string& pattern)
+{
+  std::vector<std::string> values;
+  values.push_back(pattern);
+
+  FindRequest request(ResourceType_Patient);
+  request.GetDicomTagConstraints().AddConstraint(
+    new DatabaseDicomTagConstraint(ResourceType_Patient, DICOM_TAG_PATIENT_NAME, true,
+                                   ConstraintType_Wildcard, values, true, true));
+
+  FindResponse response;
+  transaction.ExecuteFind(response, request, db.GetDatabaseCapabilities());
+
+  target.clear();
+  for (size_t i = 0; i < response.GetSize(); ++i)
+  {
+    target.insert(response.GetResourceByIndex(i).GetIdentifier());
+  }
+}
+
+
+TEST(SQLiteDatabaseWrapper, NGramIndex)
+{
+  std::set<std::string> ngrams;
+  ISqlLookupFormatter::ExtractNGrams(ngrams, "SMITH", false);
+  ASSERT_EQ(3u, ngrams.size());
+  ASSERT_TRUE(ngrams.find("SMI") != ngrams.end());
+  ASSERT_TRUE(ngrams.find("MIT") != ngrams.end());
+  ASSERT_TRUE(ngrams.find("ITH") != ngrams.end());
+
+  ISqlLookupFormatter::ExtractNGrams(ngrams, "*SM?TH*", true);
+  ASSERT_TRUE(ngrams.empty());
+
+  ISqlLookupFormatter::ExtractNGrams(ngrams, "JO*SMIT?", true);
+  ASSERT_EQ(2u, ngrams.size());
+  ASSERT_TRUE(ngrams.find("SMI") != ngrams.end());
+  ASSERT_TRUE(ngrams.find("MIT") != ngrams.end());
+
+  ISqlLookupFormatter::ExtractNGrams(ngrams, "*SMITH*", false);
+  ASSERT_EQ(5u, ngrams.size());  // The wildcards are regular characters in values
+
+  TemporaryFile tmp;
+  TestDatabaseListener listener;
+
+  {
+    SQLiteDatabaseWrapper db(SystemToolbox::PathToUtf8(tmp.GetPath()));
+    db.SetNGramIndex(true);
+    db.Open();
+    ASSERT_THROW(db.SetNGramIndex(false), OrthancException);
+
+    std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadWrite, listener));
+    SQLiteDatabaseWrapper::UnitTestsTransaction& transaction = dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*t);
+
+    int64_t a = transaction.CreateResource("a", ResourceType_Patient);
+    int64_t b = transaction.CreateResource("b", ResourceType_Patient);
+    int64_t c = transaction.CreateResource("c", ResourceType_Patient);
+    transaction.SetIdentifierTag(a, DICOM_TAG_PATIENT_NAME, "JOHN SMITH");
+    transaction.SetIdentifierTag(b, DICOM_TAG_PATIENT_NAME, "JANE SMYTH");
+    transaction.SetIdentifierTag(c, DICOM_TAG_PATIENT_NAME, "JOHN DOE");
+    transaction.SetIdentifierTag(c, DICOM_TAG_PATIENT_BIRTH_DATE, "19700101");  // Not indexed
+
+    ASSERT_EQ(8 + 8 + 6, transaction.GetTableRecordCount("DicomIdentifiersNGrams"));
+
+    std::set<std::string> s;
+    LookupPatientName(s, db, transaction, "*SMITH*");
+    ASSERT_EQ(1u, s.size());
+    ASSERT_TRUE(s.find("a") != s.end());
+
+    LookupPatientName(s, db, transaction, "*SM?TH");
+    ASSERT_EQ(2u, s.size());
+
+    LookupPatientName(s, db, transaction, "JOHN*");
+    ASSERT_EQ(2u, s.size());
+    ASSERT_TRUE(s.find("a") != s.end());
+    ASSERT_TRUE(s.find("c") != s.end());
+
+    LookupPatientName(s, db, transaction, "*OHN SMI*");
+    ASSERT_EQ(1u, s.size());
+
+    LookupPatientName(s, db, transaction, "*HN?SM*");  // Only n-grams "HN?" and "?SM" would span the wildcard
+    ASSERT_EQ(1u, s.size());
+
+    LookupPatientName(s, db, transaction, "*SMITH");
+    ASSERT_EQ(1u, s.size());
+
+    LookupPatientName(s, db, transaction, "SMITH*");  // The n-grams match, but not the pattern
+    ASSERT_TRUE(s.empty());
+
+    transaction.DeleteResource(a);
+    ASSERT_EQ(8 + 6, transaction.GetTableRecordCount("DicomIdentifiersNGrams"));
+
+    LookupPatientName(s, db, transaction, "*SMITH*");
+    ASSERT_TRUE(s.empty());
+
+    t->Commit(0);
+    t.reset();
+    db.Close();
+  }
+
+  {
+    // Reopening the database with the index enabled keeps the existing n-grams
+    SQLiteDatabaseWrapper db(SystemToolbox::PathToUtf8(tmp.GetPath()));
+    db.SetNGramIndex(true);
+    db.Open();
+
+    std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadWrite, listener));
+    ASSERT_EQ(8 + 6, dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*t).GetTableRecordCount("DicomIdentifiersNGrams"));
+
+    std::set<std::string> s;
+    LookupPatientName(s, db, *t, "*SMYTH");
+    ASSERT_EQ(1u, s.size());
+    ASSERT_TRUE(s.find("b") != s.end());
+
+    t->Commit(0);
+    t.reset();
+    db.Close();
+  }
+
+  {
+    // Reopening the database without the index drops the n-grams
+    SQLiteDatabaseWrapper db(SystemToolbox::PathToUtf8(tmp.GetPath()));
+    db.Open();
+
+    std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadWrite, listener));
+
+    std::set<std::string> s;
+    LookupPatientName(s, db, *t, "*SMYTH");
+    ASSERT_EQ(1u, s.size());
+
+    t->Commit(0);
+    t.reset();
+    db.Close();
+  }
+}
+
+
+static void LookupMetadata(std::set<std::string>& target,
+                           SQLiteDatabaseWrapper& db,
+                           IDatabaseWrapper::ITransaction& transaction,
+                           ConstraintType type,
+                           const std::string& value,
+                           bool caseSensitive)
+{
+  FindRequest request(ResourceType_Patient);
+  request.AddMetadataConstraint(new DatabaseMetadataConstraint(MetadataType_EndUser, type, value, caseSensitive));
+
+  FindResponse response;
+  transaction.ExecuteFind(response, request, db.GetDatabaseCapabilities());
+
+  target.clear();
+  for (size_t i = 0; i < response.GetSize(); ++i)
+  {
+    target.insert(response.GetResourceByIndex(i).GetIdentifier());
+  }
+}
+
+
+TEST(SQLiteDatabaseWrapper, MetadataValuesIndex)
+{
+  std::string lower, upper;
+  ASSERT_FALSE(ISqlLookupFormatter::GetWildcardPrefixRange(lower, upper, "*DONE"));
+  ASSERT_FALSE(ISqlLookupFormatter::GetWildcardPrefixRange(lower, upper, "?DONE"));
+
+  ASSERT_TRUE(ISqlLookupFormatter::GetWildcardPrefixRange(lower, upper, "DONE*"));
+  ASSERT_EQ("DONE", lower);
+  ASSERT_EQ("DONF", upper);
+
+  ASSERT_TRUE(ISqlLookupFormatter::GetWildcardPrefixRange(lower, upper, "AB?D*"));
+  ASSERT_EQ("AB", lower);
+  ASSERT_EQ("AC", upper);
+
+  ASSERT_TRUE(ISqlLookupFormatter::GetWildcardPrefixRange(lower, upper, "A\xff\xff*"));
+  ASSERT_EQ("A\xff\xff", lower);
+  ASSERT_EQ("B", upper);
+
+  ASSERT_TRUE(ISqlLookupFormatter::GetWildcardPrefixRange(lower, upper, "\xff*"));
+  ASSERT_EQ("\xff", lower);
+  ASSERT_TRUE(upper.empty());
+
+  TestDatabaseListener listener;
+  SQLiteDatabaseWrapper db;  // The SQLite DB is in memory
+  db.Open();
+
+  std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadWrite, listener));
+  SQLiteDatabaseWrapper::UnitTestsTransaction& transaction = dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*t);
+
+  int64_t a = transaction.CreateResource("a", ResourceType_Patient);
+  int64_t b = transaction.CreateResource("b", ResourceType_Patient);
+  int64_t c = transaction.CreateResource("c", ResourceType_Patient);
+  transaction.CreateResource("d", ResourceType_Patient);
+  transaction.SetMetadata(a, MetadataType_EndUser, "DONE", 0);
+  transaction.SetMetadata(b, MetadataType_EndUser, "DONE-PARTIAL", 0);
+  transaction.SetMetadata(c, MetadataType_EndUser, "done", 0);
+
+  std::set<std::string> s;
+  LookupMetadata(s, db, transaction, ConstraintType_Equal, "DONE", true);
+  ASSERT_EQ(1u, s.size());
+  ASSERT_TRUE(s.find("a") != s.end());
+
+  LookupMetadata(s, db, transaction, ConstraintType_Equal, "DONE", false);
+  ASSERT_EQ(2u, s.size());
+  ASSERT_TRUE(s.find("a") != s.end());
+  ASSERT_TRUE(s.find("c") != s.end());
+
+  LookupMetadata(s, db, transaction, ConstraintType_Wildcard, "DONE*", true);
+  ASSERT_EQ(2u, s.size());
+  ASSERT_TRUE(s.find("a") != s.end());
+  ASSERT_TRUE(s.find("b") != s.end());
+
+  LookupMetadata(s, db, transaction, ConstraintType_Wildcard, "DO?E-*", true);
+  ASSERT_EQ(1u, s.size());
+  ASSERT_TRUE(s.find("b") != s.end());
+
+  LookupMetadata(s, db, transaction, ConstraintType_Wildcard, "*DONE", true);
+  ASSERT_EQ(1u, s.size());
+  ASSERT_TRUE(s.find("a") != s.end());
+
+  LookupMetadata(s, db, transaction, ConstraintType_Wildcard, "DONE*", false);
+  ASSERT_EQ(3u, s.size());
+
+  LookupMetadata(s, db, transaction, ConstraintType_GreaterOrEqual, "DONE-", true);
+  ASSERT_EQ(2u, s.size());
+  ASSERT_TRUE(s.find("b") != s.end());
+  ASSERT_TRUE(s.find("c") != s.end());
+
+  t->Commit(0);
+  t.reset();
+  db.Close();
+}
+
+static void LookupLabels(std::set<std::string>& target,
+                         SQLiteDatabaseWrapper& db,
+                         IDatabaseWrapper::ITransaction& transaction,
+                         const std::string& labels,
+                         LabelsConstraint constraint)
+{
+  FindRequest request(ResourceType_Study);
+
+  std::vector<std::string> tokens;
+  Toolbox::TokenizeString(tokens, labels, ',');
+  for (size_t i = 0; i < tokens.size(); i++)
+  {
+    if (!tokens[i].empty())
+    {
+      request.AddLabel(tokens[i]);
+    }
+  }
+
+  request.SetLabelsConstraint(constraint);
+
+  FindResponse response;
+  transaction.ExecuteFind(response, request, db.GetDatabaseCapabilities());
+
+  target.clear();
+  for (size_t i = 0; i < response.GetSize(); ++i)
+  {
+    target.insert(response.GetResourceByIndex(i).GetIdentifier());
   }
+}
+
+
+TEST(SQLiteDatabaseWrapper, LabelsConstraints)
+{
+  TestDatabaseListener listener;
+  SQLiteDatabaseWrapper db;  // The SQLite DB is in memory
+  db.Open();
+
+  std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadWrite, listener));
+  SQLiteDatabaseWrapper::UnitTestsTransaction& transaction = dynamic_cast<SQLiteDatabaseWrapper::UnitTestsTransaction&>(*t);
+
+  int64_t a = transaction.CreateResource("a", ResourceType_Study);
+  int64_t b = transaction.CreateResource("b", ResourceType_Study);
+  int64_t c = transaction.CreateResource("c", ResourceType_Study);
+  transaction.CreateResource("d", ResourceType_Study);
+  int64_t e = transaction.CreateResource("e", ResourceType_Series);
+  transaction.AddLabel(a, "tenant1");
+  transaction.AddLabel(a, "urgent");
+  transaction.AddLabel(b, "tenant1");
+  transaction.AddLabel(c, "tenant2");
+  transaction.AddLabel(c, "urgent");
+  transaction.AddLabel(e, "tenant1");  // Not a study
+
+  std::set<std::string> s;
+  LookupLabels(s, db, transaction, "tenant1", LabelsConstraint_All);
+  ASSERT_EQ(2u, s.size());
+  ASSERT_TRUE(s.find("a") != s.end());
+  ASSERT_TRUE(s.find("b") != s.end());
 
+  LookupLabels(s, db, transaction, "tenant1,urgent", LabelsConstraint_All);
+  ASSERT_EQ(1u, s.size());
+  ASSERT_TRUE(s.find("a") != s.end());
+
+  LookupLabels(s, db, transaction, "tenant1,urgent", LabelsConstraint_Any);
+  ASSERT_EQ(3u, s.size());
+
+  LookupLabels(s, db, transaction, "tenant1,nope", LabelsConstraint_All);
+  ASSERT_TRUE(s.empty());
+
+  LookupLabels(s, db, transaction, "tenant1", LabelsConstraint_None);
+  ASSERT_EQ(2u, s.size());
+  ASSERT_TRUE(s.find("c") != s.end());
+  ASSERT_TRUE(s.find("d") != s.end());
+
+  LookupLabels(s, db, transaction, "tenant1,urgent", LabelsConstraint_None);
+  ASSERT_EQ(1u, s.size());
+  ASSERT_TRUE(s.find("d") != s.end());
+
+  LookupLabels(s, db, transaction, "", LabelsConstraint_None);
+  ASSERT_EQ(1u, s.size());
+  ASSERT_TRUE(s.find("d") != s.end());
+
+  LookupLabels(s, db, transaction, "", LabelsConstraint_All);
+  ASSERT_EQ(4u, s.size());
+
+  t->Commit(0);
+  t.reset();
   db.Close();
 }
 
+TEST(SQLiteDatabaseWrapper, ExplainFind)
+{
+  TestDatabaseListener listener;
+  SQLiteDatabaseWrapper db;  // The SQLite DB is in memory
+  db.Open();
+  ASSERT_TRUE(db.GetDatabaseCapabilities().HasFindExplainSupport());
+
+  std::unique_ptr<IDatabaseWrapper::ITransaction> t(db.StartTransaction(TransactionType_ReadOnly, listener));
+
+  FindRequest request(ResourceType_Study);
+  request.AddLabel("tenant1");
+  request.SetLabelsConstraint(LabelsConstraint_All);
+  request.SetLimits(0, 10);
+
+  Json::Value explanation;
+  t->ExplainFind(explanation, request, db.GetDatabaseCapabilities());
+
+  ASSERT_EQ(Json::objectValue, explanation.type());
+  ASSERT_EQ(Json::stringValue, explanation["SQL"].type());
+  ASSERT_NE(std::string::npos, explanation["SQL"].asString().find("Labels"));
+
+  ASSERT_EQ(Json::arrayValue, explanation["Parameters"].type());
+  ASSERT_EQ(2u, explanation["Parameters"].size());
+  ASSERT_EQ("tenant1", explanation["Parameters"][0].asString());
+  ASSERT_EQ(10, explanation["Parameters"][1].asInt());
+
+  ASSERT_EQ(Json::arrayValue, explanation["Plan"].type());
+
+  bool usesIndex = false;
+  for (Json::Value::ArrayIndex i = 0; i < explanation["Plan"].size(); i++)
+  {
+    if (explanation["Plan"][i].asString().find("LabelsIndex3") != std::string::npos)
+    {
+      usesIndex = true;
+    }
+  }
+
+  ASSERT_TRUE(usesIndex);
+
+  t->Commit(0);
+  t.reset();
+  db.Close();
+}
 
 TEST(SQLiteDatabaseWrapper, Queues)
 {
@@ -1347,6 +2952,32 @@ TEST(SQLiteDatabaseWrapper, Queues)
   db.Close();
 }
 
+TEST(DelayedFilesRemover, Serialization)
+{
+  std::string customData("hello\0world", 11);  // Binary custom data
+
+  std::string s;
+  DelayedFilesRemover::SerializeFile(s, "uuid", FileContentType_DicomUntilPixelData, customData);
+
+  std::string uuid, data;
+  FileContentType type;
+  DelayedFilesRemover::UnserializeFile(uuid, type, data, s);
+  ASSERT_EQ("uuid", uuid);
+  ASSERT_EQ(FileContentType_DicomUntilPixelData, type);
+  ASSERT_EQ(11u, data.size());
+  ASSERT_EQ(customData, data);
+
+  DelayedFilesRemover::SerializeFile(s, "uuid2", FileContentType_Dicom, "");
+  DelayedFilesRemover::UnserializeFile(uuid, type, data, s);
+  ASSERT_EQ("uuid2", uuid);
+  ASSERT_EQ(FileContentType_Dicom, type);
+  ASSERT_TRUE(data.empty());
+
+  ASSERT_THROW(DelayedFilesRemover::UnserializeFile(uuid, type, data, "nope"), OrthancException);
+  ASSERT_THROW(DelayedFilesRemover::UnserializeFile(uuid, type, data, "{\"Uuid\":\"a\"}"), OrthancException);
+}
+
+
 TEST(SQLiteDatabaseWrapper, ReserveQueueValue)
 {
   SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
@@ -1420,6 +3051,34 @@ TEST(SQLiteDatabaseWrapper, ReserveQueueValue)
     ASSERT_FALSE(op.ReserveQueueValue(s, valueId0, "test", QueueOrigin_Back, 1));  
   }
 
+  {
+    StatelessDatabaseOperations op(db, false);
+    op.SetTransactionContextFactory(new DummyTransactionContextFactory);
+
+    op.EnqueueValue("renew", "a");
+    op.EnqueueValue("renew", "b");
+
+    std::string s;
+    uint64_t valueId, renewedId, dummy;
+    ASSERT_TRUE(op.ReserveQueueValue(s, valueId, "renew", QueueOrigin_Front, 100));
+    ASSERT_EQ("a", s);
+
+    op.RenewQueueValueReservation(renewedId, "renew", valueId, "a", 100);
+    ASSERT_NE(valueId, renewedId);
+    ASSERT_EQ(2u, op.GetQueueSize("renew"));
+    ASSERT_THROW(op.AcknowledgeQueueValue("renew", valueId), OrthancException);  // Replaced by the renewal
+    ASSERT_THROW(op.RenewQueueValueReservation(dummy, "renew", valueId, "a", 100), OrthancException);
+
+    // The renewed value is still reserved
+    ASSERT_TRUE(op.ReserveQueueValue(s, valueId, "renew", QueueOrigin_Front, 100));
+    ASSERT_EQ("b", s);
+    ASSERT_FALSE(op.ReserveQueueValue(s, valueId, "renew", QueueOrigin_Front, 100));
+
+    op.AcknowledgeQueueValue("renew", renewedId);
+    op.AcknowledgeQueueValue("renew", valueId);
+    ASSERT_EQ(0u, op.GetQueueSize("renew"));
+  }
+
   db.Close();
 }
 
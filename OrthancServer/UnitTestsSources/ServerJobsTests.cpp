@@ -30,6 +30,7 @@
 #include "../../OrthancFramework/Sources/JobsEngine/Operations/LogJobOperation.h"
 #include "../../OrthancFramework/Sources/Logging.h"
 #include "../../OrthancFramework/Sources/SerializationToolbox.h"
+#include "../../OrthancFramework/Sources/SystemToolbox.h"
 
 #include "../Sources/Database/SQLiteDatabaseWrapper.h"
 #include "../Sources/DicomInstanceToStore.h"
@@ -45,10 +46,13 @@
 #include "../Sources/ServerJobs/Operations/SystemCallOperation.h"
 
 #include "../Sources/ServerJobs/ArchiveJob.h"
+#include "../Sources/ServerJobs/JobOutputsStore.h"
+#include "../Sources/ServerJobs/JobsEventsHub.h"
 #include "../Sources/ServerJobs/DicomModalityStoreJob.h"
 #include "../Sources/ServerJobs/DicomMoveScuJob.h"
 #include "../Sources/ServerJobs/MergeStudyJob.h"
 #include "../Sources/ServerJobs/OrthancPeerStoreJob.h"
+#include "../Sources/ServerJobs/ReindexingJob.h"
 #include "../Sources/ServerJobs/ResourceModificationJob.h"
 #include "../Sources/ServerJobs/SplitStudyJob.h"
 
@@ -360,6 +364,19 @@ static bool CheckIdempotentSetOfInstances(IJobUnserializer& unserializer,
 }
 
 
+static JobStepCode RunThreadedSetOfInstancesJob(ThreadedSetOfInstancesJob& job)
+{
+  for (;;)
+  {
+    JobStepCode code = job.Step("jobId").GetCode();
+    if (code != JobStepCode_Continue)
+    {
+      return code;
+    }
+  }
+}
+
+
 static bool CheckIdempotentSetOfInstances(IJobUnserializer& unserializer,
                                           ThreadedSetOfInstancesJob& job)
 {
@@ -876,6 +893,26 @@ TEST_F(OrthancJobsSerialization, Jobs)
     ASSERT_FALSE(tmp.GetPeer().IsPkcs11Enabled());
     ASSERT_TRUE(tmp.IsTranscode());
     ASSERT_EQ(DicomTransferSyntax_JPEGProcess1, tmp.GetTransferSyntax());
+    ASSERT_EQ(0u, tmp.GetBundleSize());
+  }
+
+  {
+    OrthancPeerStoreJob job(GetContext());
+    job.SetBundleSize(100);
+    job.SetCompress(true);
+    
+    ASSERT_TRUE(CheckIdempotentSetOfInstances(unserializer, job));
+    ASSERT_TRUE(job.Serialize(s));
+  }
+
+  {
+    std::unique_ptr<IJob> job;
+    job.reset(unserializer.UnserializeJob(s));
+
+    OrthancPeerStoreJob& tmp = dynamic_cast<OrthancPeerStoreJob&>(*job);
+    ASSERT_EQ(100u, tmp.GetBundleSize());
+    ASSERT_TRUE(tmp.IsCompress());
+    ASSERT_FALSE(tmp.IsTranscode());
   }
 
   // ResourceModificationJob
@@ -1042,9 +1079,9 @@ TEST_F(OrthancJobsSerialization, Jobs)
     std::string a, b;
 
     {
-      ASSERT_THROW(SplitStudyJob(GetContext(), std::string("nope")), OrthancException);
+      ASSERT_THROW(SplitStudyJob(GetContext(), std::string("nope"), 1), OrthancException);
 
-      SplitStudyJob job(GetContext(), study);
+      SplitStudyJob job(GetContext(), study, 2);
       job.SetKeepSource(true);
       job.AddSourceSeries(series);
       ASSERT_THROW(job.AddSourceSeries("nope"), OrthancException);
@@ -1058,10 +1095,8 @@ TEST_F(OrthancJobsSerialization, Jobs)
       a = job.GetTargetStudyUid();
       ASSERT_TRUE(job.LookupTargetSeriesUid(b, series));
 
-      job.AddTrailingStep();
       job.Start();
-      ASSERT_EQ(JobStepCode_Continue, job.Step("jobId").GetCode());
-      ASSERT_EQ(JobStepCode_Success, job.Step("jobId").GetCode());
+      ASSERT_EQ(JobStepCode_Success, RunThreadedSetOfInstancesJob(job));
 
       study2 = job.GetTargetStudy();
       ASSERT_FALSE(study2.empty());
@@ -1105,9 +1140,9 @@ TEST_F(OrthancJobsSerialization, Jobs)
   // MergeStudyJob
 
   {
-    ASSERT_THROW(SplitStudyJob(GetContext(), std::string("nope")), OrthancException);
+    ASSERT_THROW(MergeStudyJob(GetContext(), std::string("nope"), 1), OrthancException);
 
-    MergeStudyJob job(GetContext(), study);
+    MergeStudyJob job(GetContext(), study, 2);
     job.SetKeepSource(true);
     job.AddSource(study2);
     ASSERT_THROW(job.AddSourceSeries("nope"), OrthancException);
@@ -1117,10 +1152,8 @@ TEST_F(OrthancJobsSerialization, Jobs)
     
     ASSERT_EQ(job.GetTargetStudy(), study);
 
-    job.AddTrailingStep();
     job.Start();
-    ASSERT_EQ(JobStepCode_Continue, job.Step("jobId").GetCode());
-    ASSERT_EQ(JobStepCode_Success, job.Step("jobId").GetCode());
+    ASSERT_EQ(JobStepCode_Success, RunThreadedSetOfInstancesJob(job));
 
     ASSERT_TRUE(CheckIdempotentSetOfInstances(unserializer, job));
     ASSERT_TRUE(job.Serialize(s));
@@ -1143,10 +1176,92 @@ TEST_F(OrthancJobsSerialization, Jobs)
     ASSERT_EQ(study, tmp.GetTargetStudy());
     ASSERT_EQ(RequestOrigin_Lua, tmp.GetOrigin().GetRequestOrigin());
   }
+
+  {
+    // Backward compatibility with the jobs serialized by Orthanc <=
+    // 1.12.11, that were derived from "SetOfInstancesJob"
+    ASSERT_EQ(Json::arrayValue, s["Instances"].type());
+    ASSERT_EQ(1u, s["Instances"].size());
+
+    s["Commands"] = Json::arrayValue;
+    s["Commands"].append(s["Instances"][0]);
+    s["Commands"].append(Json::nullValue);  // Trailing step
+    s["Position"] = 0;
+    s["TrailingStep"] = true;
+    s.removeMember("Instances");
+    s.removeMember("CurrentStep");
+    s.removeMember("WorkersCount");
+
+    std::unique_ptr<IJob> job;
+    job.reset(unserializer.UnserializeJob(s));
+
+    MergeStudyJob& tmp = dynamic_cast<MergeStudyJob&>(*job);
+    ASSERT_EQ(1u, tmp.GetInstancesCount());
+    ASSERT_EQ(ThreadedSetOfInstancesJob::ThreadedJobStep_NotStarted, tmp.GetCurrentStep());
+    ASSERT_TRUE(tmp.IsKeepSource());
+    ASSERT_EQ(study, tmp.GetTargetStudy());
+  }
 }
 
 
 
+TEST_F(OrthancJobsSerialization, ReindexingJob)
+{
+  std::string instance1, instance2;
+  ASSERT_TRUE(CreateInstance(instance1));
+  ASSERT_TRUE(CreateInstance(instance2));
+
+  ASSERT_THROW(ReindexingJob(GetContext(), 0, 10, 0), OrthancException);
+  ASSERT_THROW(ReindexingJob(GetContext(), 2, 0, 0), OrthancException);
+
+  OrthancJobUnserializer unserializer(GetContext());
+  Json::Value s;
+
+  {
+    ReindexingJob job(GetContext(), 2, 1 /* one instance per batch */, 0 /* no limit */);
+    job.SetDescription("Test");
+    ASSERT_FLOAT_EQ(0.0f, job.GetProgress());
+
+    job.Start();
+
+    JobStepCode code;
+    do
+    {
+      code = job.Step("jobId").GetCode();
+    }
+    while (code == JobStepCode_Continue);
+
+    ASSERT_EQ(JobStepCode_Success, code);
+    ASSERT_EQ(2u, job.GetProcessedStudies());
+    ASSERT_EQ(2u, job.GetProcessedInstances());
+    ASSERT_FALSE(job.GetLastStudy().empty());
+    ASSERT_FLOAT_EQ(1.0f, job.GetProgress());
+
+    ASSERT_TRUE(job.Serialize(s));
+  }
+
+  {
+    std::unique_ptr<IJob> job;
+    job.reset(unserializer.UnserializeJob(s));
+
+    // The unserialized job resumes after the last study, so it has nothing left to do
+    ReindexingJob& tmp = dynamic_cast<ReindexingJob&>(*job);
+    ASSERT_EQ(s["LastStudy"].asString(), tmp.GetLastStudy());
+    ASSERT_EQ(2u, tmp.GetProcessedInstances());
+
+    tmp.Start();
+    ASSERT_EQ(JobStepCode_Continue, tmp.Step("jobId").GetCode());  // Listing the studies
+    ASSERT_EQ(JobStepCode_Success, tmp.Step("jobId").GetCode());
+    ASSERT_EQ(2u, tmp.GetProcessedStudies());
+    ASSERT_EQ(2u, tmp.GetProcessedInstances());
+
+    Json::Value t;
+    ASSERT_TRUE(tmp.Serialize(t));
+    ASSERT_EQ(s.toStyledString(), t.toStyledString());
+  }
+}
+
+
 TEST_F(OrthancJobsSerialization, DicomAssociationParameters)
 {
   Json::Value v;
@@ -1345,3 +1460,105 @@ TEST_F(OrthancJobsSerialization, DicomMoveScuJob)
     ASSERT_EQ(query.toStyledString(), s2["Query"][0].toStyledString());
   }
 }
+
+
+TEST(JobsEventsHub, Basic)
+{
+  JobsEventsHub hub;
+  hub.SignalJobUpdated("nope");  // No listener
+
+  std::set<std::string> changes;
+
+  {
+    JobsEventsHub::Listener listener(hub);
+    ASSERT_EQ(1u, hub.GetListenersCount());
+
+    ASSERT_TRUE(listener.WaitChanges(changes, 10));
+    ASSERT_TRUE(changes.empty());
+
+    // The changes of one job are coalesced
+    hub.SignalJobUpdated("a");
+    hub.SignalJobUpdated("b");
+    hub.SignalJobUpdated("a");
+
+    ASSERT_TRUE(listener.WaitChanges(changes, 10));
+    ASSERT_EQ(2u, changes.size());
+    ASSERT_TRUE(changes.find("a") != changes.end());
+    ASSERT_TRUE(changes.find("b") != changes.end());
+
+    ASSERT_TRUE(listener.WaitChanges(changes, 10));
+    ASSERT_TRUE(changes.empty());
+
+    hub.Stop();
+    ASSERT_FALSE(listener.WaitChanges(changes, 1000));
+  }
+
+  ASSERT_EQ(0u, hub.GetListenersCount());
+}
+
+
+static TemporaryFile* CreateJobOutput(JobOutputsStore& store,
+                                      size_t size)
+{
+  std::unique_ptr<TemporaryFile> f(store.CreateSpoolFile());
+  f->Write(std::string(size, 'x'));
+  return f.release();
+}
+
+
+TEST(JobOutputsStore, Basic)
+{
+  JobOutputsStore store(2);
+  ASSERT_EQ(0u, store.GetNumberOfItems());
+
+  store.Add("job1", "archive", CreateJobOutput(store, 10), MimeType_Zip, "a.zip");
+  store.Add("job2", "archive", CreateJobOutput(store, 20), MimeType_Zip, "b.zip");
+  ASSERT_EQ(2u, store.GetNumberOfItems());
+  ASSERT_EQ(30u, store.GetTotalSize());
+
+  std::string path;
+
+  {
+    JobOutputsStore::Accessor accessor(store, "job1", "archive");
+    ASSERT_TRUE(accessor.IsValid());
+    ASSERT_EQ(10u, accessor.GetSize());
+    ASSERT_EQ(MimeType_Zip, accessor.GetMimeType());
+    ASSERT_EQ("a.zip", accessor.GetFilename());
+    path = accessor.GetFile().GetPath().string();
+  }
+
+  ASSERT_FALSE(JobOutputsStore::Accessor(store, "job1", "nope").IsValid());
+  ASSERT_FALSE(JobOutputsStore::Accessor(store, "nope", "archive").IsValid());
+
+  // "job2" is the least recently used output
+  store.Add("job3", "archive", CreateJobOutput(store, 30), MimeType_Zip, "c.zip");
+  ASSERT_EQ(2u, store.GetNumberOfItems());
+  ASSERT_EQ(40u, store.GetTotalSize());
+  ASSERT_FALSE(JobOutputsStore::Accessor(store, "job2", "archive").IsValid());
+
+  {
+    // The file stays on the disk until the accessor is released
+    JobOutputsStore::Accessor accessor(store, "job1", "archive");
+    ASSERT_TRUE(store.Remove("job1", "archive"));
+    ASSERT_FALSE(store.Remove("job1", "archive"));
+    ASSERT_TRUE(accessor.IsValid());
+    ASSERT_TRUE(SystemToolbox::IsRegularFile(path));
+  }
+
+  ASSERT_FALSE(SystemToolbox::IsRegularFile(path));
+  ASSERT_EQ(1u, store.GetNumberOfItems());
+  ASSERT_EQ(30u, store.GetTotalSize());
+
+  // The quota on the total size never evicts the last output
+  store.SetMaximumTotalSize(25);
+  ASSERT_EQ(1u, store.GetNumberOfItems());
+
+  store.Add("job4", "archive", CreateJobOutput(store, 5), MimeType_Zip, "d.zip");
+  ASSERT_EQ(1u, store.GetNumberOfItems());
+  ASSERT_EQ(5u, store.GetTotalSize());
+  ASSERT_TRUE(JobOutputsStore::Accessor(store, "job4", "archive").IsValid());
+
+  CacheStatistics statistics;
+  store.GetStatistics(statistics);
+  ASSERT_EQ(2u, statistics.GetEvictions());
+}
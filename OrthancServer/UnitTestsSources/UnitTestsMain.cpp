@@ -444,6 +444,91 @@ namespace Orthanc
 }
 
 
+TEST(ServerToolbox, ExtractIndexingSummary)
+{
+  // This is a Latin-1 test string: "crane" with a circumflex accent
+  const unsigned char raw[] = { 0x63, 0x72, 0xe2, 0x6e, 0x65 };
+  std::string latin1((char*) &raw[0], sizeof(raw) / sizeof(char));
+
+  const std::string utf8 = Toolbox::ConvertToUtf8(latin1, Encoding_Latin1, false, false);
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    ParsedDicomFile dicom(true);
+    dicom.SetEncoding(Encoding_Latin1);
+    dicom.ReplacePlainString(DICOM_TAG_PATIENT_NAME, "Hello^World");
+    dicom.ReplacePlainString(DICOM_TAG_STUDY_DESCRIPTION, utf8);
+    dicom.ReplacePlainString(DICOM_TAG_SERIES_DESCRIPTION, "odd");
+    dicom.ReplacePlainString(DICOM_TAG_MANUFACTURER, std::string(ORTHANC_MAXIMUM_TAG_LENGTH + 1, 'a'));
+    dicom.ReplacePlainString(DICOM_TAG_INSTANCE_NUMBER, "42");
+    dicom.ReplacePlainString(DICOM_TAG_ROWS, "512");
+    dicom.ReplacePlainString(DICOM_TAG_COLUMNS, "256");
+    dicom.ReplacePlainString(DICOM_TAG_IMAGE_ORIENTATION_PATIENT, "1\\0\\0\\0\\1\\0");
+    dicom.ReplacePlainString(DICOM_TAG_PIXEL_DATA, "binary");
+    dicom.GetDcmtkObject().getDataset()->insertEmptyElement(DCM_StudyID, OFFalse);
+
+    if (i == 1)
+    {
+      ASSERT_TRUE(dicom.GetDcmtkObject().chooseRepresentation(EXS_LittleEndianImplicit, NULL).good());
+      dicom.GetDcmtkObject().removeAllButCurrentRepresentations();
+    }
+
+    std::string buffer;
+    dicom.SaveToMemoryBuffer(buffer);
+
+    DicomMap expected;
+
+    {
+      ParsedDicomFile reparsed(buffer);
+      OrthancConfiguration::DefaultExtractDicomSummary(expected, reparsed);
+    }
+
+    DicomMap summary;
+    ASSERT_TRUE(ServerToolbox::ExtractIndexingSummary(summary, buffer.c_str(), buffer.size()));
+
+    ASSERT_EQ("Hello^World", summary.GetStringValue(DICOM_TAG_PATIENT_NAME, "", false));
+    ASSERT_EQ(utf8, summary.GetStringValue(DICOM_TAG_STUDY_DESCRIPTION, "", false));
+    ASSERT_EQ("odd", summary.GetStringValue(DICOM_TAG_SERIES_DESCRIPTION, "", false));
+    ASSERT_TRUE(summary.GetValue(DICOM_TAG_MANUFACTURER).IsNull());
+    ASSERT_EQ("", summary.GetStringValue(DICOM_TAG_STUDY_ID, "nope", false));
+    ASSERT_EQ("512", summary.GetStringValue(DICOM_TAG_ROWS, "", false));
+    ASSERT_EQ("256", summary.GetStringValue(DICOM_TAG_COLUMNS, "", false));
+    ASSERT_FALSE(summary.HasTag(DICOM_TAG_PIXEL_DATA));
+
+    // The values must be the same as those extracted by DCMTK
+    std::set<DicomTag> tags;
+    summary.GetTags(tags);
+    ASSERT_FALSE(tags.empty());
+
+    for (std::set<DicomTag>::const_iterator it = tags.begin(); it != tags.end(); ++it)
+    {
+      const DicomValue* value = expected.TestAndGetValue(*it);
+      ASSERT_TRUE(value != NULL);
+      ASSERT_EQ(value->IsNull(), summary.GetValue(*it).IsNull());
+
+      if (!value->IsNull())
+      {
+        ASSERT_EQ(value->GetContent(), summary.GetValue(*it).GetContent());
+      }
+    }
+
+    std::set<DicomTag> mainDicomTags;
+    DicomMap::GetAllMainDicomTags(mainDicomTags);
+
+    for (std::set<DicomTag>::const_iterator it = mainDicomTags.begin(); it != mainDicomTags.end(); ++it)
+    {
+      ASSERT_EQ(expected.HasTag(*it), summary.HasTag(*it));
+    }
+  }
+
+  {
+    DicomMap summary;
+    const std::string nope = "nope";
+    ASSERT_FALSE(ServerToolbox::ExtractIndexingSummary(summary, nope.c_str(), nope.size()));
+  }
+}
+
+
 TEST(StorageCommitmentReports, Basic)
 {
   Orthanc::StorageCommitmentReports reports(2);